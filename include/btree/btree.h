@@ -28,6 +28,7 @@
 
 typedef struct BTreeDescr BTreeDescr;
 typedef struct BTreeIterator BTreeIterator;
+typedef struct BTreeKeysLookup BTreeKeysLookup;
 typedef struct CheckpointFileHeader CheckpointFileHeader;
 
 typedef uint16 OIndexNumber;
@@ -84,7 +85,9 @@ typedef enum BTreeOperationType
 	BTreeOperationInsert,
 	BTreeOperationLock,
 	BTreeOperationUpdate,
-	BTreeOperationDelete
+	BTreeOperationDelete,
+	/* only in undo: update keeping the changed bytes of the old tuple */
+	BTreeOperationUpdateDelta
 } BTreeOperationType;
 
 typedef enum BTreeLeafTupleDeletedStatus
@@ -151,6 +154,23 @@ typedef struct
 	uint32		(*hash) (BTreeDescr *desc, OTuple tuple, BTreeKeyType tupleType);
 	uint32		(*unique_hash) (BTreeDescr *desc, OTuple tuple);
 	OBTreeKeyCmp cmp;
+
+	/*
+	 * Optional.  Get the number of leading key attributes, which are equal
+	 * in two given non-leaf keys.
+	 */
+	int			(*key_common_prefix) (BTreeDescr *desc,
+									  OTuple key1, OTuple key2);
+
+	/*
+	 * Optional.  Same as `cmp`, but assumes the first `skip` key attributes
+	 * to be known equal.  Must be provided together with
+	 * `key_common_prefix`.
+	 */
+	int			(*cmp_skip) (BTreeDescr *desc,
+							 void *p1, BTreeKeyType k1,
+							 void *p2, BTreeKeyType k2,
+							 int skip);
 } BTreeOps;
 
 #define MAX_NUM_DIRTY_PARTS			4
@@ -184,7 +204,8 @@ struct BTreeDescr
 	SeqBufDescPrivate freeBuf;
 	SeqBufDescPrivate nextChkp[2];
 	SeqBufDescPrivate tmpBuf[2];
-	BTreeS3PartsInfo buildPartsInfo[2];
+	BTreeS3PartsInfo *buildPartsInfo;	/* allocated on demand, see
+										 * btree_smgr_schedule_s3_write() */
 	OXid		createOxid;
 	BTreeOps   *ops;
 };
@@ -359,9 +380,19 @@ extern void o_btree_init_unique_lwlocks(void);
 extern void o_btree_init(BTreeDescr *descr);
 extern void o_btree_cleanup_pages(OInMemoryBlkno root, OInMemoryBlkno metaPageBlkno,
 								  uint32 rootPageChangeCount);
+extern Size o_btree_cleanup_queue_shmem_needs(void);
+extern void o_btree_cleanup_queue_shmem_init(Pointer ptr, bool found);
+extern bool o_btree_cleanup_lazy(Oid datoid, Oid relnode,
+								 OInMemoryBlkno rootPageBlkno,
+								 OInMemoryBlkno metaPageBlkno,
+								 uint32 rootPageChangeCount,
+								 bool files, bool fsync);
+extern void o_btree_cleanup_queued_trees(void);
 extern ItemPointerData btree_ctid_get_and_inc(BTreeDescr *desc);
 extern ItemPointerData btree_bridge_ctid_get_and_inc(BTreeDescr *desc, bool *overflow);
 extern void btree_ctid_update_if_needed(BTreeDescr *desc, ItemPointerData ctid);
+extern void btree_return_ctid_leases(void);
+extern double o_btree_in_memory_fraction(BTreeDescr *desc);
 extern void btree_desc_stopevent_params_internal(BTreeDescr *desc,
 												 JsonbParseState **state);
 extern void btree_page_stopevent_params_internal(BTreeDescr *desc, Page p,
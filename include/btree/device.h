@@ -0,0 +1,34 @@
+/*-------------------------------------------------------------------------
+ *
+ * device.h
+ *		Declarations for the raw devices of the block device mode.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/device.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_DEVICE_H__
+#define __BTREE_DEVICE_H__
+
+#define O_DEVICES_MAX_COUNT	32
+
+extern int	o_devices_count;
+
+extern void o_devices_open(void);
+extern Size o_devices_shmem_needs(void);
+extern void o_devices_shmem_init(Pointer ptr, bool found);
+extern uint64 orioledb_device_alloc(struct BTreeDescr *descr, uint32 size);
+extern uint64 o_devices_data_length(void);
+extern int	o_device_fd(int devnum);
+extern void o_device_io_start(int devnum);
+extern void o_device_io_done(int devnum, bool write, ssize_t amount);
+extern int	o_device_read(char *buffer, int amount, off_t offset);
+extern int	o_device_write(char *buffer, int amount, off_t offset);
+extern void o_device_prefetch(off_t offset, int amount);
+extern void o_device_writeback(off_t offset, int amount);
+extern void o_devices_sync(void);
+
+#endif							/* __BTREE_DEVICE_H__ */
@@ -18,7 +18,7 @@
 #include "btree/find.h"
 #include "btree/page_contents.h"
 
-#define FASTPATH_FIND_DOWNLINK_MAX_KEYS (4)
+#define FASTPATH_FIND_DOWNLINK_MAX_KEYS (8)
 #define FASTPATH_FIND_DOWNLINK_FLAG_MINUS_INF (1)
 #define FASTPATH_FIND_DOWNLINK_FLAG_PLUS_INF (2)
 
@@ -103,6 +103,9 @@ extern void init_page_find_context(OBTreeFindPageContext *context,
 
 extern OFindPageResult find_page(OBTreeFindPageContext *context, void *key,
 								 BTreeKeyType keyType, uint16 targetLevel);
+extern OFindPageResult find_page_resume(OBTreeFindPageContext *context,
+										void *key, BTreeKeyType keyType,
+										uint16 targetLevel);
 extern OFindPageResult refind_page(OBTreeFindPageContext *context, void *key,
 								   BTreeKeyType keyType, uint16 level,
 								   OInMemoryBlkno blkno, uint32 pageChangeCount);
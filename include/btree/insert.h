@@ -26,8 +26,15 @@ extern void o_btree_insert_tuple_to_leaf(OBTreeFindPageContext *context,
 										 BTreeLeafTuphdr *leaf_header,
 										 bool replace,
 										 int reserve_kind);
+extern void o_btree_insert_waiter_tuples(BTreeDescr *desc,
+										 OInMemoryBlkno blkno);
 extern bool o_btree_split_is_incomplete(OInMemoryBlkno left_blkno,
 										uint32 pageChangeCount,
 										bool *relocked);
+extern Size o_btree_broken_splits_shmem_needs(void);
+extern void o_btree_broken_splits_shmem_init(Pointer ptr, bool found);
+extern void o_btree_register_broken_split(OInMemoryBlkno rightBlkno,
+										  uint32 rightChangeCount);
+extern void o_btree_fix_broken_splits(void);
 
 #endif							/* __BTREE_INSERT_H__ */
@@ -25,14 +25,27 @@ typedef enum OWalkPageResult
 	OWalkPageMerged,
 } OWalkPageResult;
 
+#define BTREE_BUILD_WRITE_BUFFER_SIZE	(128 * ORIOLEDB_BLCKSZ)
+
+/* Pages written by the index build, not yet passed to the storage */
+typedef struct
+{
+	char		data[BTREE_BUILD_WRITE_BUFFER_SIZE];
+	off_t		offset;
+	int			length;
+} BTreeBuildWriteBuffer;
+
 extern Size btree_io_shmem_needs(void);
 extern void btree_io_shmem_init(Pointer buf, bool found);
 extern void btree_io_error_cleanup(void);
+extern void btree_io_set_append_extents(BTreeDescr *desc);
 extern void request_btree_io_lwlocks(void);
 extern int	assign_io_num(OInMemoryBlkno blkno, OffsetNumber offnum);
 extern OWalkPageResult walk_page(OInMemoryBlkno blkno, bool evict);
 extern void unlock_io(int ionum);
 extern void wait_for_io_completion(int ionum);
+extern bool have_io_lock(int ionum);
+extern int	btree_smgr_file_fd(File file);
 extern bool cleanup_btree_files(Oid datoid, Oid relnode, bool fsync);
 extern bool fsync_btree_files(Oid datoid, Oid relnode);
 extern int	OFileRead(File file, char *buffer, int amount, off_t offset,
@@ -47,12 +60,19 @@ extern char *btree_smgr_filename(BTreeDescr *desc, off_t offset,
 								 uint32 chkpNum);
 extern int	btree_smgr_read(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 							int amount, off_t offset);
+extern void btree_smgr_prefetch(BTreeDescr *desc, uint32 chkpNum,
+								off_t offset, int amount);
 extern void btree_smgr_writeback(BTreeDescr *desc, uint32 chkpNum,
 								 off_t offset, int amount);
 extern void btree_smgr_sync(BTreeDescr *desc, uint32 chkpNum, off_t length);
 extern void btree_smgr_punch_hole(BTreeDescr *desc, uint32 chkpNum,
 								  off_t offset, int length);
 extern void init_btree_io_lwlocks(void);
+extern bool get_downlink_disk_range(BTreeDescr *desc, uint64 downlink,
+									off_t *byte_offset, int *size);
+extern void prefetch_page_from_disk(BTreeDescr *desc, uint64 downlink);
+extern void prefetch_leaf_for_key(BTreeDescr *desc, Pointer key,
+								  BTreeKeyType keyType);
 extern bool read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink, FileExtent *extent);
 extern void load_page(OBTreeFindPageContext *context);
 extern uint64 perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
@@ -61,7 +81,10 @@ extern uint64 perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 extern uint64 perform_page_io_autonomous(BTreeDescr *desc, uint32 chkpNum,
 										 Page img, FileExtent *extent);
 extern uint64 perform_page_io_build(BTreeDescr *desc, Page img,
-									FileExtent *extent, BTreeMetaPage *metaPageBlkno);
+									FileExtent *extent, BTreeMetaPage *metaPageBlkno,
+									BTreeBuildWriteBuffer *writeBuffer);
+extern void btree_build_flush_writes(BTreeDescr *desc,
+									 BTreeBuildWriteBuffer *writeBuffer);
 extern BTreeDescr *index_oids_get_btree_descr(ORelOids oids, OIndexType type);
 extern void try_to_punch_holes(BTreeDescr *desc);
 
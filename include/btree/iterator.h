@@ -36,6 +36,9 @@ typedef TupleFetchCallbackResult (*TupleFetchCallback) (OTuple tuple,
 														void *arg,
 														TupleFetchCallbackCheckType check_type);
 
+/* Tells whether the tuple version located in the page matches */
+typedef bool (*OTupleFilter) (OTuple tuple, void *arg);
+
 extern OTuple o_btree_find_tuple_by_key(BTreeDescr *desc, void *key,
 										BTreeKeyType kind,
 										OSnapshot *read_o_snapshot,
@@ -43,6 +46,17 @@ extern OTuple o_btree_find_tuple_by_key(BTreeDescr *desc, void *key,
 										MemoryContext mcxt,
 										BTreeLocationHint *hint);
 
+extern BTreeKeysLookup *o_btree_keys_lookup_create(void);
+extern void o_btree_keys_lookup_reset(BTreeKeysLookup *lookup);
+extern void o_btree_keys_lookup_free(BTreeKeysLookup *lookup);
+extern OTuple o_btree_keys_lookup_fetch(BTreeKeysLookup *lookup,
+										BTreeDescr *desc, void *key,
+										BTreeKeyType kind,
+										OSnapshot *read_o_snapshot,
+										CommitSeqNo *out_csn,
+										MemoryContext mcxt,
+										BTreeLocationHint *hint);
+
 extern BTreeIterator *o_btree_iterator_create(BTreeDescr *desc, void *key,
 											  BTreeKeyType kind,
 											  OSnapshot *o_snapshot,
@@ -83,5 +97,19 @@ extern OTuple o_find_tuple_version(BTreeDescr *desc, Page p,
 								   MemoryContext mcxt,
 								   TupleFetchCallback cb,
 								   void *arg);
+extern OTuple o_find_tuple_version_filter(BTreeDescr *desc, Page p,
+										  BTreePageItemLocator *loc,
+										  OSnapshot *oSnapshot,
+										  CommitSeqNo *tupleCsn,
+										  MemoryContext mcxt,
+										  OTupleFilter filter,
+										  void *filterArg);
+extern OTuple o_find_tuple_version_ref(BTreeDescr *desc, Page p,
+									   BTreePageItemLocator *loc,
+									   OSnapshot *oSnapshot,
+									   CommitSeqNo *tupleCsn,
+									   MemoryContext mcxt,
+									   OTupleFilter filter,
+									   void *filterArg, bool *allocated);
 
 #endif							/* __BTREE_ITERATOR_H__ */
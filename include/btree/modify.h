@@ -53,6 +53,7 @@ typedef struct BTreeModifyCallbackInfo
 extern BTreeModifyCallbackInfo nullCallbackInfo;
 
 extern bool o_btree_autonomous_insert(BTreeDescr *desc, OTuple tuple);
+extern bool o_btree_batched_autonomous_insert(BTreeDescr *desc, OTuple tuple);
 extern bool o_btree_autonomous_delete(BTreeDescr *desc, OTuple key, BTreeKeyType keyType,
 									  BTreeLocationHint *hint);
 extern OBTreeModifyResult o_btree_modify(BTreeDescr *desc,
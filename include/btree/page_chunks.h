@@ -45,6 +45,9 @@ extern void init_page_first_chunk(BTreeDescr *desc, Page p,
 								  LocationIndex hikeySize);
 extern void page_chunk_fill_locator(Page p, OffsetNumber chunkOffset,
 									BTreePageItemLocator *locator);
+extern bool page_locator_get_chunk_bounds(Page p,
+										  BTreePageItemLocator *locator,
+										  OTuple *lokey, OTuple *hikey);
 extern void page_item_fill_locator(Page p, OffsetNumber itemOffset,
 								   BTreePageItemLocator *locator);
 extern void page_item_fill_locator_backwards(Page p, OffsetNumber itemOffset,
@@ -19,6 +19,29 @@
 
 #define NUM_SEQ_SCANS_ARRAY_SIZE	32
 
+/* Number of extents in a refill batch of the free extents cache */
+#define FREE_EXTENTS_CACHE_BATCH	16
+/* Cached extent lengths are 1..FREE_EXTENTS_CACHE_CLASSES chunks */
+#define FREE_EXTENTS_CACHE_CLASSES	(ORIOLEDB_BLCKSZ / ORIOLEDB_COMP_BLCKSZ)
+
+typedef struct
+{
+	uint64		offsets[FREE_EXTENTS_CACHE_BATCH];
+	uint8		pos;
+	uint8		count;
+} FreeExtentsCacheBin;
+
+/* Free extents of a compressed tree binned by length, see free_extents.c */
+typedef struct
+{
+	slock_t		lock;
+	/* number of foreach_free_extent() calls in progress */
+	int			disabled;
+	/* number of batches being moved from the trees to the cache */
+	int			inProgress;
+	FreeExtentsCacheBin bins[FREE_EXTENTS_CACHE_CLASSES];
+} FreeExtentsCache;
+
 /* The structure of BTree meta page.  Referenced by metaPageBlkno. */
 typedef struct
 {
@@ -43,6 +66,12 @@ typedef struct
 	pg_atomic_uint64 bridge_ctid;
 	pg_atomic_uint32 leafPagesNum;
 
+	/*
+	 * Number of recent consecutive leaf splits appending to the rightmost
+	 * page.  Used to detect monotonically increasing keys.
+	 */
+	pg_atomic_uint32 appendSplits;
+
 	/* Number of running sequential scans depending on the checkpoint number */
 	pg_atomic_uint32 numSeqScans[NUM_SEQ_SCANS_ARRAY_SIZE];
 
@@ -53,6 +82,22 @@ typedef struct
 
 	LWLock		punchHolesLock;
 	uint32		punchHolesChkpNum;
+
+	/* Id of the compression dictionary, see O_COMPRESS_DICT_* */
+	pg_atomic_uint32 compressDictId;
+
+	/* Automatically selected compression level, see O_COMPRESS_AUTO_* */
+	pg_atomic_uint32 compressAuto;
+
+	FreeExtentsCache freeExtentsCache;
+
+	/*
+	 * Set by the compaction worker to ask the next checkpoint to append the
+	 * pages of this tree at the end of the data file.  The checkpointer
+	 * clears it and saves its checkpoint number to compactChkpNum.
+	 */
+	pg_atomic_uint32 compactRequest;
+	uint32		compactChkpNum;
 } BTreeMetaPage;
 
 StaticAssertDecl(sizeof(BTreeMetaPage) <= ORIOLEDB_BLCKSZ,
@@ -172,6 +217,36 @@ typedef struct PartialPageState PartialPageState;
 #define BTREE_PAGE_LOCATOR_GET_ITEM(p, locptr) \
 	((void) (p), (Pointer) (locptr)->chunk + \
 		ITEM_GET_OFFSET((locptr)->chunk->items[(locptr)->itemOffset]))
+
+/*
+ * Prefetch hints for the page contents, which are going to be read soon.
+ * They overlap the dependent loads of the descent (the page header, then the
+ * chunk descriptors, then the items) and of the iteration with the
+ * processing of the current item.
+ */
+#if defined(__GNUC__)
+#define O_PREFETCH(ptr) __builtin_prefetch((ptr), 0, 3)
+#else
+#define O_PREFETCH(ptr) ((void) (ptr))
+#endif
+#define O_PREFETCH_PAGE_HEADER(p) \
+	do { \
+		O_PREFETCH(p); \
+		O_PREFETCH((Pointer) (p) + PG_CACHE_LINE_SIZE); \
+	} while (false)
+#define BTREE_PAGE_CHUNK_PREFETCH_ITEM(locptr, offset) \
+	O_PREFETCH((Pointer) (locptr)->chunk + \
+			   ITEM_GET_OFFSET((locptr)->chunk->items[(offset)]))
+/* How many items ahead BTREE_PAGE_LOCATOR_PREFETCH() prefetches */
+#define BTREE_PAGE_PREFETCH_DISTANCE 2
+#define BTREE_PAGE_LOCATOR_PREFETCH(p, locptr) \
+	do { \
+		if (BTREE_PAGE_LOCATOR_IS_VALID((p), (locptr)) && \
+			(locptr)->itemOffset + BTREE_PAGE_PREFETCH_DISTANCE < (locptr)->chunkItemsCount) \
+			BTREE_PAGE_CHUNK_PREFETCH_ITEM((locptr), \
+										   (locptr)->itemOffset + BTREE_PAGE_PREFETCH_DISTANCE); \
+	} while (false)
+
 #define BTREE_PAGE_OFFSET_GET_LOCATOR(p, offset, locptr) \
 	(page_item_fill_locator((p), (offset), (locptr)))
 #define BTREE_PAGE_LOCATOR_GET_OFFSET(p, locptr) \
@@ -16,6 +16,7 @@
 
 #include "btree.h"
 #include "page_contents.h"
+#include "utils/tree_stats.h"
 
 /* Flags stored in OrioleDBPageHeader.state */
 #define PAGE_STATE_LOCKED_FLAG	UINT64CONST(0x0000000000040000)
@@ -62,6 +63,8 @@ extern void o_check_page_struct(BTreeDescr *desc, Page p);
 
 extern Size page_state_shmem_needs(void);
 extern void page_state_shmem_init(Pointer buf, bool found);
+extern void page_state_init_wait_events(void);
+extern PageWaitLevel page_wait_level(Page p);
 extern bool have_locked_pages(void);
 extern int	get_waiters_with_tuples(BTreeDescr *desc,
 									OInMemoryBlkno blkno,
@@ -15,6 +15,7 @@
 #define __BTREE_SCAN_H__
 
 #include "btree/btree.h"
+#include "btree/iterator.h"
 #include "btree/page_contents.h"
 
 #include "executor/tuptable.h"
@@ -34,6 +35,18 @@ typedef struct BTreeSeqScanCallbacks
 	bool		(*getNextKey) (OFixedKey *key, bool inclusive, void *arg);
 } BTreeSeqScanCallbacks;
 
+/*
+ * Callbacks of the disk phase of the sequential scan.  The filter gets the
+ * on-disk downlink of the leaf and the csn of the version the scan needs, and
+ * returns false to skip the leaf without reading it.  The loaded callback
+ * gets the image of each leaf just read from disk, before reconstructing its
+ * older version from undo.
+ */
+typedef bool (*BTreeSeqScanDiskLeafFilter) (BTreeDescr *desc, uint64 downlink,
+											CommitSeqNo csn, void *arg);
+typedef void (*BTreeSeqScanDiskLeafLoaded) (BTreeDescr *desc, uint64 downlink,
+											Page img, void *arg);
+
 extern BTreeScanShmem *btreeScanShmem;
 
 extern Size btree_scan_shmem_needs(void);
@@ -44,12 +57,22 @@ extern BTreeSeqScan *make_btree_seq_scan(BTreeDescr *desc,
 extern BTreeSeqScan *make_btree_seq_scan_cb(BTreeDescr *desc,
 											OSnapshot *oSnapshot,
 											BTreeSeqScanCallbacks *cb,
-											void *arg);
+											void *arg, void *poscan);
 extern BTreeSeqScan *make_btree_sampling_scan(BTreeDescr *desc,
 											  BlockSampler sampler);
+extern void btree_seq_scan_set_filter(BTreeSeqScan *scan, OTupleFilter filter,
+									  void *arg);
+extern void btree_seq_scan_set_disk_leaf_filter(BTreeSeqScan *scan,
+												BTreeSeqScanDiskLeafFilter filter,
+												BTreeSeqScanDiskLeafLoaded loaded,
+												void *arg);
 extern OTuple btree_seq_scan_getnext(BTreeSeqScan *scan, MemoryContext mctx,
 									 CommitSeqNo *tupleCsn,
 									 BTreeLocationHint *hint);
+extern int	btree_seq_scan_getnext_batch(BTreeSeqScan *scan, MemoryContext mctx,
+										 OTuple *tuples, CommitSeqNo *csns,
+										 BTreeLocationHint *hints,
+										 bool *allocated, int maxTuples);
 extern OTuple btree_seq_scan_getnext_raw(BTreeSeqScan *scan, MemoryContext mctx,
 										 bool *end, BTreeLocationHint *hint);
 extern void free_btree_seq_scan(BTreeSeqScan *scan);
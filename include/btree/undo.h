@@ -62,6 +62,22 @@ typedef struct
 	BTreeLeafTuphdr tuphdr;
 } BTreeModifyUndoStackItem;
 
+/*
+ * The update undo record, which keeps only the bytes of the old tuple
+ * differing from the new one, see make_update_undo_record().  The record is
+ * followed by this header, the key and the old bytes.
+ */
+typedef struct
+{
+	LocationIndex tupleLength;
+	LocationIndex keyLength;
+	LocationIndex offset;
+	LocationIndex length;
+} BTreeUpdateDeltaUndo;
+
+#define BTREE_UPDATE_DELTA_UNDO_KEY_OFFSET \
+	(sizeof(BTreeModifyUndoStackItem) + MAXALIGN(sizeof(BTreeUpdateDeltaUndo)))
+
 typedef struct
 {
 	OnCommitUndoStackItem header;
@@ -99,6 +115,11 @@ extern UndoLocation make_undo_record(BTreeDescr *desc, OTuple tuple,
 									 OInMemoryBlkno blkno,
 									 uint32 pageChangeCount,
 									 BTreeLeafTuphdr *curTupHdr);
+extern UndoLocation make_update_undo_record(BTreeDescr *desc, OTuple oldTuple,
+											OTuple newTuple,
+											OInMemoryBlkno blkno,
+											uint32 pageChangeCount,
+											BTreeLeafTuphdr *curTupHdr);
 extern void make_waiter_undo_record(BTreeDescr *desc, OInMemoryBlkno blkno,
 									int pgprocno,
 									OPageWaiterShmemState *lockerState);
@@ -143,6 +164,11 @@ extern void lock_undo_callback(UndoLogType undoType, UndoLocation location,
 							   UndoStackItem *baseItem,
 							   OXid oxid, bool abort,
 							   bool changeCountsValid);
+extern UndoLocation add_compact_row_lock(BTreeDescr *desc, OTuple tuple,
+										 bool is_tuple, OInMemoryBlkno blkno,
+										 uint32 pageChangeCount, OXid oxid);
+extern bool have_compact_row_locks(OXid oxid);
+extern void release_compact_row_locks(OXid oxid, bool abort);
 extern void btree_relnode_undo_callback(UndoLogType undoType,
 										UndoLocation location,
 										UndoStackItem *baseItem, OXid oxid,
@@ -171,6 +197,11 @@ extern UndoLocation walk_undo_range_with_buf(UndoLogType undoType, UndoLocation
 											 UndoLocation toLoc,
 											 OXid oxid, bool abort_val, UndoLocation *onCommitLocation,
 											 bool changeCountsValid);
+extern bool undo_range_is_tree_local(UndoLogType undoType,
+									 UndoLocation location);
+extern void walk_undo_range_partition(UndoLogType undoType,
+									  UndoLocation location, OXid oxid,
+									  int partition, int npartitions);
 
 
 #endif							/* __BTREE_UNDO_H__ */
@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------
+ *
+ * uring.h
+ *		Declarations for asynchronous B-tree page writes using io_uring.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/uring.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_URING_H__
+#define __BTREE_URING_H__
+
+#include "storage/fd.h"
+
+typedef enum
+{
+	OIOMethodSync,
+	OIOMethodIOUring
+} OIOMethod;
+
+extern bool o_uring_start_write(OInMemoryBlkno blkno, int ionum);
+extern bool o_uring_write_active(void);
+extern void o_uring_write(File file, char *buffer, int amount, off_t offset);
+extern void o_uring_finish_write(void);
+extern void o_uring_wait_all(void);
+extern void o_uring_error_cleanup(void);
+
+#endif							/* __BTREE_URING_H__ */
@@ -0,0 +1,44 @@
+/*-------------------------------------------------------------------------
+ *
+ * walk.h
+ *		Declarations for the walk over the internal pages of orioledb B-tree.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/btree/walk.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __BTREE_WALK_H__
+#define __BTREE_WALK_H__
+
+#include "btree.h"
+
+typedef enum
+{
+	/* don't visit the child */
+	OBTreeWalkSkip,
+	/* visit the child, the level 0 child is just loaded */
+	OBTreeWalkDescend,
+	/* finish the whole walk */
+	OBTreeWalkStop
+} OBTreeWalkAction;
+
+typedef struct OBTreeWalker
+{
+	/*
+	 * Optional, called for each visited internal page before its downlinks.
+	 * Returns false to skip the downlinks of the page.
+	 */
+	bool		(*page) (BTreeDescr *desc, Page img, uint16 level, void *arg);
+	/* called for each downlink of the visited page at 'level' */
+	OBTreeWalkAction (*downlink) (BTreeDescr *desc, uint16 level,
+								  uint64 downlink, void *arg);
+	void	   *arg;
+} OBTreeWalker;
+
+extern void o_btree_walk_internal_pages(BTreeDescr *desc,
+										OBTreeWalker *walker);
+
+#endif							/* __BTREE_WALK_H__ */
@@ -80,6 +80,14 @@ typedef struct
 	MemoryContext index_mctx;
 } OIndex;
 
+/* item of the array returned by o_indices_collect_oids() */
+typedef struct
+{
+	OIndexType	type;
+	ORelOids	treeOids;
+	ORelOids	tableOids;
+} OIndexOidsItem;
+
 /* callback for o_indices_foreach_oids() */
 typedef void (*OIndexOidsCallback) (OIndexType type, ORelOids treeOids,
 									ORelOids tableOids, void *arg);
@@ -97,6 +105,7 @@ extern bool o_indices_update(OTable *table, OIndexNumber ixNum,
 extern bool o_indices_find_table_oids(ORelOids indexOids, OIndexType type,
 									  OSnapshot *oSnapshot,
 									  ORelOids *tableOids);
+extern OIndexOidsItem *o_indices_collect_oids(int *nitems);
 extern void o_indices_foreach_oids(OIndexOidsCallback callback, void *arg);
 
 #endif
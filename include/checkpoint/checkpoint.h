@@ -20,6 +20,8 @@
 #include "rewind/rewind.h"
 
 #include "access/xlogdefs.h"
+#include "datatype/timestamp.h"
+#include "storage/spin.h"
 
 struct CheckpointFileHeader
 {
@@ -130,7 +132,7 @@ typedef enum
 
 #define SHARED_ROOT_INFO_INSERT_NUM_LOCKS 128
 
-#define XID_RECS_QUEUE_SIZE			(max_procs * 4)
+#define XID_RECS_QUEUE_SIZE			(max_procs * xids_queue_per_backend)
 
 typedef struct
 {
@@ -142,6 +144,45 @@ typedef struct
 /* Rewind types are shifted by UndoLogsCount compared to respective general undoTypes */
 #define XID_REC_REWIND_TYPES_OFFSET UndoLogsCount
 
+/* Phases of the checkpoint accounted in CheckpointStats.phaseTime */
+typedef enum
+{
+	CheckpointPhaseSysTrees,
+	CheckpointPhaseXidsFile,
+	CheckpointPhaseMapSort,
+	CheckpointPhaseWriteback,
+	CheckpointPhaseFsync,
+	CheckpointPhasesCount
+} CheckpointPhase;
+
+#define CHECKPOINT_STATS_HISTORY_SIZE	(16)
+
+/*
+ * Progress and cost of a checkpoint.  The checkpointer publishes its copy to
+ * the shared memory under CheckpointState.statsLock.
+ */
+typedef struct
+{
+	uint32		checkpointNumber;
+	bool		inProgress;
+	int			flags;
+	TimestampTz startTime;
+	TimestampTz endTime;
+	/* the tree being checkpointed */
+	OIndexType	treeType;
+	ORelOids	treeOids;
+	/* trees of the user relations */
+	uint64		treesDone;
+	uint64		treesTotal;
+	uint64		pagesWritten;
+	/* pages written to the free extents of the data file */
+	uint64		pagesReused;
+	uint64		pagesCompressed;
+	uint64		bytesWritten;
+	/* microseconds, the system trees phase includes their writes */
+	int64		phaseTime[CheckpointPhasesCount];
+} CheckpointStats;
+
 typedef struct
 {
 	uint64		controlIdentifier;
@@ -176,6 +217,12 @@ typedef struct
 	XLogRecPtr	controlToastConsistentPtr;
 	pg_atomic_uint64 mmapDataLength;
 
+	/* the running checkpoint and the history of the completed ones */
+	slock_t		statsLock;
+	CheckpointStats curStats;
+	uint32		statsHistoryCount;
+	CheckpointStats statsHistory[CHECKPOINT_STATS_HISTORY_SIZE];
+
 	/*
 	 * Shared memory queue of records for writing to the xids file.  Backends
 	 * write to this queue last undo position on transaction commit/abort.
@@ -195,6 +242,18 @@ typedef struct
 } CheckpointState;
 
 #define XID_FILENAME_FORMAT (ORIOLEDB_DATA_DIR"/%u.xid")
+#define TREE_XMINS_FILENAME_FORMAT (ORIOLEDB_DATA_DIR"/%u.txmin")
+
+/*
+ * The record of the file listing the trees written by the checkpoint.  The
+ * transactions older than xmin were finished before the tree was written, so
+ * their changes are already contained in the checkpoint image of the tree.
+ */
+typedef struct
+{
+	ORelOids	oids;
+	OXid		xmin;
+} CheckpointTreeXmin;
 
 #define chkp_inc_changecount_before(state)	\
 	do {	\
@@ -231,6 +290,7 @@ extern void o_update_latest_chkp_num(Oid datoid, Oid relnode, uint32 chkp_num);
 extern void o_delete_chkp_num(Oid datoid, Oid relnode);
 
 extern void o_perform_checkpoint(XLogRecPtr redo_pos, int flags);
+extern void checkpoint_error_cleanup(void);
 extern void o_after_checkpoint_cleanup_hook(XLogRecPtr checkPointRedo,
 											int flags);
 
@@ -56,6 +56,8 @@
 #define ORIOLEDB_UNDO_DIR "orioledb_undo"
 #define ORIOLEDB_RMGR_ID (129)
 #define ORIOLEDB_XLOG_CONTAINER (0x00)
+#define ORIOLEDB_XLOG_CONTAINER_COMPRESSED (0x10)
+#define ORIOLEDB_XLOG_HOT_PAGES (0x20)
 /*
  * Sub-versions in the same ORIOLEDB_BINARY_VERSION.
  *
@@ -85,6 +87,8 @@
 #define ORIOLEDB_BLCKSZ		8192
 /* size of on disk compressed page chunk */
 #define ORIOLEDB_COMP_BLCKSZ	512
+/* alignment of the data file IO with orioledb.direct_io */
+#define ORIOLEDB_DIRECT_IO_ALIGN	4096
 /* size of data file segment */
 #define ORIOLEDB_SEGMENT_SIZE	(1024 * 1024 * 1024)
 /* size of S3 data file part */
@@ -175,6 +179,9 @@ typedef struct
 	pg_atomic_uint64 reservedUndoLocation;
 	pg_atomic_uint64 transactionUndoRetainLocation;
 	pg_atomic_uint64 snapshotRetainUndoLocation;
+	/* when the retain locations were set, for pg_stat_orioledb_undo */
+	TimestampTz transactionRetainTime;
+	TimestampTz snapshotRetainTime;
 } UndoRetainSharedLocations;
 
 typedef struct
@@ -298,10 +305,17 @@ typedef struct
 	 * pages it should be used for conversion of uncompressed images
 	 */
 	uint8		page_version;
-	uint32		reserved1;
-	uint32		reserved2;
+	uint8		compress_codec; /* Codec of the compressed page, see
+								 * O_COMPRESS_CODEC_* */
+	uint8		flags;			/* See O_ONDISK_PAGE_* */
+	uint16		reserved1;
+	uint32		checksum;		/* CRC-32C of the on-disk image if
+								 * O_ONDISK_PAGE_CHECKSUM is set */
 } OrioleDBOndiskPageHeader;
 
+/* The on-disk image has the checksum */
+#define O_ONDISK_PAGE_CHECKSUM	(0x01)
+
 #define O_PAGE_HEADER_SIZE		sizeof(OrioleDBPageHeader)
 #define O_PAGE_HEADER(page)	((OrioleDBPageHeader *)(page))
 
@@ -324,9 +338,24 @@ typedef struct
 #define FileExtentLenIsValid(len) ((len) != InvalidFileExtentLen)
 #define FileExtentOffIsValid(off) ((off) < InvalidFileExtentOff)
 #define FileExtentIsValid(extent) (FileExtentLenIsValid((extent).len) && FileExtentOffIsValid((extent).off))
+/* direct IO needs the compressed images aligned to the device blocks */
+#define CompressedSizeAlign (orioledb_direct_io ? ORIOLEDB_DIRECT_IO_ALIGN : ORIOLEDB_COMP_BLCKSZ)
 #define CompressedSize(page_size) ((page_size) == ORIOLEDB_BLCKSZ \
 										? ORIOLEDB_BLCKSZ \
-										: ((page_size) + sizeof(OrioleDBOndiskPageHeader) + ORIOLEDB_COMP_BLCKSZ - 1))
+										: TYPEALIGN(CompressedSizeAlign, (page_size) + sizeof(OrioleDBOndiskPageHeader)))
+#define DirectIOIsAligned(ptr, amount, offset) \
+	((((uintptr_t) (ptr)) | ((uintptr_t) (amount)) | ((uintptr_t) (offset))) % ORIOLEDB_DIRECT_IO_ALIGN == 0)
+
+/* Buffer for a page image suitable for direct IO */
+typedef union OIOAlignedPage
+{
+#ifdef pg_attribute_aligned
+	pg_attribute_aligned(ORIOLEDB_DIRECT_IO_ALIGN)
+#endif
+	char		data[ORIOLEDB_BLCKSZ];
+	double		force_align_d;
+	int64		force_align_i64;
+} OIOAlignedPage;
 #define FileExtentLen(page_size) (CompressedSize(page_size) / ORIOLEDB_COMP_BLCKSZ)
 
 typedef struct
@@ -342,12 +371,43 @@ typedef struct
 /* orioledb.c */
 extern Size orioledb_buffers_size;
 extern Size orioledb_buffers_count;
+extern Size compressed_cache_size;
+extern Size undo_page_cache_size;
+extern Size zone_map_size;
+extern Size root_info_cache_size;
+extern int	tree_stats_max;
+extern int	page_wait_sample_rate;
+extern bool explain_io_details;
+extern int	undo_image_limit;
+extern int	undo_disk_read_limit;
+extern bool undo_limit_error;
+extern int	op_sampling_history_size;
+extern int	op_sampling_period;
+extern int	backend_memory_soft_limit;
 extern Size undo_circular_buffer_size;
 extern uint32 undo_buffers_count;
 extern Size xid_circular_buffer_size;
 extern Size rewind_circular_buffer_size;
 extern double regular_block_undo_circular_buffer_fraction;
 extern double system_undo_circular_buffer_fraction;
+extern bool undo_adaptive_split;
+extern int	undo_reserve_batch;
+extern int	undo_compress;
+extern int	undo_compress_codec;
+extern int	orioledb_commit_delay;
+extern int	wal_compress;
+extern int	wal_compress_codec;
+extern int	wal_compress_threshold;
+extern bool wal_update_delta;
+extern bool undo_update_delta;
+extern bool skip_unchanged_indices;
+extern bool compact_row_locks;
+extern bool resume_point_lookups;
+extern int	point_lookup_hints;
+extern int	ctid_lease_size;
+extern bool toast_raw_values;
+extern bool index_build_radix_sort;
+extern bool create_index_concurrently_fallback;
 extern uint32 xid_buffers_count;
 extern uint32 rewind_buffers_count;
 extern Pointer o_shared_buffers;
@@ -356,26 +416,83 @@ extern int	max_procs;
 extern OrioleDBPageDesc *page_descs;
 extern bool remove_old_checkpoint_files;
 extern bool skip_unmodified_trees;
+extern bool orioledb_fast_snapshots;
+extern bool skip_clean_subtrees;
 extern bool debug_disable_bgwriter;
+extern bool balance_pools;
 extern MemoryContext btree_insert_context;
 extern MemoryContext btree_seqscan_context;
 extern double o_checkpoint_completion_ratio;
+extern int	checkpoint_min_write_rate;
+extern int	checkpoint_max_write_rate;
+extern int	checkpoint_sort_mem;
+extern int	xids_queue_per_backend;
 extern int	max_io_concurrency;
+extern int	io_method;
+extern int	io_uring_depth;
+extern int	write_combine_limit;
+extern int	iterator_prefetch_pages;
+extern int	seq_scan_readahead_pages;
+extern int	page_pool_numa_nodes;
+extern int	bgwriter_num_workers;
+extern int	eviction_dirty_skips;
+extern int	free_pages_low_watermark;
+extern int	free_pages_high_watermark;
+extern bool scan_resistant_seq_scan;
+extern bool scan_resistant_sampling;
+extern bool sampling_skip_pages;
+extern bool seq_scan_qual_pushdown;
+extern bool index_only_scan_all_visible;
+extern bool enable_parallel_bitmap_scan;
+extern bool index_insert_prefetch;
+extern bool enable_parallel_index_scan;
+extern bool enable_skip_scan;
+extern bool enable_tree_statistics;
+extern bool enable_count_pushdown;
+extern bool standby_nowait_reads;
+extern bool enable_prewarm;
+extern int	prewarm_workers_num;
+extern bool replica_prewarm;
+extern int	logical_apply_batch_size;
+extern bool compress_dictionaries;
+extern bool compress_auto;
+extern bool page_checksums;
+extern int	compress_auto_cpu_cost;
+extern int	compress_workers_num;
+extern int	checkpoint_sync_workers_num;
+extern int	database_pool_quota;
+extern int	table_pool_quota;
+extern bool enable_background_merge;
+extern int	background_merge_pages;
+extern int	background_merge_delay;
+extern int	split_fix_delay;
+extern bool lazy_tree_cleanup;
+extern bool enable_compaction;
+extern int	compaction_pages;
+extern int	compaction_delay;
+extern bool compaction_pause;
+extern int	verify_workers_num;
+extern int	verify_pages;
+extern int	verify_delay;
 extern bool use_mmap;
 extern bool use_device;
 extern bool orioledb_use_sparse_files;
-extern int	device_fd;
+extern bool orioledb_direct_io;
 extern char *device_filename;
-extern Pointer mmap_data;
+extern int	device_length_guc;
+extern int	device_stripe_size_guc;
 extern Size device_length;
 extern int	default_compress;
 extern int	default_primary_compress;
 extern int	default_toast_compress;
+extern int	default_compress_codec;
 extern bool orioledb_table_description_compress;
 extern BlockNumber max_bridge_ctid_blkno;
 extern bool orioledb_s3_mode;
 extern int	s3_num_workers;
 extern int	s3_desired_size;
+extern int	s3_desired_size_max;
+extern int	s3_cold_read_rate;
 extern int	s3_queue_size_guc;
 extern char *s3_host;
 extern bool s3_use_https;
@@ -384,9 +501,18 @@ extern char *s3_prefix;
 extern char *s3_accesskey;
 extern char *s3_secretkey;
 extern char *s3_cainfo;
+extern int	s3_multipart_part_size;
+extern int	s3_cache_size;
+extern int	s3_file_chunk_size;
+extern char *s3_cache_dir;
+extern int	s3_scan_prefetch_pages;
+extern bool s3_backfill;
 extern bool enable_rewind;
 extern int	rewind_max_time;
 extern int	rewind_max_transactions;
+extern int	rewind_parallel_workers;
+extern bool as_of_enabled;
+extern TimestampTz as_of_timestamp;
 extern int	logical_xid_buffers_guc;
 
 #define GET_CUR_PROCDATA() \
@@ -408,6 +534,19 @@ typedef int OCompress;
 #define InvalidOCompress (-1)
 #define OCompressIsValid(compress) ((compress) != InvalidOCompress)
 
+/*
+ * The upper bits of a valid OCompress select the codec, the lower bits keep
+ * the codec-specific level.  Zero codec keeps plain zstd levels as they are.
+ */
+#define O_COMPRESS_CODEC_ZSTD	(0)
+#define O_COMPRESS_CODEC_LZ4	(1)
+#define O_COMPRESS_CODEC_SHIFT	(8)
+#define O_COMPRESS_LEVEL_MASK	((1 << O_COMPRESS_CODEC_SHIFT) - 1)
+#define OCompressGetCodec(compress) ((compress) >> O_COMPRESS_CODEC_SHIFT)
+#define OCompressGetLevel(compress) ((compress) & O_COMPRESS_LEVEL_MASK)
+#define OCompressMake(codec, level) \
+	(((codec) << O_COMPRESS_CODEC_SHIFT) | (level))
+
 typedef struct ORelOptions
 {
 	StdRdOptions std_options;
@@ -415,6 +554,7 @@ typedef struct ORelOptions
 	int			primary_compress_offset;
 	int			toast_compress_offset;
 	bool		index_bridging;
+	bool		frozen;
 } ORelOptions;
 
 typedef struct OBTOptions
@@ -442,8 +582,8 @@ typedef struct OPagePool OPagePool;
 struct BTreeDescr;
 
 extern void o_verify_dir_exists_or_create(char *dirname, bool *created, bool *found);
-extern uint64 orioledb_device_alloc(struct BTreeDescr *descr, uint32 size);
 extern OPagePool *get_ppool(OPagePoolType type);
+extern const char *get_ppool_name(OPagePoolType type);
 extern OPagePool *get_ppool_by_blkno(OInMemoryBlkno blkno);
 extern OInMemoryBlkno get_dirty_pages_count_sum(void);
 extern void jsonb_push_key(JsonbParseState **state, char *key);
@@ -472,5 +612,6 @@ extern void o_drop_table(ORelOids oids);
 
 /* scan.c */
 extern CustomScanMethods o_scan_methods;
+extern CustomScanMethods o_count_scan_methods;
 
 #endif							/* __ORIOLEDB_H__ */
@@ -51,6 +51,7 @@ typedef enum
 	RecoveryMsgTypeUpdate,
 	RecoveryMsgTypeDelete,
 	RecoveryMsgTypeBridgeErase,
+	RecoveryMsgTypeUpdateDelta,
 	RecoveryMsgTypeCommit,
 	RecoveryMsgTypeRollback,
 	RecoveryMsgTypeFinished,
@@ -132,6 +133,9 @@ typedef struct
 {
 	pg_atomic_uint64 commitPtr;
 	pg_atomic_uint64 retainPtr;
+	/* Modify messages sent by the main process and applied by the worker */
+	pg_atomic_uint64 sentModifies;
+	pg_atomic_uint64 appliedModifies;
 	uint32		flushedUndoLocCompletedCheckpointNumber;
 } RecoveryWorkerPtrs;
 
@@ -196,6 +200,8 @@ extern void DestroyParallelRecoveryContext(ParallelRecoveryContext *context);
  */
 extern void apply_modify_record(OTableDescr *descr, OIndexDescr *id,
 								uint16 type, OTuple p);
+extern void apply_update_delta_record(OTableDescr *descr, OIndexDescr *id,
+									  Pointer data);
 extern bool apply_btree_modify_record(BTreeDescr *tree,
 									  RecoveryMsgType type,
 									  OTuple ptr, OXid oxid, CommitSeqNo csn);
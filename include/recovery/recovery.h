@@ -47,6 +47,7 @@ extern XLogRecPtr recovery_get_current_ptr(void);
 extern int	recovery_queue_size_guc;
 extern int	recovery_pool_size_guc;
 extern int	recovery_idx_pool_size_guc;
+extern bool recovery_prefetch_guc;
 extern OXid recovery_oxid;
 
 typedef struct BTreeDescr BTreeDescr;
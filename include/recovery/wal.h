@@ -14,6 +14,9 @@
 #ifndef __WAL_H__
 #define __WAL_H__
 
+#include "access/xlogreader.h"
+#include "port/pg_crc32c.h"
+
 /*
  * Data sturctures for transactions in-progress recording.
  */
@@ -32,6 +35,7 @@
 #define WAL_REC_JOINT_COMMIT (12)
 #define WAL_REC_TRUNCATE	(13)
 #define WAL_REC_BRIDGE_ERASE (14)
+#define WAL_REC_UPDATE_DELTA (15)
 
 /* Constants for commitInProgressXlogLocation */
 #define OWalTmpCommitPos			(0)
@@ -74,6 +78,28 @@ typedef struct
 	uint8		length[sizeof(OffsetNumber)];
 } WALRecModify;
 
+/*
+ * Update of the primary tuple logged as a difference to the old tuple.  The
+ * bytes of the new tuple matching the prefix and the suffix of the old tuple
+ * are omitted.  The header is followed by the primary key and the middle
+ * bytes of the new tuple.  The length and the checksum of the old tuple let
+ * the replay verify that it rebuilds the tuple from the same base, and the
+ * 64-bit hash of the new tuple verifies the rebuilt tuple itself.
+ */
+typedef struct
+{
+	uint8		recType;
+	uint8		keyFormatFlags;
+	uint8		keyLength[sizeof(OffsetNumber)];
+	uint8		tupleFormatFlags;
+	uint8		tupleLength[sizeof(OffsetNumber)];
+	uint8		prefixLength[sizeof(OffsetNumber)];
+	uint8		suffixLength[sizeof(OffsetNumber)];
+	uint8		baseLength[sizeof(OffsetNumber)];
+	uint8		baseChecksum[sizeof(pg_crc32c)];
+	uint8		tupleHash[sizeof(uint64)];
+} WALRecUpdateDelta;
+
 typedef struct
 {
 	uint8		recType;
@@ -118,6 +144,30 @@ typedef struct
 } WALRecBridgeErase;
 
 #define LOCAL_WAL_BUFFER_SIZE	(8192)
+
+/*
+ * Header of the ORIOLEDB_XLOG_CONTAINER_COMPRESSED record.  It's followed by
+ * the container compressed with the codec.
+ */
+typedef struct
+{
+	uint8		codec;
+	uint8		rawLength[sizeof(uint32)];
+} WALCompressedContainerHeader;
+
+/*
+ * Position of the item at the offset of the container for the record
+ * [startPtr, endPtr).  The positions within the compressed container
+ * are scaled to stay within the record.
+ */
+static inline XLogRecPtr
+wal_container_xlog_ptr(XLogRecPtr startPtr, XLogRecPtr endPtr,
+					   int offset, int length)
+{
+	if (startPtr + length <= endPtr)
+		return startPtr + offset;
+	return startPtr + (uint64) offset * (endPtr - startPtr) / length;
+}
 #define ORIOLEDB_WAL_PREFIX	"o_wal"
 #define ORIOLEDB_WAL_PREFIX_SIZE (5)
 
@@ -135,10 +185,14 @@ extern XLogRecPtr wal_commit(OXid oxid, TransactionId logicalXid);
 extern XLogRecPtr wal_joint_commit(OXid oxid, TransactionId logicalXid,
 								   TransactionId xid);
 extern void wal_after_commit(void);
+extern void wal_commit_flush(XLogRecPtr flushPos);
 extern void wal_rollback(OXid oxid, TransactionId logicalXid);
 extern XLogRecPtr log_logical_wal_container(Pointer ptr, int length);
+extern Pointer wal_container_get_data(XLogReaderState *record, int *length);
 extern void o_wal_insert(BTreeDescr *desc, OTuple tuple);
 extern void o_wal_update(BTreeDescr *desc, OTuple tuple);
+extern void o_wal_update_delta(BTreeDescr *desc, OTuple oldTuple,
+							   OTuple newTuple);
 extern void o_wal_delete(BTreeDescr *desc, OTuple tuple);
 extern void o_wal_delete_key(BTreeDescr *desc, OTuple key);
 extern void add_truncate_wal_record(ORelOids oids);
@@ -18,14 +18,17 @@
 #include "utils/o_buffers.h"
 
 #include "access/transam.h"
+#include "storage/spin.h"
 
 #define REWIND_FILE_SIZE (0x1000000)
 #define REWIND_BUFFERS_TAG (0)
+#define REWIND_INDEX_TAG (1)
 
 extern TransactionId orioledb_vacuum_horizon_hook(void);
 extern void register_rewind_worker(void);
 extern bool is_rewind_worker(void);
 PGDLLEXPORT void rewind_worker_main(Datum);
+PGDLLEXPORT void rewind_apply_worker_main(Datum);
 extern Size rewind_shmem_needs(void);
 extern void rewind_init_shmem(Pointer buf, bool found);
 extern void checkpoint_write_rewind_xids(void);
@@ -35,6 +38,8 @@ extern TransactionId get_precommit_xid_subxids(int *nsubxids, TransactionId **su
 extern void reset_precommit_xid_subxids(void);
 extern OXid get_rewind_run_xmin(void);
 extern void log_print_rewind_queue(void);
+extern bool rewind_get_csn_as_of(TimestampTz timestamp, CommitSeqNo *csn,
+								 OXid *xmin);
 
 #define EMPTY_ITEM_TAG (0)
 #define REWIND_ITEM_TAG (1)
@@ -68,6 +73,45 @@ typedef struct SubxidsItem
 
 #define REWIND_DISK_BUFFER_LENGTH (ORIOLEDB_BLCKSZ / sizeof(RewindItem))
 
+/* Number of pages evicted to disk at once */
+#define REWIND_EVICT_BATCH_PAGES (8)
+
+/* The page is written as is, because the encoded one happened to be larger */
+#define REWIND_PAGE_RAW (1)
+
+/*
+ * Number of (timestamp, CSN) samples taken by the rewind worker.  They cover
+ * rewind_max_time and map the historical queries timestamp to the snapshot.
+ */
+#define REWIND_CSN_SAMPLES (1024)
+
+typedef struct
+{
+	TimestampTz timestamp;
+	CommitSeqNo csn;
+	OXid		xmin;
+} RewindCsnSample;
+
+/*
+ * The location of evicted page of REWIND_DISK_BUFFER_LENGTH items in the data
+ * files.  The index files keep them by the page number.
+ */
+typedef struct
+{
+	uint64		offset;
+	uint32		length;
+	uint32		flags;
+} RewindDiskPageRef;
+
+/* The batch of transactions, which undo is applied by rewind in parallel */
+#define REWIND_APPLY_BATCH_SIZE (1024)
+
+typedef struct
+{
+	OXid		oxid;
+	uint64		undoLocation[UndoLogsCount];
+} RewindApplyItem;
+
 typedef struct
 {
 	pg_atomic_uint64 addPosReserved;	/* Next adding position available for
@@ -83,7 +127,14 @@ typedef struct
 	uint64		checkpointPos;	/* Already included into checkpoint. Start
 								 * point for writing rewindItem-s into
 								 * checkpoint. */
-	uint64		oldCleanedFileNum;	/* Last removed buffer file number */
+	uint64		oldCleanedFileNum;	/* Next buffer file number to remove */
+	uint64		oldCleanedIndexFileNum; /* Next index file number to remove */
+	uint64		evictPageNum;	/* Number of the next page to evict. Only
+								 * changes together with evictPos. */
+	uint64		restorePageNum; /* Number of the next page to restore */
+	uint64		evictDataPos;	/* Next offset in the buffer files */
+	uint64		restoreDataPos; /* Offset in the buffer files after the last
+								 * restored page */
 	bool		skipCheck;		/* Skip timestamp-based check of items to
 								 * process */
 	int			rewindEvictTrancheId;
@@ -104,6 +155,25 @@ typedef struct
 	TransactionId force_complete_xid;
 	OXid		force_complete_oxid;
 
+	/*
+	 * Parallel rewind: the apply workers abort the trees of their partitions
+	 * for every transaction of the batch, the rewinding backend takes the
+	 * partition zero.
+	 */
+	int			applyWorkersNum;
+	bool		applyFinished;
+	pg_atomic_uint32 applyBatchNum;
+	pg_atomic_uint32 applyWorkersDone;
+	uint32		applyBatchLength;
+	RewindApplyItem applyBatch[REWIND_APPLY_BATCH_SIZE];
+
+	/*
+	 * Ring of the snapshot samples for historical queries.  Written only by
+	 * the rewind worker.
+	 */
+	slock_t		csnSamplesLock;
+	uint64		csnSamplesCount;
+	RewindCsnSample csnSamples[REWIND_CSN_SAMPLES];
 } RewindMeta;
 
 /*
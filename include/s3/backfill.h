@@ -0,0 +1,19 @@
+/*-------------------------------------------------------------------------
+ *
+ * backfill.h
+ *		Declarations for the background load of the S3 data file parts.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/s3/backfill.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __S3_BACKFILL_H__
+#define __S3_BACKFILL_H__
+
+extern void register_s3_backfill_worker(void);
+PGDLLEXPORT void s3_backfill_worker_main(Datum);
+
+#endif							/* __S3_BACKFILL_H__ */
@@ -37,6 +37,7 @@ typedef enum
 	 (t1).segNum == (t2).segNum)
 
 extern int	s3_headers_buffers_size;
+extern uint32 s3_header_my_cold_reads;
 
 extern Size s3_headers_shmem_needs(void);
 extern void s3_headers_shmem_init(Pointer buf, bool found);
@@ -54,5 +55,9 @@ extern void s3_header_mark_part_not_written(S3HeaderTag tag, int index);
 extern void s3_headers_sync(void);
 extern void s3_headers_error_cleanup(void);
 extern void s3_headers_try_eviction_cycle(void);
+extern void s3_headers_get_stats(uint64 *lookups, uint64 *misses);
+extern void s3_headers_get_eviction_stats(uint64 *desiredSize,
+										  uint64 *loadedParts,
+										  uint64 *coldReads);
 
 #endif							/* __S3_HEADERS_H__ */
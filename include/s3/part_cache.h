@@ -0,0 +1,25 @@
+/*-------------------------------------------------------------------------
+ *
+ * part_cache.h
+ *		Declarations for the local cache of S3 file parts.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/s3/part_cache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __S3_PART_CACHE_H__
+#define __S3_PART_CACHE_H__
+
+#include "s3/headers.h"
+
+extern Size s3_part_cache_shmem_needs(void);
+extern void s3_part_cache_shmem_init(Pointer ptr, bool found);
+extern void s3_part_cache_put(S3HeaderTag tag, int partNum, int fd,
+							  off_t offset, off_t size);
+extern bool s3_part_cache_get(S3HeaderTag tag, int partNum,
+							  const char *filename);
+
+#endif							/* __S3_PART_CACHE_H__ */
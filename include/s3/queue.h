@@ -20,10 +20,41 @@
 
 #define InvalidS3TaskLocation (UINT64_MAX)
 
+/*
+ * Priority lanes of the queue.  Workers pick the tasks from the lanes in this
+ * order.
+ */
+typedef enum
+{
+	S3TaskPriorityRead = 0,		/* reads somebody is waiting for */
+	S3TaskPriorityWAL,			/* WAL archiving */
+	S3TaskPriorityCheckpoint,	/* checkpoint and eviction writes */
+	S3TaskPriorityPrefetch		/* speculative reads */
+} S3TaskPriority;
+
+#define S3_TASK_PRIORITIES_NUM		4
+
+/*
+ * The task location consists of the lane number plus one in the higher bits
+ * and the offset within the lane.  So, zero location is never valid, and
+ * means that there is nothing to wait for.  The locations are only comparable
+ * within the same lane.
+ */
+#define S3_TASK_LOCATION_LANE_SHIFT	56
+#define S3_TASK_LOCATION_OFFSET_MASK \
+	((UINT64CONST(1) << S3_TASK_LOCATION_LANE_SHIFT) - 1)
+#define S3_TASK_LOCATION_MAKE(priority, offset) \
+	((((uint64) (priority) + 1) << S3_TASK_LOCATION_LANE_SHIFT) | (offset))
+#define S3_TASK_LOCATION_GET_PRIORITY(location) \
+	((S3TaskPriority) (((location) >> S3_TASK_LOCATION_LANE_SHIFT) - 1))
+#define S3_TASK_LOCATION_GET_OFFSET(location) \
+	((location) & S3_TASK_LOCATION_OFFSET_MASK)
+
 extern Size s3_queue_shmem_needs(void);
 extern void s3_queue_init_shmem(Pointer ptr, bool found);
-extern S3TaskLocation s3_queue_get_insert_location(void);
-extern S3TaskLocation s3_queue_put_task(Pointer data, uint32 len);
+extern S3TaskLocation s3_queue_put_task(Pointer data, uint32 len,
+										S3TaskPriority priority);
+extern bool s3_queue_has_ready_task(void);
 extern S3TaskLocation s3_queue_try_pick_task(void);
 Pointer		s3_queue_get_task(S3TaskLocation taskLocation);
 extern void s3_queue_erase_task(S3TaskLocation taskLocation);
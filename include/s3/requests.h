@@ -19,6 +19,11 @@
 #define S3_RESPONSE_CONDITION_CONFLICT	409
 #define S3_RESPONSE_CONDITION_FAILED	412
 
+/* The number of attempts to upload a part of the multipart upload */
+#define S3_MULTIPART_MAX_ATTEMPTS		3
+/* Sleep before the next attempt grows by this value (in microseconds) */
+#define S3_MULTIPART_RETRY_DELAY		100000L
+
 extern long s3_put_file(char *objectname, char *filename, bool ifNoneMatch);
 extern void s3_get_file(char *objectname, char *filename);
 extern void s3_put_empty_dir(char *objectname);
@@ -30,6 +35,8 @@ extern long s3_put_object_with_contents(char *objectname, Pointer data,
 extern long s3_get_object(char *objectname, StringInfo str, bool missing_ok);
 extern void s3_delete_object(char *objectname);
 
+extern Pointer read_file_part(const char *filename, uint64 offset,
+							  uint64 maxSize, uint64 *size);
 extern Pointer read_file(const char *filename, uint64 *size);
 
 #endif							/* __S3_REQUESTS_H__ */
@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * stats.h
+ *		Declarations for the statistics of S3 requests.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/s3/stats.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __S3_STATS_H__
+#define __S3_STATS_H__
+
+#include "utils/timestamp.h"
+
+typedef enum
+{
+	S3OperationGetPart = 0,
+	S3OperationGetFile,
+	S3OperationPutPart,
+	S3OperationPutFile,
+	S3OperationDelete
+} S3Operation;
+
+#define S3_OPERATIONS_NUM	(S3OperationDelete + 1)
+
+extern Size s3_stats_shmem_needs(void);
+extern void s3_stats_shmem_init(Pointer ptr, bool found);
+extern TimestampTz s3_stats_request_start(S3Operation op, char *objectname);
+extern void s3_stats_report_request(S3Operation op, uint64 bytes,
+									TimestampTz startTime, bool error);
+extern void s3_stats_report_retry(S3Operation op);
+extern void s3_stats_report_queue_wait(S3Operation op, TimestampTz queuedAt);
+
+#endif							/* __S3_STATS_H__ */
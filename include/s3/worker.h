@@ -17,6 +17,8 @@
 #include "orioledb.h"
 #include "s3/queue.h"
 
+#include "utils/timestamp.h"
+
 typedef enum
 {
 	S3TaskTypeWriteFile,
@@ -35,6 +37,7 @@ typedef enum
 typedef struct
 {
 	S3TaskType	type;
+	TimestampTz queuedAt;		/* for the queue wait statistics */
 	union
 	{
 		struct
@@ -77,9 +80,15 @@ typedef struct
 
 #define FILE_CHECKSUMS_FILENAME		ORIOLEDB_DATA_DIR "/file_checksums"
 
+/* Objects of the chunks of a big PostgreSQL file are put under this suffix */
+#define S3_FILE_CHUNKS_SUFFIX		".chunks"
+
 extern Size s3_workers_shmem_needs(void);
 extern void s3_workers_init_shmem(Pointer ptr, bool found);
 extern void register_s3worker(int num);
+extern void s3_workers_backup_start(uint32 chkpNum, uint64 filesTotal,
+									 uint64 bytesTotal);
+extern void s3_workers_backup_finish(void);
 extern void s3_workers_checkpoint_init(void);
 extern void s3_workers_checkpoint_finish(void);
 PGDLLEXPORT void s3worker_main(Datum);
@@ -93,7 +102,8 @@ extern S3TaskLocation s3_schedule_file_part_write(uint32 chkpNum, Oid datoid,
 												  int32 partNum);
 extern S3TaskLocation s3_schedule_file_part_read(uint32 chkpNum, Oid datoid,
 												 Oid relnode, int32 segNum,
-												 int32 partNum);
+												 int32 partNum,
+												 S3TaskPriority priority);
 extern S3TaskLocation s3_schedule_wal_file_write(char *filename);
 extern S3TaskLocation s3_schedule_undo_file_write(UndoLogType undoType,
 												  uint64 fileNum);
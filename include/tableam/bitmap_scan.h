@@ -18,9 +18,32 @@
 #include "tableam/handler.h"
 #include "tableam/scan.h"
 
-#include "lib/rbtree.h"
+#include "storage/condition_variable.h"
+#include "utils/dsa.h"
 
 typedef struct OBitmapScan OBitmapScan;
+typedef struct OKeyBitmap OKeyBitmap;
+
+typedef enum
+{
+	OParallelBitmapInitial,
+	OParallelBitmapInProgress,
+	OParallelBitmapFinished
+} OParallelBitmapStatus;
+
+/*
+ * Shared state of the parallel bitmap scan.  The first participant builds
+ * the key bitmap and publishes it serialized in the query DSA.  Then all the
+ * participants scan the primary tree in parallel using 'poscan'.
+ */
+typedef struct OParallelBitmapScanData
+{
+	slock_t		mutex;
+	OParallelBitmapStatus status;
+	ConditionVariable cv;
+	dsa_pointer bitmap;
+	ParallelOScanDescData poscan;
+} OParallelBitmapScanData;
 
 typedef struct OBitmapHeapPlanState
 {
@@ -34,6 +57,8 @@ typedef struct OBitmapHeapPlanState
 	MemoryContext cxt;
 	OBitmapScan *scan;
 	OEACallsCounters *eaCounters;
+	/* shared state of the parallel scan, NULL for the non-parallel one */
+	OParallelBitmapScanData *pstate;
 } OBitmapHeapPlanState;
 
 extern OBitmapScan *o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state,
@@ -44,15 +69,24 @@ extern OBitmapScan *o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state,
 extern TupleTableSlot *o_exec_bitmap_fetch(OBitmapScan *scan,
 										   CustomScanState *node);
 extern void o_free_bitmap_scan(OBitmapScan *scan);
+extern void o_parallel_bitmap_scan_initialize(OParallelBitmapScanData *pstate,
+											  Relation rel);
+extern void o_parallel_bitmap_scan_reinitialize(OParallelBitmapScanData *pstate,
+												Relation rel, dsa_area *dsa);
 
-extern RBTree *o_keybitmap_create(void);
-extern void o_keybitmap_insert(RBTree *rbtree, uint64 value);
-extern void o_keybitmap_intersect(RBTree *a, RBTree *b);
-extern void o_keybitmap_union(RBTree *a, RBTree *b);
-extern void o_keybitmap_free(RBTree *tree);
-extern bool o_keybitmap_is_empty(RBTree *rbtree);
-extern bool o_keybitmap_test(RBTree *rbtree, uint64 value);
-extern bool o_keybitmap_range_is_valid(RBTree *rbtree, uint64 low, uint64 high);
-extern uint64 o_keybitmap_get_next(RBTree *rbtree, uint64 prev, bool *found);
+extern OKeyBitmap *o_keybitmap_create(void);
+extern void o_keybitmap_insert(OKeyBitmap *bitmap, uint64 value);
+extern void o_keybitmap_intersect(OKeyBitmap *a, OKeyBitmap *b);
+extern void o_keybitmap_union(OKeyBitmap *a, OKeyBitmap *b);
+extern void o_keybitmap_free(OKeyBitmap *bitmap);
+extern bool o_keybitmap_is_empty(OKeyBitmap *bitmap);
+extern bool o_keybitmap_test(OKeyBitmap *bitmap, uint64 value);
+extern bool o_keybitmap_range_is_valid(OKeyBitmap *bitmap, uint64 low,
+									   uint64 high);
+extern uint64 o_keybitmap_get_next(OKeyBitmap *bitmap, uint64 prev,
+								   bool *found);
+extern Size o_keybitmap_serialized_size(OKeyBitmap *bitmap);
+extern void o_keybitmap_serialize(OKeyBitmap *bitmap, Pointer ptr);
+extern OKeyBitmap *o_keybitmap_attach(Pointer ptr);
 
 #endif							/* __TABLEAM_BITMAP_SCAN_H__ */
@@ -28,6 +28,8 @@
 #include "commands/explain.h"
 #include "executor/tuptable.h"
 #include "nodes/pathnodes.h"
+#include "utils/tuplesort.h"
+#include "utils/uuid.h"
 
 /* tableam/descr.c */
 
@@ -56,6 +58,61 @@ typedef struct
 typedef struct OComparator OComparator;
 typedef struct OComparatorKey OComparatorKey;
 
+struct OComparatorKey
+{
+	Oid			opfamily;
+	Oid			lefttype;
+	Oid			righttype;
+	Oid			collation;
+};
+
+/*
+ * The comparisons done inline by o_call_comparator() without calling the
+ * comparison function.
+ */
+typedef enum
+{
+	OComparatorGeneric,
+	/* ssup_datum_int32_cmp(): int4, date */
+	OComparatorInt32,
+	/* ssup_datum_signed_cmp(): int8, timestamp, timestamptz */
+	OComparatorInt64,
+	/* uuid_ops */
+	OComparatorUuid
+} OComparatorKind;
+
+/* btree/uuid_ops has no OID symbol in pg_opfamily.dat */
+#define O_UUID_BTREE_FAM_OID	(2968)
+
+struct OComparator
+{
+	OComparatorKey key;
+	OComparatorKind kind;
+	bool		haveSortSupport;
+
+	/* Filled when haveSortSupport == false */
+	FmgrInfo	finfo;
+
+	/* Filled when haveSortSupport == true */
+	MemoryContext ssup_cxt;
+	void	   *ssup_extra;
+	int			(*ssup_comparator) (Datum x, Datum y, SortSupport ssup);
+
+	/*
+	 * The opclass sort support function, which is called again to set up the
+	 * abbreviated keys for sorting.  InvalidOid if not found via opclass.
+	 */
+	Oid			ssupOid;
+	Oid			ssupDatoid;
+
+	/*
+	 * True if the values are varlenas ordered as memcmp() of their contents.
+	 * Then the first bytes of values give us the normalized prefix, which
+	 * defines the comparison result unless prefixes are equal.
+	 */
+	bool		prefixComparable;
+};
+
 /*
  * The index field descriptor
  */
@@ -114,6 +171,8 @@ struct OIndexDescr
 	/* Tuple descriptor and format specifier for leaf tuples */
 	TupleDesc	leafTupdesc;
 	OTupleFixedFormatSpec leafSpec;
+	/* Dense leaf attributes properties for o_tuple_deform_fields() */
+	ODeformAttr *leafDeform;
 
 	/*
 	 * Flag to indicate unique index and number of unique fields for unique
@@ -163,6 +222,15 @@ struct OIndexDescr
 	/* The maximal value in tableAttnums */
 	int			maxTableAttnum;
 
+	/*
+	 * Table attributes the secondary index tuple depends on, offset by
+	 * FirstLowInvalidHeapAttributeNumber.  keyAttrs covers the key fields,
+	 * the primary key, the expressions and the predicate.  includedAttrs
+	 * covers the rest of INCLUDE fields.
+	 */
+	Bitmapset  *keyAttrs;
+	Bitmapset  *includedAttrs;
+
 	/* Used in getsomeattrs to reorder fields during index only scan of pkey  */
 	AttrNumberMap *pk_tbl_field_map;
 
@@ -238,6 +306,13 @@ struct OTableDescr
 	int			nIndices;
 	/* number of unique trees */
 	int			nUniqueIndices;
+
+	/*
+	 * Indexed attributes modified by the last update and the rowid of the
+	 * row it was applied to.  See o_index_update_is_needed().
+	 */
+	Bitmapset  *updatedAttrs;
+	bytea	   *updatedRowid;
 };
 
 typedef struct
@@ -293,11 +368,38 @@ extern OComparator *o_find_comparator(Oid opfamily,
 									  Oid lefttype,
 									  Oid righttype,
 									  Oid collation);
-extern int	o_call_comparator(OComparator *comparator, Datum left,
-							  Datum right);
+extern int	o_call_comparator_generic(OComparator *comparator, Datum left,
+									  Datum right);
 extern void o_invalidate_comparator_cache(Oid opfamily, Oid lefttype,
 										  Oid righttype);
 
+static inline int
+o_call_comparator(OComparator *comparator, Datum left, Datum right)
+{
+	switch (comparator->kind)
+	{
+		case OComparatorInt32:
+			{
+				int32		l = DatumGetInt32(left),
+							r = DatumGetInt32(right);
+
+				return (l > r) - (l < r);
+			}
+		case OComparatorInt64:
+			{
+				int64		l = DatumGetInt64(left),
+							r = DatumGetInt64(right);
+
+				return (l > r) - (l < r);
+			}
+		case OComparatorUuid:
+			return memcmp(DatumGetPointer(left), DatumGetPointer(right),
+						  UUID_LEN);
+		default:
+			return o_call_comparator_generic(comparator, left, right);
+	}
+}
+
 extern EvictedTreeData *read_evicted_data(Oid datoid, Oid relnode, bool delete);
 extern void insert_evicted_data(EvictedTreeData *data);
 
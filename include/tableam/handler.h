@@ -24,6 +24,10 @@
 
 extern bool is_orioledb_rel(Relation rel);
 extern OIndexNumber find_tree_in_descr(OTableDescr *descr, ORelOids oids);
+extern int	orioledb_getnextslots(TableScanDesc sscan, ScanDirection direction,
+								  TupleTableSlot **slots, int nslots);
+extern void orioledb_scan_set_planstate(TableScanDesc sscan,
+										PlanState *planstate);
 
 /* EXPLAIN ANALYZE functions call counter */
 typedef struct
@@ -33,9 +37,19 @@ typedef struct
 	uint32		load;			/* load_page() */
 	uint32		lock;			/* lock_page() */
 	uint32		evict;			/* evict_page() */
+	/* shown with orioledb.explain_io_details */
+	uint32		diskRead;		/* page reads from the data files */
+	uint32		s3Read;			/* S3 parts loaded by the page reads */
+	uint32		undoImage;		/* get_page_from_undo() */
+	uint32		toastChunk;		/* fetched TOAST chunks */
+	uint32		visibility;		/* tuple visibility checks */
+	uint32		undoDiskRead;	/* undo disk reads by get_page_from_undo() */
+	instr_time	ioTime;			/* time blocked in the page reads */
 } OEACallsCounter;
 
 #define EA_COUNTERS_NUM (5)		/* number of EXPLAIN ANALYZE counters */
+#define EA_IO_COUNTERS_NUM (6)	/* number of orioledb.explain_io_details
+								 * counters */
 
 /*
  * EXPLAIN ANALYZE counters for different trees involved in single executor
@@ -54,6 +68,8 @@ typedef struct
 	OEACallsCounter toast;
 	/* Counters for indices of other tables */
 	OEACallsCounter others;
+	/* Measure the time of the page reads */
+	bool		timing;
 } OEACallsCounters;
 
 /*
@@ -62,11 +78,11 @@ typedef struct
  */
 extern OEACallsCounters *ea_counters;
 
-/* returns AnalyzeCallsCounter for specified index number */
+/* returns AnalyzeCallsCounter for specified tree */
 static inline OEACallsCounter *
-get_ea_counters(OrioleDBPageDesc *desc)
+get_ea_tree_counters(ORelOids oids)
 {
-	OIndexNumber ix_num = find_tree_in_descr(ea_counters->descr, desc->oids);
+	OIndexNumber ix_num = find_tree_in_descr(ea_counters->descr, oids);
 
 	if (ix_num == InvalidIndexNumber)
 		return &ea_counters->others;
@@ -75,6 +91,13 @@ get_ea_counters(OrioleDBPageDesc *desc)
 	return &ea_counters->indices[ix_num];
 }
 
+/* returns AnalyzeCallsCounter for specified index number */
+static inline OEACallsCounter *
+get_ea_counters(OrioleDBPageDesc *desc)
+{
+	return get_ea_tree_counters(desc->oids);
+}
+
 /* increases EXPLAIN_ANALYZE counter for o_btree_read_page() call */
 #define EA_READ_INC(blkno)  \
 	if (ea_counters != NULL)	\
@@ -125,10 +148,35 @@ get_ea_counters(OrioleDBPageDesc *desc)
 			ix_counter->evict++; \
 	}
 
+/* increases EXPLAIN_ANALYZE counter 'field' of the tree */
+#define EA_TREE_ADD(oids, field, value)  \
+	if (ea_counters != NULL)	\
+	{	\
+		OEACallsCounter *ix_counter = get_ea_tree_counters(oids); \
+		if (ix_counter != NULL) \
+			ix_counter->field += (value); \
+	}
+
+#define EA_TREE_INC(oids, field) EA_TREE_ADD(oids, field, 1)
+
+/* whether the page reads are timed for EXPLAIN ANALYZE */
+#define EA_IO_TIMING() (ea_counters != NULL && ea_counters->timing)
+
+/* accounts the time of the page read of the tree started at 'startTime' */
+#define EA_TREE_IO_TIME(oids, startTime)  \
+	if (EA_IO_TIMING())	\
+	{	\
+		OEACallsCounter *ix_counter = get_ea_tree_counters(oids); \
+		instr_time	endTime; \
+		INSTR_TIME_SET_CURRENT(endTime); \
+		INSTR_TIME_ACCUM_DIFF(ix_counter->ioTime, endTime, startTime); \
+	}
+
 extern void cleanup_btree(Oid datoid, Oid relnode, bool files, bool fsync);
 extern bool o_drop_shared_root_info(Oid datoid, Oid relnode);
 extern void o_tableam_descr_init(void);
 extern void o_invalidate_descrs(Oid datoid, Oid reloid, Oid relfilenode);
+extern void o_shed_descrs(void);
 extern void init_print_options(BTreePrintOptions *printOptions, VarChar *optionsArg);
 extern void orioledb_free_rd_amcache(Relation rel);
 extern OTableDescr *relation_get_descr(Relation rel);
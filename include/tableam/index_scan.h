@@ -18,12 +18,51 @@
 #include "tableam/scan.h"
 
 #include "access/sdir.h"
+#include "port/atomics.h"
+#include "storage/condition_variable.h"
+#include "storage/spin.h"
+#include "utils/dsa.h"
+
+typedef enum
+{
+	OParallelIndexInitial,
+	OParallelIndexInProgress,
+	OParallelIndexFinished
+} OParallelIndexStatus;
+
+/*
+ * Shared state of the parallel index scan.  The first participant collects
+ * the separator keys of the scan range from the internal pages and publishes
+ * them in the query DSA.  The separators split the range into the chunks,
+ * which the participants claim in the scan direction using 'nextChunk'.
+ */
+typedef struct OParallelIndexScanData
+{
+	slock_t		mutex;
+	OParallelIndexStatus status;
+	ConditionVariable cv;
+	pg_atomic_uint32 nextChunk;
+	int			nkeys;
+	dsa_pointer keys;
+} OParallelIndexScanData;
+
+typedef enum
+{
+	OParallelIndexNotStarted,
+	/* the scan isn't split, the participant claimed it whole */
+	OParallelIndexWhole,
+	/* the participant scans the chunks it claims */
+	OParallelIndexChunks,
+	OParallelIndexDone
+} OParallelIndexMode;
 
 typedef struct OScanState
 {
 	IndexScanDescData scandesc;
 	OIndexNumber ixNum;
 	MemoryContext cxt;
+	/* context of the fetched tuples, see o_scan_tuples_context_create() */
+	MemoryContext tupleCxt;
 	ScanDirection scanDir;
 	bool		addJunk;
 	/* is only current index can be used in scan */
@@ -34,10 +73,24 @@ typedef struct OScanState
 	bool		exact;
 	OBTreeKeyRange curKeyRange;
 	BTreeIterator *iterator;
+	/* keeps the descent path between exact lookups of array keys */
+	BTreeKeysLookup *keysLookup;
 	List	   *indexQuals;
 	/* used only by direct modify functions */
 	CmdType		cmd;
 	OSnapshot	oSnapshot;
+	/* shared state of the parallel scan, NULL for the non-parallel one */
+	OParallelIndexScanData *pscan;
+	dsa_area   *dsa;
+	OParallelIndexMode parallelMode;
+	/* separators of the parallel scan chunks and the current chunk */
+	OTuple	   *chunkKeys;
+	int			nChunkKeys;
+	int			curChunk;
+	/* skip scan over the values of the first key column */
+	bool		skipScan;
+	int			skipRejected;
+	OBTreeKeyBound skipBound;
 } OScanState;
 
 typedef struct OIndexPlanState
@@ -77,13 +130,19 @@ extern TupleTableSlot *o_exec_project(ProjectionInfo *projInfo,
 									  TupleTableSlot *innerTuple);
 
 /* explain analyze */
-extern void eanalyze_counters_init(OEACallsCounters *eacc, OTableDescr *descr);
+extern void eanalyze_counters_init(OEACallsCounters *eacc, OTableDescr *descr,
+								   bool timing);
 extern void eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 									 char *ix_name, ExplainState *es);
 extern void eanalyze_counters_explain(OTableDescr *descr,
 									  OEACallsCounters *counters,
 									  ExplainState *es);
 
+extern void o_parallel_index_scan_initialize(OParallelIndexScanData *pscan);
+extern void o_parallel_index_scan_reinitialize(OParallelIndexScanData *pscan,
+											   dsa_area *dsa);
+extern void o_parallel_index_scan_reset(OScanState *ostate);
+
 extern int	o_get_num_prefix_exact_keys(ScanKey scankey, int nscankeys);
 
 #endif							/* __TABLEAM_INDEX_SCAN_H__ */
@@ -89,6 +89,9 @@ typedef struct
 extern TupleTableSlot *o_tbl_insert(OTableDescr *descr, Relation relation,
 									TupleTableSlot *slot, OXid oxid,
 									CommitSeqNo csn);
+extern void o_tbl_multi_insert(OTableDescr *descr, Relation relation,
+							   TupleTableSlot **slots, int ntuples,
+							   OXid oxid, CommitSeqNo csn);
 extern TupleTableSlot *o_tbl_insert_with_arbiter(Relation rel,
 												 OTableDescr *descr,
 												 TupleTableSlot *slot,
@@ -115,6 +118,11 @@ extern OTableModifyResult o_tbl_update(OTableDescr *descr, TupleTableSlot *slot,
 									   BTreeLocationHint *hint,
 									   OModifyCallbackArg *arg,
 									   ItemPointer bridge_ctid);
+extern void o_set_updated_attrs(OTableDescr *descr, Relation rel,
+								Datum tupleid, TupleTableSlot *oldSlot,
+								TupleTableSlot *newSlot);
+extern bool o_index_update_is_needed(OTableDescr *descr, OIndexDescr *id,
+									 Datum oldTupleid);
 extern OTableModifyResult o_update_secondary_index(OIndexDescr *id,
 												   OIndexNumber ix_num,
 												   bool new_valid,
@@ -146,5 +154,8 @@ extern bool o_is_index_predicate_satisfied(OIndexDescr *idx,
 										   TupleTableSlot *slot,
 										   ExprContext *econtext);
 extern void o_truncate_table(ORelOids oids);
+extern bool o_apply_buffer_insert(Relation relation, TupleTableSlot *slot);
+extern void o_apply_flush_inserts(void);
+extern void o_apply_discard_inserts(void);
 
 #endif
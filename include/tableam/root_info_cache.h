@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * root_info_cache.h
+ *		Lock-free shared cache in front of the shared root info tree.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/tableam/root_info_cache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __ROOT_INFO_CACHE_H__
+#define __ROOT_INFO_CACHE_H__
+
+#include "btree/btree.h"
+#include "catalog/sys_trees.h"
+
+extern Size root_info_cache_shmem_needs(void);
+extern void root_info_cache_shmem_init(Pointer ptr, bool found);
+extern bool root_info_cache_lookup(SharedRootInfoKey *key,
+								   BTreeRootInfo *rootInfo);
+extern uint64 root_info_cache_get_generation(void);
+extern void root_info_cache_insert(SharedRootInfoKey *key,
+								   BTreeRootInfo *rootInfo,
+								   uint64 generation);
+extern void root_info_cache_invalidate(SharedRootInfoKey *key);
+
+#endif							/* __ROOT_INFO_CACHE_H__ */
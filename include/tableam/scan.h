@@ -16,6 +16,7 @@
 
 #include "postgres.h"
 
+#include "executor/executor.h"
 #include "nodes/extensible.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
@@ -34,6 +35,8 @@ typedef struct OPlanState
 } OPlanState;
 
 extern set_rel_pathlist_hook_type old_set_rel_pathlist_hook;
+extern ExecutorStart_hook_type prev_ExecutorStart_hook;
+extern create_upper_paths_hook_type prev_create_upper_paths_hook;
 
 extern void orioledb_set_rel_pathlist_hook(PlannerInfo *root, RelOptInfo *rel,
 										   Index rti, RangeTblEntry *rte);
@@ -41,6 +44,13 @@ extern bool orioledb_set_plain_rel_pathlist_hook(PlannerInfo *root,
 												 RelOptInfo *rel,
 												 RangeTblEntry *rte);
 
+extern void orioledb_executor_start_hook(QueryDesc *queryDesc, int eflags);
+extern void orioledb_create_upper_paths_hook(PlannerInfo *root,
+											 UpperRelationKind stage,
+											 RelOptInfo *input_rel,
+											 RelOptInfo *output_rel,
+											 void *extra);
+
 extern bool is_o_custom_scan(CustomScan *scan);
 extern bool is_o_custom_scan_state(CustomScanState *scan);
 
@@ -63,6 +63,9 @@ extern OSnapshot o_non_deleted_snapshot;
 		(o_snapshot)->xlogptr = (snapshot)->csnSnapshotData.xlogptr; \
 		(o_snapshot)->cid = (snapshot)->curcid; \
 		(o_snapshot)->cidUndoLocation = MaxUndoLocation; \
+		if (unlikely(as_of_enabled) && \
+			(snapshot)->snapshot_type == SNAPSHOT_MVCC) \
+			o_snapshot_apply_as_of(o_snapshot); \
 	} while (false)
 
 #define O_LOAD_SNAPSHOT_CSN(o_snapshot, csnValue) \
@@ -82,8 +85,11 @@ extern bool wait_for_oxid(OXid oxid);
 extern void oxid_notify(OXid oxid);
 extern void oxid_notify_all(void);
 extern void advance_oxids(OXid new_xid);
+extern void set_my_xmin(OXid xmin);
 extern OXid get_current_oxid(void);
 extern void assign_subtransaction_logical_xid(void);
+extern void release_subtransaction_logical_xid(void);
+extern void rollback_subtransaction_logical_xid(void);
 extern void set_oxid_csn(OXid oxid, CommitSeqNo csn);
 extern void set_oxid_xlog_ptr(OXid oxid, XLogRecPtr ptr);
 extern void set_current_oxid(OXid oxid);
@@ -101,6 +107,7 @@ extern XLogRecPtr oxid_get_xlog_ptr(OXid oxid);
 extern void oxid_match_snapshot(OXid oxid, OSnapshot *snapshot,
 								CommitSeqNo *outCsn, XLogRecPtr *outPtr);
 extern void fill_current_oxid_osnapshot(OXid *oxid, OSnapshot *snapshot);
+extern void o_snapshot_apply_as_of(OSnapshot *snapshot);
 extern int	oxid_get_procnum(OXid oxid);
 extern bool xid_is_finished(OXid xid);
 extern bool xid_is_finished_for_everybody(OXid xid);
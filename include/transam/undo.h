@@ -80,7 +80,10 @@ typedef struct
 	 * log buffer' free locations, ready to be obtained by backends.
 	 * advanceReservedLocation is the top value of all monotonically
 	 * increasing undo log buffer locations. advanceReservedLocation gets
-	 * increased in reserve_undo_size_extended() method only.
+	 * increased in reserve_undo_size_extended() method only.  Within a
+	 * transaction, backend reserves up to orioledb.undo_reserve_batch in
+	 * advance and carves the following reservations locally.  The unused
+	 * arena is returned at the transaction end.
 	 *
 	 * Pre-reservation must be performed well in advance before the actual
 	 * obtaining (reserving) of undo log locations, because of eviction
@@ -217,6 +220,18 @@ typedef struct
 	LWLock		undoWriteLock;
 
 	int			undoStackLocationsFlushLockTrancheId;
+
+	/* Cumulative statistics of the disk access, see pg_stat_orioledb_undo */
+	pg_atomic_uint64 evictedBytes;
+	pg_atomic_uint64 diskReads;
+	pg_atomic_uint64 diskReadBytes;
+
+	/*
+	 * The part of the circular buffer the undo log can use.  It's the whole
+	 * circular buffer unless orioledb.undo_adaptive_split is set, see
+	 * undo_balance_split().
+	 */
+	pg_atomic_uint64 circularCapacity;
 } UndoMeta;
 
 typedef struct
@@ -269,6 +284,8 @@ typedef struct
 	bool		needs_wal_flush;
 	bool		has_retained_undo_location[(int) UndoLogsCount];
 	bool		local_wal_has_material_changes;
+	bool		batched;
+	int			nestingLevel;
 	OXid		oxid;
 	TransactionId logicalXid;
 } OAutonomousTxState;
@@ -305,6 +322,8 @@ typedef enum
 extern bool oxid_needs_wal_flush;
 extern UndoLocation curRetainUndoLocations[(int) UndoLogsCount];
 extern PendingTruncatesMeta *pending_truncates_meta;
+extern uint64 undo_disk_reads;
+extern uint64 undo_disk_read_bytes;
 
 #define ORIOLEDB_UNDO_DATA_ROW_FILENAME_TEMPLATE (ORIOLEDB_UNDO_DIR "/%02X%08Xrow")
 #define ORIOLEDB_UNDO_DATA_PAGE_FILENAME_TEMPLATE (ORIOLEDB_UNDO_DIR "/%02X%08Xpage")
@@ -320,6 +339,7 @@ extern PendingTruncatesMeta *pending_truncates_meta;
 										&oProcData[MYPROCNUMBER].undoStackLocations[oProcData[MYPROCNUMBER].autonomousNestingLevel][(int) (undoType)])
 
 extern Size undo_shmem_needs(void);
+extern void undo_balance_split(void);
 extern void undo_shmem_init(Pointer buf, bool found);
 extern UndoMeta *get_undo_meta_by_type(UndoLogType undoType);
 
@@ -344,6 +364,7 @@ extern Pointer get_undo_record_unreserved(UndoLogType type,
 										  Size size);
 extern Size get_reserved_undo_size(UndoLogType undoType);
 extern void release_undo_size(UndoLogType undoType);
+extern void release_undo_arena(UndoLogType undoType);
 extern void release_reserved_undo_location(UndoLogType undoType);
 extern void add_new_undo_stack_item(UndoLogType undoType,
 									UndoLocation location);
@@ -372,6 +393,9 @@ extern void free_retained_undo_location(UndoLogType undoType);
 extern void start_autonomous_transaction(OAutonomousTxState *state);
 extern void abort_autonomous_transaction(OAutonomousTxState *state);
 extern void finish_autonomous_transaction(OAutonomousTxState *state);
+extern void start_batched_autonomous_transaction(OAutonomousTxState *state);
+extern void begin_autonomous_batch(void);
+extern void end_autonomous_batch(bool commit);
 extern void undo_read(UndoLogType undoType, UndoLocation location,
 					  Size size, Pointer buf);
 extern void undo_write(UndoLogType undoType, UndoLocation location,
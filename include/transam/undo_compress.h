@@ -0,0 +1,49 @@
+/*-------------------------------------------------------------------------
+ *
+ * undo_compress.h
+ *		Declarations for compression of the evicted undo log.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/transam/undo_compress.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __UNDO_COMPRESS_H__
+#define __UNDO_COMPRESS_H__
+
+#include "transam/undo.h"
+#include "utils/o_buffers.h"
+
+#define ORIOLEDB_UNDO_DATA_PAGE_INDEX_FILENAME_TEMPLATE (ORIOLEDB_UNDO_DIR "/%02X%08Xpage.zidx")
+
+/* The evicted undo is compressed by the chunks of this size */
+#define UNDO_COMPRESS_CHUNK_SIZE	(0x10000)
+#define UNDO_COMPRESS_CHUNKS_PER_FILE	(UNDO_FILE_SIZE / UNDO_COMPRESS_CHUNK_SIZE)
+
+/*
+ * The entry of the index file: zero for the chunk written as is, otherwise
+ * the codec and the size of the compressed chunk.
+ */
+#define UNDO_COMPRESS_ENTRY(codec, size) ((((uint32) (codec) + 1) << 24) | (uint32) (size))
+#define UNDO_COMPRESS_ENTRY_IS_RAW(entry) ((entry) == 0)
+#define UNDO_COMPRESS_ENTRY_CODEC(entry) ((uint8) (((entry) >> 24) - 1))
+#define UNDO_COMPRESS_ENTRY_SIZE(entry) ((entry) & 0xFFFFFF)
+
+extern bool undo_type_compressible(UndoLogType undoType);
+extern void undo_compress_write_range(OBuffersDesc *desc, Pointer buf,
+									  UndoLogType undoType,
+									  UndoLocation minLoc,
+									  UndoLocation maxLoc);
+extern void undo_compress_read_range(OBuffersDesc *desc, Pointer buf,
+									 UndoLogType undoType,
+									 UndoLocation minLoc,
+									 UndoLocation maxLoc);
+extern void undo_compress_sync(UndoLogType undoType, UndoLocation fromLoc,
+							   UndoLocation toLoc, uint32 wait_event_info);
+extern void undo_compress_unlink_files_range(UndoLogType undoType,
+											 int64 firstFileNumber,
+											 int64 lastFileNumber);
+
+#endif							/* __UNDO_COMPRESS_H__ */
@@ -44,6 +44,18 @@ typedef struct
 	uint16		len;
 } OTupleFixedFormatSpec;
 
+/*
+ * Attribute properties used by o_tuple_deform_fields().  They are copied from
+ * the tuple descriptor into a dense array once per index descriptor.
+ */
+typedef struct
+{
+	int32		cacheoff;		/* precomputed offset, or -1 */
+	int16		attlen;
+	char		attalign;
+	bool		attbyval;
+} ODeformAttr;
+
 typedef OTupleHeaderData *OTupleHeader;
 #define SizeOfOTupleHeader MAXALIGN(sizeof(OTupleHeaderData))
 
@@ -183,6 +195,12 @@ typedef struct BrigeData
 extern void o_tuple_init_reader(OTupleReaderState *state, OTuple tuple,
 								TupleDesc desc, OTupleFixedFormatSpec *spec);
 extern Datum o_tuple_read_next_field(OTupleReaderState *state, bool *isnull);
+extern ODeformAttr *o_tuple_make_deform_attrs(TupleDesc desc,
+											   MemoryContext mcxt);
+extern int	o_tuple_deform_fields(OTupleReaderState *state,
+								  ODeformAttr *attrs, int maxFields,
+								  Datum *values, bool *isnull,
+								  bool *hastoast);
 extern uint32 o_tuple_next_field_offset(OTupleReaderState *state,
 										Form_pg_attribute att);
 extern ItemPointer o_tuple_get_last_iptr(TupleDesc desc,
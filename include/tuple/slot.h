@@ -34,6 +34,8 @@ typedef struct OTableSlot
 	CommitSeqNo csn;
 	int			ixnum;
 	bool		leafTuple;
+	bool		tupleRef;		/* tuple points into the memory of the scan,
+								 * see tts_orioledb_store_tuple_ref() */
 	uint32		version;
 	OTupleReaderState state;
 	BTreeLocationHint hint;
@@ -51,6 +53,10 @@ extern void tts_orioledb_store_tuple(TupleTableSlot *slot, OTuple tuple,
 									 OTableDescr *descr, CommitSeqNo csn,
 									 int ixnum, bool shouldfree,
 									 BTreeLocationHint *hint);
+extern void tts_orioledb_store_tuple_ref(TupleTableSlot *slot, OTuple tuple,
+										 OTableDescr *descr, CommitSeqNo csn,
+										 int ixnum, BTreeLocationHint *hint);
+extern void tts_orioledb_own_tuple(TupleTableSlot *slot);
 extern void tts_orioledb_store_non_leaf_tuple(TupleTableSlot *slot,
 											  OTuple tuple,
 											  OTableDescr *descr,
@@ -87,6 +93,11 @@ extern bool tts_orioledb_update_toast_values(TupleTableSlot *oldSlot,
 extern bool tts_orioledb_modified(TupleTableSlot *oldSlot,
 								  TupleTableSlot *newSlot,
 								  Bitmapset *attrs);
+extern Bitmapset *tts_orioledb_modified_attrs(TupleTableSlot *oldSlot,
+											  TupleTableSlot *newSlot,
+											  Bitmapset *attrs);
 extern void tts_orioledb_set_ctid(TupleTableSlot *slot, ItemPointer iptr);
+extern MemoryContext o_scan_tuples_context_create(MemoryContext slotCxt);
+extern void o_scan_tuples_context_release(MemoryContext cxt);
 
 #endif							/* __TUPLE_SLOT_H__ */
@@ -117,6 +117,21 @@ extern bool generic_toast_delete_optional_wal(ToastAPI *api, void *key,
 extern Pointer generic_toast_get(ToastAPI *api, void *key, Size data_size,
 								 OSnapshot *snapshot, void *arg);
 
+/*
+ * Called for the consecutive parts of the TOAST value.  'offset' is the
+ * position of the part in the value.  Returning false stops the iteration.
+ */
+typedef bool (*ToastChunkCallback) (Pointer data, Size offset, Size length,
+									void *arg);
+
+/* Passes the chunks covering the part of the value to the callback */
+extern Size generic_toast_iterate_chunks(ToastAPI *api, void *key,
+										 Size data_size, Size offset,
+										 Size length, OSnapshot *snapshot,
+										 void *arg,
+										 ToastChunkCallback callback,
+										 void *callback_arg);
+
 /* Returns tuple and size of data if found, or NULL otherwise */
 extern Pointer generic_toast_get_any(ToastAPI *api, void *key,
 									 Size *data_size, OSnapshot *snapshot,
@@ -155,12 +170,22 @@ extern void o_toast_sort_add(OIndexDescr *primary, OIndexDescr *toast,
 							 OTuple pk, uint16 attn,
 							 Pointer data, Size data_size,
 							 Tuplesortstate *sortstate);
+extern bool o_toast_insert_copy(OIndexDescr *primary, OIndexDescr *toast,
+								OTuple pk, uint16 attn, struct varlena *src,
+								OXid oxid, CommitSeqNo csn,
+								Tuplesortstate *sortstate);
 extern bool o_toast_delete(OIndexDescr *primary, OIndexDescr *toast,
 						   OTuple pk, uint16 attn,
 						   OXid oxid, CommitSeqNo csn);
 extern Pointer o_toast_get(OIndexDescr *primary, OIndexDescr *toast,
 						   OTuple pk, uint16 attn, Size data_size,
 						   OSnapshot *snapshot);
+extern Size o_toast_iterate_chunks(OIndexDescr *primary, OIndexDescr *toast,
+								   OTuple pk, uint16 attn, Size data_size,
+								   Size offset, Size length,
+								   OSnapshot *snapshot,
+								   ToastChunkCallback callback,
+								   void *callback_arg);
 
 extern int	o_toast_cmp(BTreeDescr *desc, void *p1, BTreeKeyType k1,
 						void *p2, BTreeKeyType k2);
@@ -220,6 +245,9 @@ extern Datum o_get_raw_value(Datum value, bool *free);
 
 extern Datum o_get_src_value(Datum value, bool *free);
 
+/* compares the raw values of the same size */
+extern bool o_toast_raw_equal(Datum left, Datum right);
+
 /* returns true if left and right are equal orioledb TOAST values */
 extern bool o_toast_equal(BTreeDescr *primary, Datum left, Datum right);
 
@@ -0,0 +1,87 @@
+/*-------------------------------------------------------------------------
+ *
+ * assoc_cache.h
+ *		Set-associative shared caches of the extents and the undo images.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/assoc_cache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __ASSOC_CACHE_H__
+#define __ASSOC_CACHE_H__
+
+#include "btree/btree.h"
+
+#include "fmgr.h"
+#include "port/atomics.h"
+
+/* the number of the hit/miss/... counters of the cache */
+#define ASSOC_CACHE_MAX_COUNTERS	(4)
+
+/* the key of the slots caching the data file extents */
+typedef struct
+{
+	Oid			datoid;
+	Oid			relnode;
+	uint64		off;
+} AssocCacheKey;
+
+typedef struct
+{
+	int			trancheId;
+	uint64		nbuckets;
+	pg_atomic_uint64 usedSlots;
+	pg_atomic_uint64 counters[ASSOC_CACHE_MAX_COUNTERS];
+} AssocCacheMeta;
+
+typedef bool (*AssocCacheSlotIsEmpty) (Pointer slot);
+typedef void (*AssocCacheSlotClear) (Pointer slot);
+
+/*
+ * The layout of the cache.  Each bucket starts with the LWLock followed by
+ * the array of 'ways' slots at 'slotsOffset'.  Each slot has the usage
+ * counter at 'usageOffset' and the extent slot has the AssocCacheKey at
+ * 'keyOffset'.
+ */
+typedef struct
+{
+	Size		bucketSize;
+	Size		slotsOffset;
+	Size		slotSize;
+	int			ways;
+	Size		keyOffset;
+	Size		usageOffset;
+	AssocCacheSlotIsEmpty isEmpty;
+	AssocCacheSlotClear clear;
+	/* set by assoc_cache_shmem_init() */
+	AssocCacheMeta *meta;
+	Pointer		buckets;
+} AssocCache;
+
+#define ASSOC_CACHE_BUCKET_LOCK(bucket) ((LWLock *) (bucket))
+
+extern Size assoc_cache_shmem_needs(AssocCache *cache, Size size);
+extern void assoc_cache_shmem_init(AssocCache *cache, Pointer ptr, bool found,
+								   Size size, const char *trancheName);
+extern bool assoc_cache_enabled(AssocCache *cache, BTreeDescr *desc);
+extern Pointer assoc_cache_bucket(AssocCache *cache, uint32 hash);
+extern Pointer assoc_cache_extent_bucket(AssocCache *cache, BTreeDescr *desc,
+										 uint64 off);
+extern Pointer assoc_cache_find(AssocCache *cache, Pointer bucket,
+								BTreeDescr *desc, uint64 off);
+extern int	assoc_cache_pick_victim(Pointer slots, Size slotSize, int ways,
+									Size usageOffset,
+									AssocCacheSlotIsEmpty isEmpty,
+									bool *wasEmpty);
+extern Pointer assoc_cache_replace(AssocCache *cache, Pointer bucket);
+extern void assoc_cache_invalidate(AssocCache *cache, BTreeDescr *desc,
+								   uint64 off);
+extern void assoc_cache_invalidate_relnode(AssocCache *cache, Oid datoid,
+										   Oid relnode);
+extern Datum assoc_cache_stats(AssocCache *cache, FunctionCallInfo fcinfo,
+							   int ncounters);
+
+#endif							/* __ASSOC_CACHE_H__ */
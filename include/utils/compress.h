@@ -14,10 +14,39 @@
 #ifndef __COMPRESS_H__
 #define __COMPRESS_H__
 
+#include "btree/btree.h"
+
+/* Values of BTreeMetaPage.compressDictId, reserved by zstd for dictionary ids */
+#define O_COMPRESS_DICT_UNKNOWN	(0)
+#define O_COMPRESS_DICT_NONE	(1)
+
+/*
+ * Values of BTreeMetaPage.compressAuto.  Otherwise, it's the selected level
+ * plus O_COMPRESS_AUTO_SHIFT, so InvalidOCompress means no compression.
+ */
+#define O_COMPRESS_AUTO_UNKNOWN	(0)
+#define O_COMPRESS_AUTO_SHIFT	(2)
+
 extern void o_compress_init(void);
 extern Pointer o_compress_page(Pointer page, size_t *size, OCompress lvl);
 extern void o_decompress_page(Pointer src, size_t size, Pointer page);
+extern size_t o_compress_buffer(Pointer src, size_t srcSize, Pointer dst,
+								size_t dstSize, OCompress lvl);
+extern void o_decompress_buffer(uint8 codec, Pointer src, size_t srcSize,
+								Pointer dst, size_t dstSize);
+extern uint32 o_compress_tree_dict_id(BTreeDescr *desc);
+extern OCompress o_compress_tree_level(BTreeDescr *desc);
+extern Pointer o_compress_tree_page(BTreeDescr *desc, Pointer page,
+									size_t *size, OCompress lvl);
+extern void o_decompress_tree_page(BTreeDescr *desc, uint8 codec, Pointer src,
+								   size_t size, Pointer page);
+extern void o_compress_start_sampling(BTreeDescr *desc);
+extern void o_compress_sample_page(BTreeDescr *desc, Pointer page);
+extern void o_compress_finish_sampling(BTreeDescr *desc, bool train);
 extern OCompress o_compress_max_lvl(void);
 extern void validate_compress(OCompress compress, char *prefix);
+extern OCompress o_compress_default_codec(OCompress compress);
+extern char *o_compress_to_cstring(OCompress compress);
+extern char *o_compress_to_option(OCompress compress);
 
 #endif							/* __COMPRESS_H__ */
@@ -0,0 +1,25 @@
+/*-------------------------------------------------------------------------
+ *
+ * compressed_cache.h
+ *		Shared cache of compressed images of evicted BTree pages.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/compressed_cache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __COMPRESSED_CACHE_H__
+#define __COMPRESSED_CACHE_H__
+
+#include "btree/btree.h"
+
+extern Size compressed_cache_shmem_needs(void);
+extern void compressed_cache_shmem_init(Pointer ptr, bool found);
+extern void compressed_cache_put(BTreeDescr *desc, uint64 off, Page page);
+extern bool compressed_cache_get(BTreeDescr *desc, uint64 off, Pointer img);
+extern void compressed_cache_invalidate(BTreeDescr *desc, uint64 off);
+extern void compressed_cache_invalidate_relnode(Oid datoid, Oid relnode);
+
+#endif							/* __COMPRESSED_CACHE_H__ */
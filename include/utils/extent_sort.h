@@ -0,0 +1,22 @@
+/*-------------------------------------------------------------------------
+ *
+ * extent_sort.h
+ *		Declarations for sorting of the free extents lists.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/extent_sort.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __EXTENT_SORT_H__
+#define __EXTENT_SORT_H__
+
+#include "storage/fd.h"
+
+extern void sort_free_extents(Pointer items, uint64 count, bool extents);
+extern void sort_free_extents_file(File file, const char *filename,
+								   off_t start, uint64 count, bool extents);
+
+#endif							/* __EXTENT_SORT_H__ */
@@ -0,0 +1,38 @@
+/*-------------------------------------------------------------------------
+ *
+ * o_memory.h
+ *		Declarations for the accounting of OrioleDB backend-local memory.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/o_memory.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __O_MEMORY_H__
+#define __O_MEMORY_H__
+
+/* Long-living memory contexts of the OrioleDB subsystems */
+typedef enum
+{
+	OMemoryDescriptors = 0,
+	OMemorySysCaches,
+	OMemoryBTree,
+	OMemoryCheckpoint
+} OMemorySubsystem;
+
+#define O_MEMORY_SUBSYSTEMS_NUM	(OMemoryCheckpoint + 1)
+
+/* The parent of all the long-living OrioleDB memory contexts */
+extern MemoryContext OrioleDBTopMemoryContext;
+
+extern void o_memory_init(void);
+extern void o_memory_register(OMemorySubsystem subsystem,
+							  MemoryContext context);
+extern Size o_memory_shmem_needs(void);
+extern void o_memory_shmem_init(Pointer ptr, bool found);
+extern void o_memory_report(void);
+extern void o_memory_xact_end(void);
+
+#endif							/* __O_MEMORY_H__ */
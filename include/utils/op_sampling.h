@@ -0,0 +1,84 @@
+/*-------------------------------------------------------------------------
+ *
+ * op_sampling.h
+ *		Declarations for the sampling profiler of OrioleDB operations.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/op_sampling.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __OP_SAMPLING_H__
+#define __OP_SAMPLING_H__
+
+#include "storage/proc.h"
+
+typedef enum
+{
+	OpSamplingNone = 0,
+	OpSamplingDescent,
+	OpSamplingPageLock,
+	OpSamplingUndoReserve,
+	OpSamplingIORead,
+	OpSamplingIOWrite,
+	OpSamplingCompress,
+	OpSamplingDecompress,
+	OpSamplingVisibility
+} OpSamplingOp;
+
+#define OP_SAMPLING_OPS_NUM	(OpSamplingVisibility + 1)
+
+/* The operation currently performed by the process */
+typedef struct
+{
+	uint32		op;
+	ORelOids	oids;
+} OpSamplingProcState;
+
+extern OpSamplingProcState *opSamplingProcs;
+
+extern Size op_sampling_shmem_needs(void);
+extern void op_sampling_shmem_init(Pointer ptr, bool found);
+extern void op_sampling_collect(void);
+
+/*
+ * Marks the start of the operation over the tree.  Returns the previous
+ * state to be restored by op_sampling_end(), so the operations may nest.
+ *
+ * The sampler reads the state without any locking, so it might rarely see
+ * the operation of the previous tree.  That's fine for the statistical
+ * profile.
+ */
+static inline OpSamplingProcState
+op_sampling_begin(OpSamplingOp op, ORelOids oids)
+{
+	OpSamplingProcState saved = {OpSamplingNone};
+	volatile OpSamplingProcState *state;
+
+	if (opSamplingProcs == NULL || MyProc == NULL)
+		return saved;
+
+	state = &opSamplingProcs[MYPROCNUMBER];
+	saved.op = state->op;
+	saved.oids = state->oids;
+	state->oids = oids;
+	state->op = op;
+	return saved;
+}
+
+static inline void
+op_sampling_end(OpSamplingProcState saved)
+{
+	volatile OpSamplingProcState *state;
+
+	if (opSamplingProcs == NULL || MyProc == NULL)
+		return;
+
+	state = &opSamplingProcs[MYPROCNUMBER];
+	state->op = saved.op;
+	state->oids = saved.oids;
+}
+
+#endif							/* __OP_SAMPLING_H__ */
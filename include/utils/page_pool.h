@@ -15,6 +15,7 @@
 #define __PAGE_POOL_H__
 
 #include "common/pg_prng.h"
+#include "storage/lwlock.h"
 #include "utils/ucm.h"
 
 /*
@@ -22,6 +23,24 @@
  */
 #define PPOOL_MIN_SIZE			(1024)
 #define PPOOL_MIN_SIZE_BLCKS	(PPOOL_MIN_SIZE * ORIOLEDB_BLCKSZ / BLCKSZ)
+
+/*
+ * With orioledb.balance_pools, the free tree and catalog pools can grow up to
+ * PPOOL_BALANCE_GROW_FACTOR times their configured size by borrowing the
+ * pages of the main pool, while main pool lends at most
+ * PPOOL_BALANCE_MAIN_LEND_PERCENT of its size.
+ */
+#define PPOOL_BALANCE_GROW_FACTOR		4
+#define PPOOL_BALANCE_MAIN_LEND_PERCENT	25
+/* maximal value of orioledb.page_pool_numa_nodes */
+#define PPOOL_MAX_NUMA_NODES	64
+/* maximal number of free pages cached by a backend */
+#define PPOOL_MAGAZINE_SIZE		16
+/* numbers of page pool owner buckets for the quotas */
+#define PPOOL_QUOTA_DATABASE_BUCKETS	256
+#define PPOOL_QUOTA_TREE_BUCKETS		4096
+/* maximal number of clock candidates spared for the owners within quota */
+#define PPOOL_QUOTA_MAX_SKIPS			16
 #define PPOOL_RESERVE_META 0
 #define PPOOL_RESERVE_INSERT	1
 #define PPOOL_RESERVE_FIND	2
@@ -37,20 +56,106 @@
 #define PPOOL_RESERVE_MASK_ALL (PPOOL_RESERVE_META_MASK | PPOOL_RESERVE_INSERT_MASK \
 								| PPOOL_RESERVE_FIND_MASK | PPOOL_RESERVE_SHARED_INFO_INSERT_MASK)
 
+/* reasons to reject the eviction candidate, see walk_page() */
+typedef enum
+{
+	/* the page is free or its tree isn't visible */
+	PPoolRejectNoTree = 0,
+	/* non-leaf page with in-memory children */
+	PPoolRejectChildren,
+	/* the page or its parent is locked, or the page is being split */
+	PPoolRejectLocked,
+	/* the page can't be written during the checkpoint of its tree now */
+	PPoolRejectCheckpoint,
+	/* the root page, evicted only with the whole tree */
+	PPoolRejectRoot
+} PPoolRejectReason;
+
+#define PPOOL_REJECT_REASONS_NUM	(PPoolRejectRoot + 1)
+
+/* eviction statistics of the pool, see orioledb_eviction_stats() */
+typedef struct
+{
+	/* reservations which had to evict pages themselves */
+	pg_atomic_uint64 stalls;
+	/* total duration of these reservations in microseconds */
+	pg_atomic_uint64 stallTime;
+	/* clock runs with eviction made by background writers */
+	pg_atomic_uint64 bgwriterEvictions;
+	/* background writers wakeups requested by the backends */
+	pg_atomic_uint64 bgwriterWakeups;
+	/* clock runs by backends and candidates examined by all the runs */
+	pg_atomic_uint64 backendClockRuns;
+	pg_atomic_uint64 clockSteps;
+	/* eviction candidates rejected by the reason */
+	pg_atomic_uint64 rejected[PPOOL_REJECT_REASONS_NUM];
+	/* evicted pages, which were clean and which had to be written first */
+	pg_atomic_uint64 evictedClean;
+	pg_atomic_uint64 evictedDirty;
+} OPagePoolStats;
+
+/*
+ * Online resizing of the pool, see ppool_resize().  The pages past the
+ * current size are retired: they are neither free nor evictable, and the
+ * memory of their contents is returned to the OS.
+ */
+typedef struct
+{
+	LWLock		lock;
+	int			lockTrancheId;
+	/* number of the pages in use, starting from the pool offset */
+	pg_atomic_uint64 size;
+	/* pages past the size, which are already retired */
+	pg_atomic_uint64 retiredPages;
+	/*
+	 * the configured size or the one set by the last ppool_resize(), and the
+	 * size the pool can't be shrunk below
+	 */
+	OInMemoryBlkno baseSize;
+	OInMemoryBlkno minSize;
+} OPagePoolResize;
+
+/*
+ * Counts of the pool pages occupied by databases and trees.  Owners are
+ * hashed into buckets, so a count might include the pages of colliding
+ * owners.  That's acceptable for the soft quotas.
+ */
+typedef struct
+{
+	/* number of buckets over their quota */
+	pg_atomic_uint32 overQuotaCount;
+	pg_atomic_uint32 databasePages[PPOOL_QUOTA_DATABASE_BUCKETS];
+	pg_atomic_uint32 treePages[PPOOL_QUOTA_TREE_BUCKETS];
+} OPagePoolOwners;
+
 struct OPagePool
 {
 	/* count of available to reserve pages in the pool */
 	pg_atomic_uint64 *availablePagesCount;
 	/* count of dirty pages in the pool */
 	pg_atomic_uint32 *dirtyPagesCount;
+	/* eviction statistics */
+	OPagePoolStats *stats;
+	/* pages occupied by databases and trees */
+	OPagePoolOwners *owners;
+	/* online resizing state */
+	OPagePoolResize *resize;
 	/* init position for the ucm */
 	OInMemoryBlkno location;
+	/* start position of the free pages search, local to our NUMA node */
+	OInMemoryBlkno allocLocation;
 	/* offset of the pool in the o_shared_buffers */
 	OInMemoryBlkno offset;
 	/* size of the pool */
 	OInMemoryBlkno size;
 	/* reserved pages count by type array */
 	OInMemoryBlkno numPagesReserved[PPOOL_RESERVE_COUNT];
+	/* pages reserved in advance, but not assigned to any kind yet */
+	OInMemoryBlkno numPagesSpare;
+	/* free pages occupied in advance for reserved and spare pages */
+	int			magazineSize;
+	int			magazineCount;
+	OInMemoryBlkno magazine[PPOOL_MAGAZINE_SIZE];
 	/* usage counter map and their size in shared memory */
 	UsageCountMap ucm;
 	Size		ucmShmemSize;
@@ -60,9 +165,26 @@ struct OPagePool
 
 extern Size ppool_estimate_space(OPagePool *pool, OInMemoryBlkno offset, OInMemoryBlkno size, bool debug);
 extern void ppool_shmem_init(OPagePool *pool, Pointer ptr, bool found);
+extern void ppool_init_size(OPagePool *pool, OInMemoryBlkno size,
+							OInMemoryBlkno minSize);
+extern OInMemoryBlkno ppool_size(OPagePool *pool);
+extern OInMemoryBlkno ppool_retire_pending(OPagePool *pool);
+extern OInMemoryBlkno ppool_resize(OPagePool *pool, OInMemoryBlkno size,
+								   bool wait);
+extern void ppool_retire_pass(OPagePool *pool, int maxClockRuns,
+							  OInMemoryBlkno *cursor);
+extern void ppool_retire_free_pages(OPagePool *pool, int maxPages);
+extern void ppool_balance_pools(void);
 extern OInMemoryBlkno ppool_free_pages_count(OPagePool *pool);
 extern OInMemoryBlkno ppool_dirty_pages_count(OPagePool *pool);
+extern OInMemoryBlkno ppool_free_pages_low_mark(OPagePool *pool);
+extern OInMemoryBlkno ppool_free_pages_high_mark(OPagePool *pool);
 extern void ppool_run_clock(OPagePool *pool, bool evict, volatile sig_atomic_t *shutdown_requested);
+extern void ppool_run_clock_region(OPagePool *pool, bool evict,
+								   volatile sig_atomic_t *shutdown_requested,
+								   OInMemoryBlkno regionStart,
+								   OInMemoryBlkno regionEnd,
+								   OInMemoryBlkno *cursor);
 
 extern void ppool_reserve_pages(OPagePool *pool, int kind, int count);
 extern void ppool_release_reserved(OPagePool *pool, uint32 mask);
@@ -70,6 +192,10 @@ extern void ppool_release_all_pages(void);
 extern OInMemoryBlkno ppool_get_metapage(OPagePool *pool);
 extern OInMemoryBlkno ppool_get_page(OPagePool *pool, int kind);
 extern void ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock);
+extern void ppool_page_set_owner(OPagePool *pool, OInMemoryBlkno blkno,
+								 ORelOids oids);
+extern bool ppool_owner_over_quota(OPagePool *pool, ORelOids oids);
+extern uint32 ppool_loaded_page_usage_count(OPagePool *pool, ORelOids oids);
 
 #define PAGE_DESC_FLAG_DIRTY			1	/* Modified since the the last
 											 * time being written out */
@@ -77,6 +203,8 @@ extern void ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock
 											 * detect changes concurrent to
 											 * write operatorions */
 #define PAGE_DESC_FLAG_BOTH_DIRTY		(PAGE_DESC_FLAG_DIRTY | PAGE_DESC_FLAG_CONCURRENT_DIRTY)
+#define PAGE_DESC_FLAG_RETIRED			4	/* Out of the current pool size,
+											 * see ppool_resize() */
 #define IS_DIRTY(blkno) (O_GET_IN_MEMORY_PAGEDESC(blkno)->flags & PAGE_DESC_FLAG_DIRTY)
 #define IS_DIRTY_CONCURRENT(blkno) (O_GET_IN_MEMORY_PAGEDESC(blkno)->flags & PAGE_DESC_FLAG_CONCURRENT_DIRTY)
 #define CLEAN_DIRTY_CONCURRENT(blkno) (O_GET_IN_MEMORY_PAGEDESC(blkno)->flags &= ~PAGE_DESC_FLAG_CONCURRENT_DIRTY)
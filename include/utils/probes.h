@@ -0,0 +1,45 @@
+/*-------------------------------------------------------------------------
+ *
+ * probes.h
+ *		Static tracepoints (USDT) of OrioleDB.
+ *
+ * The tracepoints are compiled in only when building with USE_USDT=1, which
+ * requires <sys/sdt.h> (systemtap-sdt-dev).  The compiled-in tracepoint is
+ * a single nop instruction until a tracer like bpftrace attaches to it,
+ * otherwise the macros expand to nothing.  The provider name is "orioledb":
+ *
+ *   bpftrace -e 'usdt:orioledb.so:orioledb:load_page__start { ... }'
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/probes.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+#ifdef USE_USDT
+
+#include <sys/sdt.h>
+
+#define ORIOLEDB_PROBE1(name, a1) \
+	DTRACE_PROBE1(orioledb, name, a1)
+#define ORIOLEDB_PROBE2(name, a1, a2) \
+	DTRACE_PROBE2(orioledb, name, a1, a2)
+#define ORIOLEDB_PROBE3(name, a1, a2, a3) \
+	DTRACE_PROBE3(orioledb, name, a1, a2, a3)
+#define ORIOLEDB_PROBE4(name, a1, a2, a3, a4) \
+	DTRACE_PROBE4(orioledb, name, a1, a2, a3, a4)
+
+#else
+
+#define ORIOLEDB_PROBE1(name, a1) ((void) 0)
+#define ORIOLEDB_PROBE2(name, a1, a2) ((void) 0)
+#define ORIOLEDB_PROBE3(name, a1, a2, a3) ((void) 0)
+#define ORIOLEDB_PROBE4(name, a1, a2, a3, a4) ((void) 0)
+
+#endif							/* USE_USDT */
+
+#endif							/* __PROBES_H__ */
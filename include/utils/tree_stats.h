@@ -0,0 +1,75 @@
+/*-------------------------------------------------------------------------
+ *
+ * tree_stats.h
+ *		Declarations for the cumulative cache and I/O statistics of trees.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/tree_stats.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __TREE_STATS_H__
+#define __TREE_STATS_H__
+
+#include "portability/instr_time.h"
+
+typedef enum
+{
+	TreeStatHits = 0,
+	TreeStatMisses,
+	TreeStatDiskLoads,
+	TreeStatS3Loads,
+	TreeStatEvictions,
+	TreeStatWrites,
+	TreeStatSplits,
+	TreeStatMerges,
+	TreeStatCompressBytesIn,
+	TreeStatCompressBytesOut,
+	/* microseconds */
+	TreeStatLoadTime,
+	TreeStatWriteTime
+} TreeStat;
+
+#define TREE_STATS_NUM	(TreeStatWriteTime + 1)
+
+typedef enum
+{
+	PageWaitLock = 0,
+	PageWaitReadBlock,
+	PageWaitSplit,
+	PageWaitIO
+} PageWaitKind;
+
+#define PAGE_WAIT_KINDS_NUM	(PageWaitIO + 1)
+
+typedef enum
+{
+	PageWaitLevelLeaf = 0,
+	PageWaitLevelInternal,
+	PageWaitLevelRoot
+} PageWaitLevel;
+
+#define PAGE_WAIT_LEVELS_NUM	(PageWaitLevelRoot + 1)
+
+extern Size tree_stats_shmem_needs(void);
+extern void tree_stats_shmem_init(Pointer ptr, bool found);
+extern void tree_stats_add(ORelOids oids, TreeStat stat, uint64 value);
+extern void tree_stats_add_time(ORelOids oids, TreeStat stat,
+								instr_time startTime);
+extern void tree_stats_flush(void);
+extern bool tree_stats_page_wait_sample(instr_time *startTime);
+extern void tree_stats_report_page_wait(ORelOids oids, PageWaitKind kind,
+										PageWaitLevel level,
+										instr_time startTime);
+
+#define tree_stats_enabled() (tree_stats_max > 0)
+
+#define tree_stats_count(oids, stat) \
+	do { \
+		if (tree_stats_enabled()) \
+			tree_stats_add((oids), (stat), 1); \
+	} while (0)
+
+#endif							/* __TREE_STATS_H__ */
@@ -24,6 +24,8 @@
 typedef struct UsageCountMap
 {
 	pg_atomic_uint32 *epoch;
+	/* number of epoch shifts, lives in the cache line of the epoch */
+	pg_atomic_uint64 *epochShifts;
 	pg_atomic_uint32 *ucm;
 	OInMemoryBlkno offset;
 	OInMemoryBlkno size;
@@ -41,10 +43,16 @@ extern void page_change_usage_count(UsageCountMap *map, OInMemoryBlkno blkno, ui
 extern bool ucm_check_map(UsageCountMap *map);
 extern bool ucm_epoch_needs_shift(UsageCountMap *map);
 extern void ucm_epoch_shift(UsageCountMap *map);
+extern void ucm_level_pages(UsageCountMap *map, uint64 pages[UCM_LEVELS]);
 extern OInMemoryBlkno ucm_next_blkno(UsageCountMap *map, OInMemoryBlkno init_blkno, uint32 mask_src);
-extern OInMemoryBlkno ucm_occupy_free_page(UsageCountMap *map);
+extern OInMemoryBlkno ucm_occupy_free_page(UsageCountMap *map,
+											 OInMemoryBlkno init_blkno);
+extern bool ucm_try_occupy_page(UsageCountMap *map, OInMemoryBlkno blkno);
 extern void set_skip_ucm(void);
 extern void unset_skip_ucm(void);
+extern void set_ucm_scan_access(void);
+extern void unset_ucm_scan_access(void);
+extern uint32 ucm_loaded_page_usage_count(UsageCountMap *map);
 
 static inline uint64
 ucm_update_state(UsageCountMap *map, OInMemoryBlkno blkno, uint64 state)
@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------
+ *
+ * undo_page_cache.h
+ *		Shared cache of historical page images reconstructed from undo.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/undo_page_cache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __UNDO_PAGE_CACHE_H__
+#define __UNDO_PAGE_CACHE_H__
+
+#include "btree/btree.h"
+
+extern Size undo_page_cache_shmem_needs(void);
+extern void undo_page_cache_shmem_init(Pointer ptr, bool found);
+extern bool undo_page_cache_get(BTreeDescr *desc, UndoLocation startLocation,
+								CommitSeqNo csn, Page img,
+								UndoLocation *imageLocation);
+extern void undo_page_cache_put(BTreeDescr *desc, UndoLocation startLocation,
+								CommitSeqNo csnLow, CommitSeqNo csnHigh,
+								Page img, UndoLocation imageLocation);
+
+#endif							/* __UNDO_PAGE_CACHE_H__ */
@@ -0,0 +1,35 @@
+/*-------------------------------------------------------------------------
+ *
+ * zone_map.h
+ *		Shared cache of the column summaries of the on-disk leaf pages.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/utils/zone_map.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __ZONE_MAP_H__
+#define __ZONE_MAP_H__
+
+#include "btree/btree.h"
+#include "tuple/format.h"
+
+#include "access/skey.h"
+
+extern Size zone_map_shmem_needs(void);
+extern void zone_map_shmem_init(Pointer ptr, bool found);
+extern bool zone_map_enabled(BTreeDescr *desc);
+extern bool zone_map_leaf_may_match(BTreeDescr *desc, uint64 downlink,
+									CommitSeqNo csn, TupleDesc tupdesc,
+									int nkeys, ScanKey keys,
+									AttrNumber *attnums);
+extern void zone_map_summarize_leaf(BTreeDescr *desc, uint64 downlink,
+									Page img, TupleDesc tupdesc,
+									OTupleFixedFormatSpec *spec,
+									int nkeys, AttrNumber *attnums);
+extern void zone_map_invalidate(BTreeDescr *desc, uint64 off);
+extern void zone_map_invalidate_relnode(Oid datoid, Oid relnode);
+
+#endif							/* __ZONE_MAP_H__ */
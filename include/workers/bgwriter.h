@@ -16,7 +16,10 @@
 
 extern bool IsBGWriter;
 
-extern void register_bgwriter(void);
+extern Size bgwriter_shmem_needs(void);
+extern void bgwriter_shmem_init(Pointer ptr, bool found);
+extern bool bgwriter_wakeup(void);
+extern void register_bgwriter(int num);
 PGDLLEXPORT void bgwriter_main(Datum);
 
 #endif							/* __BGWRITER_H__ */
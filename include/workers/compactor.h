@@ -0,0 +1,26 @@
+/*-------------------------------------------------------------------------
+ *
+ * compactor.h
+ *		Routines for background data file compaction worker.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/compactor.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __COMPACTOR_H__
+#define __COMPACTOR_H__
+
+#include "btree/btree.h"
+
+extern bool IsCompactionWorker;
+
+extern Size compaction_shmem_needs(void);
+extern void compaction_shmem_init(Pointer ptr, bool found);
+extern void compaction_checkpoint_begin(BTreeDescr *desc, uint32 chkpNum);
+extern void register_compaction_worker(void);
+PGDLLEXPORT void compaction_worker_main(Datum);
+
+#endif							/* __COMPACTOR_H__ */
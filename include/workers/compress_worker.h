@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------
+ *
+ * compress_worker.h
+ *		Routines for background page compression workers.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/compress_worker.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __COMPRESS_WORKER_H__
+#define __COMPRESS_WORKER_H__
+
+#include "btree/btree.h"
+
+extern bool IsCompressWorker;
+
+extern Size compress_workers_shmem_needs(void);
+extern void compress_workers_shmem_init(Pointer ptr, bool found);
+extern void compress_workers_precompress_leaves(BTreeDescr *desc, Page parent,
+												BTreePageItemLocator *loc,
+												uint32 chkpNum);
+extern Pointer compress_workers_get_result(BTreeDescr *desc, Page page,
+										   Pointer dst, size_t *size);
+extern void compress_workers_release_all(void);
+extern void register_compress_worker(int num);
+PGDLLEXPORT void compress_worker_main(Datum);
+
+#endif							/* __COMPRESS_WORKER_H__ */
@@ -0,0 +1,23 @@
+/*-------------------------------------------------------------------------
+ *
+ * merger.h
+ *		Routines for background page merge worker.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/merger.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __MERGER_H__
+#define __MERGER_H__
+
+extern bool IsMergeWorker;
+
+extern Size merge_worker_shmem_needs(void);
+extern void merge_worker_shmem_init(Pointer ptr, bool found);
+extern void register_merge_worker(void);
+PGDLLEXPORT void merge_worker_main(Datum);
+
+#endif							/* __MERGER_H__ */
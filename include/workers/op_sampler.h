@@ -0,0 +1,19 @@
+/*-------------------------------------------------------------------------
+ *
+ * op_sampler.h
+ *		Routines for background worker sampling OrioleDB operations.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/op_sampler.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __OP_SAMPLER_H__
+#define __OP_SAMPLER_H__
+
+extern void register_op_sampler(void);
+PGDLLEXPORT void op_sampler_main(Datum);
+
+#endif							/* __OP_SAMPLER_H__ */
@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * paced_worker.h
+ *		Setup of the background workers and the main loop of those doing
+ *		their work in rounds.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/paced_worker.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __PACED_WORKER_H__
+#define __PACED_WORKER_H__
+
+typedef struct OPacedWorker
+{
+	/* worker name for the log messages, like "merge worker" */
+	const char *name;
+	/* GUCs of the delay between the rounds in ms and the pages per round */
+	int		   *delay;
+	int		   *pages;
+	/* optional GUC suspending the rounds */
+	bool	   *pause;
+	/* does one round of the work examining up to 'npages' pages */
+	void		(*round) (void *arg, int npages);
+	/* optional callbacks for the shutdown and for the error thrown */
+	void		(*shutdown) (void *arg);
+	void		(*error) (void *arg);
+	void	   *arg;
+} OPacedWorker;
+
+extern void o_worker_setup(void (*termHandler) (SIGNAL_ARGS));
+extern void o_paced_worker_main(OPacedWorker *worker);
+
+#endif							/* __PACED_WORKER_H__ */
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * prewarm.h
+ *		Routines for saving and restoring the hot page set.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/prewarm.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __PREWARM_H__
+#define __PREWARM_H__
+
+#include "access/xlogreader.h"
+
+extern bool IsPrewarmWorker;
+
+extern int64 prewarm_dump_hot_pages(void);
+extern int64 prewarm_load_hot_pages(int num, int nworkers);
+extern int64 prewarm_log_hot_pages(void);
+extern void prewarm_redo_hot_pages(XLogReaderState *record);
+extern void register_prewarm_worker(int num);
+extern void register_replica_prewarm_worker(void);
+PGDLLEXPORT void prewarm_worker_main(Datum);
+PGDLLEXPORT void replica_prewarm_worker_main(Datum);
+
+#endif							/* __PREWARM_H__ */
@@ -0,0 +1,72 @@
+/*-------------------------------------------------------------------------
+ *
+ * slot_queue.h
+ *		Shared slot queue of the background job workers.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/slot_queue.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __SLOT_QUEUE_H__
+#define __SLOT_QUEUE_H__
+
+#include "fmgr.h"
+#include "port/atomics.h"
+#include "storage/condition_variable.h"
+
+/* the number of the usage counters of the queue */
+#define O_SLOT_QUEUE_MAX_COUNTERS	(3)
+/* the counter of the submitted slots, the rest are up to the users */
+#define O_SLOT_QUEUE_SUBMITTED		(0)
+
+/*
+ * The header of each slot.  The users place their job data after it.
+ */
+typedef struct
+{
+	pg_atomic_uint32 state;
+} OSlotQueueSlot;
+
+typedef struct
+{
+	/* the workers sleep here waiting for the submitted slots */
+	ConditionVariable submitCV;
+	/* the submitters sleep here waiting for the running slots */
+	ConditionVariable doneCV;
+	pg_atomic_uint64 counters[O_SLOT_QUEUE_MAX_COUNTERS];
+	int			nslots;
+	int			slotsPerWorker;
+	Size		slotSize;
+} OSlotQueue;
+
+#define O_SLOT_QUEUE_SLOT(queue, index) \
+	((OSlotQueueSlot *) ((Pointer) (queue) + MAXALIGN(sizeof(OSlotQueue)) + \
+						 (Size) (index) * (queue)->slotSize))
+
+/* does the job of the slot taken by the worker */
+typedef void (*OSlotQueueJob) (OSlotQueue *queue, OSlotQueueSlot *slot);
+
+extern Size o_slot_queue_shmem_needs(int nworkers, int slotsPerWorker,
+									 Size slotSize);
+extern void o_slot_queue_init(OSlotQueue *queue, int nworkers,
+							  int slotsPerWorker, Size slotSize);
+
+extern int	o_slot_queue_acquire(OSlotQueue *queue);
+extern void o_slot_queue_submit(OSlotQueue *queue, int index);
+extern void o_slot_queue_wakeup_workers(OSlotQueue *queue);
+extern bool o_slot_queue_is_done(OSlotQueue *queue, int index);
+extern void o_slot_queue_wait_done(OSlotQueue *queue, int index);
+extern bool o_slot_queue_cancel(OSlotQueue *queue, int index);
+extern void o_slot_queue_free(OSlotQueue *queue, int index);
+
+extern void o_slot_queue_register_worker(int num, const char *function,
+										 const char *name);
+extern void o_slot_queue_worker_main(OSlotQueue *queue, int num,
+									 const char *name, OSlotQueueJob job);
+extern Datum o_slot_queue_stats(FunctionCallInfo fcinfo, OSlotQueue *queue,
+								int ncounters);
+
+#endif							/* __SLOT_QUEUE_H__ */
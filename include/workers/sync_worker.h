@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------
+ *
+ * sync_worker.h
+ *		Routines for background data file sync workers.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/sync_worker.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __SYNC_WORKER_H__
+#define __SYNC_WORKER_H__
+
+extern bool IsSyncWorker;
+
+extern Size sync_workers_shmem_needs(void);
+extern void sync_workers_shmem_init(Pointer ptr, bool found);
+extern bool sync_workers_enabled(void);
+extern void sync_workers_submit(const char *path);
+extern void sync_workers_wait_all(void);
+extern void sync_workers_release_all(void);
+extern void register_sync_worker(int num);
+PGDLLEXPORT void sync_worker_main(Datum);
+
+#endif							/* __SYNC_WORKER_H__ */
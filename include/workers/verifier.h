@@ -0,0 +1,23 @@
+/*-------------------------------------------------------------------------
+ *
+ * verifier.h
+ *		Routines for background tree verification workers.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/include/workers/verifier.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef __VERIFIER_H__
+#define __VERIFIER_H__
+
+extern bool IsVerifyWorker;
+
+extern Size verify_shmem_needs(void);
+extern void verify_shmem_init(Pointer ptr, bool found);
+extern void register_verify_worker(int num);
+PGDLLEXPORT void verify_worker_main(Datum);
+
+#endif							/* __VERIFIER_H__ */
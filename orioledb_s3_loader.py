@@ -137,6 +137,8 @@ class OrioledbS3ObjectLoader:
 		    os.path.join("orioledb_data", "small_file_checksums"), chkp_num,
 		    None)
 
+		self.assemble_chunked_files()
+
 		control = get_control_data(self.data_dir)
 		orioledb_control = get_orioledb_control_data(self.data_dir)
 		self.download_undo(orioledb_control['undoRegularStartLocation'],
@@ -490,6 +492,31 @@ class OrioledbS3ObjectLoader:
 			                                    prev_chkp_num,
 			                                    prev_file_checksums)
 
+	def assemble_chunked_files(self):
+		# Big PostgreSQL files are put by chunks into "<filename>.chunks/<n>"
+		# objects, concatenate the downloaded chunks back into the files
+		for root, dirs, _ in os.walk(self.data_dir):
+			for dirname in list(dirs):
+				if not dirname.endswith(".chunks"):
+					continue
+				dirs.remove(dirname)
+
+				chunks_dir = os.path.join(root, dirname)
+				filename = os.path.join(root, dirname[:-len(".chunks")])
+				chunks = sorted(os.listdir(chunks_dir), key=int)
+
+				if self.verbose:
+					print(f"{chunks_dir} -> {filename}", flush=True)
+
+				with open(filename, 'wb') as file:
+					for chunk in chunks:
+						chunk_path = os.path.join(chunks_dir, chunk)
+						with open(chunk_path, 'rb') as chunk_file:
+							file.write(chunk_file.read())
+						os.unlink(chunk_path)
+				os.chmod(filename, 0o600)
+				os.rmdir(chunks_dir)
+
 	def get_unchanged_file_checksums(self, file_checksums_name: str,
 	                                 chkp_num: int) -> dict[str, str]:
 		res = {}
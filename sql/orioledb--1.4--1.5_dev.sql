@@ -13,3 +13,15 @@ RETURNS void
 AS 'MODULE_PATHNAME'
 VOLATILE LANGUAGE C;
 
+
+CREATE FUNCTION orioledb_btree_bench(relid regclass,
+									 operation text,
+									 nops bigint,
+									 nkeys bigint,
+									 distribution text DEFAULT 'uniform',
+									 seed bigint DEFAULT 0,
+									 OUT affected bigint,
+									 OUT elapsed_ms float8,
+									 OUT ops_per_sec float8)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
@@ -53,3 +53,418 @@ VOLATILE LANGUAGE C;
 --RETURNS bigint
 --AS 'MODULE_PATHNAME'
 --VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_merge_worker_stats(OUT pages_scanned bigint,
+											OUT pages_merged bigint,
+											OUT passes bigint)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_eviction_stats(OUT pool_name text,
+										OUT stalls bigint,
+										OUT stall_time_us bigint,
+										OUT bgwriter_evictions bigint,
+										OUT bgwriter_wakeups bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_prewarm_dump()
+RETURNS bigint
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_prewarm_load()
+RETURNS bigint
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_pool_occupancy(OUT pool_name text,
+										OUT datoid oid,
+										OUT reloid oid,
+										OUT relnode oid,
+										OUT pages bigint,
+										OUT dirty_pages bigint,
+										OUT over_quota bool)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_shared_buffers_info(OUT mapping text,
+											 OUT size bigint,
+											 OUT huge_page_size bigint,
+											 OUT huge_pages_size bigint,
+											 OUT locked bool)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_compressed_cache_stats(OUT size bigint,
+												OUT slots bigint,
+												OUT used_slots bigint,
+												OUT hits bigint,
+												OUT misses bigint,
+												OUT inserts bigint,
+												OUT rejects bigint)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_undo_page_cache_stats(OUT size bigint,
+												OUT slots bigint,
+												OUT hits bigint,
+												OUT misses bigint,
+												OUT inserts bigint)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_zone_map_stats(OUT size bigint,
+										OUT slots bigint,
+										OUT used_slots bigint,
+										OUT skips bigint,
+										OUT hits bigint,
+										OUT misses bigint,
+										OUT inserts bigint)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_compress_worker_stats(OUT submitted bigint,
+											   OUT used bigint,
+											   OUT wasted bigint)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_compact(relid regclass)
+RETURNS integer
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_compaction_stats(OUT queued bigint,
+										  OUT pages_rewritten bigint,
+										  OUT trees_compacted bigint)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_sync_worker_stats(OUT submitted bigint,
+										   OUT failed bigint)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_checkpoint_stats(OUT checkpoint_number bigint,
+										  OUT in_progress bool,
+										  OUT start_time timestamptz,
+										  OUT end_time timestamptz,
+										  OUT datoid oid,
+										  OUT reloid oid,
+										  OUT relnode oid,
+										  OUT trees_done bigint,
+										  OUT trees_total bigint,
+										  OUT pages_written bigint,
+										  OUT pages_reused bigint,
+										  OUT pages_compressed bigint,
+										  OUT bytes_written bigint,
+										  OUT sys_trees_time float8,
+										  OUT xids_file_time float8,
+										  OUT map_sort_time float8,
+										  OUT writeback_time float8,
+										  OUT fsync_time float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_checkpoint AS
+	SELECT * FROM orioledb_checkpoint_stats();
+
+CREATE FUNCTION orioledb_undo_stats(OUT undo_type text,
+									OUT buffer_size bigint,
+									OUT last_used_location bigint,
+									OUT reserved_bytes bigint,
+									OUT written_location bigint,
+									OUT buffer_fill float8,
+									OUT min_reserved_location bigint,
+									OUT min_transaction_retain_location bigint,
+									OUT min_retain_location bigint,
+									OUT min_rewind_retain_location bigint,
+									OUT checkpoint_retain_start_location bigint,
+									OUT checkpoint_retain_end_location bigint,
+									OUT retained_bytes bigint,
+									OUT evicted_bytes bigint,
+									OUT disk_reads bigint,
+									OUT disk_read_bytes bigint,
+									OUT retaining_pid int4,
+									OUT retaining_kind text,
+									OUT retaining_since timestamptz)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_undo AS
+	SELECT *, now() - retaining_since AS retaining_age
+	FROM orioledb_undo_stats();
+
+CREATE FUNCTION orioledb_recovery_queue_depth(OUT worker int4,
+											  OUT sent_modifies bigint,
+											  OUT applied_modifies bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_s3_queue_stats(OUT priority text,
+										OUT depth bigint,
+										OUT in_progress bigint,
+										OUT scheduled bigint,
+										OUT processed bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_s3_queue AS
+	SELECT * FROM orioledb_s3_queue_stats();
+
+CREATE FUNCTION orioledb_s3_stats(OUT operation text,
+								  OUT requests bigint,
+								  OUT bytes bigint,
+								  OUT errors bigint,
+								  OUT retries bigint,
+								  OUT total_time float8,
+								  OUT queue_waits bigint,
+								  OUT queue_wait_time float8,
+								  OUT latency_histogram bigint[])
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_s3 AS
+	SELECT * FROM orioledb_s3_stats();
+
+CREATE FUNCTION orioledb_s3_headers_stats(OUT lookups bigint,
+										  OUT misses bigint,
+										  OUT hit_ratio float8,
+										  OUT desired_size bigint,
+										  OUT loaded_size bigint,
+										  OUT cold_reads bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_s3_headers AS
+	SELECT * FROM orioledb_s3_headers_stats();
+
+CREATE FUNCTION orioledb_s3_backup_progress(OUT checkpoint_number bigint,
+											OUT in_progress bool,
+											OUT start_time timestamptz,
+											OUT files_total bigint,
+											OUT files_done bigint,
+											OUT bytes_total bigint,
+											OUT bytes_done bigint)
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_s3_backup AS
+	SELECT * FROM orioledb_s3_backup_progress();
+
+CREATE FUNCTION orioledb_tree_stats(OUT datoid oid,
+									OUT reloid oid,
+									OUT relnode oid,
+									OUT hits bigint,
+									OUT misses bigint,
+									OUT disk_loads bigint,
+									OUT s3_loads bigint,
+									OUT evictions bigint,
+									OUT writes bigint,
+									OUT splits bigint,
+									OUT merges bigint,
+									OUT compress_bytes_in bigint,
+									OUT compress_bytes_out bigint,
+									OUT load_time float8,
+									OUT write_time float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_trees AS
+	SELECT s.datoid, s.reloid, c.relname, s.relnode, s.hits, s.misses,
+		   s.disk_loads, s.s3_loads, s.evictions, s.writes, s.splits,
+		   s.merges, s.compress_bytes_in, s.compress_bytes_out,
+		   s.load_time, s.write_time
+	FROM orioledb_tree_stats() s
+	LEFT JOIN pg_database d ON d.datname = current_database()
+	LEFT JOIN pg_class c ON s.datoid = d.oid AND c.oid = s.reloid;
+
+CREATE FUNCTION orioledb_page_wait_stats(OUT datoid oid,
+										 OUT reloid oid,
+										 OUT relnode oid,
+										 OUT wait_type text,
+										 OUT level text,
+										 OUT waits bigint,
+										 OUT wait_time float8,
+										 OUT histogram bigint[])
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_page_waits AS
+	SELECT s.datoid, s.reloid, c.relname, s.relnode, s.wait_type, s.level,
+		   s.waits, s.wait_time, s.histogram
+	FROM orioledb_page_wait_stats() s
+	LEFT JOIN pg_database d ON d.datname = current_database()
+	LEFT JOIN pg_class c ON s.datoid = d.oid AND c.oid = s.reloid;
+
+CREATE FUNCTION orioledb_op_samples(OUT sample_time timestamptz,
+									OUT pid int4,
+									OUT operation text,
+									OUT datoid oid,
+									OUT reloid oid,
+									OUT relnode oid)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_op_samples AS
+	SELECT s.sample_time, s.pid, s.operation, s.datoid, s.reloid, c.relname,
+		   s.relnode
+	FROM orioledb_op_samples() s
+	LEFT JOIN pg_database d ON d.datname = current_database()
+	LEFT JOIN pg_class c ON s.datoid = d.oid AND c.oid = s.reloid;
+
+CREATE VIEW pg_stat_orioledb_op_profile AS
+	SELECT datoid, reloid, relname, relnode, operation,
+		   count(*) AS samples,
+		   count(*)::float8 / sum(count(*)) OVER () AS fraction
+	FROM pg_stat_orioledb_op_samples
+	GROUP BY datoid, reloid, relname, relnode, operation;
+
+CREATE FUNCTION orioledb_ucm_stats(OUT pool_name text,
+								   OUT epoch int4,
+								   OUT epoch_shifts bigint,
+								   OUT usage_levels bigint[],
+								   OUT free_pages bigint,
+								   OUT available_pages bigint,
+								   OUT dirty_pages bigint,
+								   OUT free_pages_low_mark bigint,
+								   OUT free_pages_high_mark bigint,
+								   OUT backend_clock_runs bigint,
+								   OUT clock_steps bigint,
+								   OUT rejected_no_tree bigint,
+								   OUT rejected_children bigint,
+								   OUT rejected_locked bigint,
+								   OUT rejected_checkpoint bigint,
+								   OUT rejected_root bigint,
+								   OUT evicted_clean bigint,
+								   OUT evicted_dirty bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_ucm AS
+	SELECT * FROM orioledb_ucm_stats();
+
+CREATE FUNCTION orioledb_bgwriter_clock_stats(OUT pool_name text,
+											  OUT bgwriter int4,
+											  OUT region_start bigint,
+											  OUT region_end bigint,
+											  OUT clock_hand bigint,
+											  OUT runs bigint,
+											  OUT passes bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_bgwriter_clocks AS
+	SELECT * FROM orioledb_bgwriter_clock_stats();
+
+CREATE FUNCTION orioledb_free_pages_history(OUT pool_name text,
+											OUT sample_time timestamptz,
+											OUT free_pages bigint,
+											OUT dirty_pages bigint,
+											OUT stalls bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_free_pages_history AS
+	SELECT * FROM orioledb_free_pages_history();
+
+CREATE FUNCTION orioledb_backend_memory(OUT pid int4,
+										OUT total_bytes bigint,
+										OUT descriptors_bytes bigint,
+										OUT sys_caches_bytes bigint,
+										OUT btree_bytes bigint,
+										OUT checkpoint_bytes bigint,
+										OUT cache_sheds bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_backend_memory AS
+	SELECT m.pid, a.backend_type, a.usename, a.datname, m.total_bytes,
+		   m.descriptors_bytes, m.sys_caches_bytes, m.btree_bytes,
+		   m.checkpoint_bytes, m.cache_sheds
+	FROM orioledb_backend_memory() m
+	LEFT JOIN pg_stat_activity a ON a.pid = m.pid;
+
+CREATE FUNCTION orioledb_memory_contexts(OUT name text,
+										 OUT ident text,
+										 OUT parent text,
+										 OUT level int4,
+										 OUT total_bytes bigint,
+										 OUT total_nblocks bigint,
+										 OUT free_bytes bigint,
+										 OUT used_bytes bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_memory_contexts AS
+	SELECT * FROM orioledb_memory_contexts();
+
+CREATE FUNCTION orioledb_device_stats(OUT device int4,
+									  OUT path text,
+									  OUT length bigint,
+									  OUT allocated bigint,
+									  OUT inflight int4,
+									  OUT reads bigint,
+									  OUT read_bytes bigint,
+									  OUT writes bigint,
+									  OUT written_bytes bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_devices AS
+	SELECT * FROM orioledb_device_stats();
+
+CREATE FUNCTION orioledb_verify(relid regclass)
+RETURNS integer
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_verify_status(OUT datoid oid,
+									   OUT reloid oid,
+									   OUT relnode oid,
+									   OUT index_type text,
+									   OUT status text,
+									   OUT worker int4,
+									   OUT pages_checked bigint,
+									   OUT errors bigint,
+									   OUT queued_at timestamptz,
+									   OUT started_at timestamptz,
+									   OUT finished_at timestamptz,
+									   OUT message text)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE VIEW pg_stat_orioledb_verify AS
+	SELECT * FROM orioledb_verify_status();
+
+CREATE FUNCTION orioledb_resize_main_buffers(size bigint)
+RETURNS bigint
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
+
+CREATE FUNCTION orioledb_main_buffers_info(OUT size bigint,
+										   OUT max_size bigint,
+										   OUT retired_pages bigint,
+										   OUT pending_pages bigint)
+RETURNS record
+AS 'MODULE_PATHNAME'
+VOLATILE LANGUAGE C;
@@ -0,0 +1,436 @@
+/*-------------------------------------------------------------------------
+ *
+ * bench.c
+ *		Microbenchmarks of the B-tree operations.
+ *
+ * orioledb_btree_bench() runs the given number of the B-tree operations
+ * directly against the primary index of the table and reports the time they
+ * took.  The keys are drawn from 1..nkeys by the sequential, uniform or
+ * zipfian distribution, so the same seed gives the same sequence of the
+ * operations.  The point lookups, the range iterations and the full
+ * sequential scans go through the page finding with the fast-path downlink
+ * search and the page chunk loading, the inserts and the deletes go through
+ * o_btree_modify() including the page splits and the merges.
+ *
+ * The table must have an int4 primary key, the int4 columns only and no
+ * secondary indices.  The modifications skip WAL, so the table must be
+ * unlogged or temporary.  The concurrency and the page pool pressure are
+ * driven by test/bench/btree_bench.py, which runs the function in several
+ * sessions of the node with the given orioledb.main_buffers.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/bench.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "orioledb.h"
+
+#include "btree/btree.h"
+#include "btree/iterator.h"
+#include "btree/modify.h"
+#include "btree/scan.h"
+#include "tableam/descr.h"
+#include "tableam/handler.h"
+#include "transam/oxid.h"
+#include "tuple/format.h"
+
+#include "access/htup_details.h"
+#include "access/relation.h"
+#include "catalog/pg_type.h"
+#include "common/pg_prng.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "portability/instr_time.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+/* The number of tuples fetched by every range iteration */
+#define BENCH_RANGE_TUPLES		100
+/* The number of operations between the resets of the memory context */
+#define BENCH_RESET_INTERVAL	1024
+/* The skew of the zipfian distribution */
+#define BENCH_ZIPFIAN_THETA		0.99
+
+typedef enum
+{
+	BenchInsert,
+	BenchDelete,
+	BenchFind,
+	BenchIterate,
+	BenchSeqScan
+} BenchOperation;
+
+typedef enum
+{
+	BenchSequential,
+	BenchUniform,
+	BenchZipfian
+} BenchDistribution;
+
+typedef struct
+{
+	BenchDistribution distribution;
+	pg_prng_state prng;
+	uint64		nkeys;
+	uint64		next;
+	/* precomputed constants of the zipfian distribution */
+	double		zetan;
+	double		alpha;
+	double		eta;
+} BenchKeyGenerator;
+
+PG_FUNCTION_INFO_V1(orioledb_btree_bench);
+
+static void
+key_generator_init(BenchKeyGenerator *gen, BenchDistribution distribution,
+				   uint64 nkeys, uint64 seed)
+{
+	gen->distribution = distribution;
+	gen->nkeys = nkeys;
+	gen->next = seed % nkeys;
+	pg_prng_seed(&gen->prng, seed);
+
+	if (distribution == BenchZipfian)
+	{
+		double		zeta2 = 1.0 + pow(0.5, BENCH_ZIPFIAN_THETA);
+		uint64		i;
+
+		/* See "Quickly Generating Billion-Record Synthetic Databases" */
+		gen->zetan = 0.0;
+		for (i = 1; i <= nkeys; i++)
+			gen->zetan += pow(1.0 / (double) i, BENCH_ZIPFIAN_THETA);
+		gen->alpha = 1.0 / (1.0 - BENCH_ZIPFIAN_THETA);
+		gen->eta = (1.0 - pow(2.0 / (double) nkeys,
+							  1.0 - BENCH_ZIPFIAN_THETA)) /
+			(1.0 - zeta2 / gen->zetan);
+	}
+}
+
+static int32
+key_generator_next(BenchKeyGenerator *gen)
+{
+	uint64		key = 0;
+
+	switch (gen->distribution)
+	{
+		case BenchSequential:
+			key = gen->next;
+			gen->next = (gen->next + 1) % gen->nkeys;
+			break;
+		case BenchUniform:
+			key = pg_prng_uint64_range(&gen->prng, 0, gen->nkeys - 1);
+			break;
+		case BenchZipfian:
+			{
+				double		u = pg_prng_double(&gen->prng);
+				double		uz = u * gen->zetan;
+
+				if (uz < 1.0)
+					key = 0;
+				else if (uz < 1.0 + pow(0.5, BENCH_ZIPFIAN_THETA))
+					key = 1;
+				else
+					key = (uint64) ((double) gen->nkeys *
+									pow(gen->eta * u - gen->eta + 1.0,
+										gen->alpha));
+				key = Min(key, gen->nkeys - 1);
+			}
+			break;
+	}
+	return (int32) (key + 1);
+}
+
+static BenchOperation
+parse_operation(const char *name)
+{
+	if (strcmp(name, "insert") == 0)
+		return BenchInsert;
+	else if (strcmp(name, "delete") == 0)
+		return BenchDelete;
+	else if (strcmp(name, "find") == 0)
+		return BenchFind;
+	else if (strcmp(name, "iterate") == 0)
+		return BenchIterate;
+	else if (strcmp(name, "seq_scan") == 0)
+		return BenchSeqScan;
+
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("unknown benchmark operation \"%s\"", name),
+			 errhint("Valid operations are \"insert\", \"delete\", \"find\", "
+					 "\"iterate\" and \"seq_scan\".")));
+	return BenchFind;			/* keep compiler quiet */
+}
+
+static BenchDistribution
+parse_distribution(const char *name)
+{
+	if (strcmp(name, "sequential") == 0)
+		return BenchSequential;
+	else if (strcmp(name, "uniform") == 0)
+		return BenchUniform;
+	else if (strcmp(name, "zipfian") == 0)
+		return BenchZipfian;
+
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("unknown key distribution \"%s\"", name),
+			 errhint("Valid distributions are \"sequential\", \"uniform\" "
+					 "and \"zipfian\".")));
+	return BenchUniform;		/* keep compiler quiet */
+}
+
+/*
+ * Checks that the table fits the benchmark: see the header comment.
+ */
+static OIndexDescr *
+bench_check_table(Relation rel, OTableDescr *descr)
+{
+	OIndexDescr *primary = GET_PRIMARY(descr);
+	int			i;
+
+	if (primary->primaryIsCtid || primary->bridging ||
+		primary->nKeyFields != 1 || descr->nIndices != 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("table \"%s\" must have a single column primary key "
+						"and no secondary indices",
+						RelationGetRelationName(rel))));
+
+	for (i = 0; i < primary->leafTupdesc->natts; i++)
+	{
+		if (TupleDescAttr(primary->leafTupdesc, i)->atttypid != INT4OID)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("table \"%s\" must have int4 columns only",
+							RelationGetRelationName(rel))));
+	}
+
+	if (primary->desc.storageType == BTreeStoragePersistence)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("table \"%s\" must be unlogged or temporary",
+						RelationGetRelationName(rel))));
+
+	return primary;
+}
+
+static void
+bench_fill_key(OIndexDescr *primary, OBTreeKeyBound *bound, int32 key)
+{
+	bound->nkeys = 1;
+	bound->n_row_keys = 0;
+	bound->row_keys = NULL;
+	bound->keys[0].value = Int32GetDatum(key);
+	bound->keys[0].type = INT4OID;
+	bound->keys[0].flags = O_VALUE_BOUND_PLAIN_VALUE;
+	bound->keys[0].comparator = primary->fields[0].comparator;
+}
+
+/*
+ * Runs the operations and returns the number of the tuples inserted, deleted
+ * or fetched.
+ */
+static uint64
+bench_run(OIndexDescr *primary, BenchOperation operation,
+		  BenchKeyGenerator *gen, int64 nops, MemoryContext benchCxt)
+{
+	BTreeDescr *desc = &primary->desc;
+	TupleDesc	tupdesc = primary->leafTupdesc;
+	Datum	   *values = palloc(sizeof(Datum) * tupdesc->natts);
+	bool	   *isnull = palloc0(sizeof(bool) * tupdesc->natts);
+	MemoryContext prevCxt;
+	OSnapshot	oSnapshot;
+	OXid		oxid;
+	OTuple		nullTup;
+	uint64		result = 0;
+	int64		i;
+	int			j;
+
+	O_TUPLE_SET_NULL(nullTup);
+	fill_current_oxid_osnapshot(&oxid, &oSnapshot);
+	o_btree_load_shmem(desc);
+
+	prevCxt = MemoryContextSwitchTo(benchCxt);
+	for (i = 0; i < nops; i++)
+	{
+		int32		key = key_generator_next(gen);
+		OBTreeKeyBound bound;
+
+		CHECK_FOR_INTERRUPTS();
+
+		bench_fill_key(primary, &bound, key);
+
+		switch (operation)
+		{
+			case BenchInsert:
+				{
+					OTuple		tup;
+
+					for (j = 0; j < tupdesc->natts; j++)
+						values[j] = Int32GetDatum(key);
+					tup = o_form_tuple(tupdesc, &primary->leafSpec, 0,
+									   values, isnull, NULL);
+					if (o_btree_modify(desc, BTreeOperationInsert,
+									   tup, BTreeKeyLeafTuple,
+									   (Pointer) &bound, BTreeKeyBound,
+									   oxid, oSnapshot.csn, RowLockUpdate,
+									   NULL, &nullCallbackInfo) ==
+						OBTreeModifyResultInserted)
+						result++;
+				}
+				break;
+			case BenchDelete:
+				if (o_btree_modify(desc, BTreeOperationDelete,
+								   nullTup, BTreeKeyNone,
+								   (Pointer) &bound, BTreeKeyBound,
+								   oxid, oSnapshot.csn, RowLockUpdate,
+								   NULL, &nullCallbackInfo) ==
+					OBTreeModifyResultDeleted)
+					result++;
+				break;
+			case BenchFind:
+				if (!O_TUPLE_IS_NULL(o_btree_find_tuple_by_key(desc, &bound,
+															   BTreeKeyBound,
+															   &oSnapshot,
+															   NULL,
+															   benchCxt,
+															   NULL)))
+					result++;
+				break;
+			case BenchIterate:
+				{
+					BTreeIterator *it;
+
+					it = o_btree_iterator_create(desc, &bound, BTreeKeyBound,
+												 &oSnapshot,
+												 ForwardScanDirection);
+					for (j = 0; j < BENCH_RANGE_TUPLES; j++)
+					{
+						OTuple		tup;
+
+						tup = o_btree_iterator_fetch(it, NULL, NULL,
+													 BTreeKeyNone, false,
+													 NULL);
+						if (O_TUPLE_IS_NULL(tup))
+							break;
+						result++;
+					}
+					btree_iterator_free(it);
+				}
+				break;
+			case BenchSeqScan:
+				{
+					BTreeSeqScan *scan;
+
+					scan = make_btree_seq_scan(desc, &oSnapshot, NULL);
+					while (!O_TUPLE_IS_NULL(btree_seq_scan_getnext(scan,
+																   benchCxt,
+																   NULL,
+																   NULL)))
+						result++;
+					free_btree_seq_scan(scan);
+				}
+				break;
+		}
+
+		if ((i + 1) % BENCH_RESET_INTERVAL == 0)
+			MemoryContextReset(benchCxt);
+	}
+	MemoryContextSwitchTo(prevCxt);
+	MemoryContextReset(benchCxt);
+
+	pfree(values);
+	pfree(isnull);
+
+	return result;
+}
+
+/*
+ * orioledb_btree_bench(relid, operation, nops, nkeys, distribution, seed)
+ *
+ * Returns the number of the affected tuples, the elapsed milliseconds and the
+ * operations per second.
+ */
+Datum
+orioledb_btree_bench(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	char	   *operationName = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	int64		nops = PG_GETARG_INT64(2);
+	int64		nkeys = PG_GETARG_INT64(3);
+	char	   *distributionName = text_to_cstring(PG_GETARG_TEXT_PP(4));
+	int64		seed = PG_GETARG_INT64(5);
+	BenchOperation operation = parse_operation(operationName);
+	BenchKeyGenerator gen;
+	MemoryContext benchCxt;
+	OTableDescr *descr;
+	OIndexDescr *primary;
+	Relation	rel;
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3] = {false};
+	instr_time	start,
+				elapsed;
+	uint64		affected;
+	double		elapsedMs;
+
+	orioledb_check_shmem();
+
+	if (nops < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of operations must not be negative")));
+	if (nkeys < 1 || nkeys > PG_INT32_MAX)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of keys must be between 1 and %d",
+						PG_INT32_MAX)));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	rel = relation_open(relid, (operation == BenchInsert ||
+								operation == BenchDelete) ?
+						RowExclusiveLock : AccessShareLock);
+	descr = relation_get_descr(rel);
+	if (!descr)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("relation \"%s\" is not orioledb",
+						RelationGetRelationName(rel))));
+	primary = bench_check_table(rel, descr);
+
+	key_generator_init(&gen, parse_distribution(distributionName),
+					   (uint64) nkeys, (uint64) seed);
+	benchCxt = AllocSetContextCreate(CurrentMemoryContext,
+									 "orioledb btree bench",
+									 ALLOCSET_DEFAULT_SIZES);
+
+	INSTR_TIME_SET_CURRENT(start);
+	affected = bench_run(primary, operation, &gen, nops, benchCxt);
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+	elapsedMs = INSTR_TIME_GET_MILLISEC(elapsed);
+
+	MemoryContextDelete(benchCxt);
+	relation_close(rel, NoLock);
+
+	values[0] = Int64GetDatum((int64) affected);
+	values[1] = Float8GetDatum(elapsedMs);
+	if (elapsedMs > 0.0)
+		values[2] = Float8GetDatum((double) nops * 1000.0 / elapsedMs);
+	else
+		nulls[2] = true;
+
+	tupdesc = BlessTupleDesc(tupdesc);
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values,
+													   nulls)));
+}
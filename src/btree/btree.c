@@ -19,7 +19,9 @@
 #include "btree/insert.h"
 #include "btree/io.h"
 #include "btree/page_chunks.h"
+#include "btree/page_contents.h"
 #include "btree/undo.h"
+#include "btree/walk.h"
 #include "catalog/o_tables.h"
 #include "recovery/recovery.h"
 #include "recovery/wal.h"
@@ -33,7 +35,11 @@
 
 #include "fmgr.h"
 #include "miscadmin.h"
+#include "postmaster/interrupt.h"
+#include "storage/spin.h"
 #include "utils/fmgrprotos.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
 #include "utils/numeric.h"
 
 LWLockPadded *unique_locks;
@@ -238,6 +244,289 @@ o_btree_cleanup_pages(OInMemoryBlkno rootPageBlkno, OInMemoryBlkno metaPageBlkno
 	free_meta_page(pool, metaPageBlkno);
 }
 
+/*
+ * The lazy cleanup of the dropped and truncated trees.  The backend only
+ * marks the root page with O_BTREE_FLAG_PRE_CLEANUP and queues the tree, and
+ * the first background writer releases its pages by
+ * O_TREE_CLEANUP_PAGES_PER_ROUND per round.  The release runs the same two
+ * phases as o_btree_cleanup_pages(), but the walk is kept in the explicit
+ * stack, so it can be resumed in the next round.  walk_page() doesn't evict
+ * or write the pages of a tree with the marked root.
+ *
+ * The queue lives in the shared memory only, so the files are still unlinked
+ * by the backend: a crash leaves no files of the dropped trees behind.  The
+ * background writer unlinks them once again after releasing the pages, in
+ * case a write racing with the marking of the root has created them again.
+ */
+#define O_TREE_CLEANUP_QUEUE_SIZE		64
+#define O_TREE_CLEANUP_PAGES_PER_ROUND	1024
+
+typedef struct
+{
+	Oid			datoid;
+	Oid			relnode;
+	OInMemoryBlkno rootPageBlkno;
+	OInMemoryBlkno metaPageBlkno;
+	uint32		rootPageChangeCount;
+	bool		files;
+	bool		fsync;
+} OTreeCleanupItem;
+
+typedef struct
+{
+	slock_t		lock;
+	int			count;
+	OTreeCleanupItem items[O_TREE_CLEANUP_QUEUE_SIZE];
+} OTreeCleanupQueue;
+
+typedef struct
+{
+	OInMemoryBlkno childPageNumbers[BTREE_PAGE_MAX_CHUNK_ITEMS];
+	uint32		childPageChangeCounts[BTREE_PAGE_MAX_CHUNK_ITEMS];
+	int			childPagesCount;
+	int			nextChild;
+	OInMemoryBlkno blkno;
+	uint32		pageChangeCount;
+} OTreeCleanupStackItem;
+
+/* The state of the walk, which is local to the first background writer */
+typedef struct
+{
+	bool		active;
+	bool		freeing;
+	int			depth;
+	OTreeCleanupStackItem stack[ORIOLEDB_MAX_DEPTH + 1];
+} OTreeCleanupWalk;
+
+static OTreeCleanupQueue *treeCleanupQueue = NULL;
+static OTreeCleanupWalk *treeCleanupWalk = NULL;
+
+Size
+o_btree_cleanup_queue_shmem_needs(void)
+{
+	return sizeof(OTreeCleanupQueue);
+}
+
+void
+o_btree_cleanup_queue_shmem_init(Pointer ptr, bool found)
+{
+	treeCleanupQueue = (OTreeCleanupQueue *) ptr;
+
+	if (!found)
+	{
+		SpinLockInit(&treeCleanupQueue->lock);
+		treeCleanupQueue->count = 0;
+	}
+}
+
+/*
+ * Marks the root page of the tree going to be queued for the lazy cleanup.
+ */
+static void
+mark_root_pre_cleanup(OInMemoryBlkno blkno, uint32 pageChangeCount)
+{
+	OInMemoryBlkno childPageNumbers[BTREE_PAGE_MAX_CHUNK_ITEMS];
+	uint32		childPageChangeCounts[BTREE_PAGE_MAX_CHUNK_ITEMS];
+	int			childPagesCount;
+	int			ionum;
+
+	if (!get_page_children(blkno, pageChangeCount,
+						   childPageNumbers, childPageChangeCounts,
+						   &childPagesCount))
+		return;
+
+	page_block_reads(blkno);
+	((BTreePageHeader *) O_GET_IN_MEMORY_PAGE(blkno))->flags |= O_BTREE_FLAG_PRE_CLEANUP;
+	ionum = O_GET_IN_MEMORY_PAGEDESC(blkno)->ionum;
+	unlock_page(blkno);
+
+	if (ionum >= 0)
+		wait_for_io_completion(ionum);
+}
+
+/*
+ * Queues the tree for the cleanup by the background writer.  Returns false
+ * if the pages should be cleaned up by the caller.  The files are always
+ * unlinked by the caller.
+ */
+bool
+o_btree_cleanup_lazy(Oid datoid, Oid relnode, OInMemoryBlkno rootPageBlkno,
+					 OInMemoryBlkno metaPageBlkno, uint32 rootPageChangeCount,
+					 bool files, bool fsync)
+{
+	bool		result = false;
+
+	if (!lazy_tree_cleanup || debug_disable_bgwriter ||
+		((volatile OTreeCleanupQueue *) treeCleanupQueue)->count >= O_TREE_CLEANUP_QUEUE_SIZE)
+		return false;
+
+	/*
+	 * Mark the root before the tree is queued: once queued, the background
+	 * writer might release the root concurrently.  If the queue appears to
+	 * be full, the caller marks the pages once again, which is harmless.
+	 */
+	mark_root_pre_cleanup(rootPageBlkno, rootPageChangeCount);
+
+	SpinLockAcquire(&treeCleanupQueue->lock);
+	if (treeCleanupQueue->count < O_TREE_CLEANUP_QUEUE_SIZE)
+	{
+		OTreeCleanupItem *item = &treeCleanupQueue->items[treeCleanupQueue->count];
+
+		item->datoid = datoid;
+		item->relnode = relnode;
+		item->rootPageBlkno = rootPageBlkno;
+		item->metaPageBlkno = metaPageBlkno;
+		item->rootPageChangeCount = rootPageChangeCount;
+		item->files = files;
+		item->fsync = fsync;
+		treeCleanupQueue->count++;
+		result = true;
+	}
+	SpinLockRelease(&treeCleanupQueue->lock);
+
+	return result;
+}
+
+static void
+tree_cleanup_walk_push(OInMemoryBlkno blkno, uint32 pageChangeCount)
+{
+	OTreeCleanupStackItem *item;
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	int			ionum;
+
+	Assert(treeCleanupWalk->depth <= ORIOLEDB_MAX_DEPTH);
+	item = &treeCleanupWalk->stack[treeCleanupWalk->depth];
+
+	if (!get_page_children(blkno, pageChangeCount,
+						   item->childPageNumbers, item->childPageChangeCounts,
+						   &item->childPagesCount))
+		return;
+
+	if (!treeCleanupWalk->freeing)
+	{
+		page_block_reads(blkno);
+		((BTreePageHeader *) p)->flags |= O_BTREE_FLAG_PRE_CLEANUP;
+		ionum = O_GET_IN_MEMORY_PAGEDESC(blkno)->ionum;
+		unlock_page(blkno);
+
+		if (ionum >= 0)
+			wait_for_io_completion(ionum);
+	}
+	else
+	{
+		Assert(O_PAGE_IS(p, PRE_CLEANUP));
+		unlock_page(blkno);
+	}
+
+	item->blkno = blkno;
+	item->pageChangeCount = pageChangeCount;
+	item->nextChild = 0;
+	treeCleanupWalk->depth++;
+}
+
+/*
+ * Walks the tree until all the pages are processed or the budget is spent.
+ * Returns true if the walk is finished.
+ */
+static bool
+tree_cleanup_walk(OPagePool *pool, int *budget)
+{
+	while (treeCleanupWalk->depth > 0 && *budget > 0 && !ShutdownRequestPending)
+	{
+		OTreeCleanupStackItem *item = &treeCleanupWalk->stack[treeCleanupWalk->depth - 1];
+
+		if (item->nextChild < item->childPagesCount)
+		{
+			int			i = item->nextChild++;
+
+			tree_cleanup_walk_push(item->childPageNumbers[i],
+								   item->childPageChangeCounts[i]);
+			continue;
+		}
+
+		/* All the children are processed, so the page is popped */
+		treeCleanupWalk->depth--;
+		(*budget)--;
+
+		if (treeCleanupWalk->freeing)
+		{
+			lock_page(item->blkno);
+			Assert(O_PAGE_IS(O_GET_IN_MEMORY_PAGE(item->blkno), PRE_CLEANUP));
+			Assert(O_PAGE_GET_CHANGE_COUNT(O_GET_IN_MEMORY_PAGE(item->blkno)) == item->pageChangeCount);
+			Assert(O_GET_IN_MEMORY_PAGEDESC(item->blkno)->ionum < 0);
+			page_block_reads(item->blkno);
+			CLEAN_DIRTY(pool, item->blkno);
+			ppool_free_page(pool, item->blkno, true);
+		}
+	}
+
+	return treeCleanupWalk->depth == 0;
+}
+
+/*
+ * Continues the lazy cleanup of the queued trees.  Called by the first
+ * background writer.
+ */
+void
+o_btree_cleanup_queued_trees(void)
+{
+	int			budget = O_TREE_CLEANUP_PAGES_PER_ROUND;
+
+	while (budget > 0 && !ShutdownRequestPending)
+	{
+		OTreeCleanupItem item;
+		OPagePool  *pool;
+
+		if (((volatile OTreeCleanupQueue *) treeCleanupQueue)->count == 0)
+			return;
+
+		/* The queue head stays there until the cleanup is finished */
+		SpinLockAcquire(&treeCleanupQueue->lock);
+		item = treeCleanupQueue->items[0];
+		SpinLockRelease(&treeCleanupQueue->lock);
+
+		pool = get_ppool_by_blkno(item.rootPageBlkno);
+		Assert(pool != NULL);
+
+		if (!treeCleanupWalk)
+			treeCleanupWalk = MemoryContextAllocZero(TopMemoryContext,
+													 sizeof(OTreeCleanupWalk));
+
+		if (!treeCleanupWalk->active)
+		{
+			treeCleanupWalk->active = true;
+			treeCleanupWalk->freeing = false;
+			treeCleanupWalk->depth = 0;
+			tree_cleanup_walk_push(item.rootPageBlkno, item.rootPageChangeCount);
+		}
+
+		if (!tree_cleanup_walk(pool, &budget))
+			return;
+
+		if (!treeCleanupWalk->freeing)
+		{
+			/* All the pages are marked, start releasing them */
+			treeCleanupWalk->freeing = true;
+			tree_cleanup_walk_push(item.rootPageBlkno, item.rootPageChangeCount);
+			continue;
+		}
+
+		free_meta_page(pool, item.metaPageBlkno);
+
+		/* Unlink the files the racing writes might have created again */
+		if (item.files)
+			cleanup_btree_files(item.datoid, item.relnode, item.fsync);
+		treeCleanupWalk->active = false;
+
+		SpinLockAcquire(&treeCleanupQueue->lock);
+		Assert(treeCleanupQueue->count > 0);
+		treeCleanupQueue->count--;
+		memmove(&treeCleanupQueue->items[0], &treeCleanupQueue->items[1],
+				sizeof(OTreeCleanupItem) * treeCleanupQueue->count);
+		SpinLockRelease(&treeCleanupQueue->lock);
+	}
+}
+
 void
 o_btree_check_size_of_tuple(int len, char *relation_name, bool index)
 {
@@ -251,12 +540,88 @@ o_btree_check_size_of_tuple(int len, char *relation_name, bool index)
 						relation_name)));
 }
 
+/*
+ * The ranges of ctids leased by the backend from the shared counters of the
+ * meta pages.  Every insert into the table without primary key takes the next
+ * ctid.  With orioledb.ctid_lease_size, the backend moves the shared counter
+ * once per lease, which keeps the counter cache line from bouncing between
+ * the inserting backends.  The ctids of the backend also go together, so the
+ * backends insert into the different leaves.
+ *
+ * The counters only grow, so the lease stays valid as long as the tree.  The
+ * truncate or rewrite creates a new tree with new oids.
+ */
+typedef struct
+{
+	ORelOids	oids;
+	uint64		ctidNext;
+	uint64		ctidEnd;
+	uint64		bridgeCtidNext;
+	uint64		bridgeCtidEnd;
+} CtidLease;
+
+static HTAB *ctidLeases = NULL;
+
+static CtidLease *
+get_ctid_lease(BTreeDescr *desc)
+{
+	CtidLease  *lease;
+	bool		found;
+
+	if (!ctidLeases)
+	{
+		HASHCTL		ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(ORelOids);
+		ctl.entrysize = sizeof(CtidLease);
+		ctl.hcxt = TopMemoryContext;
+		ctidLeases = hash_create("OrioleDB ctid leases", 16, &ctl,
+								 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	lease = (CtidLease *) hash_search(ctidLeases, &desc->oids, HASH_ENTER,
+									  &found);
+	if (!found)
+	{
+		lease->ctidNext = lease->ctidEnd = 0;
+		lease->bridgeCtidNext = lease->bridgeCtidEnd = 0;
+	}
+	return lease;
+}
+
+static uint64
+ctid_counter_get_and_inc(BTreeDescr *desc, pg_atomic_uint64 *counter,
+						 bool bridge)
+{
+	CtidLease  *lease;
+	uint64	   *next,
+			   *end;
+
+	if (ctid_lease_size <= 1 && !ctidLeases)
+		return pg_atomic_fetch_add_u64(counter, 1);
+
+	lease = get_ctid_lease(desc);
+	next = bridge ? &lease->bridgeCtidNext : &lease->ctidNext;
+	end = bridge ? &lease->bridgeCtidEnd : &lease->ctidEnd;
+
+	if (*next >= *end)
+	{
+		if (ctid_lease_size <= 1)
+			return pg_atomic_fetch_add_u64(counter, 1);
+		*next = pg_atomic_fetch_add_u64(counter, ctid_lease_size);
+		*end = *next + ctid_lease_size;
+	}
+	return (*next)++;
+}
+
 ItemPointerData
 btree_ctid_get_and_inc(BTreeDescr *desc)
 {
 	BTreeMetaPage *metaPageBlkno = BTREE_GET_META(desc);
 	ItemPointerData result;
-	uint64		ctid = pg_atomic_fetch_add_u64(&metaPageBlkno->ctid, 1);
+	uint64		ctid = ctid_counter_get_and_inc(desc, &metaPageBlkno->ctid,
+												false);
 
 	Assert(ORootPageIsValid(desc) && OMetaPageIsValid(desc));
 	Assert(ctid / (MaxOffsetNumber - FirstOffsetNumber) < InvalidBlockNumber);
@@ -293,7 +658,8 @@ btree_bridge_ctid_get_and_inc(BTreeDescr *desc, bool *overflow)
 {
 	BTreeMetaPage *metaPageBlkno = BTREE_GET_META(desc);
 	ItemPointerData result;
-	uint64		ctid = pg_atomic_fetch_add_u64(&metaPageBlkno->bridge_ctid, 1);
+	uint64		ctid = ctid_counter_get_and_inc(desc, &metaPageBlkno->bridge_ctid,
+												true);
 	BlockNumber max_block_number = MaxBlockNumber;
 
 	Assert(ORootPageIsValid(desc) && OMetaPageIsValid(desc));
@@ -309,6 +675,173 @@ btree_bridge_ctid_get_and_inc(BTreeDescr *desc, bool *overflow)
 	return result;
 }
 
+/*
+ * Returns the unused remainder of the lease to the shared counter, unless
+ * somebody has leased after us.
+ */
+static void
+return_ctid_lease(pg_atomic_uint64 *counter, uint64 next, uint64 end)
+{
+	if (next < end)
+		(void) pg_atomic_compare_exchange_u64(counter, &end, next);
+}
+
+/*
+ * Returns the unused ctid leases on the backend exit.  The meta pages are
+ * found by the shared root info, so the leases of the trees not in the shared
+ * memory anymore are just left.
+ */
+void
+btree_return_ctid_leases(void)
+{
+	HASH_SEQ_STATUS status;
+	CtidLease  *lease;
+
+	if (!ctidLeases)
+		return;
+
+	hash_seq_init(&status, ctidLeases);
+	while ((lease = (CtidLease *) hash_seq_search(&status)) != NULL)
+	{
+		SharedRootInfoKey key;
+		SharedRootInfo *sharedRootInfo;
+		BTreeMetaPage *meta;
+
+		if (lease->ctidNext >= lease->ctidEnd &&
+			lease->bridgeCtidNext >= lease->bridgeCtidEnd)
+			continue;
+
+		key.datoid = lease->oids.datoid;
+		key.relnode = lease->oids.relnode;
+		sharedRootInfo = o_find_shared_root_info(&key);
+		if (!sharedRootInfo || sharedRootInfo->placeholder)
+			continue;
+
+		meta = (BTreeMetaPage *) O_GET_IN_MEMORY_PAGE(sharedRootInfo->rootInfo.metaPageBlkno);
+		return_ctid_lease(&meta->ctid, lease->ctidNext, lease->ctidEnd);
+		return_ctid_lease(&meta->bridge_ctid, lease->bridgeCtidNext,
+						  lease->bridgeCtidEnd);
+		pfree(sharedRootInfo);
+	}
+	hash_destroy(ctidLeases);
+	ctidLeases = NULL;
+}
+
+/* The number of the children sampled on each internal page */
+#define IN_MEMORY_FRACTION_SAMPLES		4
+/* The maximum number of the internal pages sampled per tree */
+#define IN_MEMORY_FRACTION_MAX_PAGES	16
+
+typedef struct
+{
+	int			budget;
+	double		fraction;
+	/* the state of the sampled page at each level */
+	struct
+	{
+		double		weight;
+		int			count;
+		int			item;
+		int			sample;
+		int			nsamples;
+	}			levels[ORIOLEDB_MAX_DEPTH + 1];
+} InMemoryFractionArg;
+
+/*
+ * Accounts the sampled internal page.  The page of the 'weight' is already
+ * counted as residing in memory, so the page changed concurrently keeps
+ * that estimate.
+ */
+static bool
+in_memory_fraction_page(BTreeDescr *desc, Page img, uint16 level, void *arg)
+{
+	InMemoryFractionArg *fracArg = (InMemoryFractionArg *) arg;
+	double		weight = fracArg->levels[level].weight;
+	int			count;
+
+	fracArg->budget--;
+
+	count = BTREE_PAGE_ITEMS_COUNT(img);
+	if (count == 0)
+		return false;
+
+	fracArg->fraction -= weight;
+
+	/* The downlinks of the level 1 pages point to the leaves */
+	if (level == 1 || fracArg->budget <= 0)
+	{
+		fracArg->fraction += weight * (double) (count - PAGE_GET_N_ONDISK(img)) /
+			(double) count;
+		return false;
+	}
+
+	/* Otherwise, the estimate is made of the sampled children */
+	fracArg->levels[level].count = count;
+	fracArg->levels[level].item = 0;
+	fracArg->levels[level].sample = 0;
+	fracArg->levels[level].nsamples = Min(count, IN_MEMORY_FRACTION_SAMPLES);
+	return true;
+}
+
+/*
+ * Descends to the evenly spaced children.  The evicted ones have all their
+ * leaves on disk.
+ */
+static OBTreeWalkAction
+in_memory_fraction_downlink(BTreeDescr *desc, uint16 level, uint64 downlink,
+							void *arg)
+{
+	InMemoryFractionArg *fracArg = (InMemoryFractionArg *) arg;
+	int			count = fracArg->levels[level].count,
+				nsamples = fracArg->levels[level].nsamples;
+	double		weight;
+
+	if (fracArg->levels[level].sample >= nsamples)
+		return OBTreeWalkSkip;
+	if (fracArg->levels[level].item++ !=
+		(fracArg->levels[level].sample * count + count / 2) / nsamples)
+		return OBTreeWalkSkip;
+	fracArg->levels[level].sample++;
+
+	if (DOWNLINK_IS_ON_DISK(downlink))
+		return OBTreeWalkSkip;
+
+	weight = fracArg->levels[level].weight / (double) nsamples;
+	fracArg->fraction += weight;
+	if (fracArg->budget <= 0)
+		return OBTreeWalkSkip;
+
+	fracArg->levels[level - 1].weight = weight;
+	return OBTreeWalkDescend;
+}
+
+/*
+ * Estimates the fraction of the tree leaves residing in the page pool.  The
+ * internal pages count their on-disk downlinks, so sampling a few of them
+ * is enough.  Used by the planner.
+ */
+double
+o_btree_in_memory_fraction(BTreeDescr *desc)
+{
+	InMemoryFractionArg fracArg;
+	OBTreeWalker walker = {
+		.page = in_memory_fraction_page,
+		.downlink = in_memory_fraction_downlink,
+		.arg = &fracArg
+	};
+	int			i;
+
+	/* The root, whatever its level, is the whole tree */
+	fracArg.budget = IN_MEMORY_FRACTION_MAX_PAGES;
+	fracArg.fraction = 1.0;
+	for (i = 0; i <= ORIOLEDB_MAX_DEPTH; i++)
+		fracArg.levels[i].weight = 1.0;
+
+	o_btree_walk_internal_pages(desc, &walker);
+
+	return fracArg.fraction;
+}
+
 static inline OIndexDescr *
 o_get_tree_def(BTreeDescr *desc)
 {
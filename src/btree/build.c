@@ -50,14 +50,17 @@ typedef struct OIndexBuildStackItem
 static bool put_item_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack,
 							  int level, OTuple tuple, int tuplesize,
 							  Pointer tupleheader, LocationIndex header_size,
-							  int *root_level, BTreeMetaPage *metaPageBlkno);
+							  int *root_level, BTreeMetaPage *metaPageBlkno,
+							  BTreeBuildWriteBuffer *writeBuffer);
 static bool put_tuple_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack,
 							   OTuple tuple, int *root_level,
-							   BTreeMetaPage *metaPageBlkno);
+							   BTreeMetaPage *metaPageBlkno,
+							   BTreeBuildWriteBuffer *writeBuffer);
 static bool put_downlink_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack,
 								  int level, uint64 downlink, OTuple key,
 								  int keysize, int *root_level,
-								  BTreeMetaPage *metaPageBlkno);
+								  BTreeMetaPage *metaPageBlkno,
+								  BTreeBuildWriteBuffer *writeBuffer);
 
 static void
 stack_page_split(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
@@ -138,7 +141,8 @@ static bool
 put_item_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
 				  OTuple tuple, int tuplesize, Pointer tupleheader,
 				  LocationIndex header_size, int *root_level,
-				  BTreeMetaPage *metaPageBlkno)
+				  BTreeMetaPage *metaPageBlkno,
+				  BTreeBuildWriteBuffer *writeBuffer)
 {
 	BTreeItemPageFitType fit;
 	Pointer		tuple_ptr;
@@ -229,7 +233,8 @@ put_item_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
 
 		VALGRIND_CHECK_MEM_IS_DEFINED(stack[level].img, ORIOLEDB_BLCKSZ);
 
-		downlink = perform_page_io_build(desc, stack[level].img, &extent, metaPageBlkno);
+		downlink = perform_page_io_build(desc, stack[level].img, &extent,
+										 metaPageBlkno, writeBuffer);
 		if (level == 0)
 			pg_atomic_add_fetch_u32(&metaPageBlkno->leafPagesNum, 1);
 
@@ -252,7 +257,7 @@ put_item_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
 
 		put_downlink_to_stack(desc, stack, level + 1, downlink,
 							  key.tuple, keysize,
-							  root_level, metaPageBlkno);
+							  root_level, metaPageBlkno, writeBuffer);
 	}
 	return true;
 }
@@ -260,7 +265,8 @@ put_item_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
 static bool
 put_downlink_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
 					  uint64 downlink, OTuple key, int keysize,
-					  int *root_level, BTreeMetaPage *metaPageBlkno)
+					  int *root_level, BTreeMetaPage *metaPageBlkno,
+					  BTreeBuildWriteBuffer *writeBuffer)
 {
 	BTreeNonLeafTuphdr internal_header = {0};
 	bool		result;
@@ -269,13 +275,14 @@ put_downlink_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack, int level,
 	result = put_item_to_stack(desc, stack, level, key, keysize,
 							   (Pointer) &internal_header,
 							   sizeof(internal_header), root_level,
-							   metaPageBlkno);
+							   metaPageBlkno, writeBuffer);
 	return result;
 }
 
 static bool
 put_tuple_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack,
-				   OTuple tuple, int *root_level, BTreeMetaPage *metaPageBlkno)
+				   OTuple tuple, int *root_level, BTreeMetaPage *metaPageBlkno,
+				   BTreeBuildWriteBuffer *writeBuffer)
 {
 	BTreeLeafTuphdr leaf_header = {0};
 	int			tuplesize;
@@ -286,7 +293,8 @@ put_tuple_to_stack(BTreeDescr *desc, OIndexBuildStackItem *stack,
 	tuplesize = o_btree_len(desc, tuple, OTupleLength);
 	return put_item_to_stack(desc, stack, 0,
 							 tuple, tuplesize, (Pointer) &leaf_header,
-							 sizeof(leaf_header), root_level, metaPageBlkno);
+							 sizeof(leaf_header), root_level, metaPageBlkno,
+							 writeBuffer);
 }
 
 void
@@ -297,6 +305,7 @@ btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
 {
 	OTuple		idx_tup;
 	OIndexBuildStackItem *stack;
+	BTreeBuildWriteBuffer *writeBuffer;
 	int			root_level = 0,
 				saved_root_level;
 	Page		root_page;
@@ -312,6 +321,8 @@ btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
 	btree_open_smgr(desc);
 
 	stack = (OIndexBuildStackItem *) palloc0(sizeof(OIndexBuildStackItem) * ORIOLEDB_MAX_DEPTH);
+	writeBuffer = (BTreeBuildWriteBuffer *) palloc(sizeof(BTreeBuildWriteBuffer));
+	writeBuffer->length = 0;
 	values = (Datum *) palloc(sizeof(Datum) * tupdesc->natts);
 	isnull = (bool *) palloc(sizeof(bool) * tupdesc->natts);
 
@@ -334,7 +345,8 @@ btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
 	while (!O_TUPLE_IS_NULL(idx_tup))
 	{
 		Assert(o_tuple_size(idx_tup, &((OIndexDescr *) desc->arg)->leafSpec) <= O_BTREE_MAX_TUPLE_SIZE);
-		put_tuple_to_stack(desc, stack, idx_tup, &root_level, &metaPageBlkno);
+		put_tuple_to_stack(desc, stack, idx_tup, &root_level, &metaPageBlkno,
+						   writeBuffer);
 		idx_tup = tuplesort_getotuple(sortstate, true);
 	}
 
@@ -353,13 +365,14 @@ btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
 		VALGRIND_CHECK_MEM_IS_DEFINED(stack[i].img, ORIOLEDB_BLCKSZ);
 
 		split_page_by_chunks(desc, stack[i].img);
-		downlink = perform_page_io_build(desc, stack[i].img, &extent, &metaPageBlkno);
+		downlink = perform_page_io_build(desc, stack[i].img, &extent,
+										 &metaPageBlkno, writeBuffer);
 		if (i == 0)
 			pg_atomic_add_fetch_u32(&metaPageBlkno.leafPagesNum, 1);
 
 		put_downlink_to_stack(desc, stack, i + 1, downlink,
 							  stack[i].key.tuple, stack[i].keysize,
-							  &root_level, &metaPageBlkno);
+							  &root_level, &metaPageBlkno, writeBuffer);
 	}
 
 	root_page = stack[root_level].img;
@@ -385,11 +398,14 @@ btree_write_index_data(BTreeDescr *desc, TupleDesc tupdesc,
 	VALGRIND_CHECK_MEM_IS_DEFINED(root_page, ORIOLEDB_BLCKSZ);
 
 	split_page_by_chunks(desc, root_page);
-	downlink = perform_page_io_build(desc, root_page, &extent, &metaPageBlkno);
+	downlink = perform_page_io_build(desc, root_page, &extent,
+									 &metaPageBlkno, writeBuffer);
 	if (root_level == 0)
 		pg_atomic_add_fetch_u32(&metaPageBlkno.leafPagesNum, 1);
 
+	btree_build_flush_writes(desc, writeBuffer);
 	btree_close_smgr(desc);
+	pfree(writeBuffer);
 	pfree(stack);
 
 	if (orioledb_s3_mode)
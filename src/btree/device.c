@@ -0,0 +1,557 @@
+/*-------------------------------------------------------------------------
+ *
+ * device.c
+ *		Raw devices of the block device mode.
+ *
+ * orioledb.device_filename lists one or more devices of
+ * orioledb.device_length each.  The data file offsets form a single address
+ * space striped across the devices by orioledb.device_stripe_size: the
+ * stripe number N of the address space lives on the device N % count.  With
+ * a single device, the mapping is the identity.
+ *
+ * Every device has its own file descriptor, so the kernel keeps a separate
+ * queue for each of them, and its own allocation pointer.  The new extents
+ * go to the device with the fewest I/O operations in flight and then with
+ * the least allocated space, so that the load spreads over the devices
+ * instead of filling them in order.  The extents never cross the stripe
+ * boundary, so any extent is contiguous on its device.
+ *
+ * The checkpoint stores the length of the address space covering the
+ * allocated space of all the devices.  After the restart, every device
+ * continues from its share of that length.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/device.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "orioledb.h"
+
+#include "btree/device.h"
+#include "btree/uring.h"
+#include "checkpoint/checkpoint.h"
+
+#include "funcapi.h"
+#include "pgstat.h"
+#include "storage/fd.h"
+#include "utils/builtins.h"
+#include "utils/tuplestore.h"
+#include "utils/varlena.h"
+
+typedef struct
+{
+	/* allocated bytes of the device */
+	pg_atomic_uint64 allocated;
+	pg_atomic_uint32 inflight;
+	pg_atomic_uint64 reads;
+	pg_atomic_uint64 readBytes;
+	pg_atomic_uint64 writes;
+	pg_atomic_uint64 writtenBytes;
+} ODeviceState;
+
+int			o_devices_count = 0;
+
+static char *deviceNames[O_DEVICES_MAX_COUNT];
+static int	deviceFds[O_DEVICES_MAX_COUNT];
+static Pointer deviceMmaps[O_DEVICES_MAX_COUNT];
+static uint64 stripeSize = 0;
+static ODeviceState *deviceStates = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_device_stats);
+
+/*
+ * Opens the devices listed in orioledb.device_filename.  Called from
+ * _PG_init(), so the backends inherit the descriptors.
+ */
+void
+o_devices_open(void)
+{
+	char	   *rawNames;
+	List	   *names;
+	ListCell   *lc;
+
+	use_device = false;
+	if (!device_filename)
+	{
+		use_mmap = false;
+		return;
+	}
+
+	device_length = (Size) device_length_guc * BLCKSZ;
+	stripeSize = (uint64) device_stripe_size_guc * BLCKSZ;
+
+	rawNames = pstrdup(device_filename);
+	if (!SplitDirectoriesString(rawNames, ',', &names))
+	{
+		elog(LOG, "invalid list syntax in orioledb.device_filename");
+		use_mmap = false;
+		return;
+	}
+	if (list_length(names) > O_DEVICES_MAX_COUNT)
+	{
+		elog(LOG, "orioledb.device_filename lists more than %d devices",
+			 O_DEVICES_MAX_COUNT);
+		use_mmap = false;
+		return;
+	}
+
+	foreach(lc, names)
+	{
+		char	   *name = (char *) lfirst(lc);
+		int			fd;
+
+		fd = BasicOpenFile(name, O_RDWR);
+		if (fd < 0)
+		{
+			elog(LOG, "can't open device file %s", name);
+			break;
+		}
+		deviceNames[o_devices_count] = MemoryContextStrdup(TopMemoryContext,
+														   name);
+		deviceFds[o_devices_count] = fd;
+		deviceMmaps[o_devices_count] = NULL;
+		if (use_mmap)
+		{
+			Pointer		data;
+
+			data = mmap(NULL, device_length, PROT_READ | PROT_WRITE,
+						MAP_FILE | MAP_SHARED, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				elog(LOG, "can't map device file %s", name);
+				use_mmap = false;
+			}
+			else
+				deviceMmaps[o_devices_count] = data;
+		}
+		o_devices_count++;
+	}
+
+	/* All the devices are needed to address the data */
+	if (o_devices_count < list_length(names))
+	{
+		while (o_devices_count > 0)
+			close(deviceFds[--o_devices_count]);
+	}
+
+	use_device = (o_devices_count > 0);
+	if (!use_device)
+		use_mmap = false;
+}
+
+Size
+o_devices_shmem_needs(void)
+{
+	return mul_size(O_DEVICES_MAX_COUNT, sizeof(ODeviceState));
+}
+
+void
+o_devices_shmem_init(Pointer ptr, bool found)
+{
+	deviceStates = (ODeviceState *) ptr;
+
+	if (!found)
+	{
+		uint64		length = pg_atomic_read_u64(&checkpoint_state->mmapDataLength);
+		int			i;
+
+		for (i = 0; i < O_DEVICES_MAX_COUNT; i++)
+		{
+			ODeviceState *state = &deviceStates[i];
+			uint64		allocated = 0;
+
+			if (o_devices_count == 1)
+				allocated = length;
+			else if (i < o_devices_count)
+				allocated = length / o_devices_count;
+
+			pg_atomic_init_u64(&state->allocated, allocated);
+			pg_atomic_init_u32(&state->inflight, 0);
+			pg_atomic_init_u64(&state->reads, 0);
+			pg_atomic_init_u64(&state->readBytes, 0);
+			pg_atomic_init_u64(&state->writes, 0);
+			pg_atomic_init_u64(&state->writtenBytes, 0);
+		}
+	}
+}
+
+/*
+ * Maps the offset in the address space to the device and the offset on the
+ * device.  Returns the number of bytes contiguous on the device, at most
+ * 'amount'.
+ */
+static int
+o_device_map(off_t offset, int amount, int *devnum, off_t *devoff)
+{
+	uint64		stripe,
+				left;
+
+	if (o_devices_count == 1)
+	{
+		*devnum = 0;
+		*devoff = offset;
+		return amount;
+	}
+
+	stripe = (uint64) offset / stripeSize;
+	*devnum = stripe % o_devices_count;
+	*devoff = (stripe / o_devices_count) * stripeSize + offset % stripeSize;
+	left = stripeSize - offset % stripeSize;
+	return (int) Min((uint64) amount, left);
+}
+
+/*
+ * Returns the offset in the address space of the offset on the device.
+ */
+static uint64
+o_device_unmap(int devnum, uint64 devoff)
+{
+	if (o_devices_count == 1)
+		return devoff;
+
+	return ((devoff / stripeSize) * o_devices_count + devnum) * stripeSize +
+		devoff % stripeSize;
+}
+
+/*
+ * Picks the device for the new extent: the fewest I/O operations in flight,
+ * then the least allocated space.
+ */
+static int
+o_device_choose(uint32 size, uint32 excluded)
+{
+	int			i,
+				result = -1;
+	uint32		bestInflight = 0;
+	uint64		bestAllocated = 0;
+
+	for (i = 0; i < o_devices_count; i++)
+	{
+		ODeviceState *state = &deviceStates[i];
+		uint32		inflight;
+		uint64		allocated;
+
+		if (excluded & (1U << i))
+			continue;
+
+		inflight = pg_atomic_read_u32(&state->inflight);
+		allocated = pg_atomic_read_u64(&state->allocated);
+		if (allocated + size > device_length)
+			continue;
+
+		if (result < 0 || inflight < bestInflight ||
+			(inflight == bestInflight && allocated < bestAllocated))
+		{
+			result = i;
+			bestInflight = inflight;
+			bestAllocated = allocated;
+		}
+	}
+	return result;
+}
+
+/*
+ * Allocates 'size' bytes of the device space.  Returns the offset in the
+ * address space.
+ */
+uint64
+orioledb_device_alloc(struct BTreeDescr *descr, uint32 size)
+{
+	uint32		excluded = 0;
+
+	Assert(size <= stripeSize || o_devices_count == 1);
+
+	while (true)
+	{
+		int			devnum = o_device_choose(size, excluded);
+		ODeviceState *state;
+		uint64		cur,
+					start;
+
+		if (devnum < 0)
+			elog(ERROR, "device file overflow");
+
+		state = &deviceStates[devnum];
+		cur = pg_atomic_read_u64(&state->allocated);
+		while (true)
+		{
+			start = cur;
+
+			/* Don't let the extent cross the stripe boundary */
+			if (o_devices_count > 1 && start % stripeSize + size > stripeSize)
+				start = (start / stripeSize + 1) * stripeSize;
+			if (start + size > device_length)
+				break;
+			if (pg_atomic_compare_exchange_u64(&state->allocated, &cur,
+											   start + size))
+				return o_device_unmap(devnum, start);
+		}
+		excluded |= 1U << devnum;
+	}
+}
+
+/*
+ * Returns the length of the address space covering the allocated space of
+ * all the devices.  Saved by the checkpoint.
+ */
+uint64
+o_devices_data_length(void)
+{
+	uint64		rows = 0;
+	int			i;
+
+	if (!use_device)
+		return pg_atomic_read_u64(&checkpoint_state->mmapDataLength);
+
+	if (o_devices_count == 1)
+		return pg_atomic_read_u64(&deviceStates[0].allocated);
+
+	for (i = 0; i < o_devices_count; i++)
+	{
+		uint64		allocated = pg_atomic_read_u64(&deviceStates[i].allocated);
+
+		rows = Max(rows, (allocated + stripeSize - 1) / stripeSize);
+	}
+	return rows * stripeSize * o_devices_count;
+}
+
+int
+o_device_fd(int devnum)
+{
+	Assert(devnum >= 0 && devnum < o_devices_count);
+	return deviceFds[devnum];
+}
+
+void
+o_device_io_start(int devnum)
+{
+	pg_atomic_fetch_add_u32(&deviceStates[devnum].inflight, 1);
+}
+
+/*
+ * Accounts the completed I/O operation on the device.
+ */
+void
+o_device_io_done(int devnum, bool write, ssize_t amount)
+{
+	ODeviceState *state = &deviceStates[devnum];
+
+	pg_atomic_fetch_sub_u32(&state->inflight, 1);
+	if (write)
+	{
+		pg_atomic_fetch_add_u64(&state->writes, 1);
+		if (amount > 0)
+			pg_atomic_fetch_add_u64(&state->writtenBytes, amount);
+	}
+	else
+	{
+		pg_atomic_fetch_add_u64(&state->reads, 1);
+		if (amount > 0)
+			pg_atomic_fetch_add_u64(&state->readBytes, amount);
+	}
+}
+
+int
+o_device_read(char *buffer, int amount, off_t offset)
+{
+	int			total = 0;
+
+	while (total < amount)
+	{
+		int			devnum,
+					len,
+					result;
+		off_t		devoff;
+
+		len = o_device_map(offset + total, amount - total, &devnum, &devoff);
+		Assert(devoff + len <= device_length);
+		if (use_mmap)
+		{
+			memcpy(buffer + total, deviceMmaps[devnum] + devoff, len);
+			total += len;
+			continue;
+		}
+
+		o_device_io_start(devnum);
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_READ);
+		result = pg_pread(deviceFds[devnum], buffer + total, len, devoff);
+		pgstat_report_wait_end();
+		o_device_io_done(devnum, false, result);
+		if (result < 0)
+			return result;
+		total += result;
+		if (result < len)
+			break;
+	}
+	return total;
+}
+
+int
+o_device_write(char *buffer, int amount, off_t offset)
+{
+	int			total = 0;
+
+	while (total < amount)
+	{
+		int			devnum,
+					len,
+					result;
+		off_t		devoff;
+
+		len = o_device_map(offset + total, amount - total, &devnum, &devoff);
+		Assert(devoff + len <= device_length);
+		if (use_mmap)
+		{
+			memcpy(deviceMmaps[devnum] + devoff, buffer + total, len);
+			total += len;
+			continue;
+		}
+
+		if (o_uring_write_active())
+		{
+			/* The device number is passed as a non-positive file */
+			o_uring_write(-devnum, buffer + total, len, devoff);
+			total += len;
+			continue;
+		}
+
+		o_device_io_start(devnum);
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_WRITE);
+		result = pg_pwrite(deviceFds[devnum], buffer + total, len, devoff);
+		pgstat_report_wait_end();
+		o_device_io_done(devnum, true, result);
+		if (result < 0)
+			return result;
+		total += result;
+		if (result < len)
+			break;
+	}
+	return total;
+}
+
+/*
+ * Asks the kernel to start reading the given range.
+ */
+void
+o_device_prefetch(off_t offset, int amount)
+{
+	while (amount > 0)
+	{
+		int			devnum,
+					len;
+		off_t		devoff;
+
+		len = o_device_map(offset, amount, &devnum, &devoff);
+		Assert(devoff + len <= device_length);
+		if (use_mmap)
+		{
+			off_t		start = TYPEALIGN_DOWN(BLCKSZ, devoff);
+
+			(void) madvise(deviceMmaps[devnum] + start, devoff + len - start,
+						   MADV_WILLNEED);
+		}
+#ifdef USE_POSIX_FADVISE
+		else
+			(void) posix_fadvise(deviceFds[devnum], devoff, len,
+								 POSIX_FADV_WILLNEED);
+#endif
+		offset += len;
+		amount -= len;
+	}
+}
+
+/*
+ * Starts the writeback of the given range of the mapped devices.
+ */
+void
+o_device_writeback(off_t offset, int amount)
+{
+	if (!use_mmap)
+		return;
+
+	while (amount > 0)
+	{
+		int			devnum,
+					len;
+		off_t		devoff,
+					start;
+
+		len = o_device_map(offset, amount, &devnum, &devoff);
+		Assert(devoff + len <= device_length);
+		start = TYPEALIGN_DOWN(sysconf(_SC_PAGESIZE), devoff);
+		msync(deviceMmaps[devnum] + start, devoff + len - start, MS_ASYNC);
+		offset += len;
+		amount -= len;
+	}
+}
+
+/*
+ * Synchronously writes the mapped devices.
+ */
+void
+o_devices_sync(void)
+{
+	int			i;
+
+	for (i = 0; i < o_devices_count; i++)
+	{
+		if (deviceMmaps[i])
+			msync(deviceMmaps[i], device_length, MS_SYNC);
+	}
+}
+
+/*
+ * Reports the space and the I/O of every device.
+ */
+Datum
+orioledb_device_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			i;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	for (i = 0; i < o_devices_count; i++)
+	{
+		ODeviceState *state = &deviceStates[i];
+		Datum		values[9];
+		bool		nulls[9] = {false};
+
+		values[0] = Int32GetDatum(i);
+		values[1] = CStringGetTextDatum(deviceNames[i]);
+		values[2] = Int64GetDatum((int64) device_length);
+		values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&state->allocated));
+		values[4] = Int32GetDatum((int32) pg_atomic_read_u32(&state->inflight));
+		values[5] = Int64GetDatum((int64) pg_atomic_read_u64(&state->reads));
+		values[6] = Int64GetDatum((int64) pg_atomic_read_u64(&state->readBytes));
+		values[7] = Int64GetDatum((int64) pg_atomic_read_u64(&state->writes));
+		values[8] = Int64GetDatum((int64) pg_atomic_read_u64(&state->writtenBytes));
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return (Datum) 0;
+}
@@ -31,6 +31,23 @@
 
 #include "catalog/pg_opclass_d.h"
 #include "commands/defrem.h"
+#include "utils/uuid.h"
+
+/*
+ * Vectorized variants of the array search functions.  x86-64 kernels are
+ * compiled with per-function target attributes and chosen at runtime
+ * according to CPU features.  NEON is mandatory on AArch64, so its kernels
+ * are always used there.
+ */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define USE_FASTPATH_X86_SIMD 1
+#include <cpuid.h>
+#include <immintrin.h>
+#define FASTPATH_TARGET(x) __attribute__((target(x)))
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define USE_FASTPATH_NEON 1
+#include <arm_neon.h>
+#endif
 
 typedef struct
 {
@@ -60,16 +77,53 @@ static void float8_array_search(Pointer p, int stride, int *lower,
 								int *upper, Datum keyDatum);
 static void tid_array_search(Pointer p, int stride, int *lower,
 							 int *upper, Datum keyDatum);
+static void uuid_array_search(Pointer p, int stride, int *lower,
+							  int *upper, Datum keyDatum);
+static void choose_array_search_funcs(void);
+
+#ifdef USE_FASTPATH_X86_SIMD
+static void oid_array_search_avx2(Pointer p, int stride, int *lower,
+								  int *upper, Datum keyDatum);
+static void int4_array_search_avx2(Pointer p, int stride, int *lower,
+								   int *upper, Datum keyDatum);
+static void int8_array_search_avx2(Pointer p, int stride, int *lower,
+								   int *upper, Datum keyDatum);
+static void oid_array_search_avx512(Pointer p, int stride, int *lower,
+									int *upper, Datum keyDatum);
+static void int4_array_search_avx512(Pointer p, int stride, int *lower,
+									 int *upper, Datum keyDatum);
+static void int8_array_search_avx512(Pointer p, int stride, int *lower,
+									 int *upper, Datum keyDatum);
+#endif
+#ifdef USE_FASTPATH_NEON
+static void oid_array_search_neon(Pointer p, int stride, int *lower,
+								  int *upper, Datum keyDatum);
+static void int4_array_search_neon(Pointer p, int stride, int *lower,
+								   int *upper, Datum keyDatum);
+static void int8_array_search_neon(Pointer p, int stride, int *lower,
+								   int *upper, Datum keyDatum);
+#endif
 
+/*
+ * Date, timestamp and timestamptz are stored as plain integers ordered the
+ * same way as the values, so they share the integer search functions.  Uuid
+ * is stored as bytes ordered by memcmp().
+ */
 ArraySearchDesc arraySearchDescs[] = {
 	{OIDOID, OID_BTREE_OPS_OID, sizeof(Oid), ALIGNOF_INT, oid_array_search},
 	{INT4OID, INT4_BTREE_OPS_OID, sizeof(int32), ALIGNOF_INT, int4_array_search},
 	{INT8OID, INT8_BTREE_OPS_OID, sizeof(int64), ALIGNOF_DOUBLE, int8_array_search},
 	{FLOAT4OID, InvalidOid, sizeof(float4), ALIGNOF_INT, float4_array_search},
 	{FLOAT8OID, FLOAT8_BTREE_OPS_OID, sizeof(float8), ALIGNOF_DOUBLE, float8_array_search},
-	{TIDOID, InvalidOid, sizeof(ItemPointerData), ALIGNOF_SHORT, tid_array_search}
+	{TIDOID, InvalidOid, sizeof(ItemPointerData), ALIGNOF_SHORT, tid_array_search},
+	{DATEOID, InvalidOid, sizeof(int32), ALIGNOF_INT, int4_array_search},
+	{TIMESTAMPOID, InvalidOid, sizeof(int64), ALIGNOF_DOUBLE, int8_array_search},
+	{TIMESTAMPTZOID, InvalidOid, sizeof(int64), ALIGNOF_DOUBLE, int8_array_search},
+	{UUIDOID, InvalidOid, UUID_LEN, 1, uuid_array_search}
 };
 
+static bool arraySearchFuncsChosen = false;
+
 /*
  * Checks if the "fast path" the navigation can be applied to the given search
  * and fills *meta structure if so.
@@ -115,10 +169,11 @@ can_fastpath_find_downlink(OBTreeFindPageContext *context,
 	offset = 0;
 	for (i = 0; i < meta->numKeys; i++)
 	{
-		ArraySearchDesc *desc = find_array_search_desc_by_typeid(id->nonLeafTupdesc->attrs[0].atttypid);
+		ArraySearchDesc *desc = find_array_search_desc_by_typeid(TupleDescAttr(id->nonLeafTupdesc, i)->atttypid);
 		OIndexField *field = &id->fields[i];
 
-		if (!desc || desc->opcid != field->opclass)
+		/* The search functions expect the values in the ascending order */
+		if (!desc || desc->opcid != field->opclass || !field->ascending)
 		{
 			meta->enabled = false;
 			return;
@@ -149,6 +204,9 @@ find_array_search_desc_by_typeid(Oid typeid)
 {
 	int			i;
 
+	if (!arraySearchFuncsChosen)
+		choose_array_search_funcs();
+
 	for (i = 0; i < sizeof(arraySearchDescs) / sizeof(ArraySearchDesc); i++)
 	{
 		if (arraySearchDescs[i].typeid == typeid)
@@ -198,6 +256,17 @@ find_downlink_get_keys(BTreeDescr *desc, void *key, BTreeKeyType keyType,
 		OBTreeKeyBound *bound = (OBTreeKeyBound *) key;
 		int			num = Min(numValues, bound->nkeys);
 
+		/*
+		 * Keys, which are not specified in the bound, can't narrow the
+		 * search.  Place the search to the beginning of the range of equal
+		 * values for the lower bound and to the end otherwise.
+		 */
+		for (i = num; i < numValues; i++)
+		{
+			flags[i] = (keyType == BTreeKeyUniqueUpperBound) ? FASTPATH_FIND_DOWNLINK_FLAG_PLUS_INF : FASTPATH_FIND_DOWNLINK_FLAG_MINUS_INF;
+			values[i] = (Datum) 0;
+		}
+
 		for (i = 0; i < num; i++)
 		{
 			uint8		f = bound->keys[i].flags;
@@ -704,3 +773,492 @@ tid_array_search(Pointer p, int stride, int *lower, int *upper, Datum keyDatum)
 	if (!lowerSet)
 		*lower = *upper;
 }
+
+static void
+uuid_array_search(Pointer p, int stride, int *lower, int *upper, Datum keyDatum)
+{
+	int			i;
+	bool		lowerSet = false;
+	Pointer		key = DatumGetPointer(keyDatum);
+
+	p += *lower * stride;
+
+	for (i = *lower; i < *upper; i++)
+	{
+		int			cmp = memcmp(p, key, UUID_LEN);
+
+		if (cmp == 0 && !lowerSet)
+		{
+			*lower = i;
+			lowerSet = true;
+		}
+		else if (cmp > 0)
+		{
+			if (!lowerSet)
+				*lower = i;
+			*upper = i;
+			return;
+		}
+
+		p += stride;
+	}
+	if (!lowerSet)
+		*lower = *upper;
+}
+
+/*
+ * Replaces the scalar search function with its vectorized variant for all
+ * the types using it.
+ */
+static inline void
+set_array_search_func(ArraySearchFunc scalar, ArraySearchFunc func)
+{
+	int			i;
+
+	for (i = 0; i < sizeof(arraySearchDescs) / sizeof(ArraySearchDesc); i++)
+	{
+		if (arraySearchDescs[i].func == scalar)
+			arraySearchDescs[i].func = func;
+	}
+}
+
+#ifdef USE_FASTPATH_X86_SIMD
+
+/*
+ * Check if CPU and OS support the given XSAVE-managed register state.  We
+ * must check the OS support in addition to the CPUID bits, because OS might
+ * not save the wide registers on context switch.
+ */
+static bool
+xsave_state_enabled(uint32 mask)
+{
+	unsigned int eax,
+				ebx,
+				ecx,
+				edx;
+	uint32		xcr0_lo,
+				xcr0_hi;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE))
+		return false;
+
+	__asm__ __volatile__("xgetbv":"=a"(xcr0_lo), "=d"(xcr0_hi):"c"(0));
+
+	return (xcr0_lo & mask) == mask;
+}
+
+static bool
+cpu_has_avx2(void)
+{
+	unsigned int eax,
+				ebx,
+				ecx,
+				edx;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+
+	/* XMM and YMM state */
+	return (ebx & bit_AVX2) && xsave_state_enabled(0x06);
+}
+
+static bool
+cpu_has_avx512(void)
+{
+	unsigned int eax,
+				ebx,
+				ecx,
+				edx;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+
+	/* XMM, YMM, opmask and ZMM state */
+	return (ebx & bit_AVX512F) && xsave_state_enabled(0xE6);
+}
+
+#endif
+
+/*
+ * Chooses the best available implementations of the array search functions.
+ * Called once per backend before the first lookup of the search descriptor.
+ */
+static void
+choose_array_search_funcs(void)
+{
+#if defined(USE_FASTPATH_X86_SIMD)
+	if (cpu_has_avx512())
+	{
+		set_array_search_func(oid_array_search, oid_array_search_avx512);
+		set_array_search_func(int4_array_search, int4_array_search_avx512);
+		set_array_search_func(int8_array_search, int8_array_search_avx512);
+	}
+	else if (cpu_has_avx2())
+	{
+		set_array_search_func(oid_array_search, oid_array_search_avx2);
+		set_array_search_func(int4_array_search, int4_array_search_avx2);
+		set_array_search_func(int8_array_search, int8_array_search_avx2);
+	}
+#elif defined(USE_FASTPATH_NEON)
+	set_array_search_func(oid_array_search, oid_array_search_neon);
+	set_array_search_func(int4_array_search, int4_array_search_neon);
+	set_array_search_func(int8_array_search, int8_array_search_neon);
+#endif
+	arraySearchFuncsChosen = true;
+}
+
+/*
+ * The vectorized functions below don't look for the boundaries one by one.
+ * Instead, given the array is sorted, they count the elements which are less
+ * than the key and the elements which are less or equal to the key.  These
+ * counts give new *lower and *upper correspondingly.  That is branch-free
+ * within the block of elements.  Once the block contains element greater than
+ * the key, the rest of array can't contain less or equal elements, so we
+ * stop.  The tail shorter than vector width is processed by the scalar loop.
+ *
+ * The array is strided, so elements are loaded using gather instructions
+ * (or lane-by-lane on NEON), which never touch memory outside the items.
+ */
+#define ARRAY_SEARCH_SCALAR_TAIL(type, getkey) \
+	do { \
+		type		tailKey = getkey(keyDatum); \
+		for (; i < end; i++) \
+		{ \
+			type		value = *((type *) (p + i * stride)); \
+			if (value > tailKey) \
+				break; \
+			if (value < tailKey) \
+				less++; \
+			lessOrEqual++; \
+		} \
+	} while (0)
+
+#define ARRAY_SEARCH_SET_RESULT() \
+	do { \
+		*upper = *lower + lessOrEqual; \
+		*lower = *lower + less; \
+	} while (0)
+
+#ifdef USE_FASTPATH_X86_SIMD
+
+FASTPATH_TARGET("avx2")
+static void
+int4_array_search_avx2(Pointer p, int stride, int *lower, int *upper,
+					   Datum keyDatum)
+{
+	int			i = *lower,
+				end = *upper;
+	int			less = 0,
+				lessOrEqual = 0;
+	__m256i		key = _mm256_set1_epi32(DatumGetInt32(keyDatum));
+	__m256i		offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+											 _mm256_set1_epi32(stride));
+
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256i		values = _mm256_i32gather_epi32((const int *) (p + i * stride),
+													offsets, 1);
+		uint32		ltMask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(key, values)));
+		uint32		gtMask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(values, key)));
+
+		less += __builtin_popcount(ltMask);
+		lessOrEqual += 8 - __builtin_popcount(gtMask);
+		if (gtMask != 0)
+		{
+			ARRAY_SEARCH_SET_RESULT();
+			return;
+		}
+	}
+
+	ARRAY_SEARCH_SCALAR_TAIL(int32, DatumGetInt32);
+	ARRAY_SEARCH_SET_RESULT();
+}
+
+FASTPATH_TARGET("avx2")
+static void
+oid_array_search_avx2(Pointer p, int stride, int *lower, int *upper,
+					  Datum keyDatum)
+{
+	int			i = *lower,
+				end = *upper;
+	int			less = 0,
+				lessOrEqual = 0;
+	/* AVX2 has only signed comparison, so flip the sign bit first */
+	__m256i		bias = _mm256_set1_epi32((int32) 0x80000000);
+	__m256i		key = _mm256_xor_si256(_mm256_set1_epi32((int32) DatumGetObjectId(keyDatum)),
+									   bias);
+	__m256i		offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+											 _mm256_set1_epi32(stride));
+
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256i		values = _mm256_xor_si256(_mm256_i32gather_epi32((const int *) (p + i * stride),
+																	 offsets, 1),
+											  bias);
+		uint32		ltMask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(key, values)));
+		uint32		gtMask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(values, key)));
+
+		less += __builtin_popcount(ltMask);
+		lessOrEqual += 8 - __builtin_popcount(gtMask);
+		if (gtMask != 0)
+		{
+			ARRAY_SEARCH_SET_RESULT();
+			return;
+		}
+	}
+
+	ARRAY_SEARCH_SCALAR_TAIL(Oid, DatumGetObjectId);
+	ARRAY_SEARCH_SET_RESULT();
+}
+
+FASTPATH_TARGET("avx2")
+static void
+int8_array_search_avx2(Pointer p, int stride, int *lower, int *upper,
+					   Datum keyDatum)
+{
+	int			i = *lower,
+				end = *upper;
+	int			less = 0,
+				lessOrEqual = 0;
+	__m256i		key = _mm256_set1_epi64x(DatumGetInt64(keyDatum));
+	__m128i		offsets = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3),
+										  _mm_set1_epi32(stride));
+
+	for (; i + 4 <= end; i += 4)
+	{
+		__m256i		values = _mm256_i32gather_epi64((const long long *) (p + i * stride),
+													offsets, 1);
+		uint32		ltMask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(key, values)));
+		uint32		gtMask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(values, key)));
+
+		less += __builtin_popcount(ltMask);
+		lessOrEqual += 4 - __builtin_popcount(gtMask);
+		if (gtMask != 0)
+		{
+			ARRAY_SEARCH_SET_RESULT();
+			return;
+		}
+	}
+
+	ARRAY_SEARCH_SCALAR_TAIL(int64, DatumGetInt64);
+	ARRAY_SEARCH_SET_RESULT();
+}
+
+FASTPATH_TARGET("avx512f")
+static void
+int4_array_search_avx512(Pointer p, int stride, int *lower, int *upper,
+						 Datum keyDatum)
+{
+	int			i = *lower,
+				end = *upper;
+	int			less = 0,
+				lessOrEqual = 0;
+	__m512i		key = _mm512_set1_epi32(DatumGetInt32(keyDatum));
+	__m512i		offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+															   8, 9, 10, 11, 12, 13, 14, 15),
+											 _mm512_set1_epi32(stride));
+
+	for (; i + 16 <= end; i += 16)
+	{
+		__m512i		values = _mm512_i32gather_epi32(offsets, (const void *) (p + i * stride), 1);
+		__mmask16	ltMask = _mm512_cmplt_epi32_mask(values, key);
+		__mmask16	gtMask = _mm512_cmpgt_epi32_mask(values, key);
+
+		less += __builtin_popcount((uint32) ltMask);
+		lessOrEqual += 16 - __builtin_popcount((uint32) gtMask);
+		if (gtMask != 0)
+		{
+			ARRAY_SEARCH_SET_RESULT();
+			return;
+		}
+	}
+
+	ARRAY_SEARCH_SCALAR_TAIL(int32, DatumGetInt32);
+	ARRAY_SEARCH_SET_RESULT();
+}
+
+FASTPATH_TARGET("avx512f")
+static void
+oid_array_search_avx512(Pointer p, int stride, int *lower, int *upper,
+						Datum keyDatum)
+{
+	int			i = *lower,
+				end = *upper;
+	int			less = 0,
+				lessOrEqual = 0;
+	__m512i		key = _mm512_set1_epi32((int32) DatumGetObjectId(keyDatum));
+	__m512i		offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+															   8, 9, 10, 11, 12, 13, 14, 15),
+											 _mm512_set1_epi32(stride));
+
+	for (; i + 16 <= end; i += 16)
+	{
+		__m512i		values = _mm512_i32gather_epi32(offsets, (const void *) (p + i * stride), 1);
+		__mmask16	ltMask = _mm512_cmplt_epu32_mask(values, key);
+		__mmask16	gtMask = _mm512_cmpgt_epu32_mask(values, key);
+
+		less += __builtin_popcount((uint32) ltMask);
+		lessOrEqual += 16 - __builtin_popcount((uint32) gtMask);
+		if (gtMask != 0)
+		{
+			ARRAY_SEARCH_SET_RESULT();
+			return;
+		}
+	}
+
+	ARRAY_SEARCH_SCALAR_TAIL(Oid, DatumGetObjectId);
+	ARRAY_SEARCH_SET_RESULT();
+}
+
+FASTPATH_TARGET("avx512f")
+static void
+int8_array_search_avx512(Pointer p, int stride, int *lower, int *upper,
+						 Datum keyDatum)
+{
+	int			i = *lower,
+				end = *upper;
+	int			less = 0,
+				lessOrEqual = 0;
+	__m512i		key = _mm512_set1_epi64(DatumGetInt64(keyDatum));
+	__m256i		offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+											 _mm256_set1_epi32(stride));
+
+	for (; i + 8 <= end; i += 8)
+	{
+		__m512i		values = _mm512_i32gather_epi64(offsets, (const void *) (p + i * stride), 1);
+		__mmask8	ltMask = _mm512_cmplt_epi64_mask(values, key);
+		__mmask8	gtMask = _mm512_cmpgt_epi64_mask(values, key);
+
+		less += __builtin_popcount((uint32) ltMask);
+		lessOrEqual += 8 - __builtin_popcount((uint32) gtMask);
+		if (gtMask != 0)
+		{
+			ARRAY_SEARCH_SET_RESULT();
+			return;
+		}
+	}
+
+	ARRAY_SEARCH_SCALAR_TAIL(int64, DatumGetInt64);
+	ARRAY_SEARCH_SET_RESULT();
+}
+
+#endif							/* USE_FASTPATH_X86_SIMD */
+
+#ifdef USE_FASTPATH_NEON
+
+static void
+int4_array_search_neon(Pointer p, int stride, int *lower, int *upper,
+					   Datum keyDatum)
+{
+	int			i = *lower,
+				end = *upper;
+	int			less = 0,
+				lessOrEqual = 0;
+	int32x4_t	key = vdupq_n_s32(DatumGetInt32(keyDatum));
+
+	for (; i + 4 <= end; i += 4)
+	{
+		Pointer		ptr = p + i * stride;
+		int32		buf[4];
+		int32x4_t	values;
+		uint32		lt,
+					gt;
+
+		buf[0] = *((int32 *) ptr);
+		buf[1] = *((int32 *) (ptr + stride));
+		buf[2] = *((int32 *) (ptr + 2 * stride));
+		buf[3] = *((int32 *) (ptr + 3 * stride));
+		values = vld1q_s32(buf);
+		lt = vaddvq_u32(vshrq_n_u32(vcltq_s32(values, key), 31));
+		gt = vaddvq_u32(vshrq_n_u32(vcgtq_s32(values, key), 31));
+
+		less += lt;
+		lessOrEqual += 4 - gt;
+		if (gt != 0)
+		{
+			ARRAY_SEARCH_SET_RESULT();
+			return;
+		}
+	}
+
+	ARRAY_SEARCH_SCALAR_TAIL(int32, DatumGetInt32);
+	ARRAY_SEARCH_SET_RESULT();
+}
+
+static void
+oid_array_search_neon(Pointer p, int stride, int *lower, int *upper,
+					  Datum keyDatum)
+{
+	int			i = *lower,
+				end = *upper;
+	int			less = 0,
+				lessOrEqual = 0;
+	uint32x4_t	key = vdupq_n_u32(DatumGetObjectId(keyDatum));
+
+	for (; i + 4 <= end; i += 4)
+	{
+		Pointer		ptr = p + i * stride;
+		uint32		buf[4];
+		uint32x4_t	values;
+		uint32		lt,
+					gt;
+
+		buf[0] = *((Oid *) ptr);
+		buf[1] = *((Oid *) (ptr + stride));
+		buf[2] = *((Oid *) (ptr + 2 * stride));
+		buf[3] = *((Oid *) (ptr + 3 * stride));
+		values = vld1q_u32(buf);
+		lt = vaddvq_u32(vshrq_n_u32(vcltq_u32(values, key), 31));
+		gt = vaddvq_u32(vshrq_n_u32(vcgtq_u32(values, key), 31));
+
+		less += lt;
+		lessOrEqual += 4 - gt;
+		if (gt != 0)
+		{
+			ARRAY_SEARCH_SET_RESULT();
+			return;
+		}
+	}
+
+	ARRAY_SEARCH_SCALAR_TAIL(Oid, DatumGetObjectId);
+	ARRAY_SEARCH_SET_RESULT();
+}
+
+static void
+int8_array_search_neon(Pointer p, int stride, int *lower, int *upper,
+					   Datum keyDatum)
+{
+	int			i = *lower,
+				end = *upper;
+	int			less = 0,
+				lessOrEqual = 0;
+	int64x2_t	key = vdupq_n_s64(DatumGetInt64(keyDatum));
+
+	for (; i + 2 <= end; i += 2)
+	{
+		Pointer		ptr = p + i * stride;
+		int64		buf[2];
+		int64x2_t	values;
+		uint64		lt,
+					gt;
+
+		buf[0] = *((int64 *) ptr);
+		buf[1] = *((int64 *) (ptr + stride));
+		values = vld1q_s64(buf);
+		lt = vaddvq_u64(vshrq_n_u64(vcltq_s64(values, key), 63));
+		gt = vaddvq_u64(vshrq_n_u64(vcgtq_s64(values, key), 63));
+
+		less += (int) lt;
+		lessOrEqual += 2 - (int) gt;
+		if (gt != 0)
+		{
+			ARRAY_SEARCH_SET_RESULT();
+			return;
+		}
+	}
+
+	ARRAY_SEARCH_SCALAR_TAIL(int64, DatumGetInt64);
+	ARRAY_SEARCH_SET_RESULT();
+}
+
+#endif							/* USE_FASTPATH_NEON */
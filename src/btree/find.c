@@ -21,10 +21,19 @@
 #include "btree/io.h"
 #include "btree/page_chunks.h"
 #include "tableam/descr.h"
+#include "tableam/handler.h"
+#include "utils/op_sampling.h"
 #include "utils/stopevent.h"
+#include "utils/tree_stats.h"
 
 #include "access/transam.h"
 
+/*
+ * Minimal number of chunk items to make skipping of the common key prefix
+ * worth its calculation.
+ */
+#define BTREE_CHUNK_PREFIX_MIN_ITEMS	8
+
 typedef struct
 {
 	OBTreeFindPageContext *context;
@@ -40,6 +49,9 @@ typedef struct
 } OBTreeFindPageInternalContext;
 
 static bool follow_rightlink(OBTreeFindPageInternalContext *intCxt);
+static OFindPageResult find_page_internal(OBTreeFindPageContext *context,
+										  void *key, BTreeKeyType keyType,
+										  uint16 targetLevel, bool resume);
 static void step_upward_level(OBTreeFindPageInternalContext *intCxt);
 static bool btree_find_read_page(OBTreeFindPageContext *context,
 								 OInMemoryBlkno blkno, uint32 pageChangeCount,
@@ -368,6 +380,41 @@ page_find_item(OBTreeFindPageInternalContext *intCxt,
 OFindPageResult
 find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 		  uint16 targetLevel)
+{
+	OpSamplingProcState opSaved;
+	OFindPageResult result;
+
+	opSaved = op_sampling_begin(OpSamplingDescent, context->desc->oids);
+	result = find_page_internal(context, key, keyType, targetLevel, false);
+	op_sampling_end(opSaved);
+	return result;
+}
+
+/*
+ * Locate page for the given key re-using the descent path saved in the
+ * context by the previous find_page() call with the same targetLevel.
+ *
+ * The caller must guarantee the key is greater or equal to the key of the
+ * previous search.  Then the search starts from the previously found page
+ * and climbs up by the saved stack only while the key is beyond the page
+ * hikey.  That saves the most of the descent for a series of close keys.
+ */
+OFindPageResult
+find_page_resume(OBTreeFindPageContext *context, void *key,
+				 BTreeKeyType keyType, uint16 targetLevel)
+{
+	OpSamplingProcState opSaved;
+	OFindPageResult result;
+
+	opSaved = op_sampling_begin(OpSamplingDescent, context->desc->oids);
+	result = find_page_internal(context, key, keyType, targetLevel, true);
+	op_sampling_end(opSaved);
+	return result;
+}
+
+static OFindPageResult
+find_page_internal(OBTreeFindPageContext *context, void *key,
+				   BTreeKeyType keyType, uint16 targetLevel, bool resume)
 {
 	BTreeDescr *desc = context->desc;
 	OBTreeFindPageInternalContext intCxt;
@@ -381,7 +428,8 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 				noFixFlag PG_USED_FOR_ASSERTS_ONLY = BTREE_PAGE_FIND_IS(context, NO_FIX_SPLIT),
 				keepLokeyFlag = BTREE_PAGE_FIND_IS(context, KEEP_LOKEY),
 				downlinkLocationFlag = BTREE_PAGE_FIND_IS(context, DOWNLINK_LOCATION);
-	bool		shmemIsReloaded = false;
+	bool		shmemIsReloaded = false,
+				pageLoaded = false;
 	FastpathFindDownlinkMeta fastpathMeta;
 	Jsonb	   *params = NULL;
 
@@ -408,6 +456,8 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 		   || (!imageFlag && fetchFlag && !modifyFlag && !keepLokeyFlag)
 		   || (!imageFlag && !fetchFlag && modifyFlag && !keepLokeyFlag));
 	Assert(!(COMMITSEQNO_IS_NORMAL(context->csn) && modifyFlag));
+	Assert(!resume || (fetchFlag && keyType != BTreeKeyNone &&
+					   keyType != BTreeKeyRightmost));
 
 	/* resets the context before start */
 	if (BTREE_PAGE_FIND_IS(context, KEEP_LOKEY))
@@ -418,11 +468,24 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 	}
 	context->imgUndoLoc = InvalidUndoLocation;
 	context->partial.isPartial = false;
-	context->index = 0;
 
-	/* starts from the rootPageBlkno */
-	intCxt.blkno = desc->rootInfo.rootPageBlkno;
-	intCxt.pageChangeCount = desc->rootInfo.rootPageChangeCount;
+	if (resume)
+	{
+		/*
+		 * Starts from the previously found page.  follow_rightlink() steps
+		 * us upward by the saved stack if the key is beyond the page hikey,
+		 * while changed pages are re-found from their parents.
+		 */
+		intCxt.blkno = context->items[context->index].blkno;
+		intCxt.pageChangeCount = context->items[context->index].pageChangeCount;
+	}
+	else
+	{
+		/* starts from the rootPageBlkno */
+		context->index = 0;
+		intCxt.blkno = desc->rootInfo.rootPageBlkno;
+		intCxt.pageChangeCount = desc->rootInfo.rootPageChangeCount;
+	}
 	while (true)
 	{
 		BTreeNonLeafTuphdr *nonLeafHdr = NULL;
@@ -655,6 +718,14 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 			else if (result == OBTreeFastPathFindRetry)
 				continue;
 			p = O_GET_IN_MEMORY_PAGE(intCxt.blkno);
+
+			/*
+			 * Start loading the child page header, while the downlink is
+			 * being checked and the parent is being unlocked.
+			 */
+			if (level > targetLevel && nonLeafHdr &&
+				DOWNLINK_IS_IN_MEMORY(nonLeafHdr->downlink))
+				O_PREFETCH_PAGE_HEADER(O_GET_IN_MEMORY_PAGE(DOWNLINK_GET_IN_MEMORY_BLKNO(nonLeafHdr->downlink)));
 		}
 		else
 		{
@@ -761,6 +832,7 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 			if (intCxt.haveLock)
 			{
 				load_page(context);
+				pageLoaded = true;
 				intCxt.blkno = context->items[context->index].blkno;
 				loc = context->items[context->index].locator;
 				intCxt.pagePtr = p = O_GET_IN_MEMORY_PAGE(intCxt.blkno);
@@ -793,16 +865,32 @@ find_page(OBTreeFindPageContext *context, void *key, BTreeKeyType keyType,
 		else if (DOWNLINK_IS_IN_IO(nonLeafHdr->downlink))
 		{
 			int			ionum = DOWNLINK_GET_IO_LOCKNUM(nonLeafHdr->downlink);
+			PageWaitLevel waitLevel;
+			instr_time	waitStart;
+			bool		sampled;
 
+			waitLevel = PAGE_GET_LEVEL(p) == 1 ? PageWaitLevelLeaf : PageWaitLevelInternal;
 			if (intCxt.haveLock)
 			{
 				unlock_page(intCxt.blkno);
 				intCxt.haveLock = false;
 			}
+			sampled = tree_stats_page_wait_sample(&waitStart);
+			if (!sampled && EA_IO_TIMING())
+				INSTR_TIME_SET_CURRENT(waitStart);
 			wait_for_io_completion(ionum);
+			if (sampled)
+				tree_stats_report_page_wait(desc->oids, PageWaitIO,
+											waitLevel, waitStart);
+			EA_TREE_IO_TIME(desc->oids, waitStart);
 			continue;
 		}
 
+		/* The step to the page just loaded is accounted as a miss */
+		if (!pageLoaded)
+			tree_stats_count(desc->oids, TreeStatHits);
+		pageLoaded = false;
+
 		parentBlkno = intCxt.blkno;
 		context->index++;
 		intCxt.blkno = DOWNLINK_GET_IN_MEMORY_BLKNO(nonLeafHdr->downlink);
@@ -1679,7 +1767,8 @@ btree_page_search_items(BTreeDescr *desc, Page p, Pointer key,
 	OBTreeKeyCmp cmpFunc = desc->ops->cmp;
 	BTreeKeyType midkind;
 	int			targetCmpVal,
-				result;
+				result,
+				skip = 0;
 
 	midkind = isLeaf ? BTreeKeyLeafTuple : BTreeKeyNonLeafKey;
 
@@ -1689,6 +1778,26 @@ btree_page_search_items(BTreeDescr *desc, Page p, Pointer key,
 		return;
 	}
 
+	/*
+	 * The chunk is found by the binary search over the chunk hikeys, so both
+	 * the key and all the chunk items lie between the previous chunk hikey
+	 * and the chunk hikey.  Therefore, they all share the leading key
+	 * attributes, which are equal in those hikeys, and we can skip them in
+	 * the comparisons.  The last chunk is excluded: its hikey is the page
+	 * hikey, which isn't compared with the key.  The stored keys are left
+	 * intact, only the comparisons are made cheaper.
+	 */
+	if (desc->ops->cmp_skip &&
+		locator->chunkItemsCount >= BTREE_CHUNK_PREFIX_MIN_ITEMS &&
+		locator->chunkOffset + 1 < ((BTreePageHeader *) p)->chunksCount)
+	{
+		OTuple		lokey,
+					hikey;
+
+		if (page_locator_get_chunk_bounds(p, locator, &lokey, &hikey))
+			skip = desc->ops->key_common_prefix(desc, lokey, hikey);
+	}
+
 	low = 0;
 	high = locator->chunkItemsCount - 1;
 	nextkey = (!isLeaf && keyType != BTreeKeyPageHiKey);
@@ -1729,9 +1838,21 @@ btree_page_search_items(BTreeDescr *desc, Page p, Pointer key,
 		{
 			OTuple		midTup;
 
+			/* Prefetch both candidates of the next step during comparison */
+			if (high - low > 2)
+			{
+				BTREE_PAGE_CHUNK_PREFETCH_ITEM(locator, low + (mid - low) / 2);
+				BTREE_PAGE_CHUNK_PREFETCH_ITEM(locator,
+											   mid + 1 + (high - mid - 1) / 2);
+			}
+
 			locator->itemOffset = mid;
 			BTREE_PAGE_READ_TUPLE(midTup, p, locator);
-			result = cmpFunc(desc, key, keyType, &midTup, midkind);
+			if (skip > 0)
+				result = desc->ops->cmp_skip(desc, key, keyType,
+											 &midTup, midkind, skip);
+			else
+				result = cmpFunc(desc, key, keyType, &midTup, midkind);
 		}
 
 		if (result >= targetCmpVal)
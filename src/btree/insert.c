@@ -17,10 +17,12 @@
 
 #include "btree/find.h"
 #include "btree/insert.h"
+#include "btree/io.h"
 #include "btree/split.h"
 #include "btree/page_contents.h"
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
+#include "catalog/sys_trees.h"
 #include "checkpoint/checkpoint.h"
 #include "recovery/recovery.h"
 #include "transam/undo.h"
@@ -29,7 +31,10 @@
 #include "utils/stopevent.h"
 
 #include "miscadmin.h"
+#include "postmaster/interrupt.h"
+#include "storage/spin.h"
 #include "utils/memutils.h"
+#include "utils/timestamp.h"
 
 /* In order to avoid use of the recursion in insert_leaf() we use context. */
 typedef struct BTreeInsertStackItem
@@ -816,6 +821,136 @@ o_btree_insert_needs_page_undo(BTreeDescr *desc, Page p)
 	return needsUndo;
 }
 
+/*
+ * Puts the leaf tuple into the page at the given locator position.  Caller
+ * must hold the page lock, block the page reads and be in critical section.
+ */
+static void
+insert_leaf_item_at(BTreeDescr *desc, OInMemoryBlkno blkno,
+					BTreePageItemLocator *loc, BTreeLeafTuphdr *tuphdr,
+					OTuple tuple, LocationIndex tuplen)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	BTreePageHeader *header = (BTreePageHeader *) p;
+	LocationIndex keyLen;
+	Pointer		ptr;
+
+	page_locator_insert_item(p, loc, MAXALIGN(tuplen) + BTreeLeafTuphdrSize);
+	header->prevInsertOffset = BTREE_PAGE_LOCATOR_GET_OFFSET(p, loc);
+	keyLen = MAXALIGN(o_btree_len(desc, tuple, OTupleKeyLengthNoVersion));
+	header->maxKeyLen = Max(header->maxKeyLen, keyLen);
+
+	/* Copy new tuple and header */
+	ptr = BTREE_PAGE_LOCATOR_GET_ITEM(p, loc);
+	memcpy(ptr, tuphdr, BTreeLeafTuphdrSize);
+	ptr += BTreeLeafTuphdrSize;
+	memcpy(ptr, tuple.data, tuplen);
+	BTREE_PAGE_SET_ITEM_FLAGS(p, loc, tuple.formatFlags);
+
+	if (!(tuple.formatFlags & O_TUPLE_FLAGS_FIXED_FORMAT))
+		header->chunkDesc[loc->chunkOffset].chunkKeysFixed = 0;
+	MARK_DIRTY(desc, blkno);
+}
+
+/*
+ * Inserts the tuples of the page waiters, which fit the page as is.  Waiters
+ * whose tuples don't belong to the page, already have a duplicate on the
+ * page, or don't fit the page anymore are left in the queue: they will retry
+ * on their own after the page is unlocked.  Caller must hold the page lock
+ * and block the page reads.
+ */
+static void
+insert_waiter_tuples_as_is(BTreeDescr *desc, OInMemoryBlkno blkno,
+						   TupleWaiterInfo *tupleWaiterInfos,
+						   int tupleWaitersCount)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	int			i;
+
+	for (i = 0; i < tupleWaitersCount; i++)
+	{
+		TupleWaiterInfo *waiterInfo = &tupleWaiterInfos[i];
+		OPageWaiterShmemState *lockerState = &lockerStates[waiterInfo->pgprocno];
+		BTreePageItemLocator loc;
+		BTreeLeafTuphdr tuphdr;
+		OTuple		tuple;
+
+		tuple.formatFlags = waiterInfo->item.flags;
+		tuple.data = waiterInfo->item.data + BTreeLeafTuphdrSize;
+		tuphdr = *((BTreeLeafTuphdr *) waiterInfo->item.data);
+
+		if (!O_PAGE_IS(p, RIGHTMOST))
+		{
+			OTuple		hikey;
+
+			hikey = page_get_hikey(p);
+			if (o_btree_cmp(desc, &tuple, BTreeKeyLeafTuple, &hikey, BTreeKeyNonLeafKey) >= 0)
+				continue;
+		}
+
+		btree_page_search(desc, p, (Pointer) &tuple,
+						  BTreeKeyLeafTuple, NULL, &loc);
+
+		if (!page_locator_fits_new_item(p, &loc, waiterInfo->item.size))
+			break;
+
+		if (BTREE_PAGE_LOCATOR_IS_VALID(p, &loc))
+		{
+			OTuple		existingTup;
+
+			BTREE_PAGE_READ_LEAF_TUPLE(existingTup, p, &loc);
+
+			if (o_btree_cmp(desc, &tuple, BTreeKeyLeafTuple, &existingTup, BTreeKeyLeafTuple) == 0)
+				continue;
+		}
+
+		START_CRIT_SECTION();
+		if (desc->undoType != UndoLogNone)
+		{
+			steal_reserved_undo_size(desc->undoType,
+									 lockerState->reservedUndoSize);
+			make_waiter_undo_record(desc, blkno,
+									waiterInfo->pgprocno,
+									lockerState);
+		}
+		lockerState->inserted = true;
+		insert_leaf_item_at(desc, blkno, &loc, &tuphdr, tuple,
+							waiterInfo->item.size - BTreeLeafTuphdrSize);
+		END_CRIT_SECTION();
+	}
+}
+
+/*
+ * Applies the inserts queued by the waiters of the locked leaf page, which
+ * fit the page without split or compaction.  The lock holder calls this
+ * before releasing the page after its own modification, so that a contended
+ * leaf is changed by several backends' tuples under one lock acquisition
+ * instead of passing the lock around for each of them.
+ */
+void
+o_btree_insert_waiter_tuples(BTreeDescr *desc, OInMemoryBlkno blkno)
+{
+	int			tupleWaiterProcnums[BTREE_PAGE_MAX_SPLIT_ITEMS];
+	TupleWaiterInfo tupleWaiterInfos[BTREE_PAGE_MAX_SPLIT_ITEMS];
+	int			tupleWaitersCount;
+
+	Assert(page_is_locked(blkno));
+
+	if (!O_PAGE_IS(O_GET_IN_MEMORY_PAGE(blkno), LEAF))
+		return;
+
+	tupleWaitersCount = get_waiters_with_tuples(desc, blkno,
+												tupleWaiterProcnums);
+	if (tupleWaitersCount == 0)
+		return;
+
+	(void) get_tuple_waiter_infos(desc, tupleWaiterProcnums,
+								  tupleWaiterInfos, tupleWaitersCount);
+	page_block_reads(blkno);
+	insert_waiter_tuples_as_is(desc, blkno, tupleWaiterInfos,
+							   tupleWaitersCount);
+}
+
 static bool
 o_btree_insert_item_with_waiters(BTreeInsertStackItem *insert_item,
 								 int reserve_kind,
@@ -855,92 +990,18 @@ o_btree_insert_item_with_waiters(BTreeInsertStackItem *insert_item,
 
 		page_block_reads(blkno);
 
-		for (i = 0; i <= tupleWaitersCount; i++)
-		{
-			LocationIndex tuplen;
-			LocationIndex keyLen;
-			BTreePageHeader *header = (BTreePageHeader *) p;
-			BTreeLeafTuphdr tuphdr;
-			OTuple		tuple;
-			Pointer		ptr;
-
-			if (i == 0)
-			{
-				loc = curContext->items[curContext->index].locator;
-				tuple = insert_item->tuple;
-				tuplen = insert_item->tuplen;
-				tuphdr = *((BTreeLeafTuphdr *) insert_item->tupheader);
-				START_CRIT_SECTION();
-			}
-			else
-			{
-				TupleWaiterInfo *waiterInfo = &tupleWaiterInfos[i - 1];
-				OPageWaiterShmemState *lockerState = &lockerStates[waiterInfo->pgprocno];
-
-				tuple.formatFlags = waiterInfo->item.flags;
-				tuple.data = waiterInfo->item.data + BTreeLeafTuphdrSize;
-				tuphdr = *((BTreeLeafTuphdr *) waiterInfo->item.data);
-				tuplen = waiterInfo->item.size - BTreeLeafTuphdrSize;
-
-				if (!O_PAGE_IS(p, RIGHTMOST))
-				{
-					OTuple		hikey;
-
-					hikey = page_get_hikey(p);
-					if (o_btree_cmp(desc, &tuple, BTreeKeyLeafTuple, &hikey, BTreeKeyNonLeafKey) >= 0)
-						continue;
-
-				}
-
-				btree_page_search(desc, p, (Pointer) &tuple,
-								  BTreeKeyLeafTuple, NULL, &loc);
-
-				if (!page_locator_fits_new_item(p, &loc, waiterInfo->item.size))
-					break;
-
-				if (BTREE_PAGE_LOCATOR_IS_VALID(p, &loc))
-				{
-					OTuple		existingTup;
-
-					BTREE_PAGE_READ_LEAF_TUPLE(existingTup, p, &loc);
-
-					if (o_btree_cmp(desc, &tuple, BTreeKeyLeafTuple, &existingTup, BTreeKeyLeafTuple) == 0)
-						continue;
-				}
-
-				START_CRIT_SECTION();
-				if (desc->undoType != UndoLogNone)
-				{
-					steal_reserved_undo_size(desc->undoType,
-											 lockerState->reservedUndoSize);
-					make_waiter_undo_record(desc, blkno,
-											waiterInfo->pgprocno,
-											lockerState);
-				}
-				lockerState->inserted = true;
-			}
-
-			page_locator_insert_item(p, &loc, MAXALIGN(tuplen) + BTreeLeafTuphdrSize);
-			header->prevInsertOffset = BTREE_PAGE_LOCATOR_GET_OFFSET(p, &loc);
-			keyLen = MAXALIGN(o_btree_len(desc, tuple, OTupleKeyLengthNoVersion));
-			header->maxKeyLen = Max(header->maxKeyLen, keyLen);
+		loc = curContext->items[curContext->index].locator;
+		START_CRIT_SECTION();
+		insert_leaf_item_at(desc, blkno, &loc,
+							(BTreeLeafTuphdr *) insert_item->tupheader,
+							insert_item->tuple, insert_item->tuplen);
+		END_CRIT_SECTION();
 
-			/* Copy new tuple and header */
-			ptr = BTREE_PAGE_LOCATOR_GET_ITEM(p, &loc);
-			memcpy(ptr, &tuphdr, BTreeLeafTuphdrSize);
-			ptr += BTreeLeafTuphdrSize;
-			memcpy(ptr, tuple.data, tuplen);
-			BTREE_PAGE_SET_ITEM_FLAGS(p, &loc, tuple.formatFlags);
-
-			if (!(tuple.formatFlags & O_TUPLE_FLAGS_FIXED_FORMAT))
-				header->chunkDesc[loc.chunkOffset].chunkKeysFixed = 0;
-			MARK_DIRTY(desc, blkno);
-			END_CRIT_SECTION();
-		}
+		insert_waiter_tuples_as_is(desc, blkno, tupleWaiterInfos,
+								   tupleWaitersCount);
 
 		unlock_page(blkno);
 
-
 		return true;
 	}
 
@@ -1138,6 +1199,13 @@ o_btree_insert_item_no_waiters(BTreeInsertStackItem *insert_item,
 
 		MARK_DIRTY(desc, blkno);
 
+		/*
+		 * Replaces don't take the waiters' tuples into the page image, but
+		 * we still can put them as is before releasing the page.
+		 */
+		if (insert_item->replace)
+			o_btree_insert_waiter_tuples(desc, blkno);
+
 		o_btree_insert_mark_split_finished_if_needed(insert_item);
 		unlock_page(blkno);
 
@@ -1402,3 +1470,172 @@ o_btree_insert_tuple_to_leaf(OBTreeFindPageContext *context,
 		MemoryContextResetOnly(btree_insert_context);
 	}
 }
+
+/*
+ * Registry of the splits marked as broken on the error cleanup.  The
+ * background writer fixes them eagerly, so they don't wait for the next
+ * modification of the page or the checkpoint.  If the registry is full, the
+ * split is just left to the lazy fix.
+ */
+#define O_BROKEN_SPLITS_MAX		256
+
+typedef struct
+{
+	OInMemoryBlkno rightBlkno;
+	uint32		rightChangeCount;
+	TimestampTz time;
+} OBrokenSplit;
+
+typedef struct
+{
+	slock_t		lock;
+	int			count;
+	OBrokenSplit items[O_BROKEN_SPLITS_MAX];
+} OBrokenSplits;
+
+static OBrokenSplits *brokenSplits = NULL;
+
+Size
+o_btree_broken_splits_shmem_needs(void)
+{
+	return sizeof(OBrokenSplits);
+}
+
+void
+o_btree_broken_splits_shmem_init(Pointer ptr, bool found)
+{
+	brokenSplits = (OBrokenSplits *) ptr;
+
+	if (!found)
+	{
+		SpinLockInit(&brokenSplits->lock);
+		brokenSplits->count = 0;
+	}
+}
+
+/*
+ * Registers the split, which right page was just marked as broken.
+ */
+void
+o_btree_register_broken_split(OInMemoryBlkno rightBlkno,
+							  uint32 rightChangeCount)
+{
+	TimestampTz now;
+
+	if (split_fix_delay < 0)
+		return;
+
+	now = GetCurrentTimestamp();
+	SpinLockAcquire(&brokenSplits->lock);
+	if (brokenSplits->count < O_BROKEN_SPLITS_MAX)
+	{
+		OBrokenSplit *item = &brokenSplits->items[brokenSplits->count++];
+
+		item->rightBlkno = rightBlkno;
+		item->rightChangeCount = rightChangeCount;
+		item->time = now;
+	}
+	SpinLockRelease(&brokenSplits->lock);
+}
+
+/*
+ * Takes a registered split broken before the given time.
+ */
+static bool
+o_btree_pop_broken_split(TimestampTz before, OBrokenSplit *result)
+{
+	bool		found = false;
+	int			i;
+
+	SpinLockAcquire(&brokenSplits->lock);
+	for (i = 0; i < brokenSplits->count; i++)
+	{
+		if (brokenSplits->items[i].time <= before)
+		{
+			*result = brokenSplits->items[i];
+			brokenSplits->items[i] = brokenSplits->items[--brokenSplits->count];
+			found = true;
+			break;
+		}
+	}
+	SpinLockRelease(&brokenSplits->lock);
+
+	return found;
+}
+
+/*
+ * Fixes the split if its right page is still the broken one we registered.
+ */
+static void
+o_btree_fix_broken_split(OBrokenSplit *split)
+{
+	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(split->rightBlkno);
+	Page		p = O_GET_IN_MEMORY_PAGE(split->rightBlkno);
+	BTreeDescr *desc;
+	ORelOids	oids;
+	OIndexType	type;
+	UndoLogType pageUndoType;
+
+	/* Important to access the shared memory once */
+	oids = *((volatile ORelOids *) &page_desc->oids);
+	type = page_desc->type;
+	if (!ORelOidsIsValid(oids) || type == oIndexInvalid ||
+		O_PAGE_GET_CHANGE_COUNT(p) != split->rightChangeCount ||
+		!O_PAGE_IS(p, BROKEN_SPLIT))
+		return;
+
+	/* See the comment in walk_page() */
+	if (IS_SYS_TREE_OIDS(oids))
+	{
+		if (sys_tree_get_storage_type(oids.relnode) == BTreeStorageInMemory)
+			return;
+		desc = get_sys_tree(oids.relnode);
+	}
+	else
+	{
+		desc = index_oids_get_btree_descr(oids, type);
+		if (desc == NULL)
+			return;
+	}
+
+	/* The downlink insertion might split the parent and save its image */
+	pageUndoType = GET_PAGE_LEVEL_UNDO_TYPE(desc->undoType);
+	if (pageUndoType != UndoLogNone)
+		reserve_undo_size(pageUndoType, 2 * O_MERGE_UNDO_IMAGE_SIZE);
+
+	lock_page(split->rightBlkno);
+	if (ORelOidsIsEqual(oids, page_desc->oids) &&
+		O_PAGE_GET_CHANGE_COUNT(p) == split->rightChangeCount &&
+		O_PAGE_IS(p, BROKEN_SPLIT))
+		o_btree_split_fix_for_right_page_and_unlock(desc, split->rightBlkno);
+	else
+		unlock_page(split->rightBlkno);
+
+	if (pageUndoType != UndoLogNone)
+	{
+		release_undo_size(pageUndoType);
+		free_retained_undo_location(pageUndoType);
+	}
+	ppool_release_reserved(desc->ppool, PPOOL_RESERVE_MASK_ALL);
+}
+
+/*
+ * Fixes the splits broken at least orioledb.split_fix_delay ago.  Called by
+ * the first background writer.
+ */
+void
+o_btree_fix_broken_splits(void)
+{
+	TimestampTz before;
+	OBrokenSplit split;
+
+	if (split_fix_delay < 0 || brokenSplits->count == 0)
+		return;
+
+	before = TimestampTzPlusMilliseconds(GetCurrentTimestamp(), -split_fix_delay);
+	while (!ShutdownRequestPending && o_btree_pop_broken_split(before, &split))
+	{
+		o_btree_fix_broken_split(&split);
+		Assert(!have_locked_pages());
+	}
+}
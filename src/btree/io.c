@@ -21,11 +21,13 @@
 
 #include "orioledb.h"
 
+#include "btree/device.h"
 #include "btree/io.h"
 #include "btree/find.h"
 #include "btree/merge.h"
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
+#include "btree/uring.h"
 #include "checkpoint/checkpoint.h"
 #include "catalog/free_extents.h"
 #include "catalog/o_sys_cache.h"
@@ -35,12 +37,18 @@
 #include "tableam/descr.h"
 #include "tableam/handler.h"
 #include "utils/compress.h"
+#include "utils/compressed_cache.h"
 #include "utils/elog.h"
+#include "utils/op_sampling.h"
 #include "utils/page_pool.h"
+#include "utils/probes.h"
 #include "utils/seq_buf.h"
 #include "utils/stopevent.h"
+#include "utils/tree_stats.h"
 #include "utils/ucm.h"
+#include "utils/zone_map.h"
 #include "workers/bgwriter.h"
+#include "workers/sync_worker.h"
 
 #include "access/transam.h"
 #include "access/relation.h"
@@ -82,6 +90,15 @@ static IOShmem *ioShmem = NULL;
 static int	num_io_lwlocks;
 static bool io_in_progress = false;
 
+/*
+ * The tree, whose pages this process places at the end of the data file
+ * instead of the free extents.  Set by the checkpointer for the trees
+ * requested by the compaction worker.
+ */
+static bool append_extents = false;
+static ORelOids append_extents_oids;
+static OIndexType append_extents_type;
+
 static bool prepare_non_leaf_page(Page p);
 static uint64 get_free_disk_offset(BTreeDescr *desc);
 static bool get_free_disk_extent(BTreeDescr *desc, uint32 chkpNum,
@@ -192,6 +209,12 @@ typedef struct
 	uint32		segmentNumber;
 } FileHashKey;
 
+#ifdef O_DIRECT
+#define BTREE_O_DIRECT (orioledb_direct_io ? O_DIRECT : 0)
+#else
+#define BTREE_O_DIRECT 0
+#endif
+
 typedef struct
 {
 	FileHashKey key;
@@ -317,7 +340,7 @@ btree_open_smgr_file(BTreeDescr *desc, uint32 num, uint32 chkpNum,
 		filename = btree_smgr_filename(desc,
 									   (off_t) num * ORIOLEDB_SEGMENT_SIZE,
 									   chkpNum);
-		desc->smgr.array.files[num] = PathNameOpenFile(filename, O_RDWR | O_CREAT | PG_BINARY);
+		desc->smgr.array.files[num] = PathNameOpenFile(filename, O_RDWR | O_CREAT | PG_BINARY | BTREE_O_DIRECT);
 
 		if (desc->smgr.array.files[num] <= 0)
 			ereport(FATAL,
@@ -328,12 +351,83 @@ btree_open_smgr_file(BTreeDescr *desc, uint32 num, uint32 chkpNum,
 	}
 }
 
+/*
+ * Returns the kernel file descriptor of the virtual file.  The virtual file
+ * might be closed to keep the number of the open files under the limit, then
+ * FileSize() reopens it.
+ */
+int
+btree_smgr_file_fd(File file)
+{
+	int			fd = FileGetRawDesc(file);
+
+	if (fd < 0)
+	{
+		(void) FileSize(file);
+		fd = FileGetRawDesc(file);
+	}
+	return fd;
+}
+
+#ifdef O_DIRECT
+static void
+btree_smgr_set_direct(int fd, bool direct)
+{
+	int			flags = fcntl(fd, F_GETFL);
+
+	if (flags < 0 ||
+		fcntl(fd, F_SETFL, direct ? (flags | O_DIRECT) : (flags & ~O_DIRECT)) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not change the direct IO mode of data file: %m")));
+}
+#endif
+
+/*
+ * Reads or writes the data file.  With orioledb.direct_io, the IO bypassing
+ * the page cache must be aligned.  The pages written by the index build and
+ * the extents allocated before enabling direct IO might be not, so direct IO
+ * is switched off for them.
+ */
+static int
+btree_smgr_file_io(File file, char *buffer, int amount, off_t offset,
+				   bool write)
+{
+	int			result;
+
+#ifdef O_DIRECT
+	if (orioledb_direct_io && !DirectIOIsAligned(buffer, amount, offset))
+	{
+		int			fd = btree_smgr_file_fd(file);
+
+		btree_smgr_set_direct(fd, false);
+		if (write)
+			result = OFileWrite(file, buffer, amount, offset,
+								WAIT_EVENT_DATA_FILE_WRITE);
+		else
+			result = OFileRead(file, buffer, amount, offset,
+							   WAIT_EVENT_DATA_FILE_READ);
+		btree_smgr_set_direct(fd, true);
+		return result;
+	}
+#endif
+
+	if (write)
+		result = OFileWrite(file, buffer, amount, offset,
+							WAIT_EVENT_DATA_FILE_WRITE);
+	else
+		result = OFileRead(file, buffer, amount, offset,
+						   WAIT_EVENT_DATA_FILE_READ);
+	return result;
+}
+
 void
 btree_init_smgr(BTreeDescr *descr)
 {
 	if (orioledb_s3_mode)
 	{
 		descr->smgr.hash = NULL;
+		descr->buildPartsInfo = NULL;
 	}
 	else
 	{
@@ -347,20 +441,8 @@ btree_open_smgr(BTreeDescr *descr)
 {
 	if (orioledb_s3_mode)
 	{
-		int			i;
-		int			j;
-
 		descr->smgr.hash = s3Files_create(TopMemoryContext, 16, NULL);
-
-		for (i = 0; i < 2; i++)
-		{
-			descr->buildPartsInfo[i].writeMaxLocation = 0;
-			for (j = 0; j < MAX_NUM_DIRTY_PARTS; j++)
-			{
-				descr->buildPartsInfo[i].dirtyParts[j].segNum = -1;
-				descr->buildPartsInfo[i].dirtyParts[j].partNum = -1;
-			}
-		}
+		descr->buildPartsInfo = NULL;
 	}
 	else
 	{
@@ -383,11 +465,14 @@ btree_close_smgr(BTreeDescr *descr)
 {
 	int			i;
 
+	/* The deferred writes might refer to the files */
+	o_uring_wait_all();
+
 	if (orioledb_s3_mode)
 	{
 		int			j;
 
-		for (j = 0; j < 2; j++)
+		for (j = 0; j < 2 && descr->buildPartsInfo; j++)
 		{
 			for (i = 0; i < MAX_NUM_DIRTY_PARTS; i++)
 			{
@@ -415,6 +500,12 @@ btree_close_smgr(BTreeDescr *descr)
 			}
 		}
 
+		if (descr->buildPartsInfo)
+		{
+			pfree(descr->buildPartsInfo);
+			descr->buildPartsInfo = NULL;
+		}
+
 		if (descr->smgr.hash)
 		{
 			s3Files_iterator i;
@@ -491,6 +582,27 @@ btree_smgr_schedule_s3_write(BTreeDescr *desc, uint32 chkpNum,
 	}
 	else
 	{
+		/*
+		 * Only the trees being built have no meta page.  Allocate the parts
+		 * info on the first write, so the descriptors of the other trees
+		 * don't carry it.
+		 */
+		if (!desc->buildPartsInfo)
+		{
+			int			j;
+
+			desc->buildPartsInfo = (BTreeS3PartsInfo *)
+				MemoryContextAllocZero(TopMemoryContext,
+									   sizeof(BTreeS3PartsInfo) * 2);
+			for (i = 0; i < 2; i++)
+			{
+				for (j = 0; j < MAX_NUM_DIRTY_PARTS; j++)
+				{
+					desc->buildPartsInfo[i].dirtyParts[j].segNum = -1;
+					desc->buildPartsInfo[i].dirtyParts[j].partNum = -1;
+				}
+			}
+		}
 		partsInfo = desc->buildPartsInfo;
 	}
 
@@ -539,20 +651,8 @@ btree_smgr_write(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 				granularity;
 	S3HeaderTag tag = {0};
 
-	if (use_mmap)
-	{
-		Assert(offset + amount <= device_length);
-		memcpy(mmap_data + offset, buffer, amount);
-		return amount;
-	}
-	else if (use_device)
-	{
-		Assert(offset + amount <= device_length);
-		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_WRITE);
-		result = pg_pwrite(device_fd, buffer, amount, offset);
-		pgstat_report_wait_end();
-		return result;
-	}
+	if (use_device)
+		return o_device_write(buffer, amount, offset);
 
 	if (orioledb_s3_mode)
 	{
@@ -581,11 +681,25 @@ btree_smgr_write(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 		}
 
 		file = btree_open_smgr_file(desc, segno, chkpNum, loadId);
+		if (o_uring_write_active() &&
+			(!orioledb_direct_io || DirectIOIsAligned(NULL, amount, curOffset)))
+		{
+			int			stepAmount = Min(amount, granularity - curOffset % granularity);
+
+			Assert(!orioledb_s3_mode);
+			o_uring_write(file, buffer, stepAmount,
+						  curOffset % ORIOLEDB_SEGMENT_SIZE);
+			result += stepAmount;
+			buffer += stepAmount;
+			curOffset += stepAmount;
+			amount -= stepAmount;
+			continue;
+		}
 		if ((curOffset + amount) / granularity == curOffset / granularity)
 		{
-			result += OFileWrite(file, buffer, amount,
-								 curOffset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
-								 WAIT_EVENT_DATA_FILE_WRITE);
+			result += btree_smgr_file_io(file, buffer, amount,
+										 curOffset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
+										 true);
 			if (orioledb_s3_mode)
 				s3_header_unlock_part(tag, partno, true);
 			break;
@@ -595,9 +709,9 @@ btree_smgr_write(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 			int			stepAmount = granularity - curOffset % granularity;
 
 			Assert(amount >= stepAmount);
-			result += OFileWrite(file, buffer, stepAmount,
-								 curOffset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
-								 WAIT_EVENT_DATA_FILE_WRITE);
+			result += btree_smgr_file_io(file, buffer, stepAmount,
+										 curOffset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
+										 true);
 			buffer += stepAmount;
 			curOffset += stepAmount;
 			amount -= stepAmount;
@@ -631,20 +745,8 @@ btree_smgr_read(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 	off_t		granularity;
 	S3HeaderTag tag = {0};
 
-	if (use_mmap)
-	{
-		Assert(offset + amount <= device_length);
-		memcpy(buffer, mmap_data + offset, amount);
-		return amount;
-	}
-	else if (use_device)
-	{
-		Assert(offset + amount <= device_length);
-		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_READ);
-		result = pg_pread(device_fd, buffer, amount, offset);
-		pgstat_report_wait_end();
-		return result;
-	}
+	if (use_device)
+		return o_device_read(buffer, amount, offset);
 
 	if (orioledb_s3_mode)
 	{
@@ -675,9 +777,9 @@ btree_smgr_read(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 		file = btree_open_smgr_file(desc, segno, chkpNum, loadId);
 		if ((offset + amount) / granularity == offset / granularity)
 		{
-			result += OFileRead(file, buffer, amount,
-								offset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
-								WAIT_EVENT_DATA_FILE_READ);
+			result += btree_smgr_file_io(file, buffer, amount,
+										 offset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
+										 false);
 			if (orioledb_s3_mode)
 				s3_header_unlock_part(tag, partno, false);
 			break;
@@ -687,9 +789,9 @@ btree_smgr_read(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 			int			stepAmount = granularity - offset % granularity;
 
 			Assert(amount >= stepAmount);
-			result += OFileRead(file, buffer, stepAmount,
-								offset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
-								WAIT_EVENT_DATA_FILE_READ);
+			result += btree_smgr_file_io(file, buffer, stepAmount,
+										 offset % ORIOLEDB_SEGMENT_SIZE + (orioledb_s3_mode ? ORIOLEDB_BLCKSZ : 0),
+										 false);
 			buffer += stepAmount;
 			offset += stepAmount;
 			amount -= stepAmount;
@@ -702,18 +804,59 @@ btree_smgr_read(BTreeDescr *desc, char *buffer, uint32 chkpNum,
 	return result;
 }
 
+/*
+ * Asks the kernel to start reading the given range of the data file.  Doesn't
+ * wait for the read to complete.
+ */
 void
-btree_smgr_writeback(BTreeDescr *desc, uint32 chkpNum,
-					 off_t offset, int amount)
+btree_smgr_prefetch(BTreeDescr *desc, uint32 chkpNum,
+					off_t offset, int amount)
 {
-	if (use_mmap)
+	if (use_device)
 	{
-		Assert(offset + amount <= device_length);
-		msync(mmap_data + offset, amount, MS_ASYNC);
+		o_device_prefetch(offset, amount);
 		return;
 	}
-	else if (use_device)
+
+	/* S3 parts might be not downloaded yet, nothing to prefetch locally */
+	if (orioledb_s3_mode)
+		return;
+
+	while (amount > 0)
 	{
+		int			segno = offset / ORIOLEDB_SEGMENT_SIZE;
+		File		file;
+
+		file = btree_open_smgr_file(desc, segno, chkpNum, 0);
+		if ((offset + amount) / ORIOLEDB_SEGMENT_SIZE == segno)
+		{
+			(void) FilePrefetch(file, offset % ORIOLEDB_SEGMENT_SIZE,
+								amount, WAIT_EVENT_DATA_FILE_PREFETCH);
+			break;
+		}
+		else
+		{
+			int			stepAmount = ORIOLEDB_SEGMENT_SIZE - offset % ORIOLEDB_SEGMENT_SIZE;
+
+			Assert(amount >= stepAmount);
+			(void) FilePrefetch(file, offset % ORIOLEDB_SEGMENT_SIZE,
+								stepAmount, WAIT_EVENT_DATA_FILE_PREFETCH);
+			offset += stepAmount;
+			amount -= stepAmount;
+		}
+	}
+}
+
+void
+btree_smgr_writeback(BTreeDescr *desc, uint32 chkpNum,
+					 off_t offset, int amount)
+{
+	/* The asynchronous writes must reach the kernel first */
+	o_uring_wait_all();
+
+	if (use_device)
+	{
+		o_device_writeback(offset, amount);
 		return;
 	}
 
@@ -760,13 +903,16 @@ btree_smgr_sync(BTreeDescr *desc, uint32 chkpNum, off_t length)
 {
 	int			num;
 
+	o_uring_wait_all();
+
 	if (orioledb_s3_mode)
 		btree_s3_flush(desc, chkpNum);
 
 	if (use_mmap || use_device)
 		return;
 
-	for (num = 0; num < length / ORIOLEDB_SEGMENT_SIZE; num++)
+	/* The last segment is usually partially filled */
+	for (num = 0; num < (length + ORIOLEDB_SEGMENT_SIZE - 1) / ORIOLEDB_SEGMENT_SIZE; num++)
 	{
 		File		file;
 		uint32		loadId = 0;
@@ -782,7 +928,15 @@ btree_smgr_sync(BTreeDescr *desc, uint32 chkpNum, off_t length)
 		}
 
 		file = btree_open_smgr_file(desc, num, chkpNum, loadId);
-		FileSync(file, WAIT_EVENT_DATA_FILE_SYNC);
+
+		/*
+		 * The sync workers sync the files meanwhile the checkpointer walks
+		 * the next trees.  The S3 mode schedules the uploads after the sync.
+		 */
+		if (sync_workers_enabled() && !orioledb_s3_mode)
+			sync_workers_submit(FilePathName(file));
+		else
+			FileSync(file, WAIT_EVENT_DATA_FILE_SYNC);
 	}
 }
 
@@ -849,6 +1003,28 @@ btree_io_error_cleanup(void)
 {
 	if (io_in_progress)
 		io_finish();
+	o_uring_error_cleanup();
+	btree_io_set_append_extents(NULL);
+}
+
+/*
+ * Makes the subsequent page writes of the given tree go to the end of the
+ * data file, so the pages written in the key order are laid out
+ * sequentially.  NULL resets to the regular free extents allocation.
+ */
+void
+btree_io_set_append_extents(BTreeDescr *desc)
+{
+	if (desc)
+	{
+		append_extents = true;
+		append_extents_oids = desc->oids;
+		append_extents_type = desc->type;
+	}
+	else
+	{
+		append_extents = false;
+	}
 }
 
 void
@@ -898,10 +1074,23 @@ assign_io_num(OInMemoryBlkno blkno, OffsetNumber offnum)
 void
 wait_for_io_completion(int ionum)
 {
+	/* It might be our own asynchronous write */
+	if (have_io_lock(ionum))
+		o_uring_wait_all();
+
 	LWLockAcquire(&io_locks[ionum].lock, LW_SHARED);
 	LWLockRelease(&io_locks[ionum].lock);
 }
 
+/*
+ * Returns true if this process holds the given IO lock.
+ */
+bool
+have_io_lock(int ionum)
+{
+	return LWLockHeldByMe(&io_locks[ionum].lock);
+}
+
 /*
  * Report given IO operation to be finished.
  */
@@ -1068,6 +1257,19 @@ get_free_disk_extent(BTreeDescr *desc, uint32 chkpNum,
 		return FileExtentIsValid(*extent);
 	}
 
+	if (append_extents && !use_device &&
+		ORelOidsIsEqual(desc->oids, append_extents_oids) &&
+		desc->type == append_extents_type)
+	{
+		BTreeMetaPage *metaPage = BTREE_GET_META(desc);
+
+		extent->len = OCompressIsValid(desc->compress) ? FileExtentLen(page_size) : 1;
+		LWLockAcquire(&metaPage->metaLock, LW_SHARED);
+		extent->off = pg_atomic_fetch_add_u64(&metaPage->datafileLength[0],
+											  extent->len);
+		LWLockRelease(&metaPage->metaLock);
+		return FileExtentIsValid(*extent);
+	}
 
 	if (!OCompressIsValid(desc->compress))
 	{
@@ -1145,6 +1347,129 @@ get_free_disk_extent_copy_blkno(BTreeDescr *desc, off_t page_size,
 	return FileExtentIsValid(*extent);
 }
 
+/*
+ * Gets the byte range of the data file occupied by the page referenced by a
+ * valid on-disk downlink.  Returns false in S3 mode, where the data file
+ * parts might be not downloaded yet.
+ */
+bool
+get_downlink_disk_range(BTreeDescr *desc, uint64 downlink,
+						off_t *byte_offset, int *size)
+{
+	uint64		offset = DOWNLINK_GET_DISK_OFF(downlink);
+	uint16		len = DOWNLINK_GET_DISK_LEN(downlink);
+
+	Assert(FileExtentOffIsValid(offset));
+	Assert(FileExtentLenIsValid(len));
+
+	if (orioledb_s3_mode)
+		return false;
+
+	if (!OCompressIsValid(desc->compress))
+	{
+		if (use_device)
+			*byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
+		else
+			*byte_offset = (off_t) offset * (off_t) ORIOLEDB_BLCKSZ;
+		*size = ORIOLEDB_BLCKSZ;
+	}
+	else
+	{
+		*byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
+		*size = len * ORIOLEDB_COMP_BLCKSZ;
+	}
+	return true;
+}
+
+/*
+ * Starts asynchronous reading of the page referenced by a valid on-disk
+ * downlink.  A subsequent read_page_from_disk() for the same downlink is then
+ * likely to be served from the kernel cache.
+ */
+void
+prefetch_page_from_disk(BTreeDescr *desc, uint64 downlink)
+{
+	off_t		byte_offset;
+	int			size;
+
+	if (get_downlink_disk_range(desc, downlink, &byte_offset, &size))
+		btree_smgr_prefetch(desc, 0, byte_offset, size);
+}
+
+/*
+ * Starts asynchronous reading of the leaf page the key belongs to, if it's
+ * evicted.  Descends to the parent of the leaf using the page images, so
+ * the leaf itself isn't loaded.
+ */
+void
+prefetch_leaf_for_key(BTreeDescr *desc, Pointer key, BTreeKeyType keyType)
+{
+	OBTreeFindPageContext context;
+	BTreePageItemLocator *loc;
+	BTreeNonLeafTuphdr *tuphdr;
+	OTuple		internalTuple;
+
+	init_page_find_context(&context, desc, COMMITSEQNO_INPROGRESS,
+						   BTREE_PAGE_FIND_IMAGE);
+	if (find_page(&context, key, keyType, 1) != OFindPageResultSuccess)
+		return;
+
+	if (O_PAGE_IS(context.img, LEAF) || PAGE_GET_LEVEL(context.img) != 1)
+		return;
+
+	loc = &context.items[context.index].locator;
+	if (!BTREE_PAGE_LOCATOR_IS_VALID(context.img, loc) ||
+		!partial_load_chunk(&context.partial, context.img,
+							loc->chunkOffset, NULL))
+		return;
+
+	BTREE_PAGE_READ_INTERNAL_ITEM(tuphdr, internalTuple, context.img, loc);
+	if (DOWNLINK_IS_ON_DISK(tuphdr->downlink))
+		prefetch_page_from_disk(desc, tuphdr->downlink);
+}
+
+/*
+ * Calculates the checksum of the on-disk page image: the header except the
+ * checksum itself and the page data.  pg_crc32c uses the hardware CRC-32C
+ * instructions where available.
+ */
+static uint32
+ondisk_page_checksum(Pointer image, off_t size)
+{
+	pg_crc32c	crc;
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, image, offsetof(OrioleDBOndiskPageHeader, checksum));
+	COMP_CRC32C(crc, image + sizeof(OrioleDBOndiskPageHeader),
+				size - sizeof(OrioleDBOndiskPageHeader));
+	FIN_CRC32C(crc);
+	return crc;
+}
+
+/*
+ * Verifies the checksum of the on-disk page image if it has one.
+ */
+static bool
+ondisk_page_verify_checksum(BTreeDescr *desc, Pointer image, off_t size,
+							uint64 offset)
+{
+	OrioleDBOndiskPageHeader *header = (OrioleDBOndiskPageHeader *) image;
+	uint32		checksum;
+
+	if (!(header->flags & O_ONDISK_PAGE_CHECKSUM))
+		return true;
+
+	checksum = ondisk_page_checksum(image, size);
+	if (checksum == header->checksum)
+		return true;
+
+	ereport(WARNING,
+			(errcode(ERRCODE_DATA_CORRUPTED),
+			 errmsg("page checksum verification failed for relnode %u at file offset " UINT64_FORMAT ": calculated %08X but expected %08X",
+					desc->oids.relnode, offset, checksum, header->checksum)));
+	return false;
+}
+
 /*
  * Reads a page from disk to the img from a valid downlink. It's fills an empty
  * array of offsets for the page.
@@ -1159,10 +1484,21 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink,
 	uint32		chkpNum = 0;
 	uint16		len = DOWNLINK_GET_DISK_LEN(downlink);
 	bool		err = false;
+	OpSamplingProcState opSaved;
 
 	Assert(FileExtentOffIsValid(offset));
 	Assert(FileExtentLenIsValid(len));
 
+	if (compressed_cache_get(desc, offset, img))
+	{
+		extent->off = offset;
+		extent->len = len;
+		return true;
+	}
+
+	tree_stats_count(desc->oids, TreeStatDiskLoads);
+	EA_TREE_INC(desc->oids, diskRead);
+
 	if (!OCompressIsValid(desc->compress))
 	{
 		/* easy case, read page from uncompressed index */
@@ -1182,7 +1518,8 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink,
 			byte_offset = (off_t) offset * (off_t) ORIOLEDB_BLCKSZ;
 		read_size = ORIOLEDB_BLCKSZ;
 
-		err = btree_smgr_read(desc, img, chkpNum, read_size, byte_offset) != read_size;
+		err = btree_smgr_read(desc, img, chkpNum, read_size, byte_offset) != read_size ||
+			!ondisk_page_verify_checksum(desc, img, read_size, offset);
 		if (!err)
 		{
 			uint8		page_version;
@@ -1202,7 +1539,7 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink,
 	}
 	else
 	{
-		char		buf[ORIOLEDB_BLCKSZ];
+		OIOAlignedPage buf;
 		bool		compressed = len != (ORIOLEDB_BLCKSZ / ORIOLEDB_COMP_BLCKSZ);
 
 		extent->off = offset;
@@ -1219,13 +1556,14 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink,
 			byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
 			read_size = len * ORIOLEDB_COMP_BLCKSZ;
 
-			err = btree_smgr_read(desc, buf, chkpNum, read_size, byte_offset) != read_size;
+			err = btree_smgr_read(desc, buf.data, chkpNum, read_size, byte_offset) != read_size ||
+				!ondisk_page_verify_checksum(desc, buf.data, read_size, offset);
 
 			if (!err)
 			{
 				OrioleDBOndiskPageHeader ondisk_page_header;
 
-				memcpy(&ondisk_page_header, buf, sizeof(OrioleDBOndiskPageHeader));
+				memcpy(&ondisk_page_header, buf.data, sizeof(OrioleDBOndiskPageHeader));
 
 				if (ondisk_page_header.page_version != ORIOLEDB_PAGE_VERSION)
 				{
@@ -1251,41 +1589,46 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink,
 					elog(FATAL, "Page version %u of OrioleDB cluster is not among supported for conversion %u", ondisk_page_header.page_version, ORIOLEDB_PAGE_VERSION);
 				}
 
-				o_decompress_page(buf + sizeof(OrioleDBOndiskPageHeader), ondisk_page_header.compress_page_size, img);
+				opSaved = op_sampling_begin(OpSamplingDecompress, desc->oids);
+				o_decompress_tree_page(desc, ondisk_page_header.compress_codec, buf.data + sizeof(OrioleDBOndiskPageHeader), ondisk_page_header.compress_page_size, img);
+				op_sampling_end(opSaved);
 			}
 		}
 		else
 		{
 			OrioleDBOndiskPageHeader ondisk_page_header;
+			size_t		skipped = offsetof(BTreePageHeader, undoLocation);
 
 			byte_offset = (off_t) offset * (off_t) ORIOLEDB_COMP_BLCKSZ;
-			read_size = sizeof(OrioleDBOndiskPageHeader);
+			read_size = sizeof(OrioleDBOndiskPageHeader) + ORIOLEDB_BLCKSZ - skipped;
+			Assert(read_size <= ORIOLEDB_BLCKSZ);
 
-			/* details about writed image parts are in write_page_to_disk */
-			err = btree_smgr_read(desc, (Pointer) &ondisk_page_header, chkpNum, read_size, byte_offset) != read_size;
-			byte_offset += read_size;
+			/*
+			 * Details about writed image parts are in write_page_to_disk.  The
+			 * whole extent is read at once, so the read is aligned for direct
+			 * IO.
+			 */
+			err = btree_smgr_read(desc, buf.data, chkpNum, read_size, byte_offset) != read_size ||
+				!ondisk_page_verify_checksum(desc, buf.data, read_size, offset);
 
 			if (!err)
 			{
-				size_t		skipped = offsetof(BTreePageHeader, undoLocation);
 				BTreePageHeader *btree_page_header;
 
+				memcpy(&ondisk_page_header, buf.data, sizeof(OrioleDBOndiskPageHeader));
 				memset(img, 0, skipped);
-				read_size = ORIOLEDB_BLCKSZ - skipped;
-				err = btree_smgr_read(desc, img + skipped, chkpNum, read_size, byte_offset) != read_size;
+				memcpy(img + skipped, buf.data + sizeof(OrioleDBOndiskPageHeader),
+					   ORIOLEDB_BLCKSZ - skipped);
 
-				if (!err)
+				if (ondisk_page_header.page_version != ORIOLEDB_PAGE_VERSION)
 				{
-					if (ondisk_page_header.page_version != ORIOLEDB_PAGE_VERSION)
-					{
-						/*
-						 * Now we have only one page version (1). When we have
-						 * different versions we'll need to bump
-						 * ORIOLEDB_PAGE_VERSION and add on-the-fly conversion
-						 * function from all previous page versions here
-						 */
-						elog(FATAL, "Page version %u of OrioleDB cluster is not among supported for conversion %u", ondisk_page_header.page_version, ORIOLEDB_PAGE_VERSION);
-					}
+					/*
+					 * Now we have only one page version (1). When we have
+					 * different versions we'll need to bump
+					 * ORIOLEDB_PAGE_VERSION and add on-the-fly conversion
+					 * function from all previous page versions here
+					 */
+					elog(FATAL, "Page version %u of OrioleDB cluster is not among supported for conversion %u", ondisk_page_header.page_version, ORIOLEDB_PAGE_VERSION);
 				}
 				btree_page_header = (BTreePageHeader *) img;
 				btree_page_header->o_header.checkpointNum = ondisk_page_header.checkpointNum;
@@ -1297,21 +1640,17 @@ read_page_from_disk(BTreeDescr *desc, Pointer img, uint64 downlink,
 }
 
 /*
- * Writes a page to the disk. An array of file offsets must be valid.
+ * Fills the buffer with the on-disk image of the page: the on-disk header
+ * followed by the page contents.  Returns the image size.
  */
-static bool
-write_page_to_disk(BTreeDescr *desc, FileExtent *extent, uint32 curChkpNum,
-				   Pointer page, off_t page_size)
+static off_t
+make_ondisk_page_image(BTreeDescr *desc, FileExtent *extent,
+					   uint32 curChkpNum, Pointer page, off_t page_size,
+					   char *buf)
 {
-
-	off_t		byte_offset,
-				write_size;
-	bool		err = false;
-	uint32		chkpNum = 0;
-	char		buf[ORIOLEDB_BLCKSZ];
+	off_t		write_size;
 
 	Assert(sizeof(OrioleDBOndiskPageHeader) == O_PAGE_HEADER_SIZE);
-	Assert(FileExtentOffIsValid(extent->off));
 	if (!OCompressIsValid(desc->compress))
 	{
 		OrioleDBOndiskPageHeader *ondisk_page_header;
@@ -1320,76 +1659,95 @@ write_page_to_disk(BTreeDescr *desc, FileExtent *extent, uint32 curChkpNum,
 		Assert(extent->len == 1);
 		Assert(page_size == ORIOLEDB_BLCKSZ);
 
-		byte_offset = (off_t) extent->off;
-
-		if (orioledb_s3_mode)
-		{
-			chkpNum = S3_GET_CHKP_NUM(byte_offset);
-			byte_offset &= S3_OFFSET_MASK;
-		}
-
-		if (use_device)
-			byte_offset *= (off_t) ORIOLEDB_COMP_BLCKSZ;
-		else
-			byte_offset *= (off_t) ORIOLEDB_BLCKSZ;
-		write_size = ORIOLEDB_BLCKSZ;
-
 		memset(buf, 0, sizeof(OrioleDBOndiskPageHeader));
 		ondisk_page_header = (OrioleDBOndiskPageHeader *) buf;
 		ondisk_page_header->checkpointNum = curChkpNum;
 		ondisk_page_header->page_version = ORIOLEDB_PAGE_VERSION;
 		memcpy(&buf[sizeof(OrioleDBOndiskPageHeader)], page + sizeof(OrioleDBOndiskPageHeader), ORIOLEDB_BLCKSZ - sizeof(OrioleDBOndiskPageHeader));
-
-		err = btree_smgr_write(desc, buf, chkpNum, write_size, byte_offset) != write_size;
+		write_size = ORIOLEDB_BLCKSZ;
 	}
 	else
 	{
 		OrioleDBOndiskPageHeader ondisk_page_header = {0};
 
-		byte_offset = (off_t) extent->off;
-		if (orioledb_s3_mode)
-		{
-			chkpNum = S3_GET_CHKP_NUM(byte_offset);
-			byte_offset &= S3_OFFSET_MASK;
-		}
-		byte_offset *= (off_t) ORIOLEDB_COMP_BLCKSZ;
-
 		/*
 		 * overflow protection
 		 */
 		Assert(sizeof(((OrioleDBOndiskPageHeader *) 0)->compress_page_size) == sizeof(uint16));
 		Assert(ORIOLEDB_BLCKSZ < UINT16_MAX);
 
-		/* we need to write header first */
+		/* header goes first */
 		ondisk_page_header.compress_page_size = page_size;
 		ondisk_page_header.checkpointNum = curChkpNum;
 		ondisk_page_header.compress_version = ORIOLEDB_COMPRESS_VERSION;
 		ondisk_page_header.page_version = ORIOLEDB_PAGE_VERSION;
-
+		if (page_size != ORIOLEDB_BLCKSZ)
+			ondisk_page_header.compress_codec = OCompressGetCodec(desc->compress);
+		memcpy(buf, &ondisk_page_header, sizeof(OrioleDBOndiskPageHeader));
 		write_size = sizeof(OrioleDBOndiskPageHeader);
-		err = btree_smgr_write(desc, (char *) &ondisk_page_header, chkpNum, write_size, byte_offset) != write_size;
-		byte_offset += write_size;
-
-		if (err)
-			return false;
 
 		if (page_size != ORIOLEDB_BLCKSZ)
 		{
-			write_size = extent->len * ORIOLEDB_COMP_BLCKSZ - sizeof(OrioleDBOndiskPageHeader);
-			err = btree_smgr_write(desc, page, chkpNum, write_size, byte_offset) != write_size;
+			off_t		data_size = extent->len * ORIOLEDB_COMP_BLCKSZ - sizeof(OrioleDBOndiskPageHeader);
+
+			memcpy(buf + write_size, page, data_size);
+			write_size += data_size;
 		}
 		else
 		{
 			size_t		skipped = offsetof(BTreePageHeader, undoLocation);
 
 			/* Skipping chkpNum because it is present in BTreePageHeader */
-			page += skipped;
-			write_size = ORIOLEDB_BLCKSZ - skipped;
-			err = btree_smgr_write(desc, page, chkpNum, write_size, byte_offset) != write_size;
+			memcpy(buf + write_size, page + skipped, ORIOLEDB_BLCKSZ - skipped);
+			write_size += ORIOLEDB_BLCKSZ - skipped;
 		}
 	}
+	Assert(write_size <= ORIOLEDB_BLCKSZ);
 
-	return !err;
+	if (page_checksums)
+	{
+		OrioleDBOndiskPageHeader *ondisk_page_header = (OrioleDBOndiskPageHeader *) buf;
+
+		ondisk_page_header->flags |= O_ONDISK_PAGE_CHECKSUM;
+		ondisk_page_header->checksum = ondisk_page_checksum(buf, write_size);
+	}
+
+	return write_size;
+}
+
+/*
+ * Writes a page to the disk. An array of file offsets must be valid.
+ */
+static bool
+write_page_to_disk(BTreeDescr *desc, FileExtent *extent, uint32 curChkpNum,
+				   Pointer page, off_t page_size)
+{
+	off_t		byte_offset,
+				write_size;
+	uint32		chkpNum = 0;
+	OIOAlignedPage buf;
+
+	Assert(FileExtentOffIsValid(extent->off));
+
+	byte_offset = (off_t) extent->off;
+	if (orioledb_s3_mode)
+	{
+		chkpNum = S3_GET_CHKP_NUM(byte_offset);
+		byte_offset &= S3_OFFSET_MASK;
+	}
+
+	if (use_device || OCompressIsValid(desc->compress))
+		byte_offset *= (off_t) ORIOLEDB_COMP_BLCKSZ;
+	else
+		byte_offset *= (off_t) ORIOLEDB_BLCKSZ;
+
+	write_size = make_ondisk_page_image(desc, extent, curChkpNum,
+										page, page_size, buf.data);
+
+	compressed_cache_invalidate(desc, extent->off);
+	zone_map_invalidate(desc, extent->off);
+
+	return btree_smgr_write(desc, buf.data, chkpNum, write_size, byte_offset) == write_size;
 }
 
 /*
@@ -1422,6 +1780,11 @@ load_page(OBTreeFindPageContext *context)
 	bool		was_image = false;
 	bool		was_keep_lokey = false;
 	uint32		chkpNum = 0;
+	bool		ioTiming = tree_stats_enabled() && track_io_timing,
+				eaTiming = EA_IO_TIMING();
+	instr_time	ioStart;
+	uint32		s3ColdReads = s3_header_my_cold_reads;
+	OpSamplingProcState opSaved;
 
 	context_index = context->index;
 	parent_blkno = context->items[context_index].blkno;
@@ -1429,6 +1792,8 @@ load_page(OBTreeFindPageContext *context)
 	parent_change_count = context->items[context_index].pageChangeCount;
 	parent_page = O_GET_IN_MEMORY_PAGE(parent_blkno);
 
+	tree_stats_count(desc->oids, TreeStatMisses);
+
 	ionum = assign_io_num(parent_blkno, BTREE_PAGE_LOCATOR_GET_OFFSET(parent_page, parent_loc));
 
 	/* Modify parent downlink: indicate that IO is in-progress */
@@ -1467,6 +1832,11 @@ load_page(OBTreeFindPageContext *context)
 	page_desc->flags = 0;
 
 	/* Read page data and put it to the page */
+	ORIOLEDB_PROBE3(load_page__start, desc->oids.datoid, desc->oids.relnode,
+					DOWNLINK_GET_DISK_OFF(downlink));
+	if (ioTiming || eaTiming)
+		INSTR_TIME_SET_CURRENT(ioStart);
+	opSaved = op_sampling_begin(OpSamplingIORead, desc->oids);
 	if (!read_page_from_disk(desc, buf, downlink, &page_desc->fileExtent))
 	{
 		int_hdr->downlink = downlink;
@@ -1481,11 +1851,22 @@ load_page(OBTreeFindPageContext *context)
 							   btree_smgr_filename(desc, DOWNLINK_GET_DISK_OFF(downlink), chkpNum))));
 	}
 
+	op_sampling_end(opSaved);
+	if (ioTiming)
+		tree_stats_add_time(desc->oids, TreeStatLoadTime, ioStart);
+	if (eaTiming)
+		EA_TREE_IO_TIME(desc->oids, ioStart);
+	if (s3_header_my_cold_reads != s3ColdReads)
+		EA_TREE_ADD(desc->oids, s3Read, s3_header_my_cold_reads - s3ColdReads);
+	ORIOLEDB_PROBE3(load_page__done, desc->oids.datoid, desc->oids.relnode,
+					target_level);
+
 	put_page_image(blkno, buf);
 	page_change_usage_count(&desc->ppool->ucm, blkno,
-							(pg_atomic_read_u32(desc->ppool->ucm.epoch) + 2) % UCM_USAGE_LEVELS);
+							ppool_loaded_page_usage_count(desc->ppool,
+														  parent_page_desc->oids));
 	page_desc->type = parent_page_desc->type;
-	page_desc->oids = parent_page_desc->oids;
+	ppool_page_set_owner(desc->ppool, blkno, parent_page_desc->oids);
 
 	Assert(O_PAGE_IS(page, LEAF) ||
 		   (PAGE_GET_N_ONDISK(page) == BTREE_PAGE_ITEMS_COUNT(page)));
@@ -1621,8 +2002,24 @@ get_write_img(BTreeDescr *desc, Page page, size_t *size)
 
 	if (OCompressIsValid(desc->compress))
 	{
-		result = o_compress_page(page, size, desc->compress);
-		if (*size > (ORIOLEDB_BLCKSZ - ORIOLEDB_COMP_BLCKSZ - sizeof(OrioleDBOndiskPageHeader)))
+		OCompress	lvl = o_compress_tree_level(desc);
+
+		o_compress_sample_page(desc, page);
+		if (OCompressIsValid(lvl))
+		{
+			OpSamplingProcState opSaved;
+
+			opSaved = op_sampling_begin(OpSamplingCompress, desc->oids);
+			result = o_compress_tree_page(desc, page, size, lvl);
+			op_sampling_end(opSaved);
+		}
+		else
+		{
+			/* The automatic selection found the compression not worth it */
+			result = page;
+			*size = ORIOLEDB_BLCKSZ;
+		}
+		if (*size >= ORIOLEDB_BLCKSZ || CompressedSize(*size) >= ORIOLEDB_BLCKSZ)
 		{
 			/*
 			 * No sense to write compressed page
@@ -1630,6 +2027,11 @@ get_write_img(BTreeDescr *desc, Page page, size_t *size)
 			result = page;
 			*size = ORIOLEDB_BLCKSZ;
 		}
+		if (tree_stats_enabled())
+		{
+			tree_stats_add(desc->oids, TreeStatCompressBytesIn, ORIOLEDB_BLCKSZ);
+			tree_stats_add(desc->oids, TreeStatCompressBytesOut, *size);
+		}
 	}
 	else
 	{
@@ -1673,6 +2075,8 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 	int			chkp_index;
 	bool		less_num,
 				err = false;
+	bool		ioTiming = tree_stats_enabled() && track_io_timing;
+	instr_time	ioStart;
 
 #ifdef USE_ASSERT_CHECKING
 	prewrite_image_check(img);
@@ -1680,6 +2084,9 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 
 	EA_WRITE_INC(blkno);
 
+	if (ioTiming)
+		INSTR_TIME_SET_CURRENT(ioStart);
+
 	less_num = header->o_header.checkpointNum < checkpoint_number;
 	if (less_num)
 	{
@@ -1864,6 +2271,10 @@ perform_page_io(BTreeDescr *desc, OInMemoryBlkno blkno,
 		return InvalidDiskDownlink;
 	}
 
+	tree_stats_count(desc->oids, TreeStatWrites);
+	if (ioTiming)
+		tree_stats_add_time(desc->oids, TreeStatWriteTime, ioStart);
+
 	return MAKE_ON_DISK_DOWNLINK(page_desc->fileExtent);
 }
 
@@ -1928,7 +2339,8 @@ perform_page_io_autonomous(BTreeDescr *desc, uint32 chkpNum, Page img, FileExten
  */
 uint64
 perform_page_io_build(BTreeDescr *desc, Page img,
-					  FileExtent *extent, BTreeMetaPage *metaPage)
+					  FileExtent *extent, BTreeMetaPage *metaPage,
+					  BTreeBuildWriteBuffer *writeBuffer)
 {
 	Pointer		write_img;
 	size_t		write_size;
@@ -1995,6 +2407,49 @@ perform_page_io_build(BTreeDescr *desc, Page img,
 
 	Assert(FileExtentIsValid(*extent));
 
+	compressed_cache_invalidate(desc, extent->off);
+	zone_map_invalidate(desc, extent->off);
+
+	/*
+	 * Without S3 and device, the extents of the subsequent pages are
+	 * allocated one after another.  Gather them into a single write.
+	 */
+	if (writeBuffer && !orioledb_s3_mode && !use_device && !use_mmap)
+	{
+		off_t		byte_offset,
+					extent_size;
+		off_t		image_size;
+
+		if (OCompressIsValid(desc->compress))
+		{
+			byte_offset = (off_t) extent->off * ORIOLEDB_COMP_BLCKSZ;
+			extent_size = (off_t) extent->len * ORIOLEDB_COMP_BLCKSZ;
+		}
+		else
+		{
+			byte_offset = (off_t) extent->off * ORIOLEDB_BLCKSZ;
+			extent_size = ORIOLEDB_BLCKSZ;
+		}
+
+		if (writeBuffer->length > 0 &&
+			(writeBuffer->offset + writeBuffer->length != byte_offset ||
+			 writeBuffer->length + extent_size > BTREE_BUILD_WRITE_BUFFER_SIZE))
+			btree_build_flush_writes(desc, writeBuffer);
+
+		if (writeBuffer->length == 0)
+			writeBuffer->offset = byte_offset;
+
+		image_size = make_ondisk_page_image(desc, extent, 0,
+											write_img, write_size,
+											writeBuffer->data + writeBuffer->length);
+		Assert(image_size <= extent_size);
+		memset(writeBuffer->data + writeBuffer->length + image_size, 0,
+			   extent_size - image_size);
+		writeBuffer->length += extent_size;
+
+		return MAKE_ON_DISK_DOWNLINK(*extent);
+	}
+
 	if (!write_page_to_disk(desc, extent, 0, write_img, write_size))
 	{
 		ereport(PANIC, (errcode_for_file_access(),
@@ -2008,6 +2463,25 @@ perform_page_io_build(BTreeDescr *desc, Page img,
 	return MAKE_ON_DISK_DOWNLINK(*extent);
 }
 
+/*
+ * Writes the pages gathered by perform_page_io_build() to the disk.
+ */
+void
+btree_build_flush_writes(BTreeDescr *desc, BTreeBuildWriteBuffer *writeBuffer)
+{
+	if (writeBuffer->length == 0)
+		return;
+
+	if (btree_smgr_write(desc, writeBuffer->data, 0, writeBuffer->length,
+						 writeBuffer->offset) != writeBuffer->length)
+		ereport(PANIC, (errcode_for_file_access(),
+						errmsg("could not write index build pages to file %s with offset %lu: %m",
+							   btree_smgr_filename(desc, writeBuffer->offset, 0),
+							   (unsigned long) writeBuffer->offset)));
+
+	writeBuffer->length = 0;
+}
+
 /*
  * Prepare internal page for writing to disk.
  */
@@ -2063,6 +2537,7 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 	uint32		parent_change_count = 0;
 	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
 	bool		is_root = desc->rootInfo.rootPageBlkno == blkno;
+	OpSamplingProcState opSaved;
 
 	/* rootPageBlkno can not be evicted here */
 	Assert(!evict || !is_root);
@@ -2070,6 +2545,15 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 	Assert(page_is_locked(blkno));
 	EA_EVICT_INC(blkno);
 
+	if (evict)
+	{
+		tree_stats_count(desc->oids, TreeStatEvictions);
+		if (IS_DIRTY(blkno))
+			pg_atomic_fetch_add_u64(&desc->ppool->stats->evictedDirty, 1);
+		else
+			pg_atomic_fetch_add_u64(&desc->ppool->stats->evictedClean, 1);
+	}
+
 	if (!is_root)
 	{
 		context_index = context->index;
@@ -2130,11 +2614,17 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 			unlock_page(parent_blkno);
 
 		/* Perform actual IO */
+		ORIOLEDB_PROBE4(write_page__start, desc->oids.datoid,
+						desc->oids.relnode, blkno, evict);
 		if (evict)
 		{
 			unlock_page(blkno);
+			opSaved = op_sampling_begin(OpSamplingIOWrite, desc->oids);
 			new_downlink = perform_page_io(desc, blkno, p,
 										   checkpoint_number, copy_blkno, &dirty_parent);
+			op_sampling_end(opSaved);
+			ORIOLEDB_PROBE4(write_page__done, desc->oids.datoid,
+							desc->oids.relnode, blkno, new_downlink);
 
 			if (DiskDownlinkIsValid(new_downlink))
 				writeback_put_extent(&io_writeback, desc, new_downlink);
@@ -2158,8 +2648,12 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 				params = btree_page_stopevent_params(desc, p);
 				STOPEVENT(STOPEVENT_AFTER_IONUM_SET, params);
 			}
+			opSaved = op_sampling_begin(OpSamplingIOWrite, desc->oids);
 			new_downlink = perform_page_io(desc, blkno, img,
 										   checkpoint_number, copy_blkno, &dirty_parent);
+			op_sampling_end(opSaved);
+			ORIOLEDB_PROBE4(write_page__done, desc->oids.datoid,
+							desc->oids.relnode, blkno, new_downlink);
 
 			if (DiskDownlinkIsValid(new_downlink))
 				writeback_put_extent(&io_writeback, desc, new_downlink);
@@ -2248,6 +2742,13 @@ write_page(OBTreeFindPageContext *context, OInMemoryBlkno blkno, Page img,
 		unlock_io(ionum);
 	}
 
+	/*
+	 * Cache the evicted image while the parent is still locked: no one can
+	 * load the page back and rewrite its extent before we finish.
+	 */
+	if (evict)
+		compressed_cache_put(desc, page_desc->fileExtent.off, p);
+
 	if (!is_root)
 		unlock_page(parent_blkno);
 
@@ -2313,7 +2814,7 @@ btree_finalize_private_seq_bufs(BTreeDescr *desc, EvictedTreeData *evicted_data,
 
 		evicted_data->tmpBuf.tag = desc->tmpBuf[chkp_index].shared->tag;
 		if (notModified)
-			seq_buf_close_file(&desc->nextChkp[chkp_index]);
+			seq_buf_close_file(&desc->tmpBuf[chkp_index]);
 		else
 			evicted_data->tmpBuf.offset = seq_buf_finalize(&desc->tmpBuf[chkp_index]);
 		FREE_PAGE_IF_VALID(desc->ppool, desc->tmpBuf[chkp_index].shared->pages[0]);
@@ -2354,6 +2855,7 @@ evict_btree(BTreeDescr *desc, uint32 checkpoint_number)
 
 	/* we check it before */
 	Assert(!RightLinkIsValid(BTREE_PAGE_GET_RIGHTLINK(rootPageBlkno)));
+	ORIOLEDB_PROBE2(evict_btree__start, desc->oids.datoid, desc->oids.relnode);
 	if (orioledb_s3_mode)
 	{
 		btree_s3_flush(desc, checkpoint_number);
@@ -2398,7 +2900,11 @@ evict_btree(BTreeDescr *desc, uint32 checkpoint_number)
 	{
 		if (!LWLockConditionalAcquire(&checkpoint_state->oTablesMetaLock,
 									  LW_SHARED))
+		{
+			ORIOLEDB_PROBE3(evict_btree__done, desc->oids.datoid,
+							desc->oids.relnode, false);
 			return false;
+		}
 	}
 
 	file_header.rootDownlink = new_downlink;
@@ -2458,6 +2964,8 @@ evict_btree(BTreeDescr *desc, uint32 checkpoint_number)
 	if (!hasMetaLock)
 		LWLockRelease(&checkpoint_state->oTablesMetaLock);
 
+	ORIOLEDB_PROBE3(evict_btree__done, desc->oids.datoid, desc->oids.relnode,
+					true);
 	return true;
 }
 
@@ -2482,6 +2990,17 @@ index_oids_get_btree_descr(ORelOids oids, OIndexType type)
 	return desc;
 }
 
+/*
+ * Counts the eviction candidate rejected by walk_page().
+ */
+static inline OWalkPageResult
+walk_page_reject(OInMemoryBlkno blkno, bool evict, PPoolRejectReason reason)
+{
+	if (evict)
+		pg_atomic_fetch_add_u64(&get_ppool_by_blkno(blkno)->stats->rejected[reason], 1);
+	return OWalkPageSkipped;
+}
+
 /*
  * Examine single page and evict it if possible.
  */
@@ -2507,10 +3026,10 @@ walk_page(OInMemoryBlkno blkno, bool evict)
 retry:
 
 	if (!ORelOidsIsValid(page_desc->oids) || page_desc->type == oIndexInvalid)
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectNoTree);
 
 	if (!O_PAGE_IS(p, LEAF) && evict && PAGE_GET_N_ONDISK(p) != BTREE_PAGE_ITEMS_COUNT(p))
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectChildren);
 
 	if (!evict && !IS_DIRTY(blkno))
 		return OWalkPageSkipped;
@@ -2528,7 +3047,7 @@ retry:
 		if (sys_tree_get_storage_type(oids.relnode) != BTreeStorageInMemory)
 			desc = get_sys_tree(oids.relnode);
 		else
-			return OWalkPageSkipped;
+			return walk_page_reject(blkno, evict, PPoolRejectNoTree);
 	}
 	else
 	{
@@ -2536,11 +3055,11 @@ retry:
 		desc = index_oids_get_btree_descr(oids, page_desc->type);
 
 		if (desc == NULL)
-			return OWalkPageSkipped;
+			return walk_page_reject(blkno, evict, PPoolRejectNoTree);
 	}
 
 	if (!try_lock_page(blkno))
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectLocked);
 
 	/* page is locked once we get here */
 
@@ -2549,7 +3068,7 @@ retry:
 		!ORelOidsIsEqual(oids, page_desc->oids))
 	{
 		unlock_page(blkno);
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectNoTree);
 	}
 
 	if (!evict && !IS_DIRTY(blkno))
@@ -2558,10 +3077,13 @@ retry:
 		return OWalkPageSkipped;
 	}
 
-	if (O_PAGE_IS(p, PRE_CLEANUP))
+	/* The marked root means the tree is queued for the lazy cleanup */
+	if (O_PAGE_IS(p, PRE_CLEANUP) ||
+		(ORootPageIsValid(desc) &&
+		 O_PAGE_IS(O_GET_IN_MEMORY_PAGE(desc->rootInfo.rootPageBlkno), PRE_CLEANUP)))
 	{
 		unlock_page(blkno);
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectLocked);
 	}
 
 	/* On concurrent IO, then wait for completion and retry */
@@ -2576,7 +3098,7 @@ retry:
 	if (!O_PAGE_IS(p, LEAF) && evict && PAGE_GET_N_ONDISK(p) != BTREE_PAGE_ITEMS_COUNT(p))
 	{
 		unlock_page(blkno);
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectChildren);
 	}
 
 	if (!O_PAGE_IS(p, LEAF) && !evict)
@@ -2592,7 +3114,7 @@ retry:
 	if (RightLinkIsValid(BTREE_PAGE_GET_RIGHTLINK(p)))
 	{
 		unlock_page(blkno);
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectLocked);
 	}
 
 	/* Try to merge sparse page instead of eviction */
@@ -2646,7 +3168,7 @@ retry:
 			Assert(findResult == OFindPageResultFailure);
 			unlock_page(blkno);
 			Assert(!have_locked_pages());
-			return OWalkPageSkipped;
+			return walk_page_reject(blkno, evict, PPoolRejectLocked);
 		}
 
 		BTREE_PAGE_FIND_UNSET(&context, TRY_LOCK);
@@ -2663,14 +3185,14 @@ retry:
 			 */
 			unlock_page(blkno);
 			unlock_page(context.items[context.index].blkno);
-			return OWalkPageSkipped;
+			return walk_page_reject(blkno, evict, PPoolRejectLocked);
 		}
 	}
 	else if (IS_SYS_TREE_OIDS(oids))
 	{
 		Assert(is_root);
 		unlock_page(blkno);
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectRoot);
 	}
 
 	if (!get_checkpoint_number(desc, blkno, &checkpoint_number, &copy_blkno))
@@ -2681,7 +3203,7 @@ retry:
 		{
 			unlock_page(context.items[context.index].blkno);
 		}
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectCheckpoint);
 	}
 
 	if (evict && is_root)
@@ -2693,7 +3215,7 @@ retry:
 		if (tree_is_under_checkpoint(desc))
 		{
 			unlock_page(blkno);
-			return OWalkPageSkipped;
+			return walk_page_reject(blkno, evict, PPoolRejectCheckpoint);
 		}
 
 		if (!recovery)
@@ -2734,7 +3256,8 @@ retry:
 				if (!recovery)
 					o_tables_rel_unlock_extended(&oids, AccessExclusiveLock, false);
 				o_tables_rel_unlock_extended(&oids, AccessExclusiveLock, true);
-				return result ? OWalkPageEvicted : OWalkPageSkipped;
+				return result ? OWalkPageEvicted :
+					walk_page_reject(blkno, evict, PPoolRejectRoot);
 			}
 			else
 			{
@@ -2743,7 +3266,7 @@ retry:
 			}
 		}
 		unlock_page(blkno);
-		return OWalkPageSkipped;
+		return walk_page_reject(blkno, evict, PPoolRejectRoot);
 	}
 
 	STOPEVENT(STOPEVENT_BEFORE_WRITE_PAGE, NULL);
@@ -3021,7 +3544,7 @@ perform_writeback(IOWriteBack *writeback)
 			if (use_mmap)
 			{
 				if (len > 0)
-					msync(mmap_data + (off_t) segno * ORIOLEDB_SEGMENT_SIZE + (off_t) offset * blcksz, (off_t) len * blcksz, MS_ASYNC);
+					o_device_writeback((off_t) segno * ORIOLEDB_SEGMENT_SIZE + (off_t) offset * blcksz, (off_t) len * blcksz);
 			}
 			else
 			{
@@ -3064,7 +3587,7 @@ perform_writeback(IOWriteBack *writeback)
 			else
 			{
 				if (use_mmap)
-					msync(mmap_data + (off_t) segno * ORIOLEDB_SEGMENT_SIZE + (off_t) offset * blcksz, (off_t) len * blcksz, MS_ASYNC);
+					o_device_writeback((off_t) segno * ORIOLEDB_SEGMENT_SIZE + (off_t) offset * blcksz, (off_t) len * blcksz);
 				else
 					FileWriteback(file, (off_t) offset * blcksz,
 								  (off_t) len * blcksz,
@@ -3079,7 +3602,7 @@ perform_writeback(IOWriteBack *writeback)
 	{
 		Assert(blcksz != 0);
 		if (use_mmap)
-			msync(mmap_data + (off_t) segno * ORIOLEDB_SEGMENT_SIZE + (off_t) offset * blcksz, (off_t) len * blcksz, MS_ASYNC);
+			o_device_writeback((off_t) segno * ORIOLEDB_SEGMENT_SIZE + (off_t) offset * blcksz, (off_t) len * blcksz);
 		else
 			FileWriteback(file, (off_t) offset * blcksz,
 						  (off_t) len * blcksz,
@@ -3133,6 +3656,10 @@ iterate_relnode_files(Oid datoid, Oid relnode, RelnodeFileCallback callback,
 			 (file_ext_p = file_ext)) ||
 			sscanf(file->d_name, "%10u.%10u",
 				   &file_relnode, &file_segno) == 2 ||
+			(sscanf(file->d_name, "%10u.%4s",
+					&file_relnode, file_ext) == 2 &&
+			 !strcmp(file_ext, "dict") &&
+			 (file_ext_p = file_ext)) ||
 			sscanf(file->d_name, "%10u",
 				   &file_relnode) == 1)
 		{
@@ -3180,6 +3707,8 @@ unlink_callback(const char *filename, uint32 segno, char *ext, void *arg)
 bool
 cleanup_btree_files(Oid datoid, Oid relnode, bool fsync)
 {
+	compressed_cache_invalidate_relnode(datoid, relnode);
+	zone_map_invalidate_relnode(datoid, relnode);
 	return iterate_relnode_files(datoid, relnode, unlink_callback, (void *) &fsync);
 }
 
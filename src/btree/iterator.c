@@ -17,12 +17,15 @@
 
 #include "btree/btree.h"
 #include "btree/find.h"
+#include "btree/io.h"
 #include "btree/iterator.h"
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
 #include "catalog/sys_trees.h"
+#include "tableam/handler.h"
 #include "transam/oxid.h"
 #include "transam/undo.h"
+#include "utils/op_sampling.h"
 #include "utils/page_pool.h"
 
 #include "access/transam.h"
@@ -65,6 +68,11 @@ struct BTreeIterator
 	/* callback for fetching tuple version */
 	TupleFetchCallback fetchCallback;
 	void	   *fetchCallbackArg;
+	/* parent page, whose downlinks are being prefetched */
+	OInMemoryBlkno prefetchBlkno;
+	uint32		prefetchChangeCount;
+	/* offset of the last prefetched downlink in the parent page */
+	int			prefetchOffset;
 #ifdef USE_ASSERT_CHECKING
 	/* additional check for iteration order */
 	OFixedTuple prevTuple;
@@ -72,6 +80,7 @@ struct BTreeIterator
 };
 
 static void get_next_combined_location(BTreeIterator *it);
+static void btree_iterator_prefetch(BTreeIterator *it);
 static void load_page_from_undo(BTreeIterator *it, void *key, BTreeKeyType kind);
 static bool btree_iterator_check_load_next_page(BTreeIterator *it);
 static OTuple o_btree_iterator_fetch_internal(BTreeIterator *it,
@@ -93,7 +102,10 @@ static void undo_it_find_internal(UndoIterator *undoIt, void *key, BTreeKeyType
 #define IT_NEXT_OFFSET(it, loc) \
 	do { \
 		if (IT_IS_FORWARD(it)) \
+		{ \
 			BTREE_PAGE_LOCATOR_NEXT((it)->context.img, (loc)); \
+			BTREE_PAGE_LOCATOR_PREFETCH((it)->context.img, (loc)); \
+		} \
 		else if (IT_IS_BACKWARD(it)) \
 			BTREE_PAGE_LOCATOR_PREV((it)->context.img, (loc)); \
 	} while (0); \
@@ -106,6 +118,39 @@ static void undo_it_find_internal(UndoIterator *undoIt, void *key, BTreeKeyType
 			BTREE_PAGE_LOCATOR_PREV((undoIt)->image, (loc)); \
 	} while (0); \
 
+/*
+ * Returns CSN for the page find context to fetch a tuple with the given
+ * snapshot.  Without current undo, we have to combine the results of the
+ * current page and its undo image by ourselves.
+ */
+static inline CommitSeqNo
+find_tuple_context_csn(BTreeDescr *desc, OSnapshot *read_o_snapshot)
+{
+	if (COMMITSEQNO_IS_NORMAL(read_o_snapshot->csn) &&
+		!have_current_undo(desc->undoType))
+		return COMMITSEQNO_INPROGRESS;
+	return read_o_snapshot->csn;
+}
+
+/* State of the lookup of the series of ascending keys */
+struct BTreeKeysLookup
+{
+	OBTreeFindPageContext context;
+	/* does the context hold the descent path of the previous key? */
+	bool		valid;
+};
+
+static OTuple find_tuple_by_key_internal(OBTreeFindPageContext *context,
+										 bool resume, void *key,
+										 BTreeKeyType kind,
+										 OSnapshot *read_o_snapshot,
+										 CommitSeqNo *out_csn,
+										 MemoryContext mcxt,
+										 BTreeLocationHint *hint,
+										 bool *deleted,
+										 TupleFetchCallback cb,
+										 void *arg);
+
 /*
  * Fetches tuple from the tree with given CSN snapshot.  Tuple is allocated
  * in the given context.  Leaf page is found using the given hint (if provided).
@@ -120,38 +165,113 @@ o_btree_find_tuple_by_key_cb(BTreeDescr *desc, void *key,
 							 TupleFetchCallback cb,
 							 void *arg)
 {
-	BTreePageItemLocator loc;
 	OBTreeFindPageContext context;
+
+	init_page_find_context(&context, desc,
+						   find_tuple_context_csn(desc, read_o_snapshot),
+						   BTREE_PAGE_FIND_FETCH);
+
+	return find_tuple_by_key_internal(&context, false, key, kind,
+									  read_o_snapshot, out_csn, mcxt, hint,
+									  deleted, cb, arg);
+}
+
+/*
+ * Creates the state for the lookup of the series of ascending keys.  It keeps
+ * the descent path between the lookups, so each next key is searched from the
+ * previously found leaf instead of the root.
+ */
+BTreeKeysLookup *
+o_btree_keys_lookup_create(void)
+{
+	BTreeKeysLookup *lookup;
+
+	lookup = (BTreeKeysLookup *) palloc(sizeof(BTreeKeysLookup));
+	lookup->valid = false;
+	return lookup;
+}
+
+/*
+ * Forget the saved descent path.  Should be called when the next key isn't
+ * guaranteed to follow the previous one.
+ */
+void
+o_btree_keys_lookup_reset(BTreeKeysLookup *lookup)
+{
+	lookup->valid = false;
+}
+
+void
+o_btree_keys_lookup_free(BTreeKeysLookup *lookup)
+{
+	pfree(lookup);
+}
+
+/*
+ * Fetches tuple by the key, which must be greater or equal to the key of the
+ * previous call for the same lookup.  Otherwise the same as
+ * o_btree_find_tuple_by_key().
+ */
+OTuple
+o_btree_keys_lookup_fetch(BTreeKeysLookup *lookup, BTreeDescr *desc,
+						  void *key, BTreeKeyType kind,
+						  OSnapshot *read_o_snapshot, CommitSeqNo *out_csn,
+						  MemoryContext mcxt, BTreeLocationHint *hint)
+{
+	CommitSeqNo csn = find_tuple_context_csn(desc, read_o_snapshot);
+	bool		resume;
+
+	resume = lookup->valid &&
+		lookup->context.desc == desc &&
+		lookup->context.csn == csn;
+
+	if (!resume)
+		init_page_find_context(&lookup->context, desc, csn,
+							   BTREE_PAGE_FIND_FETCH);
+	lookup->valid = true;
+
+	return find_tuple_by_key_internal(&lookup->context, resume, key, kind,
+									  read_o_snapshot, out_csn, mcxt, hint,
+									  NULL, NULL, NULL);
+}
+
+static OTuple
+find_tuple_by_key_internal(OBTreeFindPageContext *context, bool resume,
+						   void *key, BTreeKeyType kind,
+						   OSnapshot *read_o_snapshot, CommitSeqNo *out_csn,
+						   MemoryContext mcxt, BTreeLocationHint *hint,
+						   bool *deleted, TupleFetchCallback cb, void *arg)
+{
+	BTreeDescr *desc = context->desc;
+	BTreePageItemLocator loc;
 	char	   *img;
 	BTreePageHeader *header;
-	bool		combinedResult = false;
+	bool		combinedResult;
 	OTuple		result;
 	OFindPageResult findResult PG_USED_FOR_ASSERTS_ONLY;
 
-	if (COMMITSEQNO_IS_NORMAL(read_o_snapshot->csn))
-		combinedResult = !have_current_undo(desc->undoType);
-
-	init_page_find_context(&context, desc,
-						   combinedResult ? COMMITSEQNO_INPROGRESS : read_o_snapshot->csn,
-						   BTREE_PAGE_FIND_FETCH);
+	combinedResult = COMMITSEQNO_IS_INPROGRESS(context->csn) &&
+		COMMITSEQNO_IS_NORMAL(read_o_snapshot->csn);
 
 	/* Use page location hint if provided */
-	if (hint && OInMemoryBlknoIsValid(hint->blkno))
-		findResult = refind_page(&context, key, kind, 0, hint->blkno, hint->pageChangeCount);
+	if (resume)
+		findResult = find_page_resume(context, key, kind, 0);
+	else if (hint && OInMemoryBlknoIsValid(hint->blkno))
+		findResult = refind_page(context, key, kind, 0, hint->blkno, hint->pageChangeCount);
 	else
-		findResult = find_page(&context, key, kind, 0);
+		findResult = find_page(context, key, kind, 0);
 
 	Assert(findResult == OFindPageResultSuccess);
 
-	loc = context.items[context.index].locator;
-	img = context.img;
+	loc = context->items[context->index].locator;
+	img = context->img;
 	header = (BTreePageHeader *) img;
 
 	/* Adjust hint if given */
 	if (hint)
 	{
-		hint->blkno = context.items[context.index].blkno;
-		hint->pageChangeCount = context.items[context.index].pageChangeCount;
+		hint->blkno = context->items[context->index].blkno;
+		hint->pageChangeCount = context->items[context->index].pageChangeCount;
 	}
 
 	if (combinedResult && header->csn >= read_o_snapshot->csn)
@@ -233,23 +353,27 @@ o_btree_find_tuple_by_key(BTreeDescr *desc, void *key, BTreeKeyType kind,
 
 
 /*
- * Finds appropriate tuple version in the undo chain.
+ * Finds appropriate tuple version in the undo chain.  The result points to
+ * the page 'p', unless '*allocated' is set, which means the version is read
+ * from undo into 'mcxt'.
  */
-OTuple
-o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
-					 OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
-					 MemoryContext mcxt, TupleFetchCallback cb,
-					 void *arg)
+static OTuple
+o_find_tuple_version_internal(BTreeDescr *desc, Page p,
+							  BTreePageItemLocator *loc,
+							  OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
+							  MemoryContext mcxt, TupleFetchCallback cb,
+							  void *arg, bool *allocated)
 {
 	BTreeLeafTuphdr tupHdr,
 			   *tupHdrPtr;
 	OTuple		curTuple;
 	OTuple		result;
-	int			result_size;
 	UndoLocation undoLocation = InvalidUndoLocation;
 	bool		curTupleAllocated = false;
 	MemoryContext prevMctx;
 
+	EA_TREE_INC(desc->oids, visibility);
+
 	prevMctx = MemoryContextSwitchTo(mcxt);
 
 	BTREE_PAGE_READ_LEAF_ITEM(tupHdrPtr, curTuple, p, loc);
@@ -374,10 +498,13 @@ o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
 		}
 		else
 		{
-			if (curTupleAllocated)
-				pfree(curTuple.data);
+			OTuple		newerTuple = curTuple;
+
+			/* The delta record restores the old version from the newer one */
 			get_prev_leaf_header_and_tuple_from_undo(desc->undoType, &tupHdr,
 													 &curTuple, 0);
+			if (curTupleAllocated)
+				pfree(newerTuple.data);
 			curTupleAllocated = true;
 		}
 
@@ -401,24 +528,112 @@ o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
 		return result;
 	}
 
-	if (!curTupleAllocated)
-	{
-		result_size = o_btree_len(desc, curTuple, OTupleLength);
-		/* TODO: check result tuple size */
-		result.data = (Pointer) MemoryContextAlloc(mcxt, result_size);
-		memcpy(result.data, curTuple.data, result_size);
-		result.formatFlags = curTuple.formatFlags;
-	}
-	else
-	{
-		result = curTuple;
-	}
-
 	Assert(!UndoLocationIsValid(undoLocation) || UNDO_REC_EXISTS(desc->undoType, undoLocation));
 	MemoryContextSwitchTo(prevMctx);
+	*allocated = curTupleAllocated;
+	return curTuple;
+}
+
+static OTuple
+o_copy_tuple_version(BTreeDescr *desc, OTuple tuple, MemoryContext mcxt)
+{
+	OTuple		result;
+	int			result_size;
+
+	result_size = o_btree_len(desc, tuple, OTupleLength);
+	/* TODO: check result tuple size */
+	result.data = (Pointer) MemoryContextAlloc(mcxt, result_size);
+	memcpy(result.data, tuple.data, result_size);
+	result.formatFlags = tuple.formatFlags;
 	return result;
 }
 
+/*
+ * Finds appropriate tuple version in the undo chain and copies it into
+ * 'mcxt'.
+ */
+OTuple
+o_find_tuple_version(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
+					 OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
+					 MemoryContext mcxt, TupleFetchCallback cb,
+					 void *arg)
+{
+	OTuple		tuple;
+	bool		allocated;
+	OpSamplingProcState opSaved;
+
+	opSaved = op_sampling_begin(OpSamplingVisibility, desc->oids);
+	tuple = o_find_tuple_version_internal(desc, p, loc, oSnapshot, tupleCsn,
+										  mcxt, cb, arg, &allocated);
+	op_sampling_end(opSaved);
+	if (O_TUPLE_IS_NULL(tuple) || allocated)
+		return tuple;
+	return o_copy_tuple_version(desc, tuple, mcxt);
+}
+
+/*
+ * The same as o_find_tuple_version(), but returns only the version matching
+ * the 'filter'.  The filter is applied before the version is copied, so the
+ * rejected versions are never copied out of the page.
+ */
+OTuple
+o_find_tuple_version_filter(BTreeDescr *desc, Page p,
+							BTreePageItemLocator *loc, OSnapshot *oSnapshot,
+							CommitSeqNo *tupleCsn, MemoryContext mcxt,
+							OTupleFilter filter, void *filterArg)
+{
+	OTuple		tuple;
+	bool		allocated;
+	OpSamplingProcState opSaved;
+
+	opSaved = op_sampling_begin(OpSamplingVisibility, desc->oids);
+	tuple = o_find_tuple_version_internal(desc, p, loc, oSnapshot, tupleCsn,
+										  mcxt, NULL, NULL, &allocated);
+	op_sampling_end(opSaved);
+	if (O_TUPLE_IS_NULL(tuple))
+		return tuple;
+
+	if (!filter(tuple, filterArg))
+	{
+		if (allocated)
+			pfree(tuple.data);
+		O_TUPLE_SET_NULL(tuple);
+		return tuple;
+	}
+
+	if (allocated)
+		return tuple;
+	return o_copy_tuple_version(desc, tuple, mcxt);
+}
+
+/*
+ * The same as o_find_tuple_version_filter() ('filter' may be NULL), but
+ * doesn't copy the version found on the page.  '*allocated' is set to false
+ * if the result points into 'p', so it's valid as long as the page image is.
+ * Otherwise, the result is allocated in 'mcxt'.
+ */
+OTuple
+o_find_tuple_version_ref(BTreeDescr *desc, Page p, BTreePageItemLocator *loc,
+						 OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
+						 MemoryContext mcxt, OTupleFilter filter,
+						 void *filterArg, bool *allocated)
+{
+	OTuple		tuple;
+	OpSamplingProcState opSaved;
+
+	opSaved = op_sampling_begin(OpSamplingVisibility, desc->oids);
+	tuple = o_find_tuple_version_internal(desc, p, loc, oSnapshot, tupleCsn,
+										  mcxt, NULL, NULL, allocated);
+	op_sampling_end(opSaved);
+	if (O_TUPLE_IS_NULL(tuple) || !filter || filter(tuple, filterArg))
+		return tuple;
+
+	if (*allocated)
+		pfree(tuple.data);
+	O_TUPLE_SET_NULL(tuple);
+	return tuple;
+}
+
 BTreeIterator *
 o_btree_iterator_create(BTreeDescr *desc, void *key, BTreeKeyType kind,
 						OSnapshot *o_snapshot, ScanDirection scanDir)
@@ -434,6 +649,9 @@ o_btree_iterator_create(BTreeDescr *desc, void *key, BTreeKeyType kind,
 	it->tupleCxt = CurrentMemoryContext;
 	it->fetchCallback = NULL;
 	it->fetchCallbackArg = NULL;
+	it->prefetchBlkno = OInvalidInMemoryBlkno;
+	it->prefetchChangeCount = 0;
+	it->prefetchOffset = 0;
 	BTREE_PAGE_LOCATOR_SET_INVALID(&it->undoLoc);
 #ifdef USE_ASSERT_CHECKING
 	O_TUPLE_SET_NULL(it->prevTuple.tuple);
@@ -487,6 +705,8 @@ o_btree_iterator_create(BTreeDescr *desc, void *key, BTreeKeyType kind,
 			BTREE_PAGE_LOCATOR_PREV(it->context.img, loc);
 	}
 
+	btree_iterator_prefetch(it);
+
 	load_page_from_undo(it, key,
 						kind != BTreeKeyRightmost ? kind : BTreeKeyNone);
 
@@ -787,6 +1007,8 @@ btree_iterator_check_load_next_page(BTreeIterator *it)
 		if (!step_result)
 			return false;
 
+		btree_iterator_prefetch(it);
+
 		header = (BTreePageHeader *) context->img;
 
 		if (it->combinedResult && header->csn >= it->oSnapshot.csn)
@@ -832,6 +1054,73 @@ btree_iterator_check_load_next_page(BTreeIterator *it)
 	return true;
 }
 
+/*
+ * Starts reading of the evicted leaves ahead of the iterator.  Looks through
+ * the next downlinks of the parent page image in the scan direction and
+ * issues prefetch requests for the on-disk ones.  Once the iterator steps
+ * to the next leaf, only the downlinks not yet prefetched from the same
+ * parent are examined.
+ */
+static void
+btree_iterator_prefetch(BTreeIterator *it)
+{
+	OBTreeFindPageContext *context = &it->context;
+	Page		parentImg = context->parentImg;
+	OBtreePageFindItem *parentItem;
+	BTreePageItemLocator loc;
+	int			distance = iterator_prefetch_pages,
+				i;
+
+	if (max_io_concurrency > 0)
+		distance = Min(distance, max_io_concurrency);
+
+	if (distance <= 0 || context->index == 0 ||
+		!O_PAGE_IS(context->img, LEAF))
+		return;
+
+	parentItem = &context->items[context->index - 1];
+	loc = parentItem->locator;
+	if (!BTREE_PAGE_LOCATOR_IS_VALID(parentImg, &loc))
+		return;
+
+	if (parentItem->blkno != it->prefetchBlkno ||
+		parentItem->pageChangeCount != it->prefetchChangeCount)
+	{
+		it->prefetchBlkno = parentItem->blkno;
+		it->prefetchChangeCount = parentItem->pageChangeCount;
+		it->prefetchOffset = BTREE_PAGE_LOCATOR_GET_OFFSET(parentImg, &loc);
+	}
+
+	for (i = 0; i < distance; i++)
+	{
+		BTreeNonLeafTuphdr *tuphdr;
+		OTuple		internalTuple;
+		int			offset;
+
+		if (IT_IS_FORWARD(it))
+			BTREE_PAGE_LOCATOR_NEXT(parentImg, &loc);
+		else
+			BTREE_PAGE_LOCATOR_PREV(parentImg, &loc);
+
+		if (!BTREE_PAGE_LOCATOR_IS_VALID(parentImg, &loc))
+			break;
+
+		offset = BTREE_PAGE_LOCATOR_GET_OFFSET(parentImg, &loc);
+		if (IT_IS_FORWARD(it) ? offset <= it->prefetchOffset :
+			offset >= it->prefetchOffset)
+			continue;
+
+		if (!partial_load_chunk(&context->partial, parentImg,
+								loc.chunkOffset, NULL))
+			break;
+
+		BTREE_PAGE_READ_INTERNAL_ITEM(tuphdr, internalTuple, parentImg, &loc);
+		if (DOWNLINK_IS_ON_DISK(tuphdr->downlink))
+			prefetch_page_from_disk(context->desc, tuphdr->downlink);
+		it->prefetchOffset = offset;
+	}
+}
+
 /*
  * Can we fetch more pages form undo page image?
  */
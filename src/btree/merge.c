@@ -20,8 +20,11 @@
 #include "btree/merge.h"
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
+#include "catalog/sys_trees.h"
 #include "checkpoint/checkpoint.h"
 #include "utils/page_pool.h"
+#include "utils/probes.h"
+#include "utils/tree_stats.h"
 #include "transam/undo.h"
 
 #include "miscadmin.h"
@@ -528,6 +531,8 @@ can_be_merged(BTreeDescr *desc, Page left, Page right, CommitSeqNo csn)
 	Assert(O_PAGE_IS(left, LEAF) == O_PAGE_IS(right, LEAF));
 	Assert(!O_PAGE_IS(left, RIGHTMOST));
 
+	tree_stats_count(desc->oids, TreeStatMerges);
+
 	space_free = BTREE_PAGE_FREE_SPACE(left);
 	space_needed = ORIOLEDB_BLCKSZ - BTREE_PAGE_FREE_SPACE(right);
 
@@ -575,6 +580,8 @@ merge_pages(BTreeDescr *desc, OInMemoryBlkno left_blkno,
 
 	Assert(O_PAGE_IS(left, LEAF) == O_PAGE_IS(right, LEAF));
 	Assert(!O_PAGE_IS(left, RIGHTMOST));
+	ORIOLEDB_PROBE3(merge_pages__start, desc->oids.datoid, desc->oids.relnode,
+					left_blkno);
 
 	leftHikeySize = BTREE_PAGE_GET_HIKEY_SIZE(left);
 	BTREE_PAGE_GET_HIKEY(leftHikey, left);
@@ -684,6 +691,9 @@ merge_pages(BTreeDescr *desc, OInMemoryBlkno left_blkno,
 
 	left_header->rightLink = InvalidRightLink;
 	left_header->prevInsertOffset = InvalidOffsetNumber;
+
+	ORIOLEDB_PROBE3(merge_pages__done, desc->oids.datoid, desc->oids.relnode,
+					left_blkno);
 }
 
 /*
@@ -725,3 +735,73 @@ is_page_too_sparse(BTreeDescr *desc, Page p)
 		return ((double) space_free / ORIOLEDB_BLCKSZ) >= O_MERGE_NODE_FREE_RATIO;
 	}
 }
+
+/*
+ * Examine single page and merge it with its sibling if it's too sparse.  Used
+ * by the background merge worker, which doesn't wait for memory pressure.
+ * Returns true if the page was merged.
+ */
+bool
+btree_try_merge_sparse_page(OInMemoryBlkno blkno)
+{
+	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	BTreeDescr *desc;
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	ORelOids	oids;
+	bool		result;
+
+	if (!ORelOidsIsValid(page_desc->oids) || page_desc->type == oIndexInvalid)
+		return false;
+
+	/*
+	 * Quick unlocked checks to skip the majority of pages cheaply.  The page
+	 * is re-checked with is_page_too_sparse() once locked.
+	 */
+	if (!O_PAGE_IS(p, LEAF) ||
+		((double) (BTREE_PAGE_FREE_SPACE(p) + PAGE_GET_N_VACATED(p)) /
+		 ORIOLEDB_BLCKSZ) < O_MERGE_LEAF_FREE_RATIO)
+		return false;
+
+	/* Important to access the shared memory once */
+	oids = *((volatile ORelOids *) &page_desc->oids);
+
+	/* See the comment in walk_page() */
+	if (IS_SYS_TREE_OIDS(oids))
+	{
+		if (sys_tree_get_storage_type(oids.relnode) != BTreeStorageInMemory)
+			desc = get_sys_tree(oids.relnode);
+		else
+			return false;
+	}
+	else
+	{
+		desc = index_oids_get_btree_descr(oids, page_desc->type);
+
+		if (desc == NULL)
+			return false;
+	}
+
+	if (!try_lock_page(blkno))
+		return false;
+
+	if (!ORelOidsIsValid(page_desc->oids) ||
+		page_desc->type == oIndexInvalid ||
+		!ORelOidsIsEqual(oids, page_desc->oids) ||
+		O_PAGE_IS(p, PRE_CLEANUP) ||
+		!O_PAGE_IS(p, LEAF) ||
+		page_desc->ionum >= 0 ||
+		RightLinkIsValid(BTREE_PAGE_GET_RIGHTLINK(p)) ||
+		desc->rootInfo.rootPageBlkno == blkno ||
+		!is_page_too_sparse(desc, p))
+	{
+		unlock_page(blkno);
+		return false;
+	}
+
+	result = btree_try_merge_and_unlock(desc, blkno, true, false);
+
+	/* Merge shouldn't leave us with locked pages. */
+	Assert(!have_locked_pages());
+
+	return result;
+}
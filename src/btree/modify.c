@@ -30,6 +30,7 @@
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
 
+#include "access/xact.h"
 #include "miscadmin.h"
 
 #define IsRelationTree(desc) (ORelOidsIsValid(desc->oids) && !IS_SYS_TREE_OIDS(desc->oids))
@@ -382,7 +383,14 @@ unlock_release(BTreeModifyInternalContext *context, bool unlock)
 	blkno = pageFindContext->items[pageFindContext->index].blkno;
 
 	if (unlock)
+	{
+		/*
+		 * Apply the inserts queued on the leaf while we were holding it
+		 * before letting the next locker in.
+		 */
+		o_btree_insert_waiter_tuples(desc, blkno);
 		unlock_page(blkno);
+	}
 	if (context->undoIsReserved)
 	{
 		release_undo_size(desc->undoType);
@@ -744,10 +752,10 @@ o_btree_modify_add_undo_record(BTreeModifyInternalContext *context)
 
 		BTREE_PAGE_READ_LEAF_ITEM(tuphdr, curTuple, page, &loc);
 
-		undoLocation = make_undo_record(desc, curTuple, true,
-										BTreeOperationUpdate, blkno,
-										O_PAGE_GET_CHANGE_COUNT(page),
-										tuphdr);
+		undoLocation = make_update_undo_record(desc, curTuple, context->tuple,
+											   blkno,
+											   O_PAGE_GET_CHANGE_COUNT(page),
+											   tuphdr);
 		leafTuphdr->undoLocation = undoLocation;
 		leafTuphdr->chainHasLocks = tuphdr->chainHasLocks ||
 			XACT_INFO_IS_LOCK_ONLY(tuphdr->xactInfo);
@@ -876,6 +884,31 @@ o_btree_modify_delete(BTreeModifyInternalContext *context)
 	return OBTreeModifyResultDeleted;
 }
 
+/*
+ * Checks if the lock of the row with 'tuphdr' might be taken without its own
+ * undo record, see add_compact_row_lock().  The row version should be visible
+ * to everybody and have no locks.  The lock should belong to the top-level
+ * transaction, so that it's released only at the transaction end.
+ */
+static bool
+compact_row_lock_is_possible(BTreeDescr *desc, BTreeLeafTuphdr *tuphdr,
+							 OXid opOxid)
+{
+	if (!compact_row_locks || desc->undoType != UndoLogRegular)
+		return false;
+
+	if (tuphdr->deleted != BTreeLeafTupleNonDeleted ||
+		tuphdr->chainHasLocks ||
+		XACT_INFO_IS_LOCK_ONLY(tuphdr->xactInfo) ||
+		!XACT_INFO_FINISHED_FOR_EVERYBODY(tuphdr->xactInfo) ||
+		COMMITSEQNO_IS_ABORTED(XACT_INFO_MAP_CSN(tuphdr->xactInfo)))
+		return false;
+
+	return opOxid == get_current_oxid_if_any() &&
+		GetCurrentTransactionNestLevel() == 1 &&
+		GET_CUR_PROCDATA()->autonomousNestingLevel == 0;
+}
+
 static OBTreeModifyResult
 o_btree_modify_lock(BTreeModifyInternalContext *context)
 {
@@ -919,9 +952,13 @@ o_btree_modify_lock(BTreeModifyInternalContext *context)
 	}
 
 	pageChangeCount = O_PAGE_GET_CHANGE_COUNT(page);
-	undoLocation = make_undo_record(desc, key, key_is_tuple,
-									BTreeOperationLock, blkno,
-									pageChangeCount, tuphdr);
+	if (compact_row_lock_is_possible(desc, tuphdr, context->opOxid))
+		undoLocation = add_compact_row_lock(desc, key, key_is_tuple, blkno,
+											pageChangeCount, context->opOxid);
+	else
+		undoLocation = make_undo_record(desc, key, key_is_tuple,
+										BTreeOperationLock, blkno,
+										pageChangeCount, tuphdr);
 
 	START_CRIT_SECTION();
 	page_block_reads(blkno);
@@ -1043,6 +1080,16 @@ o_btree_normal_modify(BTreeDescr *desc, BTreeOperationType action,
 	}
 	Assert(findResult == OFindPageResultSuccess);
 
+	/*
+	 * Adjust hint if given.  Callers modifying a series of ascending keys
+	 * pass the same hint to search each next key from the previous leaf.
+	 */
+	if (hint)
+	{
+		hint->blkno = pageFindContext.items[pageFindContext.index].blkno;
+		hint->pageChangeCount = pageFindContext.items[pageFindContext.index].pageChangeCount;
+	}
+
 	return o_btree_modify_internal(&pageFindContext, action, tuple, tupleType,
 								   key, keyType, opOxid, opCsn,
 								   lockMode, deleted, pageReserveKind,
@@ -1087,9 +1134,24 @@ page_unique_check(BTreeDescr *desc, Page p, BTreePageItemLocator *locator,
 	return false;
 }
 
+static inline void
+set_insert_hint(OBTreeFindPageContext *pageFindContext,
+				BTreeLocationHint *insertHint)
+{
+	insertHint->blkno = pageFindContext->items[pageFindContext->index].blkno;
+	insertHint->pageChangeCount = pageFindContext->items[pageFindContext->index].pageChangeCount;
+}
+
+/*
+ * Checks the whole unique key range, which might span multiple pages.  When
+ * no conflicting tuple is found, insertHint is set to the visited leaf, where
+ * the new tuple is to be inserted.  That saves from another descent from the
+ * root, which could load evicted internal pages once again.
+ */
 static bool
 slowpath_unique_check(BTreeDescr *desc, OBTreeFindPageContext *pageFindContext,
-					  Pointer key, OXid opOxid, OTupleXactInfo *xactInfo)
+					  Pointer key, OXid opOxid, OTupleXactInfo *xactInfo,
+					  BTreeLocationHint *insertHint)
 {
 	Page		p;
 	OFixedKey	hikey_buf;
@@ -1098,6 +1160,7 @@ slowpath_unique_check(BTreeDescr *desc, OBTreeFindPageContext *pageFindContext,
 										   key, BTreeKeyUniqueLowerBound, 0);
 
 	p = pageFindContext->img;
+	insertHint->blkno = OInvalidInMemoryBlkno;
 
 	while (true)
 	{
@@ -1109,10 +1172,19 @@ slowpath_unique_check(BTreeDescr *desc, OBTreeFindPageContext *pageFindContext,
 			return true;
 
 		if (O_PAGE_IS(p, RIGHTMOST))
+		{
+			if (!OInMemoryBlknoIsValid(insertHint->blkno))
+				set_insert_hint(pageFindContext, insertHint);
 			break;
+		}
 
 		BTREE_PAGE_GET_HIKEY(hikey, p);
 
+		if (!OInMemoryBlknoIsValid(insertHint->blkno) &&
+			o_btree_cmp(desc, &hikey, BTreeKeyNonLeafKey,
+						key, BTreeKeyBound) > 0)
+			set_insert_hint(pageFindContext, insertHint);
+
 		cmp = o_btree_cmp(desc, &hikey, BTreeKeyNonLeafKey,
 						  key, BTreeKeyUniqueUpperBound);
 		if (cmp > 0)
@@ -1131,12 +1203,45 @@ slowpath_unique_check(BTreeDescr *desc, OBTreeFindPageContext *pageFindContext,
 	return false;
 }
 
-OBTreeModifyResult
-o_btree_insert_unique(BTreeDescr *desc, OTuple tuple, BTreeKeyType tupleType,
-					  Pointer key, BTreeKeyType keyType,
-					  OXid opOxid, CommitSeqNo opCsn,
-					  RowLockMode lockMode, BTreeLocationHint *hint,
-					  BTreeModifyCallbackInfo *callbackInfo)
+/*
+ * Waits for the transaction, which inserted the conflicting unique key, to
+ * finish.
+ *
+ * Concurrent inserters of the same key first queue on the heavyweight lock
+ * of the key, so that only the head of the queue sleeps on the conflicting
+ * transaction.  When it finishes, just one waiter wakes up and re-checks the
+ * key, and the lock is handed to the next one in FIFO order once this insert
+ * is done.  This avoids the herd of waiters re-checking the hot key on every
+ * commit.
+ */
+static void
+wait_for_unique_key(BTreeDescr *desc, OTuple tuple, OXid oxid,
+					LOCKTAG *hwLockTag, LOCKMODE *hwLockMode)
+{
+	if (*hwLockMode == NoLock)
+	{
+		/* field4 distinguishes the lock from the tuple lock of wait_for_tuple() */
+		SET_LOCKTAG_TUPLE(*hwLockTag,
+						  desc->oids.datoid,
+						  desc->oids.reloid,
+						  o_btree_unique_hash(desc, tuple),
+						  1);
+		*hwLockMode = ExclusiveLock;
+
+		(void) LockAcquire(hwLockTag, *hwLockMode, false, false);
+	}
+
+	wait_for_oxid(oxid);
+}
+
+static OBTreeModifyResult
+o_btree_insert_unique_internal(BTreeDescr *desc, OTuple tuple,
+							   BTreeKeyType tupleType,
+							   Pointer key, BTreeKeyType keyType,
+							   OXid opOxid, CommitSeqNo opCsn,
+							   RowLockMode lockMode, BTreeLocationHint *hint,
+							   BTreeModifyCallbackInfo *callbackInfo,
+							   LOCKTAG *hwLockTag, LOCKMODE *hwLockMode)
 {
 	OBTreeFindPageContext pageFindContext;
 	int			pageReserveKind;
@@ -1271,7 +1376,8 @@ retry:
 					}
 				}
 				unlock_page(blkno);
-				wait_for_oxid(XACT_INFO_GET_OXID(xactInfo));
+				wait_for_unique_key(desc, tuple, XACT_INFO_GET_OXID(xactInfo),
+									hwLockTag, hwLockMode);
 				findResult = refind_page(&pageFindContext, key,
 										 BTreeKeyUniqueLowerBound, 0,
 										 blkno, pageChangeCount);
@@ -1293,6 +1399,7 @@ retry:
 	else
 	{
 		OTupleXactInfo xactInfo;
+		BTreeLocationHint insertHint;
 
 		/*
 		 * Evade deadlock: unlock the page before taking an unique lwlock.
@@ -1302,7 +1409,7 @@ retry:
 		LWLockAcquire(uniqueLock, LW_EXCLUSIVE);
 
 		if (slowpath_unique_check(desc, &pageFindContext, key,
-								  opOxid, &xactInfo))
+								  opOxid, &xactInfo, &insertHint))
 		{
 			BTreePageItemLocator *loc = &pageFindContext.items[pageFindContext.index].locator;
 			OTuple		curTuple;
@@ -1347,7 +1454,8 @@ retry:
 					if (cbAction == OBTreeCallbackActionXidExit)
 						return OBTreeModifyResultFound;
 				}
-				wait_for_oxid(XACT_INFO_GET_OXID(xactInfo));
+				wait_for_unique_key(desc, tuple, XACT_INFO_GET_OXID(xactInfo),
+									hwLockTag, hwLockMode);
 				BTREE_PAGE_FIND_SET(&pageFindContext, MODIFY);
 				findResult = refind_page(&pageFindContext, key,
 										 BTreeKeyUniqueLowerBound, 0,
@@ -1359,7 +1467,14 @@ retry:
 		else
 		{
 			BTREE_PAGE_FIND_SET(&pageFindContext, MODIFY);
-			findResult = find_page(&pageFindContext, key, BTreeKeyBound, 0);
+			if (OInMemoryBlknoIsValid(insertHint.blkno))
+				findResult = refind_page(&pageFindContext, key,
+										 BTreeKeyBound, 0,
+										 insertHint.blkno,
+										 insertHint.pageChangeCount);
+			else
+				findResult = find_page(&pageFindContext, key,
+									   BTreeKeyBound, 0);
 			Assert(findResult == OFindPageResultSuccess);
 		}
 	}
@@ -1374,6 +1489,29 @@ retry:
 	return result;
 }
 
+OBTreeModifyResult
+o_btree_insert_unique(BTreeDescr *desc, OTuple tuple, BTreeKeyType tupleType,
+					  Pointer key, BTreeKeyType keyType,
+					  OXid opOxid, CommitSeqNo opCsn,
+					  RowLockMode lockMode, BTreeLocationHint *hint,
+					  BTreeModifyCallbackInfo *callbackInfo)
+{
+	OBTreeModifyResult result;
+	LOCKTAG		hwLockTag;
+	LOCKMODE	hwLockMode = NoLock;
+
+	result = o_btree_insert_unique_internal(desc, tuple, tupleType,
+											key, keyType, opOxid, opCsn,
+											lockMode, hint, callbackInfo,
+											&hwLockTag, &hwLockMode);
+
+	/* Let the next waiter for the key in */
+	if (hwLockMode != NoLock)
+		LockRelease(&hwLockTag, hwLockMode, false);
+
+	return result;
+}
+
 OBTreeModifyResult
 o_btree_modify(BTreeDescr *desc, BTreeOperationType action,
 			   OTuple tuple, BTreeKeyType tupleType,
@@ -1422,15 +1560,19 @@ o_btree_delete_pk_changed(BTreeDescr *desc, Pointer key,
 								 callbackInfo);
 }
 
-bool
-o_btree_autonomous_insert(BTreeDescr *desc, OTuple tuple)
+static bool
+o_btree_autonomous_insert_internal(BTreeDescr *desc, OTuple tuple,
+								   bool batched)
 {
 	OAutonomousTxState state;
 	OBTreeModifyResult result;
 
 	if (desc->storageType == BTreeStoragePersistence)
 	{
-		start_autonomous_transaction(&state);
+		if (batched)
+			start_batched_autonomous_transaction(&state);
+		else
+			start_autonomous_transaction(&state);
 		PG_TRY();
 		{
 			result = o_btree_normal_modify(desc, BTreeOperationInsert,
@@ -1466,6 +1608,22 @@ o_btree_autonomous_insert(BTreeDescr *desc, OTuple tuple)
 	return (result == OBTreeModifyResultInserted);
 }
 
+bool
+o_btree_autonomous_insert(BTreeDescr *desc, OTuple tuple)
+{
+	return o_btree_autonomous_insert_internal(desc, tuple, false);
+}
+
+/*
+ * Same as o_btree_autonomous_insert(), but joins the open batch of the
+ * autonomous transactions.
+ */
+bool
+o_btree_batched_autonomous_insert(BTreeDescr *desc, OTuple tuple)
+{
+	return o_btree_autonomous_insert_internal(desc, tuple, true);
+}
+
 bool
 o_btree_autonomous_delete(BTreeDescr *desc, OTuple key, BTreeKeyType keyType,
 						  BTreeLocationHint *hint)
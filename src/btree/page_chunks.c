@@ -296,6 +296,35 @@ page_chunk_fill_locator(Page p, OffsetNumber chunkOffset,
 	locator->chunk = (BTreePageChunk *) (p + SHORT_GET_LOCATION(header->chunkDesc[chunkOffset].shortLocation));
 }
 
+/*
+ * Get the bounds of the locator's chunk: the hikey of the previous chunk and
+ * the chunk's own hikey.  All the chunk keys lie between them.  Returns false
+ * for the first chunk, which has no previous chunk hikey.  Must not be called
+ * for the last chunk, whose hikey is the page hikey.
+ */
+bool
+page_locator_get_chunk_bounds(Page p, BTreePageItemLocator *locator,
+							  OTuple *lokey, OTuple *hikey)
+{
+	BTreePageHeader *header = (BTreePageHeader *) p;
+	BTreePageChunkDesc *chunkDesc;
+
+	Assert(locator->chunkOffset + 1 < header->chunksCount);
+
+	if (locator->chunkOffset == 0)
+		return false;
+
+	chunkDesc = &header->chunkDesc[locator->chunkOffset - 1];
+	lokey->formatFlags = chunkDesc->hikeyFlags;
+	lokey->data = p + SHORT_GET_LOCATION(chunkDesc->hikeyShortLocation);
+
+	chunkDesc = &header->chunkDesc[locator->chunkOffset];
+	hikey->formatFlags = chunkDesc->hikeyFlags;
+	hikey->data = p + SHORT_GET_LOCATION(chunkDesc->hikeyShortLocation);
+
+	return true;
+}
+
 void
 page_item_fill_locator(Page p, OffsetNumber itemOffset,
 					   BTreePageItemLocator *locator)
@@ -343,6 +372,10 @@ page_locator_next_chunk(Page p, BTreePageItemLocator *locator)
 		if (locator->chunkOffset + 1 < header->chunksCount)
 		{
 			page_chunk_fill_locator(p, locator->chunkOffset + 1, locator);
+
+			/* The items array of the next chunk is read right after */
+			if (locator->chunkOffset + 1 < header->chunksCount)
+				O_PREFETCH(p + SHORT_GET_LOCATION(header->chunkDesc[locator->chunkOffset + 1].shortLocation));
 		}
 		else
 		{
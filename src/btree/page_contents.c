@@ -24,13 +24,16 @@
 #include "transam/undo.h"
 #include "utils/page_pool.h"
 #include "utils/ucm.h"
+#include "utils/undo_page_cache.h"
 
 #include "access/transam.h"
+#include "access/xlog.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/proc.h"
 #include "storage/proclist.h"
 #include "storage/s_lock.h"
+#include "storage/spin.h"
 #include "utils/memdebug.h"
 
 /*
@@ -45,16 +48,28 @@ read_page_from_undo(BTreeDescr *desc, Page img, UndoLocation undo_loc,
 	BTreePageHeader *header;
 	CommitSeqNo page_csn;
 	UndoLocation rec_undo_location;
+	UndoLocation start_loc = undo_loc;
+	UndoLocation image_loc;
+	CommitSeqNo csn_high = COMMITSEQNO_MAX_NORMAL;
 	bool		is_left = true;
+	bool		is_right = true;
+	bool		single_images = true;
 	UndoLogType undoType PG_USED_FOR_ASSERTS_ONLY = GET_PAGE_LEVEL_UNDO_TYPE(desc->undoType);
 
 	Assert(UndoLocationIsValid(undo_loc));
 
+	if (undo_page_cache_get(desc, start_loc, csn, img, &image_loc))
+		return image_loc;
+
 	while (true)
 	{
 		/* Read page image from page-level undo item */
 		get_page_from_undo(desc, undo_loc, key, keyType, img,
-						   &is_left, NULL, lokey, NULL, NULL);
+						   &is_left, &is_right, lokey, NULL, NULL);
+
+		/* The half of the merge image depends on the key */
+		if (!is_left || !is_right)
+			single_images = false;
 
 		header = (BTreePageHeader *) img;
 		page_csn = header->csn;
@@ -66,6 +81,7 @@ read_page_from_undo(BTreeDescr *desc, Page img, UndoLocation undo_loc,
 		/* Continue traversing undo chain if needed */
 		if (COMMITSEQNO_IS_NORMAL(page_csn) && page_csn >= csn)
 		{
+			csn_high = Min(csn_high, page_csn);
 			undo_loc = rec_undo_location;
 			continue;
 		}
@@ -78,7 +94,18 @@ read_page_from_undo(BTreeDescr *desc, Page img, UndoLocation undo_loc,
 	/* Page-level undo item should be retained */
 	Assert(UNDO_REC_EXISTS(undoType, undo_loc));
 
-	return O_UNDO_GET_IMAGE_LOCATION(undo_loc, is_left);
+	image_loc = O_UNDO_GET_IMAGE_LOCATION(undo_loc, is_left);
+
+	/*
+	 * The same image is reached by any snapshot newer than the image and not
+	 * newer than the images passed by.
+	 */
+	if (single_images)
+		undo_page_cache_put(desc, start_loc,
+							COMMITSEQNO_IS_NORMAL(page_csn) ? page_csn : 0,
+							csn_high, img, image_loc);
+
+	return image_loc;
 }
 
 /*
@@ -165,6 +192,39 @@ copy_page(OInMemoryBlkno blkno, uint32 pageChangeCount, Page dest,
 	}
 }
 
+/*
+ * Number of spins a hot standby session waits for the page-level undo image
+ * of the page modified by recovery before queueing for the page reads.
+ */
+#define STANDBY_READ_SPINS	(128)
+
+/*
+ * Waits for the reads of the leaf blocked by the recovery worker on a hot
+ * standby.  Returns true once the undo image made by the page modification
+ * serves the snapshot `csn`, so the page could be read from undo without
+ * waiting for the modification to finish.  Otherwise returns false after the
+ * page reads are enabled.
+ */
+static bool
+standby_wait_for_page_image(OInMemoryBlkno blkno, CommitSeqNo csn)
+{
+	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+	volatile BTreePageHeader *header = (volatile BTreePageHeader *) p;
+	int			i;
+
+	for (i = 0; i < STANDBY_READ_SPINS; i++)
+	{
+		if (header->csn >= csn)
+			return true;
+		if (!O_PAGE_STATE_READ_IS_BLOCKED(pg_atomic_read_u64(&(O_PAGE_HEADER(p)->state))))
+			return false;
+		pg_spin_delay();
+	}
+
+	page_wait_for_read_enable(blkno);
+	return false;
+}
+
 /*
  * Read in-memory page number `blkno` into `img`.  Check expected
  * `pageChangeCount`.  Lookup for undo page according to `csn` when `key` of
@@ -182,6 +242,7 @@ o_btree_read_page(BTreeDescr *desc, OInMemoryBlkno blkno,
 	BTreePageHeader *header = (BTreePageHeader *) p;
 	CommitSeqNo headerCsn;
 	UndoLocation headerUndoLocation;
+	UndoLocation pageUndoLoc;
 	bool		read_undo = O_PAGE_IS(p, LEAF);
 
 	Assert(pageChangeCount != InvalidOPageChangeCount);
@@ -209,8 +270,7 @@ o_btree_read_page(BTreeDescr *desc, OInMemoryBlkno blkno,
 	headerCsn = header->csn;
 	if (read_undo && COMMITSEQNO_IS_NORMAL(csn) && headerCsn >= csn)
 	{
-		UndoLocation pageUndoLoc;
-
+read_from_undo:
 		pg_read_barrier();
 		headerUndoLocation = header->undoLocation;
 		pg_read_barrier();
@@ -230,16 +290,40 @@ o_btree_read_page(BTreeDescr *desc, OInMemoryBlkno blkno,
 		return true;
 	}
 
-	if (!copy_page(blkno, pageChangeCount, img, partial,
-				   loadHikeysChunk, readCsn))
+	if (standby_nowait_reads && read_undo && COMMITSEQNO_IS_NORMAL(csn) &&
+		RecoveryInProgress() && !is_recovery_process())
+	{
+		/*
+		 * Hot standby session: don't queue behind the recovery worker
+		 * modifying the page, if its page-level undo image is published for
+		 * our snapshot in the meantime.
+		 */
+		while (true)
+		{
+			ReadPageResult result;
+
+			result = try_copy_page(blkno, pageChangeCount, img,
+								   partial, loadHikeysChunk, readCsn);
+			if (result == ReadPageResultOK)
+				break;
+			else if (result == ReadPageResultWrongPageChangeCount)
+				return false;
+
+			if (standby_wait_for_page_image(blkno, csn))
+			{
+				header = (BTreePageHeader *) p;
+				goto read_from_undo;
+			}
+		}
+	}
+	else if (!copy_page(blkno, pageChangeCount, img, partial,
+						loadHikeysChunk, readCsn))
 		return false;
 	header = (BTreePageHeader *) img;
 
 	/* Re-try reading page-level undo item due to concurrent changes */
 	if (read_undo && COMMITSEQNO_IS_NORMAL(csn) && header->csn >= csn)
 	{
-		UndoLocation pageUndoLoc;
-
 		pageUndoLoc = read_page_from_undo(desc, img, header->undoLocation, csn,
 										  key, keyType, lokey);
 		header = (BTreePageHeader *) img;
@@ -332,7 +416,7 @@ init_new_btree_page(BTreeDescr *desc, OInMemoryBlkno blkno, uint16 flags,
 		page_block_reads(blkno);
 	}
 
-	page_desc->oids = desc->oids;
+	ppool_page_set_owner(desc->ppool, blkno, desc->oids);
 	page_desc->type = desc->type;
 	page_desc->fileExtent.len = InvalidFileExtentLen;
 	page_desc->fileExtent.off = InvalidFileExtentOff;
@@ -373,6 +457,10 @@ init_meta_page(OInMemoryBlkno blkno, uint32 leafPagesNum)
 
 	memset(p + O_PAGE_HEADER_SIZE, 0, ORIOLEDB_BLCKSZ - O_PAGE_HEADER_SIZE);
 	pg_atomic_init_u32(&metaPage->leafPagesNum, leafPagesNum);
+	pg_atomic_init_u32(&metaPage->appendSplits, 0);
+	pg_atomic_init_u32(&metaPage->compressDictId, 0);
+	pg_atomic_init_u32(&metaPage->compressAuto, 0);
+	pg_atomic_init_u32(&metaPage->compactRequest, 0);
 	pg_atomic_init_u64(&metaPage->numFreeBlocks, 0);
 	pg_atomic_init_u64(&metaPage->datafileLength[0], 0);
 	pg_atomic_init_u64(&metaPage->datafileLength[1], 0);
@@ -387,6 +475,7 @@ init_meta_page(OInMemoryBlkno blkno, uint32 leafPagesNum)
 					 checkpoint_state->oMetaTrancheId);
 	LWLockInitialize(&metaPage->punchHolesLock,
 					 checkpoint_state->punchHolesTrancheId);
+	SpinLockInit(&metaPage->freeExtentsCache.lock);
 
 	page_desc->type = oIndexInvalid;
 	page_desc->oids.datoid = InvalidOid;
@@ -16,6 +16,7 @@
 #include "orioledb.h"
 
 #include "btree/find.h"
+#include "btree/insert.h"
 #include "btree/io.h"
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
@@ -26,8 +27,10 @@
 #include "transam/oxid.h"
 #include "transam/undo.h"
 #include "utils/dsa.h"
+#include "utils/op_sampling.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
+#include "utils/tree_stats.h"
 #include "utils/ucm.h"
 
 #include "access/transam.h"
@@ -37,6 +40,7 @@
 #include "storage/proclist.h"
 #include "storage/s_lock.h"
 #include "utils/memdebug.h"
+#include "utils/wait_event.h"
 
 /* Maximum simultaneously locked pages per process */
 #define MAX_PAGES_PER_PROCESS 8
@@ -59,6 +63,17 @@ static int	numberOfMyInProgressSplitPages = 0;
 
 OPageWaiterShmemState *lockerStates = NULL;
 
+/*
+ * Wait events of the page waits.  Without the custom wait events of the
+ * extensions, the waits are reported as the buffer content locks.
+ */
+static uint32 pageWaitEvents[PAGE_WAIT_KINDS_NUM] = {
+	PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT,
+	PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT,
+	PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT,
+	PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT
+};
+
 #ifdef CHECK_PAGE_STATS
 static void o_check_btree_page_statistics(BTreeDescr *desc, Pointer p);
 #endif
@@ -77,6 +92,42 @@ page_state_shmem_init(Pointer buf, bool found)
 	lockerStates = (OPageWaiterShmemState *) ptr;
 }
 
+/*
+ * Registers the wait events of the page waits.  Called on the shared memory
+ * startup, so the backends inherit the event ids.  The io waits are reported
+ * by the lwlocks of the "orioledb_btree_io" tranche.
+ */
+void
+page_state_init_wait_events(void)
+{
+#if PG_VERSION_NUM >= 170000
+	pageWaitEvents[PageWaitLock] = WaitEventExtensionNew("OrioleDBPageLock");
+	pageWaitEvents[PageWaitReadBlock] = WaitEventExtensionNew("OrioleDBPageReadBlock");
+	pageWaitEvents[PageWaitSplit] = WaitEventExtensionNew("OrioleDBPageSplit");
+#endif
+}
+
+/*
+ * Returns the level of the page for the page wait statistics.
+ */
+PageWaitLevel
+page_wait_level(Page p)
+{
+	if (O_PAGE_IS(p, LEFTMOST) && O_PAGE_IS(p, RIGHTMOST))
+		return PageWaitLevelRoot;
+	else if (O_PAGE_IS(p, LEAF))
+		return PageWaitLevelLeaf;
+	return PageWaitLevelInternal;
+}
+
+static inline void
+page_wait_report(OInMemoryBlkno blkno, PageWaitKind kind, instr_time startTime)
+{
+	tree_stats_report_page_wait(O_GET_IN_MEMORY_PAGEDESC(blkno)->oids, kind,
+								page_wait_level(O_GET_IN_MEMORY_PAGE(blkno)),
+								startTime);
+}
+
 static int
 get_my_locked_page_index(OInMemoryBlkno blkno)
 {
@@ -410,12 +461,19 @@ lock_page(OInMemoryBlkno blkno)
 
 	while (true)
 	{
+		instr_time	waitStart;
+		bool		sampled;
+		OpSamplingProcState opSaved;
+
 		prevState = lock_page_or_queue(blkno, MYPROCNUMBER);
 
 		if (!O_PAGE_STATE_IS_LOCKED(prevState))
 			break;
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		sampled = tree_stats_page_wait_sample(&waitStart);
+		opSaved = op_sampling_begin(OpSamplingPageLock,
+				    O_GET_IN_MEMORY_PAGEDESC(blkno)->oids);
+		pgstat_report_wait_start(pageWaitEvents[PageWaitLock]);
 
 		for (;;)
 		{
@@ -426,6 +484,9 @@ lock_page(OInMemoryBlkno blkno)
 		}
 
 		pgstat_report_wait_end();
+		op_sampling_end(opSaved);
+		if (sampled)
+			page_wait_report(blkno, PageWaitLock, waitStart);
 	}
 
 	my_locked_page_add(blkno, prevState | PAGE_STATE_LOCKED_FLAG);
@@ -459,6 +520,9 @@ lock_page_with_tuple(BTreeDescr *desc,
 	while (true)
 	{
 		LockPageResult lockResult;
+		instr_time	waitStart;
+		bool		sampled;
+		OpSamplingProcState opSaved;
 
 		lockResult = lock_page_or_queue_or_split_detect(desc, blkno,
 														pageChangeCount,
@@ -477,7 +541,10 @@ lock_page_with_tuple(BTreeDescr *desc,
 		}
 		Assert(lockResult == LockPageResultQueued);
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		sampled = tree_stats_page_wait_sample(&waitStart);
+		opSaved = op_sampling_begin(OpSamplingPageLock,
+				    O_GET_IN_MEMORY_PAGEDESC(*blkno)->oids);
+		pgstat_report_wait_start(pageWaitEvents[PageWaitLock]);
 
 		for (;;)
 		{
@@ -487,6 +554,9 @@ lock_page_with_tuple(BTreeDescr *desc,
 			extraWaits++;
 		}
 		pgstat_report_wait_end();
+		op_sampling_end(opSaved);
+		if (sampled)
+			page_wait_report(*blkno, PageWaitLock, waitStart);
 
 		/*
 		 * Fix the process wait semaphore's count for any absorbed wakeups.
@@ -521,12 +591,19 @@ page_wait_for_read_enable(OInMemoryBlkno blkno)
 
 	while (true)
 	{
+		instr_time	waitStart;
+		bool		sampled;
+		OpSamplingProcState opSaved;
+
 		prevState = read_enabled_or_queue(blkno, MYPROCNUMBER);
 
 		if (!(prevState & PAGE_STATE_NO_READ_FLAG))
 			break;
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		sampled = tree_stats_page_wait_sample(&waitStart);
+		opSaved = op_sampling_begin(OpSamplingPageLock,
+				    O_GET_IN_MEMORY_PAGEDESC(blkno)->oids);
+		pgstat_report_wait_start(pageWaitEvents[PageWaitReadBlock]);
 
 		for (;;)
 		{
@@ -537,6 +614,9 @@ page_wait_for_read_enable(OInMemoryBlkno blkno)
 		}
 
 		pgstat_report_wait_end();
+		op_sampling_end(opSaved);
+		if (sampled)
+			page_wait_report(blkno, PageWaitReadBlock, waitStart);
 	}
 
 	/*
@@ -560,6 +640,9 @@ page_wait_for_changecount(OInMemoryBlkno blkno, uint32 state)
 	while (true)
 	{
 		bool		exit_loop = false;
+		instr_time	waitStart;
+		bool		sampled;
+		OpSamplingProcState opSaved;
 
 		curState = state_changed_or_queue(blkno, MYPROCNUMBER, state);
 		if ((curState & PAGE_STATE_CHANGE_COUNT_MASK) !=
@@ -568,7 +651,10 @@ page_wait_for_changecount(OInMemoryBlkno blkno, uint32 state)
 			return curState;
 		}
 
-		pgstat_report_wait_start(PG_WAIT_LWLOCK | LWTRANCHE_BUFFER_CONTENT);
+		sampled = tree_stats_page_wait_sample(&waitStart);
+		opSaved = op_sampling_begin(OpSamplingPageLock,
+				    O_GET_IN_MEMORY_PAGEDESC(blkno)->oids);
+		pgstat_report_wait_start(pageWaitEvents[PageWaitSplit]);
 
 		for (;;)
 		{
@@ -583,10 +669,13 @@ page_wait_for_changecount(OInMemoryBlkno blkno, uint32 state)
 			}
 			extraWaits++;
 		}
-		if (exit_loop)
-			break;
 
 		pgstat_report_wait_end();
+		op_sampling_end(opSaved);
+		if (sampled)
+			page_wait_report(blkno, PageWaitSplit, waitStart);
+		if (exit_loop)
+			break;
 	}
 
 	/*
@@ -1086,6 +1175,7 @@ btree_split_mark_finished(OInMemoryBlkno rightBlkno, bool use_lock, bool success
 	BTreePageHeader *rightHeader;
 	OrioleDBPageDesc *rightPageDesc = O_GET_IN_MEMORY_PAGEDESC(rightBlkno);
 	OInMemoryBlkno leftBlkno;
+	uint32		rightChangeCount;
 
 	leftBlkno = rightPageDesc->leftBlkno;
 	Assert(OInMemoryBlknoIsValid(leftBlkno));
@@ -1138,10 +1228,14 @@ btree_split_mark_finished(OInMemoryBlkno rightBlkno, bool use_lock, bool success
 
 	END_CRIT_SECTION();
 
+	rightChangeCount = O_PAGE_GET_CHANGE_COUNT(O_GET_IN_MEMORY_PAGE(rightBlkno));
 	unlock_page(rightBlkno);
 
 	if (use_lock)
 		unlock_page(leftBlkno);
+
+	if (!success)
+		o_btree_register_broken_split(rightBlkno, rightChangeCount);
 }
 
 #ifdef CHECK_PAGE_STRUCT
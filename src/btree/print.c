@@ -23,6 +23,7 @@
 #include "transam/oxid.h"
 #include "transam/undo.h"
 #include "tuple/format.h"
+#include "utils/compress.h"
 #include "utils/page_pool.h"
 
 #include "access/transam.h"
@@ -279,7 +280,8 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 	}
 
 	if (OCompressIsValid(desc->compress))
-		appendStringInfo(outbuf, ", compression = %d", desc->compress);
+		appendStringInfo(outbuf, ", compression = %s",
+						 o_compress_to_cstring(desc->compress));
 
 	if (IS_DIRTY(blkno))
 	{
@@ -358,11 +360,14 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 			{
 				BTreeLeafTuphdr tuphdr,
 						   *pageTuphdr;
-				OTuple		tuple;
-				bool		inUndo = false;
+				OTuple		tuple,
+							lastTuple;
+				bool		inUndo = false,
+							lastAllocated = false;
 
 				BTREE_PAGE_READ_LEAF_ITEM(pageTuphdr, tuple, p, &loc);
 				tuphdr = *pageTuphdr;
+				lastTuple = tuple;
 				appendStringInfo(outbuf, "    Item %i: ", i);
 
 				while (true)
@@ -459,12 +464,19 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 						UndoLocationIsValid(tuphdr.undoLocation))
 					{
 						Assert(UNDO_REC_EXISTS(desc->undoType, tuphdr.undoLocation));
-						if (inUndo && !O_TUPLE_IS_NULL(tuple))
-							pfree(tuple.data);
 						if (!tuphdr.deleted && !XACT_INFO_IS_LOCK_ONLY(tuphdr.xactInfo))
 						{
+							/*
+							 * The delta record restores the old version from
+							 * the last version read.
+							 */
+							tuple = lastTuple;
 							get_prev_leaf_header_and_tuple_from_undo(desc->undoType,
 																	 &tuphdr, &tuple, 0);
+							if (lastAllocated)
+								pfree(lastTuple.data);
+							lastTuple = tuple;
+							lastAllocated = true;
 						}
 						else
 						{
@@ -478,8 +490,8 @@ print_page_contents_recursive(BTreeDescr *desc, OInMemoryBlkno blkno,
 						break;
 					}
 				}
-				if (inUndo && !O_TUPLE_IS_NULL(tuple))
-					pfree(tuple.data);
+				if (lastAllocated)
+					pfree(lastTuple.data);
 			}
 			else
 			{
@@ -33,9 +33,12 @@
  *		3. Once the internal page is finished, one worker loads the next page in
  *		   its place.  Other workers continue to process the downlink of the
  *		   remaining page.
- *		4. Once internal page processing is finished, all workers publish
- *		   on-disk downlinks to the dsm.  The leader sorts on-disk downlinks.
- *		5. Workers process on-disk downlinks in parallel one by one.
+ *		4. Once internal page processing is finished, all workers sort their
+ *		   on-disk downlinks and publish them to the dsm.  The leader merges
+ *		   the sorted runs.
+ *		5. Workers claim the chunks of the sorted on-disk downlinks and
+ *		   process them in parallel.  Each worker prefetches its own chunk,
+ *		   so the disk reads of all the workers go concurrently.
  *
  *-------------------------------------------------------------------------
  */
@@ -50,11 +53,14 @@
 #include "btree/page_chunks.h"
 #include "btree/scan.h"
 #include "btree/undo.h"
+#include "s3/worker.h"
 #include "transam/oxid.h"
 #include "tuple/slot.h"
 #include "utils/sampling.h"
 #include "utils/stopevent.h"
+#include "utils/ucm.h"
 
+#include "lib/binaryheap.h"
 #include "miscadmin.h"
 #include "utils/wait_event.h"
 
@@ -71,6 +77,12 @@ typedef struct
 	CommitSeqNo csn;
 } BTreeSeqScanDiskDownlink;
 
+/* Maximal size of a single coalesced readahead request */
+#define SEQ_SCAN_MAX_PREFETCH_SIZE	(1024 * 1024)
+
+/* Number of the on-disk downlinks claimed at once without the readahead */
+#define SEQ_SCAN_DISK_CHUNK_SIZE	16
+
 struct BTreeSeqScan
 {
 	BTreeDescr *desc;
@@ -104,6 +116,9 @@ struct BTreeSeqScan
 	int64		downlinksCount;
 	int64		downlinkIndex;
 	int64		allocatedDownlinks;
+	/* the chunk of the shared on-disk downlinks claimed by the worker */
+	uint64		chunkIndex;
+	uint64		chunkEnd;
 
 	BTreeIterator *iter;
 	OTuple		iterEnd;
@@ -125,6 +140,10 @@ struct BTreeSeqScan
 	BlockSampler sampler;
 	BlockNumber samplingNumber;
 	BlockNumber samplingNext;
+	/* level 1 pages read by the sampling scan and their downlinks */
+	uint64		samplingIntPages;
+	uint64		samplingIntDownlinks;
+	OBTreeFindPageContext *samplingContext;
 
 	BTreeSeqScanCallbacks *cb;
 	void	   *arg;
@@ -133,6 +152,18 @@ struct BTreeSeqScan
 				keyRangeHigh;
 	bool		firstPageIsLoaded;
 
+	/* Don't let the scan push hot pages out of the pool */
+	bool		scanResistant;
+
+	/* Skips the tuple versions not matching the filter before the copy */
+	OTupleFilter filter;
+	void	   *filterArg;
+
+	/* Skips the reads of the on-disk leaves not matching the filter */
+	BTreeSeqScanDiskLeafFilter diskLeafFilter;
+	BTreeSeqScanDiskLeafLoaded diskLeafLoaded;
+	void	   *diskLeafArg;
+
 	/* Private parallel worker info in a backend */
 	ParallelOScanDesc poscan;
 	bool		isLeader;
@@ -399,6 +430,88 @@ cmp_downlinks(const void *p1, const void *p2)
 		return 1;
 }
 
+typedef struct
+{
+	BTreeSeqScanDiskDownlink *downlinks;
+	uint64	   *pos;
+} DownlinksMergeState;
+
+static int
+cmp_downlinks_runs(Datum a, Datum b, void *arg)
+{
+	DownlinksMergeState *state = (DownlinksMergeState *) arg;
+
+	/* binaryheap is a max-heap, so the comparison is reversed */
+	return -cmp_downlinks(&state->downlinks[state->pos[DatumGetInt32(a)]],
+						  &state->downlinks[state->pos[DatumGetInt32(b)]]);
+}
+
+/*
+ * Merges the sorted runs of the downlinks published by the workers.  The
+ * runs are found as the ascending sequences, so we don't need to track
+ * their bounds.
+ */
+static void
+merge_downlinks_runs(BTreeSeqScanDiskDownlink *downlinks, uint64 count)
+{
+	DownlinksMergeState state;
+	BTreeSeqScanDiskDownlink *result;
+	uint64	   *ends;
+	binaryheap *heap;
+	int			nruns = 1,
+				allocated = 16,
+				i;
+	uint64		j,
+				k = 0;
+
+	state.downlinks = downlinks;
+	state.pos = (uint64 *) palloc(sizeof(uint64) * allocated);
+	ends = (uint64 *) palloc(sizeof(uint64) * allocated);
+	state.pos[0] = 0;
+	for (j = 1; j < count; j++)
+	{
+		if (cmp_downlinks(&downlinks[j - 1], &downlinks[j]) <= 0)
+			continue;
+
+		if (nruns >= allocated)
+		{
+			allocated *= 2;
+			state.pos = (uint64 *) repalloc(state.pos, sizeof(uint64) * allocated);
+			ends = (uint64 *) repalloc(ends, sizeof(uint64) * allocated);
+		}
+		ends[nruns - 1] = j;
+		state.pos[nruns++] = j;
+	}
+	ends[nruns - 1] = count;
+
+	if (nruns > 1)
+	{
+		result = (BTreeSeqScanDiskDownlink *) MemoryContextAllocHuge(CurrentMemoryContext,
+																	 sizeof(downlinks[0]) * count);
+		heap = binaryheap_allocate(nruns, cmp_downlinks_runs, &state);
+		for (i = 0; i < nruns; i++)
+			binaryheap_add_unordered(heap, Int32GetDatum(i));
+		binaryheap_build(heap);
+
+		while (!binaryheap_empty(heap))
+		{
+			i = DatumGetInt32(binaryheap_first(heap));
+			result[k++] = downlinks[state.pos[i]++];
+			if (state.pos[i] < ends[i])
+				binaryheap_replace_first(heap, Int32GetDatum(i));
+			else
+				(void) binaryheap_remove_first(heap);
+		}
+		Assert(k == count);
+
+		memcpy(downlinks, result, sizeof(downlinks[0]) * count);
+		binaryheap_free(heap);
+		pfree(result);
+	}
+	pfree(state.pos);
+	pfree(ends);
+}
+
 static void
 switch_to_disk_scan(BTreeSeqScan *scan)
 {
@@ -407,14 +520,14 @@ switch_to_disk_scan(BTreeSeqScan *scan)
 
 	scan->status = BTreeSeqScanDisk;
 	BTREE_PAGE_LOCATOR_SET_INVALID(&scan->leafLoc);
-	if (!poscan)
-	{
-		qsort(scan->diskDownlinks,
-			  scan->downlinksCount,
-			  sizeof(scan->diskDownlinks[0]),
-			  cmp_downlinks);
-	}
-	else
+
+	/* In parallel scans, every worker sorts its own downlinks */
+	qsort(scan->diskDownlinks,
+		  scan->downlinksCount,
+		  sizeof(scan->diskDownlinks[0]),
+		  cmp_downlinks);
+
+	if (poscan)
 	{
 		SpinLockAcquire(&poscan->workerStart);
 		if (!(poscan->flags & O_PARALLEL_DISK_SCAN_STARTED))
@@ -482,8 +595,8 @@ switch_to_disk_scan(BTreeSeqScan *scan)
 				LWLockAcquire(&poscan->downlinksPublish, LW_EXCLUSIVE);
 				LWLockRelease(&poscan->downlinksPublish);
 
-				qsort(dsm_segment_address(scan->dsmSeg), poscan->downlinksCount,
-					  sizeof(scan->diskDownlinks[0]), cmp_downlinks);
+				merge_downlinks_runs((BTreeSeqScanDiskDownlink *) dsm_segment_address(scan->dsmSeg),
+									 poscan->downlinksCount);
 			}
 
 			pg_atomic_write_u64(&poscan->downlinkIndex, 0);
@@ -599,6 +712,87 @@ get_next_key(BTreeSeqScan *scan, BTreePageItemLocator *intLoc, OFixedKey *nextKe
 		clear_fixed_key(nextKey);
 }
 
+/*
+ * Skips the level 1 pages holding no sampled leaves without reading them.
+ * The number of leaves under each skipped page is estimated by the average
+ * of the level 1 pages read so far.  Walks the level 2 pages starting from
+ * the downlink to the page beginning with scan->prevHikey, and moves
+ * scan->prevHikey past the skipped pages.
+ *
+ * Returns false if there are no more level 1 pages to read.
+ */
+static bool
+sampling_skip_internal_pages(BTreeSeqScan *scan)
+{
+	BTreeDescr *desc = scan->desc;
+	OBTreeFindPageContext *context;
+	BlockNumber fanout;
+
+	/* The sampler is exhausted */
+	if (scan->samplingNext == InvalidBlockNumber)
+		return false;
+
+	if (scan->samplingIntPages == 0 ||
+		PAGE_GET_LEVEL(O_GET_IN_MEMORY_PAGE(desc->rootInfo.rootPageBlkno)) < 2)
+		return true;
+
+	fanout = Max(scan->samplingIntDownlinks / scan->samplingIntPages, 1);
+	if (scan->samplingNext - scan->samplingNumber < fanout)
+		return true;
+
+	if (!scan->samplingContext)
+		scan->samplingContext = (OBTreeFindPageContext *) MemoryContextAlloc(scan->mctx,
+																			 sizeof(OBTreeFindPageContext));
+	context = scan->samplingContext;
+
+	while (true)
+	{
+		BTreePageItemLocator loc;
+		OTuple		key;
+		Page		img;
+
+		init_page_find_context(context, desc, scan->oSnapshot.csn,
+							   BTREE_PAGE_FIND_IMAGE |
+							   BTREE_PAGE_FIND_KEEP_LOKEY);
+		(void) find_page(context, &scan->prevHikey.tuple, BTreeKeyNonLeafKey, 2);
+		img = context->img;
+		if (PAGE_GET_LEVEL(img) != 2)
+			return true;
+
+		/*
+		 * The downlink should begin exactly with prevHikey.  Otherwise, the
+		 * tree was concurrently changed, and the page is read as usual.
+		 */
+		loc = context->items[context->index].locator;
+		if (BTREE_PAGE_LOCATOR_GET_OFFSET(img, &loc) > 0)
+			BTREE_PAGE_READ_INTERNAL_TUPLE(key, img, &loc);
+		else
+			key = context->lokey.tuple;
+		if (O_TUPLE_IS_NULL(key) ||
+			o_btree_cmp(desc, &scan->prevHikey.tuple, BTreeKeyNonLeafKey,
+						&key, BTreeKeyNonLeafKey) != 0)
+			return true;
+
+		while (scan->samplingNext - scan->samplingNumber >= fanout)
+		{
+			scan->samplingNumber += fanout;
+			BTREE_PAGE_LOCATOR_NEXT(img, &loc);
+			if (BTREE_PAGE_LOCATOR_IS_VALID(img, &loc))
+				copy_fixed_page_key(desc, &scan->prevHikey, img, &loc);
+			else if (!O_PAGE_IS(img, RIGHTMOST))
+				break;
+			else
+				return false;
+		}
+
+		if (BTREE_PAGE_LOCATOR_IS_VALID(img, &loc))
+			return true;
+
+		/* Continue with the next level 2 page */
+		copy_fixed_hikey(desc, &scan->prevHikey, img);
+	}
+}
+
 /*
  * Gets the next downlink with it's keyrange (low and high keys of the
  * keyrange).
@@ -630,6 +824,9 @@ get_next_downlink(BTreeSeqScan *scan, uint64 *downlink,
 				{
 					Assert(!O_PAGE_IS(scan->context.img, RIGHTMOST));
 					copy_fixed_hikey(scan->desc, &scan->prevHikey, scan->context.img);
+					if (scan->needSampling && sampling_skip_pages &&
+						!sampling_skip_internal_pages(scan))
+						return false;
 				}
 
 				if (!load_next_internal_page(scan, scan->prevHikey.tuple,
@@ -645,6 +842,12 @@ get_next_downlink(BTreeSeqScan *scan, uint64 *downlink,
 					return false;
 				}
 
+				if (scan->needSampling)
+				{
+					scan->samplingIntPages++;
+					scan->samplingIntDownlinks += BTREE_PAGE_ITEMS_COUNT(scan->context.img);
+				}
+
 				if (scan->iter)
 					return false;
 			}
@@ -942,6 +1145,112 @@ iterate_internal_page(BTreeSeqScan *scan)
 	return false;
 }
 
+/*
+ * Issues readahead requests for the sorted on-disk downlinks in the
+ * [start, end) range.  Adjacent extents are coalesced into a single request,
+ * so the device sees large sequential reads.  In S3 mode, the loads of the
+ * file parts containing the pages are scheduled instead.  The sorted order
+ * makes the consecutive downlinks hit the same part, which is scheduled only
+ * once.
+ */
+static void
+prefetch_disk_downlinks(BTreeSeqScan *scan,
+						BTreeSeqScanDiskDownlink *downlinks,
+						int64 start, int64 end)
+{
+	off_t		rangeOffset = 0;
+	int			rangeSize = 0;
+	int64		i;
+
+	if (orioledb_s3_mode)
+	{
+		for (i = start; i < end; i++)
+			(void) s3_schedule_downlink_load(scan->desc, downlinks[i].downlink);
+		return;
+	}
+
+	for (i = start; i < end; i++)
+	{
+		off_t		offset;
+		int			size;
+
+		if (!get_downlink_disk_range(scan->desc, downlinks[i].downlink,
+									 &offset, &size))
+			return;
+
+		if (rangeSize > 0 && rangeOffset + rangeSize == offset &&
+			rangeSize <= SEQ_SCAN_MAX_PREFETCH_SIZE - size)
+		{
+			rangeSize += size;
+			continue;
+		}
+
+		if (rangeSize > 0)
+			btree_smgr_prefetch(scan->desc, 0, rangeOffset, rangeSize);
+		rangeOffset = offset;
+		rangeSize = size;
+	}
+
+	if (rangeSize > 0)
+		btree_smgr_prefetch(scan->desc, 0, rangeOffset, rangeSize);
+}
+
+/*
+ * Keeps the readahead between one and two windows ahead of the current
+ * downlink: each time the index crosses a window boundary, the window after
+ * the next one is requested.  Parallel scans prefetch the claimed chunks
+ * instead, see load_next_disk_leaf_page().
+ */
+static void
+seq_scan_readahead(BTreeSeqScan *scan, BTreeSeqScanDiskDownlink *downlinks,
+				   int64 index, int64 count)
+{
+	int64		window = orioledb_s3_mode ? s3_scan_prefetch_pages :
+		seq_scan_readahead_pages;
+
+	if (window <= 0 || index % window != 0)
+		return;
+
+	if (index == 0)
+		prefetch_disk_downlinks(scan, downlinks, 0, Min(2 * window, count));
+	else if (index + window < count)
+		prefetch_disk_downlinks(scan, downlinks, index + window,
+								Min(index + 2 * window, count));
+}
+
+/*
+ * Claims the next chunk of the shared sorted on-disk downlinks and prefetches
+ * it.  The chunks are as large as the readahead window, but each worker
+ * should get several of them for the load balance.  Returns false if all the
+ * downlinks are claimed.
+ */
+static bool
+claim_disk_downlinks_chunk(BTreeSeqScan *scan)
+{
+	ParallelOScanDesc poscan = scan->poscan;
+	int64		window = orioledb_s3_mode ? s3_scan_prefetch_pages :
+		seq_scan_readahead_pages;
+	uint64		chunkSize,
+				index;
+
+	chunkSize = window > 0 ? window : SEQ_SCAN_DISK_CHUNK_SIZE;
+	chunkSize = Min(chunkSize,
+					poscan->downlinksCount / (Max(poscan->nworkers, 1) * 4));
+	chunkSize = Max(chunkSize, 1);
+
+	index = pg_atomic_fetch_add_u64(&poscan->downlinkIndex, chunkSize);
+	if (index >= poscan->downlinksCount)
+		return false;
+
+	scan->chunkIndex = index;
+	scan->chunkEnd = Min(index + chunkSize, poscan->downlinksCount);
+	if (window > 0)
+		prefetch_disk_downlinks(scan,
+								(BTreeSeqScanDiskDownlink *) dsm_segment_address(scan->dsmSeg),
+								scan->chunkIndex, scan->chunkEnd);
+	return true;
+}
+
 static bool
 load_next_disk_leaf_page(BTreeSeqScan *scan)
 {
@@ -951,37 +1260,55 @@ load_next_disk_leaf_page(BTreeSeqScan *scan)
 	BTreeSeqScanDiskDownlink downlink;
 	ParallelOScanDesc poscan = scan->poscan;
 
-	if (!poscan)
-	{
-		if (scan->downlinkIndex >= scan->downlinksCount)
-			return false;
-
-		downlink = scan->diskDownlinks[scan->downlinkIndex];
-	}
-	else
+	while (true)
 	{
-		uint64		index = pg_atomic_fetch_add_u64(&poscan->downlinkIndex, 1);
+		if (!poscan)
+		{
+			if (scan->downlinkIndex >= scan->downlinksCount)
+				return false;
 
-		if (index >= poscan->downlinksCount)
+			seq_scan_readahead(scan, scan->diskDownlinks, scan->downlinkIndex,
+							   scan->downlinksCount);
+			downlink = scan->diskDownlinks[scan->downlinkIndex];
+		}
+		else
 		{
-			if (scan->dsmSeg)
+			if (scan->chunkIndex >= scan->chunkEnd &&
+				!claim_disk_downlinks_chunk(scan))
 			{
-				dsm_detach(scan->dsmSeg);
-				scan->dsmSeg = NULL;
+				if (scan->dsmSeg)
+				{
+					dsm_detach(scan->dsmSeg);
+					scan->dsmSeg = NULL;
 #ifdef USE_ASSERT_CHECKING
-				(void) pg_atomic_fetch_sub_u32(&poscan->dsmSegNumAttached, 1);
+					(void) pg_atomic_fetch_sub_u32(&poscan->dsmSegNumAttached, 1);
 #endif
+				}
+				return false;
 			}
-			return false;
+			downlink = ((BTreeSeqScanDiskDownlink *) dsm_segment_address(scan->dsmSeg))[scan->chunkIndex++];
 		}
-		downlink = ((BTreeSeqScanDiskDownlink *) dsm_segment_address(scan->dsmSeg))[index];
+
+		if (!scan->diskLeafFilter ||
+			scan->diskLeafFilter(scan->desc, downlink.downlink, downlink.csn,
+								 scan->diskLeafArg))
+			break;
+
+		CHECK_FOR_INTERRUPTS();
+		scan->downlinkIndex++;
 	}
 
 	success = read_page_from_disk(scan->desc,
 								  scan->leafImg,
 								  downlink.downlink,
 								  &extent);
+	if (!success)
+		elog(ERROR, "can not read leaf page from disk");
+
 	header = (BTreePageHeader *) scan->leafImg;
+	if (scan->diskLeafLoaded)
+		scan->diskLeafLoaded(scan->desc, downlink.downlink, scan->leafImg,
+							 scan->diskLeafArg);
 	if (header->csn >= downlink.csn)
 		read_page_from_undo(scan->desc, scan->leafImg, header->undoLocation,
 							downlink.csn, NULL, BTreeKeyNone, NULL);
@@ -990,9 +1317,6 @@ load_next_disk_leaf_page(BTreeSeqScan *scan)
 			  btree_page_stopevent_params(scan->desc,
 										  scan->leafImg));
 
-	if (!success)
-		elog(ERROR, "can not read leaf page from disk");
-
 	BTREE_PAGE_LOCATOR_FIRST(scan->leafImg, &scan->leafLoc);
 	scan->downlinkIndex++;
 	scan->hint.blkno = OInvalidInMemoryBlkno;
@@ -1148,6 +1472,8 @@ make_btree_seq_scan_internal(BTreeDescr *desc, OSnapshot *oSnapshot,
 	scan->allocatedDownlinks = 16;
 	scan->downlinksCount = 0;
 	scan->downlinkIndex = 0;
+	scan->chunkIndex = 0;
+	scan->chunkEnd = 0;
 	scan->diskDownlinks = (BTreeSeqScanDiskDownlink *) palloc(sizeof(scan->diskDownlinks[0]) * scan->allocatedDownlinks);
 	scan->mctx = CurrentMemoryContext;
 	scan->iter = NULL;
@@ -1156,7 +1482,16 @@ make_btree_seq_scan_internal(BTreeDescr *desc, OSnapshot *oSnapshot,
 	scan->firstPageIsLoaded = false;
 	scan->intStartOffset = 0;
 	scan->samplingNumber = 0;
+	scan->samplingIntPages = 0;
+	scan->samplingIntDownlinks = 0;
+	scan->samplingContext = NULL;
 	scan->sampler = sampler;
+	scan->scanResistant = sampler ? scan_resistant_sampling : scan_resistant_seq_scan;
+	scan->filter = NULL;
+	scan->filterArg = NULL;
+	scan->diskLeafFilter = NULL;
+	scan->diskLeafLoaded = NULL;
+	scan->diskLeafArg = NULL;
 	scan->dsmSeg = NULL;
 	scan->initialized = false;
 	scan->checkpointNumberSet = false;
@@ -1177,10 +1512,10 @@ make_btree_seq_scan(BTreeDescr *desc, OSnapshot *oSnapshot, void *poscan)
 
 BTreeSeqScan *
 make_btree_seq_scan_cb(BTreeDescr *desc, OSnapshot *oSnapshot,
-					   BTreeSeqScanCallbacks *cb, void *arg)
+					   BTreeSeqScanCallbacks *cb, void *arg, void *poscan)
 {
 	o_btree_load_shmem(desc);
-	return make_btree_seq_scan_internal(desc, oSnapshot, cb, arg, NULL, NULL);
+	return make_btree_seq_scan_internal(desc, oSnapshot, cb, arg, NULL, poscan);
 }
 
 BTreeSeqScan *
@@ -1190,6 +1525,57 @@ make_btree_sampling_scan(BTreeDescr *desc, BlockSampler sampler)
 										NULL, NULL, sampler, NULL);
 }
 
+/*
+ * Sets the filter of the tuple versions returned by btree_seq_scan_getnext()
+ * and btree_seq_scan_getnext_batch().  The filter is evaluated against the
+ * version located in the page image, so the rejected versions are not copied.
+ */
+void
+btree_seq_scan_set_filter(BTreeSeqScan *scan, OTupleFilter filter, void *arg)
+{
+	scan->filter = filter;
+	scan->filterArg = arg;
+}
+
+/*
+ * Sets the callbacks of the disk phase of the scan, see
+ * BTreeSeqScanDiskLeafFilter.  The skipped leaves are never read, so the
+ * filter must only reject the leaves, which have no matching tuples visible
+ * for the scan snapshot.
+ */
+void
+btree_seq_scan_set_disk_leaf_filter(BTreeSeqScan *scan,
+									BTreeSeqScanDiskLeafFilter filter,
+									BTreeSeqScanDiskLeafLoaded loaded,
+									void *arg)
+{
+	scan->diskLeafFilter = filter;
+	scan->diskLeafLoaded = loaded;
+	scan->diskLeafArg = arg;
+}
+
+/*
+ * Finds the visible version of the tuple.  When 'allocated' is not NULL, the
+ * version found on the page isn't copied, see o_find_tuple_version_ref().
+ */
+static OTuple
+btree_seq_scan_find_tuple_version(BTreeSeqScan *scan, Page p,
+								  BTreePageItemLocator *loc,
+								  CommitSeqNo *tupleCsn, MemoryContext mctx,
+								  bool *allocated)
+{
+	if (allocated)
+		return o_find_tuple_version_ref(scan->desc, p, loc, &scan->oSnapshot,
+										tupleCsn, mctx, scan->filter,
+										scan->filterArg, allocated);
+	if (scan->filter)
+		return o_find_tuple_version_filter(scan->desc, p, loc,
+										   &scan->oSnapshot, tupleCsn, mctx,
+										   scan->filter, scan->filterArg);
+	return o_find_tuple_version(scan->desc, p, loc, &scan->oSnapshot,
+								tupleCsn, mctx, NULL, NULL);
+}
+
 static OTuple
 btree_seq_scan_get_tuple_from_iterator(BTreeSeqScan *scan,
 									   CommitSeqNo *tupleCsn,
@@ -1197,14 +1583,22 @@ btree_seq_scan_get_tuple_from_iterator(BTreeSeqScan *scan,
 {
 	OTuple		result;
 
-	if (!O_TUPLE_IS_NULL(scan->iterEnd))
-		result = o_btree_iterator_fetch(scan->iter, tupleCsn,
-										&scan->iterEnd, BTreeKeyNonLeafKey,
-										false, hint);
-	else
-		result = o_btree_iterator_fetch(scan->iter, tupleCsn,
-										NULL, BTreeKeyNone,
-										false, hint);
+	while (true)
+	{
+		if (!O_TUPLE_IS_NULL(scan->iterEnd))
+			result = o_btree_iterator_fetch(scan->iter, tupleCsn,
+											&scan->iterEnd, BTreeKeyNonLeafKey,
+											false, hint);
+		else
+			result = o_btree_iterator_fetch(scan->iter, tupleCsn,
+											NULL, BTreeKeyNone,
+											false, hint);
+
+		if (O_TUPLE_IS_NULL(result) || !scan->filter ||
+			scan->filter(result, scan->filterArg))
+			break;
+		pfree(result.data);
+	}
 
 	if (O_TUPLE_IS_NULL(result))
 	{
@@ -1338,12 +1732,22 @@ apply_next_key(BTreeSeqScan *scan)
 	}
 }
 
+/*
+ * Fetches the next tuple of the scan.  When 'allocated' is not NULL, the
+ * tuples of the leaf image are returned without copying and '*allocated' is
+ * set to false for them.  When 'stopAtLeafEnd' is set, returns the NULL tuple
+ * instead of loading the next leaf image.
+ */
 static OTuple
 btree_seq_scan_getnext_internal(BTreeSeqScan *scan, MemoryContext mctx,
-								CommitSeqNo *tupleCsn, BTreeLocationHint *hint)
+								CommitSeqNo *tupleCsn, BTreeLocationHint *hint,
+								bool *allocated, bool stopAtLeafEnd)
 {
 	OTuple		tuple;
 
+	if (allocated)
+		*allocated = true;
+
 	if (scan->iter)
 	{
 		tuple = btree_seq_scan_get_tuple_from_iterator(scan, tupleCsn, hint);
@@ -1438,14 +1842,9 @@ btree_seq_scan_getnext_internal(BTreeSeqScan *scan, MemoryContext mctx,
 				}
 			}
 
-			tuple = o_find_tuple_version(scan->desc,
-										 scan->histImg,
-										 &scan->histLoc,
-										 &scan->oSnapshot,
-										 tupleCsn,
-										 mctx,
-										 NULL,
-										 NULL);
+			tuple = btree_seq_scan_find_tuple_version(scan, scan->histImg,
+													  &scan->histLoc,
+													  tupleCsn, mctx, NULL);
 			BTREE_PAGE_LOCATOR_NEXT(scan->histImg, &scan->histLoc);
 			if (!O_TUPLE_IS_NULL(tuple))
 			{
@@ -1461,6 +1860,11 @@ btree_seq_scan_getnext_internal(BTreeSeqScan *scan, MemoryContext mctx,
 
 		if (!BTREE_PAGE_LOCATOR_IS_VALID(scan->leafImg, &scan->leafLoc))
 		{
+			if (stopAtLeafEnd)
+			{
+				O_TUPLE_SET_NULL(tuple);
+				return tuple;
+			}
 			if (scan->status == BTreeSeqScanInMemory)
 			{
 				if (iterate_internal_page(scan))
@@ -1491,14 +1895,10 @@ btree_seq_scan_getnext_internal(BTreeSeqScan *scan, MemoryContext mctx,
 			continue;
 		}
 
-		tuple = o_find_tuple_version(scan->desc,
-									 scan->leafImg,
-									 &scan->leafLoc,
-									 &scan->oSnapshot,
-									 tupleCsn,
-									 mctx,
-									 NULL,
-									 NULL);
+		BTREE_PAGE_LOCATOR_PREFETCH(scan->leafImg, &scan->leafLoc);
+		tuple = btree_seq_scan_find_tuple_version(scan, scan->leafImg,
+												  &scan->leafLoc,
+												  tupleCsn, mctx, allocated);
 		BTREE_PAGE_LOCATOR_NEXT(scan->leafImg, &scan->leafLoc);
 		if (!O_TUPLE_IS_NULL(tuple))
 		{
@@ -1520,21 +1920,80 @@ btree_seq_scan_getnext(BTreeSeqScan *scan, MemoryContext mctx,
 	OTuple		tuple;
 
 	Assert(scan);
+	if (scan->scanResistant)
+		set_ucm_scan_access();
+
 	if (!scan->initialized)
 		init_btree_seq_scan(scan);
 
+	O_TUPLE_SET_NULL(tuple);
 	if (scan->status == BTreeSeqScanInMemory ||
 		scan->status == BTreeSeqScanDisk)
+		tuple = btree_seq_scan_getnext_internal(scan, mctx, tupleCsn, hint,
+												NULL, false);
+
+	if (scan->scanResistant)
+		unset_ucm_scan_access();
+
+	Assert(!O_TUPLE_IS_NULL(tuple) || scan->status == BTreeSeqScanFinished);
+	return tuple;
+}
+
+/*
+ * Fetches up to 'maxTuples' next tuples of the scan into 'tuples', 'csns' and
+ * 'hints' ('hints' may be NULL).  The batch ends with the tuples of the
+ * current leaf image, so the batch holds the tuples of a single leaf.  The
+ * tuples are copied into 'mctx'.
+ *
+ * When 'allocated' is not NULL, the tuples of the leaf image aren't copied:
+ * they point into the private leaf image of the scan, and 'allocated' shows
+ * which of them are copied.  The leaf image is only replaced by the next
+ * call, so the caller must copy the tuples it still needs before that, or
+ * before free_btree_seq_scan().
+ *
+ * Returns the number of tuples fetched.  Zero means the scan is finished.
+ */
+int
+btree_seq_scan_getnext_batch(BTreeSeqScan *scan, MemoryContext mctx,
+							 OTuple *tuples, CommitSeqNo *csns,
+							 BTreeLocationHint *hints, bool *allocated,
+							 int maxTuples)
+{
+	int			count = 0;
+
+	Assert(scan);
+	Assert(maxTuples > 0);
+	if (scan->scanResistant)
+		set_ucm_scan_access();
+
+	if (!scan->initialized)
+		init_btree_seq_scan(scan);
+
+	while (count < maxTuples &&
+		   (scan->status == BTreeSeqScanInMemory ||
+			scan->status == BTreeSeqScanDisk))
 	{
-		tuple = btree_seq_scan_getnext_internal(scan, mctx, tupleCsn, hint);
+		OTuple		tuple;
 
-		if (!O_TUPLE_IS_NULL(tuple))
-			return tuple;
+		tuple = btree_seq_scan_getnext_internal(scan, mctx, &csns[count],
+												hints ? &hints[count] : NULL,
+												allocated ? &allocated[count] : NULL,
+												count > 0);
+		if (O_TUPLE_IS_NULL(tuple))
+			break;
+		tuples[count++] = tuple;
+
+		/* Stop at the end of the leaf, not to load the next one */
+		if (!scan->iter && !scan->haveHistImg &&
+			!BTREE_PAGE_LOCATOR_IS_VALID(scan->leafImg, &scan->leafLoc))
+			break;
 	}
-	Assert(scan->status == BTreeSeqScanFinished);
 
-	O_TUPLE_SET_NULL(tuple);
-	return tuple;
+	if (scan->scanResistant)
+		unset_ucm_scan_access();
+
+	Assert(count > 0 || scan->status == BTreeSeqScanFinished);
+	return count;
 }
 
 static OTuple
@@ -1631,24 +2090,31 @@ btree_seq_scan_getnext_raw(BTreeSeqScan *scan, MemoryContext mctx,
 {
 	OTuple		tuple;
 
+	if (scan->scanResistant)
+		set_ucm_scan_access();
+
 	if (!scan->initialized)
 		init_btree_seq_scan(scan);
 
+	O_TUPLE_SET_NULL(tuple);
+	*end = true;
 	if (scan->status == BTreeSeqScanInMemory ||
 		scan->status == BTreeSeqScanDisk)
 	{
 		tuple = btree_seq_scan_getnext_raw_internal(scan, mctx, hint);
 		if (scan->status == BTreeSeqScanInMemory ||
 			scan->status == BTreeSeqScanDisk)
-		{
 			*end = false;
-			return tuple;
-		}
 	}
-	Assert(scan->status == BTreeSeqScanFinished);
 
-	O_TUPLE_SET_NULL(tuple);
-	*end = true;
+	if (scan->scanResistant)
+		unset_ucm_scan_access();
+
+	if (*end)
+	{
+		Assert(scan->status == BTreeSeqScanFinished);
+		O_TUPLE_SET_NULL(tuple);
+	}
 	return tuple;
 }
 
@@ -1674,6 +2140,8 @@ free_btree_seq_scan(BTreeSeqScan *scan)
 		dsm_detach(scan->dsmSeg);
 	}
 	pfree(scan->diskDownlinks);
+	if (scan->samplingContext)
+		pfree(scan->samplingContext);
 	pfree(scan);
 }
 
@@ -24,10 +24,20 @@
 #include "transam/undo.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
+#include "utils/probes.h"
+#include "utils/tree_stats.h"
 
+#include "access/nbtree.h"
 #include "miscadmin.h"
 #include "utils/memutils.h"
 
+/*
+ * Number of consecutive leaf splits appending to the rightmost page after
+ * which we consider the tree keys to be monotonically increasing.  Before
+ * that, rightmost splits follow the fillfactor as usual.
+ */
+#define BTREE_APPEND_SPLITS_THRESHOLD	(32)
+
 void
 make_split_items(BTreeDescr *desc, Page page,
 				 BTreeSplitItems *items,
@@ -281,6 +291,32 @@ btree_get_split_left_count(BTreeDescr *desc, Page page,
 	targetCount = 0;
 	spaceRatio = 0.5f;
 
+	/*
+	 * Track the splits appending to the rightmost leaf in the meta page.  If
+	 * the tree keys seem to be monotonically increasing (sequences,
+	 * timestamps etc), split exactly at the insertion point.  Left pages
+	 * aren't going to receive new tuples, so we fill them completely unless
+	 * the user asked for a lower fillfactor.
+	 */
+	if (O_PAGE_IS(page, LEAF))
+	{
+		pg_atomic_uint32 *appendSplits = &BTREE_GET_META(desc)->appendSplits;
+		uint32		count = pg_atomic_read_u32(appendSplits);
+
+		if (O_PAGE_IS(page, RIGHTMOST) && !replace &&
+			offset == header->itemsCount)
+		{
+			if (count < BTREE_APPEND_SPLITS_THRESHOLD)
+				pg_atomic_write_u32(appendSplits, count + 1);
+			else if (desc->fillfactor >= BTREE_DEFAULT_FILLFACTOR)
+				targetCount = offset;
+		}
+		else if (count != 0)
+		{
+			pg_atomic_write_u32(appendSplits, 0);
+		}
+	}
+
 	/*
 	 * Try to autodetect ordered inserts and split near the insertion point.
 	 * If we're close to the end of the page, split already inserted data away
@@ -289,7 +325,11 @@ btree_get_split_left_count(BTreeDescr *desc, Page page,
 	 * point. Hopefuly, we still have many tuple to insert and that will give
 	 * us the good utilization.
 	 */
-	if (offset == header->prevInsertOffset + 1)
+	if (targetCount != 0)
+	{
+		/* rightmost append is detected above */
+	}
+	else if (offset == header->prevInsertOffset + 1)
 	{
 		if ((float) offset / (float) header->itemsCount > fillfactorRatio)
 			spaceRatio = fillfactorRatio;
@@ -369,6 +409,10 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno,
 	uint64		rightlink;
 	LocationIndex hikeySize;
 
+	tree_stats_count(desc->oids, TreeStatSplits);
+	ORIOLEDB_PROBE4(perform_page_split__start, desc->oids.datoid,
+					desc->oids.relnode, blkno, new_blkno);
+
 	rightlink = left_header->rightLink;
 	init_new_btree_page(desc, new_blkno,
 						left_header->flags & ~(O_BTREE_FLAG_LEFTMOST),
@@ -428,4 +472,7 @@ perform_page_split(BTreeDescr *desc, OInMemoryBlkno blkno,
 
 	MARK_DIRTY(desc, blkno);
 	MARK_DIRTY(desc, new_blkno);
+
+	ORIOLEDB_PROBE4(perform_page_split__done, desc->oids.datoid,
+					desc->oids.relnode, blkno, new_blkno);
 }
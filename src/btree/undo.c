@@ -24,6 +24,7 @@
 #include "recovery/recovery.h"
 #include "rewind/rewind.h"
 #include "tableam/descr.h"
+#include "tableam/handler.h"
 #include "transam/oxid.h"
 #include "transam/undo.h"
 #include "utils/memutils.h"
@@ -32,6 +33,7 @@
 #include "utils/page_pool.h"
 
 #include "access/transam.h"
+#include "access/xact.h"
 #include "miscadmin.h"
 #include "utils/inval.h"
 #include "utils/wait_event.h"
@@ -40,6 +42,8 @@ static void clean_chain_has_locks_flag(UndoLogType undoType,
 									   UndoLocation location,
 									   BTreeLeafTuphdr *pageTuphdr,
 									   OInMemoryBlkno blkno);
+static UndoLocation add_modify_undo_record(BTreeDescr *desc,
+										   UndoLocation undoLocation);
 
 /*
  * Add page image to the undo log.
@@ -260,7 +264,8 @@ undo_record_key_stopevent_params(BTreeOperationType action,
 	pushJsonbValue(&state, WJB_BEGIN_OBJECT, NULL);
 	if (action == BTreeOperationInsert)
 		jsonb_push_string_key(&state, "action", "insert");
-	else if (action == BTreeOperationUpdate)
+	else if (action == BTreeOperationUpdate ||
+			 action == BTreeOperationUpdateDelta)
 		jsonb_push_string_key(&state, "action", "update");
 	else if (action == BTreeOperationDelete)
 		jsonb_push_string_key(&state, "action", "delete");
@@ -301,7 +306,6 @@ make_undo_record(BTreeDescr *desc, OTuple tuple, bool is_tuple,
 	LocationIndex tuplelen;
 	BTreeModifyUndoStackItem *item;
 	LocationIndex size;
-	CommandId	commandId;
 	UndoLocation undoLocation;
 
 	if (action == BTreeOperationUpdate)
@@ -357,6 +361,18 @@ make_undo_record(BTreeDescr *desc, OTuple tuple, bool is_tuple,
 		item->tuphdr.chainHasLocks = curTupHdr->chainHasLocks;
 	}
 
+	return add_modify_undo_record(desc, undoLocation);
+}
+
+/*
+ * Adds the filled modify undo record to the undo stack.  Returns the undo
+ * location of its tuple header.
+ */
+static UndoLocation
+add_modify_undo_record(BTreeDescr *desc, UndoLocation undoLocation)
+{
+	CommandId	commandId;
+
 	add_new_undo_stack_item(desc->undoType, undoLocation);
 
 	undoLocation += offsetof(BTreeModifyUndoStackItem, tuphdr);
@@ -370,6 +386,88 @@ make_undo_record(BTreeDescr *desc, OTuple tuple, bool is_tuple,
 	return undoLocation;
 }
 
+/*
+ * Makes undo record of the update of 'oldTuple' to 'newTuple'.  With
+ * orioledb.undo_update_delta, the update keeping the tuple length records
+ * only the key and the bytes of the old tuple between the common prefix and
+ * suffix of the tuples.  The readers of the undo chain restore the old tuple
+ * from the next newer version, see get_prev_leaf_header_and_tuple_from_undo().
+ * Falls back to the full image of the old tuple if the difference is not
+ * shorter.
+ */
+UndoLocation
+make_update_undo_record(BTreeDescr *desc, OTuple oldTuple, OTuple newTuple,
+						OInMemoryBlkno blkno, uint32 pageChangeCount,
+						BTreeLeafTuphdr *curTupHdr)
+{
+	BTreeModifyUndoStackItem *item;
+	BTreeUpdateDeltaUndo *delta;
+	UndoLocation undoLocation;
+	OTuple		key;
+	bool		keyPalloc = false;
+	LocationIndex length,
+				keyLength,
+				size;
+	int			prefix = 0,
+				suffix = 0;
+
+	if (!undo_update_delta || IS_SYS_TREE_OIDS(desc->oids) ||
+		oldTuple.formatFlags != newTuple.formatFlags)
+		return make_undo_record(desc, oldTuple, true, BTreeOperationUpdate,
+								blkno, pageChangeCount, curTupHdr);
+
+	length = o_btree_len(desc, oldTuple, OTupleLength);
+	if (o_btree_len(desc, newTuple, OTupleLength) != length)
+		return make_undo_record(desc, oldTuple, true, BTreeOperationUpdate,
+								blkno, pageChangeCount, curTupHdr);
+
+	while (prefix < length && oldTuple.data[prefix] == newTuple.data[prefix])
+		prefix++;
+	while (suffix < length - prefix &&
+		   oldTuple.data[length - suffix - 1] == newTuple.data[length - suffix - 1])
+		suffix++;
+
+	keyLength = o_btree_len(desc, oldTuple, OTupleKeyLength);
+	size = BTREE_UPDATE_DELTA_UNDO_KEY_OFFSET + keyLength +
+		(length - prefix - suffix);
+	if (size >= sizeof(BTreeModifyUndoStackItem) + length)
+		return make_undo_record(desc, oldTuple, true, BTreeOperationUpdate,
+								blkno, pageChangeCount, curTupHdr);
+
+	item = (BTreeModifyUndoStackItem *) get_undo_record(desc->undoType,
+														&undoLocation,
+														MAXALIGN(size));
+	item->header.itemSize = size;
+	item->header.type = ModifyUndoItemType;
+	item->header.indexType = desc->type;
+	item->action = BTreeOperationUpdateDelta;
+	item->blkno = blkno;
+	item->pageChangeCount = pageChangeCount;
+	item->oids = desc->oids;
+
+	delta = (BTreeUpdateDeltaUndo *) ((Pointer) item + sizeof(BTreeModifyUndoStackItem));
+	delta->tupleLength = length;
+	delta->keyLength = keyLength;
+	delta->offset = prefix;
+	delta->length = length - prefix - suffix;
+
+	memset((Pointer) item + BTREE_UPDATE_DELTA_UNDO_KEY_OFFSET, 0, keyLength);
+	key = o_btree_tuple_make_key(desc, oldTuple,
+								 (Pointer) item + BTREE_UPDATE_DELTA_UNDO_KEY_OFFSET,
+								 true, &keyPalloc);
+	Assert(!keyPalloc);
+	item->tuphdr.formatFlags = key.formatFlags;
+	memcpy((Pointer) item + BTREE_UPDATE_DELTA_UNDO_KEY_OFFSET + keyLength,
+		   oldTuple.data + prefix, delta->length);
+
+	item->tuphdr.xactInfo = curTupHdr->xactInfo;
+	item->tuphdr.undoLocation = curTupHdr->undoLocation;
+	item->tuphdr.deleted = curTupHdr->deleted;
+	item->tuphdr.chainHasLocks = curTupHdr->chainHasLocks;
+
+	return add_modify_undo_record(desc, undoLocation);
+}
+
 void
 make_waiter_undo_record(BTreeDescr *desc, OInMemoryBlkno blkno, int pgprocno,
 						OPageWaiterShmemState *lockerState)
@@ -455,7 +553,10 @@ modify_undo_callback(UndoLogType undoType, UndoLocation location,
 		return;
 
 	tuple.formatFlags = item->tuphdr.formatFlags;
-	tuple.data = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
+	if (item->action == BTreeOperationUpdateDelta)
+		tuple.data = (Pointer) item + BTREE_UPDATE_DELTA_UNDO_KEY_OFFSET;
+	else
+		tuple.data = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
 
 	if (STOPEVENTS_ENABLED())
 	{
@@ -549,16 +650,14 @@ modify_undo_callback(UndoLogType undoType, UndoLocation location,
 }
 
 /*
- * Callback for aborting B-tree tuple lock.
+ * Removes the lock of the row 'key' by 'oxid', which tuple header refers to
+ * 'lockUndoLocation', from the undo chain of the row.
  */
-void
-lock_undo_callback(UndoLogType undoType, UndoLocation location,
-				   UndoStackItem *baseItem, OXid oxid,
-				   bool abort, bool changeCountsValid)
+static void
+remove_row_lock(BTreeDescr *desc, OTuple key, OInMemoryBlkno hintBlkno,
+				uint32 pageChangeCount, OXid oxid,
+				UndoLocation lockUndoLocation)
 {
-	BTreeModifyUndoStackItem *item = (BTreeModifyUndoStackItem *) baseItem;
-	BTreeDescr *desc = get_tree_descr(item->oids, item->header.indexType);
-	OTuple		key;
 	Page		p;
 	int			cmp;
 	OInMemoryBlkno blkno;
@@ -570,30 +669,12 @@ lock_undo_callback(UndoLogType undoType, UndoLocation location,
 				lastLockOnlyUndoLocation = InvalidUndoLocation;
 	OFindPageResult findResult;
 
-	Assert(abort);
-
-	if (!desc)
-		return;
-
-	key.formatFlags = item->tuphdr.formatFlags;
-	key.data = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
-
-	if (STOPEVENTS_ENABLED())
-	{
-		Jsonb	   *params = undo_record_key_stopevent_params(BTreeOperationLock,
-															  desc, key, oxid);
-
-		STOPEVENT(STOPEVENT_APPLY_UNDO, params);
-	}
-
 	o_btree_load_shmem(desc);
 	init_page_find_context(&context, desc, COMMITSEQNO_INPROGRESS, BTREE_PAGE_FIND_MODIFY);
-	if (!changeCountsValid)
-		item->pageChangeCount = InvalidOPageChangeCount;
 
 	findResult = refind_page(&context, (Pointer) &key,
-							 BTreeKeyNonLeafKey, 0, item->blkno,
-							 item->pageChangeCount);
+							 BTreeKeyNonLeafKey, 0, hintBlkno,
+							 pageChangeCount);
 
 	if (findResult == OFindPageResultFailure)
 	{
@@ -642,7 +723,7 @@ lock_undo_callback(UndoLogType undoType, UndoLocation location,
 
 		if (XACT_INFO_IS_LOCK_ONLY(tuphdr.xactInfo) && XACT_INFO_GET_OXID(tuphdr.xactInfo) == oxid)
 		{
-			if (tuphdr.undoLocation == location + offsetof(BTreeModifyUndoStackItem, tuphdr))
+			if (tuphdr.undoLocation == lockUndoLocation)
 				delete_record = true;
 		}
 
@@ -689,6 +770,178 @@ lock_undo_callback(UndoLogType undoType, UndoLocation location,
 	unlock_page(blkno);
 }
 
+/*
+ * Callback for aborting B-tree tuple lock.
+ */
+void
+lock_undo_callback(UndoLogType undoType, UndoLocation location,
+				   UndoStackItem *baseItem, OXid oxid,
+				   bool abort, bool changeCountsValid)
+{
+	BTreeModifyUndoStackItem *item = (BTreeModifyUndoStackItem *) baseItem;
+	BTreeDescr *desc = get_tree_descr(item->oids, item->header.indexType);
+	OTuple		key;
+
+	Assert(abort);
+
+	if (!desc)
+		return;
+
+	key.formatFlags = item->tuphdr.formatFlags;
+	key.data = (Pointer) item + sizeof(BTreeModifyUndoStackItem);
+
+	if (STOPEVENTS_ENABLED())
+	{
+		Jsonb	   *params = undo_record_key_stopevent_params(BTreeOperationLock,
+															  desc, key, oxid);
+
+		STOPEVENT(STOPEVENT_APPLY_UNDO, params);
+	}
+
+	if (!changeCountsValid)
+		item->pageChangeCount = InvalidOPageChangeCount;
+
+	remove_row_lock(desc, key, item->blkno, item->pageChangeCount, oxid,
+					location + offsetof(BTreeModifyUndoStackItem, tuphdr));
+}
+
+/*
+ * The compact row locks of the current transaction.  The lock of the row,
+ * which version is visible to everybody and has no other locks, doesn't need
+ * its own undo record: the previous tuple header is the frozen one anyway.
+ * So all such locks of the transaction refer to the single undo record with
+ * the frozen tuple header.  The undo record is retained as long as the
+ * regular undo records of the transaction, so the chain walkers don't need to
+ * know about the compact locks.
+ *
+ * The compact locks aren't in the undo stack.  Instead, the keys of locked
+ * rows are kept in the backend memory, to remove the locks on abort.
+ */
+typedef struct
+{
+	ORelOids	oids;
+	OIndexType	type;
+	OInMemoryBlkno blkno;
+	uint32		pageChangeCount;
+	uint8		formatFlags;
+	Pointer		key;
+} CompactRowLock;
+
+static OXid compactRowLocksOxid = InvalidOXid;
+static UndoLocation compactRowLockUndoLocation = InvalidUndoLocation;
+static List *compactRowLocks = NIL;
+
+/*
+ * Registers the compact lock of the row 'tuple' (the key if '!is_tuple') by
+ * 'oxid' and returns the undo location for its tuple header.  The caller
+ * should have the undo reserved.
+ */
+UndoLocation
+add_compact_row_lock(BTreeDescr *desc, OTuple tuple, bool is_tuple,
+					 OInMemoryBlkno blkno, uint32 pageChangeCount, OXid oxid)
+{
+	CompactRowLock *lock;
+	MemoryContext mcxt;
+	OTuple		key;
+	LocationIndex keylen;
+
+	Assert(desc->undoType == UndoLogRegular);
+
+	if (compactRowLocksOxid != oxid)
+	{
+		compactRowLocksOxid = oxid;
+		compactRowLockUndoLocation = InvalidUndoLocation;
+		compactRowLocks = NIL;
+	}
+
+	if (!UndoLocationIsValid(compactRowLockUndoLocation))
+	{
+		BTreeLeafTuphdr *tuphdr;
+		UndoLocation undoLocation;
+
+		tuphdr = (BTreeLeafTuphdr *) get_undo_record(desc->undoType,
+													 &undoLocation,
+													 MAXALIGN(sizeof(BTreeLeafTuphdr)));
+		tuphdr->xactInfo = OXID_GET_XACT_INFO(BootstrapTransactionId,
+											  RowLockUpdate, false);
+		tuphdr->deleted = BTreeLeafTupleNonDeleted;
+		tuphdr->chainHasLocks = false;
+		tuphdr->undoLocation = InvalidUndoLocation;
+		tuphdr->formatFlags = 0;
+		compactRowLockUndoLocation = undoLocation;
+		release_reserved_undo_location(desc->undoType);
+	}
+
+	mcxt = MemoryContextSwitchTo(TopTransactionContext);
+	keylen = o_btree_len(desc, tuple, is_tuple ? OTupleKeyLength : OKeyLength);
+	lock = (CompactRowLock *) palloc(sizeof(CompactRowLock));
+	lock->oids = desc->oids;
+	lock->type = desc->type;
+	lock->blkno = blkno;
+	lock->pageChangeCount = pageChangeCount;
+	lock->key = palloc0(keylen);
+	if (!is_tuple)
+	{
+		memcpy(lock->key, tuple.data, keylen);
+		lock->formatFlags = tuple.formatFlags;
+	}
+	else
+	{
+		bool		key_palloc = false;
+
+		key = o_btree_tuple_make_key(desc, tuple, lock->key, true, &key_palloc);
+		Assert(!key_palloc);
+		lock->formatFlags = key.formatFlags;
+	}
+	compactRowLocks = lappend(compactRowLocks, lock);
+	MemoryContextSwitchTo(mcxt);
+
+	return compactRowLockUndoLocation;
+}
+
+bool
+have_compact_row_locks(OXid oxid)
+{
+	return compactRowLocksOxid == oxid && compactRowLocks != NIL;
+}
+
+/*
+ * Releases the compact row locks of 'oxid' at the transaction end.  On abort,
+ * removes the locks from the rows.  Should be called after the undo stack is
+ * applied, because the undo of the own modifications of the locked rows might
+ * return the compact locks back to the pages.
+ */
+void
+release_compact_row_locks(OXid oxid, bool abort)
+{
+	ListCell   *lc;
+
+	if (compactRowLocksOxid != oxid)
+		return;
+
+	if (abort)
+	{
+		foreach(lc, compactRowLocks)
+		{
+			CompactRowLock *lock = (CompactRowLock *) lfirst(lc);
+			BTreeDescr *desc = get_tree_descr(lock->oids, lock->type);
+			OTuple		key;
+
+			if (!desc)
+				continue;
+
+			key.formatFlags = lock->formatFlags;
+			key.data = lock->key;
+			remove_row_lock(desc, key, lock->blkno, lock->pageChangeCount,
+							oxid, compactRowLockUndoLocation);
+		}
+	}
+
+	compactRowLocksOxid = InvalidOXid;
+	compactRowLockUndoLocation = InvalidUndoLocation;
+	compactRowLocks = NIL;
+}
+
 #define PENDING_TRUNCATES_FILENAME (ORIOLEDB_DATA_DIR "/pending_truncates")
 
 static void
@@ -1046,6 +1299,56 @@ read_hikey_from_undo(UndoLogType undoType, UndoLocation location,
 	*loc = ((BTreePageHeader *) dest)->hikeysEnd;
 }
 
+/*
+ * Accounts the page image reconstructed from undo by the current statement
+ * and checks it against orioledb.undo_image_limit and
+ * orioledb.undo_disk_read_limit.  Reports only once per statement.
+ */
+static void
+undo_image_account(uint64 diskBytes)
+{
+	static TimestampTz statementStart = 0;
+	static uint64 imageBytes = 0;
+	static uint64 readBytes = 0;
+	static bool reported = false;
+	TimestampTz curStatementStart = GetCurrentStatementStartTimestamp();
+
+	if (curStatementStart != statementStart)
+	{
+		statementStart = curStatementStart;
+		imageBytes = 0;
+		readBytes = 0;
+		reported = false;
+	}
+
+	imageBytes += ORIOLEDB_BLCKSZ;
+	readBytes += diskBytes;
+
+	if (reported)
+		return;
+
+	if ((undo_image_limit > 0 && imageBytes > (uint64) undo_image_limit * 1024) ||
+		(undo_disk_read_limit > 0 && readBytes > (uint64) undo_disk_read_limit * 1024))
+	{
+		reported = true;
+		ereport(undo_limit_error ? ERROR : WARNING,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("statement exceeded the limit of undo page image reconstruction"),
+				 errdetail("%llu kB of page images were reconstructed, %llu kB of undo were read from disk.",
+						   (unsigned long long) (imageBytes / 1024),
+						   (unsigned long long) (readBytes / 1024)),
+				 errhint("Limits are set by orioledb.undo_image_limit and orioledb.undo_disk_read_limit.")));
+	}
+}
+
+static void get_page_from_undo_internal(BTreeDescr *desc,
+										UndoLocation undoLocation,
+										Pointer key, BTreeKeyType kind,
+										Pointer dest, bool *is_left,
+										bool *is_right, OFixedKey *lokey,
+										OFixedKey *page_lokey,
+										OTuple *page_hikey);
+
 /*
  * Finds page image in undoLocation.
  */
@@ -1054,6 +1357,23 @@ get_page_from_undo(BTreeDescr *desc, UndoLocation undoLocation, Pointer key,
 				   BTreeKeyType kind, Pointer dest,
 				   bool *is_left, bool *is_right, OFixedKey *lokey,
 				   OFixedKey *page_lokey, OTuple *page_hikey)
+{
+	uint64		diskReads = undo_disk_reads;
+	uint64		diskReadBytes = undo_disk_read_bytes;
+
+	get_page_from_undo_internal(desc, undoLocation, key, kind, dest,
+								is_left, is_right, lokey,
+								page_lokey, page_hikey);
+
+	EA_TREE_ADD(desc->oids, undoDiskRead, undo_disk_reads - diskReads);
+	undo_image_account(undo_disk_read_bytes - diskReadBytes);
+}
+
+static void
+get_page_from_undo_internal(BTreeDescr *desc, UndoLocation undoLocation,
+							Pointer key, BTreeKeyType kind, Pointer dest,
+							bool *is_left, bool *is_right, OFixedKey *lokey,
+							OFixedKey *page_lokey, OTuple *page_hikey)
 {
 	UndoPageImageHeader header = {UndoPageImageInvalid, 0, 0};
 	int			cmp,
@@ -1064,6 +1384,8 @@ get_page_from_undo(BTreeDescr *desc, UndoLocation undoLocation, Pointer key,
 	LocationIndex loc = 0;
 	UndoLogType undoType = GET_PAGE_LEVEL_UNDO_TYPE(desc->undoType);
 
+	EA_TREE_INC(desc->oids, undoImage);
+
 	undo_read(undoType, undoLocation,
 			  sizeof(UndoPageImageHeader), (Pointer) &header);
 	left_loc = undoLocation + MAXALIGN(sizeof(UndoPageImageHeader));
@@ -1668,9 +1990,41 @@ get_prev_leaf_header_and_tuple_from_undo(UndoLogType undoType,
 			  sizeof(BTreeModifyUndoStackItem),
 			  (Pointer) &item);
 	Assert(item.header.type == ModifyUndoItemType);
-	Assert(item.action == BTreeOperationUpdate);
+	Assert(item.action == BTreeOperationUpdate ||
+		   item.action == BTreeOperationUpdateDelta);
 
 	*tuphdr = item.tuphdr;
+
+	if (item.action == BTreeOperationUpdateDelta)
+	{
+		BTreeUpdateDeltaUndo delta;
+		UndoLocation itemLocation = undoLocation -
+			offsetof(BTreeModifyUndoStackItem, tuphdr);
+
+		/*
+		 * The old tuple differs from the newer version given in 'tuple' only
+		 * by the bytes kept in the record.
+		 */
+		undo_read(undoType,
+				  itemLocation + sizeof(BTreeModifyUndoStackItem),
+				  sizeof(delta),
+				  (Pointer) &delta);
+		if (sizeAvailable == 0)
+		{
+			Pointer		data = palloc(delta.tupleLength);
+
+			memcpy(data, tuple->data, delta.tupleLength);
+			tuple->data = data;
+		}
+		Assert(sizeAvailable == 0 || sizeAvailable >= delta.tupleLength);
+		undo_read(undoType,
+				  itemLocation + BTREE_UPDATE_DELTA_UNDO_KEY_OFFSET + delta.keyLength,
+				  delta.length,
+				  tuple->data + delta.offset);
+		tuphdr->formatFlags = 0;
+		return;
+	}
+
 	tuple->formatFlags = tuphdr->formatFlags;
 	tupleSize = item.header.itemSize - sizeof(BTreeModifyUndoStackItem);
 	if (sizeAvailable == 0)
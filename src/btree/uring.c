@@ -0,0 +1,564 @@
+/*-------------------------------------------------------------------------
+ *
+ * uring.c
+ *		Deferred B-tree page writes: io_uring and write combining.
+ *
+ * The checkpointer writes the leaf pages one by one, and each synchronous
+ * write waits for the device.  Instead, the leaf image is copied to a write
+ * slot and the checkpointer continues the walk.  The IO lock of the page is
+ * held until the write completes, so the concurrent eviction of the page
+ * waits for it the same way as for the synchronous write.
+ *
+ * The chunks of the slots placed contiguously in the same file are combined
+ * into a single vectored request up to orioledb.write_combine_limit pages.
+ * The request is written with pwritev(), or submitted to the ring with
+ * orioledb.io_method = 'io_uring'.  Checkpoints of the freshly built or
+ * sequentially written trees thus issue large writes instead of 8 kB ones.
+ * All the writes are flushed and waited for before the writeback, fsync and
+ * the end of the tree checkpoint.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/uring.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <limits.h>
+
+#include "orioledb.h"
+
+#include "btree/device.h"
+#include "btree/io.h"
+#include "btree/uring.h"
+
+#include "port/pg_iovec.h"
+#include "utils/memutils.h"
+
+#include "pgstat.h"
+
+#ifdef USE_LIBURING
+#include <liburing.h>
+#endif
+
+/*
+ * Every write in flight holds an IO lock, so the number of the writes is
+ * limited well below MAX_SIMPLE_LWLOCKS.
+ */
+#define O_WRITE_MAX_SLOTS	(128)
+
+typedef struct
+{
+	OInMemoryBlkno blkno;
+	/* IO lock of the page, -1 for the free slot */
+	int			ionum;
+	/* bytes copied to the buffer */
+	int			amount;
+	/* chunks not yet written */
+	int			pending;
+	/* errno of the failed request */
+	int			error;
+	bool		finished;
+	char	   *buffer;
+} OUringWrite;
+
+/* Contiguous chunks of the write slots written by a single request */
+typedef struct
+{
+	int			nchunks;
+	int			total;
+	/* the device written, -1 for a data file */
+	int			device;
+	OUringWrite **owners;
+	struct iovec *iov;
+} OWriteRequest;
+
+static OUringWrite *writes = NULL;
+static int	nslots = 0;
+static int	writes_in_flight = 0;
+static int	current_write = -1;
+
+/* The request being combined, file is minus the number of the device */
+static OWriteRequest batch;
+static File batch_file;
+static off_t batch_offset;
+static int	batch_max_chunks;
+
+#ifdef USE_LIBURING
+static struct io_uring ring;
+static bool ring_initialized = false;
+static bool ring_failed = false;
+static int	requests_in_flight = 0;
+#endif
+
+static void
+o_write_init(void)
+{
+	Pointer		buffers;
+	int			i;
+
+	if (writes)
+		return;
+
+	nslots = Max(write_combine_limit, io_uring_depth);
+	nslots = Min(nslots, O_WRITE_MAX_SLOTS);
+
+	/* A page write might be split between two segment files */
+	batch_max_chunks = 2 * nslots;
+#ifdef IOV_MAX
+	batch_max_chunks = Min(batch_max_chunks, IOV_MAX);
+#endif
+	batch.owners = MemoryContextAlloc(TopMemoryContext,
+									  sizeof(OUringWrite *) * batch_max_chunks);
+	batch.iov = MemoryContextAlloc(TopMemoryContext,
+								   sizeof(struct iovec) * batch_max_chunks);
+	batch.nchunks = 0;
+	batch.total = 0;
+	batch.device = -1;
+
+	buffers = MemoryContextAlloc(TopMemoryContext,
+								 (Size) nslots * ORIOLEDB_BLCKSZ + BLCKSZ);
+	buffers = (Pointer) TYPEALIGN(BLCKSZ, buffers);
+	writes = MemoryContextAllocZero(TopMemoryContext,
+									sizeof(OUringWrite) * nslots);
+	for (i = 0; i < nslots; i++)
+	{
+		writes[i].ionum = -1;
+		writes[i].buffer = buffers + (Size) i * ORIOLEDB_BLCKSZ;
+	}
+}
+
+#ifdef USE_LIBURING
+static bool
+o_uring_init(void)
+{
+	int			ret;
+
+	if (ring_initialized)
+		return true;
+	if (ring_failed)
+		return false;
+
+	ret = io_uring_queue_init(batch_max_chunks, &ring, 0);
+	if (ret < 0)
+	{
+		ring_failed = true;
+		elog(LOG, "could not initialize io_uring, falling back to synchronous writes: %s",
+			 strerror(-ret));
+		return false;
+	}
+	ring_initialized = true;
+	return true;
+}
+#endif
+
+/*
+ * Releases the slot and the IO lock of the completed write.  Throws an error
+ * if the write failed.
+ */
+static void
+o_uring_complete(OUringWrite *w)
+{
+	OInMemoryBlkno blkno = w->blkno;
+	int			ionum = w->ionum,
+				error = w->error;
+
+	w->ionum = -1;
+	w->amount = 0;
+	w->error = 0;
+	w->finished = false;
+	writes_in_flight--;
+
+	unlock_io(ionum);
+	O_GET_IN_MEMORY_PAGEDESC(blkno)->ionum = -1;
+
+	if (error != 0)
+	{
+		errno = error;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write page %u to data file: %m", blkno)));
+	}
+}
+
+/*
+ * Accounts the result of the request in its write slots.
+ */
+static void
+o_write_request_done(OWriteRequest *req, int error, ssize_t written)
+{
+	int			i;
+
+	if (req->device >= 0)
+		o_device_io_done(req->device, true, written);
+
+	if (error == 0 && written != req->total)
+		error = ENOSPC;			/* short write, assume a lack of disk space */
+
+	for (i = 0; i < req->nchunks; i++)
+	{
+		OUringWrite *w = req->owners[i];
+
+		if (error != 0)
+			w->error = error;
+		w->pending--;
+	}
+}
+
+/*
+ * pwritev() retrying the partial writes.  Unlike pg_pwritev_with_retry(),
+ * the number of chunks isn't limited by PG_IOV_MAX.  The iov array is
+ * modified.
+ */
+static ssize_t
+o_pwritev_with_retry(int fd, struct iovec *iov, int iovcnt, off_t offset)
+{
+	ssize_t		total = 0;
+
+	while (iovcnt > 0)
+	{
+		ssize_t		part = pg_pwritev(fd, iov, iovcnt, offset);
+
+		if (part < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (part == 0)
+			break;
+
+		total += part;
+		offset += part;
+		while (iovcnt > 0 && part >= iov->iov_len)
+		{
+			part -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (part > 0)
+		{
+			iov->iov_base = (char *) iov->iov_base + part;
+			iov->iov_len -= part;
+		}
+	}
+	return total;
+}
+
+/*
+ * Completes the finished writes having all their chunks written.
+ */
+static void
+o_write_complete_finished(void)
+{
+	int			i;
+
+	for (i = 0; i < nslots; i++)
+	{
+		OUringWrite *w = &writes[i];
+
+		if (w->ionum >= 0 && w->finished && w->pending == 0)
+			o_uring_complete(w);
+	}
+}
+
+#ifdef USE_LIBURING
+/*
+ * Processes the available completions.  Waits for at least one if wait is
+ * true.
+ */
+static void
+o_uring_reap(bool wait)
+{
+	struct io_uring_cqe *cqe;
+	bool		processed = false;
+	int			ret;
+
+	if (!ring_initialized)
+		return;
+
+	if (wait && requests_in_flight > 0)
+	{
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_WRITE);
+		do
+		{
+			ret = io_uring_wait_cqe(&ring, &cqe);
+		} while (ret == -EINTR);
+		pgstat_report_wait_end();
+
+		if (ret < 0)
+			elog(PANIC, "could not wait for io_uring completion: %s",
+				 strerror(-ret));
+	}
+
+	while (io_uring_peek_cqe(&ring, &cqe) == 0)
+	{
+		OWriteRequest *req = (OWriteRequest *) io_uring_cqe_get_data(cqe);
+
+		if (cqe->res < 0)
+			o_write_request_done(req, -cqe->res, 0);
+		else
+			o_write_request_done(req, 0, cqe->res);
+		io_uring_cqe_seen(&ring, cqe);
+		requests_in_flight--;
+		pfree(req);
+		processed = true;
+	}
+
+	if (processed)
+		o_write_complete_finished();
+}
+#endif
+
+/*
+ * Writes or submits the combined request.
+ */
+static void
+o_write_flush(void)
+{
+	int			fd;
+	ssize_t		written;
+
+	if (batch.nchunks == 0)
+		return;
+
+	/* The virtual file might have been closed since the first chunk */
+	if (batch_file > 0)
+	{
+		fd = btree_smgr_file_fd(batch_file);
+		batch.device = -1;
+	}
+	else
+	{
+		fd = o_device_fd(-batch_file);
+		batch.device = -batch_file;
+		o_device_io_start(batch.device);
+	}
+
+#ifdef USE_LIBURING
+	if (io_method == OIOMethodIOUring && o_uring_init())
+	{
+		OWriteRequest *req;
+		struct io_uring_sqe *sqe;
+		int			ret;
+
+		/* The request keeps the chunks until its completion */
+		req = MemoryContextAlloc(TopMemoryContext,
+								 sizeof(OWriteRequest) +
+								 batch.nchunks * (sizeof(struct iovec) +
+												  sizeof(OUringWrite *)));
+		req->nchunks = batch.nchunks;
+		req->total = batch.total;
+		req->device = batch.device;
+		req->iov = (struct iovec *) (req + 1);
+		req->owners = (OUringWrite **) (req->iov + batch.nchunks);
+		memcpy(req->iov, batch.iov, sizeof(struct iovec) * batch.nchunks);
+		memcpy(req->owners, batch.owners, sizeof(OUringWrite *) * batch.nchunks);
+		batch.nchunks = 0;
+		batch.total = 0;
+
+		sqe = io_uring_get_sqe(&ring);
+		Assert(sqe);
+		io_uring_prep_writev(sqe, fd, req->iov, req->nchunks, batch_offset);
+		io_uring_sqe_set_data(sqe, req);
+
+		ret = io_uring_submit(&ring);
+		if (ret < 0)
+		{
+			o_write_request_done(req, -ret, 0);
+			pfree(req);
+			elog(ERROR, "could not submit io_uring request: %s", strerror(-ret));
+		}
+		requests_in_flight++;
+
+		/* Take the ready completions without waiting */
+		o_uring_reap(false);
+		return;
+	}
+#endif
+
+	pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_WRITE);
+	written = o_pwritev_with_retry(fd, batch.iov, batch.nchunks, batch_offset);
+	pgstat_report_wait_end();
+
+	o_write_request_done(&batch, written < 0 ? errno : 0, written);
+	batch.nchunks = 0;
+	batch.total = 0;
+	o_write_complete_finished();
+}
+
+/*
+ * Starts the deferred write of the page holding the given IO lock.  Returns
+ * false if the page should be written synchronously.
+ */
+bool
+o_uring_start_write(OInMemoryBlkno blkno, int ionum)
+{
+	int			i;
+
+	if (orioledb_s3_mode || use_mmap ||
+		(io_method != OIOMethodIOUring && write_combine_limit <= 1))
+		return false;
+
+	o_write_init();
+	Assert(current_write < 0);
+
+	while (writes_in_flight >= nslots)
+	{
+		if (batch.nchunks > 0)
+			o_write_flush();
+#ifdef USE_LIBURING
+		else
+			o_uring_reap(true);
+#endif
+	}
+
+	for (i = 0; i < nslots; i++)
+	{
+		if (writes[i].ionum < 0)
+			break;
+	}
+	Assert(i < nslots);
+
+	writes[i].blkno = blkno;
+	writes[i].ionum = ionum;
+	writes_in_flight++;
+	current_write = i;
+	return true;
+}
+
+bool
+o_uring_write_active(void)
+{
+	return current_write >= 0;
+}
+
+/*
+ * Copies the data to the buffer of the current write and appends it to the
+ * combined request.  The request is flushed first if the data doesn't
+ * continue it.  The file is minus the number of the device for the devices.
+ */
+void
+o_uring_write(File file, char *buffer, int amount, off_t offset)
+{
+	OUringWrite *w = &writes[current_write];
+	char	   *chunk = w->buffer + w->amount;
+	int			n;
+
+	Assert(w->amount + amount <= ORIOLEDB_BLCKSZ);
+	memcpy(chunk, buffer, amount);
+	w->amount += amount;
+
+	if (batch.nchunks > 0 &&
+		(batch_file != file ||
+		 batch_offset + batch.total != offset ||
+		 batch.nchunks >= batch_max_chunks))
+		o_write_flush();
+
+	if (batch.nchunks == 0)
+	{
+		batch_file = file;
+		batch_offset = offset;
+	}
+	n = batch.nchunks++;
+	batch.iov[n].iov_base = chunk;
+	batch.iov[n].iov_len = amount;
+	batch.owners[n] = w;
+	batch.total += amount;
+	w->pending++;
+
+	if (batch.total >= write_combine_limit * ORIOLEDB_BLCKSZ)
+		o_write_flush();
+}
+
+/*
+ * Finishes the current write.  The IO lock is released once all its chunks
+ * are written.
+ */
+void
+o_uring_finish_write(void)
+{
+	OUringWrite *w;
+
+	Assert(current_write >= 0);
+	w = &writes[current_write];
+	current_write = -1;
+	w->finished = true;
+	if (w->pending == 0)
+		o_uring_complete(w);
+}
+
+/*
+ * Flushes the combined request and waits for all the finished writes of this
+ * process to complete.
+ */
+void
+o_uring_wait_all(void)
+{
+	if (!writes)
+		return;
+
+	o_write_flush();
+#ifdef USE_LIBURING
+	while (requests_in_flight > 0)
+		o_uring_reap(true);
+#endif
+}
+
+/*
+ * Forgets the combined request and waits for the requests in flight ignoring
+ * their errors.  The IO locks still held are released here.
+ */
+void
+o_uring_error_cleanup(void)
+{
+	int			i;
+
+	if (!writes)
+		return;
+
+	current_write = -1;
+	batch.nchunks = 0;
+	batch.total = 0;
+
+#ifdef USE_LIBURING
+	while (requests_in_flight > 0)
+	{
+		struct io_uring_cqe *cqe;
+		OWriteRequest *req;
+		int			ret = io_uring_wait_cqe(&ring, &cqe);
+
+		if (ret == -EINTR)
+			continue;
+		if (ret < 0)
+			elog(PANIC, "could not wait for io_uring completion: %s",
+				 strerror(-ret));
+		req = (OWriteRequest *) io_uring_cqe_get_data(cqe);
+		if (req->device >= 0)
+			o_device_io_done(req->device, true, 0);
+		pfree(req);
+		io_uring_cqe_seen(&ring, cqe);
+		requests_in_flight--;
+	}
+#endif
+
+	for (i = 0; i < nslots; i++)
+	{
+		OUringWrite *w = &writes[i];
+
+		if (w->ionum >= 0)
+		{
+			if (have_io_lock(w->ionum))
+				unlock_io(w->ionum);
+			O_GET_IN_MEMORY_PAGEDESC(w->blkno)->ionum = -1;
+		}
+		w->ionum = -1;
+		w->amount = 0;
+		w->pending = 0;
+		w->error = 0;
+		w->finished = false;
+	}
+	writes_in_flight = 0;
+}
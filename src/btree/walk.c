@@ -0,0 +1,142 @@
+/*-------------------------------------------------------------------------
+ *
+ * walk.c
+ *		Walk over the internal pages of orioledb B-tree.
+ *
+ * The walk goes top-down from the root and visits only those children,
+ * which the walker asks for.  Each page is found by its lokey with the
+ * context of its level, so the image of the parent stays intact during the
+ * descent into its children.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/btree/walk.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/find.h"
+#include "btree/page_contents.h"
+#include "btree/walk.h"
+
+#include "miscadmin.h"
+
+static OBTreeFindPageContext *
+walk_find_page(BTreeDescr *desc, OBTreeFindPageContext **contexts,
+			   OTuple *lokey, uint16 level)
+{
+	OBTreeFindPageContext *context;
+
+	if (!contexts[level])
+		contexts[level] = palloc(sizeof(OBTreeFindPageContext));
+	context = contexts[level];
+
+	init_page_find_context(context, desc, COMMITSEQNO_INPROGRESS,
+						   BTREE_PAGE_FIND_IMAGE);
+	if (lokey)
+		(void) find_page(context, lokey, BTreeKeyNonLeafKey, level);
+	else
+		(void) find_page(context, NULL, BTreeKeyNone, level);
+
+	return context;
+}
+
+/*
+ * Visits the internal page at 'level', which starts with the 'lokey' (NULL
+ * for the leftmost page).  Returns false if the walker stopped the walk.
+ */
+static bool
+walk_subtree(BTreeDescr *desc, OBTreeWalker *walker,
+			 OBTreeFindPageContext **contexts, OTuple *lokey, uint16 level)
+{
+	BTreePageItemLocator loc;
+	OFixedKey	key;
+	Page		img;
+
+	CHECK_FOR_INTERRUPTS();
+
+	img = walk_find_page(desc, contexts, lokey, level)->img;
+
+	/* The page might be changed concurrently */
+	if (O_PAGE_IS(img, LEAF) || PAGE_GET_LEVEL(img) != level)
+		return true;
+
+	if (walker->page && !walker->page(desc, img, level, walker->arg))
+		return true;
+
+	BTREE_PAGE_FOREACH_ITEMS(img, &loc)
+	{
+		BTreeNonLeafTuphdr *tuphdr;
+		OTuple		tuple;
+		OTuple	   *childLokey;
+
+		BTREE_PAGE_READ_INTERNAL_ITEM(tuphdr, tuple, img, &loc);
+
+		switch (walker->downlink(desc, level, tuphdr->downlink, walker->arg))
+		{
+			case OBTreeWalkSkip:
+				continue;
+			case OBTreeWalkStop:
+				return false;
+			case OBTreeWalkDescend:
+				break;
+		}
+
+		if (BTREE_PAGE_LOCATOR_GET_OFFSET(img, &loc) > 0)
+		{
+			copy_fixed_key(desc, &key, tuple);
+			childLokey = &key.tuple;
+		}
+		else if (lokey)
+		{
+			copy_fixed_key(desc, &key, *lokey);
+			childLokey = &key.tuple;
+		}
+		else
+		{
+			childLokey = NULL;
+		}
+
+		if (level > 1)
+		{
+			if (!walk_subtree(desc, walker, contexts, childLokey, level - 1))
+				return false;
+		}
+		else
+		{
+			(void) walk_find_page(desc, contexts, childLokey, 0);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Walks the internal pages of the tree.  The walker's callbacks decide,
+ * which children to visit.  Does nothing for the tree of a single leaf.
+ */
+void
+o_btree_walk_internal_pages(BTreeDescr *desc, OBTreeWalker *walker)
+{
+	OBTreeFindPageContext *contexts[ORIOLEDB_MAX_DEPTH + 1];
+	uint16		level;
+	int			i;
+
+	o_btree_load_shmem(desc);
+	level = PAGE_GET_LEVEL(O_GET_IN_MEMORY_PAGE(desc->rootInfo.rootPageBlkno));
+	if (level == 0)
+		return;
+
+	memset(contexts, 0, sizeof(contexts));
+	(void) walk_subtree(desc, walker, contexts, NULL, level);
+
+	for (i = 0; i <= ORIOLEDB_MAX_DEPTH; i++)
+	{
+		if (contexts[i])
+			pfree(contexts[i]);
+	}
+}
@@ -65,6 +65,7 @@
 #include "commands/vacuum.h"
 #include "commands/view.h"
 #include "commands/tablecmds.h"
+#include "executor/executor.h"
 #include "fmgr.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
@@ -131,6 +132,33 @@ static void o_alter_column_type(AlterTableCmd *cmd, const char *queryString,
 static void o_find_collation_dependencies(Oid colloid);
 static void redefine_indices(Relation rel, OTable *new_o_table, bool primary, bool set_tablespace);
 static void redefine_pkey_for_rel(Relation rel);
+static void o_resolve_compress_options(List *options);
+
+/*
+ * DDL statements, whose system cache changes share the single batch of the
+ * autonomous transactions.  The statements, which may end the transaction in
+ * the middle, are not batched.
+ */
+static bool
+utility_uses_autonomous_batch(Node *stmt)
+{
+	switch (nodeTag(stmt))
+	{
+		case T_CreateStmt:
+		case T_AlterTableStmt:
+		case T_CompositeTypeStmt:
+		case T_CreateEnumStmt:
+		case T_AlterEnumStmt:
+		case T_CreateRangeStmt:
+		case T_CreateDomainStmt:
+		case T_DefineStmt:
+			return true;
+		case T_IndexStmt:
+			return !((IndexStmt *) stmt)->concurrent;
+		default:
+			return false;
+	}
+}
 
 void
 orioledb_setup_ddl_hooks(void)
@@ -965,6 +993,9 @@ orioledb_utility_command(PlannedStmt *pstmt,
 						case AT_AlterColumnType:
 							o_alter_column_type(cmd, queryString, rel);
 							break;
+						case AT_SetRelOptions:
+							o_resolve_compress_options((List *) cmd->def);
+							break;
 						default:
 							break;
 					}
@@ -973,6 +1004,14 @@ orioledb_utility_command(PlannedStmt *pstmt,
 			table_close(rel, lockmode);
 		}
 	}
+	else if (IsA(pstmt->utilityStmt, CreateStmt))
+	{
+		CreateStmt *stmt = (CreateStmt *) pstmt->utilityStmt;
+
+		if ((stmt->accessMethod && strcmp(stmt->accessMethod, "orioledb") == 0) ||
+			(!stmt->accessMethod && strcmp(default_table_access_method, "orioledb") == 0))
+			o_resolve_compress_options(stmt->options);
+	}
 	else if (IsA(pstmt->utilityStmt, ClusterStmt))
 	{
 		ClusterStmt *stmt = (ClusterStmt *) pstmt->utilityStmt;
@@ -1306,25 +1345,63 @@ orioledb_utility_command(PlannedStmt *pstmt,
 			if (is_orioledb_rel(rel))
 			{
 				table_close(rel, lockmode);
-				elog(ERROR, "concurrent index creation is not supported for orioledb tables yet");
+				if (!create_index_concurrently_fallback)
+					elog(ERROR, "concurrent index creation is not supported for orioledb tables yet");
+
+				/*
+				 * The writers only maintain the indices of the table
+				 * descriptor, which doesn't get the index until it's built.
+				 * So build it the regular way, under the lock blocking the
+				 * writes.
+				 */
+				ereport(NOTICE,
+						(errmsg("building index on orioledb table \"%s\" non-concurrently",
+								stmt->relation->relname)));
+				stmt->concurrent = false;
 			}
-			table_close(rel, lockmode);
+			else
+				table_close(rel, lockmode);
 		}
 
+		if (stmt->options != NIL)
+		{
+			Relation	rel;
+
+			rel = relation_openrv(stmt->relation, AccessShareLock);
+			if (is_orioledb_rel(rel))
+				o_resolve_compress_options(stmt->options);
+			relation_close(rel, AccessShareLock);
+		}
 	}
 
 	if (call_next)
 	{
-		if (next_ProcessUtility_hook)
-			(*next_ProcessUtility_hook) (pstmt, queryString,
-										 readOnlyTree,
-										 context, params, env,
-										 dest, qc);
-		else
-			standard_ProcessUtility(pstmt, queryString,
-									readOnlyTree,
-									context, params, env,
-									dest, qc);
+		bool		batch = utility_uses_autonomous_batch(pstmt->utilityStmt);
+
+		if (batch)
+			begin_autonomous_batch();
+		PG_TRY();
+		{
+			if (next_ProcessUtility_hook)
+				(*next_ProcessUtility_hook) (pstmt, queryString,
+											 readOnlyTree,
+											 context, params, env,
+											 dest, qc);
+			else
+				standard_ProcessUtility(pstmt, queryString,
+										readOnlyTree,
+										context, params, env,
+										dest, qc);
+		}
+		PG_CATCH();
+		{
+			if (batch)
+				end_autonomous_batch(false);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+		if (batch)
+			end_autonomous_batch(true);
 	}
 
 	if (IsA(pstmt->utilityStmt, TruncateStmt) && !in_nontransactional_truncate)
@@ -1757,9 +1834,9 @@ set_toast_oids_and_options(Relation rel, Relation toast_rel, bool only_fillfacto
 	int			numTreeOids;
 	OTable	   *o_table;
 	ORelOptions *options = (ORelOptions *) rel->rd_options;
-	OCompress	compress = default_compress,
-				primary_compress = default_primary_compress,
-				toast_compress = default_toast_compress;
+	OCompress	compress = o_compress_default_codec(default_compress),
+				primary_compress = o_compress_default_codec(default_primary_compress),
+				toast_compress = o_compress_default_codec(default_toast_compress);
 	uint8		fillfactor = BTREE_DEFAULT_FILLFACTOR;
 	OXid		oxid = InvalidOXid;
 	OSnapshot	oSnapshot;
@@ -2047,6 +2124,60 @@ rewrite_matview(Relation rel, OTable *old_o_table, OTable *new_o_table)
 	SetMatViewPopulatedState(rel, true);
 }
 
+/*
+ * Returns the expression computing the value of the attribute 'i' of the
+ * rewritten table, when the old value is NULL.  NULL if the old value should
+ * be kept.
+ */
+static Node *
+rewrite_table_null_expr(Relation rel, Form_pg_attribute attr, int i,
+						int primary_init_nfields)
+{
+	Node	   *expr = NULL;
+
+	if (attr->atthasdef && !attr->atthasmissing &&
+		i >= primary_init_nfields)
+		expr = build_column_default(rel, i + 1);
+
+	if (!expr && attr->attgenerated)
+		expr = build_column_default(rel, i + 1);
+
+	if (!expr && DomainHasConstraints(attr->atttypid))
+	{
+		Oid			baseTypeId;
+		int32		baseTypeMod;
+		Oid			baseTypeColl;
+		Node	   *defval;
+
+		defval = build_column_default(rel, i + 1);
+
+		if (!defval)
+		{
+			baseTypeMod = attr->atttypmod;
+			baseTypeId = getBaseTypeAndTypmod(attr->atttypid, &baseTypeMod);
+			baseTypeColl = get_typcollation(baseTypeId);
+			defval = (Node *) makeNullConst(baseTypeId, baseTypeMod, baseTypeColl);
+		}
+		else
+		{
+			baseTypeId = exprType(defval);
+		}
+		defval = (Node *) coerce_to_target_type(NULL,
+												defval,
+												baseTypeId,
+												attr->atttypid,
+												attr->atttypmod,
+												COERCION_ASSIGNMENT,
+												COERCE_IMPLICIT_CAST,
+												-1);
+		if (defval == NULL)		/* should not happen */
+			elog(ERROR, "failed to coerce base type to domain");
+		expr = defval;
+	}
+
+	return expr;
+}
+
 static void
 rewrite_table(Relation rel, OTable *old_o_table, OTable *new_o_table)
 {
@@ -2060,6 +2191,11 @@ rewrite_table(Relation rel, OTable *old_o_table, OTable *new_o_table)
 	OTableDescr *descr;
 	OSnapshot	oSnapshot;
 	OXid		oxid;
+	EState	   *estate;
+	ExprContext *econtext;
+	ExprState **exprStates;
+	ExprState **nullExprStates;
+	int			natts;
 	int			primary_init_nfields = old_o_table->primary_init_nfields;
 
 	if (!old_o_table->has_primary)
@@ -2069,92 +2205,75 @@ rewrite_table(Relation rel, OTable *old_o_table, OTable *new_o_table)
 	descr = relation_get_descr(rel);
 	old_slot = MakeSingleTupleTableSlot(old_descr->tupdesc, &TTSOpsOrioleDB);
 	new_slot = MakeSingleTupleTableSlot(descr->tupdesc, &TTSOpsOrioleDB);
-	sscan = make_btree_seq_scan(&GET_PRIMARY(old_descr)->desc, &o_in_progress_snapshot, NULL);
+	natts = old_slot->tts_tupleDescriptor->natts;
 
-	fill_current_oxid_osnapshot(&oxid, &oSnapshot);
-
-	while (!O_TUPLE_IS_NULL(tup = btree_seq_scan_getnext(sscan, old_slot->tts_mcxt, &tupleCsn, &hint)))
+	/*
+	 * Prepare the expressions once, the per-tuple context of the executor
+	 * state holds the values of the current tuple only.
+	 */
+	estate = CreateExecutorState();
+	econtext = GetPerTupleExprContext(estate);
+	econtext->ecxt_scantuple = old_slot;
+	exprStates = (ExprState **) palloc0(sizeof(ExprState *) * natts);
+	nullExprStates = (ExprState **) palloc0(sizeof(ExprState *) * natts);
+	for (int i = 0; i < natts; i++)
 	{
-		tts_orioledb_store_tuple(old_slot, tup, old_descr,
-								 COMMITSEQNO_INPROGRESS, PrimaryIndexNumber,
-								 true, &hint);
-		slot_getallattrs(old_slot);
-		tts_orioledb_detoast(old_slot);
+		Form_pg_attribute attr = &old_slot->tts_tupleDescriptor->attrs[i];
+		Node	   *expr = NULL;
+		ListCell   *lc;
 
-		for (int i = 0; i < old_slot->tts_tupleDescriptor->natts; i++)
+		foreach(lc, alter_type_exprs)
 		{
-			Node	   *expr = NULL;
-			Form_pg_attribute attr = &old_slot->tts_tupleDescriptor->attrs[i];
+			AttrNumber	attnum = intVal(linitial((List *) lfirst(lc)));
 
-			ListCell   *lc;
-
-			foreach(lc, alter_type_exprs)
+			if (attnum == i + 1)
 			{
-				AttrNumber	attnum = intVal(linitial((List *) lfirst(lc)));
-
-				if (attnum == i + 1)
-				{
-					expr = (Node *) lsecond((List *) lfirst(lc));
-					break;
-				}
+				expr = (Node *) lsecond((List *) lfirst(lc));
+				break;
 			}
+		}
 
-			if (!expr && attr->atthasdef && !attr->atthasmissing &&
-				i >= primary_init_nfields &&
-				old_slot->tts_isnull[i])
-			{
-				Node	   *defaultexpr = build_column_default(rel, i + 1);
+		if (expr)
+			exprStates[i] = ExecPrepareExpr((Expr *) expr, estate);
+		else
+		{
+			expr = rewrite_table_null_expr(rel, attr, i,
+										   primary_init_nfields);
+			if (expr)
+				nullExprStates[i] = ExecPrepareExpr((Expr *) expr, estate);
+		}
+	}
 
-				expr = defaultexpr;
-			}
+	sscan = make_btree_seq_scan(&GET_PRIMARY(old_descr)->desc, &o_in_progress_snapshot, NULL);
 
-			if (!expr && attr->attgenerated && old_slot->tts_isnull[i])
-			{
-				Node	   *defaultexpr = build_column_default(rel, i + 1);
+	fill_current_oxid_osnapshot(&oxid, &oSnapshot);
 
-				expr = defaultexpr;
-			}
+	while (!O_TUPLE_IS_NULL(tup = btree_seq_scan_getnext(sscan, old_slot->tts_mcxt, &tupleCsn, &hint)))
+	{
+		MemoryContext oldcxt;
 
-			if (!expr && DomainHasConstraints(attr->atttypid) &&
-				old_slot->tts_isnull[i])
-			{
-				Oid			baseTypeId;
-				int32		baseTypeMod;
-				Oid			baseTypeColl;
-				Node	   *defval;
+		ResetExprContext(econtext);
 
-				defval = build_column_default(rel, i + 1);
+		tts_orioledb_store_tuple(old_slot, tup, old_descr,
+								 COMMITSEQNO_INPROGRESS, PrimaryIndexNumber,
+								 true, &hint);
+		slot_getallattrs(old_slot);
+		tts_orioledb_detoast(old_slot);
 
-				if (!defval)
-				{
-					baseTypeMod = attr->atttypmod;
-					baseTypeId = getBaseTypeAndTypmod(attr->atttypid, &baseTypeMod);
-					baseTypeColl = get_typcollation(baseTypeId);
-					defval = (Node *) makeNullConst(baseTypeId, baseTypeMod, baseTypeColl);
-				}
-				else
-				{
-					baseTypeId = exprType(defval);
-				}
-				defval = (Node *) coerce_to_target_type(NULL,
-														defval,
-														baseTypeId,
-														attr->atttypid,
-														attr->atttypmod,
-														COERCION_ASSIGNMENT,
-														COERCE_IMPLICIT_CAST,
-														-1);
-				if (defval == NULL) /* should not happen */
-					elog(ERROR, "failed to coerce base type to domain");
-				expr = defval;
-			}
+		oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+		for (int i = 0; i < natts; i++)
+		{
+			ExprState  *exprState = exprStates[i];
+			Form_pg_attribute attr;
+
+			if (!exprState && old_slot->tts_isnull[i])
+				exprState = nullExprStates[i];
 
 			attr = &new_slot->tts_tupleDescriptor->attrs[i];
-			if (expr)
+			if (exprState)
 			{
-				new_slot->tts_values[i] = o_eval_default(new_o_table, rel, expr, old_slot,
-														 attr->attbyval, attr->attlen,
-														 &new_slot->tts_isnull[i]);
+				new_slot->tts_values[i] = ExecEvalExpr(exprState, econtext,
+													   &new_slot->tts_isnull[i]);
 			}
 			else
 			{
@@ -2170,6 +2289,7 @@ rewrite_table(Relation rel, OTable *old_o_table, OTable *new_o_table)
 				}
 			}
 		}
+		MemoryContextSwitchTo(oldcxt);
 		new_slot->tts_nvalid = new_slot->tts_tupleDescriptor->natts;
 
 		o_tbl_insert(descr, rel, new_slot, oxid, oSnapshot.csn);
@@ -2181,6 +2301,9 @@ rewrite_table(Relation rel, OTable *old_o_table, OTable *new_o_table)
 	ExecDropSingleTupleTableSlot(old_slot);
 	ExecDropSingleTupleTableSlot(new_slot);
 	free_btree_seq_scan(sscan);
+	pfree(exprStates);
+	pfree(nullExprStates);
+	FreeExecutorState(estate);
 
 	o_drop_table(old_o_table->oids);
 }
@@ -3690,6 +3813,58 @@ orioledb_object_access_hook(ObjectAccessType access, Oid classId, Oid objectId,
 		old_objectaccess_hook(access, classId, objectId, subId, arg);
 }
 
+/*
+ * Parses "<codec>[:<level>]" compression value.
+ */
+static int16
+o_parse_compress_codec(const char *value)
+{
+	const char *ptr;
+	int			codec;
+	long		level;
+
+	if (strncmp(value, "lz4", 3) == 0)
+	{
+		codec = O_COMPRESS_CODEC_LZ4;
+		ptr = value + 3;
+		level = 0;
+	}
+	else if (strncmp(value, "zstd", 4) == 0)
+	{
+		codec = O_COMPRESS_CODEC_ZSTD;
+		ptr = value + 4;
+		level = O_COMPRESS_DEFAULT;
+	}
+	else
+		ereport(ERROR, (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+						errmsg("invalid compression value: \"%s\"",
+							   value)));
+
+	if (*ptr == ':')
+	{
+		char	   *end;
+
+		ptr++;
+		errno = 0;
+		level = strtol(ptr, &end, 10);
+		if (end == ptr || *end != '\0' || errno != 0)
+			ereport(ERROR, (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+							errmsg("invalid compression value: \"%s\"",
+								   value)));
+	}
+	else if (*ptr != '\0')
+		ereport(ERROR, (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+						errmsg("invalid compression value: \"%s\"",
+							   value)));
+
+	if (level < 0 || level > O_COMPRESS_LEVEL_MASK)
+		ereport(ERROR, (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						errmsg("compression level in \"%s\" must be between %d and %d",
+							   value, 0, O_COMPRESS_LEVEL_MASK)));
+
+	return OCompressMake(codec, level);
+}
+
 int16
 o_parse_compress(const char *value)
 {
@@ -3761,16 +3936,50 @@ o_parse_compress(const char *value)
 		if (strcmp(value, "auto") == 0 ||
 			strcmp(value, "on") == 0 ||
 			strcmp(value, "true") == 0)
-			result = O_COMPRESS_DEFAULT;
+			return (default_compress_codec == O_COMPRESS_CODEC_LZ4) ?
+				OCompressMake(O_COMPRESS_CODEC_LZ4, 0) : O_COMPRESS_DEFAULT;
 		else if (strcmp(value, "off") == 0)
-			result = InvalidOCompress;
+			return InvalidOCompress;
 		else
-			ereport(ERROR, (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-							errmsg("invalid compression value: \"%s\"",
-								   value)));
+			return o_parse_compress_codec(value);
 	}
 
-	return result;
+	/* Plain level can't overlap the codec bits */
+	if (result > O_COMPRESS_LEVEL_MASK)
+		ereport(ERROR, (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						errmsg("compression level \"%s\" must be between %d and %d",
+							   value, -1, O_COMPRESS_LEVEL_MASK)));
+
+	return o_compress_default_codec(result);
+}
+
+/*
+ * Replaces the compression options of the statement with the values naming
+ * the codec explicitly.  The stored options get parsed again on every rewrite
+ * of the relation, so "auto" and the plain levels must not pick up
+ * orioledb.default_compress_codec of that later session.
+ */
+static void
+o_resolve_compress_options(List *options)
+{
+	ListCell   *lc;
+
+	foreach(lc, options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+		OCompress	compress;
+
+		if (def->defnamespace != NULL ||
+			(strcmp(def->defname, "compress") != 0 &&
+			 strcmp(def->defname, "primary_compress") != 0 &&
+			 strcmp(def->defname, "toast_compress") != 0))
+			continue;
+
+		/* The option without a value means "true" */
+		compress = o_parse_compress(def->arg ? defGetString(def) : "true");
+		if (OCompressIsValid(compress))
+			def->arg = (Node *) makeString(o_compress_to_option(compress));
+	}
 }
 
 void
@@ -14,6 +14,16 @@
  * is reset after reboot of the database engine and the state must
  * be restored after it.
  *
+ * Compressed trees allocate an extent on every page write, and each
+ * get_extent() call modifies both B-trees.  To make it cheaper, the meta page
+ * of the tree keeps a cache of free extents binned by the length.  An empty
+ * bin is refilled with a batch of extents cut from a single free extent, or
+ * from the end of the file, so the pages written one after another get
+ * physically contiguous extents.  The cached extents are still accounted in
+ * numFreeBlocks.  foreach_free_extent() disables the cache and returns the
+ * cached extents to the B-trees, so the free extents list saved by the
+ * checkpoint is exact.
+ *
  * Copyright (c) 2021-2025, Oriole DB Inc.
  * Copyright (c) 2025, Supabase Inc.
  *
@@ -27,6 +37,7 @@
 #include "orioledb.h"
 
 #include "btree/btree.h"
+#include "btree/device.h"
 #include "btree/find.h"
 #include "btree/io.h"
 #include "btree/iterator.h"
@@ -40,14 +51,194 @@
 
 #include "access/transam.h"
 #include "miscadmin.h"
+#include "storage/spin.h"
 #include "utils/wait_event.h"
 
 #define EXTENTS_IX_EQ(ex1, ex2) ((ex1).ixType == (ex2).ixType && \
 								 (ex1).datoid == (ex2).datoid && \
 								 (ex1).relnode == (ex2).relnode)
 
+static FileExtent get_extent_internal(BTreeDescr *desc, uint16 len,
+									  bool extend);
+
+/*
+ * Allocates the extent at the end of the data file.
+ */
+static FileExtent
+extend_data_file(BTreeDescr *desc, uint16 len)
+{
+	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
+	FileExtent	result;
+
+	result.len = len;
+	if (use_device)
+		result.off = orioledb_device_alloc(desc, len * ORIOLEDB_COMP_BLCKSZ) / ORIOLEDB_COMP_BLCKSZ;
+	else
+		result.off = pg_atomic_fetch_add_u64(&metaPage->datafileLength[0], len);
+	return result;
+}
+
 /*
- * Returns free file extent with length = len.
+ * Returns free file extent with length = len.  Takes it from the free extents
+ * cache if possible.
+ */
+FileExtent
+get_extent(BTreeDescr *desc, uint16 len)
+{
+	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
+	FreeExtentsCache *cache = &metaPage->freeExtentsCache;
+	FreeExtentsCacheBin *bin;
+	FileExtent	result,
+				batch;
+	uint16		batchLen = len * FREE_EXTENTS_CACHE_BATCH;
+	int			i;
+
+	Assert(!orioledb_s3_mode);
+
+	if (len == 0 || len > FREE_EXTENTS_CACHE_CLASSES)
+		return get_extent_internal(desc, len, true);
+
+	bin = &cache->bins[len - 1];
+	SpinLockAcquire(&cache->lock);
+	if (cache->disabled > 0)
+	{
+		SpinLockRelease(&cache->lock);
+		return get_extent_internal(desc, len, true);
+	}
+	if (bin->pos < bin->count)
+	{
+		result.off = bin->offsets[bin->pos++];
+		result.len = len;
+		SpinLockRelease(&cache->lock);
+		pg_atomic_fetch_sub_u64(&metaPage->numFreeBlocks, (uint64) len);
+		return result;
+	}
+	cache->inProgress++;
+	SpinLockRelease(&cache->lock);
+
+	result.len = InvalidFileExtentLen;
+	result.off = InvalidFileExtentOff;
+
+	/*
+	 * Cut the batch from a single free extent.  Don't split the smaller free
+	 * extents into the cache, but extend the file by the whole batch if there
+	 * are no suitable free extents at all.
+	 */
+	PG_TRY();
+	{
+		batch = get_extent_internal(desc, batchLen, false);
+		if (!FileExtentIsValid(batch))
+		{
+			result = get_extent_internal(desc, len, false);
+			if (!FileExtentIsValid(result))
+				batch = extend_data_file(desc, batchLen);
+		}
+	}
+	PG_CATCH();
+	{
+		SpinLockAcquire(&cache->lock);
+		cache->inProgress--;
+		SpinLockRelease(&cache->lock);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	if (!FileExtentIsValid(batch))
+	{
+		SpinLockAcquire(&cache->lock);
+		cache->inProgress--;
+		SpinLockRelease(&cache->lock);
+		return result;
+	}
+
+	/* The rest of the batch is still free */
+	pg_atomic_fetch_add_u64(&metaPage->numFreeBlocks, (uint64) (batchLen - len));
+	result.off = batch.off;
+	result.len = len;
+
+	SpinLockAcquire(&cache->lock);
+	cache->inProgress--;
+	if (bin->pos >= bin->count)
+	{
+		for (i = 1; i < FREE_EXTENTS_CACHE_BATCH; i++)
+			bin->offsets[i - 1] = batch.off + (uint64) i * len;
+		bin->pos = 0;
+		bin->count = FREE_EXTENTS_CACHE_BATCH - 1;
+		batch.len = 0;
+	}
+	SpinLockRelease(&cache->lock);
+
+	if (batch.len > 0)
+	{
+		/* The bin was refilled concurrently, return the rest to the trees */
+		batch.off += len;
+		batch.len = batchLen - len;
+		free_extent(desc, batch);
+	}
+
+	return result;
+}
+
+/*
+ * Disables the free extents cache and moves the cached extents to the
+ * B-trees.  Waits for the concurrent refills to complete.
+ */
+static void
+free_extents_cache_disable(BTreeDescr *desc)
+{
+	FreeExtentsCache *cache = &BTREE_GET_META(desc)->freeExtentsCache;
+	FileExtent	extents[FREE_EXTENTS_CACHE_CLASSES];
+	int			i,
+				n = 0;
+
+	SpinLockAcquire(&cache->lock);
+	cache->disabled++;
+	for (i = 0; i < FREE_EXTENTS_CACHE_CLASSES; i++)
+	{
+		FreeExtentsCacheBin *bin = &cache->bins[i];
+
+		/* The bin holds the contiguous extents of the same length */
+		if (bin->pos < bin->count)
+		{
+			extents[n].off = bin->offsets[bin->pos];
+			extents[n].len = (bin->count - bin->pos) * (i + 1);
+			n++;
+		}
+		bin->pos = bin->count = 0;
+	}
+	SpinLockRelease(&cache->lock);
+
+	for (i = 0; i < n; i++)
+		free_extent(desc, extents[i]);
+
+	while (true)
+	{
+		bool		done;
+
+		SpinLockAcquire(&cache->lock);
+		done = (cache->inProgress == 0);
+		SpinLockRelease(&cache->lock);
+		if (done)
+			break;
+		pg_usleep(100L);
+	}
+}
+
+static void
+free_extents_cache_enable(BTreeDescr *desc)
+{
+	FreeExtentsCache *cache = &BTREE_GET_META(desc)->freeExtentsCache;
+
+	SpinLockAcquire(&cache->lock);
+	Assert(cache->disabled > 0);
+	cache->disabled--;
+	SpinLockRelease(&cache->lock);
+}
+
+/*
+ * Returns free file extent with length = len from the B-trees.  If there is
+ * no such extent, extends the file or returns an invalid extent depending
+ * on extend.
  *
  * get_extend()/free_extend() operations optimized for more fast get_extend()
  * execution because as more critical for performance part.
@@ -68,8 +259,8 @@
  * 4. If found extent is more than needed than return the remaining part into
  * the (len, off) B-tree.
  */
-FileExtent
-get_extent(BTreeDescr *desc, uint16 len)
+static FileExtent
+get_extent_internal(BTreeDescr *desc, uint16 len, bool extend)
 {
 	BTreeMetaPage *metaPage = BTREE_GET_META(desc);
 	BTreeLeafTuphdr *header = NULL;
@@ -90,15 +281,15 @@ get_extent(BTreeDescr *desc, uint16 len)
 
 	Assert(!orioledb_s3_mode);
 
+	result.len = InvalidFileExtentLen;
+	result.off = InvalidFileExtentOff;
+
 	/* a fast check */
 	if (pg_atomic_read_u64(&metaPage->numFreeBlocks) < len)
 	{
 		/* free extent can not be founded, increase file length */
-		result.len = len;
-		if (use_device)
-			result.off = orioledb_device_alloc(desc, len * ORIOLEDB_COMP_BLCKSZ) / ORIOLEDB_COMP_BLCKSZ;
-		else
-			result.off = pg_atomic_fetch_add_u64(&metaPage->datafileLength[0], len);
+		if (extend)
+			result = extend_data_file(desc, len);
 		return result;
 	}
 
@@ -178,11 +369,8 @@ get_extent(BTreeDescr *desc, uint16 len)
 	if (!found)
 	{
 		/* free extent not founded, increase file length */
-		result.len = len;
-		if (use_device)
-			result.off = orioledb_device_alloc(desc, len * ORIOLEDB_COMP_BLCKSZ) / ORIOLEDB_COMP_BLCKSZ;
-		else
-			result.off = pg_atomic_fetch_add_u64(&metaPage->datafileLength[0], len);
+		if (extend)
+			result = extend_data_file(desc, len);
 		enable_stopevents = old_enable_stopevents;
 		return result;
 	}
@@ -475,6 +663,8 @@ free_extent(BTreeDescr *desc, FileExtent extent)
 
 /*
  * Calls the callback for each free file extent for a BTree on given csn.
+ * The cache is disabled meanwhile, so all the free extents are in the
+ * B-trees.
  *
  * Be careful, there are can be some intersections, see get_extent() algorithm.
  */
@@ -492,6 +682,7 @@ foreach_free_extent(BTreeDescr *desc, ForEachExtentCallback callback, void *arg)
 	OTuple		toTup;
 	OTuple		fromTup;
 
+	free_extents_cache_disable(desc);
 	enable_stopevents = false;
 
 	from.ixType = to.ixType = desc->type;
@@ -542,6 +733,7 @@ foreach_free_extent(BTreeDescr *desc, ForEachExtentCallback callback, void *arg)
 
 	btree_iterator_free(it);
 	enable_stopevents = old_enable_stopevents;
+	free_extents_cache_enable(desc);
 }
 
 /*
@@ -1642,7 +1642,10 @@ rebuild_indices_worker_heap_scan(OTableDescr *old_descr, OTableDescr *descr,
 
 	while (scan_getnextslot_allattrs(sscan, old_descr, primarySlot, heap_tuples))
 	{
-		tts_orioledb_detoast(primarySlot);
+		/*
+		 * The TOASTed values aren't detoasted: their chunks are copied from
+		 * the old TOAST tree by tts_orioledb_toast_sort_add().
+		 */
 		tts_orioledb_toast(primarySlot, descr);
 
 		for (i = PrimaryIndexNumber; i < descr->nIndices; i++)
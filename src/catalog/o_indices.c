@@ -767,6 +767,12 @@ fillFixedFormatSpec(TupleDesc tupdesc, OTupleFixedFormatSpec *spec,
 		natts = *primary_init_nfields;
 	else
 		natts = tupdesc->natts;
+
+	/*
+	 * Precompute the offsets of the leading fixed-width attributes.  They are
+	 * the same in the fixed format tuples and in the tuples without nulls, so
+	 * the access to an attribute doesn't need to walk the preceding ones.
+	 */
 	for (i = 0; i < natts; i++)
 	{
 		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
@@ -775,6 +781,7 @@ fillFixedFormatSpec(TupleDesc tupdesc, OTupleFixedFormatSpec *spec,
 			break;
 
 		len = att_align_nominal(len, attr->attalign);
+		attr->attcacheoff = len;
 		len += attr->attlen;
 	}
 	spec->natts = i;
@@ -792,6 +799,50 @@ attrnumber_cmp(const void *p1, const void *p2)
 	return 0;
 }
 
+/*
+ * Fills the sets of table attributes the secondary index tuple depends on.
+ * They let the update skip the indices, which fields weren't modified.
+ */
+static void
+fill_index_update_attrs(OIndexDescr *descr, OIndex *oIndex)
+{
+	int			i;
+
+	descr->keyAttrs = NULL;
+	descr->includedAttrs = NULL;
+
+	for (i = 0; i < oIndex->nLeafFields; i++)
+	{
+		int			attnum = oIndex->leafFields[i].attnum;
+
+		if (attnum < 0)
+			continue;
+
+		attnum += 1 - FirstLowInvalidHeapAttributeNumber;
+		if (i >= oIndex->nKeyFields &&
+			i < oIndex->nKeyFields + oIndex->nIncludedFields)
+			descr->includedAttrs = bms_add_member(descr->includedAttrs, attnum);
+		else
+			descr->keyAttrs = bms_add_member(descr->keyAttrs, attnum);
+	}
+
+	/* Primary key fields might be shared with INCLUDE fields */
+	for (i = 0; i < oIndex->nPrimaryFields; i++)
+	{
+		int			attnum;
+
+		attnum = oIndex->leafFields[oIndex->primaryFieldsAttnums[i] - 1].attnum;
+		if (attnum >= 0)
+			descr->keyAttrs = bms_add_member(descr->keyAttrs,
+											 attnum + 1 - FirstLowInvalidHeapAttributeNumber);
+	}
+
+	pull_varattnos((Node *) descr->expressions, 1, &descr->keyAttrs);
+	pull_varattnos((Node *) descr->predicate, 1, &descr->keyAttrs);
+	descr->includedAttrs = bms_del_members(descr->includedAttrs,
+										   descr->keyAttrs);
+}
+
 static void
 cache_scan_tupdesc_and_slot(OIndexDescr *index_descr, OIndex *oIndex)
 {
@@ -1035,6 +1086,9 @@ o_index_fill_descr(OIndexDescr *descr, OIndex *oIndex, OTable *oTable)
 	if (descr->predicate)
 		descr->predicate_str = pstrdup(oIndex->predicate_str);
 	descr->expressions = list_copy_deep(oIndex->expressions);
+	if (oIndex->indexType == oIndexRegular ||
+		oIndex->indexType == oIndexUnique)
+		fill_index_update_attrs(descr, oIndex);
 	if (!(oIndex->indexType == oIndexToast || (oIndex->indexType == oIndexPrimary && oIndex->primaryIsCtid)))
 	{
 		descr->old_leaf_slot = MakeSingleTupleTableSlot(descr->leafTupdesc, &TTSOpsOrioleDB);
@@ -1089,6 +1143,7 @@ o_index_fill_descr(OIndexDescr *descr, OIndex *oIndex, OTable *oTable)
 						primary_init_nfields);
 	fillFixedFormatSpec(descr->nonLeafTupdesc, &descr->nonLeafSpec,
 						false, NULL);
+	descr->leafDeform = o_tuple_make_deform_attrs(descr->leafTupdesc, mcxt);
 	if (primary_init_nfields)
 		pfree(primary_init_nfields);
 }
@@ -1224,19 +1279,29 @@ o_indices_find_table_oids(ORelOids indexOids, OIndexType type,
 	return false;
 }
 
-void
-o_indices_foreach_oids(OIndexOidsCallback callback, void *arg)
+/*
+ * Collects the oids of all the trees in SYS_TREES_O_INDICES into a palloc'ed
+ * array in a single pass of the system tree.  Callers can scan the array as
+ * many times as they need, or split it between workers, without touching
+ * the system tree again.
+ */
+OIndexOidsItem *
+o_indices_collect_oids(int *nitems)
 {
 	OIndexChunkKey chunkKey;
-	ORelOids	oids = {0, 0, 0},
-				old_oids PG_USED_FOR_ASSERTS_ONLY;
-	OIndexType	type = oIndexInvalid;
 	BTreeIterator *it;
 	OTuple		tuple;
 	BTreeDescr *desc = get_sys_tree(SYS_TREES_O_INDICES);
+	OIndexOidsItem *items;
+	int			allocated = 64;
+	int			count = 0;
+
+	items = (OIndexOidsItem *) palloc(sizeof(OIndexOidsItem) * allocated);
 
-	chunkKey.type = type;
-	chunkKey.oids = oids;
+	chunkKey.type = oIndexInvalid;
+	chunkKey.oids.datoid = 0;
+	chunkKey.oids.reloid = 0;
+	chunkKey.oids.relnode = 0;
 	chunkKey.chunknum = 0;
 
 	it = o_btree_iterator_create(desc, (Pointer) &chunkKey, BTreeKeyBound,
@@ -1244,38 +1309,58 @@ o_indices_foreach_oids(OIndexOidsCallback callback, void *arg)
 
 	tuple = o_btree_iterator_fetch(it, NULL, NULL,
 								   BTreeKeyNone, false, NULL);
-	old_oids = oids;
 	while (!O_TUPLE_IS_NULL(tuple))
 	{
 		OIndexChunk *chunk = (OIndexChunk *) tuple.data;
-		ORelOids	tableOids;
-		bool		temp_table;
-
-		type = chunk->key.type;
-		oids = chunk->key.oids;
-		Assert(chunk->dataLength >= sizeof(tableOids));
-		memcpy(&tableOids, chunk->data, sizeof(tableOids));
-		memcpy(&temp_table, chunk->data + sizeof(tableOids), sizeof(bool));
-		Assert(chunk->key.chunknum == 0);
-		Assert(ORelOidsIsValid(oids));
-		Assert(!ORelOidsIsEqual(old_oids, oids));
-		old_oids = oids;
 
-		callback(type, oids, tableOids, arg);
+		/* Only the first chunk of every tree carries the table oids */
+		if (count > 0 &&
+			items[count - 1].type == chunk->key.type &&
+			ORelOidsIsEqual(items[count - 1].treeOids, chunk->key.oids))
+		{
+			Assert(chunk->key.chunknum > 0);
+			pfree(tuple.data);
+			tuple = o_btree_iterator_fetch(it, NULL, NULL,
+										   BTreeKeyNone, false, NULL);
+			continue;
+		}
 
-		pfree(tuple.data);
-		btree_iterator_free(it);
+		Assert(chunk->key.chunknum == 0);
+		Assert(ORelOidsIsValid(chunk->key.oids));
+		Assert(chunk->dataLength >= sizeof(ORelOids));
 
-		oids.relnode += 1;		/* go to the next oid */
-		chunkKey.oids = oids;
-		chunkKey.type = type;
-		chunkKey.chunknum = 0;
+		if (count >= allocated)
+		{
+			allocated *= 2;
+			items = (OIndexOidsItem *) repalloc(items,
+												sizeof(OIndexOidsItem) * allocated);
+		}
+		items[count].type = chunk->key.type;
+		items[count].treeOids = chunk->key.oids;
+		memcpy(&items[count].tableOids, chunk->data, sizeof(ORelOids));
+		count++;
 
-		it = o_btree_iterator_create(desc, (Pointer) &chunkKey, BTreeKeyBound,
-									 &o_non_deleted_snapshot, ForwardScanDirection);
+		pfree(tuple.data);
 		tuple = o_btree_iterator_fetch(it, NULL, NULL,
 									   BTreeKeyNone, false, NULL);
 	}
+	btree_iterator_free(it);
+
+	*nitems = count;
+	return items;
+}
+
+void
+o_indices_foreach_oids(OIndexOidsCallback callback, void *arg)
+{
+	OIndexOidsItem *items;
+	int			nitems;
+	int			i;
+
+	items = o_indices_collect_oids(&nitems);
+	for (i = 0; i < nitems; i++)
+		callback(items[i].type, items[i].treeOids, items[i].tableOids, arg);
+	pfree(items);
 }
 
 static const char *
@@ -25,6 +25,7 @@
 #include "recovery/wal.h"
 #include "transam/oxid.h"
 #include "tuple/toast.h"
+#include "utils/o_memory.h"
 #include "utils/planner.h"
 
 #include "access/heaptoast.h"
@@ -71,6 +72,31 @@ typedef struct OCacheIdMapEntry
 	OSysCache  *sys_cache;
 } OCacheIdMapEntry;
 
+/*
+ * Catalog tuples built by o_SearchCatCacheInternal_hook() are kept in the
+ * backend-local hash to serve repeated lookups (for instance, per-row enum
+ * lookups) without searching the sys cache and forming the tuple again.
+ * The hash is keyed by the catcache id and hash value of the keys, so
+ * orioledb_syscache_hook() invalidates it together with the fastcache.
+ */
+typedef struct
+{
+	int			cacheId;
+	OSysCacheHashKey hashValue;
+} OHookTupleCacheKey;
+
+typedef struct
+{
+	Oid			datoid;
+	CatCTup    *ct;
+} OHookTupleCacheItem;
+
+typedef struct
+{
+	OHookTupleCacheKey key;
+	List	   *items;			/* OHookTupleCacheItem list */
+} OHookTupleCacheEntry;
+
 static Pointer o_sys_cache_get_from_tree(OSysCache *sys_cache,
 										 int nkeys,
 										 OSysCacheKey *key);
@@ -118,6 +144,7 @@ Oid			o_sys_cache_search_datoid = InvalidOid;
 static MemoryContext sys_cache_cxt = NULL;
 static HTAB *sys_cache_fastcache;
 static HTAB *sys_caches;
+static HTAB *hook_tuple_cache = NULL;
 
 static ResourceOwner my_owner = NULL;
 static Oid	save_userid;
@@ -132,9 +159,10 @@ o_sys_caches_init(void)
 {
 	HASHCTL		ctl;
 
-	sys_cache_cxt = AllocSetContextCreate(TopMemoryContext,
+	sys_cache_cxt = AllocSetContextCreate(OrioleDBTopMemoryContext,
 										  "OrioleDB sys_caches fastcache context",
 										  ALLOCSET_DEFAULT_SIZES);
+	o_memory_register(OMemorySysCaches, sys_cache_cxt);
 
 	MemSet(&ctl, 0, sizeof(ctl));
 	ctl.keysize = sizeof(OSysCacheHashKey);
@@ -151,6 +179,14 @@ o_sys_caches_init(void)
 	sys_caches = hash_create("OrioleDB sys_tree_num to sys_cache map", 8, &ctl,
 							 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
 
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(OHookTupleCacheKey);
+	ctl.entrysize = sizeof(OHookTupleCacheEntry);
+	ctl.hcxt = sys_cache_cxt;
+	hook_tuple_cache = hash_create("OrioleDB sys_caches hook tuple cache", 8,
+								   &ctl,
+								   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
 	o_aggregate_cache_init(sys_cache_cxt, sys_cache_fastcache);
 	o_amop_cache_init(sys_cache_cxt, sys_cache_fastcache);
 	o_amop_strat_cache_init(sys_cache_cxt, sys_cache_fastcache);
@@ -397,11 +433,65 @@ invalidate_fastcache_entry(int cacheid, uint32 hashvalue)
 	}
 }
 
+/*
+ * Removes the hook tuple cache entry.  The tuples still referenced are left
+ * to their holders: ReleaseCatCache() can't free them, because they aren't
+ * linked to the catcache.
+ */
+static void
+remove_hook_tuple_cache_entry(OHookTupleCacheEntry *entry)
+{
+	ListCell   *lc;
+
+	foreach(lc, entry->items)
+	{
+		OHookTupleCacheItem *item = (OHookTupleCacheItem *) lfirst(lc);
+
+		if (item->ct->refcount == 0)
+			pfree(item->ct);
+	}
+	list_free_deep(entry->items);
+	hash_search(hook_tuple_cache, &entry->key, HASH_REMOVE, NULL);
+}
+
+static void
+invalidate_hook_tuple_cache(int cacheid, uint32 hashvalue)
+{
+	OHookTupleCacheEntry *entry;
+
+	/* Zero hash value means the whole catcache reset */
+	if (hashvalue == 0)
+	{
+		HASH_SEQ_STATUS hash_seq;
+
+		hash_seq_init(&hash_seq, hook_tuple_cache);
+		while ((entry = (OHookTupleCacheEntry *) hash_seq_search(&hash_seq)) != NULL)
+		{
+			if (entry->key.cacheId == cacheid)
+				remove_hook_tuple_cache_entry(entry);
+		}
+	}
+	else
+	{
+		OHookTupleCacheKey key;
+
+		memset(&key, 0, sizeof(key));
+		key.cacheId = cacheid;
+		key.hashValue = hashvalue;
+		entry = (OHookTupleCacheEntry *) hash_search(hook_tuple_cache, &key,
+													 HASH_FIND, NULL);
+		if (entry)
+			remove_hook_tuple_cache_entry(entry);
+	}
+}
+
 static void
 orioledb_syscache_hook(Datum arg, int cacheid, uint32 hashvalue)
 {
 	if (sys_cache_fastcache)
 		invalidate_fastcache_entry(cacheid, hashvalue);
+	if (hook_tuple_cache)
+		invalidate_hook_tuple_cache(cacheid, hashvalue);
 }
 
 void
@@ -716,7 +806,7 @@ o_sys_cache_add(OSysCache *sys_cache, OSysCacheKey *key, Pointer entry)
 
 		tup.formatFlags = 0;
 		tup.data = entry;
-		inserted = o_btree_autonomous_insert(desc, tup);
+		inserted = o_btree_batched_autonomous_insert(desc, tup);
 	}
 	else
 	{
@@ -731,7 +821,7 @@ o_sys_cache_add(OSysCache *sys_cache, OSysCacheKey *key, Pointer entry)
 
 		data = sys_cache->funcs->toast_serialize_entry(entry, &len);
 
-		start_autonomous_transaction(&state);
+		start_batched_autonomous_transaction(&state);
 		PG_TRY();
 		{
 			inserted = generic_toast_insert(&oSysCacheToastAPI,
@@ -815,7 +905,7 @@ o_sys_cache_update(OSysCache *sys_cache, Pointer updated_entry)
 		tup.formatFlags = 0;
 		tup.data = updated_entry;
 
-		start_autonomous_transaction(&state);
+		start_batched_autonomous_transaction(&state);
 		PG_TRY();
 		{
 			result = o_btree_modify(desc, BTreeOperationUpdate,
@@ -850,7 +940,7 @@ o_sys_cache_update(OSysCache *sys_cache, Pointer updated_entry)
 
 		data = sys_cache->funcs->toast_serialize_entry(updated_entry, &len);
 
-		start_autonomous_transaction(&state);
+		start_batched_autonomous_transaction(&state);
 		PG_TRY();
 		{
 			result = generic_toast_update(&oSysCacheToastAPI,
@@ -1107,6 +1197,24 @@ o_sys_cache_delete_by_lsn(OSysCache *sys_cache, XLogRecPtr lsn)
 	btree_iterator_free(it);
 }
 
+/*
+ * Drops all the fastcache entries of the backend.  Callers must be ready to
+ * the entries invalidation as well as for the syscache invalidation.
+ */
+void
+o_sys_caches_reset(void)
+{
+	HASH_SEQ_STATUS hash_seq;
+	OSysCacheHashEntry *entry;
+
+	if (!sys_cache_fastcache)
+		return;
+
+	hash_seq_init(&hash_seq, sys_cache_fastcache);
+	while ((entry = (OSysCacheHashEntry *) hash_seq_search(&hash_seq)) != NULL)
+		invalidate_fastcache_entry(-1, entry->key);
+}
+
 void
 o_sys_caches_delete_by_lsn(XLogRecPtr checkPointRedo)
 {
@@ -1551,6 +1659,85 @@ heap_to_catctup(CatCache *cache, TupleDesc cc_tupdesc, HeapTuple tuple,
 	return ct;
 }
 
+/*
+ * Looks for the tuple previously built by o_SearchCatCacheInternal_hook() in
+ * the hook tuple cache.  Fills *cacheKey and *datoid for the following
+ * o_hook_tuple_cache_add().  Returns false if the cache isn't backed by
+ * OrioleDB sys cache.
+ */
+static bool
+o_hook_tuple_cache_lookup(CatCache *cache, int nkeys, OSysCacheKey4 *key,
+						  OHookTupleCacheKey *cacheKey, Oid *datoid,
+						  CatCTup **result)
+{
+	OCacheIdMapEntry *mapEntry;
+	OHookTupleCacheEntry *entry;
+	ListCell   *lc;
+
+	*result = NULL;
+	if (!hook_tuple_cache)
+		return false;
+
+	mapEntry = hash_search(sys_caches, &cache->id, HASH_FIND, NULL);
+	if (!mapEntry)
+		return false;
+
+	memset(cacheKey, 0, sizeof(*cacheKey));
+	cacheKey->cacheId = cache->id;
+	cacheKey->hashValue = compute_hash_value(mapEntry->sys_cache->cc_hashfunc,
+											 nkeys, (OSysCacheKey *) key);
+	o_sys_cache_set_datoid_lsn(NULL, datoid);
+
+	entry = (OHookTupleCacheEntry *) hash_search(hook_tuple_cache, cacheKey,
+												 HASH_FIND, NULL);
+	if (!entry)
+		return true;
+
+	foreach(lc, entry->items)
+	{
+		OHookTupleCacheItem *item = (OHookTupleCacheItem *) lfirst(lc);
+		OSysCacheKey4 ctKey = {0};
+
+		if (item->datoid != *datoid)
+			continue;
+
+		memcpy(ctKey.keys, item->ct->keys, sizeof(Datum) * nkeys);
+		if (o_sys_cache_key_cmp(mapEntry->sys_cache, nkeys,
+								(OSysCacheKey *) &ctKey,
+								(OSysCacheKey *) key) == 0)
+		{
+			ResourceOwnerEnlargeCatCacheRefs(CurrentResourceOwner);
+			item->ct->refcount++;
+			ResourceOwnerRememberCatCacheRef(CurrentResourceOwner,
+											 &item->ct->tuple);
+			*result = item->ct;
+			break;
+		}
+	}
+	return true;
+}
+
+static void
+o_hook_tuple_cache_add(OHookTupleCacheKey *cacheKey, Oid datoid, CatCTup *ct)
+{
+	OHookTupleCacheEntry *entry;
+	OHookTupleCacheItem *item;
+	MemoryContext prev_context;
+	bool		found;
+
+	entry = (OHookTupleCacheEntry *) hash_search(hook_tuple_cache, cacheKey,
+												 HASH_ENTER, &found);
+	if (!found)
+		entry->items = NIL;
+
+	prev_context = MemoryContextSwitchTo(sys_cache_cxt);
+	item = palloc(sizeof(OHookTupleCacheItem));
+	item->datoid = datoid;
+	item->ct = ct;
+	entry->items = lappend(entry->items, item);
+	MemoryContextSwitchTo(prev_context);
+}
+
 static CatCTup *
 o_SearchCatCacheInternal_hook(CatCache *cache, int nkeys, Datum v1, Datum v2,
 							  Datum v3, Datum v4)
@@ -1558,6 +1745,15 @@ o_SearchCatCacheInternal_hook(CatCache *cache, int nkeys, Datum v1, Datum v2,
 	CatCTup    *result = NULL;
 	TupleDesc	tupdesc = NULL;
 	HeapTuple	hook_tuple = NULL;
+	OSysCacheKey4 key = {.keys = {v1, v2, v3, v4}};
+	OHookTupleCacheKey cacheKey;
+	Oid			datoid = InvalidOid;
+	bool		cacheable;
+
+	cacheable = o_hook_tuple_cache_lookup(cache, nkeys, &key, &cacheKey,
+										  &datoid, &result);
+	if (result)
+		return result;
 
 	switch (cache->cc_indexoid)
 	{
@@ -1692,7 +1888,7 @@ o_SearchCatCacheInternal_hook(CatCache *cache, int nkeys, Datum v1, Datum v2,
 				Name		enumlabel;
 
 				enumtypid = DatumGetObjectId(v1);
-				enumlabel = DatumGetName(v1);
+				enumlabel = DatumGetName(v2);
 
 				Assert(tupdesc);
 
@@ -1773,7 +1969,11 @@ o_SearchCatCacheInternal_hook(CatCache *cache, int nkeys, Datum v1, Datum v2,
 	}
 
 	if (hook_tuple)
+	{
 		result = heap_to_catctup(cache, tupdesc, hook_tuple, true);
+		if (cacheable)
+			o_hook_tuple_cache_add(&cacheKey, datoid, result);
+	}
 
 	if (tupdesc && tupdesc != cache->cc_tupdesc)
 		FreeTupleDesc(tupdesc);
@@ -26,6 +26,7 @@
 #include "tableam/operations.h"
 #include "transam/oxid.h"
 #include "tuple/toast.h"
+#include "utils/compress.h"
 #include "utils/planner.h"
 
 #include "access/heapam.h"
@@ -249,50 +250,63 @@ ToastAPI	oTablesToastAPI = {
 	.versionCallback = oTablesVersionCallback
 };
 
+/*
+ * Iterates the oids of the tables visible to oSnapshot.  The oids are
+ * collected in a single pass of SYS_TREES_O_TABLES skipping the further chunks
+ * and versions of the same table, then the callback is called for each of
+ * them.  So, the callback is free to modify the system tree.
+ */
 void
 o_tables_foreach_oids(OTablesOidsCallback callback,
 					  OSnapshot *oSnapshot,
 					  void *arg)
 {
 	OTableChunkKey chunk_key;
-	ORelOids	oids = {0, 0, 0},
-				old_oids PG_USED_FOR_ASSERTS_ONLY;
 	BTreeIterator *it;
 	OTuple		tuple;
 	BTreeDescr *desc = get_sys_tree(SYS_TREES_O_TABLES);
+	ORelOids   *oids;
+	int			allocated = 64;
+	int			count = 0;
+	int			i;
 
-	chunk_key.oids = oids;
+	oids = (ORelOids *) palloc(sizeof(ORelOids) * allocated);
+
+	chunk_key.oids.datoid = 0;
+	chunk_key.oids.reloid = 0;
+	chunk_key.oids.relnode = 0;
 	chunk_key.chunknum = 0;
+	chunk_key.version = 0;
 
 	it = o_btree_iterator_create(desc, (Pointer) &chunk_key, BTreeKeyBound,
 								 oSnapshot, ForwardScanDirection);
 
 	tuple = o_btree_iterator_fetch(it, NULL, NULL,
 								   BTreeKeyNone, false, NULL);
-	old_oids = oids;
 	while (!O_TUPLE_IS_NULL(tuple))
 	{
 		OTableChunk *chunk = (OTableChunk *) tuple.data;
 
-		oids = chunk->key.oids;
-		Assert(ORelOidsIsValid(oids));
-		Assert(!ORelOidsIsEqual(old_oids, oids));
-		old_oids = oids;
-
-		callback(oids, arg);
+		Assert(ORelOidsIsValid(chunk->key.oids));
+		if (count == 0 || !ORelOidsIsEqual(oids[count - 1], chunk->key.oids))
+		{
+			if (count >= allocated)
+			{
+				allocated *= 2;
+				oids = (ORelOids *) repalloc(oids, sizeof(ORelOids) * allocated);
+			}
+			oids[count++] = chunk->key.oids;
+		}
 
 		pfree(tuple.data);
-		btree_iterator_free(it);
-
-		oids.relnode += 1;		/* go to the next oid */
-		chunk_key.oids = oids;
-		chunk_key.chunknum = 0;
-
-		it = o_btree_iterator_create(desc, (Pointer) &chunk_key, BTreeKeyBound,
-									 oSnapshot, ForwardScanDirection);
 		tuple = o_btree_iterator_fetch(it, NULL, NULL,
 									   BTreeKeyNone, false, NULL);
 	}
+	btree_iterator_free(it);
+
+	for (i = 0; i < count; i++)
+		callback(oids[i], arg);
+	pfree(oids);
 }
 
 /*
@@ -1366,10 +1380,10 @@ describe_table(ORelOids oids)
 	}
 
 	initStringInfo(&title);
-	appendStringInfo(&title, "Compress = %d, Primary compress = %d, TOAST compress = %d\n",
-					 table->default_compress,
-					 table->primary_compress,
-					 table->toast_compress);
+	appendStringInfo(&title, "Compress = %s, Primary compress = %s, TOAST compress = %s\n",
+					 o_compress_to_cstring(table->default_compress),
+					 o_compress_to_cstring(table->primary_compress),
+					 o_compress_to_cstring(table->toast_compress));
 	appendStringInfo(&title, " %%%ds | %%%ds | %%%ds | Nullable | Droped ",
 					 max_column_str,
 					 max_type_str,
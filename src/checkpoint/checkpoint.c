@@ -22,6 +22,7 @@
 
 #include "orioledb.h"
 
+#include "btree/device.h"
 #include "btree/insert.h"
 #include "btree/io.h"
 #include "btree/iterator.h"
@@ -29,6 +30,7 @@
 #include "btree/modify.h"
 #include "btree/page_chunks.h"
 #include "btree/undo.h"
+#include "btree/uring.h"
 #include "catalog/free_extents.h"
 #include "catalog/o_indices.h"
 #include "catalog/o_tables.h"
@@ -44,23 +46,37 @@
 #include "tableam/toast.h"
 #include "transam/oxid.h"
 #include "transam/undo.h"
+#include "utils/compress.h"
+#include "utils/extent_sort.h"
+#include "utils/o_memory.h"
 #include "utils/page_pool.h"
+#include "utils/probes.h"
 #include "utils/seq_buf.h"
 #include "utils/stopevent.h"
+#include "utils/tree_stats.h"
 #include "utils/ucm.h"
+#include "workers/compactor.h"
+#include "workers/compress_worker.h"
+#include "workers/prewarm.h"
+#include "workers/sync_worker.h"
 
+#include "access/htup_details.h"
 #include "access/xlog_internal.h"
 #include "access/xlogarchive.h"
 #include "catalog/pg_database.h"
 #include "common/hashfn.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "postmaster/bgwriter.h"
 #include "storage/bufmgr.h"
+#include "storage/latch.h"
 #include "storage/proc.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
 
 /*
  * Single action in B-tree checkpoint loop.
@@ -108,6 +124,8 @@ typedef struct WalkMessage
 typedef struct CheckpointWriteBack
 {
 	bool		isCompressed;
+	/* extents below this offset are reused free extents */
+	uint64		reuseLimit;
 	int			extentsNumber;
 	int			extentsAllocated;
 	int			checkpointFlags;
@@ -154,6 +172,8 @@ typedef struct
 	bool		lock;			/* true for lock, false for unlock */
 } SysTreesLockUndoStackItem;
 
+PG_FUNCTION_INFO_V1(orioledb_checkpoint_stats);
+
 CheckpointState *checkpoint_state = NULL;
 MemoryContext chkp_main_context = NULL;
 MemoryContext chkp_tree_context = NULL;
@@ -161,19 +181,38 @@ MemoryContext chkp_tree_context = NULL;
 static char *xidFilename = NULL;
 static uint32 xidFileCheckpointnum = 0;
 static File xidFile = -1;
+/* the checkpointer is between start_write_xids() and close_xids_file() */
+static bool xids_queue_active = false;
+
+/* Trees written by the current checkpoint with their xmins */
+static CheckpointTreeXmin *chkpTreeXmins = NULL;
+static int	chkpTreeXminsCount = 0;
+static int	chkpTreeXminsAllocated = 0;
 static S3TaskLocation maxLocation = 0;
 
+/*
+ * Statistics of the current checkpoint.  Also gives the write rate to
+ * checkpoint_write_delay().
+ */
+static CheckpointStats chkp_stats = {0};
+
+static inline void
+checkpoint_phase_finish(CheckpointPhase phase, TimestampTz start_time)
+{
+	chkp_stats.phaseTime[phase] += GetCurrentTimestamp() - start_time;
+}
+
 static void init_writeback(CheckpointWriteBack *writeback, int flags, bool isCompressed);
 static void writeback_put_extent(CheckpointWriteBack *writeback, FileExtent *extent);
 static void perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback);
 static void free_writeback(CheckpointWriteBack *writeback);
+static void checkpoint_stats_publish(bool finished);
+static void drain_xids_queue(void);
 
 static uint64 append_file_contents(File target, char *source_filename, uint64 offset);
 static uint64 finalize_chkp_map(File chkp_file, uint64 len,
 								char *input_filename, uint64 input_offset,
 								uint32 input_num);
-static int	uint32_offsets_cmp(const void *a, const void *b);
-static int	file_extents_len_off_cmp(const void *a, const void *b);
 static int	file_extents_off_len_cmp(const void *a, const void *b);
 static int	file_extents_writeback_cmp(const void *a, const void *b);
 
@@ -196,6 +235,7 @@ static void checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
 									 CheckpointWriteBack *writeback,
 									 int level, WalkMessage *message);
 static void prepare_leaf_page(BTreeDescr *descr, CheckpointState *state);
+static bool checkpoint_clean_child_downlink(uint64 *downlink);
 static void checkpoint_lock_page(BTreeDescr *descr, CheckpointState *state,
 								 OInMemoryBlkno *blkno, uint32 page_chage_count,
 								 int level);
@@ -255,6 +295,7 @@ checkpoint_shmem_init(Pointer ptr, bool found)
 		CheckpointControl control;
 
 		memset(checkpoint_state, 0, sizeof(*checkpoint_state));
+		SpinLockInit(&checkpoint_state->statsLock);
 		checkpoint_state->curKeyType = CurKeyFinished;
 		checkpoint_state->pid = InvalidPid;
 		pg_atomic_init_u64(&checkpoint_state->mmapDataLength, 0);
@@ -389,6 +430,7 @@ static void
 init_writeback(CheckpointWriteBack *writeback, int flags, bool isCompressed)
 {
 	writeback->isCompressed = isCompressed;
+	writeback->reuseLimit = 0;
 	writeback->checkpointFlags = flags;
 	writeback->extentsNumber = 0;
 	writeback->extentsAllocated = 16;
@@ -408,6 +450,11 @@ writeback_put_extent(CheckpointWriteBack *writeback, FileExtent *extent)
 													 sizeof(FileExtent) * writeback->extentsAllocated);
 	}
 	writeback->extents[writeback->extentsNumber] = *extent;
+	chkp_stats.pagesWritten++;
+	if (extent->off < writeback->reuseLimit)
+		chkp_stats.pagesReused++;
+	if (writeback->isCompressed)
+		chkp_stats.pagesCompressed++;
 	if (orioledb_s3_mode)
 		writeback->extents[writeback->extentsNumber].off &= S3_OFFSET_MASK;
 	if (!writeback->isCompressed && use_device)
@@ -415,6 +462,59 @@ writeback_put_extent(CheckpointWriteBack *writeback, FileExtent *extent)
 	writeback->extentsNumber++;
 }
 
+/*
+ * Paces the checkpoint writes.  The progress against the PostgreSQL
+ * checkpoint schedule, which accounts both the elapsed time and the WAL
+ * generated since the checkpoint start, decides whether to sleep.  The
+ * optional write rate bounds override it: below the minimum rate we don't
+ * sleep, above the maximum rate we sleep until the average rate drops.
+ */
+static void
+checkpoint_write_delay(int flags, double progress)
+{
+	double		elapsed,
+				written;
+
+	drain_xids_queue();
+
+	if (checkpoint_min_write_rate > 0 || checkpoint_max_write_rate > 0)
+	{
+		elapsed = (double) (GetCurrentTimestamp() - chkp_stats.startTime) / 1000000.0;
+		written = (double) chkp_stats.bytesWritten / (1024.0 * 1024.0);
+
+		if (checkpoint_max_write_rate > 0 && AmCheckpointerProcess() &&
+			!(flags & CHECKPOINT_IMMEDIATE) &&
+			written > elapsed * checkpoint_max_write_rate)
+		{
+			long		delay_ms;
+
+			delay_ms = (long) ((written / checkpoint_max_write_rate - elapsed) * 1000.0);
+			delay_ms = Min(delay_ms, 100);
+			if (delay_ms > 0)
+			{
+				(void) WaitLatch(MyLatch,
+								 WL_LATCH_SET | WL_EXIT_ON_PM_DEATH | WL_TIMEOUT,
+								 delay_ms,
+								 WAIT_EVENT_CHECKPOINT_WRITE_DELAY);
+				ResetLatch(MyLatch);
+			}
+			/* Zero progress is never on schedule: only absorb the requests */
+			CheckpointWriteDelay(flags, 0.0);
+			return;
+		}
+
+		if (checkpoint_min_write_rate > 0 &&
+			written < elapsed * checkpoint_min_write_rate)
+		{
+			CheckpointWriteDelay(flags, 0.0);
+			return;
+		}
+	}
+
+	if (progress < 1.0)
+		CheckpointWriteDelay(flags, progress * o_checkpoint_completion_ratio);
+}
+
 static void
 perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback)
 {
@@ -424,6 +524,7 @@ perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback)
 	double		progress = 0.0;
 	uint		blcksz = (writeback->isCompressed || use_mmap) ? ORIOLEDB_COMP_BLCKSZ : ORIOLEDB_BLCKSZ;
 	uint32		chkpNum = checkpoint_state->lastCheckpointNumber + 1;
+	TimestampTz start_time;
 
 	if (use_device && !use_mmap)
 	{
@@ -431,9 +532,20 @@ perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback)
 		return;
 	}
 
+	start_time = GetCurrentTimestamp();
+
 	pg_qsort(writeback->extents, writeback->extentsNumber,
 			 sizeof(FileExtent), file_extents_writeback_cmp);
 
+	/*
+	 * The pages dirtied after the checkpoint start extend the remaining work.
+	 * Keep the estimate up to date, so we don't fall behind under the write
+	 * load.
+	 */
+	checkpoint_state->dirtyPagesEstimate = Max(checkpoint_state->dirtyPagesEstimate,
+											   (double) (checkpoint_state->pagesWritten +
+														 get_dirty_pages_count_sum()));
+
 	for (i = 0; i < writeback->extentsNumber; i++)
 	{
 		if (i > 0 && writeback->extents[i].off == writeback->extents[i - 1].off)
@@ -456,16 +568,10 @@ perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback)
 			len = writeback->extents[i].len;
 		}
 
-		if (progress < 1.0)
-		{
-			progress = (double) (checkpoint_state->pagesWritten + (uint64) i)
-				/ (double) checkpoint_state->dirtyPagesEstimate;
-			if (progress < 1.0)
-			{
-				progress *= o_checkpoint_completion_ratio;
-				CheckpointWriteDelay(writeback->checkpointFlags, progress);
-			}
-		}
+		chkp_stats.bytesWritten += (uint64) writeback->extents[i].len * blcksz;
+		progress = (double) (checkpoint_state->pagesWritten + (uint64) i)
+			/ (double) checkpoint_state->dirtyPagesEstimate;
+		checkpoint_write_delay(writeback->checkpointFlags, progress);
 	}
 
 	if (len > 0)
@@ -474,6 +580,9 @@ perform_writeback(BTreeDescr *desc, CheckpointWriteBack *writeback)
 							 (off_t) len * (off_t) blcksz);
 	checkpoint_state->pagesWritten += writeback->extentsNumber;
 	writeback->extentsNumber = 0;
+
+	checkpoint_phase_finish(CheckpointPhaseWriteback, start_time);
+	checkpoint_stats_publish(false);
 }
 
 static BTreeDescr *
@@ -591,6 +700,70 @@ unlink_xids_file(uint32 checkpointnum)
 	pfree(xip_filename);
 }
 
+static void
+add_tree_xmin(ORelOids oids, OXid xmin)
+{
+	/* Standby doesn't track the xmin of the replayed transactions */
+	if (orioledb_s3_mode || RecoveryInProgress())
+		return;
+
+	if (chkpTreeXminsCount >= chkpTreeXminsAllocated)
+	{
+		chkpTreeXminsAllocated = Max(chkpTreeXminsAllocated * 2, 64);
+		if (chkpTreeXmins == NULL)
+			chkpTreeXmins = MemoryContextAlloc(TopMemoryContext,
+											   sizeof(CheckpointTreeXmin) * chkpTreeXminsAllocated);
+		else
+			chkpTreeXmins = repalloc(chkpTreeXmins,
+									 sizeof(CheckpointTreeXmin) * chkpTreeXminsAllocated);
+	}
+	chkpTreeXmins[chkpTreeXminsCount].oids = oids;
+	chkpTreeXmins[chkpTreeXminsCount].xmin = xmin;
+	chkpTreeXminsCount++;
+}
+
+/*
+ * Writes the xmins of the trees written by the checkpoint.  Recovery skips
+ * the changes to the tree made by the transactions older than its xmin.
+ */
+static void
+write_tree_xmins_file(uint32 checkpointnum)
+{
+	char	   *filename = psprintf(TREE_XMINS_FILENAME_FORMAT, checkpointnum);
+	File		file;
+	uint32		count = chkpTreeXminsCount;
+	int			size = sizeof(CheckpointTreeXmin) * chkpTreeXminsCount;
+
+	file = PathNameOpenFile(filename, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (file < 0)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not open tree xmins file %s: %m", filename)));
+
+	if (OFileWrite(file, (Pointer) &count, sizeof(count), 0,
+				   WAIT_EVENT_SLRU_WRITE) != sizeof(count) ||
+		(size > 0 &&
+		 OFileWrite(file, (Pointer) chkpTreeXmins, size, sizeof(count),
+					WAIT_EVENT_SLRU_WRITE) != size))
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not write tree xmins file %s: %m", filename)));
+
+	if (FileSync(file, WAIT_EVENT_SLRU_SYNC) < 0)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not sync tree xmins file %s: %m", filename)));
+
+	FileClose(file);
+	pfree(filename);
+}
+
+static void
+unlink_tree_xmins_file(uint32 checkpointnum)
+{
+	char	   *filename = psprintf(TREE_XMINS_FILENAME_FORMAT, checkpointnum);
+
+	unlink(filename);
+	pfree(filename);
+}
+
 /*
  * Open xids file corresponding to the current checkpoint.
  */
@@ -692,6 +865,37 @@ try_flush_xids_queue(void)
 	}
 }
 
+/*
+ * Called by the checkpointer during the walk.  Flushes the xids queue in
+ * batches before it's full, so the committing backends don't have to flush
+ * it themselves and don't wait for the checkpoint progress.
+ */
+static void
+drain_xids_queue(void)
+{
+	uint64		lastPos,
+				flushPos;
+
+	if (!xids_queue_active)
+		return;
+
+	lastPos = pg_atomic_read_u64(&checkpoint_state->xidRecLastPos);
+	flushPos = pg_atomic_read_u64(&checkpoint_state->xidRecFlushPos);
+	if (lastPos - flushPos >= XID_RECS_QUEUE_SIZE / 4)
+		try_flush_xids_queue();
+}
+
+/*
+ * Called on error cleanup.  The checkpoint interrupted by an error doesn't
+ * reach close_xids_file(), so the walk of the next one mustn't drain the
+ * queue before start_write_xids().
+ */
+void
+checkpoint_error_cleanup(void)
+{
+	xids_queue_active = false;
+}
+
 /*
  * Write single xid record to queue.
  */
@@ -1111,15 +1315,19 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 				checkpoint_end_loc[NUM_CHECKPOINTABLE_UNDO_LOGS];
 	OXid		checkpoint_xmin,
 				checkpoint_xmax;
+	TimestampTz phase_start;
+	OIndexOidsItem *trees;
+	int			ntrees;
 	int			i;
 
 	orioledb_check_shmem();
 
 	if (chkp_main_context == NULL)
 	{
-		chkp_main_context = AllocSetContextCreate(TopMemoryContext,
+		chkp_main_context = AllocSetContextCreate(OrioleDBTopMemoryContext,
 												  "OrioleDB checkpoint context",
 												  ALLOCSET_DEFAULT_SIZES);
+		o_memory_register(OMemoryCheckpoint, chkp_main_context);
 		chkp_tree_context = AllocSetContextCreate(chkp_main_context,
 												  "OrioleDB single tree context",
 												  ALLOCSET_DEFAULT_SIZES);
@@ -1156,7 +1364,14 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	checkpoint_state->dirtyPagesEstimate *= (1.0 + CheckPointCompletionTarget
 											 * o_checkpoint_completion_ratio);
 	checkpoint_state->pagesWritten = 0;
+	memset(&chkp_stats, 0, sizeof(chkp_stats));
+	chkp_stats.checkpointNumber = cur_chkp_num;
+	chkp_stats.inProgress = true;
+	chkp_stats.flags = flags;
+	chkp_stats.startTime = GetCurrentTimestamp();
+	checkpoint_stats_publish(false);
 	checkpoint_state->toastConsistentPtr = InvalidXLogRecPtr;
+	chkpTreeXminsCount = 0;
 
 	old_enable_stopevents = enable_stopevents;
 
@@ -1173,6 +1388,7 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 		UndoMeta   *undo_meta = get_undo_meta_by_type(undoType);
 
 		checkpoint_start_loc[i] = pg_atomic_read_u64(&undo_meta->minProcTransactionRetainLocation);
+		my_proc_info->undoRetainLocations[undoType].snapshotRetainTime = GetCurrentTimestamp();
 		pg_atomic_write_u64(&my_proc_info->undoRetainLocations[undoType].snapshotRetainUndoLocation,
 							checkpoint_start_loc[i]);
 	}
@@ -1183,14 +1399,19 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	wait_finish_active_commits(checkpoint_state->replayStartPtr);
 
 	LWLockAcquire(&checkpoint_state->oXidQueueLock, LW_EXCLUSIVE);
+	phase_start = GetCurrentTimestamp();
 	before_writing_xids_file(cur_chkp_num);
 	start_write_xids(cur_chkp_num);
+	xids_queue_active = true;
+	checkpoint_phase_finish(CheckpointPhaseXidsFile, phase_start);
 
 
 	LWLockAcquire(&checkpoint_state->oTablesMetaLock, LW_EXCLUSIVE);
 	LWLockAcquire(&checkpoint_state->oSysTreesLock, LW_EXCLUSIVE);
 
+	phase_start = GetCurrentTimestamp();
 	checkpoint_sys_trees(flags, cur_chkp_num, &chkp_tbl_arg);
+	checkpoint_phase_finish(CheckpointPhaseSysTrees, phase_start);
 
 	/*
 	 * We get start position for replay changes to system trees while holding
@@ -1204,12 +1425,24 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 
 	enable_stopevents = old_enable_stopevents;
 
+	/*
+	 * Collect the trees once: the same array gives the total for the
+	 * statistics and drives the checkpointing of the trees.
+	 */
 	LWLockAcquire(&checkpoint_state->oTablesMetaLock, LW_EXCLUSIVE);
-	o_indices_foreach_oids(checkpoint_tables_callback, &chkp_tbl_arg);
+	trees = o_indices_collect_oids(&ntrees);
+	chkp_stats.treesTotal += ntrees;
+	checkpoint_stats_publish(false);
+	for (i = 0; i < ntrees; i++)
+		checkpoint_tables_callback(trees[i].type, trees[i].treeOids,
+								   trees[i].tableOids, &chkp_tbl_arg);
+	pfree(trees);
 
 	LWLockRelease(&checkpoint_state->oTablesMetaLock);
 
+	phase_start = GetCurrentTimestamp();
 	checkpoint_chkp_nums(flags, cur_chkp_num, &chkp_tbl_arg);
+	checkpoint_phase_finish(CheckpointPhaseSysTrees, phase_start);
 
 	/*
 	 * It might happen there is no secondary indices, but we still need to set
@@ -1218,8 +1451,13 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	if (XLogRecPtrIsInvalid(checkpoint_state->toastConsistentPtr))
 		checkpoint_state->toastConsistentPtr = GetXLogInsertRecPtr();
 
+	phase_start = GetCurrentTimestamp();
+	xids_queue_active = false;
 	finish_write_xids(cur_chkp_num);
 	close_xids_file();
+	if (!orioledb_s3_mode)
+		write_tree_xmins_file(cur_chkp_num);
+	checkpoint_phase_finish(CheckpointPhaseXidsFile, phase_start);
 	LWLockRelease(&checkpoint_state->oXidQueueLock);
 
 	for (i = 0; i < NUM_CHECKPOINTABLE_UNDO_LOGS; i++)
@@ -1231,8 +1469,9 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	}
 	checkpoint_xmax = pg_atomic_read_u64(&xid_meta->nextXid);
 
+	phase_start = GetCurrentTimestamp();
 	if (use_mmap)
-		msync(mmap_data, device_length, MS_SYNC);
+		o_devices_sync();
 
 	for (i = 0; i < NUM_CHECKPOINTABLE_UNDO_LOGS; i++)
 	{
@@ -1264,6 +1503,10 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 					   checkpoint_xmax,
 					   WAIT_EVENT_DATA_FILE_IMMEDIATE_SYNC);
 
+	/* The data files of all the trees must be durable before the control */
+	sync_workers_wait_all();
+	checkpoint_phase_finish(CheckpointPhaseFsync, phase_start);
+
 	if (checkpoint_state->controlIdentifier == 0)
 	{
 		struct timeval tv;
@@ -1286,7 +1529,7 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	control.sysTreesStartPtr = checkpoint_state->sysTreesStartPtr;
 	control.replayStartPtr = checkpoint_state->replayStartPtr;
 	control.toastConsistentPtr = checkpoint_state->toastConsistentPtr;
-	control.mmapDataLength = pg_atomic_read_u64(&checkpoint_state->mmapDataLength);
+	control.mmapDataLength = o_devices_data_length();
 	for (i = 0; i < NUM_CHECKPOINTABLE_UNDO_LOGS; i++)
 	{
 		UndoLogType undoType = GetCheckpointableUndoLog(i);
@@ -1433,15 +1676,36 @@ o_perform_checkpoint(XLogRecPtr redo_pos, int flags)
 	list_free_deep(chkp_tbl_arg.postProcessList);
 
 	if (remove_old_checkpoint_files)
+	{
 		unlink_xids_file(prev_chkp_num);
+		unlink_tree_xmins_file(prev_chkp_num);
+	}
 
 	CheckPointProgress = o_checkpoint_completion_ratio;
 
+	chkp_stats.inProgress = false;
+	chkp_stats.endTime = GetCurrentTimestamp();
+	chkp_stats.treeType = oIndexInvalid;
+	memset(&chkp_stats.treeOids, 0, sizeof(chkp_stats.treeOids));
+	checkpoint_stats_publish(true);
+
+	/*
+	 * The checkpointer doesn't end transactions, which flush the stats and
+	 * report the memory usage.
+	 */
+	tree_stats_flush();
+	o_memory_report();
+
 	o_unset_syscache_hooks();
 
 	elog(LOG, "orioledb checkpoint %u complete",
 		 checkpoint_state->lastCheckpointNumber);
 
+	if (enable_prewarm)
+		(void) prewarm_dump_hot_pages();
+	if (replica_prewarm && XLogIsNeeded() && !RecoveryInProgress())
+		(void) prewarm_log_hot_pages();
+
 	if (orioledb_s3_mode)
 		s3_perform_backup(flags, maxLocation);
 
@@ -1628,6 +1892,7 @@ void
 o_after_checkpoint_cleanup_hook(XLogRecPtr checkPointRedo, int flags)
 {
 	S3TaskLocation maxLocation = 0;
+	S3TaskLocation walLocation = 0;
 	S3TaskLocation location;
 	uint32		chkpNum = checkpoint_state->lastCheckpointNumber;
 
@@ -1665,8 +1930,7 @@ o_after_checkpoint_cleanup_hook(XLogRecPtr checkPointRedo, int flags)
 	}
 	else
 	{
-		location = after_checkpoint_sync_wal();
-		maxLocation = Max(maxLocation, location);
+		walLocation = after_checkpoint_sync_wal();
 	}
 
 	location = s3_schedule_file_write(chkpNum, XLOG_CONTROL_FILE, false);
@@ -1676,6 +1940,9 @@ o_after_checkpoint_cleanup_hook(XLogRecPtr checkPointRedo, int flags)
 	location = s3_schedule_root_file_write(CONTROL_FILENAME, false);
 	maxLocation = Max(maxLocation, location);
 	s3_queue_wait_for_location(maxLocation);
+
+	/* WAL files are in the other queue lane, so they are waited separately */
+	s3_queue_wait_for_location(walLocation);
 }
 
 
@@ -1746,37 +2013,6 @@ finalize_chkp_map(File chkp_file, uint64 len, char *input_filename,
 	return len;
 }
 
-/*
- * Comparator for sort ascending.
- */
-static int
-uint32_offsets_cmp(const void *a, const void *b)
-{
-	uint32		val1 = *(uint32 *) a;
-	uint32		val2 = *(uint32 *) b;
-
-	if (val1 != val2)
-		return val1 > val2 ? 1 : -1;
-	return 0;
-}
-
-/*
- * Comparator for FileExtent.len sort descending.
- */
-static int
-file_extents_len_off_cmp(const void *a, const void *b)
-{
-	FileExtent *val1 = (FileExtent *) a;
-	FileExtent *val2 = (FileExtent *) b;
-
-	if (val1->len != val2->len)
-		return val1->len > val2->len ? -1 : 1;
-	else if (val1->off != val2->off)
-		return val1->off > val2->off ? 1 : -1;
-
-	return 0;
-}
-
 /*
  * Comparator for FileExtent.off sort ascending.
  */
@@ -1822,14 +2058,12 @@ file_extents_writeback_cmp(const void *a, const void *b)
 static void
 sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 {
-	Pointer		free_blocks;
-	uint64		free_blocks_size;
 	File		file;
 	char	   *filename;
 	CheckpointFileHeader header = {0};
 	bool		ferror = false,
 				is_compressed = OCompressIsValid(descr->compress);
-	int			read_size;
+	TimestampTz start_time = GetCurrentTimestamp();
 
 	filename = get_seq_buf_filename(&descr->nextChkp[cur_chkp_index].tag);
 	file = PathNameOpenFile(filename, O_RDWR | PG_BINARY);
@@ -1840,7 +2074,7 @@ sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 							   filename)));
 	}
 
-	/* reads header and blocks from map file */
+	/* reads header from map file */
 	ferror = OFileRead(file, (Pointer) &header,
 					   sizeof(header), 0, WAIT_EVENT_DATA_FILE_READ) != sizeof(header);
 	if (ferror)
@@ -1850,39 +2084,11 @@ sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 							   filename)));
 	}
 
-	if (is_compressed || use_device)
-	{
-		free_blocks_size = sizeof(FileExtent) * header.numFreeBlocks;
-	}
-	else
-	{
-		free_blocks_size = sizeof(uint32) * header.numFreeBlocks;
-	}
-
-	free_blocks = palloc(free_blocks_size);
-	if (free_blocks_size > 0)
-	{
-		read_size = OFileRead(file, (Pointer) free_blocks, free_blocks_size,
-							  sizeof(header), WAIT_EVENT_DATA_FILE_READ);
-
-		if (read_size != free_blocks_size)
-		{
-			ereport(FATAL, (errcode_for_file_access(),
-							errmsg("Could not read data from checkpoint map file %s: %m",
-								   filename)));
-		}
-	}
-
-	/* sorts blocks */
-	if (is_compressed || use_device)
-		pg_qsort(free_blocks, header.numFreeBlocks, sizeof(FileExtent), file_extents_len_off_cmp);
-	else
-		pg_qsort(free_blocks, header.numFreeBlocks, sizeof(uint32), uint32_offsets_cmp);
+	/* sorts blocks in place */
+	sort_free_extents_file(file, filename, sizeof(header),
+						   header.numFreeBlocks, is_compressed || use_device);
 
-	/* writes sorted blocks to map file. */
-	if (OFileWrite(file, (Pointer) free_blocks, free_blocks_size,
-				   sizeof(header), WAIT_EVENT_DATA_FILE_WRITE) != free_blocks_size ||
-		FileSync(file, WAIT_EVENT_SLRU_SYNC) != 0)
+	if (FileSync(file, WAIT_EVENT_SLRU_SYNC) != 0)
 	{
 		ereport(FATAL, (errcode_for_file_access(),
 						errmsg("Could not write sorted data to checkpoint map file %s: %m",
@@ -1890,7 +2096,7 @@ sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 	}
 	FileClose(file);
 	pfree(filename);
-	pfree(free_blocks);
+	checkpoint_phase_finish(CheckpointPhaseMapSort, start_time);
 }
 
 /*
@@ -1899,12 +2105,11 @@ sort_checkpoint_map_file(BTreeDescr *descr, int cur_chkp_index)
 static void
 sort_checkpoint_tmp_file(BTreeDescr *descr, int cur_chkp_index)
 {
-	Pointer		free_blocks;
-	uint64		free_blocks_size;
 	File		file;
 	char	   *filename;
 	bool		is_compressed = OCompressIsValid(descr->compress);
-	int			read_size;
+	Size		item_size;
+	TimestampTz start_time = GetCurrentTimestamp();
 
 	filename = get_seq_buf_filename(&descr->tmpBuf[cur_chkp_index].tag);
 	file = PathNameOpenFile(filename, O_RDWR | PG_BINARY);
@@ -1916,37 +2121,13 @@ sort_checkpoint_tmp_file(BTreeDescr *descr, int cur_chkp_index)
 		return;
 	}
 
-	free_blocks_size = FileSize(file);
-	free_blocks = palloc(free_blocks_size);
-
-	if (free_blocks_size > 0)
-	{
-		read_size = OFileRead(file, (Pointer) free_blocks,
-							  free_blocks_size, 0, WAIT_EVENT_DATA_FILE_READ);
-		if (read_size != free_blocks_size)
-		{
-			ereport(FATAL, (errcode_for_file_access(),
-							errmsg("Could not read data from checkpoint tmp file: %s %d %lu: %m",
-								   filename, read_size, free_blocks_size)));
-		}
-	}
+	item_size = (is_compressed || use_device) ? sizeof(FileExtent) : sizeof(uint32);
 
-	/* sorts blocks */
-	if (is_compressed || use_device)
-	{
-		pg_qsort(free_blocks, free_blocks_size / sizeof(FileExtent),
-				 sizeof(FileExtent), file_extents_len_off_cmp);
-	}
-	else
-	{
-		pg_qsort(free_blocks, free_blocks_size / sizeof(uint32),
-				 sizeof(uint32), uint32_offsets_cmp);
-	}
+	/* sorts blocks in place */
+	sort_free_extents_file(file, filename, 0, FileSize(file) / item_size,
+						   is_compressed || use_device);
 
-	/* writes sorted blocks to tmp file */
-	if (OFileWrite(file, (Pointer) free_blocks,
-				   free_blocks_size, 0, WAIT_EVENT_DATA_FILE_WRITE) != free_blocks_size ||
-		FileSync(file, WAIT_EVENT_SLRU_SYNC) != 0)
+	if (FileSync(file, WAIT_EVENT_SLRU_SYNC) != 0)
 	{
 		ereport(FATAL, (errcode_for_file_access(),
 						errmsg("Could not write sorted data to checkpoint tmp file %s: %m",
@@ -1955,12 +2136,15 @@ sort_checkpoint_tmp_file(BTreeDescr *descr, int cur_chkp_index)
 
 	FileClose(file);
 	pfree(filename);
-	pfree(free_blocks);
+	checkpoint_phase_finish(CheckpointPhaseMapSort, start_time);
 }
 
 static inline void
 checkpoint_ix_init_state(CheckpointState *state, BTreeDescr *descr)
 {
+	chkp_stats.treeType = descr->type;
+	chkp_stats.treeOids = descr->oids;
+
 	chkp_inc_changecount_before(checkpoint_state);
 	checkpoint_state->treeType = descr->type;
 	checkpoint_state->datoid = descr->oids.datoid;
@@ -2446,24 +2630,32 @@ checkpoint_ix(int flags, BTreeDescr *descr)
 	off_t		file_length;
 	uint32		chkpNum = checkpoint_state->lastCheckpointNumber + 1;
 	int			cur_chkp_index = (chkpNum) % 2;
+	TimestampTz phase_start;
 
 	Assert(ORootPageIsValid(descr) && OMetaPageIsValid(descr));
+	ORIOLEDB_PROBE3(checkpoint_tree__start, datoid, relnode, chkpNum);
 	meta_page = BTREE_GET_META(descr);
 	meta_page->dirtyFlag1 = false;
 
 	/* Make checkpoint of the tree itself */
 	init_writeback(&writeback, flags, is_compressed);
+	if (!orioledb_s3_mode && !use_device)
+		writeback.reuseLimit = pg_atomic_read_u64(&meta_page->datafileLength[0]);
 	root_downlink = checkpoint_btree(&descr, checkpoint_state, &writeback);
 	if (!DiskDownlinkIsValid(root_downlink))
 	{
 		free_writeback(&writeback);
+		ORIOLEDB_PROBE4(checkpoint_tree__done, datoid, relnode, chkpNum, false);
 		return false;
 	}
 	descr = perform_writeback_and_relock(descr, &writeback,
 										 checkpoint_state, NULL, 0);
 	free_writeback(&writeback);
 	if (!descr)
+	{
+		ORIOLEDB_PROBE4(checkpoint_tree__done, datoid, relnode, chkpNum, false);
 		return false;
+	}
 
 	Assert(checkpoint_state->curKeyType == CurKeyGreatest);
 	Assert(DiskDownlinkIsValid(root_downlink));
@@ -2476,7 +2668,9 @@ checkpoint_ix(int flags, BTreeDescr *descr)
 			file_length = pg_atomic_read_u64(&meta_page->datafileLength[index]) * ORIOLEDB_COMP_BLCKSZ;
 		else
 			file_length = pg_atomic_read_u64(&meta_page->datafileLength[index]) * ORIOLEDB_BLCKSZ;
+		phase_start = GetCurrentTimestamp();
 		btree_smgr_sync(descr, chkpNum, file_length);
+		checkpoint_phase_finish(CheckpointPhaseFsync, phase_start);
 
 		if (orioledb_s3_mode)
 		{
@@ -2740,6 +2934,7 @@ checkpoint_ix(int flags, BTreeDescr *descr)
 		o_update_latest_chkp_num(descr->oids.datoid,
 								 descr->oids.relnode,
 								 chkpNum);
+	ORIOLEDB_PROBE4(checkpoint_tree__done, datoid, relnode, chkpNum, true);
 	return true;
 }
 
@@ -2760,6 +2955,8 @@ checkpoint_btree(BTreeDescr **descrPtr, CheckpointState *state,
 										ALLOCSET_DEFAULT_SIZES);
 	prev_context = MemoryContextSwitchTo(tmp_context);
 
+	compaction_checkpoint_begin(*descrPtr, state->lastCheckpointNumber + 1);
+
 	set_skip_ucm();
 	/* Walk the tree recursively starting from rootPageBlkno */
 	root_downlink = checkpoint_btree_loop(descrPtr,
@@ -2767,6 +2964,9 @@ checkpoint_btree(BTreeDescr **descrPtr, CheckpointState *state,
 										  writeback,
 										  tmp_context);
 	unset_skip_ucm();
+	compress_workers_release_all();
+	o_uring_wait_all();
+	btree_io_set_append_extents(NULL);
 
 	checkpoint_reset_stack(state);
 
@@ -3344,6 +3544,8 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 
 		MemoryContextReset(tmp_context);
 
+		drain_xids_queue();
+
 		if (STOPEVENTS_ENABLED())
 		{
 			Jsonb	   *params = prepare_checkpoint_step_params(descr, state,
@@ -3366,7 +3568,8 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 		if (message.action == WalkDownwards)
 		{
 			bool		was_dirty,
-						parent_dirty;
+						parent_dirty,
+						async_write;
 			Page		img;
 			OrioleDBPageDesc *page_desc = NULL;
 
@@ -3487,6 +3690,7 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 					/* prepare_leaf_page() unlocks page */
 					prepare_leaf_page(descr, state);
 
+					async_write = o_uring_start_write(blkno, page_desc->ionum);
 					downlink = perform_page_io(descr,
 											   blkno,
 											   state->stack[level].image,
@@ -3508,8 +3712,16 @@ checkpoint_btree_loop(BTreeDescr **descrPtr,
 					}
 
 					writeback_put_extent(writeback, &page_desc->fileExtent);
-					unlock_io(page_desc->ionum);
-					page_desc->ionum = -1;
+					if (async_write)
+					{
+						/* the IO lock is released on the write completion */
+						o_uring_finish_write();
+					}
+					else
+					{
+						unlock_io(page_desc->ionum);
+						page_desc->ionum = -1;
+					}
 				}
 				else
 				{
@@ -4252,6 +4464,10 @@ checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
 			state->stack[level].autonomousTupleExist = false;
 		}
 
+		/* Handle the unmodified in-memory subtrees as the on-disk ones */
+		if (DOWNLINK_IS_IN_MEMORY(downlink) && !autonomous)
+			(void) checkpoint_clean_child_downlink(&downlink);
+
 		if (DOWNLINK_IS_IN_MEMORY(downlink))
 		{
 			BTreePageItemLocator nextLoc = loc;
@@ -4294,6 +4510,10 @@ checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
 									page, &loc);
 			}
 
+			/* Let the compression workers start on the next leaves */
+			if (level == 1)
+				compress_workers_precompress_leaves(descr, page, &loc, chkpNum);
+
 			unlock_page(blkno);
 			message->action = WalkDownwards;
 			message->content.downwards.blkno = DOWNLINK_GET_IN_MEMORY_BLKNO(downlink);
@@ -4313,6 +4533,7 @@ checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
 			memcpy(BTREE_PAGE_LOCATOR_GET_ITEM(img, &imgLastLoc),
 				   BTREE_PAGE_LOCATOR_GET_ITEM(page, &loc),
 				   BTreeNonLeafTuphdrSize);
+			((BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(img, &imgLastLoc))->downlink = downlink;
 
 			if (BTREE_PAGE_ITEMS_COUNT(state->stack[level - 1].image) > 0)
 			{
@@ -4661,6 +4882,58 @@ checkpoint_internal_pass(BTreeDescr *descr, CheckpointState *state,
 }
 
 
+/*
+ * Checks if the in-memory child of the locked internal page is unmodified
+ * since it was written: the child is clean, has no IO and no incomplete
+ * split, and if it's an internal page, all its downlinks point to the disk.
+ * That means the subtree image on disk is current, so the checkpointer can
+ * reuse the child extent without descending.  Replaces *downlink with the
+ * on-disk downlink in this case.
+ *
+ * Eviction of the child needs the parent lock, so the child can't be
+ * replaced.  We only try-lock the child to be sure nobody is modifying it.
+ */
+static bool
+checkpoint_clean_child_downlink(uint64 *downlink)
+{
+	OInMemoryBlkno blkno = DOWNLINK_GET_IN_MEMORY_BLKNO(*downlink);
+	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	Page		page = O_GET_IN_MEMORY_PAGE(blkno);
+	bool		result;
+
+	if (!skip_clean_subtrees || IS_DIRTY(blkno) || page_desc->ionum >= 0 ||
+		!try_lock_page(blkno))
+		return false;
+
+	result = O_PAGE_GET_CHANGE_COUNT(page) == DOWNLINK_GET_IN_MEMORY_CHANGECOUNT(*downlink) &&
+		!IS_DIRTY(blkno) && page_desc->ionum < 0 &&
+		FileExtentIsValid(page_desc->fileExtent) &&
+		!RightLinkIsValid(BTREE_PAGE_GET_RIGHTLINK(page));
+
+	if (result && !O_PAGE_IS(page, LEAF))
+	{
+		BTreePageItemLocator loc;
+
+		BTREE_PAGE_FOREACH_ITEMS(page, &loc)
+		{
+			BTreeNonLeafTuphdr *tuphdr;
+
+			tuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(page, &loc);
+			if (!DOWNLINK_IS_ON_DISK(tuphdr->downlink))
+			{
+				result = false;
+				break;
+			}
+		}
+	}
+
+	if (result)
+		*downlink = MAKE_ON_DISK_DOWNLINK(page_desc->fileExtent);
+	unlock_page(blkno);
+
+	return result;
+}
+
 /*
  * Prepare particular leaf B-tree page for checkpointing.  Checkpointer
  * state stack item is already filled and page is locked.
@@ -4769,6 +5042,7 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 
 	if (!check_tree_needs_checkpointing(type, treeOids))
 	{
+		chkp_stats.treesDone++;
 		MemoryContextSwitchTo(prev_context);
 		MemoryContextResetOnly(chkp_tree_context);
 		return;
@@ -4790,6 +5064,7 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 		BTreeMetaPage *meta = BTREE_GET_META(td);
 		bool		success;
 		bool		skip = false;
+		OXid		treeXmin;
 
 		elog(DEBUG3, "CHKP %u, (%u, %u, %u) => (%u, %u, %u)",
 			 type, treeOids.datoid, treeOids.reloid, treeOids.relnode,
@@ -4806,6 +5081,13 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 
 		LWLockRelease(&checkpoint_state->oTablesMetaLock);
 
+		/*
+		 * All the transactions older than runXmin are finished, so their
+		 * changes are in memory and get into the image written below.
+		 */
+		treeXmin = pg_atomic_read_u64(&xid_meta->runXmin);
+		pg_read_barrier();
+
 		if (STOPEVENTS_ENABLED())
 		{
 			Jsonb	   *params = prepare_checkpoint_tree_start_params(td);
@@ -4834,6 +5116,8 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 
 		if (skip)
 		{
+			if (td->storageType == BTreeStoragePersistence)
+				add_tree_xmin(td->oids, treeXmin);
 			if (!orioledb_s3_mode)
 			{
 				if (td->storageType == BTreeStoragePersistence ||
@@ -4850,10 +5134,14 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 		else if (td->storageType == BTreeStoragePersistence ||
 				 td->storageType == BTreeStorageUnlogged)
 		{
+			o_compress_start_sampling(td);
 			success = checkpoint_ix(tbl_arg->flags, td);
+			o_compress_finish_sampling(td, success);
 
 			if (success)
 			{
+				if (td->storageType == BTreeStoragePersistence)
+					add_tree_xmin(td->oids, treeXmin);
 				if (!orioledb_s3_mode)
 				{
 					sort_checkpoint_map_file(td, cur_chkp_index);
@@ -4879,10 +5167,118 @@ checkpoint_tables_callback(OIndexType type, ORelOids treeOids,
 		o_tables_rel_unlock_extended(&treeOids, AccessShareLock, true);
 	}
 
+	/* The trees created after the count are checkpointed too */
+	chkp_stats.treesDone++;
+	chkp_stats.treesTotal = Max(chkp_stats.treesTotal, chkp_stats.treesDone);
+	checkpoint_stats_publish(false);
+
 	MemoryContextSwitchTo(prev_context);
 	MemoryContextResetOnly(chkp_tree_context);
 }
 
+/*
+ * Publishes the statistics of the current checkpoint.  Adds them to the
+ * history if the checkpoint is finished.
+ */
+static void
+checkpoint_stats_publish(bool finished)
+{
+	SpinLockAcquire(&checkpoint_state->statsLock);
+	checkpoint_state->curStats = chkp_stats;
+	if (finished)
+	{
+		checkpoint_state->statsHistory[checkpoint_state->statsHistoryCount %
+									   CHECKPOINT_STATS_HISTORY_SIZE] = chkp_stats;
+		checkpoint_state->statsHistoryCount++;
+	}
+	SpinLockRelease(&checkpoint_state->statsLock);
+}
+
+static void
+checkpoint_stats_put_row(ReturnSetInfo *rsinfo, CheckpointStats *stats)
+{
+	Datum		values[18];
+	bool		nulls[18];
+	int			i;
+
+	MemSet(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(stats->checkpointNumber);
+	values[1] = BoolGetDatum(stats->inProgress);
+	values[2] = TimestampTzGetDatum(stats->startTime);
+	values[3] = TimestampTzGetDatum(stats->endTime);
+	nulls[3] = stats->inProgress;
+	values[4] = ObjectIdGetDatum(stats->treeOids.datoid);
+	values[5] = ObjectIdGetDatum(stats->treeOids.reloid);
+	values[6] = ObjectIdGetDatum(stats->treeOids.relnode);
+	nulls[4] = nulls[5] = nulls[6] = !stats->inProgress;
+	values[7] = Int64GetDatum(stats->treesDone);
+	values[8] = Int64GetDatum(stats->treesTotal);
+	values[9] = Int64GetDatum(stats->pagesWritten);
+	values[10] = Int64GetDatum(stats->pagesReused);
+	values[11] = Int64GetDatum(stats->pagesCompressed);
+	values[12] = Int64GetDatum(stats->bytesWritten);
+	for (i = 0; i < CheckpointPhasesCount; i++)
+		values[13 + i] = Float8GetDatum((double) stats->phaseTime[i] / 1000.0);
+
+	tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+}
+
+/*
+ * Returns the statistics of the recent checkpoints, followed by the running
+ * one.
+ */
+Datum
+orioledb_checkpoint_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	CheckpointStats *history;
+	CheckpointStats current;
+	uint32		count,
+				first,
+				i;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	history = (CheckpointStats *) palloc(sizeof(CheckpointStats) *
+										 CHECKPOINT_STATS_HISTORY_SIZE);
+	SpinLockAcquire(&checkpoint_state->statsLock);
+	count = checkpoint_state->statsHistoryCount;
+	memcpy(history, checkpoint_state->statsHistory,
+		   sizeof(CheckpointStats) * CHECKPOINT_STATS_HISTORY_SIZE);
+	current = checkpoint_state->curStats;
+	SpinLockRelease(&checkpoint_state->statsLock);
+
+	first = (count > CHECKPOINT_STATS_HISTORY_SIZE) ?
+		count - CHECKPOINT_STATS_HISTORY_SIZE : 0;
+	for (i = first; i < count; i++)
+		checkpoint_stats_put_row(rsinfo,
+								 &history[i % CHECKPOINT_STATS_HISTORY_SIZE]);
+	if (current.inProgress)
+		checkpoint_stats_put_row(rsinfo, &current);
+
+	pfree(history);
+
+	return (Datum) 0;
+}
+
 /*
  * Returns actual lastCheckpointNumber for current tree.
  */
@@ -33,6 +33,7 @@
 #include "access/relation.h"
 #include "commands/progress.h"
 #include "commands/vacuum.h"
+#include "nodes/makefuncs.h"
 #include "nodes/pathnodes.h"
 #include "optimizer/optimizer.h"
 #include "parser/parsetree.h"
@@ -670,6 +671,10 @@ orioledb_amupdate(Relation rel, bool new_valid, bool old_valid,
 	}
 	Assert(ix_num < descr->nIndices);
 
+	if (new_valid == old_valid &&
+		!o_index_update_is_needed(descr, index_descr, oldTupleid))
+		return true;
+
 	append_rowid_values(index_descr,
 						GET_PRIMARY(descr)->nonLeafTupdesc,
 						&GET_PRIMARY(descr)->nonLeafSpec,
@@ -942,6 +947,38 @@ orioledb_amcanreturn(Relation index, int attno)
 	return true;
 }
 
+/*
+ * Estimates the number of distinct values of the first index column.
+ * Returns -1 if there are no statistics for it.
+ */
+static double
+o_index_first_column_ndistinct(PlannerInfo *root, IndexOptInfo *index)
+{
+	RangeTblEntry *rte;
+	VariableStatData vardata;
+	Oid			typid;
+	int32		typmod;
+	Oid			collid;
+	Var		   *var;
+	double		ndistinct;
+	bool		isdefault;
+
+	if (index->indexkeys[0] == 0)
+		return -1;
+
+	rte = planner_rt_fetch(index->rel->relid, root);
+	get_atttypetypmodcoll(rte->relid, index->indexkeys[0],
+						  &typid, &typmod, &collid);
+	var = makeVar(index->rel->relid, index->indexkeys[0],
+				  typid, typmod, collid, 0);
+
+	examine_variable(root, (Node *) var, 0, &vardata);
+	ndistinct = get_variable_numdistinct(&vardata, &isdefault);
+	ReleaseVariableStats(vardata);
+
+	return isdefault ? -1 : ndistinct;
+}
+
 /* TODO: Rewrite to be more orioledb-specific */
 void
 orioledb_amcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
@@ -962,6 +999,7 @@ orioledb_amcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	bool		found_saop;
 	bool		found_is_null_op;
 	double		num_sa_scans;
+	double		skip_scans;
 	ListCell   *lc;
 
 	/*
@@ -987,6 +1025,27 @@ orioledb_amcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	found_saop = false;
 	found_is_null_op = false;
 	num_sa_scans = 1;
+	skip_scans = 1;
+
+	/*
+	 * The skip scan of the index having no quals on the first column but
+	 * having them on the second one descends once per distinct value of the
+	 * first column.  Consider it when there are fewer values than the index
+	 * pages.  Then the first column acts like an '=' qual.
+	 */
+	if (enable_skip_scan && index->nkeycolumns > 1 &&
+		path->indexclauses != NIL &&
+		linitial_node(IndexClause, path->indexclauses)->indexcol == 1)
+	{
+		double		ndistinct = o_index_first_column_ndistinct(root, index);
+
+		if (ndistinct > 0 && ndistinct <= index->pages)
+		{
+			skip_scans = ndistinct;
+			indexcol = 1;
+		}
+	}
+
 	foreach(lc, path->indexclauses)
 	{
 		IndexClause *iclause = lfirst_node(IndexClause, lc);
@@ -1076,6 +1135,7 @@ orioledb_amcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	if (index->unique &&
 		indexcol == index->nkeycolumns - 1 &&
 		eqQualHere &&
+		skip_scans == 1 &&
 		!found_saop &&
 		!found_is_null_op)
 		numIndexTuples = 1.0;
@@ -1156,7 +1216,7 @@ orioledb_amcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	{
 		descentCost = ceil(log(index->tuples) / log(2.0)) * cpu_operator_cost;
 		costs.indexStartupCost += descentCost;
-		costs.indexTotalCost += costs.num_sa_scans * descentCost;
+		costs.indexTotalCost += costs.num_sa_scans * skip_scans * descentCost;
 	}
 
 	/*
@@ -1171,7 +1231,7 @@ orioledb_amcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	 */
 	descentCost = (index->tree_height + 1) * DEFAULT_PAGE_CPU_MULTIPLIER * cpu_operator_cost;
 	costs.indexStartupCost += descentCost;
-	costs.indexTotalCost += costs.num_sa_scans * descentCost;
+	costs.indexTotalCost += costs.num_sa_scans * skip_scans * descentCost;
 
 	/*
 	 * If we can get an estimate of the first column's ordering correlation C
@@ -1271,6 +1331,13 @@ orioledb_amcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 
 	ReleaseVariableStats(vardata);
 
+	/*
+	 * The primary index leaves hold the table rows, so the table is ordered
+	 * by the primary index.
+	 */
+	if (enable_tree_statistics && get_index_isprimary(index->indexoid))
+		costs.indexCorrelation = index->reverse_sort[0] ? -1.0 : 1.0;
+
 	*indexStartupCost = costs.indexStartupCost;
 	*indexTotalCost = costs.indexTotalCost;
 	*indexSelectivity = costs.indexSelectivity;
@@ -1401,6 +1468,7 @@ orioledb_ambeginscan(Relation rel, int nkeys, int norderbys)
 	OBTOptions *options = (OBTOptions *) rel->rd_options;
 
 	o_current_index = NULL;
+	o_apply_flush_inserts();
 
 	if (options && !options->orioledb_index)
 	{
@@ -1479,6 +1547,7 @@ orioledb_amrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
 
 	MemoryContextReset(o_scan->cxt);
 	o_scan->iterator = NULL;
+	o_scan->keysLookup = NULL;
 	o_scan->curKeyRangeIsLoaded = false;
 	o_scan->numPrefixExactKeys = o_get_num_prefix_exact_keys(scankey, nscankeys);
 	btrescan(scan, scankey, nscankeys, orderbys, norderbys);
@@ -14,11 +14,17 @@
  */
 #include "postgres.h"
 
+#include <math.h>
+
 #include "orioledb.h"
 
+#include "btree/btree.h"
+#include "btree/device.h"
 #include "btree/find.h"
+#include "btree/insert.h"
 #include "btree/io.h"
 #include "btree/scan.h"
+#include "btree/uring.h"
 #include "catalog/o_tables.h"
 #include "catalog/o_sys_cache.h"
 #include "catalog/sys_trees.h"
@@ -27,36 +33,58 @@
 #include "recovery/logical.h"
 #include "recovery/recovery.h"
 #include "recovery/wal.h"
+#include "s3/backfill.h"
 #include "s3/control.h"
 #include "s3/headers.h"
+#include "s3/part_cache.h"
 #include "s3/queue.h"
 #include "s3/requests.h"
+#include "s3/stats.h"
 #include "s3/worker.h"
 #include "tableam/handler.h"
+#include "tableam/root_info_cache.h"
 #include "tableam/scan.h"
 #include "tableam/toast.h"
 #include "transam/oxid.h"
 #include "transam/undo.h"
 #include "tuple/toast.h"
 #include "utils/compress.h"
+#include "utils/compressed_cache.h"
 #include "utils/guc.h"
 #include "utils/memdebug.h"
+#include "utils/o_memory.h"
+#include "utils/op_sampling.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
+#include "utils/tree_stats.h"
 #include "utils/ucm.h"
+#include "utils/undo_page_cache.h"
+#include "utils/zone_map.h"
 #include "workers/bgwriter.h"
+#include "workers/compactor.h"
+#include "workers/compress_worker.h"
+#include "workers/merger.h"
+#include "workers/op_sampler.h"
+#include "workers/prewarm.h"
+#include "workers/sync_worker.h"
+#include "workers/verifier.h"
 #include "rewind/rewind.h"
 
 #include "access/heapam.h"
+#include "access/htup_details.h"
 #include "access/table.h"
 #include "access/xlog_internal.h"
 #include "catalog/pg_enum.h"
+#include "catalog/pg_type.h"
 #include "executor/execExpr.h"
 #include "funcapi.h"
 #include "libpq/auth.h"
 #include "miscadmin.h"
+#include "optimizer/cost.h"
 #include "optimizer/optimizer.h"
+#include "optimizer/paths.h"
 #include "optimizer/plancat.h"
+#include "port/pg_bitutils.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
@@ -66,12 +94,14 @@
 #include "storage/ipc.h"
 #include "storage/lwlock.h"
 #include "storage/proclist.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/inval.h"
 #include "utils/rangetypes.h"
 #include "utils/pg_locale.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
+#include "utils/timestamp.h"
 
 #include <dirent.h>
 #include <sys/stat.h>
@@ -89,51 +119,188 @@ static Size free_tree_buffers_count;
 static int	catalog_buffers_guc;
 static Size catalog_buffers_count;
 static Size main_buffers_offset;
+/* initial size of the main pool, which might be less than its maximum */
+static Size main_buffers_initial_count;
+static Size free_tree_buffers_initial_count;
+static Size catalog_buffers_initial_count;
+static Size pool_min_count;
 
 Pointer		o_shared_buffers = NULL;
 OrioleDBPageDesc *page_descs = NULL;
 
+typedef enum
+{
+	OSharedBuffersHugePagesOff,
+	OSharedBuffersHugePagesTry,
+	OSharedBuffersHugePagesOn
+} OSharedBuffersHugePages;
+
+static const struct config_enum_entry shared_buffers_huge_pages_options[] = {
+	{"off", OSharedBuffersHugePagesOff, false},
+	{"try", OSharedBuffersHugePagesTry, false},
+	{"on", OSharedBuffersHugePagesOn, false},
+	{NULL, 0, false}
+};
+
+static const struct config_enum_entry compress_codec_options[] = {
+	{"zstd", O_COMPRESS_CODEC_ZSTD, false},
+	{"lz4", O_COMPRESS_CODEC_LZ4, false},
+	{NULL, 0, false}
+};
+
+static const struct config_enum_entry io_method_options[] = {
+	{"sync", OIOMethodSync, false},
+	{"io_uring", OIOMethodIOUring, false},
+	{NULL, 0, false}
+};
+
+static int	shared_buffers_huge_pages = OSharedBuffersHugePagesOff;
+static int	shared_buffers_huge_page_size = 0;
+static bool shared_buffers_transparent_huge_pages = false;
+static bool shared_buffers_lock = false;
+
+/*
+ * Separate mapping of o_shared_buffers.  It's created by the postmaster and
+ * inherited by the children.
+ */
+static Pointer o_shared_buffers_mapping = NULL;
+static Size o_shared_buffers_mapping_size = 0;
+/* size of the huge pages backing the mapping, 0 for the regular pages */
+static Size o_shared_buffers_mapping_huge_page_size = 0;
+static bool o_shared_buffers_mapping_locked = false;
+
 /* Custom GUC variables */
 static int	main_buffers_guc;
+static int	main_buffers_max_guc;
 static int	undo_buffers_guc;
 static int	xid_buffers_guc;
 static int	rewind_buffers_guc;
+static int	compressed_cache_guc;
+static int	undo_page_cache_guc;
+static int	zone_map_guc;
+static int	root_info_cache_guc;
 int			max_procs;
 Size		orioledb_buffers_size;
 Size		orioledb_buffers_count;
+Size		compressed_cache_size;
+Size		undo_page_cache_size;
+Size		zone_map_size;
+Size		root_info_cache_size;
+int			tree_stats_max = 0;
+int			page_wait_sample_rate = 0;
+bool		explain_io_details = false;
+int			undo_image_limit = 0;
+int			undo_disk_read_limit = 0;
+bool		undo_limit_error = false;
+int			op_sampling_history_size = 0;
+int			op_sampling_period = 10;
+int			backend_memory_soft_limit = 0;
 Size		page_descs_size;
 Size		undo_circular_buffer_size;
 uint32		undo_buffers_count;
 double		regular_block_undo_circular_buffer_fraction;
 double		system_undo_circular_buffer_fraction;
+bool		undo_adaptive_split = false;
+int			undo_reserve_batch = 32;
+int			undo_compress = InvalidOCompress;
+int			undo_compress_codec = O_COMPRESS_CODEC_ZSTD;
+int			orioledb_commit_delay = 0;
+int			wal_compress = InvalidOCompress;
+int			wal_compress_codec = O_COMPRESS_CODEC_ZSTD;
+int			wal_compress_threshold = 512;
+bool		wal_update_delta = false;
+bool		undo_update_delta = false;
+bool		skip_unchanged_indices = false;
+bool		compact_row_locks = false;
+bool		resume_point_lookups = false;
+int			point_lookup_hints = 0;
+int			ctid_lease_size = 0;
+bool		toast_raw_values = false;
+bool		index_build_radix_sort = false;
+bool		create_index_concurrently_fallback = false;
 Size		xid_circular_buffer_size;
 uint32		xid_buffers_count;
 Size		rewind_circular_buffer_size;
 uint32		rewind_buffers_count;
 bool		remove_old_checkpoint_files = true;
 bool		skip_unmodified_trees = true;
+bool		orioledb_fast_snapshots = false;
+bool		skip_clean_subtrees = true;
 bool		debug_disable_bgwriter = false;
+bool		balance_pools = false;
 bool		use_mmap = false;
 bool		use_device = false;
 bool		orioledb_use_sparse_files = false;
+bool		orioledb_direct_io = false;
 char	   *device_filename = NULL;
-Pointer		mmap_data = NULL;
-int			device_fd;
 int			device_length_guc = 0;
+int			device_stripe_size_guc = 128;
 Size		device_length = 0;
 double		o_checkpoint_completion_ratio;
+int			checkpoint_min_write_rate = 0;
+int			checkpoint_max_write_rate = 0;
+int			checkpoint_sort_mem = 65536;
+int			xids_queue_per_backend = 64;
 int			bgwriter_num_workers = 1;
+int			eviction_dirty_skips = 0;
+bool		enable_background_merge = false;
+int			background_merge_pages = 1024;
+int			background_merge_delay = 1000;
+int			split_fix_delay = -1;
+bool		lazy_tree_cleanup = false;
+bool		enable_compaction = false;
+int			compaction_pages = 1024;
+int			compaction_delay = 1000;
+bool		compaction_pause = false;
+int			verify_workers_num = 0;
+int			verify_pages = 64;
+int			verify_delay = 100;
 int			max_io_concurrency = 0;
+int			io_method = OIOMethodSync;
+int			io_uring_depth = 32;
+int			write_combine_limit = 128;
+int			iterator_prefetch_pages = 16;
+int			seq_scan_readahead_pages = 128;
+int			page_pool_numa_nodes = 1;
+int			free_pages_low_watermark = 5;
+int			free_pages_high_watermark = 10;
+bool		scan_resistant_seq_scan = true;
+bool		scan_resistant_sampling = true;
+bool		sampling_skip_pages = false;
+bool		seq_scan_qual_pushdown = true;
+bool		index_only_scan_all_visible = false;
+bool		enable_parallel_bitmap_scan = false;
+bool		index_insert_prefetch = false;
+bool		enable_parallel_index_scan = false;
+bool		enable_skip_scan = false;
+bool		enable_tree_statistics = false;
+bool		enable_count_pushdown = false;
+bool		standby_nowait_reads = true;
+bool		enable_prewarm = false;
+int			prewarm_workers_num = 1;
+bool		replica_prewarm = false;
+int			logical_apply_batch_size = 1000;
+bool		compress_dictionaries = false;
+bool		compress_auto = false;
+bool		page_checksums = false;
+int			compress_auto_cpu_cost = 16;
+int			compress_workers_num = 0;
+int			checkpoint_sync_workers_num = 0;
+int			database_pool_quota = 0;
+int			table_pool_quota = 0;
 ODBProcData *oProcData;
 int			default_compress = InvalidOCompress;
 int			default_primary_compress = InvalidOCompress;
 int			default_toast_compress = InvalidOCompress;
+int			default_compress_codec = O_COMPRESS_CODEC_ZSTD;
 bool		orioledb_table_description_compress = false;
 char	   *max_bridge_ctid_string = NULL;
 BlockNumber max_bridge_ctid_blkno = 0;
 bool		orioledb_s3_mode = false;
 int			s3_num_workers = 3;
 int			s3_desired_size = 10000;
+int			s3_desired_size_max = 0;
+int			s3_cold_read_rate = 10;
 int			s3_queue_size_guc;
 char	   *s3_host = NULL;
 bool		s3_use_https = true;
@@ -142,9 +309,19 @@ char	   *s3_prefix = NULL;
 char	   *s3_accesskey = NULL;
 char	   *s3_secretkey = NULL;
 char	   *s3_cainfo = NULL;
+int			s3_multipart_part_size = 64;
+int			s3_cache_size = 0;
+int			s3_file_chunk_size = 16;
+char	   *s3_cache_dir = NULL;
+int			s3_scan_prefetch_pages = 1024;
+bool		s3_backfill = false;
 bool		enable_rewind = false;
 int			rewind_max_time = 0;
 int			rewind_max_transactions = 0;
+int			rewind_parallel_workers = 0;
+static char *as_of_timestamp_string = NULL;
+bool		as_of_enabled = false;
+TimestampTz as_of_timestamp = 0;
 int			logical_xid_buffers_guc = 64;
 
 /* Previous values of hooks to chain call them */
@@ -203,7 +380,25 @@ static ShmemItem shmemItems[] = {
 	{s3_queue_shmem_needs, s3_queue_init_shmem},
 	{s3_workers_shmem_needs, s3_workers_init_shmem},
 	{s3_headers_shmem_needs, s3_headers_shmem_init},
-	{rewind_shmem_needs, rewind_init_shmem}
+	{s3_part_cache_shmem_needs, s3_part_cache_shmem_init},
+	{s3_stats_shmem_needs, s3_stats_shmem_init},
+	{rewind_shmem_needs, rewind_init_shmem},
+	{merge_worker_shmem_needs, merge_worker_shmem_init},
+	{bgwriter_shmem_needs, bgwriter_shmem_init},
+	{compressed_cache_shmem_needs, compressed_cache_shmem_init},
+	{undo_page_cache_shmem_needs, undo_page_cache_shmem_init},
+	{zone_map_shmem_needs, zone_map_shmem_init},
+	{root_info_cache_shmem_needs, root_info_cache_shmem_init},
+	{tree_stats_shmem_needs, tree_stats_shmem_init},
+	{op_sampling_shmem_needs, op_sampling_shmem_init},
+	{o_memory_shmem_needs, o_memory_shmem_init},
+	{compress_workers_shmem_needs, compress_workers_shmem_init},
+	{compaction_shmem_needs, compaction_shmem_init},
+	{verify_shmem_needs, verify_shmem_init},
+	{sync_workers_shmem_needs, sync_workers_shmem_init},
+	{o_devices_shmem_needs, o_devices_shmem_init},
+	{o_btree_broken_splits_shmem_needs, o_btree_broken_splits_shmem_init},
+	{o_btree_cleanup_queue_shmem_needs, o_btree_cleanup_queue_shmem_init}
 };
 
 
@@ -219,9 +414,20 @@ static void orioledb_get_relation_info_hook(PlannerInfo *root,
 static bool orioledb_skip_tree_height_hook(Relation indexRelation);
 
 static bool check_debug_max_bridge_ctid(char **newval, void **extra, GucSource source);
+static bool check_default_compress_codec(int *newval, void **extra, GucSource source);
+static bool check_io_method(int *newval, void **extra, GucSource source);
+static bool check_direct_io(bool *newval, void **extra, GucSource source);
 static void assign_debug_max_bridge_ctid(const char *newval, void *extra);
+static bool check_as_of_timestamp(char **newval, void **extra, GucSource source);
+static void assign_as_of_timestamp(const char *newval, void *extra);
 
 PG_FUNCTION_INFO_V1(orioledb_page_stats);
+PG_FUNCTION_INFO_V1(orioledb_eviction_stats);
+PG_FUNCTION_INFO_V1(orioledb_ucm_stats);
+PG_FUNCTION_INFO_V1(orioledb_pool_occupancy);
+PG_FUNCTION_INFO_V1(orioledb_shared_buffers_info);
+PG_FUNCTION_INFO_V1(orioledb_resize_main_buffers);
+PG_FUNCTION_INFO_V1(orioledb_main_buffers_info);
 PG_FUNCTION_INFO_V1(orioledb_version);
 PG_FUNCTION_INFO_V1(orioledb_commit_hash);
 PG_FUNCTION_INFO_V1(orioledb_ucm_check);
@@ -231,12 +437,19 @@ PG_FUNCTION_INFO_V1(orioledb_parallel_debug_stop);
 static void
 orioledb_rm_desc(StringInfo buf, XLogReaderState *record)
 {
-	appendStringInfo(buf, "OrioleDB WAL container");
+	if ((XLogRecGetInfo(record) & ~XLR_INFO_MASK) == ORIOLEDB_XLOG_HOT_PAGES)
+		appendStringInfo(buf, "OrioleDB hot pages");
+	else
+		appendStringInfo(buf, "OrioleDB WAL container");
 }
 
 static const char *
 orioledb_rm_identify(uint8 info)
 {
+	if ((info & ~XLR_INFO_MASK) == ORIOLEDB_XLOG_CONTAINER_COMPRESSED)
+		return "OrioleDB compressed WAL container";
+	if ((info & ~XLR_INFO_MASK) == ORIOLEDB_XLOG_HOT_PAGES)
+		return "OrioleDB hot pages";
 	return "OrioleDB WAL container";
 }
 
@@ -308,6 +521,70 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.main_buffers_max",
+							"Maximal size the orioledb main shared buffers can be "
+							"resized to online, 0 means orioledb.main_buffers.",
+							NULL,
+							&main_buffers_max_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomEnumVariable("orioledb.shared_buffers_huge_pages",
+							 "Use huge pages for orioledb engine shared buffers, "
+							 "independently of huge_pages.",
+							 NULL,
+							 &shared_buffers_huge_pages,
+							 OSharedBuffersHugePagesOff,
+							 shared_buffers_huge_pages_options,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.shared_buffers_huge_page_size",
+							"Size of huge pages for orioledb engine shared buffers, "
+							"0 uses the default size of the kernel.",
+							NULL,
+							&shared_buffers_huge_page_size,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.shared_buffers_transparent_huge_pages",
+							 "Advise the kernel to back orioledb engine shared buffers "
+							 "with transparent huge pages when explicit huge pages aren't used.",
+							 NULL,
+							 &shared_buffers_transparent_huge_pages,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.shared_buffers_lock",
+							 "Lock orioledb engine shared buffers in memory.",
+							 NULL,
+							 &shared_buffers_lock,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomIntVariable("orioledb.free_tree_buffers",
 							"Size of orioledb engine shared buffers for free extents BTrees.",
 							NULL,
@@ -334,6 +611,18 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomBoolVariable("orioledb.balance_pools",
+							 "Lets the free extents and catalog buffers borrow "
+							 "from and lend to the main buffers.",
+							 NULL,
+							 &balance_pools,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomIntVariable("orioledb.undo_buffers",
 							"Size of orioledb engine undo log buffers.",
 							NULL,
@@ -373,6 +662,223 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("orioledb.undo_adaptive_split",
+							 "Moves the undo circular buffer memory between the "
+							 "undo log types according to their demand.",
+							 NULL,
+							 &undo_adaptive_split,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.undo_reserve_batch",
+							"Size of the undo log reserved by a backend in advance within the transaction.",
+							"Zero disables reserving in advance.",
+							&undo_reserve_batch,
+							32,
+							0,
+							64 * 1024,
+							PGC_SIGHUP,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.undo_compress",
+							"Compression level of the page-level undo evicted to disk.",
+							"-1 disables the compression.",
+							&undo_compress,
+							-1,
+							-1,
+							o_compress_max_lvl(),
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomEnumVariable("orioledb.undo_compress_codec",
+							 "Codec for the compression of the evicted undo.",
+							 NULL,
+							 &undo_compress_codec,
+							 O_COMPRESS_CODEC_ZSTD,
+							 compress_codec_options,
+							 PGC_SIGHUP,
+							 0,
+							 check_default_compress_codec,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.commit_delay",
+							"Sets the delay in microseconds before flushing the WAL of "
+							"the orioledb commit, so that concurrent commits join the flush.",
+							"Only applies when at least commit_siblings other orioledb "
+							"commits are waiting for the flush.  Zero disables the delay.",
+							&orioledb_commit_delay,
+							0,
+							0,
+							100000,
+							PGC_SUSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.wal_compress",
+							"Compression level of the orioledb WAL containers.",
+							"-1 disables the compression.",
+							&wal_compress,
+							-1,
+							-1,
+							o_compress_max_lvl(),
+							PGC_SUSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomEnumVariable("orioledb.wal_compress_codec",
+							 "Codec for the compression of the orioledb WAL containers.",
+							 NULL,
+							 &wal_compress_codec,
+							 O_COMPRESS_CODEC_ZSTD,
+							 compress_codec_options,
+							 PGC_SUSET,
+							 0,
+							 check_default_compress_codec,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.wal_compress_threshold",
+							"Minimal size of the orioledb WAL container to be compressed.",
+							NULL,
+							&wal_compress_threshold,
+							512,
+							64,
+							LOCAL_WAL_BUFFER_SIZE,
+							PGC_SUSET,
+							GUC_UNIT_BYTE,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.wal_update_delta",
+							 "Log updates of the primary tuples as the difference to the old tuples.",
+							 "Applies only when wal_level is below logical.",
+							 &wal_update_delta,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.undo_update_delta",
+							 "Keep in undo only the bytes of the old tuples changed by the updates.",
+							 "Applies only to the updates, which keep the tuple length.",
+							 &undo_update_delta,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.skip_unchanged_indices",
+							 "Skip the secondary indices, which fields aren't modified by the update.",
+							 NULL,
+							 &skip_unchanged_indices,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.compact_row_locks",
+							 "Take the row locks of the rows visible to everybody without undo records.",
+							 NULL,
+							 &compact_row_locks,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.resume_point_lookups",
+							 "Search the exact index lookup from the leaf of the previous one, if the key ascends.",
+							 "Speeds up the foreign key checks of the referencing rows loaded in the key order.",
+							 &resume_point_lookups,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.point_lookup_hints",
+							"Number of leaf hints of the exact index lookups the backend keeps by the key hashes.",
+							"0 disables the hints.",
+							&point_lookup_hints,
+							0,
+							0,
+							INT_MAX / 2,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.ctid_lease_size",
+							"Number of ctids the backend takes at once for the inserts into the tables without primary key.",
+							"0 takes the ctids one by one.",
+							&ctid_lease_size,
+							0,
+							0,
+							65536,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.toast_raw_values",
+							 "TOAST the values uncompressed, if the TOAST tree pages are compressed.",
+							 NULL,
+							 &toast_raw_values,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.index_build_radix_sort",
+							 "Sort the tuples by the integer and uuid keys with radix sort on index build.",
+							 NULL,
+							 &index_build_radix_sort,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.create_index_concurrently_fallback",
+							 "Build CREATE INDEX CONCURRENTLY on orioledb tables as a regular index build.",
+							 NULL,
+							 &create_index_concurrently_fallback,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomIntVariable("orioledb.xid_buffers",
 							"Size of orioledb engine xid buffers.",
 							NULL,
@@ -432,6 +938,18 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("orioledb.fast_snapshots",
+							 "Take the snapshots with a single CSN read while the backend "
+							 "already retains the undo for another snapshot.",
+							 "May retain the undo for longer than needed.",
+							 &orioledb_fast_snapshots,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("orioledb.skip_unmodified_trees",
 							 "Skip reading of unmodified trees during checkpointing.",
 							 NULL,
@@ -443,6 +961,17 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("orioledb.skip_clean_subtrees",
+							 "Skip descending into unmodified in-memory subtrees during checkpointing.",
+							 NULL,
+							 &skip_clean_subtrees,
+							 true,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("orioledb.debug_disable_bgwriter",
 							 "Disables bgwriter for debug.",
 							 NULL,
@@ -493,6 +1022,17 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomBoolVariable("orioledb.recovery_prefetch",
+							 "Prefetch the evicted leaf pages ahead of applying the recovery modify messages.",
+							 NULL,
+							 &recovery_prefetch_guc,
+							 true,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomIntVariable("orioledb.logical_xid_buffers",
 							"Size of shared memory buffers for subtransaction logical XIDs.",
 							NULL,
@@ -540,46 +1080,853 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
-	DefineCustomIntVariable("orioledb.bgwriter_num_workers",
-							"Number of background writers.",
+	DefineCustomIntVariable("orioledb.checkpoint_min_write_rate",
+							"Write rate in MB/s, below which the checkpoint doesn't sleep between writes.",
 							NULL,
-							&bgwriter_num_workers,
-							1,
-							1,
-							MAX_BACKENDS,
-							PGC_POSTMASTER,
+							&checkpoint_min_write_rate,
+							0,
+							0,
+							INT_MAX / 1024,
+							PGC_SIGHUP,
 							0,
 							NULL,
 							NULL,
 							NULL);
 
-	DefineCustomIntVariable("orioledb.max_io_concurrency",
-							"Number of maximum concurrent IO operations.",
+	DefineCustomIntVariable("orioledb.checkpoint_max_write_rate",
+							"Maximum write rate of the checkpoint in MB/s, zero means unlimited.",
 							NULL,
-							&max_io_concurrency,
+							&checkpoint_max_write_rate,
 							0,
 							0,
-							INT_MAX,
+							INT_MAX / 1024,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.checkpoint_sort_mem",
+							"Maximum memory used to sort the free extents lists of a tree on checkpoint.",
+							"Larger lists are sorted in runs, which are merged via a temporary file.",
+							&checkpoint_sort_mem,
+							65536,
+							8,
+							MaxAllocSize / 1024,
+							PGC_SIGHUP,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.xids_queue_per_backend",
+							"Sets the size of the checkpoint xids queue per backend.",
+							"Backends committing during the checkpoint put their undo "
+							"locations to the queue.  A backend has to flush the "
+							"queue itself if it is full.",
+							&xids_queue_per_backend,
+							64,
+							4,
+							65536,
 							PGC_POSTMASTER,
 							0,
 							NULL,
 							NULL,
 							NULL);
 
-	DefineCustomBoolVariable("orioledb.use_mmap",
-							 "Store data in the mmap'ed file.",
-							 NULL,
-							 &use_mmap,
-							 false,
-							 PGC_POSTMASTER,
+	DefineCustomBoolVariable("orioledb.scan_resistant_seq_scan",
+							 "Prevents sequential scans from evicting the hot pages.",
+							 "Pages loaded by sequential scans get the lowest "
+							 "usage count, and the scans don't increase usage "
+							 "counts of the pages they read.",
+							 &scan_resistant_seq_scan,
+							 true,
+							 PGC_USERSET,
 							 0,
 							 NULL,
 							 NULL,
 							 NULL);
 
-	DefineCustomStringVariable("orioledb.device_filename",
-							   "Data file for mmap.",
-							   NULL,
+	DefineCustomBoolVariable("orioledb.scan_resistant_sampling",
+							 "Prevents sampling scans from evicting the hot pages.",
+							 "The same as orioledb.scan_resistant_seq_scan, but "
+							 "for the sampling scans of ANALYZE.",
+							 &scan_resistant_sampling,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.sampling_skip_pages",
+							 "Lets sampling scans skip the internal pages having no sampled leaves.",
+							 "The number of leaves under the skipped pages is "
+							 "estimated by the pages read so far, so ANALYZE "
+							 "reads the internal pages proportionally to the "
+							 "sample size.",
+							 &sampling_skip_pages,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.seq_scan_qual_pushdown",
+							 "Evaluates simple quals of sequential scans against the tuples in the leaf pages.",
+							 "Comparisons of fixed-width columns with constants "
+							 "are checked before the tuples are copied out of "
+							 "the pages and formed into the slots.",
+							 &seq_scan_qual_pushdown,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.index_only_scan_all_visible",
+							 "Costs index-only scans of OrioleDB tables as never visiting the primary tree.",
+							 "Index-only scans return the tuples straight from "
+							 "the secondary index, whose undo serves the "
+							 "visibility checks.  So the planner may treat the "
+							 "table as all-visible.",
+							 &index_only_scan_all_visible,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.index_insert_prefetch",
+							 "Prefetches the evicted leaves of the secondary indices before inserting into them.",
+							 NULL,
+							 &index_insert_prefetch,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_parallel_bitmap_scan",
+							 "Enables the planner's use of parallel bitmap scans of OrioleDB tables.",
+							 "The first participant builds the key bitmap in "
+							 "the shared memory, then all the participants "
+							 "scan the primary tree in parallel.",
+							 &enable_parallel_bitmap_scan,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_parallel_index_scan",
+							 "Enables the planner's use of parallel primary index scans of OrioleDB tables.",
+							 "The participants split the scanned key range by "
+							 "the separator keys of the internal pages and scan "
+							 "the chunks in order.",
+							 &enable_parallel_index_scan,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_skip_scan",
+							 "Enables skip scans of OrioleDB indexes having no quals on the first column.",
+							 "The scan of such an index repositions over the "
+							 "values of the first column and searches the "
+							 "range of the next columns for each of them.",
+							 &enable_skip_scan,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_tree_statistics",
+							 "Makes the planner count only not in-memory pages of OrioleDB trees as I/O.",
+							 "The in-memory fraction of each tree is estimated by "
+							 "sampling its internal pages, which count their "
+							 "on-disk downlinks.",
+							 &enable_tree_statistics,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_count_pushdown",
+							 "Enables the count scan answering count(*) over OrioleDB tables.",
+							 "The count scan counts the visible tuples in the "
+							 "primary tree leaves without forming them.",
+							 &enable_count_pushdown,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.standby_nowait_reads",
+							 "Lets hot standby queries read pages modified by recovery from undo.",
+							 "Instead of waiting for the recovery worker to "
+							 "finish the page modification, the query reads "
+							 "the page-level undo image once it serves the "
+							 "query snapshot.",
+							 &standby_nowait_reads,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.page_pool_numa_nodes",
+							"Number of NUMA nodes to partition the page pools across.",
+							"Each page pool is split into equal parts bound to "
+							"the NUMA nodes, and backends allocate pages from "
+							"the part of their node first.  1 disables.",
+							&page_pool_numa_nodes,
+							1,
+							1,
+							PPOOL_MAX_NUMA_NODES,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.free_pages_low_watermark",
+							"Percentage of free pages in a page pool below which "
+							"background writers start eviction.",
+							NULL,
+							&free_pages_low_watermark,
+							5,
+							0,
+							50,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.free_pages_high_watermark",
+							"Percentage of free pages in a page pool background "
+							"writers evict up to.",
+							NULL,
+							&free_pages_high_watermark,
+							10,
+							0,
+							50,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.database_pool_quota",
+							"Percentage of a page pool a database can occupy before "
+							"its pages are evicted first, 0 disables the quota.",
+							NULL,
+							&database_pool_quota,
+							0,
+							0,
+							100,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.table_pool_quota",
+							"Percentage of a page pool a table or index tree can occupy "
+							"before its pages are evicted first, 0 disables the quota.",
+							NULL,
+							&table_pool_quota,
+							0,
+							0,
+							100,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.compressed_cache_size",
+							"Size of the shared cache of compressed images of evicted "
+							"pages, 0 disables the cache.",
+							NULL,
+							&compressed_cache_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.undo_page_cache_size",
+							"Size of the shared cache of the historical page images "
+							"reconstructed from undo, 0 disables the cache.",
+							NULL,
+							&undo_page_cache_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.zone_map_size",
+							"Size of the shared cache of the column summaries of the "
+							"on-disk leaf pages, 0 disables the cache.",
+							NULL,
+							&zone_map_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.tree_stats_max",
+							"Maximum number of trees tracked by the cumulative "
+							"cache and I/O statistics, 0 disables the statistics.",
+							NULL,
+							&tree_stats_max,
+							0,
+							0,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.page_wait_sample_rate",
+							"Every n-th page wait of the backend is timed for the "
+							"page wait histograms, 0 disables the sampling.",
+							NULL,
+							&page_wait_sample_rate,
+							0,
+							0,
+							INT_MAX,
+							PGC_SUSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.explain_io_details",
+							 "Shows the page reads from disk and S3, the undo page "
+							 "images, TOAST chunks, visibility checks and the "
+							 "I/O time in EXPLAIN (ANALYZE, BUFFERS).",
+							 NULL,
+							 &explain_io_details,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.undo_image_limit",
+							"Limits the size of the page images a statement "
+							"reconstructs from undo, 0 disables the limit.",
+							NULL,
+							&undo_image_limit,
+							0,
+							0,
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.undo_disk_read_limit",
+							"Limits the undo a statement reads from disk to "
+							"reconstruct the page images, 0 disables the limit.",
+							NULL,
+							&undo_disk_read_limit,
+							0,
+							0,
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.undo_limit_error",
+							 "Cancels the statement exceeding the undo limits "
+							 "instead of warning.",
+							 NULL,
+							 &undo_limit_error,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.op_sampling_history_size",
+							"Number of the samples of OrioleDB operations kept in "
+							"the shared memory, 0 disables the sampling.",
+							NULL,
+							&op_sampling_history_size,
+							0,
+							0,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.op_sampling_period",
+							"Period of sampling of OrioleDB operations.",
+							NULL,
+							&op_sampling_period,
+							10,
+							1,
+							60000,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.backend_memory_soft_limit",
+							"Memory of the OrioleDB caches of a backend, which "
+							"makes it shed the caches at the end of the transaction.",
+							"Zero disables the limit.",
+							&backend_memory_soft_limit,
+							0,
+							0,
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.root_info_cache_size",
+							"Size of the shared cache in front of the shared root "
+							"info tree, 0 disables the cache.",
+							NULL,
+							&root_info_cache_guc,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.bgwriter_num_workers",
+							"Number of background writers.",
+							NULL,
+							&bgwriter_num_workers,
+							1,
+							1,
+							MAX_BACKENDS,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.eviction_dirty_skips",
+							"Number of dirty eviction candidates the clock gives another chance before evicting one.",
+							"0 evicts the dirty pages as the clean ones.",
+							&eviction_dirty_skips,
+							0,
+							0,
+							1024,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_background_merge",
+							 "Enable background worker merging sparse B-tree leaf pages.",
+							 NULL,
+							 &enable_background_merge,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.enable_compaction",
+							 "Enable background worker rewriting the trees requested by orioledb_compact() in the key order.",
+							 NULL,
+							 &enable_compaction,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.compaction_pause",
+							 "Pause the background compaction worker.",
+							 NULL,
+							 &compaction_pause,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.prewarm",
+							 "Save the hot pages at checkpoints and load them after restart.",
+							 NULL,
+							 &enable_prewarm,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.replica_prewarm",
+							 "Ship the hot pages of the primary to the standbys and load them there.",
+							 "The primary logs its hot leaves at every "
+							 "checkpoint, and the standby loads them in the "
+							 "background till the promotion.",
+							 &replica_prewarm,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.prewarm_workers",
+							"Sets the number of the workers loading the hot pages after restart.",
+							NULL,
+							&prewarm_workers_num,
+							1,
+							1,
+							64,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.logical_apply_batch_size",
+							"Sets the number of the inserts the logical replication apply worker buffers per table.",
+							"The buffered inserts are done in the primary key order. "
+							"Values of 0 and 1 disable the buffering.",
+							&logical_apply_batch_size,
+							1000,
+							0,
+							100000,
+							PGC_SUSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.compress_dictionaries",
+							 "Train per-tree dictionaries for the compressed trees at checkpoints.",
+							 NULL,
+							 &compress_dictionaries,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.page_checksums",
+							 "Write the checksums of the page images to verify them on reads.",
+							 NULL,
+							 &page_checksums,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("orioledb.compress_auto",
+							 "Select the compression level of the compressed trees automatically at checkpoints.",
+							 NULL,
+							 &compress_auto,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.compress_auto_cpu_cost",
+							"Space saved by the compression, which is worth a millisecond of CPU time.",
+							"Used by the automatic selection of the compression level.",
+							&compress_auto_cpu_cost,
+							16,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.compress_workers",
+							"Number of background workers compressing pages for the checkpointer.",
+							NULL,
+							&compress_workers_num,
+							0,
+							0,
+							MAX_BACKENDS,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.checkpoint_sync_workers",
+							"Number of background workers syncing the data files for the checkpointer.",
+							NULL,
+							&checkpoint_sync_workers_num,
+							0,
+							0,
+							MAX_BACKENDS,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.background_merge_pages",
+							"Maximum number of pages examined by the background merge worker per round.",
+							NULL,
+							&background_merge_pages,
+							1024,
+							1,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.background_merge_delay",
+							"Sleep time between background merge worker rounds.",
+							NULL,
+							&background_merge_delay,
+							1000,
+							1,
+							60000,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.split_fix_delay",
+							"Time after which the background writer fixes the split broken by an error, -1 disables.",
+							NULL,
+							&split_fix_delay,
+							-1,
+							-1,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.lazy_tree_cleanup",
+							 "Lets the background writer release the pages and "
+							 "the files of the dropped and truncated trees.",
+							 NULL,
+							 &lazy_tree_cleanup,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.compaction_pages",
+							"Maximum number of leaf pages rewritten by the compaction worker per checkpoint.",
+							NULL,
+							&compaction_pages,
+							1024,
+							1,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.compaction_delay",
+							"Sleep time between compaction worker rounds.",
+							NULL,
+							&compaction_delay,
+							1000,
+							1,
+							60000,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.verify_workers",
+							"Number of background workers verifying the trees requested by orioledb_verify().",
+							NULL,
+							&verify_workers_num,
+							0,
+							0,
+							32,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.verify_pages",
+							"Maximum number of leaf pages verified by a verify worker per round.",
+							NULL,
+							&verify_pages,
+							64,
+							1,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.verify_delay",
+							"Sleep time between verify worker rounds.",
+							NULL,
+							&verify_delay,
+							100,
+							1,
+							60000,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.max_io_concurrency",
+							"Number of maximum concurrent IO operations.",
+							NULL,
+							&max_io_concurrency,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomEnumVariable("orioledb.io_method",
+							 "Method of the checkpointer leaf page writes.",
+							 "With io_uring, the writes are asynchronous.",
+							 &io_method,
+							 OIOMethodSync,
+							 io_method_options,
+							 PGC_SIGHUP,
+							 0,
+							 check_io_method,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("orioledb.io_uring_depth",
+							"Maximum number of the asynchronous page writes in flight per process.",
+							NULL,
+							&io_uring_depth,
+							32,
+							1,
+							128,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.write_combine_limit",
+							"Maximum number of contiguous pages combined into a single checkpoint write.",
+							"Value 1 disables the write combining.",
+							&write_combine_limit,
+							128,
+							1,
+							128,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.iterator_prefetch_pages",
+							"Number of evicted leaf pages to prefetch ahead of B-tree iterators.",
+							"The value is also limited by orioledb.max_io_concurrency.",
+							&iterator_prefetch_pages,
+							16,
+							0,
+							1024,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.seq_scan_readahead_pages",
+							"Number of evicted pages to read ahead during the disk phase of sequential scans.",
+							NULL,
+							&seq_scan_readahead_pages,
+							128,
+							0,
+							65536,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.use_mmap",
+							 "Store data in the mmap'ed file.",
+							 NULL,
+							 &use_mmap,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomStringVariable("orioledb.device_filename",
+							   "Comma-separated list of the devices for the block device mode.",
+							   "The data is striped across the devices.",
 							   &device_filename,
 							   NULL,
 							   PGC_POSTMASTER,
@@ -589,7 +1936,7 @@ _PG_init(void)
 							   NULL);
 
 	DefineCustomIntVariable("orioledb.device_length",
-							"Size of mmap.",
+							"Size of every device.",
 							NULL,
 							&device_length_guc,
 							0,
@@ -601,6 +1948,19 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.device_stripe_size",
+							"Size of the stripe of the data striped across the devices.",
+							"Must not be changed once the data is written.",
+							&device_stripe_size_guc,
+							128,
+							ORIOLEDB_BLCKSZ / BLCKSZ,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_BLOCKS,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomIntVariable("orioledb.default_compress",
 							"Default compression level.",
 							NULL,
@@ -640,6 +2000,18 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomEnumVariable("orioledb.default_compress_codec",
+							 "Default codec for the compression levels given without one.",
+							 NULL,
+							 &default_compress_codec,
+							 O_COMPRESS_CODEC_ZSTD,
+							 compress_codec_options,
+							 PGC_USERSET,
+							 0,
+							 check_default_compress_codec,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("orioledb.table_description_compress",
 							 "Display compression column in "
 							 "orioledb_table_description",
@@ -662,6 +2034,17 @@ _PG_init(void)
 							 NULL,
 							 NULL,
 							 NULL);
+
+	DefineCustomBoolVariable("orioledb.direct_io",
+							 "Bypass the OS page cache for the data files.",
+							 "Ignored in the S3 and device modes.",
+							 &orioledb_direct_io,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 check_direct_io,
+							 NULL,
+							 NULL);
 	DefineCustomStringVariable("orioledb.debug_max_bridge_ctid_blkno",
 							   "Sets maximum value for bridge ctid for its overflow testing",
 							   NULL,
@@ -736,6 +2119,34 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.s3_desired_size_max",
+							"The maximum size local OrioleDB data could grow to.",
+							"When set higher than orioledb.s3_desired_size, "
+							"the desired size adapts to the rate of the cold reads.",
+							&s3_desired_size_max,
+							0,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_MB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.s3_cold_read_rate",
+							"The rate of the reads of evicted parts per second, "
+							"which makes the adaptive desired size grow.",
+							NULL,
+							&s3_cold_read_rate,
+							10,
+							1,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomStringVariable("orioledb.s3_host",
 							   "S3 host",
 							   NULL,
@@ -814,6 +2225,82 @@ _PG_init(void)
 							   NULL,
 							   NULL);
 
+	DefineCustomIntVariable("orioledb.s3_multipart_part_size",
+							"The part size of the multipart upload to S3.",
+							"Objects larger than the part size are uploaded "
+							"by parts.",
+							&s3_multipart_part_size,
+							64,
+							5,
+							5 * 1024,
+							PGC_SIGHUP,
+							GUC_UNIT_MB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.s3_file_chunk_size",
+							"The chunk size of the PostgreSQL files put to S3.",
+							"Only the changed chunks of the bigger files are "
+							"put on checkpoint.  Zero puts the whole files.",
+							&s3_file_chunk_size,
+							16,
+							0,
+							1024,
+							PGC_POSTMASTER,
+							GUC_UNIT_MB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("orioledb.s3_cache_size",
+							"The size of the local cache of the evicted S3 file parts.",
+							"Zero disables the cache.",
+							&s3_cache_size,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_UNIT_MB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomStringVariable("orioledb.s3_cache_dir",
+							   "The directory of the local cache of the evicted S3 file parts.",
+							   NULL,
+							   &s3_cache_dir,
+							   "orioledb_s3_cache",
+							   PGC_POSTMASTER,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
+	DefineCustomIntVariable("orioledb.s3_scan_prefetch_pages",
+							"Number of pages ahead of the disk phase of sequential scans to load from S3.",
+							"Zero disables the prefetch.",
+							&s3_scan_prefetch_pages,
+							1024,
+							0,
+							65536,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("orioledb.s3_backfill",
+							 "Load all the data file parts from S3 in background after the start.",
+							 NULL,
+							 &s3_backfill,
+							 false,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("orioledb.enable_rewind",
 							 "Enable rewind for OrioleDB tables",
 							 NULL,
@@ -850,6 +2337,30 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("orioledb.rewind_parallel_workers",
+							"Number of workers applying the undo of the rewound transactions in parallel.",
+							NULL,
+							&rewind_parallel_workers,
+							2,
+							0,
+							MAX_BACKENDS,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomStringVariable("orioledb.as_of_timestamp",
+							   "Makes the reads of OrioleDB tables see the data as of the given past timestamp.",
+							   "Empty string means the current data.  Requires orioledb.enable_rewind.",
+							   &as_of_timestamp_string,
+							   "",
+							   PGC_USERSET,
+							   0,
+							   check_as_of_timestamp,
+							   assign_as_of_timestamp,
+							   NULL);
+
 	if (orioledb_s3_mode)
 	{
 		if (!s3_host || !s3_region || !s3_accesskey || !s3_secretkey)
@@ -864,14 +2375,46 @@ _PG_init(void)
 	}
 
 	main_buffers_count = ((Size) main_buffers_guc * (Size) BLCKSZ) / ORIOLEDB_BLCKSZ;
+	main_buffers_initial_count = main_buffers_count;
+	/* The pages up to the maximum are reserved, the rest of them retired */
+	if (main_buffers_max_guc > main_buffers_guc)
+		main_buffers_count = ((Size) main_buffers_max_guc * (Size) BLCKSZ) / ORIOLEDB_BLCKSZ;
 	free_tree_buffers_count = ((Size) free_tree_buffers_guc * (Size) BLCKSZ) / ORIOLEDB_BLCKSZ;
 	catalog_buffers_count = ((Size) catalog_buffers_guc * (Size) BLCKSZ) / ORIOLEDB_BLCKSZ;
+	free_tree_buffers_initial_count = free_tree_buffers_count;
+	catalog_buffers_initial_count = catalog_buffers_count;
+	pool_min_count = debug_disable_pools_limit ? 1 :
+		((Size) min_pool_size * (Size) BLCKSZ) / ORIOLEDB_BLCKSZ;
+
+	/*
+	 * Reserve the room for balancing: the secondary pools grow by the pages
+	 * the main pool lends, and the main pool grows by the pages they lend.
+	 */
+	if (balance_pools)
+	{
+		Size		mainLend = (main_buffers_initial_count *
+								PPOOL_BALANCE_MAIN_LEND_PERCENT) / 100;
+
+		free_tree_buffers_count = Min(free_tree_buffers_count * PPOOL_BALANCE_GROW_FACTOR,
+									  free_tree_buffers_count + mainLend);
+		catalog_buffers_count = Min(catalog_buffers_count * PPOOL_BALANCE_GROW_FACTOR,
+									catalog_buffers_count + mainLend);
+		main_buffers_count = Max(main_buffers_count,
+								 main_buffers_initial_count +
+								 (free_tree_buffers_initial_count - pool_min_count) +
+								 (catalog_buffers_initial_count - pool_min_count));
+	}
 
 	main_buffers_offset = free_tree_buffers_count + catalog_buffers_count;
 
 	orioledb_buffers_count = main_buffers_count + free_tree_buffers_count + catalog_buffers_count;
 	orioledb_buffers_size = mul_size(orioledb_buffers_count, ORIOLEDB_BLCKSZ);
 
+	compressed_cache_size = (Size) compressed_cache_guc * (Size) BLCKSZ;
+	undo_page_cache_size = (Size) undo_page_cache_guc * (Size) BLCKSZ;
+	zone_map_size = (Size) zone_map_guc * (Size) BLCKSZ;
+	root_info_cache_size = (Size) root_info_cache_guc * (Size) BLCKSZ;
+
 	undo_circular_buffer_size = ((Size) undo_buffers_guc * BLCKSZ) / 2;
 	undo_circular_buffer_size /= ORIOLEDB_BLCKSZ;
 	undo_buffers_count = (uint32) undo_circular_buffer_size;
@@ -913,40 +2456,47 @@ _PG_init(void)
 	for (i = 0; i < OPagePoolTypesCount; i++)
 		page_pools_size[i] = CACHELINEALIGN(page_pools_size[i]);
 
-	if (device_filename)
-	{
-		device_fd = BasicOpenFile(device_filename, O_RDWR);
-		device_length = (Size) device_length_guc * BLCKSZ;
-		if (device_fd < 0)
-		{
-			elog(LOG, "can't open device file %s", device_filename);
-		}
-		else if (use_mmap)
-		{
-			mmap_data = mmap(NULL,
-							 device_length,
-							 PROT_READ | PROT_WRITE,
-							 MAP_FILE | MAP_SHARED,
-							 device_fd,
-							 0);
-			if (!mmap_data)
-				elog(LOG, "can't map device file %s", device_filename);
+	o_devices_open();
 
-		}
-		if (device_fd >= 0)
-			use_device = true;
-		if (!mmap_data)
-			use_mmap = false;
-	}
-	else
+	/* The S3 data files and the device are used only via the page cache */
+	if (orioledb_direct_io && (orioledb_s3_mode || use_device))
 	{
-		use_mmap = false;
-		use_device = false;
+		elog(LOG, "orioledb.direct_io is ignored in the S3 and device modes");
+		orioledb_direct_io = false;
 	}
 
 	/* Register background writers */
 	for (i = 0; i < bgwriter_num_workers; i++)
-		register_bgwriter();
+		register_bgwriter(i);
+
+	if (enable_background_merge)
+		register_merge_worker();
+
+	if (enable_compaction)
+		register_compaction_worker();
+
+	/* Register tree verification workers */
+	for (i = 0; i < verify_workers_num; i++)
+		register_verify_worker(i);
+
+	if (op_sampling_history_size > 0)
+		register_op_sampler();
+
+	/* Register compression workers */
+	for (i = 0; i < compress_workers_num; i++)
+		register_compress_worker(i);
+
+	/* Register checkpoint sync workers */
+	for (i = 0; i < checkpoint_sync_workers_num; i++)
+		register_sync_worker(i);
+
+	if (enable_prewarm)
+	{
+		for (i = 0; i < prewarm_workers_num; i++)
+			register_prewarm_worker(i);
+	}
+	if (replica_prewarm)
+		register_replica_prewarm_worker();
 
 	if (enable_rewind)
 		register_rewind_worker();
@@ -972,17 +2522,23 @@ _PG_init(void)
 	for (i = 0; orioledb_s3_mode && (i < s3_num_workers); i++)
 		register_s3worker(i);
 
+	if (orioledb_s3_mode && s3_backfill)
+		register_s3_backfill_worker();
+
 	/* Register custom deTOAST function */
 	register_o_detoast_func(o_detoast);
 
+	o_memory_init();
 	o_tableam_descr_init();
 	o_compress_init();
 	o_sys_caches_init();
 	RegisterCustomScanMethods(&o_scan_methods);
+	RegisterCustomScanMethods(&o_count_scan_methods);
 
-	btree_insert_context = AllocSetContextCreate(TopMemoryContext,
+	btree_insert_context = AllocSetContextCreate(OrioleDBTopMemoryContext,
 												 "orioledb B-tree insert context",
 												 ALLOCSET_DEFAULT_SIZES);
+	o_memory_register(OMemoryBTree, btree_insert_context);
 
 	btree_seqscan_context = AllocSetContextCreate(TopTransactionContext,
 												  "orioledb B-tree seqential scans context",
@@ -997,6 +2553,10 @@ _PG_init(void)
 	old_set_rel_pathlist_hook = set_rel_pathlist_hook;
 	set_rel_pathlist_hook = orioledb_set_rel_pathlist_hook;
 	set_plain_rel_pathlist_hook = orioledb_set_plain_rel_pathlist_hook;
+	prev_ExecutorStart_hook = ExecutorStart_hook;
+	ExecutorStart_hook = orioledb_executor_start_hook;
+	prev_create_upper_paths_hook = create_upper_paths_hook;
+	create_upper_paths_hook = orioledb_create_upper_paths_hook;
 	RegisterXactCallback(undo_xact_callback, NULL);
 	RegisterSubXactCallback(undo_subxact_callback, NULL);
 	CacheRegisterUsercacheCallback(orioledb_usercache_hook, PointerGetDatum(NULL));
@@ -1092,6 +2652,134 @@ o_proc_shmem_init(Pointer ptr, bool found)
 	}
 }
 
+/*
+ * Checks if o_shared_buffers need a mapping of their own, apart from the
+ * main shared memory segment.  That's impossible when the children don't
+ * inherit the mappings of the postmaster.
+ */
+static bool
+o_shared_buffers_separate(void)
+{
+#ifndef EXEC_BACKEND
+	/* the own mapping also aligns the pages for the direct IO */
+	return shared_buffers_huge_pages != OSharedBuffersHugePagesOff ||
+		shared_buffers_transparent_huge_pages || shared_buffers_lock ||
+		orioledb_direct_io;
+#else
+	return false;
+#endif
+}
+
+#ifdef MAP_HUGETLB
+static Size
+o_get_huge_page_size(void)
+{
+	Size		result = 2 * 1024 * 1024;
+	FILE	   *fp;
+	char		buf[128];
+
+	if (shared_buffers_huge_page_size != 0)
+		return (Size) shared_buffers_huge_page_size * 1024;
+
+	fp = AllocateFile("/proc/meminfo", "r");
+	if (fp)
+	{
+		unsigned long sz;
+
+		while (fgets(buf, sizeof(buf), fp))
+		{
+			if (sscanf(buf, "Hugepagesize: %lu kB", &sz) == 1)
+			{
+				result = (Size) sz * 1024;
+				break;
+			}
+		}
+		FreeFile(fp);
+	}
+	return result;
+}
+#endif
+
+/*
+ * Maps o_shared_buffers with the huge pages if requested, falling back to
+ * the regular pages unless orioledb.shared_buffers_huge_pages = on.  The
+ * mapping survives the shared memory reinitialization after a crash.
+ */
+static Pointer
+o_shared_buffers_map(void)
+{
+	void	   *ptr = MAP_FAILED;
+	Size		size = orioledb_buffers_size;
+
+	if (o_shared_buffers_mapping)
+		return o_shared_buffers_mapping;
+
+#ifdef MAP_HUGETLB
+	if (shared_buffers_huge_pages != OSharedBuffersHugePagesOff)
+	{
+		Size		hugePageSize = o_get_huge_page_size();
+		int			flags = MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB;
+
+#ifdef MAP_HUGE_SHIFT
+		if (shared_buffers_huge_page_size != 0)
+			flags |= pg_ceil_log2_64(hugePageSize) << MAP_HUGE_SHIFT;
+#endif
+		size = TYPEALIGN(hugePageSize, orioledb_buffers_size);
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (ptr != MAP_FAILED)
+			o_shared_buffers_mapping_huge_page_size = hugePageSize;
+		else if (shared_buffers_huge_pages == OSharedBuffersHugePagesOn)
+			ereport(FATAL,
+					(errmsg("could not map %zu bytes of orioledb shared buffers with huge pages of %zu bytes: %m",
+							size, hugePageSize),
+					 errhint("Reserve more huge pages of this size in the kernel "
+							 "or set orioledb.shared_buffers_huge_pages = try.")));
+		else
+			ereport(LOG,
+					(errmsg("could not map %zu bytes of orioledb shared buffers with huge pages of %zu bytes: %m",
+							size, hugePageSize),
+					 errdetail("Falling back to the regular pages.")));
+	}
+#else
+	if (shared_buffers_huge_pages == OSharedBuffersHugePagesOn)
+		ereport(FATAL,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("huge pages for orioledb shared buffers are not supported on this platform")));
+#endif
+
+	if (ptr == MAP_FAILED)
+	{
+		size = orioledb_buffers_size;
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			ereport(FATAL,
+					(errmsg("could not map %zu bytes of orioledb shared buffers: %m",
+							size)));
+#ifdef MADV_HUGEPAGE
+		if (shared_buffers_transparent_huge_pages &&
+			madvise(ptr, size, MADV_HUGEPAGE) != 0)
+			ereport(LOG,
+					(errmsg("could not enable transparent huge pages for orioledb shared buffers: %m")));
+#endif
+	}
+
+	if (shared_buffers_lock)
+	{
+		if (mlock(ptr, size) == 0)
+			o_shared_buffers_mapping_locked = true;
+		else
+			ereport(LOG,
+					(errmsg("could not lock %zu bytes of orioledb shared buffers in memory: %m",
+							size),
+					 errhint("Check the RLIMIT_MEMLOCK limit of the postmaster.")));
+	}
+
+	o_shared_buffers_mapping = (Pointer) ptr;
+	o_shared_buffers_mapping_size = size;
+	return o_shared_buffers_mapping;
+}
+
 static Size
 ppools_shmem_needs(void)
 {
@@ -1100,7 +2788,8 @@ ppools_shmem_needs(void)
 
 	for (i = 0; i < OPagePoolTypesCount; i++)
 		size = add_size(size, page_pools_size[i]);
-	size = add_size(size, orioledb_buffers_size);
+	if (!o_shared_buffers_separate())
+		size = add_size(size, orioledb_buffers_size);
 	size = add_size(size, page_descs_size);
 	return size;
 }
@@ -1116,8 +2805,15 @@ ppools_shmem_init(Pointer ptr, bool found)
 		page_pools_ptr[i] = ptr;
 		ptr += page_pools_size[i];
 	}
-	o_shared_buffers = ptr;
-	ptr += orioledb_buffers_size;
+	if (o_shared_buffers_separate())
+	{
+		o_shared_buffers = o_shared_buffers_map();
+	}
+	else
+	{
+		o_shared_buffers = ptr;
+		ptr += orioledb_buffers_size;
+	}
 	page_descs = (OrioleDBPageDesc *) ptr;
 
 	for (i = 0; i < OPagePoolTypesCount; i++)
@@ -1145,6 +2841,16 @@ ppools_shmem_init(Pointer ptr, bool found)
 			page_descs[i].type = 0;
 			page_descs[i].flags = 0;
 		}
+
+		ppool_init_size(&page_pools[OPagePoolFreeTree],
+						free_tree_buffers_initial_count,
+						pool_min_count);
+		ppool_init_size(&page_pools[OPagePoolCatalog],
+						catalog_buffers_initial_count,
+						pool_min_count);
+		ppool_init_size(&page_pools[OPagePoolMain],
+						main_buffers_initial_count,
+						pool_min_count);
 	}
 }
 
@@ -1167,11 +2873,16 @@ orioledb_memsize(void)
 static void
 orioledb_on_shmem_exit(int code, Datum arg)
 {
+	if (MyProc && code == 0)
+		btree_return_ctid_leases();
+
 	if (MyProc)
-		pg_atomic_write_u64(&oProcData[MYPROCNUMBER].xmin, InvalidOXid);
+		set_my_xmin(InvalidOXid);
 
 	if (orioledb_s3_mode)
 		s3_delete_lock_file();
+
+	tree_stats_flush();
 }
 
 /*
@@ -1223,6 +2934,7 @@ orioledb_shmem_startup(void)
 
 	init_btree_io_lwlocks();
 	o_btree_init_unique_lwlocks();
+	page_state_init_wait_events();
 
 	before_shmem_exit(orioledb_on_shmem_exit, (Datum) 0);
 
@@ -1231,19 +2943,6 @@ orioledb_shmem_startup(void)
 	shared_segment_initialized = true;
 }
 
-uint64
-orioledb_device_alloc(struct BTreeDescr *descr, uint32 size)
-{
-	uint64		result;
-
-	result = pg_atomic_fetch_add_u64(&checkpoint_state->mmapDataLength, size);
-
-	if (result + size > device_length)
-		elog(ERROR, "device file overflow");
-
-	return result;
-}
-
 void
 orioledb_check_shmem(void)
 {
@@ -1355,101 +3054,309 @@ pg_mkdir_p(char *path, int omode)
 				retval;
 	char	   *p;
 
-	retval = 0;
-	p = path;
+	retval = 0;
+	p = path;
+
+#ifdef WIN32
+	/* skip network and drive specifiers for win32 */
+	if (strlen(p) >= 2)
+	{
+		if (p[0] == '/' && p[1] == '/')
+		{
+			/* network drive */
+			p = strstr(p + 2, "/");
+			if (p == NULL)
+			{
+				errno = EINVAL;
+				return -1;
+			}
+		}
+		else if (p[1] == ':' &&
+				 ((p[0] >= 'a' && p[0] <= 'z') ||
+				  (p[0] >= 'A' && p[0] <= 'Z')))
+		{
+			/* local drive */
+			p += 2;
+		}
+	}
+#endif
+
+	/*
+	 * POSIX 1003.2: For each dir operand that does not name an existing
+	 * directory, effects equivalent to those caused by the following command
+	 * shall occur:
+	 *
+	 * mkdir -p -m $(umask -S),u+wx $(dirname dir) && mkdir [-m mode] dir
+	 *
+	 * We change the user's umask and then restore it, instead of doing
+	 * chmod's.  Note we assume umask() can't change errno.
+	 */
+	oumask = umask(0);
+	numask = oumask & ~(S_IWUSR | S_IXUSR);
+	(void) umask(numask);
+
+	if (p[0] == '/')			/* Skip leading '/'. */
+		++p;
+	for (last = 0; !last; ++p)
+	{
+		if (p[0] == '\0')
+			last = 1;
+		else if (p[0] != '/')
+			continue;
+		*p = '\0';
+		if (!last && p[1] == '\0')
+			last = 1;
+
+		if (last)
+			(void) umask(oumask);
+
+		/* check for pre-existing directory */
+		if (stat(path, &sb) == 0)
+		{
+			if (!S_ISDIR(sb.st_mode))
+			{
+				if (last)
+					errno = EEXIST;
+				else
+					errno = ENOTDIR;
+				retval = -1;
+				break;
+			}
+		}
+		else if (mkdir(path, last ? omode : S_IRWXU | S_IRWXG | S_IRWXO) < 0)
+		{
+			retval = -1;
+			break;
+		}
+		if (!last)
+			*p = '/';
+	}
+
+	/* ensure we restored umask */
+	(void) umask(oumask);
+
+	return retval;
+}
+
+Datum
+orioledb_page_stats(PG_FUNCTION_ARGS)
+{
+	Datum		values[5];
+	bool		nulls[5];
+	int			i;
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/*
+	 * Build and return the tuple
+	 */
+	MemSet(nulls, 0, sizeof(nulls));
+	for (i = 0; i < OPagePoolTypesCount; i++)
+	{
+		int64		num_free_pages,
+					total_num_pages;
+
+		total_num_pages = (int64) ppool_size(&page_pools[i]);
+
+		if (i == OPagePoolMain)
+			values[0] = PointerGetDatum(cstring_to_text("main"));
+		else if (i == OPagePoolFreeTree)
+			values[0] = PointerGetDatum(cstring_to_text("free_tree"));
+		else if (i == OPagePoolCatalog)
+			values[0] = PointerGetDatum(cstring_to_text("catalog"));
+		num_free_pages = (int64) ppool_free_pages_count(&page_pools[i]);
+		values[1] = Int64GetDatum(total_num_pages - num_free_pages);
+		values[2] = Int64GetDatum(num_free_pages);
+		values[3] = Int64GetDatum((int64) ppool_dirty_pages_count(&page_pools[i]));
+		values[4] = Int64GetDatum(total_num_pages);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Reports how often the backends had to evict pages themselves, and the work
+ * done by background writers instead.
+ */
+Datum
+orioledb_eviction_stats(PG_FUNCTION_ARGS)
+{
+	Datum		values[5];
+	bool		nulls[5];
+	int			i;
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	MemSet(nulls, 0, sizeof(nulls));
+	for (i = 0; i < OPagePoolTypesCount; i++)
+	{
+		OPagePoolStats *stats = page_pools[i].stats;
+
+		if (i == OPagePoolMain)
+			values[0] = PointerGetDatum(cstring_to_text("main"));
+		else if (i == OPagePoolFreeTree)
+			values[0] = PointerGetDatum(cstring_to_text("free_tree"));
+		else if (i == OPagePoolCatalog)
+			values[0] = PointerGetDatum(cstring_to_text("catalog"));
+		values[1] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->stalls));
+		values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->stallTime));
+		values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->bgwriterEvictions));
+		values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->bgwriterWakeups));
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Reports the state of the usage count map and the clock of each page pool.
+ * Usage levels are reported relative to the current epoch from the coldest
+ * (the next to be evicted) to the hottest one.  Counters are read without
+ * locks, so the values might be slightly inconsistent with each other.
+ */
+Datum
+orioledb_ucm_stats(PG_FUNCTION_ARGS)
+{
+	Datum		values[18];
+	bool		nulls[18];
+	int			i,
+				j;
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
 
-#ifdef WIN32
-	/* skip network and drive specifiers for win32 */
-	if (strlen(p) >= 2)
-	{
-		if (p[0] == '/' && p[1] == '/')
-		{
-			/* network drive */
-			p = strstr(p + 2, "/");
-			if (p == NULL)
-			{
-				errno = EINVAL;
-				return -1;
-			}
-		}
-		else if (p[1] == ':' &&
-				 ((p[0] >= 'a' && p[0] <= 'z') ||
-				  (p[0] >= 'A' && p[0] <= 'Z')))
-		{
-			/* local drive */
-			p += 2;
-		}
-	}
-#endif
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
 
-	/*
-	 * POSIX 1003.2: For each dir operand that does not name an existing
-	 * directory, effects equivalent to those caused by the following command
-	 * shall occur:
-	 *
-	 * mkdir -p -m $(umask -S),u+wx $(dirname dir) && mkdir [-m mode] dir
-	 *
-	 * We change the user's umask and then restore it, instead of doing
-	 * chmod's.  Note we assume umask() can't change errno.
-	 */
-	oumask = umask(0);
-	numask = oumask & ~(S_IWUSR | S_IXUSR);
-	(void) umask(numask);
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
 
-	if (p[0] == '/')			/* Skip leading '/'. */
-		++p;
-	for (last = 0; !last; ++p)
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemSet(nulls, 0, sizeof(nulls));
+	for (i = 0; i < OPagePoolTypesCount; i++)
 	{
-		if (p[0] == '\0')
-			last = 1;
-		else if (p[0] != '/')
-			continue;
-		*p = '\0';
-		if (!last && p[1] == '\0')
-			last = 1;
+		OPagePool  *pool = &page_pools[i];
+		OPagePoolStats *stats = pool->stats;
+		uint64		pages[UCM_LEVELS];
+		Datum		levels[UCM_USAGE_LEVELS];
+		uint32		epoch;
+
+		epoch = pg_atomic_read_u32(pool->ucm.epoch);
+		ucm_level_pages(&pool->ucm, pages);
+		for (j = 0; j < UCM_USAGE_LEVELS; j++)
+			levels[j] = Int64GetDatum((int64) pages[(epoch + j) % UCM_USAGE_LEVELS]);
+
+		values[0] = CStringGetTextDatum(get_ppool_name(i));
+		values[1] = Int32GetDatum((int32) epoch);
+		values[2] = Int64GetDatum((int64) pg_atomic_read_u64(pool->ucm.epochShifts));
+		values[3] = PointerGetDatum(construct_array(levels, UCM_USAGE_LEVELS,
+													INT8OID, sizeof(int64),
+													FLOAT8PASSBYVAL,
+													TYPALIGN_DOUBLE));
+		values[4] = Int64GetDatum((int64) pages[UCM_FREE_PAGES_LEVEL]);
+		values[5] = Int64GetDatum((int64) ppool_free_pages_count(pool));
+		values[6] = Int64GetDatum((int64) ppool_dirty_pages_count(pool));
+		values[7] = Int64GetDatum((int64) ppool_free_pages_low_mark(pool));
+		values[8] = Int64GetDatum((int64) ppool_free_pages_high_mark(pool));
+		values[9] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->backendClockRuns));
+		values[10] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->clockSteps));
+		for (j = 0; j < PPOOL_REJECT_REASONS_NUM; j++)
+			values[11 + j] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->rejected[j]));
+		values[16] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->evictedClean));
+		values[17] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->evictedDirty));
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
 
-		if (last)
-			(void) umask(oumask);
+	MemoryContextSwitchTo(oldcontext);
 
-		/* check for pre-existing directory */
-		if (stat(path, &sb) == 0)
-		{
-			if (!S_ISDIR(sb.st_mode))
-			{
-				if (last)
-					errno = EEXIST;
-				else
-					errno = ENOTDIR;
-				retval = -1;
-				break;
-			}
-		}
-		else if (mkdir(path, last ? omode : S_IRWXU | S_IRWXG | S_IRWXO) < 0)
-		{
-			retval = -1;
-			break;
-		}
-		if (!last)
-			*p = '/';
-	}
+	return (Datum) 0;
+}
 
-	/* ensure we restored umask */
-	(void) umask(oumask);
+typedef struct
+{
+	ORelOids	oids;
+	int			poolType;
+	bool		dirty;
+} OPoolOccupancyItem;
 
-	return retval;
+static int
+pool_occupancy_item_cmp(const void *a, const void *b)
+{
+	const OPoolOccupancyItem *item1 = (const OPoolOccupancyItem *) a;
+	const OPoolOccupancyItem *item2 = (const OPoolOccupancyItem *) b;
+
+	if (item1->poolType != item2->poolType)
+		return item1->poolType < item2->poolType ? -1 : 1;
+	return memcmp(&item1->oids, &item2->oids, sizeof(ORelOids));
 }
 
+/*
+ * Reports the pages occupied by each tree in the page pools.  Page
+ * descriptors are read without locks, so the result is approximate.
+ */
 Datum
-orioledb_page_stats(PG_FUNCTION_ARGS)
+orioledb_pool_occupancy(PG_FUNCTION_ARGS)
 {
-	Datum		values[5];
-	bool		nulls[5];
-	int			i;
+	Datum		values[7];
+	bool		nulls[7];
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
 	TupleDesc	tupdesc;
 	Tuplestorestate *tupstore;
 	MemoryContext per_query_ctx;
 	MemoryContext oldcontext;
+	OPoolOccupancyItem *items;
+	int64		count = 0,
+				i,
+				j;
+	int			poolType;
 
 	orioledb_check_shmem();
 
@@ -1467,34 +3374,201 @@ orioledb_page_stats(PG_FUNCTION_ARGS)
 
 	MemoryContextSwitchTo(oldcontext);
 
-	/*
-	 * Build and return the tuple
-	 */
+	items = (OPoolOccupancyItem *) MemoryContextAllocHuge(CurrentMemoryContext,
+														  sizeof(OPoolOccupancyItem) * orioledb_buffers_count);
+	for (poolType = 0; poolType < OPagePoolTypesCount; poolType++)
+	{
+		OPagePool  *pool = &page_pools[poolType];
+		OInMemoryBlkno blkno;
+
+		for (blkno = pool->offset; blkno < pool->offset + pool->size; blkno++)
+		{
+			OrioleDBPageDesc *pageDesc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+
+			if (!ORelOidsIsValid(pageDesc->oids))
+				continue;
+			items[count].oids = pageDesc->oids;
+			items[count].poolType = poolType;
+			items[count].dirty = IS_DIRTY(blkno);
+			count++;
+		}
+	}
+
+	pg_qsort(items, count, sizeof(OPoolOccupancyItem), pool_occupancy_item_cmp);
+
 	MemSet(nulls, 0, sizeof(nulls));
-	for (i = 0; i < OPagePoolTypesCount; i++)
+	for (i = 0; i < count; i = j)
 	{
-		int64		num_free_pages,
-					total_num_pages;
+		OPagePool  *pool = &page_pools[items[i].poolType];
+		int64		dirty = 0;
 
-		total_num_pages = (int64) page_pools[i].size;
+		for (j = i; j < count && pool_occupancy_item_cmp(&items[i], &items[j]) == 0; j++)
+		{
+			if (items[j].dirty)
+				dirty++;
+		}
 
-		if (i == OPagePoolMain)
+		if (items[i].poolType == OPagePoolMain)
 			values[0] = PointerGetDatum(cstring_to_text("main"));
-		else if (i == OPagePoolFreeTree)
+		else if (items[i].poolType == OPagePoolFreeTree)
 			values[0] = PointerGetDatum(cstring_to_text("free_tree"));
-		else if (i == OPagePoolCatalog)
+		else
 			values[0] = PointerGetDatum(cstring_to_text("catalog"));
-		num_free_pages = (int64) ppool_free_pages_count(&page_pools[i]);
-		values[1] = Int64GetDatum(total_num_pages - num_free_pages);
-		values[2] = Int64GetDatum(num_free_pages);
-		values[3] = Int64GetDatum((int64) ppool_dirty_pages_count(&page_pools[i]));
-		values[4] = Int64GetDatum(total_num_pages);
+		values[1] = ObjectIdGetDatum(items[i].oids.datoid);
+		values[2] = ObjectIdGetDatum(items[i].oids.reloid);
+		values[3] = ObjectIdGetDatum(items[i].oids.relnode);
+		values[4] = Int64GetDatum(j - i);
+		values[5] = Int64GetDatum(dirty);
+		values[6] = BoolGetDatum(ppool_owner_over_quota(pool, items[i].oids));
 		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
 	}
 
+	pfree(items);
+
 	return (Datum) 0;
 }
 
+/*
+ * Returns the amount of the transparent huge pages backing the mapping of
+ * o_shared_buffers in our process, or -1 if unknown.
+ */
+static int64
+o_shared_buffers_thp_size(void)
+{
+	FILE	   *fp;
+	char		buf[256];
+	bool		inMapping = false;
+	int64		result = -1;
+
+	fp = AllocateFile("/proc/self/smaps", "r");
+	if (!fp)
+		return -1;
+
+	while (fgets(buf, sizeof(buf), fp))
+	{
+		unsigned long start,
+					end,
+					sz;
+
+		if (sscanf(buf, "%lx-%lx", &start, &end) == 2)
+		{
+			if (inMapping)
+				break;
+			inMapping = (start == (unsigned long) o_shared_buffers_mapping);
+			if (inMapping)
+				result = 0;
+		}
+		else if (inMapping &&
+				 (sscanf(buf, "AnonHugePages: %lu kB", &sz) == 1 ||
+				  sscanf(buf, "ShmemPmdMapped: %lu kB", &sz) == 1))
+		{
+			result += (int64) sz * 1024;
+		}
+	}
+	FreeFile(fp);
+
+	return result;
+}
+
+/*
+ * Reports how orioledb engine shared buffers are mapped, and how much of
+ * them got huge pages.
+ */
+Datum
+orioledb_shared_buffers_info(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[5];
+	bool		nulls[5] = {false, false, false, false, false};
+
+	orioledb_check_shmem();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[1] = Int64GetDatum((int64) orioledb_buffers_size);
+	if (!o_shared_buffers_mapping)
+	{
+		/* Part of the main shared memory segment, see huge_pages_status */
+		values[0] = PointerGetDatum(cstring_to_text("shared_memory"));
+		nulls[2] = true;
+		nulls[3] = true;
+	}
+	else if (o_shared_buffers_mapping_huge_page_size > 0)
+	{
+		values[0] = PointerGetDatum(cstring_to_text("huge_pages"));
+		values[2] = Int64GetDatum((int64) o_shared_buffers_mapping_huge_page_size);
+		values[3] = Int64GetDatum((int64) o_shared_buffers_mapping_size);
+	}
+	else
+	{
+		int64		thpSize = o_shared_buffers_thp_size();
+
+		values[0] = PointerGetDatum(cstring_to_text("regular_pages"));
+		nulls[2] = true;
+		values[3] = Int64GetDatum(thpSize);
+		nulls[3] = (thpSize < 0);
+	}
+	values[4] = BoolGetDatum(o_shared_buffers_mapping_locked);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * Resizes the main shared buffers within orioledb.main_buffers_max.  The size
+ * is given in bytes.  Returns the number of pages past the new size, which
+ * are still in use and will be retired once evicted.
+ */
+Datum
+orioledb_resize_main_buffers(PG_FUNCTION_ARGS)
+{
+	int64		size = PG_GETARG_INT64(0);
+	OPagePool  *pool = &page_pools[OPagePoolMain];
+	int64		minSize;
+
+	orioledb_check_shmem();
+
+	/* The same limit as orioledb.main_buffers has */
+	minSize = (int64) pool->resize->minSize;
+
+	if (size < minSize * ORIOLEDB_BLCKSZ ||
+		size > (int64) pool->size * ORIOLEDB_BLCKSZ)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("main buffers size must be between " INT64_FORMAT " and " INT64_FORMAT " bytes",
+						minSize * ORIOLEDB_BLCKSZ,
+						(int64) pool->size * ORIOLEDB_BLCKSZ),
+				 errhint("The maximal size is set by orioledb.main_buffers_max.")));
+
+	PG_RETURN_INT64((int64) ppool_resize(pool, (OInMemoryBlkno) (size / ORIOLEDB_BLCKSZ),
+										 true));
+}
+
+/*
+ * Reports the current and the maximal size of the main shared buffers in
+ * bytes, and the retirement progress of the pages past the current size.
+ */
+Datum
+orioledb_main_buffers_info(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	OPagePool  *pool = &page_pools[OPagePoolMain];
+	Datum		values[4];
+	bool		nulls[4] = {false, false, false, false};
+
+	orioledb_check_shmem();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = Int64GetDatum((int64) ppool_size(pool) * ORIOLEDB_BLCKSZ);
+	values[1] = Int64GetDatum((int64) pool->size * ORIOLEDB_BLCKSZ);
+	values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&pool->resize->retiredPages));
+	values[3] = Int64GetDatum((int64) ppool_retire_pending(pool));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
 Datum
 orioledb_ucm_check(PG_FUNCTION_ARGS)
 {
@@ -1558,6 +3632,17 @@ get_ppool(OPagePoolType type)
 	return &page_pools[type];
 }
 
+const char *
+get_ppool_name(OPagePoolType type)
+{
+	if (type == OPagePoolMain)
+		return "main";
+	else if (type == OPagePoolFreeTree)
+		return "free_tree";
+	Assert(type == OPagePoolCatalog);
+	return "catalog";
+}
+
 /*
  * Returns a page pool for the page number.
  */
@@ -1666,13 +3751,19 @@ orioledb_error_cleanup_hook(void)
 	int			i;
 
 	GET_CUR_PROCDATA()->waitingForOxid = false;
+	if (opSamplingProcs)
+		opSamplingProcs[MYPROCNUMBER].op = OpSamplingNone;
 	release_all_page_locks();
 	ppool_release_all_pages();
 	for (i = 0; i < (int) UndoLogsCount; i++)
 		release_undo_size((UndoLogType) i);
 	btree_mark_incomplete_splits();
 	unset_skip_ucm();
+	unset_ucm_scan_access();
 	btree_io_error_cleanup();
+	compress_workers_release_all();
+	sync_workers_release_all();
+	checkpoint_error_cleanup();
 	o_reset_syscache_hooks();
 	o_ddl_cleanup();
 	if (orioledb_s3_mode)
@@ -1697,6 +3788,30 @@ orioledb_get_relation_info_hook(PlannerInfo *root,
 		if (rel->rel_parallel_workers > 0)
 			elog(WARNING, "Rel parallel workers = %d", rel->rel_parallel_workers);
 
+		/*
+		 * The page pool makes reads of the in-memory pages nearly free, so
+		 * the planner only counts the on-disk part of the pages as I/O.  The
+		 * parallel workers are still chosen by the whole table size, because
+		 * the scan of the in-memory pages is CPU-bound.
+		 */
+		if (enable_tree_statistics && rel->pages > 0)
+		{
+			OTableDescr *descr = relation_get_descr(relation);
+
+			if (descr)
+			{
+				double		inMemory;
+
+				inMemory = o_btree_in_memory_fraction(&GET_PRIMARY(descr)->desc);
+				if (rel->rel_parallel_workers == -1)
+					rel->rel_parallel_workers = compute_parallel_worker(rel,
+																		rel->pages,
+																		-1,
+																		max_parallel_workers_per_gather);
+				rel->pages = Max((BlockNumber) ceil(rel->pages * (1.0 - inMemory)), 1);
+			}
+		}
+
 		if (relation->rd_rel->relhasindex)
 		{
 			int			i;
@@ -1732,10 +3847,11 @@ orioledb_get_relation_info_hook(PlannerInfo *root,
 					index_close(index, AccessShareLock);
 
 					/*
-					 * TODO: Remove when parallel index scan will be
-					 * implemented
+					 * Only the primary index scans are run by the custom scan
+					 * supporting the parallel mode.
 					 */
-					info->amcanparallel = false;
+					info->amcanparallel = enable_parallel_index_scan &&
+						info->indexoid == primary->oids.reloid;
 					hasbitmap = info->indexoid != primary->oids.reloid &&
 						primary->nFields <= 1;
 					for (i = 0;
@@ -1763,6 +3879,13 @@ orioledb_get_relation_info_hook(PlannerInfo *root,
 					root_page = O_GET_IN_MEMORY_PAGE(rootPageBlkno);
 					info->tree_height = PAGE_GET_LEVEL(root_page);
 					info->pages = TREE_NUM_LEAF_PAGES(&index_descr->desc);
+					if (enable_tree_statistics && info->pages > 0)
+					{
+						double		inMemory;
+
+						inMemory = o_btree_in_memory_fraction(&index_descr->desc);
+						info->pages = Max((BlockNumber) ceil(info->pages * (1.0 - inMemory)), 1);
+					}
 				}
 			}
 		}
@@ -1865,3 +3988,80 @@ assign_debug_max_bridge_ctid(const char *newval, void *extra)
 	else
 		max_bridge_ctid_blkno = InvalidBlockNumber;
 }
+
+static bool
+check_as_of_timestamp(char **newval, void **extra, GucSource source)
+{
+	if (strcmp(*newval, "") != 0)
+	{
+		TimestampTz *myextra;
+		TimestampTz timestamp;
+
+		if (!enable_rewind)
+		{
+			GUC_check_errdetail("Historical queries require orioledb.enable_rewind.");
+			return false;
+		}
+
+		timestamp = DatumGetTimestampTz(DirectFunctionCall3(timestamptz_in,
+															CStringGetDatum(*newval),
+															ObjectIdGetDatum(InvalidOid),
+															Int32GetDatum(-1)));
+		if (TIMESTAMP_NOT_FINITE(timestamp))
+		{
+			GUC_check_errdetail("The timestamp must be finite.");
+			return false;
+		}
+
+		myextra = (TimestampTz *) guc_malloc(ERROR, sizeof(TimestampTz));
+		*myextra = timestamp;
+		*extra = (void *) myextra;
+	}
+	return true;
+}
+
+static void
+assign_as_of_timestamp(const char *newval, void *extra)
+{
+	as_of_enabled = newval && strcmp(newval, "") != 0;
+	as_of_timestamp = as_of_enabled ? *((TimestampTz *) extra) : 0;
+}
+
+static bool
+check_default_compress_codec(int *newval, void **extra, GucSource source)
+{
+#ifndef USE_LZ4
+	if (*newval == O_COMPRESS_CODEC_LZ4)
+	{
+		GUC_check_errdetail("lz4 compression is not supported by this build.");
+		return false;
+	}
+#endif
+	return true;
+}
+
+static bool
+check_io_method(int *newval, void **extra, GucSource source)
+{
+#ifndef USE_LIBURING
+	if (*newval == OIOMethodIOUring)
+	{
+		GUC_check_errdetail("io_uring is not supported by this build.");
+		return false;
+	}
+#endif
+	return true;
+}
+
+static bool
+check_direct_io(bool *newval, void **extra, GucSource source)
+{
+#ifndef O_DIRECT
+	if (*newval)
+	{
+		GUC_check_errdetail("Direct IO is not supported on this platform.");
+		return false;
+	}
+#endif
+	return true;
+}
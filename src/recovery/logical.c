@@ -28,9 +28,35 @@
 #include "replication/origin.h"
 #include "replication/reorderbuffer.h"
 #include "replication/snapbuild.h"
+#include "access/htup_details.h"
 #include "access/toast_compression.h"
 #include "access/detoast.h"
 #include "tuple/toast.h"
+#include "utils/memutils.h"
+
+/*
+ * The savepoint of the transaction being decoded.
+ */
+typedef struct
+{
+	SubTransactionId parentSubid;
+	TransactionId logicalXid;
+	TransactionId parentLogicalXid;
+} DecodeSavepoint;
+
+typedef struct
+{
+	OXid		oxid;
+	List	   *savepoints;
+} DecodeTxnSavepoints;
+
+/*
+ * Savepoints of the transactions being decoded by the current decoding
+ * context.  They let us discard the changes of the rolled back
+ * subtransactions, which might be already streamed to the output plugin.
+ */
+static HTAB *decode_savepoints = NULL;
+static MemoryContextCallback decode_savepoints_reset_cb;
 
 /*
  * Copy identity attributes from srcSlot to dstSlot.
@@ -135,19 +161,142 @@ get_reorder_buffer_txn(ReorderBuffer *rb, TransactionId xid)
 		return NULL;
 }
 
+static void
+decode_savepoints_reset(void *arg)
+{
+	decode_savepoints = NULL;
+}
+
+static DecodeTxnSavepoints *
+get_decode_savepoints(LogicalDecodingContext *ctx, OXid oxid, bool create)
+{
+	if (decode_savepoints == NULL)
+	{
+		HASHCTL		ctl;
+
+		if (!create)
+			return NULL;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(OXid);
+		ctl.entrysize = sizeof(DecodeTxnSavepoints);
+		ctl.hcxt = ctx->context;
+		decode_savepoints = hash_create("orioledb decode savepoints", 16,
+										&ctl,
+										HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+		decode_savepoints_reset_cb.func = decode_savepoints_reset;
+		decode_savepoints_reset_cb.arg = NULL;
+		MemoryContextRegisterResetCallback(ctx->context,
+										   &decode_savepoints_reset_cb);
+	}
+
+	if (create)
+	{
+		DecodeTxnSavepoints *entry;
+		bool		found;
+
+		entry = (DecodeTxnSavepoints *) hash_search(decode_savepoints, &oxid,
+													HASH_ENTER, &found);
+		if (!found)
+			entry->savepoints = NIL;
+		return entry;
+	}
+
+	return (DecodeTxnSavepoints *) hash_search(decode_savepoints, &oxid,
+											   HASH_FIND, NULL);
+}
+
+static void
+decode_savepoint(LogicalDecodingContext *ctx, OXid oxid,
+				 SubTransactionId parentSubid, TransactionId logicalXid,
+				 TransactionId parentLogicalXid)
+{
+	DecodeTxnSavepoints *entry = get_decode_savepoints(ctx, oxid, true);
+	MemoryContext mcxt = MemoryContextSwitchTo(ctx->context);
+	DecodeSavepoint *savepoint = palloc(sizeof(DecodeSavepoint));
+
+	savepoint->parentSubid = parentSubid;
+	savepoint->logicalXid = logicalXid;
+	savepoint->parentLogicalXid = parentLogicalXid;
+	entry->savepoints = lappend(entry->savepoints, savepoint);
+	MemoryContextSwitchTo(mcxt);
+}
+
 /*
- * Convert tuples from the main relation from OrioleDB to haep format with
- * conversion of TOAST pointers to PG format.
+ * Aborts the subtransactions rolled back to the savepoint in the reorder
+ * buffer.  The reorder buffer sends the stream abort for those of them, which
+ * are already streamed.  Returns the logical xid of the parent, which the
+ * following changes belong to.
  */
-static HeapTuple
-convert_toast_pointers(OTableDescr *descr, OIndexDescr *indexDescr,
-					   OFixedTuple tuple)
+static TransactionId
+decode_rollback_to_savepoint(LogicalDecodingContext *ctx, OXid oxid,
+							 SubTransactionId parentSubid,
+							 TransactionId logicalXid, XLogRecPtr lsn)
 {
-	int			natts = descr->tupdesc->natts;
-	Datum	   *old_values = palloc0(natts * sizeof(Datum));
-	Datum	   *new_values = palloc0(natts * sizeof(Datum));
-	bool	   *isnull = palloc0(natts * sizeof(bool));
+	DecodeTxnSavepoints *entry = get_decode_savepoints(ctx, oxid, false);
+
+	if (entry == NULL)
+		return logicalXid;
+
+	while (entry->savepoints != NIL)
+	{
+		DecodeSavepoint *savepoint = llast(entry->savepoints);
+		bool		done = (savepoint->parentSubid == parentSubid);
+
+		ReorderBufferAbort(ctx->reorder, savepoint->logicalXid, lsn, 0);
+		logicalXid = savepoint->parentLogicalXid;
+
+		entry->savepoints = list_delete_last(entry->savepoints);
+		pfree(savepoint);
+		if (done)
+			break;
+	}
+
+	return logicalXid;
+}
+
+static void
+decode_forget_savepoints(OXid oxid)
+{
+	DecodeTxnSavepoints *entry;
+
+	if (decode_savepoints == NULL)
+		return;
+
+	entry = (DecodeTxnSavepoints *) hash_search(decode_savepoints, &oxid,
+												HASH_FIND, NULL);
+	if (entry)
+	{
+		list_free_deep(entry->savepoints);
+		hash_search(decode_savepoints, &oxid, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * Converts the tuple of the main relation from OrioleDB to heap format right
+ * into the reorder buffer tuple.  OrioleDB TOAST pointers are replaced with
+ * PG on-disk ones without fetching the values.  The reorder buffer replaces
+ * them with the chunks decoded within the same change, and the rest reach the
+ * output plugin as unchanged TOAST values.
+ */
+static REORDER_BUFFER_TUPLE_TYPE
+record_buffer_toast_tuple(ReorderBuffer *reorder, OTableDescr *descr,
+						  OIndexDescr *indexDescr, OTuple tuple)
+{
+	TupleDesc	tupdesc = descr->tupdesc;
+	int			natts = tupdesc->natts;
+	Datum	   *values = palloc(natts * sizeof(Datum));
+	bool	   *isnull = palloc(natts * sizeof(bool));
+	char	   *toastptrs = palloc0(descr->ntoastable * TOAST_POINTER_SIZE);
 	int			ctid_off = indexDescr->primaryIsCtid ? 1 : 0;
+	bool		hasnull = false;
+	Size		len,
+				data_len,
+				hoff;
+	HeapTuple	changeTup;
+	HeapTupleHeader td;
+	REORDER_BUFFER_TUPLE_TYPE result;
 
 	/*
 	 * Decode original tuple.
@@ -155,11 +304,9 @@ convert_toast_pointers(OTableDescr *descr, OIndexDescr *indexDescr,
 	Assert(descr->toast);
 	for (int i = 0; i < natts; i++)
 	{
-		old_values[i] = o_fastgetattr(tuple.tuple, i + 1,
-									  descr->tupdesc,
-									  &indexDescr->leafSpec,
-									  &isnull[i]);
-		new_values[i] = old_values[i];
+		values[i] = o_fastgetattr(tuple, i + 1, tupdesc,
+								  &indexDescr->leafSpec, &isnull[i]);
+		hasnull |= isnull[i];
 	}
 
 	/* Convert TOAST pointers */
@@ -172,39 +319,61 @@ convert_toast_pointers(OTableDescr *descr, OIndexDescr *indexDescr,
 		varatt_external ve;
 
 		if (isnull[toast_attn])
-		{
-			elog(DEBUG4, "NULL attr %u", toast_attn);
 			continue;
-		}
 
-		old_toastptr = (struct varlena *) DatumGetPointer(old_values[toast_attn]);
+		old_toastptr = (struct varlena *) DatumGetPointer(values[toast_attn]);
 		if (old_toastptr == NULL || !VARATT_IS_EXTERNAL(old_toastptr))
-		{
-			elog(DEBUG4, "NON-toast or empty attr %u", toast_attn);
 			continue;
-		}
 
 		memcpy(&otv, old_toastptr, sizeof(otv));
-		elog(DEBUG4, "reloid: Old toast value: %u toast_attn: %u compression %u, raw_size, %u, toasted_size %u",
-			 descr->oids.reloid, toast_attn + 1, otv.compression,
-			 otv.raw_size, otv.toasted_size);
-
 		ve.va_rawsize = otv.raw_size + VARHDRSZ;
 		ve.va_extinfo = (otv.toasted_size - VARHDRSZ) | (otv.compression << VARLENA_EXTSIZE_BITS);
 		ve.va_toastrelid = descr->toast->oids.reloid;
 		ve.va_valueid = ObjectIdGetDatum(toast_attn + 1 + 8000);
 
-		elog(DEBUG4, "New toast pointer compression: %u rawsize: %u, extinfo_size: %u, toastrelid %u, valueid %u  ",
-			 (ve.va_extinfo >> VARLENA_EXTSIZE_BITS), ve.va_rawsize,
-			 (ve.va_extinfo & VARLENA_EXTSIZE_MASK),
-			 ve.va_toastrelid, ve.va_valueid);
+		elog(DEBUG4, "reloid: %u toast_attn: %u compression: %u, rawsize: %u, toasted_size: %u",
+			 descr->oids.reloid, toast_attn + 1, otv.compression,
+			 otv.raw_size, otv.toasted_size);
 
-		new_toastptr = palloc0(TOAST_POINTER_SIZE);
+		new_toastptr = (struct varlena *) (toastptrs + i * TOAST_POINTER_SIZE);
 		SET_VARTAG_EXTERNAL(new_toastptr, VARTAG_ONDISK);
 		memcpy(VARDATA_EXTERNAL(new_toastptr), &ve, sizeof(ve));
-		new_values[toast_attn] = PointerGetDatum(new_toastptr);
+		values[toast_attn] = PointerGetDatum(new_toastptr);
 	}
-	return heap_form_tuple(descr->tupdesc, new_values, isnull);
+
+	/* Form the heap tuple in place just like heap_form_tuple() does */
+	hoff = SizeofHeapTupleHeader;
+	if (hasnull)
+		hoff += BITMAPLEN(natts);
+	hoff = MAXALIGN(hoff);
+	data_len = heap_compute_data_size(tupdesc, values, isnull);
+	len = hoff + data_len;
+
+	result = ReorderBufferGetTupleBuf(reorder, len);
+#if PG_VERSION_NUM >= 170000
+	changeTup = result;
+#else
+	changeTup = &result->tuple;
+#endif
+	changeTup->t_tableOid = InvalidOid;
+	changeTup->t_len = len;
+	ItemPointerSetInvalid(&changeTup->t_self);
+
+	td = changeTup->t_data;
+	memset(td, 0, len);
+	HeapTupleHeaderSetDatumLength(td, len);
+	HeapTupleHeaderSetTypeId(td, tupdesc->tdtypeid);
+	HeapTupleHeaderSetTypMod(td, tupdesc->tdtypmod);
+	HeapTupleHeaderSetNatts(td, natts);
+	td->t_hoff = hoff;
+	heap_fill_tuple(tupdesc, values, isnull, (char *) td + hoff, data_len,
+					&td->t_infomask, hasnull ? td->t_bits : NULL);
+
+	pfree(values);
+	pfree(isnull);
+	pfree(toastptrs);
+
+	return result;
 }
 
 /*
@@ -216,9 +385,10 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 	XLogReaderState *record = buf->record;
 	XLogRecPtr	startXLogPtr = record->ReadRecPtr;
 	XLogRecPtr	endXLogPtr = record->EndRecPtr;
-	Pointer		startPtr = (Pointer) XLogRecGetData(record);
-	Pointer		endPtr = startPtr + XLogRecGetDataLen(record);
-	Pointer		ptr = startPtr;
+	int			containerLength;
+	Pointer		startPtr;
+	Pointer		endPtr;
+	Pointer		ptr;
 	OTableDescr *descr = NULL;
 	OIndexDescr *indexDescr = NULL;
 	int			sys_tree_num = -1;
@@ -231,6 +401,14 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 	TupleDescData *o_toast_tupDesc = NULL;
 	TupleDescData *heap_toast_tupDesc = NULL;
 
+	/* The hot page lists are only for the physical standbys */
+	if ((XLogRecGetInfo(record) & ~XLR_INFO_MASK) == ORIOLEDB_XLOG_HOT_PAGES)
+		return;
+
+	startPtr = wal_container_get_data(record, &containerLength);
+	endPtr = startPtr + containerLength;
+	ptr = startPtr;
+
 	while (ptr < endPtr)
 	{
 		rec_type = *ptr;
@@ -248,6 +426,7 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 			 rec_type == WAL_REC_ROLLBACK_TO_SAVEPOINT ? "ROLLBACK TO SAVEPOINT" :
 			 rec_type == WAL_REC_INSERT ? "INSERT" :
 			 rec_type == WAL_REC_UPDATE ? "UPDATE" :
+			 rec_type == WAL_REC_UPDATE_DELTA ? "UPDATE DELTA" :
 			 rec_type == WAL_REC_DELETE ? "DELETE" : "_UNKNOWN");
 
 		if (rec_type == WAL_REC_XID)
@@ -277,19 +456,23 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 
 			SnapBuildUpdateCSNSnaphot(ctx->snapshot_builder, &csnSnapshot);
 
+			/* The transaction might have no changes left to decode */
 			txn = get_reorder_buffer_txn(ctx->reorder, logicalXid);
-			if (txn->toptxn)
+			if (txn && txn->toptxn)
 				txn = txn->toptxn;
 
-			dlist_foreach(cur_txn_i, &txn->subtxns)
+			if (txn)
 			{
-				ReorderBufferTXN *cur_txn;
+				dlist_foreach(cur_txn_i, &txn->subtxns)
+				{
+					ReorderBufferTXN *cur_txn;
 
-				cur_txn = dlist_container(ReorderBufferTXN, node, cur_txn_i.cur);
+					cur_txn = dlist_container(ReorderBufferTXN, node, cur_txn_i.cur);
 
-				ReorderBufferCommitChild(ctx->reorder, txn->xid, cur_txn->xid,
-										 startXLogPtr, endXLogPtr);
+					ReorderBufferCommitChild(ctx->reorder, txn->xid, cur_txn->xid,
+											 startXLogPtr, endXLogPtr);
 
+				}
 			}
 
 			/*
@@ -310,6 +493,7 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 								   startXLogPtr, 0);
 			}
 			UpdateDecodingStats(ctx);
+			decode_forget_savepoints(oxid);
 
 			oxid = InvalidOXid;
 			logicalXid = InvalidTransactionId;
@@ -347,6 +531,7 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 								   startXLogPtr, 0);
 			}
 			UpdateDecodingStats(ctx);
+			decode_forget_savepoints(oxid);
 
 			oxid = InvalidOXid;
 			logicalXid = InvalidTransactionId;
@@ -455,6 +640,8 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 			ptr += sizeof(TransactionId);
 
 			ReorderBufferAssignChild(ctx->reorder, parentLogicalXid, logicalXid, buf->origptr);
+			decode_savepoint(ctx, oxid, parentSubid, logicalXid,
+							 parentLogicalXid);
 
 			/* Skip */
 		}
@@ -465,13 +652,23 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 			memcpy(&parentSubid, ptr, sizeof(SubTransactionId));
 			ptr += sizeof(SubTransactionId);
 
-			/* Skip */
+			logicalXid = decode_rollback_to_savepoint(ctx, oxid, parentSubid,
+													  logicalXid,
+													  startXLogPtr);
+		}
+		else if (rec_type == WAL_REC_UPDATE_DELTA)
+		{
+			/* Written only when wal_level is below logical */
+			elog(ERROR, "unexpected orioledb delta update record in logical decoding");
 		}
 		else
 		{
 			OFixedTuple tuple;
 			ReorderBufferChange *change;
-			XLogRecPtr	changeXLogPtr = startXLogPtr + (ptr - startPtr);
+			XLogRecPtr	changeXLogPtr = wal_container_xlog_ptr(startXLogPtr,
+																endXLogPtr,
+																ptr - startPtr,
+																containerLength);
 
 			Assert(rec_type == WAL_REC_INSERT || rec_type == WAL_REC_UPDATE || rec_type == WAL_REC_DELETE);
 
@@ -607,11 +804,9 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 						 */
 						if (descr->ntoastable > 0)
 						{
-							HeapTuple	newheaptuple;
-
-							newheaptuple = convert_toast_pointers(descr, indexDescr, tuple);
-							change->data.tp.newtuple = record_buffer_tuple(ctx->reorder, newheaptuple, true);
-							Assert(change->data.tp.newtuple);
+							change->data.tp.newtuple = record_buffer_toast_tuple(ctx->reorder,
+																				 descr, indexDescr,
+																				 tuple.tuple);
 						}
 						else	/* Tuple without TOASTed attrs */
 						{
@@ -647,23 +842,16 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 					 * Primary table contains TOASTed attributes needs
 					 * conversion of them
 					 */
+					tts_orioledb_store_tuple(descr->newTuple, tuple.tuple,
+											 descr, COMMITSEQNO_INPROGRESS,
+											 PrimaryIndexNumber, false,
+											 NULL);
 					if (descr->ntoastable > 0)
-					{
-						HeapTuple	newheaptuple;
-
-						newheaptuple = convert_toast_pointers(descr, indexDescr, tuple);
-						ExecForceStoreHeapTuple(newheaptuple, descr->newTuple, false);
-						change->data.tp.newtuple = record_buffer_tuple(ctx->reorder, newheaptuple, true);
-					}
+						change->data.tp.newtuple = record_buffer_toast_tuple(ctx->reorder,
+																			 descr, indexDescr,
+																			 tuple.tuple);
 					else		/* Tuple without TOASTed attrs */
-					{
-						tts_orioledb_store_tuple(descr->newTuple, tuple.tuple,
-												 descr, COMMITSEQNO_INPROGRESS,
-												 PrimaryIndexNumber, false,
-												 NULL);
-
 						change->data.tp.newtuple = record_buffer_tuple_slot(ctx->reorder, descr->newTuple);
-					}
 					tts_copy_identity(descr->newTuple, descr->oldTuple,
 									  GET_PRIMARY(descr));
 					change->data.tp.oldtuple = record_buffer_tuple_slot(ctx->reorder, descr->oldTuple);
@@ -699,10 +887,9 @@ orioledb_decode(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 						 */
 						if (descr->ntoastable > 0)
 						{
-							HeapTuple	oldheaptuple;
-
-							oldheaptuple = convert_toast_pointers(descr, indexDescr, tuple);
-							change->data.tp.oldtuple = record_buffer_tuple(ctx->reorder, oldheaptuple, true);
+							change->data.tp.oldtuple = record_buffer_toast_tuple(ctx->reorder,
+																				 descr, indexDescr,
+																				 tuple.tuple);
 						}
 						else	/* Tuple without TOASTed attrs */
 						{
@@ -39,11 +39,13 @@
 #include "utils/stopevent.h"
 #include "utils/syscache.h"
 #include "workers/interrupt.h"
+#include "workers/prewarm.h"
 
 #include "access/hash.h"
 #include "access/xlog_internal.h"
 #include "access/xlogrecovery.h"
 #include "lib/ilist.h"
+#include "funcapi.h"
 #include "lib/pairingheap.h"
 #include "miscadmin.h"
 #include "postmaster/postmaster.h"
@@ -55,6 +57,7 @@
 #include "storage/standby.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
+#include "utils/tuplestore.h"
 #include "utils/typcache.h"
 
 #include <sys/stat.h>
@@ -77,10 +80,31 @@ typedef struct
 	OIndexType	type;
 	/* Handle for the worker */
 	BackgroundWorkerHandle *handle;
+	/* Number of modify messages sent to the worker */
+	uint64		modifies_sent;
 } RecoveryWorkerState;
 
 static RecoveryWorkerState *workers_pool;
 
+/*
+ * Routing of the modify messages to the recovery workers.  The key hashes are
+ * grouped into the slots, each slot is routed to a single worker.  The slot is
+ * moved to the less loaded worker only when its worker is overloaded and has
+ * applied all the messages of the slot.  So the messages for the same key are
+ * still applied one by one in the WAL order.
+ */
+#define RECOVERY_ROUTE_SLOTS		(4096)
+#define RECOVERY_REBALANCE_DEPTH	(1024)
+
+typedef struct
+{
+	int			worker;
+	/* Value of modifies_sent of the worker for the last message of the slot */
+	uint64		last_sent;
+} RecoveryRouteSlot;
+
+static RecoveryRouteSlot *recovery_routes = NULL;
+
 typedef struct
 {
 	ORelOids	oids;			/* hash table key */
@@ -140,6 +164,7 @@ typedef struct
 
 
 PG_FUNCTION_INFO_V1(orioledb_recovery_synchronized);
+PG_FUNCTION_INFO_V1(orioledb_recovery_queue_depth);
 
 /*
  * Comparator for undo retain min-heap.
@@ -192,6 +217,9 @@ static HTAB *recovery_xid_state_hash = NULL;
 
 static HTAB *idxbuild_oids_hash = NULL;
 
+/* Xmins of the trees written by the checkpoint the recovery starts from */
+static HTAB *tree_xmins_hash = NULL;
+
 /* Queues of undo retain locations */
 static pairingheap *retain_undo_queues[(int) UndoLogsCount] =
 {
@@ -250,6 +278,12 @@ int			recovery_idx_pool_size_guc;
  */
 int			recovery_queue_size_guc;
 
+/*
+ * GUC value, should recovery workers prefetch the evicted leaves ahead of
+ * applying the modify messages.
+ */
+bool		recovery_prefetch_guc = true;
+
 /*
  * Are TOAST trees consistent with primary indices.
  */
@@ -293,7 +327,8 @@ static void o_handle_startup_proc_interrupts_hook(void);
 static void abort_recovery(RecoveryWorkerState *workers_pool, bool send_to_idx_pool);
 
 static void replay_container(Pointer ptr, Pointer endPtr,
-							 bool single, XLogRecPtr xlogRecPtr);
+							 bool single, XLogRecPtr xlogRecPtr,
+							 XLogRecPtr xlogRecEndPtr);
 
 static void worker_send_modify(int worker_id, BTreeDescr *desc,
 							   RecoveryMsgType recType,
@@ -312,6 +347,7 @@ static inline bool apply_sys_tree_modify_record(int sys_tree_num, uint16 type,
 static inline void spread_idx_modify(BTreeDescr *desc,
 									 RecoveryMsgType recType,
 									 OTuple rec);
+static int	recovery_route_worker(uint32 hash);
 
 static inline RecoveryMsgType recovery_msg_from_wal_record(uint8 wal_record);
 static void recovery_send_init(int worker_num);
@@ -416,6 +452,8 @@ recovery_shmem_init(Pointer ptr, bool found)
 			shm_mq_create(GET_WORKER_QUEUE(i), recovery_queue_data_size);
 			pg_atomic_init_u64(&worker_ptrs[i].commitPtr, InvalidXLogRecPtr);
 			pg_atomic_init_u64(&worker_ptrs[i].retainPtr, InvalidXLogRecPtr);
+			pg_atomic_init_u64(&worker_ptrs[i].sentModifies, 0);
+			pg_atomic_init_u64(&worker_ptrs[i].appliedModifies, 0);
 			worker_ptrs[i].flushedUndoLocCompletedCheckpointNumber = 0;
 		}
 		pg_atomic_init_u64(recovery_ptr, InvalidXLogRecPtr);
@@ -533,6 +571,109 @@ read_xids(int checkpointnum, bool recovery_single, int worker_id)
 	pfree(xidFilename);
 }
 
+/*
+ * Read xmins of the trees written by the checkpoint.  The file is absent for
+ * the checkpoints made by the earlier versions or on the standby.
+ */
+static void
+read_tree_xmins(int checkpointnum)
+{
+	char	   *filename = psprintf(TREE_XMINS_FILENAME_FORMAT, checkpointnum);
+	File		file;
+	HASHCTL		ctl;
+	off_t		offset = 0;
+	uint32		count = 0,
+				i;
+
+	file = PathNameOpenFile(filename, O_RDONLY | PG_BINARY);
+	if (file < 0)
+	{
+		pfree(filename);
+		return;
+	}
+
+	if (OFileRead(file, (Pointer) &count, sizeof(count), offset,
+				  WAIT_EVENT_SLRU_READ) != sizeof(count))
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not read tree xmins file %s: %m", filename)));
+	offset += sizeof(count);
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(ORelOids);
+	ctl.entrysize = sizeof(CheckpointTreeXmin);
+	ctl.hcxt = TopMemoryContext;
+	tree_xmins_hash = hash_create("orioledb recovery tree xmins hash",
+								  Max(count, 16), &ctl,
+								  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	for (i = 0; i < count; i++)
+	{
+		CheckpointTreeXmin rec;
+		CheckpointTreeXmin *entry;
+
+		if (OFileRead(file, (Pointer) &rec, sizeof(rec), offset,
+					  WAIT_EVENT_SLRU_READ) != sizeof(rec))
+			ereport(FATAL, (errcode_for_file_access(),
+							errmsg("could not read tree xmins file %s: %m", filename)));
+		offset += sizeof(rec);
+
+		entry = (CheckpointTreeXmin *) hash_search(tree_xmins_hash, &rec.oids,
+												   HASH_ENTER, NULL);
+		entry->xmin = rec.xmin;
+	}
+
+	FileClose(file);
+	pfree(filename);
+}
+
+static OXid
+recovery_tree_xmin(OIndexDescr *id)
+{
+	CheckpointTreeXmin *entry;
+
+	entry = (CheckpointTreeXmin *) hash_search(tree_xmins_hash,
+											   &id->desc.oids,
+											   HASH_FIND, NULL);
+	return entry ? entry->xmin : InvalidOXid;
+}
+
+/*
+ * Returns the xmin, such that the changes of the older transactions to the
+ * relation are already contained in the checkpoint images of all its trees.
+ * Replay skips them.  Returns InvalidOXid if nothing could be skipped.
+ */
+static OXid
+recovery_relation_skip_xmin(OTableDescr *descr, OIndexDescr *indexDescr)
+{
+	OXid		xmin;
+	int			i;
+
+	if (tree_xmins_hash == NULL || indexDescr == NULL)
+		return InvalidOXid;
+
+	if (descr == NULL)
+		return recovery_tree_xmin(indexDescr);
+
+	/* The table changes are applied to all of its indices */
+	xmin = InvalidOXid;
+	if (descr->bridge)
+	{
+		xmin = recovery_tree_xmin(descr->bridge);
+		if (!OXidIsValid(xmin))
+			return InvalidOXid;
+	}
+	for (i = 0; i < descr->nIndices; i++)
+	{
+		OXid		treeXmin = recovery_tree_xmin(descr->indices[i]);
+
+		if (!OXidIsValid(treeXmin))
+			return InvalidOXid;
+		xmin = Min(xmin, treeXmin);
+	}
+
+	return xmin;
+}
+
 /*
  * Apply undo records "hidden" in undo branches.
  *
@@ -636,6 +777,9 @@ o_recovery_start_hook(void)
 			state->oids.reloid = InvalidOid;
 			state->oids.relnode = InvalidOid;
 			state->oxid = InvalidOXid;
+			state->modifies_sent = 0;
+			pg_atomic_write_u64(&worker_ptrs[i].sentModifies, 0);
+			pg_atomic_write_u64(&worker_ptrs[i].appliedModifies, 0);
 
 			workers_pool[i].handle = recovery_worker_register(i);
 			if (workers_pool[i].handle == NULL)
@@ -686,11 +830,17 @@ o_recovery_start_hook(void)
 void
 orioledb_redo(XLogReaderState *record)
 {
-	Pointer		msg_start = (Pointer) XLogRecGetData(record);
-	int			msg_len = XLogRecGetDataLen(record);
+	Pointer		msg_start;
+	int			msg_len;
 	bool		recovery_single;
 
-	Assert((XLogRecGetInfo(record) & ~XLR_INFO_MASK) == ORIOLEDB_XLOG_CONTAINER);
+	if ((XLogRecGetInfo(record) & ~XLR_INFO_MASK) == ORIOLEDB_XLOG_HOT_PAGES)
+	{
+		prewarm_redo_hot_pages(record);
+		return;
+	}
+
+	msg_start = wal_container_get_data(record, &msg_len);
 	recovery_single = *recovery_single_process;
 
 	if (record->ReadRecPtr >= checkpoint_state->controlToastConsistentPtr)
@@ -703,7 +853,8 @@ orioledb_redo(XLogReaderState *record)
 	if (record->ReadRecPtr >= checkpoint_state->controlReplayStartPtr)
 	{
 		replay_container(msg_start, msg_start + msg_len,
-						 recovery_single, record->ReadRecPtr);
+						 recovery_single, record->ReadRecPtr,
+						 record->EndRecPtr);
 	}
 
 	if (unexpected_worker_detach)
@@ -910,6 +1061,9 @@ recovery_init(int worker_id)
 				  *recovery_single_process,
 				  worker_id);
 
+	if (worker_id < 0 && checkpoint_state->lastCheckpointNumber > 0)
+		read_tree_xmins(checkpoint_state->lastCheckpointNumber);
+
 	if (worker_id < 0)
 	{
 		HASHCTL		reloid_ctl;
@@ -1067,6 +1221,11 @@ recovery_finish(int worker_id)
 	HandleStartupProcInterrupts_hook = NULL;
 	hash_destroy(recovery_xid_state_hash);
 	recovery_xid_state_hash = NULL;
+	if (tree_xmins_hash)
+	{
+		hash_destroy(tree_xmins_hash);
+		tree_xmins_hash = NULL;
+	}
 
 	if (worker_id < 0)
 	{
@@ -1703,6 +1862,56 @@ orioledb_recovery_synchronized(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(true);
 }
 
+/*
+ * Returns the number of modify messages sent to and applied by every recovery
+ * worker.  The difference is the depth of the worker queue.
+ */
+Datum
+orioledb_recovery_queue_depth(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			i;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < recovery_pool_size_guc; i++)
+	{
+		Datum		values[3];
+		bool		nulls[3] = {false, false, false};
+		uint64		applied,
+					sent;
+
+		/* Read applied first, so it never exceeds sent */
+		applied = pg_atomic_read_u64(&worker_ptrs[i].appliedModifies);
+		pg_read_barrier();
+		sent = pg_atomic_read_u64(&worker_ptrs[i].sentModifies);
+
+		values[0] = Int32GetDatum(i);
+		values[1] = Int64GetDatum((int64) sent);
+		values[2] = Int64GetDatum((int64) applied);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
 static void
 update_run_xmin(void)
 {
@@ -2631,7 +2840,8 @@ invalidate_typcache(void)
  */
 static void
 replay_container(Pointer startPtr, Pointer endPtr,
-				 bool single, XLogRecPtr xlogRecPtr)
+				 bool single, XLogRecPtr xlogRecPtr,
+				 XLogRecPtr xlogRecEndPtr)
 {
 	OTableDescr *descr = NULL;
 	OIndexDescr *indexDescr = NULL;
@@ -2645,10 +2855,12 @@ replay_container(Pointer startPtr, Pointer endPtr,
 	int			sys_tree_num = -1;
 	Pointer		ptr = startPtr;
 	XLogRecPtr	xlogPtr;
+	OXid		skip_xmin = InvalidOXid;
 
 	while (ptr < endPtr)
 	{
-		xlogPtr = xlogRecPtr + (ptr - startPtr);
+		xlogPtr = wal_container_xlog_ptr(xlogRecPtr, xlogRecEndPtr,
+										 ptr - startPtr, endPtr - startPtr);
 		rec_type = *ptr;
 		ptr++;
 
@@ -2762,6 +2974,13 @@ replay_container(Pointer startPtr, Pointer endPtr,
 												 false, NULL);
 			}
 
+			/*
+			 * Changes of the transactions finished before the checkpoint of
+			 * the tree started are already in its image.
+			 */
+			skip_xmin = (sys_tree_num > 0) ? InvalidOXid :
+				recovery_relation_skip_xmin(descr, indexDescr);
+
 			if (sys_tree_num == -1)
 			{
 				char	   *prefix;
@@ -2862,6 +3081,9 @@ replay_container(Pointer startPtr, Pointer endPtr,
 
 			Assert(indexDescr);
 
+			if (OXidIsValid(skip_xmin) && oxid < skip_xmin)
+				continue;
+
 			if (single)
 			{
 				recovery_switch_to_oxid(oxid, -1);
@@ -2875,10 +3097,57 @@ replay_container(Pointer startPtr, Pointer endPtr,
 				hash = o_hash_iptr(indexDescr, &iptr);
 				tuple.formatFlags = 0;
 				tuple.data = (Pointer) &iptr;
-				worker_send_modify(GET_WORKER_ID(hash), &indexDescr->desc,
+				worker_send_modify(recovery_route_worker(hash), &indexDescr->desc,
 								   RecoveryMsgTypeBridgeErase, tuple, 0);
 			}
 		}
+		else if (rec_type == WAL_REC_UPDATE_DELTA)
+		{
+			WALRecUpdateDelta rec;
+			OffsetNumber keyLength,
+						tupleLength,
+						prefix,
+						suffix;
+			OTuple		delta;
+
+			memcpy(&rec, ptr - 1, sizeof(rec));
+			memcpy(&keyLength, rec.keyLength, sizeof(OffsetNumber));
+			memcpy(&tupleLength, rec.tupleLength, sizeof(OffsetNumber));
+			memcpy(&prefix, rec.prefixLength, sizeof(OffsetNumber));
+			memcpy(&suffix, rec.suffixLength, sizeof(OffsetNumber));
+			length = sizeof(rec) + keyLength + tupleLength - prefix - suffix;
+
+			/* The whole record is passed to the worker including the type */
+			delta.formatFlags = 0;
+			delta.data = ptr - 1;
+			ptr += length - 1;
+
+			Assert(oxid != InvalidOXid);
+			Assert(sys_tree_num <= 0);
+
+			if (indexDescr == NULL ||
+				(OXidIsValid(skip_xmin) && oxid < skip_xmin))
+				continue;
+
+			if (single)
+			{
+				recovery_switch_to_oxid(oxid, -1);
+				apply_update_delta_record(descr, indexDescr, delta.data);
+			}
+			else
+			{
+				OFixedKey	key;
+				uint32		hash;
+
+				key.tuple.formatFlags = rec.keyFormatFlags;
+				key.tuple.data = key.fixedData;
+				memcpy(key.fixedData, delta.data + sizeof(rec), keyLength);
+				hash = o_btree_hash(&indexDescr->desc, key.tuple,
+									BTreeKeyNonLeafKey);
+				worker_send_modify(recovery_route_worker(hash), &indexDescr->desc,
+								   RecoveryMsgTypeUpdateDelta, delta, length);
+			}
+		}
 		else
 		{
 			OFixedTuple tuple;
@@ -2950,7 +3219,8 @@ replay_container(Pointer startPtr, Pointer endPtr,
 				}
 			}
 
-			if (sys_tree_num > 0 || indexDescr == NULL)
+			if (sys_tree_num > 0 || indexDescr == NULL ||
+				(OXidIsValid(skip_xmin) && oxid < skip_xmin))
 			{
 				/* nothing to do here */
 				ptr += length;
@@ -3183,11 +3453,16 @@ worker_send_modify(int worker_id, BTreeDescr *desc,
 	Assert(recType == RecoveryMsgTypeInsert ||
 		   recType == RecoveryMsgTypeUpdate ||
 		   recType == RecoveryMsgTypeDelete ||
+		   recType == RecoveryMsgTypeUpdateDelta ||
 		   recType == RecoveryMsgTypeBridgeErase);
 
 	if (RECOVERY_QUEUE_BUF_SIZE - state->queue_buf_len < max_msg_size)
 		worker_queue_flush(worker_id);
 
+	state->modifies_sent++;
+	pg_atomic_write_u64(&worker_ptrs[worker_id].sentModifies,
+						state->modifies_sent);
+
 	data = state->queue_buf + state->queue_buf_len;
 	header = (RecoveryMsgHeader *) data;
 	header->type = recType;
@@ -3501,6 +3776,66 @@ apply_sys_tree_modify_record(int sys_tree_num, uint16 type, OTuple tup,
 	return result;
 }
 
+static inline uint64
+recovery_worker_queue_depth(int worker_id)
+{
+	return workers_pool[worker_id].modifies_sent -
+		pg_atomic_read_u64(&worker_ptrs[worker_id].appliedModifies);
+}
+
+/*
+ * Returns the worker for the next modify message with the given key hash.
+ */
+static int
+recovery_route_worker(uint32 hash)
+{
+	RecoveryRouteSlot *slot;
+	uint64		depth;
+	int			worker_id;
+
+	if (recovery_routes == NULL)
+	{
+		int			i;
+
+		recovery_routes = MemoryContextAlloc(TopMemoryContext,
+											 sizeof(RecoveryRouteSlot) * RECOVERY_ROUTE_SLOTS);
+		for (i = 0; i < RECOVERY_ROUTE_SLOTS; i++)
+		{
+			recovery_routes[i].worker = GET_WORKER_ID(i);
+			recovery_routes[i].last_sent = 0;
+		}
+	}
+
+	slot = &recovery_routes[hash % RECOVERY_ROUTE_SLOTS];
+	worker_id = slot->worker;
+	depth = recovery_worker_queue_depth(worker_id);
+
+	if (depth >= RECOVERY_REBALANCE_DEPTH &&
+		pg_atomic_read_u64(&worker_ptrs[worker_id].appliedModifies) >= slot->last_sent)
+	{
+		int			least = worker_id;
+		uint64		least_depth = depth;
+		int			i;
+
+		for (i = 0; i < recovery_pool_size_guc; i++)
+		{
+			uint64		cur_depth = recovery_worker_queue_depth(i);
+
+			if (cur_depth < least_depth)
+			{
+				least = i;
+				least_depth = cur_depth;
+			}
+		}
+
+		if (least_depth * 2 < depth)
+			slot->worker = worker_id = least;
+	}
+
+	slot->last_sent = workers_pool[worker_id].modifies_sent + 1;
+	return worker_id;
+}
+
 /*
  * Spreads the index modify recovery record to the recovery workers pool.
  *
@@ -3528,13 +3863,13 @@ spread_idx_modify(BTreeDescr *desc, RecoveryMsgType recType, OTuple rec)
 			if (key_pfree)
 				pfree(key.data);
 #endif
-			worker_send_modify(GET_WORKER_ID(hash), desc,
+			worker_send_modify(recovery_route_worker(hash), desc,
 							   recType, rec, tup_len);
 			break;
 		case RecoveryMsgTypeDelete:
 			key_len = o_btree_len(desc, rec, OKeyLength);
 			hash = o_btree_hash(desc, rec, BTreeKeyNonLeafKey);
-			worker_send_modify(GET_WORKER_ID(hash), desc, recType,
+			worker_send_modify(recovery_route_worker(hash), desc, recType,
 							   rec, key_len);
 			break;
 		default:
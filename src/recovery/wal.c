@@ -21,9 +21,13 @@
 #include "recovery/wal.h"
 #include "tableam/descr.h"
 #include "transam/oxid.h"
+#include "utils/compress.h"
 
+#include "access/xlog.h"
+#include "common/hashfn.h"
 #include "replication/message.h"
 #include "storage/proc.h"
+#include "utils/wait_event.h"
 
 static char local_wal_buffer[LOCAL_WAL_BUFFER_SIZE];
 static int	local_wal_buffer_offset = 0;
@@ -194,6 +198,84 @@ wal_joint_commit(OXid oxid, TransactionId logicalXid, TransactionId xid)
 	return walPos;
 }
 
+/*
+ * Flushes WAL up to the commit position with the group commit.
+ *
+ * The orioledb-only transactions have no PostgreSQL xids, so they aren't
+ * counted by the commit_siblings check of the builtin commit_delay.  Here
+ * the siblings are the other backends, whose commit records are inserted
+ * but not yet flushed.  The backend with the earliest such record is the
+ * leader: it sleeps for orioledb.commit_delay and then flushes the records of
+ * all the siblings at once.  The followers wait for the leader's flush
+ * instead of issuing their own.
+ */
+void
+wal_commit_flush(XLogRecPtr flushPos)
+{
+	XLogRecPtr	groupPos = flushPos;
+	bool		isLeader = true;
+	int			nsiblings = 0;
+	int			i;
+
+	if (orioledb_commit_delay <= 0 || !enableFsync || !XLogNeedsFlush(flushPos))
+	{
+		XLogFlush(flushPos);
+		return;
+	}
+
+	for (i = 0; i < max_procs; i++)
+	{
+		XLogRecPtr	pos;
+
+		if (i == MYPROCNUMBER)
+			continue;
+
+		pos = pg_atomic_read_u64(&oProcData[i].commitInProgressXlogLocation);
+		if (pos == OWalInvalidCommitPos || pos == OWalTmpCommitPos ||
+			!XLogNeedsFlush(pos))
+			continue;
+
+		nsiblings++;
+		if (pos < flushPos)
+			isLeader = false;
+		groupPos = Max(groupPos, pos);
+	}
+
+	if (nsiblings >= CommitSiblings)
+	{
+		pgstat_report_wait_start(WAIT_EVENT_COMMIT_DELAY);
+		if (isLeader)
+		{
+			pg_usleep(orioledb_commit_delay);
+
+			/* Take the records inserted while we were sleeping */
+			for (i = 0; i < max_procs; i++)
+			{
+				XLogRecPtr	pos;
+
+				pos = pg_atomic_read_u64(&oProcData[i].commitInProgressXlogLocation);
+				if (pos != OWalInvalidCommitPos && pos != OWalTmpCommitPos)
+					groupPos = Max(groupPos, pos);
+			}
+			flushPos = groupPos;
+		}
+		else
+		{
+			long		waited = 0;
+
+			/* Give the leader a chance, then flush ourselves anyway */
+			while (waited < 2L * orioledb_commit_delay && XLogNeedsFlush(flushPos))
+			{
+				pg_usleep(orioledb_commit_delay / 10 + 1);
+				waited += orioledb_commit_delay / 10 + 1;
+			}
+		}
+		pgstat_report_wait_end();
+	}
+
+	XLogFlush(flushPos);
+}
+
 void
 wal_after_commit()
 {
@@ -458,12 +540,73 @@ flush_local_wal_if_needed(int required_length)
 	}
 }
 
+/*
+ * Inserts the WAL container.  The containers of at least
+ * orioledb.wal_compress_threshold bytes are compressed when
+ * orioledb.wal_compress is set, unless the compression doesn't save space.
+ */
 XLogRecPtr
 log_logical_wal_container(Pointer ptr, int length)
 {
+	static char compressed[LOCAL_WAL_BUFFER_SIZE];
+	WALCompressedContainerHeader header;
+	size_t		compressedLength = 0;
+	uint32		rawLength = length;
+
+	if (OCompressIsValid(wal_compress) && length >= wal_compress_threshold)
+		compressedLength = o_compress_buffer(ptr, length, compressed,
+											 Min(length - sizeof(header),
+												 sizeof(compressed)),
+											 OCompressMake(wal_compress_codec,
+														   wal_compress));
+
 	XLogBeginInsert();
-	XLogRegisterData(ptr, length);
-	return XLogInsert(ORIOLEDB_RMGR_ID, ORIOLEDB_XLOG_CONTAINER);
+	if (compressedLength == 0)
+	{
+		XLogRegisterData(ptr, length);
+		return XLogInsert(ORIOLEDB_RMGR_ID, ORIOLEDB_XLOG_CONTAINER);
+	}
+
+	header.codec = wal_compress_codec;
+	memcpy(header.rawLength, &rawLength, sizeof(rawLength));
+	XLogRegisterData((Pointer) &header, sizeof(header));
+	XLogRegisterData(compressed, compressedLength);
+	return XLogInsert(ORIOLEDB_RMGR_ID, ORIOLEDB_XLOG_CONTAINER_COMPRESSED);
+}
+
+/*
+ * Returns the WAL container of the record, decompressing it if needed.  The
+ * decompressed container is valid till the next call.
+ */
+Pointer
+wal_container_get_data(XLogReaderState *record, int *length)
+{
+	static char decompressed[LOCAL_WAL_BUFFER_SIZE];
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+	WALCompressedContainerHeader header;
+	uint32		rawLength;
+
+	if (info == ORIOLEDB_XLOG_CONTAINER)
+	{
+		*length = XLogRecGetDataLen(record);
+		return (Pointer) XLogRecGetData(record);
+	}
+
+	if (info != ORIOLEDB_XLOG_CONTAINER_COMPRESSED ||
+		XLogRecGetDataLen(record) < sizeof(header))
+		elog(PANIC, "unexpected orioledb WAL record info %u", info);
+
+	memcpy(&header, XLogRecGetData(record), sizeof(header));
+	memcpy(&rawLength, header.rawLength, sizeof(rawLength));
+	if (rawLength > sizeof(decompressed))
+		elog(PANIC, "too long compressed orioledb WAL container: %u", rawLength);
+
+	o_decompress_buffer(header.codec,
+						(Pointer) XLogRecGetData(record) + sizeof(header),
+						XLogRecGetDataLen(record) - sizeof(header),
+						decompressed, rawLength);
+	*length = rawLength;
+	return decompressed;
 }
 
 /*
@@ -498,6 +641,115 @@ o_wal_update(BTreeDescr *desc, OTuple tuple)
 		pfree(wal_record.data);
 }
 
+/*
+ * Makes WAL update record of the primary tuple as the difference to the old
+ * tuple: the common prefix and suffix of the tuples are omitted.  Falls back
+ * to the full update record if the difference is not shorter, or if the
+ * logical decoding needs the whole new tuple.
+ */
+void
+o_wal_update_delta(BTreeDescr *desc, OTuple oldTuple, OTuple newTuple)
+{
+	OIndexDescr *id = (OIndexDescr *) desc->arg;
+	WALRecUpdateDelta *rec;
+	OTuple		key;
+	bool		key_pfree;
+	int			oldLength,
+				newLength,
+				minLength,
+				keyLength,
+				prefix = 0,
+				suffix = 0,
+				required_length;
+	OffsetNumber len;
+	pg_crc32c	crc;
+	uint64		hash;
+
+	/* Do not write WAL during recovery */
+	if (OXidIsValid(recovery_oxid))
+		return;
+
+	Assert(!IS_SYS_TREE_OIDS(desc->oids) && desc->type == oIndexPrimary);
+
+	if (!wal_update_delta || XLogLogicalInfoActive() ||
+		O_TUPLE_IS_NULL(oldTuple) ||
+		oldTuple.formatFlags != newTuple.formatFlags)
+	{
+		o_wal_update(desc, newTuple);
+		return;
+	}
+
+	oldLength = o_btree_len(desc, oldTuple, OTupleLength);
+	newLength = o_btree_len(desc, newTuple, OTupleLength);
+	minLength = Min(oldLength, newLength);
+
+	while (prefix < minLength && oldTuple.data[prefix] == newTuple.data[prefix])
+		prefix++;
+	while (suffix < minLength - prefix &&
+		   oldTuple.data[oldLength - suffix - 1] == newTuple.data[newLength - suffix - 1])
+		suffix++;
+
+	key = o_btree_tuple_make_key(desc, newTuple, NULL, true, &key_pfree);
+	keyLength = o_btree_len(desc, key, OKeyLength);
+
+	if (sizeof(WALRecUpdateDelta) + keyLength + newLength - prefix - suffix >=
+		sizeof(WALRecModify) + newLength)
+	{
+		if (key_pfree)
+			pfree(key.data);
+		o_wal_update(desc, newTuple);
+		return;
+	}
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, oldTuple.data, oldLength);
+	FIN_CRC32C(crc);
+	hash = hash_bytes_extended((const unsigned char *) newTuple.data,
+							   newLength, 0);
+
+	required_length = sizeof(WALRecUpdateDelta) + keyLength +
+		newLength - prefix - suffix;
+
+	if (!ORelOidsIsEqual(local_oids, id->tableOids) || local_type != oIndexInvalid)
+		required_length += sizeof(WALRecRelation);
+
+	flush_local_wal_if_needed(required_length);
+	Assert(local_wal_buffer_offset + required_length <= LOCAL_WAL_BUFFER_SIZE);
+
+	add_xid_wal_record_if_needed();
+
+	if (!ORelOidsIsEqual(local_oids, id->tableOids) || local_type != oIndexInvalid)
+		add_rel_wal_record(id->tableOids, oIndexInvalid);
+
+	rec = (WALRecUpdateDelta *) (&local_wal_buffer[local_wal_buffer_offset]);
+	rec->recType = WAL_REC_UPDATE_DELTA;
+	rec->keyFormatFlags = key.formatFlags;
+	len = keyLength;
+	memcpy(rec->keyLength, &len, sizeof(OffsetNumber));
+	rec->tupleFormatFlags = newTuple.formatFlags;
+	len = newLength;
+	memcpy(rec->tupleLength, &len, sizeof(OffsetNumber));
+	len = prefix;
+	memcpy(rec->prefixLength, &len, sizeof(OffsetNumber));
+	len = suffix;
+	memcpy(rec->suffixLength, &len, sizeof(OffsetNumber));
+	len = oldLength;
+	memcpy(rec->baseLength, &len, sizeof(OffsetNumber));
+	memcpy(rec->baseChecksum, &crc, sizeof(pg_crc32c));
+	memcpy(rec->tupleHash, &hash, sizeof(uint64));
+	local_wal_buffer_offset += sizeof(*rec);
+
+	memcpy(&local_wal_buffer[local_wal_buffer_offset], key.data, keyLength);
+	local_wal_buffer_offset += keyLength;
+	memcpy(&local_wal_buffer[local_wal_buffer_offset], newTuple.data + prefix,
+		   newLength - prefix - suffix);
+	local_wal_buffer_offset += newLength - prefix - suffix;
+	local_wal_has_material_changes = true;
+
+	if (key_pfree)
+		pfree(key.data);
+}
+
 /*
  * Makes WAL delete record.
  */
@@ -15,12 +15,15 @@
 
 #include "orioledb.h"
 
+#include "btree/io.h"
+#include "btree/iterator.h"
 #include "btree/modify.h"
 #include "catalog/indices.h"
 #include "catalog/o_sys_cache.h"
 #include "catalog/o_tables.h"
 #include "recovery/recovery.h"
 #include "recovery/internal.h"
+#include "recovery/wal.h"
 #include "storage/itemptr.h"
 #include "tableam/descr.h"
 #include "tableam/operations.h"
@@ -29,6 +32,7 @@
 #include "tuple/slot.h"
 #include "workers/interrupt.h"
 
+#include "common/hashfn.h"
 #include "miscadmin.h"
 #include "postmaster/bgworker.h"
 #include "postmaster/interrupt.h"
@@ -47,9 +51,32 @@
 #define QUEUE_READ_USLEEP_MULTIPLER	(2)
 #define QUEUE_READ_USLEEP_MAX		(1024 * QUEUE_READ_USLEEP_BASE)
 
+/* Maximum number of the insert messages applied as a single batch */
+#define RECOVERY_INSERT_BATCH_SIZE	(256)
+
+typedef struct
+{
+	OBTreeKeyBound key;
+	OTuple		tuple;
+	int			index;
+} RecoveryInsertBatchItem;
+
 static bool detached = false;
 static CommitSeqNo my_ptr;
 static bool recovery_initialized = false;
+static uint64 applied_modifies = 0;
+
+/*
+ * Consecutive insert messages of the same transaction into the same table,
+ * which are not applied yet.  The tuples point to the message read from the
+ * queue, so the batch is applied before the next read.
+ */
+static RecoveryInsertBatchItem *insert_batch = NULL;
+static int	insert_batch_len = 0;
+static OTableDescr *insert_batch_descr = NULL;
+
+/* Secondary index tuples of the batch being applied */
+static RecoveryInsertBatchItem *index_batch = NULL;
 
 static void recovery_queue_process(shm_mq_handle *queue, int id);
 static inline Pointer recovery_queue_read(shm_mq_handle *queue, Size *data_size, int id);
@@ -58,6 +85,15 @@ static void apply_tbl_modify_record(OTableDescr *descr,
 									OTuple p, OXid oxid, CommitSeqNo csn);
 static void apply_tbl_insert(OTableDescr *descr, OTuple tuple,
 							 OXid oxid, CommitSeqNo csn);
+static void apply_tbl_insert_primary(OTableDescr *descr, OTuple tuple,
+									 OXid oxid, CommitSeqNo csn,
+									 BTreeLocationHint *hint);
+static void apply_index_insert(OIndexDescr *id, bool isPrimary, OTuple tuple,
+							   OBTreeKeyBound *keyBound, OXid oxid,
+							   CommitSeqNo csn, BTreeLocationHint *hint);
+static void insert_batch_flush(int id);
+static void recovery_queue_prefetch(Pointer data, Size data_size,
+									OIndexDescr *indexDescr);
 static void apply_tbl_delete(OTableDescr *descr, OTuple key,
 							 OXid oxid, CommitSeqNo csn);
 static void apply_tbl_update(OTableDescr *descr, OTuple tuple,
@@ -347,6 +383,9 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 			break;
 
 		Assert(data != NULL);
+		if (recovery_prefetch_guc && indexDescr != NULL)
+			recovery_queue_prefetch(data, data_size, indexDescr);
+
 		data_pos = 0;
 		while (data_pos < data_size)
 		{
@@ -355,12 +394,18 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 			recovery_header = (RecoveryMsgHeader *) (data + data_pos);
 			type = (recovery_header->type & RECOVERY_MSG_OPERATION_MASK);
 
+			if (type != RecoveryMsgTypeInsert ||
+				(recovery_header->type & (RECOVERY_MODIFY_OXID | RECOVERY_MODIFY_OIDS)))
+				insert_batch_flush(id);
+
 			if (type == RecoveryMsgTypeInsert ||
 				type == RecoveryMsgTypeUpdate ||
 				type == RecoveryMsgTypeDelete ||
+				type == RecoveryMsgTypeUpdateDelta ||
 				type == RecoveryMsgTypeBridgeErase)
 			{
 				OTuple		tuple;
+				bool		batched = false;
 
 				data_pos += sizeof(RecoveryMsgHeader);
 				if (recovery_header->type & RECOVERY_MODIFY_OXID)
@@ -426,12 +471,36 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 						Assert(ORelOidsIsValid(oids));
 
 						tuple.data = data + data_pos;
-						apply_modify_record(descr, indexDescr,
-											type,
-											tuple);
+						if (type == RecoveryMsgTypeInsert && descr &&
+							toast_consistent)
+						{
+							RecoveryInsertBatchItem *item;
+
+							if (insert_batch == NULL)
+								insert_batch = MemoryContextAlloc(TopMemoryContext,
+																  sizeof(RecoveryInsertBatchItem) *
+																  RECOVERY_INSERT_BATCH_SIZE);
+							item = &insert_batch[insert_batch_len];
+							item->tuple = tuple;
+							item->index = insert_batch_len;
+							insert_batch_descr = descr;
+							batched = true;
+							if (++insert_batch_len == RECOVERY_INSERT_BATCH_SIZE)
+								insert_batch_flush(id);
+						}
+						else if (type == RecoveryMsgTypeUpdateDelta)
+							apply_update_delta_record(descr, indexDescr,
+													  tuple.data);
+						else
+							apply_modify_record(descr, indexDescr,
+												type,
+												tuple);
 					}
 					data_pos += tuple_len;
 				}
+				if (!batched)
+					pg_atomic_write_u64(&worker_ptrs[id].appliedModifies,
+										++applied_modifies);
 			}
 			else if (type == RecoveryMsgTypeLeaderParallelIndexBuild)
 			{
@@ -618,6 +687,7 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 			}
 			data_pos = MAXALIGN(data_pos);
 		}
+		insert_batch_flush(id);
 		update_recovery_undo_loc_flush(false, id);
 	}
 	if (descr)
@@ -626,6 +696,203 @@ recovery_queue_process(shm_mq_handle *queue, int id)
 	MemoryContextDelete(recovery_context);
 }
 
+/*
+ * Starts reading of the evicted leaves, which the modify messages read from
+ * the queue are going to modify.  So, the reads for the following messages
+ * overlap with applying the previous ones instead of blocking each of them
+ * in load_page().  Only the messages to the current tree are examined:
+ * looking through the messages stops at the switch to another tree or at
+ * a message, which is not trivial to skip.
+ */
+static void
+recovery_queue_prefetch(Pointer data, Size data_size, OIndexDescr *indexDescr)
+{
+	Size		data_pos = 0;
+
+	o_btree_load_shmem(&indexDescr->desc);
+
+	while (data_pos < data_size)
+	{
+		RecoveryMsgHeader *header = (RecoveryMsgHeader *) (data + data_pos);
+		RecoveryMsgType type = (header->type & RECOVERY_MSG_OPERATION_MASK);
+
+		if (type == RecoveryMsgTypeInsert ||
+			type == RecoveryMsgTypeUpdate ||
+			type == RecoveryMsgTypeDelete ||
+			type == RecoveryMsgTypeUpdateDelta)
+		{
+			OTuple		tuple;
+			int			tuple_len;
+
+			if (header->type & RECOVERY_MODIFY_OIDS)
+				return;
+
+			data_pos += sizeof(RecoveryMsgHeader);
+			if (header->type & RECOVERY_MODIFY_OXID)
+				data_pos += sizeof(OXid);
+
+			memcpy(&tuple_len, data + data_pos, sizeof(int));
+			data_pos += sizeof(int);
+			memcpy(&tuple.formatFlags, data + data_pos, 1);
+			data_pos++;
+			data_pos = MAXALIGN(data_pos);
+			tuple.data = data + data_pos;
+
+			if (type == RecoveryMsgTypeUpdateDelta)
+			{
+				WALRecUpdateDelta rec;
+				OFixedKey	key;
+				OffsetNumber keyLength;
+
+				/* The key follows the header of the record */
+				memcpy(&rec, tuple.data, sizeof(rec));
+				memcpy(&keyLength, rec.keyLength, sizeof(OffsetNumber));
+				key.tuple.formatFlags = rec.keyFormatFlags;
+				key.tuple.data = key.fixedData;
+				memcpy(key.fixedData, tuple.data + sizeof(rec), keyLength);
+				prefetch_leaf_for_key(&indexDescr->desc, (Pointer) &key.tuple,
+									  BTreeKeyNonLeafKey);
+			}
+			else if (type == RecoveryMsgTypeDelete)
+				prefetch_leaf_for_key(&indexDescr->desc, (Pointer) &tuple,
+									  BTreeKeyNonLeafKey);
+			else
+				prefetch_leaf_for_key(&indexDescr->desc, (Pointer) &tuple,
+									  BTreeKeyLeafTuple);
+			data_pos += tuple_len;
+		}
+		else if (type == RecoveryMsgTypeCommit ||
+				 type == RecoveryMsgTypeRollback)
+			data_pos += sizeof(RecoveryMsgOXidPtr);
+		else if (type == RecoveryMsgTypeSynchronize)
+			data_pos += sizeof(RecoveryMsgPtr);
+		else if (type == RecoveryMsgTypeSavepoint)
+			data_pos += sizeof(RecoveryMsgSavepoint);
+		else if (type == RecoveryMsgTypeRollbackToSavepointt)
+			data_pos += sizeof(RecoveryMsgRollbackToSavepoint);
+		else
+			return;
+		data_pos = MAXALIGN(data_pos);
+	}
+}
+
+static int
+insert_batch_item_cmp(const void *a, const void *b, void *arg)
+{
+	const RecoveryInsertBatchItem *item1 = (const RecoveryInsertBatchItem *) a;
+	const RecoveryInsertBatchItem *item2 = (const RecoveryInsertBatchItem *) b;
+	BTreeDescr *desc = (BTreeDescr *) arg;
+	int			cmp;
+
+	cmp = o_btree_cmp(desc, (Pointer) &item1->key, BTreeKeyBound,
+					  (Pointer) &item2->key, BTreeKeyBound);
+	if (cmp != 0)
+		return cmp;
+
+	/* keep the WAL order of the same key */
+	return item1->index - item2->index;
+}
+
+/*
+ * Inserts the tuples of the batch into the secondary index in the order of
+ * its key.
+ */
+static void
+insert_batch_apply_secondary(OTableDescr *descr, OIndexDescr *id, OXid oxid)
+{
+	BTreeLocationHint hint = {OInvalidInMemoryBlkno, 0};
+	TupleTableSlot *slot = descr->newTuple;
+	int			i,
+				count = 0;
+
+	for (i = 0; i < insert_batch_len; i++)
+	{
+		RecoveryInsertBatchItem *item = &index_batch[count];
+
+		tts_orioledb_store_tuple(slot, insert_batch[i].tuple, descr,
+								 COMMITSEQNO_INPROGRESS, PrimaryIndexNumber,
+								 false, NULL);
+		if (o_is_index_predicate_satisfied(id, slot, id->econtext))
+		{
+			item->tuple = tts_orioledb_make_secondary_tuple(slot, id, true);
+			item->index = insert_batch[i].index;
+			o_fill_key_bound(id, item->tuple, BTreeKeyLeafTuple, &item->key);
+			count++;
+		}
+		ExecClearTuple(slot);
+	}
+
+	if (count > 1)
+		qsort_arg(index_batch, count, sizeof(RecoveryInsertBatchItem),
+				  insert_batch_item_cmp, &id->desc);
+
+	for (i = 0; i < count; i++)
+	{
+		apply_index_insert(id, false, index_batch[i].tuple,
+						   &index_batch[i].key, oxid,
+						   COMMITSEQNO_INPROGRESS, &hint);
+		pfree(index_batch[i].tuple.data);
+	}
+}
+
+/*
+ * Applies the batch of insert messages.
+ *
+ * The inserts are applied to the primary index in the order of primary key,
+ * so every next tuple is likely to go to the same leaf as the previous one,
+ * and we search for it from the previous leaf using location hint instead of
+ * descent from the root.  Then the batch is applied to every secondary index
+ * in the order of its own key the same way.  The batch contains only inserts
+ * within the same transaction and is applied before its commit, so
+ * reordering of different keys doesn't change the result.
+ */
+static void
+insert_batch_flush(int id)
+{
+	OTableDescr *descr = insert_batch_descr;
+	OIndexDescr *primary;
+	BTreeLocationHint hint = {OInvalidInMemoryBlkno, 0};
+	OXid		oxid;
+	int			i;
+
+	if (insert_batch_len == 0)
+		return;
+
+	primary = GET_PRIMARY(descr);
+	oxid = get_current_oxid();
+
+	if (insert_batch_len > 1)
+	{
+		for (i = 0; i < insert_batch_len; i++)
+			o_fill_key_bound(primary, insert_batch[i].tuple,
+							 BTreeKeyLeafTuple, &insert_batch[i].key);
+		qsort_arg(insert_batch, insert_batch_len,
+				  sizeof(RecoveryInsertBatchItem),
+				  insert_batch_item_cmp, &primary->desc);
+	}
+
+	o_set_syscache_hooks();
+	for (i = 0; i < insert_batch_len; i++)
+	{
+		apply_tbl_insert_primary(descr, insert_batch[i].tuple,
+								 oxid, COMMITSEQNO_INPROGRESS, &hint);
+		ExecClearTuple(descr->newTuple);
+	}
+
+	if (descr->nIndices > 1 && index_batch == NULL)
+		index_batch = MemoryContextAlloc(TopMemoryContext,
+										 sizeof(RecoveryInsertBatchItem) *
+										 RECOVERY_INSERT_BATCH_SIZE);
+	for (i = PrimaryIndexNumber + 1; i < descr->nIndices; i++)
+		insert_batch_apply_secondary(descr, descr->indices[i], oxid);
+	o_unset_syscache_hooks();
+
+	applied_modifies += insert_batch_len;
+	pg_atomic_write_u64(&worker_ptrs[id].appliedModifies, applied_modifies);
+	insert_batch_len = 0;
+	insert_batch_descr = NULL;
+}
+
 /*
  * Apply the modify WAL record.
  */
@@ -654,6 +921,91 @@ apply_modify_record(OTableDescr *descr, OIndexDescr *id, uint16 type,
 	}
 }
 
+/*
+ * Apply the update WAL record logged as the difference to the old tuple.
+ *
+ * The new tuple is rebuilt from the old tuple found in the primary tree by the
+ * record key.  The record is skipped if the tree contains another tuple than
+ * the base of the difference.  That happens only when the tree image is
+ * already ahead of the record, because the checkpoint images are written
+ * concurrently with the modifications.  The following records then bring the
+ * tuple to the proper state.  The base is matched by its format, length and
+ * CRC, and the rebuilt tuple must also match the 64-bit hash of the new
+ * tuple, so a checksum collision can't make us apply a wrong tuple.
+ */
+void
+apply_update_delta_record(OTableDescr *descr, OIndexDescr *id, Pointer data)
+{
+	WALRecUpdateDelta rec;
+	OFixedKey	key;
+	OFixedTuple tuple;
+	OTuple		oldTuple;
+	OffsetNumber keyLength,
+				tupleLength,
+				prefix,
+				suffix,
+				baseLength;
+	pg_crc32c	baseChecksum;
+	uint64		tupleHash;
+	CommitSeqNo csn;
+	bool		found = false;
+
+	memcpy(&rec, data, sizeof(rec));
+	memcpy(&keyLength, rec.keyLength, sizeof(OffsetNumber));
+	memcpy(&tupleLength, rec.tupleLength, sizeof(OffsetNumber));
+	memcpy(&prefix, rec.prefixLength, sizeof(OffsetNumber));
+	memcpy(&suffix, rec.suffixLength, sizeof(OffsetNumber));
+	memcpy(&baseLength, rec.baseLength, sizeof(OffsetNumber));
+	memcpy(&baseChecksum, rec.baseChecksum, sizeof(pg_crc32c));
+	memcpy(&tupleHash, rec.tupleHash, sizeof(uint64));
+	data += sizeof(rec);
+
+	key.tuple.formatFlags = rec.keyFormatFlags;
+	key.tuple.data = key.fixedData;
+	memcpy(key.fixedData, data, keyLength);
+	data += keyLength;
+
+	o_btree_load_shmem(&id->desc);
+	oldTuple = o_btree_find_tuple_by_key(&id->desc, (Pointer) &key.tuple,
+										 BTreeKeyNonLeafKey,
+										 &o_in_progress_snapshot, &csn,
+										 CurrentMemoryContext, NULL);
+
+	if (!O_TUPLE_IS_NULL(oldTuple) &&
+		oldTuple.formatFlags == rec.tupleFormatFlags &&
+		o_btree_len(&id->desc, oldTuple, OTupleLength) == baseLength)
+	{
+		pg_crc32c	crc;
+
+		INIT_CRC32C(crc);
+		COMP_CRC32C(crc, oldTuple.data, baseLength);
+		FIN_CRC32C(crc);
+		found = EQ_CRC32C(crc, baseChecksum);
+	}
+
+	if (!found)
+	{
+		if (!O_TUPLE_IS_NULL(oldTuple))
+			pfree(oldTuple.data);
+		return;
+	}
+
+	Assert(prefix + suffix <= Min(baseLength, tupleLength));
+	tuple.tuple.formatFlags = rec.tupleFormatFlags;
+	tuple.tuple.data = tuple.fixedData;
+	memcpy(tuple.fixedData, oldTuple.data, prefix);
+	memcpy(tuple.fixedData + prefix, data, tupleLength - prefix - suffix);
+	memcpy(tuple.fixedData + tupleLength - suffix,
+		   oldTuple.data + baseLength - suffix, suffix);
+	pfree(oldTuple.data);
+
+	if (hash_bytes_extended((const unsigned char *) tuple.fixedData,
+							tupleLength, 0) != tupleHash)
+		return;
+
+	apply_modify_record(descr, id, RecoveryMsgTypeUpdate, tuple.tuple);
+}
+
 /*
  * Reads a message from the queue.
  */
@@ -754,97 +1106,102 @@ apply_tbl_modify_record(OTableDescr *descr, RecoveryMsgType type,
 	o_unset_syscache_hooks();
 }
 
+/*
+ * Inserts the tuple into the single index of the table.
+ */
 static void
-apply_tbl_insert(OTableDescr *descr, OTuple tuple,
-				 OXid oxid, CommitSeqNo csn)
+apply_index_insert(OIndexDescr *id, bool isPrimary, OTuple tuple,
+				   OBTreeKeyBound *keyBound, OXid oxid, CommitSeqNo csn,
+				   BTreeLocationHint *hint)
 {
-	OBTreeKeyBound keyBound;
-	OTuple		stuple,
-				cur_tuple;
-	OIndexDescr *id;
-	int			i;
-	bool		isPrimary = false;
-	TupleTableSlot *slot = descr->newTuple;
 	BTreeModifyCallbackInfo callbackInfo = nullCallbackInfo;
+	int			attnum;
+
+	o_btree_load_shmem(&id->desc);
+	for (attnum = 0; attnum < id->nonLeafTupdesc->natts; attnum++)
+	{
+		FormData_pg_attribute attr = id->nonLeafTupdesc->attrs[attnum];
+
+		o_class_cache_preload_for_column(attr.atttypid);
+	}
 
-	O_TUPLE_SET_NULL(stuple);
+	if (isPrimary)
+	{
+		callbackInfo.modifyCallback = recovery_insert_primary_callback;
+		callbackInfo.modifyDeletedCallback = recovery_insert_deleted_primary_callback;
+	}
+	else
+	{
+		callbackInfo.modifyCallback = recovery_insert_overwrite_callback;
+		callbackInfo.modifyDeletedCallback = recovery_insert_deleted_overwrite_callback;
+	}
+	/* HACK: prevent sys cache pages from loading during o_btree_modify */
+	(void) o_btree_cmp(&id->desc, &tuple, BTreeKeyLeafTuple,
+					   (Pointer) keyBound, BTreeKeyBound);
+	(void) o_btree_modify(&id->desc, BTreeOperationInsert,
+						  tuple, BTreeKeyLeafTuple,
+						  (Pointer) keyBound, BTreeKeyBound,
+						  oxid, csn, RowLockUpdate,
+						  hint, &callbackInfo);
+}
+
+/*
+ * Inserts the tuple into the primary index.  Leaves the tuple stored in
+ * descr->newTuple for the secondary indices.
+ */
+static void
+apply_tbl_insert_primary(OTableDescr *descr, OTuple tuple,
+						 OXid oxid, CommitSeqNo csn, BTreeLocationHint *hint)
+{
+	OBTreeKeyBound keyBound;
+	OIndexDescr *primary = GET_PRIMARY(descr);
+	TupleTableSlot *slot = descr->newTuple;
 
 	tts_orioledb_store_tuple(slot, tuple, descr,
 							 csn, PrimaryIndexNumber, false, NULL);
 
-	if (GET_PRIMARY(descr)->primaryIsCtid)
+	if (primary->primaryIsCtid)
 	{
-		o_btree_load_shmem(&GET_PRIMARY(descr)->desc);
-		btree_ctid_update_if_needed(&GET_PRIMARY(descr)->desc,
-									slot->tts_tid);
+		o_btree_load_shmem(&primary->desc);
+		btree_ctid_update_if_needed(&primary->desc, slot->tts_tid);
 	}
 
 	if (descr->bridge)
 	{
 		OTableSlot *oslot = (OTableSlot *) slot;
 
-		o_btree_load_shmem(&GET_PRIMARY(descr)->desc);
-		btree_ctid_update_if_needed(&GET_PRIMARY(descr)->desc,
-									oslot->bridge_ctid);
+		o_btree_load_shmem(&primary->desc);
+		btree_ctid_update_if_needed(&primary->desc, oslot->bridge_ctid);
 	}
 
-	for (i = 0; i < descr->nIndices; i++)
-	{
-		int			attnum;
-
-		isPrimary = (i == PrimaryIndexNumber);
-		id = descr->indices[i];
-
-		if (!isPrimary)
-		{
-			stuple = tts_orioledb_make_secondary_tuple(slot, descr->indices[i], true);
-		}
+	tts_orioledb_fill_key_bound(slot, primary, &keyBound);
+	apply_index_insert(primary, true, tuple, &keyBound, oxid, csn, hint);
+}
 
-		if (!isPrimary)
-		{
-			if (!o_is_index_predicate_satisfied(id, slot, id->econtext))
-				continue;
-		}
+static void
+apply_tbl_insert(OTableDescr *descr, OTuple tuple,
+				 OXid oxid, CommitSeqNo csn)
+{
+	TupleTableSlot *slot = descr->newTuple;
+	int			i;
 
-		cur_tuple = isPrimary ? tuple : stuple;
+	apply_tbl_insert_primary(descr, tuple, oxid, csn, NULL);
 
-		o_btree_load_shmem(&id->desc);
-		for (attnum = 0; attnum < id->nonLeafTupdesc->natts; attnum++)
-		{
-			FormData_pg_attribute attr = id->nonLeafTupdesc->attrs[attnum];
+	for (i = PrimaryIndexNumber + 1; i < descr->nIndices; i++)
+	{
+		OIndexDescr *id = descr->indices[i];
+		OBTreeKeyBound keyBound;
+		OTuple		stuple;
 
-			o_class_cache_preload_for_column(attr.atttypid);
-		}
+		if (!o_is_index_predicate_satisfied(id, slot, id->econtext))
+			continue;
 
-		if (isPrimary)
-		{
-			callbackInfo.modifyCallback = recovery_insert_primary_callback;
-			callbackInfo.modifyDeletedCallback = recovery_insert_deleted_primary_callback;
-		}
-		else
-		{
-			callbackInfo.modifyCallback = recovery_insert_overwrite_callback;
-			callbackInfo.modifyDeletedCallback = recovery_insert_deleted_overwrite_callback;
-		}
+		stuple = tts_orioledb_make_secondary_tuple(slot, id, true);
 		tts_orioledb_fill_key_bound(slot, id, &keyBound);
-		/* HACK: prevent sys cache pages from loading during o_btree_modify */
-		(void) o_btree_cmp(&id->desc, &cur_tuple, BTreeKeyLeafTuple,
-						   (Pointer) &keyBound, BTreeKeyBound);
-		(void) o_btree_modify(&id->desc, BTreeOperationInsert,
-							  cur_tuple, BTreeKeyLeafTuple,
-							  (Pointer) &keyBound, BTreeKeyBound,
-							  oxid, csn, RowLockUpdate,
-							  NULL, &callbackInfo);
-
-		if (!isPrimary)
-		{
-			pfree(stuple.data);
-			O_TUPLE_SET_NULL(stuple);
-		}
+		apply_index_insert(id, false, stuple, &keyBound, oxid, csn, NULL);
+		pfree(stuple.data);
 	}
 
-	if (!O_TUPLE_IS_NULL(stuple))
-		pfree(stuple.data);
 	ExecClearTuple(slot);
 }
 
@@ -1021,6 +1378,25 @@ apply_tbl_update(OTableDescr *descr, OTuple tuple,
 					pfree(new_stup.data);
 				}
 			}
+			else if (tts_orioledb_modified(old_slot, new_slot,
+										   tree->includedAttrs) &&
+					 o_is_index_predicate_satisfied(tree,
+													new_slot,
+													tree->econtext))
+			{
+				BTreeModifyCallbackInfo callbackInfo = nullCallbackInfo;
+
+				/* Only INCLUDE fields are modified, overwrite the tuple */
+				callbackInfo.modifyDeletedCallback = recovery_insert_deleted_overwrite_callback;
+				callbackInfo.modifyCallback = recovery_insert_overwrite_callback;
+				new_stup = tts_orioledb_make_secondary_tuple(new_slot, tree, true);
+				(void) o_btree_modify(&tree->desc, BTreeOperationInsert,
+									  new_stup, BTreeKeyLeafTuple,
+									  (Pointer) &new_key, BTreeKeyBound,
+									  oxid, csn, RowLockUpdate,
+									  NULL, &callbackInfo);
+				pfree(new_stup.data);
+			}
 		}
 	}
 
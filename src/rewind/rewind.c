@@ -33,6 +33,7 @@
 #include "storage/latch.h"
 #include "storage/proc.h"
 #include "storage/sinvaladt.h"
+#include "tcop/tcopprot.h"
 #include "utils/memutils.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
@@ -50,12 +51,243 @@ static bool rewindWorker = false;
 
 static OBuffersDesc rewindBuffersDesc = {
 	.singleFileSize = REWIND_FILE_SIZE,
-	.filenameTemplate = {ORIOLEDB_DATA_DIR "/%02X%08X.rewindmap"},
+	.filenameTemplate = {ORIOLEDB_DATA_DIR "/%02X%08X.rewindmap",
+	ORIOLEDB_DATA_DIR "/%02X%08X.rewindidx"},
 	.groupCtlTrancheName = "rewindBuffersGroupCtlTranche",
 	.bufferCtlTrancheName = "rewindBuffersCtlTranche"
 };
 static FullTransactionId GetOldestFullTransactionIdConsideredRunning(void);
 
+/*
+ * The evicted rewind items are stored in a compact form.  Every page of
+ * REWIND_DISK_BUFFER_LENGTH items is encoded as the varints of the deltas
+ * against the previous item of the page.  They are small for consecutive
+ * commits: oxids and xids go almost sequentially, undo locations and
+ * horizons grow slowly and timestamps are close.  The pages are appended to
+ * the buffer files and located by their numbers via the index files.
+ */
+#define ZIGZAG_ENCODE(d)	(((uint64) (d) << 1) ^ (uint64) ((int64) (d) >> 63))
+#define ZIGZAG_DECODE(v)	((int64) ((v) >> 1) ^ -(int64) ((v) & 1))
+
+static inline bool
+rewind_put_varint(char **ptr, char *end, uint64 value)
+{
+	while (value >= 0x80)
+	{
+		if (*ptr >= end)
+			return false;
+		*(*ptr)++ = (char) ((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	if (*ptr >= end)
+		return false;
+	*(*ptr)++ = (char) value;
+	return true;
+}
+
+static inline uint64
+rewind_get_varint(char **ptr)
+{
+	uint64		value = 0;
+	int			shift = 0;
+	uint8		byte;
+
+	do
+	{
+		byte = (uint8) *(*ptr)++;
+		value |= (uint64) (byte & 0x7F) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+
+	return value;
+}
+
+#define REWIND_PUT_DELTA(ptr, end, cur, prev) \
+	rewind_put_varint((ptr), (end), ZIGZAG_ENCODE((uint64) (cur) - (uint64) (prev)))
+#define REWIND_GET_DELTA(ptr, prev) \
+	((uint64) (prev) + (uint64) ZIGZAG_DECODE(rewind_get_varint(ptr)))
+
+static bool
+encode_rewind_item(RewindItem *item, RewindItem *prev, char **ptr, char *end)
+{
+	int			i;
+
+	if (*ptr >= end)
+		return false;
+	*(*ptr)++ = (char) item->tag;
+
+	if (!rewind_put_varint(ptr, end, (uint32) item->nsubxids) ||
+		!REWIND_PUT_DELTA(ptr, end, item->oxid, prev->oxid))
+		return false;
+
+	if (item->tag == SUBXIDS_ITEM_TAG)
+	{
+		SubxidsItem *subxidsItem = (SubxidsItem *) item;
+		TransactionId prevXid = prev->xid;
+
+		/* The unused tail of the last item is encoded as well */
+		for (i = 0; i < SUBXIDS_PER_ITEM; i++)
+		{
+			if (!REWIND_PUT_DELTA(ptr, end, subxidsItem->subxids[i], prevXid))
+				return false;
+			prevXid = subxidsItem->subxids[i];
+		}
+		return true;
+	}
+
+	if (!REWIND_PUT_DELTA(ptr, end, item->xid, prev->xid))
+		return false;
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		if (!REWIND_PUT_DELTA(ptr, end, item->onCommitUndoLocation[i],
+							  prev->onCommitUndoLocation[i]) ||
+			!REWIND_PUT_DELTA(ptr, end, item->undoLocation[i],
+							  prev->undoLocation[i]) ||
+			!REWIND_PUT_DELTA(ptr, end, item->minRetainLocation[i],
+							  prev->minRetainLocation[i]))
+			return false;
+	}
+	if (!REWIND_PUT_DELTA(ptr, end,
+						  U64FromFullTransactionId(item->oldestConsideredRunningXid),
+						  U64FromFullTransactionId(prev->oldestConsideredRunningXid)) ||
+		!REWIND_PUT_DELTA(ptr, end, item->runXmin, prev->runXmin) ||
+		!REWIND_PUT_DELTA(ptr, end, item->timestamp, prev->timestamp))
+		return false;
+
+	*prev = *item;
+	return true;
+}
+
+static void
+decode_rewind_item(RewindItem *item, RewindItem *prev, char **ptr)
+{
+	int			i;
+
+	memset(item, 0, sizeof(RewindItem));
+	item->tag = (uint8) *(*ptr)++;
+	item->nsubxids = (int) rewind_get_varint(ptr);
+	item->oxid = REWIND_GET_DELTA(ptr, prev->oxid);
+
+	if (item->tag == SUBXIDS_ITEM_TAG)
+	{
+		SubxidsItem *subxidsItem = (SubxidsItem *) item;
+		TransactionId prevXid = prev->xid;
+
+		for (i = 0; i < SUBXIDS_PER_ITEM; i++)
+		{
+			subxidsItem->subxids[i] = (TransactionId) REWIND_GET_DELTA(ptr, prevXid);
+			prevXid = subxidsItem->subxids[i];
+		}
+		return;
+	}
+
+	item->xid = (TransactionId) REWIND_GET_DELTA(ptr, prev->xid);
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		item->onCommitUndoLocation[i] = REWIND_GET_DELTA(ptr, prev->onCommitUndoLocation[i]);
+		item->undoLocation[i] = REWIND_GET_DELTA(ptr, prev->undoLocation[i]);
+		item->minRetainLocation[i] = REWIND_GET_DELTA(ptr, prev->minRetainLocation[i]);
+	}
+	item->oldestConsideredRunningXid =
+		FullTransactionIdFromU64(REWIND_GET_DELTA(ptr, U64FromFullTransactionId(prev->oldestConsideredRunningXid)));
+	item->runXmin = REWIND_GET_DELTA(ptr, prev->runXmin);
+	item->timestamp = (TimestampTz) REWIND_GET_DELTA(ptr, prev->timestamp);
+
+	*prev = *item;
+}
+
+/*
+ * Encodes the page of rewindAddBuffer items starting from startPos into buf,
+ * which has room for at least the raw page.  Returns the length of the
+ * encoded page.
+ */
+static uint32
+encode_rewind_page(uint64 startPos, char *buf, uint32 *flags)
+{
+	RewindItem	prev;
+	char	   *ptr = buf;
+	char	   *end = buf + REWIND_DISK_BUFFER_LENGTH * sizeof(RewindItem);
+	int			i;
+
+	memset(&prev, 0, sizeof(prev));
+	for (i = 0; i < REWIND_DISK_BUFFER_LENGTH; i++)
+	{
+		RewindItem *item = &rewindAddBuffer[(startPos + i) % rewind_circular_buffer_size];
+
+		Assert(item->tag != EMPTY_ITEM_TAG);
+		if (!encode_rewind_item(item, &prev, &ptr, end))
+			break;
+	}
+
+	if (i == REWIND_DISK_BUFFER_LENGTH)
+	{
+		*flags = 0;
+		return ptr - buf;
+	}
+
+	for (i = 0; i < REWIND_DISK_BUFFER_LENGTH; i++)
+		memcpy(buf + i * sizeof(RewindItem),
+			   &rewindAddBuffer[(startPos + i) % rewind_circular_buffer_size],
+			   sizeof(RewindItem));
+	*flags = REWIND_PAGE_RAW;
+	return REWIND_DISK_BUFFER_LENGTH * sizeof(RewindItem);
+}
+
+/*
+ * Reads the evicted page by its number.  Returns the offset in the buffer
+ * files after the page.
+ */
+static uint64
+read_rewind_disk_page(uint64 pageNum, RewindItem *items)
+{
+	RewindDiskPageRef ref;
+	char		buf[REWIND_DISK_BUFFER_LENGTH * sizeof(RewindItem)];
+
+	o_buffers_read(&rewindBuffersDesc, (Pointer) &ref, REWIND_INDEX_TAG,
+				   pageNum * sizeof(RewindDiskPageRef),
+				   sizeof(RewindDiskPageRef));
+	Assert(ref.length <= sizeof(buf));
+
+	if (ref.flags & REWIND_PAGE_RAW)
+	{
+		o_buffers_read(&rewindBuffersDesc, (Pointer) items, REWIND_BUFFERS_TAG,
+					   ref.offset, ref.length);
+	}
+	else
+	{
+		RewindItem	prev;
+		char	   *ptr = buf;
+		int			i;
+
+		o_buffers_read(&rewindBuffersDesc, (Pointer) buf, REWIND_BUFFERS_TAG,
+					   ref.offset, ref.length);
+		memset(&prev, 0, sizeof(prev));
+		for (i = 0; i < REWIND_DISK_BUFFER_LENGTH; i++)
+			decode_rewind_item(&items[i], &prev, &ptr);
+		Assert(ptr == buf + ref.length);
+	}
+
+	return ref.offset + ref.length;
+}
+
+/*
+ * Finds the evicted page containing pos given the consistent pair of evictPos
+ * and evictPageNum.  The evicted pages go contiguously up to evictPos.
+ */
+static uint64
+rewind_disk_page_for_pos(uint64 pos, uint64 evictPos, uint64 evictPageNum,
+						 uint64 *startPos)
+{
+	uint64		back = (evictPos - 1 - pos) / REWIND_DISK_BUFFER_LENGTH;
+
+	Assert(pos < evictPos);
+	*startPos = evictPos - (back + 1) * REWIND_DISK_BUFFER_LENGTH;
+	return evictPageNum - 1 - back;
+}
+
+/* Interval between the rewind progress reports in ms */
+#define REWIND_PROGRESS_INTERVAL (10000)
+
 /* Temporary storage for heap info between pre-commit and commit in a backend */
 static TransactionId precommit_xid;
 static int	precommit_nsubxids;
@@ -78,6 +310,9 @@ PG_FUNCTION_INFO_V1(orioledb_rewind_set_complete);
 #define REWIND_MODE_TIMESTAMP (2)
 #define	REWIND_MODE_XID	(3)
 
+static void rewind_sample_csn(void);
+static void rewind_evict_ahead(void);
+static void evict_rewind_items(uint64 curAddPosFilled);
 static void orioledb_rewind_internal(int rewind_mode, int rewind_time, OXid rewind_oxid, TransactionId rewind_xid, TimestampTz rewind_timestamp);
 
 /* Interface functions */
@@ -291,10 +526,9 @@ log_print_rewind_queue(void)
 	{
 		RewindItem	buffer[REWIND_DISK_BUFFER_LENGTH];
 
-		o_buffers_read(&rewindBuffersDesc,
-					   (Pointer) &buffer, REWIND_BUFFERS_TAG,
-					   pos * sizeof(RewindItem),
-					   REWIND_DISK_BUFFER_LENGTH * sizeof(RewindItem));
+		(void) read_rewind_disk_page(rewindMeta->restorePageNum +
+									 (pos - rewindMeta->restorePos) / REWIND_DISK_BUFFER_LENGTH,
+									 buffer);
 
 		for (i = 0; i < REWIND_DISK_BUFFER_LENGTH; i++)
 		{
@@ -327,6 +561,144 @@ rewind_shmem_needs(void)
 	return size;
 }
 
+/*
+ * Starts the workers applying the undo of the rewound transactions in
+ * parallel with the rewinding backend.  Rewind goes on with fewer workers if
+ * some of them couldn't start.
+ */
+static BackgroundWorkerHandle **
+start_rewind_apply_workers(int *nworkers)
+{
+	BackgroundWorkerHandle **handles;
+	int			i,
+				n = 0;
+
+	handles = palloc0(sizeof(BackgroundWorkerHandle *) *
+					  Max(rewind_parallel_workers, 1));
+	rewindMeta->applyFinished = false;
+	rewindMeta->applyBatchLength = 0;
+	pg_atomic_write_u32(&rewindMeta->applyBatchNum, 0);
+	pg_atomic_write_u32(&rewindMeta->applyWorkersDone, 0);
+
+	for (i = 0; i < rewind_parallel_workers; i++)
+	{
+		BackgroundWorker worker;
+		pid_t		pid;
+
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+		worker.bgw_restart_time = BGW_NEVER_RESTART;
+		worker.bgw_main_arg = Int32GetDatum(n);
+		worker.bgw_notify_pid = MyProcPid;
+		strcpy(worker.bgw_library_name, "orioledb");
+		strcpy(worker.bgw_function_name, "rewind_apply_worker_main");
+		strcpy(worker.bgw_name, "orioledb rewind apply worker");
+		strcpy(worker.bgw_type, "orioledb rewind apply worker");
+
+		if (!RegisterDynamicBackgroundWorker(&worker, &handles[n]))
+			break;
+		if (WaitForBackgroundWorkerStartup(handles[n], &pid) != BGWH_STARTED)
+			break;
+		n++;
+	}
+
+	if (n < rewind_parallel_workers)
+		elog(WARNING, "started %d of %d rewind apply workers",
+			 n, rewind_parallel_workers);
+
+	rewindMeta->applyWorkersNum = n;
+	*nworkers = n;
+	return handles;
+}
+
+/*
+ * Applies the undo of the current batch, which belongs to the trees of the
+ * given partition.  The transactions are processed in the rewind order, so
+ * the order of the undo items of each tree is the same as in the sequential
+ * rewind.
+ */
+static void
+rewind_apply_batch(int partition, int npartitions)
+{
+	uint32		j;
+	int			i;
+
+	for (j = 0; j < rewindMeta->applyBatchLength; j++)
+	{
+		RewindApplyItem *item = &rewindMeta->applyBatch[j];
+
+		for (i = 0; i < (int) UndoLogsCount; i++)
+			walk_undo_range_partition((UndoLogType) i, item->undoLocation[i],
+									  item->oxid, partition, npartitions);
+	}
+}
+
+static void
+rewind_apply_flush(BackgroundWorkerHandle **handles, int nworkers)
+{
+	uint32		j;
+
+	if (rewindMeta->applyBatchLength == 0)
+		return;
+
+	pg_atomic_write_u32(&rewindMeta->applyWorkersDone, 0);
+	pg_write_barrier();
+	pg_atomic_fetch_add_u32(&rewindMeta->applyBatchNum, 1);
+
+	rewind_apply_batch(0, nworkers + 1);
+
+	while (pg_atomic_read_u32(&rewindMeta->applyWorkersDone) < nworkers)
+	{
+		int			i;
+
+		for (i = 0; i < nworkers; i++)
+		{
+			pid_t		pid;
+
+			if (GetBackgroundWorkerPid(handles[i], &pid) == BGWH_STOPPED)
+				ereport(FATAL,
+						(errcode(ERRCODE_INTERNAL_ERROR),
+						 errmsg("orioledb rewind apply worker %d exited during rewind", i)));
+		}
+		pg_usleep(1000L);
+	}
+	pg_read_barrier();
+
+	for (j = 0; j < rewindMeta->applyBatchLength; j++)
+		set_oxid_csn(rewindMeta->applyBatch[j].oxid, COMMITSEQNO_ABORTED);
+	rewindMeta->applyBatchLength = 0;
+}
+
+static void
+finish_rewind_apply_workers(BackgroundWorkerHandle **handles, int nworkers)
+{
+	int			i;
+
+	rewind_apply_flush(handles, nworkers);
+	rewindMeta->applyFinished = true;
+	for (i = 0; i < nworkers; i++)
+		(void) WaitForBackgroundWorkerShutdown(handles[i]);
+}
+
+/*
+ * Checks if the undo of the rewound transaction could be applied in parallel
+ * with the others: it touches nothing but the individual trees.
+ */
+static bool
+rewind_item_is_tree_local(RewindItem *rewindItem)
+{
+	int			i;
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		if (!undo_range_is_tree_local((UndoLogType) i,
+									  rewindItem->undoLocation[i]))
+			return false;
+	}
+	return true;
+}
+
 /* Perform actual rewind within one backend left */
 static void
 do_rewind(int rewind_mode, int rewind_time, TimestampTz rewindStartTimeStamp, OXid rewind_oxid, TransactionId rewind_xid, TimestampTz rewind_timestamp)
@@ -351,11 +723,18 @@ do_rewind(int rewind_mode, int rewind_time, TimestampTz rewindStartTimeStamp, OX
 	long		secs;
 	int			usecs;
 	int			source_buffer;
+	BackgroundWorkerHandle **applyWorkers = NULL;
+	int			nApplyWorkers = 0;
+	uint64		nrewound = 0;
+	TimestampTz lastProgressReport = rewindStartTimeStamp;
 
 #ifdef REWIND_DEBUG_MODE
 	log_print_rewind_queue();
 #endif
 
+	if (rewind_parallel_workers > 0)
+		applyWorkers = start_rewind_apply_workers(&nApplyWorkers);
+
 	/*
 	 * Bump rewindMeta->addPosFilledUpto compacting all filled entries between
 	 * addPosFilledUpto and addPosReserved and dropping non-filled ones
@@ -393,10 +772,15 @@ do_rewind(int rewind_mode, int rewind_time, TimestampTz rewindStartTimeStamp, OX
 		{
 			if (k == 0)
 			{
-				o_buffers_read(&rewindBuffersDesc,
-							   (Pointer) &tmpbuf, REWIND_BUFFERS_TAG,
-							   (pos - REWIND_DISK_BUFFER_LENGTH + 1) * sizeof(RewindItem),
-							   REWIND_DISK_BUFFER_LENGTH * sizeof(RewindItem));
+				uint64		startPos PG_USED_FOR_ASSERTS_ONLY;
+				uint64		pageNum;
+
+				pageNum = rewind_disk_page_for_pos(pos,
+												   pg_atomic_read_u64(&rewindMeta->evictPos),
+												   rewindMeta->evictPageNum,
+												   &startPos);
+				Assert(startPos == pos - REWIND_DISK_BUFFER_LENGTH + 1);
+				(void) read_rewind_disk_page(pageNum, tmpbuf);
 				k = REWIND_DISK_BUFFER_LENGTH;
 			}
 			k--;
@@ -500,8 +884,28 @@ do_rewind(int rewind_mode, int rewind_time, TimestampTz rewindStartTimeStamp, OX
 			/* Rewind current rewind item */
 
 			/* Undo orioledb transaction */
-			if (OXidIsValid(rewindItem->oxid))
+			if (OXidIsValid(rewindItem->oxid) && nApplyWorkers > 0 &&
+				rewind_item_is_tree_local(rewindItem))
+			{
+				RewindApplyItem *applyItem;
+
+#ifdef USE_ASSERT_CHECKING
+				csn = oxid_get_csn(rewindItem->oxid, true);
+				Assert(csn_is_retained_for_rewind(csn));
+#endif
+				if (rewindMeta->applyBatchLength == REWIND_APPLY_BATCH_SIZE)
+					rewind_apply_flush(applyWorkers, nApplyWorkers);
+
+				applyItem = &rewindMeta->applyBatch[rewindMeta->applyBatchLength++];
+				applyItem->oxid = rewindItem->oxid;
+				for (i = 0; i < (int) UndoLogsCount; i++)
+					applyItem->undoLocation[i] = rewindItem->undoLocation[i];
+			}
+			else if (OXidIsValid(rewindItem->oxid))
 			{
+				/* The undo of the batched transactions goes first */
+				rewind_apply_flush(applyWorkers, nApplyWorkers);
+
 				for (i = 0; i < (int) UndoLogsCount; i++)
 				{
 					UndoLocation location PG_USED_FOR_ASSERTS_ONLY;
@@ -550,6 +954,18 @@ do_rewind(int rewind_mode, int rewind_time, TimestampTz rewindStartTimeStamp, OX
 			}
 			else
 				Assert(!started_subxids && !got_all_subxids && nsubxids == 0);
+
+			nrewound++;
+			if (TimestampDifferenceExceeds(lastProgressReport,
+										   GetCurrentTimestamp(),
+										   REWIND_PROGRESS_INTERVAL))
+			{
+				lastProgressReport = GetCurrentTimestamp();
+				ereport(LOG,
+						errmsg("orioledb rewind in progress: " UINT64_FORMAT " transactions rewound, now at XID %u, OXid %lu committed at %s",
+							   nrewound, rewindItem->xid, rewindItem->oxid,
+							   pstrdup(timestamptz_to_str(rewindItem->timestamp))));
+			}
 		}
 
 		/* Clear the item from the circular buffer */
@@ -560,6 +976,7 @@ do_rewind(int rewind_mode, int rewind_time, TimestampTz rewindStartTimeStamp, OX
 		 */
 		if (pos == rewindMeta->completePos)
 		{
+			finish_rewind_apply_workers(applyWorkers, nApplyWorkers);
 			TimestampDifference(rewindItem->timestamp, rewindStartTimeStamp, &secs, &usecs);
 			ereport(LOG, errmsg("orioledb rewind completed on full rewind capacity. Last rewound transaction XID %u, OXid %lu is %ld.%d seconds back at %s", rewindItem->xid, rewindItem->oxid, secs, usecs / 1000, pstrdup(timestamptz_to_str(rewindItem->timestamp))));
 			return;
@@ -569,6 +986,7 @@ do_rewind(int rewind_mode, int rewind_time, TimestampTz rewindStartTimeStamp, OX
 
 rewind_complete:
 
+	finish_rewind_apply_workers(applyWorkers, nApplyWorkers);
 	TimestampDifference(rewindItem->timestamp, rewindStartTimeStamp, &secs, &usecs);
 	ereport(LOG, errmsg("orioledb rewind completed. Last remaining item XID %u, OXid %lu is %ld.%d seconds back at %s", rewindItem->xid, rewindItem->oxid, secs, usecs / 1000, pstrdup(timestamptz_to_str(rewindItem->timestamp))));
 	return;
@@ -920,17 +1338,30 @@ rewind_init_shmem(Pointer ptr, bool found)
 		rewindMeta->restorePos = 0;
 		rewindMeta->checkpointPos = 0;
 		rewindMeta->oldCleanedFileNum = 0;
+		rewindMeta->oldCleanedIndexFileNum = 0;
+		rewindMeta->evictPageNum = 0;
+		rewindMeta->restorePageNum = 0;
+		rewindMeta->evictDataPos = 0;
+		rewindMeta->restoreDataPos = 0;
 		pg_atomic_write_u64(&rewindMeta->oldestConsideredRunningXid,
 							InvalidTransactionId);
 		pg_atomic_write_u64(&rewindMeta->runXmin, InvalidOXid);
+		SpinLockInit(&rewindMeta->csnSamplesLock);
+		rewindMeta->csnSamplesCount = 0;
 
 		/* Rewind buffers are not persistent */
 		cleanup_rewind_files(&rewindBuffersDesc, REWIND_BUFFERS_TAG);
+		cleanup_rewind_files(&rewindBuffersDesc, REWIND_INDEX_TAG);
 		rewindMeta->force_complete_xid = InvalidTransactionId;
 		rewindMeta->force_complete_oxid = InvalidOXid;
 		rewindMeta->complete_xid = InvalidTransactionId;
 		rewindMeta->complete_oxid = InvalidOXid;
 		rewindMeta->complete_timestamp = 0;
+		rewindMeta->applyWorkersNum = 0;
+		rewindMeta->applyFinished = false;
+		rewindMeta->applyBatchLength = 0;
+		pg_atomic_init_u32(&rewindMeta->applyBatchNum, 0);
+		pg_atomic_init_u32(&rewindMeta->applyWorkersDone, 0);
 	}
 	LWLockRegisterTranche(rewindMeta->rewindEvictTrancheId, "RewindEvictTranche");
 	LWLockRegisterTranche(rewindMeta->rewindCheckpointTrancheId, "RewindCheckpointTranche");
@@ -970,6 +1401,66 @@ is_rewind_worker(void)
 	return rewindWorker;
 }
 
+/*
+ * Applies the undo of the rewound transactions for the trees of its partition
+ * batch by batch, till the rewinding backend finishes.
+ */
+void
+rewind_apply_worker_main(Datum main_arg)
+{
+	int			num = DatumGetInt32(main_arg);
+	uint32		seenBatchNum = 0;
+
+	/* enable timeout for relation lock */
+	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
+
+	/* enable relation cache invalidation (remove old OTableDescr) */
+	RelationCacheInitialize();
+	InitCatalogCache();
+	SharedInvalBackendInit(false);
+
+	InitializeSessionUserIdStandalone();
+	pgstat_beinit();
+	pgstat_bestart();
+
+	SetProcessingMode(NormalProcessing);
+
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	elog(LOG, "orioledb rewind apply worker %d started", num);
+
+	CurTransactionContext = AllocSetContextCreate(TopMemoryContext,
+												  "orioledb rewind apply worker current transaction context",
+												  ALLOCSET_DEFAULT_SIZES);
+	TopTransactionContext = AllocSetContextCreate(TopMemoryContext,
+												  "orioledb rewind apply worker top transaction context",
+												  ALLOCSET_DEFAULT_SIZES);
+	MemoryContextSwitchTo(CurTransactionContext);
+
+	while (!rewindMeta->applyFinished)
+	{
+		uint32		batchNum;
+
+		CHECK_FOR_INTERRUPTS();
+
+		batchNum = pg_atomic_read_u32(&rewindMeta->applyBatchNum);
+		if (batchNum == seenBatchNum)
+		{
+			pg_usleep(1000L);
+			continue;
+		}
+		pg_read_barrier();
+
+		rewind_apply_batch(num + 1, rewindMeta->applyWorkersNum + 1);
+		MemoryContextReset(CurTransactionContext);
+		seenBatchNum = batchNum;
+
+		pg_write_barrier();
+		pg_atomic_fetch_add_u32(&rewindMeta->applyWorkersDone, 1);
+	}
+}
+
 /*
  * Restore page from disk to an empty space in completeBuffer.
  * Takes an exclusive lock to avoid cocurrent page eviction.
@@ -980,7 +1471,6 @@ try_restore_evicted_rewind_page(void)
 	int			start;
 	int			length_to_end;
 	uint64		currentCleanFileNum;
-	int			itemsPerFile;
 
 	LWLockAcquire(&rewindMeta->rewindEvictLock, LW_EXCLUSIVE);
 
@@ -1000,22 +1490,21 @@ try_restore_evicted_rewind_page(void)
 
 		if (length_to_end < REWIND_DISK_BUFFER_LENGTH)
 		{
-			o_buffers_read(&rewindBuffersDesc,
-						   (Pointer) &rewindCompleteBuffer[start], REWIND_BUFFERS_TAG,
-						   rewindMeta->restorePos * sizeof(RewindItem),
-						   length_to_end * sizeof(RewindItem));
-			o_buffers_read(&rewindBuffersDesc,
-						   (Pointer) &rewindCompleteBuffer[0], REWIND_BUFFERS_TAG,
-						   (rewindMeta->restorePos + length_to_end) * sizeof(RewindItem),
-						   (REWIND_DISK_BUFFER_LENGTH - length_to_end) * sizeof(RewindItem));
+			RewindItem	buffer[REWIND_DISK_BUFFER_LENGTH];
+
+			rewindMeta->restoreDataPos = read_rewind_disk_page(rewindMeta->restorePageNum,
+															   buffer);
+			memcpy(&rewindCompleteBuffer[start], buffer,
+				   length_to_end * sizeof(RewindItem));
+			memcpy(&rewindCompleteBuffer[0], &buffer[length_to_end],
+				   (REWIND_DISK_BUFFER_LENGTH - length_to_end) * sizeof(RewindItem));
 		}
 		else
 		{
-			o_buffers_read(&rewindBuffersDesc,
-						   (Pointer) &rewindCompleteBuffer[start], REWIND_BUFFERS_TAG,
-						   rewindMeta->restorePos * sizeof(RewindItem),
-						   REWIND_DISK_BUFFER_LENGTH * sizeof(RewindItem));
+			rewindMeta->restoreDataPos = read_rewind_disk_page(rewindMeta->restorePageNum,
+															   &rewindCompleteBuffer[start]);
 		}
+		rewindMeta->restorePageNum++;
 
 #ifdef USE_ASSERT_CHECKING
 		for (uint64 pos = start; pos < start + REWIND_DISK_BUFFER_LENGTH; pos++)
@@ -1057,18 +1546,29 @@ try_restore_evicted_rewind_page(void)
 	}
 	LWLockRelease(&rewindMeta->rewindEvictLock);
 
-	/* Clean old buffer files if needed. No lock. */
-	itemsPerFile = REWIND_FILE_SIZE / sizeof(RewindItem);
-	currentCleanFileNum = rewindMeta->restorePos / itemsPerFile;
-
+	/*
+	 * Clean old buffer and index files if needed: the ones before the file
+	 * holding the next page to restore. No lock.
+	 */
+	currentCleanFileNum = rewindMeta->restoreDataPos / REWIND_FILE_SIZE;
 	if (currentCleanFileNum > rewindMeta->oldCleanedFileNum)
 	{
 		o_buffers_unlink_files_range(&rewindBuffersDesc,
 									 REWIND_BUFFERS_TAG,
 									 rewindMeta->oldCleanedFileNum,
-									 currentCleanFileNum);
+									 currentCleanFileNum - 1);
 		rewindMeta->oldCleanedFileNum = currentCleanFileNum;
 	}
+
+	currentCleanFileNum = (rewindMeta->restorePageNum * sizeof(RewindDiskPageRef)) / REWIND_FILE_SIZE;
+	if (currentCleanFileNum > rewindMeta->oldCleanedIndexFileNum)
+	{
+		o_buffers_unlink_files_range(&rewindBuffersDesc,
+									 REWIND_INDEX_TAG,
+									 rewindMeta->oldCleanedIndexFileNum,
+									 currentCleanFileNum - 1);
+		rewindMeta->oldCleanedIndexFileNum = currentCleanFileNum;
+	}
 }
 
 void
@@ -1132,6 +1632,9 @@ rewind_worker_main(Datum main_arg)
 
 			elog(DEBUG3, "Rewind worker came to check");
 
+			rewind_sample_csn();
+			rewind_evict_ahead();
+
 			while (rewindMeta->completePos < pg_atomic_read_u64(&rewindMeta->addPosFilledUpto))
 			{
 				uint64		location PG_USED_FOR_ASSERTS_ONLY;
@@ -1259,15 +1762,124 @@ rewind_worker_main(Datum main_arg)
 	PG_END_TRY();
 }
 
+/*
+ * Takes the (timestamp, CSN) sample for historical queries.  The samples are
+ * spread to cover rewind_max_time by the ring, but taken not more often than
+ * the worker wakes up.
+ */
+static void
+rewind_sample_csn(void)
+{
+	RewindCsnSample sample;
+	int			interval = Max(RewindHorizonCheckDelay,
+							   rewind_max_time * 1000 / REWIND_CSN_SAMPLES);
+
+	if (rewindMeta->csnSamplesCount > 0)
+	{
+		RewindCsnSample *last;
+
+		last = &rewindMeta->csnSamples[(rewindMeta->csnSamplesCount - 1) % REWIND_CSN_SAMPLES];
+		if (!TimestampDifferenceExceeds(last->timestamp, GetCurrentTimestamp(),
+										interval))
+			return;
+	}
+
+	/*
+	 * Every oxid below xmin is finished before the CSN is read, so the pair
+	 * makes a valid snapshot the same way as orioledb_snapshot_hook() does.
+	 * The timestamp is taken the last: the snapshot is not newer than it.
+	 */
+	sample.xmin = pg_atomic_read_u64(&xid_meta->runXmin);
+	pg_read_barrier();
+	sample.csn = pg_atomic_read_u64(&TRANSAM_VARIABLES->nextCommitSeqNo);
+	sample.timestamp = GetCurrentTimestamp();
+
+	SpinLockAcquire(&rewindMeta->csnSamplesLock);
+	rewindMeta->csnSamples[rewindMeta->csnSamplesCount % REWIND_CSN_SAMPLES] = sample;
+	rewindMeta->csnSamplesCount++;
+	SpinLockRelease(&rewindMeta->csnSamplesLock);
+}
+
+/*
+ * Evicts the added items while the add buffer is more than half full.
+ * Otherwise, add_to_rewind_buffer() has to evict them inline, and the
+ * committing backend waits for the encoding and the write of the items
+ * before the client gets the commit acknowledgement.
+ */
+static void
+rewind_evict_ahead(void)
+{
+	while (!rewindMeta->rewindWorkerStopRequested)
+	{
+		uint64		evictPos = pg_atomic_read_u64(&rewindMeta->evictPos);
+		uint64		used = pg_atomic_read_u64(&rewindMeta->addPosReserved) - evictPos;
+
+		if (used <= rewind_circular_buffer_size / 2)
+			break;
+
+		evict_rewind_items(pg_atomic_read_u64(&rewindMeta->addPosFilledUpto));
+
+		/* No progress: nothing is ready, or a backend evicts concurrently */
+		if (pg_atomic_read_u64(&rewindMeta->evictPos) == evictPos)
+			break;
+	}
+}
+
+/*
+ * Finds the snapshot for the historical query as of the given timestamp.
+ * Returns false if no sample is that old, or the rewind already released the
+ * undo needed to read the data as of the sample.
+ */
+bool
+rewind_get_csn_as_of(TimestampTz timestamp, CommitSeqNo *csn, OXid *xmin)
+{
+	RewindCsnSample sample;
+	uint64		start,
+				low,
+				high;
+	OXid		runXmin;
+
+	SpinLockAcquire(&rewindMeta->csnSamplesLock);
+	high = rewindMeta->csnSamplesCount;
+	start = high > REWIND_CSN_SAMPLES ? high - REWIND_CSN_SAMPLES : 0;
+	low = start;
+
+	/* Binary search for the newest sample not newer than the timestamp */
+	while (low < high)
+	{
+		uint64		mid = low + (high - low) / 2;
+
+		if (rewindMeta->csnSamples[mid % REWIND_CSN_SAMPLES].timestamp <= timestamp)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low == start)
+	{
+		SpinLockRelease(&rewindMeta->csnSamplesLock);
+		return false;
+	}
+	sample = rewindMeta->csnSamples[(low - 1) % REWIND_CSN_SAMPLES];
+	SpinLockRelease(&rewindMeta->csnSamplesLock);
+
+	/* The transactions committed after the sample must be still retained */
+	runXmin = get_rewind_run_xmin();
+	if (sample.timestamp < rewindMeta->complete_timestamp ||
+		(OXidIsValid(runXmin) && sample.xmin < runXmin))
+		return false;
+
+	*csn = sample.csn;
+	*xmin = sample.xmin;
+	return true;
+}
+
 /*
  * Evict page from a ring buffer to disk. Takes exclusive lock against concurrent eviction.
  */
 static void
 evict_rewind_items(uint64 curAddPosFilled)
 {
-	int			start;
-	int			length_to_end;
-
 	LWLockAcquire(&rewindMeta->rewindCheckpointLock, LW_SHARED);
 	if (LWLockAcquireOrWait(&rewindMeta->rewindEvictLock, LW_EXCLUSIVE))
 	{
@@ -1302,9 +1914,15 @@ evict_rewind_items(uint64 curAddPosFilled)
 		}
 		else if (pg_atomic_read_u64(&rewindMeta->evictPos) + REWIND_DISK_BUFFER_LENGTH < curAddPosFilled)
 		{
-			/* Evict to disk buffers */
-			start = (pg_atomic_read_u64(&rewindMeta->evictPos) % rewind_circular_buffer_size);
-			length_to_end = rewind_circular_buffer_size - start;
+			static char evictBuf[REWIND_EVICT_BATCH_PAGES * REWIND_DISK_BUFFER_LENGTH * sizeof(RewindItem)];
+			RewindDiskPageRef refs[REWIND_EVICT_BATCH_PAGES];
+			uint64		evictPos = pg_atomic_read_u64(&rewindMeta->evictPos);
+			uint32		length = 0;
+			int			npages;
+
+			/* Evict to disk buffers by the batches of encoded pages */
+			npages = Min(REWIND_EVICT_BATCH_PAGES,
+						 (curAddPosFilled - evictPos - 1) / REWIND_DISK_BUFFER_LENGTH);
 
 			elog(DEBUG3, "DISK_evict: AF=%lu AR=%lu E=%lu C=%lu R=%lu freeAdd=%lu",
 				 curAddPosFilled,
@@ -1314,31 +1932,30 @@ evict_rewind_items(uint64 curAddPosFilled)
 				 rewindMeta->restorePos,
 				 rewind_circular_buffer_size - (pg_atomic_read_u64(&rewindMeta->addPosReserved) - pg_atomic_read_u64(&rewindMeta->evictPos)));
 
-			if (length_to_end < REWIND_DISK_BUFFER_LENGTH)
+			for (int i = 0; i < npages; i++)
 			{
-				o_buffers_write(&rewindBuffersDesc,
-								(Pointer) &rewindAddBuffer[start],
-								REWIND_BUFFERS_TAG,
-								pg_atomic_read_u64(&rewindMeta->evictPos) * sizeof(RewindItem),
-								length_to_end * sizeof(RewindItem));
-
-				o_buffers_write(&rewindBuffersDesc,
-								(Pointer) &rewindAddBuffer[0],
-								REWIND_BUFFERS_TAG,
-								(pg_atomic_read_u64(&rewindMeta->evictPos) + length_to_end) * sizeof(RewindItem),
-								(REWIND_DISK_BUFFER_LENGTH - length_to_end) * sizeof(RewindItem));
-			}
-			else
-			{
-				o_buffers_write(&rewindBuffersDesc,
-								(Pointer) &rewindAddBuffer[start],
-								REWIND_BUFFERS_TAG,
-								pg_atomic_read_u64(&rewindMeta->evictPos) * sizeof(RewindItem),
-								REWIND_DISK_BUFFER_LENGTH * sizeof(RewindItem));
+				refs[i].offset = rewindMeta->evictDataPos + length;
+				refs[i].length = encode_rewind_page(evictPos + i * REWIND_DISK_BUFFER_LENGTH,
+													evictBuf + length,
+													&refs[i].flags);
+				length += refs[i].length;
 			}
 
+			o_buffers_write(&rewindBuffersDesc,
+							(Pointer) evictBuf,
+							REWIND_BUFFERS_TAG,
+							rewindMeta->evictDataPos,
+							length);
+			o_buffers_write(&rewindBuffersDesc,
+							(Pointer) refs,
+							REWIND_INDEX_TAG,
+							rewindMeta->evictPageNum * sizeof(RewindDiskPageRef),
+							npages * sizeof(RewindDiskPageRef));
+			rewindMeta->evictDataPos += length;
+			rewindMeta->evictPageNum += npages;
+
 			/* Clean written items from ring buffer */
-			for (int i = 0; i < REWIND_DISK_BUFFER_LENGTH; i++)
+			for (int i = 0; i < npages * REWIND_DISK_BUFFER_LENGTH; i++)
 			{
 				rewindAddBuffer[(pg_atomic_read_u64(&rewindMeta->evictPos) % rewind_circular_buffer_size)].tag = EMPTY_ITEM_TAG;
 
@@ -1619,7 +2236,10 @@ next_subxids_item:
 void
 checkpoint_write_rewind_xids(void)
 {
-	bool		buffer_loaded = false;
+	uint64		bufferStart = 0;
+	uint64		bufferEnd = 0;
+	uint64		evictPos;
+	uint64		evictPageNum;
 	RewindItem	buffer[REWIND_DISK_BUFFER_LENGTH];
 
 	if (!enable_rewind)
@@ -1646,18 +2266,26 @@ checkpoint_write_rewind_xids(void)
 	for (; rewindMeta->checkpointPos < rewindMeta->restorePos; rewindMeta->checkpointPos++)
 		checkpoint_write_rewind_item(&rewindCompleteBuffer[rewindMeta->checkpointPos % rewind_circular_buffer_size]);
 
-	/* Write rewind records from on-disk buffer if they exist */
-	while (rewindMeta->checkpointPos < pg_atomic_read_u64(&rewindMeta->evictPos))
+	/*
+	 * Write rewind records from on-disk buffer if they exist.  The eviction
+	 * is blocked by the lock, so evictPos and evictPageNum are consistent.
+	 */
+	LWLockAcquire(&rewindMeta->rewindEvictLock, LW_SHARED);
+	evictPos = pg_atomic_read_u64(&rewindMeta->evictPos);
+	evictPageNum = rewindMeta->evictPageNum;
+	LWLockRelease(&rewindMeta->rewindEvictLock);
+
+	while (rewindMeta->checkpointPos < evictPos)
 	{
-		if (!buffer_loaded)
+		if (rewindMeta->checkpointPos >= bufferEnd)
 		{
-			int			startbuf = rewindMeta->checkpointPos - (rewindMeta->checkpointPos % REWIND_DISK_BUFFER_LENGTH);
+			uint64		pageNum;
 
-			o_buffers_read(&rewindBuffersDesc,
-						   (Pointer) &buffer, REWIND_BUFFERS_TAG,
-						   startbuf * sizeof(RewindItem),
-						   REWIND_DISK_BUFFER_LENGTH * sizeof(RewindItem));
-			buffer_loaded = true;
+			pageNum = rewind_disk_page_for_pos(rewindMeta->checkpointPos,
+											   evictPos, evictPageNum,
+											   &bufferStart);
+			(void) read_rewind_disk_page(pageNum, buffer);
+			bufferEnd = bufferStart + REWIND_DISK_BUFFER_LENGTH;
 		}
 
 		elog(DEBUG3, "CHECKPOINT FROM DISK: AF=%lu AR=%lu E=%lu C=%lu R=%lu freeAdd=%lu",
@@ -1668,10 +2296,8 @@ checkpoint_write_rewind_xids(void)
 			 rewindMeta->restorePos,
 			 rewind_circular_buffer_size - (pg_atomic_read_u64(&rewindMeta->addPosReserved) - pg_atomic_read_u64(&rewindMeta->evictPos)));
 
-		checkpoint_write_rewind_item(&buffer[rewindMeta->checkpointPos % REWIND_DISK_BUFFER_LENGTH]);
+		checkpoint_write_rewind_item(&buffer[rewindMeta->checkpointPos - bufferStart]);
 		rewindMeta->checkpointPos++;
-		if (rewindMeta->checkpointPos % REWIND_DISK_BUFFER_LENGTH == 0)
-			buffer_loaded = false;
 	}
 
 	/*
@@ -0,0 +1,173 @@
+/*-------------------------------------------------------------------------
+ *
+ * backfill.c
+ *		Background load of the S3 data file parts after the restore.
+ *
+ * The node restored from S3 starts with the PostgreSQL files, undo, WAL and
+ * the checkpoint map files only.  The parts of the data files are fetched on
+ * demand, when the pages are read.  With orioledb.s3_backfill, the backfill
+ * worker walks the internal pages of all the trees after the recovery and
+ * schedules the loads of all the on-disk children to the prefetch lane of
+ * the S3 task queue.  The queries' own reads go first, and the prefetch lane
+ * fills up with the scheduled loads, which throttles the walk.
+ *
+ * Only the internal pages are loaded into the page pool.  The leaves stay on
+ * the local disk once their parts are loaded.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/s3/backfill.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/page_contents.h"
+#include "btree/walk.h"
+#include "catalog/o_indices.h"
+#include "catalog/o_tables.h"
+#include "s3/backfill.h"
+#include "s3/worker.h"
+#include "tableam/descr.h"
+#include "utils/page_pool.h"
+#include "workers/paced_worker.h"
+
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "storage/proc.h"
+#include "tcop/tcopprot.h"
+#include "utils/memutils.h"
+
+typedef struct
+{
+	ORelOids	oids;
+	OIndexType	type;
+} S3BackfillTree;
+
+typedef struct
+{
+	S3BackfillTree *trees;
+	int			count;
+	int			allocated;
+} S3BackfillTreesArg;
+
+static void
+s3_backfill_trees_callback(OIndexType type, ORelOids treeOids,
+						   ORelOids tableOids, void *arg)
+{
+	S3BackfillTreesArg *treesArg = (S3BackfillTreesArg *) arg;
+
+	if (treesArg->count >= treesArg->allocated)
+	{
+		treesArg->allocated *= 2;
+		treesArg->trees = (S3BackfillTree *) repalloc(treesArg->trees,
+													  sizeof(S3BackfillTree) * treesArg->allocated);
+	}
+	treesArg->trees[treesArg->count].oids = treeOids;
+	treesArg->trees[treesArg->count].type = type;
+	treesArg->count++;
+}
+
+/*
+ * Schedules the loads of the on-disk children of the internal page, then
+ * descends to the internal children.
+ */
+static OBTreeWalkAction
+s3_backfill_walk_downlink(BTreeDescr *desc, uint16 level, uint64 downlink,
+						  void *arg)
+{
+	int64	   *scheduled = (int64 *) arg;
+
+	if (DOWNLINK_IS_ON_DISK(downlink))
+	{
+		(void) s3_schedule_downlink_load(desc, downlink);
+		(*scheduled)++;
+		return OBTreeWalkSkip;
+	}
+
+	return level > 1 ? OBTreeWalkDescend : OBTreeWalkSkip;
+}
+
+static int64
+s3_backfill_tree(S3BackfillTree *tree)
+{
+	ORelOids	oids = tree->oids;
+	OIndexDescr *indexDescr;
+	int64		scheduled = 0;
+
+	if (!o_tables_rel_try_lock(&oids, AccessShareLock, NULL))
+		return 0;
+
+	indexDescr = o_fetch_index_descr(oids, tree->type, false, NULL);
+	if (indexDescr)
+	{
+		OBTreeWalker walker = {
+			.downlink = s3_backfill_walk_downlink,
+			.arg = &scheduled
+		};
+
+		o_btree_walk_internal_pages(&indexDescr->desc, &walker);
+	}
+
+	o_tables_rel_unlock(&oids, AccessShareLock);
+
+	return scheduled;
+}
+
+void
+register_s3_backfill_worker(void)
+{
+	BackgroundWorker worker;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	strcpy(worker.bgw_library_name, "orioledb");
+	strcpy(worker.bgw_function_name, "s3_backfill_worker_main");
+	strcpy(worker.bgw_name, "orioledb s3 backfill worker");
+	strcpy(worker.bgw_type, "orioledb s3 backfill worker");
+	RegisterBackgroundWorker(&worker);
+}
+
+void
+s3_backfill_worker_main(Datum main_arg)
+{
+	S3BackfillTreesArg treesArg;
+	int64		scheduled = 0;
+	int			i;
+
+	/* the walk is checking for interrupts */
+	o_worker_setup(die);
+
+	elog(LOG, "orioledb s3 backfill worker started");
+
+	PG_TRY();
+	{
+		MemoryContextSwitchTo(TopTransactionContext);
+		treesArg.count = 0;
+		treesArg.allocated = 64;
+		treesArg.trees = (S3BackfillTree *) palloc(sizeof(S3BackfillTree) * treesArg.allocated);
+		o_indices_foreach_oids(s3_backfill_trees_callback, &treesArg);
+
+		MemoryContextSwitchTo(CurTransactionContext);
+		for (i = 0; i < treesArg.count; i++)
+		{
+			scheduled += s3_backfill_tree(&treesArg.trees[i]);
+			ppool_release_all_pages();
+			MemoryContextReset(CurTransactionContext);
+		}
+
+		elog(LOG, "orioledb s3 backfill worker scheduled " INT64_FORMAT " pages of %d trees",
+			 scheduled, treesArg.count);
+	}
+	PG_CATCH();
+	{
+		LockReleaseSession(DEFAULT_LOCKMETHOD);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
@@ -196,9 +196,22 @@ typedef struct
 	int64		size;			/* total size as sent; -1 if not known */
 } tablespaceinfo;
 
+/*
+ * PostgreSQL file to be put by the S3 workers.
+ */
+typedef struct
+{
+	char	   *path;
+	off_t		size;
+} S3BackupFile;
+
 typedef struct
 {
 	List	   *tablespaces;
+	S3BackupFile *files;
+	int			filesNum;
+	int			filesAllocated;
+	uint64		filesSize;
 	List	   *smallFileNames;
 	List	   *smallFileSizes;
 	int			smallFilesTotalSize;
@@ -218,6 +231,9 @@ static S3TaskLocation flush_small_files(S3BackupState *state);
 static S3TaskLocation accumulate_small_file(S3BackupState *state,
 											const char *path,
 											int size);
+static void s3_backup_add_file(S3BackupState *state, const char *path,
+							   off_t size);
+static S3TaskLocation s3_backup_schedule_files(S3BackupState *state);
 static int64 s3_backup_scan_dir(S3BackupState *state,
 								const char *path, int basepathlen,
 								const char *spcoid);
@@ -262,6 +278,10 @@ s3_perform_backup(int flags, S3TaskLocation maxLocation)
 
 	state.tablespaces = lappend(state.tablespaces, newti);
 	state.chkpNum = chkpNum;
+	state.filesNum = 0;
+	state.filesAllocated = 64;
+	state.files = (S3BackupFile *) palloc(sizeof(S3BackupFile) * state.filesAllocated);
+	state.filesSize = 0;
 	state.smallFileNames = NIL;
 	state.smallFileSizes = NIL;
 	state.smallFilesTotalSize = sizeof(int);
@@ -301,6 +321,9 @@ s3_perform_backup(int flags, S3TaskLocation maxLocation)
 	location = flush_small_files(&state);
 	maxLocation = Max(maxLocation, location);
 
+	location = s3_backup_schedule_files(&state);
+	maxLocation = Max(maxLocation, location);
+
 	freeS3ChecksumState(state.checksumState);
 	list_free_deep(state.tablespaces);
 	pfree(tablespaceMapData.data);
@@ -317,6 +340,73 @@ s3_perform_backup(int flags, S3TaskLocation maxLocation)
 	maxLocation = Max(maxLocation, location);
 
 	s3_queue_wait_for_location(maxLocation);
+	s3_workers_backup_finish();
+}
+
+/*
+ * Remembers the PostgreSQL file to be put after the scan of all the
+ * directories.
+ */
+static void
+s3_backup_add_file(S3BackupState *state, const char *path, off_t size)
+{
+	if (state->filesNum >= state->filesAllocated)
+	{
+		state->filesAllocated *= 2;
+		state->files = (S3BackupFile *) repalloc(state->files,
+												 sizeof(S3BackupFile) * state->filesAllocated);
+	}
+	state->files[state->filesNum].path = pstrdup(path);
+	state->files[state->filesNum].size = size;
+	state->filesNum++;
+	state->filesSize += size;
+}
+
+static int
+s3_backup_file_cmp(const void *a, const void *b)
+{
+	const S3BackupFile *file1 = (const S3BackupFile *) a;
+	const S3BackupFile *file2 = (const S3BackupFile *) b;
+
+	if (file1->size != file2->size)
+		return file1->size > file2->size ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Schedules the put of all the PostgreSQL files found by the scan, the
+ * biggest ones first.  So the workers don't end up waiting for the single
+ * big file scheduled last.  The number of the files put concurrently is
+ * limited by orioledb.s3_num_workers, the memory of every worker is limited
+ * by orioledb.s3_file_chunk_size.
+ */
+static S3TaskLocation
+s3_backup_schedule_files(S3BackupState *state)
+{
+	S3TaskLocation location,
+				result = 0;
+	int			i;
+
+	qsort(state->files, state->filesNum, sizeof(S3BackupFile),
+		  s3_backup_file_cmp);
+
+	s3_workers_backup_start(state->chkpNum, state->filesNum,
+							state->filesSize);
+
+	for (i = 0; i < state->filesNum; i++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		location = s3_schedule_pg_file_write(state->chkpNum,
+											 state->files[i].path);
+		result = Max(result, location);
+		pfree(state->files[i].path);
+	}
+	pfree(state->files);
+	state->files = NULL;
+	state->filesNum = 0;
+
+	return result;
 }
 
 static int64
@@ -610,10 +700,12 @@ s3_backup_scan_dir(S3BackupState *state, const char *path,
 			S3TaskLocation location;
 
 			if (statbuf.st_size < SMALL_FILE_THRESHOLD)
+			{
 				location = accumulate_small_file(state, pathbuf, statbuf.st_size);
+				maxLocation = Max(maxLocation, location);
+			}
 			else
-				location = s3_schedule_pg_file_write(state->chkpNum, pathbuf);
-			maxLocation = Max(maxLocation, location);
+				s3_backup_add_file(state, pathbuf, statbuf.st_size);
 		}
 		else
 			ereport(WARNING,
@@ -13,6 +13,8 @@
  */
 #include "postgres.h"
 
+#include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <unistd.h>
 
 #include "orioledb.h"
@@ -21,23 +23,47 @@
 #include "btree/io.h"
 #include "checkpoint/checkpoint.h"
 #include "s3/headers.h"
+#include "s3/part_cache.h"
 #include "s3/worker.h"
+#include "utils/tree_stats.h"
 
 #include "common/file_perm.h"
 #include "common/file_utils.h"
 #include "common/hashfn.h"
 #include "common/pg_prng.h"
 #include "pgstat.h"
+#include "utils/timestamp.h"
 
 #define S3_HEADER_BUFFERS_PER_GROUP 4
 #define S3_HEADER_BUFFERS_PER_GROUP_NUM_BITS 2
 #define S3_HEADER_NUM_VALUES (ORIOLEDB_SEGMENT_SIZE / ORIOLEDB_S3_PART_SIZE)
 
+/*
+ * The adaptive desired size is reconsidered once per this interval (in
+ * microseconds) by the steps of the 1/16 of its range.  It's shrunk while
+ * less than 10% of the file system is free.
+ */
+#define S3_DESIRED_SIZE_ADAPT_INTERVAL	(10 * USECS_PER_SEC)
+#define S3_DESIRED_SIZE_ADAPT_STEPS		16
+#define S3_DESIRED_SIZE_MIN_FREE_SPACE	0.1
+
 typedef struct
 {
 	int			groupCtlTrancheId;
 	int			bufferCtlTrancheId;
 	pg_atomic_uint64 numberOfLoadedParts;
+
+	/* Statistics */
+	pg_atomic_uint64 lookups;
+	pg_atomic_uint64 misses;
+
+	/* Reads, which had to wait for the part to be loaded */
+	pg_atomic_uint64 coldReads;
+
+	/* State of the adaptive desired size */
+	pg_atomic_uint64 desiredNumParts;
+	pg_atomic_uint64 lastAdaptTime;
+	uint64		lastAdaptColdReads;
 } S3HeadersMeta;
 
 typedef struct
@@ -126,6 +152,12 @@ s3_headers_shmem_init(Pointer buf, bool found)
 		meta->groupCtlTrancheId = LWLockNewTrancheId();
 		meta->bufferCtlTrancheId = LWLockNewTrancheId();
 		pg_atomic_init_u64(&meta->numberOfLoadedParts, 0);
+		pg_atomic_init_u64(&meta->lookups, 0);
+		pg_atomic_init_u64(&meta->misses, 0);
+		pg_atomic_init_u64(&meta->coldReads, 0);
+		pg_atomic_init_u64(&meta->desiredNumParts, 0);
+		pg_atomic_init_u64(&meta->lastAdaptTime, 0);
+		meta->lastAdaptColdReads = 0;
 
 		for (i = 0; i < groupsCount; i++)
 		{
@@ -402,10 +434,23 @@ load_header_buffer(S3HeaderTag tag)
 
 	LWLockAcquire(&group->buffers[victim].bufferCtlLock, LW_EXCLUSIVE);
 
+	pg_atomic_fetch_add_u64(&meta->misses, 1);
 	change_buffer(group, victim, tag);
 
 }
 
+/*
+ * Returns the number of lookups of the headers buffers and the number of
+ * them, which had to load the header from the file.
+ */
+void
+s3_headers_get_stats(uint64 *lookups, uint64 *misses)
+{
+	*misses = pg_atomic_read_u64(&meta->misses);
+	pg_read_barrier();
+	*lookups = pg_atomic_read_u64(&meta->lookups);
+}
+
 static void
 check_unlink_file(S3HeaderTag tag)
 {
@@ -414,6 +459,8 @@ check_unlink_file(S3HeaderTag tag)
 	int			victim = 0;
 	S3HeaderTag newTag;
 
+	pg_atomic_fetch_add_u64(&meta->lookups, 1);
+
 	while (true)
 	{
 		bool		found = false;
@@ -457,6 +504,8 @@ s3_header_read_value(S3HeaderTag tag, int index)
 	S3HeadersBuffersGroup *group = &groups[hash % groupsCount];
 	int			i;
 
+	pg_atomic_fetch_add_u64(&meta->lookups, 1);
+
 	while (true)
 	{
 		bool		tagMatched = false;
@@ -512,6 +561,8 @@ s3_header_get_load_id(S3HeaderTag tag)
 	S3HeadersBuffersGroup *group = &groups[hash % groupsCount];
 	int			i;
 
+	pg_atomic_fetch_add_u64(&meta->lookups, 1);
+
 	while (true)
 	{
 		for (i = 0; i < S3_HEADER_BUFFERS_PER_GROUP; i++)
@@ -550,6 +601,8 @@ s3_header_compare_and_swap_extended(S3HeaderTag tag, int index,
 	S3HeadersBuffersGroup *group = &groups[hash % groupsCount];
 	int			i;
 
+	pg_atomic_fetch_add_u64(&meta->lookups, 1);
+
 	while (true)
 	{
 		bool		tagMatched = false;
@@ -636,6 +689,9 @@ s3_header_compare_and_swap(S3HeaderTag tag, int index,
 static S3HeaderTag curLockedTag = {InvalidOid, InvalidOid, 0, 0};
 static int	curLockedIndex = 0;
 
+/* Number of the parts this backend has loaded from S3 on the reads */
+uint32		s3_header_my_cold_reads = 0;
+
 /*
  * Lock file part in S3 header.  This shouldn't let anybody to concurrently
  * evict the same file part.
@@ -659,6 +715,14 @@ s3_header_lock_part(S3HeaderTag tag, int index, uint32 *loadId)
 
 		if (status == S3PartStatusNotLoaded)
 		{
+			pg_atomic_fetch_add_u64(&meta->coldReads, 1);
+			s3_header_my_cold_reads++;
+			if (tree_stats_enabled())
+			{
+				ORelOids	oids = {tag.datoid, InvalidOid, tag.relnode};
+
+				tree_stats_add(oids, TreeStatS3Loads, 1);
+			}
 			s3_load_file_part(tag.checkpointNum, tag.datoid,
 							  tag.relnode, tag.segNum, index);
 			value = s3_header_read_value(tag, index);
@@ -1109,6 +1173,52 @@ initial_parts_conting(void)
 
 }
 
+/*
+ * The eviction cycle first builds the histogram of the usage counts of the
+ * evictable parts.  Then it evicts only the parts, whose usage count is not
+ * higher than the one needed to get below the desired number of the loaded
+ * parts, and ages the others.
+ */
+static uint64 evictionHistogram[S3_PART_USAGE_COUNT_MAX + 1];
+static uint32 evictionMaxUsageCount;
+static uint64 evictionTargetNumParts;
+
+static inline bool
+s3_part_is_evictable(uint32 value)
+{
+	return S3_PART_GET_STATUS(value) == S3PartStatusLoaded &&
+		S3_PART_GET_LOCKS_NUM(value) == 0 &&
+		(value & (S3_PART_DIRTY_FLAG | S3_PART_WRITING_FLAG)) == 0;
+}
+
+static void
+usage_histogram_callback(S3HeaderTag tag)
+{
+	char	   *filename;
+	struct stat st;
+	int			i;
+	int			numParts;
+
+	filename = btree_filename(tag.datoid, tag.relnode, tag.segNum,
+							  tag.checkpointNum);
+	if (stat(filename, &st) != 0)
+	{
+		pfree(filename);
+		return;
+	}
+	pfree(filename);
+
+	numParts = (st.st_size + ORIOLEDB_S3_PART_SIZE - 1) / ORIOLEDB_S3_PART_SIZE;
+	numParts = Min(numParts, S3_HEADER_NUM_VALUES);
+	for (i = 0; i < numParts; i++)
+	{
+		uint32		value = s3_header_read_value(tag, i);
+
+		if (s3_part_is_evictable(value))
+			evictionHistogram[S3_PART_GET_USAGE_COUNT(value)]++;
+	}
+}
+
 static void
 eviction_callback(S3HeaderTag tag)
 {
@@ -1159,9 +1269,9 @@ eviction_callback(S3HeaderTag tag)
 			uint32		newValue = value,
 						usageCount = S3_PART_GET_USAGE_COUNT(value);
 
-			if (S3_PART_GET_STATUS(value) == S3PartStatusLoaded &&
-				S3_PART_GET_LOCKS_NUM(value) == 0 && usageCount == 0 &&
-				(value & (S3_PART_DIRTY_FLAG | S3_PART_WRITING_FLAG)) == 0)
+			if (s3_part_is_evictable(value) &&
+				usageCount <= evictionMaxUsageCount &&
+				pg_atomic_read_u64(&meta->numberOfLoadedParts) > evictionTargetNumParts)
 			{
 				newValue = S3_PART_SET_STATUS(newValue, S3PartStatusEvicting);
 			}
@@ -1179,6 +1289,8 @@ eviction_callback(S3HeaderTag tag)
 					uint64		result;
 
 					elog(DEBUG1, "S3 evict %u %u %u %d %d", tag.datoid, tag.relnode, tag.checkpointNum, tag.segNum, i);
+					s3_part_cache_put(tag, i, fd, offset,
+									  Min(offset + ORIOLEDB_S3_PART_SIZE, fileSize) - offset);
 					pg_pwrite_zeros(fd, Min(offset + ORIOLEDB_S3_PART_SIZE, fileSize) - offset, offset);
 
 					result = pg_atomic_fetch_sub_u64(&meta->numberOfLoadedParts, 1);
@@ -1200,16 +1312,134 @@ eviction_callback(S3HeaderTag tag)
 	close(fd);
 }
 
+static inline uint64
+s3_size_to_num_parts(int size)
+{
+	return (uint64) size * (uint64) (1024 * 1024) / (uint64) ORIOLEDB_S3_PART_SIZE;
+}
+
+/*
+ * Returns the fraction of the free space of the file system holding the
+ * data directory, or 1.0 if it's unknown.
+ */
+static double
+s3_free_space_fraction(void)
+{
+	struct statvfs st;
+
+	if (statvfs(ORIOLEDB_DATA_DIR, &st) != 0 || st.f_blocks == 0)
+		return 1.0;
+
+	return (double) st.f_bavail / (double) st.f_blocks;
+}
+
+/*
+ * Returns the desired number of the loaded parts.  With
+ * orioledb.s3_desired_size_max set, it grows from orioledb.s3_desired_size
+ * while the rate of the cold reads exceeds orioledb.s3_cold_read_rate, and
+ * shrinks back while the rate is below the half of it or the disk is short
+ * of space.
+ */
+static uint64
+s3_headers_desired_num_parts(void)
+{
+	uint64		minNumParts = s3_size_to_num_parts(s3_desired_size),
+				maxNumParts = s3_size_to_num_parts(s3_desired_size_max),
+				numParts,
+				step,
+				coldReads;
+	uint64		lastTime;
+	TimestampTz now;
+	double		rate;
+
+	if (maxNumParts <= minNumParts)
+		return minNumParts;
+
+	numParts = pg_atomic_read_u64(&meta->desiredNumParts);
+	numParts = Max(Min(numParts, maxNumParts), minNumParts);
+
+	now = GetCurrentTimestamp();
+	lastTime = pg_atomic_read_u64(&meta->lastAdaptTime);
+	if (lastTime == 0)
+	{
+		if (pg_atomic_compare_exchange_u64(&meta->lastAdaptTime, &lastTime, now))
+		{
+			meta->lastAdaptColdReads = pg_atomic_read_u64(&meta->coldReads);
+			pg_atomic_write_u64(&meta->desiredNumParts, numParts);
+		}
+		return numParts;
+	}
+
+	if (now - (TimestampTz) lastTime < S3_DESIRED_SIZE_ADAPT_INTERVAL ||
+		!pg_atomic_compare_exchange_u64(&meta->lastAdaptTime, &lastTime, now))
+		return numParts;
+
+	coldReads = pg_atomic_read_u64(&meta->coldReads);
+	rate = (double) (coldReads - meta->lastAdaptColdReads) * USECS_PER_SEC /
+		(double) (now - (TimestampTz) lastTime);
+	meta->lastAdaptColdReads = coldReads;
+
+	step = Max((maxNumParts - minNumParts) / S3_DESIRED_SIZE_ADAPT_STEPS, 1);
+	if (s3_free_space_fraction() < S3_DESIRED_SIZE_MIN_FREE_SPACE ||
+		rate < (double) s3_cold_read_rate / 2)
+		numParts = numParts > minNumParts + step ? numParts - step : minNumParts;
+	else if (rate > (double) s3_cold_read_rate)
+		numParts = Min(numParts + step, maxNumParts);
+
+	pg_atomic_write_u64(&meta->desiredNumParts, numParts);
+
+	return numParts;
+}
+
 void
 s3_headers_try_eviction_cycle(void)
 {
-	uint64		desiredNumParts = (uint64) s3_desired_size * (uint64) (1024 * 1024) / (uint64) ORIOLEDB_S3_PART_SIZE;
+	uint64		desiredNumParts = s3_headers_desired_num_parts();
+	uint64		numParts,
+				targetNumParts,
+				excess = 0;
+	uint32		usageCount;
 
 	Assert(orioledb_s3_mode);
 
-	if (pg_atomic_read_u64(&meta->numberOfLoadedParts) < desiredNumParts)
+	numParts = pg_atomic_read_u64(&meta->numberOfLoadedParts);
+	if (numParts < desiredNumParts)
 		return;
 
+	/* Evict 10% below the desired size, so the cycle doesn't run every time */
+	targetNumParts = desiredNumParts - desiredNumParts / 10;
+
+	memset(evictionHistogram, 0, sizeof(evictionHistogram));
+	iterate_files(usage_histogram_callback);
+
+	/* Find the least usage count, which frees the enough of parts */
+	for (usageCount = 0; usageCount < S3_PART_USAGE_COUNT_MAX; usageCount++)
+	{
+		excess += evictionHistogram[usageCount];
+		if (excess >= numParts - targetNumParts)
+			break;
+	}
+	evictionMaxUsageCount = usageCount;
+	evictionTargetNumParts = targetNumParts;
+
 	iterate_files(eviction_callback);
+}
+
+/*
+ * Returns the desired size of the loaded parts in bytes, the number of the
+ * loaded parts and the number of reads, which had to wait for the part load.
+ */
+void
+s3_headers_get_eviction_stats(uint64 *desiredSize, uint64 *loadedParts,
+							  uint64 *coldReads)
+{
+	uint64		desiredNumParts = s3_size_to_num_parts(s3_desired_size);
+
+	if (s3_desired_size_max > s3_desired_size)
+		desiredNumParts = Max(desiredNumParts,
+							  pg_atomic_read_u64(&meta->desiredNumParts));
 
+	*desiredSize = desiredNumParts * ORIOLEDB_S3_PART_SIZE;
+	*loadedParts = pg_atomic_read_u64(&meta->numberOfLoadedParts);
+	*coldReads = pg_atomic_read_u64(&meta->coldReads);
 }
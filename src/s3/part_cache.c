@@ -0,0 +1,348 @@
+/*-------------------------------------------------------------------------
+ *
+ * part_cache.c
+ *		Local cache of the S3 file parts evicted from the data files.
+ *
+ * When the local data exceeds orioledb.s3_desired_size, the eviction cycle
+ * zeroes the clean parts of the data files.  The next read of such a part
+ * fetches it from S3 again.  With orioledb.s3_cache_size set, the evicted
+ * part is demoted to a file in orioledb.s3_cache_dir, which is meant to be
+ * on a fast local disk, and the load of the part takes it from there instead
+ * of S3.
+ *
+ * The cache entry is removed once the part is loaded back to the data file.
+ * So the entry can't go stale: the part may only be modified after it is
+ * loaded, and it is demoted again on the next eviction.  When the cache
+ * exceeds its size budget, the entries demoted earliest are removed.  The
+ * cache is cleared at startup, because the parts might have been changed
+ * while the cache was disabled.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/s3/part_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "orioledb.h"
+
+#include "s3/part_cache.h"
+
+#include "common/file_perm.h"
+#include "pgstat.h"
+#include "storage/fd.h"
+
+typedef struct
+{
+	pg_atomic_uint64 size;
+	pg_atomic_flag shrinkInProgress;
+} S3PartCacheMeta;
+
+typedef struct
+{
+	time_t		mtime;
+	off_t		size;
+	char	   *name;
+} S3PartCacheEntry;
+
+static S3PartCacheMeta *cacheMeta = NULL;
+
+static inline bool
+s3_part_cache_enabled(void)
+{
+	return orioledb_s3_mode && s3_cache_size > 0 &&
+		s3_cache_dir != NULL && s3_cache_dir[0] != '\0';
+}
+
+static inline uint64
+s3_part_cache_budget(void)
+{
+	return (uint64) s3_cache_size * 1024 * 1024;
+}
+
+static char *
+s3_part_cache_filename(S3HeaderTag tag, int partNum)
+{
+	return psprintf("%s/%u-%u-%u-%d-%d", s3_cache_dir, tag.checkpointNum,
+					tag.datoid, tag.relnode, tag.segNum, partNum);
+}
+
+static void
+s3_part_cache_sub_size(uint64 size)
+{
+	uint64		value = pg_atomic_read_u64(&cacheMeta->size);
+
+	while (!pg_atomic_compare_exchange_u64(&cacheMeta->size, &value,
+										   value > size ? value - size : 0))
+		;
+}
+
+Size
+s3_part_cache_shmem_needs(void)
+{
+	return CACHELINEALIGN(sizeof(S3PartCacheMeta));
+}
+
+void
+s3_part_cache_shmem_init(Pointer ptr, bool found)
+{
+	DIR		   *dir;
+	struct dirent *file;
+
+	cacheMeta = (S3PartCacheMeta *) ptr;
+	if (found)
+		return;
+
+	pg_atomic_init_u64(&cacheMeta->size, 0);
+	pg_atomic_init_flag(&cacheMeta->shrinkInProgress);
+
+	if (!s3_part_cache_enabled())
+		return;
+
+	if (MakePGDirectory(s3_cache_dir) < 0 && errno != EEXIST)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not create directory \"%s\": %m",
+							   s3_cache_dir)));
+
+	dir = opendir(s3_cache_dir);
+	if (dir == NULL)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not open directory \"%s\": %m",
+							   s3_cache_dir)));
+
+	while (errno = 0, (file = readdir(dir)) != NULL)
+	{
+		char	   *filename;
+
+		if (strcmp(file->d_name, ".") == 0 || strcmp(file->d_name, "..") == 0)
+			continue;
+
+		filename = psprintf("%s/%s", s3_cache_dir, file->d_name);
+		(void) unlink(filename);
+		pfree(filename);
+	}
+	closedir(dir);
+}
+
+static int
+s3_part_cache_entry_cmp(const void *a, const void *b)
+{
+	const S3PartCacheEntry *entry1 = (const S3PartCacheEntry *) a;
+	const S3PartCacheEntry *entry2 = (const S3PartCacheEntry *) b;
+
+	if (entry1->mtime != entry2->mtime)
+		return entry1->mtime < entry2->mtime ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Removes the entries demoted earliest, till the cache takes 90% of its
+ * budget.  The cache size is recalculated from the directory contents.
+ */
+static void
+s3_part_cache_shrink(void)
+{
+	DIR		   *dir;
+	struct dirent *file;
+	S3PartCacheEntry *entries;
+	int			nentries = 0,
+				allocated = 64,
+				i;
+	uint64		total = 0,
+				target = s3_part_cache_budget() / 10 * 9;
+
+	if (!pg_atomic_test_set_flag(&cacheMeta->shrinkInProgress))
+		return;
+
+	dir = opendir(s3_cache_dir);
+	if (dir == NULL)
+	{
+		pg_atomic_clear_flag(&cacheMeta->shrinkInProgress);
+		return;
+	}
+
+	entries = (S3PartCacheEntry *) palloc(sizeof(S3PartCacheEntry) * allocated);
+	while (errno = 0, (file = readdir(dir)) != NULL)
+	{
+		struct stat st;
+		char	   *filename;
+
+		/* Skip the files being written */
+		if (file->d_name[0] == '.' || strstr(file->d_name, ".tmp") != NULL)
+			continue;
+
+		filename = psprintf("%s/%s", s3_cache_dir, file->d_name);
+		if (stat(filename, &st) != 0)
+		{
+			pfree(filename);
+			continue;
+		}
+
+		if (nentries >= allocated)
+		{
+			allocated *= 2;
+			entries = (S3PartCacheEntry *) repalloc(entries,
+													sizeof(S3PartCacheEntry) * allocated);
+		}
+		entries[nentries].mtime = st.st_mtime;
+		entries[nentries].size = st.st_size;
+		entries[nentries].name = filename;
+		nentries++;
+		total += st.st_size;
+	}
+	closedir(dir);
+
+	qsort(entries, nentries, sizeof(S3PartCacheEntry), s3_part_cache_entry_cmp);
+	for (i = 0; i < nentries; i++)
+	{
+		if (total > target && unlink(entries[i].name) == 0)
+			total -= entries[i].size;
+		pfree(entries[i].name);
+	}
+	pfree(entries);
+
+	pg_atomic_write_u64(&cacheMeta->size, total);
+	pg_atomic_clear_flag(&cacheMeta->shrinkInProgress);
+}
+
+/*
+ * Demotes the part of the data file 'fd' at 'offset' with length 'size' to
+ * the cache.  Called by the eviction cycle before zeroing the part.  Failures
+ * are only reported: the part is still in S3.
+ */
+void
+s3_part_cache_put(S3HeaderTag tag, int partNum, int fd, off_t offset,
+				  off_t size)
+{
+	char	   *filename;
+	char	   *tmpFilename;
+	Pointer		buffer;
+	int			cacheFd;
+	off_t		done = 0;
+	bool		written;
+
+	if (!s3_part_cache_enabled() || size <= 0 ||
+		(uint64) size > s3_part_cache_budget())
+		return;
+
+	buffer = (Pointer) palloc(size);
+	while (done < size)
+	{
+		int			rc;
+
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_READ);
+		rc = pg_pread(fd, buffer + done, size - done, offset + done);
+		pgstat_report_wait_end();
+
+		if (rc <= 0)
+		{
+			pfree(buffer);
+			return;
+		}
+		done += rc;
+	}
+
+	filename = s3_part_cache_filename(tag, partNum);
+	tmpFilename = psprintf("%s.tmp.%d", filename, MyProcPid);
+
+	cacheFd = BasicOpenFilePerm(tmpFilename, O_CREAT | O_WRONLY | O_TRUNC | PG_BINARY,
+								pg_file_create_mode);
+	written = cacheFd >= 0;
+	if (written)
+	{
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_WRITE);
+		written = pg_pwrite(cacheFd, buffer, size, 0) == size;
+		pgstat_report_wait_end();
+		written = (close(cacheFd) == 0) && written;
+	}
+	if (!written || rename(tmpFilename, filename) != 0)
+	{
+		ereport(WARNING, (errcode_for_file_access(),
+						  errmsg("could not write S3 cache file \"%s\": %m",
+								 filename)));
+		(void) unlink(tmpFilename);
+		(void) unlink(filename);
+	}
+	else if (pg_atomic_add_fetch_u64(&cacheMeta->size, size) > s3_part_cache_budget())
+	{
+		s3_part_cache_shrink();
+	}
+
+	pfree(buffer);
+	pfree(tmpFilename);
+	pfree(filename);
+}
+
+/*
+ * Loads the part of the data file 'filename' from the cache and removes the
+ * cache entry.
+ *
+ * Returns false if the part isn't cached.
+ */
+bool
+s3_part_cache_get(S3HeaderTag tag, int partNum, const char *filename)
+{
+	char	   *cacheFilename;
+	Pointer		buffer;
+	int			cacheFd;
+	off_t		size;
+	File		file;
+	int			rc;
+
+	if (!s3_part_cache_enabled())
+		return false;
+
+	cacheFilename = s3_part_cache_filename(tag, partNum);
+	cacheFd = BasicOpenFile(cacheFilename, O_RDONLY | PG_BINARY);
+	if (cacheFd < 0)
+	{
+		pfree(cacheFilename);
+		return false;
+	}
+
+	size = lseek(cacheFd, 0, SEEK_END);
+	buffer = (Pointer) palloc(Max(size, 1));
+	pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_READ);
+	rc = size > 0 ? pg_pread(cacheFd, buffer, size, 0) : -1;
+	pgstat_report_wait_end();
+	close(cacheFd);
+
+	if (rc != size)
+	{
+		if (unlink(cacheFilename) == 0)
+			s3_part_cache_sub_size(Max(size, 0));
+		pfree(buffer);
+		pfree(cacheFilename);
+		return false;
+	}
+
+	file = PathNameOpenFile(filename, O_CREAT | O_RDWR | PG_BINARY);
+	if (file < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", filename)));
+
+	rc = FileWrite(file, buffer, size,
+				   (off_t) partNum * ORIOLEDB_S3_PART_SIZE + ORIOLEDB_BLCKSZ,
+				   WAIT_EVENT_DATA_FILE_WRITE);
+	if (rc != size)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", filename)));
+	FileClose(file);
+
+	/* The part is loaded, so the entry would go stale on the next change */
+	if (unlink(cacheFilename) == 0)
+		s3_part_cache_sub_size(size);
+
+	elog(DEBUG1, "S3 part cache hit %s", cacheFilename);
+
+	pfree(buffer);
+	pfree(cacheFilename);
+	return true;
+}
@@ -3,6 +3,13 @@
  * queue.c
  *		Implementation for queue of tasks for S3 workers.
  *
+ * The queue consists of the lanes of different priorities, each being a
+ * separate lockless circular buffer.  A read, which a backend is blocked on,
+ * shouldn't wait behind the bulk of checkpoint writes.  Workers pick the
+ * tasks from the highest priority lane having them.  In order to prevent the
+ * starvation, every S3_QUEUE_FAIRNESS_INTERVAL-th pick starts from one of the
+ * lower priority lanes in round-robin.
+ *
  * Copyright (c) 2024-2025, Oriole DB Inc.
  * Copyright (c) 2025, Supabase Inc.
  *
@@ -18,10 +25,17 @@
 
 #include "s3/queue.h"
 
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/tuplestore.h"
 #include "utils/wait_event.h"
 
+#define S3_QUEUE_FAIRNESS_INTERVAL	8
+
 /*
- * Meta-information about S3 tasks queue.
+ * Meta-information about the lane of S3 tasks queue.
  */
 typedef struct
 {
@@ -38,6 +52,16 @@ typedef struct
 	 */
 	pg_atomic_uint64 erasedLocation;
 	ConditionVariable erasedLocationCV;
+
+	/* Statistics */
+	pg_atomic_uint64 insertedTasks;
+	pg_atomic_uint64 pickedTasks;
+	pg_atomic_uint64 erasedTasks;
+} S3TaskQueueLane;
+
+typedef struct
+{
+	S3TaskQueueLane lanes[S3_TASK_PRIORITIES_NUM];
 } S3TaskQueueMeta;
 
 /*
@@ -46,9 +70,19 @@ typedef struct
  */
 #define	LENGTH_ERASED_FLAG	(0x80000000)
 
+static const char *s3_queue_lane_names[S3_TASK_PRIORITIES_NUM] = {
+	"read",
+	"wal",
+	"checkpoint",
+	"prefetch"
+};
+
 static Size s3_queue_size = 0;
 static S3TaskQueueMeta *s3_queue_meta = NULL;
-static Pointer s3_queue_buffer = NULL;
+static Pointer s3_queue_buffers[S3_TASK_PRIORITIES_NUM];
+static uint32 s3_queue_picks_count = 0;
+
+PG_FUNCTION_INFO_V1(orioledb_s3_queue_stats);
 
 Size
 s3_queue_shmem_needs(void)
@@ -59,7 +93,8 @@ s3_queue_shmem_needs(void)
 		return size;
 
 	size = add_size(size, CACHELINEALIGN(sizeof(S3TaskQueueMeta)));
-	size = add_size(size, CACHELINEALIGN((Size) s3_queue_size_guc * 1024));
+	size = add_size(size, mul_size(CACHELINEALIGN((Size) s3_queue_size_guc * 1024),
+								   S3_TASK_PRIORITIES_NUM));
 
 	return size;
 }
@@ -67,6 +102,8 @@ s3_queue_shmem_needs(void)
 void
 s3_queue_init_shmem(Pointer ptr, bool found)
 {
+	int			i;
+
 	if (!orioledb_s3_mode)
 		return;
 
@@ -75,33 +112,42 @@ s3_queue_init_shmem(Pointer ptr, bool found)
 	s3_queue_meta = (S3TaskQueueMeta *) ptr;
 	ptr += CACHELINEALIGN(sizeof(S3TaskQueueMeta));
 
-	s3_queue_buffer = ptr;
+	for (i = 0; i < S3_TASK_PRIORITIES_NUM; i++)
+	{
+		s3_queue_buffers[i] = ptr;
+		ptr += CACHELINEALIGN(s3_queue_size);
+	}
 
 	if (!found)
 	{
-		pg_atomic_init_u64(&s3_queue_meta->insertLocation, 0);
-		pg_atomic_init_u64(&s3_queue_meta->pickLocation, 0);
-		pg_atomic_init_u64(&s3_queue_meta->erasedLocation, 0);
+		for (i = 0; i < S3_TASK_PRIORITIES_NUM; i++)
+		{
+			S3TaskQueueLane *lane = &s3_queue_meta->lanes[i];
 
-		ConditionVariableInit(&s3_queue_meta->insertLocationCV);
-		ConditionVariableInit(&s3_queue_meta->erasedLocationCV);
+			pg_atomic_init_u64(&lane->insertLocation, 0);
+			pg_atomic_init_u64(&lane->pickLocation, 0);
+			pg_atomic_init_u64(&lane->erasedLocation, 0);
 
-		memset(s3_queue_buffer, 0, s3_queue_size);
-	}
-}
+			ConditionVariableInit(&lane->insertLocationCV);
+			ConditionVariableInit(&lane->erasedLocationCV);
 
-S3TaskLocation
-s3_queue_get_insert_location(void)
-{
-	return pg_atomic_read_u64(&s3_queue_meta->insertLocation);
+			pg_atomic_init_u64(&lane->insertedTasks, 0);
+			pg_atomic_init_u64(&lane->pickedTasks, 0);
+			pg_atomic_init_u64(&lane->erasedTasks, 0);
+
+			memset(s3_queue_buffers[i], 0, s3_queue_size);
+		}
+	}
 }
 
 /*
- * Put new task to the lockless queue.
+ * Put new task to the lockless queue lane of given priority.
  */
 S3TaskLocation
-s3_queue_put_task(Pointer data, uint32 len)
+s3_queue_put_task(Pointer data, uint32 len, S3TaskPriority priority)
 {
+	S3TaskQueueLane *lane = &s3_queue_meta->lanes[priority];
+	Pointer		s3_queue_buffer = s3_queue_buffers[priority];
 	S3TaskLocation insertLocation;
 	bool		slept = false;
 	uint32		totallen = len + sizeof(uint32);
@@ -109,15 +155,15 @@ s3_queue_put_task(Pointer data, uint32 len)
 	Assert(totallen = INTALIGN(totallen));
 
 	/* Pick the insert location */
-	insertLocation = pg_atomic_fetch_add_u64(&s3_queue_meta->insertLocation, totallen);
+	insertLocation = pg_atomic_fetch_add_u64(&lane->insertLocation, totallen);
 
 	/*
 	 * Check that circular buffer of tasks didn't wraparound.  Wait the
 	 * overlapping tasks to be erased before we continue.
 	 */
-	while (insertLocation + totallen > pg_atomic_read_u64(&s3_queue_meta->erasedLocation) + s3_queue_size)
+	while (insertLocation + totallen > pg_atomic_read_u64(&lane->erasedLocation) + s3_queue_size)
 	{
-		ConditionVariableSleep(&s3_queue_meta->erasedLocationCV, WAIT_EVENT_MQ_PUT_MESSAGE);
+		ConditionVariableSleep(&lane->erasedLocationCV, WAIT_EVENT_MQ_PUT_MESSAGE);
 		slept = true;
 	}
 	if (slept)
@@ -156,16 +202,22 @@ s3_queue_put_task(Pointer data, uint32 len)
 	pg_write_barrier();
 	*((uint32 *) (s3_queue_buffer + insertLocation % s3_queue_size)) = totallen;
 
-	return insertLocation;
+	pg_atomic_fetch_add_u64(&lane->insertedTasks, 1);
+
+	return S3_TASK_LOCATION_MAKE(priority, insertLocation);
 }
 
 /*
- * Try to pick the task for processing.  Returns the task location on success,
- * and InvalidS3TaskLocation on failure.
+ * Try to pick the task from the lane of given priority.  Returns the offset
+ * of the task within the lane on success, and InvalidS3TaskLocation on
+ * failure.
  */
-S3TaskLocation
-s3_queue_try_pick_task(void)
+static S3TaskLocation
+s3_queue_try_pick_lane_task(S3TaskPriority priority)
 {
+	S3TaskQueueLane *lane = &s3_queue_meta->lanes[priority];
+	Pointer		s3_queue_buffer = s3_queue_buffers[priority];
+
 	while (true)
 	{
 		S3TaskLocation insertLocation,
@@ -173,10 +225,10 @@ s3_queue_try_pick_task(void)
 					erasedLocation;
 		uint32		taskLen;
 
-		pickLocation = pg_atomic_read_u64(&s3_queue_meta->pickLocation);
+		pickLocation = pg_atomic_read_u64(&lane->pickLocation);
 		pg_read_barrier();
-		insertLocation = pg_atomic_read_u64(&s3_queue_meta->insertLocation);
-		erasedLocation = pg_atomic_read_u64(&s3_queue_meta->erasedLocation);
+		insertLocation = pg_atomic_read_u64(&lane->insertLocation);
+		erasedLocation = pg_atomic_read_u64(&lane->erasedLocation);
 
 		if (pickLocation >= insertLocation)
 		{
@@ -205,21 +257,85 @@ s3_queue_try_pick_task(void)
 		 * Try to advance the pick location.  Whoever succeed on advancing the
 		 * pick location is assumed to successfully pick the task.
 		 */
-		if (pg_atomic_compare_exchange_u64(&s3_queue_meta->pickLocation,
+		if (pg_atomic_compare_exchange_u64(&lane->pickLocation,
 										   &pickLocation,
 										   pickLocation + taskLen))
 		{
+			pg_atomic_fetch_add_u64(&lane->pickedTasks, 1);
 			return pickLocation;
 		}
 	}
 }
 
+/*
+ * Check if any lane has the task ready to be picked.  Workers use this to
+ * decide whether they can go to sleep.
+ */
+bool
+s3_queue_has_ready_task(void)
+{
+	int			i;
+
+	for (i = 0; i < S3_TASK_PRIORITIES_NUM; i++)
+	{
+		S3TaskQueueLane *lane = &s3_queue_meta->lanes[i];
+		S3TaskLocation pickLocation,
+					erasedLocation;
+
+		pickLocation = pg_atomic_read_u64(&lane->pickLocation);
+		pg_read_barrier();
+		if (pickLocation >= pg_atomic_read_u64(&lane->insertLocation))
+			continue;
+
+		erasedLocation = pg_atomic_read_u64(&lane->erasedLocation);
+		if (pickLocation + sizeof(uint32) >= erasedLocation + s3_queue_size)
+			continue;
+
+		if (*((volatile uint32 *) (s3_queue_buffers[i] + pickLocation % s3_queue_size)) != 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Try to pick the task for processing.  Returns the task location on success,
+ * and InvalidS3TaskLocation on failure.
+ */
+S3TaskLocation
+s3_queue_try_pick_task(void)
+{
+	int			first = 0,
+				i;
+
+	/* Let the lower priority lanes go first from time to time */
+	if ((s3_queue_picks_count + 1) % S3_QUEUE_FAIRNESS_INTERVAL == 0)
+		first = 1 + (s3_queue_picks_count / S3_QUEUE_FAIRNESS_INTERVAL) %
+			(S3_TASK_PRIORITIES_NUM - 1);
+
+	for (i = 0; i < S3_TASK_PRIORITIES_NUM; i++)
+	{
+		S3TaskPriority priority = (first + i) % S3_TASK_PRIORITIES_NUM;
+		S3TaskLocation location;
+
+		location = s3_queue_try_pick_lane_task(priority);
+		if (location != InvalidS3TaskLocation)
+		{
+			s3_queue_picks_count++;
+			return S3_TASK_LOCATION_MAKE(priority, location);
+		}
+	}
+
+	return InvalidS3TaskLocation;
+}
+
 /*
  * Get the task by its location.
  */
 Pointer
-s3_queue_get_task(S3TaskLocation taskLocation)
+s3_queue_get_task(S3TaskLocation location)
 {
+	Pointer		s3_queue_buffer = s3_queue_buffers[S3_TASK_LOCATION_GET_PRIORITY(location)];
+	S3TaskLocation taskLocation = S3_TASK_LOCATION_GET_OFFSET(location);
 	uint32		taskLen;
 	Pointer		result;
 
@@ -249,8 +365,8 @@ s3_queue_get_task(S3TaskLocation taskLocation)
 
 		Assert(firstChunkLen >= sizeof(uint32));
 
-		memcpy(s3_queue_buffer + taskLocation % s3_queue_size + sizeof(uint32),
-			   result,
+		memcpy(result,
+			   s3_queue_buffer + taskLocation % s3_queue_size + sizeof(uint32),
 			   firstChunkLen - sizeof(uint32));
 		memcpy(result + (firstChunkLen - sizeof(uint32)),
 			   s3_queue_buffer,
@@ -264,8 +380,11 @@ s3_queue_get_task(S3TaskLocation taskLocation)
  * Erase the processed task from the circular buffer.
  */
 void
-s3_queue_erase_task(S3TaskLocation taskLocation)
+s3_queue_erase_task(S3TaskLocation location)
 {
+	S3TaskQueueLane *lane = &s3_queue_meta->lanes[S3_TASK_LOCATION_GET_PRIORITY(location)];
+	Pointer		s3_queue_buffer = s3_queue_buffers[S3_TASK_LOCATION_GET_PRIORITY(location)];
+	S3TaskLocation taskLocation = S3_TASK_LOCATION_GET_OFFSET(location);
 	uint32		taskLen;
 
 	taskLen = *((uint32 *) (s3_queue_buffer + taskLocation % s3_queue_size));
@@ -304,8 +423,10 @@ s3_queue_erase_task(S3TaskLocation taskLocation)
 	/* Put the LENGTH_ERASED_FLAG, which means we have erased the task body */
 	*((uint32 *) (s3_queue_buffer + taskLocation % s3_queue_size)) = taskLen | LENGTH_ERASED_FLAG;
 
+	pg_atomic_fetch_add_u64(&lane->erasedTasks, 1);
+
 	/* Try to advance the erased location */
-	while (pg_atomic_compare_exchange_u64(&s3_queue_meta->erasedLocation,
+	while (pg_atomic_compare_exchange_u64(&lane->erasedLocation,
 										  &taskLocation,
 										  taskLocation + taskLen))
 	{
@@ -326,23 +447,90 @@ s3_queue_erase_task(S3TaskLocation taskLocation)
 		taskLen &= ~LENGTH_ERASED_FLAG;
 	}
 
-	ConditionVariableBroadcast(&s3_queue_meta->erasedLocationCV);
+	ConditionVariableBroadcast(&lane->erasedLocationCV);
 }
 
 /*
- * Wait till the task with given location is processed by worker.
+ * Wait till the task with given location and all the previous tasks of the
+ * same lane are processed by workers.
  */
 void
 s3_queue_wait_for_location(S3TaskLocation location)
 {
+	S3TaskQueueLane *lane;
+	S3TaskLocation offset = S3_TASK_LOCATION_GET_OFFSET(location);
 	bool		slept = false;
 
-	while (pg_atomic_read_u64(&s3_queue_meta->erasedLocation) <= location)
+	if (location == 0)
+		return;
+
+	lane = &s3_queue_meta->lanes[S3_TASK_LOCATION_GET_PRIORITY(location)];
+	while (pg_atomic_read_u64(&lane->erasedLocation) <= offset)
 	{
-		ConditionVariableSleep(&s3_queue_meta->erasedLocationCV,
+		ConditionVariableSleep(&lane->erasedLocationCV,
 							   WAIT_EVENT_MQ_PUT_MESSAGE);
 		slept = true;
 	}
 	if (slept)
 		ConditionVariableCancelSleep();
 }
+
+/*
+ * Returns the number of tasks scheduled to, picked from and processed in
+ * every lane of the queue.  The queue depth is the number of scheduled tasks,
+ * which are not picked yet.
+ */
+Datum
+orioledb_s3_queue_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			i;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (!orioledb_s3_mode)
+		return (Datum) 0;
+
+	for (i = 0; i < S3_TASK_PRIORITIES_NUM; i++)
+	{
+		S3TaskQueueLane *lane = &s3_queue_meta->lanes[i];
+		Datum		values[5];
+		bool		nulls[5] = {false, false, false, false, false};
+		uint64		erased,
+					picked,
+					inserted;
+
+		/* Read in the reverse order, so the differences are never negative */
+		erased = pg_atomic_read_u64(&lane->erasedTasks);
+		pg_read_barrier();
+		picked = pg_atomic_read_u64(&lane->pickedTasks);
+		pg_read_barrier();
+		inserted = pg_atomic_read_u64(&lane->insertedTasks);
+
+		values[0] = CStringGetTextDatum(s3_queue_lane_names[i]);
+		values[1] = Int64GetDatum((int64) (inserted - picked));
+		values[2] = Int64GetDatum((int64) (picked - erased));
+		values[3] = Int64GetDatum((int64) inserted);
+		values[4] = Int64GetDatum((int64) erased);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
@@ -20,6 +20,7 @@
 #include "orioledb.h"
 
 #include "s3/requests.h"
+#include "s3/stats.h"
 
 #include "common/base64.h"
 #include "lib/stringinfo.h"
@@ -66,7 +67,7 @@ hex_string(Pointer data, int len)
  */
 static char *
 canonical_request_checksum(char *method, char *datetime, char *objectname,
-						   char *contentchecksum)
+						   char *query, char *contentchecksum)
 {
 	StringInfoData buf;
 	unsigned char checksumbuf[32];
@@ -74,7 +75,7 @@ canonical_request_checksum(char *method, char *datetime, char *objectname,
 	initStringInfo(&buf);
 	appendStringInfo(&buf, "%s\n", method);
 	appendStringInfo(&buf, "/%s\n", objectname);
-	appendStringInfo(&buf, "\n");
+	appendStringInfo(&buf, "%s\n", query);
 	appendStringInfo(&buf, "host:%s\n", s3_host);
 	appendStringInfo(&buf, "x-amz-content-sha256:%s\n", contentchecksum);
 	appendStringInfo(&buf, "x-amz-date:%s\n", datetime);
@@ -90,11 +91,13 @@ canonical_request_checksum(char *method, char *datetime, char *objectname,
 
 /*
  * Construct signed string for the Authorization header,
- * following the Amazon S3 REST API spec.
+ * following the Amazon S3 REST API spec.  The query must be in the canonical
+ * form: sorted by the parameter names and URI-encoded.
  */
 static char *
 s3_signature(char *method, char *datetimestring, char *datestring,
-			 char *objectname, char *secretkey, char *checksumstring)
+			 char *objectname, char *query, char *secretkey,
+			 char *checksumstring)
 {
 	StringInfoData buf;
 	char	   *key;
@@ -102,7 +105,8 @@ s3_signature(char *method, char *datetimestring, char *datestring,
 	char	   *canonical_checksum;
 
 	canonical_checksum = canonical_request_checksum(method, datetimestring,
-													objectname, checksumstring);
+													objectname, query,
+													checksumstring);
 
 	key = psprintf("AWS4%s", s3_secretkey);
 	hmac_sha256(datestring, checksumbuf, key, strlen(key));
@@ -159,6 +163,36 @@ httpdatetime(time_t *timer)
 	return datetimestring;
 }
 
+/*
+ * The curl handle is kept for the whole life of the process.  The handle
+ * keeps the cache of the connections to S3, so subsequent requests reuse the
+ * established TCP and TLS sessions instead of setting them up every time.
+ */
+static CURL *s3_curl = NULL;
+
+/*
+ * Returns the curl handle with the default options.
+ */
+static CURL *
+s3_curl_handle(void)
+{
+	if (s3_curl == NULL)
+	{
+		s3_curl = curl_easy_init();
+		if (s3_curl == NULL)
+			ereport(FATAL, (errcode(ERRCODE_CONNECTION_EXCEPTION),
+							errmsg("could not initialize curl handle")));
+	}
+	else
+	{
+		/* Resets the options, but keeps the live connections */
+		curl_easy_reset(s3_curl);
+	}
+
+	curl_easy_setopt(s3_curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	return s3_curl;
+}
+
 /*
  * Curl callback, which appends data to String Info.
  */
@@ -174,12 +208,14 @@ write_data_to_buf(void *buffer, size_t size, size_t nmemb, void *userp)
 }
 
 /*
- * Get the binary content of an object from S3 into 'str'.
+ * Get the binary content of an object from S3 into 'str'.  The request is
+ * accounted in the statistics of the operation 'op'.
  *
  * Returns HTTP status code.
  */
-long
-s3_get_object(char *objectname, StringInfo str, bool missing_ok)
+static long
+s3_get_object_extended(char *objectname, StringInfo str, bool missing_ok,
+					   S3Operation op)
 {
 	CURL	   *curl;
 	char	   *url;
@@ -193,6 +229,7 @@ s3_get_object(char *objectname, StringInfo str, bool missing_ok)
 	char	   *checksumstringbuf;
 	char	   *objectpath = objectname;
 	long		http_code = 0;
+	TimestampTz startTime = s3_stats_request_start(op, objectname);
 
 	(void) SHA256(NULL, 0, checksumbuf);
 	checksumstringbuf = hex_string((Pointer) checksumbuf, sizeof(checksumbuf));
@@ -214,7 +251,7 @@ s3_get_object(char *objectname, StringInfo str, bool missing_ok)
 	datestring = httpdate(NULL);
 	datetimestring = httpdatetime(NULL);
 	signature = s3_signature("GET", datetimestring, datestring, objectpath,
-							 s3_secretkey, checksumstringbuf);
+							 "", s3_secretkey, checksumstringbuf);
 
 	slist = NULL;
 	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-date: %s", datetimestring)));
@@ -226,7 +263,7 @@ s3_get_object(char *objectname, StringInfo str, bool missing_ok)
 											  s3_accesskey, datestring, s3_region, signature)));
 	pfree(tmp);
 
-	curl = curl_easy_init();
+	curl = s3_curl_handle();
 	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
 	curl_easy_setopt(curl, CURLOPT_URL, url);
 	if (s3_cainfo)
@@ -237,6 +274,10 @@ s3_get_object(char *objectname, StringInfo str, bool missing_ok)
 	sc = curl_easy_perform(curl);
 	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
 
+	s3_stats_report_request(op, str->len, startTime,
+							sc != 0 || (http_code != S3_RESPONSE_OK &&
+										!(missing_ok && http_code == S3_RESPONSE_NOT_FOUND)));
+
 	if (sc != 0 || http_code != S3_RESPONSE_OK)
 	{
 		if (missing_ok && http_code == S3_RESPONSE_NOT_FOUND)
@@ -250,8 +291,6 @@ s3_get_object(char *objectname, StringInfo str, bool missing_ok)
 									  sc, http_code, str->data)));
 	}
 
-	curl_easy_cleanup(curl);
-
 	curl_slist_free_all(slist);
 	pfree(url);
 	pfree(datestring);
@@ -264,6 +303,18 @@ s3_get_object(char *objectname, StringInfo str, bool missing_ok)
 	return http_code;
 }
 
+/*
+ * Get the binary content of an object from S3 into 'str'.
+ *
+ * Returns HTTP status code.
+ */
+long
+s3_get_object(char *objectname, StringInfo str, bool missing_ok)
+{
+	return s3_get_object_extended(objectname, str, missing_ok,
+								  S3OperationGetFile);
+}
+
 /*
  * A SQL function to get object from S3.  Currently only used for debugging
  * purposes.
@@ -299,6 +350,8 @@ s3_delete_object(char *objectname)
 	char	   *checksumstringbuf;
 	char	   *objectpath = objectname;
 	long		http_code = 0;
+	TimestampTz startTime = s3_stats_request_start(S3OperationDelete,
+												   objectname);
 
 	(void) SHA256(NULL, 0, checksumbuf);
 	checksumstringbuf = hex_string((Pointer) checksumbuf, sizeof(checksumbuf));
@@ -320,7 +373,7 @@ s3_delete_object(char *objectname)
 	datestring = httpdate(NULL);
 	datetimestring = httpdatetime(NULL);
 	signature = s3_signature("DELETE", datetimestring, datestring, objectpath,
-							 s3_secretkey, checksumstringbuf);
+							 "", s3_secretkey, checksumstringbuf);
 
 	slist = NULL;
 	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-date: %s", datetimestring)));
@@ -334,7 +387,7 @@ s3_delete_object(char *objectname)
 
 	initStringInfo(&buf);
 
-	curl = curl_easy_init();
+	curl = s3_curl_handle();
 	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
 	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
 	curl_easy_setopt(curl, CURLOPT_URL, url);
@@ -346,14 +399,15 @@ s3_delete_object(char *objectname)
 	sc = curl_easy_perform(curl);
 	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
 
+	s3_stats_report_request(S3OperationDelete, 0, startTime,
+							sc != 0 || http_code != 204 || strlen(buf.data) != 0);
+
 	if (sc != 0 || http_code != 204 || strlen(buf.data) != 0)
 		ereport(FATAL, (errcode(ERRCODE_CONNECTION_EXCEPTION),
 						errmsg("could not delete object from S3"),
 						errdetail("return code = %d, http code = %ld, response = %s",
 								  sc, http_code, buf.data)));
 
-	curl_easy_cleanup(curl);
-
 	curl_slist_free_all(slist);
 	pfree(url);
 	pfree(datestring);
@@ -365,11 +419,322 @@ s3_delete_object(char *objectname)
 	pfree(checksumstringbuf);
 }
 
+/*
+ * Curl header callback, which saves the value of the ETag header.
+ */
+static size_t
+write_etag_to_buf(char *buffer, size_t size, size_t nitems, void *userp)
+{
+	size_t		len = size * nitems;
+	StringInfo	info = (StringInfo) userp;
+
+	if (len > 5 && pg_strncasecmp(buffer, "etag:", 5) == 0)
+	{
+		char	   *start = buffer + 5;
+		char	   *end = buffer + len;
+
+		while (start < end && (*start == ' ' || *start == '\t'))
+			start++;
+		while (end > start && (end[-1] == '\r' || end[-1] == '\n' ||
+							   end[-1] == ' ' || end[-1] == '\t'))
+			end--;
+		resetStringInfo(info);
+		appendBinaryStringInfo(info, start, end - start);
+	}
+
+	return len;
+}
+
+/*
+ * Returns the path of the object within the bucket.
+ */
+static char *
+s3_object_path(char *objectname)
+{
+	if (s3_prefix)
+	{
+		int			prefix_len = strlen(s3_prefix);
+
+		if (prefix_len != 0)
+		{
+			if (s3_prefix[prefix_len - 1] == '/')
+				prefix_len--;
+			return psprintf("%.*s/%s", prefix_len, s3_prefix, objectname);
+		}
+	}
+	return objectname;
+}
+
+/*
+ * URI-encodes the query parameter value according to AWS4-HMAC-SHA256.
+ */
+static char *
+s3_uri_encode(const char *value)
+{
+	StringInfoData buf;
+	const char *ptr;
+
+	initStringInfo(&buf);
+	for (ptr = value; *ptr; ptr++)
+	{
+		unsigned char c = (unsigned char) *ptr;
+
+		if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+			(c >= '0' && c <= '9') ||
+			c == '-' || c == '_' || c == '.' || c == '~')
+			appendStringInfoChar(&buf, c);
+		else
+			appendStringInfo(&buf, "%%%02X", c);
+	}
+	return buf.data;
+}
+
+/*
+ * Returns the contents of the first XML element with the given name or NULL
+ * if there is no such element.
+ */
+static char *
+s3_xml_element(const char *xml, const char *name)
+{
+	char	   *tag = psprintf("<%s>", name);
+	char	   *endTag = psprintf("</%s>", name);
+	char	   *start,
+			   *end,
+			   *result = NULL;
+
+	start = strstr(xml, tag);
+	if (start)
+	{
+		start += strlen(tag);
+		end = strstr(start, endTag);
+		if (end)
+			result = pnstrdup(start, end - start);
+	}
+	pfree(tag);
+	pfree(endTag);
+	return result;
+}
+
+/*
+ * Makes the request of the multipart upload with the given query to the
+ * object.  The response body is written to 'response' and the ETag header to
+ * 'etag' if given.  The curl return code is written to '*sc'.
+ *
+ * Returns HTTP status code.
+ */
+static long
+s3_multipart_request(char *method, char *objectpath, char *query,
+					 Pointer data, uint64 dataSize,
+					 StringInfo response, StringInfo etag, int *sc)
+{
+	CURL	   *curl;
+	char	   *url;
+	char	   *datestring;
+	char	   *datetimestring;
+	char	   *signature;
+	char	   *checksumstringbuf;
+	struct curl_slist *slist;
+	char	   *tmp;
+	unsigned char checksumbuf[SHA256_DIGEST_LENGTH];
+	long		http_code = 0;
+
+	(void) SHA256((unsigned char *) data, dataSize, checksumbuf);
+	checksumstringbuf = hex_string((Pointer) checksumbuf, sizeof(checksumbuf));
+
+	url = psprintf("%s://%s/%s?%s",
+				   s3_use_https ? "https" : "http", s3_host, objectpath, query);
+	datestring = httpdate(NULL);
+	datetimestring = httpdatetime(NULL);
+	signature = s3_signature(method, datetimestring, datestring, objectpath,
+							 query, s3_secretkey, checksumstringbuf);
+
+	slist = NULL;
+	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-date: %s", datetimestring)));
+	pfree(tmp);
+	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-content-sha256: %s", checksumstringbuf)));
+	pfree(tmp);
+	slist = curl_slist_append(slist, (tmp = psprintf("Content-Length: %lu", dataSize)));
+	pfree(tmp);
+	slist = curl_slist_append(slist,
+							  (tmp = psprintf("Authorization: AWS4-HMAC-SHA256 Credential=%s/%s/%s/s3/aws4_request, SignedHeaders=host;x-amz-content-sha256;x-amz-date, Signature=%s",
+											  s3_accesskey, datestring, s3_region, signature)));
+	pfree(tmp);
+	slist = curl_slist_append(slist, "Content-Type: application/octet-stream");
+
+	curl = s3_curl_handle();
+	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
+	curl_easy_setopt(curl, CURLOPT_URL, url);
+	if (s3_cainfo)
+		curl_easy_setopt(curl, CURLOPT_CAINFO, s3_cainfo);
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data ? data : "");
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, dataSize);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_to_buf);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+	if (etag)
+	{
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_etag_to_buf);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, etag);
+	}
+
+	*sc = curl_easy_perform(curl);
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+	curl_slist_free_all(slist);
+	pfree(url);
+	pfree(datestring);
+	pfree(datetimestring);
+	pfree(signature);
+	pfree(checksumstringbuf);
+
+	return http_code;
+}
+
+/*
+ * Aborts the multipart upload, so S3 frees the uploaded parts.  Failure is
+ * only reported, because the upload is going to fail anyway.
+ */
+static void
+s3_abort_multipart_upload(char *objectpath, char *uploadId)
+{
+	StringInfoData buf;
+	char	   *query = psprintf("uploadId=%s", uploadId);
+	long		http_code;
+	int			sc;
+
+	initStringInfo(&buf);
+	http_code = s3_multipart_request("DELETE", objectpath, query, NULL, 0,
+									 &buf, NULL, &sc);
+	if (sc != 0 || http_code != 204)
+		ereport(WARNING, (errcode(ERRCODE_CONNECTION_EXCEPTION),
+						  errmsg("could not abort multipart upload to S3"),
+						  errdetail("return code = %d, http code = %ld, response = %s",
+									sc, http_code, buf.data)));
+	pfree(buf.data);
+	pfree(query);
+}
+
+/*
+ * Put object with given binary contents to S3 using the multipart upload.
+ * The contents are uploaded by orioledb.s3_multipart_part_size parts, the
+ * part which failed to upload is retried a few times.
+ *
+ * Returns HTTP status code.
+ */
+static long
+s3_put_object_multipart(char *objectname, Pointer data, uint64 dataSize,
+						S3Operation op)
+{
+	char	   *objectpath = s3_object_path(objectname);
+	uint64		partSize = (uint64) s3_multipart_part_size * 1024 * 1024;
+	StringInfoData response;
+	StringInfoData etag;
+	StringInfoData complete;
+	char	   *uploadId;
+	char	   *encodedUploadId;
+	char	   *query;
+	uint64		offset;
+	int			partNum;
+	long		http_code;
+	int			sc;
+	TimestampTz startTime = s3_stats_request_start(op, objectname);
+
+	initStringInfo(&response);
+	initStringInfo(&etag);
+
+	http_code = s3_multipart_request("POST", objectpath, "uploads=", NULL, 0,
+									 &response, NULL, &sc);
+	uploadId = s3_xml_element(response.data, "UploadId");
+	if (sc != 0 || http_code != S3_RESPONSE_OK || uploadId == NULL)
+	{
+		s3_stats_report_request(op, 0, startTime, true);
+		ereport(FATAL, (errcode(ERRCODE_CONNECTION_EXCEPTION),
+						errmsg("could not initiate multipart upload to S3"),
+						errdetail("return code = %d, http code = %ld, response = %s",
+								  sc, http_code, response.data)));
+	}
+	encodedUploadId = s3_uri_encode(uploadId);
+
+	initStringInfo(&complete);
+	appendStringInfoString(&complete, "<CompleteMultipartUpload>");
+	for (offset = 0, partNum = 1; offset < dataSize; offset += partSize, partNum++)
+	{
+		uint64		size = Min(partSize, dataSize - offset);
+		int			attempt;
+
+		query = psprintf("partNumber=%d&uploadId=%s", partNum, encodedUploadId);
+		for (attempt = 1;; attempt++)
+		{
+			resetStringInfo(&response);
+			resetStringInfo(&etag);
+			http_code = s3_multipart_request("PUT", objectpath, query,
+											 data + offset, size,
+											 &response, &etag, &sc);
+			if (sc == 0 && http_code == S3_RESPONSE_OK && etag.len > 0)
+				break;
+
+			if (attempt >= S3_MULTIPART_MAX_ATTEMPTS)
+			{
+				s3_stats_report_request(op, offset, startTime, true);
+				s3_abort_multipart_upload(objectpath, encodedUploadId);
+				ereport(FATAL, (errcode(ERRCODE_CONNECTION_EXCEPTION),
+								errmsg("could not put part %d of object to S3",
+									   partNum),
+								errdetail("return code = %d, http code = %ld, response = %s",
+										  sc, http_code, response.data)));
+			}
+			ereport(LOG, (errmsg("retrying put of part %d of object %s to S3",
+								 partNum, objectname),
+						  errdetail("return code = %d, http code = %ld",
+									sc, http_code)));
+			s3_stats_report_retry(op);
+			pg_usleep(S3_MULTIPART_RETRY_DELAY * attempt);
+		}
+		pfree(query);
+
+		appendStringInfo(&complete,
+						 "<Part><PartNumber>%d</PartNumber><ETag>%s</ETag></Part>",
+						 partNum, etag.data);
+	}
+	appendStringInfoString(&complete, "</CompleteMultipartUpload>");
+
+	query = psprintf("uploadId=%s", encodedUploadId);
+	resetStringInfo(&response);
+	http_code = s3_multipart_request("POST", objectpath, query,
+									 complete.data, complete.len,
+									 &response, NULL, &sc);
+
+	/* S3 might report the error in the body of the successful response */
+	if (sc != 0 || http_code != S3_RESPONSE_OK ||
+		strstr(response.data, "<Error>") != NULL)
+	{
+		s3_stats_report_request(op, dataSize, startTime, true);
+		s3_abort_multipart_upload(objectpath, encodedUploadId);
+		ereport(FATAL, (errcode(ERRCODE_CONNECTION_EXCEPTION),
+						errmsg("could not complete multipart upload to S3"),
+						errdetail("return code = %d, http code = %ld, response = %s",
+								  sc, http_code, response.data)));
+	}
+
+	s3_stats_report_request(op, dataSize, startTime, false);
+
+	pfree(query);
+	pfree(complete.data);
+	pfree(response.data);
+	pfree(etag.data);
+	pfree(uploadId);
+	pfree(encodedUploadId);
+	if (objectpath != objectname)
+		pfree(objectpath);
+
+	return http_code;
+}
+
 /*
  * Reads the part of the file 'filename' from 'offset' with length 'maxSize'.
  * The actual length might appear to be lower, it's to be written to '*size'.
  */
-static Pointer
+Pointer
 read_file_part(const char *filename, uint64 offset,
 			   uint64 maxSize, uint64 *size)
 {
@@ -482,15 +847,12 @@ write_file(const char *filename, Pointer data, uint64 size)
 }
 
 /*
- * Put object with given binary contents to S3.
- *
- * If dataChecksum is NULL the function calculates checksum of the content.
- *
- * Returns HTTP status code.
+ * Put object with given binary contents to S3.  The request is accounted in
+ * the statistics of the operation 'op'.
  */
-long
-s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
-							char *dataChecksum, bool ifNoneMatch)
+static long
+s3_put_object_extended(char *objectname, Pointer data, uint64 dataSize,
+					   char *dataChecksum, bool ifNoneMatch, S3Operation op)
 {
 	CURL	   *curl;
 	char	   *url;
@@ -504,6 +866,14 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 	int			sc;
 	StringInfoData buf;
 	long		http_code = 0;
+	TimestampTz startTime;
+
+	/* Conditional writes are only used for the small lock file */
+	if (!ifNoneMatch &&
+		dataSize > (uint64) s3_multipart_part_size * 1024 * 1024)
+		return s3_put_object_multipart(objectname, data, dataSize, op);
+
+	startTime = s3_stats_request_start(op, objectname);
 
 	if (dataChecksum == NULL)
 	{
@@ -532,7 +902,7 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 	datestring = httpdate(NULL);
 	datetimestring = httpdatetime(NULL);
 	signature = s3_signature("PUT", datetimestring, datestring, objectpath,
-							 s3_secretkey, checksumstringbuf);
+							 "", s3_secretkey, checksumstringbuf);
 
 	slist = NULL;
 	slist = curl_slist_append(slist, (tmp = psprintf("x-amz-date: %s", datetimestring)));
@@ -551,7 +921,7 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 
 	initStringInfo(&buf);
 
-	curl = curl_easy_init();
+	curl = s3_curl_handle();
 	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
 	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
 	curl_easy_setopt(curl, CURLOPT_URL, url);
@@ -565,6 +935,12 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 	sc = curl_easy_perform(curl);
 	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
 
+	s3_stats_report_request(op, dataSize, startTime,
+							(sc != 0 || http_code != S3_RESPONSE_OK ||
+							 strlen(buf.data) != 0) &&
+							!(ifNoneMatch && (http_code == S3_RESPONSE_CONDITION_FAILED ||
+											  http_code == S3_RESPONSE_CONDITION_CONFLICT)));
+
 	if (sc != 0 || http_code != S3_RESPONSE_OK || strlen(buf.data) != 0)
 	{
 		/*
@@ -583,8 +959,6 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 									  sc, http_code, buf.data)));
 	}
 
-	curl_easy_cleanup(curl);
-
 	curl_slist_free_all(slist);
 	pfree(url);
 	pfree(datestring);
@@ -599,6 +973,21 @@ s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
 	return http_code;
 }
 
+/*
+ * Put object with given binary contents to S3.
+ *
+ * If dataChecksum is NULL the function calculates checksum of the content.
+ *
+ * Returns HTTP status code.
+ */
+long
+s3_put_object_with_contents(char *objectname, Pointer data, uint64 dataSize,
+							char *dataChecksum, bool ifNoneMatch)
+{
+	return s3_put_object_extended(objectname, data, dataSize, dataChecksum,
+								  ifNoneMatch, S3OperationPutFile);
+}
+
 /*
  * Put the whole file as S3 object.
  */
@@ -654,7 +1043,8 @@ s3_put_file_part(char *objectname, char *filename, int partnum)
 						  &dataSize);
 	if (data)
 	{
-		res = s3_put_object_with_contents(objectname, data, dataSize, NULL, false);
+		res = s3_put_object_extended(objectname, data, dataSize, NULL, false,
+									 S3OperationPutPart);
 		pfree(data);
 	}
 
@@ -663,14 +1053,24 @@ s3_put_file_part(char *objectname, char *filename, int partnum)
 
 /*
  * Get the file part from S3 object.
+ *
+ * Every part is a separate S3 object, so the reads of the adjacent parts
+ * can't be coalesced into a single ranged GET.  Concurrent reads of them are
+ * done by different workers over their persistent connections instead.  The
+ * buffer is allocated for the whole part and the terminating zero at once,
+ * so the response isn't copied on the repeated enlargements.
+ * enlargeStringInfo() would round the size up to the next power of two,
+ * which is twice the part size.
  */
 void
 s3_get_file_part(char *objectname, char *filename, int partnum)
 {
 	StringInfoData buf;
 
-	initStringInfo(&buf);
-	s3_get_object(objectname, &buf, false);
+	buf.maxlen = ORIOLEDB_S3_PART_SIZE + 1;
+	buf.data = (char *) palloc(buf.maxlen);
+	resetStringInfo(&buf);
+	(void) s3_get_object_extended(objectname, &buf, false, S3OperationGetPart);
 
 	write_file_part(filename,
 					partnum * ORIOLEDB_S3_PART_SIZE + ORIOLEDB_BLCKSZ,
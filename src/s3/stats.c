@@ -0,0 +1,296 @@
+/*-------------------------------------------------------------------------
+ *
+ * stats.c
+ *		Statistics of S3 requests.
+ *
+ * The counters are kept per operation in the shared memory: the number of
+ * requests, bytes transferred, errors, retries, the total time and the
+ * latency histogram of the requests, and the time the tasks spent in the
+ * queue before a worker picked them.  The histogram buckets are powers of
+ * ten of milliseconds.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/s3/stats.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "s3/headers.h"
+#include "s3/stats.h"
+#include "utils/probes.h"
+
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/tuplestore.h"
+
+/* < 1ms, < 10ms, < 100ms, < 1s, < 10s, >= 10s */
+#define S3_STATS_HISTOGRAM_BUCKETS	6
+
+typedef struct
+{
+	pg_atomic_uint64 requests;
+	pg_atomic_uint64 bytes;
+	pg_atomic_uint64 errors;
+	pg_atomic_uint64 retries;
+	pg_atomic_uint64 totalTime;
+	pg_atomic_uint64 queueWaits;
+	pg_atomic_uint64 queueWaitTime;
+	pg_atomic_uint64 histogram[S3_STATS_HISTOGRAM_BUCKETS];
+} S3OperationStats;
+
+typedef struct
+{
+	S3OperationStats operations[S3_OPERATIONS_NUM];
+} S3Stats;
+
+static S3Stats *s3_stats = NULL;
+
+static const char *s3_operation_names[S3_OPERATIONS_NUM] = {
+	"get_part",
+	"get_file",
+	"put_part",
+	"put_file",
+	"delete"
+};
+
+PG_FUNCTION_INFO_V1(orioledb_s3_stats);
+PG_FUNCTION_INFO_V1(orioledb_s3_headers_stats);
+
+Size
+s3_stats_shmem_needs(void)
+{
+	if (!orioledb_s3_mode)
+		return 0;
+
+	return CACHELINEALIGN(sizeof(S3Stats));
+}
+
+void
+s3_stats_shmem_init(Pointer ptr, bool found)
+{
+	int			i,
+				j;
+
+	if (!orioledb_s3_mode)
+		return;
+
+	s3_stats = (S3Stats *) ptr;
+
+	if (found)
+		return;
+
+	for (i = 0; i < S3_OPERATIONS_NUM; i++)
+	{
+		S3OperationStats *stats = &s3_stats->operations[i];
+
+		pg_atomic_init_u64(&stats->requests, 0);
+		pg_atomic_init_u64(&stats->bytes, 0);
+		pg_atomic_init_u64(&stats->errors, 0);
+		pg_atomic_init_u64(&stats->retries, 0);
+		pg_atomic_init_u64(&stats->totalTime, 0);
+		pg_atomic_init_u64(&stats->queueWaits, 0);
+		pg_atomic_init_u64(&stats->queueWaitTime, 0);
+		for (j = 0; j < S3_STATS_HISTOGRAM_BUCKETS; j++)
+			pg_atomic_init_u64(&stats->histogram[j], 0);
+	}
+}
+
+static uint64
+s3_stats_elapsed(TimestampTz startTime)
+{
+	TimestampTz now = GetCurrentTimestamp();
+
+	return now > startTime ? (uint64) (now - startTime) : 0;
+}
+
+/*
+ * Returns the start time for s3_stats_report_request() of the request of the
+ * operation to the object.
+ */
+TimestampTz
+s3_stats_request_start(S3Operation op, char *objectname)
+{
+	ORIOLEDB_PROBE2(s3_request__start, op, objectname);
+	return GetCurrentTimestamp();
+}
+
+/*
+ * Accounts the finished request of the operation, which has started at
+ * 'startTime' and transferred 'bytes'.
+ */
+void
+s3_stats_report_request(S3Operation op, uint64 bytes, TimestampTz startTime,
+						bool error)
+{
+	S3OperationStats *stats;
+	uint64		elapsed = s3_stats_elapsed(startTime);
+	uint64		bound = 1000;
+	int			bucket = 0;
+
+	ORIOLEDB_PROBE4(s3_request__done, op, bytes, elapsed, error);
+
+	if (s3_stats == NULL)
+		return;
+
+	stats = &s3_stats->operations[op];
+
+	while (bucket < S3_STATS_HISTOGRAM_BUCKETS - 1 && elapsed >= bound)
+	{
+		bound *= 10;
+		bucket++;
+	}
+
+	pg_atomic_fetch_add_u64(&stats->requests, 1);
+	pg_atomic_fetch_add_u64(&stats->bytes, bytes);
+	if (error)
+		pg_atomic_fetch_add_u64(&stats->errors, 1);
+	pg_atomic_fetch_add_u64(&stats->totalTime, elapsed);
+	pg_atomic_fetch_add_u64(&stats->histogram[bucket], 1);
+}
+
+void
+s3_stats_report_retry(S3Operation op)
+{
+	if (s3_stats == NULL)
+		return;
+
+	pg_atomic_fetch_add_u64(&s3_stats->operations[op].retries, 1);
+}
+
+/*
+ * Accounts the time the task of the operation spent in the queue since
+ * 'queuedAt'.
+ */
+void
+s3_stats_report_queue_wait(S3Operation op, TimestampTz queuedAt)
+{
+	S3OperationStats *stats;
+
+	if (s3_stats == NULL)
+		return;
+
+	stats = &s3_stats->operations[op];
+	pg_atomic_fetch_add_u64(&stats->queueWaits, 1);
+	pg_atomic_fetch_add_u64(&stats->queueWaitTime, s3_stats_elapsed(queuedAt));
+}
+
+static Tuplestorestate *
+s3_stats_begin_tuplestore(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = *tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
+
+/*
+ * Reports the statistics of S3 requests per operation.  The times are in
+ * milliseconds.
+ */
+Datum
+orioledb_s3_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	int			i,
+				j;
+
+	tupstore = s3_stats_begin_tuplestore(fcinfo, &tupdesc);
+
+	if (s3_stats == NULL)
+		return (Datum) 0;
+
+	for (i = 0; i < S3_OPERATIONS_NUM; i++)
+	{
+		S3OperationStats *stats = &s3_stats->operations[i];
+		Datum		histogram[S3_STATS_HISTOGRAM_BUCKETS];
+		Datum		values[9];
+		bool		nulls[9] = {false, false, false, false, false,
+		false, false, false, false};
+
+		for (j = 0; j < S3_STATS_HISTOGRAM_BUCKETS; j++)
+			histogram[j] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->histogram[j]));
+
+		values[0] = CStringGetTextDatum(s3_operation_names[i]);
+		values[1] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->requests));
+		values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->bytes));
+		values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->errors));
+		values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->retries));
+		values[5] = Float8GetDatum((double) pg_atomic_read_u64(&stats->totalTime) / 1000.0);
+		values[6] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->queueWaits));
+		values[7] = Float8GetDatum((double) pg_atomic_read_u64(&stats->queueWaitTime) / 1000.0);
+		values[8] = PointerGetDatum(construct_array(histogram,
+													S3_STATS_HISTOGRAM_BUCKETS,
+													INT8OID, sizeof(int64),
+													FLOAT8PASSBYVAL,
+													TYPALIGN_DOUBLE));
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Reports the hit ratio of the S3 headers buffers and the state of the
+ * eviction of the parts.
+ */
+Datum
+orioledb_s3_headers_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	Datum		values[6];
+	bool		nulls[6] = {false, false, false, false, false, false};
+	uint64		lookups,
+				misses,
+				desiredSize,
+				loadedParts,
+				coldReads;
+
+	tupstore = s3_stats_begin_tuplestore(fcinfo, &tupdesc);
+
+	if (!orioledb_s3_mode)
+		return (Datum) 0;
+
+	s3_headers_get_stats(&lookups, &misses);
+	misses = Min(misses, lookups);
+	s3_headers_get_eviction_stats(&desiredSize, &loadedParts, &coldReads);
+
+	values[0] = Int64GetDatum((int64) lookups);
+	values[1] = Int64GetDatum((int64) misses);
+	if (lookups > 0)
+		values[2] = Float8GetDatum((double) (lookups - misses) / (double) lookups);
+	else
+		nulls[2] = true;
+	values[3] = Int64GetDatum((int64) desiredSize);
+	values[4] = Int64GetDatum((int64) (loadedParts * ORIOLEDB_S3_PART_SIZE));
+	values[5] = Int64GetDatum((int64) coldReads);
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+	return (Datum) 0;
+}
@@ -20,11 +20,15 @@
 #include "catalog/o_sys_cache.h"
 #include "s3/checksum.h"
 #include "s3/headers.h"
+#include "s3/part_cache.h"
 #include "s3/queue.h"
 #include "s3/requests.h"
+#include "s3/stats.h"
 #include "s3/worker.h"
 
+#include "access/htup_details.h"
 #include "access/xlog_internal.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "postmaster/bgworker.h"
 #include "postmaster/bgwriter.h"
@@ -43,6 +47,7 @@
 
 #include "openssl/sha.h"
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 
@@ -53,11 +58,31 @@ typedef struct S3WorkerCtl
 	pg_atomic_uint32 fileChecksumsCnt;
 	ConditionVariable fileChecksumsFlushedCV;
 
+	/* Progress of the backup of PostgreSQL files */
+	pg_atomic_uint32 backupInProgress;
+	uint32		backupChkpNum;
+	TimestampTz backupStartTime;
+	pg_atomic_uint64 backupFilesTotal;
+	pg_atomic_uint64 backupFilesDone;
+	pg_atomic_uint64 backupBytesTotal;
+	pg_atomic_uint64 backupBytesDone;
+
 	/* S3 workers are in progress of putting PostgreSQL files into S3 bucket */
 	pg_atomic_flag workersInProgress[FLEXIBLE_ARRAY_MEMBER];
 } S3WorkerCtl;
 
+/*
+ * The latch of the worker, and whether the worker is going to sleep on it
+ * waiting for the new tasks.
+ */
+typedef struct
+{
+	Latch	   *latch;
+	pg_atomic_uint32 sleeping;
+} S3WorkerWakeup;
+
 static volatile S3TaskLocation *workers_locations = NULL;
+static S3WorkerWakeup *workers_wakeups = NULL;
 static S3FileChecksum *workers_file_checksums = NULL;
 
 static S3WorkerCtl *workers_ctl = NULL;
@@ -65,6 +90,8 @@ static S3ChecksumState *checksum_state = NULL;
 
 static int	worker_num;
 
+PG_FUNCTION_INFO_V1(orioledb_s3_backup_progress);
+
 Size
 s3_workers_shmem_needs(void)
 {
@@ -74,6 +101,8 @@ s3_workers_shmem_needs(void)
 						  sizeof(pg_atomic_flag) * s3_num_workers);
 	size = add_size(size,
 					CACHELINEALIGN(mul_size(sizeof(S3TaskLocation), s3_num_workers)));
+	size = add_size(size,
+					CACHELINEALIGN(mul_size(sizeof(S3WorkerWakeup), s3_num_workers)));
 	size = add_size(size,
 					CACHELINEALIGN(mul_size(sizeof(S3FileChecksum),
 											s3_num_workers *
@@ -94,6 +123,9 @@ s3_workers_init_shmem(Pointer ptr, bool found)
 	workers_locations = (S3TaskLocation *) ptr;
 	ptr += CACHELINEALIGN(mul_size(sizeof(S3TaskLocation), s3_num_workers));
 
+	workers_wakeups = (S3WorkerWakeup *) ptr;
+	ptr += CACHELINEALIGN(mul_size(sizeof(S3WorkerWakeup), s3_num_workers));
+
 	workers_file_checksums = (S3FileChecksum *) ptr;
 
 	if (!found)
@@ -102,10 +134,20 @@ s3_workers_init_shmem(Pointer ptr, bool found)
 
 		ConditionVariableInit(&workers_ctl->fileChecksumsFlushedCV);
 
+		pg_atomic_init_u32(&workers_ctl->backupInProgress, 0);
+		workers_ctl->backupChkpNum = 0;
+		workers_ctl->backupStartTime = 0;
+		pg_atomic_init_u64(&workers_ctl->backupFilesTotal, 0);
+		pg_atomic_init_u64(&workers_ctl->backupFilesDone, 0);
+		pg_atomic_init_u64(&workers_ctl->backupBytesTotal, 0);
+		pg_atomic_init_u64(&workers_ctl->backupBytesDone, 0);
+
 		for (i = 0; i < s3_num_workers; i++)
 		{
 			workers_locations[i] = InvalidS3TaskLocation;
 			pg_atomic_init_flag(&workers_ctl->workersInProgress[i]);
+			workers_wakeups[i].latch = NULL;
+			pg_atomic_init_u32(&workers_wakeups[i].sleeping, 0);
 		}
 	}
 }
@@ -156,6 +198,58 @@ s3_workers_wait_for_flush(void)
 	ConditionVariableCancelSleep();
 }
 
+/*
+ * Start the progress reporting of the backup of 'filesTotal' PostgreSQL
+ * files of 'bytesTotal' size in total for the checkpoint 'chkpNum'.
+ */
+void
+s3_workers_backup_start(uint32 chkpNum, uint64 filesTotal, uint64 bytesTotal)
+{
+	workers_ctl->backupChkpNum = chkpNum;
+	workers_ctl->backupStartTime = GetCurrentTimestamp();
+	pg_atomic_write_u64(&workers_ctl->backupFilesDone, 0);
+	pg_atomic_write_u64(&workers_ctl->backupBytesDone, 0);
+	pg_atomic_write_u64(&workers_ctl->backupFilesTotal, filesTotal);
+	pg_atomic_write_u64(&workers_ctl->backupBytesTotal, bytesTotal);
+	pg_write_barrier();
+	pg_atomic_write_u32(&workers_ctl->backupInProgress, 1);
+}
+
+void
+s3_workers_backup_finish(void)
+{
+	pg_atomic_write_u32(&workers_ctl->backupInProgress, 0);
+}
+
+/*
+ * Reports the progress of the last backup of PostgreSQL files.
+ */
+Datum
+orioledb_s3_backup_progress(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[7];
+	bool		nulls[7] = {false, false, false, false, false, false, false};
+
+	orioledb_check_shmem();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = Int64GetDatum((int64) workers_ctl->backupChkpNum);
+	values[1] = BoolGetDatum(pg_atomic_read_u32(&workers_ctl->backupInProgress) != 0);
+	if (workers_ctl->backupStartTime != 0)
+		values[2] = TimestampTzGetDatum(workers_ctl->backupStartTime);
+	else
+		nulls[2] = true;
+	values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&workers_ctl->backupFilesTotal));
+	values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&workers_ctl->backupFilesDone));
+	values[5] = Int64GetDatum((int64) pg_atomic_read_u64(&workers_ctl->backupBytesTotal));
+	values[6] = Int64GetDatum((int64) pg_atomic_read_u64(&workers_ctl->backupBytesDone));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
 /*
  * Prepare S3 workers to checkpoint database files.
  */
@@ -271,6 +365,48 @@ flush_worker_checksum_state(void)
 	flushS3ChecksumState(checksum_state, filename);
 }
 
+/*
+ * Puts the contents of PostgreSQL file (or its chunk) 'name' into S3 bucket
+ * unless its checksum matches the one from the previous checkpoint.
+ */
+static void
+s3_put_pg_file_data(uint32 chkpNum, char *name, Pointer data, uint64 size)
+{
+	S3FileChecksum *entry;
+
+	pg_atomic_test_set_flag(&workers_ctl->workersInProgress[worker_num]);
+
+	if (checksum_state->fileChecksumsLen == WORKERS_FILE_CHECKSUMS_MAX_LEN)
+		flush_worker_checksum_state();
+
+	entry = getS3FileChecksum(checksum_state, name, data, size);
+
+	if (entry->changed)
+	{
+		char	   *objectname;
+
+		objectname = psprintf("data/%u/%s", chkpNum, name);
+		(void) s3_put_object_with_contents(objectname, data, size,
+										   entry->checksum, false);
+		pfree(objectname);
+	}
+	pfree(entry);
+}
+
+/*
+ * Returns the operation to account the queue wait of the task to.
+ */
+static S3Operation
+s3_task_operation(S3Task *task)
+{
+	if (task->type == S3TaskTypeReadFilePart)
+		return S3OperationGetPart;
+	if (task->type == S3TaskTypeWriteFilePart &&
+		task->typeSpecific.filePart.segNum >= 0)
+		return S3OperationPutPart;
+	return S3OperationPutFile;
+}
+
 /*
  * Process the task at given location.
  */
@@ -282,6 +418,8 @@ s3process_task(uint64 taskLocation)
 
 	Assert(workers_ctl != NULL);
 
+	s3_stats_report_queue_wait(s3_task_operation(task), task->queuedAt);
+
 	if (task->type == S3TaskTypeWriteFile)
 	{
 		char	   *filename = task->typeSpecific.writeFile.filename;
@@ -362,15 +500,20 @@ s3process_task(uint64 taskLocation)
 							  task->typeSpecific.filePart.segNum,
 							  task->typeSpecific.filePart.partNum);
 
-		elog(DEBUG1, "S3 part get %s %s", objectname, filename);
-
-		s3_get_file_part(objectname, filename, task->typeSpecific.filePart.partNum);
-
 		tag.datoid = task->typeSpecific.filePart.datoid;
 		tag.relnode = task->typeSpecific.filePart.relnode;
 		tag.checkpointNum = task->typeSpecific.filePart.chkpNum;
 		tag.segNum = task->typeSpecific.filePart.segNum;
 
+		if (!s3_part_cache_get(tag, task->typeSpecific.filePart.partNum,
+							   filename))
+		{
+			elog(DEBUG1, "S3 part get %s %s", objectname, filename);
+
+			s3_get_file_part(objectname, filename,
+							 task->typeSpecific.filePart.partNum);
+		}
+
 		s3_header_mark_part_loaded(tag, task->typeSpecific.filePart.partNum);
 
 		pfree(filename);
@@ -522,47 +665,78 @@ s3process_task(uint64 taskLocation)
 	else if (task->type == S3TaskTypeWritePGFile)
 	{
 		char	   *filename = task->typeSpecific.writePGFile.filename;
-		Pointer		data;
-		uint64		size;
+		struct stat st;
+		uint64		bytesDone = 0;
 
 		if (filename[0] == '.' && filename[1] == '/')
 			filename += 2;
 
-		objectname = psprintf("data/%u/%s",
-							  task->typeSpecific.writePGFile.chkpNum,
-							  filename);
+		elog(DEBUG1, "S3 PG file put %s", filename);
 
-		elog(DEBUG1, "S3 PG file put %s %s", objectname, filename);
+		if (checksum_state == NULL)
+			checksum_state = makeS3ChecksumState(task->typeSpecific.writePGFile.chkpNum,
+												 get_worker_file_checksums(),
+												 WORKERS_FILE_CHECKSUMS_MAX_LEN,
+												 FILE_CHECKSUMS_FILENAME);
 
-		data = read_file(filename, &size);
+		Assert(checksum_state->checkpointNumber == task->typeSpecific.writePGFile.chkpNum);
 
-		if (data != NULL)
+		if (s3_file_chunk_size > 0 && stat(filename, &st) == 0 &&
+			(uint64) st.st_size > (uint64) s3_file_chunk_size * 1024 * 1024)
 		{
-			S3FileChecksum *entry;
-
-			pg_atomic_test_set_flag(&workers_ctl->workersInProgress[worker_num]);
+			uint64		chunkSize = (uint64) s3_file_chunk_size * 1024 * 1024;
+			uint64		offset;
+			int			chunkNum = 0;
 
-			if (checksum_state == NULL)
-				checksum_state = makeS3ChecksumState(task->typeSpecific.writePGFile.chkpNum,
-													 get_worker_file_checksums(),
-													 WORKERS_FILE_CHECKSUMS_MAX_LEN,
-													 FILE_CHECKSUMS_FILENAME);
-
-			Assert(checksum_state->checkpointNumber == task->typeSpecific.writePGFile.chkpNum);
+			/*
+			 * Put only the changed chunks of the big file.  The unchanged
+			 * ones are referenced by the checksum file from the earlier
+			 * checkpoints, the loader concatenates them back.
+			 */
+			for (offset = 0; offset < (uint64) st.st_size; offset += chunkSize)
+			{
+				char	   *chunkname;
+				Pointer		data;
+				uint64		size;
+
+				data = read_file_part(filename, offset, chunkSize, &size);
+				if (data == NULL)
+					break;
+				if (size == 0)
+				{
+					pfree(data);
+					break;
+				}
 
-			if (checksum_state->fileChecksumsLen == WORKERS_FILE_CHECKSUMS_MAX_LEN)
-				flush_worker_checksum_state();
+				chunkname = psprintf("%s" S3_FILE_CHUNKS_SUFFIX "/%d",
+									 filename, chunkNum);
+				s3_put_pg_file_data(task->typeSpecific.writePGFile.chkpNum,
+									chunkname, data, size);
+				bytesDone += size;
 
-			entry = getS3FileChecksum(checksum_state, filename, data, size);
+				pfree(chunkname);
+				pfree(data);
+				chunkNum++;
+			}
+		}
+		else
+		{
+			Pointer		data;
+			uint64		size;
 
-			if (entry->changed)
-				(void) s3_put_object_with_contents(objectname, data, size,
-												   entry->checksum, false);
+			data = read_file(filename, &size);
 
-			pfree(data);
+			if (data != NULL)
+			{
+				s3_put_pg_file_data(task->typeSpecific.writePGFile.chkpNum,
+									filename, data, size);
+				bytesDone = size;
+				pfree(data);
+			}
 		}
 
-		pfree(objectname);
+		pg_atomic_fetch_add_u64(&workers_ctl->backupBytesDone, bytesDone);
+		pg_atomic_fetch_add_u64(&workers_ctl->backupFilesDone, 1);
 
 		/* Mark this task as processed */
 		pg_atomic_fetch_sub_u32(&workers_ctl->fileChecksumsCnt, 1);
@@ -572,6 +746,47 @@ s3process_task(uint64 taskLocation)
 	s3_queue_erase_task(taskLocation);
 }
 
+/*
+ * Wake up one of the workers sleeping on the empty queue, if any.  The busy
+ * workers pick the new task anyway, once they are done with the current ones.
+ */
+static void
+s3_workers_wakeup(void)
+{
+	int			i,
+				start = MyProcPid % s3_num_workers;
+
+	/* Make the new task visible before checking the sleeping flags */
+	pg_memory_barrier();
+
+	for (i = 0; i < s3_num_workers; i++)
+	{
+		S3WorkerWakeup *wakeup = &workers_wakeups[(start + i) % s3_num_workers];
+
+		if (pg_atomic_read_u32(&wakeup->sleeping) != 0 &&
+			pg_atomic_exchange_u32(&wakeup->sleeping, 0) != 0)
+		{
+			SetLatch(wakeup->latch);
+			return;
+		}
+	}
+}
+
+/*
+ * Put the task to the queue and wake up a worker to process it.
+ */
+static S3TaskLocation
+s3_put_task(Pointer data, uint32 len, S3TaskPriority priority)
+{
+	S3TaskLocation location;
+
+	((S3Task *) data)->queuedAt = GetCurrentTimestamp();
+	location = s3_queue_put_task(data, len, priority);
+	s3_workers_wakeup();
+
+	return location;
+}
+
 /*
  * Schedule a synchronization of given data file to S3.
  */
@@ -591,7 +806,7 @@ s3_schedule_file_write(uint32 chkpNum, char *filename, bool delete)
 	task->typeSpecific.writeFile.delete = delete;
 	memcpy(task->typeSpecific.writeFile.filename, filename, filenameLen + 1);
 
-	location = s3_queue_put_task((Pointer) task, taskLen);
+	location = s3_put_task((Pointer) task, taskLen, S3TaskPriorityCheckpoint);
 
 	elog(DEBUG1, "S3 schedule file write: %s %u %u (%llu)",
 		 filename, chkpNum, delete ? 1 : 0, (unsigned long long) location);
@@ -620,7 +835,7 @@ s3_schedule_empty_dir_write(uint32 chkpNum, char *dirname)
 	task->typeSpecific.writeEmptyDir.chkpNum = chkpNum;
 	memcpy(task->typeSpecific.writeEmptyDir.dirname, dirname, dirnameLen + 1);
 
-	location = s3_queue_put_task((Pointer) task, taskLen);
+	location = s3_put_task((Pointer) task, taskLen, S3TaskPriorityCheckpoint);
 
 	elog(DEBUG1, "S3 schedule empty dir write: %s %u (%llu)",
 		 dirname, chkpNum, (unsigned long long) location);
@@ -652,7 +867,8 @@ s3_schedule_file_part_write(uint32 chkpNum, Oid datoid, Oid relnode,
 	task->typeSpecific.filePart.segNum = segNum;
 	task->typeSpecific.filePart.partNum = partNum;
 
-	location = s3_queue_put_task((Pointer) task, sizeof(S3Task));
+	location = s3_put_task((Pointer) task, sizeof(S3Task),
+						   S3TaskPriorityCheckpoint);
 
 	elog(DEBUG1, "S3 schedule file part write: %u %u %u %d %d (%llu)",
 		 datoid, relnode, chkpNum, segNum, partNum, (unsigned long long) location);
@@ -663,11 +879,14 @@ s3_schedule_file_part_write(uint32 chkpNum, Oid datoid, Oid relnode,
 }
 
 /*
- * Schedule the read of given data file part from S3.
+ * Schedule the read of given data file part from S3 with given priority.
+ * Returns zero if the part is already loaded or being loaded.  In the latter
+ * case, *loading is set if given.
  */
-S3TaskLocation
-s3_schedule_file_part_read(uint32 chkpNum, Oid datoid, Oid relnode,
-						   int32 segNum, int32 partNum)
+static S3TaskLocation
+s3_schedule_file_part_read_extended(uint32 chkpNum, Oid datoid, Oid relnode,
+									int32 segNum, int32 partNum,
+									S3TaskPriority priority, bool *loading)
 {
 	S3Task	   *task;
 	S3TaskLocation location;
@@ -683,16 +902,14 @@ s3_schedule_file_part_read(uint32 chkpNum, Oid datoid, Oid relnode,
 	pfree(db_prefix);
 
 	status = s3_header_mark_part_loading(tag, partNum);
-	if (status == S3PartStatusLoading)
+	if (loading)
+		*loading = (status == S3PartStatusLoading);
+	if (status == S3PartStatusLoading || status == S3PartStatusLoaded)
 	{
 		/*
-		 * The task is already scheduled.  We don't know the location, but we
-		 * know it's lower than current insert location.
+		 * The task is already scheduled, possibly to the other lane.  So, its
+		 * location isn't a reliable thing to wait for.
 		 */
-		return s3_queue_get_insert_location();
-	}
-	else if (status == S3PartStatusLoaded)
-	{
 		return 0;
 	}
 	Assert(status == S3PartStatusNotLoaded);
@@ -705,7 +922,7 @@ s3_schedule_file_part_read(uint32 chkpNum, Oid datoid, Oid relnode,
 	task->typeSpecific.filePart.segNum = segNum;
 	task->typeSpecific.filePart.partNum = partNum;
 
-	location = s3_queue_put_task((Pointer) task, sizeof(S3Task));
+	location = s3_put_task((Pointer) task, sizeof(S3Task), priority);
 
 	elog(DEBUG1, "S3 schedule file part read: %u %u %u %d %d (%llu)",
 		 datoid, relnode, chkpNum, segNum, partNum, (unsigned long long) location);
@@ -715,6 +932,15 @@ s3_schedule_file_part_read(uint32 chkpNum, Oid datoid, Oid relnode,
 	return location;
 }
 
+S3TaskLocation
+s3_schedule_file_part_read(uint32 chkpNum, Oid datoid, Oid relnode,
+						   int32 segNum, int32 partNum, S3TaskPriority priority)
+{
+	return s3_schedule_file_part_read_extended(chkpNum, datoid, relnode,
+											   segNum, partNum, priority,
+											   NULL);
+}
+
 /*
  * Schedule a synchronization of given WAL file to S3.
  */
@@ -732,7 +958,7 @@ s3_schedule_wal_file_write(char *filename)
 	task->type = S3TaskTypeWriteWALFile;
 	memcpy(task->typeSpecific.walFilename, filename, filenameLen + 1);
 
-	location = s3_queue_put_task((Pointer) task, taskLen);
+	location = s3_put_task((Pointer) task, taskLen, S3TaskPriorityWAL);
 
 	elog(DEBUG1, "S3 schedule WAL file write: %s (%llu)",
 		 filename, (unsigned long long) location);
@@ -756,7 +982,8 @@ s3_schedule_undo_file_write(UndoLogType undoType, uint64 fileNum)
 	task->typeSpecific.writeUndoFile.undoType = undoType;
 	task->typeSpecific.writeUndoFile.fileNum = fileNum;
 
-	location = s3_queue_put_task((Pointer) task, sizeof(S3Task));
+	location = s3_put_task((Pointer) task, sizeof(S3Task),
+						   S3TaskPriorityCheckpoint);
 
 	elog(DEBUG1, "S3 schedule UNDO file write: %llu (%llu)",
 		 (unsigned long long) fileNum, (unsigned long long) location);
@@ -804,7 +1031,8 @@ s3_schedule_downlink_load(BTreeDescr *desc, uint64 downlink)
 		partNum = (byte_offset % ORIOLEDB_SEGMENT_SIZE) / ORIOLEDB_S3_PART_SIZE;
 		location = s3_schedule_file_part_read(chkpNum,
 											  desc->oids.datoid, desc->oids.relnode,
-											  segNum, partNum);
+											  segNum, partNum,
+											  S3TaskPriorityPrefetch);
 		result = Max(result, location);
 		if (byte_offset % ORIOLEDB_S3_PART_SIZE + read_size > ORIOLEDB_S3_PART_SIZE)
 		{
@@ -840,7 +1068,7 @@ s3_schedule_root_file_write(char *filename, bool delete)
 	task->typeSpecific.writeRootFile.delete = delete;
 	memcpy(task->typeSpecific.writeRootFile.filename, filename, filenameLen + 1);
 
-	location = s3_queue_put_task((Pointer) task, taskLen);
+	location = s3_put_task((Pointer) task, taskLen, S3TaskPriorityCheckpoint);
 
 	elog(DEBUG1, "S3 schedule root file write: %s %u (%llu)",
 		 filename, delete ? 1 : 0, (unsigned long long) location);
@@ -870,7 +1098,7 @@ s3_schedule_pg_file_write(uint32 chkpNum, char *filename)
 	task->typeSpecific.writePGFile.chkpNum = chkpNum;
 	memcpy(task->typeSpecific.writePGFile.filename, filename, filenameLen + 1);
 
-	location = s3_queue_put_task((Pointer) task, taskLen);
+	location = s3_put_task((Pointer) task, taskLen, S3TaskPriorityCheckpoint);
 
 	elog(DEBUG1, "S3 schedule PGDATA file write: %s %u (%llu)",
 		 filename, chkpNum, (unsigned long long) location);
@@ -882,14 +1110,29 @@ s3_schedule_pg_file_write(uint32 chkpNum, char *filename)
 	return location;
 }
 
+/*
+ * Load given data file part from S3 and wait for the load to finish.  The
+ * load of the part, which is being loaded by somebody else, is waited by
+ * polling of its status, because it might be scheduled as a prefetch.
+ */
 void
 s3_load_file_part(uint32 chkpNum, Oid datoid, Oid relnode,
 				  int32 segNum, int32 partNum)
 {
 	S3TaskLocation location;
+	bool		loading;
 
-	location = s3_schedule_file_part_read(chkpNum, datoid, relnode,
-										  segNum, partNum);
+	while (true)
+	{
+		location = s3_schedule_file_part_read_extended(chkpNum, datoid,
+													   relnode, segNum,
+													   partNum,
+													   S3TaskPriorityRead,
+													   &loading);
+		if (!loading)
+			break;
+		pg_usleep(10000L);
+	}
 
 	s3_queue_wait_for_location(location);
 }
@@ -897,12 +1140,7 @@ s3_load_file_part(uint32 chkpNum, Oid datoid, Oid relnode,
 void
 s3_load_map_file(uint32 chkpNum, Oid datoid, Oid relnode)
 {
-	S3TaskLocation location;
-
-	location = s3_schedule_file_part_read(chkpNum, datoid, relnode,
-										  -1, 0);
-
-	s3_queue_wait_for_location(location);
+	s3_load_file_part(chkpNum, datoid, relnode, -1, 0);
 }
 
 void
@@ -942,6 +1180,7 @@ s3worker_main(Datum main_arg)
 												  ALLOCSET_DEFAULT_SIZES);
 
 	ResetLatch(MyLatch);
+	workers_wakeups[worker_num].latch = MyLatch;
 
 	PG_TRY();
 	{
@@ -959,6 +1198,7 @@ s3worker_main(Datum main_arg)
 
 		while (true)
 		{
+			S3WorkerWakeup *wakeup = &workers_wakeups[worker_num];
 			uint64		taskLocation;
 
 			if (ShutdownRequestPending)
@@ -966,10 +1206,18 @@ s3worker_main(Datum main_arg)
 
 			/*
 			 * Sleep until we are signaled or it's time to check the queue.
+			 * Announce the sleep before checking the queue, so the wakeup by
+			 * the task producer isn't missed.
 			 */
-			rc = WaitLatch(MyLatch, wake_events,
-						   BgWriterDelay,
-						   WAIT_EVENT_BGWRITER_MAIN);
+			pg_atomic_write_u32(&wakeup->sleeping, 1);
+			pg_memory_barrier();
+			rc = 0;
+			if (!s3_queue_has_ready_task())
+				rc = WaitLatch(MyLatch, wake_events,
+							   BgWriterDelay,
+							   WAIT_EVENT_BGWRITER_MAIN);
+			pg_atomic_write_u32(&wakeup->sleeping, 0);
+			ResetLatch(MyLatch);
 
 			if (rc & WL_POSTMASTER_DEATH)
 				ShutdownRequestPending = true;
@@ -1002,8 +1250,6 @@ s3worker_main(Datum main_arg)
 				pg_atomic_clear_flag(&workers_ctl->workersInProgress[worker_num]);
 				ConditionVariableBroadcast(&workers_ctl->fileChecksumsFlushedCV);
 			}
-
-			ResetLatch(MyLatch);
 		}
 		elog(LOG, "orioledb s3 worker %d is shut down", worker_num);
 	}
@@ -25,8 +25,9 @@
 #include "access/table.h"
 #include "catalog/pg_type.h"
 #include "executor/nodeIndexscan.h"
-#include "lib/rbtree.h"
 #include "nodes/execnodes.h"
+#include "pgstat.h"
+#include "storage/spin.h"
 #include "utils/memutils.h"
 
 #include <math.h>
@@ -37,7 +38,7 @@ typedef struct OBitmapScan
 	ScanState  *ss;
 	OSnapshot	oSnapshot;
 	MemoryContext cxt;
-	RBTree	   *saved_bitmap;
+	OKeyBitmap *saved_bitmap;
 	Oid			typeoid;
 	BTreeSeqScan *seq_scan;
 } OBitmapScan;
@@ -160,7 +161,7 @@ primary_tuple_get_data(OTuple tuple, OIndexDescr *primary, bool onlyPkey)
 
 static double
 o_index_getbitmap(OBitmapHeapPlanState *bitmap_state,
-				  BitmapIndexScanState *node, RBTree *bitmap)
+				  BitmapIndexScanState *node, OKeyBitmap *bitmap)
 {
 	OScanState	ostate = {0};
 	OTableDescr *descr;
@@ -269,10 +270,10 @@ o_index_getbitmap(OBitmapHeapPlanState *bitmap_state,
 	return nTuples;
 }
 
-static RBTree *
+static OKeyBitmap *
 o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 {
-	RBTree	   *result = NULL;
+	OKeyBitmap *result = NULL;
 
 	switch (nodeTag(planstate))
 	{
@@ -288,8 +289,8 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 				for (i = 0; i < node->nplans; i++)
 				{
 					PlanState  *subnode = node->bitmapplans[i];
-					RBTree	   *subresult = o_exec_bitmapqual(bitmap_state,
-															  subnode);
+					OKeyBitmap *subresult = o_exec_bitmapqual(bitmap_state,
+															   subnode);
 
 					if (result == NULL)
 						result = subresult; /* first subplan */
@@ -326,7 +327,7 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 				for (i = 0; i < node->nplans; i++)
 				{
 					PlanState  *subnode = node->bitmapplans[i];
-					RBTree	   *subresult;
+					OKeyBitmap *subresult;
 
 					if (IsA(subnode, BitmapIndexScanState))
 					{
@@ -410,9 +411,17 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 					OIndexDescr *bridge = bitmap_state->scan->tbl_desc->bridge;
 					CommitSeqNo tupleCsn;
 					ItemPointerData iptr;
+					BTreeKeysLookup *lookup;
 
 					nTuples = (double) index_getbitmap(node->biss_ScanDesc, bridged_bitmap);
 
+					/*
+					 * The bitmap returns the bridge ctids in ascending order,
+					 * so each next one is searched from the bridge leaf of
+					 * the previous one.
+					 */
+					o_btree_load_shmem(&bridge->desc);
+					lookup = o_btree_keys_lookup_create();
 					tbmiterator = tbm_begin_iterate(bridged_bitmap);
 
 					while ((tbmres = tbm_iterate(tbmiterator)) != NULL)
@@ -433,9 +442,8 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 							bridge_bound.n_row_keys = 0;
 							bridge_bound.row_keys = NULL;
 
-							o_btree_load_shmem(&bridge->desc);
-
-							bridge_tup = o_btree_find_tuple_by_key(&bridge->desc,
+							bridge_tup = o_btree_keys_lookup_fetch(lookup,
+																   &bridge->desc,
 																   (Pointer) &bridge_bound, BTreeKeyBound,
 																   &o_in_progress_snapshot, &tupleCsn,
 																   CurrentMemoryContext, NULL);
@@ -451,6 +459,7 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 
 					tbm_end_iterate(tbmiterator);
 					tbm_free(bridged_bitmap);
+					o_btree_keys_lookup_free(lookup);
 				}
 				else
 				{
@@ -469,6 +478,58 @@ o_exec_bitmapqual(OBitmapHeapPlanState *bitmap_state, PlanState *planstate)
 	return result;
 }
 
+void
+o_parallel_bitmap_scan_initialize(OParallelBitmapScanData *pstate,
+								  Relation rel)
+{
+	SpinLockInit(&pstate->mutex);
+	pstate->status = OParallelBitmapInitial;
+	ConditionVariableInit(&pstate->cv);
+	pstate->bitmap = InvalidDsaPointer;
+	(void) orioledb_parallelscan_initialize(rel,
+											(ParallelTableScanDesc) &pstate->poscan);
+}
+
+void
+o_parallel_bitmap_scan_reinitialize(OParallelBitmapScanData *pstate,
+									Relation rel, dsa_area *dsa)
+{
+	if (DsaPointerIsValid(pstate->bitmap))
+		dsa_free(dsa, pstate->bitmap);
+	pstate->bitmap = InvalidDsaPointer;
+	pstate->status = OParallelBitmapInitial;
+	orioledb_parallelscan_reinitialize(rel,
+									   (ParallelTableScanDesc) &pstate->poscan);
+}
+
+/*
+ * Returns true if the caller should build the shared key bitmap.  Otherwise,
+ * waits till the bitmap is built by another participant.  Modified copy of
+ * BitmapShouldInitializeSharedState().
+ */
+static bool
+o_parallel_bitmap_should_build(OParallelBitmapScanData *pstate)
+{
+	OParallelBitmapStatus status;
+
+	while (true)
+	{
+		SpinLockAcquire(&pstate->mutex);
+		status = pstate->status;
+		if (status == OParallelBitmapInitial)
+			pstate->status = OParallelBitmapInProgress;
+		SpinLockRelease(&pstate->mutex);
+
+		if (status != OParallelBitmapInProgress)
+			break;
+
+		ConditionVariableSleep(&pstate->cv, WAIT_EVENT_PARALLEL_BITMAP_SCAN);
+	}
+	ConditionVariableCancelSleep();
+
+	return status == OParallelBitmapInitial;
+}
+
 OBitmapScan *
 o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state, ScanState *ss,
 				   PlanState *bitmapqualplanstate, Relation rel,
@@ -476,6 +537,8 @@ o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state, ScanState *ss,
 				   MemoryContext cxt)
 {
 	OBitmapScan *scan = palloc0(sizeof(OBitmapScan));
+	OParallelBitmapScanData *pstate = bitmap_state->pstate;
+	ParallelOScanDesc poscan = NULL;
 
 	scan->typeoid = typeoid;
 	scan->oSnapshot = *oSnapshot;
@@ -483,10 +546,50 @@ o_make_bitmap_scan(OBitmapHeapPlanState *bitmap_state, ScanState *ss,
 	scan->ss = ss;
 	scan->tbl_desc = relation_get_descr(rel);
 	bitmap_state->scan = scan;
-	scan->saved_bitmap = o_exec_bitmapqual(bitmap_state, bitmapqualplanstate);
+
+	if (pstate)
+	{
+		dsa_area   *dsa = ss->ps.state->es_query_dsa;
+
+		if (dsa == NULL)
+			elog(ERROR, "parallel bitmap scan requires the query DSA area");
+
+		if (o_parallel_bitmap_should_build(pstate))
+		{
+			OKeyBitmap *bitmap;
+			dsa_pointer dp;
+
+			bitmap = o_exec_bitmapqual(bitmap_state, bitmapqualplanstate);
+			dp = dsa_allocate(dsa, o_keybitmap_serialized_size(bitmap));
+			o_keybitmap_serialize(bitmap, dsa_get_address(dsa, dp));
+			o_keybitmap_free(bitmap);
+
+			SpinLockAcquire(&pstate->mutex);
+			pstate->bitmap = dp;
+			pstate->status = OParallelBitmapFinished;
+			SpinLockRelease(&pstate->mutex);
+			ConditionVariableBroadcast(&pstate->cv);
+		}
+
+		scan->saved_bitmap = o_keybitmap_attach(dsa_get_address(dsa,
+																pstate->bitmap));
+		poscan = &pstate->poscan;
+	}
+	else
+	{
+		scan->saved_bitmap = o_exec_bitmapqual(bitmap_state,
+											   bitmapqualplanstate);
+	}
+
+	/*
+	 * The parallel scan distributes the downlinks of the primary tree between
+	 * the participants.  The callbacks skip the key ranges missing in the
+	 * bitmap in each of them.
+	 */
 	scan->seq_scan = make_btree_seq_scan_cb(&GET_PRIMARY(scan->tbl_desc)->desc,
 											&scan->oSnapshot,
-											&bitmap_seq_scan_callbacks, scan);
+											&bitmap_seq_scan_callbacks, scan,
+											poscan);
 	return scan;
 }
 
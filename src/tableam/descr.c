@@ -25,20 +25,25 @@
 #include "catalog/o_tables.h"
 #include "catalog/sys_trees.h"
 #include "recovery/recovery.h"
+#include "tableam/root_info_cache.h"
 #include "tableam/toast.h"
 #include "tableam/tree.h"
 #include "tuple/slot.h"
 #include "transam/undo.h"
+#include "utils/o_memory.h"
 #include "utils/page_pool.h"
 #include "utils/stopevent.h"
 
 #include "access/nbtree.h"
+#include "catalog/pg_collation.h"
 #include "catalog/pg_opfamily.h"
+#include "catalog/pg_type.h"
 #include "common/hashfn.h"
 #include "executor/functions.h"
 #include "funcapi.h"
 #include "miscadmin.h"
 #include "parser/parse_coerce.h"
+#include "port/pg_bswap.h"
 #include "utils/builtins.h"
 #include "utils/fmgrtab.h"
 #include "utils/lsyscache.h"
@@ -55,7 +60,7 @@ typedef struct
 } InvalidateComparatorUndoStackItem;
 
 static OIndexDescr *get_index_descr(ORelOids ixOids, OIndexType ixType,
-									bool miss_ok);
+									bool miss_ok, OTable *table);
 static void o_table_descr_fill_indices(OTableDescr *descr, OTable *table);
 static void init_shared_root_info(OPagePool *pool,
 								  SharedRootInfo *sharedRootInfo);
@@ -70,28 +75,6 @@ PG_FUNCTION_INFO_V1(orioledb_get_table_descrs);
 PG_FUNCTION_INFO_V1(orioledb_get_index_descrs);
 PG_FUNCTION_INFO_V1(orioledb_get_evicted_trees);
 
-struct OComparatorKey
-{
-	Oid			opfamily;
-	Oid			lefttype;
-	Oid			righttype;
-	Oid			collation;
-};
-
-struct OComparator
-{
-	OComparatorKey key;
-	bool		haveSortSupport;
-
-	/* Filled when haveSortSupport == false */
-	FmgrInfo	finfo;
-
-	/* Filled when haveSortSupport == true */
-	MemoryContext ssup_cxt;
-	void	   *ssup_extra;
-	int			(*ssup_comparator) (Datum x, Datum y, SortSupport ssup);
-};
-
 static HTAB *oTableDescrHash;
 static HTAB *oIndexDescrHash;
 static HTAB *comparatorCache;
@@ -100,6 +83,8 @@ static OComparator *lastcmp = NULL;
 static MemoryContext descrCxt = NULL;
 
 static void o_find_toastable_attrs(OTableDescr *tableDescr);
+static void o_comparator_set_prefix_comparable(OComparator *comparator);
+static void o_comparator_set_kind(OComparator *comparator);
 
 
 /*
@@ -576,6 +561,9 @@ table_descr_free(OTableDescr *descr)
 		ExecDropSingleTupleTableSlot(descr->newTuple);
 	if (descr->tupdesc)
 		FreeTupleDesc(descr->tupdesc);
+	bms_free(descr->updatedAttrs);
+	if (descr->updatedRowid)
+		pfree(descr->updatedRowid);
 }
 
 
@@ -606,6 +594,9 @@ o_free_tmp_table_descr(OTableDescr *descr)
 		ExecDropSingleTupleTableSlot(descr->newTuple);
 	if (descr->tupdesc)
 		FreeTupleDesc(descr->tupdesc);
+	bms_free(descr->updatedAttrs);
+	if (descr->updatedRowid)
+		pfree(descr->updatedRowid);
 }
 
 
@@ -793,7 +784,7 @@ o_fetch_index_descr(ORelOids oids, OIndexType type, bool lock, bool *nested)
 	if (lock)
 		o_tables_rel_lock_extended(&oids, AccessShareLock, true);
 
-	index_descr = get_index_descr(oids, type, true);
+	index_descr = get_index_descr(oids, type, true, NULL);
 
 	if (!index_descr && lock)
 	{
@@ -890,11 +881,51 @@ o_invalidate_descrs(Oid datoid, Oid reloid, Oid relfilenode)
 	}
 }
 
+/*
+ * Frees the descriptors, which aren't referenced now.  Descriptors referenced
+ * by the relation cache stay, their memory is freed together with the
+ * relcache entries.
+ */
+void
+o_shed_descrs(void)
+{
+	HASH_SEQ_STATUS scan_status;
+	OTableDescr *tableDescr;
+	OIndexDescr *indexDescr;
+
+	hash_seq_init(&scan_status, oTableDescrHash);
+	while ((tableDescr = (OTableDescr *) hash_seq_search(&scan_status)) != NULL)
+	{
+		if (tableDescr->refcnt == 0)
+			table_descr_delete_from_hash(tableDescr);
+	}
+
+	hash_seq_init(&scan_status, oIndexDescrHash);
+	while ((indexDescr = (OIndexDescr *) hash_seq_search(&scan_status)) != NULL)
+	{
+		if (indexDescr->refcnt == 0)
+			index_descr_delete_from_hash(indexDescr);
+	}
+}
+
 SharedRootInfo *
 o_find_shared_root_info(SharedRootInfoKey *key)
 {
 	OTuple		key_tuple,
 				result_tuple;
+	SharedRootInfo *result;
+	BTreeRootInfo rootInfo;
+	uint64		generation;
+
+	if (root_info_cache_lookup(key, &rootInfo))
+	{
+		result = palloc0(sizeof(SharedRootInfo));
+		result->key = *key;
+		result->rootInfo = rootInfo;
+		result->placeholder = false;
+		return result;
+	}
+	generation = root_info_cache_get_generation();
 
 	key_tuple.data = (Pointer) key;
 	key_tuple.formatFlags = 0;
@@ -904,7 +935,10 @@ o_find_shared_root_info(SharedRootInfoKey *key)
 											 &o_in_progress_snapshot, NULL,
 											 CurrentMemoryContext, NULL);
 
-	return (SharedRootInfo *) result_tuple.data;
+	result = (SharedRootInfo *) result_tuple.data;
+	if (result && !result->placeholder)
+		root_info_cache_insert(key, &result->rootInfo, generation);
+	return result;
 }
 
 void
@@ -947,7 +981,14 @@ cleanup_btree(Oid datoid, Oid relnode, bool files, bool fsync)
 
 		drop_result = o_drop_shared_root_info(datoid, relnode);
 		Assert(drop_result);
-		if (!shared->placeholder)
+
+		/* The background writer might release the pages */
+		if (!shared->placeholder &&
+			!o_btree_cleanup_lazy(datoid, relnode,
+								  shared->rootInfo.rootPageBlkno,
+								  shared->rootInfo.metaPageBlkno,
+								  shared->rootInfo.rootPageChangeCount,
+								  files, fsync))
 			o_btree_cleanup_pages(shared->rootInfo.rootPageBlkno,
 								  shared->rootInfo.metaPageBlkno,
 								  shared->rootInfo.rootPageChangeCount);
@@ -962,18 +1003,34 @@ o_drop_shared_root_info(Oid datoid, Oid relnode)
 {
 	SharedRootInfoKey key;
 	OTuple		key_tuple;
+	bool		result;
 
 	key.datoid = datoid;
 	key.relnode = relnode;
 	key_tuple.data = (Pointer) &key;
 	key_tuple.formatFlags = 0;
 
-	return o_btree_autonomous_delete(get_sys_tree(SYS_TREES_SHARED_ROOT_INFO),
-									 key_tuple, BTreeKeyNonLeafKey, NULL);
+	/*
+	 * The cached root info might be put back by someone, who found it in the
+	 * tree before the deletion.  So invalidate the cache after the deletion
+	 * too.
+	 */
+	root_info_cache_invalidate(&key);
+	result = o_btree_autonomous_delete(get_sys_tree(SYS_TREES_SHARED_ROOT_INFO),
+									   key_tuple, BTreeKeyNonLeafKey, NULL);
+	root_info_cache_invalidate(&key);
+
+	return result;
 }
 
+/*
+ * Finds the index descriptor in the cache, or creates a new one.  The table,
+ * when given by the caller, saves another o_tables_get() for the primary
+ * index descriptor.
+ */
 static OIndexDescr *
-get_index_descr(ORelOids ixOids, OIndexType ixType, bool miss_ok)
+get_index_descr(ORelOids ixOids, OIndexType ixType, bool miss_ok,
+				OTable *table)
 {
 	bool		found;
 	OIndexDescr *result;
@@ -993,7 +1050,7 @@ get_index_descr(ORelOids ixOids, OIndexType ixType, bool miss_ok)
 		return NULL;
 	}
 	mcxt = MemoryContextSwitchTo(descrCxt);
-	o_index_fill_descr(result, oIndex, NULL);
+	o_index_fill_descr(result, oIndex, table);
 	MemoryContextSwitchTo(mcxt);
 	index_btree_desc_init(&result->desc, result->compress, result->fillfactor, result->oids,
 						  oIndex->indexType, oIndex->table_persistence, oIndex->createOxid, result);
@@ -1056,13 +1113,14 @@ o_table_descr_fill_indices(OTableDescr *descr, OTable *table)
 			ixType = table->indices[cur_ix - ctid_idx_off].type;
 		}
 
-		descr->indices[cur_ix] = get_index_descr(ixOids, ixType, false);
+		descr->indices[cur_ix] = get_index_descr(ixOids, ixType, false, table);
 		descr->indices[cur_ix]->refcnt++;
 	}
 
 	if (ORelOidsIsValid(table->bridge_oids))
 	{
-		descr->bridge = get_index_descr(table->bridge_oids, oIndexBridge, false);
+		descr->bridge = get_index_descr(table->bridge_oids, oIndexBridge, false,
+									   table);
 		descr->bridge->refcnt++;
 	}
 	else
@@ -1070,7 +1128,8 @@ o_table_descr_fill_indices(OTableDescr *descr, OTable *table)
 
 	if (ORelOidsIsValid(table->toast_oids))
 	{
-		descr->toast = get_index_descr(table->toast_oids, oIndexToast, false);
+		descr->toast = get_index_descr(table->toast_oids, oIndexToast, false,
+									  table);
 		descr->toast->refcnt++;
 	}
 	else
@@ -1227,6 +1286,8 @@ o_find_comparator(Oid opfamily, Oid lefttype, Oid righttype, Oid collation)
 		}
 		fmgr_info(procOid, &comparator.finfo);
 	}
+	o_comparator_set_prefix_comparable(&comparator);
+	o_comparator_set_kind(&comparator);
 
 	return o_add_comparator_to_cache(&comparator);
 }
@@ -1285,6 +1346,8 @@ o_find_opclass_comparator(OOpclass *opclass, Oid collation)
 			comparator.ssup_cxt = ssup.ssup_cxt;
 			comparator.ssup_extra = ssup.ssup_extra;
 			comparator.ssup_comparator = ssup.comparator;
+			comparator.ssupOid = opclass->ssupOid;
+			comparator.ssupDatoid = opclass->key.common.datoid;
 		}
 	}
 
@@ -1294,10 +1357,98 @@ o_find_opclass_comparator(OOpclass *opclass, Oid collation)
 	if (!comparator.haveSortSupport)
 		o_proc_cache_fill_finfo(&comparator.finfo, opclass->cmpOid);
 	o_unset_syscache_hooks();
+	o_comparator_set_prefix_comparable(&comparator);
+	o_comparator_set_kind(&comparator);
 
 	return o_add_comparator_to_cache(&comparator);
 }
 
+/*
+ * Checks if comparator values are ordered as memcmp() of their contents.
+ * That is true for bytea, for text with pattern opclass and for text in "C"
+ * collation.  We don't try to lookup the collation properties: that
+ * requires catalog access, which isn't always available here.
+ */
+static void
+o_comparator_set_prefix_comparable(OComparator *comparator)
+{
+	OComparatorKey *key = &comparator->key;
+
+	comparator->prefixComparable = false;
+
+	if (key->lefttype != key->righttype)
+		return;
+
+	if (key->lefttype == BYTEAOID && key->opfamily == BYTEA_BTREE_FAM_OID)
+		comparator->prefixComparable = true;
+	else if (key->lefttype == TEXTOID &&
+			 (key->opfamily == TEXT_PATTERN_BTREE_FAM_OID ||
+			  (key->opfamily == TEXT_BTREE_FAM_OID &&
+			   (key->collation == C_COLLATION_OID ||
+				key->collation == POSIX_COLLATION_OID))))
+		comparator->prefixComparable = true;
+}
+
+/*
+ * Finds if o_call_comparator() can compare the values inline.  The sort
+ * support functions of int4, date, int8, timestamp and others give the
+ * comparators of the plain datums exported by tuplesort, so the inline
+ * comparison gives the same results.  uuid_ops compares the uuids with
+ * memcmp().
+ */
+static void
+o_comparator_set_kind(OComparator *comparator)
+{
+	OComparatorKey *key = &comparator->key;
+
+	comparator->kind = OComparatorGeneric;
+
+	if (key->lefttype != key->righttype || comparator->prefixComparable)
+		return;
+
+	if (comparator->haveSortSupport &&
+		comparator->ssup_comparator == ssup_datum_int32_cmp)
+		comparator->kind = OComparatorInt32;
+#if SIZEOF_DATUM >= 8
+	else if (comparator->haveSortSupport &&
+			 comparator->ssup_comparator == ssup_datum_signed_cmp)
+		comparator->kind = OComparatorInt64;
+#endif
+	else if (key->lefttype == UUIDOID &&
+			 key->opfamily == O_UUID_BTREE_FAM_OID)
+		comparator->kind = OComparatorUuid;
+}
+
+/*
+ * Compares normalized prefixes of two varlenas: first bytes of their contents
+ * padded by zeros and loaded as big-endian integer.  Returns zero when the
+ * prefixes are equal, and the full comparison is needed.
+ */
+static inline int
+o_varlena_prefix_cmp(Datum left, Datum right)
+{
+	Pointer		l = DatumGetPointer(left),
+				r = DatumGetPointer(right);
+	uint64		lprefix = 0,
+				rprefix = 0;
+
+	/* Compressed or external values need to be detoasted first */
+	if ((VARATT_IS_EXTENDED(l) && !VARATT_IS_SHORT(l)) ||
+		(VARATT_IS_EXTENDED(r) && !VARATT_IS_SHORT(r)))
+		return 0;
+
+	memcpy(&lprefix, VARDATA_ANY(l), Min(VARSIZE_ANY_EXHDR(l), sizeof(uint64)));
+	memcpy(&rprefix, VARDATA_ANY(r), Min(VARSIZE_ANY_EXHDR(r), sizeof(uint64)));
+	lprefix = pg_ntoh64(lprefix);
+	rprefix = pg_ntoh64(rprefix);
+
+	if (lprefix < rprefix)
+		return -1;
+	else if (lprefix > rprefix)
+		return 1;
+	return 0;
+}
+
 /*
  * Tries to find a comparator in the cache.
  */
@@ -1408,10 +1559,17 @@ o_add_invalidate_comparator_undo_item(Oid opfamily, Oid lefttype, Oid righttype)
 }
 
 int
-o_call_comparator(OComparator *comparator, Datum left, Datum right)
+o_call_comparator_generic(OComparator *comparator, Datum left, Datum right)
 {
 	int			ret;
 
+	if (comparator->prefixComparable)
+	{
+		ret = o_varlena_prefix_cmp(left, right);
+		if (ret != 0)
+			return ret;
+	}
+
 	if (comparator->haveSortSupport)
 	{
 		SortSupportData ssup;
@@ -1477,10 +1635,32 @@ comparison_shim(Datum x, Datum y, SortSupport ssup)
 	return result;
 }
 
+/*
+ * Fills the comparator of 'ssup'.  If 'ssup->abbreviate' is set, the opclass
+ * sort support function is called on 'ssup' to set up the abbreviated keys.
+ * The state of the abbreviation is allocated in 'ssup->ssup_cxt', so it
+ * isn't shared with the cached comparator.
+ */
 void
 o_finish_sort_support_function(OComparator *comparator, SortSupport ssup)
 {
 	Assert(comparator);
+	if (comparator->haveSortSupport && ssup->abbreviate &&
+		OidIsValid(comparator->ssupOid) &&
+		MyDatabaseId == comparator->ssupDatoid)
+	{
+		FmgrInfo	finfo;
+
+		memset(&finfo, 0, sizeof(FmgrInfo));
+		o_set_syscache_hooks();
+		o_proc_cache_fill_finfo(&finfo, comparator->ssupOid);
+		FunctionCall1(&finfo, PointerGetDatum(ssup));
+		o_unset_syscache_hooks();
+		if (ssup->comparator != NULL)
+			return;
+	}
+
+	ssup->abbreviate = false;
 	if (comparator->haveSortSupport)
 	{
 		ssup->comparator = comparator->ssup_comparator;
@@ -1511,9 +1691,10 @@ o_tableam_descr_init(void)
 {
 	HASHCTL		ctl;
 
-	descrCxt = AllocSetContextCreate(TopMemoryContext,
+	descrCxt = AllocSetContextCreate(OrioleDBTopMemoryContext,
 									 "OrioleDB descriptors",
 									 ALLOCSET_DEFAULT_SIZES);
+	o_memory_register(OMemoryDescriptors, descrCxt);
 
 	MemSet(&ctl, 0, sizeof(ctl));
 	ctl.keysize = sizeof(ORelOids);
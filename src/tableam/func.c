@@ -1394,7 +1394,8 @@ index_description(StringInfo buf, OIndexDescr *ct, bool primary, bool oids)
 	appendStringInfo(buf, "    Index type: %s", primary ? "primary" : "secondary");
 	appendStringInfo(buf, "%s", ct->unique ? ", unique" : "");
 	if (OCompressIsValid(ct->compress))
-		appendStringInfo(buf, ", compression = %d", ct->compress);
+		appendStringInfo(buf, ", compression = %s",
+						 o_compress_to_cstring(ct->compress));
 	appendStringInfo(buf, "%s\n", primary && ct->primaryIsCtid ? ", ctid" : "");
 	if (ct->predicate)
 		appendStringInfo(buf, "    Predicate: %s\n", ct->predicate_str);
@@ -37,6 +37,7 @@
 #include "utils/compress.h"
 #include "utils/rel.h"
 #include "utils/stopevent.h"
+#include "utils/zone_map.h"
 
 #include "access/heapam.h"
 #include "access/heaptoast.h"
@@ -73,12 +74,50 @@
 
 bool		in_nontransactional_truncate = false;
 
+/* Maximum number of tuples fetched from the sequential scan at once */
+#define O_SCAN_BATCH_SIZE	64
+
+/*
+ * Scan keys evaluated against the tuples located in the leaf pages.  See
+ * o_scan_init_filter().
+ */
+typedef struct OScanFilter
+{
+	TupleDesc	tupdesc;
+	OTupleFixedFormatSpec *spec;
+	int			nkeys;
+	ScanKey		keys;
+	AttrNumber *attnums;		/* attribute numbers in the leaf tuple */
+	/* the scan node, which counts the rejected tuples as filtered out */
+	PlanState  *planstate;
+} OScanFilter;
+
 typedef struct OScanDescData
 {
 	TableScanDescData rs_base;	/* AM independent part of the descriptor */
 	BTreeSeqScan *scan;
 	OSnapshot	o_snapshot;
 	ItemPointerData iptr;
+
+	/* Tuples fetched from the scan, but not returned yet */
+	OTuple		batchTuples[O_SCAN_BATCH_SIZE];
+	CommitSeqNo batchCsns[O_SCAN_BATCH_SIZE];
+	BTreeLocationHint batchHints[O_SCAN_BATCH_SIZE];
+	/* false for the tuples pointing into the leaf image of the scan */
+	bool		batchAllocated[O_SCAN_BATCH_SIZE];
+	int			batchCount;
+	int			batchIndex;
+	/* Slots, which were given the not allocated tuples of the batch */
+	TupleTableSlot *refSlots[O_SCAN_BATCH_SIZE];
+	Pointer		refTuples[O_SCAN_BATCH_SIZE];
+	int			nrefs;
+	/* context of the fetched tuples, see o_scan_tuples_context_create() */
+	MemoryContext tupleCxt;
+
+	/* Scan keys pushed to the B-tree scan and the rest of them */
+	OScanFilter filter;
+	int			nrestKeys;
+	ScanKey		restKeys;
 } OScanDescData;
 typedef OScanDescData *OScanDesc;
 
@@ -130,6 +169,8 @@ orioledb_index_fetch_begin(Relation rel)
 	/* TODO: Remove this hack */
 	extern Relation o_current_index;
 
+	o_apply_flush_inserts();
+
 	if (o_current_index)
 	{
 		OBTOptions *options = (OBTOptions *) o_current_index->rd_options;
@@ -391,6 +432,31 @@ orioledb_get_row_ref_type(Relation rel)
 	return ROW_REF_ROWID;
 }
 
+/*
+ * Rejects the modification of the table having the orioledb_frozen option,
+ * and any modification while orioledb.as_of_timestamp makes the reads
+ * historical.  Row locks, TRUNCATE and DDL are still allowed for frozen
+ * tables: the option only protects the cold data from accidental writes.
+ */
+static void
+o_check_table_writable(Relation relation)
+{
+	ORelOptions *options = (ORelOptions *) relation->rd_options;
+
+	if (as_of_enabled)
+		ereport(ERROR,
+				(errcode(ERRCODE_READ_ONLY_SQL_TRANSACTION),
+				 errmsg("cannot modify table \"%s\" while orioledb.as_of_timestamp is set",
+						RelationGetRelationName(relation))));
+
+	if (options && options->frozen)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("cannot modify frozen table \"%s\"",
+						RelationGetRelationName(relation)),
+				 errhint("Reset the \"orioledb_frozen\" option of the table first.")));
+}
+
 static TupleTableSlot *
 orioledb_tuple_insert(Relation relation, TupleTableSlot *slot,
 					  CommandId cid, int options, BulkInsertState bistate)
@@ -402,6 +468,11 @@ orioledb_tuple_insert(Relation relation, TupleTableSlot *slot,
 	if (OidIsValid(relation->rd_rel->relrewrite))
 		return slot;
 
+	o_check_table_writable(relation);
+
+	if (o_apply_buffer_insert(relation, slot))
+		return slot;
+
 	descr = relation_get_descr(relation);
 	fill_current_oxid_osnapshot(&oxid, &oSnapshot);
 	return o_tbl_insert(descr, relation, slot, oxid, oSnapshot.csn);
@@ -423,6 +494,8 @@ orioledb_tuple_insert_with_arbiter(ResultRelInfo *rinfo,
 	OTuple		tup;
 	OIndexDescr *id;
 
+	o_check_table_writable(rel);
+
 	descr = relation_get_descr(rel);
 	Assert(descr);
 	id = GET_PRIMARY(descr);
@@ -471,6 +544,10 @@ orioledb_tuple_delete(Relation relation, Datum tupleid, CommandId cid,
 	ASAN_UNPOISON_MEMORY_REGION(tmfd, sizeof(*tmfd));
 	ASAN_UNPOISON_MEMORY_REGION(&mres, sizeof(mres));
 
+	o_check_table_writable(relation);
+
+	o_apply_flush_inserts();
+
 	if (snapshot)
 		O_LOAD_SNAPSHOT(&oSnapshot, snapshot);
 	else
@@ -563,6 +640,10 @@ orioledb_tuple_update(Relation relation, Datum tupleid, TupleTableSlot *slot,
 
 	ASAN_UNPOISON_MEMORY_REGION(tmfd, sizeof(*tmfd));
 
+	o_check_table_writable(relation);
+
+	o_apply_flush_inserts();
+
 	if (snapshot)
 		O_LOAD_SNAPSHOT(&oSnapshot, snapshot);
 	else
@@ -642,6 +723,9 @@ orioledb_tuple_update(Relation relation, Datum tupleid, TupleTableSlot *slot,
 	bms_free(marg.keyAttrs);
 	Assert(mres.success);
 
+	if (mres.oldTuple)
+		o_set_updated_attrs(descr, relation, tupleid, mres.oldTuple, slot);
+
 	return mres.oldTuple ? TM_Ok : (marg.modified ? TM_Updated : TM_Deleted);
 }
 
@@ -658,6 +742,8 @@ orioledb_tuple_lock(Relation rel, Datum tupleid, Snapshot snapshot,
 	OXid		oxid;
 	BTreeLocationHint hint;
 
+	o_apply_flush_inserts();
+
 	descr = relation_get_descr(rel);
 	Assert(descr != NULL);
 
@@ -742,6 +828,8 @@ orioledb_relation_set_new_filenode(Relation rel,
 {
 	SMgrRelation srel;
 
+	o_apply_flush_inserts();
+
 	/* TRUNCATE case */
 	if (rel->rd_rel->oid != 0 &&
 		rel->rd_rel->relkind != RELKIND_TOASTVALUE &&
@@ -1326,6 +1414,16 @@ orioledb_estimate_rel_size(Relation rel, int32 *attr_widths,
 	}
 	*tuples = rint(density * (double) curpages);
 
+	/*
+	 * Index-only scans never fetch the tuples from the primary tree: the
+	 * visibility is checked using the undo of the secondary tree itself.
+	 */
+	if (index_only_scan_all_visible)
+	{
+		*allvisfrac = 1;
+		return;
+	}
+
 	/*
 	 * We use relallvisible as-is, rather than scaling it up like we do for
 	 * the pages and tuples counts, on the theory that any pages added since
@@ -1456,6 +1554,162 @@ orioledb_parallelscan_reinitialize(Relation rel, ParallelTableScanDesc pscan)
 }
 
 
+static inline void
+o_scan_filter_count_rejected(OScanFilter *filter)
+{
+	if (filter->planstate)
+		InstrCountFiltered1(filter->planstate, 1);
+}
+
+static bool
+o_scan_filter_tuple(OTuple tuple, void *arg)
+{
+	OScanFilter *filter = (OScanFilter *) arg;
+	int			natts;
+	int			i;
+
+	if (tuple.formatFlags & O_TUPLE_FLAGS_FIXED_FORMAT)
+		natts = filter->spec->natts;
+	else
+		natts = ((OTupleHeader) tuple.data)->natts;
+
+	for (i = 0; i < filter->nkeys; i++)
+	{
+		ScanKey		key = &filter->keys[i];
+		AttrNumber	attnum = filter->attnums[i];
+		Datum		val;
+		bool		isnull;
+
+		/* The attributes added after the tuple was written are NULLs */
+		if (attnum > natts)
+		{
+			o_scan_filter_count_rejected(filter);
+			return false;
+		}
+
+		val = o_fastgetattr(tuple, attnum, filter->tupdesc, filter->spec,
+							&isnull);
+		if (isnull ||
+			!DatumGetBool(FunctionCall2Coll(&key->sk_func,
+											key->sk_collation,
+											val,
+											key->sk_argument)))
+		{
+			o_scan_filter_count_rejected(filter);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool
+o_scan_filter_disk_leaf(BTreeDescr *desc, uint64 downlink, CommitSeqNo csn,
+						void *arg)
+{
+	OScanFilter *filter = (OScanFilter *) arg;
+
+	return zone_map_leaf_may_match(desc, downlink, csn, filter->tupdesc,
+								   filter->nkeys, filter->keys,
+								   filter->attnums);
+}
+
+static void
+o_scan_disk_leaf_loaded(BTreeDescr *desc, uint64 downlink, Page img,
+						void *arg)
+{
+	OScanFilter *filter = (OScanFilter *) arg;
+
+	zone_map_summarize_leaf(desc, downlink, img, filter->tupdesc,
+							filter->spec, filter->nkeys, filter->attnums);
+}
+
+/*
+ * Splits the scan keys into the ones evaluated by the B-tree scan against
+ * the tuples located in the leaf pages, and the rest of them checked on the
+ * slot.  Only the keys on the fixed-width attributes are pushed, because the
+ * others might need detoasting.
+ */
+static void
+o_scan_init_filter(OScanDesc scan, OTableDescr *descr)
+{
+	OIndexDescr *primary = GET_PRIMARY(descr);
+	int			ctid_off = primary->primaryIsCtid ? 1 : 0;
+	int			i;
+
+	scan->filter.tupdesc = primary->leafTupdesc;
+	scan->filter.spec = &primary->leafSpec;
+	scan->filter.nkeys = 0;
+	scan->nrestKeys = 0;
+
+	for (i = 0; i < scan->rs_base.rs_nkeys; i++)
+	{
+		ScanKey		key = &scan->rs_base.rs_key[i];
+		AttrNumber	attnum = key->sk_attno + ctid_off;
+		Form_pg_attribute attr = NULL;
+
+		if (key->sk_flags == 0 && key->sk_attno > 0 && !primary->bridging &&
+			attnum <= primary->leafTupdesc->natts)
+			attr = TupleDescAttr(primary->leafTupdesc, attnum - 1);
+
+		if (attr && attr->attlen > 0 && !attr->attisdropped &&
+			!attr->atthasmissing)
+		{
+			scan->filter.keys[scan->filter.nkeys] = *key;
+			scan->filter.attnums[scan->filter.nkeys] = attnum;
+			scan->filter.nkeys++;
+		}
+		else
+		{
+			scan->restKeys[scan->nrestKeys++] = *key;
+		}
+	}
+
+	if (scan->filter.nkeys == 0)
+		return;
+
+	btree_seq_scan_set_filter(scan->scan, o_scan_filter_tuple,
+							  &scan->filter);
+
+	/* The zone map needs the keys with the B-tree strategies */
+	for (i = 0; i < scan->filter.nkeys; i++)
+	{
+		if (scan->filter.keys[i].sk_strategy != InvalidStrategy)
+			break;
+	}
+	if (i < scan->filter.nkeys && zone_map_enabled(&primary->desc))
+	{
+		/*
+		 * The leaves skipped by their summaries aren't read, so the
+		 * instrumented scan can't count their tuples as filtered out.  It
+		 * only summarizes the leaves.
+		 */
+		bool		instrumented = scan->filter.planstate &&
+			scan->filter.planstate->instrument;
+
+		btree_seq_scan_set_disk_leaf_filter(scan->scan,
+											instrumented ? NULL : o_scan_filter_disk_leaf,
+											o_scan_disk_leaf_loaded,
+											&scan->filter);
+	}
+}
+
+/*
+ * Makes the scan count the tuples rejected by its keys in the
+ * "Rows Removed by Filter" of the scan node, as if the executor's qual
+ * rejected them.
+ */
+void
+orioledb_scan_set_planstate(TableScanDesc sscan, PlanState *planstate)
+{
+	OScanDesc	scan = (OScanDesc) sscan;
+	OTableDescr *descr = relation_get_descr(scan->rs_base.rs_rd);
+
+	scan->filter.planstate = planstate;
+	if (scan->scan)
+		o_scan_init_filter(scan, descr);
+}
+
 static TableScanDesc
 orioledb_beginscan(Relation relation, Snapshot snapshot,
 				   int nkeys, ScanKey key,
@@ -1465,6 +1719,8 @@ orioledb_beginscan(Relation relation, Snapshot snapshot,
 	OTableDescr *descr;
 	OScanDesc	scan;
 
+	o_apply_flush_inserts();
+
 	descr = relation_get_descr(relation);
 
 	/*
@@ -1482,6 +1738,9 @@ orioledb_beginscan(Relation relation, Snapshot snapshot,
 	{
 		scan->rs_base.rs_key = (ScanKey) palloc(sizeof(ScanKeyData) * nkeys);
 		memcpy(scan->rs_base.rs_key, key, sizeof(ScanKeyData) * nkeys);
+		scan->filter.keys = (ScanKey) palloc(sizeof(ScanKeyData) * nkeys);
+		scan->filter.attnums = (AttrNumber *) palloc(sizeof(AttrNumber) * nkeys);
+		scan->restKeys = (ScanKey) palloc(sizeof(ScanKeyData) * nkeys);
 	}
 	else
 	{
@@ -1497,11 +1756,52 @@ orioledb_beginscan(Relation relation, Snapshot snapshot,
 	ItemPointerSetOffsetNumber(&scan->iptr, FirstOffsetNumber);
 
 	if (descr)
+	{
 		scan->scan = make_btree_seq_scan(&GET_PRIMARY(descr)->desc, &scan->o_snapshot, parallel_scan);
+		o_scan_init_filter(scan, descr);
+	}
 
 	return &scan->rs_base;
 }
 
+/*
+ * Makes the slots, which still hold the tuples of the batch pointing into
+ * the leaf image of the scan, copy them.  Called before the leaf image is
+ * replaced or freed.
+ */
+static void
+o_scan_own_ref_tuples(OScanDesc scan)
+{
+	int			i;
+
+	for (i = 0; i < scan->nrefs; i++)
+	{
+		OTableSlot *oslot = (OTableSlot *) scan->refSlots[i];
+
+		if (oslot->tupleRef && oslot->tuple.data == scan->refTuples[i])
+			tts_orioledb_own_tuple(scan->refSlots[i]);
+	}
+	scan->nrefs = 0;
+}
+
+/*
+ * Frees the fetched tuples, which are not returned yet.  Must be called
+ * before the B-tree scan is freed.
+ */
+static void
+o_scan_batch_reset(OScanDesc scan)
+{
+	o_scan_own_ref_tuples(scan);
+	while (scan->batchIndex < scan->batchCount)
+	{
+		if (scan->batchAllocated[scan->batchIndex])
+			pfree(scan->batchTuples[scan->batchIndex].data);
+		scan->batchIndex++;
+	}
+	scan->batchCount = 0;
+	scan->batchIndex = 0;
+}
+
 static void
 orioledb_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
 				bool allow_strat, bool allow_sync, bool allow_pagemode)
@@ -1512,14 +1812,17 @@ orioledb_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
 	scan = (OScanDesc) sscan;
 	descr = relation_get_descr(scan->rs_base.rs_rd);
 
-	memcpy(scan->rs_base.rs_key, key, sizeof(ScanKeyData) *
-		   scan->rs_base.rs_nkeys);
+	if (key != NULL && scan->rs_base.rs_nkeys > 0)
+		memcpy(scan->rs_base.rs_key, key, sizeof(ScanKeyData) *
+			   scan->rs_base.rs_nkeys);
 
+	o_scan_batch_reset(scan);
 	if (scan->scan)
 		free_btree_seq_scan(scan->scan);
 
 	scan->scan = make_btree_seq_scan(&GET_PRIMARY(descr)->desc, &scan->o_snapshot,
 									 scan->rs_base.rs_parallel);
+	o_scan_init_filter(scan, descr);
 }
 
 static void
@@ -1532,8 +1835,10 @@ orioledb_endscan(TableScanDesc sscan)
 	if (scan->rs_base.rs_flags & SO_TEMP_SNAPSHOT)
 		UnregisterSnapshot(scan->rs_base.rs_snapshot);
 
+	o_scan_batch_reset(scan);
 	if (scan->scan)
 		free_btree_seq_scan(scan->scan);
+	o_scan_tuples_context_release(scan->tupleCxt);
 }
 
 static bool
@@ -1570,53 +1875,111 @@ slot_keytest(TupleTableSlot *slot, int nkeys, ScanKey keys)
 	return true;
 }
 
-static bool
-orioledb_getnextslot(TableScanDesc sscan, ScanDirection direction,
-					 TupleTableSlot *slot)
+/*
+ * Fills up to 'nslots' slots with the next tuples of the sequential scan,
+ * which match the scan keys.  The tuples are fetched from the B-tree by the
+ * batches of a leaf page, so the executors and extensions processing the
+ * tuples in batches can avoid the per-tuple calls to the B-tree scan.
+ *
+ * The tuples of the leaf images aren't copied: the slots reference them in
+ * the private leaf image of the B-tree scan, which isn't affected by the
+ * concurrent changes of the page or its eviction.  The slots still holding
+ * them copy the tuples only when the scan is about to replace the image, so
+ * the tuples consumed before that, or rejected by the scan keys, are never
+ * copied.
+ *
+ * Returns the number of filled slots.  Less than 'nslots' means the scan is
+ * finished.
+ */
+int
+orioledb_getnextslots(TableScanDesc sscan, ScanDirection direction,
+					  TupleTableSlot **slots, int nslots)
 {
-	OScanDesc	scan;
+	OScanDesc	scan = (OScanDesc) sscan;
 	OTableDescr *descr;
-	bool		result;
+	int			count = 0;
 
 	if (OidIsValid(o_saved_relrewrite))
-		return false;
-
-	do
-	{
-		OTuple		tuple = {0};
-		BTreeLocationHint hint;
-		CommitSeqNo csn;
+		return 0;
 
-		scan = (OScanDesc) sscan;
-		descr = relation_get_descr(scan->rs_base.rs_rd);
+	descr = relation_get_descr(scan->rs_base.rs_rd);
 
-		if (scan->scan)
-			tuple = btree_seq_scan_getnext(scan->scan, slot->tts_mcxt,
-										   &csn, &hint);
+	while (count < nslots)
+	{
+		TupleTableSlot *slot = slots[count];
+		int			i;
 
-		if (O_TUPLE_IS_NULL(tuple))
-			return false;
+		if (scan->batchIndex >= scan->batchCount)
+		{
+			scan->batchIndex = 0;
+			scan->batchCount = 0;
+			if (!scan->tupleCxt)
+				scan->tupleCxt = o_scan_tuples_context_create(slot->tts_mcxt);
+			o_scan_own_ref_tuples(scan);
+			if (scan->scan)
+				scan->batchCount = btree_seq_scan_getnext_batch(scan->scan,
+																scan->tupleCxt,
+																scan->batchTuples,
+																scan->batchCsns,
+																scan->batchHints,
+																scan->batchAllocated,
+																O_SCAN_BATCH_SIZE);
+			if (scan->batchCount == 0)
+				break;
+		}
 
-		tts_orioledb_store_tuple(slot, tuple, descr, csn,
-								 PrimaryIndexNumber, true, &hint);
+		i = scan->batchIndex++;
+		if (scan->batchAllocated[i])
+		{
+			tts_orioledb_store_tuple(slot, scan->batchTuples[i], descr,
+									 scan->batchCsns[i], PrimaryIndexNumber,
+									 true, &scan->batchHints[i]);
+		}
+		else
+		{
+			tts_orioledb_store_tuple_ref(slot, scan->batchTuples[i], descr,
+										 scan->batchCsns[i],
+										 PrimaryIndexNumber,
+										 &scan->batchHints[i]);
+			scan->refSlots[scan->nrefs] = slot;
+			scan->refTuples[scan->nrefs] = scan->batchTuples[i].data;
+			scan->nrefs++;
+		}
 
-		result = slot_keytest(slot,
-							  scan->rs_base.rs_nkeys,
-							  scan->rs_base.rs_key);
+		if (slot_keytest(slot, scan->nrestKeys, scan->restKeys))
+			count++;
+		else
+			o_scan_filter_count_rejected(&scan->filter);
 	}
-	while (!result);
 
-	return true;
+	return count;
+}
+
+static bool
+orioledb_getnextslot(TableScanDesc sscan, ScanDirection direction,
+					 TupleTableSlot *slot)
+{
+	return orioledb_getnextslots(sscan, direction, &slot, 1) > 0;
 }
 
 static void
 orioledb_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
 					  CommandId cid, int options, BulkInsertState bistate)
 {
-	int			i;
+	OTableDescr *descr;
+	OSnapshot	oSnapshot;
+	OXid		oxid;
+
+	if (OidIsValid(relation->rd_rel->relrewrite))
+		return;
 
-	for (i = 0; i < ntuples; i++)
-		orioledb_tuple_insert(relation, slots[i], cid, options, bistate);
+	o_check_table_writable(relation);
+
+	o_apply_flush_inserts();
+
+	descr = relation_get_descr(relation);
+	fill_current_oxid_osnapshot(&oxid, &oSnapshot);
+	o_tbl_multi_insert(descr, relation, slots, ntuples, oxid, oSnapshot.csn);
 }
 
 static void
@@ -2102,6 +2465,11 @@ orioledb_default_reloptions(Datum reloptions, bool validate, relopt_kind kind)
 								 false,
 								 offsetof(ORelOptions,
 										  index_bridging));
+		add_local_bool_reloption(&relopts, "orioledb_frozen",
+								 "Makes the table read-only, rejecting "
+								 "inserts, updates and deletes",
+								 false,
+								 offsetof(ORelOptions, frozen));
 		MemoryContextSwitchTo(oldcxt);
 		relopts_set = true;
 	}
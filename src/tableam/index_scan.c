@@ -15,8 +15,10 @@
 
 #include "orioledb.h"
 
+#include "btree/find.h"
 #include "btree/io.h"
 #include "btree/iterator.h"
+#include "btree/page_contents.h"
 #include "tableam/bitmap_scan.h"
 #include "tableam/index_scan.h"
 #include "tableam/descr.h"
@@ -26,8 +28,15 @@
 
 #include "access/nbtree.h"
 #include "access/skey.h"
+#include "common/hashfn.h"
+#include "lib/stringinfo.h"
 #include "executor/nodeIndexscan.h"
 #include "parser/parse_coerce.h"
+#include "pgstat.h"
+#include "storage/spin.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
 
 void
 init_index_scan_state(OPlanState *o_plan_state, OScanState *ostate, Relation index,
@@ -260,6 +269,545 @@ o_bt_advance_array_keys_increment(OScanState *ostate, ScanDirection dir)
 }
 #endif
 
+/*
+ * Parallel index scan.
+ *
+ * The separator keys of the internal pages split the scan range into the
+ * chunks.  The participants claim the chunks one by one in the scan
+ * direction.  So the output of each participant stays ordered, and
+ * Gather Merge can merge it.  The scans with the array keys and the exact
+ * lookups aren't split: a single participant does them whole.
+ */
+#define O_PARALLEL_INDEX_MIN_KEYS	64
+#define O_PARALLEL_INDEX_MAX_KEYS	1024
+
+typedef struct
+{
+	int			len;
+	uint8		formatFlags;
+} OParallelIndexKey;
+
+#define O_PARALLEL_INDEX_KEY_DATA(key) \
+	((Pointer) (key) + MAXALIGN(sizeof(OParallelIndexKey)))
+
+typedef struct
+{
+	StringInfoData buf;
+	Size	   *offsets;
+	int			count;
+	/* only every 'stride'th suitable key is kept */
+	int			stride;
+	int64		seen;
+} OParallelIndexKeys;
+
+static OTuple
+o_parallel_index_get_key(Pointer data, Size offset)
+{
+	OParallelIndexKey *key = (OParallelIndexKey *) (data + offset);
+	OTuple		tuple;
+
+	tuple.formatFlags = key->formatFlags;
+	tuple.data = O_PARALLEL_INDEX_KEY_DATA(key);
+	return tuple;
+}
+
+static Size
+o_parallel_index_keys_entry_size(OParallelIndexKeys *keys, int i)
+{
+	if (i + 1 < keys->count)
+		return keys->offsets[i + 1] - keys->offsets[i];
+	return keys->buf.len - keys->offsets[i];
+}
+
+/*
+ * Leaves every second key, so the kept keys stay evenly spread.
+ */
+static void
+o_parallel_index_keys_thin(OParallelIndexKeys *keys)
+{
+	StringInfoData buf;
+	int			i,
+				count = 0;
+
+	initStringInfo(&buf);
+	for (i = 0; i < keys->count; i += 2)
+	{
+		Size		size = o_parallel_index_keys_entry_size(keys, i);
+
+		keys->offsets[count++] = buf.len;
+		appendBinaryStringInfo(&buf, keys->buf.data + keys->offsets[i], size);
+	}
+	pfree(keys->buf.data);
+	keys->buf = buf;
+	keys->count = count;
+	keys->stride *= 2;
+}
+
+static void
+o_parallel_index_keys_add(BTreeDescr *desc, OParallelIndexKeys *keys,
+						  OTuple tuple)
+{
+	OParallelIndexKey key;
+	int			len;
+
+	/* the concurrent page splits might make us to see the keys again */
+	if (keys->count > 0)
+	{
+		OTuple		last = o_parallel_index_get_key(keys->buf.data,
+													keys->offsets[keys->count - 1]);
+
+		if (o_btree_cmp(desc, &tuple, BTreeKeyNonLeafKey,
+						&last, BTreeKeyNonLeafKey) <= 0)
+			return;
+	}
+
+	if (keys->seen++ % keys->stride != 0)
+		return;
+
+	if (keys->count >= O_PARALLEL_INDEX_MAX_KEYS)
+	{
+		o_parallel_index_keys_thin(keys);
+		if ((keys->seen - 1) % keys->stride != 0)
+			return;
+	}
+
+	len = o_btree_len(desc, tuple, OKeyLength);
+	key.len = len;
+	key.formatFlags = tuple.formatFlags;
+
+	keys->offsets[keys->count++] = keys->buf.len;
+	appendBinaryStringInfo(&keys->buf, (char *) &key, sizeof(key));
+	appendStringInfoSpaces(&keys->buf,
+						   MAXALIGN(sizeof(key)) - sizeof(key));
+	appendBinaryStringInfo(&keys->buf, tuple.data, len);
+	appendStringInfoSpaces(&keys->buf, MAXALIGN(len) - len);
+}
+
+/*
+ * Adds the key to the separators if it's within the scan range.  Returns
+ * false if the key is beyond the range.
+ */
+static bool
+o_parallel_index_keys_add_if_valid(BTreeDescr *desc, OParallelIndexKeys *keys,
+								   OBTreeKeyRange *range, OTuple tuple)
+{
+	if (o_btree_cmp(desc, &tuple, BTreeKeyNonLeafKey,
+					&range->high, BTreeKeyBound) >= 0)
+		return false;
+	if (o_btree_cmp(desc, &tuple, BTreeKeyNonLeafKey,
+					&range->low, BTreeKeyBound) > 0)
+		o_parallel_index_keys_add(desc, keys, tuple);
+	return true;
+}
+
+/*
+ * Collects the separator keys of the scan range from the pages at 'level'.
+ */
+static void
+o_parallel_index_collect_level(BTreeDescr *desc, OBTreeKeyRange *range,
+							   uint16 level, OParallelIndexKeys *keys)
+{
+	OBTreeFindPageContext context;
+	OFixedKey	hikey;
+
+	init_page_find_context(&context, desc, COMMITSEQNO_INPROGRESS,
+						   BTREE_PAGE_FIND_IMAGE);
+	(void) find_page(&context, &range->low, BTreeKeyBound, level);
+
+	while (true)
+	{
+		Page		img = context.img;
+		BTreePageItemLocator loc;
+		bool		first = true;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (O_PAGE_IS(img, LEAF) || PAGE_GET_LEVEL(img) != level)
+			return;
+
+		/* the first item of the page has no key */
+		BTREE_PAGE_FOREACH_ITEMS(img, &loc)
+		{
+			BTreeNonLeafTuphdr *tuphdr;
+			OTuple		tuple;
+
+			if (first)
+			{
+				first = false;
+				continue;
+			}
+
+			BTREE_PAGE_READ_INTERNAL_ITEM(tuphdr, tuple, img, &loc);
+			if (!o_parallel_index_keys_add_if_valid(desc, keys, range, tuple))
+				return;
+		}
+
+		if (O_PAGE_IS(img, RIGHTMOST))
+			return;
+
+		copy_fixed_hikey(desc, &hikey, img);
+		if (!o_parallel_index_keys_add_if_valid(desc, keys, range, hikey.tuple))
+			return;
+		(void) find_page(&context, &hikey.tuple, BTreeKeyNonLeafKey, level);
+	}
+}
+
+/*
+ * Collects the separators of the scan range and publishes them in the query
+ * DSA.  Descends till the level giving enough of the chunks.
+ */
+static void
+o_parallel_index_build(OIndexDescr *indexDescr, OScanState *ostate)
+{
+	BTreeDescr *desc = &indexDescr->desc;
+	OParallelIndexScanData *pscan = ostate->pscan;
+	OParallelIndexKeys keys;
+	uint16		level;
+	Size		offsetsSize;
+	dsa_pointer dp = InvalidDsaPointer;
+	Pointer		ptr;
+
+	keys.offsets = (Size *) palloc(sizeof(Size) * O_PARALLEL_INDEX_MAX_KEYS);
+	initStringInfo(&keys.buf);
+	keys.count = 0;
+
+	level = PAGE_GET_LEVEL(O_GET_IN_MEMORY_PAGE(desc->rootInfo.rootPageBlkno));
+	for (; level > 0; level--)
+	{
+		resetStringInfo(&keys.buf);
+		keys.count = 0;
+		keys.stride = 1;
+		keys.seen = 0;
+		o_parallel_index_collect_level(desc, &ostate->curKeyRange, level,
+									   &keys);
+		if (keys.count >= O_PARALLEL_INDEX_MIN_KEYS)
+			break;
+	}
+
+	if (keys.count > 0)
+	{
+		int			i;
+
+		offsetsSize = MAXALIGN(sizeof(Size) * keys.count);
+		dp = dsa_allocate(ostate->dsa, offsetsSize + keys.buf.len);
+		ptr = dsa_get_address(ostate->dsa, dp);
+		for (i = 0; i < keys.count; i++)
+			((Size *) ptr)[i] = offsetsSize + keys.offsets[i];
+		memcpy(ptr + offsetsSize, keys.buf.data, keys.buf.len);
+	}
+	pfree(keys.offsets);
+	pfree(keys.buf.data);
+
+	SpinLockAcquire(&pscan->mutex);
+	pscan->keys = dp;
+	pscan->nkeys = keys.count;
+	pscan->status = OParallelIndexFinished;
+	SpinLockRelease(&pscan->mutex);
+	ConditionVariableBroadcast(&pscan->cv);
+}
+
+/*
+ * Returns true if the caller should collect the separators.  Otherwise,
+ * waits till they are published by another participant.
+ */
+static bool
+o_parallel_index_should_build(OParallelIndexScanData *pscan)
+{
+	OParallelIndexStatus status;
+
+	while (true)
+	{
+		SpinLockAcquire(&pscan->mutex);
+		status = pscan->status;
+		if (status == OParallelIndexInitial)
+			pscan->status = OParallelIndexInProgress;
+		SpinLockRelease(&pscan->mutex);
+
+		if (status != OParallelIndexInProgress)
+			break;
+
+		ConditionVariableSleep(&pscan->cv, WAIT_EVENT_BTREE_PAGE);
+	}
+	ConditionVariableCancelSleep();
+
+	return status == OParallelIndexInitial;
+}
+
+/*
+ * Claims the next chunk and starts the iterator from its beginning.  Returns
+ * false if all the chunks are claimed.
+ */
+static bool
+o_parallel_index_next_chunk(OIndexDescr *indexDescr, OScanState *ostate,
+							MemoryContext tupleCxt)
+{
+	uint32		claimed;
+	int			n = ostate->nChunkKeys;
+	void	   *key;
+	BTreeKeyType kind;
+	MemoryContext oldcontext;
+
+	if (ostate->iterator != NULL)
+	{
+		btree_iterator_free(ostate->iterator);
+		ostate->iterator = NULL;
+	}
+
+	claimed = pg_atomic_fetch_add_u32(&ostate->pscan->nextChunk, 1);
+	if (claimed > (uint32) n)
+	{
+		ostate->parallelMode = OParallelIndexDone;
+		return false;
+	}
+
+	if (ScanDirectionIsForward(ostate->scanDir))
+	{
+		ostate->curChunk = claimed;
+		if (ostate->curChunk > 0)
+		{
+			key = &ostate->chunkKeys[ostate->curChunk - 1];
+			kind = BTreeKeyNonLeafKey;
+		}
+		else
+		{
+			key = &ostate->curKeyRange.low;
+			kind = BTreeKeyBound;
+		}
+	}
+	else
+	{
+		ostate->curChunk = n - claimed;
+		if (ostate->curChunk < n)
+		{
+			key = &ostate->chunkKeys[ostate->curChunk];
+			kind = BTreeKeyNonLeafKey;
+		}
+		else
+		{
+			key = &ostate->curKeyRange.high;
+			kind = BTreeKeyBound;
+		}
+	}
+
+	oldcontext = MemoryContextSwitchTo(ostate->cxt);
+	ostate->iterator = o_btree_iterator_create(&indexDescr->desc, key, kind,
+											   &ostate->oSnapshot,
+											   ostate->scanDir);
+	o_btree_iterator_set_tuple_ctx(ostate->iterator, tupleCxt);
+	MemoryContextSwitchTo(oldcontext);
+
+	return true;
+}
+
+/*
+ * Starts the parallel scan once the key range is loaded.  Returns false if
+ * there is nothing to scan for this participant.
+ */
+static bool
+o_parallel_index_start(OIndexDescr *indexDescr, OScanState *ostate,
+					   MemoryContext tupleCxt)
+{
+	OParallelIndexScanData *pscan = ostate->pscan;
+	BTScanOpaque so = (BTScanOpaque) ostate->scandesc.opaque;
+	Pointer		ptr;
+	int			i;
+
+	if (ostate->exact || so->numArrayKeys != 0)
+	{
+		if (pg_atomic_fetch_add_u32(&pscan->nextChunk, 1) != 0)
+		{
+			ostate->parallelMode = OParallelIndexDone;
+			return false;
+		}
+		ostate->parallelMode = OParallelIndexWhole;
+		return true;
+	}
+
+	if (ostate->dsa == NULL)
+		elog(ERROR, "parallel index scan requires the query DSA area");
+
+	if (o_parallel_index_should_build(pscan))
+		o_parallel_index_build(indexDescr, ostate);
+
+	ostate->nChunkKeys = pscan->nkeys;
+	if (ostate->nChunkKeys > 0)
+	{
+		ptr = dsa_get_address(ostate->dsa, pscan->keys);
+		ostate->chunkKeys = (OTuple *) palloc(sizeof(OTuple) *
+											  ostate->nChunkKeys);
+		for (i = 0; i < ostate->nChunkKeys; i++)
+			ostate->chunkKeys[i] = o_parallel_index_get_key(ptr,
+															((Size *) ptr)[i]);
+	}
+	ostate->parallelMode = OParallelIndexChunks;
+
+	return o_parallel_index_next_chunk(indexDescr, ostate, tupleCxt);
+}
+
+void
+o_parallel_index_scan_initialize(OParallelIndexScanData *pscan)
+{
+	SpinLockInit(&pscan->mutex);
+	pscan->status = OParallelIndexInitial;
+	ConditionVariableInit(&pscan->cv);
+	pg_atomic_init_u32(&pscan->nextChunk, 0);
+	pscan->nkeys = 0;
+	pscan->keys = InvalidDsaPointer;
+}
+
+void
+o_parallel_index_scan_reinitialize(OParallelIndexScanData *pscan,
+								   dsa_area *dsa)
+{
+	if (DsaPointerIsValid(pscan->keys))
+		dsa_free(dsa, pscan->keys);
+	pscan->keys = InvalidDsaPointer;
+	pscan->nkeys = 0;
+	pscan->status = OParallelIndexInitial;
+	pg_atomic_write_u32(&pscan->nextChunk, 0);
+}
+
+/*
+ * Resets the participant's state of the parallel scan on rescan.
+ */
+void
+o_parallel_index_scan_reset(OScanState *ostate)
+{
+	ostate->parallelMode = OParallelIndexNotStarted;
+	ostate->chunkKeys = NULL;
+	ostate->nChunkKeys = 0;
+	ostate->curChunk = 0;
+}
+
+/*
+ * Skip scan.
+ *
+ * When the scan has no quals on the first key column, but has them on the
+ * second one, the valid tuples form the subranges for each value of the
+ * first column.  The scan steps over the tuples out of the subrange, and once
+ * it has rejected O_SKIP_SCAN_THRESHOLD of them in a row, it repositions the
+ * iterator to the subrange start of the current value or to the next value.
+ * So few distinct values of the first column cost a descent per value, while
+ * many of them cost nearly nothing.
+ */
+#define O_SKIP_SCAN_THRESHOLD	16
+
+static bool
+o_skip_scan_is_applicable(OScanState *ostate)
+{
+	OBTreeKeyRange *range = &ostate->curKeyRange;
+	BTScanOpaque so = (BTScanOpaque) ostate->scandesc.opaque;
+
+	if (!enable_skip_scan || ostate->exact || so->numArrayKeys != 0 ||
+		ostate->parallelMode == OParallelIndexChunks)
+		return false;
+
+	if (range->low.nkeys < 2 ||
+		range->low.n_row_keys > 0 || range->high.n_row_keys > 0)
+		return false;
+
+	if (!(range->low.keys[0].flags & O_VALUE_BOUND_UNBOUNDED) ||
+		!(range->high.keys[0].flags & O_VALUE_BOUND_UNBOUNDED))
+		return false;
+
+	return !(range->low.keys[1].flags & O_VALUE_BOUND_UNBOUNDED) ||
+		!(range->high.keys[1].flags & O_VALUE_BOUND_UNBOUNDED);
+}
+
+/*
+ * Returns -1 if the second key column value of the tuple is below the range,
+ * 1 if it's above, and 0 if it's within the range.
+ */
+static int
+o_skip_scan_position(OIndexDescr *id, OBTreeKeyRange *range, OTuple tup)
+{
+	int			attnum = OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple, id, 2);
+	bool		isnull;
+	Datum		value = o_fastgetattr(tup, attnum, id->leafTupdesc,
+									  &id->leafSpec, &isnull);
+
+	if (!(range->low.keys[1].flags & O_VALUE_BOUND_UNBOUNDED) &&
+		o_idx_cmp_range_key_to_value(&range->low.keys[1], &id->fields[1],
+									 value, isnull) > 0)
+		return -1;
+	if (!(range->high.keys[1].flags & O_VALUE_BOUND_UNBOUNDED) &&
+		o_idx_cmp_range_key_to_value(&range->high.keys[1], &id->fields[1],
+									 value, isnull) < 0)
+		return 1;
+	return 0;
+}
+
+/*
+ * Called for the tuple rejected by the skip scan.  Repositions the iterator
+ * when the threshold of the rejected tuples is reached.
+ */
+static void
+o_skip_scan_advance(OIndexDescr *id, OScanState *ostate, OTuple tup,
+					MemoryContext tupleCxt)
+{
+	OBTreeKeyRange *range = &ostate->curKeyRange;
+	OBTreeKeyBound *bound = &ostate->skipBound;
+	int			position = o_skip_scan_position(id, range, tup);
+	bool		toNextValue;
+	int			attnum;
+	bool		isnull;
+	int			i;
+	MemoryContext oldcontext;
+
+	if (position == 0)
+	{
+		/* rejected by the other quals, repositioning wouldn't help */
+		ostate->skipRejected = 0;
+		return;
+	}
+
+	if (++ostate->skipRejected < O_SKIP_SCAN_THRESHOLD)
+		return;
+
+	/*
+	 * Forward scan jumps over the rest of the current value if above the
+	 * range, or to the range start for the current value if below it.  The
+	 * backward scan does the opposite.
+	 */
+	toNextValue = ScanDirectionIsForward(ostate->scanDir) ? position > 0 :
+		position < 0;
+
+	attnum = OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple, id, 1);
+	bound->nkeys = range->low.nkeys;
+	bound->n_row_keys = 0;
+	bound->row_keys = NULL;
+	bound->keys[0].value = o_fastgetattr(tup, attnum, id->leafTupdesc,
+										 &id->leafSpec, &isnull);
+	bound->keys[0].type = id->leafTupdesc->attrs[attnum - 1].atttypid;
+	bound->keys[0].flags = O_VALUE_BOUND_PLAIN_VALUE;
+	if (isnull)
+		bound->keys[0].flags |= O_VALUE_BOUND_NULL;
+	bound->keys[0].comparator = id->fields[0].comparator;
+
+	for (i = 1; i < bound->nkeys; i++)
+	{
+		if (!toNextValue)
+			bound->keys[i] = ScanDirectionIsForward(ostate->scanDir) ?
+				range->low.keys[i] : range->high.keys[i];
+		else if (ScanDirectionIsForward(ostate->scanDir))
+			bound->keys[i].flags = O_VALUE_BOUND_PLUS_INFINITY;
+		else
+			bound->keys[i].flags = O_VALUE_BOUND_MINUS_INFINITY;
+	}
+
+	btree_iterator_free(ostate->iterator);
+	oldcontext = MemoryContextSwitchTo(ostate->cxt);
+	ostate->iterator = o_btree_iterator_create(&id->desc, (Pointer) bound,
+											   BTreeKeyBound,
+											   &ostate->oSnapshot,
+											   ostate->scanDir);
+	o_btree_iterator_set_tuple_ctx(ostate->iterator, tupleCxt);
+	MemoryContextSwitchTo(oldcontext);
+
+	/* the next value is likely to start below the range as well */
+	ostate->skipRejected = toNextValue ? O_SKIP_SCAN_THRESHOLD - 1 : 0;
+}
+
 static bool
 switch_to_next_range(OIndexDescr *indexDescr, OScanState *ostate,
 					 MemoryContext tupleCxt)
@@ -270,6 +818,9 @@ switch_to_next_range(OIndexDescr *indexDescr, OScanState *ostate,
 	MemoryContext oldcontext;
 	bool		result = true;
 
+	if (ostate->parallelMode == OParallelIndexDone)
+		return false;
+
 #if PG_VERSION_NUM >= 170000
 
 	if (!so->qual_ok)
@@ -326,6 +877,20 @@ switch_to_next_range(OIndexDescr *indexDescr, OScanState *ostate,
 											indexDescr->nonLeafTupdesc->natts,
 											indexDescr->fields);
 
+	if (ostate->pscan && ostate->parallelMode == OParallelIndexNotStarted)
+	{
+		result = o_parallel_index_start(indexDescr, ostate, tupleCxt);
+		if (!result || ostate->parallelMode == OParallelIndexChunks)
+		{
+			ostate->skipScan = false;
+			MemoryContextSwitchTo(oldcontext);
+			return result;
+		}
+	}
+
+	ostate->skipScan = o_skip_scan_is_applicable(ostate);
+	ostate->skipRejected = 0;
+
 	if (!ostate->exact)
 	{
 		bound = (ostate->scanDir == ForwardScanDirection
@@ -342,6 +907,258 @@ switch_to_next_range(OIndexDescr *indexDescr, OScanState *ostate,
 	return true;
 }
 
+/*
+ * Do exact lookups of the array keys combinations go in ascending order?
+ */
+static inline bool
+exact_keys_ascend(OScanState *ostate)
+{
+#if PG_VERSION_NUM >= 170000
+	return !ScanDirectionIsBackward(ostate->scanDir);
+#else
+	/* array keys are always advanced forward, see switch_to_next_range() */
+	return true;
+#endif
+}
+
+/*
+ * The descent path of the last exact lookup by a single key.  The foreign key
+ * checks probe the referenced key by a separate index scan per referencing
+ * row.  When the referencing rows are loaded in the order of the foreign key,
+ * the probes go in ascending order, and each next probe is searched from the
+ * leaf of the previous one as if the keys were looked up in a batch.
+ */
+static BTreeKeysLookup *pointLookup = NULL;
+static ORelOids pointLookupOids = {InvalidOid, InvalidOid, InvalidOid};
+static OFixedKey pointLookupKey;
+
+/*
+ * The leaves of the recent exact lookups by the hashes of their keys.  The
+ * repeated lookup of the same key starts from the remembered leaf and skips
+ * the descent, like the location hints of the modifications.  The hash is
+ * taken over the binary representation of the key, and the hint is used only
+ * if the key is found on the hinted leaf.  So the hash collisions and the
+ * equal keys with the different representation just miss the hint.
+ */
+typedef struct
+{
+	ORelOids	oids;
+	uint32		keyHash;
+} OPointHintKey;
+
+typedef struct
+{
+	OPointHintKey key;
+	BTreeLocationHint hint;
+} OPointHintEntry;
+
+static HTAB *pointHints = NULL;
+
+/*
+ * Hashes the key bound.  Returns false for the compressed and the external
+ * values, which aren't worth hashing.
+ */
+static bool
+point_lookup_key_hash(OIndexDescr *indexDescr, OBTreeKeyBound *key,
+					  uint32 *result)
+{
+	uint32		hash = 0;
+	int			i;
+
+	for (i = 0; i < key->nkeys; i++)
+	{
+		OBTreeValueBound *value = &key->keys[i];
+		Form_pg_attribute attr = TupleDescAttr(indexDescr->nonLeafTupdesc, i);
+		int16		typlen;
+		bool		typbyval;
+		uint32		valueHash;
+
+		if (value->flags & O_VALUE_BOUND_NULL)
+		{
+			hash = hash_combine(hash, 0);
+			continue;
+		}
+
+		if (value->type == attr->atttypid)
+		{
+			typlen = attr->attlen;
+			typbyval = attr->attbyval;
+		}
+		else
+			get_typlenbyval(value->type, &typlen, &typbyval);
+
+		if (typbyval)
+			valueHash = hash_bytes((unsigned char *) &value->value,
+								   sizeof(Datum));
+		else if (typlen > 0)
+			valueHash = hash_bytes((unsigned char *) DatumGetPointer(value->value),
+								   typlen);
+		else if (typlen == -1)
+		{
+			struct varlena *v = (struct varlena *) DatumGetPointer(value->value);
+
+			if (VARATT_IS_COMPRESSED(v) || VARATT_IS_EXTERNAL(v))
+				return false;
+			valueHash = hash_bytes((unsigned char *) VARDATA_ANY(v),
+								   VARSIZE_ANY_EXHDR(v));
+		}
+		else
+		{
+			char	   *str = DatumGetCString(value->value);
+
+			valueHash = hash_bytes((unsigned char *) str, strlen(str));
+		}
+		hash = hash_combine(hash, valueHash);
+	}
+
+	*result = hash;
+	return true;
+}
+
+/*
+ * Looks up the key starting from its remembered leaf.  Returns false if
+ * there is no hint, or the key isn't found on the hinted leaf.
+ */
+static bool
+o_index_hinted_lookup(OIndexDescr *indexDescr, OPointHintKey *hintKey,
+					  OBTreeKeyBound *key, OSnapshot *oSnapshot,
+					  CommitSeqNo *tupleCsn, MemoryContext tupleCxt,
+					  BTreeLocationHint *hint, OTuple *result)
+{
+	OPointHintEntry *entry;
+	BTreeLocationHint localHint;
+
+	entry = (OPointHintEntry *) hash_search(pointHints, hintKey, HASH_FIND,
+											NULL);
+	if (entry == NULL)
+		return false;
+
+	localHint = entry->hint;
+	*result = o_btree_find_tuple_by_key(&indexDescr->desc, key, BTreeKeyBound,
+										oSnapshot, tupleCsn, tupleCxt,
+										&localHint);
+	if (O_TUPLE_IS_NULL(*result))
+		return false;
+
+	entry->hint = localHint;
+	if (hint)
+		*hint = localHint;
+	return true;
+}
+
+/*
+ * Remembers the leaf, where the key was found.
+ */
+static void
+o_index_remember_hint(OPointHintKey *hintKey, BTreeLocationHint *hint)
+{
+	OPointHintEntry *entry;
+
+	if (pointHints == NULL ||
+		hash_get_num_entries(pointHints) >= point_lookup_hints)
+	{
+		HASHCTL		ctl;
+
+		if (pointHints)
+			hash_destroy(pointHints);
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(OPointHintKey);
+		ctl.entrysize = sizeof(OPointHintEntry);
+		ctl.hcxt = TopMemoryContext;
+		pointHints = hash_create("OrioleDB point lookup hints",
+								 Min(point_lookup_hints, 1024), &ctl,
+								 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = (OPointHintEntry *) hash_search(pointHints, hintKey, HASH_ENTER,
+											NULL);
+	entry->hint = *hint;
+}
+
+static OTuple
+o_index_point_lookup_internal(OIndexDescr *indexDescr, OBTreeKeyBound *key,
+							  OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
+							  MemoryContext tupleCxt, BTreeLocationHint *hint);
+
+static OTuple
+o_index_point_lookup(OIndexDescr *indexDescr, OBTreeKeyBound *key,
+					 OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
+					 MemoryContext tupleCxt, BTreeLocationHint *hint)
+{
+	OPointHintKey hintKey;
+	BTreeLocationHint localHint = {OInvalidInMemoryBlkno, 0};
+	OTuple		tup;
+
+	memset(&hintKey, 0, sizeof(hintKey));
+	if (point_lookup_hints <= 0 ||
+		!point_lookup_key_hash(indexDescr, key, &hintKey.keyHash))
+		return o_index_point_lookup_internal(indexDescr, key, oSnapshot,
+											 tupleCsn, tupleCxt, hint);
+	hintKey.oids = indexDescr->desc.oids;
+
+	if (pointHints &&
+		o_index_hinted_lookup(indexDescr, &hintKey, key, oSnapshot,
+							  tupleCsn, tupleCxt, hint, &tup))
+		return tup;
+
+	tup = o_index_point_lookup_internal(indexDescr, key, oSnapshot,
+										tupleCsn, tupleCxt, &localHint);
+	if (hint)
+		*hint = localHint;
+	if (!O_TUPLE_IS_NULL(tup) && OInMemoryBlknoIsValid(localHint.blkno))
+		o_index_remember_hint(&hintKey, &localHint);
+
+	return tup;
+}
+
+static OTuple
+o_index_point_lookup_internal(OIndexDescr *indexDescr, OBTreeKeyBound *key,
+							  OSnapshot *oSnapshot, CommitSeqNo *tupleCsn,
+							  MemoryContext tupleCxt, BTreeLocationHint *hint)
+{
+	BTreeDescr *desc = &indexDescr->desc;
+	OTuple		tup;
+	bool		key_palloc = false;
+
+	if (!resume_point_lookups)
+		return o_btree_find_tuple_by_key(desc, key, BTreeKeyBound, oSnapshot,
+										 tupleCsn, tupleCxt, hint);
+
+	if (pointLookup == NULL)
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+		pointLookup = o_btree_keys_lookup_create();
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	if (!ORelOidsIsEqual(pointLookupOids, desc->oids) ||
+		o_btree_cmp(desc, key, BTreeKeyBound,
+					&pointLookupKey.tuple, BTreeKeyNonLeafKey) < 0)
+		o_btree_keys_lookup_reset(pointLookup);
+
+	tup = o_btree_keys_lookup_fetch(pointLookup, desc, key, BTreeKeyBound,
+									oSnapshot, tupleCsn, tupleCxt, hint);
+
+	/* The next probe might resume only after the found key */
+	if (O_TUPLE_IS_NULL(tup) ||
+		o_btree_len(desc, tup, OTupleKeyLength) > O_BTREE_MAX_KEY_SIZE)
+	{
+		o_btree_keys_lookup_reset(pointLookup);
+		ORelOidsSetInvalid(pointLookupOids);
+		return tup;
+	}
+
+	pointLookupKey.tuple = o_btree_tuple_make_key(desc, tup,
+												  pointLookupKey.fixedData,
+												  true, &key_palloc);
+	Assert(!key_palloc);
+	pointLookupOids = desc->oids;
+
+	return tup;
+}
+
 OTuple
 o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 				CommitSeqNo *tupleCsn, MemoryContext tupleCxt,
@@ -371,26 +1188,84 @@ o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 			if (hint)
 				hint->blkno = InvalidBlockNumber;
 
-			tup = o_btree_find_tuple_by_key(&indexDescr->desc,
-											&ostate->curKeyRange.low,
-											BTreeKeyBound, &ostate->oSnapshot,
-											tupleCsn, tupleCxt, hint);
+			if (so->numArrayKeys > 0 && exact_keys_ascend(ostate))
+			{
+				/*
+				 * Array keys are iterated in ascending order, so we search
+				 * each next key from the leaf of the previous one.
+				 */
+				if (ostate->keysLookup == NULL)
+				{
+					MemoryContext oldcontext;
+
+					oldcontext = MemoryContextSwitchTo(ostate->cxt);
+					ostate->keysLookup = o_btree_keys_lookup_create();
+					MemoryContextSwitchTo(oldcontext);
+				}
+				tup = o_btree_keys_lookup_fetch(ostate->keysLookup,
+												&indexDescr->desc,
+												&ostate->curKeyRange.low,
+												BTreeKeyBound,
+												&ostate->oSnapshot,
+												tupleCsn, tupleCxt, hint);
+			}
+			else
+				tup = o_index_point_lookup(indexDescr,
+										   &ostate->curKeyRange.low,
+										   &ostate->oSnapshot,
+										   tupleCsn, tupleCxt, hint);
 			if (!O_TUPLE_IS_NULL(tup))
 				tup_fetched = true;
 		}
 		else if (ostate->iterator)
 		{
+			void	   *end;
+			BTreeKeyType endKind = BTreeKeyBound;
+			bool		endIsIncluded = true;
+			OTuple	   *chunkStart = NULL;
+
 			bound = (ostate->scanDir == ForwardScanDirection
 					 ? &ostate->curKeyRange.high : &ostate->curKeyRange.low);
+			end = bound;
+
+			if (ostate->parallelMode == OParallelIndexChunks)
+			{
+				/*
+				 * The chunk includes its lower separator.  The backward scan
+				 * starts from the upper one, so it's skipped.
+				 */
+				if (ScanDirectionIsForward(ostate->scanDir) &&
+					ostate->curChunk < ostate->nChunkKeys)
+				{
+					end = &ostate->chunkKeys[ostate->curChunk];
+					endKind = BTreeKeyNonLeafKey;
+					endIsIncluded = false;
+				}
+				else if (ScanDirectionIsBackward(ostate->scanDir))
+				{
+					if (ostate->curChunk > 0)
+					{
+						end = &ostate->chunkKeys[ostate->curChunk - 1];
+						endKind = BTreeKeyNonLeafKey;
+					}
+					if (ostate->curChunk < ostate->nChunkKeys)
+						chunkStart = &ostate->chunkKeys[ostate->curChunk];
+				}
+			}
 
 			do
 			{
 				tup = o_btree_iterator_fetch(ostate->iterator, tupleCsn,
-											 bound, BTreeKeyBound,
-											 true, hint);
+											 end, endKind,
+											 endIsIncluded, hint);
 
 				if (O_TUPLE_IS_NULL(tup))
 					tup_is_valid = true;
+				else if (chunkStart &&
+						 o_btree_cmp(&indexDescr->desc,
+									 &tup, BTreeKeyLeafTuple,
+									 chunkStart, BTreeKeyNonLeafKey) >= 0)
+					tup_is_valid = false;
 				else
 				{
 					tup_is_valid = is_tuple_valid(tup, indexDescr,
@@ -398,7 +1273,12 @@ o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 												  so,
 												  ostate->numPrefixExactKeys);
 					if (tup_is_valid)
+					{
 						tup_fetched = true;
+						ostate->skipRejected = 0;
+					}
+					else if (ostate->skipScan)
+						o_skip_scan_advance(indexDescr, ostate, tup, tupleCxt);
 				}
 			} while (!tup_is_valid);
 		}
@@ -408,11 +1288,21 @@ o_iterate_index(OIndexDescr *indexDescr, OScanState *ostate,
 			tup_fetched = true;
 		}
 
-		if (!tup_fetched &&
-			!switch_to_next_range(indexDescr, ostate, tupleCxt))
+		if (!tup_fetched)
 		{
-			O_TUPLE_SET_NULL(tup);
-			tup_fetched = true;
+			bool		has_next;
+
+			if (ostate->parallelMode == OParallelIndexChunks)
+				has_next = o_parallel_index_next_chunk(indexDescr, ostate,
+													   tupleCxt);
+			else
+				has_next = switch_to_next_range(indexDescr, ostate, tupleCxt);
+
+			if (!has_next)
+			{
+				O_TUPLE_SET_NULL(tup);
+				tup_fetched = true;
+			}
 		}
 	} while (!tup_fetched);
 	return tup;
@@ -503,7 +1393,11 @@ o_exec_fetch(OScanState *ostate, ScanState *ss)
 	OTuple		tuple;
 	bool		scan_primary = ostate->ixNum == PrimaryIndexNumber ||
 		!ostate->onlyCurIx;
-	MemoryContext tupleCxt = ss->ss_ScanTupleSlot->tts_mcxt;
+	MemoryContext tupleCxt;
+
+	if (!ostate->tupleCxt)
+		ostate->tupleCxt = o_scan_tuples_context_create(ss->ss_ScanTupleSlot->tts_mcxt);
+	tupleCxt = ostate->tupleCxt;
 
 	do
 	{
@@ -566,9 +1460,11 @@ o_exec_project(ProjectionInfo *projInfo, ExprContext *econtext,
 
 /* initialize explain analyze counters */
 void
-eanalyze_counters_init(OEACallsCounters *eacc, OTableDescr *descr)
+eanalyze_counters_init(OEACallsCounters *eacc, OTableDescr *descr,
+					   bool timing)
 {
 	memset(eacc, 0, sizeof(*eacc));
+	eacc->timing = timing && explain_io_details;
 	eacc->oids = descr->oids;
 	eacc->descr = descr;
 	eacc->nindices = descr->nIndices;
@@ -582,10 +1478,15 @@ eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 						 char *ix_name, ExplainState *es)
 {
 	StringInfoData explain;
-	char	   *fnames[EA_COUNTERS_NUM] = {"read", "lock", "evict",
-	"write", "load"};
-	uint32		counts[EA_COUNTERS_NUM],
+	char	   *fnames[EA_COUNTERS_NUM + EA_IO_COUNTERS_NUM] = {"read", "lock",
+		"evict", "write", "load", "disk_read", "s3_read", "undo_images",
+	"toast_chunks", "visibility_checks", "undo_disk_reads"};
+	char	   *io_pnames[EA_IO_COUNTERS_NUM] = {"Disk Read", "S3 Read",
+	"Undo Images", "Toast Chunks", "Visibility Checks", "Undo Disk Reads"};
+	uint32		counts[EA_COUNTERS_NUM + EA_IO_COUNTERS_NUM],
+				ncounts,
 				i;
+	double		io_time = 0.0;
 	bool		is_first,
 				is_null;
 	char	   *label_upcase = NULL;
@@ -597,9 +1498,22 @@ eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 	counts[2] = counter->evict;
 	counts[3] = counter->write;
 	counts[4] = counter->load;
+	counts[5] = counter->diskRead;
+	counts[6] = counter->s3Read;
+	counts[7] = counter->undoImage;
+	counts[8] = counter->toastChunk;
+	counts[9] = counter->visibility;
+	counts[10] = counter->undoDiskRead;
+
+	ncounts = EA_COUNTERS_NUM;
+	if (explain_io_details)
+	{
+		ncounts += EA_IO_COUNTERS_NUM;
+		io_time = INSTR_TIME_GET_MILLISEC(counter->ioTime);
+	}
 
-	is_null = true;
-	for (i = 0; i < EA_COUNTERS_NUM; i++)
+	is_null = (io_time == 0.0);
+	for (i = 0; i < ncounts; i++)
 		if (counts[i] > 0)
 			is_null = false;
 
@@ -635,7 +1549,7 @@ eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 	}
 
 	is_first = true;
-	for (i = 0; i < EA_COUNTERS_NUM; i++)
+	for (i = 0; i < ncounts; i++)
 	{
 		if (counts[i] > 0)
 		{
@@ -651,6 +1565,12 @@ eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 				case EXPLAIN_FORMAT_JSON:
 				case EXPLAIN_FORMAT_XML:
 				case EXPLAIN_FORMAT_YAML:
+					if (i >= EA_COUNTERS_NUM)
+					{
+						ExplainPropertyUInteger(io_pnames[i - EA_COUNTERS_NUM],
+												NULL, counts[i], es);
+					}
+					else
 					{
 						char	   *fname = pstrdup(fnames[i]);
 
@@ -664,6 +1584,26 @@ eanalyze_counter_explain(OEACallsCounter *counter, char *label,
 		}
 	}
 
+	if (io_time > 0.0)
+	{
+		switch (es->format)
+		{
+			case EXPLAIN_FORMAT_TEXT:
+				if (!is_first)
+					appendStringInfo(&explain, ", ");
+				else
+					initStringInfo(&explain);
+				appendStringInfo(&explain, "io_time=%.3f", io_time);
+				break;
+			case EXPLAIN_FORMAT_JSON:
+			case EXPLAIN_FORMAT_XML:
+			case EXPLAIN_FORMAT_YAML:
+				ExplainPropertyFloat("I/O Time", "ms", io_time, 3, es);
+				break;
+		}
+		is_first = false;
+	}
+
 	switch (es->format)
 	{
 		case EXPLAIN_FORMAT_TEXT:
@@ -3,6 +3,22 @@
  * key_bitmap.c
  *		Routines for bitmap scan of orioledb table
  *
+ * The key bitmap is a roaring bitmap over the 64-bit key space.  The keys
+ * are split into the high 48 bits, which select the container, and the low
+ * 16 bits, which are stored in the container.  The containers are kept in
+ * an array sorted by the high bits.  Each container is either a sorted array
+ * of the low parts (sparse), a plain bitmap of 2^16 bits (dense) or an array
+ * of runs (ranges of consecutive keys), whatever takes less memory.
+ *
+ * The index scans insert the keys in the order of the index, which is
+ * arbitrary in terms of the primary key.  So the inserted keys are
+ * accumulated in the pending buffer first, then sorted and merged into the
+ * containers in bulk.
+ *
+ * Parallel bitmap scans serialize the bitmap into the shared memory.  The
+ * participants attach to it as read-only bitmaps referencing the shared
+ * containers data.
+ *
  * Copyright (c) 2021-2025, Oriole DB Inc.
  * Copyright (c) 2025, Supabase Inc.
  *
@@ -14,505 +30,978 @@
 
 #include "orioledb.h"
 
-#include "btree/io.h"
-#include "btree/iterator.h"
-#include "btree/page_chunks.h"
 #include "tableam/bitmap_scan.h"
-#include "tableam/index_scan.h"
-#include "tuple/slot.h"
 
-#include "lib/rbtree.h"
+#include "port/pg_bitutils.h"
 
-static int	bm_rbt_comparator(const RBTNode *a, const RBTNode *b, void *arg);
-static void bm_rbt_combiner(RBTNode *existing, const RBTNode *newdata, void *arg);
-static RBTNode *bm_rbt_allocfunc(void *arg);
-static void bm_rbt_freefunc(RBTNode *x, void *arg);
+#define OKB_CONTAINER_SIZE		0x10000
+#define OKB_ARRAY_MAX_CARD		4096
+#define OKB_BITMAP_WORDS		(OKB_CONTAINER_SIZE / 64)
+#define OKB_BITMAP_BYTES		(OKB_BITMAP_WORDS * sizeof(uint64))
+#define OKB_PENDING_INITIAL		1024
+#define OKB_PENDING_MAX			0x10000
 
-#define HIGH_PART_MASK	(0xFFFFFFFFFFFFFC00)
-#define LOW_PART_MASK	(0x00000000000003FF)
-#define BITMAP_SIZE		0x80
+#define OKB_HIGH(key)			((key) >> 16)
+#define OKB_LOW(key)			((uint16) ((key) & 0xFFFF))
+#define OKB_KEY(high, low)		(((high) << 16) | (uint64) (low))
 
+typedef enum
+{
+	OKB_ARRAY,
+	OKB_BITMAP,
+	OKB_RUN
+} OKeyBitmapContainerType;
+
+/* The run covers the values from start to start + length inclusive */
 typedef struct
 {
-	RBTNode		rbtnode;
-	uint64		key;
-	uint8	   *bitmap;
-} OKeyBitmapRBTNode;
+	uint16		start;
+	uint16		length;
+} OKeyBitmapRun;
 
-RBTree *
-o_keybitmap_create(void)
+/* Serialized container, the data is located at 'offset' from the start */
+typedef struct
 {
-	return rbt_create(sizeof(OKeyBitmapRBTNode),
-					  bm_rbt_comparator,
-					  bm_rbt_combiner,
-					  bm_rbt_allocfunc,
-					  bm_rbt_freefunc,
-					  NULL);
-}
+	uint64		high;
+	Size		offset;
+	int32		card;
+	int32		n;
+	uint8		type;
+} OKeyBitmapSerializedContainer;
 
-void
-o_keybitmap_insert(RBTree *rbtree, uint64 value)
+typedef struct
 {
-	OKeyBitmapRBTNode node;
-	bool		is_new;
+	int			ncontainers;
+	OKeyBitmapSerializedContainer containers[FLEXIBLE_ARRAY_MEMBER];
+} OKeyBitmapSerialized;
 
-	/*
-	 * For the moment, fill only the fields of node that will be looked at by
-	 * bm_rbt_combiner or bt_rbt_comparator.
-	 */
-	node.key = value;
-	node.bitmap = NULL;
-	(void) rbt_insert(rbtree, (RBTNode *) &node, &is_new);
-}
+typedef struct
+{
+	uint64		high;
+	/* uint16 values, uint64 words or OKeyBitmapRun runs depending on type */
+	void	   *data;
+	/* number of values in the container */
+	int32		card;
+	/* number of the array values or runs */
+	int32		n;
+	uint8		type;
+} OKeyBitmapContainer;
+
+struct OKeyBitmap
+{
+	MemoryContext mcxt;
+	/* the containers data belong to the serialized bitmap */
+	bool		readOnly;
+	OKeyBitmapContainer *containers;
+	int			ncontainers;
+	/* the container found by the last lookup */
+	int			lastContainer;
+	uint64	   *pending;
+	int			npending;
+	int			pendingAllocated;
+};
 
-bool
-o_keybitmap_test(RBTree *rbtree, uint64 value)
+static int
+okb_uint64_cmp(const void *a, const void *b)
 {
-	OKeyBitmapRBTNode node;
-	OKeyBitmapRBTNode *found;
+	uint64		va = *((const uint64 *) a);
+	uint64		vb = *((const uint64 *) b);
 
-	/*
-	 * For the moment, fill only the fields of node that will be looked at by
-	 * bt_rbt_comparator.
-	 */
-	node.key = value;
-	node.bitmap = NULL;
-	found = (OKeyBitmapRBTNode *) rbt_find(rbtree, (RBTNode *) &node);
-	if (!found)
-		return false;
+	return va > vb ? 1 : va < vb ? -1 : 0;
+}
 
-	if (found->bitmap)
+/*
+ * Returns the index of the first array value, which is greater or equal to
+ * 'value'.
+ */
+static int
+okb_array_lower_bound(const uint16 *values, int n, int value)
+{
+	int			low = 0,
+				high = n;
+
+	while (low < high)
 	{
-		int			offset = (value & LOW_PART_MASK);
+		int			mid = (low + high) / 2;
 
-		if (found->bitmap[offset >> 3] & (1 << (offset & 7)))
-			return true;
+		if (values[mid] < value)
+			low = mid + 1;
 		else
-			return false;
+			high = mid;
 	}
-	else
+	return low;
+}
+
+/*
+ * Returns the index of the first run, which ends at or after 'value'.
+ */
+static int
+okb_runs_lower_bound(const OKeyBitmapRun *runs, int n, int value)
+{
+	int			low = 0,
+				high = n;
+
+	while (low < high)
 	{
-		return (found->key == value);
+		int			mid = (low + high) / 2;
+
+		if ((int) runs[mid].start + (int) runs[mid].length < value)
+			low = mid + 1;
+		else
+			high = mid;
 	}
+	return low;
 }
 
-bool
-o_keybitmap_range_is_valid(RBTree *rbtree, uint64 low, uint64 high)
+static int
+okb_array_union(const uint16 *a, int na, const uint16 *b, int nb, uint16 *out)
 {
-	OKeyBitmapRBTNode lowNode;
-	OKeyBitmapRBTNode *node;
-	int			i,
-				iStart,
-				iEnd;
-	uint8		startMask,
-				endMask;
-	bool		valid = false;
-	bool		first = true;
-
-	while (!valid && ((low & HIGH_PART_MASK) <= (high & HIGH_PART_MASK)))
-	{
-		bool		skip_step = false;
-
-		/*
-		 * For the moment, fill only the fields of node that will be looked at
-		 * by bt_rbt_comparator.
-		 */
-		lowNode.key = low;
-		lowNode.bitmap = NULL;
-
-		node = (OKeyBitmapRBTNode *) rbt_find_great(rbtree,
-													(RBTNode *) &lowNode,
-													true);
-		if (!node)
-			break;
-
-		if (!node->bitmap)
-		{
-			if (node->key >= low && node->key < high)
-				valid = true;
-			skip_step = true;
-		}
+	int			i = 0,
+				j = 0,
+				n = 0;
 
-		if (!skip_step)
+	while (i < na && j < nb)
+	{
+		if (a[i] < b[j])
+			out[n++] = a[i++];
+		else if (a[i] > b[j])
+			out[n++] = b[j++];
+		else
 		{
-			if ((low & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
-			{
-				iStart = (low & LOW_PART_MASK) >> 3;
-				startMask = 0xFF << ((low & LOW_PART_MASK) & 7);
-			}
-			else
-			{
-				iStart = 0;
-				startMask = 0xFF;
-			}
+			out[n++] = a[i++];
+			j++;
+		}
+	}
+	while (i < na)
+		out[n++] = a[i++];
+	while (j < nb)
+		out[n++] = b[j++];
+	return n;
+}
 
-			if ((high & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
-			{
-				iEnd = ((high - 1) & LOW_PART_MASK) >> 3;
-				endMask = 0xFF >> (7 - (((high - 1) & LOW_PART_MASK) & 7));
-			}
-			else
-			{
-				iEnd = BITMAP_SIZE - 1;
-				endMask = 0xFF;
-			}
-			for (i = iStart; i <= iEnd; i++)
-			{
-				uint8		mask;
+/*
+ * Returns the position of the first set (or clear, if !set) bit at or after
+ * 'pos'.  Returns -1 if no set bit is found or OKB_CONTAINER_SIZE if no clear
+ * bit is found.
+ */
+static int
+okb_words_next(const uint64 *words, int pos, bool set)
+{
+	int			i = pos >> 6;
+	uint64		word;
 
-				mask = (i == iStart) ? startMask : 0xFF;
-				if (i == iEnd)
-					mask &= endMask;
+	if (pos >= OKB_CONTAINER_SIZE)
+		return set ? -1 : OKB_CONTAINER_SIZE;
 
-				if (node->bitmap[i] & mask)
-					valid = true;
-			}
-		}
-		if (!valid)
-		{
-			low = node->key;
-			if (!first)
-				low += (1L << 10);
-		}
-		first = false;
+	word = set ? words[i] : ~words[i];
+	word &= ~UINT64CONST(0) << (pos & 63);
+	while (word == 0)
+	{
+		if (++i >= OKB_BITMAP_WORDS)
+			return set ? -1 : OKB_CONTAINER_SIZE;
+		word = set ? words[i] : ~words[i];
 	}
+	return (i << 6) + pg_rightmost_one_pos64(word);
+}
 
-	return valid;
+static void
+okb_words_set_range(uint64 *words, int start, int end)
+{
+	int			first = start >> 6,
+				last = end >> 6,
+				i;
+	uint64		firstMask = ~UINT64CONST(0) << (start & 63),
+				lastMask = ~UINT64CONST(0) >> (63 - (end & 63));
+
+	if (first == last)
+	{
+		words[first] |= firstMask & lastMask;
+		return;
+	}
+	words[first] |= firstMask;
+	for (i = first + 1; i < last; i++)
+		words[i] = ~UINT64CONST(0);
+	words[last] |= lastMask;
 }
 
 static int
-find_next_offset(uint8 *bitmap, int minOffset)
+okb_words_count_runs(const uint64 *words)
+{
+	uint64		carry = 0;
+	int			nruns = 0,
+				i;
+
+	/* count the set bits, which don't follow another set bit */
+	for (i = 0; i < OKB_BITMAP_WORDS; i++)
+	{
+		uint64		word = words[i];
+
+		nruns += pg_popcount64(word & ~((word << 1) | carry));
+		carry = word >> 63;
+	}
+	return nruns;
+}
+
+static void
+okb_container_free(OKeyBitmapContainer *c)
+{
+	if (c->data)
+		pfree(c->data);
+	c->data = NULL;
+}
+
+static Size
+okb_container_data_size(const OKeyBitmapContainer *c)
+{
+	switch (c->type)
+	{
+		case OKB_ARRAY:
+			return sizeof(uint16) * c->n;
+		case OKB_BITMAP:
+			return OKB_BITMAP_BYTES;
+		case OKB_RUN:
+			return sizeof(OKeyBitmapRun) * c->n;
+	}
+	Assert(false);
+	return 0;
+}
+
+static void
+okb_container_copy(OKeyBitmapContainer *dst, const OKeyBitmapContainer *src)
+{
+	Size		size = okb_container_data_size(src);
+
+	*dst = *src;
+	dst->data = palloc(Max(size, 1));
+	memcpy(dst->data, src->data, size);
+}
+
+/*
+ * Sets the bits of the container values in 'words'.
+ */
+static void
+okb_container_or_words(const OKeyBitmapContainer *c, uint64 *words)
 {
 	int			i;
-	uint8		mask;
 
-	i = minOffset >> 3;
-	mask = 0xFF << (minOffset & 7);
-	while (i < BITMAP_SIZE)
+	switch (c->type)
 	{
-		mask &= bitmap[i];
-		if (mask)
-		{
-			int			result;
+		case OKB_ARRAY:
+			{
+				const uint16 *values = (const uint16 *) c->data;
 
-			result = i << 3;
-			while (!(mask & 1))
+				for (i = 0; i < c->n; i++)
+					words[values[i] >> 6] |= UINT64CONST(1) << (values[i] & 63);
+				break;
+			}
+		case OKB_BITMAP:
 			{
-				result++;
-				mask >>= 1;
+				const uint64 *cwords = (const uint64 *) c->data;
+
+				for (i = 0; i < OKB_BITMAP_WORDS; i++)
+					words[i] |= cwords[i];
+				break;
+			}
+		case OKB_RUN:
+			{
+				const OKeyBitmapRun *runs = (const OKeyBitmapRun *) c->data;
+
+				for (i = 0; i < c->n; i++)
+					okb_words_set_range(words, runs[i].start,
+										runs[i].start + runs[i].length);
+				break;
 			}
-			return result;
-		}
-		mask = 0xFF;
-		i++;
 	}
-	return -1;
 }
 
+static void
+okb_container_to_words(const OKeyBitmapContainer *c, uint64 *words)
+{
+	memset(words, 0, OKB_BITMAP_BYTES);
+	okb_container_or_words(c, words);
+}
 
-uint64
-o_keybitmap_get_next(RBTree *rbtree, uint64 prev, bool *found)
+/*
+ * Replaces the container contents with the 'words' bitmap using the most
+ * compact representation.  Leaves the container with zero card and no data
+ * if the bitmap is empty.
+ */
+static void
+okb_container_set_words(OKeyBitmapContainer *c, const uint64 *words)
 {
-	OKeyBitmapRBTNode lowNode;
-	OKeyBitmapRBTNode *node;
-	RBTreeIterator iter;
+	int			card = (int) pg_popcount((const char *) words, OKB_BITMAP_BYTES);
+	int			nruns;
 
-	/*
-	 * For the moment, fill only the fields of node that will be looked at by
-	 * bt_rbt_comparator.
-	 */
-	lowNode.key = prev;
-	lowNode.bitmap = NULL;
-	node = (OKeyBitmapRBTNode *) rbt_find_great(rbtree,
-												(RBTNode *) &lowNode,
-												true);
-	if (!node)
-	{
-		*found = false;
-		return 0;
-	}
+	okb_container_free(c);
+	c->card = card;
+	c->n = 0;
+	if (card == 0)
+		return;
 
-	if (!node->bitmap)
+	nruns = okb_words_count_runs(words);
+	if (sizeof(OKeyBitmapRun) * nruns <
+		(card <= OKB_ARRAY_MAX_CARD ? sizeof(uint16) * card : OKB_BITMAP_BYTES))
 	{
-		if (node->key >= prev)
+		OKeyBitmapRun *runs = palloc(sizeof(OKeyBitmapRun) * nruns);
+		int			pos = okb_words_next(words, 0, true);
+
+		while (pos >= 0)
 		{
-			*found = true;
-			return node->key;
+			int			end = okb_words_next(words, pos, false);
+
+			runs[c->n].start = pos;
+			runs[c->n].length = end - 1 - pos;
+			c->n++;
+			pos = okb_words_next(words, end, true);
 		}
+		Assert(c->n == nruns);
+		c->type = OKB_RUN;
+		c->data = runs;
 	}
-	else if ((prev & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
+	else if (card <= OKB_ARRAY_MAX_CARD)
 	{
-		int			nextOffset;
-
-		nextOffset = find_next_offset(node->bitmap, prev & LOW_PART_MASK);
+		uint16	   *values = palloc(sizeof(uint16) * card);
+		int			i;
 
-		if (nextOffset >= 0)
+		for (i = 0; i < OKB_BITMAP_WORDS; i++)
 		{
-			*found = true;
-			return node->key + nextOffset;
+			uint64		word = words[i];
+
+			while (word != 0)
+			{
+				values[c->n++] = (i << 6) + pg_rightmost_one_pos64(word);
+				word &= word - 1;
+			}
 		}
+		c->type = OKB_ARRAY;
+		c->data = values;
 	}
-
-	if ((prev & HIGH_PART_MASK) == (node->key & HIGH_PART_MASK))
+	else
 	{
-		rbt_begin_iterate(rbtree, LeftRightWalk, &iter);
-		iter.last_visited = (RBTNode *) node;
-		node = (OKeyBitmapRBTNode *) rbt_iterate(&iter);
+		c->type = OKB_BITMAP;
+		c->data = palloc(OKB_BITMAP_BYTES);
+		memcpy(c->data, words, OKB_BITMAP_BYTES);
 	}
+}
 
-	if (!node)
+/*
+ * Converts the array container to runs if they take less memory.
+ */
+static void
+okb_container_optimize(OKeyBitmapContainer *c)
+{
+	uint16	   *values = (uint16 *) c->data;
+	OKeyBitmapRun *runs;
+	int			nruns = 1,
+				i;
+
+	if (c->type != OKB_ARRAY || c->n == 0)
+		return;
+
+	for (i = 1; i < c->n; i++)
+		if (values[i] != values[i - 1] + 1)
+			nruns++;
+	if (sizeof(OKeyBitmapRun) * nruns >= sizeof(uint16) * c->n)
+		return;
+
+	runs = palloc(sizeof(OKeyBitmapRun) * nruns);
+	runs[0].start = values[0];
+	runs[0].length = 0;
+	nruns = 1;
+	for (i = 1; i < c->n; i++)
 	{
-		*found = false;
-		return 0;
+		if (values[i] == values[i - 1] + 1)
+		{
+			runs[nruns - 1].length++;
+		}
+		else
+		{
+			runs[nruns].start = values[i];
+			runs[nruns].length = 0;
+			nruns++;
+		}
 	}
+	pfree(values);
+	c->type = OKB_RUN;
+	c->data = runs;
+	c->n = nruns;
+}
 
-	if (!node->bitmap)
+/*
+ * Initializes the container with sorted unique 'values'.
+ */
+static void
+okb_container_init(OKeyBitmapContainer *c, uint64 high,
+				   const uint16 *values, int n)
+{
+	c->high = high;
+	c->data = NULL;
+	if (n <= OKB_ARRAY_MAX_CARD)
 	{
-		*found = true;
-		return node->key;
+		c->type = OKB_ARRAY;
+		c->data = palloc(sizeof(uint16) * n);
+		memcpy(c->data, values, sizeof(uint16) * n);
+		c->n = c->card = n;
+		okb_container_optimize(c);
 	}
 	else
 	{
-		int			nextOffset = find_next_offset(node->bitmap, 0);
+		uint64		words[OKB_BITMAP_WORDS];
+		int			i;
 
-		Assert(nextOffset >= 0);
-		*found = true;
-		return node->key + nextOffset;
+		memset(words, 0, OKB_BITMAP_BYTES);
+		for (i = 0; i < n; i++)
+			words[values[i] >> 6] |= UINT64CONST(1) << (values[i] & 63);
+		okb_container_set_words(c, words);
 	}
 }
 
+/*
+ * Adds sorted unique 'values' to the container.
+ */
 static void
-free_tree_node(RBTNode *node)
+okb_container_add(OKeyBitmapContainer *c, const uint16 *values, int n)
 {
-	OKeyBitmapRBTNode *keyNode = (OKeyBitmapRBTNode *) node;
+	if (c->type == OKB_ARRAY && c->n + n <= OKB_ARRAY_MAX_CARD)
+	{
+		uint16	   *merged = palloc(sizeof(uint16) * (c->n + n));
 
-	if (node->left == node)
+		c->n = c->card = okb_array_union((uint16 *) c->data, c->n,
+										 values, n, merged);
+		pfree(c->data);
+		c->data = merged;
+		okb_container_optimize(c);
+	}
+	else
 	{
-		Assert(node->right == node);
-		return;
+		uint64		words[OKB_BITMAP_WORDS];
+		int			i;
+
+		okb_container_to_words(c, words);
+		for (i = 0; i < n; i++)
+			words[values[i] >> 6] |= UINT64CONST(1) << (values[i] & 63);
+		okb_container_set_words(c, words);
 	}
-	if (keyNode->bitmap)
-		pfree(keyNode->bitmap);
-	free_tree_node(node->left);
-	free_tree_node(node->right);
-	pfree(node);
 }
 
-void
-o_keybitmap_free(RBTree *tree)
+static bool
+okb_container_contains(const OKeyBitmapContainer *c, int value)
 {
-	free_tree_node(*((RBTNode **) tree));
-	pfree(tree);
+	int			i;
+
+	switch (c->type)
+	{
+		case OKB_ARRAY:
+			{
+				const uint16 *values = (const uint16 *) c->data;
+
+				i = okb_array_lower_bound(values, c->n, value);
+				return i < c->n && values[i] == value;
+			}
+		case OKB_BITMAP:
+			{
+				const uint64 *words = (const uint64 *) c->data;
+
+				return (words[value >> 6] >> (value & 63)) & 1;
+			}
+		case OKB_RUN:
+			{
+				const OKeyBitmapRun *runs = (const OKeyBitmapRun *) c->data;
+
+				i = okb_runs_lower_bound(runs, c->n, value);
+				return i < c->n && runs[i].start <= value;
+			}
+	}
+	Assert(false);
+	return false;
 }
 
-bool
-o_keybitmap_is_empty(RBTree *rbtree)
+/*
+ * Returns the least container value, which is greater or equal to 'value',
+ * or -1 if there is no such value.
+ */
+static int
+okb_container_next(const OKeyBitmapContainer *c, int value)
 {
-	return rbt_leftmost(rbtree) == NULL;
+	int			i;
+
+	switch (c->type)
+	{
+		case OKB_ARRAY:
+			{
+				const uint16 *values = (const uint16 *) c->data;
+
+				i = okb_array_lower_bound(values, c->n, value);
+				return i < c->n ? values[i] : -1;
+			}
+		case OKB_BITMAP:
+			return okb_words_next((const uint64 *) c->data, value, true);
+		case OKB_RUN:
+			{
+				const OKeyBitmapRun *runs = (const OKeyBitmapRun *) c->data;
+
+				i = okb_runs_lower_bound(runs, c->n, value);
+				return i < c->n ? Max(runs[i].start, value) : -1;
+			}
+	}
+	Assert(false);
+	return -1;
 }
 
-void
-o_keybitmap_intersect(RBTree *a, RBTree *b)
+static void
+okb_container_intersect(OKeyBitmapContainer *a, const OKeyBitmapContainer *b)
 {
-	RBTreeIterator iterA;
-	RBTreeIterator iterB;
-	OKeyBitmapRBTNode *nodeA;
-	OKeyBitmapRBTNode *nodeB;
-	List	   *removing = NIL;
-	ListCell   *lc;
+	int			i,
+				n = 0;
 
-	rbt_begin_iterate(a, LeftRightWalk, &iterA);
-	rbt_begin_iterate(b, LeftRightWalk, &iterB);
+	if (a->type == OKB_ARRAY)
+	{
+		uint16	   *values = (uint16 *) a->data;
 
-	nodeB = (OKeyBitmapRBTNode *) rbt_iterate(&iterB);
-	while ((nodeA = (OKeyBitmapRBTNode *) rbt_iterate(&iterA)) != NULL)
+		for (i = 0; i < a->n; i++)
+			if (okb_container_contains(b, values[i]))
+				values[n++] = values[i];
+		a->n = a->card = n;
+	}
+	else if (b->type == OKB_ARRAY)
 	{
-		while (nodeB &&
-			   (nodeB->key & HIGH_PART_MASK) < (nodeA->key & HIGH_PART_MASK))
-		{
-			nodeB = (OKeyBitmapRBTNode *) rbt_iterate(&iterB);
-		}
+		const uint16 *bvalues = (const uint16 *) b->data;
+		uint16	   *values = palloc(sizeof(uint16) * Max(b->n, 1));
+
+		for (i = 0; i < b->n; i++)
+			if (okb_container_contains(a, bvalues[i]))
+				values[n++] = bvalues[i];
+		okb_container_free(a);
+		a->type = OKB_ARRAY;
+		a->data = values;
+		a->n = a->card = n;
+	}
+	else
+	{
+		uint64		wordsA[OKB_BITMAP_WORDS];
+		uint64		wordsB[OKB_BITMAP_WORDS];
+
+		/* the word loop is simple enough for the compiler to vectorize */
+		okb_container_to_words(a, wordsA);
+		okb_container_to_words(b, wordsB);
+		for (i = 0; i < OKB_BITMAP_WORDS; i++)
+			wordsA[i] &= wordsB[i];
+		okb_container_set_words(a, wordsA);
+	}
+}
 
-		if (!nodeB ||
-			(nodeB->key & HIGH_PART_MASK) > (nodeA->key & HIGH_PART_MASK))
-		{
-			OKeyBitmapRBTNode *removed_node;
+static void
+okb_container_union(OKeyBitmapContainer *a, const OKeyBitmapContainer *b)
+{
+	if (a->type == OKB_ARRAY && b->type == OKB_ARRAY &&
+		a->n + b->n <= OKB_ARRAY_MAX_CARD)
+	{
+		okb_container_add(a, (const uint16 *) b->data, b->n);
+	}
+	else
+	{
+		uint64		words[OKB_BITMAP_WORDS];
+
+		okb_container_to_words(a, words);
+		okb_container_or_words(b, words);
+		okb_container_set_words(a, words);
+	}
+}
+
+/*
+ * Merges the pending keys into the containers.
+ */
+static void
+okb_flush(OKeyBitmap *bitmap)
+{
+	MemoryContext oldcxt;
+	OKeyBitmapContainer *containers;
+	uint64	   *pending = bitmap->pending;
+	uint16	   *values;
+	int			npending = 0,
+				ngroups = 0,
+				n = 0,
+				i,
+				k;
+
+	if (bitmap->npending == 0)
+		return;
+
+	oldcxt = MemoryContextSwitchTo(bitmap->mcxt);
 
-			removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-			memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-			removing = lappend(removing, removed_node);
+	qsort(pending, bitmap->npending, sizeof(uint64), okb_uint64_cmp);
+	for (i = 0; i < bitmap->npending; i++)
+	{
+		if (npending > 0 && pending[npending - 1] == pending[i])
 			continue;
-		}
+		if (npending == 0 ||
+			OKB_HIGH(pending[npending - 1]) != OKB_HIGH(pending[i]))
+			ngroups++;
+		pending[npending++] = pending[i];
+	}
+	bitmap->npending = 0;
 
-		Assert((nodeA->key & HIGH_PART_MASK) == (nodeB->key & HIGH_PART_MASK));
+	containers = (OKeyBitmapContainer *) palloc(sizeof(OKeyBitmapContainer) *
+												(bitmap->ncontainers + ngroups));
+	values = (uint16 *) palloc(sizeof(uint16) * Min(npending, OKB_CONTAINER_SIZE));
 
-		if (!nodeA->bitmap)
+	i = 0;
+	k = 0;
+	while (i < npending || k < bitmap->ncontainers)
+	{
+		uint64		high;
+		int			nvalues = 0;
+
+		if (i >= npending ||
+			(k < bitmap->ncontainers &&
+			 bitmap->containers[k].high < OKB_HIGH(pending[i])))
 		{
-			if (!nodeB->bitmap)
-			{
-				if (nodeA->key != nodeB->key)
-				{
-					OKeyBitmapRBTNode *removed_node;
-
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
-			}
-			else
-			{
-				int			offset = (nodeA->key & LOW_PART_MASK);
+			containers[n++] = bitmap->containers[k++];
+			continue;
+		}
 
-				if (!(nodeB->bitmap[offset >> 3] & (1 << (offset & 7))))
-				{
-					OKeyBitmapRBTNode *removed_node;
+		high = OKB_HIGH(pending[i]);
+		while (i < npending && OKB_HIGH(pending[i]) == high)
+			values[nvalues++] = OKB_LOW(pending[i++]);
 
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
-			}
+		if (k < bitmap->ncontainers && bitmap->containers[k].high == high)
+		{
+			containers[n] = bitmap->containers[k++];
+			okb_container_add(&containers[n], values, nvalues);
 		}
 		else
 		{
-			if (!nodeB->bitmap)
-			{
-				int			offset = (nodeB->key & LOW_PART_MASK);
-
-				if (!(nodeA->bitmap[offset >> 3] & (1 << (offset & 7))))
-				{
-					OKeyBitmapRBTNode *removed_node;
-
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
-				pfree(nodeA->bitmap);
-				nodeA->bitmap = NULL;
-				nodeA->key = nodeB->key;
-			}
-			else
-			{
-				int			i;
-				bool		empty = true;
-
-				for (i = 0; i < BITMAP_SIZE; i++)
-				{
-					nodeA->bitmap[i] &= nodeB->bitmap[i];
-					if (nodeA->bitmap[i] != 0)
-						empty = false;
-				}
-
-				if (empty)
-				{
-					OKeyBitmapRBTNode *removed_node;
-
-					removed_node = palloc0(sizeof(OKeyBitmapRBTNode));
-					memcpy(removed_node, nodeA, sizeof(OKeyBitmapRBTNode));
-					removing = lappend(removing, removed_node);
-					continue;
-				}
-			}
+			okb_container_init(&containers[n], high, values, nvalues);
 		}
+		n++;
 	}
 
-	foreach(lc, removing)
-	{
-		OKeyBitmapRBTNode *search_node;
-		OKeyBitmapRBTNode *removing_node;
+	if (bitmap->containers)
+		pfree(bitmap->containers);
+	bitmap->containers = containers;
+	bitmap->ncontainers = n;
+	bitmap->lastContainer = 0;
+	pfree(values);
 
-		search_node = (OKeyBitmapRBTNode *) lfirst(lc);
-		if (search_node->bitmap)
-			pfree(search_node->bitmap);
-		removing_node = (OKeyBitmapRBTNode *) rbt_find(a,
-													   (RBTNode *) search_node);
-		rbt_delete(a, (RBTNode *) removing_node);
-		pfree(search_node);
-	}
-	list_free(removing);
+	MemoryContextSwitchTo(oldcxt);
 }
 
-void
-o_keybitmap_union(RBTree *a, RBTree *b)
+/*
+ * Returns the index of the first container, whose high part is greater or
+ * equal to 'high'.
+ */
+static int
+okb_find_container(OKeyBitmap *bitmap, uint64 high)
 {
-	RBTreeIterator iterB;
-	OKeyBitmapRBTNode *nodeB;
+	int			low = 0,
+				up = bitmap->ncontainers;
+
+	okb_flush(bitmap);
 
-	rbt_begin_iterate(b, LeftRightWalk, &iterB);
-	while ((nodeB = (OKeyBitmapRBTNode *) rbt_iterate(&iterB)) != NULL)
+	/* the scans usually look up the keys in order */
+	if (bitmap->lastContainer < bitmap->ncontainers &&
+		bitmap->containers[bitmap->lastContainer].high == high)
+		return bitmap->lastContainer;
+
+	while (low < up)
 	{
-		bool		is_new;
+		int			mid = (low + up) / 2;
 
-		rbt_insert(a, &nodeB->rbtnode, &is_new);
+		if (bitmap->containers[mid].high < high)
+			low = mid + 1;
+		else
+			up = mid;
 	}
+	bitmap->lastContainer = low;
+	return low;
 }
 
-static int
-bm_rbt_comparator(const RBTNode *a, const RBTNode *b, void *arg)
+OKeyBitmap *
+o_keybitmap_create(void)
 {
-	const OKeyBitmapRBTNode *keyA = (OKeyBitmapRBTNode *) a;
-	const OKeyBitmapRBTNode *keyB = (OKeyBitmapRBTNode *) b;
-	uint64		va = keyA->key & HIGH_PART_MASK;
-	uint64		vb = keyB->key & HIGH_PART_MASK;
+	OKeyBitmap *bitmap = (OKeyBitmap *) palloc0(sizeof(OKeyBitmap));
 
-	return va > vb ? 1 : va < vb ? -1 : 0;
+	bitmap->mcxt = CurrentMemoryContext;
+	bitmap->pendingAllocated = OKB_PENDING_INITIAL;
+	bitmap->pending = (uint64 *) palloc(sizeof(uint64) * OKB_PENDING_INITIAL);
+	return bitmap;
 }
 
-static void
-node_make_bitmap(OKeyBitmapRBTNode *node)
+void
+o_keybitmap_insert(OKeyBitmap *bitmap, uint64 value)
 {
-	int			offset;
+	Assert(!bitmap->readOnly);
+	if (bitmap->npending >= bitmap->pendingAllocated)
+	{
+		if (bitmap->pendingAllocated >= OKB_PENDING_MAX)
+		{
+			okb_flush(bitmap);
+		}
+		else
+		{
+			bitmap->pendingAllocated *= 2;
+			bitmap->pending = (uint64 *) repalloc(bitmap->pending,
+												  sizeof(uint64) * bitmap->pendingAllocated);
+		}
+	}
+	bitmap->pending[bitmap->npending++] = value;
+}
 
-	node->bitmap = palloc0(BITMAP_SIZE);
-	offset = node->key & LOW_PART_MASK;
+bool
+o_keybitmap_test(OKeyBitmap *bitmap, uint64 value)
+{
+	int			i = okb_find_container(bitmap, OKB_HIGH(value));
 
-	node->bitmap[offset >> 3] |= 1 << (offset & 7);
-	node->key &= HIGH_PART_MASK;
+	return i < bitmap->ncontainers &&
+		bitmap->containers[i].high == OKB_HIGH(value) &&
+		okb_container_contains(&bitmap->containers[i], OKB_LOW(value));
 }
 
-static void
-bm_rbt_combiner(RBTNode *existing,
-				const RBTNode *newdata,
-				void *arg)
+/*
+ * Checks if the bitmap contains any key from 'low' inclusive to 'high'
+ * exclusive.
+ */
+bool
+o_keybitmap_range_is_valid(OKeyBitmap *bitmap, uint64 low, uint64 high)
 {
-	OKeyBitmapRBTNode *old = (OKeyBitmapRBTNode *) existing;
-	OKeyBitmapRBTNode *new = (OKeyBitmapRBTNode *) newdata;
+	bool		found;
+	uint64		next;
 
-	if (!old->bitmap)
+	next = o_keybitmap_get_next(bitmap, low, &found);
+	return found && next < high;
+}
+
+/*
+ * Returns the least key in the bitmap, which is greater or equal to 'prev'.
+ */
+uint64
+o_keybitmap_get_next(OKeyBitmap *bitmap, uint64 prev, bool *found)
+{
+	uint64		high = OKB_HIGH(prev);
+	int			i = okb_find_container(bitmap, high);
+
+	if (i < bitmap->ncontainers && bitmap->containers[i].high == high)
 	{
-		if (!new->bitmap && new->key == old->key)
-			return;
-		node_make_bitmap(old);
+		int			next = okb_container_next(&bitmap->containers[i],
+											  OKB_LOW(prev));
+
+		if (next >= 0)
+		{
+			*found = true;
+			return OKB_KEY(high, next);
+		}
+		i++;
 	}
 
-	if (!new->bitmap)
+	if (i < bitmap->ncontainers)
 	{
-		int			offset = new->key & LOW_PART_MASK;
+		OKeyBitmapContainer *c = &bitmap->containers[i];
 
-		old->bitmap[offset >> 3] |= 1 << (offset & 7);
+		*found = true;
+		return OKB_KEY(c->high, okb_container_next(c, 0));
 	}
-	else
+
+	*found = false;
+	return 0;
+}
+
+void
+o_keybitmap_free(OKeyBitmap *bitmap)
+{
+	int			i;
+
+	if (!bitmap->readOnly)
 	{
-		int			i;
+		for (i = 0; i < bitmap->ncontainers; i++)
+			okb_container_free(&bitmap->containers[i]);
+	}
+	if (bitmap->containers)
+		pfree(bitmap->containers);
+	if (bitmap->pending)
+		pfree(bitmap->pending);
+	pfree(bitmap);
+}
+
+bool
+o_keybitmap_is_empty(OKeyBitmap *bitmap)
+{
+	return bitmap->ncontainers == 0 && bitmap->npending == 0;
+}
+
+/*
+ * Leaves in 'a' only the keys contained in 'b'.
+ */
+void
+o_keybitmap_intersect(OKeyBitmap *a, OKeyBitmap *b)
+{
+	MemoryContext oldcxt;
+	int			i = 0,
+				j = 0,
+				n = 0;
+
+	Assert(!a->readOnly);
+	okb_flush(a);
+	okb_flush(b);
+
+	oldcxt = MemoryContextSwitchTo(a->mcxt);
+	while (i < a->ncontainers && j < b->ncontainers)
+	{
+		OKeyBitmapContainer *ca = &a->containers[i];
+		OKeyBitmapContainer *cb = &b->containers[j];
 
-		for (i = 0; i < BITMAP_SIZE; i++)
-			old->bitmap[i] |= new->bitmap[i];
+		if (ca->high < cb->high)
+		{
+			okb_container_free(ca);
+			i++;
+		}
+		else if (ca->high > cb->high)
+		{
+			j++;
+		}
+		else
+		{
+			okb_container_intersect(ca, cb);
+			if (ca->card > 0)
+				a->containers[n++] = *ca;
+			else
+				okb_container_free(ca);
+			i++;
+			j++;
+		}
 	}
+	for (; i < a->ncontainers; i++)
+		okb_container_free(&a->containers[i]);
+	a->ncontainers = n;
+	a->lastContainer = 0;
+	MemoryContextSwitchTo(oldcxt);
 }
 
-static RBTNode *
-bm_rbt_allocfunc(void *arg)
+/*
+ * Adds to 'a' all the keys contained in 'b'.
+ */
+void
+o_keybitmap_union(OKeyBitmap *a, OKeyBitmap *b)
 {
-	RBTNode    *result = palloc0(sizeof(OKeyBitmapRBTNode));
+	MemoryContext oldcxt;
+	OKeyBitmapContainer *containers;
+	int			i = 0,
+				j = 0,
+				n = 0;
+
+	Assert(!a->readOnly);
+	okb_flush(a);
+	okb_flush(b);
+	if (b->ncontainers == 0)
+		return;
+
+	oldcxt = MemoryContextSwitchTo(a->mcxt);
+	containers = (OKeyBitmapContainer *) palloc(sizeof(OKeyBitmapContainer) *
+												(a->ncontainers + b->ncontainers));
+	while (i < a->ncontainers || j < b->ncontainers)
+	{
+		if (j >= b->ncontainers ||
+			(i < a->ncontainers && a->containers[i].high < b->containers[j].high))
+		{
+			containers[n++] = a->containers[i++];
+		}
+		else if (i >= a->ncontainers ||
+				 a->containers[i].high > b->containers[j].high)
+		{
+			okb_container_copy(&containers[n++], &b->containers[j++]);
+		}
+		else
+		{
+			containers[n] = a->containers[i++];
+			okb_container_union(&containers[n++], &b->containers[j++]);
+		}
+	}
+	if (a->containers)
+		pfree(a->containers);
+	a->containers = containers;
+	a->ncontainers = n;
+	a->lastContainer = 0;
+	MemoryContextSwitchTo(oldcxt);
+}
 
-	return result;
+static Size
+okb_serialized_header_size(int ncontainers)
+{
+	return MAXALIGN(offsetof(OKeyBitmapSerialized, containers) +
+					sizeof(OKeyBitmapSerializedContainer) * ncontainers);
 }
 
-static void
-bm_rbt_freefunc(RBTNode *x, void *arg)
+/*
+ * Returns the size of the serialized bitmap.
+ */
+Size
+o_keybitmap_serialized_size(OKeyBitmap *bitmap)
+{
+	Size		size;
+	int			i;
+
+	okb_flush(bitmap);
+	size = okb_serialized_header_size(bitmap->ncontainers);
+	for (i = 0; i < bitmap->ncontainers; i++)
+		size += MAXALIGN(okb_container_data_size(&bitmap->containers[i]));
+	return size;
+}
+
+/*
+ * Serializes the bitmap into 'ptr', which should have
+ * o_keybitmap_serialized_size() bytes.
+ */
+void
+o_keybitmap_serialize(OKeyBitmap *bitmap, Pointer ptr)
+{
+	OKeyBitmapSerialized *serialized = (OKeyBitmapSerialized *) ptr;
+	Size		offset;
+	int			i;
+
+	okb_flush(bitmap);
+	serialized->ncontainers = bitmap->ncontainers;
+	offset = okb_serialized_header_size(bitmap->ncontainers);
+	for (i = 0; i < bitmap->ncontainers; i++)
+	{
+		OKeyBitmapContainer *c = &bitmap->containers[i];
+		OKeyBitmapSerializedContainer *sc = &serialized->containers[i];
+		Size		size = okb_container_data_size(c);
+
+		sc->high = c->high;
+		sc->offset = offset;
+		sc->card = c->card;
+		sc->n = c->n;
+		sc->type = c->type;
+		memcpy(ptr + offset, c->data, size);
+		offset += MAXALIGN(size);
+	}
+}
+
+/*
+ * Makes the read-only bitmap, which references the containers serialized
+ * at 'ptr'.  The serialized bitmap should outlive the result.
+ */
+OKeyBitmap *
+o_keybitmap_attach(Pointer ptr)
 {
-	pfree(x);
+	OKeyBitmapSerialized *serialized = (OKeyBitmapSerialized *) ptr;
+	OKeyBitmap *bitmap = (OKeyBitmap *) palloc0(sizeof(OKeyBitmap));
+	int			i;
+
+	bitmap->mcxt = CurrentMemoryContext;
+	bitmap->readOnly = true;
+	bitmap->ncontainers = serialized->ncontainers;
+	bitmap->containers = (OKeyBitmapContainer *) palloc(sizeof(OKeyBitmapContainer) *
+														Max(serialized->ncontainers, 1));
+	for (i = 0; i < serialized->ncontainers; i++)
+	{
+		OKeyBitmapContainer *c = &bitmap->containers[i];
+		OKeyBitmapSerializedContainer *sc = &serialized->containers[i];
+
+		c->high = sc->high;
+		c->data = ptr + sc->offset;
+		c->card = sc->card;
+		c->n = sc->n;
+		c->type = sc->type;
+	}
+	return bitmap;
 }
@@ -16,6 +16,7 @@
 #include "orioledb.h"
 
 #include "btree/btree.h"
+#include "btree/io.h"
 #include "btree/iterator.h"
 #include "btree/modify.h"
 #include "btree/undo.h"
@@ -32,15 +33,20 @@
 #include "utils/stopevent.h"
 
 #include "access/heapam.h"
+#include "access/relation.h"
 #include "access/tableam.h"
+#include "access/xact.h"
 #include "catalog/index.h"
 #include "catalog/storage.h"
 #include "commands/vacuum.h"
 #include "nodes/execnodes.h"
 #include "parser/parsetree.h"
+#include "replication/logicalworker.h"
 #include "storage/bufmgr.h"
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
 
 static OTableModifyResult o_tbl_indices_overwrite(OTableDescr *descr,
 												  OBTreeKeyBound *oldPkey,
@@ -62,6 +68,19 @@ static OTableModifyResult o_tbl_indices_delete(OTableDescr *descr,
 											   OModifyCallbackArg *arg);
 static void o_toast_insert_values(Relation rel, OTableDescr *descr,
 								  TupleTableSlot *slot, OXid oxid, CommitSeqNo csn);
+static TupleTableSlot *o_tbl_insert_internal(OTableDescr *descr,
+											 Relation relation,
+											 TupleTableSlot *slot,
+											 OXid oxid, CommitSeqNo csn,
+											 BTreeLocationHint *hint);
+static OBTreeModifyResult o_tbl_index_insert_internal(OTableDescr *descr,
+													  OIndexDescr *id,
+													  OTuple *own_tup,
+													  TupleTableSlot *slot,
+													  OXid oxid,
+													  CommitSeqNo csn,
+													  BTreeLocationHint *hint,
+													  BTreeModifyCallbackInfo *callbackInfo);
 static inline bool o_callback_is_modified(OXid oxid, CommitSeqNo csn, OTupleXactInfo xactInfo);
 static OBTreeModifyCallbackAction o_insert_callback(BTreeDescr *descr,
 													OTuple tup, OTuple *newtup,
@@ -265,9 +284,129 @@ delete_old_bridge_index_ctid(OTableDescr *descr, Relation relation,
 							   tss_orioledb_print_idx_key(bridge_slot, descr->bridge))));
 }
 
+/*
+ * Starts reading the evicted leaves of the secondary indices the tuples are
+ * going to be inserted into.  The secondary inserts come one by one after the
+ * primary insert, and each of them might wait for a random page read.  With
+ * the prefetch, these reads run concurrently.  The partial indices are
+ * skipped, because the tuple might not match the predicate.
+ */
+static void
+o_tbl_prefetch_secondary_leaves(OTableDescr *descr, TupleTableSlot **slots,
+								int ntuples)
+{
+	int			i,
+				j;
+
+	for (i = PrimaryIndexNumber + 1; i < descr->nIndices; i++)
+	{
+		OIndexDescr *id = descr->indices[i];
+
+		if (id->predicate != NIL)
+			continue;
+
+		o_btree_load_shmem(&id->desc);
+		for (j = 0; j < ntuples; j++)
+		{
+			OBTreeKeyBound key;
+
+			tts_orioledb_fill_key_bound(slots[j], id, &key);
+			prefetch_leaf_for_key(&id->desc, (Pointer) &key, BTreeKeyBound);
+		}
+	}
+}
+
 TupleTableSlot *
 o_tbl_insert(OTableDescr *descr, Relation relation,
 			 TupleTableSlot *slot, OXid oxid, CommitSeqNo csn)
+{
+	if (index_insert_prefetch && descr->nIndices > 1)
+	{
+		if (slot->tts_ops != descr->newTuple->tts_ops)
+		{
+			ExecCopySlot(descr->newTuple, slot);
+			slot = descr->newTuple;
+		}
+		o_tbl_prefetch_secondary_leaves(descr, &slot, 1);
+	}
+
+	return o_tbl_insert_internal(descr, relation, slot, oxid, csn, NULL);
+}
+
+typedef struct
+{
+	OBTreeKeyBound key;
+	int			slotIndex;
+} OMultiInsertItem;
+
+static int
+multi_insert_item_cmp(const void *a, const void *b, void *arg)
+{
+	const OMultiInsertItem *item1 = (const OMultiInsertItem *) a;
+	const OMultiInsertItem *item2 = (const OMultiInsertItem *) b;
+	BTreeDescr *desc = (BTreeDescr *) arg;
+	int			cmp;
+
+	cmp = o_btree_cmp(desc, (Pointer) &item1->key, BTreeKeyBound,
+					  (Pointer) &item2->key, BTreeKeyBound);
+	if (cmp != 0)
+		return cmp;
+
+	/* keep the original order of equal keys for duplicate reporting */
+	return item1->slotIndex - item2->slotIndex;
+}
+
+/*
+ * Inserts a batch of tuples into the table.
+ *
+ * Tuples are inserted into the primary index in the order of primary key.
+ * So, every next tuple is likely to go to the same leaf as the previous one,
+ * and we search for it from the previous leaf using location hint instead
+ * of descent from the root.  For ctid primary keys the ctids are assigned
+ * in ascending order, so the original order is already sorted.
+ */
+void
+o_tbl_multi_insert(OTableDescr *descr, Relation relation,
+				   TupleTableSlot **slots, int ntuples,
+				   OXid oxid, CommitSeqNo csn)
+{
+	OIndexDescr *primary = GET_PRIMARY(descr);
+	BTreeLocationHint hint = {OInvalidInMemoryBlkno, 0};
+	OMultiInsertItem *items;
+	int			i;
+
+	if (index_insert_prefetch && descr->nIndices > 1)
+		o_tbl_prefetch_secondary_leaves(descr, slots, ntuples);
+
+	if (primary->primaryIsCtid || ntuples < 2)
+	{
+		for (i = 0; i < ntuples; i++)
+			(void) o_tbl_insert_internal(descr, relation, slots[i],
+										 oxid, csn, &hint);
+		return;
+	}
+
+	items = (OMultiInsertItem *) palloc(sizeof(OMultiInsertItem) * ntuples);
+	for (i = 0; i < ntuples; i++)
+	{
+		tts_orioledb_fill_key_bound(slots[i], primary, &items[i].key);
+		items[i].slotIndex = i;
+	}
+
+	qsort_arg(items, ntuples, sizeof(OMultiInsertItem),
+			  multi_insert_item_cmp, &primary->desc);
+
+	for (i = 0; i < ntuples; i++)
+		(void) o_tbl_insert_internal(descr, relation,
+									 slots[items[i].slotIndex],
+									 oxid, csn, &hint);
+	pfree(items);
+}
+
+static TupleTableSlot *
+o_tbl_insert_internal(OTableDescr *descr, Relation relation,
+					  TupleTableSlot *slot, OXid oxid, CommitSeqNo csn,
+					  BTreeLocationHint *hint)
 {
 	OTableModifyResult mres;
 	OTuple		tup;
@@ -306,8 +445,9 @@ o_tbl_insert(OTableDescr *descr, Relation relation,
 								RelationGetRelationName(relation),
 								false);
 
-	mres.success = (o_tbl_index_insert(descr, descr->indices[0], NULL, slot,
-									   oxid, csn, &callbackInfo) == OBTreeModifyResultInserted);
+	mres.success = (o_tbl_index_insert_internal(descr, descr->indices[0],
+												NULL, slot, oxid, csn, hint,
+												&callbackInfo) == OBTreeModifyResultInserted);
 	if (!mres.success)
 	{
 		mres.failedIxNum = 0;
@@ -703,6 +843,8 @@ o_tbl_update(OTableDescr *descr, TupleTableSlot *slot,
 		int			attnum;
 		TupleTableSlot *newSlot;
 		Bitmapset  *changed_attrs = NULL;
+		EState	   *estate = NULL;
+		ExprContext *econtext = NULL;
 
 		/* not using simple reindex_relation here anymore, */
 		/* because we hold a lock on relation already */
@@ -751,36 +893,34 @@ o_tbl_update(OTableDescr *descr, TupleTableSlot *slot,
 
 				intresting = options && !options->orioledb_index;
 			}
+
+			/*
+			 * Skip this index-update if the predicate isn't satisfied.  The
+			 * predicate doesn't depend on the attribute, so it's checked once
+			 * per index, and all the predicates share the executor state.
+			 */
+			if (intresting && index_rel->rd_indpred != NIL)
+			{
+				ExprState  *predicate;
+
+				if (!estate)
+				{
+					estate = CreateExecutorState();
+					econtext = GetPerTupleExprContext(estate);
+					econtext->ecxt_scantuple = newSlot;
+				}
+
+				predicate = ExecPrepareQual(index_rel->rd_indpred, estate);
+				intresting = ExecQual(predicate, econtext);
+				ResetExprContext(econtext);
+			}
+
 			if (intresting)
 			{
 				for (attnum = 0; attnum < index_rel->rd_index->indnatts; attnum++)
 				{
 					AttrNumber	tbl_attnum = index_rel->rd_index->indkey.values[attnum];
 
-					if (index_rel->rd_indpred != NIL)
-					{
-						ExprState  *predicate;
-						EState	   *estate;
-						ExprContext *econtext;
-
-						estate = CreateExecutorState();
-						predicate = ExecPrepareQual(index_rel->rd_indpred, estate);
-
-						econtext = GetPerTupleExprContext(estate);
-						econtext->ecxt_scantuple = newSlot;
-
-						/*
-						 * Skip this index-update if the predicate isn't
-						 * satisfied
-						 */
-						if (!ExecQual(predicate, econtext))
-						{
-							FreeExecutorState(estate);
-							continue;
-						}
-						FreeExecutorState(estate);
-					}
-
 					if (AttributeNumberIsValid(tbl_attnum))
 					{
 						if (bms_is_member(tbl_attnum - 1, changed_attrs))
@@ -798,6 +938,9 @@ o_tbl_update(OTableDescr *descr, TupleTableSlot *slot,
 			}
 			index_close(index_rel, AccessExclusiveLock);
 		}
+
+		if (estate)
+			FreeExecutorState(estate);
 	}
 
 	tts_orioledb_toast(slot, descr);
@@ -862,9 +1005,10 @@ o_tbl_update(OTableDescr *descr, TupleTableSlot *slot,
 			if (mres.success &&
 				primary->desc.storageType == BTreeStoragePersistence)
 			{
-				OTuple		final_tup = tts_orioledb_form_tuple(slot, descr);
+				OTuple		old_tup = ((OTableSlot *) oldSlot)->tuple,
+							final_tup = tts_orioledb_form_tuple(slot, descr);
 
-				o_wal_update(&primary->desc, final_tup);
+				o_wal_update_delta(&primary->desc, old_tup, final_tup);
 			}
 		}
 		else if (mres.action == BTreeOperationDelete)
@@ -1046,6 +1190,95 @@ fill_key_bound(TupleTableSlot *slot, OIndexDescr *idx, OBTreeKeyBound *bound)
 	}
 }
 
+static OBTreeModifyCallbackAction
+o_update_included_callback(BTreeDescr *descr,
+						   OTuple tup, OTuple *newtup, OXid oxid,
+						   OTupleXactInfo xactInfo,
+						   UndoLocation location, RowLockMode *lock_mode,
+						   BTreeLocationHint *hint, void *arg)
+{
+	return OBTreeCallbackActionUpdate;
+}
+
+/* checks if INCLUDE fields of the secondary index tuples are modified */
+static bool
+o_included_fields_modified(OIndexDescr *id, TupleTableSlot *oldSlot,
+						   TupleTableSlot *newSlot)
+{
+	int			i;
+
+	for (i = id->nKeyFields; i < id->nKeyFields + id->nIncludedFields; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(id->leafTupdesc, i);
+
+		if (oldSlot->tts_isnull[i] || newSlot->tts_isnull[i])
+		{
+			if (oldSlot->tts_isnull[i] != newSlot->tts_isnull[i])
+				return true;
+		}
+		else if (!datumIsEqual(oldSlot->tts_values[i], newSlot->tts_values[i],
+							   att->attbyval, att->attlen))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Remembers the indexed attributes modified by the update of the row
+ * 'tupleid'.  The following orioledb_amupdate() calls skip the secondary
+ * indices not depending on them.
+ */
+void
+o_set_updated_attrs(OTableDescr *descr, Relation rel, Datum tupleid,
+					TupleTableSlot *oldSlot, TupleTableSlot *newSlot)
+{
+	MemoryContext mcxt;
+	Bitmapset  *indexAttrs;
+	Pointer		rowid = DatumGetPointer(tupleid);
+
+	bms_free(descr->updatedAttrs);
+	descr->updatedAttrs = NULL;
+	if (descr->updatedRowid)
+	{
+		pfree(descr->updatedRowid);
+		descr->updatedRowid = NULL;
+	}
+
+	if (!skip_unchanged_indices || descr->nIndices <= 1)
+		return;
+
+	indexAttrs = RelationGetIndexAttrBitmap(rel, INDEX_ATTR_BITMAP_ALL);
+
+	mcxt = MemoryContextSwitchTo(TopMemoryContext);
+	descr->updatedAttrs = tts_orioledb_modified_attrs(oldSlot, newSlot,
+													  indexAttrs);
+	descr->updatedRowid = (bytea *) palloc(VARSIZE_ANY(rowid));
+	memcpy(descr->updatedRowid, rowid, VARSIZE_ANY(rowid));
+	MemoryContextSwitchTo(mcxt);
+
+	bms_free(indexAttrs);
+}
+
+/*
+ * Checks if the secondary index needs to be updated for the row 'oldTupleid'.
+ * Returns false only if o_set_updated_attrs() was called for this row and
+ * none of the index fields was modified.
+ */
+bool
+o_index_update_is_needed(OTableDescr *descr, OIndexDescr *id,
+						 Datum oldTupleid)
+{
+	Pointer		rowid = DatumGetPointer(oldTupleid);
+
+	if (!descr->updatedRowid ||
+		VARSIZE_ANY(rowid) != VARSIZE_ANY(descr->updatedRowid) ||
+		memcmp(rowid, descr->updatedRowid, VARSIZE_ANY(rowid)) != 0)
+		return true;
+
+	return bms_overlap(descr->updatedAttrs, id->keyAttrs) ||
+		bms_overlap(descr->updatedAttrs, id->includedAttrs);
+}
+
 OTableModifyResult
 o_update_secondary_index(OIndexDescr *id,
 						 OIndexNumber ix_num,
@@ -1073,7 +1306,28 @@ o_update_secondary_index(OIndexDescr *id,
 	fill_key_bound(newSlot, id, &new_key);
 
 	if (is_keys_eq(&id->desc, &old_key, &new_key) && (old_valid == new_valid))
+	{
+		if (!new_valid || !o_included_fields_modified(id, oldSlot, newSlot))
+			return res;
+
+		/* Only INCLUDE fields are modified, replace the index tuple */
+		o_btree_check_size_of_tuple(o_tuple_size(new_ix_tup, &id->leafSpec),
+									id->name.data,
+									true);
+		o_btree_load_shmem(&id->desc);
+		callbackInfo.modifyCallback = o_update_included_callback;
+		res.success = o_btree_modify(&id->desc, BTreeOperationUpdate,
+									 new_ix_tup, BTreeKeyLeafTuple,
+									 (Pointer) &new_key, BTreeKeyBound,
+									 oxid, csn, RowLockNoKeyUpdate,
+									 NULL, &callbackInfo) == OBTreeModifyResultUpdated;
+		if (!res.success)
+		{
+			res.action = BTreeOperationUpdate;
+			res.failedIxNum = ix_num;
+		}
 		return res;
+	}
 
 	o_btree_load_shmem(&id->desc);
 	O_TUPLE_SET_NULL(nullTup);
@@ -1383,6 +1637,19 @@ o_tbl_index_insert(OTableDescr *descr,
 				   TupleTableSlot *slot,
 				   OXid oxid, CommitSeqNo csn,
 				   BTreeModifyCallbackInfo *callbackInfo)
+{
+	return o_tbl_index_insert_internal(descr, id, own_tup, slot, oxid, csn,
+									   NULL, callbackInfo);
+}
+
+static OBTreeModifyResult
+o_tbl_index_insert_internal(OTableDescr *descr,
+							OIndexDescr *id,
+							OTuple *own_tup,
+							TupleTableSlot *slot,
+							OXid oxid, CommitSeqNo csn,
+							BTreeLocationHint *hint,
+							BTreeModifyCallbackInfo *callbackInfo)
 {
 	BTreeDescr *bd = &id->desc;
 	OTuple		tup;
@@ -1419,7 +1686,7 @@ o_tbl_index_insert(OTableDescr *descr,
 								tup, BTreeKeyLeafTuple,
 								(Pointer) &knew, BTreeKeyBound,
 								oxid, csn, RowLockUpdate,
-								NULL, callbackInfo) == OBTreeModifyResultInserted;
+								hint, callbackInfo) == OBTreeModifyResultInserted;
 	else
 		result = o_btree_insert_unique(bd, tup, BTreeKeyLeafTuple,
 									   (Pointer) &knew, BTreeKeyBound,
@@ -2042,3 +2309,124 @@ o_truncate_table(ORelOids oids)
 
 	pfree(treeOids);
 }
+
+/*
+ * Inserts received by the logical replication apply worker are buffered per
+ * relation and then inserted by o_tbl_multi_insert() in the primary key order.
+ * The buffer is flushed before the worker reads or modifies any OrioleDB
+ * table in another way, when the worker switches to another relation, and
+ * before the commit.  Thus, the worker never misses its own inserts.
+ */
+static Oid	applyBufferRelid = InvalidOid;
+static TupleTableSlot **applyBufferSlots = NULL;
+static int	applyBufferCount = 0;
+static int	applyBufferSize = 0;
+static MemoryContext applyBufferContext = NULL;
+
+static bool
+o_apply_can_buffer_insert(Relation relation, OTableDescr *descr)
+{
+	if (logical_apply_batch_size <= 1 || !IsLogicalWorker() ||
+		IsLogicalParallelApplyWorker())
+		return false;
+
+	/*
+	 * Savepoints would make the buffered inserts belong to the wrong
+	 * subtransaction.  The after row triggers and bridged indexes need the
+	 * inserted tuple right away.
+	 */
+	if (GetCurrentTransactionNestLevel() != 1 || descr->bridge ||
+		(relation->trigdesc && relation->trigdesc->trig_insert_after_row))
+		return false;
+
+	return true;
+}
+
+/*
+ * Buffers the insert of the apply worker.  Returns false if the insert must
+ * be done right away.
+ */
+bool
+o_apply_buffer_insert(Relation relation, TupleTableSlot *slot)
+{
+	OTableDescr *descr = relation_get_descr(relation);
+	MemoryContext oldcxt;
+
+	if (!o_apply_can_buffer_insert(relation, descr))
+	{
+		o_apply_flush_inserts();
+		return false;
+	}
+
+	if (applyBufferCount > 0 &&
+		applyBufferRelid != RelationGetRelid(relation))
+		o_apply_flush_inserts();
+
+	if (!applyBufferContext)
+	{
+		applyBufferContext = AllocSetContextCreate(TopTransactionContext,
+												   "orioledb apply insert buffer",
+												   ALLOCSET_DEFAULT_SIZES);
+		applyBufferSize = logical_apply_batch_size;
+		applyBufferSlots = (TupleTableSlot **)
+			MemoryContextAlloc(applyBufferContext,
+							   sizeof(TupleTableSlot *) * applyBufferSize);
+	}
+
+	oldcxt = MemoryContextSwitchTo(applyBufferContext);
+	applyBufferSlots[applyBufferCount] = table_slot_create(relation, NULL);
+	ExecCopySlot(applyBufferSlots[applyBufferCount], slot);
+	MemoryContextSwitchTo(oldcxt);
+	applyBufferRelid = RelationGetRelid(relation);
+	applyBufferCount++;
+
+	if (applyBufferCount >= applyBufferSize)
+		o_apply_flush_inserts();
+
+	return true;
+}
+
+/*
+ * Inserts the buffered tuples of the apply worker.
+ */
+void
+o_apply_flush_inserts(void)
+{
+	Relation	relation;
+	OTableDescr *descr;
+	OSnapshot	oSnapshot;
+	OXid		oxid;
+	int			count = applyBufferCount;
+	int			i;
+
+	if (count == 0)
+		return;
+
+	/* The buffer is empty even if the insert fails */
+	applyBufferCount = 0;
+
+	/* The apply worker holds the lock on the relation till the commit */
+	relation = relation_open(applyBufferRelid, NoLock);
+	descr = relation_get_descr(relation);
+	fill_current_oxid_osnapshot(&oxid, &oSnapshot);
+	o_tbl_multi_insert(descr, relation, applyBufferSlots, count,
+					   oxid, oSnapshot.csn);
+	relation_close(relation, NoLock);
+
+	for (i = 0; i < count; i++)
+		ExecDropSingleTupleTableSlot(applyBufferSlots[i]);
+}
+
+/*
+ * Forgets the buffer at the transaction end.  The memory goes away with the
+ * transaction context.
+ */
+void
+o_apply_discard_inserts(void)
+{
+	applyBufferRelid = InvalidOid;
+	applyBufferSlots = NULL;
+	applyBufferCount = 0;
+	applyBufferSize = 0;
+	applyBufferContext = NULL;
+}
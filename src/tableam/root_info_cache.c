@@ -0,0 +1,227 @@
+/*-------------------------------------------------------------------------
+ *
+ * root_info_cache.c
+ *		Lock-free shared cache in front of the shared root info tree.
+ *
+ * Every backend finds the in-memory root and meta pages of a tree in the
+ * SYS_TREES_SHARED_ROOT_INFO tree the first time it touches the tree.  With
+ * many relations, this descent becomes noticeable.  The cache keeps the root
+ * infos of the recently found trees in a direct-mapped array in the shared
+ * memory.  The entries are guarded by the sequence counters: the writer makes
+ * the counter odd while changing the entry, and the reader retries the tree
+ * search if the counter was odd or changed during its read.  So readers never
+ * wait.
+ *
+ * The root info is dropped from the tree on eviction or removal of the tree,
+ * and o_drop_shared_root_info() invalidates the entry both before and after
+ * the deletion.  The invalidation also advances the generation counter.  The
+ * backend inserts the root info found in the tree only if the generation is
+ * the same as before the tree search, so it can't put back the root info,
+ * which was deleted concurrently.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/tableam/root_info_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "tableam/root_info_cache.h"
+
+#include "common/hashfn.h"
+#include "port/atomics.h"
+#include "storage/s_lock.h"
+
+typedef struct
+{
+	/* odd while the entry is being changed */
+	pg_atomic_uint32 seq;
+	/* InvalidOid datoid for the empty entry */
+	SharedRootInfoKey key;
+	BTreeRootInfo rootInfo;
+} RootInfoCacheEntry;
+
+typedef struct
+{
+	pg_atomic_uint64 generation;
+	uint64		nentries;
+} RootInfoCacheMeta;
+
+static RootInfoCacheMeta *rootInfoCacheMeta = NULL;
+static RootInfoCacheEntry *rootInfoCacheEntries = NULL;
+
+static uint64
+root_info_cache_nentries(void)
+{
+	return root_info_cache_size / sizeof(RootInfoCacheEntry);
+}
+
+Size
+root_info_cache_shmem_needs(void)
+{
+	Size		size;
+
+	size = CACHELINEALIGN(sizeof(RootInfoCacheMeta));
+	size = add_size(size, mul_size(root_info_cache_nentries(),
+								   sizeof(RootInfoCacheEntry)));
+	return size;
+}
+
+void
+root_info_cache_shmem_init(Pointer ptr, bool found)
+{
+	rootInfoCacheMeta = (RootInfoCacheMeta *) ptr;
+	rootInfoCacheEntries = (RootInfoCacheEntry *)
+		(ptr + CACHELINEALIGN(sizeof(RootInfoCacheMeta)));
+
+	if (!found)
+	{
+		uint64		i;
+
+		pg_atomic_init_u64(&rootInfoCacheMeta->generation, 0);
+		rootInfoCacheMeta->nentries = root_info_cache_nentries();
+
+		for (i = 0; i < rootInfoCacheMeta->nentries; i++)
+		{
+			RootInfoCacheEntry *entry = &rootInfoCacheEntries[i];
+
+			pg_atomic_init_u32(&entry->seq, 0);
+			entry->key.datoid = InvalidOid;
+			entry->key.relnode = InvalidOid;
+		}
+	}
+}
+
+static inline RootInfoCacheEntry *
+root_info_cache_get_entry(SharedRootInfoKey *key)
+{
+	uint32		hash;
+
+	if (!rootInfoCacheMeta || rootInfoCacheMeta->nentries == 0)
+		return NULL;
+
+	hash = hash_bytes((unsigned char *) key, sizeof(SharedRootInfoKey));
+	return &rootInfoCacheEntries[hash % rootInfoCacheMeta->nentries];
+}
+
+static inline bool
+root_info_cache_key_equal(SharedRootInfoKey *key1, SharedRootInfoKey *key2)
+{
+	return key1->datoid == key2->datoid && key1->relnode == key2->relnode;
+}
+
+/*
+ * Tries to find the root info of the tree in the cache without locking.
+ */
+bool
+root_info_cache_lookup(SharedRootInfoKey *key, BTreeRootInfo *rootInfo)
+{
+	RootInfoCacheEntry *entry = root_info_cache_get_entry(key);
+	uint32		seq;
+	bool		match;
+
+	if (!entry)
+		return false;
+
+	seq = pg_atomic_read_u32(&entry->seq);
+	if (seq & 1)
+		return false;
+	pg_read_barrier();
+
+	match = root_info_cache_key_equal(&entry->key, key);
+	if (match)
+		*rootInfo = entry->rootInfo;
+
+	pg_read_barrier();
+	if (pg_atomic_read_u32(&entry->seq) != seq)
+		return false;
+
+	return match;
+}
+
+/*
+ * Returns the generation to be passed to root_info_cache_insert().  Must be
+ * taken before the search in the shared root info tree.
+ */
+uint64
+root_info_cache_get_generation(void)
+{
+	if (!rootInfoCacheMeta)
+		return 0;
+	return pg_atomic_read_u64(&rootInfoCacheMeta->generation);
+}
+
+/*
+ * Puts the root info found in the tree to the cache unless any root info was
+ * invalidated since the 'generation' was taken.  Never waits: gives up if the
+ * entry is being changed by someone else.
+ */
+void
+root_info_cache_insert(SharedRootInfoKey *key, BTreeRootInfo *rootInfo,
+					   uint64 generation)
+{
+	RootInfoCacheEntry *entry = root_info_cache_get_entry(key);
+	uint32		seq;
+
+	if (!entry)
+		return;
+
+	seq = pg_atomic_read_u32(&entry->seq);
+	if ((seq & 1) ||
+		!pg_atomic_compare_exchange_u32(&entry->seq, &seq, seq + 1))
+		return;
+
+	/*
+	 * The invalidation advances the generation before taking the entry, so
+	 * either we see the new generation here, or the invalidation waits for
+	 * us and clears the entry afterwards.
+	 */
+	if (pg_atomic_read_u64(&rootInfoCacheMeta->generation) == generation)
+	{
+		entry->key = *key;
+		entry->rootInfo = *rootInfo;
+	}
+
+	pg_write_barrier();
+	pg_atomic_write_u32(&entry->seq, seq + 2);
+}
+
+/*
+ * Removes the root info of the tree from the cache.
+ */
+void
+root_info_cache_invalidate(SharedRootInfoKey *key)
+{
+	RootInfoCacheEntry *entry = root_info_cache_get_entry(key);
+	SpinDelayStatus status;
+	uint32		seq;
+
+	if (!entry)
+		return;
+
+	pg_atomic_fetch_add_u64(&rootInfoCacheMeta->generation, 1);
+
+	init_local_spin_delay(&status);
+	while (true)
+	{
+		seq = pg_atomic_read_u32(&entry->seq);
+		if (!(seq & 1) &&
+			pg_atomic_compare_exchange_u32(&entry->seq, &seq, seq + 1))
+			break;
+		perform_spin_delay(&status);
+	}
+	finish_spin_delay(&status);
+
+	if (root_info_cache_key_equal(&entry->key, key))
+	{
+		entry->key.datoid = InvalidOid;
+		entry->key.relnode = InvalidOid;
+	}
+
+	pg_write_barrier();
+	pg_atomic_write_u32(&entry->seq, seq + 2);
+}
@@ -30,6 +30,8 @@
 
 #include "access/relation.h"
 #include "access/table.h"
+#include "catalog/pg_am.h"
+#include "commands/defrem.h"
 #include "common/hashfn.h"
 #include "executor/executor.h"
 #include "executor/nodeIndexscan.h"
@@ -43,6 +45,7 @@
 #include "optimizer/plancat.h"
 #include "optimizer/planmain.h"
 #include "parser/parsetree.h"
+#include "utils/fmgroids.h"
 #include "utils/json.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
@@ -82,6 +85,7 @@ typedef struct OCustomScanState
 } OCustomScanState;
 
 set_rel_pathlist_hook_type old_set_rel_pathlist_hook = NULL;
+ExecutorStart_hook_type prev_ExecutorStart_hook = NULL;
 OEACallsCounters *ea_counters = NULL;
 
 /* custom scan */
@@ -94,6 +98,17 @@ static void o_end_custom_scan(CustomScanState *node);
 static void o_rescan_custom_scan(CustomScanState *node);
 static void o_explain_custom_scan(CustomScanState *node, List *ancestors,
 								  ExplainState *es);
+static Size o_estimate_dsm_custom_scan(CustomScanState *node,
+									   ParallelContext *pcxt);
+static void o_initialize_dsm_custom_scan(CustomScanState *node,
+										 ParallelContext *pcxt,
+										 void *coordinate);
+static void o_reinitialize_dsm_custom_scan(CustomScanState *node,
+										   ParallelContext *pcxt,
+										   void *coordinate);
+static void o_initialize_worker_custom_scan(CustomScanState *node,
+											shm_toc *toc,
+											void *coordinate);
 static Node *o_create_custom_scan_state(CustomScan *cscan);
 
 static CustomPathMethods o_path_methods =
@@ -117,10 +132,10 @@ static CustomExecMethods o_scan_exec_methods =
 	o_rescan_custom_scan,
 	NULL,
 	NULL,
-	NULL,
-	NULL,
-	NULL,
-	NULL,
+	o_estimate_dsm_custom_scan,
+	o_initialize_dsm_custom_scan,
+	o_reinitialize_dsm_custom_scan,
+	o_initialize_worker_custom_scan,
 	NULL,
 	o_explain_custom_scan
 };
@@ -321,6 +336,124 @@ orioledb_set_plain_rel_pathlist_hook(PlannerInfo *root, RelOptInfo *rel,
 	return result;
 }
 
+/*
+ * Converts the qual clause "Var op Const" to the scan key.  Only the strict,
+ * immutable and leakproof operators are converted, because the scan keys are
+ * evaluated before the other quals, including the security barrier ones.
+ */
+static bool
+o_qual_to_scan_key(Expr *clause, Index scanrelid, ScanKey key)
+{
+	OpExpr	   *opexpr;
+	Var		   *var;
+	Const	   *con;
+	Oid			opclass;
+	StrategyNumber strategy = InvalidStrategy;
+
+	if (!IsA(clause, OpExpr))
+		return false;
+
+	opexpr = (OpExpr *) clause;
+	if (list_length(opexpr->args) != 2 || opexpr->opretset)
+		return false;
+
+	var = (Var *) linitial(opexpr->args);
+	con = (Const *) lsecond(opexpr->args);
+	if (!IsA(var, Var) || !IsA(con, Const))
+		return false;
+
+	if (var->varno != scanrelid || var->varlevelsup != 0 ||
+		var->varattno <= 0 || con->constisnull)
+		return false;
+
+	if (!func_strict(opexpr->opfuncid) ||
+		func_volatile(opexpr->opfuncid) != PROVOLATILE_IMMUTABLE ||
+		!get_func_leakproof(opexpr->opfuncid))
+		return false;
+
+	/*
+	 * The strategy of the operator in the default B-tree opfamily of the
+	 * column type lets the zone map compare the key with the column
+	 * summaries.
+	 */
+	opclass = GetDefaultOpClass(var->vartype, BTREE_AM_OID);
+	if (OidIsValid(opclass))
+		strategy = get_op_opfamily_strategy(opexpr->opno,
+											get_opclass_family(opclass));
+
+	ScanKeyEntryInitialize(key, 0, var->varattno, strategy,
+						   strategy != InvalidStrategy ? con->consttype : InvalidOid,
+						   opexpr->inputcollid,
+						   opexpr->opfuncid, con->constvalue);
+	return true;
+}
+
+/*
+ * Begins the scans of the sequential scan nodes over orioledb tables with
+ * the scan keys made of their simple quals.  So that the B-tree scan skips
+ * the tuples not matching the quals before they are copied out of the leaf
+ * pages and formed into the slots.  The quals are still evaluated by the
+ * executor, the scan keys are only a prefilter.  The tuples rejected by the
+ * scan keys are counted as filtered out by the node.
+ */
+static bool
+o_seq_scan_pushdown_walker(PlanState *planstate, void *context)
+{
+	if (IsA(planstate, SeqScanState) && !planstate->plan->parallel_aware)
+	{
+		ScanState  *node = (ScanState *) planstate;
+		Index		scanrelid = ((Scan *) planstate->plan)->scanrelid;
+		EState	   *estate = planstate->state;
+		ScanKey		keys;
+		int			nkeys = 0;
+		ListCell   *lc;
+
+		if (node->ss_currentScanDesc == NULL &&
+			node->ss_currentRelation != NULL &&
+			is_orioledb_rel(node->ss_currentRelation) &&
+			planstate->plan->qual != NIL)
+		{
+			MemoryContext oldcxt = MemoryContextSwitchTo(estate->es_query_cxt);
+
+			keys = (ScanKey) palloc(sizeof(ScanKeyData) *
+									list_length(planstate->plan->qual));
+			foreach(lc, planstate->plan->qual)
+			{
+				if (o_qual_to_scan_key((Expr *) lfirst(lc), scanrelid,
+									   &keys[nkeys]))
+					nkeys++;
+			}
+
+			if (nkeys > 0)
+			{
+				node->ss_currentScanDesc = table_beginscan(node->ss_currentRelation,
+														   estate->es_snapshot,
+														   nkeys, keys);
+				orioledb_scan_set_planstate(node->ss_currentScanDesc,
+											planstate);
+			}
+			pfree(keys);
+			MemoryContextSwitchTo(oldcxt);
+		}
+	}
+
+	return planstate_tree_walker(planstate, o_seq_scan_pushdown_walker,
+								 context);
+}
+
+void
+orioledb_executor_start_hook(QueryDesc *queryDesc, int eflags)
+{
+	if (prev_ExecutorStart_hook)
+		prev_ExecutorStart_hook(queryDesc, eflags);
+	else
+		standard_ExecutorStart(queryDesc, eflags);
+
+	if (seq_scan_qual_pushdown && !(eflags & EXEC_FLAG_EXPLAIN_ONLY) &&
+		queryDesc->planstate)
+		(void) o_seq_scan_pushdown_walker(queryDesc->planstate, NULL);
+}
+
 /*
  * Removes all index and base relation scan paths for a orioledb TableAm table.
  */
@@ -394,11 +527,18 @@ orioledb_set_rel_pathlist_hook(PlannerInfo *root, RelOptInfo *rel,
 			{
 				Path	   *path = list_nth(rel->partial_pathlist, i);
 
-				/*
-				 * TODO: Remove when parallel bitmap heap scan will be
-				 * implemented
-				 */
-				if (!IsA(path, Path))
+				if ((IsA(path, BitmapHeapPath) && enable_parallel_bitmap_scan) ||
+					(IsA(path, IndexPath) && enable_parallel_index_scan))
+				{
+					Path	   *custom_path = transform_path(path, descr);
+
+					rel->partial_pathlist = list_delete_nth_cell(rel->partial_pathlist, i);
+					rel->partial_pathlist = list_insert_nth(rel->partial_pathlist, i,
+															custom_path);
+					i++;
+				}
+
+				else if (!IsA(path, Path))
 					rel->partial_pathlist = list_delete_nth_cell(rel->partial_pathlist, i);
 				else
 					i++;
@@ -544,6 +684,7 @@ o_create_custom_scan_state(CustomScan *cscan)
 		ix_plan_state->ostate.ixNum = intVal(lsecond(cscan->custom_private));
 		ix_plan_state->ostate.scanDir = intVal(lthird(cscan->custom_private));
 		ix_plan_state->ostate.iterator = NULL;
+		ix_plan_state->ostate.keysLookup = NULL;
 		ix_plan_state->ostate.curKeyRangeIsLoaded = false;
 		ix_plan_state->ostate.curKeyRange.empty = true;
 		ix_plan_state->ostate.curKeyRange.low.n_row_keys = 0;
@@ -606,7 +747,8 @@ o_begin_custom_scan(CustomScanState *node, EState *estate, int eflags)
 	ocstate->o_plan_state->plan_state = &node->ss.ps;
 
 	if (is_explain_analyze(ocstate->o_plan_state->plan_state))
-		eanalyze_counters_init(&ocstate->eaCounters, descr);
+		eanalyze_counters_init(&ocstate->eaCounters, descr,
+							   (estate->es_instrument & INSTRUMENT_TIMER) != 0);
 
 	if (ocstate->o_plan_state->type == O_IndexPlan)
 	{
@@ -656,7 +798,8 @@ o_begin_custom_scan(CustomScanState *node, EState *estate, int eflags)
 											   descr->nIndices);
 			for (i = 0; i < descr->nIndices; i++)
 			{
-				eanalyze_counters_init(&bitmap_state->eaCounters[i], descr);
+				eanalyze_counters_init(&bitmap_state->eaCounters[i], descr,
+									   (estate->es_instrument & INSTRUMENT_TIMER) != 0);
 			}
 		}
 
@@ -739,6 +882,9 @@ o_exec_custom_scan(CustomScanState *node)
 			}
 		}
 
+		if (ix_plan_state->ostate.pscan)
+			ix_plan_state->ostate.dsa = node->ss.ps.state->es_query_dsa;
+
 		slot = o_exec_fetch(&ix_plan_state->ostate, &node->ss);
 	}
 	else if (ocstate->o_plan_state->type == O_BitmapHeapPlan)
@@ -800,10 +946,16 @@ o_rescan_custom_scan(CustomScanState *node)
 		{
 			MemoryContextReset(ix_plan_state->ostate.cxt);
 		}
-		else if (ix_plan_state->ostate.iterator != NULL)
+		else
 		{
-			btree_iterator_free(ix_plan_state->ostate.iterator);
+			if (ix_plan_state->ostate.iterator != NULL)
+				btree_iterator_free(ix_plan_state->ostate.iterator);
+			if (ix_plan_state->ostate.keysLookup != NULL)
+				o_btree_keys_lookup_free(ix_plan_state->ostate.keysLookup);
+			if (ix_plan_state->ostate.chunkKeys != NULL)
+				pfree(ix_plan_state->ostate.chunkKeys);
 		}
+		o_parallel_index_scan_reset(&ix_plan_state->ostate);
 
 		ix_plan_state->ostate.curKeyRangeIsLoaded = false;
 		ix_plan_state->ostate.numPrefixExactKeys = o_get_num_prefix_exact_keys(ix_plan_state->iss_ScanKeys, ix_plan_state->iss_NumScanKeys);
@@ -811,6 +963,7 @@ o_rescan_custom_scan(CustomScanState *node)
 		ix_plan_state->ostate.curKeyRange.low.n_row_keys = 0;
 		ix_plan_state->ostate.curKeyRange.high.n_row_keys = 0;
 		ix_plan_state->ostate.iterator = NULL;
+		ix_plan_state->ostate.keysLookup = NULL;
 	}
 	else if (ocstate->o_plan_state->type == O_BitmapHeapPlan)
 	{
@@ -847,6 +1000,8 @@ o_end_custom_scan(CustomScanState *node)
 			btree_iterator_free(ix_plan_state->ostate.iterator);
 		MemoryContextDelete(ix_plan_state->ostate.cxt);
 		ix_plan_state->ostate.cxt = NULL;
+		o_scan_tuples_context_release(ix_plan_state->ostate.tupleCxt);
+		ix_plan_state->ostate.tupleCxt = NULL;
 	}
 	else if (ocstate->o_plan_state->type == O_BitmapHeapPlan)
 	{
@@ -865,6 +1020,97 @@ o_end_custom_scan(CustomScanState *node)
 	ea_counters = NULL;
 }
 
+/*
+ * Parallel custom scan support.  The index scans and the bitmap heap scans
+ * can be planned as parallel aware.
+ */
+static Size
+o_estimate_dsm_custom_scan(CustomScanState *node, ParallelContext *pcxt)
+{
+	OCustomScanState *ocstate = (OCustomScanState *) node;
+
+	if (ocstate->o_plan_state->type == O_IndexPlan)
+		return sizeof(OParallelIndexScanData);
+
+	Assert(ocstate->o_plan_state->type == O_BitmapHeapPlan);
+	return sizeof(OParallelBitmapScanData);
+}
+
+static void
+o_initialize_dsm_custom_scan(CustomScanState *node, ParallelContext *pcxt,
+							 void *coordinate)
+{
+	OCustomScanState *ocstate = (OCustomScanState *) node;
+
+	if (ocstate->o_plan_state->type == O_IndexPlan)
+	{
+		OIndexPlanState *ix_plan_state =
+			(OIndexPlanState *) ocstate->o_plan_state;
+
+		ix_plan_state->ostate.pscan = (OParallelIndexScanData *) coordinate;
+		o_parallel_index_scan_initialize(ix_plan_state->ostate.pscan);
+	}
+	else
+	{
+		OBitmapHeapPlanState *bitmap_state =
+			(OBitmapHeapPlanState *) ocstate->o_plan_state;
+
+		Assert(ocstate->o_plan_state->type == O_BitmapHeapPlan);
+		bitmap_state->pstate = (OParallelBitmapScanData *) coordinate;
+		o_parallel_bitmap_scan_initialize(bitmap_state->pstate,
+										  node->ss.ss_currentRelation);
+	}
+}
+
+static void
+o_reinitialize_dsm_custom_scan(CustomScanState *node, ParallelContext *pcxt,
+							   void *coordinate)
+{
+	OCustomScanState *ocstate = (OCustomScanState *) node;
+	dsa_area   *dsa = node->ss.ps.state->es_query_dsa;
+
+	if (ocstate->o_plan_state->type == O_IndexPlan)
+	{
+		OIndexPlanState *ix_plan_state =
+			(OIndexPlanState *) ocstate->o_plan_state;
+
+		o_parallel_index_scan_reinitialize(ix_plan_state->ostate.pscan, dsa);
+	}
+	else
+	{
+		OBitmapHeapPlanState *bitmap_state =
+			(OBitmapHeapPlanState *) ocstate->o_plan_state;
+
+		Assert(ocstate->o_plan_state->type == O_BitmapHeapPlan);
+		o_parallel_bitmap_scan_reinitialize(bitmap_state->pstate,
+											node->ss.ss_currentRelation,
+											dsa);
+	}
+}
+
+static void
+o_initialize_worker_custom_scan(CustomScanState *node, shm_toc *toc,
+								void *coordinate)
+{
+	OCustomScanState *ocstate = (OCustomScanState *) node;
+
+	if (ocstate->o_plan_state->type == O_IndexPlan)
+	{
+		OIndexPlanState *ix_plan_state =
+			(OIndexPlanState *) ocstate->o_plan_state;
+
+		ix_plan_state->ostate.pscan = (OParallelIndexScanData *) coordinate;
+	}
+	else
+	{
+		OBitmapHeapPlanState *bitmap_state =
+			(OBitmapHeapPlanState *) ocstate->o_plan_state;
+
+		Assert(ocstate->o_plan_state->type == O_BitmapHeapPlan);
+		bitmap_state->pstate = (OParallelBitmapScanData *) coordinate;
+	}
+}
+
 typedef struct OExplainContext
 {
 	List	   *ancestors;
@@ -1109,3 +1355,272 @@ o_explain_custom_scan(CustomScanState *node, List *ancestors, ExplainState *es)
 	if (is_explain_analyze(ocstate->o_plan_state->plan_state))
 		eanalyze_counters_explain(descr, &ocstate->eaCounters, es);
 }
+
+/*
+ * Count pushdown.
+ *
+ * The single-table query computing only count(*) without quals is answered
+ * by the count scan.  It walks the leaves of the primary tree like the
+ * sequential scan does, but counts the visible tuple versions in place
+ * instead of copying them and forming the slots.
+ */
+typedef struct OCountScanState
+{
+	CustomScanState css;
+	Relation	relation;
+	bool		done;
+} OCountScanState;
+
+create_upper_paths_hook_type prev_create_upper_paths_hook = NULL;
+
+static Plan *o_count_plan_custom_path(PlannerInfo *root, RelOptInfo *rel,
+									  CustomPath *best_path, List *tlist,
+									  List *clauses, List *custom_plans);
+static Node *o_count_create_custom_scan_state(CustomScan *cscan);
+static void o_count_begin_custom_scan(CustomScanState *node, EState *estate,
+									  int eflags);
+static TupleTableSlot *o_count_exec_custom_scan(CustomScanState *node);
+static void o_count_end_custom_scan(CustomScanState *node);
+static void o_count_rescan_custom_scan(CustomScanState *node);
+static void o_count_explain_custom_scan(CustomScanState *node, List *ancestors,
+										ExplainState *es);
+
+static CustomPathMethods o_count_path_methods =
+{
+	.CustomName = "o_count_path",
+	.PlanCustomPath = o_count_plan_custom_path
+};
+
+CustomScanMethods o_count_scan_methods =
+{
+	"o_count_scan",
+	o_count_create_custom_scan_state
+};
+
+static CustomExecMethods o_count_scan_exec_methods =
+{
+	.CustomName = "o_count_exec_scan",
+	.BeginCustomScan = o_count_begin_custom_scan,
+	.ExecCustomScan = o_count_exec_custom_scan,
+	.EndCustomScan = o_count_end_custom_scan,
+	.ReScanCustomScan = o_count_rescan_custom_scan,
+	.ExplainCustomScan = o_count_explain_custom_scan
+};
+
+static bool
+o_is_count_star(Expr *expr)
+{
+	Aggref	   *aggref;
+
+	if (!IsA(expr, Aggref))
+		return false;
+
+	aggref = (Aggref *) expr;
+	return aggref->aggfnoid == F_COUNT_ && aggref->aggstar &&
+		aggref->aggfilter == NULL && aggref->aggdistinct == NIL &&
+		aggref->aggorder == NIL && aggref->agglevelsup == 0 &&
+		aggref->aggsplit == AGGSPLIT_SIMPLE;
+}
+
+/*
+ * Adds the count scan path to the grouping relation if the query only
+ * computes count(*) over an OrioleDB table without quals.
+ */
+void
+orioledb_create_upper_paths_hook(PlannerInfo *root, UpperRelationKind stage,
+								 RelOptInfo *input_rel, RelOptInfo *output_rel,
+								 void *extra)
+{
+	Query	   *parse = root->parse;
+	PathTarget *target = root->upper_targets[UPPERREL_GROUP_AGG];
+	RangeTblEntry *rte;
+	Relation	relation;
+	bool		isOrioledb;
+	ListCell   *lc;
+	CustomPath *path;
+	Cost		spc_seq_page_cost;
+
+	if (prev_create_upper_paths_hook)
+		prev_create_upper_paths_hook(root, stage, input_rel, output_rel, extra);
+
+	if (!enable_count_pushdown || stage != UPPERREL_GROUP_AGG)
+		return;
+
+	if (parse->groupClause != NIL || parse->groupingSets != NIL ||
+		root->hasHavingQual || target == NULL)
+		return;
+
+	if (input_rel->reloptkind != RELOPT_BASEREL ||
+		input_rel->rtekind != RTE_RELATION ||
+		input_rel->baserestrictinfo != NIL)
+		return;
+
+	rte = planner_rt_fetch(input_rel->relid, root);
+	if (rte->inh || rte->tablesample ||
+		(rte->relkind != RELKIND_RELATION && rte->relkind != RELKIND_MATVIEW))
+		return;
+
+	foreach(lc, target->exprs)
+	{
+		if (!o_is_count_star((Expr *) lfirst(lc)))
+			return;
+	}
+
+	relation = table_open(rte->relid, NoLock);
+	isOrioledb = is_orioledb_rel(relation);
+	table_close(relation, NoLock);
+	if (!isOrioledb)
+		return;
+
+	get_tablespace_page_costs(input_rel->reltablespace, NULL,
+							  &spc_seq_page_cost);
+
+	path = makeNode(CustomPath);
+	path->path.pathtype = T_CustomScan;
+	path->path.parent = output_rel;
+	path->path.pathtarget = target;
+	path->path.param_info = NULL;
+	path->path.parallel_aware = false;
+	path->path.parallel_safe = false;
+	path->path.parallel_workers = 0;
+	path->path.rows = 1;
+
+	/* No tuples are formed, so it's only a comparison per tuple */
+	path->path.startup_cost = spc_seq_page_cost * input_rel->pages +
+		cpu_operator_cost * input_rel->tuples;
+	path->path.total_cost = path->path.startup_cost + cpu_tuple_cost;
+	path->path.pathkeys = NIL;
+	path->flags = 0;
+	path->custom_paths = NIL;
+	path->custom_private = list_make1(makeInteger(input_rel->relid));
+	path->methods = &o_count_path_methods;
+
+	add_path(output_rel, (Path *) path);
+}
+
+static Plan *
+o_count_plan_custom_path(PlannerInfo *root, RelOptInfo *rel,
+						 CustomPath *best_path, List *tlist,
+						 List *clauses, List *custom_plans)
+{
+	CustomScan *custom_scan = makeNode(CustomScan);
+
+	/* The output is described by custom_scan_tlist, see setrefs.c */
+	custom_scan->scan.plan.targetlist = tlist;
+	custom_scan->scan.plan.qual = NIL;
+	custom_scan->scan.scanrelid = 0;
+	custom_scan->flags = best_path->flags;
+	custom_scan->methods = &o_count_scan_methods;
+	custom_scan->custom_plans = NIL;
+	custom_scan->custom_exprs = NIL;
+	custom_scan->custom_private = best_path->custom_private;
+	custom_scan->custom_scan_tlist = copyObject(tlist);
+
+	return (Plan *) custom_scan;
+}
+
+static Node *
+o_count_create_custom_scan_state(CustomScan *cscan)
+{
+	OCountScanState *state = (OCountScanState *) palloc0(sizeof(OCountScanState));
+
+	NodeSetTag(state, T_CustomScanState);
+	state->css.methods = &o_count_scan_exec_methods;
+	state->css.slotOps = &TTSOpsVirtual;
+
+	return (Node *) state;
+}
+
+static void
+o_count_begin_custom_scan(CustomScanState *node, EState *estate, int eflags)
+{
+	OCountScanState *state = (OCountScanState *) node;
+	CustomScan *cscan = (CustomScan *) node->ss.ps.plan;
+	Index		rti = intVal(linitial(cscan->custom_private));
+
+	state->relation = ExecOpenScanRelation(estate, rti, eflags);
+	state->done = false;
+}
+
+static bool
+o_count_filter(OTuple tuple, void *arg)
+{
+	(*(int64 *) arg)++;
+	return false;
+}
+
+static int64
+o_count_table_tuples(Relation relation, Snapshot snapshot)
+{
+	OTableDescr *descr = relation_get_descr(relation);
+	OSnapshot	oSnapshot;
+	BTreeSeqScan *scan;
+	CommitSeqNo tupleCsn;
+	OTuple		tuple PG_USED_FOR_ASSERTS_ONLY;
+	int64		count = 0;
+
+	O_LOAD_SNAPSHOT(&oSnapshot, snapshot);
+	scan = make_btree_seq_scan(&GET_PRIMARY(descr)->desc, &oSnapshot, NULL);
+
+	/* The filter counts the visible versions and rejects them all */
+	btree_seq_scan_set_filter(scan, o_count_filter, &count);
+	tuple = btree_seq_scan_getnext(scan, CurrentMemoryContext, &tupleCsn, NULL);
+	Assert(O_TUPLE_IS_NULL(tuple));
+	free_btree_seq_scan(scan);
+
+	return count;
+}
+
+static TupleTableSlot *
+o_count_exec_custom_scan(CustomScanState *node)
+{
+	OCountScanState *state = (OCountScanState *) node;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	int64		count;
+	int			i;
+
+	ExecClearTuple(slot);
+	if (state->done)
+		return slot;
+
+	count = o_count_table_tuples(state->relation,
+								 node->ss.ps.state->es_snapshot);
+	for (i = 0; i < slot->tts_tupleDescriptor->natts; i++)
+	{
+		slot->tts_values[i] = Int64GetDatum(count);
+		slot->tts_isnull[i] = false;
+	}
+	ExecStoreVirtualTuple(slot);
+	state->done = true;
+
+	if (node->ss.ps.ps_ProjInfo == NULL)
+		return slot;
+
+	ResetExprContext(econtext);
+	econtext->ecxt_scantuple = slot;
+	return ExecProject(node->ss.ps.ps_ProjInfo);
+}
+
+static void
+o_count_end_custom_scan(CustomScanState *node)
+{
+}
+
+static void
+o_count_rescan_custom_scan(CustomScanState *node)
+{
+	OCountScanState *state = (OCountScanState *) node;
+
+	state->done = false;
+}
+
+static void
+o_count_explain_custom_scan(CustomScanState *node, List *ancestors,
+							ExplainState *es)
+{
+	OCountScanState *state = (OCountScanState *) node;
+
+	ExplainPropertyText("Count of", RelationGetRelationName(state->relation),
+						es);
+}
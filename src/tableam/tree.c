@@ -61,7 +61,9 @@ static BTreeOps primaryOps = {
 	.needs_undo = pk_needs_undo,
 	.cmp = o_idx_cmp,
 	.hash = o_idx_hash,
-	.unique_hash = o_idx_unique_hash
+	.unique_hash = o_idx_unique_hash,
+	.key_common_prefix = o_idx_key_common_prefix,
+	.cmp_skip = o_idx_cmp_skip
 },
 
 			secondaryOps = {
@@ -71,7 +73,9 @@ static BTreeOps primaryOps = {
 	.needs_undo = NULL,
 	.cmp = o_idx_cmp,
 	.hash = o_idx_hash,
-	.unique_hash = o_idx_unique_hash
+	.unique_hash = o_idx_unique_hash,
+	.key_common_prefix = o_idx_key_common_prefix,
+	.cmp_skip = o_idx_cmp_skip
 },
 
 			toastOps = {
@@ -113,7 +117,7 @@ index_btree_desc_init(BTreeDescr *desc, OCompress compress, int fillfactor,
 	desc->nextChkp[0].file = -1;
 	desc->nextChkp[1].file = -1;
 	desc->tmpBuf[0].file = -1;
-	desc->tmpBuf[0].file = -1;
+	desc->tmpBuf[1].file = -1;
 	desc->ppool = get_ppool(OPagePoolMain);
 	if (persistence == RELPERSISTENCE_TEMP)
 		desc->storageType = BTreeStorageTemporary;
@@ -611,7 +615,8 @@ o_idx_cmp_range_key_to_value(OBTreeValueBound *bound1, OIndexField *field,
 static int
 o_idx_cmp_tuples(OIndexDescr *id,
 				 OTuple *tuple1, BTreeKeyType keyType1,
-				 OTuple *tuple2, BTreeKeyType keyType2)
+				 OTuple *tuple2, BTreeKeyType keyType2,
+				 int skip)
 {
 	TupleDesc	tupdesc1,
 				tupdesc2;
@@ -651,7 +656,7 @@ o_idx_cmp_tuples(OIndexDescr *id,
 	}
 
 	n = id->nonLeafTupdesc->natts;
-	for (i = 0; i < n; i++)
+	for (i = skip; i < n; i++)
 	{
 		if (!OIgnoreColumn(id, i))
 		{
@@ -686,7 +691,8 @@ o_idx_cmp_tuples(OIndexDescr *id,
 static int
 o_idx_cmp_key_bound_to_tuple(OIndexDescr *id,
 							 OBTreeKeyBound *key1, BTreeKeyType keyType1,
-							 OTuple *tuple2, BTreeKeyType keyType2)
+							 OTuple *tuple2, BTreeKeyType keyType2,
+							 int skip)
 {
 	TupleDesc	tupdesc;
 	OTupleFixedFormatSpec *spec;
@@ -719,7 +725,7 @@ o_idx_cmp_key_bound_to_tuple(OIndexDescr *id,
 		n = id->nUniqueFields;
 	}
 
-	for (i = 0; i < n; i++)
+	for (i = skip; i < n; i++)
 	{
 		if (!OIgnoreColumn(id, i))
 		{
@@ -851,6 +857,19 @@ int
 o_idx_cmp(BTreeDescr *desc,
 		  void *p1, BTreeKeyType keyType1,
 		  void *p2, BTreeKeyType keyType2)
+{
+	return o_idx_cmp_skip(desc, p1, keyType1, p2, keyType2, 0);
+}
+
+/*
+ * Compares the keys like o_idx_cmp() does, but starts from the key attribute
+ * number `skip`.  The caller guarantees the previous attributes to be equal.
+ */
+int
+o_idx_cmp_skip(BTreeDescr *desc,
+			   void *p1, BTreeKeyType keyType1,
+			   void *p2, BTreeKeyType keyType2,
+			   int skip)
 {
 	/* Keep clang analyzer quiet */
 #ifndef __clang_analyzer__
@@ -870,18 +889,21 @@ o_idx_cmp(BTreeDescr *desc,
 												(OBTreeKeyBound *) p1,
 												keyType1,
 												(OTuple *) p2,
-												keyType2);
+												keyType2,
+												skip);
 		if (IS_BOUND_KEY_TYPE(keyType2))
 			return -o_idx_cmp_key_bound_to_tuple(id,
 												 (OBTreeKeyBound *) p2,
 												 keyType2,
 												 (OTuple *) p1,
-												 keyType1);
+												 keyType1,
+												 skip);
 		return o_idx_cmp_tuples(id,
 								(OTuple *) p1,
 								keyType1,
 								(OTuple *) p2,
-								keyType2);
+								keyType2,
+								skip);
 	}
 
 	key1 = (OBTreeKeyBound *) p1;
@@ -895,7 +917,7 @@ o_idx_cmp(BTreeDescr *desc,
 	else
 		n = key1->nkeys;
 
-	for (i = 0; i < n; i++)
+	for (i = skip; i < n; i++)
 	{
 		if (!OIgnoreColumn(id, i))
 		{
@@ -920,6 +942,48 @@ o_idx_cmp(BTreeDescr *desc,
 	return 0;
 }
 
+/*
+ * Returns the number of leading key attributes equal in two non-leaf keys.
+ * Ignored columns don't break the common prefix, because they are never
+ * compared.
+ */
+int
+o_idx_key_common_prefix(BTreeDescr *desc, OTuple key1, OTuple key2)
+{
+	OIndexDescr *id = o_get_tree_def(desc);
+	int			i,
+				n;
+
+	o_set_sys_cache_search_datoid(desc->oids.datoid);
+
+	n = id->nonLeafTupdesc->natts;
+	for (i = 0; i < n; i++)
+	{
+		if (!OIgnoreColumn(id, i))
+		{
+			OIndexField *field = &id->fields[i];
+			int			attnum = OIndexKeyAttnumToTupleAttnum(BTreeKeyNonLeafKey,
+															  id, i + 1);
+			Datum		value1,
+						value2;
+			bool		isnull1,
+						isnull2;
+
+			value1 = o_fastgetattr(key1, attnum, id->nonLeafTupdesc,
+								   &id->nonLeafSpec, &isnull1);
+			value2 = o_fastgetattr(key2, attnum, id->nonLeafTupdesc,
+								   &id->nonLeafSpec, &isnull2);
+
+			if (isnull1 != isnull2)
+				break;
+			if (!isnull1 &&
+				o_call_comparator(field->comparator, value1, value2) != 0)
+				break;
+		}
+	}
+	return i;
+}
+
 static bool
 pk_needs_undo(BTreeDescr *desc, BTreeOperationType action,
 			  OTuple oldTuple, OTupleXactInfo oldXactInfo, bool oldDeleted,
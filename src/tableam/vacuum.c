@@ -77,6 +77,8 @@ typedef struct LVRelState
 	OTableDescr *descr;
 	Relation   *indrels;
 	int			nindexes;
+	int			nreadyindexes;	/* # of ready indexes, including the
+								 * orioledb ones */
 
 	/* Buffer access strategy and parallel vacuum state */
 	BufferAccessStrategy bstrategy;
@@ -232,7 +234,7 @@ vacuum_error_callback(void *arg)
 
 static void
 vac_open_bridged_indexes(Relation relation, LOCKMODE lockmode,
-						 int *nindexes, Relation **Irel)
+						 int *nindexes, int *nready, Relation **Irel)
 {
 	List	   *indexoidlist;
 	ListCell   *indexoidscan;
@@ -252,6 +254,7 @@ vac_open_bridged_indexes(Relation relation, LOCKMODE lockmode,
 
 	/* collect just the ready indexes */
 	i = 0;
+	*nready = 0;
 	foreach(indexoidscan, indexoidlist)
 	{
 		Oid			indexoid = lfirst_oid(indexoidscan);
@@ -259,6 +262,9 @@ vac_open_bridged_indexes(Relation relation, LOCKMODE lockmode,
 
 		indrel = index_open(indexoid, lockmode);
 
+		if (indrel->rd_index->indisready)
+			(*nready)++;
+
 		if (indrel->rd_amhandler == F_BTHANDLER)
 		{
 			OBTOptions *options = (OBTOptions *) indrel->rd_options;
@@ -338,8 +344,20 @@ dead_items_alloc(LVRelState *vacrel, int nworkers)
 		/*
 		 * Since parallel workers cannot access data in temporary tables, we
 		 * can't perform parallel vacuum on them.
+		 *
+		 * The parallel workers open all the ready indexes of the table and
+		 * match them to the leader's ones by position.  So the workers can
+		 * only be used when all the ready indexes are bridged, otherwise
+		 * they would process the orioledb indexes instead.
 		 */
-		if (RelationUsesLocalBuffers(vacrel->rel))
+		if (vacrel->nindexes != vacrel->nreadyindexes)
+		{
+			if (nworkers > 0)
+				ereport(WARNING,
+						(errmsg("disabling parallel option of vacuum on \"%s\" --- cannot vacuum bridged indexes in parallel together with orioledb indexes",
+								vacrel->relname)));
+		}
+		else if (RelationUsesLocalBuffers(vacrel->rel))
 		{
 			/*
 			 * Give warning only if the user explicitly tries to perform a
@@ -1258,6 +1276,7 @@ orioledb_vacuum_bridged_indexes(Relation rel, OTableDescr *descr,
 	vacrel->rel = rel;
 	vacrel->descr = descr;
 	vac_open_bridged_indexes(vacrel->rel, RowExclusiveLock, &vacrel->nindexes,
+							 &vacrel->nreadyindexes,
 							 &vacrel->indrels);
 	vacrel->bstrategy = bstrategy;
 	if (instrument && vacrel->nindexes > 0)
@@ -20,6 +20,7 @@
 #include "transam/oxid.h"
 #include "utils/dsa.h"
 #include "utils/o_buffers.h"
+#include "utils/probes.h"
 
 #include "access/transam.h"
 #include "access/twophase.h"
@@ -30,6 +31,7 @@
 #include "storage/procsignal.h"
 #include "storage/proc.h"
 #include "utils/snapmgr.h"
+#include "utils/timestamp.h"
 
 #define XID_FILE_SIZE (0x1000000)
 #define OXID_BUFFERS_TAG (0)
@@ -70,6 +72,13 @@ static OXid curOxid = InvalidOXid;
  */
 static TransactionId logicalXid = InvalidTransactionId;
 static List *prevLogicalXids = NIL;
+
+/*
+ * The logical xids of the parents of the running subtransactions.  The
+ * rolled back subtransaction switches back to the logical xid of its parent,
+ * so that logical decoding can discard its changes.
+ */
+static List *subxactParentLogicalXids = NIL;
 static OXidMapItem *xidBuffer;
 
 XidMeta    *xid_meta;
@@ -86,6 +95,47 @@ static OBuffersDesc buffersDesc = {
 	.bufferCtlTrancheName = "xidBuffersCtlTranche"
 };
 
+/*
+ * Backend-local direct-mapped cache of the commit csns of recently seen
+ * oxids.  Once the transaction is committed its csn and commit ptr never
+ * change (except by rewind, which restarts the cluster), and the oxids are
+ * never reused.  So the entries need no invalidation, and the visibility
+ * checks of the recently modified tuples avoid touching the shared xid ring
+ * or the xidmap buffers.
+ */
+#define OXID_CSN_CACHE_SIZE (512)
+
+typedef struct
+{
+	OXid		oxid;
+	CommitSeqNo csn;
+	XLogRecPtr	ptr;
+	bool		ptrKnown;
+} OXidCsnCacheEntry;
+
+static OXidCsnCacheEntry oxidCsnCache[OXID_CSN_CACHE_SIZE];
+
+#define OXID_CSN_CACHE_ENTRY(oxid) (&oxidCsnCache[(oxid) % OXID_CSN_CACHE_SIZE])
+
+/*
+ * The per-process xmins are grouped, and every group maintains the minimum
+ * xmin of its members.  Lowering a process xmin lowers the group minimum
+ * immediately.  Raising it only marks the group dirty, and the group minimum
+ * is recomputed by the next advance_global_xmin().  Thus, the global xmin
+ * advancement scans only the group minima and the dirty groups instead of
+ * all the processes.
+ */
+#define OXID_XMIN_GROUP_SIZE (64)
+#define OXID_XMIN_GROUPS_COUNT ((max_procs + OXID_XMIN_GROUP_SIZE - 1) / OXID_XMIN_GROUP_SIZE)
+
+typedef struct
+{
+	pg_atomic_uint64 xmin;
+	pg_atomic_uint32 dirty;
+} OXidXminGroup;
+
+static OXidXminGroup *xminGroups;
+
 static void advance_global_xmin(OXid newXid);
 
 Size
@@ -101,6 +151,8 @@ oxid_shmem_needs(void)
 	size = add_size(size, o_buffers_shmem_needs(&buffersDesc));
 	size = add_size(size, mul_size(logical_xid_buffers_guc,
 								   ORIOLEDB_BLCKSZ));
+	size = add_size(size, mul_size(OXID_XMIN_GROUPS_COUNT,
+								   sizeof(OXidXminGroup)));
 
 	return size;
 }
@@ -208,6 +260,8 @@ oxid_init_shmem(Pointer ptr, bool found)
 	o_buffers_shmem_init(&buffersDesc, ptr, found);
 	ptr += o_buffers_shmem_needs(&buffersDesc);
 	logicalXidsShmemMap = (pg_atomic_uint32 *) ptr;
+	ptr += logical_xid_buffers_guc * ORIOLEDB_BLCKSZ;
+	xminGroups = (OXidXminGroup *) ptr;
 
 	if (!found)
 	{
@@ -228,6 +282,12 @@ oxid_init_shmem(Pointer ptr, bool found)
 		for (i = 0; i < logical_xid_buffers_guc * (BLCKSZ / sizeof(pg_atomic_uint32)); i++)
 			pg_atomic_init_u32(&logicalXidsShmemMap[i], 0);
 
+		for (i = 0; i < OXID_XMIN_GROUPS_COUNT; i++)
+		{
+			pg_atomic_init_u64(&xminGroups[i].xmin, InvalidOXid);
+			pg_atomic_init_u32(&xminGroups[i].dirty, 0);
+		}
+
 		/* Undo positions are initialized in checkpoint_shmem_init() */
 	}
 	LWLockRegisterTranche(xid_meta->xidMapTrancheId,
@@ -324,19 +384,68 @@ assign_subtransaction_logical_xid(void)
 {
 	TransactionId nextLogicalXid;
 
+	MemoryContext mcxt;
+
 	nextLogicalXid = acquire_logical_xid();
 
+	mcxt = MemoryContextSwitchTo(TopMemoryContext);
 	if (TransactionIdIsValid(logicalXid))
-	{
-		MemoryContext mcxt = MemoryContextSwitchTo(TopMemoryContext);
-
 		prevLogicalXids = lappend_xid(prevLogicalXids, logicalXid);
-		MemoryContextSwitchTo(mcxt);
-	}
+	subxactParentLogicalXids = lappend_xid(subxactParentLogicalXids,
+										   logicalXid);
+	MemoryContextSwitchTo(mcxt);
 
 	logicalXid = nextLogicalXid;
 }
 
+/*
+ * The changes of the committed subtransaction remain under its logical xid.
+ */
+void
+release_subtransaction_logical_xid(void)
+{
+	if (subxactParentLogicalXids != NIL)
+		subxactParentLogicalXids = list_delete_last(subxactParentLogicalXids);
+}
+
+/*
+ * Switches back to the logical xid of the parent of the rolled back
+ * subtransaction.  The logical xid of the subtransaction is kept assigned
+ * till the end of the transaction.
+ */
+void
+rollback_subtransaction_logical_xid(void)
+{
+	TransactionId parentLogicalXid;
+	MemoryContext mcxt;
+	ListCell   *lc;
+
+	if (subxactParentLogicalXids == NIL)
+		return;
+
+	parentLogicalXid = lfirst_xid(list_last_cell(subxactParentLogicalXids));
+	subxactParentLogicalXids = list_delete_last(subxactParentLogicalXids);
+
+	if (!TransactionIdIsValid(parentLogicalXid) ||
+		parentLogicalXid == logicalXid)
+		return;
+
+	foreach(lc, prevLogicalXids)
+	{
+		if (lfirst_xid(lc) == parentLogicalXid)
+		{
+			prevLogicalXids = list_delete_cell(prevLogicalXids, lc);
+			break;
+		}
+	}
+
+	mcxt = MemoryContextSwitchTo(TopMemoryContext);
+	prevLogicalXids = lappend_xid(prevLogicalXids, logicalXid);
+	MemoryContextSwitchTo(mcxt);
+
+	logicalXid = parentLogicalXid;
+}
+
 /*
  * Set the csn value for particular oxid.
  */
@@ -346,6 +455,10 @@ set_oxid_csn(OXid oxid, CommitSeqNo csn)
 	CommitSeqNo oldCsn;
 	OXid		writeInProgressXmin;
 
+	/* Rewind overrides the csn of the committed transactions */
+	if (OXID_CSN_CACHE_ENTRY(oxid)->oxid == oxid)
+		OXID_CSN_CACHE_ENTRY(oxid)->oxid = InvalidOXid;
+
 	oldCsn = pg_atomic_read_u64(&xidBuffer[oxid % xid_circular_buffer_size].csn);
 	pg_read_barrier();
 	writeInProgressXmin = pg_atomic_read_u64(&xid_meta->writeInProgressXmin);
@@ -434,6 +547,45 @@ set_oxid_xlog_ptr(OXid oxid, XLogRecPtr ptr)
 }
 
 
+/*
+ * Looks up the local cache for the committed csn of oxid.
+ */
+static inline OXidCsnCacheEntry *
+oxid_csn_cache_lookup(OXid oxid)
+{
+	OXidCsnCacheEntry *entry = OXID_CSN_CACHE_ENTRY(oxid);
+
+	if (entry->oxid == oxid && COMMITSEQNO_IS_NORMAL(entry->csn))
+		return entry;
+	return NULL;
+}
+
+/*
+ * Remembers the csn (and the commit ptr if known) of the committed oxid.
+ * Recovery processes are skipped, because they might see the csn of the
+ * replayed transaction changing.
+ */
+static inline void
+oxid_csn_cache_store(OXid oxid, CommitSeqNo csn, XLogRecPtr *ptr)
+{
+	OXidCsnCacheEntry *entry = OXID_CSN_CACHE_ENTRY(oxid);
+
+	if (!COMMITSEQNO_IS_NORMAL(csn) || is_recovery_process())
+		return;
+
+	if (entry->oxid != oxid)
+	{
+		entry->oxid = oxid;
+		entry->ptrKnown = false;
+	}
+	entry->csn = csn;
+	if (ptr)
+	{
+		entry->ptr = *ptr;
+		entry->ptrKnown = true;
+	}
+}
+
 /*
  * Read csn of given xid from xidmap.
  * If getRawCsn is true outputs raw csn, otherwise clears COMMITSEQNO_RETAINED_FOR_REWIND flag.
@@ -647,9 +799,11 @@ wait_for_oxid(OXid oxid)
 	}
 
 	Assert(VirtualTransactionIdIsValid(vxid));
+	ORIOLEDB_PROBE1(wait_for_oxid__start, oxid);
 	GET_CUR_PROCDATA()->waitingForOxid = true;
 	result = VirtualXactLock(vxid, true);
 	GET_CUR_PROCDATA()->waitingForOxid = false;
+	ORIOLEDB_PROBE2(wait_for_oxid__done, oxid, result);
 
 	return result;
 }
@@ -827,7 +981,76 @@ oxid_notify_all(void)
 }
 
 /*
- * Loop over oProcData[] and update xid_meta accordingly.
+ * Sets the xmin of the current process and maintains the minimum of its
+ * group.
+ */
+void
+set_my_xmin(OXid xmin)
+{
+	pg_atomic_uint64 *myXmin = &oProcData[MYPROCNUMBER].xmin;
+	OXidXminGroup *group = &xminGroups[MYPROCNUMBER / OXID_XMIN_GROUP_SIZE];
+	OXid		oldXmin = pg_atomic_read_u64(myXmin);
+	OXid		groupXmin;
+
+	if (xmin == oldXmin)
+		return;
+
+	pg_atomic_write_u64(myXmin, xmin);
+	pg_memory_barrier();
+	groupXmin = pg_atomic_read_u64(&group->xmin);
+
+	if (xmin < oldXmin)
+	{
+		while (xmin < groupXmin)
+		{
+			if (pg_atomic_compare_exchange_u64(&group->xmin, &groupXmin, xmin))
+				break;
+		}
+	}
+	else if (oldXmin <= groupXmin)
+	{
+		/* We might hold the group minimum, let it be recomputed */
+		pg_atomic_write_u32(&group->dirty, 1);
+	}
+}
+
+/*
+ * Returns the minimum xmin of the group, recomputing it if needed.  Called
+ * under xminMutex, so there is only one recomputing process at once.
+ */
+static OXid
+get_group_xmin(int groupNum)
+{
+	OXidXminGroup *group = &xminGroups[groupNum];
+	OXid		groupXmin,
+				xmin;
+	int			i;
+
+	if (pg_atomic_read_u32(&group->dirty) == 0 ||
+		pg_atomic_exchange_u32(&group->dirty, 0) == 0)
+		return pg_atomic_read_u64(&group->xmin);
+
+	groupXmin = pg_atomic_read_u64(&group->xmin);
+	xmin = InvalidOXid;
+	for (i = groupNum * OXID_XMIN_GROUP_SIZE;
+		 i < Min((groupNum + 1) * OXID_XMIN_GROUP_SIZE, max_procs);
+		 i++)
+		xmin = Min(xmin, pg_atomic_read_u64(&oProcData[i].xmin));
+
+	/*
+	 * The concurrent lowering wins.  Recompute the group next time, because
+	 * it might be still holding the stale minimum.
+	 */
+	if (!pg_atomic_compare_exchange_u64(&group->xmin, &groupXmin, xmin))
+	{
+		pg_atomic_write_u32(&group->dirty, 1);
+		return groupXmin;
+	}
+	return xmin;
+}
+
+/*
+ * Loop over xmin groups and update xid_meta accordingly.
  */
 static void
 advance_global_xmin(OXid newXid)
@@ -851,11 +1074,11 @@ advance_global_xmin(OXid newXid)
 
 	globalXmin = pg_atomic_read_u64(&xid_meta->runXmin);
 
-	for (i = 0; i < max_procs; i++)
+	for (i = 0; i < OXID_XMIN_GROUPS_COUNT; i++)
 	{
 		OXid		xmin;
 
-		xmin = pg_atomic_read_u64(&oProcData[i].xmin);
+		xmin = get_group_xmin(i);
 
 		if (OXidIsValid(xmin) && xmin < globalXmin)
 			globalXmin = xmin;
@@ -1210,6 +1433,8 @@ release_assigned_logical_xids(void)
 		}
 		list_free(prevLogicalXids);
 		prevLogicalXids = NIL;
+		list_free(subxactParentLogicalXids);
+		subxactParentLogicalXids = NIL;
 	}
 }
 
@@ -1262,6 +1487,14 @@ oxid_get_csn(OXid oxid, bool getRawCsn)
 	if (oxid == BootstrapTransactionId)
 		return COMMITSEQNO_FROZEN;
 
+	if (!getRawCsn)
+	{
+		OXidCsnCacheEntry *entry = oxid_csn_cache_lookup(oxid);
+
+		if (entry)
+			return entry->csn;
+	}
+
 	init_local_spin_delay(&status);
 
 	while (true)
@@ -1282,6 +1515,9 @@ oxid_get_csn(OXid oxid, bool getRawCsn)
 	if (COMMITSEQNO_IS_SPECIAL(csn))
 		return COMMITSEQNO_INPROGRESS;
 
+	if (!getRawCsn)
+		oxid_csn_cache_store(oxid, csn, NULL);
+
 	return csn;
 }
 
@@ -1330,6 +1566,9 @@ oxid_match_snapshot(OXid oxid, OSnapshot *snapshot,
 					CommitSeqNo *outCsn, XLogRecPtr *outPtr)
 {
 	SpinDelayStatus status;
+	OXidCsnCacheEntry *entry;
+	CommitSeqNo *csnPtr = outCsn;
+	XLogRecPtr *ptrPtr = outPtr;
 
 	if (oxid == BootstrapTransactionId || oxid < snapshot->xmin)
 	{
@@ -1340,6 +1579,16 @@ oxid_match_snapshot(OXid oxid, OSnapshot *snapshot,
 		return;
 	}
 
+	entry = oxid_csn_cache_lookup(oxid);
+	if (entry && (!outPtr || entry->ptrKnown))
+	{
+		if (outCsn)
+			*outCsn = entry->csn;
+		if (outPtr)
+			*outPtr = entry->ptr;
+		return;
+	}
+
 	init_local_spin_delay(&status);
 
 	while (true)
@@ -1380,6 +1629,9 @@ oxid_match_snapshot(OXid oxid, OSnapshot *snapshot,
 	}
 
 	finish_spin_delay(&status);
+
+	if (csnPtr)
+		oxid_csn_cache_store(oxid, *csnPtr, ptrPtr);
 }
 
 void
@@ -1408,6 +1660,35 @@ fill_current_oxid_osnapshot(OXid *oxid, OSnapshot *snapshot)
 	*oxid = get_current_oxid();
 }
 
+/*
+ * Replaces the snapshot with the historical one as of
+ * orioledb.as_of_timestamp.  The rewind retains both the undo and the CSNs
+ * of the transactions within its window, so the regular visibility checks and
+ * read_page_from_undo() serve the historical snapshot.
+ */
+void
+o_snapshot_apply_as_of(OSnapshot *snapshot)
+{
+	CommitSeqNo csn;
+	OXid		xmin;
+
+	if (as_of_timestamp >= GetCurrentTimestamp())
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("orioledb.as_of_timestamp must be in the past")));
+
+	if (!rewind_get_csn_as_of(as_of_timestamp, &csn, &xmin))
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("history as of %s is not retained",
+						timestamptz_to_str(as_of_timestamp)),
+				 errhint("The history is limited by orioledb.rewind_max_time and orioledb.rewind_max_transactions.")));
+
+	snapshot->csn = csn;
+	snapshot->xmin = xmin;
+	snapshot->xlogptr = InvalidXLogRecPtr;
+}
+
 int
 oxid_get_procnum(OXid oxid)
 {
@@ -15,6 +15,9 @@
 #include "postgres.h"
 
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 #include "orioledb.h"
 
@@ -27,21 +30,32 @@
 #include "recovery/wal.h"
 #include "tableam/descr.h"
 #include "tableam/handler.h"
+#include "tableam/operations.h"
 #include "transam/oxid.h"
 #include "transam/undo.h"
+#include "transam/undo_compress.h"
 #include "utils/o_buffers.h"
+#include "utils/o_memory.h"
+#include "utils/op_sampling.h"
 #include "utils/page_pool.h"
+#include "utils/probes.h"
 #include "utils/snapshot.h"
 #include "utils/stopevent.h"
+#include "utils/tree_stats.h"
 #include "rewind/rewind.h"
 
 #include "access/transam.h"
+#include "access/xact.h"
+#include "common/hashfn.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/lmgr.h"
 #include "storage/md.h"
 #include "storage/proc.h"
 #include "utils/memutils.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
 
 
 #define GET_UNDO_REC(undoType, loc) (o_undo_buffers[(int) (undoType)] + \
@@ -150,6 +164,7 @@ UndoItemTypeDescr undoItemTypeDescrs[] = {
 
 
 PG_FUNCTION_INFO_V1(orioledb_has_retained_undo);
+PG_FUNCTION_INFO_V1(orioledb_undo_stats);
 
 static UndoMeta *undo_metas = NULL;
 static Pointer o_undo_buffers[(int) UndoLogsCount] =
@@ -160,19 +175,55 @@ static Size o_undo_circular_sizes[(int) UndoLogsCount] =
 {
 	0
 };
+static Size o_undo_initial_capacities[(int) UndoLogsCount] =
+{
+	0
+};
+static Size o_undo_total_capacity = 0;
 PendingTruncatesMeta *pending_truncates_meta;
 
+/* the minimal capacity of each undo log, the same as without the balancing */
+#define UNDO_MIN_CAPACITY		CACHELINEALIGN(4 * max_procs * ORIOLEDB_BLCKSZ)
+/* undo_balance_split() moves 1/UNDO_BALANCE_STEPS of the undo memory */
+#define UNDO_BALANCE_STEPS		32
+
+/*
+ * Returns the part of the circular buffer the undo log can use.  The
+ * circular buffer size, which the locations are mapped modulo, is never less
+ * than the capacity.
+ */
+static inline Size
+undo_capacity(UndoLogType undoType)
+{
+	return (Size) pg_atomic_read_u64(&undo_metas[(int) undoType].circularCapacity);
+}
+
 UndoLocation curRetainUndoLocations[(int) UndoLogsCount] =
 {
 	InvalidUndoLocation
 };
 bool		oxid_needs_wal_flush = false;
 
+/* The undo reads from disk by this backend */
+uint64		undo_disk_reads = 0;
+uint64		undo_disk_read_bytes = 0;
+
 static Size reserved_undo_sizes[(int) UndoLogsCount] =
 {
 	0
 };
 
+/*
+ * Undo size reserved in advance and kept by the backend till the transaction
+ * end.  The reservations of the operations are carved from it without
+ * touching meta->advanceReservedLocation.  The per-process undo locations
+ * are not affected, so update_min_undo_locations() doesn't see the arena.
+ */
+static Size undo_arena_sizes[(int) UndoLogsCount] =
+{
+	0
+};
+
 static OBuffersDesc undoBuffersDesc =
 {
 	.singleFileSize = UNDO_FILE_SIZE,
@@ -183,6 +234,8 @@ static OBuffersDesc undoBuffersDesc =
 
 static void wait_for_reserved_location(UndoLogType undoType,
 									   UndoLocation undoLocationToWait);
+static void undo_release_memory(UndoLogType undoType, UndoLocation fromLoc,
+								UndoLocation toLoc);
 
 /*
  * A sorted array comprising a map from CommandId to the UndoLocation of the
@@ -210,6 +263,7 @@ undo_shmem_needs(void)
 {
 	Size		size;
 	double		regular_row_undo_circular_buffer_fraction;
+	int			i;
 
 	regular_row_undo_circular_buffer_fraction = 1.0 - regular_block_undo_circular_buffer_fraction - system_undo_circular_buffer_fraction;
 	o_undo_circular_sizes[UndoLogRegular] = regular_row_undo_circular_buffer_fraction * undo_circular_buffer_size;
@@ -223,6 +277,25 @@ undo_shmem_needs(void)
 	o_undo_circular_sizes[UndoLogSystem] = CACHELINEALIGN(o_undo_circular_sizes[UndoLogSystem]);
 	undoBuffersDesc.buffersCount = undo_buffers_count;
 
+	/*
+	 * With the adaptive split, every undo log might take the whole undo
+	 * memory.  The circular buffer of each is twice as large, so the memory
+	 * released behind the written location is never reused by the
+	 * concurrent writers, see undo_release_memory().  Only the live part of
+	 * each buffer takes the memory.
+	 */
+	o_undo_total_capacity = 0;
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		o_undo_initial_capacities[i] = o_undo_circular_sizes[i];
+		o_undo_total_capacity += o_undo_circular_sizes[i];
+	}
+	if (undo_adaptive_split)
+	{
+		for (i = 0; i < (int) UndoLogsCount; i++)
+			o_undo_circular_sizes[i] = 2 * o_undo_total_capacity;
+	}
+
 	size = CACHELINEALIGN(sizeof(UndoMeta) * (int) UndoLogsCount);
 	size = add_size(size, CACHELINEALIGN(sizeof(PendingTruncatesMeta)));
 	size = add_size(size, o_undo_circular_sizes[UndoLogRegular]);
@@ -253,7 +326,12 @@ undo_shmem_init(Pointer buf, bool found)
 	ptr += o_undo_circular_sizes[UndoLogSystem];
 
 	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
 		init_undo_meta(&undo_metas[i], found);
+		if (!found)
+			pg_atomic_init_u64(&undo_metas[i].circularCapacity,
+							   o_undo_initial_capacities[i]);
+	}
 
 	o_buffers_shmem_init(&undoBuffersDesc, ptr, found);
 	ptr += o_buffers_shmem_needs(&undoBuffersDesc);
@@ -280,6 +358,9 @@ init_undo_meta(UndoMeta *meta, bool found)
 		meta->undoStackLocationsFlushLockTrancheId = LWLockNewTrancheId();
 		LWLockInitialize(&meta->undoWriteLock,
 						 meta->undoWriteTrancheId);
+		pg_atomic_init_u64(&meta->evictedBytes, 0);
+		pg_atomic_init_u64(&meta->diskReads, 0);
+		pg_atomic_init_u64(&meta->diskReadBytes, 0);
 
 		/* Undo locations are initialized in checkpoint_shmem_init() */
 	}
@@ -311,6 +392,16 @@ get_undo_meta_by_type(UndoLogType undoType)
 	return &undo_metas[index];
 }
 
+static void
+unlink_undo_files_range(UndoLogType undoType, int64 firstFileNumber,
+						int64 lastFileNumber)
+{
+	o_buffers_unlink_files_range(&undoBuffersDesc, (uint32) undoType,
+								 firstFileNumber, lastFileNumber);
+	undo_compress_unlink_files_range(undoType, firstFileNumber,
+									 lastFileNumber);
+}
+
 void
 update_min_undo_locations(UndoLogType undoType,
 						  bool have_lock, bool do_cleanup)
@@ -436,31 +527,27 @@ update_min_undo_locations(UndoLogType undoType,
 		if (newCheckpointEndLocation % UNDO_FILE_SIZE == 0)
 			newCheckpointEndNum--;
 
-		o_buffers_unlink_files_range(&undoBuffersDesc,
-									 (uint32) undoType,
-									 oldCheckpointStartNum,
-									 Min(oldCheckpointEndNum,
-										 Min(newCheckpointStartNum - 1,
-											 newCleanedNum - 1)));
-
-		o_buffers_unlink_files_range(&undoBuffersDesc,
-									 (uint32) undoType,
-									 Max(oldCheckpointStartNum,
-										 newCheckpointEndNum + 1),
-									 Min(oldCheckpointEndNum,
-										 newCleanedNum - 1));
-
-		o_buffers_unlink_files_range(&undoBuffersDesc,
-									 (uint32) undoType,
-									 oldCleanedNum,
-									 Min(newCheckpointStartNum - 1,
-										 newCleanedNum - 1));
-
-		o_buffers_unlink_files_range(&undoBuffersDesc,
-									 (uint32) undoType,
-									 Max(oldCleanedNum,
-										 newCheckpointEndNum + 1),
-									 newCleanedNum - 1);
+		unlink_undo_files_range(undoType,
+								oldCheckpointStartNum,
+								Min(oldCheckpointEndNum,
+									Min(newCheckpointStartNum - 1,
+										newCleanedNum - 1)));
+
+		unlink_undo_files_range(undoType,
+								Max(oldCheckpointStartNum,
+									newCheckpointEndNum + 1),
+								Min(oldCheckpointEndNum,
+									newCleanedNum - 1));
+
+		unlink_undo_files_range(undoType,
+								oldCleanedNum,
+								Min(newCheckpointStartNum - 1,
+									newCleanedNum - 1));
+
+		unlink_undo_files_range(undoType,
+								Max(oldCleanedNum,
+									newCheckpointEndNum + 1),
+								newCleanedNum - 1);
 	}
 }
 
@@ -511,7 +598,10 @@ set_my_reserved_location(UndoLogType undoType)
 		if (!UndoLocationIsValid(pg_atomic_read_u64(&curProcData->undoRetainLocations[undoType].reservedUndoLocation)))
 			pg_atomic_write_u64(&curProcData->undoRetainLocations[undoType].reservedUndoLocation, lastUsedLocation);
 		if (!UndoLocationIsValid(pg_atomic_read_u64(&curProcData->undoRetainLocations[undoType].transactionUndoRetainLocation)))
+		{
+			curProcData->undoRetainLocations[undoType].transactionRetainTime = GetCurrentTimestamp();
 			pg_atomic_write_u64(&curProcData->undoRetainLocations[undoType].transactionUndoRetainLocation, lastUsedLocation);
+		}
 
 		wait_for_even_min_undo_locations_changecount(meta);
 
@@ -543,6 +633,8 @@ set_my_retain_location(UndoLogType undoType)
 		retainUndoLocation = pg_atomic_read_u64(&meta->minProcTransactionRetainLocation);
 		curSnapshotRetainUndoLocation = pg_atomic_read_u64(&curProcData->undoRetainLocations[undoType].snapshotRetainUndoLocation);
 
+		if (!UndoLocationIsValid(curSnapshotRetainUndoLocation))
+			curProcData->undoRetainLocations[undoType].snapshotRetainTime = GetCurrentTimestamp();
 		if (!UndoLocationIsValid(curSnapshotRetainUndoLocation) ||
 			retainUndoLocation < curSnapshotRetainUndoLocation)
 			pg_atomic_write_u64(&curProcData->undoRetainLocations[undoType].snapshotRetainUndoLocation, retainUndoLocation);
@@ -742,6 +834,81 @@ walk_undo_range_with_buf(UndoLogType undoType,
 }
 
 
+/*
+ * Undo items applied to a single tree.  Branch and subtransaction items have
+ * no action on abort.
+ */
+static inline bool
+undo_item_is_tree_local(UndoStackItem *item)
+{
+	return item->type == ModifyUndoItemType ||
+		item->type == RowLockUndoItemType ||
+		item->type == BranchUndoItemType ||
+		item->type == SubXactUndoItemType;
+}
+
+/*
+ * Checks if aborting the undo range touches nothing but the individual trees.
+ * Such ranges of different transactions could be aborted in parallel, as long
+ * as the items of each tree are aborted in order.
+ */
+bool
+undo_range_is_tree_local(UndoLogType undoType, UndoLocation location)
+{
+	UndoItemBuf buf;
+	bool		result = true;
+
+	init_undo_item_buf(&buf);
+	while (UndoLocationIsValid(location))
+	{
+		UndoStackItem *item = undo_item_buf_read_item(&buf, undoType, location);
+
+		if (!undo_item_is_tree_local(item))
+		{
+			result = false;
+			break;
+		}
+		location = item->prev;
+	}
+	free_undo_item_buf(&buf);
+	return result;
+}
+
+/*
+ * Aborts the items of the tree-local undo range, which belong to the trees of
+ * the given partition.  The caller aborts the other partitions in parallel.
+ */
+void
+walk_undo_range_partition(UndoLogType undoType, UndoLocation location,
+						  OXid oxid, int partition, int npartitions)
+{
+	UndoItemBuf buf;
+
+	init_undo_item_buf(&buf);
+	while (UndoLocationIsValid(location))
+	{
+		UndoStackItem *item = undo_item_buf_read_item(&buf, undoType, location);
+
+		Assert(undo_item_is_tree_local(item));
+		if (item->type == ModifyUndoItemType ||
+			item->type == RowLockUndoItemType)
+		{
+			BTreeModifyUndoStackItem *modifyItem = (BTreeModifyUndoStackItem *) item;
+			uint32		hash;
+
+			hash = hash_bytes((const unsigned char *) &modifyItem->oids,
+							  sizeof(ORelOids));
+			if (hash % npartitions == partition)
+				item_type_get_descr(item->type)->callback(undoType, location,
+														  item, oxid,
+														  true, true);
+		}
+		location = item->prev;
+	}
+	free_undo_item_buf(&buf);
+}
+
+
 /*
  * Apply undo branches: parts of transaction undo chain, which should be already
  * aborted.  This is used during recovery: despite some parts of chain are
@@ -950,8 +1117,31 @@ static void
 read_undo_range(OBuffersDesc *desc, Pointer buf, UndoLogType undoType,
 				UndoLocation minLoc, UndoLocation maxLoc)
 {
+	UndoMeta   *meta = get_undo_meta_by_type(undoType);
+
 	Assert(maxLoc > minLoc);
-	o_buffers_read(desc, buf, (uint32) undoType, minLoc, maxLoc - minLoc);
+	pg_atomic_fetch_add_u64(&meta->diskReads, 1);
+	pg_atomic_fetch_add_u64(&meta->diskReadBytes, maxLoc - minLoc);
+	undo_disk_reads++;
+	undo_disk_read_bytes += maxLoc - minLoc;
+	if (undo_type_compressible(undoType))
+		undo_compress_read_range(desc, buf, undoType, minLoc, maxLoc);
+	else
+		o_buffers_read(desc, buf, (uint32) undoType, minLoc, maxLoc - minLoc);
+}
+
+/*
+ * Writes the range evicted from the circular buffer, compressing it if
+ * possible.
+ */
+static void
+evict_undo_range(OBuffersDesc *desc, Pointer buf, UndoLogType undoType,
+				 UndoLocation minLoc, UndoLocation maxLoc)
+{
+	if (undo_type_compressible(undoType))
+		undo_compress_write_range(desc, buf, undoType, minLoc, maxLoc);
+	else
+		write_undo_range(desc, buf, undoType, minLoc, maxLoc);
 }
 
 /*
@@ -1000,6 +1190,7 @@ evict_undo_to_disk(UndoLogType undoType,
 		targetUndoLocation <= pg_atomic_read_u64(&meta->writtenLocation))
 	{
 		/* We don't have to really write undo. */
+		writtenLocation = pg_atomic_read_u64(&meta->writtenLocation);
 		if (pg_atomic_read_u64(&meta->writeInProgressLocation) < retainUndoLocation)
 		{
 			pg_atomic_write_u64(&meta->writeInProgressLocation, retainUndoLocation);
@@ -1012,6 +1203,8 @@ evict_undo_to_disk(UndoLogType undoType,
 		Assert((meta->writeInProgressChangeCount & 1) == 0);
 
 		SpinLockRelease(&meta->minUndoLocationsMutex);
+		undo_release_memory(undoType, writtenLocation,
+							pg_atomic_read_u64(&meta->writtenLocation));
 		LWLockRelease(&meta->undoWriteLock);
 		return;
 	}
@@ -1019,7 +1212,7 @@ evict_undo_to_disk(UndoLogType undoType,
 	/* Try to write 5% of the whole undo size if possible */
 	writtenLocation = pg_atomic_read_u64(&meta->writtenLocation);
 	retainUndoLocation = Max(retainUndoLocation, writtenLocation);
-	targetUndoLocation = Max(targetUndoLocation, writtenLocation + circularBufferSize / 20);
+	targetUndoLocation = Max(targetUndoLocation, writtenLocation + undo_capacity(undoType) / 20);
 	targetUndoLocation = Min(targetUndoLocation, minProcReservedLocation);
 
 	Assert(targetUndoLocation >= pg_atomic_read_u64(&meta->writeInProgressLocation));
@@ -1040,7 +1233,7 @@ evict_undo_to_disk(UndoLogType undoType,
 	if (retainUndoLocation % circularBufferSize <
 		targetUndoLocation % circularBufferSize)
 	{
-		write_undo_range(&undoBuffersDesc,
+		evict_undo_range(&undoBuffersDesc,
 						 circularBuffer + retainUndoLocation % circularBufferSize,
 						 undoType,
 						 retainUndoLocation, targetUndoLocation);
@@ -1051,23 +1244,164 @@ evict_undo_to_disk(UndoLogType undoType,
 
 		breakUndoLocation = retainUndoLocation + (circularBufferSize -
 												  (retainUndoLocation % circularBufferSize));
-		write_undo_range(&undoBuffersDesc,
+		evict_undo_range(&undoBuffersDesc,
 						 circularBuffer + retainUndoLocation % circularBufferSize,
 						 undoType,
 						 retainUndoLocation, breakUndoLocation);
-		write_undo_range(&undoBuffersDesc,
+		evict_undo_range(&undoBuffersDesc,
 						 circularBuffer, undoType,
 						 breakUndoLocation, targetUndoLocation);
 	}
 
+	pg_atomic_fetch_add_u64(&meta->evictedBytes,
+							targetUndoLocation - retainUndoLocation);
+
 	SpinLockAcquire(&meta->minUndoLocationsMutex);
 	Assert(targetUndoLocation >= pg_atomic_read_u64(&meta->writtenLocation));
 	pg_atomic_write_u64(&meta->writtenLocation, targetUndoLocation);
 	SpinLockRelease(&meta->minUndoLocationsMutex);
 
+	undo_release_memory(undoType, writtenLocation, targetUndoLocation);
+
 	LWLockRelease(&meta->undoWriteLock);
 }
 
+/*
+ * Returns the memory of the [fromLoc, toLoc) range of the circular buffer to
+ * the OS, when the memory of the undo logs is shared adaptively.  The range
+ * is behind the written location, so it's read from disk.  The concurrent
+ * writers can't reach the same part of the buffer while we hold the
+ * undoWriteLock: the written location advances by at most the capacity,
+ * which is at most half of the circular buffer.  Only the OS pages fully
+ * within the range are released, the live data might share the others.
+ */
+static void
+undo_release_memory(UndoLogType undoType, UndoLocation fromLoc,
+					UndoLocation toLoc)
+{
+#if defined(__linux__) && defined(MADV_REMOVE)
+	static uintptr_t pageSize = 0;
+	static bool failed = false;
+	Size		circularBufferSize = o_undo_circular_sizes[(int) undoType];
+
+	if (!undo_adaptive_split || failed || toLoc <= fromLoc)
+		return;
+	if (pageSize == 0)
+		pageSize = (uintptr_t) sysconf(_SC_PAGESIZE);
+
+	fromLoc = Max(fromLoc, toLoc - Min(toLoc, circularBufferSize));
+	while (fromLoc < toLoc && !failed)
+	{
+		UndoLocation endLoc = Min(toLoc, fromLoc + (circularBufferSize -
+													fromLoc % circularBufferSize));
+		uintptr_t	start = TYPEALIGN(pageSize, (uintptr_t) GET_UNDO_REC(undoType, fromLoc)),
+					end = TYPEALIGN_DOWN(pageSize,
+										 (uintptr_t) GET_UNDO_REC(undoType, fromLoc) +
+										 (endLoc - fromLoc));
+
+		if (end > start &&
+			madvise((void *) start, end - start, MADV_REMOVE) != 0)
+		{
+			/* Huge pages can't be released partially, so just keep them */
+			failed = true;
+			elog(LOG, "could not release the memory of the undo circular buffer: %m");
+		}
+		fromLoc = endLoc;
+	}
+#endif
+}
+
+/*
+ * Moves the capacity between the undo logs, when orioledb.undo_adaptive_split
+ * is set.  The undo log, which was evicted to disk the most since the last
+ * call, takes a step of capacity from another one, which wasn't evicted and
+ * has twice the step free.  So the undo goes to disk only while all the logs
+ * are short of memory.  The capacities never get below the minimal size
+ * needed for the reservations of all the backends, and their sum stays the
+ * same.  Called by the first background writer.
+ */
+void
+undo_balance_split(void)
+{
+	static uint64 prevEvictedBytes[(int) UndoLogsCount];
+	static bool initialized = false;
+	uint64		evicted[(int) UndoLogsCount],
+				maxEvicted = 0;
+	Size		step = TYPEALIGN_DOWN(PG_CACHE_LINE_SIZE,
+									  o_undo_total_capacity / UNDO_BALANCE_STEPS),
+				maxFree = 0;
+	int			i,
+				receiver = -1,
+				donor = -1;
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		uint64		evictedBytes = pg_atomic_read_u64(&undo_metas[i].evictedBytes);
+
+		evicted[i] = evictedBytes - prevEvictedBytes[i];
+		prevEvictedBytes[i] = evictedBytes;
+		if (evicted[i] > maxEvicted)
+		{
+			maxEvicted = evicted[i];
+			receiver = i;
+		}
+	}
+
+	if (!initialized)
+	{
+		initialized = true;
+		return;
+	}
+	if (receiver < 0 || step == 0)
+		return;
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		UndoMeta   *meta = &undo_metas[i];
+		Size		capacity = undo_capacity((UndoLogType) i),
+					used;
+		UndoLocation reserved = pg_atomic_read_u64(&meta->advanceReservedLocation),
+					written = pg_atomic_read_u64(&meta->writtenLocation);
+
+		if (i == receiver || evicted[i] > 0)
+			continue;
+
+		used = reserved - Min(reserved, written);
+		if (capacity < used + 2 * step || capacity < UNDO_MIN_CAPACITY + step)
+			continue;
+		if (capacity - used > maxFree)
+		{
+			maxFree = capacity - used;
+			donor = i;
+		}
+	}
+	if (donor < 0)
+		return;
+
+	/* Shrink first, so the sum never exceeds the undo memory */
+	pg_atomic_fetch_sub_u64(&undo_metas[donor].circularCapacity, step);
+	pg_atomic_fetch_add_u64(&undo_metas[receiver].circularCapacity, step);
+}
+
+/*
+ * Size of the arena reserved in advance.  The arenas of all the processes
+ * shouldn't take more than a quarter of the circular buffer.  Reserving in
+ * advance makes sense only within a transaction, which returns the arena at
+ * its end.
+ */
+static Size
+undo_arena_limit(UndoLogType undoType)
+{
+	Size		limit;
+
+	if (undo_reserve_batch == 0 || !IsTransactionState())
+		return 0;
+
+	limit = Min((Size) undo_reserve_batch * 1024,
+				undo_capacity(undoType) / (4 * max_procs));
+	return MAXALIGN_DOWN(limit);
+}
+
 bool
 reserve_undo_size_extended(UndoLogType undoType, Size size,
 						   bool waitForUndoLocation)
@@ -1075,8 +1409,11 @@ reserve_undo_size_extended(UndoLogType undoType, Size size,
 	UndoLocation location;
 	uint64		minProcReservedLocation;
 	UndoMeta   *meta = get_undo_meta_by_type(undoType);
-	Size		circularBufferSize = o_undo_circular_sizes[(int) undoType];
+	Size		circularBufferSize = undo_capacity(undoType);
+	Size		arenaSize;
 	ODBProcData *curProcData PG_USED_FOR_ASSERTS_ONLY = GET_CUR_PROCDATA();
+	ORelOids	noOids;
+	OpSamplingProcState opSaved;
 
 	Assert(!waitForUndoLocation || !have_locked_pages());
 	Assert(undoType != UndoLogNone);
@@ -1088,9 +1425,36 @@ reserve_undo_size_extended(UndoLogType undoType, Size size,
 
 	size -= reserved_undo_sizes[(int) undoType];
 
-	location = pg_atomic_fetch_add_u64(&meta->advanceReservedLocation, size);
+	/* Carve the reservation from the arena if possible */
+	if (undo_arena_sizes[(int) undoType] >= size)
+	{
+		undo_arena_sizes[(int) undoType] -= size;
+		reserved_undo_sizes[(int) undoType] += size;
+		return true;
+	}
+	size -= undo_arena_sizes[(int) undoType];
+	reserved_undo_sizes[(int) undoType] += undo_arena_sizes[(int) undoType];
+	undo_arena_sizes[(int) undoType] = 0;
+
+	/*
+	 * Refill the arena together with the reservation, but only while it fits
+	 * the circular buffer without an eviction.
+	 */
+	arenaSize = undo_arena_limit(undoType);
+	location = pg_atomic_fetch_add_u64(&meta->advanceReservedLocation,
+									   size + arenaSize);
 	reserved_undo_sizes[(int) undoType] += size;
 
+	if (location + size + arenaSize <=
+		pg_atomic_read_u64(&meta->writtenLocation) + circularBufferSize)
+	{
+		undo_arena_sizes[(int) undoType] = arenaSize;
+		return true;
+	}
+
+	if (arenaSize > 0)
+		pg_atomic_fetch_sub_u64(&meta->advanceReservedLocation, arenaSize);
+
 	if (location + size <=
 		pg_atomic_read_u64(&meta->writtenLocation) + circularBufferSize)
 		return true;
@@ -1125,6 +1489,10 @@ reserve_undo_size_extended(UndoLogType undoType, Size size,
 		return false;
 	}
 
+	ORIOLEDB_PROBE2(undo_reserve__wait__start, undoType, size);
+	ORelOidsSetInvalid(noOids);
+	opSaved = op_sampling_begin(OpSamplingUndoReserve, noOids);
+
 	if (location + size <=
 		pg_atomic_read_u64(&meta->writeInProgressLocation) + circularBufferSize)
 	{
@@ -1139,12 +1507,16 @@ reserve_undo_size_extended(UndoLogType undoType, Size size,
 		SpinLockAcquire(&meta->minUndoLocationsMutex);
 		Assert(location + size <= pg_atomic_read_u64(&meta->writtenLocation) + circularBufferSize);
 		SpinLockRelease(&meta->minUndoLocationsMutex);
+		op_sampling_end(opSaved);
+		ORIOLEDB_PROBE2(undo_reserve__wait__done, undoType, size);
 		return true;
 	}
 
 	evict_undo_to_disk(undoType, location + size - circularBufferSize,
 					   minProcReservedLocation, false);
 	Assert(location + size <= pg_atomic_read_u64(&meta->writtenLocation) + circularBufferSize);
+	op_sampling_end(opSaved);
+	ORIOLEDB_PROBE2(undo_reserve__wait__done, undoType, size);
 
 	return true;
 }
@@ -1211,6 +1583,7 @@ fsync_undo_range(UndoLogType undoType,
 
 	o_buffers_sync(&undoBuffersDesc, (uint32) undoType,
 				   fromLoc, toLoc, wait_event_info);
+	undo_compress_sync(undoType, fromLoc, toLoc, wait_event_info);
 }
 
 Pointer
@@ -1276,11 +1649,40 @@ release_undo_size(UndoLogType undoType)
 
 	if (reserved_undo_sizes[(int) undoType] != 0)
 	{
-		pg_atomic_fetch_sub_u64(&meta->advanceReservedLocation, reserved_undo_sizes[(int) undoType]);
+		Size		limit = undo_arena_limit(undoType);
+		Size		keep = 0;
+
+		/* Keep the unused reservation in the arena till the transaction end */
+		if (undo_arena_sizes[(int) undoType] < limit)
+			keep = Min(reserved_undo_sizes[(int) undoType],
+					   limit - undo_arena_sizes[(int) undoType]);
+		undo_arena_sizes[(int) undoType] += keep;
+		reserved_undo_sizes[(int) undoType] -= keep;
+
+		if (reserved_undo_sizes[(int) undoType] != 0)
+			pg_atomic_fetch_sub_u64(&meta->advanceReservedLocation, reserved_undo_sizes[(int) undoType]);
 		reserved_undo_sizes[(int) undoType] = 0;
 	}
 }
 
+/*
+ * Returns both the reservation and the arena.  Called at the transaction end.
+ */
+void
+release_undo_arena(UndoLogType undoType)
+{
+	UndoMeta   *meta = get_undo_meta_by_type(undoType);
+	Size		size;
+
+	Assert(undoType != UndoLogNone);
+
+	size = reserved_undo_sizes[(int) undoType] + undo_arena_sizes[(int) undoType];
+	if (size != 0)
+		pg_atomic_fetch_sub_u64(&meta->advanceReservedLocation, size);
+	reserved_undo_sizes[(int) undoType] = 0;
+	undo_arena_sizes[(int) undoType] = 0;
+}
+
 Size
 get_reserved_undo_size(UndoLogType undoType)
 {
@@ -1438,7 +1840,7 @@ orioledb_reset_xmin_hook(void)
 	}
 
 	if (xmin > pg_atomic_read_u64(&curProcData->xmin))
-		pg_atomic_write_u64(&curProcData->xmin, xmin);
+		set_my_xmin(xmin);
 }
 
 static void
@@ -1468,7 +1870,7 @@ rewind_handle_pending_deletes(void)
 void
 undo_xact_callback(XactEvent event, void *arg)
 {
-	OXid		oxid = get_current_oxid_if_any();
+	OXid		oxid;
 	CommitSeqNo csn;
 	ODBProcData *curProcData = GET_CUR_PROCDATA();
 	bool		isParallelWorker;
@@ -1478,6 +1880,15 @@ undo_xact_callback(XactEvent event, void *arg)
 	TransactionId *subxids = NULL;
 
 	/* elog(LOG, "UNDO XACT CALLBACK"); */
+
+	/* Buffered inserts of the apply worker might assign the oxid */
+	if (event == XACT_EVENT_PRE_COMMIT || event == XACT_EVENT_PRE_PREPARE)
+		o_apply_flush_inserts();
+	else if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT ||
+			 event == XACT_EVENT_PREPARE)
+		o_apply_discard_inserts();
+	oxid = get_current_oxid_if_any();
+
 	isParallelWorker = (MyProc->lockGroupLeader != NULL &&
 						MyProc->lockGroupLeader != MyProc) ||
 		IsInParallelMode();
@@ -1489,7 +1900,10 @@ undo_xact_callback(XactEvent event, void *arg)
 	ea_counters = NULL;
 
 	if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT)
+	{
 		seq_scans_cleanup();
+		tree_stats_flush();
+	}
 
 	if (enable_rewind && event == XACT_EVENT_PRE_COMMIT)
 	{
@@ -1526,6 +1940,13 @@ undo_xact_callback(XactEvent event, void *arg)
 		Assert(!RecoveryInProgress());
 		switch (event)
 		{
+			case XACT_EVENT_PRE_PREPARE:
+				if (have_compact_row_locks(oxid))
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("cannot PREPARE a transaction that has taken compact row locks"),
+							 errhint("Disable orioledb.compact_row_locks for the transactions to be prepared.")));
+				break;
 			case XACT_EVENT_PRE_COMMIT:
 				if (TransactionIdIsValid(xid))
 					wal_joint_commit(oxid,
@@ -1544,7 +1965,7 @@ undo_xact_callback(XactEvent event, void *arg)
 					if (!XLogRecPtrIsInvalid(flushPos) &&
 						(synchronous_commit > SYNCHRONOUS_COMMIT_OFF ||
 						 oxid_needs_wal_flush))
-						XLogFlush(flushPos);
+						wal_commit_flush(flushPos);
 				}
 				else
 				{
@@ -1569,6 +1990,7 @@ undo_xact_callback(XactEvent event, void *arg)
 				}
 				for (i = 0; i < (int) UndoLogsCount; i++)
 					on_commit_undo_stack((UndoLogType) i, oxid, true);
+				release_compact_row_locks(oxid, false);
 
 				wal_after_commit();
 				reset_cur_undo_locations();
@@ -1581,6 +2003,7 @@ undo_xact_callback(XactEvent event, void *arg)
 								 get_current_logical_xid());
 				for (i = 0; i < (int) UndoLogsCount; i++)
 					apply_undo_stack((UndoLogType) i, oxid, NULL, true);
+				release_compact_row_locks(oxid, true);
 				reset_cur_undo_locations();
 				reset_command_undo_locations();
 				current_oxid_abort();
@@ -1603,20 +2026,22 @@ undo_xact_callback(XactEvent event, void *arg)
 		}
 	}
 
-	if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT)
+	/* The backend's undo reservations don't outlive its transaction */
+	if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT ||
+		event == XACT_EVENT_PREPARE)
 	{
 		for (i = 0; i < (int) UndoLogsCount; i++)
-			release_undo_size((UndoLogType) i);
-
-		for (i = 0; i < OPagePoolTypesCount; i++)
-		{
-			OPagePool  *pool = get_ppool((OPagePoolType) i);
+			release_undo_arena((UndoLogType) i);
+	}
 
-			ppool_release_reserved(pool, PPOOL_RESERVE_MASK_ALL);
-		}
+	if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT)
+	{
+		ppool_release_all_pages();
 
 		for (i = 0; i < (int) UndoLogsCount; i++)
 			free_retained_undo_location((UndoLogType) i);
+
+		o_memory_xact_end();
 	}
 
 	if (event == XACT_EVENT_COMMIT && isParallelWorker)
@@ -1802,6 +2227,12 @@ undo_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 	 */
 	ea_counters = NULL;
 
+	/*
+	 * Inserts buffered by the apply worker belong to the parent: flush them
+	 * before the savepoint undo item is added.
+	 */
+	o_apply_flush_inserts();
+
 	switch (event)
 	{
 		case SUBXACT_EVENT_START_SUB:
@@ -1813,12 +2244,14 @@ undo_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 			break;
 		case SUBXACT_EVENT_COMMIT_SUB:
 			update_subxact_undo_location_on_commit(parentSubid);
+			release_subtransaction_logical_xid();
 			break;
 		case SUBXACT_EVENT_ABORT_SUB:
 			for (i = 0; i < (int) UndoLogsCount; i++)
 				rollback_to_savepoint((UndoLogType) i, UndoStackFull,
 									  parentSubid, true);
 			add_rollback_to_savepoint_wal_record(parentSubid);
+			rollback_subtransaction_logical_xid();
 
 			/*
 			 * It might happen that we've released some row-level locks.  Some
@@ -1871,94 +2304,358 @@ orioledb_has_retained_undo(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(result);
 }
 
-void
-start_autonomous_transaction(OAutonomousTxState *state)
+static const char *const undo_type_names[] = {"row", "page", "system"};
+
+#define UNDO_STATS_COLUMNS	(19)
+
+/*
+ * Returns the usage and retention of every undo log.  The retaining process
+ * is the one, whose transaction or snapshot holds the lowest retain location.
+ */
+Datum
+orioledb_undo_stats(PG_FUNCTION_ARGS)
 {
-	int			i;
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			i,
+				j;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+	{
+		UndoMeta   *meta = get_undo_meta_by_type((UndoLogType) i);
+		Size		circularBufferSize = undo_capacity((UndoLogType) i);
+		Datum		values[UNDO_STATS_COLUMNS];
+		bool		nulls[UNDO_STATS_COLUMNS];
+		UndoLocation lastUsedLocation,
+					advanceReservedLocation,
+					writtenLocation,
+					minRetainLocation,
+					retainLocation = InvalidUndoLocation;
+		int			retainProc = -1;
+		bool		retainBySnapshot = false;
+		TimestampTz retainTime = 0;
+
+		lastUsedLocation = pg_atomic_read_u64(&meta->lastUsedLocation);
+		advanceReservedLocation = pg_atomic_read_u64(&meta->advanceReservedLocation);
+		writtenLocation = pg_atomic_read_u64(&meta->writtenLocation);
+		minRetainLocation = pg_atomic_read_u64(enable_rewind ?
+											   &meta->minRewindRetainLocation :
+											   &meta->minProcRetainLocation);
+
+		for (j = 0; j < max_procs; j++)
+		{
+			UndoRetainSharedLocations *locations = &oProcData[j].undoRetainLocations[i];
+			UndoLocation tmp;
+
+			tmp = pg_atomic_read_u64(&locations->transactionUndoRetainLocation);
+			if (UndoLocationIsValid(tmp) &&
+				(retainProc < 0 || tmp < retainLocation))
+			{
+				retainLocation = tmp;
+				retainProc = j;
+				retainBySnapshot = false;
+				retainTime = locations->transactionRetainTime;
+			}
+			tmp = pg_atomic_read_u64(&locations->snapshotRetainUndoLocation);
+			if (UndoLocationIsValid(tmp) &&
+				(retainProc < 0 || tmp < retainLocation))
+			{
+				retainLocation = tmp;
+				retainProc = j;
+				retainBySnapshot = true;
+				retainTime = locations->snapshotRetainTime;
+			}
+		}
+
+		MemSet(nulls, 0, sizeof(nulls));
+		values[0] = CStringGetTextDatum(undo_type_names[i]);
+		values[1] = Int64GetDatum(circularBufferSize);
+		values[2] = Int64GetDatum(lastUsedLocation);
+		values[3] = Int64GetDatum(advanceReservedLocation - lastUsedLocation);
+		values[4] = Int64GetDatum(writtenLocation);
+		values[5] = Float8GetDatum(circularBufferSize == 0 ? 0.0 :
+								   (double) (lastUsedLocation - Min(lastUsedLocation,
+																	Max(writtenLocation,
+																		minRetainLocation))) /
+								   circularBufferSize);
+		values[6] = Int64GetDatum(pg_atomic_read_u64(&meta->minProcReservedLocation));
+		values[7] = Int64GetDatum(pg_atomic_read_u64(&meta->minProcTransactionRetainLocation));
+		values[8] = Int64GetDatum(pg_atomic_read_u64(&meta->minProcRetainLocation));
+		values[9] = Int64GetDatum(pg_atomic_read_u64(&meta->minRewindRetainLocation));
+		nulls[9] = !enable_rewind;
+		values[10] = Int64GetDatum(pg_atomic_read_u64(&meta->checkpointRetainStartLocation));
+		values[11] = Int64GetDatum(pg_atomic_read_u64(&meta->checkpointRetainEndLocation));
+		values[12] = Int64GetDatum(lastUsedLocation - Min(lastUsedLocation,
+														  minRetainLocation));
+		values[13] = Int64GetDatum(pg_atomic_read_u64(&meta->evictedBytes));
+		values[14] = Int64GetDatum(pg_atomic_read_u64(&meta->diskReads));
+		values[15] = Int64GetDatum(pg_atomic_read_u64(&meta->diskReadBytes));
+		if (retainProc >= 0)
+		{
+			PGPROC	   *proc = GetPGProcByNumber(retainProc);
+
+			values[16] = Int32GetDatum(proc->pid);
+			values[17] = CStringGetTextDatum(retainBySnapshot ? "snapshot" : "transaction");
+			values[18] = TimestampTzGetDatum(retainTime);
+			nulls[18] = (retainTime == 0);
+		}
+		else
+		{
+			nulls[16] = nulls[17] = nulls[18] = true;
+		}
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * The batch of the autonomous transactions.  The system tree modifications
+ * started by start_batched_autonomous_transaction() while the batch is open
+ * share the single autonomous transaction, which is committed or aborted by
+ * end_autonomous_batch().  The batch transaction keeps the nesting level above
+ * the one the batch was opened at.  Other autonomous transactions started at
+ * the same level skip it.
+ */
+static int	autonomousBatchDepth = 0;
+static int	autonomousBatchLevel = -1;
+static OXid autonomousBatchOxid = InvalidOXid;
+static TransactionId autonomousBatchLogicalXid = InvalidTransactionId;
+static bool autonomousBatchNeedsWalFlush = false;
+static bool autonomousBatchHasMaterialChanges = false;
+
+static void
+autonomous_transaction_enter(OAutonomousTxState *state, bool batched)
+{
+	ODBProcData *curProcData = GET_CUR_PROCDATA();
 
 	state->needs_wal_flush = oxid_needs_wal_flush;
 	state->oxid = get_current_oxid();
 	state->logicalXid = get_current_logical_xid();
-	for (i = 0; i < (int) UndoLogsCount; i++)
-		state->has_retained_undo_location[i] = undo_type_has_retained_location((UndoLogType) i);
 	state->local_wal_has_material_changes = get_local_wal_has_material_changes();
+	state->nestingLevel = curProcData->autonomousNestingLevel;
+	state->batched = batched;
 
 	if (!is_recovery_process() && !local_wal_is_empty())
 		flush_local_wal(false);
 
 	oxid_needs_wal_flush = false;
 	reset_current_oxid();
-	GET_CUR_PROCDATA()->autonomousNestingLevel++;
+	curProcData->autonomousNestingLevel++;
+	if (!batched && curProcData->autonomousNestingLevel == autonomousBatchLevel)
+		curProcData->autonomousNestingLevel++;
 }
 
-void
-abort_autonomous_transaction(OAutonomousTxState *state)
+static void
+autonomous_transaction_leave(OAutonomousTxState *state)
+{
+	oxid_needs_wal_flush = state->needs_wal_flush;
+	GET_CUR_PROCDATA()->autonomousNestingLevel = state->nestingLevel;
+	set_current_oxid(state->oxid);
+	set_current_logical_xid(state->logicalXid);
+	set_local_wal_has_material_changes(state->local_wal_has_material_changes);
+}
+
+static void
+autonomous_transaction_abort_current(bool *has_retained_undo_location)
 {
 	OXid		oxid = get_current_oxid_if_any();
+	int			i;
 
-	if (OXidIsValid(oxid))
+	if (!OXidIsValid(oxid))
+		return;
+
+	if (!is_recovery_process())
+		wal_rollback(oxid,
+					 get_current_logical_xid());
+	/* Roll back the changes before the oxid is considered finished */
+	for (i = 0; i < (int) UndoLogsCount; i++)
+		apply_undo_stack((UndoLogType) i, oxid, NULL, true);
+	current_oxid_abort();
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+		release_undo_size((UndoLogType) i);
+	for (i = 0; has_retained_undo_location && i < (int) UndoLogsCount; i++)
 	{
-		int			i;
+		if (!has_retained_undo_location[i])
+			free_retained_undo_location((UndoLogType) i);
+	}
+}
 
-		if (!is_recovery_process())
-			wal_rollback(oxid,
-						 get_current_logical_xid());
-		current_oxid_abort();
-		for (i = 0; i < (int) UndoLogsCount; i++)
-			apply_undo_stack((UndoLogType) i, oxid, NULL, true);
+static void
+autonomous_transaction_commit_current(bool *has_retained_undo_location)
+{
+	OXid		oxid = get_current_oxid_if_any();
+	CommitSeqNo csn;
+	int			i;
 
-		for (i = 0; i < (int) UndoLogsCount; i++)
-			release_undo_size((UndoLogType) i);
-		for (i = 0; i < (int) UndoLogsCount; i++)
-		{
-			if (!state->has_retained_undo_location[i])
-				free_retained_undo_location((UndoLogType) i);
-		}
+	if (!OXidIsValid(oxid))
+		return;
+
+	if (!is_recovery_process())
+		wal_commit(oxid,
+				   get_current_logical_xid());
+
+	current_oxid_precommit();
+	csn = pg_atomic_fetch_add_u64(&TRANSAM_VARIABLES->nextCommitSeqNo, 1);
+	current_oxid_commit(csn);
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+		on_commit_undo_stack((UndoLogType) i, oxid, true);
+	wal_after_commit();
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+		release_undo_size((UndoLogType) i);
+	for (i = 0; has_retained_undo_location && i < (int) UndoLogsCount; i++)
+	{
+		if (!has_retained_undo_location[i])
+			free_retained_undo_location((UndoLogType) i);
 	}
+}
 
-	oxid_needs_wal_flush = state->needs_wal_flush;
-	GET_CUR_PROCDATA()->autonomousNestingLevel--;
-	set_current_oxid(state->oxid);
-	set_current_logical_xid(state->logicalXid);
-	set_local_wal_has_material_changes(state->local_wal_has_material_changes);
+void
+start_autonomous_transaction(OAutonomousTxState *state)
+{
+	int			i;
+
+	for (i = 0; i < (int) UndoLogsCount; i++)
+		state->has_retained_undo_location[i] = undo_type_has_retained_location((UndoLogType) i);
+	autonomous_transaction_enter(state, false);
+}
+
+void
+abort_autonomous_transaction(OAutonomousTxState *state)
+{
+	if (state->batched)
+	{
+		/* The batch can't be partially aborted, so abort it all */
+		autonomous_transaction_abort_current(NULL);
+		autonomousBatchOxid = InvalidOXid;
+		autonomousBatchLogicalXid = InvalidTransactionId;
+		autonomousBatchNeedsWalFlush = false;
+		autonomousBatchHasMaterialChanges = false;
+		reset_current_oxid();
+	}
+	else
+	{
+		autonomous_transaction_abort_current(state->has_retained_undo_location);
+	}
+	autonomous_transaction_leave(state);
 }
 
 void
 finish_autonomous_transaction(OAutonomousTxState *state)
 {
-	OXid		oxid = get_current_oxid_if_any();
+	int			i;
 
-	if (OXidIsValid(oxid))
+	if (state->batched)
+	{
+		/* Keep the batch transaction in progress till the end of the batch */
+		autonomousBatchOxid = get_current_oxid_if_any();
+		autonomousBatchLogicalXid = get_current_logical_xid();
+		autonomousBatchNeedsWalFlush = oxid_needs_wal_flush;
+		autonomousBatchHasMaterialChanges |= get_local_wal_has_material_changes();
+		if (!is_recovery_process() && !local_wal_is_empty())
+			flush_local_wal(false);
+		for (i = 0; i < (int) UndoLogsCount; i++)
+			release_undo_size((UndoLogType) i);
+		reset_current_oxid();
+	}
+	else
 	{
-		CommitSeqNo csn;
-		int			i;
+		autonomous_transaction_commit_current(state->has_retained_undo_location);
+	}
+	autonomous_transaction_leave(state);
+}
 
-		if (!is_recovery_process())
-			wal_commit(oxid,
-					   get_current_logical_xid());
+/*
+ * Starts the autonomous transaction, which joins the open batch.  Works as
+ * start_autonomous_transaction() if there is no batch open at the current
+ * nesting level.
+ */
+void
+start_batched_autonomous_transaction(OAutonomousTxState *state)
+{
+	if (autonomousBatchDepth == 0 || is_recovery_process() ||
+		GET_CUR_PROCDATA()->autonomousNestingLevel + 1 != autonomousBatchLevel)
+	{
+		start_autonomous_transaction(state);
+		return;
+	}
 
-		current_oxid_precommit();
-		csn = pg_atomic_fetch_add_u64(&TRANSAM_VARIABLES->nextCommitSeqNo, 1);
-		current_oxid_commit(csn);
+	autonomous_transaction_enter(state, true);
+	if (OXidIsValid(autonomousBatchOxid))
+	{
+		set_current_oxid(autonomousBatchOxid);
+		set_current_logical_xid(autonomousBatchLogicalXid);
+		oxid_needs_wal_flush = autonomousBatchNeedsWalFlush;
+	}
+}
 
-		for (i = 0; i < (int) UndoLogsCount; i++)
-			on_commit_undo_stack((UndoLogType) i, oxid, true);
-		wal_after_commit();
+void
+begin_autonomous_batch(void)
+{
+	if (autonomousBatchDepth++ > 0)
+		return;
 
-		for (i = 0; i < (int) UndoLogsCount; i++)
-			release_undo_size((UndoLogType) i);
-		for (i = 0; i < (int) UndoLogsCount; i++)
-		{
-			if (!state->has_retained_undo_location[i])
-				free_retained_undo_location((UndoLogType) i);
-		}
+	Assert(!OXidIsValid(autonomousBatchOxid));
+	autonomousBatchLevel = GET_CUR_PROCDATA()->autonomousNestingLevel + 1;
+}
+
+/*
+ * Commits or aborts the batch transaction.  Its retained undo locations are
+ * released together with the ones of the main transaction.
+ */
+void
+end_autonomous_batch(bool commit)
+{
+	OAutonomousTxState state;
+
+	Assert(autonomousBatchDepth > 0);
+	if (--autonomousBatchDepth > 0)
+		return;
+
+	if (OXidIsValid(autonomousBatchOxid))
+	{
+		autonomous_transaction_enter(&state, true);
+		set_current_oxid(autonomousBatchOxid);
+		set_current_logical_xid(autonomousBatchLogicalXid);
+		oxid_needs_wal_flush = autonomousBatchNeedsWalFlush;
+		set_local_wal_has_material_changes(autonomousBatchHasMaterialChanges);
+
+		if (commit)
+			autonomous_transaction_commit_current(NULL);
+		else
+			autonomous_transaction_abort_current(NULL);
+		reset_current_oxid();
+		autonomous_transaction_leave(&state);
 	}
 
-	oxid_needs_wal_flush = state->needs_wal_flush;
-	GET_CUR_PROCDATA()->autonomousNestingLevel--;
-	set_current_oxid(state->oxid);
-	set_current_logical_xid(state->logicalXid);
-	set_local_wal_has_material_changes(state->local_wal_has_material_changes);
+	autonomousBatchLevel = -1;
+	autonomousBatchOxid = InvalidOXid;
+	autonomousBatchLogicalXid = InvalidTransactionId;
+	autonomousBatchNeedsWalFlush = false;
+	autonomousBatchHasMaterialChanges = false;
 }
 
 void
@@ -2072,6 +2769,7 @@ undo_write(UndoLogType undoType, UndoLocation location, Size size, Pointer buf)
 	}
 
 	/* Finally perform writing to the file */
+	Assert(!undo_type_compressible(undoType));
 	write_undo_range(&undoBuffersDesc, buf, undoType,
 					 location, memoryUndoLocation);
 }
@@ -2149,18 +2847,37 @@ orioledb_snapshot_hook(Snapshot snapshot)
 
 		lastUsedLocation = pg_atomic_read_u64(&meta->lastUsedLocation);
 		lastUsedUndoLocationWhenUpdatedMinLocation = pg_atomic_read_u64(&meta->lastUsedUndoLocationWhenUpdatedMinLocation);
-		if (lastUsedLocation - lastUsedUndoLocationWhenUpdatedMinLocation > o_undo_circular_sizes[(int) undoType] / 10)
+		if (lastUsedLocation - lastUsedUndoLocationWhenUpdatedMinLocation > undo_capacity(undoType) / 10)
 			update_min_undo_locations(undoType, false, true);
 	}
 
 
-	snapshot->undoRegularRowLocationPhNode.undoLocation = set_my_retain_location(UndoLogRegular);
-	snapshot->undoRegularPageLocationPhNode.undoLocation = set_my_retain_location(UndoLogRegularPageLevel);
-	snapshot->undoSystemLocationPhNode.undoLocation = set_my_retain_location(UndoLogSystem);
-	xmin = pg_atomic_read_u64(&xid_meta->runXmin);
 	curXmin = pg_atomic_read_u64(&curProcData->xmin);
-	if (!OXidIsValid(curXmin))
-		pg_atomic_write_u64(&curProcData->xmin, xmin);
+	if (orioledb_fast_snapshots && OXidIsValid(curXmin) &&
+		UndoLocationIsValid(get_snapshot_retained_undo_location(UndoLogRegular)) &&
+		UndoLocationIsValid(get_snapshot_retained_undo_location(UndoLogRegularPageLevel)) &&
+		UndoLocationIsValid(get_snapshot_retained_undo_location(UndoLogSystem)))
+	{
+		/*
+		 * The backend already retains the undo and the xmin for its other
+		 * snapshot.  They are not newer than the ones we would take now, and
+		 * the backend itself keeps them while the new snapshot is registered.
+		 * So the new snapshot only needs to read the CSN.
+		 */
+		snapshot->undoRegularRowLocationPhNode.undoLocation = get_snapshot_retained_undo_location(UndoLogRegular);
+		snapshot->undoRegularPageLocationPhNode.undoLocation = get_snapshot_retained_undo_location(UndoLogRegularPageLevel);
+		snapshot->undoSystemLocationPhNode.undoLocation = get_snapshot_retained_undo_location(UndoLogSystem);
+		xmin = curXmin;
+	}
+	else
+	{
+		snapshot->undoRegularRowLocationPhNode.undoLocation = set_my_retain_location(UndoLogRegular);
+		snapshot->undoRegularPageLocationPhNode.undoLocation = set_my_retain_location(UndoLogRegularPageLevel);
+		snapshot->undoSystemLocationPhNode.undoLocation = set_my_retain_location(UndoLogSystem);
+		xmin = pg_atomic_read_u64(&xid_meta->runXmin);
+		if (!OXidIsValid(curXmin))
+			set_my_xmin(xmin);
+	}
 
 	/*
 	 * Snapshot CSN could be newer than retained location, not older.  Enforce
@@ -2265,7 +2982,7 @@ update_command_undo_location(CommandId commandId, UndoLocation undoLocation)
 			if (commandInfos == commandInfosStatic)
 			{
 				commandInfosLength = 2 * lengthof(commandInfosStatic);
-				commandInfos = MemoryContextAlloc(TopMemoryContext,
+				commandInfos = MemoryContextAlloc(OrioleDBTopMemoryContext,
 												  sizeof(*commandInfos) * commandInfosLength);
 				memcpy(commandInfos, commandInfosStatic, sizeof(commandInfosStatic));
 			}
@@ -0,0 +1,382 @@
+/*-------------------------------------------------------------------------
+ *
+ * undo_compress.c
+ *		Compression of the evicted undo log.
+ *
+ * The page-level undo of the regular tables mostly consists of the page
+ * images, which compress well.  When orioledb.undo_compress is set, the
+ * evicted ranges of this undo log are compressed by the chunks of
+ * UNDO_COMPRESS_CHUNK_SIZE aligned by the undo location.  Only the chunks
+ * fully covered by a single eviction are compressed.  The compressed chunk is
+ * written at the beginning of its place in the undo file, so the rest of the
+ * place stays a hole of the sparse file.  The partially covered chunks and
+ * the chunks, which don't compress well, are written as is through o_buffers.
+ *
+ * Every undo file has an index file with the entry per chunk, which tells
+ * whether the chunk is compressed.  The index entries are written before the
+ * eviction advances writtenLocation, so readers of the evicted undo always
+ * see the entries of the chunks they read.  The undo locations after the
+ * restart might overlap with the ones evicted before the crash, so the
+ * eviction rewrites the entries of all the chunks it touches.
+ *
+ * The shared S3 storage uploads the undo files as is, so the undo isn't
+ * compressed in the S3 mode.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/transam/undo_compress.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/io.h"
+#include "transam/undo.h"
+#include "transam/undo_compress.h"
+#include "utils/compress.h"
+
+#include "pgstat.h"
+#include "storage/fd.h"
+
+#include <unistd.h>
+
+/* compress the chunk only if it saves at least 1/8 of the space */
+#define UNDO_COMPRESS_MAX_SIZE	(UNDO_COMPRESS_CHUNK_SIZE - UNDO_COMPRESS_CHUNK_SIZE / 8)
+
+typedef struct
+{
+	File		file;
+	int64		fileNum;
+	char		fileName[MAXPGPATH];
+} UndoCompressFile;
+
+static UndoCompressFile dataFile = {-1, -1};
+static UndoCompressFile indexFile = {-1, -1};
+
+/* backend-local copy of the index file */
+static uint32 indexCache[UNDO_COMPRESS_CHUNKS_PER_FILE];
+static int64 indexCacheFileNum = -1;
+static UndoLocation indexCacheValidTo = InvalidUndoLocation;
+
+/* the last decompressed chunk */
+static Pointer chunkCache = NULL;
+static UndoLocation chunkCacheLocation = InvalidUndoLocation;
+
+static Pointer compressBuf = NULL;
+
+bool
+undo_type_compressible(UndoLogType undoType)
+{
+	return undoType == UndoLogRegularPageLevel;
+}
+
+static bool
+undo_compress_enabled(UndoLogType undoType)
+{
+	return undo_type_compressible(undoType) &&
+		OCompressIsValid(undo_compress) && !orioledb_s3_mode;
+}
+
+/*
+ * Opens the data or the index file of the given number.  Returns false if the
+ * file doesn't exist and create isn't set.
+ */
+static bool
+undo_compress_open(UndoCompressFile *f, const char *template, int64 fileNum,
+				   bool create)
+{
+	if (f->file >= 0 && f->fileNum == fileNum)
+		return true;
+
+	if (f->file >= 0)
+		FileClose(f->file);
+	f->file = -1;
+
+	pg_snprintf(f->fileName, MAXPGPATH, template,
+				(uint32) (fileNum >> 32), (uint32) fileNum);
+	f->file = PathNameOpenFile(f->fileName,
+							   O_RDWR | (create ? O_CREAT : 0) | PG_BINARY);
+	if (f->file < 0)
+	{
+		if (!create && errno == ENOENT)
+			return false;
+		ereport(PANIC, (errcode_for_file_access(),
+						errmsg("could not open undo log file %s: %m",
+							   f->fileName)));
+	}
+	f->fileNum = fileNum;
+	return true;
+}
+
+static bool
+undo_compress_open_index(int64 fileNum, bool create)
+{
+	return undo_compress_open(&indexFile,
+							  ORIOLEDB_UNDO_DATA_PAGE_INDEX_FILENAME_TEMPLATE,
+							  fileNum, create);
+}
+
+static void
+undo_compress_open_data(int64 fileNum)
+{
+	(void) undo_compress_open(&dataFile,
+							  ORIOLEDB_UNDO_DATA_PAGE_FILENAME_TEMPLATE,
+							  fileNum, true);
+}
+
+/*
+ * Writes the index entries of the chunks [firstChunk, lastChunk] of the file.
+ * Doesn't create the index file if all the entries are raw.
+ */
+static void
+write_index_entries(int64 fileNum, uint32 firstChunk, uint32 lastChunk,
+					uint32 *entries, bool anyCompressed)
+{
+	int			size = (lastChunk - firstChunk + 1) * sizeof(uint32);
+
+	if (!undo_compress_open_index(fileNum, anyCompressed))
+		return;
+
+	if (OFileWrite(indexFile.file, (Pointer) entries, size,
+				   firstChunk * sizeof(uint32),
+				   WAIT_EVENT_SLRU_WRITE) != size)
+		ereport(PANIC, (errcode_for_file_access(),
+						errmsg("could not write undo index file %s: %m",
+							   indexFile.fileName)));
+}
+
+/*
+ * Writes the evicted undo range.  The buffer is contiguous in memory.
+ */
+void
+undo_compress_write_range(OBuffersDesc *desc, Pointer buf,
+						  UndoLogType undoType,
+						  UndoLocation minLoc, UndoLocation maxLoc)
+{
+	bool		enabled = undo_compress_enabled(undoType);
+	UndoLocation loc = minLoc;
+
+	Assert(undo_type_compressible(undoType));
+
+	if (maxLoc <= minLoc)
+		return;
+
+	if (enabled && !compressBuf)
+		compressBuf = MemoryContextAlloc(TopMemoryContext,
+										 UNDO_COMPRESS_CHUNK_SIZE);
+
+	while (loc < maxLoc)
+	{
+		int64		fileNum = loc / UNDO_FILE_SIZE;
+		UndoLocation fileEnd = Min((fileNum + 1) * UNDO_FILE_SIZE, maxLoc);
+		uint32		firstChunk = (loc % UNDO_FILE_SIZE) / UNDO_COMPRESS_CHUNK_SIZE;
+		uint32		lastChunk = ((fileEnd - 1) % UNDO_FILE_SIZE) / UNDO_COMPRESS_CHUNK_SIZE;
+		uint32		entries[UNDO_COMPRESS_CHUNKS_PER_FILE];
+		bool		anyCompressed = false;
+
+		while (loc < fileEnd)
+		{
+			UndoLocation chunkStart = loc - loc % UNDO_COMPRESS_CHUNK_SIZE;
+			UndoLocation chunkEnd = Min(chunkStart + UNDO_COMPRESS_CHUNK_SIZE,
+										fileEnd);
+			uint32		chunk = (loc % UNDO_FILE_SIZE) / UNDO_COMPRESS_CHUNK_SIZE;
+			size_t		size = 0;
+
+			if (enabled && loc == chunkStart &&
+				chunkEnd == chunkStart + UNDO_COMPRESS_CHUNK_SIZE)
+				size = o_compress_buffer(buf + (loc - minLoc),
+										 UNDO_COMPRESS_CHUNK_SIZE,
+										 compressBuf, UNDO_COMPRESS_MAX_SIZE,
+										 OCompressMake(undo_compress_codec,
+													   undo_compress));
+
+			if (size > 0)
+			{
+				undo_compress_open_data(fileNum);
+				if (OFileWrite(dataFile.file, compressBuf, size,
+							   loc % UNDO_FILE_SIZE,
+							   WAIT_EVENT_SLRU_WRITE) != size)
+					ereport(PANIC, (errcode_for_file_access(),
+									errmsg("could not write undo log file %s: %m",
+										   dataFile.fileName)));
+				entries[chunk - firstChunk] = UNDO_COMPRESS_ENTRY(undo_compress_codec,
+																  size);
+				anyCompressed = true;
+			}
+			else
+			{
+				o_buffers_write(desc, buf + (loc - minLoc), (uint32) undoType,
+								loc, chunkEnd - loc);
+				entries[chunk - firstChunk] = 0;
+			}
+			loc = chunkEnd;
+		}
+
+		write_index_entries(fileNum, firstChunk, lastChunk, entries,
+							anyCompressed);
+	}
+}
+
+/*
+ * Returns the index entry of the chunk.  The entry is taken from the
+ * backend-local copy of the index file if it was read after the chunk was
+ * evicted.
+ */
+static uint32
+get_index_entry(UndoLogType undoType, UndoLocation chunkStart)
+{
+	int64		fileNum = chunkStart / UNDO_FILE_SIZE;
+	uint32		chunk = (chunkStart % UNDO_FILE_SIZE) / UNDO_COMPRESS_CHUNK_SIZE;
+
+	if (indexCacheFileNum != fileNum ||
+		chunkStart + UNDO_COMPRESS_CHUNK_SIZE > indexCacheValidTo)
+	{
+		UndoMeta   *meta = get_undo_meta_by_type(undoType);
+		int			result = 0;
+
+		indexCacheValidTo = pg_atomic_read_u64(&meta->writtenLocation);
+		pg_read_barrier();
+
+		if (undo_compress_open_index(fileNum, false))
+		{
+			result = OFileRead(indexFile.file, (Pointer) indexCache,
+							   sizeof(indexCache), 0, WAIT_EVENT_SLRU_READ);
+			if (result < 0)
+				ereport(PANIC, (errcode_for_file_access(),
+								errmsg("could not read undo index file %s: %m",
+									   indexFile.fileName)));
+		}
+		memset((Pointer) indexCache + result, 0, sizeof(indexCache) - result);
+		indexCacheFileNum = fileNum;
+	}
+
+	return indexCache[chunk];
+}
+
+static void
+read_compressed_chunk(UndoLocation chunkStart, uint32 entry)
+{
+	Pointer		src;
+	int			size = UNDO_COMPRESS_ENTRY_SIZE(entry);
+
+	if (chunkCacheLocation == chunkStart)
+		return;
+
+	if (!chunkCache)
+		chunkCache = MemoryContextAlloc(TopMemoryContext,
+										UNDO_COMPRESS_CHUNK_SIZE);
+	src = palloc(size);
+
+	undo_compress_open_data(chunkStart / UNDO_FILE_SIZE);
+	if (OFileRead(dataFile.file, src, size, chunkStart % UNDO_FILE_SIZE,
+				  WAIT_EVENT_SLRU_READ) != size)
+		ereport(PANIC, (errcode_for_file_access(),
+						errmsg("could not read undo log file %s: %m",
+							   dataFile.fileName)));
+
+	chunkCacheLocation = InvalidUndoLocation;
+	o_decompress_buffer(UNDO_COMPRESS_ENTRY_CODEC(entry), src, size,
+						chunkCache, UNDO_COMPRESS_CHUNK_SIZE);
+	chunkCacheLocation = chunkStart;
+	pfree(src);
+}
+
+/*
+ * Reads the evicted undo range, which may contain the compressed chunks.
+ */
+void
+undo_compress_read_range(OBuffersDesc *desc, Pointer buf,
+						 UndoLogType undoType,
+						 UndoLocation minLoc, UndoLocation maxLoc)
+{
+	UndoLocation loc = minLoc;
+
+	Assert(undo_type_compressible(undoType));
+	Assert(maxLoc > minLoc);
+
+	while (loc < maxLoc)
+	{
+		UndoLocation chunkStart = loc - loc % UNDO_COMPRESS_CHUNK_SIZE;
+		UndoLocation chunkEnd = Min(chunkStart + UNDO_COMPRESS_CHUNK_SIZE,
+									maxLoc);
+		uint32		entry = get_index_entry(undoType, chunkStart);
+
+		if (UNDO_COMPRESS_ENTRY_IS_RAW(entry))
+		{
+			o_buffers_read(desc, buf + (loc - minLoc), (uint32) undoType,
+						   loc, chunkEnd - loc);
+		}
+		else
+		{
+			read_compressed_chunk(chunkStart, entry);
+			memcpy(buf + (loc - minLoc), chunkCache + (loc - chunkStart),
+				   chunkEnd - loc);
+		}
+		loc = chunkEnd;
+	}
+}
+
+/*
+ * Syncs the index files of the undo range.  The data files are synced by
+ * o_buffers_sync().
+ */
+void
+undo_compress_sync(UndoLogType undoType, UndoLocation fromLoc,
+				   UndoLocation toLoc, uint32 wait_event_info)
+{
+	int64		firstFileNumber,
+				lastFileNumber,
+				fileNumber;
+
+	if (!undo_type_compressible(undoType) || toLoc <= fromLoc)
+		return;
+
+	firstFileNumber = fromLoc / UNDO_FILE_SIZE;
+	lastFileNumber = (toLoc - 1) / UNDO_FILE_SIZE;
+
+	for (fileNumber = firstFileNumber; fileNumber <= lastFileNumber; fileNumber++)
+	{
+		if (undo_compress_open_index(fileNumber, false) &&
+			FileSync(indexFile.file, wait_event_info) < 0)
+			ereport(PANIC, (errcode_for_file_access(),
+							errmsg("could not fsync undo index file %s: %m",
+								   indexFile.fileName)));
+	}
+}
+
+void
+undo_compress_unlink_files_range(UndoLogType undoType, int64 firstFileNumber,
+								 int64 lastFileNumber)
+{
+	static char fileNameToUnlink[MAXPGPATH];
+	int64		fileNumber;
+
+	if (!undo_type_compressible(undoType))
+		return;
+
+	for (fileNumber = firstFileNumber;
+		 fileNumber <= lastFileNumber;
+		 fileNumber++)
+	{
+		if (indexFile.file >= 0 && indexFile.fileNum == fileNumber)
+		{
+			FileClose(indexFile.file);
+			indexFile.file = -1;
+		}
+		if (dataFile.file >= 0 && dataFile.fileNum == fileNumber)
+		{
+			FileClose(dataFile.file);
+			dataFile.file = -1;
+		}
+		if (indexCacheFileNum == fileNumber)
+			indexCacheFileNum = -1;
+
+		pg_snprintf(fileNameToUnlink, MAXPGPATH,
+					ORIOLEDB_UNDO_DATA_PAGE_INDEX_FILENAME_TEMPLATE,
+					(uint32) (fileNumber >> 32), (uint32) fileNumber);
+		(void) unlink(fileNameToUnlink);
+	}
+}
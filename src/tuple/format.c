@@ -159,6 +159,99 @@ o_tuple_read_next_field(OTupleReaderState *state, bool *isnull)
 	return fetchatt(att, state->tp + off);
 }
 
+ODeformAttr *
+o_tuple_make_deform_attrs(TupleDesc desc, MemoryContext mcxt)
+{
+	ODeformAttr *attrs;
+	int			i;
+
+	attrs = (ODeformAttr *) MemoryContextAlloc(mcxt,
+											   sizeof(ODeformAttr) * Max(desc->natts, 1));
+	for (i = 0; i < desc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(desc, i);
+
+		attrs[i].cacheoff = att->attcacheoff;
+		attrs[i].attlen = att->attlen;
+		attrs[i].attalign = att->attalign;
+		attrs[i].attbyval = att->attbyval;
+	}
+	return attrs;
+}
+
+/*
+ * Specialized variant of the o_tuple_read_next_field() loop.  Reads up to
+ * 'maxFields' next fields into 'values' and 'isnull' using the dense array
+ * of the attribute properties made by o_tuple_make_deform_attrs() for the
+ * reader's descriptor.  The leading fixed-width fields are fetched by their
+ * precomputed offsets.  Sets '*hastoast' if any field is an OrioleDB TOAST
+ * pointer, which needs to be detoasted.
+ *
+ * Returns the number of fields read.  The fields missing in the tuple are
+ * left for o_tuple_read_next_field(), which fills their default values.
+ */
+int
+o_tuple_deform_fields(OTupleReaderState *state, ODeformAttr *attrs,
+					  int maxFields, Datum *values, bool *isnull,
+					  bool *hastoast)
+{
+	char	   *tp = state->tp;
+	bits8	   *bp = state->bp;
+	uint32		off = state->off;
+	int			attnum = state->attnum;
+	int			last = Min(state->natts, attnum + maxFields);
+	bool		slow = state->slow;
+	int			i = 0;
+
+	for (; attnum < last; attnum++, i++)
+	{
+		ODeformAttr *att = &attrs[attnum];
+		char	   *ptr;
+
+		if (state->hasnulls && att_isnull(attnum, bp))
+		{
+			values[i] = (Datum) 0;
+			isnull[i] = true;
+			slow = true;
+			continue;
+		}
+
+		isnull[i] = false;
+		if (!slow && att->cacheoff >= 0)
+			off = att->cacheoff;
+		else if (att->attlen == -1)
+			off = att_align_pointer(off, att->attalign, -1, tp + off);
+		else
+			off = att_align_nominal(off, att->attalign);
+
+		ptr = tp + off;
+		values[i] = fetch_att(ptr, att->attbyval, att->attlen);
+
+		if (att->attlen > 0)
+		{
+			off += att->attlen;
+			continue;
+		}
+
+		if (!att->attbyval && IS_TOAST_POINTER(ptr))
+		{
+			if (!VARATT_IS_EXTERNAL_ORIOLEDB(ptr))
+				*hastoast = true;
+			off += sizeof(OToastValue);
+		}
+		else
+		{
+			off = att_addlength_pointer(off, att->attlen, ptr);
+		}
+		slow = true;
+	}
+
+	state->off = off;
+	state->attnum = attnum;
+	state->slow = slow;
+	return i;
+}
+
 static Pointer
 o_tuple_read_next_field_ptr(OTupleReaderState *state)
 {
@@ -29,6 +29,7 @@
 #include "utils/expandeddatum.h"
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 
 #include "nodes/nodeFuncs.h"
 
@@ -47,6 +48,7 @@ tts_orioledb_init(TupleTableSlot *slot)
 	oslot->descr = NULL;
 	oslot->rowid = NULL;
 	oslot->to_toast = NULL;
+	oslot->tupleRef = false;
 	oslot->version = 0;
 	oslot->hint.blkno = OInvalidInMemoryBlkno;
 	oslot->hint.pageChangeCount = 0;
@@ -96,6 +98,7 @@ tts_orioledb_clear(TupleTableSlot *slot)
 	}
 
 	oslot->data = NULL;
+	oslot->tupleRef = false;
 	O_TUPLE_SET_NULL(oslot->tuple);
 	if (oslot->rowid)
 	{
@@ -301,8 +304,26 @@ tts_orioledb_getsomeattrs(TupleTableSlot *slot, int __natts)
 		natts = oslot->state.desc->natts;
 	}
 
+	attnum = slot->tts_nvalid;
+
+	/*
+	 * The primary index tuple fetched in the table order is deformed by the
+	 * specialized loop over the dense attribute array of the index.  The
+	 * generic loop below handles the rest: the attributes missing in the
+	 * tuple, and the ones to be read due to the TOASTed values.
+	 */
+	if (oslot->ixnum == PrimaryIndexNumber && !index_order &&
+		oslot->leafTuple && idx->leafDeform)
+	{
+		attnum += o_tuple_deform_fields(&oslot->state, idx->leafDeform,
+										natts - attnum, values + attnum,
+										isnull + attnum, &hastoast);
+		if (hastoast)
+			natts = Max(natts, idx->maxTableAttnum - ctid_off);
+	}
+
 	/* Iterate over the attributes to populate values and null flags. */
-	for (attnum = slot->tts_nvalid; attnum < natts; attnum++)
+	for (; attnum < natts; attnum++)
 	{
 		Form_pg_attribute thisatt;
 		int			res_attnum = 0;
@@ -584,6 +605,10 @@ tts_orioledb_materialize(TupleTableSlot *slot)
 	Size		sz = 0;
 	char	   *data;
 
+	/* the copy of the referenced tuple doesn't depend on the scan */
+	if (oslot->tupleRef)
+		tts_orioledb_own_tuple(slot);
+
 	/* already materialized */
 	if (TTS_SHOULDFREE(slot))
 		return;
@@ -901,6 +926,74 @@ tts_orioledb_store_tuple(TupleTableSlot *slot, OTuple tuple,
 									  shouldfree, hint);
 }
 
+/*
+ * Stores the tuple pointing into the memory of the scan, for instance, its
+ * private page image.  The scan must call tts_orioledb_own_tuple() before
+ * that memory is reused, if the slot still holds the tuple.  That saves the
+ * copying of the tuples, which are consumed before the scan moves on.
+ */
+void
+tts_orioledb_store_tuple_ref(TupleTableSlot *slot, OTuple tuple,
+							 OTableDescr *descr, CommitSeqNo csn,
+							 int ixnum, BTreeLocationHint *hint)
+{
+	OTableSlot *oslot = (OTableSlot *) slot;
+
+	tts_orioledb_store_tuple_internal(slot, tuple, descr, csn, ixnum, true,
+									  false, hint);
+	oslot->tupleRef = true;
+}
+
+/*
+ * Copies the tuple stored by tts_orioledb_store_tuple_ref() into the slot
+ * memory.  The already deformed attributes and the reader state are moved
+ * to the copy, so the copying is transparent for the slot users.
+ */
+void
+tts_orioledb_own_tuple(TupleTableSlot *slot)
+{
+	OTableSlot *oslot = (OTableSlot *) slot;
+	TupleDesc	desc = slot->tts_tupleDescriptor;
+	OIndexDescr *idx;
+	Pointer		src,
+				dst;
+	uint32		tupLen;
+	int			i;
+
+	if (!oslot->tupleRef)
+		return;
+
+	Assert(!TTS_SHOULDFREE(slot) && oslot->leafTuple);
+	if (oslot->ixnum == BridgeIndexNumber)
+		idx = oslot->descr->bridge;
+	else
+		idx = oslot->descr->indices[oslot->ixnum];
+
+	src = oslot->tuple.data;
+	tupLen = o_tuple_size(oslot->tuple, &idx->leafSpec);
+	dst = (Pointer) MemoryContextAlloc(slot->tts_mcxt, tupLen);
+	memcpy(dst, src, tupLen);
+
+	for (i = 0; i < slot->tts_nvalid; i++)
+	{
+		Pointer		ptr;
+
+		if (slot->tts_isnull[i] || TupleDescAttr(desc, i)->attbyval)
+			continue;
+		ptr = DatumGetPointer(slot->tts_values[i]);
+		if (ptr >= src && ptr < src + tupLen)
+			slot->tts_values[i] = PointerGetDatum(dst + (ptr - src));
+	}
+	if (oslot->state.tp)
+		oslot->state.tp = dst + (oslot->state.tp - src);
+	if (oslot->state.bp)
+		oslot->state.bp = (bits8 *) (dst + ((Pointer) oslot->state.bp - src));
+
+	oslot->tuple.data = dst;
+	oslot->tupleRef = false;
+	slot->tts_flags |= TTS_FLAG_SHOULDFREE;
+}
+
 void
 tts_orioledb_store_non_leaf_tuple(TupleTableSlot *slot, OTuple tuple,
 								  OTableDescr *descr, CommitSeqNo csn,
@@ -1234,9 +1327,18 @@ tts_orioledb_toast(TupleTableSlot *slot, OTableDescr *descr)
 	bool		has_toasted = false;
 	TupleDesc	tupdesc = slot->tts_tupleDescriptor;
 	bool		primaryIsCtid;
+	bool		toastRaw;
 	int			ctid_off;
 
 	primaryIsCtid = GET_PRIMARY(descr)->primaryIsCtid;
+
+	/*
+	 * The TOAST tree compressing its pages compresses the TOASTed values
+	 * anyway, so the values are TOASTed raw instead of compressing them
+	 * twice.
+	 */
+	toastRaw = toast_raw_values && descr->toast &&
+		OCompressIsValid(descr->toast->desc.compress);
 	ctid_off = primaryIsCtid ? 1 : 0;
 
 	if (GET_PRIMARY(descr)->bridging)
@@ -1343,6 +1445,24 @@ tts_orioledb_toast(TupleTableSlot *slot, OTableDescr *descr)
 
 		att = TupleDescAttr(tupdesc, max_attn);
 
+		if (toastRaw && att->attstorage != TYPSTORAGE_MAIN)
+		{
+			if (VARATT_IS_COMPRESSED(slot->tts_values[max_attn]))
+			{
+				oldMctx = MemoryContextSwitchTo(slot->tts_mcxt);
+				tmp = PointerGetDatum(toast_decompress_datum((struct varlena *) DatumGetPointer(slot->tts_values[max_attn])));
+				MemoryContextSwitchTo(oldMctx);
+
+				if (oslot->vfree[max_attn])
+					pfree(DatumGetPointer(slot->tts_values[max_attn]));
+				slot->tts_values[max_attn] = tmp;
+				oslot->vfree[max_attn] = true;
+			}
+			oslot->to_toast[max_attn] = ORIOLEDB_TO_TOAST_ON;
+			to_toastn++;
+			continue;
+		}
+
 		/*
 		 * If the value is already compressed or can not be compressed - it
 		 * must be toasted
@@ -1514,7 +1634,19 @@ tts_orioledb_insert_toast_values(TupleTableSlot *slot,
 
 	for (i = 0; i < tupleDesc->natts; i++)
 	{
-		if (oslot->to_toast[i])
+		if (oslot->to_toast[i] &&
+			VARATT_IS_EXTERNAL_ORIOLEDB(slot->tts_values[i]))
+		{
+			/* copy the chunks of the value from the other TOAST tree */
+			o_btree_load_shmem(&descr->toast->desc);
+			result = o_toast_insert_copy(GET_PRIMARY(descr), descr->toast,
+										 idx_tup, i + 1 + ctid_off,
+										 (struct varlena *) DatumGetPointer(slot->tts_values[i]),
+										 oxid, csn, NULL);
+			if (!result)
+				break;
+		}
+		else if (oslot->to_toast[i])
 		{
 			Datum		value;
 			Pointer		p;
@@ -1558,7 +1690,16 @@ tts_orioledb_toast_sort_add(TupleTableSlot *slot,
 
 	for (i = 0; i < tupleDesc->natts; i++)
 	{
-		if (oslot->to_toast[i])
+		if (oslot->to_toast[i] &&
+			VARATT_IS_EXTERNAL_ORIOLEDB(slot->tts_values[i]))
+		{
+			(void) o_toast_insert_copy(GET_PRIMARY(descr), descr->toast,
+									   idx_tup, i + 1 + ctid_off,
+									   (struct varlena *) DatumGetPointer(slot->tts_values[i]),
+									   InvalidOXid, COMMITSEQNO_INPROGRESS,
+									   sortstate);
+		}
+		else if (oslot->to_toast[i])
 		{
 			Datum		value;
 			Pointer		p;
@@ -1743,38 +1884,9 @@ tts_orioledb_update_toast_values(TupleTableSlot *oldSlot,
 		else
 		{
 			/* update value if it does not equal */
-			bool		equal;
-			int			rawSize;
-
-			rawSize = o_get_raw_size(newValue);
-			equal = (rawSize == o_get_raw_size(oldValue));
-			if (equal)
-			{
-				Datum		newRawValue;
-				Datum		oldRawValue;
-				Pointer		newPtr;
-				Pointer		oldPtr;
-				bool		freeNew;
-				bool		freeOld;
-
-				newRawValue = o_get_raw_value(newValue, &freeNew);
-				oldRawValue = o_get_raw_value(oldValue, &freeOld);
-				newPtr = DatumGetPointer(newRawValue);
-				oldPtr = DatumGetPointer(oldRawValue);
-
-				Assert(VARSIZE_ANY_EXHDR(newPtr) == VARSIZE_ANY_EXHDR(oldPtr));
-				Assert(VARSIZE_ANY_EXHDR(newPtr) == rawSize);
-				equal = memcmp(VARDATA_ANY(oldPtr),
-							   VARDATA_ANY(newPtr),
-							   rawSize) == 0;
-				if (freeNew)
-					pfree(newPtr);
-				if (freeOld)
-					pfree(oldPtr);
-
-				if (equal)
-					continue;
-			}
+			if (o_get_raw_size(newValue) == o_get_raw_size(oldValue) &&
+				o_toast_raw_equal(newValue, oldValue))
+				continue;
 
 			insertNew = true;
 			deleteOld = true;
@@ -1802,7 +1914,21 @@ tts_orioledb_update_toast_values(TupleTableSlot *oldSlot,
 				break;
 		}
 
-		if (insertNew)
+		if (insertNew && VARATT_IS_EXTERNAL_ORIOLEDB(newValue))
+		{
+			o_btree_load_shmem(&descr->toast->desc);
+			result = o_toast_insert_copy(GET_PRIMARY(descr),
+										 descr->toast,
+										 idx_tup,
+										 toast_attn + 1 + ctid_off,
+										 (struct varlena *) DatumGetPointer(newValue),
+										 oxid,
+										 csn,
+										 NULL);
+			if (!result)
+				break;
+		}
+		else if (insertNew)
 		{
 			Datum		value;
 			Pointer		p;
@@ -1831,12 +1957,29 @@ tts_orioledb_update_toast_values(TupleTableSlot *oldSlot,
 	return result;
 }
 
+static inline bool
+tts_orioledb_attr_modified(TupleTableSlot *oldSlot, TupleTableSlot *newSlot,
+						   int attnum)
+{
+	int			i = attnum + FirstLowInvalidHeapAttributeNumber - 1;
+	Form_pg_attribute att;
+
+	if (unlikely(i < 0))
+		elog(ERROR, "invalid attribute number %d", i);
+
+	att = TupleDescAttr(oldSlot->tts_tupleDescriptor, i);
+	if (oldSlot->tts_isnull[i] || newSlot->tts_isnull[i])
+		return oldSlot->tts_isnull[i] != newSlot->tts_isnull[i];
+
+	return !datumIsEqual(oldSlot->tts_values[i], newSlot->tts_values[i],
+						 att->attbyval, att->attlen);
+}
+
 bool
 tts_orioledb_modified(TupleTableSlot *oldSlot,
 					  TupleTableSlot *newSlot,
 					  Bitmapset *attrs)
 {
-	TupleDesc	tupdesc = oldSlot->tts_tupleDescriptor;
 	int			attnum,
 				maxAttr;
 
@@ -1851,29 +1994,39 @@ tts_orioledb_modified(TupleTableSlot *oldSlot,
 	attnum = -1;
 	while ((attnum = bms_next_member(attrs, attnum)) >= 0)
 	{
-		int			i = attnum + FirstLowInvalidHeapAttributeNumber - 1;
+		if (tts_orioledb_attr_modified(oldSlot, newSlot, attnum))
+			return true;
+	}
+	return false;
+}
 
-		if (unlikely(i < 0))
-			elog(ERROR, "invalid attribute number %d", i);
-		else
-		{
-			Form_pg_attribute att = TupleDescAttr(tupdesc, i);
-			Datum		val1 = oldSlot->tts_values[i],
-						val2 = newSlot->tts_values[i];
-			bool		isnull1 = oldSlot->tts_isnull[i],
-						isnull2 = newSlot->tts_isnull[i];
+/*
+ * Returns the subset of 'attrs' modified between 'oldSlot' and 'newSlot'.
+ */
+Bitmapset *
+tts_orioledb_modified_attrs(TupleTableSlot *oldSlot,
+							TupleTableSlot *newSlot,
+							Bitmapset *attrs)
+{
+	Bitmapset  *result = NULL;
+	int			attnum,
+				maxAttr;
 
-			if (isnull1 || isnull2)
-			{
-				if (isnull1 != isnull2)
-					return true;
-			}
+	maxAttr = bms_prev_member(attrs, -1) + FirstLowInvalidHeapAttributeNumber - 1;
 
-			if (!datumIsEqual(val1, val2, att->attbyval, att->attlen))
-				return true;
-		}
+	if (maxAttr < 0)
+		return NULL;
+
+	slot_getsomeattrs(oldSlot, maxAttr + 1);
+	slot_getsomeattrs(newSlot, maxAttr + 1);
+
+	attnum = -1;
+	while ((attnum = bms_next_member(attrs, attnum)) >= 0)
+	{
+		if (tts_orioledb_attr_modified(oldSlot, newSlot, attnum))
+			result = bms_add_member(result, attnum);
 	}
-	return false;
+	return result;
 }
 
 void
@@ -1888,6 +2041,35 @@ tts_orioledb_set_ctid(TupleTableSlot *slot, ItemPointer iptr)
 		o_tuple_set_ctid(oslot->tuple, iptr);
 }
 
+/*
+ * Creates the memory context for the tuples returned by a scan into the
+ * slots.  The tuples are allocated one after another and the slots free
+ * them in nearly the same order, so the generation context serves them by a
+ * pointer bump and recycles the whole blocks instead of managing the free
+ * lists of the chunks.  The context is a child of the slots context, so the
+ * slots may keep its tuples after the end of the scan.
+ */
+MemoryContext
+o_scan_tuples_context_create(MemoryContext slotCxt)
+{
+	return GenerationContextCreate(slotCxt,
+								   "orioledb scan tuples",
+								   ALLOCSET_DEFAULT_MINSIZE,
+								   ALLOCSET_DEFAULT_INITSIZE,
+								   8 * ALLOCSET_DEFAULT_INITSIZE);
+}
+
+/*
+ * Deletes the scan tuples context at the end of the scan.  When the slots
+ * still hold its tuples, the context is left to the slots context.
+ */
+void
+o_scan_tuples_context_release(MemoryContext cxt)
+{
+	if (cxt && MemoryContextIsEmpty(cxt))
+		MemoryContextDelete(cxt);
+}
+
 const TupleTableSlotOps TTSOpsOrioleDB = {
 	.base_slot_size = sizeof(OTableSlot),
 	.init = tts_orioledb_init,
@@ -22,13 +22,20 @@
 
 #include "catalog/pg_collation_d.h"
 #include "catalog/pg_opclass_d.h"
+#include "catalog/pg_type_d.h"
+#include "utils/memutils.h"
 #include "utils/tuplesort.h"
+#include "utils/uuid.h"
+
+typedef struct ORadixSort ORadixSort;
 
 typedef struct
 {
 	TupleDesc	tupDesc;
 	OIndexDescr *id;
 	bool		enforceUnique;
+	/* the radix sort of the buffered tuples, NULL if not used */
+	ORadixSort *radix;
 } OIndexBuildSortArg;
 
 static void
@@ -54,8 +61,386 @@ read_o_tuple(void *ptr)
 	return tup;
 }
 
+/*
+ * Radix sort of the index tuples by the normalized keys.
+ *
+ * When all the sort keys are integers or uuids, the keys are normalized into
+ * the byte strings, which memcmp() order is the order of the sort keys: one
+ * byte for the null flag and the big-endian value with the flipped sign bit,
+ * inverted for the descending keys.  The in-memory LSD radix sort of these
+ * strings skips the byte positions, which are equal for all the tuples,
+ * like the high bytes of the small integers.  The tuples are kept out of the
+ * tuplesort until they exceed workMem, then they are passed to tuplesort.
+ */
+#define O_RADIX_MAX_KEY_SIZE	(64)
+
+struct ORadixSort
+{
+	MemoryContext mcxt;
+	int			nkeys;
+	AttrNumber	attnos[O_RADIX_MAX_KEY_SIZE];
+	Oid			typids[O_RADIX_MAX_KEY_SIZE];
+	bool		nullsFirst[O_RADIX_MAX_KEY_SIZE];
+	bool		reverse[O_RADIX_MAX_KEY_SIZE];
+	int			keyLen;
+	Size		entrySize;
+	Pointer		entries;
+	int64		nentries;
+	int64		allocated;
+	int64		pos;
+	bool		sorted;
+	Size		memUsed;
+	Size		memLimit;
+};
+
+#define O_RADIX_ENTRY(radix, i) ((radix)->entries + (Size) (i) * (radix)->entrySize)
+/* the normalized key is followed by the null flag and the tuple pointer */
+#define O_RADIX_ENTRY_HASNULL(radix, entry) (*((bool *) ((entry) + (radix)->keyLen)))
+#define O_RADIX_ENTRY_TUPLE(radix, entry) \
+	(*((Pointer *) ((entry) + MAXALIGN((radix)->keyLen + 1))))
+
+static int
+radix_key_size(Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+			return sizeof(int16);
+		case INT4OID:
+		case OIDOID:
+			return sizeof(int32);
+		case INT8OID:
+			return sizeof(int64);
+		case UUIDOID:
+			return UUID_LEN;
+		default:
+			return 0;
+	}
+}
+
+static ORadixSort *
+radix_sort_create(OIndexDescr *idx, TuplesortPublic *base, int workMem)
+{
+	OIndexBuildSortArg *arg = (OIndexBuildSortArg *) base->arg;
+	ORadixSort *radix;
+	int			keyLen = 0;
+	int			i;
+
+	if (base->nKeys > O_RADIX_MAX_KEY_SIZE)
+		return NULL;
+
+	radix = (ORadixSort *) palloc0(sizeof(ORadixSort));
+	for (i = 0; i < base->nKeys; i++)
+	{
+		SortSupport sortKey = &base->sortKeys[i];
+		OIndexField *field = &idx->fields[i];
+		Oid			typid;
+		int			size;
+
+		if (OIgnoreColumn(idx, i))
+			continue;
+
+		typid = TupleDescAttr(arg->tupDesc, sortKey->ssup_attno - 1)->atttypid;
+		size = radix_key_size(typid);
+		if (size == 0 ||
+			!(field->opclass == INT2_BTREE_OPS_OID ||
+			  field->opclass == INT4_BTREE_OPS_OID ||
+			  field->opclass == INT8_BTREE_OPS_OID ||
+			  field->opclass == OID_BTREE_OPS_OID ||
+			  (typid == UUIDOID && field->opfamily == O_UUID_BTREE_FAM_OID)) ||
+			field->inputtype != typid)
+		{
+			pfree(radix);
+			return NULL;
+		}
+
+		radix->attnos[radix->nkeys] = sortKey->ssup_attno;
+		radix->typids[radix->nkeys] = typid;
+		radix->nullsFirst[radix->nkeys] = sortKey->ssup_nulls_first;
+		radix->reverse[radix->nkeys] = sortKey->ssup_reverse;
+		radix->nkeys++;
+		keyLen += 1 + size;
+	}
+
+	if (radix->nkeys == 0 || keyLen > O_RADIX_MAX_KEY_SIZE)
+	{
+		pfree(radix);
+		return NULL;
+	}
+
+	radix->mcxt = AllocSetContextCreate(base->maincontext,
+										"orioledb index build radix sort",
+										ALLOCSET_DEFAULT_SIZES);
+	radix->keyLen = keyLen;
+	radix->entrySize = MAXALIGN(keyLen + 1) + sizeof(Pointer);
+	radix->allocated = 1024;
+	radix->entries = MemoryContextAlloc(radix->mcxt,
+										radix->entrySize * radix->allocated);
+	radix->memLimit = (Size) workMem * 1024;
+	/* two arrays of the entries are needed for the sort */
+	radix->memUsed = 2 * radix->entrySize * radix->allocated;
+	return radix;
+}
+
+static void
+radix_put_uint(Pointer dst, uint64 value, int size, bool reverse)
+{
+	int			i;
+
+	for (i = size - 1; i >= 0; i--)
+	{
+		dst[i] = (char) (reverse ? ~value : value);
+		value >>= 8;
+	}
+}
+
+static void
+radix_normalize_key(ORadixSort *radix, OIndexBuildSortArg *arg,
+					OTuple tup, Pointer entry)
+{
+	OTupleFixedFormatSpec *spec = &arg->id->leafSpec;
+	Pointer		dst = entry;
+	bool		hasnull = false;
+	int			i;
+
+	for (i = 0; i < radix->nkeys; i++)
+	{
+		Datum		value;
+		bool		isnull;
+		int			size = radix_key_size(radix->typids[i]);
+
+		value = o_fastgetattr(tup, radix->attnos[i], arg->tupDesc, spec,
+							  &isnull);
+		*dst++ = (isnull == radix->nullsFirst[i]) ? 0 : 1;
+		if (isnull)
+		{
+			hasnull = true;
+			memset(dst, 0, size);
+		}
+		else
+		{
+			switch (radix->typids[i])
+			{
+				case INT2OID:
+					radix_put_uint(dst, (uint16) DatumGetInt16(value) ^ 0x8000,
+								   size, radix->reverse[i]);
+					break;
+				case INT4OID:
+					radix_put_uint(dst, (uint32) DatumGetInt32(value) ^ 0x80000000,
+								   size, radix->reverse[i]);
+					break;
+				case OIDOID:
+					radix_put_uint(dst, DatumGetObjectId(value),
+								   size, radix->reverse[i]);
+					break;
+				case INT8OID:
+					radix_put_uint(dst, (uint64) DatumGetInt64(value) ^ PG_INT64_MIN,
+								   size, radix->reverse[i]);
+					break;
+				case UUIDOID:
+					{
+						pg_uuid_t  *uuid = DatumGetUUIDP(value);
+						int			j;
+
+						for (j = 0; j < size; j++)
+							dst[j] = radix->reverse[i] ? ~uuid->data[j] : uuid->data[j];
+						break;
+					}
+				default:
+					Assert(false);
+			}
+		}
+		dst += size;
+	}
+	O_RADIX_ENTRY_HASNULL(radix, entry) = hasnull;
+}
+
+/*
+ * Passes the buffered tuples to tuplesort and stops using the radix sort.
+ */
+static void
+radix_sort_fallback(Tuplesortstate *state, OIndexBuildSortArg *arg)
+{
+	ORadixSort *radix = arg->radix;
+	int64		i;
+
+	arg->radix = NULL;
+	for (i = 0; i < radix->nentries; i++)
+		tuplesort_putotuple(state,
+							read_o_tuple(O_RADIX_ENTRY_TUPLE(radix, O_RADIX_ENTRY(radix, i))));
+	MemoryContextDelete(radix->mcxt);
+	pfree(radix);
+}
+
+static bool
+radix_sort_put(Tuplesortstate *state, OIndexBuildSortArg *arg, OTuple tup,
+			   int tupsize)
+{
+	ORadixSort *radix = arg->radix;
+	Size		tupSpace = MAXALIGN(MAXIMUM_ALIGNOF + tupsize);
+	Pointer		entry;
+	Pointer		copy;
+
+	if (radix->nentries >= radix->allocated)
+	{
+		Size		addSpace = 2 * radix->entrySize * radix->allocated;
+
+		if (radix->memUsed + addSpace + tupSpace > radix->memLimit ||
+			radix->entrySize * radix->allocated * 2 > MaxAllocSize)
+		{
+			radix_sort_fallback(state, arg);
+			return false;
+		}
+		radix->allocated *= 2;
+		radix->entries = repalloc(radix->entries,
+								  radix->entrySize * radix->allocated);
+		radix->memUsed += addSpace;
+	}
+	else if (radix->memUsed + tupSpace > radix->memLimit)
+	{
+		radix_sort_fallback(state, arg);
+		return false;
+	}
+
+	copy = MemoryContextAlloc(radix->mcxt, MAXIMUM_ALIGNOF + tupsize);
+	write_o_tuple(copy, tup, tupsize);
+	radix->memUsed += tupSpace;
+
+	entry = O_RADIX_ENTRY(radix, radix->nentries);
+	radix_normalize_key(radix, arg, read_o_tuple(copy), entry);
+	O_RADIX_ENTRY_TUPLE(radix, entry) = copy;
+	radix->nentries++;
+	return true;
+}
+
+static void
+radix_sort_perform(OIndexBuildSortArg *arg)
+{
+	ORadixSort *radix = arg->radix;
+	Pointer		src = radix->entries;
+	Pointer		dst;
+	int64		counts[256];
+	int64		i;
+	int			b;
+
+	if (radix->nentries > 1)
+		dst = MemoryContextAlloc(radix->mcxt,
+								 radix->entrySize * radix->nentries);
+	else
+		dst = NULL;
+
+	for (b = radix->keyLen - 1; b >= 0 && radix->nentries > 1; b--)
+	{
+		int64		offset = 0;
+		Pointer		tmp;
+		int			c;
+
+		memset(counts, 0, sizeof(counts));
+		for (i = 0; i < radix->nentries; i++)
+			counts[(uint8) src[(Size) i * radix->entrySize + b]]++;
+
+		/* the byte is the same for all the entries */
+		if (counts[(uint8) src[b]] == radix->nentries)
+			continue;
+
+		for (c = 0; c < 256; c++)
+		{
+			int64		count = counts[c];
+
+			counts[c] = offset;
+			offset += count;
+		}
+
+		for (i = 0; i < radix->nentries; i++)
+		{
+			Pointer		entry = src + (Size) i * radix->entrySize;
+
+			memcpy(dst + (Size) counts[(uint8) entry[b]]++ * radix->entrySize,
+				   entry, radix->entrySize);
+		}
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+	radix->entries = src;
+	if (dst)
+		pfree(dst);
+
+	/* see the comment in comparetup_orioledb_index_tiebreak() */
+	if (arg->enforceUnique)
+	{
+		for (i = 1; i < radix->nentries; i++)
+		{
+			Pointer		prev = O_RADIX_ENTRY(radix, i - 1);
+			Pointer		entry = O_RADIX_ENTRY(radix, i);
+
+			if (!O_RADIX_ENTRY_HASNULL(radix, entry) &&
+				memcmp(prev, entry, radix->keyLen) == 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_UNIQUE_VIOLATION),
+						 errmsg("could not create unique index \"%s\"",
+								arg->id->name.data),
+						 errdetail("Duplicate keys exist.")));
+		}
+	}
+	radix->sorted = true;
+}
+
+static OTuple
+radix_sort_get(OIndexBuildSortArg *arg, bool forward)
+{
+	ORadixSort *radix = arg->radix;
+	OTuple		result;
+
+	if (!radix->sorted)
+	{
+		radix_sort_perform(arg);
+		radix->pos = forward ? 0 : radix->nentries - 1;
+	}
+
+	if (radix->pos < 0 || radix->pos >= radix->nentries)
+	{
+		result.data = NULL;
+		result.formatFlags = 0;
+		return result;
+	}
+
+	result = read_o_tuple(O_RADIX_ENTRY_TUPLE(radix,
+											  O_RADIX_ENTRY(radix, radix->pos)));
+	radix->pos += forward ? 1 : -1;
+	return result;
+}
+
+static int	comparetup_orioledb_index_tiebreak(const SortTuple *a,
+											   const SortTuple *b,
+											   Tuplesortstate *state);
+
 static int
 comparetup_orioledb_index(const SortTuple *a, const SortTuple *b, Tuplesortstate *state)
+{
+	TuplesortPublic *base = TuplesortstateGetPublic(state);
+	SortSupport sortKey = base->sortKeys;
+	int32		compare;
+
+	/* Compare the leading sort key */
+	compare = ApplySortComparator(a->datum1, a->isnull1,
+								  b->datum1, b->isnull1,
+								  sortKey);
+	if (compare != 0)
+		return compare;
+
+	return comparetup_orioledb_index_tiebreak(a, b, state);
+}
+
+/*
+ * Compares the tuples with the equal leading keys (or the abbreviations of
+ * the leading keys).  It's also called directly by the tuplesort routines
+ * specialized for the leading keys compared as int32, int64 or unsigned
+ * datums.
+ */
+static int
+comparetup_orioledb_index_tiebreak(const SortTuple *a, const SortTuple *b,
+								   Tuplesortstate *state)
 {
 	TuplesortPublic *base = TuplesortstateGetPublic(state);
 	SortSupport sortKey = base->sortKeys;
@@ -73,13 +458,6 @@ comparetup_orioledb_index(const SortTuple *a, const SortTuple *b, Tuplesortstate
 	OIndexBuildSortArg *arg = (OIndexBuildSortArg *) base->arg;
 	OTupleFixedFormatSpec *spec = &arg->id->leafSpec;
 
-	/* Compare the leading sort key */
-	compare = ApplySortComparator(a->datum1, a->isnull1,
-								  b->datum1, b->isnull1,
-								  sortKey);
-	if (compare != 0)
-		return compare;
-
 	/* Compare additional sort keys */
 	ltup = read_o_tuple(a->tuple);
 	rtup = read_o_tuple(b->tuple);
@@ -248,8 +626,12 @@ tuplesort_begin_orioledb_index(OIndexDescr *idx,
 
 	base->removeabbrev = removeabbrev_orioledb_index;
 	base->comparetup = comparetup_orioledb_index;
+#if PG_VERSION_NUM >= 170000
+	base->comparetup_tiebreak = comparetup_orioledb_index_tiebreak;
+#endif
 	base->writetup = writetup_orioledb_index;
 	base->readtup = readtup_orioledb_index;
+	base->haveDatum1 = true;
 	base->arg = arg;
 
 	for (i = 0; i < sort_fields; i++)
@@ -265,11 +647,14 @@ tuplesort_begin_orioledb_index(OIndexDescr *idx,
 				OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple, idx, i + 1);
 			sortKey->abbreviate = (i == 0);
 			sortKey->ssup_reverse = !idx->fields[i].ascending;
-			/* FIXME: no abbrev converter yet */
 			o_finish_sort_support_function(idx->fields[i].comparator, sortKey);
 		}
 	}
 
+	/* the parallel sorts merge the runs of the workers in tuplesort */
+	if (index_build_radix_sort && !coordinate)
+		arg->radix = radix_sort_create(idx, base, workMem);
+
 	MemoryContextSwitchTo(oldcontext);
 
 	return state;
@@ -307,8 +692,12 @@ tuplesort_begin_orioledb_toast(OIndexDescr *toast,
 
 	base->removeabbrev = removeabbrev_orioledb_index;
 	base->comparetup = comparetup_orioledb_index;
+#if PG_VERSION_NUM >= 170000
+	base->comparetup_tiebreak = comparetup_orioledb_index_tiebreak;
+#endif
 	base->writetup = writetup_orioledb_index;
 	base->readtup = readtup_orioledb_index;
+	base->haveDatum1 = true;
 	base->arg = arg;
 
 	for (i = 0; i < key_fields; i++)
@@ -321,7 +710,6 @@ tuplesort_begin_orioledb_toast(OIndexDescr *toast,
 		sortKey->ssup_attno = OIndexKeyAttnumToTupleAttnum(BTreeKeyLeafTuple, primary, i + 1);
 		sortKey->abbreviate = (i == 0);
 		sortKey->ssup_reverse = !primary->fields[i].ascending;
-		/* FIXME: no abbrev converter yet */
 		o_finish_sort_support_function(primary->fields[i].comparator, sortKey);
 	}
 
@@ -359,10 +747,15 @@ tuplesort_begin_orioledb_toast(OIndexDescr *toast,
 OTuple
 tuplesort_getotuple(Tuplesortstate *state, bool forward)
 {
-	MemoryContext oldcontext = MemoryContextSwitchTo(TuplesortstateGetPublic(state)->sortcontext);
+	OIndexBuildSortArg *arg = (OIndexBuildSortArg *) TuplesortstateGetPublic(state)->arg;
+	MemoryContext oldcontext;
 	SortTuple	stup;
 	OTuple		result;
 
+	if (arg->radix)
+		return radix_sort_get(arg, forward);
+
+	oldcontext = MemoryContextSwitchTo(TuplesortstateGetPublic(state)->sortcontext);
 	if (!tuplesort_gettuple_common(state, forward, &stup))
 		stup.tuple = NULL;
 
@@ -387,7 +780,7 @@ tuplesort_putotuple(Tuplesortstate *state, OTuple tup)
 	TuplesortPublic *base = TuplesortstateGetPublic(state);
 	OIndexBuildSortArg *arg = (OIndexBuildSortArg *) base->arg;
 	OTupleFixedFormatSpec *spec = &arg->id->leafSpec;
-	MemoryContext oldcontext = MemoryContextSwitchTo(base->tuplecontext);
+	MemoryContext oldcontext;
 	SortTuple	stup;
 	int			tupsize;
 	OTuple		written_tup;
@@ -395,11 +788,15 @@ tuplesort_putotuple(Tuplesortstate *state, OTuple tup)
 	Size		tuplen;
 #endif
 
+	tupsize = o_tuple_size(tup, spec);
+	if (arg->radix && radix_sort_put(state, arg, tup, tupsize))
+		return;
+
 	/*
 	 * Copy the given tuple into memory we control, and decrease availMem.
 	 * Then call the common code.
 	 */
-	tupsize = o_tuple_size(tup, spec);
+	oldcontext = MemoryContextSwitchTo(base->tuplecontext);
 	stup.tuple = MemoryContextAlloc(base->tuplecontext, MAXIMUM_ALIGNOF + tupsize);
 	write_o_tuple(stup.tuple, tup, tupsize);
 	written_tup = read_o_tuple(stup.tuple);
@@ -20,6 +20,7 @@
 #include "recovery/recovery.h"
 #include "recovery/wal.h"
 #include "tableam/descr.h"
+#include "tableam/handler.h"
 #include "tableam/toast.h"
 #include "transam/oxid.h"
 #include "tuple/toast.h"
@@ -204,30 +205,43 @@ o_toast_needs_undo(BTreeDescr *desc, BTreeOperationType action,
 }
 
 
-struct varlena *
-o_detoast(struct varlena *attr)
+/*
+ * Reads the orioledb TOAST pointer and fetches the table descriptor.
+ */
+static OTableDescr *
+o_toast_external_load(struct varlena *attr, OToastExternal *ote,
+					  OFixedKey *key, OSnapshot *oSnapshot)
 {
-	OToastExternal ote;
 	ORelOids	oids;
 	OTableDescr *descr;
-	OFixedKey	key;
-	OSnapshot	oSnapshot;
 
-	memcpy(&ote, VARDATA_EXTERNAL(attr), O_TOAST_EXTERNAL_SZ);
-	oids.datoid = ote.datoid;
-	oids.reloid = ote.relid;
-	oids.relnode = ote.relnode;
+	memcpy(ote, VARDATA_EXTERNAL(attr), O_TOAST_EXTERNAL_SZ);
+	oids.datoid = ote->datoid;
+	oids.reloid = ote->relid;
+	oids.relnode = ote->relnode;
 	descr = o_fetch_table_descr(oids);
 
 	Assert(descr);
 
 	o_btree_load_shmem(&descr->toast->desc);
-	key.tuple.formatFlags = ote.formatFlags;
-	key.tuple.data = key.fixedData;
-	memcpy(key.fixedData,
+	key->tuple.formatFlags = ote->formatFlags;
+	key->tuple.data = key->fixedData;
+	memcpy(key->fixedData,
 		   VARDATA_EXTERNAL(attr) + O_TOAST_EXTERNAL_SZ,
-		   ote.data_size);
-	O_LOAD_SNAPSHOT_CSN(&oSnapshot, ote.csn);
+		   ote->data_size);
+	O_LOAD_SNAPSHOT_CSN(oSnapshot, ote->csn);
+	return descr;
+}
+
+struct varlena *
+o_detoast(struct varlena *attr)
+{
+	OToastExternal ote;
+	OTableDescr *descr;
+	OFixedKey	key;
+	OSnapshot	oSnapshot;
+
+	descr = o_toast_external_load(attr, &ote, &key, &oSnapshot);
 	return (struct varlena *) o_toast_get(GET_PRIMARY(descr), descr->toast,
 										  key.tuple, ote.attnum,
 										  ote.toasted_size, &oSnapshot);
@@ -731,6 +745,7 @@ generic_toast_get(ToastAPI *api, void *key, Size data_size,
 		if (O_TUPLE_IS_NULL(tup))
 			break;
 
+		EA_TREE_INC(desc->oids, toastChunk);
 		iter_data_size = api->getTupleDataSize(tup, arg);
 
 		if (actual_size + iter_data_size > data_size)
@@ -764,6 +779,92 @@ generic_toast_get(ToastAPI *api, void *key, Size data_size,
 	return data;
 }
 
+/*
+ * Passes to the callback the parts of the chunks, which cover 'length' bytes
+ * of the TOAST value starting from 'offset'.  All the chunks except the last
+ * one are getMaxChunkSize() bytes long, so the iteration starts from the
+ * chunk holding 'offset' and the preceding chunks are not read.  Stops
+ * early when callback returns false.  Returns the number of bytes passed to
+ * the callback.
+ */
+Size
+generic_toast_iterate_chunks(ToastAPI *api, void *key, Size data_size,
+							 Size offset, Size length,
+							 OSnapshot *o_snapshot, void *arg,
+							 ToastChunkCallback callback,
+							 void *callback_arg)
+{
+	BTreeDescr *desc = api->getBTreeDesc(arg);
+	BTreeIterator *it;
+	void	   *nextKey;
+	uint32		max_length = api->getMaxChunkSize(key, arg);
+	uint32		chunknum;
+	Size		chunk_offset,
+				end,
+				passed = 0;
+
+	if (offset >= data_size)
+		return 0;
+	end = offset + Min(length, data_size - offset);
+
+	chunknum = offset / max_length;
+	chunk_offset = (Size) chunknum * max_length;
+	api->updateKey(key, chunknum, arg);
+	nextKey = api->getNextKey(key, arg);
+
+	it = o_btree_iterator_create(desc, key, BTreeKeyBound,
+								 o_snapshot, ForwardScanDirection);
+	if (api->versionCallback)
+		o_btree_iterator_set_callback(it, api->versionCallback, (void *) key);
+
+	while (chunk_offset < end)
+	{
+		OTuple		tup;
+		uint32		iter_data_size;
+		Size		from,
+					to;
+		bool		cont = true;
+
+		tup = o_btree_iterator_fetch(it, NULL, nextKey, BTreeKeyBound, false, NULL);
+
+		/* if tuple not found */
+		if (O_TUPLE_IS_NULL(tup))
+			break;
+
+		EA_TREE_INC(desc->oids, toastChunk);
+		iter_data_size = api->getTupleDataSize(tup, arg);
+
+		/* chunks are missing or of unexpected size */
+		if (api->getTupleChunknum(tup, arg) != chunknum ||
+			chunk_offset + iter_data_size > data_size)
+		{
+			pfree(tup.data);
+			break;
+		}
+
+		from = Max(offset, chunk_offset);
+		to = Min(end, chunk_offset + iter_data_size);
+		if (to > from)
+		{
+			cont = callback(api->getTupleData(tup, arg) + (from - chunk_offset),
+							from, to - from, callback_arg);
+			passed += to - from;
+		}
+		pfree(tup.data);
+
+		chunk_offset += iter_data_size;
+		chunknum++;
+
+		if (!cont || iter_data_size < max_length)
+			break;
+	}
+
+	btree_iterator_free(it);
+	api->updateKey(key, 0, arg);
+
+	return passed;
+}
+
 /*
  * Common code for
  * generic_toast_get_any_with_callback and generic_toast_get_any_with_key
@@ -913,6 +1014,147 @@ o_toast_sort_add(OIndexDescr *primary, OIndexDescr *toast,
 
 }
 
+typedef struct
+{
+	OTableToastArg *arg;
+	OToastKey  *tkey;
+	OXid		oxid;
+	CommitSeqNo csn;
+	Tuplesortstate *sortstate;
+	uint32		maxLength;
+	uint32		chunknum;
+	uint32		buffered;
+	Pointer		buffer;
+	bool		inserted;
+} ToastCopyArg;
+
+static bool
+toast_copy_put_chunk(ToastCopyArg *copyArg, Pointer data, uint32 length)
+{
+	BTreeDescr *desc = &copyArg->arg->toast->desc;
+	BTreeModifyCallbackInfo callbackInfo = nullCallbackInfo;
+	OTuple		tup;
+
+	tup = tableToastAPI.createTuple(copyArg->tkey, data, 0,
+									copyArg->chunknum, length, copyArg->arg);
+	copyArg->chunknum++;
+
+	if (copyArg->sortstate)
+	{
+		tuplesort_putotuple(copyArg->sortstate, tup);
+		pfree(tup.data);
+		return true;
+	}
+
+	copyArg->inserted = o_btree_modify(desc, BTreeOperationInsert,
+									   tup, BTreeKeyLeafTuple,
+									   copyArg->tkey, BTreeKeyBound,
+									   copyArg->oxid, copyArg->csn,
+									   RowLockUpdate, NULL,
+									   &callbackInfo) == OBTreeModifyResultInserted;
+	if (copyArg->inserted && desc->storageType == BTreeStoragePersistence)
+		add_modify_wal_record(WAL_REC_INSERT, desc, tup,
+							  o_btree_len(desc, tup, OTupleLength));
+	pfree(tup.data);
+	return copyArg->inserted;
+}
+
+/*
+ * Cuts the chunks of the source value into the chunks of the target TOAST
+ * tree.  Whole target chunks are taken right from the source chunk, the rest
+ * is gathered into the buffer.
+ */
+static bool
+toast_copy_callback(Pointer data, Size offset, Size length, void *arg)
+{
+	ToastCopyArg *copyArg = (ToastCopyArg *) arg;
+
+	while (length > 0)
+	{
+		uint32		part;
+
+		if (copyArg->buffered == 0 && length >= copyArg->maxLength)
+		{
+			if (!toast_copy_put_chunk(copyArg, data, copyArg->maxLength))
+				return false;
+			data += copyArg->maxLength;
+			length -= copyArg->maxLength;
+			continue;
+		}
+
+		part = Min(length, copyArg->maxLength - copyArg->buffered);
+		memcpy(copyArg->buffer + copyArg->buffered, data, part);
+		copyArg->buffered += part;
+		data += part;
+		length -= part;
+
+		if (copyArg->buffered == copyArg->maxLength)
+		{
+			copyArg->buffered = 0;
+			if (!toast_copy_put_chunk(copyArg, copyArg->buffer,
+									  copyArg->maxLength))
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Inserts the copy of orioledb TOAST value 'src' chunk by chunk, without
+ * assembling the whole value in memory.  The chunks are put into
+ * 'sortstate' instead of the TOAST tree if it's given.
+ */
+bool
+o_toast_insert_copy(OIndexDescr *primary, OIndexDescr *toast,
+					OTuple pk, uint16 attn, struct varlena *src,
+					OXid oxid, CommitSeqNo csn, Tuplesortstate *sortstate)
+{
+	OToastExternal ote;
+	OTableDescr *srcDescr;
+	OFixedKey	srcKey;
+	OSnapshot	oSnapshot;
+	OToastKey	tkey;
+	OTableToastArg arg = {primary, toast};
+	ToastCopyArg copyArg;
+	Size		passed;
+
+	Assert(toast->desc.type == oIndexToast);
+	Assert(VARATT_IS_EXTERNAL_ORIOLEDB(src));
+
+	srcDescr = o_toast_external_load(src, &ote, &srcKey, &oSnapshot);
+
+	tkey.pk_tuple = pk;
+	tkey.attnum = attn;
+	tkey.chunknum = 0;
+
+	copyArg.arg = &arg;
+	copyArg.tkey = &tkey;
+	copyArg.oxid = oxid;
+	copyArg.csn = csn;
+	copyArg.sortstate = sortstate;
+	copyArg.maxLength = tableGetMaxChunkSize(&tkey, &arg);
+	copyArg.chunknum = 0;
+	copyArg.buffered = 0;
+	copyArg.buffer = palloc(copyArg.maxLength);
+	copyArg.inserted = true;
+
+	passed = o_toast_iterate_chunks(GET_PRIMARY(srcDescr), srcDescr->toast,
+									srcKey.tuple, ote.attnum,
+									ote.toasted_size, 0, ote.toasted_size,
+									&oSnapshot, toast_copy_callback,
+									&copyArg);
+
+	if (copyArg.inserted && passed != ote.toasted_size)
+		elog(ERROR, "missing chunks of orioledb TOAST value");
+
+	if (copyArg.inserted && copyArg.buffered > 0)
+		(void) toast_copy_put_chunk(&copyArg, copyArg.buffer,
+									copyArg.buffered);
+
+	pfree(copyArg.buffer);
+	return copyArg.inserted;
+}
+
 bool
 o_toast_delete(OIndexDescr *primary, OIndexDescr *toast,
 			   OTuple pk, uint16 attn,
@@ -955,6 +1197,26 @@ o_toast_get(OIndexDescr *primary, OIndexDescr *toast,
 	return result;
 }
 
+Size
+o_toast_iterate_chunks(OIndexDescr *primary, OIndexDescr *toast,
+					   OTuple pk, uint16 attn, Size data_size,
+					   Size offset, Size length, OSnapshot *o_snapshot,
+					   ToastChunkCallback callback, void *callback_arg)
+{
+	OToastKey	tkey;
+	OTableToastArg arg = {primary, toast};
+
+	tkey.pk_tuple = pk;
+	tkey.attnum = attn;
+	tkey.chunknum = 0;
+
+	Assert(toast->desc.type == oIndexToast);
+
+	return generic_toast_iterate_chunks(&tableToastAPI, (Pointer) &tkey,
+										data_size, offset, length, o_snapshot,
+										&arg, callback, callback_arg);
+}
+
 static OTuple
 o_create_toast_tuple(OToastKey tkey, Pointer data_ptr, Size data_length,
 					 OTableToastArg *arg)
@@ -1080,6 +1342,97 @@ o_toast_equal(BTreeDescr *primary, Datum left, Datum right)
 				  left_ote.data_size) == 0;
 }
 
+typedef struct
+{
+	Pointer		data;
+	bool		equal;
+} ToastCompareArg;
+
+static bool
+toast_compare_callback(Pointer data, Size offset, Size length, void *arg)
+{
+	ToastCompareArg *cmpArg = (ToastCompareArg *) arg;
+
+	/* offsets of the stored value include the varlena header */
+	if (memcmp(cmpArg->data + (offset - VARHDRSZ), data, length) != 0)
+	{
+		cmpArg->equal = false;
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Compares the raw values of the same raw size.  Uncompressed orioledb TOAST
+ * value is compared chunk by chunk without assembling it, and the comparison
+ * stops at the first differing chunk.
+ */
+bool
+o_toast_raw_equal(Datum left, Datum right)
+{
+	Datum		leftRawValue;
+	Pointer		leftPtr;
+	bool		freeLeft;
+	bool		equal;
+	int32		rawSize = o_get_raw_size(left);
+
+	Assert(rawSize == o_get_raw_size(right));
+
+	if (!VARATT_IS_EXTERNAL_ORIOLEDB(right) ||
+		o_get_src_size(right) != rawSize + VARHDRSZ)
+	{
+		Datum		tmp = left;
+
+		left = right;
+		right = tmp;
+	}
+
+	leftRawValue = o_get_raw_value(left, &freeLeft);
+	leftPtr = DatumGetPointer(leftRawValue);
+
+	if (VARATT_IS_EXTERNAL_ORIOLEDB(right) &&
+		o_get_src_size(right) == rawSize + VARHDRSZ)
+	{
+		OToastExternal ote;
+		OTableDescr *descr;
+		OFixedKey	key;
+		OSnapshot	oSnapshot;
+		ToastCompareArg cmpArg;
+		Size		passed;
+
+		descr = o_toast_external_load((struct varlena *) DatumGetPointer(right),
+									  &ote, &key, &oSnapshot);
+		cmpArg.data = VARDATA_ANY(leftPtr);
+		cmpArg.equal = true;
+		passed = o_toast_iterate_chunks(GET_PRIMARY(descr), descr->toast,
+										key.tuple, ote.attnum,
+										ote.toasted_size,
+										VARHDRSZ, rawSize, &oSnapshot,
+										toast_compare_callback, &cmpArg);
+		equal = cmpArg.equal;
+		Assert(!equal || passed == rawSize);
+	}
+	else
+	{
+		Datum		rightRawValue;
+		Pointer		rightPtr;
+		bool		freeRight;
+
+		rightRawValue = o_get_raw_value(right, &freeRight);
+		rightPtr = DatumGetPointer(rightRawValue);
+		Assert(VARSIZE_ANY_EXHDR(rightPtr) == rawSize);
+		equal = memcmp(VARDATA_ANY(leftPtr), VARDATA_ANY(rightPtr),
+					   rawSize) == 0;
+		if (freeRight)
+			pfree(rightPtr);
+	}
+
+	if (freeLeft)
+		pfree(leftPtr);
+
+	return equal;
+}
+
 Datum
 o_get_raw_value(Datum value, bool *free)
 {
@@ -0,0 +1,306 @@
+/*-------------------------------------------------------------------------
+ *
+ * assoc_cache.c
+ *		Set-associative shared caches of the extents and the undo images.
+ *
+ * The compressed cache, the undo page cache and the zone map split their
+ * arenas into the buckets of a few slots each under the bucket LWLock.
+ * Every slot has the usage count, which is set to the maximum on a hit and
+ * decremented each time a slot of the bucket is replaced, approximating LRU
+ * within the bucket.
+ *
+ * The compressed cache and the zone map keep the entries of the data file
+ * extents.  Such an entry is valid as long as the extent keeps its image:
+ * each write of a page removes the entry of its extent, and removal of the
+ * tree files removes all the entries of the tree.  The routines here manage
+ * the slots by their layout, while the caches fill in their payload.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/assoc_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "utils/assoc_cache.h"
+
+#include "access/htup_details.h"
+#include "common/hashfn.h"
+#include "funcapi.h"
+#include "storage/lwlock.h"
+
+#define ASSOC_CACHE_SLOT(cache, bucket, i) \
+	((bucket) + (cache)->slotsOffset + (Size) (i) * (cache)->slotSize)
+#define ASSOC_CACHE_SLOT_KEY(cache, slot) \
+	((AssocCacheKey *) ((slot) + (cache)->keyOffset))
+#define ASSOC_CACHE_SLOT_USAGE(cache, slot) \
+	((pg_atomic_uint32 *) ((slot) + (cache)->usageOffset))
+
+static uint64
+assoc_cache_nbuckets(AssocCache *cache, Size size)
+{
+	return size / cache->bucketSize;
+}
+
+Size
+assoc_cache_shmem_needs(AssocCache *cache, Size size)
+{
+	return add_size(CACHELINEALIGN(sizeof(AssocCacheMeta)),
+					mul_size(assoc_cache_nbuckets(cache, size),
+							 cache->bucketSize));
+}
+
+/*
+ * Attaches the cache to its shared memory of 'size' bytes.  Initializes the
+ * bucket locks and the empty slots unless 'found'.
+ */
+void
+assoc_cache_shmem_init(AssocCache *cache, Pointer ptr, bool found, Size size,
+					   const char *trancheName)
+{
+	cache->meta = (AssocCacheMeta *) ptr;
+	cache->buckets = ptr + CACHELINEALIGN(sizeof(AssocCacheMeta));
+
+	if (!found)
+	{
+		AssocCacheMeta *meta = cache->meta;
+		uint64		i;
+		int			j;
+
+		meta->trancheId = LWLockNewTrancheId();
+		meta->nbuckets = assoc_cache_nbuckets(cache, size);
+		pg_atomic_init_u64(&meta->usedSlots, 0);
+		for (j = 0; j < ASSOC_CACHE_MAX_COUNTERS; j++)
+			pg_atomic_init_u64(&meta->counters[j], 0);
+
+		for (i = 0; i < meta->nbuckets; i++)
+		{
+			Pointer		bucket = cache->buckets + i * cache->bucketSize;
+
+			LWLockInitialize(ASSOC_CACHE_BUCKET_LOCK(bucket), meta->trancheId);
+			for (j = 0; j < cache->ways; j++)
+			{
+				Pointer		slot = ASSOC_CACHE_SLOT(cache, bucket, j);
+
+				cache->clear(slot);
+				pg_atomic_init_u32(ASSOC_CACHE_SLOT_USAGE(cache, slot), 0);
+			}
+		}
+	}
+	LWLockRegisterTranche(cache->meta->trancheId, trancheName);
+}
+
+/*
+ * The extents are cached for the trees stored in the data files, which any
+ * backend can read.  The temporary trees are local to their backends.
+ */
+bool
+assoc_cache_enabled(AssocCache *cache, BTreeDescr *desc)
+{
+	return cache->meta != NULL &&
+		cache->meta->nbuckets > 0 &&
+		(desc->storageType == BTreeStoragePersistence ||
+		 desc->storageType == BTreeStorageUnlogged);
+}
+
+Pointer
+assoc_cache_bucket(AssocCache *cache, uint32 hash)
+{
+	return cache->buckets + (hash % cache->meta->nbuckets) * cache->bucketSize;
+}
+
+Pointer
+assoc_cache_extent_bucket(AssocCache *cache, BTreeDescr *desc, uint64 off)
+{
+	uint32		hash;
+
+	hash = hash_combine(hash_uint32(desc->oids.datoid),
+						hash_uint32(desc->oids.relnode));
+	hash = hash_combine(hash, hash_uint32((uint32) off));
+	hash = hash_combine(hash, hash_uint32((uint32) (off >> 32)));
+
+	return assoc_cache_bucket(cache, hash);
+}
+
+/*
+ * Returns the slot of the extent in the bucket or NULL.  The caller must
+ * hold the bucket lock.
+ */
+Pointer
+assoc_cache_find(AssocCache *cache, Pointer bucket, BTreeDescr *desc,
+				 uint64 off)
+{
+	int			i;
+
+	for (i = 0; i < cache->ways; i++)
+	{
+		Pointer		slot = ASSOC_CACHE_SLOT(cache, bucket, i);
+		AssocCacheKey *key = ASSOC_CACHE_SLOT_KEY(cache, slot);
+
+		if (!cache->isEmpty(slot) &&
+			key->off == off &&
+			key->relnode == desc->oids.relnode &&
+			key->datoid == desc->oids.datoid)
+			return slot;
+	}
+	return NULL;
+}
+
+/*
+ * Returns the index of the slot to be replaced in the bucket: the first empty
+ * slot or the least used one.  Ages the usage counts of all the slots.  The
+ * caller must hold the bucket lock exclusively.
+ */
+int
+assoc_cache_pick_victim(Pointer slots, Size slotSize, int ways,
+						Size usageOffset, AssocCacheSlotIsEmpty isEmpty,
+						bool *wasEmpty)
+{
+	int			victim = -1,
+				i;
+	uint32		victimUsage = 0;
+
+	*wasEmpty = false;
+	for (i = 0; i < ways; i++)
+	{
+		Pointer		slot = slots + i * slotSize;
+		pg_atomic_uint32 *usagePtr = (pg_atomic_uint32 *) (slot + usageOffset);
+		uint32		usage = pg_atomic_read_u32(usagePtr);
+
+		if (!*wasEmpty)
+		{
+			if (isEmpty(slot))
+			{
+				victim = i;
+				*wasEmpty = true;
+			}
+			else if (victim < 0 || usage < victimUsage)
+			{
+				victim = i;
+				victimUsage = usage;
+			}
+		}
+
+		if (usage > 0)
+			pg_atomic_write_u32(usagePtr, usage - 1);
+	}
+
+	Assert(victim >= 0);
+	return victim;
+}
+
+/*
+ * Returns the slot of the bucket to put the new entry to.  The caller must
+ * hold the bucket lock exclusively.
+ */
+Pointer
+assoc_cache_replace(AssocCache *cache, Pointer bucket)
+{
+	bool		wasEmpty;
+	int			victim;
+
+	victim = assoc_cache_pick_victim(ASSOC_CACHE_SLOT(cache, bucket, 0),
+									 cache->slotSize, cache->ways,
+									 cache->usageOffset, cache->isEmpty,
+									 &wasEmpty);
+	if (wasEmpty)
+		pg_atomic_fetch_add_u64(&cache->meta->usedSlots, 1);
+
+	return ASSOC_CACHE_SLOT(cache, bucket, victim);
+}
+
+static void
+assoc_cache_clear_slot(AssocCache *cache, Pointer slot)
+{
+	cache->clear(slot);
+	pg_atomic_write_u32(ASSOC_CACHE_SLOT_USAGE(cache, slot), 0);
+	pg_atomic_fetch_sub_u64(&cache->meta->usedSlots, 1);
+}
+
+/*
+ * Removes the entry of the extent, which is going to be overwritten.
+ */
+void
+assoc_cache_invalidate(AssocCache *cache, BTreeDescr *desc, uint64 off)
+{
+	Pointer		bucket;
+	Pointer		slot;
+
+	if (!assoc_cache_enabled(cache, desc))
+		return;
+
+	bucket = assoc_cache_extent_bucket(cache, desc, off);
+
+	LWLockAcquire(ASSOC_CACHE_BUCKET_LOCK(bucket), LW_EXCLUSIVE);
+	slot = assoc_cache_find(cache, bucket, desc, off);
+	if (slot)
+		assoc_cache_clear_slot(cache, slot);
+	LWLockRelease(ASSOC_CACHE_BUCKET_LOCK(bucket));
+}
+
+/*
+ * Removes the entries of the dropped tree files, because the relnode might
+ * be reused later.
+ */
+void
+assoc_cache_invalidate_relnode(AssocCache *cache, Oid datoid, Oid relnode)
+{
+	uint64		i;
+	int			j;
+
+	if (cache->meta == NULL ||
+		pg_atomic_read_u64(&cache->meta->usedSlots) == 0)
+		return;
+
+	for (i = 0; i < cache->meta->nbuckets; i++)
+	{
+		Pointer		bucket = cache->buckets + i * cache->bucketSize;
+
+		LWLockAcquire(ASSOC_CACHE_BUCKET_LOCK(bucket), LW_EXCLUSIVE);
+		for (j = 0; j < cache->ways; j++)
+		{
+			Pointer		slot = ASSOC_CACHE_SLOT(cache, bucket, j);
+			AssocCacheKey *key = ASSOC_CACHE_SLOT_KEY(cache, slot);
+
+			if (!cache->isEmpty(slot) &&
+				key->relnode == relnode &&
+				key->datoid == datoid)
+				assoc_cache_clear_slot(cache, slot);
+		}
+		LWLockRelease(ASSOC_CACHE_BUCKET_LOCK(bucket));
+	}
+}
+
+/*
+ * Returns the row of the cache size, the numbers of all and the used slots
+ * followed by the first 'ncounters' counters.
+ */
+Datum
+assoc_cache_stats(AssocCache *cache, FunctionCallInfo fcinfo, int ncounters)
+{
+	TupleDesc	tupdesc;
+	Datum		values[3 + ASSOC_CACHE_MAX_COUNTERS];
+	bool		nulls[3 + ASSOC_CACHE_MAX_COUNTERS];
+	int			i;
+
+	Assert(ncounters <= ASSOC_CACHE_MAX_COUNTERS);
+
+	orioledb_check_shmem();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = Int64GetDatum((int64) (cache->meta->nbuckets *
+									   cache->bucketSize));
+	values[1] = Int64GetDatum((int64) (cache->meta->nbuckets * cache->ways));
+	values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&cache->meta->usedSlots));
+	for (i = 0; i < ncounters; i++)
+		values[3 + i] = Int64GetDatum((int64) pg_atomic_read_u64(&cache->meta->counters[i]));
+	memset(nulls, 0, sizeof(nulls));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
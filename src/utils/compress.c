@@ -1,7 +1,7 @@
 /*-------------------------------------------------------------------------
  *
  * compress.c
- *		Compression functions for BTree pages. Wrapper for libzstd.
+ *		Compression functions for BTree pages. Wrapper for libzstd and liblz4.
  *
  * Copyright (c) 2021-2025, Oriole DB Inc.
  * Copyright (c) 2025, Supabase Inc.
@@ -15,12 +15,90 @@
 
 #include "orioledb.h"
 
+#include "btree/page_contents.h"
+#include "catalog/o_sys_cache.h"
 #include "utils/compress.h"
+#include "workers/compress_worker.h"
 
+#include "common/pg_prng.h"
+#include "portability/instr_time.h"
+#include "storage/fd.h"
 #include "utils/elog.h"
 #include "utils/memdebug.h"
 
+#include "pgstat.h"
+
+#include <math.h>
 #include <zstd.h>
+#include <zstd_errors.h>
+#include <zdict.h>
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+/*
+ * Per-tree dictionaries.  The checkpointer samples the pages it writes and
+ * trains the dictionary for the compressed trees, which don't have one yet.
+ * The dictionary is durably saved next to the tree data file before the
+ * first page is compressed with it, and it never changes for the relnode.
+ * Every compressed frame records the dictionary id, so pages compressed
+ * before the dictionary was trained stay readable.
+ */
+#define O_COMPRESS_DICT_MAGIC		(0x4F434454)
+#define O_COMPRESS_DICT_SIZE		(16 * 1024)
+#define O_COMPRESS_DICT_MIN_SAMPLES	(32)
+#define O_COMPRESS_DICT_MAX_SAMPLES	(128)
+#define O_COMPRESS_DICT_CACHE_SIZE	(16)
+
+typedef struct
+{
+	uint32		magic;
+	uint32		dictId;
+	uint32		size;
+} OCompressDictHeader;
+
+typedef struct
+{
+	Oid			datoid;
+	Oid			relnode;
+	uint32		dictId;
+	uint64		lastUsed;
+	Pointer		dict;
+	size_t		size;
+	OCompress	cdictLevel;
+	ZSTD_CDict *cdict;
+	ZSTD_DDict *ddict;
+} OCompressDict;
+
+static OCompressDict dict_cache[O_COMPRESS_DICT_CACHE_SIZE];
+static uint64 dict_cache_counter = 0;
+
+static ORelOids sampling_oids = {InvalidOid, InvalidOid, InvalidOid};
+static Pointer samples = NULL;
+static size_t sample_sizes[O_COMPRESS_DICT_MAX_SAMPLES];
+static int	samples_count = 0;
+
+/*
+ * Automatic selection of the compression level.  With orioledb.compress_auto,
+ * the checkpointer keeps a random sample of the pages it writes for every
+ * compressed tree, and tries the candidate levels of the tree codec on them.
+ * The level with the most space saved minus the compression and decompression
+ * CPU time weighted by orioledb.compress_auto_cpu_cost is published in the
+ * shared meta-page and used for the following writes.  Storing the pages
+ * uncompressed is a candidate too.  Every checkpoint of the tree revises the
+ * choice, so it follows the changes of the data, but the previous level is
+ * kept unless the new one is noticeably better.
+ */
+#define O_COMPRESS_AUTO_SAMPLES		(8)
+#define O_COMPRESS_AUTO_MAX_CANDIDATES	(8)
+
+static const OCompress zstd_auto_levels[] = {1, 3, 6, 9, 12};
+static const OCompress lz4_auto_levels[] = {1, 4, 16};
+
+static ORelOids auto_sampling_oids = {InvalidOid, InvalidOid, InvalidOid};
+static Pointer auto_samples = NULL;
+static int	auto_samples_count = 0;
+static uint64 auto_pages_count = 0;
 
 static ZSTD_CCtx *zstd_cctx = NULL;
 static ZSTD_DCtx *zstd_dctx = NULL;
@@ -36,6 +114,9 @@ o_compress_init(void)
 	zstd_cctx = ZSTD_createCCtx();
 	zstd_dctx = ZSTD_createDCtx();
 	zstd_dst_size = ZSTD_compressBound(ORIOLEDB_BLCKSZ);
+#ifdef USE_LZ4
+	zstd_dst_size = Max(zstd_dst_size, LZ4_compressBound(ORIOLEDB_BLCKSZ));
+#endif
 	zstd_dst = malloc(zstd_dst_size);
 
 	/*
@@ -50,16 +131,35 @@ o_compress_init(void)
 }
 
 /*
- * Compresses a BTree page.
+ * Compresses a BTree page.  The codec is taken from lvl.
  */
 Pointer
 o_compress_page(Pointer page, size_t *size, OCompress lvl)
 {
 	VALGRIND_CHECK_MEM_IS_DEFINED(page, ORIOLEDB_BLCKSZ);
+	if (OCompressGetCodec(lvl) == O_COMPRESS_CODEC_LZ4)
+	{
+#ifdef USE_LZ4
+		int			result;
+
+		/* The level is the acceleration of LZ4, zero means the default */
+		result = LZ4_compress_fast(page, zstd_dst, ORIOLEDB_BLCKSZ,
+								   zstd_dst_size,
+								   Max(OCompressGetLevel(lvl), 1));
+		if (result <= 0)
+			elog(PANIC, "Unable to compress page with lz4");
+		*size = result;
+		VALGRIND_MAKE_MEM_DEFINED(zstd_dst, *size);
+		return zstd_dst;
+#else
+		elog(PANIC, "lz4 compression is not supported by this build");
+#endif
+	}
+
 	*size = ZSTD_compressCCtx(zstd_cctx,
 							  zstd_dst, zstd_dst_size,
 							  page, ORIOLEDB_BLCKSZ,
-							  lvl);
+							  OCompressGetLevel(lvl));
 	VALGRIND_MAKE_MEM_DEFINED(zstd_dst, *size);
 	if (ZSTD_isError(*size))
 	{
@@ -90,6 +190,593 @@ o_decompress_page(Pointer src, size_t size, Pointer page)
 	Assert(result == ORIOLEDB_BLCKSZ);
 }
 
+/*
+ * Compresses an arbitrary buffer into dst.  Returns zero if the compressed
+ * data doesn't fit dstSize.
+ */
+size_t
+o_compress_buffer(Pointer src, size_t srcSize, Pointer dst, size_t dstSize,
+				  OCompress lvl)
+{
+	size_t		result;
+
+	if (OCompressGetCodec(lvl) == O_COMPRESS_CODEC_LZ4)
+	{
+#ifdef USE_LZ4
+		int			lz4result;
+
+		lz4result = LZ4_compress_fast(src, dst, srcSize, dstSize,
+									  Max(OCompressGetLevel(lvl), 1));
+		return lz4result > 0 ? lz4result : 0;
+#else
+		elog(PANIC, "lz4 compression is not supported by this build");
+#endif
+	}
+
+	result = ZSTD_compressCCtx(zstd_cctx, dst, dstSize, src, srcSize,
+							   OCompressGetLevel(lvl));
+	if (ZSTD_isError(result))
+	{
+		if (ZSTD_getErrorCode(result) == ZSTD_error_dstSize_tooSmall)
+			return 0;
+		elog(PANIC,
+			 "Unable to compress buffer, reason: %s", ZSTD_getErrorName(result));
+	}
+	return result;
+}
+
+/*
+ * Decompresses a buffer compressed by o_compress_buffer().  The decompressed
+ * data must be exactly dstSize bytes.
+ */
+void
+o_decompress_buffer(uint8 codec, Pointer src, size_t srcSize, Pointer dst,
+					size_t dstSize)
+{
+	if (codec == O_COMPRESS_CODEC_LZ4)
+	{
+#ifdef USE_LZ4
+		if (LZ4_decompress_safe(src, dst, srcSize, dstSize) != dstSize)
+			elog(PANIC, "Unable to decompress buffer with lz4");
+#else
+		elog(PANIC, "lz4 compression is not supported by this build");
+#endif
+	}
+	else if (codec == O_COMPRESS_CODEC_ZSTD)
+	{
+		size_t		result;
+
+		result = ZSTD_decompressDCtx(zstd_dctx, dst, dstSize, src, srcSize);
+		if (ZSTD_isError(result))
+			elog(PANIC,
+				 "Unable to decompress buffer, reason: %s",
+				 ZSTD_getErrorName(result));
+		if (result != dstSize)
+			elog(PANIC, "Unexpected decompressed buffer size %zu", result);
+	}
+	else
+		elog(PANIC, "Unknown buffer compression codec %u", codec);
+}
+
+static void
+o_decompress_page_lz4(Pointer src, size_t size, Pointer page)
+{
+#ifdef USE_LZ4
+	int			result;
+
+	result = LZ4_decompress_safe(src, page, size, ORIOLEDB_BLCKSZ);
+	if (result != ORIOLEDB_BLCKSZ)
+		elog(PANIC, "Unable to decompress page with lz4");
+#else
+	elog(PANIC, "lz4 compression is not supported by this build");
+#endif
+}
+
+static char *
+o_compress_dict_filename(Oid datoid, Oid relnode, bool tmp)
+{
+	char	   *db_prefix;
+	char	   *result;
+
+	o_get_prefixes_for_relnode(datoid, relnode, NULL, &db_prefix);
+	result = psprintf(tmp ? "%s/%u.dict.tmp" : "%s/%u.dict", db_prefix, relnode);
+	pfree(db_prefix);
+	return result;
+}
+
+/*
+ * Dictionaries are kept in the per-relnode files, so they aren't available
+ * for the shared device and S3 storage.
+ */
+static bool
+o_compress_dict_supported(BTreeDescr *desc)
+{
+	return OCompressIsValid(desc->compress) &&
+		OCompressGetCodec(desc->compress) == O_COMPRESS_CODEC_ZSTD &&
+		!orioledb_s3_mode && !use_device && !use_mmap &&
+		(desc->storageType == BTreeStoragePersistence ||
+		 desc->storageType == BTreeStorageUnlogged);
+}
+
+static void
+o_compress_dict_release(OCompressDict *entry)
+{
+	if (entry->cdict)
+		ZSTD_freeCDict(entry->cdict);
+	if (entry->ddict)
+		ZSTD_freeDDict(entry->ddict);
+	if (entry->dict)
+		free(entry->dict);
+	memset(entry, 0, sizeof(*entry));
+}
+
+/*
+ * Returns the dictionary of the relnode from the backend-local cache, loading
+ * it from the file if needed.  Zero dictId matches any dictionary.  Returns
+ * NULL if the relnode has no dictionary.
+ */
+static OCompressDict *
+o_compress_dict_get(Oid datoid, Oid relnode, uint32 dictId)
+{
+	OCompressDict *entry = NULL;
+	OCompressDictHeader header;
+	char	   *filename;
+	File		file;
+	int			i;
+
+	for (i = 0; i < O_COMPRESS_DICT_CACHE_SIZE; i++)
+	{
+		OCompressDict *cur = &dict_cache[i];
+
+		if (cur->dict && cur->datoid == datoid && cur->relnode == relnode &&
+			(dictId == 0 || cur->dictId == dictId))
+		{
+			cur->lastUsed = ++dict_cache_counter;
+			return cur;
+		}
+		if (!entry || cur->lastUsed < entry->lastUsed)
+			entry = cur;
+	}
+
+	filename = o_compress_dict_filename(datoid, relnode, false);
+	file = PathNameOpenFile(filename, O_RDONLY | PG_BINARY);
+	if (file < 0)
+	{
+		if (errno != ENOENT)
+			ereport(PANIC, (errcode_for_file_access(),
+							errmsg("could not open compression dictionary file %s: %m",
+								   filename)));
+		pfree(filename);
+		return NULL;
+	}
+
+	o_compress_dict_release(entry);
+	if (FileRead(file, (Pointer) &header, sizeof(header), 0,
+				 WAIT_EVENT_DATA_FILE_READ) != sizeof(header) ||
+		header.magic != O_COMPRESS_DICT_MAGIC ||
+		header.size > O_COMPRESS_DICT_SIZE ||
+		(dictId != 0 && header.dictId != dictId) ||
+		(entry->dict = malloc(header.size)) == NULL ||
+		FileRead(file, entry->dict, header.size, sizeof(header),
+				 WAIT_EVENT_DATA_FILE_READ) != header.size)
+		elog(PANIC, "invalid compression dictionary file %s", filename);
+	FileClose(file);
+	pfree(filename);
+
+	entry->datoid = datoid;
+	entry->relnode = relnode;
+	entry->dictId = header.dictId;
+	entry->size = header.size;
+	entry->lastUsed = ++dict_cache_counter;
+	return entry;
+}
+
+/*
+ * Returns the dictionary id of the tree or O_COMPRESS_DICT_NONE.  The shared
+ * meta-page caches the result of looking for the dictionary file.
+ */
+uint32
+o_compress_tree_dict_id(BTreeDescr *desc)
+{
+	BTreeMetaPage *meta;
+	uint32		dictId;
+
+	if (!o_compress_dict_supported(desc) ||
+		!OInMemoryBlknoIsValid(desc->rootInfo.metaPageBlkno))
+		return O_COMPRESS_DICT_NONE;
+
+	meta = BTREE_GET_META(desc);
+	dictId = pg_atomic_read_u32(&meta->compressDictId);
+	if (dictId == O_COMPRESS_DICT_UNKNOWN)
+	{
+		OCompressDict *entry;
+		uint32		newDictId;
+
+		entry = o_compress_dict_get(desc->oids.datoid, desc->oids.relnode, 0);
+		newDictId = entry ? entry->dictId : O_COMPRESS_DICT_NONE;
+		if (pg_atomic_compare_exchange_u32(&meta->compressDictId,
+										   &dictId, newDictId))
+			dictId = newDictId;
+	}
+	return dictId;
+}
+
+/*
+ * Returns the compression level for the pages of the tree: the automatically
+ * selected one if any, or the configured one.
+ */
+OCompress
+o_compress_tree_level(BTreeDescr *desc)
+{
+	uint32		value;
+
+	if (!compress_auto || !OCompressIsValid(desc->compress) ||
+		!OInMemoryBlknoIsValid(desc->rootInfo.metaPageBlkno))
+		return desc->compress;
+
+	value = pg_atomic_read_u32(&BTREE_GET_META(desc)->compressAuto);
+	if (value == O_COMPRESS_AUTO_UNKNOWN)
+		return desc->compress;
+	return (OCompress) value - O_COMPRESS_AUTO_SHIFT;
+}
+
+/*
+ * Compresses a page of the given tree with the given level using the tree
+ * dictionary if any.
+ */
+Pointer
+o_compress_tree_page(BTreeDescr *desc, Pointer page, size_t *size,
+					 OCompress lvl)
+{
+	uint32		dictId = o_compress_tree_dict_id(desc);
+	OCompressDict *entry;
+
+	if (dictId == O_COMPRESS_DICT_NONE)
+	{
+		/* The compression worker might have compressed it already */
+		if (compress_workers_get_result(desc, page, zstd_dst, size))
+			return zstd_dst;
+		return o_compress_page(page, size, lvl);
+	}
+
+	entry = o_compress_dict_get(desc->oids.datoid, desc->oids.relnode, dictId);
+	if (!entry)
+		elog(PANIC, "compression dictionary %u of relnode %u is missing",
+			 dictId, desc->oids.relnode);
+
+	if (!entry->cdict || entry->cdictLevel != lvl)
+	{
+		if (entry->cdict)
+			ZSTD_freeCDict(entry->cdict);
+		entry->cdict = ZSTD_createCDict(entry->dict, entry->size,
+										OCompressGetLevel(lvl));
+		entry->cdictLevel = lvl;
+		if (!entry->cdict)
+			elog(PANIC, "Unable to create compression dictionary");
+	}
+
+	VALGRIND_CHECK_MEM_IS_DEFINED(page, ORIOLEDB_BLCKSZ);
+	*size = ZSTD_compress_usingCDict(zstd_cctx,
+									 zstd_dst, zstd_dst_size,
+									 page, ORIOLEDB_BLCKSZ,
+									 entry->cdict);
+	VALGRIND_MAKE_MEM_DEFINED(zstd_dst, *size);
+	if (ZSTD_isError(*size))
+	{
+		elog(PANIC,
+			 "Unable to compress page, reason: %s", ZSTD_getErrorName(*size));
+	}
+
+	return zstd_dst;
+}
+
+/*
+ * Decompresses a page of the given tree written with the given codec.  The
+ * zstd frame tells which dictionary it was compressed with.
+ */
+void
+o_decompress_tree_page(BTreeDescr *desc, uint8 codec, Pointer src,
+					   size_t size, Pointer page)
+{
+	unsigned	dictId;
+	OCompressDict *entry;
+	size_t		result;
+
+	if (codec == O_COMPRESS_CODEC_LZ4)
+	{
+		o_decompress_page_lz4(src, size, page);
+		return;
+	}
+	else if (codec != O_COMPRESS_CODEC_ZSTD)
+		elog(PANIC, "Unknown page compression codec %u", codec);
+
+	dictId = ZSTD_getDictID_fromFrame(src, size);
+	if (dictId == 0)
+	{
+		o_decompress_page(src, size, page);
+		return;
+	}
+
+	entry = o_compress_dict_get(desc->oids.datoid, desc->oids.relnode, dictId);
+	if (!entry)
+		elog(PANIC, "compression dictionary %u of relnode %u is missing",
+			 dictId, desc->oids.relnode);
+
+	if (!entry->ddict)
+	{
+		entry->ddict = ZSTD_createDDict(entry->dict, entry->size);
+		if (!entry->ddict)
+			elog(PANIC, "Unable to create decompression dictionary");
+	}
+
+	result = ZSTD_decompress_usingDDict(zstd_dctx,
+										page, ORIOLEDB_BLCKSZ,
+										src, size,
+										entry->ddict);
+	if (ZSTD_isError(result))
+	{
+		elog(PANIC,
+			 "Unable to decompress page, reason: %s", ZSTD_getErrorName(result));
+	}
+
+	Assert(result == ORIOLEDB_BLCKSZ);
+}
+
+/*
+ * Starts sampling of the pages written by the checkpoint of the tree if the
+ * tree needs a dictionary or the automatic selection of the level.
+ */
+void
+o_compress_start_sampling(BTreeDescr *desc)
+{
+	samples_count = 0;
+	sampling_oids.datoid = InvalidOid;
+	auto_samples_count = 0;
+	auto_pages_count = 0;
+	auto_sampling_oids.datoid = InvalidOid;
+
+	if (compress_auto && OCompressIsValid(desc->compress))
+	{
+		if (!auto_samples)
+			auto_samples = malloc((Size) O_COMPRESS_AUTO_SAMPLES * ORIOLEDB_BLCKSZ);
+		if (auto_samples)
+			auto_sampling_oids = desc->oids;
+	}
+
+	if (!compress_dictionaries ||
+		o_compress_tree_dict_id(desc) != O_COMPRESS_DICT_NONE)
+		return;
+
+	if (!samples)
+	{
+		samples = malloc((Size) O_COMPRESS_DICT_MAX_SAMPLES * ORIOLEDB_BLCKSZ);
+		if (!samples)
+			return;
+	}
+	sampling_oids = desc->oids;
+}
+
+/*
+ * Saves the page image for the dictionary training.
+ */
+void
+o_compress_sample_page(BTreeDescr *desc, Pointer page)
+{
+	if (OidIsValid(auto_sampling_oids.datoid) &&
+		ORelOidsIsEqual(auto_sampling_oids, desc->oids))
+	{
+		uint64		i;
+
+		/* Reservoir sampling of all the pages written */
+		if (auto_samples_count < O_COMPRESS_AUTO_SAMPLES)
+			i = auto_samples_count++;
+		else
+			i = pg_prng_uint64_range(&pg_global_prng_state, 0,
+									 auto_pages_count);
+		if (i < O_COMPRESS_AUTO_SAMPLES)
+			memcpy(auto_samples + (Size) i * ORIOLEDB_BLCKSZ, page,
+				   ORIOLEDB_BLCKSZ);
+		auto_pages_count++;
+	}
+
+	if (!OidIsValid(sampling_oids.datoid) ||
+		!ORelOidsIsEqual(sampling_oids, desc->oids) ||
+		samples_count >= O_COMPRESS_DICT_MAX_SAMPLES)
+		return;
+
+	memcpy(samples + (Size) samples_count * ORIOLEDB_BLCKSZ, page,
+		   ORIOLEDB_BLCKSZ);
+	sample_sizes[samples_count++] = ORIOLEDB_BLCKSZ;
+}
+
+/*
+ * Evaluates the candidate level on the sampled pages.  Returns the space
+ * saved minus the weighted CPU time of compression and decompression.
+ */
+static double
+o_compress_auto_score(BTreeDescr *desc, OCompress lvl)
+{
+	char		page[ORIOLEDB_BLCKSZ];
+	instr_time	start,
+				duration;
+	double		saved = 0.0;
+	int			i;
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < auto_samples_count; i++)
+	{
+		Pointer		dst;
+		size_t		size;
+
+		dst = o_compress_page(auto_samples + (Size) i * ORIOLEDB_BLCKSZ,
+							  &size, lvl);
+
+		/* get_write_img() writes such pages uncompressed */
+		if (size >= ORIOLEDB_BLCKSZ || CompressedSize(size) >= ORIOLEDB_BLCKSZ)
+			continue;
+
+		saved += ORIOLEDB_BLCKSZ - CompressedSize(size);
+		o_decompress_tree_page(desc, OCompressGetCodec(lvl), dst, size, page);
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	return saved - INSTR_TIME_GET_MILLISEC(duration) *
+		compress_auto_cpu_cost * 1024.0;
+}
+
+/*
+ * Selects the compression level of the tree using the sampled pages.
+ */
+static void
+o_compress_auto_select(BTreeDescr *desc)
+{
+	BTreeMetaPage *meta = BTREE_GET_META(desc);
+	OCompress	candidates[O_COMPRESS_AUTO_MAX_CANDIDATES];
+	const OCompress *levels;
+	int			codec = OCompressGetCodec(desc->compress),
+				nlevels,
+				ncandidates = 0,
+				i;
+	OCompress	prev,
+				best = InvalidOCompress;
+	double		bestScore = 0.0,
+				prevScore = 0.0;
+
+	if (codec == O_COMPRESS_CODEC_LZ4)
+	{
+		levels = lz4_auto_levels;
+		nlevels = lengthof(lz4_auto_levels);
+	}
+	else
+	{
+		levels = zstd_auto_levels;
+		nlevels = lengthof(zstd_auto_levels);
+	}
+	for (i = 0; i < nlevels; i++)
+		candidates[ncandidates++] = OCompressMake(codec, levels[i]);
+
+	/* The current level is a candidate too */
+	prev = o_compress_tree_level(desc);
+	if (OCompressIsValid(prev))
+	{
+		for (i = 0; i < ncandidates; i++)
+			if (candidates[i] == prev)
+				break;
+		if (i == ncandidates)
+			candidates[ncandidates++] = prev;
+	}
+
+	/* Storing the pages uncompressed scores zero */
+	for (i = 0; i < ncandidates; i++)
+	{
+		double		score = o_compress_auto_score(desc, candidates[i]);
+
+		if (candidates[i] == prev)
+			prevScore = score;
+		if (score > bestScore)
+		{
+			best = candidates[i];
+			bestScore = score;
+		}
+	}
+
+	/* Don't switch the level for a marginal gain */
+	if (best != prev && prevScore >= bestScore - fabs(bestScore) / 10.0)
+		best = prev;
+
+	if (best != prev)
+		elog(DEBUG1, "compression of relnode %u is switched from %s to %s",
+			 desc->oids.relnode, o_compress_to_cstring(prev),
+			 o_compress_to_cstring(best));
+	pg_atomic_write_u32(&meta->compressAuto,
+						(uint32) (best + O_COMPRESS_AUTO_SHIFT));
+}
+
+/*
+ * Finishes sampling.  Selects the compression level, trains the dictionary
+ * and publishes it to the tree if enough pages were sampled.
+ */
+void
+o_compress_finish_sampling(BTreeDescr *desc, bool train)
+{
+	OCompressDictHeader header;
+	char		dict[O_COMPRESS_DICT_SIZE];
+	char	   *filename,
+			   *tmpFilename;
+	size_t		dictSize;
+	File		file;
+	bool		success;
+
+	if (OidIsValid(auto_sampling_oids.datoid) &&
+		ORelOidsIsEqual(auto_sampling_oids, desc->oids))
+	{
+		auto_sampling_oids.datoid = InvalidOid;
+		if (train && auto_samples_count > 0 &&
+			OInMemoryBlknoIsValid(desc->rootInfo.metaPageBlkno))
+			o_compress_auto_select(desc);
+	}
+
+	if (!OidIsValid(sampling_oids.datoid) ||
+		!ORelOidsIsEqual(sampling_oids, desc->oids))
+		return;
+	sampling_oids.datoid = InvalidOid;
+
+	if (!train || samples_count < O_COMPRESS_DICT_MIN_SAMPLES)
+		return;
+
+	dictSize = ZDICT_trainFromBuffer(dict, sizeof(dict), samples,
+									 sample_sizes, samples_count);
+	if (ZDICT_isError(dictSize))
+	{
+		elog(DEBUG1, "could not train compression dictionary for relnode %u: %s",
+			 desc->oids.relnode, ZDICT_getErrorName(dictSize));
+		return;
+	}
+
+	header.magic = O_COMPRESS_DICT_MAGIC;
+	header.dictId = ZDICT_getDictID(dict, dictSize);
+	header.size = dictSize;
+	if (header.dictId == O_COMPRESS_DICT_UNKNOWN ||
+		header.dictId == O_COMPRESS_DICT_NONE)
+		return;
+
+	filename = o_compress_dict_filename(desc->oids.datoid,
+										desc->oids.relnode, false);
+	tmpFilename = o_compress_dict_filename(desc->oids.datoid,
+										   desc->oids.relnode, true);
+	file = PathNameOpenFile(tmpFilename,
+							O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (file < 0)
+	{
+		ereport(LOG, (errcode_for_file_access(),
+					  errmsg("could not open compression dictionary file %s: %m",
+							 tmpFilename)));
+		pfree(filename);
+		pfree(tmpFilename);
+		return;
+	}
+
+	success = FileWrite(file, (Pointer) &header, sizeof(header), 0,
+						WAIT_EVENT_DATA_FILE_WRITE) == sizeof(header) &&
+		FileWrite(file, dict, dictSize, sizeof(header),
+				  WAIT_EVENT_DATA_FILE_WRITE) == dictSize &&
+		FileSync(file, WAIT_EVENT_DATA_FILE_SYNC) == 0;
+	if (!success)
+		ereport(LOG, (errcode_for_file_access(),
+					  errmsg("could not write compression dictionary file %s: %m",
+							 tmpFilename)));
+	FileClose(file);
+
+	/* The dictionary must be durable before any page is compressed with it */
+	if (success && durable_rename(tmpFilename, filename, LOG) == 0)
+		pg_atomic_write_u32(&BTREE_GET_META(desc)->compressDictId,
+							header.dictId);
+
+	pfree(filename);
+	pfree(tmpFilename);
+}
+
 /*
  * Returns max orioledb compression level.
  */
@@ -104,9 +791,58 @@ validate_compress(OCompress compress, char *prefix)
 {
 	OCompress	max_compress = o_compress_max_lvl();
 
+	if (OCompressIsValid(compress) &&
+		OCompressGetCodec(compress) == O_COMPRESS_CODEC_LZ4)
+	{
+#ifndef USE_LZ4
+		elog(ERROR, "%s compression codec lz4 is not supported by this build",
+			 prefix);
+#endif
+		return;
+	}
+
 	if (compress < -1 || compress > max_compress)
 	{
 		elog(ERROR, "%s compression level must be between %d and %d",
 			 prefix, -1, max_compress);
 	}
 }
+
+/*
+ * Applies the default codec to the plain compression level.
+ */
+OCompress
+o_compress_default_codec(OCompress compress)
+{
+	if (!OCompressIsValid(compress) ||
+		OCompressGetCodec(compress) != O_COMPRESS_CODEC_ZSTD)
+		return compress;
+	return OCompressMake(default_compress_codec, compress);
+}
+
+/*
+ * Returns the textual representation of the compression option.  Plain zstd
+ * levels are shown as numbers.
+ */
+char *
+o_compress_to_cstring(OCompress compress)
+{
+	if (OCompressIsValid(compress) &&
+		OCompressGetCodec(compress) == O_COMPRESS_CODEC_LZ4)
+		return psprintf("lz4:%d", OCompressGetLevel(compress));
+	return psprintf("%d", compress);
+}
+
+/*
+ * Returns the valid compression as the "<codec>:<level>" option value, which
+ * parses back regardless of orioledb.default_compress_codec.
+ */
+char *
+o_compress_to_option(OCompress compress)
+{
+	Assert(OCompressIsValid(compress));
+	return psprintf("%s:%d",
+					OCompressGetCodec(compress) == O_COMPRESS_CODEC_LZ4 ?
+					"lz4" : "zstd",
+					OCompressGetLevel(compress));
+}
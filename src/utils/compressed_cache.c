@@ -0,0 +1,236 @@
+/*-------------------------------------------------------------------------
+ *
+ * compressed_cache.c
+ *		Shared cache of compressed images of evicted BTree pages.
+ *
+ * The cache is an optional tier between the page pools and the data files.
+ * When a page is evicted, its image is compressed with zstd and placed into
+ * a bounded shared arena keyed by the tree and the extent the page occupies
+ * on disk.  Subsequent reads of the extent decompress the cached image
+ * instead of issuing the disk (or S3) read.
+ *
+ * The arena is a set-associative hash: every bucket holds a few fixed-size
+ * slots under its own LWLock.  Pages, which don't compress into a slot, are
+ * not cached.  The victim within a bucket is chosen by a clock-like aging of
+ * the slot usage counters.
+ *
+ * The cached image is always identical to the contents of the extent.  The
+ * page is put into the cache at eviction while the parent page is locked, so
+ * no one can load it back and rewrite the extent meanwhile.  Each write of
+ * a page removes the entry of its extent, and removal of the tree files
+ * removes all the entries of the tree.  The extents are reused only by the
+ * subsequent writes, so a stale entry can't be reached by a valid downlink.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/compressed_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "utils/assoc_cache.h"
+#include "utils/compress.h"
+#include "utils/compressed_cache.h"
+
+#include "storage/lwlock.h"
+
+#define COMPRESSED_CACHE_WAYS		4
+#define COMPRESSED_CACHE_SLOT_SIZE	(ORIOLEDB_BLCKSZ / 2)
+#define COMPRESSED_CACHE_LEVEL		1
+#define COMPRESSED_CACHE_MAX_USAGE	3
+
+/* the cache counters */
+#define COMPRESSED_CACHE_HITS		0
+#define COMPRESSED_CACHE_MISSES		1
+#define COMPRESSED_CACHE_INSERTS	2
+#define COMPRESSED_CACHE_REJECTS	3
+
+typedef struct
+{
+	AssocCacheKey key;
+	/* size of the compressed image, zero for the empty slot */
+	uint32		size;
+	pg_atomic_uint32 usage;
+	char		data[COMPRESSED_CACHE_SLOT_SIZE];
+} CompressedCacheSlot;
+
+typedef struct
+{
+	LWLock		lock;
+	CompressedCacheSlot slots[COMPRESSED_CACHE_WAYS];
+} CompressedCacheBucket;
+
+static bool compressed_cache_slot_is_empty(Pointer slot);
+static void compressed_cache_slot_clear(Pointer slot);
+
+static AssocCache compressedCache = {
+	.bucketSize = sizeof(CompressedCacheBucket),
+	.slotsOffset = offsetof(CompressedCacheBucket, slots),
+	.slotSize = sizeof(CompressedCacheSlot),
+	.ways = COMPRESSED_CACHE_WAYS,
+	.keyOffset = offsetof(CompressedCacheSlot, key),
+	.usageOffset = offsetof(CompressedCacheSlot, usage),
+	.isEmpty = compressed_cache_slot_is_empty,
+	.clear = compressed_cache_slot_clear
+};
+
+PG_FUNCTION_INFO_V1(orioledb_compressed_cache_stats);
+
+Size
+compressed_cache_shmem_needs(void)
+{
+	return assoc_cache_shmem_needs(&compressedCache, compressed_cache_size);
+}
+
+void
+compressed_cache_shmem_init(Pointer ptr, bool found)
+{
+	assoc_cache_shmem_init(&compressedCache, ptr, found, compressed_cache_size,
+						   "OCompressedCacheTranche");
+}
+
+static bool
+compressed_cache_slot_is_empty(Pointer slot)
+{
+	return ((CompressedCacheSlot *) slot)->size == 0;
+}
+
+static void
+compressed_cache_slot_clear(Pointer slot)
+{
+	((CompressedCacheSlot *) slot)->size = 0;
+}
+
+static inline void
+compressed_cache_count(int counter)
+{
+	pg_atomic_fetch_add_u64(&compressedCache.meta->counters[counter], 1);
+}
+
+/*
+ * Puts the image of the evicted page, which is located at the given extent
+ * offset, into the cache.  The caller must prevent the page from being
+ * loaded back until we finish.
+ */
+void
+compressed_cache_put(BTreeDescr *desc, uint64 off, Page page)
+{
+	CompressedCacheBucket *bucket;
+	CompressedCacheSlot *slot;
+	Pointer		image;
+	size_t		size;
+
+	if (!assoc_cache_enabled(&compressedCache, desc) ||
+		!FileExtentOffIsValid(off))
+		return;
+
+	bucket = (CompressedCacheBucket *)
+		assoc_cache_extent_bucket(&compressedCache, desc, off);
+
+	/* Page was already cached since its last write */
+	LWLockAcquire(&bucket->lock, LW_SHARED);
+	slot = (CompressedCacheSlot *)
+		assoc_cache_find(&compressedCache, (Pointer) bucket, desc, off);
+	if (slot)
+		pg_atomic_write_u32(&slot->usage, COMPRESSED_CACHE_MAX_USAGE);
+	LWLockRelease(&bucket->lock);
+	if (slot)
+		return;
+
+	image = o_compress_page(page, &size, COMPRESSED_CACHE_LEVEL);
+	if (size > COMPRESSED_CACHE_SLOT_SIZE)
+	{
+		compressed_cache_count(COMPRESSED_CACHE_REJECTS);
+		return;
+	}
+
+	LWLockAcquire(&bucket->lock, LW_EXCLUSIVE);
+	slot = (CompressedCacheSlot *)
+		assoc_cache_find(&compressedCache, (Pointer) bucket, desc, off);
+	if (!slot)
+		slot = (CompressedCacheSlot *)
+			assoc_cache_replace(&compressedCache, (Pointer) bucket);
+
+	slot->key.datoid = desc->oids.datoid;
+	slot->key.relnode = desc->oids.relnode;
+	slot->key.off = off;
+	slot->size = size;
+	memcpy(slot->data, image, size);
+	pg_atomic_write_u32(&slot->usage, COMPRESSED_CACHE_MAX_USAGE);
+	LWLockRelease(&bucket->lock);
+
+	compressed_cache_count(COMPRESSED_CACHE_INSERTS);
+}
+
+/*
+ * Decompresses the cached image of the extent to the img.  Returns false if
+ * the extent isn't cached.
+ */
+bool
+compressed_cache_get(BTreeDescr *desc, uint64 off, Pointer img)
+{
+	CompressedCacheBucket *bucket;
+	CompressedCacheSlot *slot;
+	char		buf[COMPRESSED_CACHE_SLOT_SIZE];
+	uint32		size = 0;
+
+	if (!assoc_cache_enabled(&compressedCache, desc))
+		return false;
+
+	bucket = (CompressedCacheBucket *)
+		assoc_cache_extent_bucket(&compressedCache, desc, off);
+
+	LWLockAcquire(&bucket->lock, LW_SHARED);
+	slot = (CompressedCacheSlot *)
+		assoc_cache_find(&compressedCache, (Pointer) bucket, desc, off);
+	if (slot)
+	{
+		size = slot->size;
+		memcpy(buf, slot->data, size);
+		if (pg_atomic_read_u32(&slot->usage) < COMPRESSED_CACHE_MAX_USAGE)
+			pg_atomic_fetch_add_u32(&slot->usage, 1);
+	}
+	LWLockRelease(&bucket->lock);
+
+	if (size == 0)
+	{
+		compressed_cache_count(COMPRESSED_CACHE_MISSES);
+		return false;
+	}
+
+	o_decompress_page(buf, size, img);
+
+	/*
+	 * The image was taken from the shared page: reset its state like the
+	 * disk read does.
+	 */
+	memset(img, 0, offsetof(OrioleDBPageHeader, checkpointNum));
+
+	compressed_cache_count(COMPRESSED_CACHE_HITS);
+	return true;
+}
+
+void
+compressed_cache_invalidate(BTreeDescr *desc, uint64 off)
+{
+	assoc_cache_invalidate(&compressedCache, desc, off);
+}
+
+void
+compressed_cache_invalidate_relnode(Oid datoid, Oid relnode)
+{
+	assoc_cache_invalidate_relnode(&compressedCache, datoid, relnode);
+}
+
+/*
+ * Reports the compressed cache size, occupancy and hit statistics.
+ */
+Datum
+orioledb_compressed_cache_stats(PG_FUNCTION_ARGS)
+{
+	return assoc_cache_stats(&compressedCache, fcinfo, 4);
+}
@@ -0,0 +1,376 @@
+/*-------------------------------------------------------------------------
+ *
+ * extent_sort.c
+ *		Routines for sorting of the free extents lists.
+ *
+ * Checkpoint sorts the lists of free blocks in the .map and .tmp files of
+ * every tree.  Uncompressed trees store the uint32 block offsets, which are
+ * sorted ascending.  Compressed trees and device mode store FileExtent's,
+ * which are sorted by length descending and then by offset ascending.  Both
+ * orders are the orders of unsigned integer keys, so the lists are sorted
+ * with LSD radix sort.
+ *
+ * The lists of the large trees might not fit into checkpoint_sort_mem.  Then
+ * the list is sorted by runs, which are written to the temporary file, and
+ * the runs are merged back to the original file.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/extent_sort.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/io.h"
+#include "utils/extent_sort.h"
+
+#include "lib/binaryheap.h"
+#include "pgstat.h"
+
+#define RADIX_BITS		(8)
+#define RADIX_SIZE		(1 << RADIX_BITS)
+
+/* The run of the external sort being merged */
+typedef struct
+{
+	Pointer		buf;
+	/* number of items loaded into buf and the current position there */
+	uint64		loaded;
+	uint64		pos;
+	/* offset of the next item to load and the items left in the run */
+	off_t		fileOffset;
+	uint64		left;
+} ExtentSortRun;
+
+typedef struct
+{
+	ExtentSortRun *runs;
+	bool		extents;
+} ExtentSortMergeState;
+
+/*
+ * Key of the FileExtent: longer extents go first, then lower offsets.
+ */
+static inline uint64
+extent_to_key(FileExtent extent)
+{
+	return ((uint64) (0xFFFF - extent.len) << 48) | (uint64) extent.off;
+}
+
+static inline FileExtent
+key_to_extent(uint64 key)
+{
+	FileExtent	extent;
+
+	extent.len = 0xFFFF - (key >> 48);
+	extent.off = key & UINT64CONST(0xFFFFFFFFFFFF);
+	return extent;
+}
+
+static void
+extents_to_keys(Pointer items, uint64 count)
+{
+	uint64		i;
+
+	for (i = 0; i < count; i++)
+	{
+		FileExtent	extent;
+		uint64		key;
+
+		memcpy(&extent, items + i * sizeof(FileExtent), sizeof(FileExtent));
+		key = extent_to_key(extent);
+		memcpy(items + i * sizeof(uint64), &key, sizeof(uint64));
+	}
+}
+
+static void
+keys_to_extents(Pointer items, uint64 count)
+{
+	uint64		i;
+
+	for (i = 0; i < count; i++)
+	{
+		FileExtent	extent;
+		uint64		key;
+
+		memcpy(&key, items + i * sizeof(uint64), sizeof(uint64));
+		extent = key_to_extent(key);
+		memcpy(items + i * sizeof(FileExtent), &extent, sizeof(FileExtent));
+	}
+}
+
+static inline uint64
+item_key(Pointer items, uint64 i, bool extents)
+{
+	if (extents)
+		return ((uint64 *) items)[i];
+	else
+		return ((uint32 *) items)[i];
+}
+
+static inline void
+set_item_key(Pointer items, uint64 i, uint64 key, bool extents)
+{
+	if (extents)
+		((uint64 *) items)[i] = key;
+	else
+		((uint32 *) items)[i] = (uint32) key;
+}
+
+/*
+ * Sorts the keys using 'tmp' of the same size as a scratch area.  The passes
+ * where all the keys have the same digit are skipped: the offsets of the
+ * small files and the lengths of the extents rarely use all the bits.
+ */
+static void
+radix_sort_keys(Pointer items, Pointer tmp, uint64 count, bool extents)
+{
+	int			npasses = extents ? sizeof(uint64) : sizeof(uint32);
+	Pointer		src = items,
+				dst = tmp;
+	int			pass;
+	uint64		i;
+
+	for (pass = 0; pass < npasses; pass++)
+	{
+		uint64		counts[RADIX_SIZE] = {0};
+		int			shift = pass * RADIX_BITS;
+		uint64		sum = 0;
+		Pointer		swap;
+		int			j;
+
+		for (i = 0; i < count; i++)
+			counts[(item_key(src, i, extents) >> shift) & (RADIX_SIZE - 1)]++;
+
+		if (counts[(item_key(src, 0, extents) >> shift) & (RADIX_SIZE - 1)] == count)
+			continue;
+
+		for (j = 0; j < RADIX_SIZE; j++)
+		{
+			uint64		c = counts[j];
+
+			counts[j] = sum;
+			sum += c;
+		}
+
+		for (i = 0; i < count; i++)
+		{
+			uint64		key = item_key(src, i, extents);
+
+			set_item_key(dst, counts[(key >> shift) & (RADIX_SIZE - 1)]++,
+						 key, extents);
+		}
+
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != items)
+		memcpy(items, src, count * (extents ? sizeof(uint64) : sizeof(uint32)));
+}
+
+/*
+ * Sorts the list of keys (see extents_to_keys()) in memory.
+ */
+static void
+sort_keys(Pointer items, uint64 count, bool extents)
+{
+	Pointer		tmp;
+
+	if (count <= 1)
+		return;
+
+	tmp = palloc_extended(count * (extents ? sizeof(uint64) : sizeof(uint32)),
+						  MCXT_ALLOC_HUGE);
+	radix_sort_keys(items, tmp, count, extents);
+	pfree(tmp);
+}
+
+/*
+ * Sorts the list of free extents in memory.  The list consists of
+ * FileExtent's if 'extents' is set, or of uint32 offsets otherwise.
+ */
+void
+sort_free_extents(Pointer items, uint64 count, bool extents)
+{
+	if (extents)
+		extents_to_keys(items, count);
+	sort_keys(items, count, extents);
+	if (extents)
+		keys_to_extents(items, count);
+}
+
+static void
+read_items(File file, const char *filename, Pointer buf, Size size,
+		   off_t offset)
+{
+	if (size > 0 &&
+		OFileRead(file, buf, size, offset, WAIT_EVENT_DATA_FILE_READ) != size)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not read free extents from file %s: %m",
+							   filename)));
+}
+
+static void
+write_items(File file, const char *filename, Pointer buf, Size size,
+			off_t offset)
+{
+	if (size > 0 &&
+		OFileWrite(file, buf, size, offset, WAIT_EVENT_DATA_FILE_WRITE) != size)
+		ereport(FATAL, (errcode_for_file_access(),
+						errmsg("could not write sorted free extents to file %s: %m",
+							   filename)));
+}
+
+/*
+ * Min-heap comparator for the runs: binaryheap keeps the largest item on top.
+ */
+static int
+extent_sort_run_cmp(Datum a, Datum b, void *arg)
+{
+	ExtentSortMergeState *state = (ExtentSortMergeState *) arg;
+	ExtentSortRun *run1 = &state->runs[DatumGetInt32(a)];
+	ExtentSortRun *run2 = &state->runs[DatumGetInt32(b)];
+	uint64		key1 = item_key(run1->buf, run1->pos, state->extents);
+	uint64		key2 = item_key(run2->buf, run2->pos, state->extents);
+
+	if (key1 != key2)
+		return key1 > key2 ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Loads the next part of the run.  Returns false if the run is finished.
+ */
+static bool
+extent_sort_run_load(ExtentSortRun *run, File tmpFile, uint64 bufItems,
+					 Size itemSize)
+{
+	if (run->pos < run->loaded)
+		return true;
+	if (run->left == 0)
+		return false;
+
+	run->loaded = Min(run->left, bufItems);
+	run->pos = 0;
+	read_items(tmpFile, "(temporary)", run->buf, run->loaded * itemSize,
+			   run->fileOffset);
+	run->fileOffset += run->loaded * itemSize;
+	run->left -= run->loaded;
+	return true;
+}
+
+/*
+ * Sorts the list of 'count' free extents located in the 'file' from the
+ * 'start' offset.  Uses no more than checkpoint_sort_mem of memory.
+ */
+void
+sort_free_extents_file(File file, const char *filename, off_t start,
+					   uint64 count, bool extents)
+{
+	Size		itemSize = extents ? sizeof(uint64) : sizeof(uint32);
+	Size		memSize = (Size) checkpoint_sort_mem * 1024;
+	uint64		runItems;
+	uint64		nruns;
+	uint64		bufItems;
+	uint64		i;
+	File		tmpFile;
+	Pointer		items;
+	Pointer		outBuf;
+	uint64		outCount = 0;
+	off_t		outOffset = start;
+	ExtentSortMergeState state;
+	binaryheap *heap;
+
+	if (count <= 1)
+		return;
+
+	/* a run and the scratch area of the radix sort should fit memory */
+	runItems = Max(memSize / (2 * itemSize), 1);
+
+	if (count <= runItems)
+	{
+		items = palloc_extended(count * itemSize, MCXT_ALLOC_HUGE);
+		read_items(file, filename, items, count * itemSize, start);
+		sort_free_extents(items, count, extents);
+		write_items(file, filename, items, count * itemSize, start);
+		pfree(items);
+		return;
+	}
+
+	/* sorts the runs into the temporary file */
+	tmpFile = OpenTemporaryFile(true);
+	items = palloc_extended(runItems * itemSize, MCXT_ALLOC_HUGE);
+	nruns = (count + runItems - 1) / runItems;
+	for (i = 0; i < nruns; i++)
+	{
+		uint64		n = Min(runItems, count - i * runItems);
+
+		read_items(file, filename, items, n * itemSize,
+				   start + i * runItems * itemSize);
+		if (extents)
+			extents_to_keys(items, n);
+		sort_keys(items, n, extents);
+		write_items(tmpFile, "(temporary)", items, n * itemSize,
+					i * runItems * itemSize);
+	}
+	pfree(items);
+
+	/* merges the runs back to the original file */
+	bufItems = Max(memSize / ((nruns + 1) * itemSize), BLCKSZ / itemSize);
+	state.extents = extents;
+	state.runs = (ExtentSortRun *) palloc0(sizeof(ExtentSortRun) * nruns);
+	heap = binaryheap_allocate(nruns, extent_sort_run_cmp, &state);
+	for (i = 0; i < nruns; i++)
+	{
+		ExtentSortRun *run = &state.runs[i];
+
+		run->buf = palloc_extended(bufItems * itemSize, MCXT_ALLOC_HUGE);
+		run->fileOffset = i * runItems * itemSize;
+		run->left = Min(runItems, count - i * runItems);
+		if (extent_sort_run_load(run, tmpFile, bufItems, itemSize))
+			binaryheap_add_unordered(heap, Int32GetDatum(i));
+	}
+	binaryheap_build(heap);
+
+	outBuf = palloc_extended(bufItems * itemSize, MCXT_ALLOC_HUGE);
+	while (!binaryheap_empty(heap))
+	{
+		int			runNum = DatumGetInt32(binaryheap_first(heap));
+		ExtentSortRun *run = &state.runs[runNum];
+
+		set_item_key(outBuf, outCount++, item_key(run->buf, run->pos, extents),
+					 extents);
+		run->pos++;
+
+		if (outCount == bufItems)
+		{
+			if (extents)
+				keys_to_extents(outBuf, outCount);
+			write_items(file, filename, outBuf, outCount * itemSize, outOffset);
+			outOffset += outCount * itemSize;
+			outCount = 0;
+		}
+
+		if (extent_sort_run_load(run, tmpFile, bufItems, itemSize))
+			binaryheap_replace_first(heap, Int32GetDatum(runNum));
+		else
+			(void) binaryheap_remove_first(heap);
+	}
+	if (extents)
+		keys_to_extents(outBuf, outCount);
+	write_items(file, filename, outBuf, outCount * itemSize, outOffset);
+	Assert(outOffset + outCount * itemSize == start + count * itemSize);
+
+	for (i = 0; i < nruns; i++)
+		pfree(state.runs[i].buf);
+	pfree(state.runs);
+	pfree(outBuf);
+	binaryheap_free(heap);
+	FileClose(tmpFile);
+}
@@ -25,6 +25,19 @@
 
 #define O_BUFFERS_PER_GROUP 4
 
+/* maximal number of blocks read from the file at once */
+#define O_BUFFERS_MAX_READ_BLOCKS 8
+
+/*
+ * The identity of the buffer contents: the tag and the block number packed
+ * into the single word, which can be checked without the locks.
+ */
+#define O_BUFFER_IDENT(tag, blockNum) (((uint64) (blockNum) << 2) | (tag))
+#define O_BUFFER_INVALID_IDENT PG_UINT64_MAX
+
+StaticAssertDecl(OBuffersMaxTags <= 4,
+				 "buffers tag should fit into two bits of the identity");
+
 struct OBuffersMeta
 {
 	int			groupCtlTrancheId;
@@ -34,6 +47,8 @@ struct OBuffersMeta
 typedef struct
 {
 	LWLock		bufferCtlLock;
+	/* O_BUFFER_IDENT() of the tag and blockNum, changed under bufferCtlLock */
+	pg_atomic_uint64 ident;
 	int64		blockNum;
 	int64		shadowBlockNum;
 	uint32		tag;
@@ -43,6 +58,11 @@ typedef struct
 	char		data[ORIOLEDB_BLCKSZ];
 } OBuffer;
 
+/*
+ * The buffers of the block are searched within the single group.  The lookup
+ * of the resident block doesn't take the group lock, it's only taken to
+ * evict a buffer of the group.
+ */
 struct OBuffersGroup
 {
 	LWLock		groupCtlLock;
@@ -92,7 +112,9 @@ o_buffers_shmem_init(OBuffersDesc *desc, void *buf, bool found)
 
 				LWLockInitialize(&buffer->bufferCtlLock,
 								 desc->metaPageBlkno->bufferCtlTrancheId);
+				pg_atomic_init_u64(&buffer->ident, O_BUFFER_INVALID_IDENT);
 				buffer->blockNum = -1;
+				buffer->shadowBlockNum = -1;
 				buffer->usageCount = 0;
 				buffer->dirty = false;
 				buffer->tag = 0;
@@ -168,15 +190,28 @@ write_buffer(OBuffersDesc *desc, OBuffer *buffer)
 	write_buffer_data(desc, buffer->data, buffer->tag, buffer->blockNum);
 }
 
+/*
+ * Reads the consecutive blocks to the buffers using the single read call.
+ * The buffers should be locked in the exclusive mode.
+ */
 static void
-read_buffer(OBuffersDesc *desc, OBuffer *buffer)
+read_buffers(OBuffersDesc *desc, OBuffer **buffers, int nbuffers)
 {
-	int			result;
+	static char readData[O_BUFFERS_MAX_READ_BLOCKS * ORIOLEDB_BLCKSZ];
+	OBuffer    *first = buffers[0];
+	char	   *data;
+	int			result,
+				i;
+
+	Assert(nbuffers > 0 && nbuffers <= O_BUFFERS_MAX_READ_BLOCKS);
+
+	/* Read a single block directly to the buffer */
+	data = nbuffers == 1 ? first->data : readData;
 
-	open_file(desc, buffer->tag,
-			  buffer->blockNum / (desc->singleFileSize / ORIOLEDB_BLCKSZ));
-	result = OFileRead(desc->curFile, buffer->data, ORIOLEDB_BLCKSZ,
-					   (buffer->blockNum * ORIOLEDB_BLCKSZ) % desc->singleFileSize,
+	open_file(desc, first->tag,
+			  first->blockNum / (desc->singleFileSize / ORIOLEDB_BLCKSZ));
+	result = OFileRead(desc->curFile, data, nbuffers * ORIOLEDB_BLCKSZ,
+					   (first->blockNum * ORIOLEDB_BLCKSZ) % desc->singleFileSize,
 					   WAIT_EVENT_SLRU_READ);
 
 	/* we may not read all the bytes due to read past EOF */
@@ -184,14 +219,89 @@ read_buffer(OBuffersDesc *desc, OBuffer *buffer)
 		ereport(PANIC, (errcode_for_file_access(),
 						errmsg("could not read buffer from file %s: %m", desc->curFileName)));
 
-	if (result < ORIOLEDB_BLCKSZ)
-		memset(&buffer->data[result], 0, ORIOLEDB_BLCKSZ - result);
+	for (i = 0; i < nbuffers; i++)
+	{
+		OBuffer    *buffer = buffers[i];
+		int			blockResult = Min(Max(result - i * ORIOLEDB_BLCKSZ, 0),
+									  ORIOLEDB_BLCKSZ);
+
+		Assert(buffer->tag == first->tag &&
+			   buffer->blockNum == first->blockNum + i);
+
+		if (nbuffers > 1)
+			memcpy(buffer->data, &readData[i * ORIOLEDB_BLCKSZ], blockResult);
+		if (blockResult < ORIOLEDB_BLCKSZ)
+			memset(&buffer->data[blockResult], 0, ORIOLEDB_BLCKSZ - blockResult);
+		buffer->shadowBlockNum = -1;
+	}
+}
+
+static inline OBuffersGroup *
+get_group(OBuffersDesc *desc, uint32 tag, int64 blockNum)
+{
+	/*
+	 * The consecutive blocks are placed to the different groups, and so are
+	 * the blocks of the different tags having the same number.
+	 */
+	return &desc->groups[((uint64) blockNum + (uint64) tag * 0x9E3779B9) %
+						 desc->groupsCount];
+}
+
+static inline void
+set_buffer_block(OBuffer *buffer, uint32 tag, int64 blockNum)
+{
+	buffer->blockNum = blockNum;
+	buffer->tag = tag;
+	pg_atomic_write_u64(&buffer->ident,
+						blockNum >= 0 ? O_BUFFER_IDENT(tag, blockNum) :
+						O_BUFFER_INVALID_IDENT);
+}
+
+/*
+ * Lock-free lookup of the resident block.  The identity of the buffer is
+ * rechecked after taking its lock, because the buffer might be evicted
+ * meanwhile.  Returns NULL if the block isn't found.
+ */
+static OBuffer *
+lookup_buffer(OBuffersDesc *desc, uint32 tag, int64 blockNum, bool write)
+{
+	OBuffersGroup *group = get_group(desc, tag, blockNum);
+	uint64		ident = O_BUFFER_IDENT(tag, blockNum);
+	int			i;
+
+	for (i = 0; i < O_BUFFERS_PER_GROUP; i++)
+	{
+		OBuffer    *buffer = &group->buffers[i];
+
+		if (pg_atomic_read_u64(&buffer->ident) != ident)
+			continue;
+
+		LWLockAcquire(&buffer->bufferCtlLock, write ? LW_EXCLUSIVE : LW_SHARED);
+		if (pg_atomic_read_u64(&buffer->ident) == ident)
+		{
+			buffer->usageCount++;
+			return buffer;
+		}
+		LWLockRelease(&buffer->bufferCtlLock);
+		break;
+	}
+	return NULL;
 }
 
+/*
+ * Evicts a buffer of the group to place the given block there.  Returns the
+ * buffer locked in the exclusive mode with the previous contents written out,
+ * the caller has to read the block to the buffer.
+ *
+ * If the block turns out to be already resident, sets *found and returns its
+ * buffer locked in the requested mode.  In the nowait mode, returns NULL
+ * instead, as well as in the case some lock isn't immediately available.
+ */
 static OBuffer *
-get_buffer(OBuffersDesc *desc, uint32 tag, int64 blockNum, bool write)
+evict_buffer(OBuffersDesc *desc, uint32 tag, int64 blockNum, bool write,
+			 bool nowait, bool *found)
 {
-	OBuffersGroup *group = &desc->groups[blockNum % desc->groupsCount];
+	OBuffersGroup *group = get_group(desc, tag, blockNum);
 	OBuffer    *buffer = NULL;
 	int			i,
 				victim = 0;
@@ -200,25 +310,17 @@ get_buffer(OBuffersDesc *desc, uint32 tag, int64 blockNum, bool write)
 	int64		prevBlockNum;
 	uint32		prevTag;
 
-	/* First check if required buffer is already loaded */
-	LWLockAcquire(&group->groupCtlLock, LW_SHARED);
-	for (i = 0; i < O_BUFFERS_PER_GROUP; i++)
-	{
-		buffer = &group->buffers[i];
-		if (buffer->blockNum == blockNum &&
-			buffer->tag == tag)
-		{
-			LWLockAcquire(&buffer->bufferCtlLock, write ? LW_EXCLUSIVE : LW_SHARED);
-			buffer->usageCount++;
-			LWLockRelease(&group->groupCtlLock);
+	*found = false;
 
-			return buffer;
-		}
+	if (nowait)
+	{
+		if (!LWLockConditionalAcquire(&group->groupCtlLock, LW_EXCLUSIVE))
+			return NULL;
+	}
+	else
+	{
+		LWLockAcquire(&group->groupCtlLock, LW_EXCLUSIVE);
 	}
-	LWLockRelease(&group->groupCtlLock);
-
-	/* No luck: have to evict some buffer */
-	LWLockAcquire(&group->groupCtlLock, LW_EXCLUSIVE);
 
 	/* Search for victim buffer */
 	for (i = 0; i < O_BUFFERS_PER_GROUP; i++)
@@ -229,6 +331,12 @@ get_buffer(OBuffersDesc *desc, uint32 tag, int64 blockNum, bool write)
 		if (buffer->blockNum == blockNum &&
 			buffer->tag == tag)
 		{
+			*found = true;
+			if (nowait)
+			{
+				LWLockRelease(&group->groupCtlLock);
+				return NULL;
+			}
 			LWLockAcquire(&buffer->bufferCtlLock, write ? LW_EXCLUSIVE : LW_SHARED);
 			buffer->usageCount++;
 			LWLockRelease(&group->groupCtlLock);
@@ -243,6 +351,11 @@ get_buffer(OBuffersDesc *desc, uint32 tag, int64 blockNum, bool write)
 			 * There is an in-progress operation with required tag.  We must
 			 * wait till it's completed.
 			 */
+			if (nowait)
+			{
+				LWLockRelease(&group->groupCtlLock);
+				return NULL;
+			}
 			if (LWLockAcquireOrWait(&buffer->bufferCtlLock, LW_SHARED))
 				LWLockRelease(&buffer->bufferCtlLock);
 		}
@@ -255,7 +368,18 @@ get_buffer(OBuffersDesc *desc, uint32 tag, int64 blockNum, bool write)
 		buffer->usageCount /= 2;
 	}
 	buffer = &group->buffers[victim];
-	LWLockAcquire(&buffer->bufferCtlLock, LW_EXCLUSIVE);
+	if (nowait)
+	{
+		if (!LWLockConditionalAcquire(&buffer->bufferCtlLock, LW_EXCLUSIVE))
+		{
+			LWLockRelease(&group->groupCtlLock);
+			return NULL;
+		}
+	}
+	else
+	{
+		LWLockAcquire(&buffer->bufferCtlLock, LW_EXCLUSIVE);
+	}
 
 	prevDirty = buffer->dirty;
 	prevBlockNum = buffer->blockNum;
@@ -263,8 +387,7 @@ get_buffer(OBuffersDesc *desc, uint32 tag, int64 blockNum, bool write)
 
 	buffer->usageCount = 1;
 	buffer->dirty = false;
-	buffer->blockNum = blockNum;
-	buffer->tag = tag;
+	set_buffer_block(buffer, tag, blockNum);
 	buffer->shadowBlockNum = prevBlockNum;
 	buffer->shadowTag = prevTag;
 
@@ -273,11 +396,51 @@ get_buffer(OBuffersDesc *desc, uint32 tag, int64 blockNum, bool write)
 	if (prevDirty)
 		write_buffer_data(desc, buffer->data, prevTag, prevBlockNum);
 
-	read_buffer(desc, buffer);
+	return buffer;
+}
 
-	buffer->shadowBlockNum = -1;
+/*
+ * Returns the locked buffer of the given block.  While reading a range of
+ * blocks, the following blocks missing in the buffers are loaded together
+ * with the requested one.  Their buffers are returned in buffers[1..], and
+ * the number of the returned buffers is the result.
+ */
+static int
+get_buffers(OBuffersDesc *desc, uint32 tag, int64 blockNum,
+			int64 lastBlockNum, bool write, OBuffer **buffers)
+{
+	uint64		blocksPerFile = desc->singleFileSize / ORIOLEDB_BLCKSZ;
+	bool		found;
+	int			nbuffers = 1;
+
+	buffers[0] = lookup_buffer(desc, tag, blockNum, write);
+	if (buffers[0])
+		return 1;
+
+	buffers[0] = evict_buffer(desc, tag, blockNum, write, false, &found);
+	if (found)
+		return 1;
+
+	/*
+	 * Claim the buffers for the following blocks of the same file as long as
+	 * it doesn't need to wait: we already hold the buffer lock.
+	 */
+	while (!write &&
+		   nbuffers < O_BUFFERS_MAX_READ_BLOCKS &&
+		   blockNum + nbuffers <= lastBlockNum &&
+		   (blockNum + nbuffers) % blocksPerFile != 0)
+	{
+		OBuffer    *buffer = evict_buffer(desc, tag, blockNum + nbuffers,
+										  false, true, &found);
 
-	return buffer;
+		if (!buffer)
+			break;
+		buffers[nbuffers++] = buffer;
+	}
+
+	read_buffers(desc, buffers, nbuffers);
+
+	return nbuffers;
 }
 
 static void
@@ -287,47 +450,46 @@ o_buffers_rw(OBuffersDesc *desc, Pointer buf,
 {
 	int64		firstBlockNum = offset / ORIOLEDB_BLCKSZ,
 				lastBlockNum = (offset + size - 1) / ORIOLEDB_BLCKSZ,
-				blockNum;
+				blockNum = firstBlockNum;
 	Pointer		ptr = buf;
 
-	for (blockNum = firstBlockNum; blockNum <= lastBlockNum; blockNum++)
+	while (blockNum <= lastBlockNum)
 	{
-		OBuffer    *buffer = get_buffer(desc, tag, blockNum, write);
-		uint32		copySize,
-					copyOffset;
+		OBuffer    *buffers[O_BUFFERS_MAX_READ_BLOCKS];
+		int			nbuffers,
+					i;
 
-		if (firstBlockNum == lastBlockNum)
-		{
-			copySize = size;
-			copyOffset = offset % ORIOLEDB_BLCKSZ;
-		}
-		else if (blockNum == firstBlockNum)
-		{
-			copySize = ORIOLEDB_BLCKSZ - offset % ORIOLEDB_BLCKSZ;
-			copyOffset = offset % ORIOLEDB_BLCKSZ;
-		}
-		else if (blockNum == lastBlockNum)
-		{
-			copySize = (offset + size - 1) % ORIOLEDB_BLCKSZ + 1;
-			copyOffset = 0;
-		}
-		else
-		{
-			copySize = ORIOLEDB_BLCKSZ;
-			copyOffset = 0;
-		}
+		nbuffers = get_buffers(desc, tag, blockNum, lastBlockNum, write,
+							   buffers);
 
-		if (write)
-		{
-			memcpy(&buffer->data[copyOffset], ptr, copySize);
-			buffer->dirty = true;
-		}
-		else
+		for (i = 0; i < nbuffers; i++, blockNum++)
 		{
-			memcpy(ptr, &buffer->data[copyOffset], copySize);
+			OBuffer    *buffer = buffers[i];
+			uint32		copySize,
+						copyOffset;
+
+			if (blockNum == firstBlockNum)
+				copyOffset = offset % ORIOLEDB_BLCKSZ;
+			else
+				copyOffset = 0;
+
+			if (blockNum == lastBlockNum)
+				copySize = (offset + size - 1) % ORIOLEDB_BLCKSZ + 1 - copyOffset;
+			else
+				copySize = ORIOLEDB_BLCKSZ - copyOffset;
+
+			if (write)
+			{
+				memcpy(&buffer->data[copyOffset], ptr, copySize);
+				buffer->dirty = true;
+			}
+			else
+			{
+				memcpy(ptr, &buffer->data[copyOffset], copySize);
+			}
+			ptr += copySize;
+			LWLockRelease(&buffer->bufferCtlLock);
 		}
-		ptr += copySize;
-		LWLockRelease(&buffer->bufferCtlLock);
 	}
 }
 
@@ -399,9 +561,8 @@ o_buffers_wipe(OBuffersDesc *desc,
 				buffer->blockNum >= firstBufferNumber &&
 				buffer->blockNum <= lastBufferNumber)
 			{
-				buffer->blockNum = -1;
+				set_buffer_block(buffer, 0, -1);
 				buffer->dirty = false;
-				buffer->tag = 0;
 			}
 			LWLockRelease(&buffer->bufferCtlLock);
 		}
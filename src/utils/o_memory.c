@@ -0,0 +1,319 @@
+/*-------------------------------------------------------------------------
+ *
+ * o_memory.c
+ *		Accounting of OrioleDB backend-local memory.
+ *
+ * The long-living memory contexts of the OrioleDB subsystems (descriptors,
+ * sys caches, B-tree inserts, checkpoint) are children of the "OrioleDB"
+ * context.  Every backend publishes in the shared memory the memory
+ * allocated by these contexts at the end of the transactions, at most once
+ * per second, so the totals of all the backends are visible via the
+ * pg_stat_orioledb_backend_memory view.  The pg_stat_orioledb_memory_contexts
+ * view shows the OrioleDB memory contexts of the current backend including
+ * the short-living ones, such as the scan and sort contexts.
+ *
+ * When orioledb.backend_memory_soft_limit is set, a backend exceeding it at
+ * the end of the transaction sheds its caches: the unreferenced descriptors
+ * and the sys cache entries.  The freed memory is reused for the following
+ * allocations, so the limit bounds the growth of the caches.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/o_memory.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "catalog/o_sys_cache.h"
+#include "tableam/handler.h"
+#include "utils/o_memory.h"
+
+#include "access/xact.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/memnodes.h"
+#include "storage/proc.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+/* minimal interval between the publications of the counters */
+#define O_MEMORY_REPORT_INTERVAL	1000
+
+typedef struct
+{
+	/* the backend, which published the counters */
+	pg_atomic_uint32 pid;
+	pg_atomic_uint64 total;
+	pg_atomic_uint64 subsystems[O_MEMORY_SUBSYSTEMS_NUM];
+	pg_atomic_uint64 cacheSheds;
+} OMemoryProcStats;
+
+MemoryContext OrioleDBTopMemoryContext = NULL;
+
+static MemoryContext subsystemContexts[O_MEMORY_SUBSYSTEMS_NUM];
+static OMemoryProcStats *memoryProcStats = NULL;
+static TimestampTz lastReportTime = 0;
+static uint64 cacheSheds = 0;
+
+PG_FUNCTION_INFO_V1(orioledb_backend_memory);
+PG_FUNCTION_INFO_V1(orioledb_memory_contexts);
+
+void
+o_memory_init(void)
+{
+	OrioleDBTopMemoryContext = AllocSetContextCreate(TopMemoryContext,
+													 "OrioleDB",
+													 ALLOCSET_DEFAULT_SIZES);
+}
+
+/*
+ * Registers the long-living memory context of the subsystem.  The context
+ * should be a child of OrioleDBTopMemoryContext.
+ */
+void
+o_memory_register(OMemorySubsystem subsystem, MemoryContext context)
+{
+	Assert(context->parent == OrioleDBTopMemoryContext);
+	subsystemContexts[subsystem] = context;
+}
+
+Size
+o_memory_shmem_needs(void)
+{
+	return mul_size(max_procs, sizeof(OMemoryProcStats));
+}
+
+void
+o_memory_shmem_init(Pointer ptr, bool found)
+{
+	memoryProcStats = (OMemoryProcStats *) ptr;
+
+	if (!found)
+	{
+		int			i,
+					j;
+
+		for (i = 0; i < max_procs; i++)
+		{
+			OMemoryProcStats *stats = &memoryProcStats[i];
+
+			pg_atomic_init_u32(&stats->pid, 0);
+			pg_atomic_init_u64(&stats->total, 0);
+			for (j = 0; j < O_MEMORY_SUBSYSTEMS_NUM; j++)
+				pg_atomic_init_u64(&stats->subsystems[j], 0);
+			pg_atomic_init_u64(&stats->cacheSheds, 0);
+		}
+	}
+}
+
+/*
+ * Publishes the memory allocated by the OrioleDB contexts of the backend.
+ */
+void
+o_memory_report(void)
+{
+	OMemoryProcStats *stats;
+	int			i;
+
+	if (memoryProcStats == NULL || MyProc == NULL)
+		return;
+
+	stats = &memoryProcStats[MYPROCNUMBER];
+	pg_atomic_write_u64(&stats->total,
+						MemoryContextMemAllocated(OrioleDBTopMemoryContext,
+												  true));
+	for (i = 0; i < O_MEMORY_SUBSYSTEMS_NUM; i++)
+	{
+		Size		size = 0;
+
+		if (subsystemContexts[i])
+			size = MemoryContextMemAllocated(subsystemContexts[i], true);
+		pg_atomic_write_u64(&stats->subsystems[i], size);
+	}
+	pg_atomic_write_u64(&stats->cacheSheds, cacheSheds);
+	pg_atomic_write_u32(&stats->pid, MyProcPid);
+	lastReportTime = GetCurrentTimestamp();
+}
+
+static void
+o_memory_context_counters(MemoryContext context,
+						  MemoryContextCounters *counters)
+{
+	MemoryContext child;
+
+	context->methods->stats(context, NULL, NULL, counters, false);
+	for (child = context->firstchild; child != NULL; child = child->nextchild)
+		o_memory_context_counters(child, counters);
+}
+
+/*
+ * Checks the soft limit and reports the memory usage.  Called at the end of
+ * every transaction.
+ */
+void
+o_memory_xact_end(void)
+{
+	bool		shed = false;
+
+	if (backend_memory_soft_limit > 0 && MyBackendType == B_BACKEND &&
+		MemoryContextMemAllocated(OrioleDBTopMemoryContext, true) >
+		(Size) backend_memory_soft_limit * 1024)
+	{
+		MemoryContextCounters counters;
+
+		/* Freed chunks are reused, so only count the used space */
+		memset(&counters, 0, sizeof(counters));
+		o_memory_context_counters(OrioleDBTopMemoryContext, &counters);
+		if (counters.totalspace - counters.freespace >
+			(Size) backend_memory_soft_limit * 1024)
+		{
+			elog(DEBUG1, "orioledb backend memory %zu bytes exceeds the soft limit, shedding caches",
+				 counters.totalspace - counters.freespace);
+			o_shed_descrs();
+			o_sys_caches_reset();
+			cacheSheds++;
+			shed = true;
+		}
+	}
+
+	if (shed ||
+		TimestampDifferenceExceeds(lastReportTime,
+								   GetCurrentTransactionStopTimestamp(),
+								   O_MEMORY_REPORT_INTERVAL))
+		o_memory_report();
+}
+
+/*
+ * Reports the memory usage of the backends, which have published it.
+ */
+Datum
+orioledb_backend_memory(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			i,
+				j;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	/* Report our own usage as of now */
+	o_memory_report();
+
+	for (i = 0; i < max_procs; i++)
+	{
+		OMemoryProcStats *stats = &memoryProcStats[i];
+		Datum		values[3 + O_MEMORY_SUBSYSTEMS_NUM];
+		bool		nulls[3 + O_MEMORY_SUBSYSTEMS_NUM] = {false};
+		int32		pid = (int32) pg_atomic_read_u32(&stats->pid);
+
+		/* Skip the slots left by the exited backends */
+		if (pid == 0 || GetPGProcByNumber(i)->pid != pid)
+			continue;
+
+		values[0] = Int32GetDatum(pid);
+		values[1] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->total));
+		for (j = 0; j < O_MEMORY_SUBSYSTEMS_NUM; j++)
+			values[2 + j] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->subsystems[j]));
+		values[2 + O_MEMORY_SUBSYSTEMS_NUM] = Int64GetDatum((int64) pg_atomic_read_u64(&stats->cacheSheds));
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return (Datum) 0;
+}
+
+static void
+memory_contexts_walk(Tuplestorestate *tupstore, TupleDesc tupdesc,
+					 MemoryContext context, int level, bool orioledb)
+{
+	MemoryContext child;
+
+	CHECK_FOR_INTERRUPTS();
+
+	if (!orioledb && context->name &&
+		pg_strncasecmp(context->name, "orioledb", strlen("orioledb")) == 0)
+		orioledb = true;
+
+	if (orioledb)
+	{
+		MemoryContextCounters counters;
+		Datum		values[8];
+		bool		nulls[8] = {false};
+
+		memset(&counters, 0, sizeof(counters));
+		context->methods->stats(context, NULL, NULL, &counters, false);
+
+		values[0] = CStringGetTextDatum(context->name);
+		if (context->ident)
+			values[1] = CStringGetTextDatum(pnstrdup(context->ident,
+													 Min(strlen(context->ident),
+														 1023)));
+		else
+			nulls[1] = true;
+		if (context->parent)
+			values[2] = CStringGetTextDatum(context->parent->name);
+		else
+			nulls[2] = true;
+		values[3] = Int32GetDatum(level);
+		values[4] = Int64GetDatum((int64) counters.totalspace);
+		values[5] = Int64GetDatum((int64) counters.nblocks);
+		values[6] = Int64GetDatum((int64) counters.freespace);
+		values[7] = Int64GetDatum((int64) (counters.totalspace - counters.freespace));
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	for (child = context->firstchild; child != NULL; child = child->nextchild)
+		memory_contexts_walk(tupstore, tupdesc, child, level + 1, orioledb);
+}
+
+/*
+ * Reports the OrioleDB memory contexts of the current backend and their
+ * children.  The contexts are recognized by the "orioledb" name prefix.
+ */
+Datum
+orioledb_memory_contexts(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	memory_contexts_walk(tupstore, tupdesc, TopMemoryContext, 1, false);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return (Datum) 0;
+}
@@ -0,0 +1,219 @@
+/*-------------------------------------------------------------------------
+ *
+ * op_sampling.c
+ *		Sampling profiler of OrioleDB operations.
+ *
+ * Every process publishes in the shared memory the OrioleDB operation it
+ * currently performs (descent, page lock wait, undo reservation, page I/O,
+ * compression, tuple visibility check) together with the tree of the
+ * operation.  The publication is a couple of stores to the process-local
+ * slot, so it's cheap enough to stay enabled on the production systems.
+ *
+ * The op sampler worker reads the slots of all the processes every
+ * orioledb.op_sampling_period milliseconds and puts the busy ones to the
+ * shared ring buffer of orioledb.op_sampling_history_size samples, where
+ * the new samples overwrite the oldest ones.  The samples are exposed by the
+ * pg_stat_orioledb_op_samples view, pg_stat_orioledb_op_profile aggregates
+ * them by the tree and the operation.  That is similar to pg_wait_sampling,
+ * but at the granularity of the OrioleDB operations.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/op_sampling.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "utils/op_sampling.h"
+
+#include "funcapi.h"
+#include "storage/lwlock.h"
+#include "utils/builtins.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+typedef struct
+{
+	TimestampTz time;
+	int32		pid;
+	uint32		op;
+	ORelOids	oids;
+} OpSample;
+
+typedef struct
+{
+	LWLock		lock;
+	int			lockTrancheId;
+	uint64		nsamples;
+	/* total number of the samples collected so far */
+	uint64		next;
+} OpSamplingMeta;
+
+OpSamplingProcState *opSamplingProcs = NULL;
+
+static OpSamplingMeta *opSamplingMeta = NULL;
+static OpSample *opSamples = NULL;
+
+static const char *opSamplingOpNames[OP_SAMPLING_OPS_NUM] = {
+	"none",
+	"descent",
+	"page_lock",
+	"undo_reserve",
+	"io_read",
+	"io_write",
+	"compress",
+	"decompress",
+	"visibility"
+};
+
+PG_FUNCTION_INFO_V1(orioledb_op_samples);
+
+Size
+op_sampling_shmem_needs(void)
+{
+	Size		size;
+
+	if (op_sampling_history_size <= 0)
+		return 0;
+
+	size = CACHELINEALIGN(sizeof(OpSamplingMeta));
+	size = add_size(size, CACHELINEALIGN(mul_size(max_procs,
+												  sizeof(OpSamplingProcState))));
+	size = add_size(size, mul_size(op_sampling_history_size,
+								   sizeof(OpSample)));
+	return size;
+}
+
+void
+op_sampling_shmem_init(Pointer ptr, bool found)
+{
+	if (op_sampling_history_size <= 0)
+		return;
+
+	opSamplingMeta = (OpSamplingMeta *) ptr;
+	ptr += CACHELINEALIGN(sizeof(OpSamplingMeta));
+	opSamplingProcs = (OpSamplingProcState *) ptr;
+	ptr += CACHELINEALIGN(mul_size(max_procs, sizeof(OpSamplingProcState)));
+	opSamples = (OpSample *) ptr;
+
+	if (!found)
+	{
+		opSamplingMeta->lockTrancheId = LWLockNewTrancheId();
+		LWLockInitialize(&opSamplingMeta->lock,
+						 opSamplingMeta->lockTrancheId);
+		opSamplingMeta->nsamples = op_sampling_history_size;
+		opSamplingMeta->next = 0;
+		memset(opSamplingProcs, 0, mul_size(max_procs,
+											sizeof(OpSamplingProcState)));
+	}
+	LWLockRegisterTranche(opSamplingMeta->lockTrancheId,
+						  "OpSamplingTranche");
+}
+
+/*
+ * Takes a sample of every process busy with an OrioleDB operation.  Called
+ * by the op sampler worker.
+ */
+void
+op_sampling_collect(void)
+{
+	TimestampTz now;
+	int			i;
+
+	if (opSamplingMeta == NULL)
+		return;
+
+	now = GetCurrentTimestamp();
+
+	LWLockAcquire(&opSamplingMeta->lock, LW_EXCLUSIVE);
+	for (i = 0; i < max_procs; i++)
+	{
+		volatile OpSamplingProcState *state = &opSamplingProcs[i];
+		OpSample   *sample;
+		uint32		op = state->op;
+		int			pid;
+
+		if (op == OpSamplingNone || op >= OP_SAMPLING_OPS_NUM)
+			continue;
+
+		pid = GetPGProcByNumber(i)->pid;
+		if (pid == 0)
+			continue;
+
+		sample = &opSamples[opSamplingMeta->next % opSamplingMeta->nsamples];
+		sample->time = now;
+		sample->pid = pid;
+		sample->op = op;
+		sample->oids = state->oids;
+		opSamplingMeta->next++;
+	}
+	LWLockRelease(&opSamplingMeta->lock);
+}
+
+/*
+ * Reports the samples in the ring buffer from the oldest to the newest.
+ */
+Datum
+orioledb_op_samples(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	uint64		i,
+				first;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	if (opSamplingMeta == NULL)
+	{
+		MemoryContextSwitchTo(oldcontext);
+		return (Datum) 0;
+	}
+
+	LWLockAcquire(&opSamplingMeta->lock, LW_SHARED);
+	if (opSamplingMeta->next > opSamplingMeta->nsamples)
+		first = opSamplingMeta->next - opSamplingMeta->nsamples;
+	else
+		first = 0;
+
+	for (i = first; i < opSamplingMeta->next; i++)
+	{
+		OpSample   *sample = &opSamples[i % opSamplingMeta->nsamples];
+		Datum		values[6];
+		bool		nulls[6] = {false, false, false, false, false, false};
+
+		values[0] = TimestampTzGetDatum(sample->time);
+		values[1] = Int32GetDatum(sample->pid);
+		values[2] = CStringGetTextDatum(opSamplingOpNames[sample->op]);
+		values[3] = ObjectIdGetDatum(sample->oids.datoid);
+		values[4] = ObjectIdGetDatum(sample->oids.reloid);
+		values[5] = ObjectIdGetDatum(sample->oids.relnode);
+		if (!OidIsValid(sample->oids.datoid))
+			nulls[3] = nulls[4] = nulls[5] = true;
+		else if (!OidIsValid(sample->oids.reloid))
+			nulls[4] = true;
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	LWLockRelease(&opSamplingMeta->lock);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return (Datum) 0;
+}
@@ -18,13 +18,116 @@
 #include "btree/io.h"
 #include "btree/page_contents.h"
 #include "btree/undo.h"
+#include "catalog/sys_trees.h"
 #include "checkpoint/checkpoint.h"
 #include "transam/undo.h"
 #include "utils/page_pool.h"
 #include "utils/ucm.h"
+#include "workers/bgwriter.h"
 
+#include "common/hashfn.h"
+#include "miscadmin.h"
+#include "portability/instr_time.h"
 #include "utils/memdebug.h"
 
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+#define USE_PPOOL_NUMA
+#endif
+#endif
+
+#ifdef USE_PPOOL_NUMA
+/* from linux/mempolicy.h, which isn't always installed */
+#ifndef MPOL_BIND
+#define MPOL_BIND		2
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE	(1 << 1)
+#endif
+#define PPOOL_NODEMASK_BITS (sizeof(unsigned long) * BITS_PER_BYTE)
+#endif
+
+/* pages retired and clock runs made per pass of ppool_resize() */
+#define PPOOL_RESIZE_BATCH			64
+/* passes of ppool_resize() without progress before giving up */
+#define PPOOL_RESIZE_MAX_IDLE_PASSES	100
+/* ppool_balance_pools() moves 1/PPOOL_BALANCE_STEPS of the pool base size */
+#define PPOOL_BALANCE_STEPS			16
+
+static void ppool_page_decommit(OInMemoryBlkno blkno);
+
+/*
+ * Returns the first page of the pool part belonging to the given NUMA node.
+ * node == page_pool_numa_nodes gives the end of the pool.
+ */
+static OInMemoryBlkno
+ppool_numa_node_start(OPagePool *pool, int node)
+{
+	return pool->offset +
+		(OInMemoryBlkno) (((uint64) pool->size * node) / page_pool_numa_nodes);
+}
+
+/*
+ * Binds parts of the pool memory to the NUMA nodes.  Must be called before
+ * the pages are touched for the first time.  Failure isn't critical: the
+ * memory just stays where the kernel places it.
+ */
+static void
+ppool_bind_numa_nodes(OPagePool *pool)
+{
+#ifdef USE_PPOOL_NUMA
+	uintptr_t	pageSize = (uintptr_t) sysconf(_SC_PAGESIZE);
+	int			node;
+
+	for (node = 0; node < page_pool_numa_nodes; node++)
+	{
+		unsigned long nodemask[(PPOOL_MAX_NUMA_NODES + PPOOL_NODEMASK_BITS - 1) / PPOOL_NODEMASK_BITS];
+		uintptr_t	start,
+					end;
+
+		start = (uintptr_t) O_GET_IN_MEMORY_PAGE(ppool_numa_node_start(pool, node));
+		end = (uintptr_t) O_GET_IN_MEMORY_PAGE(ppool_numa_node_start(pool, node + 1));
+		start = TYPEALIGN(pageSize, start);
+		end = TYPEALIGN_DOWN(pageSize, end);
+		if (end <= start)
+			continue;
+
+		memset(nodemask, 0, sizeof(nodemask));
+		nodemask[node / PPOOL_NODEMASK_BITS] |= 1UL << (node % PPOOL_NODEMASK_BITS);
+
+		if (syscall(SYS_mbind, (void *) start, (unsigned long) (end - start),
+					MPOL_BIND, nodemask,
+					(unsigned long) (sizeof(nodemask) * BITS_PER_BYTE),
+					MPOL_MF_MOVE) != 0)
+		{
+			elog(LOG, "could not bind page pool memory to NUMA node %d: %m",
+				 node);
+			return;
+		}
+	}
+#endif
+}
+
+/*
+ * Returns NUMA node the current process runs on.  Falls back to spreading
+ * backends between the pool parts if the node can't be determined.
+ */
+static int
+ppool_current_numa_node(void)
+{
+#ifdef USE_PPOOL_NUMA
+	unsigned int cpu,
+				node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+		return (int) (node % page_pool_numa_nodes);
+#endif
+	return (MyBackendId > 0 ? MyBackendId : 0) % page_pool_numa_nodes;
+}
+
 /*
  * Calculates shared memory space needed for a page pool. Be careful,
  * it prepares local memory structures to initialize.
@@ -42,6 +145,9 @@ ppool_estimate_space(OPagePool *pool, OInMemoryBlkno offset, OInMemoryBlkno size
 
 	result += CACHELINEALIGN(sizeof(pg_atomic_uint64));
 	result += CACHELINEALIGN(sizeof(pg_atomic_uint32));
+	result += CACHELINEALIGN(sizeof(OPagePoolStats));
+	result += CACHELINEALIGN(sizeof(OPagePoolOwners));
+	result += CACHELINEALIGN(sizeof(OPagePoolResize));
 
 	pool->ucmShmemSize = estimate_ucm_space(&pool->ucm, offset, size);
 
@@ -62,18 +168,135 @@ ppool_shmem_init(OPagePool *pool, Pointer ptr, bool found)
 	pool->dirtyPagesCount = (pg_atomic_uint32 *) ptr;
 	ptr += CACHELINEALIGN(sizeof(pg_atomic_uint32));
 
+	pool->stats = (OPagePoolStats *) ptr;
+	ptr += CACHELINEALIGN(sizeof(OPagePoolStats));
+
+	pool->owners = (OPagePoolOwners *) ptr;
+	ptr += CACHELINEALIGN(sizeof(OPagePoolOwners));
+
+	pool->resize = (OPagePoolResize *) ptr;
+	ptr += CACHELINEALIGN(sizeof(OPagePoolResize));
+
 	if (!found)
 	{
+		int			i;
+
 		pg_atomic_init_u64(pool->availablePagesCount, pool->size);
 		pg_atomic_init_u32(pool->dirtyPagesCount, 0);
+		pg_atomic_init_u64(&pool->stats->stalls, 0);
+		pg_atomic_init_u64(&pool->stats->stallTime, 0);
+		pg_atomic_init_u64(&pool->stats->bgwriterEvictions, 0);
+		pg_atomic_init_u64(&pool->stats->bgwriterWakeups, 0);
+		pg_atomic_init_u64(&pool->stats->backendClockRuns, 0);
+		pg_atomic_init_u64(&pool->stats->clockSteps, 0);
+		for (i = 0; i < PPOOL_REJECT_REASONS_NUM; i++)
+			pg_atomic_init_u64(&pool->stats->rejected[i], 0);
+		pg_atomic_init_u64(&pool->stats->evictedClean, 0);
+		pg_atomic_init_u64(&pool->stats->evictedDirty, 0);
+		pg_atomic_init_u32(&pool->owners->overQuotaCount, 0);
+		for (i = 0; i < PPOOL_QUOTA_DATABASE_BUCKETS; i++)
+			pg_atomic_init_u32(&pool->owners->databasePages[i], 0);
+		for (i = 0; i < PPOOL_QUOTA_TREE_BUCKETS; i++)
+			pg_atomic_init_u32(&pool->owners->treePages[i], 0);
+		pool->resize->lockTrancheId = LWLockNewTrancheId();
+		LWLockInitialize(&pool->resize->lock, pool->resize->lockTrancheId);
+		pg_atomic_init_u64(&pool->resize->size, pool->size);
+		pg_atomic_init_u64(&pool->resize->retiredPages, 0);
+		pool->resize->baseSize = pool->size;
+		pool->resize->minSize = 0;
+		if (page_pool_numa_nodes > 1)
+			ppool_bind_numa_nodes(pool);
 	}
 
+	LWLockRegisterTranche(pool->resize->lockTrancheId, "PagePoolResizeTranche");
+
 	init_ucm(&pool->ucm, ptr, found);
 
 	pg_prng_seed(&pool->prngSeed, MyBackendId);
 	pool->location = pg_prng_uint64_range(&pool->prngSeed,
 										  pool->offset,
 										  pool->offset + pool->size - 1);
+	pool->allocLocation = OInvalidInMemoryBlkno;
+
+	/* All the magazines together never hold more than 1/16 of the pool */
+	pool->numPagesSpare = 0;
+	pool->magazineCount = 0;
+	pool->magazineSize = Min(PPOOL_MAGAZINE_SIZE,
+							 pool->size / (max_procs * PPOOL_MAGAZINE_SIZE));
+}
+
+/*
+ * Total count of pages reserved by our backend for all the kinds.
+ */
+static int64
+ppool_num_reserved(OPagePool *pool)
+{
+	int64		result = 0;
+	int			kind;
+
+	for (kind = 0; kind < PPOOL_RESERVE_COUNT; kind++)
+		result += pool->numPagesReserved[kind];
+	return result;
+}
+
+/*
+ * Occupies a free page starting the search from the part of the pool
+ * preferred by our backend.  Caller must have a page reserved.
+ */
+static OInMemoryBlkno
+ppool_occupy_free_page(OPagePool *pool)
+{
+	OInMemoryBlkno result;
+
+	/*
+	 * Determine the preferred part of the pool once per backend.  Search
+	 * starts from there, but free page might be found anywhere in the pool.
+	 */
+	if (!OInMemoryBlknoIsValid(pool->allocLocation))
+		pool->allocLocation = ppool_numa_node_start(pool,
+													ppool_current_numa_node());
+
+	result = ucm_occupy_free_page(&pool->ucm, pool->allocLocation);
+	Assert(pool->offset <= result && result < pool->offset + pool->size);
+
+	return result;
+}
+
+/*
+ * Occupies free pages in advance for the pages reserved by our backend, so
+ * ppool_get_page() doesn't search the UCM while the caller holds page locks.
+ * Every page in the magazine is backed by a reserved or spare page.
+ */
+static void
+ppool_fill_magazine(OPagePool *pool)
+{
+	int64		target;
+
+	target = Min(pool->magazineSize,
+				 ppool_num_reserved(pool) + pool->numPagesSpare);
+	while (pool->magazineCount < target)
+		pool->magazine[pool->magazineCount++] = ppool_occupy_free_page(pool);
+}
+
+/*
+ * Returns spare pages to the shared counter, so that our backend holds no
+ * more than keep pages.  Pages in the magazine are always kept.
+ */
+static void
+ppool_trim_spare(OPagePool *pool, int keep)
+{
+	int64		reserved = ppool_num_reserved(pool);
+	int64		spareKeep;
+
+	spareKeep = Max(keep, pool->magazineCount) - reserved;
+	spareKeep = Max(spareKeep, 0);
+
+	if (pool->numPagesSpare > spareKeep)
+	{
+		pg_atomic_add_fetch_u64(pool->availablePagesCount,
+								pool->numPagesSpare - spareKeep);
+		pool->numPagesSpare = spareKeep;
+	}
 }
 
 /*
@@ -88,11 +311,16 @@ ppool_shmem_init(OPagePool *pool, Pointer ptr, bool found)
  *
  * This is why one should reserve enough amount of pages _before_ taking a page
  * lock, and then allocate them using ucm_occupy_free_page().
+ *
+ * Normally, background writers keep the free pages count above the low
+ * watermark, and we only wake them up once it falls below.  Eviction is
+ * done here only when the pool is exhausted.
  */
 void
 ppool_reserve_pages(OPagePool *pool, int kind, int count)
 {
 	uint64		val;
+	int			spare;
 
 	Assert(!have_locked_pages());
 
@@ -100,14 +328,59 @@ ppool_reserve_pages(OPagePool *pool, int kind, int count)
 	if (count <= 0)
 		return;
 
-	val = pg_atomic_sub_fetch_u64(pool->availablePagesCount, count);
-	while (val & (UINT64CONST(1) << 63))
+	/* Use the pages reserved in advance first */
+	spare = Min(count, (int) pool->numPagesSpare);
+	pool->numPagesSpare -= spare;
+	pool->numPagesReserved[kind] += spare;
+	count -= spare;
+
+	if (count > 0)
 	{
-		ppool_run_clock(pool, true, NULL);
-		val = pg_atomic_read_u64(pool->availablePagesCount);
+		int			extra = pool->magazineSize;
+
+		/*
+		 * Reserve the spare pages for the next calls in the same atomic
+		 * operation.  Don't do this if there are not enough free pages.
+		 */
+		val = pg_atomic_sub_fetch_u64(pool->availablePagesCount,
+									  count + extra);
+		if (extra > 0 && (val & (UINT64CONST(1) << 63)))
+		{
+			val = pg_atomic_add_fetch_u64(pool->availablePagesCount, extra);
+			extra = 0;
+		}
+
+		if (val & (UINT64CONST(1) << 63))
+		{
+			instr_time	startTime,
+						duration;
+
+			if (bgwriter_wakeup())
+				pg_atomic_fetch_add_u64(&pool->stats->bgwriterWakeups, 1);
+
+			INSTR_TIME_SET_CURRENT(startTime);
+			while (val & (UINT64CONST(1) << 63))
+			{
+				ppool_run_clock(pool, true, NULL);
+				val = pg_atomic_read_u64(pool->availablePagesCount);
+			}
+			INSTR_TIME_SET_CURRENT(duration);
+			INSTR_TIME_SUBTRACT(duration, startTime);
+
+			pg_atomic_fetch_add_u64(&pool->stats->stalls, 1);
+			pg_atomic_fetch_add_u64(&pool->stats->stallTime,
+									INSTR_TIME_GET_MICROSEC(duration));
+		}
+		else if (val < ppool_free_pages_low_mark(pool) && bgwriter_wakeup())
+		{
+			pg_atomic_fetch_add_u64(&pool->stats->bgwriterWakeups, 1);
+		}
+
+		pool->numPagesReserved[kind] += count;
+		pool->numPagesSpare += extra;
 	}
 
-	pool->numPagesReserved[kind] += count;
+	ppool_fill_magazine(pool);
 }
 
 /*
@@ -128,12 +401,17 @@ ppool_release_reserved(OPagePool *pool, uint32 mask)
 			pool->numPagesReserved[kind] = 0;
 		}
 	}
-	if (sum != 0)
-		pg_atomic_add_fetch_u64(pool->availablePagesCount, sum);
+	if (sum == 0)
+		return;
+
+	/* Keep some released pages as spare for the next reservations */
+	pool->numPagesSpare += sum;
+	ppool_trim_spare(pool, pool->magazineSize);
 }
 
 /*
- * Release all reserved pages in all the pools.
+ * Release all reserved pages in all the pools.  Also empties magazines, so
+ * our backend holds no pages between transactions.
  */
 void
 ppool_release_all_pages(void)
@@ -145,6 +423,16 @@ ppool_release_all_pages(void)
 		OPagePool  *pool = get_ppool((OPagePoolType) i);
 
 		ppool_release_reserved(pool, PPOOL_RESERVE_MASK_ALL);
+
+		/*
+		 * Magazine pages were never used, so it's enough to mark them free
+		 * in the UCM before returning their reservations.
+		 */
+		while (pool->magazineCount > 0)
+			page_change_usage_count(&pool->ucm,
+									pool->magazine[--pool->magazineCount],
+									UCM_FREE_PAGES_LEVEL);
+		ppool_trim_spare(pool, 0);
 	}
 }
 
@@ -172,8 +460,10 @@ ppool_get_page(OPagePool *pool, int kind)
 	Assert(pool->numPagesReserved[kind] > 0);
 	pool->numPagesReserved[kind]--;
 
-	result = ucm_occupy_free_page(&pool->ucm);
-	Assert(pool->offset <= result && result < pool->offset + pool->size);
+	if (pool->magazineCount > 0)
+		result = pool->magazine[--pool->magazineCount];
+	else
+		result = ppool_occupy_free_page(pool);
 
 	VALGRIND_CHECK_MEM_IS_DEFINED(O_GET_IN_MEMORY_PAGE(result), ORIOLEDB_BLCKSZ);
 
@@ -188,6 +478,8 @@ ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock)
 {
 	Page		p = O_GET_IN_MEMORY_PAGE(blkno);
 	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+	ORelOids	invalidOids = {InvalidOid, InvalidOid, InvalidOid};
+	bool		retire;
 
 	Assert(pool->offset <= blkno && blkno < pool->offset + pool->size);
 
@@ -201,19 +493,499 @@ ppool_free_page(OPagePool *pool, OInMemoryBlkno blkno, bool haveLock)
 	if (!haveLock)
 		lock_page(blkno);
 	O_PAGE_CHANGE_COUNT_INC(p);
-	page_desc->oids.datoid = InvalidOid;
-	page_desc->oids.relnode = InvalidOid;
-	page_desc->oids.reloid = InvalidOid;
+	ppool_page_set_owner(pool, blkno, invalidOids);
 	page_desc->type = 0;
 	page_desc->fileExtent.off = InvalidFileExtentOff;
 	page_desc->fileExtent.len = InvalidFileExtentLen;
+
+	/*
+	 * The page past the pool size is retired instead.  It was never counted
+	 * as available since the shrink, so there is nothing to give back.  Do
+	 * this under the page lock, so ppool_resize() growing the pool sees
+	 * either the page in use or the retired page.
+	 */
+	retire = blkno >= pool->offset + ppool_size(pool);
+	if (retire)
+	{
+		page_desc->flags |= PAGE_DESC_FLAG_RETIRED;
+		page_change_usage_count(&pool->ucm, blkno, UCM_INVALID_LEVEL);
+		ppool_page_decommit(blkno);
+		pg_atomic_fetch_add_u64(&pool->resize->retiredPages, 1);
+	}
 	unlock_page(blkno);
 
+	if (retire)
+		return;
+
 	page_change_usage_count(&pool->ucm, blkno, UCM_FREE_PAGES_LEVEL);
 
 	pg_atomic_add_fetch_u64(pool->availablePagesCount, 1);
 }
 
+/*
+ * Returns the memory of the retired page contents to the OS.  The OS page
+ * holding the page header stays, so the processes still referencing the
+ * page see the valid header of a page that has changed.  The memory comes
+ * back zeroed on the first touch after the pool grows.
+ */
+static void
+ppool_page_decommit(OInMemoryBlkno blkno)
+{
+#if defined(__linux__) && defined(MADV_REMOVE)
+	static uintptr_t pageSize = 0;
+	static bool failed = false;
+	uintptr_t	start,
+				end;
+
+	if (failed)
+		return;
+	if (pageSize == 0)
+		pageSize = (uintptr_t) sysconf(_SC_PAGESIZE);
+
+	start = TYPEALIGN(pageSize, (uintptr_t) O_GET_IN_MEMORY_PAGE(blkno) + 1);
+	end = TYPEALIGN_DOWN(pageSize,
+						 (uintptr_t) O_GET_IN_MEMORY_PAGE(blkno) + ORIOLEDB_BLCKSZ);
+	if (end <= start)
+		return;
+
+	if (madvise((void *) start, end - start, MADV_REMOVE) != 0)
+	{
+		/* Huge pages can't be released partially, so just keep them */
+		failed = true;
+		elog(LOG, "could not release the memory of the retired page pool pages: %m");
+	}
+#endif
+}
+
+/*
+ * Retires the pages past the initial size of the pool, which is also its base
+ * size for ppool_balance_pools().  Called once at the shared memory
+ * initialization after the page headers are set up.  minSize is the size
+ * the pool can't be shrunk below.
+ */
+void
+ppool_init_size(OPagePool *pool, OInMemoryBlkno size, OInMemoryBlkno minSize)
+{
+	OInMemoryBlkno blkno;
+
+	Assert(minSize <= size && size <= pool->size);
+
+	pool->resize->baseSize = size;
+	pool->resize->minSize = minSize;
+
+	for (blkno = pool->offset + size; blkno < pool->offset + pool->size; blkno++)
+	{
+		page_change_usage_count(&pool->ucm, blkno, UCM_INVALID_LEVEL);
+		O_GET_IN_MEMORY_PAGEDESC(blkno)->flags |= PAGE_DESC_FLAG_RETIRED;
+	}
+	pg_atomic_write_u64(&pool->resize->size, size);
+	pg_atomic_write_u64(&pool->resize->retiredPages, pool->size - size);
+	pg_atomic_write_u64(pool->availablePagesCount, size);
+}
+
+/*
+ * Returns the number of the pages in use by the pool.  The rest of the pages
+ * reserved for the pool are retired or being retired.
+ */
+OInMemoryBlkno
+ppool_size(OPagePool *pool)
+{
+	return (OInMemoryBlkno) pg_atomic_read_u64(&pool->resize->size);
+}
+
+/*
+ * Returns the number of the pages past the pool size, which aren't retired
+ * yet.
+ */
+OInMemoryBlkno
+ppool_retire_pending(OPagePool *pool)
+{
+	uint64		outside = pool->size - ppool_size(pool),
+				retired = pg_atomic_read_u64(&pool->resize->retiredPages);
+
+	return outside > retired ? (OInMemoryBlkno) (outside - retired) : 0;
+}
+
+/*
+ * Retires up to maxPages free pages past the pool size.  A free page is
+ * counted as available, so we take a reservation for every page we retire.
+ * Caller must hold the resize lock.  Returns the number of retired pages.
+ */
+static int
+ppool_retire_free_pages_internal(OPagePool *pool, int maxPages)
+{
+	OInMemoryBlkno blkno,
+				end = pool->offset + pool->size;
+	int			count = 0;
+
+	maxPages = Min(maxPages, (int) Min(ppool_retire_pending(pool), INT_MAX));
+	if (maxPages <= 0)
+		return 0;
+
+	ppool_reserve_pages(pool, PPOOL_RESERVE_META, maxPages);
+
+	for (blkno = pool->offset + ppool_size(pool);
+		 blkno < end && count < maxPages;
+		 blkno++)
+	{
+		if (!ucm_try_occupy_page(&pool->ucm, blkno))
+			continue;
+
+		lock_page(blkno);
+		O_GET_IN_MEMORY_PAGEDESC(blkno)->flags |= PAGE_DESC_FLAG_RETIRED;
+		ppool_page_decommit(blkno);
+		pg_atomic_fetch_add_u64(&pool->resize->retiredPages, 1);
+		unlock_page(blkno);
+		count++;
+	}
+
+	/* The reservations are gone together with the retired pages */
+	pool->numPagesReserved[PPOOL_RESERVE_META] -= count;
+	ppool_release_all_pages();
+
+	return count;
+}
+
+/*
+ * Retires the free pages past the pool size, which were held by the backends
+ * at the time of the shrink.  Called by the background writers.  Doesn't
+ * take the free pages below the low watermark.
+ */
+void
+ppool_retire_free_pages(OPagePool *pool, int maxPages)
+{
+	OInMemoryBlkno freePages = ppool_free_pages_count(pool),
+				lowMark = ppool_free_pages_low_mark(pool);
+
+	if (ppool_retire_pending(pool) == 0 || freePages <= lowMark)
+		return;
+
+	if (!LWLockConditionalAcquire(&pool->resize->lock, LW_EXCLUSIVE))
+		return;
+	(void) ppool_retire_free_pages_internal(pool,
+											Min(maxPages,
+												(int) (freePages - lowMark)));
+	LWLockRelease(&pool->resize->lock);
+}
+
+/*
+ * Makes a pass over the pages past the pool size: retires the free ones and
+ * runs the clock up to maxClockRuns times over the ones in use, which are
+ * retired when freed.  *cursor keeps the clock position between the passes.
+ */
+void
+ppool_retire_pass(OPagePool *pool, int maxClockRuns, OInMemoryBlkno *cursor)
+{
+	OInMemoryBlkno start = pool->offset + ppool_size(pool);
+	int			i;
+
+	LWLockAcquire(&pool->resize->lock, LW_EXCLUSIVE);
+	(void) ppool_retire_free_pages_internal(pool, PPOOL_RESIZE_BATCH);
+	LWLockRelease(&pool->resize->lock);
+
+	if (start >= pool->offset + pool->size)
+		return;
+
+	for (i = 0; i < maxClockRuns && ppool_retire_pending(pool) > 0; i++)
+		ppool_run_clock_region(pool, true, NULL,
+							   start, pool->offset + pool->size,
+							   cursor);
+}
+
+/*
+ * Sets the number of the pages in use by the pool.  Growing the pool turns
+ * the retired pages into the free ones.  Caller must hold the resize lock.
+ */
+static void
+ppool_set_size(OPagePool *pool, OInMemoryBlkno size)
+{
+	OInMemoryBlkno oldSize,
+				blkno;
+
+	Assert(size <= pool->size);
+	Assert(LWLockHeldByMeInMode(&pool->resize->lock, LW_EXCLUSIVE));
+
+	oldSize = ppool_size(pool);
+	pg_atomic_write_u64(&pool->resize->size, size);
+	if (size > oldSize)
+	{
+		uint64		count = 0;
+
+		/*
+		 * The pages not retired yet are still in use, and they will be freed
+		 * as usual now.  The retired ones become free right away.
+		 */
+		for (blkno = pool->offset + oldSize; blkno < pool->offset + size; blkno++)
+		{
+			OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+
+			lock_page(blkno);
+			if (page_desc->flags & PAGE_DESC_FLAG_RETIRED)
+			{
+				page_desc->flags &= ~PAGE_DESC_FLAG_RETIRED;
+				page_change_usage_count(&pool->ucm, blkno, UCM_FREE_PAGES_LEVEL);
+				pg_atomic_fetch_sub_u64(&pool->resize->retiredPages, 1);
+				count++;
+			}
+			unlock_page(blkno);
+		}
+		pg_atomic_add_fetch_u64(pool->availablePagesCount, count);
+	}
+}
+
+/*
+ * Changes the number of the pages in use by the pool, which also becomes its
+ * base size for ppool_balance_pools().  The pages past the new size are
+ * retired: the free ones immediately, the others once they are evicted.  If
+ * wait is true, we run the clock over them for a while, so the most of them
+ * are retired on return.  Otherwise, the caller is expected to make
+ * ppool_retire_pass() calls later.  Returns the number of pages still waiting
+ * for the retirement.
+ */
+OInMemoryBlkno
+ppool_resize(OPagePool *pool, OInMemoryBlkno size, bool wait)
+{
+	OInMemoryBlkno cursor,
+				pending;
+	int			idlePasses = 0;
+
+	Assert(size <= pool->size);
+
+	LWLockAcquire(&pool->resize->lock, LW_EXCLUSIVE);
+	ppool_set_size(pool, size);
+	pool->resize->baseSize = size;
+	LWLockRelease(&pool->resize->lock);
+
+	if (!wait)
+		return ppool_retire_pending(pool);
+
+	cursor = pool->offset + size;
+	while ((pending = ppool_retire_pending(pool)) > 0 &&
+		   idlePasses < PPOOL_RESIZE_MAX_IDLE_PASSES)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		ppool_retire_pass(pool, PPOOL_RESIZE_BATCH, &cursor);
+
+		if (ppool_retire_pending(pool) < pending)
+			idlePasses = 0;
+		else
+			idlePasses++;
+	}
+
+	return pending;
+}
+
+/*
+ * Moves the pages between the main pool and the free tree and catalog pools
+ * according to their demand.  A secondary pool, where the backends had to
+ * run the clock since the last call, borrows a step of pages from the main
+ * pool.  A secondary pool, which stays over its high watermark even without
+ * a step of pages, lends them to the main pool.  The pools never get below
+ * their minimal sizes, so the page reservations of all the backends are
+ * still satisfied, and the main pool lends at most
+ * PPOOL_BALANCE_MAIN_LEND_PERCENT of its base size.  The main pool takes the
+ * pages back up to its base size only, so it doesn't outgrow the size set by
+ * orioledb_resize_main_buffers() meanwhile.
+ *
+ * The sizes are changed by read-modify-write under the resize locks, the
+ * main pool lock taken first, so a concurrent explicit resize of the main
+ * pool isn't overwritten.
+ *
+ * The pages given away become free in the receiving pool immediately, while
+ * the giving pool releases its pages in use once they are evicted.  So the
+ * total might exceed the configured one by a step for a while.  Called by
+ * the first background writer.
+ */
+void
+ppool_balance_pools(void)
+{
+	static uint64 prevClockRuns[OPagePoolTypesCount];
+	static OInMemoryBlkno cursors[OPagePoolTypesCount];
+	OPagePool  *mainPool = get_ppool(OPagePoolMain);
+	int			i;
+
+	for (i = 0; i < (int) OPagePoolTypesCount; i++)
+	{
+		OPagePool  *pool = get_ppool((OPagePoolType) i);
+		uint64		clockRuns = pg_atomic_read_u64(&pool->stats->backendClockRuns);
+		bool		demand = clockRuns > prevClockRuns[i];
+		OInMemoryBlkno size,
+					mainSize,
+					mainBase,
+					mainFloor,
+					step;
+
+		prevClockRuns[i] = clockRuns;
+		if (i == OPagePoolMain)
+			continue;
+
+		LWLockAcquire(&mainPool->resize->lock, LW_EXCLUSIVE);
+		LWLockAcquire(&pool->resize->lock, LW_EXCLUSIVE);
+
+		size = ppool_size(pool);
+		mainSize = ppool_size(mainPool);
+		mainBase = mainPool->resize->baseSize;
+		mainFloor = mainBase -
+			(OInMemoryBlkno) ((uint64) mainBase *
+							  PPOOL_BALANCE_MAIN_LEND_PERCENT / 100);
+		mainFloor = Max(mainFloor, mainPool->resize->minSize);
+		step = Max(pool->resize->baseSize / PPOOL_BALANCE_STEPS, 1);
+
+		if (demand)
+		{
+			step = Min(step, pool->size - size);
+			step = Min(step, mainSize > mainFloor ? mainSize - mainFloor : 0);
+			if (step > 0 && ppool_retire_pending(mainPool) == 0)
+			{
+				ppool_set_size(mainPool, mainSize - step);
+				ppool_set_size(pool, size + step);
+			}
+		}
+		else if (size >= pool->resize->minSize + step &&
+				 ppool_free_pages_count(pool) > ppool_free_pages_high_mark(pool) + step &&
+				 ppool_retire_pending(pool) == 0)
+		{
+			/* The pages over the main pool base size are just retired */
+			ppool_set_size(pool, size - step);
+			if (mainSize < mainBase)
+				ppool_set_size(mainPool, mainSize + Min(step, mainBase - mainSize));
+		}
+
+		LWLockRelease(&pool->resize->lock);
+		LWLockRelease(&mainPool->resize->lock);
+	}
+
+	for (i = 0; i < (int) OPagePoolTypesCount; i++)
+	{
+		OPagePool  *pool = get_ppool((OPagePoolType) i);
+
+		if (ppool_retire_pending(pool) > 0)
+			ppool_retire_pass(pool, PPOOL_RESIZE_BATCH, &cursors[i]);
+	}
+}
+
+static inline bool
+ppool_owner_is_tracked(ORelOids oids)
+{
+	return ORelOidsIsValid(oids) && !IS_SYS_TREE_OIDS(oids);
+}
+
+static inline OInMemoryBlkno
+ppool_database_quota(OPagePool *pool)
+{
+	return (OInMemoryBlkno) ((uint64) ppool_size(pool) * database_pool_quota / 100);
+}
+
+static inline OInMemoryBlkno
+ppool_tree_quota(OPagePool *pool)
+{
+	return (OInMemoryBlkno) ((uint64) ppool_size(pool) * table_pool_quota / 100);
+}
+
+static inline pg_atomic_uint32 *
+ppool_database_bucket(OPagePool *pool, ORelOids oids)
+{
+	return &pool->owners->databasePages[hash_uint32(oids.datoid) %
+										PPOOL_QUOTA_DATABASE_BUCKETS];
+}
+
+static inline pg_atomic_uint32 *
+ppool_tree_bucket(OPagePool *pool, ORelOids oids)
+{
+	uint32		hash = hash_combine(hash_uint32(oids.datoid),
+									hash_uint32(oids.relnode));
+
+	return &pool->owners->treePages[hash % PPOOL_QUOTA_TREE_BUCKETS];
+}
+
+/*
+ * Changes the owner bucket pages count by one, and tracks the buckets
+ * crossing their quota.  Quotas can't change at runtime, so each crossing
+ * is seen exactly once.
+ */
+static void
+ppool_owner_bucket_add(OPagePool *pool, pg_atomic_uint32 *bucket,
+					   OInMemoryBlkno quota, int32 delta)
+{
+	uint32		count = pg_atomic_add_fetch_u32(bucket, delta);
+
+	if (quota == 0)
+		return;
+
+	if (delta > 0 && count == quota + 1)
+		pg_atomic_fetch_add_u32(&pool->owners->overQuotaCount, 1);
+	else if (delta < 0 && count == quota)
+		pg_atomic_fetch_sub_u32(&pool->owners->overQuotaCount, 1);
+}
+
+static void
+ppool_owner_add(OPagePool *pool, ORelOids oids, int32 delta)
+{
+	if (!ppool_owner_is_tracked(oids))
+		return;
+
+	ppool_owner_bucket_add(pool, ppool_database_bucket(pool, oids),
+						   ppool_database_quota(pool), delta);
+	ppool_owner_bucket_add(pool, ppool_tree_bucket(pool, oids),
+						   ppool_tree_quota(pool), delta);
+}
+
+/*
+ * Assigns the page to the tree or releases it when oids are invalid.  Must
+ * be called under the page lock.
+ */
+void
+ppool_page_set_owner(OPagePool *pool, OInMemoryBlkno blkno, ORelOids oids)
+{
+	OrioleDBPageDesc *page_desc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+
+	if (ORelOidsIsEqual(page_desc->oids, oids))
+		return;
+
+	ppool_owner_add(pool, page_desc->oids, -1);
+	page_desc->oids = oids;
+	ppool_owner_add(pool, oids, 1);
+}
+
+/*
+ * Checks if the database or the tree occupies more pages of the pool than
+ * its quota.
+ */
+bool
+ppool_owner_over_quota(OPagePool *pool, ORelOids oids)
+{
+	OInMemoryBlkno quota;
+
+	if (pg_atomic_read_u32(&pool->owners->overQuotaCount) == 0 ||
+		!ppool_owner_is_tracked(oids))
+		return false;
+
+	quota = ppool_database_quota(pool);
+	if (quota > 0 &&
+		pg_atomic_read_u32(ppool_database_bucket(pool, oids)) > quota)
+		return true;
+
+	quota = ppool_tree_quota(pool);
+	if (quota > 0 &&
+		pg_atomic_read_u32(ppool_tree_bucket(pool, oids)) > quota)
+		return true;
+
+	return false;
+}
+
+/*
+ * Usage count for the page loaded into the pool.  Pages of the owners over
+ * quota start at the lowest level, so they are evicted first.
+ */
+uint32
+ppool_loaded_page_usage_count(OPagePool *pool, ORelOids oids)
+{
+	if (ppool_owner_over_quota(pool, oids))
+		return pg_atomic_read_u32(pool->ucm.epoch);
+	return ucm_loaded_page_usage_count(&pool->ucm);
+}
+
 /*
  * Return count of free pages in the pool.
  */
@@ -237,22 +1009,69 @@ ppool_dirty_pages_count(OPagePool *pool)
 	return pg_atomic_read_u32(pool->dirtyPagesCount);
 }
 
+/*
+ * Background writers start eviction when the free pages count falls below
+ * the low watermark and continue until it reaches the high watermark.
+ */
+OInMemoryBlkno
+ppool_free_pages_low_mark(OPagePool *pool)
+{
+	return (OInMemoryBlkno) ((uint64) ppool_size(pool) * free_pages_low_watermark / 100);
+}
+
+OInMemoryBlkno
+ppool_free_pages_high_mark(OPagePool *pool)
+{
+	int			percent = Max(free_pages_high_watermark, free_pages_low_watermark);
+
+	return (OInMemoryBlkno) ((uint64) ppool_size(pool) * percent / 100);
+}
+
 /*
  * Run clock replacement algorithm until we evict at least one page.
  */
 void
 ppool_run_clock(OPagePool *pool, bool evict,
 				volatile sig_atomic_t *shutdown_requested)
+{
+	OInMemoryBlkno cursor;
+
+	pg_atomic_fetch_add_u64(&pool->stats->backendClockRuns, 1);
+	cursor = pg_prng_uint64_range(&pool->prngSeed,
+								  pool->offset,
+								  pool->offset + pool->size - 1);
+	ppool_run_clock_region(pool, evict, shutdown_requested,
+						   pool->offset, pool->offset + pool->size,
+						   &cursor);
+}
+
+/*
+ * Run clock replacement algorithm over the [regionStart, regionEnd) part of
+ * the pool starting from *cursor, and advance *cursor.  If there are no
+ * candidates in the region, the page is taken from the rest of the pool:
+ * we have to evict something anyway.
+ */
+void
+ppool_run_clock_region(OPagePool *pool, bool evict,
+					   volatile sig_atomic_t *shutdown_requested,
+					   OInMemoryBlkno regionStart, OInMemoryBlkno regionEnd,
+					   OInMemoryBlkno *cursor)
 {
 	uint64		blkno;
+	bool		wrapped = false;
+	int			quotaSkips = 0;
+	int			dirtySkips = 0;
+	uint64		steps = 0;
 	Size		undoRegularSize = get_reserved_undo_size(UndoLogRegularPageLevel);
 	Size		undoSystemSize = get_reserved_undo_size(UndoLogSystem);
 	bool		haveRetainRegularLoc = undo_type_has_retained_location(UndoLogRegularPageLevel);
 	bool		haveRetainSystemLoc = undo_type_has_retained_location(UndoLogSystem);
 
-	blkno = pg_prng_uint64_range(&pool->prngSeed,
-								 pool->offset,
-								 pool->offset + pool->size - 1);
+	Assert(pool->offset <= regionStart && regionStart < regionEnd &&
+		   regionEnd <= pool->offset + pool->size);
+	blkno = *cursor;
+	if (blkno < regionStart || blkno >= regionEnd)
+		blkno = regionStart;
 
 	/*
 	 * Shouldn't be called while holding a page lock: one should reserve the
@@ -274,8 +1093,47 @@ ppool_run_clock(OPagePool *pool, bool evict,
 			break;
 
 		blkno = ucm_next_blkno(&pool->ucm, blkno, 1);
+		steps++;
 
 		Assert(blkno >= pool->offset && blkno < pool->offset + pool->size);
+		if ((blkno < regionStart || blkno >= regionEnd) && !wrapped)
+		{
+			/* Nothing till the region end, retry from its start */
+			wrapped = true;
+			blkno = regionStart;
+			continue;
+		}
+
+		/*
+		 * While some owners are over quota, give the candidates of the other
+		 * owners another chance: ucm_next_blkno() has already moved them to
+		 * the next usage level.
+		 */
+		if (evict && quotaSkips < PPOOL_QUOTA_MAX_SKIPS &&
+			pg_atomic_read_u32(&pool->owners->overQuotaCount) > 0 &&
+			!ppool_owner_over_quota(pool, O_GET_IN_MEMORY_PAGEDESC(blkno)->oids))
+		{
+			quotaSkips++;
+			blkno++;
+			if (blkno >= pool->offset + pool->size)
+				blkno = pool->offset;
+			continue;
+		}
+
+		/*
+		 * Prefer the clean candidates, which are evicted without a write.  The
+		 * dirty ones skipped get written by the background writer or the
+		 * checkpointer, and their further changes get into the same write.
+		 */
+		if (evict && dirtySkips < eviction_dirty_skips && IS_DIRTY(blkno))
+		{
+			dirtySkips++;
+			blkno++;
+			if (blkno >= pool->offset + pool->size)
+				blkno = pool->offset;
+			continue;
+		}
+
 		if (walk_page(blkno, evict) != OWalkPageSkipped)
 		{
 			Assert(!have_locked_pages());
@@ -289,6 +1147,11 @@ ppool_run_clock(OPagePool *pool, bool evict,
 
 	unset_skip_ucm();
 
+	pg_atomic_fetch_add_u64(&pool->stats->clockSteps, steps);
+
+	blkno++;
+	*cursor = (blkno >= regionEnd) ? regionStart : (OInMemoryBlkno) blkno;
+
 	/*
 	 * The caller might have the undo location reserved.  We need to carefully
 	 * put the undo location back.
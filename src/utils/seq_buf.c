@@ -56,6 +56,16 @@
 #define SEQBUF_FILE_OFFSET(shared, blkno) ((off_t) SEQBUF_CHUNK_SIZE * (blkno) \
 												+ (shared)->evictOffset)
 
+/*
+ * The pages are written to the kernel one by one, but the kernel is asked to
+ * start the writeback of the map files every SEQBUF_WRITEBACK_PAGES pages,
+ * so their final fsync doesn't have to wait for the whole file.  While
+ * reading, the kernel is asked to read ahead SEQBUF_PREFETCH_PAGES pages
+ * following the double buffer, so the page switches don't wait for the disk.
+ */
+#define SEQBUF_WRITEBACK_PAGES 32
+#define SEQBUF_PREFETCH_PAGES 32
+
 /*
  * this functions returns true if success
  */
@@ -270,6 +280,15 @@ seq_buf_finish_prev_page(SeqBufDescPrivate *seqBufPrivate)
 								   (uint32) offset)));
 			return false;
 		}
+
+		/* Temporary files are never synced, don't write them back early */
+		if (shared->tag.type == 'm' &&
+			shared->filePageNum % SEQBUF_WRITEBACK_PAGES == 0)
+			FileWriteback(seqBufPrivate->file,
+						  SEQBUF_FILE_OFFSET(shared, (off_t) shared->filePageNum -
+											 SEQBUF_WRITEBACK_PAGES),
+						  (off_t) SEQBUF_WRITEBACK_PAGES * SEQBUF_CHUNK_SIZE,
+						  WAIT_EVENT_DATA_FILE_FLUSH);
 	}
 	else
 	{
@@ -322,6 +341,15 @@ seq_buf_finish_prev_page(SeqBufDescPrivate *seqBufPrivate)
 			shared->freeBytesNum -= nbytes;
 			Assert(shared->freeBytesNum >= 0);
 			put_page_image(shared->pages[1 - shared->curPageNum], buf);
+
+			/* Read ahead the pages following the one we've just read */
+			if (shared->freeBytesNum > 0 &&
+				shared->filePageNum % SEQBUF_PREFETCH_PAGES == 1)
+				(void) FilePrefetch(seqBufPrivate->file,
+									SEQBUF_FILE_OFFSET(shared, (off_t) shared->filePageNum + 2),
+									Min(shared->freeBytesNum,
+										(off_t) SEQBUF_PREFETCH_PAGES * SEQBUF_CHUNK_SIZE),
+									WAIT_EVENT_DATA_FILE_PREFETCH);
 		}
 	}
 	return true;
@@ -685,8 +713,16 @@ seq_buf_read_pages(SeqBufDescPrivate *seqBufPrivate, SeqBufDescShared *shared,
 			return false;
 		}
 		free_bytes -= nbytes;
+		evicted_off += nbytes;
 	}
 
+	/* Read ahead the pages following the double buffer */
+	if (free_bytes > 0)
+		(void) FilePrefetch(seqBufPrivate->file, evicted_off,
+							Min(free_bytes,
+								(off_t) SEQBUF_PREFETCH_PAGES * SEQBUF_CHUNK_SIZE),
+							WAIT_EVENT_DATA_FILE_PREFETCH);
+
 	put_page_image(shared->pages[0], buf_first);
 	put_page_image(shared->pages[1], buf_second);
 	shared->freeBytesNum = free_bytes;
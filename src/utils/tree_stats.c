@@ -0,0 +1,488 @@
+/*-------------------------------------------------------------------------
+ *
+ * tree_stats.c
+ *		Cumulative cache and I/O statistics of trees.
+ *
+ * The counters are kept per tree in the shared memory: the steps to the
+ * in-memory pages (hits), the loads of the pages into the page pool (misses),
+ * the reads from the data files and S3, the evictions, the writes, the splits
+ * and merges, the bytes passed through the page compression and the time
+ * spent in the reads and writes of the pages, which is measured only with
+ * track_io_timing.
+ *
+ * The shared entries make an open addressing hash keyed by the database and
+ * the relnode of the tree.  The entries are never removed, so the increments
+ * of the trees beyond orioledb.tree_stats_max are dropped.
+ *
+ * The backends batch the increments in the small direct-mapped local cache.
+ * The local slot is flushed when it's taken by another tree, the whole cache
+ * is flushed after TREE_STATS_FLUSH_EVENTS increments, at the end of the
+ * transaction, at the exit and before the statistics are reported.
+ *
+ * With orioledb.page_wait_sample_rate, every n-th page wait of the backend is
+ * timed and put to the histogram of the tree by the kind of the wait and the
+ * level of the page.  The sampled waits are rare, so they go to the shared
+ * entry directly.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/tree_stats.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "utils/tree_stats.h"
+
+#include "catalog/pg_type.h"
+#include "common/hashfn.h"
+#include "funcapi.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/tuplestore.h"
+
+#define TREE_STATS_LOCAL_SLOTS	64
+#define TREE_STATS_FLUSH_EVENTS	1024
+#define TREE_STATS_MAX_PROBES	64
+
+/* < 10us, < 100us, < 1ms, < 10ms, < 100ms, >= 100ms */
+#define PAGE_WAIT_HISTOGRAM_BUCKETS	6
+
+typedef struct
+{
+	pg_atomic_uint64 waitTime;
+	pg_atomic_uint64 histogram[PAGE_WAIT_HISTOGRAM_BUCKETS];
+} PageWaitStats;
+
+typedef struct
+{
+	/* datoid and relnode of the tree, zero for the free entry */
+	pg_atomic_uint64 key;
+	Oid			reloid;
+	pg_atomic_uint64 counters[TREE_STATS_NUM];
+	PageWaitStats pageWaits[PAGE_WAIT_KINDS_NUM][PAGE_WAIT_LEVELS_NUM];
+} TreeStatsEntry;
+
+typedef struct
+{
+	uint64		nentries;
+} TreeStatsMeta;
+
+typedef struct
+{
+	uint64		key;
+	Oid			reloid;
+	bool		dirty;
+	uint64		counters[TREE_STATS_NUM];
+} TreeStatsLocalSlot;
+
+static TreeStatsMeta *treeStatsMeta = NULL;
+static TreeStatsEntry *treeStatsEntries = NULL;
+
+static TreeStatsLocalSlot localSlots[TREE_STATS_LOCAL_SLOTS];
+static int	localPending = 0;
+static uint64 pageWaitsCount = 0;
+
+static const char *pageWaitKindNames[PAGE_WAIT_KINDS_NUM] = {
+	"lock",
+	"read_block",
+	"split",
+	"io"
+};
+
+static const char *pageWaitLevelNames[PAGE_WAIT_LEVELS_NUM] = {
+	"leaf",
+	"internal",
+	"root"
+};
+
+PG_FUNCTION_INFO_V1(orioledb_tree_stats);
+PG_FUNCTION_INFO_V1(orioledb_page_wait_stats);
+
+Size
+tree_stats_shmem_needs(void)
+{
+	Size		size;
+
+	if (tree_stats_max <= 0)
+		return 0;
+
+	size = CACHELINEALIGN(sizeof(TreeStatsMeta));
+	size = add_size(size, mul_size(tree_stats_max, sizeof(TreeStatsEntry)));
+	return size;
+}
+
+void
+tree_stats_shmem_init(Pointer ptr, bool found)
+{
+	if (tree_stats_max <= 0)
+		return;
+
+	treeStatsMeta = (TreeStatsMeta *) ptr;
+	treeStatsEntries = (TreeStatsEntry *)
+		(ptr + CACHELINEALIGN(sizeof(TreeStatsMeta)));
+
+	if (!found)
+	{
+		uint64		i;
+		int			j;
+
+		treeStatsMeta->nentries = tree_stats_max;
+
+		for (i = 0; i < treeStatsMeta->nentries; i++)
+		{
+			TreeStatsEntry *entry = &treeStatsEntries[i];
+
+			pg_atomic_init_u64(&entry->key, 0);
+			entry->reloid = InvalidOid;
+			for (j = 0; j < TREE_STATS_NUM; j++)
+				pg_atomic_init_u64(&entry->counters[j], 0);
+			for (j = 0; j < PAGE_WAIT_KINDS_NUM; j++)
+			{
+				int			k,
+							l;
+
+				for (k = 0; k < PAGE_WAIT_LEVELS_NUM; k++)
+				{
+					PageWaitStats *stats = &entry->pageWaits[j][k];
+
+					pg_atomic_init_u64(&stats->waitTime, 0);
+					for (l = 0; l < PAGE_WAIT_HISTOGRAM_BUCKETS; l++)
+						pg_atomic_init_u64(&stats->histogram[l], 0);
+				}
+			}
+		}
+	}
+}
+
+static inline uint64
+tree_stats_key(ORelOids oids)
+{
+	return ((uint64) oids.datoid << 32) | (uint64) oids.relnode;
+}
+
+static inline uint32
+tree_stats_hash(uint64 key)
+{
+	return murmurhash32((uint32) (key >> 32)) ^ murmurhash32((uint32) key);
+}
+
+/*
+ * Finds the shared entry of the tree, takes the free one if the tree has no
+ * entry yet.  Returns NULL if the probes meet no free entry.
+ */
+static TreeStatsEntry *
+tree_stats_get_entry(uint64 key)
+{
+	uint64		nentries = treeStatsMeta->nentries;
+	uint64		start = tree_stats_hash(key) % nentries;
+	uint64		i;
+
+	for (i = 0; i < Min(nentries, TREE_STATS_MAX_PROBES); i++)
+	{
+		TreeStatsEntry *entry = &treeStatsEntries[(start + i) % nentries];
+		uint64		entryKey = pg_atomic_read_u64(&entry->key);
+
+		if (entryKey == 0 &&
+			pg_atomic_compare_exchange_u64(&entry->key, &entryKey, key))
+			return entry;
+
+		if (entryKey == key)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void
+tree_stats_flush_slot(TreeStatsLocalSlot *slot)
+{
+	TreeStatsEntry *entry;
+	int			i;
+
+	entry = tree_stats_get_entry(slot->key);
+	if (entry)
+	{
+		if (!OidIsValid(entry->reloid))
+			entry->reloid = slot->reloid;
+
+		for (i = 0; i < TREE_STATS_NUM; i++)
+		{
+			if (slot->counters[i] != 0)
+				pg_atomic_fetch_add_u64(&entry->counters[i], slot->counters[i]);
+		}
+	}
+
+	memset(slot->counters, 0, sizeof(slot->counters));
+	slot->dirty = false;
+}
+
+/*
+ * Adds 'value' to the counter of the tree in the local cache.
+ */
+void
+tree_stats_add(ORelOids oids, TreeStat stat, uint64 value)
+{
+	TreeStatsLocalSlot *slot;
+	uint64		key;
+
+	if (treeStatsMeta == NULL)
+		return;
+
+	key = tree_stats_key(oids);
+	slot = &localSlots[tree_stats_hash(key) % TREE_STATS_LOCAL_SLOTS];
+
+	if (slot->key != key)
+	{
+		if (slot->dirty)
+			tree_stats_flush_slot(slot);
+		slot->key = key;
+		slot->reloid = oids.reloid;
+	}
+	else if (!OidIsValid(slot->reloid))
+	{
+		slot->reloid = oids.reloid;
+	}
+
+	slot->counters[stat] += value;
+	slot->dirty = true;
+
+	if (++localPending >= TREE_STATS_FLUSH_EVENTS)
+		tree_stats_flush();
+}
+
+/*
+ * Adds the microseconds passed since 'startTime' to the time counter of the
+ * tree.
+ */
+void
+tree_stats_add_time(ORelOids oids, TreeStat stat, instr_time startTime)
+{
+	instr_time	duration;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, startTime);
+	tree_stats_add(oids, stat, INSTR_TIME_GET_MICROSEC(duration));
+}
+
+/*
+ * Moves the batched increments of the backend to the shared memory.
+ */
+void
+tree_stats_flush(void)
+{
+	int			i;
+
+	if (treeStatsMeta == NULL || localPending == 0)
+		return;
+
+	for (i = 0; i < TREE_STATS_LOCAL_SLOTS; i++)
+	{
+		if (localSlots[i].dirty)
+			tree_stats_flush_slot(&localSlots[i]);
+	}
+	localPending = 0;
+}
+
+/*
+ * Returns true if the page wait, which is about to start, is sampled.  Sets
+ * the start time of the sampled wait.
+ */
+bool
+tree_stats_page_wait_sample(instr_time *startTime)
+{
+	if (treeStatsMeta == NULL || page_wait_sample_rate <= 0)
+		return false;
+
+	if (++pageWaitsCount % page_wait_sample_rate != 0)
+		return false;
+
+	INSTR_TIME_SET_CURRENT(*startTime);
+	return true;
+}
+
+/*
+ * Accounts the sampled page wait, which has started at 'startTime'.
+ */
+void
+tree_stats_report_page_wait(ORelOids oids, PageWaitKind kind,
+							PageWaitLevel level, instr_time startTime)
+{
+	TreeStatsEntry *entry;
+	PageWaitStats *stats;
+	instr_time	duration;
+	uint64		elapsed,
+				bound = 10;
+	int			bucket = 0;
+
+	if (treeStatsMeta == NULL)
+		return;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, startTime);
+	elapsed = INSTR_TIME_GET_MICROSEC(duration);
+
+	entry = tree_stats_get_entry(tree_stats_key(oids));
+	if (entry == NULL)
+		return;
+
+	while (bucket < PAGE_WAIT_HISTOGRAM_BUCKETS - 1 && elapsed >= bound)
+	{
+		bound *= 10;
+		bucket++;
+	}
+
+	stats = &entry->pageWaits[kind][level];
+	pg_atomic_fetch_add_u64(&stats->waitTime, elapsed);
+	pg_atomic_fetch_add_u64(&stats->histogram[bucket], 1);
+}
+
+static Tuplestorestate *
+tree_stats_begin_tuplestore(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = *tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
+
+/*
+ * Reports the statistics of the trees.  The times are in milliseconds.
+ */
+Datum
+orioledb_tree_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	uint64		i;
+
+	tupstore = tree_stats_begin_tuplestore(fcinfo, &tupdesc);
+
+	if (treeStatsMeta == NULL)
+		return (Datum) 0;
+
+	tree_stats_flush();
+
+	for (i = 0; i < treeStatsMeta->nentries; i++)
+	{
+		TreeStatsEntry *entry = &treeStatsEntries[i];
+		uint64		key = pg_atomic_read_u64(&entry->key);
+		Datum		values[3 + TREE_STATS_NUM];
+		bool		nulls[3 + TREE_STATS_NUM];
+		int			j;
+
+		if (key == 0)
+			continue;
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = ObjectIdGetDatum((Oid) (key >> 32));
+		values[1] = ObjectIdGetDatum(entry->reloid);
+		values[2] = ObjectIdGetDatum((Oid) key);
+		if (!OidIsValid(entry->reloid))
+			nulls[1] = true;
+
+		for (j = 0; j < TREE_STATS_NUM; j++)
+		{
+			uint64		value = pg_atomic_read_u64(&entry->counters[j]);
+
+			if (j == TreeStatLoadTime || j == TreeStatWriteTime)
+				values[3 + j] = Float8GetDatum((double) value / 1000.0);
+			else
+				values[3 + j] = Int64GetDatum((int64) value);
+		}
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Reports the histograms of the sampled page waits per tree, kind of the
+ * wait and level of the page.  The times are in milliseconds.
+ */
+Datum
+orioledb_page_wait_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	uint64		i;
+
+	tupstore = tree_stats_begin_tuplestore(fcinfo, &tupdesc);
+
+	if (treeStatsMeta == NULL)
+		return (Datum) 0;
+
+	for (i = 0; i < treeStatsMeta->nentries; i++)
+	{
+		TreeStatsEntry *entry = &treeStatsEntries[i];
+		uint64		key = pg_atomic_read_u64(&entry->key);
+		int			kind,
+					level;
+
+		if (key == 0)
+			continue;
+
+		for (kind = 0; kind < PAGE_WAIT_KINDS_NUM; kind++)
+		{
+			for (level = 0; level < PAGE_WAIT_LEVELS_NUM; level++)
+			{
+				PageWaitStats *stats = &entry->pageWaits[kind][level];
+				Datum		histogram[PAGE_WAIT_HISTOGRAM_BUCKETS];
+				Datum		values[8];
+				bool		nulls[8] = {false, false, false, false, false,
+				false, false, false};
+				uint64		waits = 0;
+				int			j;
+
+				for (j = 0; j < PAGE_WAIT_HISTOGRAM_BUCKETS; j++)
+				{
+					uint64		value = pg_atomic_read_u64(&stats->histogram[j]);
+
+					histogram[j] = Int64GetDatum((int64) value);
+					waits += value;
+				}
+
+				if (waits == 0)
+					continue;
+
+				values[0] = ObjectIdGetDatum((Oid) (key >> 32));
+				values[1] = ObjectIdGetDatum(entry->reloid);
+				values[2] = ObjectIdGetDatum((Oid) key);
+				if (!OidIsValid(entry->reloid))
+					nulls[1] = true;
+				values[3] = CStringGetTextDatum(pageWaitKindNames[kind]);
+				values[4] = CStringGetTextDatum(pageWaitLevelNames[level]);
+				values[5] = Int64GetDatum((int64) waits);
+				values[6] = Float8GetDatum((double) pg_atomic_read_u64(&stats->waitTime) / 1000.0);
+				values[7] = PointerGetDatum(construct_array(histogram,
+															PAGE_WAIT_HISTOGRAM_BUCKETS,
+															INT8OID, sizeof(int64),
+															FLOAT8PASSBYVAL,
+															TYPALIGN_DOUBLE));
+				tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+			}
+		}
+	}
+
+	return (Datum) 0;
+}
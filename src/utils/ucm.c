@@ -25,6 +25,7 @@
 #define UCM_LEVEL_MASK		0xF
 
 static bool skip_ucm = false;
+static bool ucm_scan_access = false;
 
 static int	init_ucm_non_leaf_recursive(UsageCountMap *map, int i);
 static void ucm_inc_recursive(UsageCountMap *map, int i, int prev, int next);
@@ -119,6 +120,7 @@ init_ucm(UsageCountMap *map, Pointer ptr, bool found)
 	OInMemoryBlkno blkno;
 
 	map->epoch = (pg_atomic_uint32 *) ptr;
+	map->epochShifts = (pg_atomic_uint64 *) (ptr + sizeof(uint64));
 	ptr += PG_CACHE_LINE_SIZE;
 
 	map->ucm = (pg_atomic_uint32 *) ptr;
@@ -127,6 +129,7 @@ init_ucm(UsageCountMap *map, Pointer ptr, bool found)
 		return;
 
 	pg_atomic_init_u32(map->epoch, 0);
+	pg_atomic_init_u64(map->epochShifts, 0);
 
 	/* Init leaf variables */
 	blkno = 0;
@@ -254,7 +257,7 @@ page_inc_usage_count(UsageCountMap *map, OInMemoryBlkno blkno)
 
 	if (usageCount == UCM_INVALID_LEVEL ||
 		usageCount == UCM_FREE_PAGES_LEVEL ||
-		skip_ucm)
+		skip_ucm || ucm_scan_access)
 		return;
 
 	page_inc_usage_count_internal(map, blkno, state);
@@ -418,7 +421,29 @@ ucm_epoch_shift(UsageCountMap *map)
 		next_epoch = 0;
 	else
 		next_epoch = epoch + 1;
-	pg_atomic_compare_exchange_u32(map->epoch, &epoch, next_epoch);
+	if (pg_atomic_compare_exchange_u32(map->epoch, &epoch, next_epoch))
+		pg_atomic_fetch_add_u64(map->epochShifts, 1);
+}
+
+/*
+ * Counts the pages of the map per usage level.  The leaf variables keep the
+ * exact counts of their pages, so we just sum them up.  The pages of the
+ * concurrent changes might be counted twice or missed.
+ */
+void
+ucm_level_pages(UsageCountMap *map, uint64 pages[UCM_LEVELS])
+{
+	int			i,
+				j;
+
+	memset(pages, 0, sizeof(uint64) * UCM_LEVELS);
+	for (i = map->nonLeaf; i < map->total; i++)
+	{
+		uint32		value = pg_atomic_read_u32(&map->ucm[i]);
+
+		for (j = 0; j < UCM_LEVELS; j++)
+			pages[j] += (value >> (j * UCM_LEVEL_BITS)) & UCM_LEVEL_MASK;
+	}
 }
 
 OInMemoryBlkno
@@ -505,9 +530,10 @@ retry:
 					else
 						next_epoch = epoch + 1;
 
-					pg_atomic_compare_exchange_u32(map->epoch,
-												   &epoch,
-												   next_epoch);
+					if (pg_atomic_compare_exchange_u32(map->epoch,
+													   &epoch,
+													   next_epoch))
+						pg_atomic_fetch_add_u64(map->epochShifts, 1);
 					goto retry;
 				}
 				factor *= UCM_BRANCH_FACTOR;
@@ -524,8 +550,13 @@ retry:
 	}
 }
 
+/*
+ * Occupies a free page.  The search starts from init_blkno, so the nearest
+ * free page in the map order is returned.  That lets the caller prefer some
+ * part of the pool and still find a free page anywhere else.
+ */
 OInMemoryBlkno
-ucm_occupy_free_page(UsageCountMap *map)
+ucm_occupy_free_page(UsageCountMap *map, OInMemoryBlkno init_blkno)
 {
 	int64		location;
 	int64		i;
@@ -535,7 +566,8 @@ ucm_occupy_free_page(UsageCountMap *map)
 	uint32		mask;
 
 	mask = UCM_LEVEL_MASK << (UCM_FREE_PAGES_LEVEL * UCM_LEVEL_BITS);
-	location = 0;
+	Assert(init_blkno >= map->offset && init_blkno < map->offset + map->size);
+	location = init_blkno - map->offset;
 	factor = map->rootFactor;
 	base = 0;
 	num_iterations = 0;
@@ -593,6 +625,19 @@ ucm_occupy_free_page(UsageCountMap *map)
 	}
 }
 
+/*
+ * Occupies the given page if it's free.
+ */
+bool
+ucm_try_occupy_page(UsageCountMap *map, OInMemoryBlkno blkno)
+{
+	OrioleDBPageHeader *header = (OrioleDBPageHeader *) O_GET_IN_MEMORY_PAGE(blkno);
+	uint64		state = pg_atomic_read_u64(&header->state);
+
+	return O_PAGE_STATE_GET_USAGE_COUNT(state) == UCM_FREE_PAGES_LEVEL &&
+		page_try_change_usage_count(map, blkno, state, UCM_INVALID_LEVEL);
+}
+
 void
 set_skip_ucm(void)
 {
@@ -604,3 +649,33 @@ unset_skip_ucm(void)
 {
 	skip_ucm = false;
 }
+
+/*
+ * Scan-resistant scans neither promote the pages they access nor give the
+ * pages they load the usual usage count.  Such pages enter the lowest level
+ * and become the first candidates for eviction unless referenced again.
+ */
+void
+set_ucm_scan_access(void)
+{
+	ucm_scan_access = true;
+}
+
+void
+unset_ucm_scan_access(void)
+{
+	ucm_scan_access = false;
+}
+
+/*
+ * Returns usage count for a page just loaded into the pool.
+ */
+uint32
+ucm_loaded_page_usage_count(UsageCountMap *map)
+{
+	uint32		epoch = pg_atomic_read_u32(map->epoch);
+
+	if (ucm_scan_access)
+		return epoch;
+	return (epoch + 2) % UCM_USAGE_LEVELS;
+}
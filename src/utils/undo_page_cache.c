@@ -0,0 +1,269 @@
+/*-------------------------------------------------------------------------
+ *
+ * undo_page_cache.c
+ *		Shared cache of historical page images reconstructed from undo.
+ *
+ * Readers with old snapshots walk the chain of page-level undo images of
+ * every leaf modified after their snapshot was taken (read_page_from_undo()).
+ * Concurrent long reports on the same hot tables repeat the same walks.  The
+ * cache keeps the result of the walk keyed by the head of the chain, which is
+ * the undo location referenced by the page, together with the range of the
+ * snapshot CSNs, which reach the same image: (csnLow, csnHigh].
+ *
+ * The undo images are never modified, and the undo locations are not reused
+ * while the shared memory lives.  So the entry is valid as long as the undo
+ * it was reconstructed from is retained.  The entries, whose undo is
+ * truncated, are treated as empty slots.  Only the walks consisting of the
+ * single-page images are cached, because the choice between the halves of
+ * the merge image depends on the key being searched.
+ *
+ * The layout follows the compressed cache: a set-associative hash of the
+ * buckets of a few slots under their own LWLock.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/undo_page_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "transam/undo.h"
+#include "utils/assoc_cache.h"
+#include "utils/undo_page_cache.h"
+
+#include "access/htup_details.h"
+#include "common/hashfn.h"
+#include "funcapi.h"
+#include "storage/lwlock.h"
+
+#define UNDO_PAGE_CACHE_WAYS		4
+#define UNDO_PAGE_CACHE_MAX_USAGE	3
+
+/* the cache counters */
+#define UNDO_PAGE_CACHE_HITS		0
+#define UNDO_PAGE_CACHE_MISSES		1
+#define UNDO_PAGE_CACHE_INSERTS		2
+
+typedef struct
+{
+	/* head of the undo chain, InvalidUndoLocation for the empty slot */
+	UndoLocation startLocation;
+	UndoLocation imageLocation;
+	CommitSeqNo csnLow;
+	CommitSeqNo csnHigh;
+	pg_atomic_uint32 usage;
+	char		image[ORIOLEDB_BLCKSZ];
+} UndoPageCacheSlot;
+
+typedef struct
+{
+	LWLock		lock;
+	UndoPageCacheSlot slots[UNDO_PAGE_CACHE_WAYS];
+} UndoPageCacheBucket;
+
+static bool undo_page_cache_slot_is_free(Pointer slot);
+static void undo_page_cache_slot_clear(Pointer slot);
+
+/* The slots are keyed by the undo location, not by the extent */
+static AssocCache undoPageCache = {
+	.bucketSize = sizeof(UndoPageCacheBucket),
+	.slotsOffset = offsetof(UndoPageCacheBucket, slots),
+	.slotSize = sizeof(UndoPageCacheSlot),
+	.ways = UNDO_PAGE_CACHE_WAYS,
+	.usageOffset = offsetof(UndoPageCacheSlot, usage),
+	.isEmpty = undo_page_cache_slot_is_free,
+	.clear = undo_page_cache_slot_clear
+};
+
+PG_FUNCTION_INFO_V1(orioledb_undo_page_cache_stats);
+
+Size
+undo_page_cache_shmem_needs(void)
+{
+	return assoc_cache_shmem_needs(&undoPageCache, undo_page_cache_size);
+}
+
+void
+undo_page_cache_shmem_init(Pointer ptr, bool found)
+{
+	assoc_cache_shmem_init(&undoPageCache, ptr, found, undo_page_cache_size,
+						   "OUndoPageCacheTranche");
+}
+
+/*
+ * Only the page-level undo of the regular tables is cached: the system trees
+ * are small and rarely read under the old snapshots.
+ */
+static inline bool
+undo_page_cache_enabled(BTreeDescr *desc)
+{
+	return undoPageCache.meta != NULL &&
+		undoPageCache.meta->nbuckets > 0 &&
+		GET_PAGE_LEVEL_UNDO_TYPE(desc->undoType) == UndoLogRegularPageLevel;
+}
+
+static UndoPageCacheBucket *
+undo_page_cache_bucket(UndoLocation startLocation)
+{
+	uint32		hash;
+
+	hash = hash_combine(hash_uint32((uint32) startLocation),
+						hash_uint32((uint32) (startLocation >> 32)));
+
+	return (UndoPageCacheBucket *) assoc_cache_bucket(&undoPageCache, hash);
+}
+
+static inline bool
+undo_page_cache_slot_is_valid(UndoPageCacheSlot *slot)
+{
+	/* The image is the oldest undo record of the chain */
+	return UndoLocationIsValid(slot->startLocation) &&
+		UNDO_REC_EXISTS(UndoLogRegularPageLevel, slot->imageLocation);
+}
+
+static bool
+undo_page_cache_slot_is_free(Pointer slot)
+{
+	return !undo_page_cache_slot_is_valid((UndoPageCacheSlot *) slot);
+}
+
+static void
+undo_page_cache_slot_clear(Pointer slot)
+{
+	((UndoPageCacheSlot *) slot)->startLocation = InvalidUndoLocation;
+}
+
+static UndoPageCacheSlot *
+undo_page_cache_find(UndoPageCacheBucket *bucket, UndoLocation startLocation,
+					 CommitSeqNo csn)
+{
+	int			i;
+
+	for (i = 0; i < UNDO_PAGE_CACHE_WAYS; i++)
+	{
+		UndoPageCacheSlot *slot = &bucket->slots[i];
+
+		if (slot->startLocation == startLocation &&
+			csn > slot->csnLow && csn <= slot->csnHigh &&
+			undo_page_cache_slot_is_valid(slot))
+			return slot;
+	}
+	return NULL;
+}
+
+/*
+ * Copies the cached image, which is visible for the csn and reconstructed
+ * from the undo chain starting at startLocation.  Returns false if there is
+ * no such image.
+ */
+bool
+undo_page_cache_get(BTreeDescr *desc, UndoLocation startLocation,
+					CommitSeqNo csn, Page img, UndoLocation *imageLocation)
+{
+	UndoPageCacheBucket *bucket;
+	UndoPageCacheSlot *slot;
+
+	if (!undo_page_cache_enabled(desc))
+		return false;
+
+	bucket = undo_page_cache_bucket(startLocation);
+
+	LWLockAcquire(&bucket->lock, LW_SHARED);
+	slot = undo_page_cache_find(bucket, startLocation, csn);
+	if (slot)
+	{
+		memcpy(img, slot->image, ORIOLEDB_BLCKSZ);
+		*imageLocation = slot->imageLocation;
+		if (pg_atomic_read_u32(&slot->usage) < UNDO_PAGE_CACHE_MAX_USAGE)
+			pg_atomic_fetch_add_u32(&slot->usage, 1);
+	}
+	LWLockRelease(&bucket->lock);
+
+	pg_atomic_fetch_add_u64(&undoPageCache.meta->counters[slot ? UNDO_PAGE_CACHE_HITS :
+														 UNDO_PAGE_CACHE_MISSES], 1);
+	return slot != NULL;
+}
+
+/*
+ * Puts the image reconstructed from the undo chain starting at startLocation.
+ * The image is visible for the snapshot CSNs in (csnLow, csnHigh].
+ */
+void
+undo_page_cache_put(BTreeDescr *desc, UndoLocation startLocation,
+					CommitSeqNo csnLow, CommitSeqNo csnHigh,
+					Page img, UndoLocation imageLocation)
+{
+	UndoPageCacheBucket *bucket;
+	UndoPageCacheSlot *slot;
+	bool		wasEmpty;
+	int			i;
+
+	if (!undo_page_cache_enabled(desc))
+		return;
+
+	bucket = undo_page_cache_bucket(startLocation);
+
+	LWLockAcquire(&bucket->lock, LW_EXCLUSIVE);
+
+	for (i = 0; i < UNDO_PAGE_CACHE_WAYS; i++)
+	{
+		UndoPageCacheSlot *cur = &bucket->slots[i];
+
+		if (cur->startLocation == startLocation &&
+			cur->csnLow == csnLow && cur->csnHigh == csnHigh)
+		{
+			/* Concurrently cached by someone else */
+			pg_atomic_write_u32(&cur->usage, UNDO_PAGE_CACHE_MAX_USAGE);
+			LWLockRelease(&bucket->lock);
+			return;
+		}
+	}
+
+	/* The slots of the discarded undo are free */
+	slot = &bucket->slots[assoc_cache_pick_victim((Pointer) bucket->slots,
+												  sizeof(UndoPageCacheSlot),
+												  UNDO_PAGE_CACHE_WAYS,
+												  offsetof(UndoPageCacheSlot, usage),
+												  undo_page_cache_slot_is_free,
+												  &wasEmpty)];
+
+	slot->startLocation = startLocation;
+	slot->imageLocation = imageLocation;
+	slot->csnLow = csnLow;
+	slot->csnHigh = csnHigh;
+	memcpy(slot->image, img, ORIOLEDB_BLCKSZ);
+	pg_atomic_write_u32(&slot->usage, UNDO_PAGE_CACHE_MAX_USAGE);
+	LWLockRelease(&bucket->lock);
+
+	pg_atomic_fetch_add_u64(&undoPageCache.meta->counters[UNDO_PAGE_CACHE_INSERTS], 1);
+}
+
+/*
+ * Reports the undo page cache size and hit statistics.
+ */
+Datum
+orioledb_undo_page_cache_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[5];
+	bool		nulls[5] = {false, false, false, false, false};
+
+	orioledb_check_shmem();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = Int64GetDatum((int64) (undoPageCache.meta->nbuckets *
+									   sizeof(UndoPageCacheBucket)));
+	values[1] = Int64GetDatum((int64) (undoPageCache.meta->nbuckets *
+									   UNDO_PAGE_CACHE_WAYS));
+	values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&undoPageCache.meta->counters[UNDO_PAGE_CACHE_HITS]));
+	values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&undoPageCache.meta->counters[UNDO_PAGE_CACHE_MISSES]));
+	values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&undoPageCache.meta->counters[UNDO_PAGE_CACHE_INSERTS]));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
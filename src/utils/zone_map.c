@@ -0,0 +1,381 @@
+/*-------------------------------------------------------------------------
+ *
+ * zone_map.c
+ *		Shared cache of the column summaries of the on-disk leaf pages.
+ *
+ * The internal pages keep only the keys of their downlinks, so the sequential
+ * scan with a predicate on a non-key column has to read every leaf.  The zone
+ * map keeps the min/max summaries of the columns referenced by the pushed
+ * down scan keys for the on-disk leaves, keyed by the tree and the extent the
+ * leaf occupies.  The disk phase of the sequential scan summarizes the leaves
+ * it reads, and the subsequent scans skip the reads of the leaves, which
+ * summaries can't match their keys.
+ *
+ * The arena is a set-associative hash like the compressed cache, so the
+ * summary is valid as long as the extent keeps its image.
+ *
+ * Only the by-value columns are summarized.  The leaf is summarized only if
+ * every tuple in it is committed and visible for everybody, so the summary
+ * covers all the versions any snapshot could see in the image.  The image
+ * csn is kept in the entry, and the summary isn't used by the scans, which
+ * would reconstruct an older image from undo.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/utils/zone_map.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/page_contents.h"
+#include "transam/oxid.h"
+#include "tuple/format.h"
+#include "utils/assoc_cache.h"
+#include "utils/zone_map.h"
+
+#include "access/stratnum.h"
+#include "storage/lwlock.h"
+#include "utils/typcache.h"
+
+#define ZONE_MAP_WAYS		4
+#define ZONE_MAP_COLUMNS	4
+#define ZONE_MAP_MAX_USAGE	3
+
+/* the zone map counters */
+#define ZONE_MAP_SKIPS		0
+#define ZONE_MAP_HITS		1
+#define ZONE_MAP_MISSES		2
+#define ZONE_MAP_INSERTS	3
+
+typedef struct
+{
+	AssocCacheKey key;
+	/* csn of the summarized image */
+	CommitSeqNo csn;
+	/* number of the summarized columns, zero for the empty slot */
+	int			ncolumns;
+	AttrNumber	attnums[ZONE_MAP_COLUMNS];
+	/* false if the column has only NULLs */
+	bool		hasValues[ZONE_MAP_COLUMNS];
+	Datum		min[ZONE_MAP_COLUMNS];
+	Datum		max[ZONE_MAP_COLUMNS];
+	pg_atomic_uint32 usage;
+} ZoneMapSlot;
+
+typedef struct
+{
+	LWLock		lock;
+	ZoneMapSlot slots[ZONE_MAP_WAYS];
+} ZoneMapBucket;
+
+static bool zone_map_slot_is_empty(Pointer slot);
+static void zone_map_slot_clear(Pointer slot);
+
+static AssocCache zoneMap = {
+	.bucketSize = sizeof(ZoneMapBucket),
+	.slotsOffset = offsetof(ZoneMapBucket, slots),
+	.slotSize = sizeof(ZoneMapSlot),
+	.ways = ZONE_MAP_WAYS,
+	.keyOffset = offsetof(ZoneMapSlot, key),
+	.usageOffset = offsetof(ZoneMapSlot, usage),
+	.isEmpty = zone_map_slot_is_empty,
+	.clear = zone_map_slot_clear
+};
+
+PG_FUNCTION_INFO_V1(orioledb_zone_map_stats);
+
+Size
+zone_map_shmem_needs(void)
+{
+	return assoc_cache_shmem_needs(&zoneMap, zone_map_size);
+}
+
+void
+zone_map_shmem_init(Pointer ptr, bool found)
+{
+	assoc_cache_shmem_init(&zoneMap, ptr, found, zone_map_size,
+						   "OZoneMapTranche");
+}
+
+bool
+zone_map_enabled(BTreeDescr *desc)
+{
+	return assoc_cache_enabled(&zoneMap, desc);
+}
+
+static bool
+zone_map_slot_is_empty(Pointer slot)
+{
+	return ((ZoneMapSlot *) slot)->ncolumns == 0;
+}
+
+static void
+zone_map_slot_clear(Pointer slot)
+{
+	((ZoneMapSlot *) slot)->ncolumns = 0;
+}
+
+static inline void
+zone_map_count(int counter)
+{
+	pg_atomic_fetch_add_u64(&zoneMap.meta->counters[counter], 1);
+}
+
+/*
+ * Checks whether the column with the summary could match the scan key.  The
+ * keys are strict, so the column having only NULLs can't match any of them.
+ */
+static bool
+zone_map_key_may_match(ScanKey key, Oid atttypid, bool hasValues,
+					   Datum min, Datum max)
+{
+	TypeCacheEntry *typentry;
+	int32		cmp;
+
+	if (!hasValues)
+		return false;
+
+	switch (key->sk_strategy)
+	{
+		case BTLessStrategyNumber:
+		case BTLessEqualStrategyNumber:
+			return DatumGetBool(FunctionCall2Coll(&key->sk_func,
+												  key->sk_collation,
+												  min, key->sk_argument));
+		case BTGreaterStrategyNumber:
+		case BTGreaterEqualStrategyNumber:
+			return DatumGetBool(FunctionCall2Coll(&key->sk_func,
+												  key->sk_collation,
+												  max, key->sk_argument));
+		case BTEqualStrategyNumber:
+			/* The equality function can't order the values */
+			if (key->sk_subtype != atttypid)
+				return true;
+			typentry = lookup_type_cache(atttypid, TYPECACHE_CMP_PROC_FINFO);
+			if (!OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+				return true;
+			cmp = DatumGetInt32(FunctionCall2Coll(&typentry->cmp_proc_finfo,
+												  key->sk_collation,
+												  min, key->sk_argument));
+			if (cmp > 0)
+				return false;
+			cmp = DatumGetInt32(FunctionCall2Coll(&typentry->cmp_proc_finfo,
+												  key->sk_collation,
+												  max, key->sk_argument));
+			return cmp >= 0;
+		default:
+			return true;
+	}
+}
+
+/*
+ * Returns false if the summary of the on-disk leaf at 'downlink' shows that
+ * none of its tuples match the scan keys.  The scan, which needs the image
+ * older than 'csn', can't use the summary of the current image.
+ */
+bool
+zone_map_leaf_may_match(BTreeDescr *desc, uint64 downlink, CommitSeqNo csn,
+						TupleDesc tupdesc, int nkeys, ScanKey keys,
+						AttrNumber *attnums)
+{
+	ZoneMapBucket *bucket;
+	ZoneMapSlot *slot;
+	ZoneMapSlot summary;
+	uint64		off = DOWNLINK_GET_DISK_OFF(downlink);
+	int			i,
+				j;
+
+	if (!zone_map_enabled(desc))
+		return true;
+
+	bucket = (ZoneMapBucket *) assoc_cache_extent_bucket(&zoneMap, desc, off);
+
+	LWLockAcquire(&bucket->lock, LW_SHARED);
+	slot = (ZoneMapSlot *) assoc_cache_find(&zoneMap, (Pointer) bucket,
+											desc, off);
+	if (slot)
+	{
+		memcpy(&summary, slot, offsetof(ZoneMapSlot, usage));
+		if (pg_atomic_read_u32(&slot->usage) < ZONE_MAP_MAX_USAGE)
+			pg_atomic_fetch_add_u32(&slot->usage, 1);
+	}
+	LWLockRelease(&bucket->lock);
+
+	if (!slot || summary.csn >= csn)
+	{
+		zone_map_count(ZONE_MAP_MISSES);
+		return true;
+	}
+
+	zone_map_count(ZONE_MAP_HITS);
+	for (i = 0; i < nkeys; i++)
+	{
+		for (j = 0; j < summary.ncolumns; j++)
+		{
+			if (summary.attnums[j] != attnums[i])
+				continue;
+
+			if (!zone_map_key_may_match(&keys[i],
+										TupleDescAttr(tupdesc, attnums[i] - 1)->atttypid,
+										summary.hasValues[j],
+										summary.min[j], summary.max[j]))
+			{
+				zone_map_count(ZONE_MAP_SKIPS);
+				return false;
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+/*
+ * Summarizes the by-value columns referenced by the scan keys over the image
+ * of the on-disk leaf at 'downlink' just read from disk.  The leaves having
+ * the versions, which might be invisible for some snapshots, are skipped.
+ */
+void
+zone_map_summarize_leaf(BTreeDescr *desc, uint64 downlink, Page img,
+						TupleDesc tupdesc, OTupleFixedFormatSpec *spec,
+						int nkeys, AttrNumber *attnums)
+{
+	ZoneMapBucket *bucket;
+	ZoneMapSlot *slot;
+	ZoneMapSlot summary;
+	FmgrInfo   *cmpFuncs[ZONE_MAP_COLUMNS];
+	Oid			collations[ZONE_MAP_COLUMNS];
+	BTreePageItemLocator loc;
+	uint64		off = DOWNLINK_GET_DISK_OFF(downlink);
+	int			i,
+				j;
+
+	if (!zone_map_enabled(desc))
+		return;
+
+	summary.ncolumns = 0;
+	for (i = 0; i < nkeys && summary.ncolumns < ZONE_MAP_COLUMNS; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, attnums[i] - 1);
+		TypeCacheEntry *typentry;
+
+		if (!attr->attbyval)
+			continue;
+
+		for (j = 0; j < summary.ncolumns; j++)
+		{
+			if (summary.attnums[j] == attnums[i])
+				break;
+		}
+		if (j < summary.ncolumns)
+			continue;
+
+		typentry = lookup_type_cache(attr->atttypid, TYPECACHE_CMP_PROC_FINFO);
+		if (!OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+			continue;
+
+		summary.attnums[summary.ncolumns] = attnums[i];
+		summary.hasValues[summary.ncolumns] = false;
+		cmpFuncs[summary.ncolumns] = &typentry->cmp_proc_finfo;
+		collations[summary.ncolumns] = attr->attcollation;
+		summary.ncolumns++;
+	}
+
+	if (summary.ncolumns == 0)
+		return;
+
+	BTREE_PAGE_FOREACH_ITEMS(img, &loc)
+	{
+		BTreeLeafTuphdr *tupHdr;
+		OTuple		tuple;
+		int			natts;
+
+		BTREE_PAGE_READ_LEAF_ITEM(tupHdr, tuple, img, &loc);
+
+		if (XACT_INFO_IS_LOCK_ONLY(tupHdr->xactInfo) ||
+			!XACT_INFO_FINISHED_FOR_EVERYBODY(tupHdr->xactInfo) ||
+			COMMITSEQNO_IS_ABORTED(XACT_INFO_MAP_CSN(tupHdr->xactInfo)))
+			return;
+
+		if (tupHdr->deleted != BTreeLeafTupleNonDeleted)
+			continue;
+
+		if (tuple.formatFlags & O_TUPLE_FLAGS_FIXED_FORMAT)
+			natts = spec->natts;
+		else
+			natts = ((OTupleHeader) tuple.data)->natts;
+
+		for (j = 0; j < summary.ncolumns; j++)
+		{
+			Datum		val;
+			bool		isnull;
+
+			/* The attributes added after the tuple was written are NULLs */
+			if (summary.attnums[j] > natts)
+				continue;
+
+			val = o_fastgetattr(tuple, summary.attnums[j], tupdesc, spec,
+								&isnull);
+			if (isnull)
+				continue;
+
+			if (!summary.hasValues[j])
+			{
+				summary.min[j] = val;
+				summary.max[j] = val;
+				summary.hasValues[j] = true;
+				continue;
+			}
+
+			if (DatumGetInt32(FunctionCall2Coll(cmpFuncs[j], collations[j],
+												val, summary.min[j])) < 0)
+				summary.min[j] = val;
+			else if (DatumGetInt32(FunctionCall2Coll(cmpFuncs[j], collations[j],
+													 val, summary.max[j])) > 0)
+				summary.max[j] = val;
+		}
+	}
+
+	summary.key.datoid = desc->oids.datoid;
+	summary.key.relnode = desc->oids.relnode;
+	summary.key.off = off;
+	summary.csn = ((BTreePageHeader *) img)->csn;
+
+	bucket = (ZoneMapBucket *) assoc_cache_extent_bucket(&zoneMap, desc, off);
+
+	LWLockAcquire(&bucket->lock, LW_EXCLUSIVE);
+	slot = (ZoneMapSlot *) assoc_cache_find(&zoneMap, (Pointer) bucket,
+											desc, off);
+	if (!slot)
+		slot = (ZoneMapSlot *) assoc_cache_replace(&zoneMap, (Pointer) bucket);
+
+	memcpy(slot, &summary, offsetof(ZoneMapSlot, usage));
+	pg_atomic_write_u32(&slot->usage, ZONE_MAP_MAX_USAGE);
+	LWLockRelease(&bucket->lock);
+
+	zone_map_count(ZONE_MAP_INSERTS);
+}
+
+void
+zone_map_invalidate(BTreeDescr *desc, uint64 off)
+{
+	assoc_cache_invalidate(&zoneMap, desc, off);
+}
+
+void
+zone_map_invalidate_relnode(Oid datoid, Oid relnode)
+{
+	assoc_cache_invalidate_relnode(&zoneMap, datoid, relnode);
+}
+
+/*
+ * Reports the zone map size, occupancy and the numbers of the skipped leaves.
+ */
+Datum
+orioledb_zone_map_stats(PG_FUNCTION_ARGS)
+{
+	return assoc_cache_stats(&zoneMap, fcinfo, 4);
+}
@@ -15,6 +15,8 @@
 
 #include "orioledb.h"
 
+#include "btree/btree.h"
+#include "btree/insert.h"
 #include "btree/undo.h"
 #include "s3/headers.h"
 #include "transam/undo.h"
@@ -23,6 +25,7 @@
 #include "utils/stopevent.h"
 #include "workers/bgwriter.h"
 
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "postmaster/bgworker.h"
 #include "postmaster/bgwriter.h"
@@ -31,17 +34,161 @@
 #include "storage/latch.h"
 #include "storage/proc.h"
 #include "storage/sinvaladt.h"
+#include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 #include "utils/timeout.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
 
 #include "pgstat.h"
 
+/* weight of the latest sample in the smoothed dirty pages growth */
+#define BGWRITER_SMOOTHING_SAMPLES	16
+/* the free pages history covers the last 10 minutes */
+#define BGWRITER_HISTORY_SIZE		120
+#define BGWRITER_HISTORY_INTERVAL	5000
+
+/* Progress of the clock of a background writer over a pool */
+typedef struct
+{
+	pg_atomic_uint64 regionStart;
+	pg_atomic_uint64 regionEnd;
+	pg_atomic_uint64 cursor;
+	pg_atomic_uint64 runs;
+	/* times the cursor wrapped around the region */
+	pg_atomic_uint64 passes;
+} BGWriterClockStats;
+
+typedef struct
+{
+	pg_atomic_uint64 time;
+	pg_atomic_uint64 freePages;
+	pg_atomic_uint64 dirtyPages;
+	pg_atomic_uint64 stalls;
+} BGWriterHistoryItem;
+
+typedef struct
+{
+	/* set when the background writers are woken up but not yet running */
+	pg_atomic_uint32 wakeupRequested;
+	/*
+	 * The free pages of the pools recorded by the first background writer
+	 * every BGWRITER_HISTORY_INTERVAL milliseconds.
+	 */
+	pg_atomic_uint64 historyCount;
+	BGWriterHistoryItem history[BGWRITER_HISTORY_SIZE][OPagePoolTypesCount];
+	/* latches of the running background writers */
+	Latch	   *latches[FLEXIBLE_ARRAY_MEMBER];
+} BGWriterShmem;
+
+/*
+ * State of a background writer for a page pool.  Each background writer
+ * runs the clock over its own region of the pool.
+ */
+typedef struct
+{
+	OInMemoryBlkno regionStart;
+	OInMemoryBlkno regionEnd;
+	OInMemoryBlkno cursor;
+	BGWriterClockStats *clock;
+	/* dirty pages count after the previous round */
+	OInMemoryBlkno prevDirty;
+	/* smoothed growth of the dirty pages count between the rounds */
+	double		smoothedDirtyGrowth;
+	/* free pages fell below the low watermark, evict up to the high one */
+	bool		evicting;
+} BGWriterPoolState;
+
 bool		IsBGWriter = false;
 
+static BGWriterShmem *bgwriterShmem = NULL;
+static BGWriterClockStats *bgwriterClocks = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_bgwriter_clock_stats);
+PG_FUNCTION_INFO_V1(orioledb_free_pages_history);
+
+Size
+bgwriter_shmem_needs(void)
+{
+	Size		size;
+
+	size = CACHELINEALIGN(add_size(offsetof(BGWriterShmem, latches),
+								   mul_size(bgwriter_num_workers,
+											sizeof(Latch *))));
+	size = add_size(size, mul_size(bgwriter_num_workers * OPagePoolTypesCount,
+								   sizeof(BGWriterClockStats)));
+	return size;
+}
+
+void
+bgwriter_shmem_init(Pointer ptr, bool found)
+{
+	bgwriterShmem = (BGWriterShmem *) ptr;
+	bgwriterClocks = (BGWriterClockStats *)
+		(ptr + CACHELINEALIGN(offsetof(BGWriterShmem, latches) +
+							  bgwriter_num_workers * sizeof(Latch *)));
+
+	if (!found)
+	{
+		int			i,
+					j;
+
+		pg_atomic_init_u32(&bgwriterShmem->wakeupRequested, 0);
+		pg_atomic_init_u64(&bgwriterShmem->historyCount, 0);
+		for (i = 0; i < BGWRITER_HISTORY_SIZE; i++)
+		{
+			for (j = 0; j < OPagePoolTypesCount; j++)
+			{
+				BGWriterHistoryItem *item = &bgwriterShmem->history[i][j];
+
+				pg_atomic_init_u64(&item->time, 0);
+				pg_atomic_init_u64(&item->freePages, 0);
+				pg_atomic_init_u64(&item->dirtyPages, 0);
+				pg_atomic_init_u64(&item->stalls, 0);
+			}
+		}
+		for (i = 0; i < bgwriter_num_workers; i++)
+			bgwriterShmem->latches[i] = NULL;
+		for (i = 0; i < bgwriter_num_workers * OPagePoolTypesCount; i++)
+		{
+			BGWriterClockStats *clock = &bgwriterClocks[i];
+
+			pg_atomic_init_u64(&clock->regionStart, 0);
+			pg_atomic_init_u64(&clock->regionEnd, 0);
+			pg_atomic_init_u64(&clock->cursor, 0);
+			pg_atomic_init_u64(&clock->runs, 0);
+			pg_atomic_init_u64(&clock->passes, 0);
+		}
+	}
+}
+
+/*
+ * Wakes up the background writers.  Returns true if they weren't already
+ * requested to wake up.
+ */
+bool
+bgwriter_wakeup(void)
+{
+	int			i;
+
+	if (pg_atomic_read_u32(&bgwriterShmem->wakeupRequested) != 0 ||
+		pg_atomic_exchange_u32(&bgwriterShmem->wakeupRequested, 1) != 0)
+		return false;
+
+	for (i = 0; i < bgwriter_num_workers; i++)
+	{
+		Latch	   *latch = bgwriterShmem->latches[i];
+
+		if (latch)
+			SetLatch(latch);
+	}
+	return true;
+}
+
 void
-register_bgwriter(void)
+register_bgwriter(int num)
 {
 	BackgroundWorker worker;
 
@@ -50,6 +197,7 @@ register_bgwriter(void)
 	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
 	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
 	worker.bgw_restart_time = 0;
+	worker.bgw_main_arg = Int32GetDatum(num);
 	strcpy(worker.bgw_library_name, "orioledb");
 	strcpy(worker.bgw_function_name, "bgwriter_main");
 	strcpy(worker.bgw_name, "orioledb background writer");
@@ -57,14 +205,141 @@ register_bgwriter(void)
 	RegisterBackgroundWorker(&worker);
 }
 
+/*
+ * Runs the clock over our region of the pool and publishes its progress.
+ */
+static void
+bgwriter_run_clock(OPagePool *pool, BGWriterPoolState *state, bool evict)
+{
+	OInMemoryBlkno prevCursor = state->cursor;
+
+	ppool_run_clock_region(pool, evict, &ShutdownRequestPending,
+						   state->regionStart, state->regionEnd,
+						   &state->cursor);
+
+	pg_atomic_write_u64(&state->clock->cursor, state->cursor);
+	pg_atomic_write_u64(&state->clock->runs,
+						pg_atomic_read_u64(&state->clock->runs) + 1);
+	if (state->cursor < prevCursor)
+		pg_atomic_write_u64(&state->clock->passes,
+							pg_atomic_read_u64(&state->clock->passes) + 1);
+}
+
+/*
+ * Records the free and dirty pages of the pools to the history.
+ */
+static void
+bgwriter_record_history(void)
+{
+	uint64		count = pg_atomic_read_u64(&bgwriterShmem->historyCount);
+	TimestampTz now = GetCurrentTimestamp();
+	int			i;
+
+	for (i = 0; i < OPagePoolTypesCount; i++)
+	{
+		OPagePool  *pool = get_ppool((OPagePoolType) i);
+		BGWriterHistoryItem *item;
+
+		item = &bgwriterShmem->history[count % BGWRITER_HISTORY_SIZE][i];
+		pg_atomic_write_u64(&item->time, (uint64) now);
+		pg_atomic_write_u64(&item->freePages, ppool_free_pages_count(pool));
+		pg_atomic_write_u64(&item->dirtyPages, ppool_dirty_pages_count(pool));
+		pg_atomic_write_u64(&item->stalls,
+							pg_atomic_read_u64(&pool->stats->stalls));
+	}
+	pg_write_barrier();
+	pg_atomic_write_u64(&bgwriterShmem->historyCount, count + 1);
+}
+
+/*
+ * Does a round of writes and evictions for the pool.  The amount of work is
+ * our share of the free pages deficit and of the dirty pages, which are
+ * expected over the target by the next round according to the measured
+ * growth.  That keeps the dirty ratio steady instead of swinging around the
+ * threshold.  Returns true if the pool needs another round immediately.
+ */
+static bool
+bgwriter_pool_round(OPagePool *pool, BGWriterPoolState *state)
+{
+	OInMemoryBlkno dirty = ppool_dirty_pages_count(pool),
+				freePages = ppool_free_pages_count(pool),
+				highMark = ppool_free_pages_high_mark(pool),
+				dirtyTarget = ppool_size(pool) / 2;
+	int64		maxPages = bgwriter_lru_maxpages * (BLCKSZ / ORIOLEDB_BLCKSZ),
+				evictions = 0,
+				writes = 0,
+				i;
+	double		growth,
+				expectedDirty;
+
+	/* Pick up the free pages left past the size by the pool shrink */
+	if (ppool_retire_pending(pool) > 0)
+		ppool_retire_free_pages(pool, (int) maxPages);
+
+	growth = dirty > state->prevDirty ? (double) (dirty - state->prevDirty) : 0.0;
+	state->smoothedDirtyGrowth += (growth - state->smoothedDirtyGrowth) /
+		BGWRITER_SMOOTHING_SAMPLES;
+
+	if (freePages < ppool_free_pages_low_mark(pool))
+		state->evicting = true;
+	if (state->evicting)
+	{
+		if (freePages < highMark)
+			evictions = (highMark - freePages + bgwriter_num_workers - 1) /
+				bgwriter_num_workers;
+		else
+			state->evicting = false;
+	}
+
+	expectedDirty = dirty + state->smoothedDirtyGrowth * bgwriter_lru_multiplier;
+	if (dirty > 0 && expectedDirty > dirtyTarget)
+	{
+		writes = ((int64) (expectedDirty - dirtyTarget) + bgwriter_num_workers - 1) /
+			bgwriter_num_workers;
+		writes = Min(writes, dirty);
+	}
+
+	/* Eviction goes first, since backends might wait for it */
+	evictions = Min(evictions, maxPages);
+	writes = Min(writes, maxPages - evictions);
+
+	for (i = 0; i < evictions && !ShutdownRequestPending; i++)
+	{
+		if (ppool_free_pages_count(pool) >= highMark)
+		{
+			state->evicting = false;
+			break;
+		}
+		bgwriter_run_clock(pool, state, true);
+		pg_atomic_fetch_add_u64(&pool->stats->bgwriterEvictions, 1);
+	}
+
+	for (i = 0; i < writes && !ShutdownRequestPending; i++)
+		bgwriter_run_clock(pool, state, false);
+
+	if (evictions > 0 || writes > 0)
+	{
+		MemoryContextReset(CurTransactionContext);
+		MemoryContextReset(TopTransactionContext);
+	}
+
+	state->prevDirty = ppool_dirty_pages_count(pool);
+
+	return state->evicting &&
+		ppool_free_pages_count(pool) < ppool_free_pages_low_mark(pool);
+}
+
 void
 bgwriter_main(Datum main_arg)
 {
 	OPagePool  *pool;
+	BGWriterPoolState poolStates[OPagePoolTypesCount];
+	OPagePoolType poolType;
+	int			num = DatumGetInt32(main_arg);
 	int			rc,
 				wake_events = WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT;
-	bool		need_eviction,
-				need_write;
+	bool		have_more_work = false;
+	TimestampTz lastHistoryTime = 0;
 
 	/* enable timeout for relation lock */
 	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
@@ -83,6 +358,7 @@ bgwriter_main(Datum main_arg)
 
 	/* catch SIGTERM signal for reason to not interupt background writing */
 	pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
 	BackgroundWorkerUnblockSignals();
 
 	elog(LOG, "orioledb background writer started");
@@ -101,14 +377,34 @@ bgwriter_main(Datum main_arg)
 												  "orioledb bgwriter top transaction context",
 												  ALLOCSET_DEFAULT_SIZES);
 
+	/* Background writers split each pool into disjoint regions */
+	for (poolType = 0; poolType < OPagePoolTypesCount; poolType++)
+	{
+		BGWriterPoolState *state = &poolStates[poolType];
+
+		pool = get_ppool(poolType);
+		state->regionStart = pool->offset +
+			(OInMemoryBlkno) (((uint64) pool->size * num) / bgwriter_num_workers);
+		state->regionEnd = pool->offset +
+			(OInMemoryBlkno) (((uint64) pool->size * (num + 1)) / bgwriter_num_workers);
+		state->cursor = state->regionStart;
+		state->clock = &bgwriterClocks[num * OPagePoolTypesCount + poolType];
+		pg_atomic_write_u64(&state->clock->regionStart, state->regionStart);
+		pg_atomic_write_u64(&state->clock->regionEnd, state->regionEnd);
+		pg_atomic_write_u64(&state->clock->cursor, state->cursor);
+		state->prevDirty = ppool_dirty_pages_count(pool);
+		state->smoothedDirtyGrowth = 0.0;
+		state->evicting = false;
+	}
+
 	ResetLatch(MyLatch);
+	bgwriterShmem->latches[num] = MyLatch;
 
 	PG_TRY();
 	{
 		MemoryContextSwitchTo(CurTransactionContext);
 		while (true)
 		{
-			OPagePoolType poolType;
 			UndoLocation lastUsedLocation;
 			UndoLocation writeInProgressLocation;
 			int			j;
@@ -117,44 +413,32 @@ bgwriter_main(Datum main_arg)
 				break;
 
 			/*
-			 * Sleep until we are signaled or it's time for another
-			 * checkpoint.
+			 * Sleep until we are signaled or it's time for another round.
+			 * Don't sleep if a pool is still below the low watermark after
+			 * the previous round.
 			 */
 			rc = WaitLatch(MyLatch, wake_events,
-						   BgWriterDelay,
+						   have_more_work ? 0 : BgWriterDelay,
 						   WAIT_EVENT_BGWRITER_MAIN);
 
 			if (rc & WL_POSTMASTER_DEATH)
 				ShutdownRequestPending = true;
 
+			ResetLatch(MyLatch);
+			pg_atomic_write_u32(&bgwriterShmem->wakeupRequested, 0);
+
+			if (ConfigReloadPending)
+			{
+				ConfigReloadPending = false;
+				ProcessConfigFile(PGC_SIGHUP);
+			}
+
+			have_more_work = false;
 			for (poolType = 0; poolType < OPagePoolTypesCount && !ShutdownRequestPending; poolType++)
 			{
 				pool = get_ppool(poolType);
-				need_eviction = ppool_free_pages_count(pool) < pool->size / 20;
-				need_write = ppool_dirty_pages_count(pool) > pool->size / 2;
-
-				if (need_eviction || need_write)
-				{
-					int			i = 0;
-
-					while (need_eviction || need_write)
-					{
-						ppool_run_clock(pool, need_eviction, &ShutdownRequestPending);
-						i++;
-
-						if (i >= bgwriter_lru_maxpages * (BLCKSZ / ORIOLEDB_BLCKSZ))
-							break;
-
-						if (ShutdownRequestPending)
-							break;
-
-						need_eviction = ppool_free_pages_count(pool) < pool->size / 20;
-						need_write = ppool_dirty_pages_count(pool) > pool->size / 2;
-					}
-
-					MemoryContextReset(CurTransactionContext);
-					MemoryContextReset(TopTransactionContext);
-				}
+				if (bgwriter_pool_round(pool, &poolStates[poolType]))
+					have_more_work = true;
 
 				if (!ShutdownRequestPending && ucm_epoch_needs_shift(&pool->ucm))
 				{
@@ -163,6 +447,18 @@ bgwriter_main(Datum main_arg)
 				}
 			}
 
+			/* The first writer moves the pages between the pools */
+			if (num == 0 && balance_pools && !ShutdownRequestPending)
+				ppool_balance_pools();
+			if (num == 0 && undo_adaptive_split)
+				undo_balance_split();
+			/* ... and fixes the splits broken by errors */
+			if (num == 0 && split_fix_delay >= 0)
+				o_btree_fix_broken_splits();
+			/* ... and releases the dropped trees */
+			if (num == 0)
+				o_btree_cleanup_queued_trees();
+
 			for (j = 0; j < (int) UndoLogsCount; j++)
 			{
 				UndoMeta   *undo_meta = get_undo_meta_by_type((UndoLogType) j);
@@ -183,11 +479,19 @@ bgwriter_main(Datum main_arg)
 
 			check_pending_truncates();
 
+			if (num == 0 &&
+				TimestampDifferenceExceeds(lastHistoryTime,
+										   GetCurrentTimestamp(),
+										   BGWRITER_HISTORY_INTERVAL))
+			{
+				bgwriter_record_history();
+				lastHistoryTime = GetCurrentTimestamp();
+			}
+
 			if (orioledb_s3_mode)
 				s3_headers_try_eviction_cycle();
-
-			ResetLatch(MyLatch);
 		}
+		bgwriterShmem->latches[num] = NULL;
 		elog(LOG, "orioledb bgwriter is shut down");
 	}
 	PG_CATCH();
@@ -197,3 +501,113 @@ bgwriter_main(Datum main_arg)
 	}
 	PG_END_TRY();
 }
+
+/*
+ * Reports the progress of the clock of every background writer over every
+ * pool.
+ */
+Datum
+orioledb_bgwriter_clock_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			i,
+				j;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < bgwriter_num_workers; i++)
+	{
+		for (j = 0; j < OPagePoolTypesCount; j++)
+		{
+			BGWriterClockStats *clock = &bgwriterClocks[i * OPagePoolTypesCount + j];
+			OPagePool  *pool = get_ppool((OPagePoolType) j);
+			Datum		values[7];
+			bool		nulls[7] = {false, false, false, false, false, false, false};
+
+			/* the region positions are relative to the pool */
+			values[0] = CStringGetTextDatum(get_ppool_name((OPagePoolType) j));
+			values[1] = Int32GetDatum(i);
+			values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&clock->regionStart) - pool->offset);
+			values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&clock->regionEnd) - pool->offset);
+			values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&clock->cursor) - pool->offset);
+			values[5] = Int64GetDatum((int64) pg_atomic_read_u64(&clock->runs));
+			values[6] = Int64GetDatum((int64) pg_atomic_read_u64(&clock->passes));
+			if (pg_atomic_read_u64(&clock->regionEnd) == 0)
+				nulls[2] = nulls[3] = nulls[4] = true;
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Reports the history of the free and dirty pages of the pools from the
+ * oldest to the newest record.
+ */
+Datum
+orioledb_free_pages_history(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	uint64		count,
+				i;
+	int			j;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	count = pg_atomic_read_u64(&bgwriterShmem->historyCount);
+	pg_read_barrier();
+	for (i = count > BGWRITER_HISTORY_SIZE ? count - BGWRITER_HISTORY_SIZE : 0;
+		 i < count; i++)
+	{
+		for (j = 0; j < OPagePoolTypesCount; j++)
+		{
+			BGWriterHistoryItem *item = &bgwriterShmem->history[i % BGWRITER_HISTORY_SIZE][j];
+			Datum		values[5];
+			bool		nulls[5] = {false, false, false, false, false};
+
+			values[0] = CStringGetTextDatum(get_ppool_name((OPagePoolType) j));
+			values[1] = TimestampTzGetDatum((TimestampTz) pg_atomic_read_u64(&item->time));
+			values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&item->freePages));
+			values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&item->dirtyPages));
+			values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&item->stalls));
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	return (Datum) 0;
+}
@@ -0,0 +1,473 @@
+/*-------------------------------------------------------------------------
+ *
+ * compactor.c
+ *		Routines for background data file compaction worker.
+ *
+ * After a long run of updates the leaves of a tree are scattered over the
+ * data file in the order their pages happened to be written, so the range
+ * scans of the evicted parts turn into random reads.  orioledb_compact()
+ * queues the trees of a table for this worker.  The worker walks the leaves
+ * in the key order, a limited number per round, and marks them dirty.  Then
+ * it asks the next checkpoint to write the pages of the tree at the end of
+ * the data file.  The checkpoint walks the tree in the key order, so the
+ * rewritten leaves are laid out sequentially.  The old extents are released
+ * by the checkpoint maps as for any other page rewrite, and they turn into
+ * holes if orioledb.use_sparse_files is set.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/compactor.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/find.h"
+#include "btree/io.h"
+#include "btree/page_contents.h"
+#include "catalog/o_tables.h"
+#include "checkpoint/checkpoint.h"
+#include "tableam/descr.h"
+#include "utils/page_pool.h"
+#include "utils/ucm.h"
+#include "workers/compactor.h"
+#include "workers/paced_worker.h"
+
+#include "access/htup_details.h"
+#include "access/relation.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/spin.h"
+
+#define COMPACTION_QUEUE_SIZE	(64)
+
+typedef struct
+{
+	ORelOids	oids;
+	OIndexType	type;
+} OCompactionItem;
+
+typedef struct
+{
+	/* queue of the trees requested by orioledb_compact() */
+	slock_t		lock;
+	int			head;
+	int			count;
+	OCompactionItem items[COMPACTION_QUEUE_SIZE];
+
+	/* leaf pages marked for rewrite and completely rewritten trees */
+	pg_atomic_uint64 pagesRewritten;
+	pg_atomic_uint64 treesCompacted;
+} OCompactionShared;
+
+/* State of the tree currently compacted by the worker */
+typedef struct
+{
+	OCompactionItem item;
+	OFixedKey	cursor;
+	bool		active;
+	bool		first;
+	bool		finished;
+	bool		waiting;
+} OCompactionState;
+
+bool		IsCompactionWorker = false;
+
+static OCompactionShared *compactionShared = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_compact);
+PG_FUNCTION_INFO_V1(orioledb_compaction_stats);
+
+Size
+compaction_shmem_needs(void)
+{
+	return sizeof(OCompactionShared);
+}
+
+void
+compaction_shmem_init(Pointer ptr, bool found)
+{
+	compactionShared = (OCompactionShared *) ptr;
+
+	if (!found)
+	{
+		SpinLockInit(&compactionShared->lock);
+		compactionShared->head = 0;
+		compactionShared->count = 0;
+		pg_atomic_init_u64(&compactionShared->pagesRewritten, 0);
+		pg_atomic_init_u64(&compactionShared->treesCompacted, 0);
+	}
+}
+
+/*
+ * Called by the checkpointer before the walk over the tree.  Makes the walk
+ * append the pages to the end of the data file if the compaction worker
+ * asked for it.
+ */
+void
+compaction_checkpoint_begin(BTreeDescr *desc, uint32 chkpNum)
+{
+	BTreeMetaPage *meta = BTREE_GET_META(desc);
+
+	if (pg_atomic_read_u32(&meta->compactRequest) == 0)
+		return;
+
+	meta->compactChkpNum = chkpNum;
+	pg_write_barrier();
+	pg_atomic_write_u32(&meta->compactRequest, 0);
+	btree_io_set_append_extents(desc);
+}
+
+/*
+ * Adds the tree to the queue unless it's already there.  Returns false if
+ * the queue is full.
+ */
+static bool
+compaction_queue_push(ORelOids oids, OIndexType type)
+{
+	bool		result = true;
+	int			i;
+
+	SpinLockAcquire(&compactionShared->lock);
+	for (i = 0; i < compactionShared->count; i++)
+	{
+		OCompactionItem *item;
+
+		item = &compactionShared->items[(compactionShared->head + i) % COMPACTION_QUEUE_SIZE];
+		if (ORelOidsIsEqual(item->oids, oids) && item->type == type)
+			break;
+	}
+
+	if (i >= compactionShared->count)
+	{
+		if (compactionShared->count < COMPACTION_QUEUE_SIZE)
+		{
+			OCompactionItem *item;
+
+			item = &compactionShared->items[(compactionShared->head + compactionShared->count) % COMPACTION_QUEUE_SIZE];
+			item->oids = oids;
+			item->type = type;
+			compactionShared->count++;
+		}
+		else
+		{
+			result = false;
+		}
+	}
+	SpinLockRelease(&compactionShared->lock);
+
+	return result;
+}
+
+/*
+ * Gets the head of the queue.  The item stays in the queue until the
+ * compaction of the tree is finished, so the repeated requests for it are
+ * merged.
+ */
+static bool
+compaction_queue_peek(OCompactionItem *result)
+{
+	bool		found = false;
+
+	SpinLockAcquire(&compactionShared->lock);
+	if (compactionShared->count > 0)
+	{
+		*result = compactionShared->items[compactionShared->head];
+		found = true;
+	}
+	SpinLockRelease(&compactionShared->lock);
+
+	return found;
+}
+
+static void
+compaction_queue_pop(void)
+{
+	SpinLockAcquire(&compactionShared->lock);
+	Assert(compactionShared->count > 0);
+	compactionShared->head = (compactionShared->head + 1) % COMPACTION_QUEUE_SIZE;
+	compactionShared->count--;
+	SpinLockRelease(&compactionShared->lock);
+}
+
+/*
+ * Don't push out the pages used by the foreground queries: the dirty pages
+ * evicted before the checkpoint are written to the regular free extents.
+ */
+static bool
+compaction_pool_is_full(OPagePool *pool)
+{
+	return ppool_free_pages_count(pool) < ppool_free_pages_high_mark(pool);
+}
+
+/*
+ * Marks dirty up to 'npages' leaves of the tree starting from the cursor.
+ * Returns the number of marked pages.
+ */
+static int
+compaction_tree_round(BTreeDescr *desc, OCompactionState *state, int npages)
+{
+	OBTreeFindPageContext context;
+	int			i,
+				marked = 0;
+
+	/* Our page scans shouldn't affect UCM */
+	set_skip_ucm();
+
+	for (i = 0; i < npages && !ShutdownRequestPending; i++)
+	{
+		OInMemoryBlkno blkno;
+		Page		p;
+
+		if (compaction_pool_is_full(desc->ppool))
+			break;
+
+		init_page_find_context(&context, desc, COMMITSEQNO_INPROGRESS,
+							   BTREE_PAGE_FIND_MODIFY |
+							   BTREE_PAGE_FIND_NO_FIX_SPLIT);
+		if (state->first)
+			(void) find_page(&context, NULL, BTreeKeyNone, 0);
+		else
+			(void) find_page(&context, &state->cursor.tuple,
+							 BTreeKeyNonLeafKey, 0);
+
+		blkno = context.items[context.index].blkno;
+		p = O_GET_IN_MEMORY_PAGE(blkno);
+
+		/* The pages under IO are being written anyway */
+		if (!IS_DIRTY(blkno) && O_GET_IN_MEMORY_PAGEDESC(blkno)->ionum < 0)
+		{
+			MARK_DIRTY(desc, blkno);
+			marked++;
+		}
+
+		state->first = false;
+		if (O_PAGE_IS(p, RIGHTMOST))
+			state->finished = true;
+		else
+			copy_fixed_hikey(desc, &state->cursor, p);
+		unlock_page(blkno);
+
+		if (state->finished)
+			break;
+	}
+
+	unset_skip_ucm();
+
+	return marked;
+}
+
+/*
+ * Makes a step of the compaction of the current tree: either waits for the
+ * checkpoint to rewrite the pages marked at the previous round, or marks the
+ * next portion of the pages.  Returns true when the tree is done.
+ */
+static bool
+compaction_tree_step(OCompactionState *state, int npages)
+{
+	ORelOids	oids = state->item.oids;
+	OIndexDescr *indexDescr;
+	BTreeDescr *desc;
+	BTreeMetaPage *meta;
+	bool		done = false;
+
+	if (!o_tables_rel_try_lock(&oids, AccessShareLock, NULL))
+		return false;
+
+	indexDescr = o_fetch_index_descr(oids, state->item.type, false, NULL);
+	if (!indexDescr)
+	{
+		/* The tree was dropped */
+		o_tables_rel_unlock(&oids, AccessShareLock);
+		return true;
+	}
+
+	desc = &indexDescr->desc;
+	o_btree_load_shmem(desc);
+	meta = BTREE_GET_META(desc);
+
+	if (state->waiting)
+	{
+		if (pg_atomic_read_u32(&meta->compactRequest) != 0)
+		{
+			o_tables_rel_unlock(&oids, AccessShareLock);
+			return false;
+		}
+		pg_read_barrier();
+		if (checkpoint_state->lastCheckpointNumber < meta->compactChkpNum)
+		{
+			o_tables_rel_unlock(&oids, AccessShareLock);
+			return false;
+		}
+		state->waiting = false;
+	}
+
+	if (state->finished)
+	{
+		done = true;
+	}
+	else
+	{
+		int			marked;
+
+		marked = compaction_tree_round(desc, state, npages);
+		if (marked > 0)
+		{
+			pg_atomic_fetch_add_u64(&compactionShared->pagesRewritten, marked);
+			pg_atomic_write_u32(&meta->compactRequest, 1);
+			state->waiting = true;
+		}
+		else if (state->finished)
+		{
+			done = true;
+		}
+	}
+
+	o_tables_rel_unlock(&oids, AccessShareLock);
+	ppool_release_all_pages();
+
+	return done;
+}
+
+void
+register_compaction_worker(void)
+{
+	BackgroundWorker worker;
+
+	/* Set up background worker parameters */
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = 0;
+	strcpy(worker.bgw_library_name, "orioledb");
+	strcpy(worker.bgw_function_name, "compaction_worker_main");
+	strcpy(worker.bgw_name, "orioledb compaction worker");
+	strcpy(worker.bgw_type, "orioledb compaction worker");
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * Round callback of the paced worker loop.  Takes the next queued tree if
+ * there is no current one.
+ */
+static void
+compaction_worker_round(void *arg, int npages)
+{
+	OCompactionState *state = (OCompactionState *) arg;
+
+	if (!state->active)
+	{
+		if (!compaction_queue_peek(&state->item))
+			return;
+		state->first = true;
+		state->finished = false;
+		state->waiting = false;
+		state->active = true;
+	}
+
+	if (compaction_tree_step(state, npages))
+	{
+		compaction_queue_pop();
+		pg_atomic_fetch_add_u64(&compactionShared->treesCompacted, 1);
+		state->active = false;
+	}
+}
+
+void
+compaction_worker_main(Datum main_arg)
+{
+	OCompactionState state = {0};
+	OPacedWorker worker = {0};
+
+	IsCompactionWorker = true;
+
+	worker.name = "compaction worker";
+	worker.delay = &compaction_delay;
+	worker.pages = &compaction_pages;
+	worker.pause = &compaction_pause;
+	worker.round = compaction_worker_round;
+	worker.arg = &state;
+	o_paced_worker_main(&worker);
+}
+
+/*
+ * Queues the trees of the table for the compaction.  Returns the number of
+ * queued trees.
+ */
+Datum
+orioledb_compact(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	OTableDescr *descr;
+	Relation	rel;
+	int			treen,
+				count = 0;
+
+	orioledb_check_shmem();
+
+	if (!enable_compaction)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("compaction worker is not enabled"),
+				 errhint("Set orioledb.enable_compaction and restart the server.")));
+
+	rel = relation_open(relid, AccessShareLock);
+
+	if (!is_orioledb_rel(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not an orioledb table",
+						RelationGetRelationName(rel))));
+
+	descr = relation_get_descr(rel);
+
+	for (treen = 0; treen < descr->nIndices + 1; treen++)
+	{
+		BTreeDescr *td;
+
+		if (treen < descr->nIndices)
+			td = &descr->indices[treen]->desc;
+		else
+			td = &descr->toast->desc;
+
+		if (!compaction_queue_push(td->oids, td->type))
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("compaction queue is full")));
+		count++;
+	}
+
+	relation_close(rel, AccessShareLock);
+
+	PG_RETURN_INT32(count);
+}
+
+/*
+ * Reports the progress of the compaction worker.
+ */
+Datum
+orioledb_compaction_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3] = {false, false, false};
+	int			queued;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	SpinLockAcquire(&compactionShared->lock);
+	queued = compactionShared->count;
+	SpinLockRelease(&compactionShared->lock);
+
+	values[0] = Int64GetDatum(queued);
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&compactionShared->pagesRewritten));
+	values[2] = Int64GetDatum(pg_atomic_read_u64(&compactionShared->treesCompacted));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
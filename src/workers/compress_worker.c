@@ -0,0 +1,359 @@
+/*-------------------------------------------------------------------------
+ *
+ * compress_worker.c
+ *		Routines for background page compression workers.
+ *
+ * Compression of the compressed trees pages is the most CPU-expensive part
+ * of the checkpoint, and the checkpointer does it serially with the writes.
+ * When the checkpointer descends to a leaf, it also copies the next dirty
+ * leaves of the same parent into the shared slots.  The compression workers
+ * compress them meanwhile.  When the checkpointer comes to write one of those
+ * leaves, it takes the ready result if the leaf image is still the same as
+ * the submitted copy, and compresses the image itself otherwise.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/compress_worker.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/page_contents.h"
+#include "utils/compress.h"
+#include "utils/page_pool.h"
+#include "workers/compress_worker.h"
+#include "workers/slot_queue.h"
+
+/* shared slots per compression worker */
+#define COMPRESS_WORKER_SLOTS_PER_WORKER	(8)
+/* leaves submitted ahead of the checkpointer per compression worker */
+#define COMPRESS_WORKER_WINDOW_PER_WORKER	(4)
+#define COMPRESS_WORKER_MAX_PENDING			(64)
+
+/* the queue counters besides the submitted slots */
+#define COMPRESS_WORKER_USED		(1)
+#define COMPRESS_WORKER_WASTED		(2)
+
+typedef struct
+{
+	OSlotQueueSlot header;
+	Oid			datoid;
+	Oid			relnode;
+	OCompress	compress;
+	/* compressed size, zero if the page doesn't fit the result buffer */
+	uint32		size;
+	char		image[ORIOLEDB_BLCKSZ];
+	char		result[ORIOLEDB_BLCKSZ];
+} CompressWorkerSlot;
+
+#define COMPRESS_WORKER_SLOT(index) \
+	((CompressWorkerSlot *) O_SLOT_QUEUE_SLOT(compressQueue, (index)))
+
+/* Slots submitted by this backend in the order of submission */
+typedef struct
+{
+	int			slot;
+	OInMemoryBlkno blkno;
+	Oid			datoid;
+	Oid			relnode;
+} CompressPendingSlot;
+
+bool		IsCompressWorker = false;
+
+static OSlotQueue *compressQueue = NULL;
+static CompressPendingSlot pending[COMPRESS_WORKER_MAX_PENDING];
+static int	pendingCount = 0;
+
+PG_FUNCTION_INFO_V1(orioledb_compress_worker_stats);
+
+Size
+compress_workers_shmem_needs(void)
+{
+	if (compress_workers_num == 0)
+		return 0;
+
+	return o_slot_queue_shmem_needs(compress_workers_num,
+									COMPRESS_WORKER_SLOTS_PER_WORKER,
+									sizeof(CompressWorkerSlot));
+}
+
+void
+compress_workers_shmem_init(Pointer ptr, bool found)
+{
+	if (compress_workers_num == 0)
+		return;
+
+	compressQueue = (OSlotQueue *) ptr;
+
+	if (!found)
+		o_slot_queue_init(compressQueue, compress_workers_num,
+						  COMPRESS_WORKER_SLOTS_PER_WORKER,
+						  sizeof(CompressWorkerSlot));
+}
+
+/*
+ * Compressed pages of the trees with dictionary need the dictionary file,
+ * which the workers don't load.  Such trees are compressed by the
+ * checkpointer itself.
+ */
+static bool
+compress_workers_enabled(BTreeDescr *desc)
+{
+	return compressQueue != NULL &&
+		OCompressIsValid(o_compress_tree_level(desc)) &&
+		o_compress_tree_dict_id(desc) == O_COMPRESS_DICT_NONE;
+}
+
+/*
+ * Returns the slot to the free ones, waiting for the worker if it's
+ * compressing the slot right now.
+ */
+static void
+release_slot(int index)
+{
+	if (!o_slot_queue_cancel(compressQueue, index))
+		o_slot_queue_free(compressQueue, index);
+}
+
+static void
+remove_pending(int i)
+{
+	pendingCount--;
+	memmove(&pending[i], &pending[i + 1],
+			sizeof(CompressPendingSlot) * (pendingCount - i));
+}
+
+static bool
+is_pending(OInMemoryBlkno blkno)
+{
+	int			i;
+
+	for (i = 0; i < pendingCount; i++)
+		if (pending[i].blkno == blkno)
+			return true;
+	return false;
+}
+
+/*
+ * Submits the copy of the leaf page to a free slot.  Returns false if there
+ * are no free slots.
+ */
+static bool
+submit_page(BTreeDescr *desc, OInMemoryBlkno blkno, uint32 chkpNum)
+{
+	CompressWorkerSlot *slot;
+	BTreePageHeader *header;
+	int			i;
+
+	i = o_slot_queue_acquire(compressQueue);
+	if (i < 0)
+		return false;
+	slot = COMPRESS_WORKER_SLOT(i);
+
+	slot->datoid = desc->oids.datoid;
+	slot->relnode = desc->oids.relnode;
+	slot->compress = o_compress_tree_level(desc);
+	slot->size = 0;
+	memcpy(slot->image, O_GET_IN_MEMORY_PAGE(blkno), ORIOLEDB_BLCKSZ);
+
+	/* perform_page_io() sets the same checkpoint number to the leaf image */
+	header = (BTreePageHeader *) slot->image;
+	if (header->o_header.checkpointNum < chkpNum)
+		header->o_header.checkpointNum = chkpNum;
+
+	pending[pendingCount].slot = i;
+	pending[pendingCount].blkno = blkno;
+	pending[pendingCount].datoid = desc->oids.datoid;
+	pending[pendingCount].relnode = desc->oids.relnode;
+	pendingCount++;
+
+	o_slot_queue_submit(compressQueue, i);
+	return true;
+}
+
+/*
+ * Submits the dirty leaves following the locator of the locked parent page
+ * to the compression workers.  The leaves, which are locked or have IO in
+ * progress, are skipped.
+ */
+void
+compress_workers_precompress_leaves(BTreeDescr *desc, Page parent,
+									BTreePageItemLocator *loc,
+									uint32 chkpNum)
+{
+	BTreePageItemLocator cur = *loc;
+	int			window,
+				submitted = 0;
+
+	if (!compress_workers_enabled(desc))
+		return;
+
+	window = Min(compress_workers_num * COMPRESS_WORKER_WINDOW_PER_WORKER,
+				 COMPRESS_WORKER_MAX_PENDING);
+
+	for (BTREE_PAGE_LOCATOR_NEXT(parent, &cur);
+		 BTREE_PAGE_LOCATOR_IS_VALID(parent, &cur) && submitted < window &&
+		 pendingCount < window;
+		 BTREE_PAGE_LOCATOR_NEXT(parent, &cur))
+	{
+		BTreeNonLeafTuphdr *tuphdr;
+		OInMemoryBlkno child;
+		Page		page;
+
+		tuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(parent, &cur);
+		if (!DOWNLINK_IS_IN_MEMORY(tuphdr->downlink))
+			continue;
+
+		child = DOWNLINK_GET_IN_MEMORY_BLKNO(tuphdr->downlink);
+		if (is_pending(child) || !IS_DIRTY(child) || !try_lock_page(child))
+			continue;
+
+		page = O_GET_IN_MEMORY_PAGE(child);
+		if (O_PAGE_GET_CHANGE_COUNT(page) == DOWNLINK_GET_IN_MEMORY_CHANGECOUNT(tuphdr->downlink) &&
+			O_PAGE_IS(page, LEAF) && IS_DIRTY(child) &&
+			O_GET_IN_MEMORY_PAGEDESC(child)->ionum < 0)
+		{
+			bool		done = !submit_page(desc, child, chkpNum);
+
+			unlock_page(child);
+			if (done)
+				break;
+			submitted++;
+			continue;
+		}
+		unlock_page(child);
+	}
+
+	if (submitted > 0)
+		o_slot_queue_wakeup_workers(compressQueue);
+}
+
+/*
+ * Looks for the submitted copy of the page image.  Copies the compressed
+ * image to dst and returns it if found.  Returns NULL if the page should be
+ * compressed by the caller.
+ *
+ * The checkpointer writes the leaves in the order of submission, so the
+ * copies of the same tree submitted before the found one are outdated.
+ */
+Pointer
+compress_workers_get_result(BTreeDescr *desc, Page page, Pointer dst,
+							size_t *size)
+{
+	Pointer		result = NULL;
+	bool		found = false;
+	int			i,
+				j;
+
+	if (pendingCount == 0 || !compress_workers_enabled(desc))
+		return NULL;
+
+	for (i = 0; i < pendingCount; i++)
+	{
+		CompressWorkerSlot *slot = COMPRESS_WORKER_SLOT(pending[i].slot);
+
+		if (pending[i].datoid != desc->oids.datoid ||
+			pending[i].relnode != desc->oids.relnode ||
+			slot->compress != o_compress_tree_level(desc) ||
+			memcmp(slot->image, page, ORIOLEDB_BLCKSZ) != 0)
+			continue;
+
+		/* Compress ourselves if no worker took the slot yet */
+		if (!o_slot_queue_cancel(compressQueue, pending[i].slot))
+		{
+			if (slot->size > 0)
+			{
+				memcpy(dst, slot->result, slot->size);
+				*size = slot->size;
+				result = dst;
+				pg_atomic_fetch_add_u64(&compressQueue->counters[COMPRESS_WORKER_USED], 1);
+			}
+			o_slot_queue_free(compressQueue, pending[i].slot);
+		}
+		remove_pending(i);
+		found = true;
+		break;
+	}
+
+	if (!found)
+		return NULL;
+
+	/* Release the outdated copies of the same tree */
+	for (j = i - 1; j >= 0; j--)
+	{
+		if (pending[j].datoid == desc->oids.datoid &&
+			pending[j].relnode == desc->oids.relnode)
+		{
+			release_slot(pending[j].slot);
+			remove_pending(j);
+			pg_atomic_fetch_add_u64(&compressQueue->counters[COMPRESS_WORKER_WASTED], 1);
+		}
+	}
+
+	return result;
+}
+
+/*
+ * Releases all the slots submitted by this backend.  Called after the
+ * checkpoint of the tree and on error cleanup.
+ */
+void
+compress_workers_release_all(void)
+{
+	while (pendingCount > 0)
+	{
+		release_slot(pending[pendingCount - 1].slot);
+		pendingCount--;
+		pg_atomic_fetch_add_u64(&compressQueue->counters[COMPRESS_WORKER_WASTED], 1);
+	}
+}
+
+void
+register_compress_worker(int num)
+{
+	o_slot_queue_register_worker(num, "compress_worker_main",
+								 "compression worker");
+}
+
+/*
+ * Compresses the page image of the slot taken by the worker.
+ */
+static void
+compress_worker_job(OSlotQueue *queue, OSlotQueueSlot *header)
+{
+	CompressWorkerSlot *slot = (CompressWorkerSlot *) header;
+	Pointer		result;
+	size_t		size;
+
+	result = o_compress_page(slot->image, &size, slot->compress);
+	if (size <= ORIOLEDB_BLCKSZ)
+	{
+		memcpy(slot->result, result, size);
+		slot->size = size;
+	}
+	else
+	{
+		slot->size = 0;
+	}
+}
+
+void
+compress_worker_main(Datum main_arg)
+{
+	IsCompressWorker = true;
+	o_slot_queue_worker_main(compressQueue, DatumGetInt32(main_arg),
+							 "compression worker", compress_worker_job);
+}
+
+/*
+ * Reports the usage of the compression workers.
+ */
+Datum
+orioledb_compress_worker_stats(PG_FUNCTION_ARGS)
+{
+	return o_slot_queue_stats(fcinfo, compressQueue, 3);
+}
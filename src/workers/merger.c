@@ -0,0 +1,186 @@
+/*-------------------------------------------------------------------------
+ *
+ * merger.c
+ *		Routines for background page merge worker.
+ *
+ * Page merges normally happen only as a side effect of the page eviction
+ * clock, i.e. under memory pressure.  This worker walks the page pools in
+ * the background and coalesces sparse leaves with their siblings, so the
+ * trees shrink after mass deletions even when there is plenty of memory.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/merger.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/merge.h"
+#include "btree/undo.h"
+#include "transam/undo.h"
+#include "utils/page_pool.h"
+#include "utils/ucm.h"
+#include "workers/merger.h"
+#include "workers/paced_worker.h"
+
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+
+typedef struct
+{
+	/* pages examined, pages merged and complete page pool sweeps */
+	pg_atomic_uint64 pagesScanned;
+	pg_atomic_uint64 pagesMerged;
+	pg_atomic_uint64 passes;
+} MergeWorkerStats;
+
+bool		IsMergeWorker = false;
+
+static MergeWorkerStats *mergeWorkerStats = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_merge_worker_stats);
+
+Size
+merge_worker_shmem_needs(void)
+{
+	return sizeof(MergeWorkerStats);
+}
+
+void
+merge_worker_shmem_init(Pointer ptr, bool found)
+{
+	mergeWorkerStats = (MergeWorkerStats *) ptr;
+
+	if (!found)
+	{
+		pg_atomic_init_u64(&mergeWorkerStats->pagesScanned, 0);
+		pg_atomic_init_u64(&mergeWorkerStats->pagesMerged, 0);
+		pg_atomic_init_u64(&mergeWorkerStats->passes, 0);
+	}
+}
+
+void
+register_merge_worker(void)
+{
+	BackgroundWorker worker;
+
+	/* Set up background worker parameters */
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time = 0;
+	strcpy(worker.bgw_library_name, "orioledb");
+	strcpy(worker.bgw_function_name, "merge_worker_main");
+	strcpy(worker.bgw_name, "orioledb merge worker");
+	strcpy(worker.bgw_type, "orioledb merge worker");
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * Examine up to 'npages' pages of the pool starting from '*cursor'.
+ */
+static void
+merge_worker_round(OPagePool *pool, OInMemoryBlkno *cursor, int npages,
+				   uint64 *merged)
+{
+	int			i;
+
+	/* Merges need undo to save page images */
+	reserve_undo_size(UndoLogRegularPageLevel, 2 * O_MERGE_UNDO_IMAGE_SIZE);
+	reserve_undo_size(UndoLogSystem, 2 * O_MERGE_UNDO_IMAGE_SIZE);
+
+	/* Our page scans shouldn't affect UCM */
+	set_skip_ucm();
+
+	for (i = 0; i < npages && !ShutdownRequestPending; i++)
+	{
+		Assert(*cursor >= pool->offset && *cursor < pool->offset + pool->size);
+
+		if (btree_try_merge_sparse_page(*cursor))
+			(*merged)++;
+		Assert(!have_locked_pages());
+
+		(*cursor)++;
+		if (*cursor >= pool->offset + pool->size)
+		{
+			*cursor = pool->offset;
+			pg_atomic_fetch_add_u64(&mergeWorkerStats->passes, 1);
+		}
+	}
+
+	unset_skip_ucm();
+
+	release_undo_size(UndoLogRegularPageLevel);
+	release_undo_size(UndoLogSystem);
+	free_retained_undo_location(UndoLogRegularPageLevel);
+	free_retained_undo_location(UndoLogSystem);
+
+	pg_atomic_fetch_add_u64(&mergeWorkerStats->pagesScanned, i);
+}
+
+/*
+ * Round callback of the paced worker loop.  Splits the per-round budget
+ * between the pools.
+ */
+static void
+merge_worker_pools_round(void *arg, int npages)
+{
+	OInMemoryBlkno *cursors = (OInMemoryBlkno *) arg;
+	OPagePoolType poolType;
+	uint64		merged = 0;
+
+	for (poolType = 0; poolType < OPagePoolTypesCount && !ShutdownRequestPending; poolType++)
+		merge_worker_round(get_ppool(poolType), &cursors[poolType],
+						   Max(npages / OPagePoolTypesCount, 1),
+						   &merged);
+
+	if (merged > 0)
+		pg_atomic_fetch_add_u64(&mergeWorkerStats->pagesMerged, merged);
+}
+
+void
+merge_worker_main(Datum main_arg)
+{
+	OInMemoryBlkno cursors[OPagePoolTypesCount];
+	OPagePoolType poolType;
+	OPacedWorker worker = {0};
+
+	IsMergeWorker = true;
+
+	for (poolType = 0; poolType < OPagePoolTypesCount; poolType++)
+		cursors[poolType] = get_ppool(poolType)->offset;
+
+	worker.name = "merge worker";
+	worker.delay = &background_merge_delay;
+	worker.pages = &background_merge_pages;
+	worker.round = merge_worker_pools_round;
+	worker.arg = cursors;
+	o_paced_worker_main(&worker);
+}
+
+/*
+ * Reports the progress of the background merge worker.
+ */
+Datum
+orioledb_merge_worker_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3] = {false, false, false};
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = Int64GetDatum(pg_atomic_read_u64(&mergeWorkerStats->pagesScanned));
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&mergeWorkerStats->pagesMerged));
+	values[2] = Int64GetDatum(pg_atomic_read_u64(&mergeWorkerStats->passes));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
@@ -0,0 +1,80 @@
+/*-------------------------------------------------------------------------
+ *
+ * op_sampler.c
+ *		Routines for background worker sampling OrioleDB operations.
+ *
+ * The worker doesn't touch the trees, it only copies the operations of the
+ * processes to the ring buffer of utils/op_sampling.c every
+ * orioledb.op_sampling_period milliseconds.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/op_sampler.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "utils/op_sampling.h"
+#include "workers/op_sampler.h"
+
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/latch.h"
+
+#include "pgstat.h"
+
+void
+register_op_sampler(void)
+{
+	BackgroundWorker worker;
+
+	/* Set up background worker parameters */
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time = 1;
+	strcpy(worker.bgw_library_name, "orioledb");
+	strcpy(worker.bgw_function_name, "op_sampler_main");
+	strcpy(worker.bgw_name, "orioledb op sampler");
+	strcpy(worker.bgw_type, "orioledb op sampler");
+	RegisterBackgroundWorker(&worker);
+}
+
+void
+op_sampler_main(Datum main_arg)
+{
+	int			rc,
+				wake_events = WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT;
+
+	pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	BackgroundWorkerUnblockSignals();
+
+	elog(LOG, "orioledb op sampler started");
+
+	while (!ShutdownRequestPending)
+	{
+		rc = WaitLatch(MyLatch, wake_events, op_sampling_period,
+					   PG_WAIT_EXTENSION);
+
+		if (rc & WL_POSTMASTER_DEATH)
+			break;
+
+		ResetLatch(MyLatch);
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		op_sampling_collect();
+	}
+
+	elog(LOG, "orioledb op sampler is shut down");
+}
@@ -0,0 +1,137 @@
+/*-------------------------------------------------------------------------
+ *
+ * paced_worker.c
+ *		Setup of the background workers and the main loop of those doing
+ *		their work in rounds.
+ *
+ * The merge, compaction and verify workers walk the trees in the
+ * background.  Each round examines a limited number of pages, and the
+ * worker sleeps between the rounds, so the walk has a bounded impact on the
+ * foreground load.  Both limits are set by the worker's GUCs.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/paced_worker.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "workers/paced_worker.h"
+
+#include "access/xlog.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/sinvaladt.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+#include "utils/timeout.h"
+
+#include "pgstat.h"
+
+/*
+ * Sets up the background worker process accessing the trees: the relation
+ * locks, the cache invalidation, pg_stat_activity entry and the transaction
+ * memory contexts.  The 'termHandler' is the SIGTERM handler.
+ */
+void
+o_worker_setup(void (*termHandler) (SIGNAL_ARGS))
+{
+	/* enable timeout for relation lock */
+	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
+
+	/* enable relation cache invalidation (remove old OTableDescr) */
+	RelationCacheInitialize();
+	InitCatalogCache();
+	SharedInvalBackendInit(false);
+
+	/* show the worker in pg_stat_activity */
+	InitializeSessionUserIdStandalone();
+	pgstat_beinit();
+	pgstat_bestart();
+
+	SetProcessingMode(NormalProcessing);
+
+	pqsignal(SIGTERM, termHandler);
+	BackgroundWorkerUnblockSignals();
+
+	CurTransactionContext = AllocSetContextCreate(TopMemoryContext,
+												  "orioledb worker current transaction context",
+												  ALLOCSET_DEFAULT_SIZES);
+	TopTransactionContext = AllocSetContextCreate(TopMemoryContext,
+												  "orioledb worker top transaction context",
+												  ALLOCSET_DEFAULT_SIZES);
+}
+
+/*
+ * Sets up the worker process and runs the rounds until the shutdown request.
+ */
+void
+o_paced_worker_main(OPacedWorker *worker)
+{
+	int			rc,
+				wake_events = WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	o_worker_setup(SignalHandlerForShutdownRequest);
+
+	elog(LOG, "orioledb %s started", worker->name);
+
+	ResetLatch(MyLatch);
+
+	PG_TRY();
+	{
+		MemoryContextSwitchTo(CurTransactionContext);
+		while (true)
+		{
+			if (ShutdownRequestPending)
+				break;
+
+			rc = WaitLatch(MyLatch, wake_events,
+						   *worker->delay,
+						   PG_WAIT_EXTENSION);
+
+			if (rc & WL_POSTMASTER_DEATH)
+				ShutdownRequestPending = true;
+
+			ResetLatch(MyLatch);
+
+			if (ConfigReloadPending)
+			{
+				ConfigReloadPending = false;
+				ProcessConfigFile(PGC_SIGHUP);
+			}
+
+			/*
+			 * Leave the trees to the recovery workers during the recovery.
+			 * The paused worker just keeps waking up for the GUC changes.
+			 */
+			if (ShutdownRequestPending || RecoveryInProgress() ||
+				(worker->pause && *worker->pause))
+				continue;
+
+			worker->round(worker->arg, *worker->pages);
+
+			MemoryContextReset(CurTransactionContext);
+			MemoryContextReset(TopTransactionContext);
+		}
+
+		if (worker->shutdown)
+			worker->shutdown(worker->arg);
+		elog(LOG, "orioledb %s is shut down", worker->name);
+	}
+	PG_CATCH();
+	{
+		if (worker->error)
+			worker->error(worker->arg);
+		LockReleaseSession(DEFAULT_LOCKMETHOD);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
@@ -0,0 +1,905 @@
+/*-------------------------------------------------------------------------
+ *
+ * prewarm.c
+ *		Routines for saving and restoring the hot page set.
+ *
+ * After a restart the page pool is empty, and the hot pages are faulted in
+ * one by one by the foreground queries.  Each checkpoint saves the list of
+ * the hot pages of the main pool: their tree oids and the extents they were
+ * read from.  After the recovery the prewarm worker walks the trees from
+ * their roots and loads the pages whose downlinks still point to the saved
+ * extents.  The reads of the children of each internal page are issued as
+ * prefetches in the extent order before loading, so they proceed in parallel.
+ *
+ * The trees having only the cold pages in the pool are saved too, with the
+ * invalid extent.  Each worker first initializes the shared memory of all
+ * its saved trees: reads their meta and seq buffers, which the first queries
+ * would otherwise do one by one.  Then it loads the hot pages.  The trees are
+ * spread among orioledb.prewarm_workers workers.
+ *
+ * The extents don't match between the primary and its standbys, so for the
+ * standbys the primary logs the hot leaves by their hikeys instead.  The
+ * standby saves them on replay, and the replica prewarm worker loads the
+ * leaves with these hikeys till the promotion, so the failover target
+ * arrives warm.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/prewarm.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/find.h"
+#include "btree/io.h"
+#include "btree/page_contents.h"
+#include "btree/walk.h"
+#include "catalog/o_tables.h"
+#include "catalog/sys_trees.h"
+#include "tableam/descr.h"
+#include "utils/page_pool.h"
+#include "utils/ucm.h"
+#include "workers/paced_worker.h"
+#include "workers/prewarm.h"
+
+#include "access/xlog.h"
+#include "access/xloginsert.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/fd.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "tcop/tcopprot.h"
+#include "utils/memutils.h"
+
+#include "pgstat.h"
+
+#include <sys/stat.h>
+
+#define PREWARM_FILENAME		ORIOLEDB_DATA_DIR "/prewarm"
+#define PREWARM_TMP_FILENAME	PREWARM_FILENAME ".tmp"
+#define PREWARM_MAGIC			(0x4F505257)
+
+#define PREWARM_REPLICA_FILENAME		ORIOLEDB_DATA_DIR "/prewarm_replica"
+#define PREWARM_REPLICA_TMP_FILENAME	PREWARM_REPLICA_FILENAME ".tmp"
+
+/* Number of the pool pages scanned per batch of the prewarm dump */
+#define PREWARM_DUMP_BATCH		(4096)
+
+/* Limit of the hot page list data per WAL record */
+#define PREWARM_WAL_RECORD_SIZE	(0x10000)
+
+/* Interval between the checks of the replica hot page list in ms */
+#define PREWARM_REPLICA_NAPTIME	(10000)
+
+#define PREWARM_WAL_FIRST		(1)
+#define PREWARM_WAL_LAST		(2)
+
+/*
+ * Pages at the lower usage levels are the next eviction candidates, so they
+ * are not worth saving.  Loaded pages start at this level.
+ */
+#define PREWARM_MIN_USAGE_LEVEL	(2)
+
+typedef struct
+{
+	uint32		magic;
+	uint32		count;
+} OPrewarmHeader;
+
+typedef struct
+{
+	ORelOids	oids;
+	uint32		type;
+	uint64		extentOff;
+} OPrewarmItem;
+
+/*
+ * Hot leaf in the WAL and in the replica file.  Followed by the hikey data,
+ * zero length stands for the rightmost leaf.
+ */
+typedef struct
+{
+	uint8		datoid[sizeof(Oid)];
+	uint8		reloid[sizeof(Oid)];
+	uint8		relnode[sizeof(Oid)];
+	uint8		type;
+	uint8		formatFlags;
+	uint8		length[sizeof(OffsetNumber)];
+} OPrewarmWALItem;
+
+bool		IsPrewarmWorker = false;
+
+PG_FUNCTION_INFO_V1(orioledb_prewarm_dump);
+PG_FUNCTION_INFO_V1(orioledb_prewarm_load);
+
+static int
+prewarm_item_cmp(const void *a, const void *b)
+{
+	const OPrewarmItem *item1 = (const OPrewarmItem *) a;
+	const OPrewarmItem *item2 = (const OPrewarmItem *) b;
+	int			cmp;
+
+	cmp = memcmp(&item1->oids, &item2->oids, sizeof(ORelOids));
+	if (cmp != 0)
+		return cmp;
+	if (item1->type != item2->type)
+		return item1->type < item2->type ? -1 : 1;
+	if (item1->extentOff != item2->extentOff)
+		return item1->extentOff < item2->extentOff ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Sorts the items and keeps a single item per a tree without hot pages.
+ * Returns the new number of the items.
+ */
+static uint32
+prewarm_items_sort(OPrewarmItem *items, uint32 count)
+{
+	uint32		i,
+				j = 1;
+
+	if (count == 0)
+		return 0;
+
+	pg_qsort(items, count, sizeof(OPrewarmItem), prewarm_item_cmp);
+
+	for (i = 1; i < count; i++)
+	{
+		if (!FileExtentOffIsValid(items[i].extentOff) &&
+			ORelOidsIsEqual(items[i].oids, items[j - 1].oids) &&
+			items[i].type == items[j - 1].type)
+			continue;
+		items[j++] = items[i];
+	}
+	return j;
+}
+
+static bool
+prewarm_page_is_hot(Page p, uint32 epoch)
+{
+	uint32		usageCount;
+
+	usageCount = O_PAGE_STATE_GET_USAGE_COUNT(pg_atomic_read_u64(&(O_PAGE_HEADER(p)->state)));
+	return usageCount < UCM_USAGE_LEVELS &&
+		(UCM_USAGE_LEVELS + usageCount - epoch) % UCM_USAGE_LEVELS >= PREWARM_MIN_USAGE_LEVEL;
+}
+
+/*
+ * Sorts the batch of the items and appends it to the prewarm file.
+ */
+static bool
+prewarm_write_batch(File file, OPrewarmItem *items, uint32 count,
+					off_t *offset, uint32 *total)
+{
+	Size		length;
+
+	count = prewarm_items_sort(items, count);
+	length = sizeof(OPrewarmItem) * count;
+	if (FileWrite(file, (Pointer) items, length, *offset,
+				  WAIT_EVENT_DATA_FILE_WRITE) != length)
+		return false;
+	*offset += length;
+	*total += count;
+	return true;
+}
+
+/*
+ * Saves the hot pages of the main pool.  Called after the checkpoint, so the
+ * saved extents match the downlinks of the checkpointed trees.  Page
+ * descriptors are read without locks: the result is only a hint.  The pool
+ * is scanned in batches of PREWARM_DUMP_BATCH items, each batch is sorted and
+ * appended to the file, so the memory used doesn't depend on the pool size.
+ * prewarm_read_file() sorts the whole list.  Returns the number of saved
+ * pages or -1 on failure.
+ */
+int64
+prewarm_dump_hot_pages(void)
+{
+	OPagePool  *pool = get_ppool(OPagePoolMain);
+	uint32		epoch = pg_atomic_read_u32(pool->ucm.epoch);
+	OPrewarmItem *items;
+	OPrewarmHeader header;
+	OInMemoryBlkno blkno;
+	uint32		count = 0,
+				total = 0;
+	off_t		offset = sizeof(OPrewarmHeader);
+	File		file;
+	bool		success = true;
+
+	file = PathNameOpenFile(PREWARM_TMP_FILENAME,
+							O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (file < 0)
+	{
+		ereport(LOG, (errcode_for_file_access(),
+					  errmsg("could not open prewarm file %s: %m",
+							 PREWARM_TMP_FILENAME)));
+		return -1;
+	}
+
+	items = (OPrewarmItem *) palloc(sizeof(OPrewarmItem) * PREWARM_DUMP_BATCH);
+
+	for (blkno = pool->offset; blkno < pool->offset + pool->size && success; blkno++)
+	{
+		Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+		OrioleDBPageDesc *pageDesc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+		OPrewarmItem *item = &items[count];
+
+		item->oids = pageDesc->oids;
+		item->type = pageDesc->type;
+		if (!ORelOidsIsValid(item->oids) || IS_SYS_TREE_OIDS(item->oids) ||
+			item->type == oIndexInvalid)
+			continue;
+
+		if (!prewarm_page_is_hot(p, epoch))
+			item->extentOff = InvalidFileExtentOff;
+		else
+			item->extentOff = pageDesc->fileExtent.off;
+
+		if (++count == PREWARM_DUMP_BATCH)
+		{
+			success = prewarm_write_batch(file, items, count, &offset, &total);
+			count = 0;
+		}
+	}
+	if (success && count > 0)
+		success = prewarm_write_batch(file, items, count, &offset, &total);
+	pfree(items);
+
+	header.magic = PREWARM_MAGIC;
+	header.count = total;
+	if (success &&
+		(FileWrite(file, (Pointer) &header, sizeof(header), 0,
+				   WAIT_EVENT_DATA_FILE_WRITE) != sizeof(header) ||
+		 FileSync(file, WAIT_EVENT_DATA_FILE_SYNC) != 0))
+		success = false;
+
+	if (!success)
+	{
+		ereport(LOG, (errcode_for_file_access(),
+					  errmsg("could not write prewarm file %s: %m",
+							 PREWARM_TMP_FILENAME)));
+		FileClose(file);
+		return -1;
+	}
+	FileClose(file);
+
+	if (durable_rename(PREWARM_TMP_FILENAME, PREWARM_FILENAME, LOG) != 0)
+		return -1;
+	return total;
+}
+
+static OPrewarmItem *
+prewarm_read_file(uint32 *count)
+{
+	OPrewarmHeader header;
+	OPrewarmItem *items;
+	File		file;
+	Size		length;
+
+	file = PathNameOpenFile(PREWARM_FILENAME, O_RDONLY | PG_BINARY);
+	if (file < 0)
+	{
+		if (errno != ENOENT)
+			ereport(LOG, (errcode_for_file_access(),
+						  errmsg("could not open prewarm file %s: %m",
+								 PREWARM_FILENAME)));
+		return NULL;
+	}
+
+	if (FileRead(file, (Pointer) &header, sizeof(header), 0,
+				 WAIT_EVENT_DATA_FILE_READ) != sizeof(header) ||
+		header.magic != PREWARM_MAGIC)
+	{
+		ereport(LOG, (errmsg("invalid prewarm file %s", PREWARM_FILENAME)));
+		FileClose(file);
+		return NULL;
+	}
+
+	length = sizeof(OPrewarmItem) * header.count;
+	items = (OPrewarmItem *) MemoryContextAllocHuge(CurrentMemoryContext,
+													Max(length, 1));
+	if (FileRead(file, (Pointer) items, length, sizeof(header),
+				 WAIT_EVENT_DATA_FILE_READ) != length)
+	{
+		ereport(LOG, (errmsg("invalid prewarm file %s", PREWARM_FILENAME)));
+		FileClose(file);
+		pfree(items);
+		return NULL;
+	}
+	FileClose(file);
+
+	/* The file consists of the sorted batches */
+	*count = prewarm_items_sort(items, header.count);
+	return items;
+}
+
+static bool
+prewarm_is_hot(OPrewarmItem *items, uint32 count, uint64 downlink)
+{
+	OPrewarmItem key;
+
+	if (!DOWNLINK_IS_ON_DISK(downlink))
+		return false;
+
+	key = items[0];
+	key.extentOff = DOWNLINK_GET_DISK_OFF(downlink);
+	return bsearch(&key, items, count, sizeof(OPrewarmItem),
+				   prewarm_item_cmp) != NULL;
+}
+
+/*
+ * Don't push out the pages, which are already used by the foreground
+ * queries.  Stop when the free pages are below the background writers
+ * target.
+ */
+static bool
+prewarm_pool_is_full(OPagePool *pool)
+{
+	return ppool_free_pages_count(pool) < ppool_free_pages_high_mark(pool);
+}
+
+typedef struct
+{
+	OPrewarmItem *items;
+	uint32		count;
+	int64		loaded;
+} PrewarmWalkArg;
+
+/*
+ * Issues the reads of all the hot children of the internal page before
+ * loading them one by one.
+ */
+static bool
+prewarm_walk_page(BTreeDescr *desc, Page img, uint16 level, void *arg)
+{
+	PrewarmWalkArg *walkArg = (PrewarmWalkArg *) arg;
+	BTreePageItemLocator loc;
+
+	if (prewarm_pool_is_full(desc->ppool))
+		return false;
+
+	BTREE_PAGE_FOREACH_ITEMS(img, &loc)
+	{
+		BTreeNonLeafTuphdr *tuphdr;
+
+		tuphdr = (BTreeNonLeafTuphdr *) BTREE_PAGE_LOCATOR_GET_ITEM(img, &loc);
+		if (prewarm_is_hot(walkArg->items, walkArg->count, tuphdr->downlink))
+			prefetch_page_from_disk(desc, tuphdr->downlink);
+	}
+	return true;
+}
+
+/*
+ * Loads the hot children.  Hot pages might be also found under the
+ * in-memory internal pages.
+ */
+static OBTreeWalkAction
+prewarm_walk_downlink(BTreeDescr *desc, uint16 level, uint64 downlink,
+					  void *arg)
+{
+	PrewarmWalkArg *walkArg = (PrewarmWalkArg *) arg;
+	bool		hot;
+
+	if (prewarm_pool_is_full(desc->ppool))
+		return OBTreeWalkStop;
+
+	hot = prewarm_is_hot(walkArg->items, walkArg->count, downlink);
+	if (!hot && !(level > 1 && DOWNLINK_IS_IN_MEMORY(downlink)))
+		return OBTreeWalkSkip;
+
+	if (hot)
+		walkArg->loaded++;
+	return OBTreeWalkDescend;
+}
+
+/*
+ * Initializes the shared memory of the saved tree.
+ */
+static void
+prewarm_init_tree(OPrewarmItem *item)
+{
+	ORelOids	oids = item->oids;
+	OIndexDescr *indexDescr;
+
+	CHECK_FOR_INTERRUPTS();
+
+	if (!o_tables_rel_try_lock(&oids, AccessShareLock, NULL))
+		return;
+
+	indexDescr = o_fetch_index_descr(oids, (OIndexType) item->type,
+									 false, NULL);
+	if (indexDescr)
+		o_btree_load_shmem(&indexDescr->desc);
+
+	o_tables_rel_unlock(&oids, AccessShareLock);
+}
+
+static int64
+prewarm_tree(OPrewarmItem *items, uint32 count)
+{
+	ORelOids	oids = items[0].oids;
+	OIndexDescr *indexDescr;
+	PrewarmWalkArg walkArg;
+
+	if (!o_tables_rel_try_lock(&oids, AccessShareLock, NULL))
+		return 0;
+
+	walkArg.items = items;
+	walkArg.count = count;
+	walkArg.loaded = 0;
+
+	indexDescr = o_fetch_index_descr(oids, (OIndexType) items[0].type,
+									 false, NULL);
+	if (indexDescr)
+	{
+		OBTreeWalker walker = {
+			.page = prewarm_walk_page,
+			.downlink = prewarm_walk_downlink,
+			.arg = &walkArg
+		};
+
+		o_btree_walk_internal_pages(&indexDescr->desc, &walker);
+	}
+
+	o_tables_rel_unlock(&oids, AccessShareLock);
+
+	return walkArg.loaded;
+}
+
+static uint32
+prewarm_tree_end(OPrewarmItem *items, uint32 count, uint32 start)
+{
+	uint32		end;
+
+	for (end = start + 1; end < count; end++)
+	{
+		if (!ORelOidsIsEqual(items[start].oids, items[end].oids) ||
+			items[start].type != items[end].type)
+			break;
+	}
+	return end;
+}
+
+/*
+ * Loads the pages saved by the last checkpoint.  The worker 'num' of
+ * 'nworkers' takes every nworkers-th tree.  Returns the number of the loaded
+ * pages.
+ */
+int64
+prewarm_load_hot_pages(int num, int nworkers)
+{
+	OPrewarmItem *items;
+	uint32		count = 0,
+				start,
+				end,
+				treeNum;
+	int64		loaded = 0;
+
+	items = prewarm_read_file(&count);
+	if (!items)
+		return 0;
+
+	/* Initialize the trees first, they are the first to be accessed */
+	for (start = 0, treeNum = 0; start < count; start = end, treeNum++)
+	{
+		end = prewarm_tree_end(items, count, start);
+		if (treeNum % nworkers != num)
+			continue;
+
+		if (prewarm_pool_is_full(get_ppool(OPagePoolMain)))
+			break;
+		prewarm_init_tree(&items[start]);
+		ppool_release_all_pages();
+	}
+
+	for (start = 0, treeNum = 0; start < count; start = end, treeNum++)
+	{
+		end = prewarm_tree_end(items, count, start);
+		if (treeNum % nworkers != num ||
+			!FileExtentOffIsValid(items[start].extentOff))
+			continue;
+
+		if (prewarm_pool_is_full(get_ppool(OPagePoolMain)))
+			break;
+		loaded += prewarm_tree(&items[start], end - start);
+		ppool_release_all_pages();
+	}
+
+	pfree(items);
+	return loaded;
+}
+
+static void
+prewarm_log_hot_pages_record(Pointer buf, Size length, uint8 flags)
+{
+	XLogBeginInsert();
+	XLogRegisterData((char *) &flags, sizeof(flags));
+	if (length > 0)
+		XLogRegisterData(buf, length);
+	(void) XLogInsert(ORIOLEDB_RMGR_ID, ORIOLEDB_XLOG_HOT_PAGES);
+}
+
+/*
+ * Logs the hikeys of the hot leaves of the main pool for the standbys.  The
+ * leaves are copied without locks using the page state protocol, the ones
+ * being modified are skipped: the result is only a hint.  Returns the number
+ * of logged leaves.
+ */
+int64
+prewarm_log_hot_pages(void)
+{
+	OPagePool  *pool = get_ppool(OPagePoolMain);
+	uint32		epoch = pg_atomic_read_u32(pool->ucm.epoch);
+	Pointer		buf = palloc(PREWARM_WAL_RECORD_SIZE);
+	Page		img = palloc(ORIOLEDB_BLCKSZ);
+	OInMemoryBlkno blkno;
+	Size		length = 0;
+	uint8		flags = PREWARM_WAL_FIRST;
+	int64		count = 0;
+
+	for (blkno = pool->offset; blkno < pool->offset + pool->size; blkno++)
+	{
+		Page		p = O_GET_IN_MEMORY_PAGE(blkno);
+		OrioleDBPageDesc *pageDesc = O_GET_IN_MEMORY_PAGEDESC(blkno);
+		ORelOids	oids = pageDesc->oids;
+		OIndexType	type = pageDesc->type;
+		PartialPageState partial;
+		OPrewarmWALItem item;
+		OTuple		hikey;
+		OffsetNumber hikeySize = 0;
+
+		if (!ORelOidsIsValid(oids) || IS_SYS_TREE_OIDS(oids) ||
+			type == oIndexInvalid || !O_PAGE_IS(p, LEAF) ||
+			!prewarm_page_is_hot(p, epoch))
+			continue;
+
+		if (o_btree_try_read_page(NULL, blkno, O_PAGE_GET_CHANGE_COUNT(p),
+								  img, COMMITSEQNO_INPROGRESS, NULL,
+								  BTreeKeyNone, &partial, true,
+								  NULL) != ReadPageResultOK ||
+			!O_PAGE_IS(img, LEAF) || !ORelOidsIsEqual(oids, pageDesc->oids))
+			continue;
+
+		if (!O_PAGE_IS(img, RIGHTMOST))
+		{
+			BTREE_PAGE_GET_HIKEY(hikey, img);
+			hikeySize = BTREE_PAGE_GET_HIKEY_SIZE(img);
+		}
+
+		if (length + sizeof(item) + hikeySize > PREWARM_WAL_RECORD_SIZE)
+		{
+			prewarm_log_hot_pages_record(buf, length, flags);
+			flags = 0;
+			length = 0;
+		}
+
+		memcpy(item.datoid, &oids.datoid, sizeof(Oid));
+		memcpy(item.reloid, &oids.reloid, sizeof(Oid));
+		memcpy(item.relnode, &oids.relnode, sizeof(Oid));
+		item.type = (uint8) type;
+		item.formatFlags = hikeySize > 0 ? hikey.formatFlags : 0;
+		memcpy(item.length, &hikeySize, sizeof(OffsetNumber));
+		memcpy(buf + length, &item, sizeof(item));
+		length += sizeof(item);
+		if (hikeySize > 0)
+		{
+			memcpy(buf + length, hikey.data, hikeySize);
+			length += hikeySize;
+		}
+		count++;
+	}
+	prewarm_log_hot_pages_record(buf, length, flags | PREWARM_WAL_LAST);
+
+	pfree(buf);
+	pfree(img);
+	return count;
+}
+
+/*
+ * Saves the hot leaves logged by the primary for the replica prewarm worker.
+ * The file is replaced once the last record of the list is replayed.
+ */
+void
+prewarm_redo_hot_pages(XLogReaderState *record)
+{
+	Pointer		data = XLogRecGetData(record);
+	Size		length = XLogRecGetDataLen(record) - 1;
+	uint8		flags = *((uint8 *) data);
+	File		file;
+	int			fileFlags = O_WRONLY | O_CREAT | PG_BINARY;
+
+	if (!replica_prewarm)
+		return;
+
+	if (flags & PREWARM_WAL_FIRST)
+		fileFlags |= O_TRUNC;
+	file = PathNameOpenFile(PREWARM_REPLICA_TMP_FILENAME, fileFlags);
+	if (file < 0)
+	{
+		ereport(LOG, (errcode_for_file_access(),
+					  errmsg("could not open prewarm file %s: %m",
+							 PREWARM_REPLICA_TMP_FILENAME)));
+		return;
+	}
+
+	if (length > 0 &&
+		FileWrite(file, data + 1, length, FileSize(file),
+				  WAIT_EVENT_DATA_FILE_WRITE) != length)
+	{
+		ereport(LOG, (errcode_for_file_access(),
+					  errmsg("could not write prewarm file %s: %m",
+							 PREWARM_REPLICA_TMP_FILENAME)));
+		FileClose(file);
+		return;
+	}
+	FileClose(file);
+
+	if (flags & PREWARM_WAL_LAST)
+		(void) durable_rename(PREWARM_REPLICA_TMP_FILENAME,
+							  PREWARM_REPLICA_FILENAME, LOG);
+}
+
+static int
+prewarm_wal_item_cmp(const void *a, const void *b)
+{
+	const OPrewarmWALItem *item1 = *((OPrewarmWALItem *const *) a);
+	const OPrewarmWALItem *item2 = *((OPrewarmWALItem *const *) b);
+
+	return memcmp(item1, item2, offsetof(OPrewarmWALItem, formatFlags));
+}
+
+/*
+ * Loads the hot leaves of the primary saved by the last replayed list.
+ * Returns the number of the loaded leaves.
+ */
+static int64
+prewarm_load_replica_pages(void)
+{
+	OPrewarmWALItem **items;
+	OBTreeFindPageContext *context;
+	Pointer		data;
+	Pointer		ptr;
+	File		file;
+	off_t		length;
+	uint32		count = 0,
+				start,
+				end;
+	int64		loaded = 0;
+
+	file = PathNameOpenFile(PREWARM_REPLICA_FILENAME, O_RDONLY | PG_BINARY);
+	if (file < 0)
+		return 0;
+
+	length = FileSize(file);
+	data = (Pointer) MemoryContextAllocHuge(CurrentMemoryContext,
+											Max(length, 1));
+	if (length < 0 ||
+		FileRead(file, data, length, 0, WAIT_EVENT_DATA_FILE_READ) != length)
+	{
+		ereport(LOG, (errmsg("invalid prewarm file %s",
+							 PREWARM_REPLICA_FILENAME)));
+		FileClose(file);
+		pfree(data);
+		return 0;
+	}
+	FileClose(file);
+
+	items = (OPrewarmWALItem **) MemoryContextAllocHuge(CurrentMemoryContext,
+														sizeof(OPrewarmWALItem *) *
+														(length / sizeof(OPrewarmWALItem) + 1));
+	for (ptr = data; ptr + sizeof(OPrewarmWALItem) <= data + length;)
+	{
+		OffsetNumber keyLength;
+
+		items[count] = (OPrewarmWALItem *) ptr;
+		memcpy(&keyLength, items[count]->length, sizeof(OffsetNumber));
+		ptr += sizeof(OPrewarmWALItem) + keyLength;
+		if (ptr > data + length)
+			break;
+		count++;
+	}
+
+	/* Group the leaves by the trees */
+	pg_qsort(items, count, sizeof(OPrewarmWALItem *), prewarm_wal_item_cmp);
+
+	context = palloc(sizeof(OBTreeFindPageContext));
+	for (start = 0; start < count; start = end)
+	{
+		ORelOids	oids;
+		OIndexDescr *indexDescr;
+		uint32		i;
+
+		for (end = start + 1; end < count; end++)
+		{
+			if (prewarm_wal_item_cmp(&items[start], &items[end]) != 0)
+				break;
+		}
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (prewarm_pool_is_full(get_ppool(OPagePoolMain)))
+			break;
+
+		memcpy(&oids.datoid, items[start]->datoid, sizeof(Oid));
+		memcpy(&oids.reloid, items[start]->reloid, sizeof(Oid));
+		memcpy(&oids.relnode, items[start]->relnode, sizeof(Oid));
+		if (!o_tables_rel_try_lock(&oids, AccessShareLock, NULL))
+			continue;
+
+		indexDescr = o_fetch_index_descr(oids, (OIndexType) items[start]->type,
+										 false, NULL);
+		if (indexDescr)
+		{
+			BTreeDescr *desc = &indexDescr->desc;
+
+			o_btree_load_shmem(desc);
+			for (i = start; i < end; i++)
+			{
+				OffsetNumber keyLength;
+
+				if (prewarm_pool_is_full(desc->ppool))
+					break;
+
+				init_page_find_context(context, desc, COMMITSEQNO_INPROGRESS,
+									   BTREE_PAGE_FIND_IMAGE);
+				memcpy(&keyLength, items[i]->length, sizeof(OffsetNumber));
+				if (keyLength == 0)
+				{
+					(void) find_page(context, NULL, BTreeKeyRightmost, 0);
+				}
+				else
+				{
+					OTuple		hikey;
+
+					hikey.formatFlags = items[i]->formatFlags;
+					hikey.data = (Pointer) items[i] + sizeof(OPrewarmWALItem);
+					(void) find_page(context, &hikey, BTreeKeyPageHiKey, 0);
+				}
+				loaded++;
+			}
+		}
+
+		o_tables_rel_unlock(&oids, AccessShareLock);
+		ppool_release_all_pages();
+	}
+
+	pfree(context);
+	pfree(items);
+	pfree(data);
+	return loaded;
+}
+
+void
+register_prewarm_worker(int num)
+{
+	BackgroundWorker worker;
+
+	/* Set up background worker parameters */
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	worker.bgw_main_arg = Int32GetDatum(num);
+	strcpy(worker.bgw_library_name, "orioledb");
+	strcpy(worker.bgw_function_name, "prewarm_worker_main");
+	strcpy(worker.bgw_name, "orioledb prewarm worker");
+	strcpy(worker.bgw_type, "orioledb prewarm worker");
+	RegisterBackgroundWorker(&worker);
+}
+
+void
+prewarm_worker_main(Datum main_arg)
+{
+	int			num = DatumGetInt32(main_arg);
+	int64		loaded;
+
+	/* the loading is checking for interrupts */
+	o_worker_setup(die);
+
+	elog(LOG, "orioledb prewarm worker %d started", num);
+	IsPrewarmWorker = true;
+
+	PG_TRY();
+	{
+		MemoryContextSwitchTo(CurTransactionContext);
+		loaded = prewarm_load_hot_pages(num, prewarm_workers_num);
+		elog(LOG, "orioledb prewarm worker %d loaded " INT64_FORMAT " pages",
+			 num, loaded);
+	}
+	PG_CATCH();
+	{
+		LockReleaseSession(DEFAULT_LOCKMETHOD);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
+
+void
+register_replica_prewarm_worker(void)
+{
+	BackgroundWorker worker;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	strcpy(worker.bgw_library_name, "orioledb");
+	strcpy(worker.bgw_function_name, "replica_prewarm_worker_main");
+	strcpy(worker.bgw_name, "orioledb replica prewarm worker");
+	strcpy(worker.bgw_type, "orioledb replica prewarm worker");
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * Loads the hot leaves of the primary every time the standby replays a new
+ * list of them.  Exits on the promotion or right away on the primary.
+ */
+void
+replica_prewarm_worker_main(Datum main_arg)
+{
+	time_t		lastMtime = 0;
+
+	o_worker_setup(die);
+
+	IsPrewarmWorker = true;
+
+	PG_TRY();
+	{
+		MemoryContextSwitchTo(CurTransactionContext);
+		while (RecoveryInProgress())
+		{
+			struct stat st;
+
+			CHECK_FOR_INTERRUPTS();
+
+			if (stat(PREWARM_REPLICA_FILENAME, &st) == 0 &&
+				st.st_mtime != lastMtime)
+			{
+				int64		loaded;
+
+				lastMtime = st.st_mtime;
+				loaded = prewarm_load_replica_pages();
+				elog(DEBUG1, "orioledb replica prewarm worker loaded " INT64_FORMAT " pages",
+					 loaded);
+				MemoryContextReset(CurTransactionContext);
+			}
+
+			(void) WaitLatch(MyLatch,
+							 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+							 PREWARM_REPLICA_NAPTIME,
+							 PG_WAIT_EXTENSION);
+			ResetLatch(MyLatch);
+		}
+	}
+	PG_CATCH();
+	{
+		LockReleaseSession(DEFAULT_LOCKMETHOD);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
+
+/*
+ * Saves the hot page set on demand.
+ */
+Datum
+orioledb_prewarm_dump(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT64(prewarm_dump_hot_pages());
+}
+
+/*
+ * Loads the hot page set saved by the last dump.
+ */
+Datum
+orioledb_prewarm_load(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT64(prewarm_load_hot_pages(0, 1));
+}
@@ -0,0 +1,286 @@
+/*-------------------------------------------------------------------------
+ *
+ * slot_queue.c
+ *		Shared slot queue of the background job workers.
+ *
+ * The submitter fills a free slot with the job and marks it submitted.  A
+ * worker takes the submitted slot, does the job and marks the slot done.
+ * The submitter reads the result of the done slot and frees it, or cancels
+ * the slot, which no worker took yet.  The compression and the sync workers
+ * are built on the queue.
+ *
+ * Each slot passes the states:
+ *
+ *		free -> filling -> submitted -> running -> done -> free
+ *
+ * with a shortcut from submitted to free for the cancelled slot.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/slot_queue.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "workers/slot_queue.h"
+
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/bgwriter.h"
+#include "postmaster/interrupt.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+
+#include "pgstat.h"
+
+typedef enum
+{
+	OSlotFree = 0,
+	OSlotFilling,
+	OSlotSubmitted,
+	OSlotRunning,
+	OSlotDone
+} OSlotState;
+
+Size
+o_slot_queue_shmem_needs(int nworkers, int slotsPerWorker, Size slotSize)
+{
+	return add_size(MAXALIGN(sizeof(OSlotQueue)),
+					mul_size(nworkers * slotsPerWorker, MAXALIGN(slotSize)));
+}
+
+void
+o_slot_queue_init(OSlotQueue *queue, int nworkers, int slotsPerWorker,
+				  Size slotSize)
+{
+	int			i;
+
+	ConditionVariableInit(&queue->submitCV);
+	ConditionVariableInit(&queue->doneCV);
+	for (i = 0; i < O_SLOT_QUEUE_MAX_COUNTERS; i++)
+		pg_atomic_init_u64(&queue->counters[i], 0);
+	queue->nslots = nworkers * slotsPerWorker;
+	queue->slotsPerWorker = slotsPerWorker;
+	queue->slotSize = MAXALIGN(slotSize);
+	for (i = 0; i < queue->nslots; i++)
+		pg_atomic_init_u32(&O_SLOT_QUEUE_SLOT(queue, i)->state, OSlotFree);
+}
+
+/*
+ * Takes a free slot for filling.  Returns its index or -1 if there are no
+ * free slots.
+ */
+int
+o_slot_queue_acquire(OSlotQueue *queue)
+{
+	int			i;
+
+	for (i = 0; i < queue->nslots; i++)
+	{
+		OSlotQueueSlot *slot = O_SLOT_QUEUE_SLOT(queue, i);
+		uint32		state = OSlotFree;
+
+		if (pg_atomic_read_u32(&slot->state) == OSlotFree &&
+			pg_atomic_compare_exchange_u32(&slot->state, &state, OSlotFilling))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Passes the filled slot to the workers.  The workers sleeping for the
+ * submitted slots are woken up by o_slot_queue_wakeup_workers(), so the
+ * caller can submit a batch first.
+ */
+void
+o_slot_queue_submit(OSlotQueue *queue, int index)
+{
+	OSlotQueueSlot *slot = O_SLOT_QUEUE_SLOT(queue, index);
+
+	Assert(pg_atomic_read_u32(&slot->state) == OSlotFilling);
+	pg_write_barrier();
+	pg_atomic_write_u32(&slot->state, OSlotSubmitted);
+	pg_atomic_fetch_add_u64(&queue->counters[O_SLOT_QUEUE_SUBMITTED], 1);
+}
+
+void
+o_slot_queue_wakeup_workers(OSlotQueue *queue)
+{
+	ConditionVariableBroadcast(&queue->submitCV);
+}
+
+/*
+ * Checks if the worker is done with the submitted slot.  The job result
+ * might be read after true is returned.
+ */
+bool
+o_slot_queue_is_done(OSlotQueue *queue, int index)
+{
+	if (pg_atomic_read_u32(&O_SLOT_QUEUE_SLOT(queue, index)->state) != OSlotDone)
+		return false;
+	pg_read_barrier();
+	return true;
+}
+
+/*
+ * Waits for the worker to finish the submitted slot.
+ */
+void
+o_slot_queue_wait_done(OSlotQueue *queue, int index)
+{
+	if (o_slot_queue_is_done(queue, index))
+		return;
+
+	ConditionVariablePrepareToSleep(&queue->doneCV);
+	while (!o_slot_queue_is_done(queue, index))
+		ConditionVariableSleep(&queue->doneCV, PG_WAIT_EXTENSION);
+	ConditionVariableCancelSleep();
+}
+
+/*
+ * Frees the submitted slot if no worker took it yet and returns true.
+ * Otherwise, waits for the worker and returns false: the job result might
+ * be read before o_slot_queue_free().
+ */
+bool
+o_slot_queue_cancel(OSlotQueue *queue, int index)
+{
+	OSlotQueueSlot *slot = O_SLOT_QUEUE_SLOT(queue, index);
+	uint32		state = OSlotSubmitted;
+
+	if (pg_atomic_compare_exchange_u32(&slot->state, &state, OSlotFree))
+		return true;
+
+	o_slot_queue_wait_done(queue, index);
+	return false;
+}
+
+void
+o_slot_queue_free(OSlotQueue *queue, int index)
+{
+	Assert(pg_atomic_read_u32(&O_SLOT_QUEUE_SLOT(queue, index)->state) == OSlotDone);
+	pg_atomic_write_u32(&O_SLOT_QUEUE_SLOT(queue, index)->state, OSlotFree);
+}
+
+void
+o_slot_queue_register_worker(int num, const char *function, const char *name)
+{
+	BackgroundWorker worker;
+
+	/* Set up background worker parameters */
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time = 0;
+	worker.bgw_main_arg = Int32GetDatum(num);
+	strcpy(worker.bgw_library_name, "orioledb");
+	strlcpy(worker.bgw_function_name, function, BGW_MAXLEN);
+	snprintf(worker.bgw_name, BGW_MAXLEN, "orioledb %s", name);
+	snprintf(worker.bgw_type, BGW_MAXLEN, "orioledb %s", name);
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * Takes a submitted slot and does its job.  Returns false if there are no
+ * submitted slots.
+ */
+static bool
+o_slot_queue_worker_step(OSlotQueue *queue, int num, OSlotQueueJob job)
+{
+	int			nslots = queue->nslots,
+				i;
+
+	/* Different workers start scanning from the different slots */
+	for (i = 0; i < nslots; i++)
+	{
+		OSlotQueueSlot *slot;
+		uint32		state = OSlotSubmitted;
+
+		slot = O_SLOT_QUEUE_SLOT(queue, (i + num * queue->slotsPerWorker) % nslots);
+		if (pg_atomic_read_u32(&slot->state) != OSlotSubmitted ||
+			!pg_atomic_compare_exchange_u32(&slot->state, &state,
+											OSlotRunning))
+			continue;
+		pg_read_barrier();
+
+		job(queue, slot);
+
+		pg_write_barrier();
+		pg_atomic_write_u32(&slot->state, OSlotDone);
+		ConditionVariableBroadcast(&queue->doneCV);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Does the jobs of the submitted slots until the shutdown request.
+ */
+void
+o_slot_queue_worker_main(OSlotQueue *queue, int num, const char *name,
+						 OSlotQueueJob job)
+{
+	pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	BackgroundWorkerUnblockSignals();
+
+	elog(LOG, "orioledb %s %d started", name, num);
+
+	while (!ShutdownRequestPending)
+	{
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		/*
+		 * Prepare to sleep before looking for work, so the broadcast of a
+		 * concurrent submitter isn't missed.
+		 */
+		ConditionVariablePrepareToSleep(&queue->submitCV);
+		if (o_slot_queue_worker_step(queue, num, job))
+			continue;
+
+		(void) ConditionVariableTimedSleep(&queue->submitCV,
+										   BgWriterDelay, PG_WAIT_EXTENSION);
+
+		if (!PostmasterIsAlive())
+			break;
+	}
+	ConditionVariableCancelSleep();
+
+	elog(LOG, "orioledb %s %d is shut down", name, num);
+}
+
+/*
+ * Returns the row of the first 'ncounters' queue counters for the stats
+ * function of the workers.  The counters are zero without the workers.
+ */
+Datum
+o_slot_queue_stats(FunctionCallInfo fcinfo, OSlotQueue *queue, int ncounters)
+{
+	TupleDesc	tupdesc;
+	Datum		values[O_SLOT_QUEUE_MAX_COUNTERS];
+	bool		nulls[O_SLOT_QUEUE_MAX_COUNTERS];
+	int			i;
+
+	Assert(ncounters <= O_SLOT_QUEUE_MAX_COUNTERS);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	for (i = 0; i < ncounters; i++)
+	{
+		values[i] = Int64GetDatum(queue ? pg_atomic_read_u64(&queue->counters[i]) : 0);
+		nulls[i] = false;
+	}
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
@@ -0,0 +1,239 @@
+/*-------------------------------------------------------------------------
+ *
+ * sync_worker.c
+ *		Routines for background data file sync workers.
+ *
+ * The checkpointer walks the trees one by one, and the walk of each tree
+ * ends with the fsync of its data files.  With many small trees those
+ * fsyncs dominate the checkpoint time, while the walk itself can't be split
+ * between processes: the backends coordinate the page modifications with
+ * the single checkpoint position in CheckpointState.  But the data files
+ * only need to be durable before the control file of the checkpoint is
+ * written.  So the checkpointer hands the fsyncs to the sync workers,
+ * proceeds to the next tree, and waits for all of them before writing the
+ * control file.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/sync_worker.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "orioledb.h"
+
+#include "workers/slot_queue.h"
+#include "workers/sync_worker.h"
+
+#include "storage/fd.h"
+#include "utils/memutils.h"
+
+/* shared slots per sync worker */
+#define SYNC_WORKER_SLOTS_PER_WORKER	(32)
+
+/* the queue counter of the failed fsyncs */
+#define SYNC_WORKER_FAILED				(1)
+
+typedef struct
+{
+	OSlotQueueSlot header;
+	/* errno of the failed fsync, zero on success */
+	int			error;
+	char		path[MAXPGPATH];
+} SyncWorkerSlot;
+
+#define SYNC_WORKER_SLOT(index) \
+	((SyncWorkerSlot *) O_SLOT_QUEUE_SLOT(syncQueue, (index)))
+
+bool		IsSyncWorker = false;
+
+static OSlotQueue *syncQueue = NULL;
+
+/* Slots submitted by this backend */
+static int *pending = NULL;
+static int	pendingCount = 0;
+
+PG_FUNCTION_INFO_V1(orioledb_sync_worker_stats);
+
+Size
+sync_workers_shmem_needs(void)
+{
+	if (checkpoint_sync_workers_num == 0)
+		return 0;
+
+	return o_slot_queue_shmem_needs(checkpoint_sync_workers_num,
+									SYNC_WORKER_SLOTS_PER_WORKER,
+									sizeof(SyncWorkerSlot));
+}
+
+void
+sync_workers_shmem_init(Pointer ptr, bool found)
+{
+	if (checkpoint_sync_workers_num == 0)
+		return;
+
+	syncQueue = (OSlotQueue *) ptr;
+
+	if (!found)
+		o_slot_queue_init(syncQueue, checkpoint_sync_workers_num,
+						  SYNC_WORKER_SLOTS_PER_WORKER,
+						  sizeof(SyncWorkerSlot));
+}
+
+bool
+sync_workers_enabled(void)
+{
+	return syncQueue != NULL;
+}
+
+/*
+ * Frees the done slots of this backend.  Waits for all of them if 'wait' is
+ * set.  Reports the first fsync failure if 'report' is set.  Returns true if
+ * at least one slot was freed.
+ */
+static bool
+reap_slots(bool wait, bool report)
+{
+	bool		freed = false;
+	int			error = 0;
+	char		path[MAXPGPATH];
+	int			i;
+
+	for (i = 0; i < pendingCount; i++)
+	{
+		SyncWorkerSlot *slot = SYNC_WORKER_SLOT(pending[i]);
+
+		if (wait)
+			o_slot_queue_wait_done(syncQueue, pending[i]);
+		else if (!o_slot_queue_is_done(syncQueue, pending[i]))
+			continue;
+
+		if (slot->error != 0 && error == 0)
+		{
+			error = slot->error;
+			strlcpy(path, slot->path, MAXPGPATH);
+		}
+		o_slot_queue_free(syncQueue, pending[i]);
+		pending[i] = pending[--pendingCount];
+		freed = true;
+		i--;
+	}
+
+	if (error != 0 && report)
+	{
+		errno = error;
+		ereport(data_sync_elevel(ERROR),
+				(errcode_for_file_access(),
+				 errmsg("could not fsync file \"%s\": %m", path)));
+	}
+
+	return freed;
+}
+
+/*
+ * Submits the fsync of the file to the sync workers.
+ */
+void
+sync_workers_submit(const char *path)
+{
+	SyncWorkerSlot *slot;
+	int			i;
+
+	Assert(sync_workers_enabled());
+
+	if (!pending)
+		pending = (int *) MemoryContextAlloc(TopMemoryContext,
+											 sizeof(int) * syncQueue->nslots);
+
+	/*
+	 * All the slots are busy: free our done ones or wait for them.  The
+	 * checkpointer is the only submitter, so the busy slots are ours.
+	 */
+	while ((i = o_slot_queue_acquire(syncQueue)) < 0)
+	{
+		if (!reap_slots(false, true) && pendingCount > 0)
+			o_slot_queue_wait_done(syncQueue, pending[0]);
+	}
+
+	slot = SYNC_WORKER_SLOT(i);
+	strlcpy(slot->path, path, MAXPGPATH);
+	slot->error = 0;
+	pending[pendingCount++] = i;
+
+	o_slot_queue_submit(syncQueue, i);
+	o_slot_queue_wakeup_workers(syncQueue);
+}
+
+/*
+ * Waits for all the fsyncs submitted by this backend.  Called before
+ * writing the checkpoint control file.
+ */
+void
+sync_workers_wait_all(void)
+{
+	if (pendingCount > 0)
+		(void) reap_slots(true, true);
+}
+
+/*
+ * Waits for the submitted fsyncs ignoring their results.  Called on error
+ * cleanup: the checkpoint is aborted anyway.
+ */
+void
+sync_workers_release_all(void)
+{
+	if (pendingCount > 0)
+		(void) reap_slots(true, false);
+}
+
+void
+register_sync_worker(int num)
+{
+	o_slot_queue_register_worker(num, "sync_worker_main", "sync worker");
+}
+
+/*
+ * Syncs the file of the slot taken by the worker.
+ */
+static void
+sync_worker_job(OSlotQueue *queue, OSlotQueueSlot *header)
+{
+	SyncWorkerSlot *slot = (SyncWorkerSlot *) header;
+	int			fd;
+
+	/* The file of the dropped tree doesn't need to be synced */
+	fd = BasicOpenFile(slot->path, O_RDWR | PG_BINARY);
+	if (fd < 0)
+	{
+		slot->error = (errno == ENOENT) ? 0 : errno;
+	}
+	else
+	{
+		slot->error = (pg_fsync(fd) != 0) ? errno : 0;
+		close(fd);
+	}
+	if (slot->error != 0)
+		pg_atomic_fetch_add_u64(&queue->counters[SYNC_WORKER_FAILED], 1);
+}
+
+void
+sync_worker_main(Datum main_arg)
+{
+	IsSyncWorker = true;
+	o_slot_queue_worker_main(syncQueue, DatumGetInt32(main_arg),
+							 "sync worker", sync_worker_job);
+}
+
+/*
+ * Reports the usage of the sync workers.
+ */
+Datum
+orioledb_sync_worker_stats(PG_FUNCTION_ARGS)
+{
+	return o_slot_queue_stats(fcinfo, syncQueue, 2);
+}
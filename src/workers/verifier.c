@@ -0,0 +1,842 @@
+/*-------------------------------------------------------------------------
+ *
+ * verifier.c
+ *		Routines for background tree verification workers.
+ *
+ * orioledb_verify() queues the trees of a table for the verification.  The
+ * orioledb.verify_workers workers take the queued trees one per worker, so
+ * several trees are verified in parallel.  A worker walks the leaves of its
+ * tree in the key order, orioledb.verify_pages per round, and sleeps for
+ * orioledb.verify_delay between the rounds.  The leaves are copied as
+ * images, so the foreground queries aren't blocked by the walk, and the
+ * pages loaded from disk get the lowest usage count, so they are the first
+ * to be evicted.
+ *
+ * Every leaf image is checked for a consistent header and chunk layout, the
+ * key order of its items, and the items to be within the lokey and the
+ * hikey.  The hikey of the last verified leaf is kept in the shared memory
+ * together with the results, so the walk interrupted by the shutdown or by
+ * the restart of the worker is resumed from there.  The results are exposed
+ * by the pg_stat_orioledb_verify view.
+ *
+ * Copyright (c) 2025, Supabase Inc.
+ *
+ * IDENTIFICATION
+ *	  contrib/orioledb/src/workers/verifier.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "orioledb.h"
+
+#include "btree/find.h"
+#include "btree/page_contents.h"
+#include "catalog/o_tables.h"
+#include "tableam/descr.h"
+#include "utils/page_pool.h"
+#include "utils/ucm.h"
+#include "workers/paced_worker.h"
+#include "workers/verifier.h"
+
+#include "access/relation.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/spin.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+#define VERIFY_ENTRIES_NUM	(128)
+#define VERIFY_MESSAGE_SIZE	(128)
+
+typedef enum
+{
+	OVerifyFree = 0,
+	OVerifyQueued,
+	OVerifyRunning,
+	OVerifyPassed,
+	OVerifyFailed,
+	OVerifyDropped
+} OVerifyStatus;
+
+#define VERIFY_STATUS_IS_FINISHED(status) ((status) >= OVerifyPassed)
+
+/* Verification of the tree requested by orioledb_verify() */
+typedef struct
+{
+	ORelOids	oids;
+	OIndexType	type;
+	OVerifyStatus status;
+	/* number of the worker verifying the tree */
+	int			worker;
+	TimestampTz queuedTime;
+	TimestampTz startTime;
+	TimestampTz finishTime;
+	uint64		pagesChecked;
+	uint64		errors;
+	/* the first error found */
+	char		message[VERIFY_MESSAGE_SIZE];
+
+	/* the hikey of the last verified leaf to resume the walk from */
+	bool		hasCursor;
+	uint8		cursorFlags;
+	uint16		cursorLen;
+	char		cursorData[O_BTREE_MAX_KEY_SIZE];
+} OVerifyEntry;
+
+typedef struct
+{
+	slock_t		lock;
+	OVerifyEntry entries[VERIFY_ENTRIES_NUM];
+} OVerifyShared;
+
+/* State of the tree currently verified by the worker */
+typedef struct
+{
+	int			slot;
+	ORelOids	oids;
+	OIndexType	type;
+	OFixedKey	cursor;
+	int			cursorLen;
+	bool		first;
+	bool		finished;
+	bool		dropped;
+	uint64		pages;
+	uint64		errors;
+	char		message[VERIFY_MESSAGE_SIZE];
+} OVerifyState;
+
+static const char *verifyStatusNames[] = {
+	"free",
+	"queued",
+	"running",
+	"passed",
+	"failed",
+	"dropped"
+};
+
+bool		IsVerifyWorker = false;
+
+static OVerifyShared *verifyShared = NULL;
+static OVerifyState *activeState = NULL;
+
+PG_FUNCTION_INFO_V1(orioledb_verify);
+PG_FUNCTION_INFO_V1(orioledb_verify_status);
+
+static void verify_error(OVerifyState *state, const char *fmt,...) pg_attribute_printf(2, 3);
+
+Size
+verify_shmem_needs(void)
+{
+	if (verify_workers_num <= 0)
+		return 0;
+
+	return sizeof(OVerifyShared);
+}
+
+void
+verify_shmem_init(Pointer ptr, bool found)
+{
+	if (verify_workers_num <= 0)
+		return;
+
+	verifyShared = (OVerifyShared *) ptr;
+
+	if (!found)
+	{
+		int			i;
+
+		SpinLockInit(&verifyShared->lock);
+		for (i = 0; i < VERIFY_ENTRIES_NUM; i++)
+			verifyShared->entries[i].status = OVerifyFree;
+	}
+}
+
+/*
+ * Queues the tree unless it's already queued or being verified.  The
+ * finished verification of the tree is restarted from the beginning.  When
+ * there are no free entries, the oldest finished one is replaced.  Returns
+ * false if all the entries are busy.
+ */
+static bool
+verify_queue_push(ORelOids oids, OIndexType type)
+{
+	OVerifyEntry *target = NULL;
+	TimestampTz now = GetCurrentTimestamp();
+	bool		result = true;
+	int			i;
+
+	SpinLockAcquire(&verifyShared->lock);
+	for (i = 0; i < VERIFY_ENTRIES_NUM; i++)
+	{
+		OVerifyEntry *entry = &verifyShared->entries[i];
+
+		if (entry->status != OVerifyFree &&
+			ORelOidsIsEqual(entry->oids, oids) && entry->type == type)
+		{
+			target = entry;
+			break;
+		}
+	}
+
+	if (target == NULL)
+	{
+		for (i = 0; i < VERIFY_ENTRIES_NUM; i++)
+		{
+			OVerifyEntry *entry = &verifyShared->entries[i];
+
+			if (entry->status == OVerifyFree)
+			{
+				target = entry;
+				break;
+			}
+			if (VERIFY_STATUS_IS_FINISHED(entry->status) &&
+				(target == NULL || entry->finishTime < target->finishTime))
+				target = entry;
+		}
+	}
+
+	if (target == NULL)
+	{
+		result = false;
+	}
+	else if (target->status != OVerifyQueued &&
+			 target->status != OVerifyRunning)
+	{
+		target->oids = oids;
+		target->type = type;
+		target->status = OVerifyQueued;
+		target->worker = -1;
+		target->queuedTime = now;
+		target->startTime = 0;
+		target->finishTime = 0;
+		target->pagesChecked = 0;
+		target->errors = 0;
+		target->message[0] = '\0';
+		target->hasCursor = false;
+	}
+	SpinLockRelease(&verifyShared->lock);
+
+	return result;
+}
+
+/*
+ * Takes the earliest queued tree for the worker.  Returns false if there are
+ * no queued trees.
+ */
+static bool
+verify_queue_pick(int num, OVerifyState *state)
+{
+	TimestampTz now = GetCurrentTimestamp();
+	OVerifyEntry *entry;
+	int			i,
+				slot = -1;
+
+	SpinLockAcquire(&verifyShared->lock);
+	for (i = 0; i < VERIFY_ENTRIES_NUM; i++)
+	{
+		entry = &verifyShared->entries[i];
+		if (entry->status == OVerifyQueued &&
+			(slot < 0 ||
+			 entry->queuedTime < verifyShared->entries[slot].queuedTime))
+			slot = i;
+	}
+
+	if (slot >= 0)
+	{
+		entry = &verifyShared->entries[slot];
+		entry->status = OVerifyRunning;
+		entry->worker = num;
+		if (entry->startTime == 0)
+			entry->startTime = now;
+
+		state->slot = slot;
+		state->oids = entry->oids;
+		state->type = entry->type;
+		state->first = !entry->hasCursor;
+		state->finished = false;
+		state->dropped = false;
+		state->pages = entry->pagesChecked;
+		state->errors = entry->errors;
+		strlcpy(state->message, entry->message, VERIFY_MESSAGE_SIZE);
+		if (entry->hasCursor)
+		{
+			state->cursor.tuple.formatFlags = entry->cursorFlags;
+			state->cursor.tuple.data = state->cursor.fixedData;
+			state->cursorLen = entry->cursorLen;
+			memcpy(state->cursor.fixedData, entry->cursorData,
+				   entry->cursorLen);
+		}
+	}
+	SpinLockRelease(&verifyShared->lock);
+
+	return slot >= 0;
+}
+
+/*
+ * Returns the trees left running by the previous incarnation of the worker
+ * to the queue.  They will resume from the saved cursor.
+ */
+static void
+verify_queue_requeue(int num)
+{
+	int			i;
+
+	SpinLockAcquire(&verifyShared->lock);
+	for (i = 0; i < VERIFY_ENTRIES_NUM; i++)
+	{
+		OVerifyEntry *entry = &verifyShared->entries[i];
+
+		if (entry->status == OVerifyRunning && entry->worker == num)
+		{
+			entry->status = OVerifyQueued;
+			entry->worker = -1;
+		}
+	}
+	SpinLockRelease(&verifyShared->lock);
+}
+
+/*
+ * Publishes the progress of the verification and the position to resume it
+ * from.
+ */
+static void
+verify_report(OVerifyState *state, OVerifyStatus status)
+{
+	OVerifyEntry *entry = &verifyShared->entries[state->slot];
+	TimestampTz now = GetCurrentTimestamp();
+
+	SpinLockAcquire(&verifyShared->lock);
+	entry->pagesChecked = state->pages;
+	entry->errors = state->errors;
+	strlcpy(entry->message, state->message, VERIFY_MESSAGE_SIZE);
+	entry->hasCursor = !state->first;
+	if (!state->first)
+	{
+		entry->cursorFlags = state->cursor.tuple.formatFlags;
+		entry->cursorLen = state->cursorLen;
+		memcpy(entry->cursorData, state->cursor.fixedData, state->cursorLen);
+	}
+	entry->status = status;
+	if (status == OVerifyQueued)
+		entry->worker = -1;
+	if (VERIFY_STATUS_IS_FINISHED(status))
+		entry->finishTime = now;
+	SpinLockRelease(&verifyShared->lock);
+}
+
+static void
+verify_error(OVerifyState *state, const char *fmt,...)
+{
+	va_list		args;
+	int			len;
+
+	state->errors++;
+	if (state->message[0] != '\0')
+		return;
+
+	len = snprintf(state->message, VERIFY_MESSAGE_SIZE, "leaf %llu: ",
+				   (unsigned long long) state->pages);
+	va_start(args, fmt);
+	vsnprintf(state->message + len, VERIFY_MESSAGE_SIZE - len, fmt, args);
+	va_end(args);
+}
+
+/*
+ * Checks the header and the chunk descriptors of the image, so the items
+ * can be safely walked.
+ */
+static bool
+verify_leaf_header(OVerifyState *state, Page img)
+{
+	BTreePageHeader *header = (BTreePageHeader *) img;
+	int			i;
+
+	if (!O_PAGE_IS(img, LEAF))
+	{
+		verify_error(state, "not a leaf page");
+		return false;
+	}
+
+	if (header->dataSize > ORIOLEDB_BLCKSZ ||
+		header->hikeysEnd > header->dataSize ||
+		header->chunksCount == 0 ||
+		header->chunksCount > BTREE_PAGE_MAX_CHUNKS ||
+		header->itemsCount > BTREE_PAGE_MAX_ITEMS)
+	{
+		verify_error(state, "invalid page header");
+		return false;
+	}
+
+	for (i = 0; i < header->chunksCount; i++)
+	{
+		BTreePageChunkDesc *chunk = &header->chunkDesc[i];
+		bool		valid;
+
+		if (i == 0)
+			valid = chunk->offset == 0 &&
+				SHORT_GET_LOCATION(chunk->shortLocation) >= header->hikeysEnd;
+		else
+			valid = chunk->offset >= header->chunkDesc[i - 1].offset &&
+				chunk->shortLocation >= header->chunkDesc[i - 1].shortLocation;
+		valid = valid && chunk->offset <= header->itemsCount &&
+			SHORT_GET_LOCATION(chunk->shortLocation) <= header->dataSize;
+
+		if (!valid)
+		{
+			verify_error(state, "invalid descriptor of chunk %d", i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Verifies the leaf image found by the context.  Returns false if the walk
+ * can't continue past the leaf.
+ */
+static bool
+verify_leaf(BTreeDescr *desc, OVerifyState *state,
+			OBTreeFindPageContext *context)
+{
+	Page		img = context->img;
+	BTreePageItemLocator loc;
+	OTuple		hikey,
+				lokey,
+				prev;
+	bool		hasHikey = !O_PAGE_IS(img, RIGHTMOST),
+				hasLokey = !O_PAGE_IS(img, LEFTMOST);
+	int			itemnum = 0;
+
+	if (!verify_leaf_header(state, img))
+		return false;
+
+	if (state->first && hasLokey)
+		verify_error(state, "the first leaf is not leftmost");
+
+	O_TUPLE_SET_NULL(hikey);
+	O_TUPLE_SET_NULL(lokey);
+	if (hasHikey)
+		BTREE_PAGE_GET_HIKEY(hikey, img);
+	if (hasLokey)
+		lokey = btree_find_context_lokey(context);
+
+	if (hasHikey && !state->first &&
+		o_btree_cmp(desc, &hikey, BTreeKeyNonLeafKey,
+					&state->cursor.tuple, BTreeKeyNonLeafKey) <= 0)
+	{
+		/* Otherwise the walk would loop over the same leaves */
+		verify_error(state, "hikey is not greater than the previous hikey");
+		return false;
+	}
+
+	if (hasHikey && hasLokey &&
+		o_btree_cmp(desc, &hikey, BTreeKeyNonLeafKey,
+					&lokey, BTreeKeyNonLeafKey) <= 0)
+		verify_error(state, "hikey is not greater than lokey");
+
+	O_TUPLE_SET_NULL(prev);
+	BTREE_PAGE_FOREACH_ITEMS(img, &loc)
+	{
+		OTuple		tuple;
+
+		if (BTREE_PAGE_GET_ITEM_OFFSET(img, &loc) + BTreeLeafTuphdrSize >
+			((BTreePageHeader *) img)->dataSize)
+		{
+			verify_error(state, "item %d is out of the page data", itemnum);
+			return false;
+		}
+
+		BTREE_PAGE_READ_LEAF_TUPLE(tuple, img, &loc);
+
+		if (!O_TUPLE_IS_NULL(prev) &&
+			o_btree_cmp(desc, &prev, BTreeKeyLeafTuple,
+						&tuple, BTreeKeyLeafTuple) >= 0)
+			verify_error(state, "item %d is out of order", itemnum);
+
+		if (hasLokey && itemnum == 0 &&
+			o_btree_cmp(desc, &tuple, BTreeKeyLeafTuple,
+						&lokey, BTreeKeyNonLeafKey) < 0)
+			verify_error(state, "item %d is less than lokey", itemnum);
+
+		if (hasHikey &&
+			o_btree_cmp(desc, &tuple, BTreeKeyLeafTuple,
+						&hikey, BTreeKeyNonLeafKey) >= 0)
+			verify_error(state, "item %d is not less than hikey", itemnum);
+
+		prev = tuple;
+		itemnum++;
+	}
+
+	return true;
+}
+
+/*
+ * Don't push out the pages used by the foreground queries.
+ */
+static bool
+verify_pool_is_full(OPagePool *pool)
+{
+	return ppool_free_pages_count(pool) < ppool_free_pages_high_mark(pool);
+}
+
+/*
+ * Verifies up to 'npages' leaves of the tree starting from the cursor.
+ */
+static void
+verify_tree_round(BTreeDescr *desc, OVerifyState *state, int npages)
+{
+	OBTreeFindPageContext context;
+	int			i;
+
+	/* The pages we load are the first candidates for eviction */
+	set_ucm_scan_access();
+
+	for (i = 0; i < npages && !ShutdownRequestPending; i++)
+	{
+		OFindPageResult result;
+
+		if (verify_pool_is_full(desc->ppool))
+			break;
+
+		init_page_find_context(&context, desc, COMMITSEQNO_INPROGRESS,
+							   BTREE_PAGE_FIND_IMAGE |
+							   BTREE_PAGE_FIND_KEEP_LOKEY);
+		if (state->first)
+			result = find_page(&context, NULL, BTreeKeyNone, 0);
+		else
+			result = find_page(&context, &state->cursor.tuple,
+							   BTreeKeyNonLeafKey, 0);
+
+		state->pages++;
+		if (result != OFindPageResultSuccess)
+		{
+			verify_error(state, "could not find the leaf");
+			state->finished = true;
+			break;
+		}
+
+		if (!verify_leaf(desc, state, &context))
+		{
+			state->finished = true;
+			break;
+		}
+
+		state->first = false;
+		if (O_PAGE_IS(context.img, RIGHTMOST))
+		{
+			state->finished = true;
+			break;
+		}
+		copy_fixed_hikey(desc, &state->cursor, context.img);
+		state->cursorLen = o_btree_len(desc, state->cursor.tuple, OKeyLength);
+	}
+
+	unset_ucm_scan_access();
+}
+
+/*
+ * Makes a round of the verification of the current tree.  Returns true when
+ * the tree is done.
+ */
+static bool
+verify_tree_step(OVerifyState *state, int npages)
+{
+	ORelOids	oids = state->oids;
+	OIndexDescr *indexDescr;
+	BTreeDescr *desc;
+
+	if (!o_tables_rel_try_lock(&oids, AccessShareLock, NULL))
+		return false;
+
+	indexDescr = o_fetch_index_descr(oids, state->type, false, NULL);
+	if (!indexDescr)
+	{
+		o_tables_rel_unlock(&oids, AccessShareLock);
+		state->dropped = true;
+		return true;
+	}
+
+	desc = &indexDescr->desc;
+	o_btree_load_shmem(desc);
+
+	verify_tree_round(desc, state, npages);
+
+	o_tables_rel_unlock(&oids, AccessShareLock);
+	ppool_release_all_pages();
+
+	return state->finished;
+}
+
+static void
+verify_tree_finish(OVerifyState *state)
+{
+	if (state->dropped)
+	{
+		verify_report(state, OVerifyDropped);
+		return;
+	}
+
+	verify_report(state, state->errors > 0 ? OVerifyFailed : OVerifyPassed);
+	if (state->errors > 0)
+		ereport(WARNING,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("orioledb verification found " UINT64_FORMAT " errors in tree (%u, %u, %u)",
+						state->errors, state->oids.datoid,
+						state->oids.reloid, state->oids.relnode),
+				 errdetail("%s", state->message)));
+}
+
+/*
+ * Records the error thrown during the verification, so the tree isn't
+ * retried by the restarted worker.
+ */
+static void
+verify_tree_error(OVerifyState *state)
+{
+	ErrorData  *edata;
+
+	MemoryContextSwitchTo(TopMemoryContext);
+	edata = CopyErrorData();
+	state->errors++;
+	if (state->message[0] == '\0')
+		strlcpy(state->message, edata->message, VERIFY_MESSAGE_SIZE);
+	FreeErrorData(edata);
+	verify_report(state, OVerifyFailed);
+}
+
+void
+register_verify_worker(int num)
+{
+	BackgroundWorker worker;
+
+	/* Set up background worker parameters */
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = 0;
+	worker.bgw_main_arg = Int32GetDatum(num);
+	strcpy(worker.bgw_library_name, "orioledb");
+	strcpy(worker.bgw_function_name, "verify_worker_main");
+	strcpy(worker.bgw_name, "orioledb verify worker");
+	strcpy(worker.bgw_type, "orioledb verify worker");
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * Round callback of the paced worker loop.  Picks the next queued tree if
+ * there is no current one.
+ */
+static void
+verify_worker_round(void *arg, int npages)
+{
+	static OVerifyState state;
+	int			num = *((int *) arg);
+
+	if (!activeState)
+	{
+		if (!verify_queue_pick(num, &state))
+			return;
+		activeState = &state;
+	}
+
+	if (verify_tree_step(activeState, npages))
+	{
+		verify_tree_finish(activeState);
+		activeState = NULL;
+	}
+	else
+	{
+		verify_report(activeState, OVerifyRunning);
+	}
+}
+
+static void
+verify_worker_shutdown(void *arg)
+{
+	/* The next start of the worker resumes from the saved cursor */
+	if (activeState)
+	{
+		verify_report(activeState, OVerifyQueued);
+		activeState = NULL;
+	}
+}
+
+static void
+verify_worker_error(void *arg)
+{
+	if (activeState)
+		verify_tree_error(activeState);
+}
+
+void
+verify_worker_main(Datum main_arg)
+{
+	int			num = DatumGetInt32(main_arg);
+	OPacedWorker worker = {0};
+
+	IsVerifyWorker = true;
+
+	verify_queue_requeue(num);
+
+	worker.name = psprintf("verify worker %d", num);
+	worker.delay = &verify_delay;
+	worker.pages = &verify_pages;
+	worker.round = verify_worker_round;
+	worker.shutdown = verify_worker_shutdown;
+	worker.error = verify_worker_error;
+	worker.arg = &num;
+	o_paced_worker_main(&worker);
+}
+
+/*
+ * Queues the trees of the table for the verification.  Returns the number
+ * of queued trees.
+ */
+Datum
+orioledb_verify(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	OTableDescr *descr;
+	Relation	rel;
+	int			treen,
+				count = 0;
+
+	orioledb_check_shmem();
+
+	if (verifyShared == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("verify workers are not enabled"),
+				 errhint("Set orioledb.verify_workers and restart the server.")));
+
+	rel = relation_open(relid, AccessShareLock);
+
+	if (!is_orioledb_rel(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not an orioledb table",
+						RelationGetRelationName(rel))));
+
+	descr = relation_get_descr(rel);
+
+	for (treen = 0; treen < descr->nIndices + 1; treen++)
+	{
+		BTreeDescr *td;
+
+		if (treen < descr->nIndices)
+			td = &descr->indices[treen]->desc;
+		else
+			td = &descr->toast->desc;
+
+		if (!verify_queue_push(td->oids, td->type))
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("verify queue is full")));
+		count++;
+	}
+
+	relation_close(rel, AccessShareLock);
+
+	PG_RETURN_INT32(count);
+}
+
+static const char *
+verify_index_type_name(OIndexType type)
+{
+	switch (type)
+	{
+		case oIndexToast:
+			return "toast";
+		case oIndexBridge:
+			return "bridge";
+		case oIndexPrimary:
+			return "primary";
+		case oIndexUnique:
+			return "unique";
+		case oIndexRegular:
+			return "regular";
+		default:
+			return "invalid";
+	}
+}
+
+/*
+ * Reports the queued, running and finished verifications.
+ */
+Datum
+orioledb_verify_status(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	OVerifyEntry *entries;
+	int			i;
+
+	orioledb_check_shmem();
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	if (verifyShared == NULL)
+	{
+		MemoryContextSwitchTo(oldcontext);
+		return (Datum) 0;
+	}
+
+	entries = palloc(sizeof(OVerifyEntry) * VERIFY_ENTRIES_NUM);
+	SpinLockAcquire(&verifyShared->lock);
+	memcpy(entries, verifyShared->entries,
+		   sizeof(OVerifyEntry) * VERIFY_ENTRIES_NUM);
+	SpinLockRelease(&verifyShared->lock);
+
+	for (i = 0; i < VERIFY_ENTRIES_NUM; i++)
+	{
+		OVerifyEntry *entry = &entries[i];
+		Datum		values[12];
+		bool		nulls[12] = {false};
+
+		if (entry->status == OVerifyFree)
+			continue;
+
+		values[0] = ObjectIdGetDatum(entry->oids.datoid);
+		values[1] = ObjectIdGetDatum(entry->oids.reloid);
+		values[2] = ObjectIdGetDatum(entry->oids.relnode);
+		values[3] = CStringGetTextDatum(verify_index_type_name(entry->type));
+		values[4] = CStringGetTextDatum(verifyStatusNames[entry->status]);
+		values[5] = Int32GetDatum(entry->worker);
+		nulls[5] = entry->worker < 0;
+		values[6] = Int64GetDatum((int64) entry->pagesChecked);
+		values[7] = Int64GetDatum((int64) entry->errors);
+		values[8] = TimestampTzGetDatum(entry->queuedTime);
+		values[9] = TimestampTzGetDatum(entry->startTime);
+		nulls[9] = entry->startTime == 0;
+		values[10] = TimestampTzGetDatum(entry->finishTime);
+		nulls[10] = entry->finishTime == 0;
+		if (entry->message[0] != '\0')
+			values[11] = CStringGetTextDatum(entry->message);
+		else
+			nulls[11] = true;
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	pfree(entries);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return (Datum) 0;
+}
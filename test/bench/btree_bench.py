@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+# coding: utf-8
+"""
+Microbenchmarks of the OrioleDB B-tree operations.
+
+Runs orioledb_btree_bench() (available in the IS_DEV builds) over the
+matrix of the page pool sizes, the key distributions, the operations and the
+concurrency levels, and prints one JSON object per case.  Every case runs
+the given number of times, the best run is reported together with the
+spread, so the results of the same build are comparable between runs.
+
+	make USE_PGXS=1 IS_DEV=1 bench BENCH_ARGS="--output results.jsonl"
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+from threading import Thread
+
+import testgres
+
+OPERATIONS = ['insert', 'find', 'iterate', 'seq_scan', 'delete']
+DISTRIBUTIONS = ['sequential', 'uniform', 'zipfian']
+
+
+def parse_args():
+	parser = argparse.ArgumentParser(description=__doc__)
+	parser.add_argument('--nkeys', type=int, default=1000000)
+	parser.add_argument('--nops', type=int, default=200000)
+	parser.add_argument('--scan-ops', type=int, default=5)
+	parser.add_argument('--runs', type=int, default=3)
+	parser.add_argument('--seed', type=int, default=1)
+	parser.add_argument('--concurrency', default='1,4')
+	parser.add_argument('--main-buffers', default='1GB,16MB')
+	parser.add_argument('--distributions', default=','.join(DISTRIBUTIONS))
+	parser.add_argument('--operations', default=','.join(OPERATIONS))
+	parser.add_argument('--output', default=None)
+	return parser.parse_args()
+
+
+def git_commit():
+	try:
+		return subprocess.check_output(['git', 'rev-parse', 'HEAD'],
+		                               stderr=subprocess.DEVNULL,
+		                               text=True).strip()
+	except (OSError, subprocess.CalledProcessError):
+		return None
+
+
+def init_node(main_buffers):
+	base_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+	                        'tmp_check_bench')
+	node = testgres.get_new_node('bench', base_dir=base_dir)
+	node.init(["--no-locale", "--encoding=UTF8"])
+	node.append_conf(
+	    'postgresql.conf', "shared_preload_libraries = orioledb\n"
+	    "orioledb.use_sparse_files = true\n"
+	    "max_connections = 100\n"
+	    "orioledb.main_buffers = %s\n" % main_buffers)
+	node.start()
+	node.safe_psql("""
+		CREATE EXTENSION orioledb;
+		CREATE UNLOGGED TABLE o_bench (
+			key int4 PRIMARY KEY,
+			val int4
+		) USING orioledb;
+	""")
+	return node
+
+
+def fill_table(node, nkeys):
+	node.safe_psql("""
+		TRUNCATE o_bench;
+		INSERT INTO o_bench SELECT v, v FROM generate_series(1, %d) v;
+	""" % nkeys)
+
+
+def run_case(node, args, operation, distribution, concurrency):
+	nops = args.scan_ops if operation == 'seq_scan' else args.nops
+	results = [None] * concurrency
+	cons = [node.connect() for _ in range(concurrency)]
+
+	def worker(i):
+		# Disjoint key ranges for the sequential distribution
+		seed = args.seed + i * (args.nkeys // concurrency)
+		results[i] = cons[i].execute(
+		    """
+			SELECT affected, elapsed_ms
+			FROM orioledb_btree_bench('o_bench', '%s', %d, %d, '%s', %d);
+		""" % (operation, nops, args.nkeys, distribution, seed))[0]
+		cons[i].commit()
+
+	threads = [Thread(target=worker, args=(i, )) for i in range(concurrency)]
+	start = time.monotonic()
+	for t in threads:
+		t.start()
+	for t in threads:
+		t.join()
+	wall_ms = (time.monotonic() - start) * 1000.0
+	for con in cons:
+		con.close()
+
+	if any(r is None for r in results):
+		raise RuntimeError("benchmark worker failed")
+
+	elapsed_ms = max(r[1] for r in results)
+	return {
+	    'affected': sum(r[0] for r in results),
+	    'elapsed_ms': elapsed_ms,
+	    'wall_ms': wall_ms,
+	    'ops_per_sec': nops * concurrency * 1000.0 / elapsed_ms
+	    if elapsed_ms > 0 else None
+	}
+
+
+def main():
+	args = parse_args()
+	output = open(args.output, 'w') if args.output else sys.stdout
+	commit = git_commit()
+
+	for main_buffers in args.main_buffers.split(','):
+		node = init_node(main_buffers)
+		try:
+			for distribution in args.distributions.split(','):
+				for operation in args.operations.split(','):
+					for concurrency in map(int, args.concurrency.split(',')):
+						runs = []
+						for _ in range(args.runs):
+							if operation == 'insert':
+								node.safe_psql("TRUNCATE o_bench;")
+							else:
+								fill_table(node, args.nkeys)
+							runs.append(
+							    run_case(node, args, operation, distribution,
+							             concurrency))
+						best = max(runs, key=lambda r: r['ops_per_sec'] or 0)
+						rates = [r['ops_per_sec'] or 0 for r in runs]
+						result = {
+						    'benchmark': 'btree_%s' % operation,
+						    'commit': commit,
+						    'main_buffers': main_buffers,
+						    'distribution': distribution,
+						    'concurrency': concurrency,
+						    'nkeys': args.nkeys,
+						    'nops': args.scan_ops
+						    if operation == 'seq_scan' else args.nops,
+						    'runs': args.runs,
+						    'spread': (max(rates) - min(rates)) / max(rates)
+						    if max(rates) > 0 else None
+						}
+						result.update(best)
+						output.write(json.dumps(result) + '\n')
+						output.flush()
+		finally:
+			node.stop()
+			node.cleanup()
+
+	if args.output:
+		output.close()
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,3 @@
+-- Update of one of the first :hot_rows rows of o_workload
+\set id random(1, :hot_rows)
+UPDATE o_workload SET val = val + 1 WHERE id = :id;
@@ -0,0 +1,3 @@
+-- Point lookup of a random row of o_workload
+\set id random(1, :rows)
+SELECT val FROM o_workload WHERE id = :id;
@@ -0,0 +1,3 @@
+-- Update of a random row of o_workload
+\set id random(1, :rows)
+UPDATE o_workload SET val = val + 1 WHERE id = :id;
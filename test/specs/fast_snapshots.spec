@@ -0,0 +1,34 @@
+setup
+{
+	CREATE EXTENSION IF NOT EXISTS orioledb;
+	CREATE TABLE IF NOT EXISTS o_fast_snapshots (
+		id int NOT NULL,
+		val int NOT NULL,
+		PRIMARY KEY(id)
+	) USING orioledb;
+	TRUNCATE o_fast_snapshots;
+	INSERT INTO o_fast_snapshots VALUES (1, 10), (2, 20);
+}
+
+teardown
+{
+	DROP TABLE o_fast_snapshots;
+}
+
+session "s1"
+setup { SET orioledb.fast_snapshots = on; }
+
+step "s1_begin"  { BEGIN; }
+step "s1_declare" { DECLARE c CURSOR FOR SELECT * FROM o_fast_snapshots ORDER BY id; }
+step "s1_select" { SELECT * FROM o_fast_snapshots ORDER BY id; }
+step "s1_fetch" { FETCH ALL c; }
+step "s1_commit" { COMMIT; }
+
+session "s2"
+
+step "s2_update" { UPDATE o_fast_snapshots SET val = val + 1 WHERE id = 1; }
+
+# The cursor keeps the undo retained, so the next snapshot of s1 is taken by
+# the CSN read only.  It must still see the concurrent update, while the
+# cursor must not.
+permutation "s1_begin" "s1_declare" "s2_update" "s1_select" "s1_fetch" "s1_commit"
@@ -0,0 +1,41 @@
+setup
+{
+	CREATE EXTENSION IF NOT EXISTS orioledb;
+	CREATE TABLE IF NOT EXISTS o_uniq_queue (
+		id int8 NOT NULL,
+		uniq int8 NOT NULL,
+		PRIMARY KEY(id),
+		UNIQUE(uniq)
+	) USING orioledb;
+	TRUNCATE o_uniq_queue;
+}
+
+teardown
+{
+	DROP TABLE o_uniq_queue;
+}
+
+session "s1"
+
+step "s1_begin"  { BEGIN; }
+step "s1_rollback" { ROLLBACK; }
+step "s1_insert" { INSERT INTO o_uniq_queue VALUES (1, 1); }
+
+session "s2"
+
+step "s2_begin"  { BEGIN; }
+step "s2_commit" { COMMIT; }
+step "s2_rollback" { ROLLBACK; }
+step "s2_insert" { INSERT INTO o_uniq_queue VALUES (2, 1); }
+
+session "s3"
+
+step "s3_begin"  { BEGIN; }
+step "s3_commit" { COMMIT; }
+step "s3_insert" { INSERT INTO o_uniq_queue VALUES (3, 1); }
+step "s3_select" { SELECT * FROM o_uniq_queue; }
+
+# The waiters for the unique key are served in FIFO order: s3 keeps waiting
+# for s2, which is the first to get the key after s1 is gone.
+permutation "s1_begin" "s1_insert" "s2_begin" "s2_insert" "s3_begin" "s3_insert" "s1_rollback" "s2_commit" "s3_commit" "s3_select"
+permutation "s1_begin" "s1_insert" "s2_begin" "s2_insert" "s3_begin" "s3_insert" "s1_rollback" "s2_rollback" "s3_commit" "s3_select"
@@ -1327,6 +1327,28 @@ SELECT * FROM bitmap_test_complex WHERE val IN ('13!', 'b');
 EXPLAIN (COSTS OFF) SELECT * FROM bitmap_test_complex WHERE val < '13!';
 SELECT * FROM bitmap_test_complex WHERE val < '13!';
 
+CREATE TABLE bitmap_test_roaring
+(
+	id int4 PRIMARY KEY,
+	m3 int4,
+	m7 int4
+) USING orioledb;
+INSERT INTO bitmap_test_roaring
+	SELECT i, i % 3, i % 7 FROM generate_series(1, 150000) i;
+CREATE INDEX bitmap_test_roaring_ix1 ON bitmap_test_roaring (m3);
+CREATE INDEX bitmap_test_roaring_ix2 ON bitmap_test_roaring (m7);
+ANALYZE bitmap_test_roaring;
+
+SET enable_seqscan = OFF;
+SET enable_indexscan = OFF;
+SELECT count(*) FROM bitmap_test_roaring WHERE m3 = 0 AND m7 = 0;
+SELECT count(*) FROM bitmap_test_roaring WHERE m3 = 0 OR m7 = 0;
+SELECT count(*) FROM bitmap_test_roaring WHERE id < 70000 AND m7 = 0;
+SELECT count(*) FROM bitmap_test_roaring WHERE m7 = 0 OR id > 149990;
+RESET enable_seqscan;
+RESET enable_indexscan;
+DROP TABLE bitmap_test_roaring;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA bitmap_scan CASCADE;
 RESET search_path;
\ No newline at end of file
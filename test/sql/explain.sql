@@ -356,6 +356,24 @@ SELECT explain_as_json($$
 			   SELECT * FROM o_explain_json ORDER BY val_1;
 	   $$)->0->'Plan'->'Actual Rows';
 
+CREATE TABLE o_count_test (
+	id int PRIMARY KEY,
+	val text
+) USING orioledb;
+INSERT INTO o_count_test SELECT i, i::text FROM generate_series(1, 1000) i;
+SET orioledb.enable_count_pushdown = on;
+EXPLAIN (COSTS OFF) SELECT count(*) FROM o_count_test;
+SELECT count(*) FROM o_count_test;
+SELECT count(*), count(*) AS count2 FROM o_count_test;
+SELECT count(*) FROM o_count_test WHERE id > 10;
+BEGIN;
+DELETE FROM o_count_test WHERE id <= 100;
+SELECT count(*) FROM o_count_test;
+ROLLBACK;
+SELECT count(*) FROM o_count_test;
+RESET orioledb.enable_count_pushdown;
+DROP TABLE o_count_test;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA explain CASCADE;
 RESET search_path;
@@ -372,6 +372,23 @@ SET LOCAL enable_seqscan = off;
 SELECT * FROM o_test_expr_table_order ORDER BY id2, id4, (id2 * 10);
 COMMIT;
 
+-- The leading fixed-width attributes are fetched by the precomputed offsets
+CREATE TABLE o_test_fixed_prefix (
+	id int PRIMARY KEY,
+	a int2,
+	b float8,
+	c bool,
+	d text,
+	e int8
+) USING orioledb;
+INSERT INTO o_test_fixed_prefix VALUES (1, 2, 3.5, true, 'x', 4),
+									   (2, NULL, 5.5, false, 'y', 6);
+ALTER TABLE o_test_fixed_prefix ADD COLUMN f int4;
+INSERT INTO o_test_fixed_prefix VALUES (3, 7, 8.5, true, NULL, 9, 10);
+SELECT e, b, id FROM o_test_fixed_prefix ORDER BY id;
+SELECT id, f, a, b, c, d, e FROM o_test_fixed_prefix ORDER BY id;
+DROP TABLE o_test_fixed_prefix;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA getsomeattrs CASCADE;
 RESET search_path;
@@ -1950,6 +1950,26 @@ EXPLAIN (COSTS OFF)
 SELECT * FROM o_test_saop WHERE i < ANY(ARRAY[1, 2]) AND j = ANY(ARRAY[1, 3]) ORDER BY i, j, k;
 SELECT * FROM o_test_saop WHERE i < ANY(ARRAY[1, 2]) AND j = ANY(ARRAY[1, 3]) ORDER BY i, j, k;
 
+CREATE TABLE o_test_skip_scan (
+	tenant_id int NOT NULL,
+	created_at int NOT NULL,
+	val text,
+	PRIMARY KEY (tenant_id, created_at)
+) USING orioledb;
+INSERT INTO o_test_skip_scan
+	SELECT t, c, t || '-' || c
+	FROM generate_series(1, 5) t, generate_series(1, 100) c;
+SET orioledb.enable_skip_scan = on;
+SET enable_seqscan = off;
+SELECT * FROM o_test_skip_scan WHERE created_at = 50;
+SELECT * FROM o_test_skip_scan WHERE created_at BETWEEN 98 AND 99;
+SELECT * FROM o_test_skip_scan WHERE created_at >= 99
+	ORDER BY tenant_id DESC, created_at DESC;
+SELECT * FROM o_test_skip_scan WHERE created_at < 3
+	ORDER BY tenant_id DESC, created_at DESC;
+RESET enable_seqscan;
+RESET orioledb.enable_skip_scan;
+DROP TABLE o_test_skip_scan;
 SELECT orioledb_parallel_debug_stop();
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA indices CASCADE;
@@ -449,6 +449,58 @@ SELECT * FROM o_test_no_parallel_bitmap_scan WHERE val_1 <@ int4range(10,50);
 
 COMMIT;
 
+CREATE TABLE o_test_parallel_bitmap_scan2 (
+	id int4 PRIMARY KEY,
+	val_1 int4
+) USING orioledb;
+INSERT INTO o_test_parallel_bitmap_scan2
+	SELECT v, v % 10 FROM generate_series(1, 10000) v;
+CREATE INDEX o_test_parallel_bitmap_scan2_ix1
+	ON o_test_parallel_bitmap_scan2 (val_1);
+
+BEGIN;
+SET LOCAL orioledb.enable_parallel_bitmap_scan = on;
+SET LOCAL parallel_setup_cost = 0;
+SET LOCAL parallel_tuple_cost = 0;
+SET LOCAL min_parallel_table_scan_size = 0;
+SET LOCAL max_parallel_workers_per_gather = 2;
+SET LOCAL enable_seqscan = off;
+SET LOCAL enable_indexscan = off;
+SET LOCAL enable_indexonlyscan = off;
+SELECT count(*), sum(id) FROM o_test_parallel_bitmap_scan2
+	WHERE val_1 IN (1, 3);
+SELECT count(*), sum(id) FROM o_test_parallel_bitmap_scan2
+	WHERE val_1 = 2 OR id <= 100;
+COMMIT;
+DROP TABLE o_test_parallel_bitmap_scan2;
+
+CREATE TABLE o_test_parallel_index_scan2 (
+	id int4 PRIMARY KEY,
+	val_1 int4
+) USING orioledb;
+INSERT INTO o_test_parallel_index_scan2
+	SELECT v, v % 100 FROM generate_series(1, 100000) v;
+
+BEGIN;
+SET LOCAL orioledb.enable_parallel_index_scan = on;
+SET LOCAL parallel_setup_cost = 0;
+SET LOCAL parallel_tuple_cost = 0;
+SET LOCAL min_parallel_table_scan_size = 0;
+SET LOCAL min_parallel_index_scan_size = 0;
+SET LOCAL max_parallel_workers_per_gather = 2;
+SET LOCAL enable_seqscan = off;
+SET LOCAL enable_bitmapscan = off;
+SELECT count(*), sum(id) FROM o_test_parallel_index_scan2
+	WHERE id > 1000 AND id <= 90000;
+SELECT id, val_1 FROM o_test_parallel_index_scan2
+	WHERE id > 49995 ORDER BY id LIMIT 5;
+SELECT id FROM o_test_parallel_index_scan2
+	WHERE id < 50005 ORDER BY id DESC LIMIT 5;
+SELECT count(*), sum(id) FROM o_test_parallel_index_scan2
+	WHERE id IN (10, 20000, 99999);
+COMMIT;
+DROP TABLE o_test_parallel_index_scan2;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA parallel_scan CASCADE;
 RESET search_path;
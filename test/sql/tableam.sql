@@ -1013,6 +1013,38 @@ COMMIT;
 
 DROP TABLE o_test_1;
 
+-- Sequential scan returns the tuples by the batches of a leaf page
+CREATE TABLE o_test_batch (
+	id int PRIMARY KEY,
+	val text
+) USING orioledb;
+INSERT INTO o_test_batch SELECT i, repeat('x', 100) FROM generate_series(1, 2000) i;
+SELECT count(*), sum(id) FROM o_test_batch;
+
+BEGIN;
+SET LOCAL enable_indexscan = off;
+SET LOCAL enable_bitmapscan = off;
+DECLARE c CURSOR FOR SELECT id FROM o_test_batch;
+FETCH 3 FROM c;
+CLOSE c;
+COMMIT;
+
+-- Simple quals are evaluated against the tuples in the leaf pages
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM o_test_batch WHERE id > 1990;
+SELECT count(*) FROM o_test_batch WHERE id > 1990 AND val = repeat('x', 100);
+ALTER TABLE o_test_batch ADD COLUMN v1 int;
+INSERT INTO o_test_batch VALUES (2001, 'y', 7);
+SELECT id, v1 FROM o_test_batch WHERE v1 = 7;
+SET orioledb.seq_scan_qual_pushdown = off;
+SELECT count(*) FROM o_test_batch WHERE id > 1990;
+RESET orioledb.seq_scan_qual_pushdown;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+
+DROP TABLE o_test_batch;
+
 DROP EXTENSION orioledb CASCADE;
 DROP SCHEMA tableam CASCADE;
 RESET search_path;
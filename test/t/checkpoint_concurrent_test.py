@@ -809,3 +809,51 @@ class CheckpointConcurrentTest(BaseTest):
 		con1.close()
 		con2.close()
 		con3.close()
+
+	def test_checkpoint_xids_queue_overflow(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.enable_stopevents = true\n"
+		    "orioledb.xids_queue_per_backend = 4\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_checkpoint (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_checkpoint\n"
+		    "	(SELECT id, 'x' FROM generate_series(1, 1000, 1) id);\n")
+		con1 = node.connect()
+		con2 = node.connect()
+		con3 = node.connect()
+
+		con3.execute("SELECT pg_stopevent_set('checkpoint_step',\n"
+		             "'$.action == \"walkDownwards\" && "
+		             "$.treeName == \"o_checkpoint_pkey\"');")
+
+		t1 = ThreadQueryExecutor(con1, "CHECKPOINT;")
+		t1.start()
+		wait_checkpointer_stopevent(node)
+
+		# The commits overflow the queue while the checkpointer is stopped
+		for i in range(1, 1001):
+			con2.execute("UPDATE o_checkpoint SET val = 'y' WHERE id = %d;" %
+			             i)
+			con2.commit()
+
+		con3.execute("SELECT pg_stopevent_reset('checkpoint_step')")
+		t1.join()
+
+		con1.close()
+		con2.close()
+		con3.close()
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute(
+		        "SELECT count(*) FROM o_checkpoint WHERE val = 'y';")[0][0],
+		    1000)
+		node.stop()
@@ -99,6 +99,321 @@ class CheckpointerTest(BaseTest):
 		    10000)
 		node.stop()
 
+	def test_checkpoint_io_uring(self):
+		node = self.node
+		node.start()
+		try:
+			node.safe_psql('postgres',
+			               "ALTER SYSTEM SET orioledb.io_method = 'io_uring';")
+		except Exception as e:
+			if 'not supported by this build' in str(e):
+				node.stop()
+				raise unittest.SkipTest('io_uring is not supported by this build')
+			raise
+		node.safe_psql('postgres', "SELECT pg_reload_conf();")
+		self.checkpoint_deferred_writes_base()
+
+	def test_checkpoint_write_combine(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.write_combine_limit = 8\n")
+		node.start()
+		self.checkpoint_deferred_writes_base()
+
+	def test_checkpoint_write_rate_bounds(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.checkpoint_min_write_rate = 1\n"
+		    "orioledb.checkpoint_max_write_rate = 100\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 100) || id
+				 FROM generate_series(1, 100000, 1) id);
+			CHECKPOINT;
+			""")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 100000)
+		node.stop()
+
+	def test_checkpoint_sort_mem(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.checkpoint_sort_mem = 8\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 100) || id
+				 FROM generate_series(1, 200000, 1) id);
+			CHECKPOINT;
+			UPDATE o_test SET val = repeat('y', 100) || id;
+			CHECKPOINT;
+			UPDATE o_test SET val = repeat('z', 100) || id;
+			CHECKPOINT;
+			""")
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass);")[0][0])
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute(
+		        "SELECT count(*) FROM o_test WHERE val LIKE 'z%';")[0][0],
+		    200000)
+		node.stop()
+
+	def test_checkpoint_stats(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 100) || id
+				 FROM generate_series(1, 10000, 1) id);
+			CHECKPOINT;
+			UPDATE o_test SET val = val || 'y';
+			CHECKPOINT;
+			""")
+		rows = node.execute("""
+			SELECT checkpoint_number, in_progress, end_time >= start_time,
+				   trees_done = trees_total, pages_written > 0,
+				   bytes_written > 0, pages_reused <= pages_written,
+				   writeback_time >= 0 AND fsync_time >= 0
+			FROM pg_stat_orioledb_checkpoint
+			ORDER BY checkpoint_number;""")
+		self.assertGreaterEqual(len(rows), 2)
+		for row in rows[-2:]:
+			self.assertEqual(row[1:], (False, True, True, True, True, True,
+			                           True))
+		self.assertEqual(rows[-1][0], rows[-2][0] + 1)
+		node.stop()
+
+	def test_checkpoint_skip_clean_subtrees(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 100) || id
+				 FROM generate_series(1, 100000, 1) id);
+			CHECKPOINT;
+			UPDATE o_test SET val = val || 'y' WHERE id % 10000 = 0;
+			CHECKPOINT;
+			UPDATE o_test SET val = val || 'z' WHERE id % 10000 = 1;
+			CHECKPOINT;
+			""")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(length(val)) FROM o_test;"),
+		    node.execute(
+		        "SELECT 100000::bigint, sum(length(repeat('x', 100) || id) +"
+		        " (id % 10000 IN (0, 1))::int) FROM generate_series(1, 100000) id;"
+		    ))
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop()
+
+	def test_checkpoint_sync_workers(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.checkpoint_sync_workers = 2\n")
+		node.start()
+		node.safe_psql('postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;")
+		for i in range(10):
+			node.safe_psql(
+			    'postgres', """
+				CREATE TABLE o_test_%d (
+					id integer NOT NULL,
+					val text,
+					PRIMARY KEY (id)
+				) USING orioledb;
+				INSERT INTO o_test_%d
+					(SELECT id, repeat('x', 100) || id
+					 FROM generate_series(1, 1000, 1) id);
+				""" % (i, i))
+		node.safe_psql('postgres', "CHECKPOINT;")
+		self.assertGreater(
+		    node.execute("SELECT submitted FROM orioledb_sync_worker_stats();")
+		    [0][0], 0)
+		self.assertEqual(
+		    node.execute("SELECT failed FROM orioledb_sync_worker_stats();")
+		    [0][0], 0)
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		for i in range(10):
+			self.assertEqual(
+			    node.execute("SELECT count(*) FROM o_test_%d;" % i)[0][0],
+			    1000)
+		node.stop()
+
+	def checkpoint_deferred_writes_base(self):
+		node = self.node
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			CREATE TABLE o_test_compressed (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb WITH (compress = 1);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 100) || id
+				 FROM generate_series(1, 100000, 1) id);
+			INSERT INTO o_test_compressed SELECT * FROM o_test;
+			CHECKPOINT;
+			UPDATE o_test SET val = val || 'y' WHERE id % 3 = 0;
+			UPDATE o_test_compressed SET val = val || 'y' WHERE id % 3 = 0;
+			CHECKPOINT;
+			""")
+		node.stop(['-m', 'immediate'])
+
+		self.assertTrue(self.is_checkpoint_exist())
+
+		node.start()
+		for table in ['o_test', 'o_test_compressed']:
+			self.assertEqual(
+			    node.execute("SELECT count(*), sum(length(val)) FROM %s;" %
+			                 table),
+			    node.execute(
+			        "SELECT 100000::bigint, sum(length(repeat('x', 100) || id) +"
+			        " (id % 3 = 0)::int) FROM generate_series(1, 100000) id;"))
+			self.assertTrue(
+			    node.execute("SELECT orioledb_tbl_check('%s'::regclass)" %
+			                 table)[0][0])
+		node.stop()
+
+	def test_compaction_worker(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.enable_compaction = true\n"
+		    "orioledb.compaction_delay = 10\n"
+		    "orioledb.compaction_pages = 100\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb WITH (compress = 1);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 100) || id
+				 FROM generate_series(1, 50000, 1) id);
+			CHECKPOINT;
+			UPDATE o_test SET val = val || 'y' WHERE id % 7 = 0;
+			CHECKPOINT;
+			""")
+		self.assertEqual(
+		    node.execute("SELECT orioledb_compact('o_test'::regclass);")[0][0],
+		    2)
+
+		for i in range(100):
+			node.safe_psql('postgres', "CHECKPOINT;")
+			stats = node.execute("SELECT * FROM orioledb_compaction_stats();")
+			if stats[0][0] == 0:
+				break
+			time.sleep(0.1)
+		self.assertEqual(stats[0][0], 0)
+		self.assertGreater(stats[0][1], 0)
+		self.assertEqual(stats[0][2], 2)
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(length(val)) FROM o_test;"),
+		    node.execute(
+		        "SELECT 50000::bigint, sum(length(repeat('x', 100) || id) +"
+		        " (id % 7 = 0)::int) FROM generate_series(1, 50000) id;"))
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop()
+
+	def test_verify_workers(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.verify_workers = 2\n"
+		    "orioledb.verify_delay = 10\n"
+		    "orioledb.verify_pages = 10\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			CREATE INDEX o_test_val_idx ON o_test (val);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 100) || id
+				 FROM generate_series(1, 50000, 1) id);
+			CHECKPOINT;
+			""")
+		self.assertEqual(
+		    node.execute("SELECT orioledb_verify('o_test'::regclass);")[0][0],
+		    3)
+
+		for i in range(300):
+			status = node.execute("""
+				SELECT count(*) FILTER (WHERE status IN ('queued', 'running'))
+				FROM pg_stat_orioledb_verify;
+			""")
+			if status[0][0] == 0:
+				break
+			time.sleep(0.1)
+		self.assertEqual(
+		    node.execute("""
+				SELECT index_type, status, errors, message
+				FROM pg_stat_orioledb_verify
+				ORDER BY index_type;
+			"""), [('primary', 'passed', 0, None),
+		           ('regular', 'passed', 0, None),
+		           ('toast', 'passed', 0, None)])
+		self.assertGreater(
+		    node.execute("""
+				SELECT pages_checked FROM pg_stat_orioledb_verify
+				WHERE index_type = 'primary';
+			""")[0][0], 10)
+		node.stop()
+
 	def is_checkpoint_exist(self):
 		orioledb_dir = self.node.data_dir + "/orioledb_data"
 		exist = False
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+from .base_test import ThreadQueryExecutor
+
+
+class CompactRowLocksTest(BaseTest):
+
+	def setUp(self):
+		super().setUp()
+		self.node.append_conf('postgresql.conf',
+		                      "orioledb.compact_row_locks = on\n")
+		self.node.start()
+		self.node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test_compact_locks (
+				id int PRIMARY KEY,
+				val int
+			) USING orioledb;
+			INSERT INTO o_test_compact_locks
+				SELECT v, v FROM generate_series(1, 10) v;
+		""")
+
+	def test_compact_row_locks_conflict(self):
+		node = self.node
+		con1 = node.connect()
+		con2 = node.connect()
+
+		con1.begin()
+		self.assertEqual(
+		    10,
+		    len(
+		        con1.execute(
+		            "SELECT * FROM o_test_compact_locks FOR UPDATE;")))
+
+		self.assertEqual([],
+		                 con2.execute("""
+			SELECT * FROM o_test_compact_locks FOR UPDATE SKIP LOCKED;
+		"""))
+		with self.assertRaises(Exception) as e:
+			con2.execute("""
+				SELECT * FROM o_test_compact_locks
+					WHERE id = 3 FOR UPDATE NOWAIT;
+			""")
+		self.assertErrorMessageEquals(
+		    e, "could not obtain lock on row in relation "
+		    "\"o_test_compact_locks\"")
+		con2.rollback()
+
+		# The shared locks of the others are compatible with FOR KEY SHARE
+		self.assertEqual([(5, 5)],
+		                 con2.execute("""
+			SELECT * FROM o_test_compact_locks
+				WHERE id = 5 FOR KEY SHARE NOWAIT;
+		"""))
+		con2.commit()
+
+		t = ThreadQueryExecutor(
+		    con2, "UPDATE o_test_compact_locks SET val = val + 1 "
+		    "WHERE id = 1;")
+		t.start()
+		con1.execute("UPDATE o_test_compact_locks SET val = 0 WHERE id = 2;")
+		con1.commit()
+		t.join()
+		con2.commit()
+
+		self.assertEqual([(1, 2), (2, 0), (3, 3)],
+		                 node.execute("""
+			SELECT * FROM o_test_compact_locks WHERE id <= 3 ORDER BY id;
+		"""))
+
+		con1.close()
+		con2.close()
+
+	def test_compact_row_locks_rollback(self):
+		node = self.node
+		con1 = node.connect()
+		con2 = node.connect()
+
+		con1.begin()
+		con1.execute("SELECT * FROM o_test_compact_locks FOR UPDATE;")
+		con1.execute("UPDATE o_test_compact_locks SET val = 0 WHERE id = 4;")
+		con1.execute("DELETE FROM o_test_compact_locks WHERE id = 5;")
+		con1.rollback()
+
+		self.assertEqual(
+		    10,
+		    len(
+		        con2.execute("""
+			SELECT * FROM o_test_compact_locks FOR UPDATE NOWAIT;
+		""")))
+		con2.rollback()
+		self.assertEqual([(i, i) for i in range(1, 11)],
+		                 node.execute("""
+			SELECT * FROM o_test_compact_locks ORDER BY id;
+		"""))
+
+		# The locks of subtransactions are released on rollback to savepoint
+		con1.begin()
+		con1.execute("SAVEPOINT s1;")
+		con1.execute("SELECT * FROM o_test_compact_locks WHERE id = 6 "
+		             "FOR UPDATE;")
+		con1.execute("ROLLBACK TO SAVEPOINT s1;")
+		self.assertEqual([(6, 6)],
+		                 con2.execute("""
+			SELECT * FROM o_test_compact_locks
+				WHERE id = 6 FOR UPDATE NOWAIT;
+		"""))
+		con2.rollback()
+		con1.rollback()
+		con1.close()
+		con2.close()
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual([(i, i) for i in range(1, 11)],
+		                 node.execute("""
+			SELECT * FROM o_test_compact_locks ORDER BY id;
+		"""))
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+import os
+
+from .base_test import BaseTest
+
+from testgres.exceptions import QueryException
+
+
+class CopyTest(BaseTest):
+
+	def test_copy_unsorted(self):
+		node = self.node
+		node.start()
+		fname = os.path.join(node.base_dir, 'o_copy_data.csv')
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_copy (
+				id int4 NOT NULL PRIMARY KEY,
+				val text
+			) USING orioledb;
+			CREATE INDEX o_copy_val_idx ON o_copy (val);
+			COPY (SELECT i, 'val' || i FROM generate_series(1, 50000) i
+				  ORDER BY (i * 7919) %% 50021) TO '%s' WITH (FORMAT csv);
+			COPY o_copy FROM '%s' WITH (FORMAT csv);
+		""" % (fname, fname))
+		self.assertEqual(
+		    node.execute("SELECT count(*), min(id), max(id) FROM o_copy"),
+		    [(50000, 1, 50000)])
+		self.assertEqual(
+		    node.execute("SELECT id FROM o_copy WHERE val = 'val12345'"),
+		    [(12345, )])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_copy'::regclass)")[0]
+		    [0])
+
+		with self.assertRaises(QueryException) as e:
+			node.safe_psql('postgres',
+			               "COPY o_copy FROM '%s' WITH (FORMAT csv)" % fname)
+		self.assertIn('duplicate key value violates unique constraint',
+		              e.exception.message)
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(id) FROM o_copy"),
+		    [(50000, 1250025000)])
+		self.assertEqual(
+		    node.execute("SELECT val FROM o_copy WHERE id = 49999"),
+		    [('val49999', )])
+		node.stop()
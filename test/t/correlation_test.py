@@ -131,3 +131,46 @@ class CorrelationTest(BaseTest):
 		""")[0][0][0]["Plan"]
 		self.assertEqual('Index Only Scan', plan["Node Type"])
 		self.assertEqual('o_foobar_ix', plan['Index Name'])
+
+	def test_tree_statistics_in_memory(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+
+			CREATE TABLE o_foobar (
+				id SERIAL,
+				k INTEGER DEFAULT '0' NOT NULL,
+				c CHAR(120) DEFAULT '' NOT NULL,
+				PRIMARY KEY (id)
+			) USING orioledb;
+
+			INSERT INTO o_foobar (id, k)
+				SELECT a, 9000000 + a FROM generate_series(1, 100000) a;
+			CREATE INDEX o_foobar_ix ON o_foobar(k);
+			ANALYZE o_foobar;
+		""")
+
+		def total_cost(con, query):
+			return con.execute(f"EXPLAIN (FORMAT JSON) {query}"
+			                   )[0][0][0]["Plan"]["Total Cost"]
+
+		con = node.connect()
+		seq_query = "SELECT * FROM o_foobar"
+		index_query = "SELECT * FROM o_foobar WHERE k > 9050000"
+		con.execute("SET enable_indexscan = off")
+		con.execute("SET enable_bitmapscan = off")
+		seq_cost = total_cost(con, seq_query)
+		con.execute("SET orioledb.enable_tree_statistics = on")
+		seq_cost_in_memory = total_cost(con, seq_query)
+		self.assertLess(seq_cost_in_memory, seq_cost)
+
+		# neither the index pages nor the primary lookups are costed as I/O
+		con.execute("RESET enable_indexscan")
+		con.execute("SET enable_seqscan = off")
+		con.execute("SET orioledb.enable_tree_statistics = off")
+		index_cost = total_cost(con, index_query)
+		con.execute("SET orioledb.enable_tree_statistics = on")
+		index_cost_in_memory = total_cost(con, index_query)
+		self.assertLess(index_cost_in_memory, index_cost)
+		con.close()
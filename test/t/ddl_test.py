@@ -214,3 +214,174 @@ class DDLTest(BaseTest):
 		    con1.execute(f"""
 			SELECT COUNT(*) FROM orioledb_sys_tree_rows(1) r;
 		""")[0][0], 0)
+
+	def test_batched_partitions_recovery(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TYPE o_test_enum AS ENUM ('a', 'b', 'c');
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				kind o_test_enum NOT NULL,
+				val text,
+				PRIMARY KEY (id, kind)
+			) PARTITION BY RANGE (id);
+		""")
+
+		con = node.connect()
+		con.begin()
+		for i in range(50):
+			con.execute(f"""
+				CREATE TABLE o_test_{i} PARTITION OF o_test
+					FOR VALUES FROM ({i * 10}) TO ({i * 10 + 10})
+					USING orioledb;
+			""")
+		con.execute("""
+			INSERT INTO o_test
+				(SELECT id, 'b', id::text FROM generate_series(0, 499) id);
+		""")
+		con.commit()
+		con.close()
+
+		# A failed batched statement leaves no trace
+		with self.assertRaises(QueryException):
+			node.safe_psql("""
+				CREATE TABLE o_test_fail PARTITION OF o_test
+					FOR VALUES FROM (0) TO (10) USING orioledb;
+			""")
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(
+		    node.execute("""
+				SELECT count(*), count(DISTINCT tableoid)
+				FROM o_test WHERE kind = 'b';
+			""")[0], (500, 50))
+		node.stop()
+
+	def test_rewrite_table_exprs(self):
+		node = self.node
+		node.start()
+
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE DOMAIN o_test_dom AS int CHECK (VALUE > 0);
+			CREATE TABLE o_test (
+				id int PRIMARY KEY,
+				val_1 int,
+				val_2 text,
+				val_3 o_test_dom DEFAULT 7
+			) USING orioledb;
+			INSERT INTO o_test (id, val_1, val_2)
+				SELECT v, v * 2, v::text FROM generate_series(1, 1000) v;
+			INSERT INTO o_test VALUES (1001, NULL, NULL, 5);
+			ALTER TABLE o_test
+				ALTER COLUMN val_1 TYPE bigint USING val_1 + id,
+				ALTER COLUMN val_2 TYPE int USING val_2::int * 10;
+		""")
+
+		self.assertEqual(
+		    [(1000, 1501500, 5005000, 7005)],
+		    node.execute("""
+				SELECT count(val_1), sum(val_1), sum(val_2), sum(val_3)
+				FROM o_test;
+			"""))
+		self.assertEqual([(1001, None, None, 5)],
+		                 node.execute("SELECT * FROM o_test WHERE id = 1001;"))
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual([(3, 9, 30, 7)],
+		                 node.execute("SELECT * FROM o_test WHERE id = 3;"))
+		node.stop()
+
+	def test_backend_memory(self):
+		node = self.node
+		node.start()
+		node.safe_psql("CREATE EXTENSION orioledb;")
+		for i in range(20):
+			node.safe_psql("""
+				CREATE TABLE o_test_%d (
+					id int PRIMARY KEY,
+					val text
+				) USING orioledb;
+				INSERT INTO o_test_%d VALUES (1, 'a'), (2, 'b');
+			""" % (i, i))
+
+		con = node.connect()
+		for i in range(20):
+			con.execute("SELECT * FROM o_test_%d;" % i)
+		con.commit()
+		self.assertEqual([(True, )],
+		                 con.execute("""
+			SELECT sum(used_bytes) > 0
+			FROM pg_stat_orioledb_memory_contexts
+			WHERE name = 'OrioleDB descriptors';
+		"""))
+		self.assertEqual([(True, True, 0)],
+		                 con.execute("""
+			SELECT total_bytes >= descriptors_bytes + sys_caches_bytes,
+				   descriptors_bytes > 0,
+				   cache_sheds
+			FROM pg_stat_orioledb_backend_memory
+			WHERE pid = pg_backend_pid();
+		"""))
+		con.commit()
+
+		con.execute("SET orioledb.backend_memory_soft_limit = '1kB';")
+		con.commit()
+		for i in range(20):
+			self.assertEqual([(2, )],
+			                 con.execute("SELECT count(*) FROM o_test_%d;" % i))
+			con.commit()
+		self.assertTrue(
+		    con.execute("""
+			SELECT cache_sheds FROM pg_stat_orioledb_backend_memory
+			WHERE pid = pg_backend_pid();
+		""")[0][0] > 0)
+		con.close()
+		node.stop()
+
+	def test_frozen_table(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test(
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_test SELECT i, 'val' || i
+				FROM generate_series(1, 100) i;
+			ALTER TABLE o_test SET (orioledb_frozen = on);
+		""")
+
+		for query in [
+		    "INSERT INTO o_test VALUES (101, 'val101');",
+		    "UPDATE o_test SET val = 'new' WHERE id = 1;",
+		    "DELETE FROM o_test WHERE id = 1;",
+		    "COPY o_test FROM PROGRAM 'echo 102,val102' CSV;"
+		]:
+			with self.assertRaises(QueryException) as e:
+				node.safe_psql(query)
+			self.assertIn('cannot modify frozen table "o_test"',
+			              e.exception.message)
+
+		self.assertEqual([(100, )],
+		                 node.execute("SELECT count(*) FROM o_test;"))
+		self.assertEqual([('val50', )],
+		                 node.execute("SELECT val FROM o_test WHERE id = 50;"))
+		self.assertEqual([(1, )],
+		                 node.execute("""
+			SELECT id FROM o_test WHERE id = 1 FOR UPDATE;
+		"""))
+
+		node.safe_psql("""
+			ALTER TABLE o_test RESET (orioledb_frozen);
+			INSERT INTO o_test VALUES (101, 'val101');
+			DELETE FROM o_test WHERE id = 1;
+		""")
+		self.assertEqual([(100, )],
+		                 node.execute("SELECT count(*) FROM o_test;"))
+		node.stop()
@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 # coding: utf-8
 
+import os
 import unittest
 
 from .base_test import BaseTest
@@ -87,6 +88,304 @@ class EvictionCompressionTest(BaseTest):
 	def test_eviction_compress_toast(self):
 		self.eviction_toast_base(True)
 
+	def test_eviction_compress_dictionary(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.compress_dictionaries = true\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key integer NOT NULL,
+				kind text NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb WITH (compress = 3);
+			INSERT INTO o_test
+				(SELECT id, 'kind_' || (id % 7), 'value_' || id || '_' || (id % 13)
+				 FROM generate_series(1, 50000, 1) id);
+			CHECKPOINT;
+			""")
+		orioledb_dir = node.data_dir + "/orioledb_data"
+		dicts = [
+		    f for d in os.listdir(orioledb_dir)
+		    if os.path.isdir(os.path.join(orioledb_dir, d))
+		    for f in os.listdir(os.path.join(orioledb_dir, d))
+		    if f.endswith('.dict')
+		]
+		self.assertTrue(len(dicts) > 0)
+
+		node.safe_psql(
+		    'postgres', """
+			INSERT INTO o_test
+				(SELECT id, 'kind_' || (id % 7), 'value_' || id || '_' || (id % 13)
+				 FROM generate_series(50001, 300000, 1) id);
+			UPDATE o_test SET val = val || '_upd' WHERE key % 10 = 0;
+			CHECKPOINT;
+			""")
+		node.stop()
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(key) FROM o_test;"),
+		    [(300000, 45000150000)])
+		self.assertEqual(
+		    node.execute("SELECT val FROM o_test WHERE key = 12340;"),
+		    [('value_12340_3_upd', )])
+		self.assertEqual(
+		    node.execute("SELECT val FROM o_test WHERE key = 250001;"),
+		    [('value_250001_11', )])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop()
+
+	def test_eviction_compress_auto(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.compress_auto = true\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb WITH (compress = 15);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 50) || id
+				 FROM generate_series(1, 100000, 1) id);
+			CHECKPOINT;
+			""")
+		# Switch the same tree to the incompressible data
+		node.safe_psql(
+		    'postgres', """
+			UPDATE o_test SET val = md5(key::text) || md5((key + 1)::text);
+			CHECKPOINT;
+			INSERT INTO o_test
+				(SELECT id, md5(id::text) || md5((id + 1)::text)
+				 FROM generate_series(100001, 300000, 1) id);
+			CHECKPOINT;
+			""")
+		node.stop()
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(key) FROM o_test;"),
+		    [(300000, 45000150000)])
+		self.assertEqual(
+		    node.execute("SELECT val FROM o_test WHERE key = 12345;"),
+		    [(node.execute("SELECT md5('12345') || md5('12346');")[0][0], )])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop()
+
+	def test_eviction_compress_lz4(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql('postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;")
+		try:
+			node.safe_psql(
+			    'postgres', """
+				CREATE TABLE o_test (
+					key integer NOT NULL,
+					val text NOT NULL,
+					PRIMARY KEY (key)
+				) USING orioledb WITH (primary_compress = 'lz4');
+				""")
+		except Exception as e:
+			if 'not supported by this build' in str(e):
+				node.stop()
+				raise unittest.SkipTest('lz4 is not supported by this build')
+			raise
+		node.safe_psql(
+		    'postgres', """
+			SET orioledb.default_compress_codec = 'lz4';
+			CREATE INDEX o_test_ix1 ON o_test (val) WITH (compress = 1);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 50) || id
+				 FROM generate_series(1, 200000, 1) id);
+			CHECKPOINT;
+			""")
+		node.stop()
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(key) FROM o_test;"),
+		    [(200000, 20000100000)])
+		self.assertEqual(
+		    node.execute("SELECT key FROM o_test WHERE val = '%s';" %
+		                 ('x' * 50 + '12345')), [(12345, )])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		self.assertIn(
+		    "Primary compress = lz4:0",
+		    node.execute(
+		        "SELECT orioledb_table_description('o_test'::regclass);")[0][0])
+		node.stop()
+
+	def test_compress_codec_resolved_at_create(self):
+		node = self.node
+		node.start()
+		node.safe_psql('postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;")
+		try:
+			node.safe_psql(
+			    'postgres', """
+				SET orioledb.default_compress_codec = 'lz4';
+				CREATE TABLE o_test (
+					key integer NOT NULL,
+					val text NOT NULL,
+					PRIMARY KEY (key)
+				) USING orioledb WITH (compress = 1, toast_compress = auto);
+				CREATE INDEX o_test_ix1 ON o_test (val) WITH (compress = on);
+				""")
+		except Exception as e:
+			if 'not supported by this build' in str(e):
+				node.stop()
+				raise unittest.SkipTest('lz4 is not supported by this build')
+			raise
+		self.assertEqual(
+		    node.execute("SELECT reloptions FROM pg_class "
+		                 "WHERE relname IN ('o_test', 'o_test_ix1') "
+		                 "ORDER BY relname;"),
+		    [(['compress=lz4:1', 'toast_compress=lz4:0'], ),
+		     (['compress=lz4:0'], )])
+		node.safe_psql(
+		    'postgres', """
+			SET orioledb.default_compress_codec = 'zstd';
+			ALTER TABLE o_test SET (primary_compress = 2);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 50) || id
+				 FROM generate_series(1, 1000, 1) id);
+			VACUUM FULL o_test;
+			REINDEX TABLE o_test;
+			""")
+		self.assertIn(
+		    "Compress = lz4:1, Primary compress = 2, TOAST compress = lz4:0",
+		    node.execute(
+		        "SELECT orioledb_table_description('o_test'::regclass);")[0][0])
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(key) FROM o_test;"),
+		    [(1000, 500500)])
+		node.stop()
+
+	def test_checkpoint_compress_workers(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 64MB\n"
+		    "orioledb.compress_workers = 2\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb WITH (compress = 3);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 50) || id
+				 FROM generate_series(1, 200000, 1) id);
+			CHECKPOINT;
+			""")
+		submitted, used, wasted = node.execute(
+		    "SELECT * FROM orioledb_compress_worker_stats();")[0]
+		self.assertGreater(submitted, 0)
+		self.assertLessEqual(used + wasted, submitted)
+		node.stop()
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(key) FROM o_test;"),
+		    [(200000, 20000100000)])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop()
+
+	def test_eviction_direct_io(self):
+		node = self.node
+		path = os.path.join(node.data_dir, 'direct_io_probe')
+		try:
+			fd = os.open(path, os.O_RDWR | os.O_CREAT | os.O_DIRECT)
+			os.close(fd)
+		except (AttributeError, OSError):
+			raise unittest.SkipTest('O_DIRECT is not supported')
+		finally:
+			if os.path.exists(path):
+				os.unlink(path)
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.direct_io = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb;
+			CREATE TABLE o_test_compress (
+				key integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb WITH (compress = 3);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 50) || id
+				 FROM generate_series(1, 100000, 1) id);
+			INSERT INTO o_test_compress (SELECT * FROM o_test);
+			CHECKPOINT;
+			""")
+		node.stop()
+		node.start()
+		for table in ['o_test', 'o_test_compress']:
+			self.assertEqual(
+			    node.execute("SELECT count(*), sum(key) FROM %s;" % table),
+			    [(100000, 5000050000)])
+			self.assertEqual(
+			    node.execute("SELECT val FROM %s WHERE key = 12345;" % table),
+			    [('x' * 50 + '12345', )])
+			self.assertTrue(
+			    node.execute("SELECT orioledb_tbl_check('%s'::regclass)" %
+			                 table)[0][0])
+		node.stop()
+
+	def test_eviction_compress_free_extents(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				key integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (key)
+			) USING orioledb WITH (compress = 1);
+			INSERT INTO o_test
+				(SELECT id, repeat('x', 50) || id
+				 FROM generate_series(1, 100000, 1) id);
+			CHECKPOINT;
+			""")
+		for i in range(3):
+			node.safe_psql(
+			    'postgres', """
+				UPDATE o_test SET val = val || '%s' WHERE key %% 3 = %s;
+				CHECKPOINT;
+				""" % (i, i))
+			self.assertTrue(
+			    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")
+			    [0][0])
+		node.stop()
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(length(val)) FROM o_test;"),
+		    node.execute("SELECT 100000::bigint, sum(length(repeat('x', 50) "
+		                 "|| id) + 1) FROM generate_series(1, 100000) id;"))
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass)")[0][0])
+		node.stop()
+
 	def test_evict_almost_full_page_when_compressed(self):
 		# Based on this post: http://blog.chenshuo.com/2014/05/incompressible-zlibdeflate-data.html
 		incompressible = []
@@ -1,8 +1,11 @@
 #!/usr/bin/env python3
 # coding: utf-8
 
+import time
 import unittest
 
+from testgres.exceptions import QueryException
+
 from .base_test import BaseTest
 from .base_test import ThreadQueryExecutor
 from .base_test import wait_checkpointer_stopevent
@@ -56,6 +59,494 @@ class EvictionTest(BaseTest):
 		con1.close()
 		node.stop()
 
+	def test_eviction_iterator_prefetch(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_prefetch (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_prefetch\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 200000, 1) id);\n")
+
+		with node.connect() as con:
+			con.execute("SET enable_seqscan = off")
+			con.execute("SET enable_bitmapscan = off")
+			results = []
+			for pages in [0, 1, 64]:
+				con.execute("SET orioledb.iterator_prefetch_pages = %d" %
+				            pages)
+				results.append(
+				    con.execute(
+				        "SELECT count(*), sum(id), min(val), max(val) "
+				        "FROM o_prefetch WHERE id BETWEEN 1000 AND 150000"))
+				results.append(
+				    con.execute("SELECT id FROM o_prefetch "
+				                "WHERE id > 100000 ORDER BY id DESC LIMIT 3"))
+			self.assertEqual(results[0][0][:2], (149001, 11249575500))
+			self.assertEqual(results[1], [(200000, ), (199999, ), (199998, )])
+			self.assertEqual(results[0:2], results[2:4])
+			self.assertEqual(results[0:2], results[4:6])
+		node.stop()
+
+	def test_eviction_unique_reinsert(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_unique (\n"
+		    "	id integer NOT NULL,\n"
+		    "	u integer NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE UNIQUE INDEX o_unique_u_idx ON o_unique (u);\n"
+		    "INSERT INTO o_unique\n"
+		    "	(SELECT id, id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 200000, 1) id);\n"
+		    "DELETE FROM o_unique WHERE u % 3 = 0;\n")
+		# Reinserted keys hit the page boundaries left by the deleted ones
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_unique\n"
+		    "	(SELECT id + 200000, id, repeat('y', 100) || id\n"
+		    "	 FROM generate_series(3, 200000, 3) id);\n")
+		with self.assertRaises(QueryException):
+			node.safe_psql('postgres',
+			               "INSERT INTO o_unique VALUES (300001, 3, 'z');")
+		with self.assertRaises(QueryException):
+			node.safe_psql('postgres',
+			               "INSERT INTO o_unique VALUES (300002, 4, 'z');")
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(u), count(DISTINCT u) "
+		                 "FROM o_unique"), [(200000, 20000100000, 200000)])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_unique'::regclass)")[0]
+		    [0])
+		node.stop()
+
+	def test_eviction_numa_nodes(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.page_pool_numa_nodes = 4\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_numa (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_numa\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 200000, 1) id);\n")
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(id) FROM o_numa"),
+		    [(200000, 20000100000)])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_numa'::regclass)")[0]
+		    [0])
+		node.stop()
+
+	def test_eviction_scan_resistant(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_hot (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "CREATE TABLE o_report (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_hot\n"
+		    "	(SELECT id, 'hot' || id\n"
+		    "	 FROM generate_series(1, 1000, 1) id);\n"
+		    "INSERT INTO o_report\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 200000, 1) id);\n")
+		with node.connect() as con:
+			for setting in ['on', 'off']:
+				con.execute("SET orioledb.scan_resistant_seq_scan = %s" %
+				            setting)
+				con.execute("SET orioledb.scan_resistant_sampling = %s" %
+				            setting)
+				for i in range(1, 1001, 97):
+					self.assertEqual(
+					    con.execute("SELECT val FROM o_hot WHERE id = %d" %
+					                i)[0][0], 'hot%d' % i)
+				self.assertEqual(
+				    con.execute("SELECT count(*), sum(id) FROM o_report"),
+				    [(200000, 20000100000)])
+				con.execute("ANALYZE o_report")
+				self.assertEqual(
+				    con.execute("SELECT count(*) FROM o_hot"), [(1000, )])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_report'::regclass)")[0]
+		    [0])
+		node.stop()
+
+	def test_eviction_sampling_skip_pages(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_report (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_report\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 300000, 1) id);\n")
+		with node.connect() as con:
+			con.execute("SET default_statistics_target = 1")
+			con.execute("SET orioledb.sampling_skip_pages = on")
+			con.execute("ANALYZE o_report")
+			reltuples = con.execute(
+			    "SELECT reltuples FROM pg_class WHERE relname = 'o_report'"
+			)[0][0]
+			self.assertGreater(reltuples, 150000)
+			self.assertLess(reltuples, 450000)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_report'::regclass)")[0]
+		    [0])
+		node.stop()
+
+	def test_eviction_bgwriter_watermarks(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.free_pages_low_watermark = 10\n"
+		    "orioledb.free_pages_high_watermark = 20\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_watermarks (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_watermarks\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 200000, 1) id);\n")
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(id) FROM o_watermarks"),
+		    [(200000, 20000100000)])
+		stats = node.execute(
+		    "SELECT stalls, stall_time_us, bgwriter_evictions "
+		    "FROM orioledb_eviction_stats() WHERE pool_name = 'main'")
+		self.assertEqual(len(stats), 1)
+		stalls, stall_time, bgwriter_evictions = stats[0]
+		# Data doesn't fit main_buffers, so somebody had to evict pages
+		self.assertGreater(stalls + bgwriter_evictions, 0)
+		self.assertGreaterEqual(stall_time, 0)
+		node.stop()
+
+	def test_eviction_bgwriter_regions(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.bgwriter_num_workers = 3\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_regions (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n")
+		for i in range(4):
+			node.safe_psql(
+			    'postgres', "INSERT INTO o_regions\n"
+			    "	(SELECT id, repeat('x', 100) || id\n"
+			    "	 FROM generate_series(%d, %d, 1) id);\n" %
+			    (i * 50000 + 1, (i + 1) * 50000))
+			node.safe_psql('postgres',
+			               "UPDATE o_regions SET val = val || 'u' "
+			               "WHERE id %% 7 = %d;" % i)
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(id), "
+		                 "count(*) FILTER (WHERE val LIKE '%u') "
+		                 "FROM o_regions"), [(200000, 20000100000, 71429)])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_regions'::regclass)")
+		    [0][0])
+		node.stop()
+
+	def test_eviction_prewarm(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.prewarm = true\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_prewarm (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_prewarm\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 100000, 1) id);\n")
+		for i in range(10):
+			node.safe_psql(
+			    'postgres', "SELECT count(*) FROM o_prewarm "
+			    "WHERE id BETWEEN 1 AND 10000;")
+		node.safe_psql('postgres', "CHECKPOINT;")
+		self.assertGreater(
+		    node.execute("SELECT orioledb_prewarm_dump();")[0][0], 0)
+		node.stop()
+
+		# Without the prewarm worker, the pages are loaded by the call below
+		node.append_conf('postgresql.conf', "orioledb.prewarm = false\n")
+		node.start()
+		self.assertGreater(
+		    node.execute("SELECT orioledb_prewarm_load();")[0][0], 0)
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(id) FROM o_prewarm "
+		                 "WHERE id BETWEEN 1 AND 10000;"), [(10000, 50005000)])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_prewarm'::regclass)")
+		    [0][0])
+		node.stop()
+
+	def test_eviction_prewarm_workers(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.prewarm = true\n"
+		    "orioledb.prewarm_workers = 3\n")
+		node.start()
+		node.safe_psql('postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;")
+		for i in range(10):
+			node.safe_psql(
+			    'postgres', "CREATE TABLE o_prewarm%d (\n"
+			    "	id integer NOT NULL PRIMARY KEY,\n"
+			    "	val text NOT NULL\n"
+			    ") USING orioledb;\n"
+			    "INSERT INTO o_prewarm%d\n"
+			    "	(SELECT id, repeat('x', 100) || id\n"
+			    "	 FROM generate_series(1, 1000, 1) id);\n" % (i, i))
+		node.safe_psql('postgres', "CHECKPOINT;")
+		node.stop()
+
+		node.start()
+		for i in range(10):
+			self.assertEqual(
+			    node.execute("SELECT count(*) FROM o_prewarm%d;" % i)[0][0],
+			    1000)
+		node.stop()
+
+	def test_eviction_pool_quota(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.table_pool_quota = 20\n"
+		    "orioledb.database_pool_quota = 90\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_quota_small (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "CREATE TABLE o_quota_large (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_quota_small\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 5000, 1) id);\n")
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_quota_large\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 200000, 1) id);\n")
+		self.assertTrue(
+		    node.execute("SELECT bool_or(over_quota) "
+		                 "FROM orioledb_pool_occupancy() "
+		                 "WHERE pool_name = 'main';")[0][0])
+		self.assertGreater(
+		    node.execute("SELECT sum(pages) FROM orioledb_pool_occupancy() "
+		                 "WHERE datoid = (SELECT oid FROM pg_database "
+		                 "WHERE datname = current_database());")[0][0], 0)
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(id) FROM o_quota_small;"),
+		    [(5000, 12502500)])
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(id) FROM o_quota_large;"),
+		    [(200000, 20000100000)])
+		self.assertTrue(
+		    node.execute(
+		        "SELECT orioledb_tbl_check('o_quota_large'::regclass)")[0][0])
+		node.stop()
+
+	def test_eviction_shared_buffers_huge_pages(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.shared_buffers_huge_pages = try\n"
+		    "orioledb.shared_buffers_transparent_huge_pages = true\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_huge_pages (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_huge_pages\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 100000, 1) id);\n")
+		mapping, size, huge_page_size, huge_pages_size = node.execute(
+		    "SELECT mapping, size, huge_page_size, huge_pages_size "
+		    "FROM orioledb_shared_buffers_info();")[0]
+		self.assertIn(mapping, ['huge_pages', 'regular_pages'])
+		self.assertGreater(size, 8 * 1024 * 1024)
+		if mapping == 'huge_pages':
+			self.assertGreater(huge_page_size, 0)
+			self.assertGreaterEqual(huge_pages_size, size)
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(id) FROM o_huge_pages;"),
+		    [(100000, 5000050000)])
+		node.stop()
+
+	def test_eviction_compressed_cache(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.compressed_cache_size = 32MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_compressed_cache (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_compressed_cache\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 200000, 1) id);\n")
+		node.safe_psql('postgres', "CHECKPOINT;")
+		for i in range(3):
+			self.assertEqual(
+			    node.execute(
+			        "SELECT count(*), sum(id) FROM o_compressed_cache;"),
+			    [(200000, 20000100000)])
+		node.safe_psql(
+		    'postgres', "UPDATE o_compressed_cache SET val = val || 'y'\n"
+		    "	WHERE id % 100 = 0;\n")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_compressed_cache\n"
+		                 "	WHERE val LIKE '%y';"), [(2000, )])
+		self.assertEqual(
+		    node.execute("SELECT val FROM o_compressed_cache WHERE id = 1500;"),
+		    [('x' * 100 + '1500y', )])
+		size, used_slots, hits, inserts = node.execute(
+		    "SELECT size, used_slots, hits, inserts "
+		    "FROM orioledb_compressed_cache_stats();")[0]
+		self.assertGreater(size, 0)
+		self.assertGreater(used_slots, 0)
+		self.assertGreater(inserts, 0)
+		self.assertGreater(hits, 0)
+		self.assertTrue(
+		    node.execute(
+		        "SELECT orioledb_tbl_check('o_compressed_cache'::regclass)")
+		    [0][0])
+		node.stop()
+
+	def test_eviction_zone_map(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.zone_map_size = 1MB\n"
+		    "max_parallel_workers_per_gather = 0\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_zone_map (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	ts integer NOT NULL,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_zone_map\n"
+		    "	(SELECT id, id / 10, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 200000, 1) id);\n")
+		node.safe_psql('postgres', "CHECKPOINT;")
+		for i in range(3):
+			self.assertEqual(
+			    node.execute("SELECT count(*), min(id), max(id) "
+			                 "FROM o_zone_map WHERE ts < 1000;"),
+			    [(9999, 1, 9999)])
+			self.assertEqual(
+			    node.execute("SELECT count(*) FROM o_zone_map "
+			                 "WHERE ts >= 19990 AND ts <= 20000;"), [(101, )])
+			self.assertEqual(
+			    node.execute("SELECT count(*) FROM o_zone_map "
+			                 "WHERE ts = 15000;"), [(10, )])
+		skips, inserts = node.execute(
+		    "SELECT skips, inserts FROM orioledb_zone_map_stats();")[0]
+		self.assertGreater(inserts, 0)
+		self.assertGreater(skips, 0)
+
+		# The rewritten leaves lose their summaries
+		node.safe_psql(
+		    'postgres', "UPDATE o_zone_map SET ts = 0 WHERE id = 150000;\n"
+		    "DELETE FROM o_zone_map WHERE id = 5000;\n")
+		node.safe_psql('postgres', "CHECKPOINT;")
+		for i in range(2):
+			self.assertEqual(
+			    node.execute("SELECT count(*), min(id), max(id) "
+			                 "FROM o_zone_map WHERE ts < 1000;"),
+			    [(9999, 1, 150000)])
+			self.assertEqual(
+			    node.execute("SELECT count(*) FROM o_zone_map "
+			                 "WHERE ts = 15000;"), [(9, )])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_zone_map'::regclass)")
+		    [0][0])
+		node.stop()
+
+	def test_eviction_seq_scan_readahead(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_readahead (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n"
+		    "CREATE TABLE o_readahead_compress (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text NOT NULL,\n"
+		    "	PRIMARY KEY (id)\n"
+		    ") USING orioledb WITH (compress = 1);\n")
+		for table in ['o_readahead', 'o_readahead_compress']:
+			node.safe_psql(
+			    'postgres', "INSERT INTO %s\n"
+			    "	(SELECT id, repeat('x', 100) || id\n"
+			    "	 FROM generate_series(1, 200000, 1) id);\n" % table)
+
+		with node.connect() as con:
+			for table in ['o_readahead', 'o_readahead_compress']:
+				results = []
+				for pages in [0, 1, 7, 128]:
+					con.execute("SET orioledb.seq_scan_readahead_pages = %d" %
+					            pages)
+					results.append(
+					    con.execute("SELECT count(*), sum(id), max(val) "
+					                "FROM %s" % table))
+				self.assertEqual(results[0][0][:2], (200000, 20000100000))
+				for result in results[1:]:
+					self.assertEqual(result, results[0])
+		node.stop()
+
 	def test_eviction_tree(self):
 		INDEX_NOT_LOADED = "Index o_evicted_pkey: not loaded"
 		node = self.node
@@ -616,3 +1107,484 @@ class EvictionTest(BaseTest):
 			    )[0][0].split('\n')[0], INDEX_EMPTY_NOT_LOADED)
 		finally:
 			con1.close()
+
+	def test_eviction_root_info_cache(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.root_info_cache_size = 1\n")
+		node.start()
+		node.safe_psql('postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;")
+		for i in range(20):
+			node.safe_psql(
+			    'postgres', """
+				CREATE TABLE o_root_%d (
+					id int PRIMARY KEY,
+					val text
+				) USING orioledb;
+				CREATE INDEX o_root_%d_val ON o_root_%d (val);
+				INSERT INTO o_root_%d
+					SELECT v, 'val' || v FROM generate_series(1, 100) v;
+			""" % (i, i, i, i))
+
+		# Evict the small tables by filling the memory with a large one
+		node.safe_psql(
+		    'postgres', """
+			CREATE TABLE o_root_large (
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_root_large
+				SELECT v, repeat('x', 100) FROM generate_series(1, 100000) v;
+		""")
+
+		for i in range(20):
+			con = node.connect()
+			self.assertEqual([(100, )],
+			                 con.execute("SELECT count(*) FROM o_root_%d;" % i))
+			self.assertEqual([('val50', )],
+			                 con.execute("SELECT val FROM o_root_%d "
+			                             "WHERE val = 'val50';" % i))
+			con.close()
+
+		node.safe_psql(
+		    'postgres', """
+			DROP TABLE o_root_3;
+			CREATE TABLE o_root_3 (
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_root_3 VALUES (1, 'one');
+		""")
+		self.assertEqual([(1, 'one')],
+		                 node.execute("SELECT * FROM o_root_3;"))
+		self.assertEqual([(100000, )],
+		                 node.execute("SELECT count(*) FROM o_root_large;"))
+		node.stop()
+
+	def test_eviction_tree_stats(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.tree_stats_max = 128\n"
+		    "track_io_timing = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_tree_stats (
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_tree_stats
+				SELECT v, repeat('x', 100) FROM generate_series(1, 100000) v;
+		""")
+		self.assertEqual([(100000, )],
+		                 node.execute("SELECT count(*) FROM o_tree_stats;"))
+
+		stats = node.execute("""
+			SELECT splits > 0, evictions > 0, writes > 0, misses > 0,
+				   disk_loads > 0, hits > 0, load_time >= 0, s3_loads
+			FROM pg_stat_orioledb_trees
+			WHERE reloid = 'o_tree_stats_pkey'::regclass;
+		""")
+		self.assertEqual([(True, True, True, True, True, True, True, 0)],
+		                 stats)
+		# The primary key tree is accounted under the index
+		self.assertEqual(
+		    [('o_tree_stats_pkey', )],
+		    node.execute("""
+				SELECT relname FROM pg_stat_orioledb_trees
+				WHERE reloid = 'o_tree_stats_pkey'::regclass;
+			"""))
+		node.stop()
+
+	def test_eviction_explain_io_details(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_explain_io (
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_explain_io
+				SELECT v, repeat('x', 100) FROM generate_series(1, 100000) v;
+		""")
+		node.restart()
+
+		def find_pages(plan):
+			if 'Primary Pages' in plan:
+				return plan['Primary Pages']
+			for subplan in plan.get('Plans', []):
+				result = find_pages(subplan)
+				if result is not None:
+					return result
+			return None
+
+		con = node.connect()
+		con.execute("SET enable_seqscan = off;")
+		con.execute("SET enable_bitmapscan = off;")
+		query = """
+			EXPLAIN (ANALYZE, BUFFERS, FORMAT JSON)
+				SELECT count(val) FROM o_explain_io WHERE id <= 50000;
+		"""
+		pages = find_pages(con.execute(query)[0][0][0]['Plan'])
+		self.assertTrue(pages['Read'] > 0)
+		self.assertFalse('Disk Read' in pages)
+		self.assertFalse('I/O Time' in pages)
+
+		con.close()
+		node.restart()
+		con = node.connect()
+		con.execute("SET enable_seqscan = off;")
+		con.execute("SET enable_bitmapscan = off;")
+		con.execute("SET orioledb.explain_io_details = on;")
+		pages = find_pages(con.execute(query)[0][0][0]['Plan'])
+		self.assertTrue(pages['Disk Read'] > 0)
+		self.assertTrue(pages['Visibility Checks'] >= 50000)
+		self.assertTrue(pages['I/O Time'] > 0)
+		con.close()
+		node.stop()
+
+	def test_eviction_page_wait_stats(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.tree_stats_max = 128\n"
+		    "orioledb.page_wait_sample_rate = 1\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_page_waits (
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+		""")
+
+		threads = []
+		for i in range(4):
+			con = node.connect()
+			t = ThreadQueryExecutor(
+			    con, """
+				INSERT INTO o_page_waits
+					SELECT v * 4 + %d, repeat('x', 100)
+					FROM generate_series(1, 25000) v;
+			""" % i)
+			t.start()
+			threads.append((t, con))
+		for t, con in threads:
+			t.join()
+			con.commit()
+			con.close()
+
+		self.assertEqual([(100000, )],
+		                 node.execute("SELECT count(*) FROM o_page_waits;"))
+		self.assertEqual([(0, )],
+		                 node.execute("""
+			SELECT count(*) FROM pg_stat_orioledb_page_waits
+			WHERE wait_type NOT IN ('lock', 'read_block', 'split', 'io') OR
+				  level NOT IN ('leaf', 'internal', 'root') OR
+				  waits != (SELECT sum(h) FROM unnest(histogram) h) OR
+				  wait_time < 0;
+		"""))
+		node.stop()
+
+	def test_eviction_op_sampling(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.op_sampling_history_size = 100000\n"
+		    "orioledb.op_sampling_period = 1ms\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_op_samples (
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_op_samples
+				SELECT v, repeat('x', 100) FROM generate_series(1, 200000) v;
+		""")
+		self.assertEqual([(200000, )],
+		                 node.execute("SELECT count(*) FROM o_op_samples;"))
+
+		self.assertEqual([(0, )],
+		                 node.execute("""
+			SELECT count(*) FROM pg_stat_orioledb_op_samples
+			WHERE operation NOT IN ('descent', 'page_lock', 'undo_reserve',
+									'io_read', 'io_write', 'compress',
+									'decompress', 'visibility') OR
+				  pid IS NULL OR sample_time > now();
+		"""))
+		self.assertTrue(
+		    node.execute("""
+			SELECT count(*) FROM pg_stat_orioledb_op_samples
+			WHERE reloid = 'o_op_samples_pkey'::regclass;
+		""")[0][0] > 0)
+		self.assertEqual([(True, )],
+		                 node.execute("""
+			SELECT abs(sum(fraction) - 1.0) < 0.0001
+			FROM pg_stat_orioledb_op_profile;
+		"""))
+		node.stop()
+
+	def test_eviction_ucm_stats(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_ucm_stats (
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_ucm_stats
+				SELECT v, repeat('x', 100) FROM generate_series(1, 200000) v;
+		""")
+		self.assertEqual([(200000, )],
+		                 node.execute("SELECT count(*) FROM o_ucm_stats;"))
+
+		self.assertEqual([(True, True, True, True)],
+		                 node.execute("""
+			SELECT array_length(usage_levels, 1) = 7,
+				   (SELECT sum(l) FROM unnest(usage_levels) l) > 0,
+				   evicted_clean + evicted_dirty > 0,
+				   clock_steps > 0
+			FROM pg_stat_orioledb_ucm
+			WHERE pool_name = 'main';
+		"""))
+		self.assertEqual([(3, )],
+		                 node.execute("""
+			SELECT count(*) FROM pg_stat_orioledb_bgwriter_clocks
+			WHERE bgwriter = 0 AND
+				  region_start <= clock_hand AND clock_hand <= region_end;
+		"""))
+		self.assertEqual([(0, )],
+		                 node.execute("""
+			SELECT count(*) FROM pg_stat_orioledb_free_pages_history
+			WHERE sample_time > now() OR free_pages < 0;
+		"""))
+		node.stop()
+
+	def test_eviction_scan_tuple_refs(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.main_buffers = 8MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_scan_refs (
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_scan_refs
+				SELECT v, repeat('x', 100) || v FROM generate_series(1, 100000) v;
+		""")
+
+		# The cursor keeps the tuples of the leaf image, while the page is
+		# changed and evicted
+		con1 = node.connect()
+		con1.begin('repeatable read')
+		con1.execute("DECLARE c CURSOR FOR SELECT * FROM o_scan_refs;")
+		self.assertEqual([(1, 'x' * 100 + '1')],
+		                 con1.execute("FETCH 1 FROM c;"))
+		node.safe_psql(
+		    'postgres', """
+			UPDATE o_scan_refs SET val = 'y';
+			SELECT count(*) FROM o_scan_refs WHERE val LIKE 'x%';
+		""")
+		self.assertEqual([(2, 'x' * 100 + '2')],
+		                 con1.execute("FETCH 1 FROM c;"))
+		rows = con1.execute("FETCH ALL FROM c;")
+		self.assertEqual(99998, len(rows))
+		self.assertTrue(all(val == 'x' * 100 + str(id) for id, val in rows))
+		con1.execute("CLOSE c;")
+		con1.commit()
+		con1.close()
+		node.stop()
+
+	def test_eviction_resize_main_buffers(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 32MB\n"
+		    "orioledb.main_buffers_max = 64MB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_resize (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_resize\n"
+		    "	(SELECT id, repeat('x', 100) || id\n"
+		    "	 FROM generate_series(1, 200000, 1) id);\n")
+		mb = 1024 * 1024
+		self.assertEqual(
+		    node.execute("SELECT size, max_size, retired_pages, pending_pages "
+		                 "FROM orioledb_main_buffers_info();"),
+		    [(32 * mb, 64 * mb, 32 * mb // 8192, 0)])
+
+		# Shrink below the data size, so the pages in use are evicted
+		pending = node.execute(
+		    "SELECT orioledb_resize_main_buffers(%d);" % (8 * mb))[0][0]
+		size, retired, pending_pages = node.execute(
+		    "SELECT size, retired_pages, pending_pages "
+		    "FROM orioledb_main_buffers_info();")[0]
+		self.assertEqual(size, 8 * mb)
+		self.assertLessEqual(pending_pages, pending)
+		self.assertEqual(retired + pending_pages, 56 * mb // 8192)
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(id) FROM o_resize;"),
+		    [(200000, 20000100000)])
+
+		# Grow past the initial size
+		node.execute("SELECT orioledb_resize_main_buffers(%d);" % (64 * mb))
+		self.assertEqual(
+		    node.execute("SELECT size, retired_pages, pending_pages "
+		                 "FROM orioledb_main_buffers_info();"),
+		    [(64 * mb, 0, 0)])
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_resize\n"
+		    "	(SELECT id, repeat('y', 100) || id\n"
+		    "	 FROM generate_series(200001, 300000, 1) id);\n")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_resize;"), [(300000, )])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_resize'::regclass)")[0][0])
+
+		with self.assertRaises(QueryException):
+			node.execute("SELECT orioledb_resize_main_buffers(%d);" %
+			             (128 * mb))
+		node.stop()
+
+	def test_eviction_balance_pools(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.debug_disable_pools_limit = true\n"
+		    "orioledb.main_buffers = 16MB\n"
+		    "orioledb.catalog_buffers = 256kB\n"
+		    "orioledb.balance_pools = on\n")
+		node.start()
+		node.safe_psql('postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;")
+
+		def pool_pages(name):
+			return node.execute("SELECT all_pages FROM orioledb_page_stats() "
+			                    "WHERE pool_name = '%s';" % name)[0][0]
+
+		catalog_pages = pool_pages('catalog')
+		main_pages = pool_pages('main')
+		for i in range(500):
+			node.safe_psql(
+			    'postgres', "CREATE TABLE o_balance_%d (\n"
+			    "	id integer NOT NULL PRIMARY KEY,\n"
+			    "	a text, b text, c text, d text, e text\n"
+			    ") USING orioledb;\n"
+			    "INSERT INTO o_balance_%d VALUES (1, 'a', 'b', 'c', 'd', 'e');\n"
+			    % (i, i))
+
+		# The catalog pool borrows from the main one
+		for _ in range(100):
+			if pool_pages('catalog') > catalog_pages:
+				break
+			time.sleep(0.1)
+		self.assertGreater(pool_pages('catalog'), catalog_pages)
+		self.assertLess(pool_pages('main'), main_pages)
+		self.assertEqual(
+		    node.execute("SELECT sum(id) FROM (%s) t;" % " UNION ALL ".join(
+		        "SELECT id FROM o_balance_%d" % i for i in range(500)))[0][0],
+		    500)
+
+		# The pages lent back don't grow the main pool past the explicit size
+		node.execute("SELECT orioledb_resize_main_buffers(%d);" %
+		             (12 * 1024 * 1024))
+		for _ in range(20):
+			self.assertLessEqual(pool_pages('main'), 12 * 1024 * 1024 // 8192)
+			time.sleep(0.1)
+		node.stop()
+
+	def test_eviction_index_insert_prefetch(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.index_insert_prefetch = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	a integer NOT NULL,\n"
+		    "	b text NOT NULL,\n"
+		    "	c integer NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_a_idx ON o_test (a);\n"
+		    "CREATE INDEX o_test_b_idx ON o_test (b);\n"
+		    "CREATE INDEX o_test_c_idx ON o_test (c) WHERE c % 2 = 0;\n")
+
+		# the random secondary keys don't fit into the buffers
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test\n"
+		    "	(SELECT id, (id * 7919) % 100003, repeat('x', 100) || "
+		    "(id * 104729) % 100019, id FROM generate_series(1, 100000) id);")
+		node.safe_psql(
+		    'postgres', "COPY o_test FROM PROGRAM "
+		    "'seq 100001 120000 | awk ''{print $1\",\"$1%997\",y\"$1\",\"$1}''' "
+		    "WITH (FORMAT csv);")
+
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass);")[0]
+		    [0])
+		con = node.connect()
+		con.execute("SET enable_seqscan = off;")
+		self.assertEqual(
+		    con.execute("SELECT count(*) FROM o_test WHERE a >= 0;")[0][0],
+		    120000)
+		self.assertEqual(
+		    con.execute("SELECT count(*) FROM o_test WHERE b > '';")[0][0],
+		    120000)
+		self.assertEqual(
+		    con.execute("SELECT count(*) FROM o_test "
+		                "WHERE c % 2 = 0 AND c > 0;")[0][0], 60000)
+		con.close()
+		node.stop()
+
+	def test_eviction_dirty_skips(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = 8MB\n"
+		    "orioledb.eviction_dirty_skips = 16\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE o_test (\n"
+		    "	id integer NOT NULL PRIMARY KEY,\n"
+		    "	val text NOT NULL\n"
+		    ") USING orioledb;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, repeat('x', 100) FROM generate_series(1, 200000) id);"
+		)
+
+		# the scattered updates over the table not fitting into the buffers
+		for i in range(1, 11):
+			node.safe_psql(
+			    'postgres', "UPDATE o_test SET val = repeat('%d', 100)\n"
+			    "	WHERE id %% 1000 = %d;" % (i, i))
+		node.safe_psql('postgres', "CHECKPOINT;")
+
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_test'::regclass);")[0]
+		    [0])
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test "
+		                 "WHERE val <> repeat('x', 100);")[0][0], 2000)
+		node.stop()
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test "
+		                 "WHERE val = repeat('7', 100);")[0][0], 200)
+		node.stop()
@@ -0,0 +1,302 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+
+
+class FastpathTest(BaseTest):
+
+	def test_composite_fixed_width_key(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_fastpath (
+				tenant_id int4 NOT NULL,
+				id int8 NOT NULL,
+				val text,
+				PRIMARY KEY (tenant_id, id)
+			) USING orioledb;
+			INSERT INTO o_fastpath
+				SELECT i % 17, i, 'val' || i
+				FROM generate_series(1, 100000) i;
+		""")
+		for i in [1, 17, 12345, 54321, 99999, 100000]:
+			self.assertEqual(
+			    node.execute(
+			        "SELECT val FROM o_fastpath "
+			        "WHERE tenant_id = %d AND id = %d" % (i % 17, i)),
+			    [('val%d' % i, )])
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_fastpath "
+		                 "WHERE tenant_id = 3 AND id BETWEEN 1000 AND 2000"),
+		    [(59, )])
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_fastpath "
+		                 "WHERE tenant_id = 3 AND id = 1001"), [(0, )])
+		node.stop()
+
+	def test_text_prefix_key(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_fastpath_text (
+				slug text COLLATE "C" NOT NULL PRIMARY KEY,
+				val int4
+			) USING orioledb;
+			CREATE TABLE o_fastpath_bytea (
+				key bytea NOT NULL PRIMARY KEY,
+				val int4
+			) USING orioledb;
+			INSERT INTO o_fastpath_text
+				SELECT 'common-prefix-' || i, i
+				FROM generate_series(1, 50000) i;
+			INSERT INTO o_fastpath_text
+				SELECT 'p' || i, i FROM generate_series(1, 1000) i;
+			INSERT INTO o_fastpath_bytea
+				SELECT ('\\x0000' || lpad(to_hex(i), 8, '0'))::bytea, i
+				FROM generate_series(1, 50000) i;
+		""")
+		for i in [1, 7, 4999, 50000]:
+			self.assertEqual(
+			    node.execute("SELECT val FROM o_fastpath_text "
+			                 "WHERE slug = 'common-prefix-%d'" % i), [(i, )])
+			self.assertEqual(
+			    node.execute("SELECT val FROM o_fastpath_bytea "
+			                 "WHERE key = '\\x0000%08x'::bytea" % i), [(i, )])
+		self.assertEqual(
+		    node.execute("SELECT val FROM o_fastpath_text WHERE slug = 'p77'"),
+		    [(77, )])
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_fastpath_text "
+		                 "WHERE slug < 'common-prefix-2'"), [(11111, )])
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_fastpath_bytea "
+		                 "WHERE key < '\\x0000000000ff'::bytea"), [(254, )])
+		node.stop()
+
+	def test_array_keys_lookup(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_array_lookup (
+				id int4 NOT NULL PRIMARY KEY,
+				grp int4 NOT NULL,
+				val text
+			) USING orioledb;
+			CREATE INDEX o_array_lookup_grp_idx ON o_array_lookup (grp, id);
+			INSERT INTO o_array_lookup
+				SELECT i, i % 10, 'val' || i
+				FROM generate_series(1, 100000) i;
+		""")
+		keys = [0, 1, 2, 500, 501, 7777, 50000, 99999, 100000, 100001]
+		keys_str = ', '.join(str(k) for k in keys)
+		found = [(k, 'val%d' % k) for k in keys if 1 <= k <= 100000]
+		with node.connect() as con:
+			con.execute("SET enable_seqscan = off")
+			con.execute("SET enable_bitmapscan = off")
+			self.assertEqual(
+			    con.execute("SELECT id, val FROM o_array_lookup "
+			                "WHERE id = ANY(ARRAY[%s]) ORDER BY id" %
+			                keys_str), found)
+			self.assertEqual(
+			    con.execute("SELECT id, val FROM o_array_lookup "
+			                "WHERE id = ANY(ARRAY[%s]) ORDER BY id DESC" %
+			                keys_str), list(reversed(found)))
+			self.assertEqual(
+			    con.execute("SELECT grp, id FROM o_array_lookup "
+			                "WHERE grp = ANY(ARRAY[1, 3, 7]) AND "
+			                "id = ANY(ARRAY[%s]) ORDER BY grp, id" % keys_str),
+			    sorted((k % 10, k) for k in keys
+			           if 1 <= k <= 100000 and k % 10 in (1, 3, 7)))
+		node.stop()
+
+	def test_resume_point_lookups(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.resume_point_lookups = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_fk_parent (
+				id int4 NOT NULL PRIMARY KEY,
+				val text
+			) USING orioledb;
+			CREATE TABLE o_fk_child (
+				id int4 NOT NULL PRIMARY KEY,
+				parent_id int4 NOT NULL REFERENCES o_fk_parent (id)
+			) USING orioledb;
+			INSERT INTO o_fk_parent
+				SELECT i * 2, 'val' || i FROM generate_series(1, 50000) i;
+			INSERT INTO o_fk_child
+				SELECT i, (i / 2) * 2 FROM generate_series(2, 100000) i;
+			INSERT INTO o_fk_child
+				SELECT 100000 + i, 100002 - i * 2
+				FROM generate_series(1, 50000) i;
+		""")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_fk_child"), [(149999, )])
+		with self.assertRaises(Exception) as e:
+			node.safe_psql(
+			    'postgres', """
+				INSERT INTO o_fk_child
+					SELECT 200000 + i, i * 2 + (i / 40000)
+					FROM generate_series(1, 50000) i;
+			""")
+		self.assertIn('violates foreign key constraint', str(e.exception))
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_fk_child"), [(149999, )])
+		with node.connect() as con:
+			con.execute("SET enable_seqscan = off")
+			con.execute("SET enable_bitmapscan = off")
+			for i in [2, 4, 1000, 99998, 99999, 100000, 100001]:
+				self.assertEqual(
+				    con.execute("SELECT val FROM o_fk_parent WHERE id = %d" %
+				                i), [('val%d' % (i // 2), )] if i % 2 == 0
+				    and i <= 100000 else [])
+		node.stop()
+
+	def test_point_lookup_hints(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.point_lookup_hints = 100\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_sessions (
+				token text NOT NULL PRIMARY KEY,
+				id int8 NOT NULL UNIQUE,
+				val int4
+			) USING orioledb;
+			INSERT INTO o_sessions
+				SELECT md5(i::text), i, i FROM generate_series(1, 20000) i;
+		""")
+		with node.connect() as con:
+			con.execute("SET enable_seqscan = off")
+			con.execute("SET enable_bitmapscan = off")
+
+			def check(start):
+				for i in range(1, 300, 7):
+					self.assertEqual(
+					    con.execute(
+					        "SELECT val FROM o_sessions WHERE token = md5('%d')"
+					        % i), [(start + i, )] if i % 5 != 0 else [])
+					self.assertEqual(
+					    con.execute(
+					        "SELECT val FROM o_sessions WHERE id = %d::int4" %
+					        i), [(start + i, )] if i % 5 != 0 else [])
+
+			con.execute("DELETE FROM o_sessions WHERE id % 5 = 0")
+			con.commit()
+			check(0)
+			check(0)
+
+			# the hinted leaves split and their change counts move
+			node.safe_psql(
+			    'postgres', """
+				INSERT INTO o_sessions
+					SELECT md5(i::text), i, i
+					FROM generate_series(20001, 60000) i;
+				UPDATE o_sessions SET val = val + 1000000;
+			""")
+			check(1000000)
+		node.stop()
+
+	def test_chunk_common_prefix(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_chunk_prefix (
+				tenant uuid NOT NULL,
+				ts timestamp NOT NULL,
+				id int8 NOT NULL,
+				val int4,
+				PRIMARY KEY (tenant, ts, id)
+			) USING orioledb;
+			CREATE INDEX o_chunk_prefix_val_idx
+				ON o_chunk_prefix (tenant, val, id);
+			INSERT INTO o_chunk_prefix
+				SELECT ('00000000-0000-0000-0000-' ||
+						lpad(to_hex(i % 4), 12, '0'))::uuid,
+					   '2025-01-01'::timestamp + (i / 4) * interval '1 second',
+					   i, i % 1000
+				FROM generate_series(1, 100000) i
+				ORDER BY random();
+		""")
+		tenant = "'00000000-0000-0000-0000-000000000003'::uuid"
+		with node.connect() as con:
+			con.execute("SET enable_seqscan = off")
+			con.execute("SET enable_bitmapscan = off")
+			for i in [3, 7, 40003, 99999]:
+				self.assertEqual(
+				    con.execute(
+				        "SELECT val FROM o_chunk_prefix WHERE "
+				        "tenant = %s AND ts = '2025-01-01'::timestamp + "
+				        "%d * interval '1 second' AND id = %d" %
+				        (tenant, i // 4, i)), [(i % 1000, )])
+			self.assertEqual(
+			    con.execute(
+			        "SELECT count(*) FROM o_chunk_prefix WHERE "
+			        "tenant = %s AND ts < '2025-01-01 01:00'" % tenant),
+			    [(3600, )])
+			self.assertEqual(
+			    con.execute("SELECT count(*) FROM o_chunk_prefix WHERE "
+			                "tenant = %s AND val = 8" % tenant), [(0, )])
+			self.assertEqual(
+			    con.execute("SELECT count(*) FROM o_chunk_prefix WHERE "
+			                "tenant = %s AND val = 3" % tenant), [(100, )])
+		self.assertTrue(
+		    node.execute(
+		        "SELECT orioledb_tbl_check('o_chunk_prefix'::regclass)")[0][0])
+		node.stop()
+
+	def test_uuid_timestamp_key(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_fastpath_uuid (
+				id uuid NOT NULL,
+				ts timestamptz NOT NULL,
+				d date NOT NULL,
+				val int4,
+				PRIMARY KEY (id, ts)
+			) USING orioledb;
+			CREATE INDEX o_fastpath_uuid_d_ts ON o_fastpath_uuid (d, ts);
+			CREATE INDEX o_fastpath_uuid_ts_desc ON o_fastpath_uuid (ts DESC);
+			INSERT INTO o_fastpath_uuid
+				SELECT md5((i % 1000)::text)::uuid,
+					   '2025-01-01 00:00:00+00'::timestamptz + i * interval '1 minute',
+					   '2025-01-01'::date + i % 100,
+					   i
+				FROM generate_series(1, 100000) i;
+		""")
+		for i in [1, 999, 1000, 54321, 100000]:
+			self.assertEqual(
+			    node.execute(
+			        "SELECT val FROM o_fastpath_uuid "
+			        "WHERE id = md5('%d')::uuid "
+			        "AND ts = '2025-01-01 00:00:00+00'::timestamptz "
+			        "+ %d * interval '1 minute'" % (i % 1000, i)), [(i, )])
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_fastpath_uuid "
+		                 "WHERE id = md5('7')::uuid"), [(100, )])
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_fastpath_uuid "
+		                 "WHERE d = '2025-01-11'::date"), [(1000, )])
+		self.assertEqual(
+		    node.execute(
+		        "SELECT val FROM o_fastpath_uuid "
+		        "WHERE ts <= '2025-01-01 00:00:00+00'::timestamptz "
+		        "+ 50000 * interval '1 minute' ORDER BY ts DESC LIMIT 2"),
+		    [(50000, ), (49999, )])
+		node.stop()
@@ -49,6 +49,50 @@ class FileOperationsTest(BaseTest):
 		except Exception:
 			self.assertEqual("We should not be here", "")
 
+	def test_page_checksums(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.page_checksums = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id, 'value' || id FROM generate_series(1, 50000) id);
+			CHECKPOINT;
+			""")
+		datoid = node.execute(
+		    "SELECT oid FROM pg_database WHERE datname = 'postgres';")[0][0]
+		node.stop()
+		node.start()
+		self.assertEqual(node.execute("SELECT count(*) FROM o_test;")[0][0],
+		                 50000)
+		node.stop()
+
+		# Corrupt every page of the data files of the database
+		db_dir = os.path.join(self.getOrioleDBDir(), str(datoid))
+		for f in os.listdir(db_dir):
+			if not re.match(r"^\d+$", f):
+				continue
+			path = os.path.join(db_dir, f)
+			with open(path, "r+b") as fd:
+				size = os.path.getsize(path)
+				for offset in range(100, size, 8192):
+					fd.seek(offset)
+					byte = fd.read(1)
+					fd.seek(offset)
+					fd.write(bytes([byte[0] ^ 0xFF]))
+
+		node.start()
+		with self.assertRaises(Exception):
+			node.safe_psql("SELECT count(*) FROM o_test;")
+		node.stop()
+		with open(node.pg_log_file) as f:
+			self.assertIn("page checksum verification failed", f.read())
+
 	def unsetRWX(self, files):
 		for fname in files:
 			os.chmod(fname, 0o000)
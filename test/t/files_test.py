@@ -384,6 +384,96 @@ class FilesTest(BaseTest):
 		self.assertFalse(bool(re.match(r".*evt", all_files)))
 		self.assertFalse(bool(re.match(r"[0-9]*_[0-9]*_[0-9]*", all_files)))
 
+	def test_drop_table_lazy_cleanup(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.lazy_tree_cleanup = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id, id || 'val' FROM generate_series(1, 100000, 1) id);
+			CHECKPOINT;
+		""")
+		relnode = node.execute("""
+			SELECT relfilenode FROM pg_class
+				WHERE oid = 'o_test_pkey'::regclass::oid
+		""")[0][0]
+		datoid = node.execute("""
+			SELECT oid FROM pg_database WHERE datname = current_database()
+		""")[0][0]
+		db_dir = os.path.join(node.data_dir, "orioledb_data", str(datoid))
+
+		def relnode_files():
+			return [
+			    f for f in os.listdir(db_dir)
+			    if re.match(r"^%d(\D|$)" % relnode, f)
+			]
+
+		self.assertNotEqual([], relnode_files())
+		node.safe_psql('postgres', "DROP TABLE o_test;")
+
+		# the files are unlinked by the backend, the pages are released by
+		# the background writer
+		self.assertEqual([], relnode_files())
+
+		node.safe_psql(
+		    'postgres', """
+			CREATE TABLE o_test (
+				id integer NOT NULL PRIMARY KEY
+			) USING orioledb;
+			INSERT INTO o_test (SELECT generate_series(1, 1000, 1));
+		""")
+		self.assertEqual(
+		    node.execute("SELECT count(*) FROM o_test;")[0][0], 1000)
+		node.stop()
+
+	def test_drop_table_lazy_cleanup_crash(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.lazy_tree_cleanup = on\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id, id || 'val' FROM generate_series(1, 100000, 1) id);
+			CHECKPOINT;
+		""")
+		relnode = node.execute("""
+			SELECT relfilenode FROM pg_class
+				WHERE oid = 'o_test_pkey'::regclass::oid
+		""")[0][0]
+		datoid = node.execute("""
+			SELECT oid FROM pg_database WHERE datname = current_database()
+		""")[0][0]
+		db_dir = os.path.join(node.data_dir, "orioledb_data", str(datoid))
+
+		def relnode_files():
+			return [
+			    f for f in os.listdir(db_dir)
+			    if re.match(r"^%d(\D|$)" % relnode, f)
+			]
+
+		self.assertNotEqual([], relnode_files())
+
+		# The checkpoint after the drop means the recovery doesn't replay it
+		node.safe_psql('postgres', """
+			DROP TABLE o_test;
+			CHECKPOINT;
+		""")
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual([], relnode_files())
+		node.stop()
+
 	def test_drop_extension_cleanup(self):
 		node = self.node
 		node.start()  # start PostgreSQL
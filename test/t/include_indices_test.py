@@ -285,3 +285,81 @@ class IncludeIndicesTest(BaseTest):
 				SELECT * FROM o_test_1 ORDER BY val_1;
 			"""))
 		node.stop()
+
+	def test_include_index_update(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+
+			CREATE TABLE o_test_include_update (
+				id int PRIMARY KEY,
+				val int,
+				inc text,
+				other int
+			) USING orioledb;
+
+			CREATE INDEX o_test_include_update_ix1
+				ON o_test_include_update (val) INCLUDE (inc);
+			CREATE INDEX o_test_include_update_ix2
+				ON o_test_include_update (other);
+
+			INSERT INTO o_test_include_update
+				SELECT v, v * 10, 'inc' || v, v FROM generate_series(1, 5) v;
+		""")
+
+		def check(expected):
+			with node.connect() as con:
+				con.execute("SET enable_seqscan = off;")
+				con.execute("SET enable_bitmapscan = off;")
+				plan = con.execute("""
+					EXPLAIN (COSTS OFF, FORMAT JSON)
+						SELECT val, inc FROM o_test_include_update
+							WHERE val > 0 ORDER BY val;
+				""")[0][0][0]["Plan"]
+				self.assertEqual('Index Only Scan', plan["Node Type"])
+				self.assertEqual('o_test_include_update_ix1',
+				                 plan['Index Name'])
+				self.assertEqual(
+				    expected,
+				    con.execute("""
+						SELECT val, inc FROM o_test_include_update
+							WHERE val > 0 ORDER BY val;
+					"""))
+				self.assertEqual(
+				    [(1,), (2,), (3,), (4,), (5,)],
+				    con.execute("""
+						SELECT other FROM o_test_include_update
+							WHERE other > 0 ORDER BY other;
+					"""))
+
+		for skip in ['off', 'on']:
+			node.safe_psql("""
+				SET orioledb.skip_unchanged_indices = %s;
+				UPDATE o_test_include_update SET inc = 'new' || id
+					WHERE id <= 2;
+				UPDATE o_test_include_update SET other = other + 10
+					WHERE id = 3;
+				UPDATE o_test_include_update SET other = other - 10
+					WHERE id = 3;
+				UPDATE o_test_include_update SET val = val + 1
+					WHERE id = 5;
+			""" % skip)
+			check([(10, 'new1'), (20, 'new2'), (30, 'inc3'), (40, 'inc4'),
+			       (51 if skip == 'off' else 52, 'inc5')])
+
+		node.safe_psql("""
+			SET orioledb.skip_unchanged_indices = on;
+			BEGIN;
+			UPDATE o_test_include_update SET inc = 'rollback' WHERE id = 4;
+			ROLLBACK;
+			UPDATE o_test_include_update SET inc = 'last' WHERE id = 3;
+		""")
+		expected = [(10, 'new1'), (20, 'new2'), (30, 'last'), (40, 'inc4'),
+		            (52, 'inc5')]
+		check(expected)
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+		check(expected)
+		node.stop()
@@ -12,6 +12,7 @@ from .base_test import wait_stopevent
 
 import string
 import random
+import time
 
 
 class SplitTest(BaseTest):
@@ -388,6 +389,31 @@ class SplitTest(BaseTest):
 
 		self.stopAll()
 
+	def test_incomplete_leaf_background_fix(self):
+		node = self.node
+		node.safe_psql("ALTER SYSTEM SET orioledb.split_fix_delay = 0;")
+		node.safe_psql("SELECT pg_reload_conf();")
+		self.insertToSplitTable(node, 10, 50, 4)
+
+		con1 = self.createConnection()
+		con1.execute("SET orioledb.enable_stopevents = true;")
+
+		con2 = self.createConnection()
+		con2.execute("SELECT pg_stopevent_set('split_fail', 'true');")
+
+		self.failedInsertToSplitTable(con1, 51, 90, 4)
+		con2.execute("SELECT pg_stopevent_reset('split_fail');")
+
+		# the background writer fixes the split without any modification
+		for _ in range(100):
+			if node.execute(
+			    "SELECT orioledb_tbl_check('o_split'::regclass)")[0][0]:
+				break
+			time.sleep(0.1)
+		self.checkSplitTable(11, True)
+
+		self.stopAll()
+
 	def createConnection(self):
 		connection = self.node.connect()
 		self.connections.append(connection)
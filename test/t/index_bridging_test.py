@@ -194,6 +194,60 @@ class IndexBridgingTest(BaseTest):
 		    expected_ctids, key=lambda ctid: int(ctid[0][1:-1].split(',')[1]))
 		check(expected_ctids)
 
+	def test_ctid_leases(self):
+		node = self.node
+		node.append_conf("orioledb.ctid_lease_size = 1024")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+			CREATE TABLE o_test (
+				i int NOT NULL,
+				j int
+			) USING orioledb;
+			CREATE INDEX o_test_ix1 ON o_test USING btree (j)
+				WITH (orioledb_index=off);
+		""")
+
+		con1 = node.connect()
+		con2 = node.connect()
+		for k in range(3):
+			con1.execute("INSERT INTO o_test SELECT v, v FROM "
+			             "generate_series(%d, %d) v;" %
+			             (k * 2000 + 1, k * 2000 + 1000))
+			con1.commit()
+			con2.execute("INSERT INTO o_test SELECT v, v FROM "
+			             "generate_series(%d, %d) v;" %
+			             (k * 2000 + 1001, k * 2000 + 2000))
+			con2.commit()
+
+		# The rows of each backend come in the leased ranges of ctids
+		self.assertEqual(
+		    [(6000, 6000)],
+		    node.execute("SELECT count(*), count(DISTINCT ctid) FROM o_test"))
+		self.assertEqual([(1, '(0,1)'), (1000, '(0,1000)'),
+		                  (1001, '(0,1025)'), (2001, '(0,1001)')],
+		                 con1.execute("""
+			SELECT i, ctid::text FROM o_test
+				WHERE i IN (1, 1000, 1001, 2001) ORDER BY i;
+		"""))
+		con1.close()
+		con2.close()
+
+		with node.connect() as con:
+			con.execute("SET enable_seqscan = off;")
+			self.assertEqual(
+			    [(6000, )],
+			    con.execute("SELECT count(*) FROM o_test WHERE j > 0;"))
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+		node.safe_psql("INSERT INTO o_test SELECT v, v FROM "
+		               "generate_series(6001, 7000) v;")
+		self.assertEqual(
+		    [(7000, 7000)],
+		    node.execute("SELECT count(*), count(DISTINCT ctid) FROM o_test"))
+		node.stop()
+
 	def test_bridge_recovery(self):
 		node = self.node
 		node.start()
@@ -252,3 +306,71 @@ class IndexBridgingTest(BaseTest):
 							SET LOCAL enable_seqscan = off;
 							SELECT * FROM o_test ORDER BY j;
 						 """))
+
+	def test_bridged_bitmap_scan_many_hits(self):
+		node = self.node
+		node.start()
+
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+
+			CREATE TABLE o_test (
+				i int PRIMARY KEY,
+				j int[]
+			) USING orioledb WITH (index_bridging);
+
+			CREATE INDEX o_test_ix1 ON o_test USING gin (j);
+
+			INSERT INTO o_test
+				SELECT v, ARRAY[v % 3, 10 + v % 7] FROM generate_series(1, 5000) v;
+			DELETE FROM o_test WHERE i % 5 = 0;
+		""")
+
+		query = "SELECT count(*), sum(i) FROM o_test WHERE j @> ARRAY[%d];"
+		with node.connect() as con:
+			con.execute("SET enable_seqscan = off;")
+			con.execute("SET enable_indexscan = off;")
+			for value in [0, 1, 12]:
+				self.assertEqual(
+				    con.execute(query % value)[0],
+				    node.execute("""
+						SELECT count(*), sum(i) FROM o_test
+						WHERE %s = ANY(j);
+					""" % value)[0])
+			self.assertEqual([(0, None)], con.execute(query % 100))
+
+	def test_bridged_partial_index_update(self):
+		node = self.node
+		node.start()
+
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+
+			CREATE TABLE o_test (
+				i int PRIMARY KEY,
+				j int[],
+				k int
+			) USING orioledb WITH (index_bridging);
+
+			CREATE INDEX o_test_ix1 ON o_test USING gin (j) WHERE k > 0;
+			CREATE INDEX o_test_ix2 ON o_test USING gin (j) WHERE k < 0;
+
+			INSERT INTO o_test
+				SELECT v, ARRAY[v % 3], v % 2 * 2 - 1
+				FROM generate_series(1, 1000) v;
+			UPDATE o_test SET j = ARRAY[5] WHERE i % 10 = 0;
+			UPDATE o_test SET k = -k WHERE i % 7 = 0;
+		""")
+
+		with node.connect() as con:
+			con.execute("SET enable_seqscan = off;")
+			con.execute("SET enable_indexscan = off;")
+			for pred in ["k > 0", "k < 0"]:
+				query = "SELECT count(*), sum(i) FROM o_test " \
+				        "WHERE j @> ARRAY[5] AND %s;" % pred
+				self.assertEqual(
+				    con.execute(query)[0],
+				    node.execute("""
+						SELECT count(*), sum(i) FROM o_test
+						WHERE 5 = ANY(j) AND %s;
+					""" % pred)[0])
@@ -654,6 +654,114 @@ class IndicesBuildTest(BaseTest):
 		    'o_indices_ix1')
 		node.stop()
 
+	def test_index_build_abbreviated_keys(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+			CREATE TABLE o_abbrev (
+				id int8 NOT NULL,
+				u uuid,
+				t text,
+				i int4,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_abbrev
+				SELECT (v * 7919) % 20011,
+					md5(v::text)::uuid,
+					CASE WHEN v % 100 = 0 THEN NULL
+						 ELSE repeat('p', 20) || md5((v % 5000)::text) END,
+					(v * 31) % 1000 - 500
+				FROM generate_series(1, 20000) v;
+			SET maintenance_work_mem = '1MB';
+			CREATE INDEX o_abbrev_u ON o_abbrev (u);
+			CREATE INDEX o_abbrev_t ON o_abbrev (t, i);
+			CREATE INDEX o_abbrev_t_c ON o_abbrev (t COLLATE "C" DESC);
+			CREATE INDEX o_abbrev_i ON o_abbrev (i DESC);
+		""")
+
+		con = node.connect()
+		for columns, order, index in [
+		    ("u", "u", "o_abbrev_u"), ("t, i", "t, i", "o_abbrev_t"),
+		    ("t", "t COLLATE \"C\" DESC", "o_abbrev_t_c"),
+		    ("i", "i DESC", "o_abbrev_i")
+		]:
+			query = "SELECT %s FROM o_abbrev ORDER BY %s" % (columns, order)
+			con.execute("SET enable_seqscan = off;")
+			plan = con.execute("EXPLAIN (FORMAT JSON) %s" % query)[0][0]
+			self.assertEqual(plan[0]["Plan"]["Index Name"], index)
+			result = con.execute(query)
+			con.execute("RESET enable_seqscan;")
+			con.execute("SET enable_indexscan = off;")
+			con.execute("SET enable_indexonlyscan = off;")
+			con.execute("SET enable_bitmapscan = off;")
+			self.assertEqual(con.execute(query), result)
+			con.execute("RESET ALL;")
+		con.close()
+
+		with self.assertRaises(Exception) as e:
+			node.safe_psql("""
+				CREATE UNIQUE INDEX o_abbrev_t_uniq ON o_abbrev (t);
+			""")
+		self.assertIn("could not create unique index", str(e.exception))
+		node.stop()
+
+	def test_index_build_radix_sort(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.index_build_radix_sort = on\n")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+			CREATE TABLE o_radix (
+				id int8 NOT NULL,
+				u uuid,
+				i int4,
+				s int2,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_radix
+				SELECT (v * 7919) % 20011 - 10000,
+					md5(v::text)::uuid,
+					CASE WHEN v % 100 = 0 THEN NULL
+						 ELSE (v * 31) % 1000 - 500 END,
+					v % 7 - 3
+				FROM generate_series(1, 20000) v;
+			CREATE INDEX o_radix_u ON o_radix (u DESC);
+			CREATE INDEX o_radix_i_s ON o_radix (i, s DESC);
+			CREATE INDEX o_radix_s ON o_radix (s NULLS FIRST);
+		""")
+		# the tuples don't fit into work_mem, so tuplesort is used
+		node.safe_psql("""
+			SET work_mem = '64kB';
+			CREATE INDEX o_radix_i ON o_radix (i DESC NULLS LAST);
+		""")
+
+		con = node.connect()
+		for columns, order, index in [
+		    ("u", "u DESC", "o_radix_u"), ("i, s", "i, s DESC", "o_radix_i_s"),
+		    ("s", "s NULLS FIRST", "o_radix_s"),
+		    ("i", "i DESC NULLS LAST", "o_radix_i")
+		]:
+			query = "SELECT %s FROM o_radix ORDER BY %s" % (columns, order)
+			con.execute("SET enable_seqscan = off;")
+			plan = con.execute("EXPLAIN (FORMAT JSON) %s" % query)[0][0]
+			self.assertEqual(plan[0]["Plan"]["Index Name"], index)
+			result = con.execute(query)
+			con.execute("RESET enable_seqscan;")
+			con.execute("SET enable_indexscan = off;")
+			con.execute("SET enable_indexonlyscan = off;")
+			con.execute("SET enable_bitmapscan = off;")
+			self.assertEqual(con.execute(query), result)
+			con.execute("RESET ALL;")
+		con.close()
+
+		node.safe_psql("CREATE UNIQUE INDEX o_radix_id_s ON o_radix (id, s);")
+		with self.assertRaises(Exception) as e:
+			node.safe_psql("CREATE UNIQUE INDEX o_radix_s_uniq ON o_radix (s);")
+		self.assertIn("could not create unique index", str(e.exception))
+		node.stop()
+
 	def get_map_files(self, filter_files):
 		map_files = []
 
@@ -58,6 +58,105 @@ class LogicalTest(BaseTest):
 		    "BEGIN\ntable public.data: INSERT: id[integer]:1 data[text]:'1'\ntable public.data: INSERT: id[integer]:2 data[text]:'2'\nCOMMIT\n"
 		)
 
+	@unittest.skipIf(not BaseTest.extension_installed("test_decoding"),
+	                 "'test_decoding' is not installed")
+	def test_rollback_to_savepoint(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE data(id serial primary key, data text) USING orioledb;\n"
+		)
+
+		node.safe_psql(
+		    'postgres',
+		    "SELECT * FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding', false, true);\n"
+		)
+
+		node.safe_psql(
+		    'postgres', "BEGIN;\n"
+		    "INSERT INTO data(data) VALUES('1');\n"
+		    "SAVEPOINT s1;\n"
+		    "INSERT INTO data(data) VALUES('2');\n"
+		    "SAVEPOINT s2;\n"
+		    "INSERT INTO data(data) VALUES('3');\n"
+		    "ROLLBACK TO SAVEPOINT s1;\n"
+		    "INSERT INTO data(data) VALUES('4');\n"
+		    "COMMIT;\n")
+
+		result = self.squashLogicalChanges(
+		    node.execute(
+		        "SELECT * FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL);"
+		    ))
+		self.assertEqual(
+		    result,
+		    "BEGIN\ntable public.data: INSERT: id[integer]:1 data[text]:'1'\ntable public.data: INSERT: id[integer]:4 data[text]:'4'\nCOMMIT\n"
+		)
+
+	@unittest.skipIf(not BaseTest.extension_installed("test_decoding"),
+	                 "'test_decoding' is not installed")
+	def test_stream_in_progress(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "logical_decoding_work_mem = 64kB\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE data(id int primary key, data text) USING orioledb;\n"
+		)
+
+		node.safe_psql(
+		    'postgres',
+		    "SELECT * FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding', false, true);\n"
+		)
+
+		node.safe_psql(
+		    'postgres', "BEGIN;\n"
+		    "INSERT INTO data (SELECT id, repeat('x', 100) FROM generate_series(1, 2000) id);\n"
+		    "SAVEPOINT s1;\n"
+		    "INSERT INTO data (SELECT id, repeat('y', 100) FROM generate_series(2001, 4000) id);\n"
+		    "ROLLBACK TO SAVEPOINT s1;\n"
+		    "COMMIT;\n")
+		node.safe_psql(
+		    'postgres', "BEGIN;\n"
+		    "INSERT INTO data (SELECT id, repeat('z', 100) FROM generate_series(4001, 6000) id);\n"
+		    "ROLLBACK;\n")
+
+		rows = [
+		    row[2] for row in node.execute(
+		        "SELECT * FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL, 'stream-changes', '1', 'include-xids', '0');"
+		    )
+		]
+		self.assertIn('opening a streamed block for transaction', rows)
+		self.assertIn('committing streamed transaction', rows)
+		self.assertIn('aborting streamed (sub)transaction', rows)
+
+	@unittest.skipIf(not BaseTest.extension_installed("test_decoding"),
+	                 "'test_decoding' is not installed")
+	def test_unchanged_toast(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE docs(id int primary key, val int, doc text) USING orioledb;\n"
+		    "ALTER TABLE docs ALTER COLUMN doc SET STORAGE EXTERNAL;\n"
+		    "INSERT INTO docs VALUES (1, 1, repeat('x', 10000));\n")
+
+		node.safe_psql(
+		    'postgres',
+		    "SELECT * FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding', false, true);\n"
+		)
+
+		node.safe_psql('postgres', "UPDATE docs SET val = 2 WHERE id = 1;\n")
+
+		result = self.squashLogicalChanges(
+		    node.execute(
+		        "SELECT * FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL);"
+		    ))
+		self.assertEqual(
+		    result,
+		    "BEGIN\ntable public.docs: UPDATE: old-key: id[integer]:1 new-tuple: id[integer]:1 val[integer]:2 doc[text]:unchanged-toast-datum\nCOMMIT\n"
+		)
+
 	@unittest.skipIf(not BaseTest.extension_installed("wal2json"),
 	                 "'wal2json' is not installed")
 	def test_wal2json(self):
@@ -204,3 +303,80 @@ class LogicalTest(BaseTest):
 					self.assertListEqual(
 					    subscriber.execute(
 					        'SELECT * FROM o_test2 ORDER BY id'), [])
+
+	def test_logical_subscription_apply_batch(self):
+		with self.node as publisher:
+			publisher.start()
+
+			baseDir = mkdtemp(prefix=self.myName + '_tgsb_')
+			subscriber = testgres.get_new_node('subscriber',
+			                                   port=self.getBasePort() + 1,
+			                                   base_dir=baseDir)
+			subscriber.init(["--no-locale", "--encoding=UTF8"])
+			subscriber.append_conf(shared_preload_libraries='orioledb')
+			subscriber.append_conf(wal_level='logical')
+			subscriber.append_conf('orioledb.logical_apply_batch_size = 10')
+
+			with subscriber.start() as subscriber:
+				create_sql = """
+					CREATE EXTENSION IF NOT EXISTS orioledb;
+					CREATE TABLE o_test1 (
+						id integer primary key,
+						data text
+					) USING orioledb;
+					CREATE TABLE o_test2 (
+						id integer primary key,
+						data text
+					) USING orioledb;
+					CREATE INDEX o_test2_data_idx ON o_test2 (data);
+				"""
+				publisher.safe_psql(create_sql)
+				subscriber.safe_psql(create_sql)
+
+				pub = publisher.publish('test_pub',
+				                        tables=['o_test1', 'o_test2'])
+				sub = subscriber.subscribe(pub, 'test_sub')
+
+				with publisher.connect() as con:
+					# inserts in the reverse key order switching the tables
+					for i in range(100, 0, -1):
+						con.execute(
+						    "INSERT INTO o_test1 VALUES (%d, 'a%d');" % (i, i))
+						if i % 3 == 0:
+							con.execute(
+							    "INSERT INTO o_test2 VALUES (%d, 'b%d');" %
+							    (i, i))
+					# changes of the rows inserted in the same transaction
+					con.execute(
+					    "UPDATE o_test1 SET data = 'upd' WHERE id <= 5;")
+					con.execute("DELETE FROM o_test2 WHERE id > 50;")
+					con.execute(
+					    "INSERT INTO o_test1 (SELECT id, 'c' || id "
+					    "FROM generate_series(101, 200) id);")
+					con.commit()
+
+				sub.catchup()
+				self.assertListEqual(
+				    subscriber.execute(
+				        "SELECT count(*), sum(id), "
+				        "count(*) FILTER (WHERE data = 'upd') FROM o_test1"),
+				    [(200, 20100, 5)])
+				self.assertListEqual(
+				    subscriber.execute(
+				        "SELECT count(*), sum(id) FROM o_test2 "
+				        "WHERE data >= 'b'"), [(16, 408)])
+				self.assertTrue(
+				    subscriber.execute(
+				        "SELECT orioledb_tbl_check('o_test2'::regclass)")[0][0])
+
+				with publisher.connect() as con:
+					con.execute("INSERT INTO o_test1 VALUES (201, 'd');")
+					con.execute("INSERT INTO o_test1 VALUES (0, 'd');")
+					con.rollback()
+					con.execute("INSERT INTO o_test1 VALUES (202, 'd');")
+					con.commit()
+
+				sub.catchup()
+				self.assertListEqual(
+				    subscriber.execute("SELECT id FROM o_test1 "
+				                       "WHERE data = 'd'"), [(202, )])
@@ -78,6 +78,40 @@ class MergeTest(BaseTest):
 		    node.execute("SELECT orioledb_tbl_check('o_merge'::regclass)")[0]
 		    [0])
 
+	def test_background_merge(self):
+		node = self.node
+		node.stop()
+		node.append_conf(
+		    'postgresql.conf', "orioledb.enable_background_merge = true\n"
+		    "orioledb.background_merge_delay = 10\n")
+		node.start()
+		node.execute("INSERT INTO o_merge"
+		             "(SELECT id FROM generate_series(1, 100000, 1) id);")
+		leaves_before = node.execute(
+		    "SELECT count FROM orioledb_tree_stat('o_merge'::regclass) "
+		    "WHERE level = 0")[0][0]
+
+		node.execute("DELETE FROM o_merge WHERE id % 10 != 0;")
+		node.poll_query_until(
+		    "SELECT count <= %d FROM orioledb_tree_stat('o_merge'::regclass) "
+		    "WHERE level = 0" % (leaves_before // 2))
+		self.assertGreater(
+		    node.execute("SELECT pages_merged "
+		                 "FROM orioledb_merge_worker_stats();")[0][0], 0)
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_merge;")[0][0], 10000)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_merge'::regclass)")[0]
+		    [0])
+		node.stop()
+
+		node.start()
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_merge;")[0][0], 10000)
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_merge'::regclass)")[0]
+		    [0])
+
 	def test_concurrent_checkpoint_begin(self):
 		self.concurrent_checkpoint_base(0, 2600, 1)
 
@@ -309,3 +309,42 @@ class NotSupportedYetTest(BaseTest):
 		node.safe_psql("""
 			REINDEX TABLE o_test;
 		""")
+
+	def test_create_index_concurrently_fallback(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.create_index_concurrently_fallback = on\n")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+		""")
+
+		node.safe_psql("""
+			CREATE TABLE o_test
+			(
+				i int
+			) USING orioledb;
+			INSERT INTO o_test SELECT v FROM generate_series(1, 100) v;
+		""")
+
+		node.safe_psql("""
+			CREATE INDEX CONCURRENTLY o_test_ix ON o_test (i);
+		""")
+
+		self.assertEqual(
+		    [(True, True)],
+		    node.execute("""
+				SELECT indisvalid, indisready FROM pg_index
+				WHERE indexrelid = 'o_test_ix'::regclass;
+			"""))
+		self.assertEqual([(50, )],
+		                 node.execute("""
+				SET enable_seqscan = off;
+				SELECT i FROM o_test WHERE i = 50;
+			"""))
+		node.safe_psql("INSERT INTO o_test VALUES (101);")
+		self.assertEqual([(101, )],
+		                 node.execute("""
+				SET enable_seqscan = off;
+				SELECT i FROM o_test WHERE i = 101;
+			"""))
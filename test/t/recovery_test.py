@@ -655,6 +655,144 @@ class RecoveryTest(BaseTest):
 		    "[(1001, 'xxx2'), (1003, 'zzz1'), (1006, 'zzz4')]")
 		node.stop()  # stop PostgreSQL
 
+	def test_wal_commit_delay(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.commit_delay = 1000\n"
+		    "commit_siblings = 1\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val integer NOT NULL,
+				PRIMARY KEY (id)
+			) USING orioledb;
+		""")
+
+		threads = []
+		cons = []
+		for i in range(8):
+			con = node.connect(autocommit=True)
+			cons.append(con)
+			threads.append(
+			    ThreadQueryExecutor(
+			        con, """
+				DO $$
+				BEGIN
+					FOR j IN 0..49 LOOP
+						INSERT INTO o_test VALUES (%d * 50 + j, j);
+						COMMIT;
+					END LOOP;
+				END $$;""" % i))
+		for t in threads:
+			t.start()
+		for t in threads:
+			t.join()
+		for con in cons:
+			con.close()
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute('postgres',
+		                 'SELECT count(*), sum(id) FROM o_test;')[0],
+		    (400, 79800))
+		node.stop()
+
+	def test_wal_compress(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (id)
+			) USING orioledb;
+		""")
+
+		def wal_size(compress, first):
+			con = node.connect()
+			con.execute("SET orioledb.wal_compress = %d;" % compress)
+			start = con.execute("SELECT pg_current_wal_insert_lsn();")[0][0]
+			con.execute("""
+				INSERT INTO o_test
+					(SELECT id, repeat('orioledb', 50) || id
+					FROM generate_series(%d, %d) id);""" % (first, first + 999))
+			con.commit()
+			size = con.execute(
+			    "SELECT pg_current_wal_insert_lsn() - '%s'::pg_lsn;" %
+			    start)[0][0]
+			con.close()
+			return size
+
+		raw_size = wal_size(-1, 1)
+		compressed_size = wal_size(3, 1001)
+		self.assertLess(compressed_size * 2, raw_size)
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(
+		    node.execute(
+		        'postgres', """SELECT count(*), sum(length(val))
+		                       FROM o_test;""")[0],
+		    node.execute(
+		        'postgres', """SELECT count(*),
+		                              sum(length(repeat('orioledb', 50) || id))
+		                       FROM generate_series(1, 2000) id;""")[0])
+		node.stop()
+
+	def test_wal_update_delta(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "wal_level = replica\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				counter integer NOT NULL,
+				val text NOT NULL,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_test
+				(SELECT id, 0, repeat('orioledb', 50) || id
+				FROM generate_series(1, 1000) id);
+		""")
+
+		def wal_size(delta):
+			con = node.connect()
+			con.execute("SET orioledb.wal_update_delta = %s;" % delta)
+			start = con.execute("SELECT pg_current_wal_insert_lsn();")[0][0]
+			con.execute("UPDATE o_test SET counter = counter + 1;")
+			con.commit()
+			size = con.execute(
+			    "SELECT pg_current_wal_insert_lsn() - '%s'::pg_lsn;" %
+			    start)[0][0]
+			con.close()
+			return size
+
+		full_size = wal_size('off')
+		delta_size = wal_size('on')
+		self.assertLess(delta_size * 2, full_size)
+		wal_size('on')
+
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(
+		    node.execute(
+		        'postgres', """SELECT count(*), sum(counter), sum(length(val))
+		                       FROM o_test
+		                       WHERE val = repeat('orioledb', 50) || id;""")[0],
+		    node.execute(
+		        'postgres', """SELECT count(*), count(*) * 3,
+		                              sum(length(repeat('orioledb', 50) || id))
+		                       FROM generate_series(1, 1000) id;""")[0])
+		node.stop()
+
 	def test_wal_update_pk(self):
 		node = self.node
 		node.start()  # start PostgreSQL
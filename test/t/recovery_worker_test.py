@@ -53,6 +53,142 @@ class RecoveryWorkerTest(BaseTest):
 		)
 		node.stop()
 
+	def test_recovery_queue_depth(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.recovery_pool_size = 3\n")
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_test (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val text,\n"
+		    "	PRIMARY KEY (id)"
+		    ") USING orioledb;\n")
+		node.safe_psql('postgres', 'CHECKPOINT;')
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test\n"
+		    "	(SELECT id, id || 'val' FROM generate_series(1, 5000, 1) id);\n"
+		    "UPDATE o_test SET val = val || 'x' WHERE id % 2 = 0;\n")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute('postgres', 'SELECT count(*) FROM o_test;')[0][0],
+		    5000)
+		depth = node.execute(
+		    'postgres', "SELECT worker, sent_modifies, applied_modifies\n"
+		    "FROM orioledb_recovery_queue_depth() ORDER BY worker;")
+		self.assertEqual(len(depth), 3)
+		self.assertGreaterEqual(sum(row[1] for row in depth), 7500)
+		for row in depth:
+			self.assertEqual(row[1], row[2])
+		node.stop()
+
+	def test_recovery_sorted_insert_batch(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_test (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val integer NOT NULL,\n"
+		    "	PRIMARY KEY (id)"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val);\n")
+		node.safe_psql('postgres', 'CHECKPOINT;')
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test\n"
+		    "	(SELECT (id * 7919) % 10007, id FROM generate_series(1, 10000, 1) id);\n"
+		    "BEGIN;\n"
+		    "INSERT INTO o_test VALUES (20000, 1), (20001, 2);\n"
+		    "DELETE FROM o_test WHERE id = 20000;\n"
+		    "INSERT INTO o_test VALUES (20000, 3);\n"
+		    "COMMIT;\n")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute('postgres', 'SELECT count(*), sum(val) FROM o_test;'),
+		    [(10002, 50005005)])
+		self.assertEqual(
+		    node.execute(
+		        'postgres', "SET enable_seqscan = off;\n"
+		        "SELECT id FROM o_test WHERE val = 3 ORDER BY id;"),
+		    [((3 * 7919) % 10007, ), (20000, )])
+		node.stop()
+
+	def test_recovery_batch_secondary_indices(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_test (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val integer NOT NULL,\n"
+		    "	name text NOT NULL,\n"
+		    "	PRIMARY KEY (id)"
+		    ") USING orioledb;\n"
+		    "CREATE UNIQUE INDEX o_test_val_idx ON o_test (val);\n"
+		    "CREATE INDEX o_test_name_idx ON o_test (name) WHERE id % 3 = 0;\n"
+		)
+		node.safe_psql('postgres', 'CHECKPOINT;')
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test\n"
+		    "	(SELECT id, 5000 - id, 'name' || (id % 100)\n"
+		    "	 FROM generate_series(1, 3000, 1) id);\n")
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute(
+		        'postgres', "SET enable_seqscan = off;\n"
+		        "SELECT count(*), min(val), max(val) FROM o_test\n"
+		        "WHERE val > 0;"), [(3000, 2000, 4999)])
+		self.assertEqual(
+		    node.execute(
+		        'postgres', "SET enable_seqscan = off;\n"
+		        "SELECT count(*) FROM o_test\n"
+		        "WHERE name = 'name3' AND id % 3 = 0;"), [(10, )])
+		node.stop()
+
+	def test_recovery_skip_checkpointed_changes(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_test (\n"
+		    "	id integer NOT NULL,\n"
+		    "	val integer NOT NULL,\n"
+		    "	PRIMARY KEY (id)"
+		    ") USING orioledb;\n"
+		    "CREATE INDEX o_test_val_idx ON o_test (val);\n")
+		con = node.connect()
+		con.begin()
+		con.execute("INSERT INTO o_test VALUES (0, 0);")
+		node.safe_psql(
+		    'postgres', "INSERT INTO o_test\n"
+		    "	(SELECT id, id FROM generate_series(1, 2000, 1) id);\n"
+		    "DELETE FROM o_test WHERE id % 10 = 0;\n")
+		node.safe_psql('postgres', 'CHECKPOINT;')
+		con.commit()
+		node.safe_psql(
+		    'postgres', "UPDATE o_test SET val = val + 10000\n"
+		    "WHERE id % 10 = 1;\n"
+		    "INSERT INTO o_test\n"
+		    "	(SELECT id, id FROM generate_series(2001, 3000, 1) id);\n")
+		con.close()
+		node.stop(['-m', 'immediate'])
+
+		node.start()
+		self.assertEqual(
+		    node.execute('SELECT count(*), sum(val) FROM o_test;'),
+		    [(2801, 6300500)])
+		self.assertEqual(
+		    node.execute(
+		        'postgres', "SET enable_seqscan = off;\n"
+		        "SELECT count(*) FROM o_test WHERE val >= 10000;"), [(200, )])
+		node.stop()
+
 	def test_too_much_workers(self):
 		node = self.node
 		node.start()
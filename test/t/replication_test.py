@@ -68,6 +68,68 @@ class ReplicationTest(BaseTest):
 				replica.poll_query_until(
 				    "SELECT orioledb_has_retained_undo();", expected=False)
 
+	def test_replication_standby_nowait_reads(self):
+		with self.node as master:
+			master.start()
+
+			with self.getReplica().start() as replica:
+				master.safe_psql("""CREATE EXTENSION orioledb;
+					CREATE TABLE o_test (
+						id integer NOT NULL,
+						val text,
+						PRIMARY KEY (id)
+					) USING orioledb;""")
+				replica.catchup()
+
+				con = replica.connect()
+				con.execute("SET orioledb.standby_nowait_reads = on;")
+				for i in range(20):
+					master.safe_psql(
+					    "INSERT INTO o_test (SELECT id, repeat('x', 100) "
+					    "FROM generate_series(%d, %d) id);" %
+					    (i * 1000 + 1, (i + 1) * 1000))
+					# every insert is seen either completely or not at all
+					count = con.execute("SELECT count(*) FROM o_test;")[0][0]
+					self.assertEqual(count % 1000, 0)
+					count = con.execute(
+					    "SELECT count(*) FROM (SELECT * FROM o_test "
+					    "ORDER BY id DESC) t;")[0][0]
+					self.assertEqual(count % 1000, 0)
+				con.close()
+
+				self.catchup_orioledb(replica)
+				self.assertEqual(
+				    20000,
+				    replica.execute("SELECT count(*) FROM o_test;")[0][0])
+
+	def test_replication_replica_prewarm(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.replica_prewarm = true\n")
+		with node as master:
+			master.start()
+
+			with self.getReplica().start() as replica:
+				master.safe_psql("""CREATE EXTENSION orioledb;
+					CREATE TABLE o_test (
+						id integer NOT NULL,
+						val text,
+						PRIMARY KEY (id)
+					) USING orioledb;
+					INSERT INTO o_test (SELECT id, repeat('x', 100) || id
+										FROM generate_series(1, 10000) id);""")
+				for i in range(10):
+					master.safe_psql("SELECT count(*) FROM o_test;")
+				master.safe_psql("CHECKPOINT;")
+				replica.catchup()
+
+				prewarm_file = os.path.join(replica.data_dir, 'orioledb_data',
+				                            'prewarm_replica')
+				self.assertTrue(os.path.exists(prewarm_file))
+				self.assertGreater(os.path.getsize(prewarm_file), 0)
+				self.assertEqual(
+				    replica.execute("SELECT count(*), sum(id) FROM o_test;"),
+				    [(10000, 50005000)])
+
 	def test_replication_drop(self):
 		with self.node as master:
 			master.start()
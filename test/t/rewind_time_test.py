@@ -10,6 +10,7 @@ import os
 from .base_test import BaseTest
 from .base_test import generate_string
 from testgres.enums import NodeStatus
+from testgres.exceptions import QueryException
 
 import string
 import random
@@ -308,3 +309,47 @@ class RewindTest(BaseTest):
 		    "[(1, '1val'), (2, '2val'), (3, '3val'), (4, '4val'), (5, '5val'), (6, '6val'), (7, '7val'), (8, '8val'), (9, '9val'), (10, '10val'), (11, '11val'), (12, '12val'), (13, '13val'), (14, '14val'), (15, '15val'), (16, '16val'), (17, '17val'), (18, '18val'), (19, '19val'), (20, '20val'), (21, '21val'), (22, '22val'), (23, '23val'), (24, '24val')]"
 		)
 		node.stop()
+
+	def test_as_of_timestamp(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.rewind_max_time = 100\n"
+		    "orioledb.enable_rewind = true\n")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_test SELECT i, i || 'val'
+				FROM generate_series(1, 5) i;
+		""")
+		time.sleep(3)
+		ts = node.execute("SELECT now()::text;")[0][0]
+		time.sleep(3)
+		node.safe_psql("""
+			UPDATE o_test SET val = 'new' WHERE id = 1;
+			DELETE FROM o_test WHERE id = 2;
+			INSERT INTO o_test VALUES (6, '6val');
+		""")
+
+		con = node.connect()
+		con.execute("SET orioledb.as_of_timestamp = '%s';" % ts)
+		self.assertEqual([(1, '1val'), (2, '2val'), (3, '3val'),
+		                  (4, '4val'), (5, '5val')],
+		                 con.execute("SELECT * FROM o_test ORDER BY id;"))
+		self.assertEqual([('2val', )],
+		                 con.execute("SELECT val FROM o_test WHERE id = 2;"))
+		with self.assertRaises(QueryException) as e:
+			con.execute("DELETE FROM o_test WHERE id = 3;")
+		self.assertIn("while orioledb.as_of_timestamp is set",
+		              e.exception.message)
+		con.rollback()
+		con.execute("RESET orioledb.as_of_timestamp;")
+		self.assertEqual([(1, 'new'), (3, '3val'), (4, '4val'),
+		                  (5, '5val'), (6, '6val')],
+		                 con.execute("SELECT * FROM o_test ORDER BY id;"))
+		con.close()
+		node.stop()
@@ -26,6 +26,7 @@ class RewindXidTest(BaseTest):
 	# test_rewind_xid_evict         // oriole+heap
 	# test_rewind_xid_heap_evict_subxids
 	# test_rewind_xid_evict_subxids // oriole+heap
+	# test_rewind_xid_oriole_evict_checkpoint // checkpoint reads evicted pages
 
 	# test_rewind_xid_oriole_evict_complete_before // complete < rewind point
 	# test_rewind_xid_oriole_evict_complete_after  // complete > rewind point (i.e. rewind would be until complete point)
@@ -105,6 +106,72 @@ class RewindXidTest(BaseTest):
 
 		node.stop()
 
+	def test_rewind_xid_oriole_evict_checkpoint(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.rewind_max_time = 5000\n"
+		    "orioledb.rewind_max_transactions 1000000\n"
+		    "orioledb.enable_rewind = true\n"
+		    "orioledb.rewind_buffers = 128\n")
+		node.start()
+
+		node.safe_psql(
+		    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+		    "CREATE TABLE IF NOT EXISTS o_test (\n"
+		    "    id serial NOT NULL,\n"
+		    "	val text,\n"
+		    "    PRIMARY KEY (id)\n"
+		    ") USING orioledb;\n")
+
+		fp1 = tempfile.NamedTemporaryFile(mode='wt', delete_on_close=False)
+		fp1.write("INSERT INTO o_test (val) VALUES ('oldval!');\n")
+		fp1.close()
+		fp2 = tempfile.NamedTemporaryFile(mode='wt', delete_on_close=False)
+		fp2.write("INSERT INTO o_test (val) VALUES ('newval!');\n"
+		          "BEGIN;\n"
+		          "SAVEPOINT s1;\n"
+		          "UPDATE o_test SET val = 'newval!' WHERE id = 1;\n"
+		          "RELEASE SAVEPOINT s1;\n"
+		          "COMMIT;\n")
+		fp2.close()
+
+		node.pgbench_with_wait(options=[
+		    '-M', 'prepared', '-f', fp1.name, '-n', '-c', '5', '-j', '5', '-t',
+		    '1'
+		],
+		                       stderr=sys.stderr)
+
+		a, *b = (node.execute('postgres',
+		                      'select orioledb_get_current_oxid();\n'))[0]
+		oxid = int(a)
+		invalidxid = 0
+
+		node.pgbench_with_wait(options=[
+		    '-M', 'prepared', '-f', fp2.name, '-n', '-c', '4', '-j', '4', '-t',
+		    '2500'
+		],
+		                       stderr=sys.stderr)
+
+		a, *b = (node.execute(
+		    'postgres', 'select orioledb_get_rewind_evicted_length();\n'))[0]
+		self.assertGreater(int(a), 0)
+		node.safe_psql('postgres', "CHECKPOINT;\n")
+
+		node.safe_psql(
+		    'postgres', "select orioledb_rewind_to_transaction(%d,%ld);\n" %
+		    (invalidxid, oxid))
+		time.sleep(1)
+
+		node.is_started = False
+		node.start()
+
+		self.assertEqual(
+		    str(node.execute('postgres', 'SELECT * FROM o_test ORDER BY 1;')),
+		    "[(1, 'oldval!'), (2, 'oldval!'), (3, 'oldval!'), (4, 'oldval!'), (5, 'oldval!')]"
+		)
+
+		node.stop()
+
 	def test_rewind_xid_heap_evict(self):
 		node = self.node
 		node.append_conf(
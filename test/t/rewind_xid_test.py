@@ -26,6 +26,7 @@ class RewindXidTest(BaseTest):
 	# test_rewind_xid_heap_subxids
 	# test_rewind_xid               // oriole+heap
 	# test_rewind_xid_subxids       // oriole+heap
+	# test_rewind_xid_parallel      // oriole, parallel apply workers
 
 	# DDL tests :
 	# test_rewind_xid_ddl_create    // oriole+heap
@@ -90,6 +91,67 @@ class RewindXidTest(BaseTest):
 		)
 		node.stop()
 
+	def test_rewind_xid_parallel(self):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.rewind_max_time = 500\n"
+		    "orioledb.enable_rewind = true\n"
+		    "orioledb.rewind_buffers = 6\n"
+		    "orioledb.rewind_parallel_workers = 3\n"
+		    "max_worker_processes = 16\n")
+		node.start()
+
+		for i in range(4):
+			node.safe_psql(
+			    'postgres', "CREATE EXTENSION IF NOT EXISTS orioledb;\n"
+			    "CREATE TABLE IF NOT EXISTS o_test%d (\n"
+			    "	id int NOT NULL,\n"
+			    "	val int NOT NULL,\n"
+			    "	PRIMARY KEY (id)\n"
+			    ") USING orioledb;\n"
+			    "CREATE INDEX o_test%d_val_idx ON o_test%d (val);\n"
+			    "INSERT INTO o_test%d SELECT v, v FROM generate_series(1, 100) v;\n"
+			    % (i, i, i, i))
+
+		fp1 = tempfile.NamedTemporaryFile(mode='wt', delete_on_close=False)
+		fp1.write("\\set id random(1, 100)\n"
+		          "\\set t random(0, 3)\n"
+		          "UPDATE o_test:t SET val = val + 1000 WHERE id = :id;\n"
+		          "INSERT INTO o_test:t VALUES (1000 + :id, :id) "
+		          "ON CONFLICT (id) DO UPDATE SET val = EXCLUDED.val;\n")
+		fp1.close()
+
+		a, *b = (node.execute('postgres',
+		                      'select orioledb_get_current_oxid();\n'))[0]
+		oxid = int(a)
+		invalidxid = 0
+
+		node.pgbench_with_wait(options=[
+		    '-M', 'prepared', '-f', fp1.name, '-n', '-c', '5', '-j', '5', '-t',
+		    '200'
+		],
+		                       stderr=sys.stderr)
+
+		node.safe_psql(
+		    'postgres', "select orioledb_rewind_to_transaction(%d,%ld);\n" %
+		    (invalidxid, oxid))
+		time.sleep(1)
+
+		node.is_started = False
+		node.start()
+
+		for i in range(4):
+			self.assertEqual(
+			    node.execute(
+			        'postgres', "SET enable_seqscan = off;\n"
+			        "SELECT count(*), sum(id), sum(val) FROM o_test%d "
+			        "WHERE val > 0;" % i)[0], (100, 5050, 5050))
+			self.assertEqual(
+			    node.execute('postgres',
+			                 "SELECT count(*), sum(id), sum(val) FROM o_test%d;" %
+			                 i)[0], (100, 5050, 5050))
+		node.stop()
+
 	def test_rewind_xid_heap(self):
 		node = self.node
 		node.append_conf(
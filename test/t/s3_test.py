@@ -94,6 +94,40 @@ class S3Test(S3BaseTest):
 		message = log[0].split('] ')[-1].strip()
 		self.assertEqual(message, "FATAL:  could not put object to S3")
 
+	def test_s3_put_multipart(self):
+		fd, s3_test_file = mkstemp()
+		with os.fdopen(fd, 'wt') as fp:
+			for i in range(200000):
+				fp.write("line %08d of the multipart object\n" % i)
+
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_multipart_part_size = 5MB
+		""")
+		node.start()
+		node.safe_psql("CREATE EXTENSION IF NOT EXISTS orioledb;")
+		node.safe_psql(f"SELECT s3_put('wal/multipart', '{s3_test_file}');")
+
+		object = self.client.get_object(Bucket=self.bucket_name,
+		                                Key="wal/multipart")
+		boto_object_body = object["Body"].read().decode("utf-8")
+		with open(f"{s3_test_file}", "r") as f:
+			file_content = f.read()
+		self.assertGreater(len(file_content), 5 * 1024 * 1024)
+		self.assertEqual(boto_object_body, file_content)
+		self.assertEqual(
+		    node.execute("SELECT s3_get('wal/multipart') = "
+		                 f"pg_read_file('{s3_test_file}');")[0][0], True)
+		node.stop(['-m', 'immediate'])
+		os.unlink(s3_test_file)
+
 	def test_s3_checkpoint(self):
 		node = self.node
 		node.append_conf(f"""
@@ -455,6 +489,241 @@ class S3Test(S3BaseTest):
 		                 node.execute("SELECT COUNT(*) FROM o_test")[0][0])
 		node.stop()
 
+	def test_s3_data_eviction_adaptive(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_desired_size = 20MB
+			orioledb.s3_desired_size_max = 40MB
+			orioledb.s3_cold_read_rate = 1
+
+			orioledb.s3_num_workers = 3
+			orioledb.recovery_pool_size = 1
+		""")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+		""")
+		node.safe_psql("""
+			BEGIN;
+			CREATE TABLE o_test (
+				id int PRIMARY KEY,
+				value text NOT NULL
+			) USING orioledb;
+			INSERT INTO o_test (id, value) (SELECT id, repeat('x', 2500) FROM generate_series(1, 20000) id);
+			COMMIT;
+		""")
+		node.safe_psql("CHECKPOINT")
+		while True:
+			dataSize = self.get_data_size()
+			if dataSize <= 40 * 1024 * 1024:
+				break
+			time.sleep(1)
+		self.assertEqual(20000,
+		                 node.execute("SELECT COUNT(*) FROM o_test")[0][0])
+
+		stats = node.execute("""
+			SELECT desired_size, loaded_size, cold_reads
+			FROM pg_stat_orioledb_s3_headers;
+		""")[0]
+		self.assertGreaterEqual(stats[0], 20 * 1024 * 1024)
+		self.assertLessEqual(stats[0], 40 * 1024 * 1024)
+		self.assertGreater(stats[1], 0)
+		self.assertGreater(stats[2], 0)
+		node.stop()
+
+	def test_s3_data_eviction_part_cache(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_desired_size = 20MB
+			orioledb.s3_cache_size = 100MB
+
+			orioledb.s3_num_workers = 3
+			orioledb.recovery_pool_size = 1
+		""")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+		""")
+		node.safe_psql("""
+			BEGIN;
+			CREATE TABLE o_test (
+				id int PRIMARY KEY,
+				value text NOT NULL
+			) USING orioledb;
+			INSERT INTO o_test (id, value) (SELECT id, repeat('x', 2500) FROM generate_series(1, 20000) id);
+			COMMIT;
+		""")
+		node.safe_psql("CHECKPOINT")
+		while True:
+			dataSize = self.get_data_size()
+			if dataSize <= 20 * 1024 * 1024:
+				break
+			time.sleep(1)
+
+		cache_dir = os.path.join(node.data_dir, 'orioledb_s3_cache')
+		self.assertGreater(len(os.listdir(cache_dir)), 0)
+		self.assertEqual(20000,
+		                 node.execute("SELECT COUNT(*) FROM o_test")[0][0])
+		self.assertEqual(
+		    20000,
+		    node.execute("SELECT COUNT(*) FROM o_test "
+		                 "WHERE value = repeat('x', 2500)")[0][0])
+		node.stop()
+
+	def test_s3_data_eviction_scan_prefetch(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_desired_size = 20MB
+
+			orioledb.s3_num_workers = 3
+			orioledb.recovery_pool_size = 1
+		""")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+		""")
+		node.safe_psql("""
+			BEGIN;
+			CREATE TABLE o_test (
+				id int PRIMARY KEY,
+				value text NOT NULL
+			) USING orioledb;
+			INSERT INTO o_test (id, value) (SELECT id, repeat('x', 2500) FROM generate_series(1, 20000) id);
+			COMMIT;
+		""")
+		node.safe_psql("CHECKPOINT")
+		while True:
+			dataSize = self.get_data_size()
+			if dataSize <= 20 * 1024 * 1024:
+				break
+			time.sleep(1)
+		node.restart()
+
+		for prefetch in [0, 16, 1024]:
+			with node.connect() as con:
+				con.execute(
+				    f"SET orioledb.s3_scan_prefetch_pages = {prefetch};")
+				self.assertEqual(
+				    20000,
+				    con.execute("SELECT COUNT(*) FROM o_test "
+				                "WHERE value = repeat('x', 2500)")[0][0])
+		node.stop()
+
+	def test_s3_queue_stats(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_num_workers = 3
+		""")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id int PRIMARY KEY,
+				value text NOT NULL
+			) USING orioledb;
+			INSERT INTO o_test (SELECT id, id || 'val' FROM generate_series(1, 10000) id);
+		""")
+		node.safe_psql("CHECKPOINT")
+
+		stats = node.execute("""
+			SELECT priority, depth, in_progress, scheduled, processed
+			FROM orioledb_s3_queue_stats();
+		""")
+		self.assertEqual(['read', 'wal', 'checkpoint', 'prefetch'],
+		                 [row[0] for row in stats])
+		for row in stats:
+			self.assertGreaterEqual(row[1], 0)
+			self.assertGreaterEqual(row[2], 0)
+			self.assertGreaterEqual(row[3], row[4])
+		checkpoint = stats[2]
+		self.assertGreater(checkpoint[4], 0)
+		node.stop()
+
+	def test_s3_stats(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_num_workers = 3
+		""")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test (
+				id integer NOT NULL,
+				val text,
+				PRIMARY KEY (id)
+			) USING orioledb;
+			INSERT INTO o_test (SELECT id, id || 'val' FROM generate_series(1, 10000) id);
+		""")
+		node.safe_psql("CHECKPOINT")
+
+		stats = node.execute("""
+			SELECT operation, requests, bytes, errors,
+				   queue_waits, latency_histogram
+			FROM pg_stat_orioledb_s3;
+		""")
+		self.assertEqual(
+		    ['get_part', 'get_file', 'put_part', 'put_file', 'delete'],
+		    [row[0] for row in stats])
+		put_part = stats[2]
+		self.assertGreater(put_part[1], 0)
+		self.assertGreater(put_part[2], 0)
+		self.assertEqual(0, put_part[3])
+		self.assertGreater(put_part[4], 0)
+		for row in stats:
+			self.assertEqual(6, len(row[5]))
+
+		self.assertEqual(
+		    4,
+		    node.execute("SELECT count(*) FROM pg_stat_orioledb_s3_queue")[0]
+		    [0])
+		headers = node.execute("""
+			SELECT lookups, misses, hit_ratio FROM pg_stat_orioledb_s3_headers;
+		""")[0]
+		self.assertGreater(headers[0], 0)
+		self.assertLessEqual(headers[1], headers[0])
+
+		backup = node.execute("""
+			SELECT in_progress, files_total, files_done,
+				   bytes_total, bytes_done
+			FROM pg_stat_orioledb_s3_backup;
+		""")[0]
+		self.assertFalse(backup[0])
+		self.assertGreater(backup[1], 0)
+		self.assertEqual(backup[1], backup[2])
+		self.assertGreater(backup[3], 0)
+		self.assertGreater(backup[4], 0)
+		node.stop()
+
 	def test_s3_data_dir_load(self):
 		node = self.node
 		node.append_conf(f"""
@@ -506,6 +775,140 @@ class S3Test(S3BaseTest):
 			new_node.stop()
 			new_node.cleanup()
 
+	def test_s3_data_dir_load_backfill(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_num_workers = 3
+
+			archive_mode = on
+			archive_library = 'orioledb'
+		""")
+		node.append_conf(f"""
+			orioledb.recovery_pool_size = 1
+			orioledb.recovery_idx_pool_size = 1
+		""")
+		node.start()
+		archiver_pid = node.execute("""
+			SELECT pid FROM pg_stat_activity WHERE backend_type = 'archiver';
+		""")[0][0]
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+			CREATE TABLE o_test_1 (
+				id int PRIMARY KEY,
+				val text
+			) USING orioledb;
+			INSERT INTO o_test_1 SELECT id, repeat('x', 100)
+				FROM generate_series(1, 50000) id;
+		""")
+		node.safe_psql("CHECKPOINT;")
+		node.stop(['--no-wait'])
+
+		while self.client.list_objects(Bucket=self.bucket_name,
+		                               Prefix='wal/') == []:
+			pass
+		os.kill(archiver_pid, signal.SIGUSR2)
+		while node.status() == NodeStatus.Running:
+			pass
+
+		with self.initNode(self.getBasePort() + 1, 'tgsb') as new_node:
+			self.loader.download(new_node.data_dir)
+			new_node.append_conf(port=new_node.port)
+			new_node.append_conf("orioledb.s3_backfill = on")
+
+			new_node.start()
+			while True:
+				prefetch = new_node.execute("""
+					SELECT scheduled, processed FROM orioledb_s3_queue_stats()
+					WHERE priority = 'prefetch';
+				""")[0]
+				if prefetch[0] > 0 and prefetch[0] == prefetch[1]:
+					break
+				time.sleep(0.1)
+			self.assertEqual(
+			    50000,
+			    new_node.execute("SELECT count(*) FROM o_test_1")[0][0])
+			new_node.stop()
+			new_node.cleanup()
+
+	def test_s3_data_dir_load_chunks(self):
+		node = self.node
+		node.append_conf(f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_num_workers = 3
+			orioledb.s3_file_chunk_size = 1
+
+			archive_mode = on
+			archive_library = 'orioledb'
+		""")
+		node.start()
+		archiver_pid = node.execute("""
+			SELECT pid FROM pg_stat_activity WHERE backend_type = 'archiver';
+		""")[0][0]
+		node.safe_psql("""
+			CREATE EXTENSION orioledb;
+			CREATE TABLE h_test (
+				id int,
+				val text
+			) USING heap;
+			INSERT INTO h_test SELECT id, repeat('x', 100)
+				FROM generate_series(1, 30000) id;
+		""")
+		path = node.execute("SELECT pg_relation_filepath('h_test');")[0][0]
+		node.safe_psql("CHECKPOINT;")
+		node.safe_psql("""
+			INSERT INTO h_test SELECT id, repeat('x', 100)
+				FROM generate_series(30001, 30010) id;
+		""")
+		node.safe_psql("CHECKPOINT;")
+
+		def chunk_objects(chkp_num):
+			objects = self.client.list_objects(
+			    Bucket=self.bucket_name,
+			    Prefix=f'data/{chkp_num}/{path}.chunks/')
+			return [obj['Key'] for obj in objects.get('Contents', [])]
+
+		chkp_num = max(
+		    int(prefix['Prefix'].rstrip('/').split('/')[-1])
+		    for prefix in self.client.list_objects(
+		        Bucket=self.bucket_name, Prefix='data/',
+		        Delimiter='/')['CommonPrefixes'])
+		first = chunk_objects(chkp_num - 1)
+		second = chunk_objects(chkp_num)
+		# The file takes a few chunks, only the appended one is put again
+		self.assertGreater(len(first), 1)
+		self.assertGreater(len(second), 0)
+		self.assertLess(len(second), len(first))
+		node.stop(['--no-wait'])
+
+		while self.client.list_objects(Bucket=self.bucket_name,
+		                               Prefix='wal/') == []:
+			pass
+		os.kill(archiver_pid, signal.SIGUSR2)
+		while node.status() == NodeStatus.Running:
+			pass
+
+		with self.initNode(self.getBasePort() + 1, 'tgsb') as new_node:
+			self.loader.download(new_node.data_dir)
+			new_node.append_conf(port=new_node.port)
+
+			new_node.start()
+			self.assertEqual(
+			    30010,
+			    new_node.execute("SELECT count(*) FROM h_test")[0][0])
+			new_node.stop()
+			new_node.cleanup()
+
 	@s3_test_attrs(
 	    http=True,
 	    prefix=f'{S3BaseTest.bucket_name}/{S3BaseTest.optional_prefix}')
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# coding: utf-8
+
+from .base_test import BaseTest
+from .base_test import ThreadQueryExecutor
+
+
+class SplitTest(BaseTest):
+
+	def leaf_stat(self, table):
+		return self.node.execute(
+		    "SELECT count, avgoccupied * 100 / 8192 "
+		    "FROM orioledb_tree_stat('%s'::regclass) "
+		    "WHERE level = 0" % table)[0]
+
+	def test_append_split(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_append (
+				id int8 NOT NULL PRIMARY KEY,
+				val text
+			) USING orioledb;
+			CREATE TABLE o_append_ff (
+				id int8 NOT NULL PRIMARY KEY,
+				val text
+			) USING orioledb WITH (fillfactor = 89);
+		""")
+		for table in ['o_append', 'o_append_ff']:
+			for i in range(10):
+				node.safe_psql(
+				    'postgres', "INSERT INTO %s SELECT id, 'val' || id "
+				    "FROM generate_series(%d, %d) id" %
+				    (table, i * 30000 + 1, (i + 1) * 30000))
+
+		append_count, append_occupied = self.leaf_stat('o_append')
+		ff_count, ff_occupied = self.leaf_stat('o_append_ff')
+
+		# Detected append pattern fills left pages completely, while explicit
+		# fillfactor is kept as is.
+		self.assertGreater(append_occupied, 94)
+		self.assertLess(ff_occupied, 92)
+		self.assertLess(append_count, ff_count)
+		self.assertEqual(
+		    node.execute("SELECT count(*), max(id) FROM o_append"),
+		    [(300000, 300000)])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_append'::regclass)")[0]
+		    [0])
+		node.stop()
+
+	def test_hot_leaf_concurrent_modify(self):
+		node = self.node
+		node.start()
+		node.safe_psql(
+		    'postgres', """
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_hot_leaf (
+				id int8 NOT NULL PRIMARY KEY,
+				val int8 NOT NULL
+			) USING orioledb;
+			INSERT INTO o_hot_leaf
+				SELECT id * 8, 0 FROM generate_series(1, 1000) id;
+		""")
+		cons = [node.connect() for _ in range(5)]
+		threads = []
+		# Inserters interleave their keys, so they compete for the same leaves
+		for i in range(4):
+			threads.append(
+			    ThreadQueryExecutor(
+			        cons[i], """
+				DO $$
+				BEGIN
+					FOR i IN 1..8000 LOOP
+						INSERT INTO o_hot_leaf VALUES (i * 4 + %d + 10000, i);
+					END LOOP;
+				END $$;
+			""" % i))
+		# While the updater and deleter hold those leaves too
+		threads.append(
+		    ThreadQueryExecutor(
+		        cons[4], """
+			DO $$
+			BEGIN
+				FOR i IN 1..1000 LOOP
+					IF i % 2 = 0 THEN
+						UPDATE o_hot_leaf SET val = val + 1 WHERE id = i * 8;
+					ELSE
+						DELETE FROM o_hot_leaf WHERE id = i * 8;
+					END IF;
+				END LOOP;
+			END $$;
+		"""))
+		for t in threads:
+			t.start()
+		for t in threads:
+			t.join()
+		for con in cons:
+			con.commit()
+			con.close()
+
+		self.assertEqual(
+		    node.execute("SELECT count(*), sum(val) FILTER (WHERE id <= 8000) "
+		                 "FROM o_hot_leaf"), [(500 + 32000, 500)])
+		self.assertTrue(
+		    node.execute("SELECT orioledb_tbl_check('o_hot_leaf'::regclass)")
+		    [0][0])
+		node.stop()
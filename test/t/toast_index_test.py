@@ -171,3 +171,112 @@ class ToastIndexTest(BaseTest):
 		node.start()
 		self.check_result(4)
 		node.stop()
+
+	def test_update_same_size_external(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_toast_external (
+				id integer PRIMARY KEY,
+				v text STORAGE EXTERNAL
+			) USING orioledb;
+		""")
+		value = gen_str(30000, 1)
+		node.safe_psql("INSERT INTO o_toast_external VALUES (1, '%s'), "
+		               "(2, '%s');" % (value, value))
+
+		# same value, the first and the last chunk differ
+		changedFirst = 'y' + value[1:]
+		changedLast = value[:-1] + 'y'
+		node.safe_psql("UPDATE o_toast_external SET v = '%s' WHERE id = 1;" %
+		               value)
+		node.safe_psql("UPDATE o_toast_external SET v = '%s' WHERE id = 2;" %
+		               changedLast)
+		self.assertEqual([(1, value), (2, changedLast)],
+		                 node.execute("SELECT * FROM o_toast_external "
+		                              "ORDER BY id;"))
+
+		node.safe_psql("UPDATE o_toast_external SET v = '%s' WHERE id = 1;" %
+		               changedFirst)
+		node.safe_psql("UPDATE o_toast_external SET v = v WHERE id = 2;")
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual([(1, changedFirst), (2, changedLast)],
+		                 node.execute("SELECT * FROM o_toast_external "
+		                              "ORDER BY id;"))
+		node.stop()
+
+	def test_toast_raw_values(self):
+		node = self.node
+		node.append_conf('postgresql.conf', "orioledb.toast_raw_values = on\n")
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_toast_raw (
+				id integer PRIMARY KEY,
+				v1 text,
+				v2 text STORAGE MAIN
+			) USING orioledb WITH (toast_compress = 5);
+			INSERT INTO o_toast_raw
+				SELECT i, repeat('abc', 10000 * i), repeat('def', 1000 * i)
+				FROM generate_series(1, 3) i;
+			UPDATE o_toast_raw SET v1 = v1 || 'x' WHERE id = 2;
+		""")
+		expected = [(1, 30000, 'abc', 3000), (2, 60001, 'x', 6000),
+		            (3, 90000, 'abc', 9000)]
+		query = """
+			SELECT id, length(v1), right(v1, 3 - (id = 2)::int * 2),
+				length(v2)
+			FROM o_toast_raw ORDER BY id;
+		"""
+		self.assertEqual(expected, node.execute(query))
+		node.safe_psql("CHECKPOINT;")
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(expected, node.execute(query))
+		node.stop()
+
+	def test_copy_toast_values(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_toast_src (
+				id integer PRIMARY KEY,
+				v text STORAGE EXTERNAL
+			) USING orioledb;
+			CREATE TABLE o_toast_dst (
+				id text PRIMARY KEY,
+				v text
+			) USING orioledb;
+			INSERT INTO o_toast_src
+				SELECT i, string_agg(md5((i * 1000 + j)::text), '' ORDER BY j)
+				FROM generate_series(1, 5) i, generate_series(1, 2000) j
+				GROUP BY i;
+			INSERT INTO o_toast_dst
+				SELECT repeat(id::text, 100), v FROM o_toast_src;
+			UPDATE o_toast_src SET id = id + 10;
+		""")
+		query = """
+			SELECT s.id, d.v = s.v, md5(d.v)
+			FROM o_toast_src s JOIN o_toast_dst d
+				ON d.id = repeat((s.id - 10)::text, 100)
+			ORDER BY s.id;
+		"""
+		expected = node.execute("""
+			SELECT i + 10, true, md5(string_agg(md5((i * 1000 + j)::text), '' ORDER BY j))
+			FROM generate_series(1, 5) i, generate_series(1, 2000) j
+			GROUP BY i ORDER BY i;
+		""")
+		self.assertEqual(expected, node.execute(query))
+
+		node.safe_psql("""
+			ALTER TABLE o_toast_dst DROP CONSTRAINT o_toast_dst_pkey;
+			ALTER TABLE o_toast_dst ADD PRIMARY KEY (id);
+		""")
+		self.assertEqual(expected, node.execute(query))
+		node.stop(['-m', 'immediate'])
+		node.start()
+		self.assertEqual(expected, node.execute(query))
+		node.stop()
@@ -767,3 +767,57 @@ class TypesTest(BaseTest):
 		con3.close()
 		self.check_total_deleted(node, 'TABLESPACE_CACHE', 5, 2)
 		node.stop()
+
+	def test_inline_comparator_types(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+			CREATE TABLE o_test_cmp (
+				a int4,
+				b int8,
+				c uuid,
+				d timestamp,
+				e date,
+				PRIMARY KEY (a, b, c)
+			) USING orioledb;
+			CREATE INDEX o_test_cmp_d_idx ON o_test_cmp (d DESC, e);
+			INSERT INTO o_test_cmp
+				SELECT v - 100,
+					   (v % 7 - 3) * 4000000000,
+					   ('00000000-0000-0000-0000-0000000000'
+						|| lpad(to_hex(255 - v), 2, '0'))::uuid,
+					   '2000-01-01'::timestamp + (v - 100) * interval '1 day',
+					   '2000-01-01'::date - v
+				FROM generate_series(1, 200) v;
+		""")
+
+		expected = node.execute("""
+			SET enable_indexscan = off;
+			SET enable_bitmapscan = off;
+			SELECT a, b, c FROM o_test_cmp
+				WHERE a BETWEEN -10 AND 10 ORDER BY a, b, c;
+		""")
+		self.assertEqual(21, len(expected))
+
+		con = node.connect()
+		con.execute("SET enable_seqscan = off;")
+		self.assertEqual(
+		    expected,
+		    con.execute("""
+				SELECT a, b, c FROM o_test_cmp
+					WHERE a BETWEEN -10 AND 10 ORDER BY a, b, c;
+			"""))
+		self.assertEqual([(-99, )],
+		                 con.execute("""
+				SELECT a FROM o_test_cmp
+					WHERE a = -99 AND b = -8000000000
+						AND c = '00000000-0000-0000-0000-0000000000fe';
+			"""))
+		self.assertEqual([(100, ), (99, ), (98, )],
+		                 con.execute("""
+				SELECT a FROM o_test_cmp
+					WHERE d >= '2000-03-09'::timestamp
+					ORDER BY d DESC, e LIMIT 3;
+			"""))
+		con.close()
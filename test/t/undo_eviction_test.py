@@ -1,10 +1,12 @@
 #!/usr/bin/env python3
 # coding: utf-8
 
+import time
 import unittest
 import os
 
 from .base_test import BaseTest
+from testgres.exceptions import QueryException
 
 
 class UndoEvictionTest(BaseTest):
@@ -118,3 +120,332 @@ class UndoEvictionTest(BaseTest):
 
 		con1.close()
 		node.stop()
+
+	def test_undo_eviction_reserve_batch(self):
+		node = self.node
+		node.safe_psql('postgres',
+		               "ALTER SYSTEM SET orioledb.undo_reserve_batch = 1024;")
+		node.safe_psql('postgres', "SELECT pg_reload_conf();")
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con1.begin()
+		con2.begin()
+		for i in range(1, 1001):
+			con1.execute("INSERT INTO o_undo_evict VALUES (%d, %d);" %
+			             (i, i))
+			con2.execute("INSERT INTO o_undo_evict VALUES (%d, %d);" %
+			             (i + 100000, i))
+		con1.execute(
+		    "INSERT INTO o_undo_evict (SELECT i, i FROM generate_series(2001, 100000) i);"
+		)
+		self.assertGreaterEqual(self.get_undo_files_count(), 1)
+		con1.rollback()
+		con2.commit()
+
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_undo_evict;")[0][0], 1000)
+
+		node.safe_psql('postgres',
+		               "ALTER SYSTEM SET orioledb.undo_reserve_batch = 0;")
+		node.safe_psql('postgres', "SELECT pg_reload_conf();")
+		con1.begin()
+		con1.execute("DELETE FROM o_undo_evict;")
+		con1.commit()
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_undo_evict;")[0][0], 0)
+
+		con1.close()
+		con2.close()
+		node.stop()
+
+	def test_undo_eviction_compress(self):
+		node = self.node
+		node.safe_psql('postgres',
+		               "ALTER SYSTEM SET orioledb.undo_compress = 1;")
+		node.safe_psql('postgres', "SELECT pg_reload_conf();")
+
+		node.execute(
+		    "INSERT INTO o_undo_evict (SELECT i, i FROM generate_series(1, 50000) i);"
+		)
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con2.begin()
+		con2.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		self.assertEqual(
+		    con2.execute("SELECT COUNT(*), SUM(value) FROM o_undo_evict;")[0],
+		    (50000, 1250025000))
+
+		con1.begin()
+		con1.execute(
+		    "INSERT INTO o_undo_evict (SELECT i, i FROM generate_series(50001, 150000) i);"
+		)
+		con1.execute("UPDATE o_undo_evict SET value = value + 1;")
+		con1.commit()
+
+		undoDir = node.data_dir + '/orioledb_undo'
+		self.assertGreaterEqual(
+		    len([name for name in os.listdir(undoDir)
+		         if name.endswith('.zidx')]), 1)
+
+		self.assertEqual(
+		    con2.execute("SELECT COUNT(*), SUM(value) FROM o_undo_evict;")[0],
+		    (50000, 1250025000))
+		con2.commit()
+
+		con1.begin()
+		con1.execute("DELETE FROM o_undo_evict;")
+		con1.rollback()
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_undo_evict;")[0][0], 150000)
+
+		con1.close()
+		con2.close()
+		node.stop()
+
+	def test_undo_page_cache(self):
+		node = self.node
+		node.append_conf('postgresql.conf',
+		                 "orioledb.undo_page_cache_size = 8MB\n")
+		node.restart()
+
+		node.execute(
+		    "INSERT INTO o_undo_evict (SELECT i, i FROM generate_series(1, 50000) i);"
+		)
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con3 = node.connect()
+		con2.begin()
+		con2.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		con2.execute("SELECT 1;")
+		con3.begin()
+		con3.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		con3.execute("SELECT 1;")
+
+		con1.execute(
+		    "INSERT INTO o_undo_evict (SELECT i, i FROM generate_series(50001, 150000) i);"
+		)
+		con1.execute("DELETE FROM o_undo_evict WHERE id % 2 = 0;")
+		con1.commit()
+
+		for con in [con2, con3, con2]:
+			self.assertEqual(
+			    con.execute("SELECT COUNT(*), SUM(value) FROM o_undo_evict;")[0],
+			    (50000, 1250025000))
+		con2.commit()
+		con3.commit()
+
+		self.assertEqual(
+		    node.execute("""SELECT size > 0, slots > 0, hits > 0, inserts > 0
+		                    FROM orioledb_undo_page_cache_stats();""")[0],
+		    (True, True, True, True))
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*) FROM o_undo_evict;")[0][0], 75000)
+
+		con1.close()
+		con2.close()
+		con3.close()
+		node.stop()
+
+	def test_undo_update_delta(self):
+		node = self.node
+		node.safe_psql(
+		    'postgres', """CREATE TABLE o_undo_delta (
+							id integer NOT NULL,
+							counter integer NOT NULL,
+							val text NOT NULL,
+							PRIMARY KEY (id)
+						) USING orioledb;
+						INSERT INTO o_undo_delta
+							(SELECT i, 0, repeat('x', 200) || i
+							 FROM generate_series(1, 10000) i);""")
+
+		def undo_size(delta):
+			con = node.connect()
+			con.execute("SET orioledb.undo_update_delta = %s;" % delta)
+			start = con.execute("""SELECT last_used_location
+								   FROM pg_stat_orioledb_undo
+								   WHERE undo_type = 'row';""")[0][0]
+			con.execute("UPDATE o_undo_delta SET counter = counter + 1;")
+			size = con.execute("""SELECT last_used_location
+								  FROM pg_stat_orioledb_undo
+								  WHERE undo_type = 'row';""")[0][0] - start
+			con.commit()
+			con.close()
+			return size
+
+		full_size = undo_size('off')
+		delta_size = undo_size('on')
+		self.assertLess(delta_size * 2, full_size)
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con2.begin()
+		con2.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		self.assertEqual(
+		    con2.execute("SELECT sum(counter) FROM o_undo_delta;")[0][0],
+		    20000)
+
+		con1.begin()
+		con1.execute("SET orioledb.undo_update_delta = on;")
+		con1.execute("UPDATE o_undo_delta SET counter = counter + 1;")
+		con1.execute("SAVEPOINT s1;")
+		con1.execute("UPDATE o_undo_delta SET counter = counter + 1;")
+		con1.execute("DELETE FROM o_undo_delta WHERE id % 10 = 0;")
+		con1.execute("ROLLBACK TO SAVEPOINT s1;")
+		con1.execute("UPDATE o_undo_delta SET counter = counter * 2;")
+		self.assertEqual(
+		    con1.execute("SELECT sum(counter) FROM o_undo_delta;")[0][0],
+		    60000)
+		con1.commit()
+
+		self.assertEqual(
+		    con2.execute("""SELECT count(*), sum(counter)
+						    FROM o_undo_delta
+						    WHERE val = repeat('x', 200) || id;""")[0],
+		    (10000, 20000))
+		con2.commit()
+
+		con1.begin()
+		con1.execute("UPDATE o_undo_delta SET counter = counter + 1;")
+		con1.rollback()
+		self.assertEqual(
+		    node.execute("""SELECT count(*), sum(counter)
+						    FROM o_undo_delta
+						    WHERE val = repeat('x', 200) || id;""")[0],
+		    (10000, 60000))
+		self.assertTrue(
+		    node.execute(
+		        "SELECT orioledb_tbl_check('o_undo_delta'::regclass)")[0][0])
+
+		con1.close()
+		con2.close()
+		node.stop()
+
+	def test_undo_stats(self):
+		node = self.node
+		node.execute(
+		    "INSERT INTO o_undo_evict (SELECT i, i FROM generate_series(1, 100000) i);"
+		)
+
+		con1 = node.connect()
+		con2 = node.connect()
+		con2.begin()
+		con2.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		con2_pid = con2.execute("SELECT pg_backend_pid();")[0][0]
+		self.assertEqual(
+		    con2.execute("SELECT COUNT(*) FROM o_undo_evict;")[0][0], 100000)
+
+		con1.execute("UPDATE o_undo_evict SET value = value + 1;")
+		con1.commit()
+
+		self.assertEqual(
+		    con2.execute("SELECT SUM(value) FROM o_undo_evict;")[0][0],
+		    5000050000)
+
+		rows = node.execute("""
+			SELECT undo_type, retaining_pid, retaining_kind,
+				   retaining_age >= interval '0', retained_bytes > 0,
+				   evicted_bytes > 0, disk_reads > 0,
+				   buffer_fill BETWEEN 0 AND 1
+			FROM pg_stat_orioledb_undo
+			WHERE undo_type = 'row';""")
+		self.assertEqual(rows,
+		                 [('row', con2_pid, 'snapshot', True, True, True, True,
+		                   True)])
+		con2.commit()
+
+		self.assertEqual(
+		    node.execute("""SELECT count(*) FROM pg_stat_orioledb_undo
+		                    WHERE retaining_pid = %d;""" % con2_pid)[0][0], 0)
+
+		con1.close()
+		con2.close()
+		node.stop()
+
+	def test_undo_adaptive_split(self):
+		node = self.node
+		node.stop()
+		node.append_conf('postgresql.conf',
+		                 "orioledb.undo_adaptive_split = on\n")
+		node.start()
+
+		def buffer_sizes():
+			return dict(
+			    node.execute("SELECT undo_type, buffer_size "
+			                 "FROM pg_stat_orioledb_undo;"))
+
+		initial = buffer_sizes()
+		con1 = node.connect()
+		con2 = node.connect()
+		con2.begin()
+		con2.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		self.assertEqual(
+		    con2.execute("SELECT COUNT(*) FROM o_undo_evict;")[0][0], 0)
+
+		# The row undo is retained by con2 and takes the memory of the others
+		for i in range(10):
+			con1.execute(
+			    "INSERT INTO o_undo_evict (SELECT i, i FROM generate_series(%d, %d) i);"
+			    % (i * 20000 + 1, (i + 1) * 20000))
+			con1.commit()
+			time.sleep(0.5)
+		sizes = buffer_sizes()
+		self.assertGreater(sizes['row'], initial['row'])
+		self.assertEqual(sum(sizes.values()), sum(initial.values()))
+
+		self.assertEqual(
+		    con2.execute("SELECT COUNT(*) FROM o_undo_evict;")[0][0], 0)
+		con2.commit()
+		self.assertEqual(
+		    node.execute("SELECT COUNT(*), SUM(value) FROM o_undo_evict;"),
+		    [(200000, 20000100000)])
+
+		con1.close()
+		con2.close()
+		node.stop()
+
+	def test_undo_image_limit(self):
+		node = self.node
+		node.safe_psql(
+		    'postgres', """
+			CREATE TABLE o_undo_image_limit (
+				id integer PRIMARY KEY,
+				val text NOT NULL
+			) USING orioledb;
+			INSERT INTO o_undo_image_limit
+				(SELECT i, 'x' FROM generate_series(1, 20000) i);
+		""")
+		con1 = node.connect()
+		con2 = node.connect()
+		con2.begin()
+		con2.execute("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ;")
+		self.assertEqual(
+		    con2.execute("SELECT COUNT(*) FROM o_undo_image_limit;")[0][0],
+		    20000)
+
+		# The grown rows split the pages, the old snapshot needs their images
+		con1.execute("UPDATE o_undo_image_limit SET val = repeat('y', 200);")
+		con1.commit()
+
+		con2.execute("SET orioledb.undo_image_limit = '8kB';")
+		con2.execute("SET orioledb.undo_limit_error = on;")
+		with self.assertRaises(QueryException) as e:
+			con2.execute("SELECT COUNT(*) FROM o_undo_image_limit "
+			             "WHERE val = 'x';")
+		self.assertIn("exceeded the limit of undo page image reconstruction",
+		              e.exception.message)
+		con2.rollback()
+
+		con2.begin()
+		con2.execute("SET orioledb.undo_image_limit = 0;")
+		self.assertEqual(
+		    con2.execute("SELECT COUNT(*) FROM o_undo_image_limit "
+		                 "WHERE val = 'x';")[0][0], 0)
+		con2.commit()
+
+		con1.close()
+		con2.close()
+		node.stop()
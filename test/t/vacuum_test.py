@@ -28,6 +28,59 @@ class VacuumTest(BaseTest):
 		node.start()
 		node.stop()
 
+	def test_vacuum_parallel_bridged(self):
+		node = self.node
+		node.start()
+		node.safe_psql("""
+			CREATE EXTENSION IF NOT EXISTS orioledb;
+
+			CREATE TABLE o_test_1(
+				val_1 int,
+				val_2 int
+			)USING orioledb;
+			CREATE INDEX o_test_1_ix1 ON o_test_1 (val_1)
+				WITH (orioledb_index=off);
+			CREATE INDEX o_test_1_ix2 ON o_test_1 (val_2)
+				WITH (orioledb_index=off);
+
+			CREATE TABLE o_test_2(
+				val_1 int PRIMARY KEY,
+				val_2 int
+			)USING orioledb;
+			CREATE INDEX o_test_2_ix1 ON o_test_2 (val_2)
+				WITH (orioledb_index=off);
+			CREATE INDEX o_test_2_ix2 ON o_test_2 (val_2, val_1)
+				WITH (orioledb_index=off);
+
+			INSERT INTO o_test_1
+				(SELECT val_1, val_1 + 10 FROM generate_series(1, 1000) AS val_1);
+			INSERT INTO o_test_2
+				(SELECT val_1, val_1 + 10 FROM generate_series(1, 1000) AS val_1);
+			DELETE FROM o_test_1 WHERE val_1 % 4 = 0;
+			DELETE FROM o_test_2 WHERE val_1 % 4 = 0;
+		""")
+
+		_, _, err = node.psql("VACUUM (PARALLEL 2) o_test_1;")
+		self.assertNotIn("disabling parallel option", err.decode("utf-8"))
+
+		# The workers can't tell the bridged indexes from the orioledb ones
+		_, _, err = node.psql("VACUUM (PARALLEL 2) o_test_2;")
+		self.assertIn(
+		    "cannot vacuum bridged indexes in parallel together "
+		    "with orioledb indexes", err.decode("utf-8"))
+
+		for table in ["o_test_1", "o_test_2"]:
+			self.assertEqual([(750, )],
+			                 node.execute(f"""
+					SET enable_seqscan = off;
+					SELECT count(*) FROM {table} WHERE val_2 > 0;
+				"""))
+			self.assertEqual([],
+			                 node.execute(f"""
+					SET enable_seqscan = off;
+					SELECT * FROM {table} WHERE val_2 = 14;
+				"""))
+
 	def test_vacuum_disable_page_skipping(self):
 		node = self.node
 		node.start()
@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+# coding: utf-8
+"""
+pgbench workloads stressing OrioleDB specifically.
+
+Every test runs a pgbench script from test/bench/pgbench and reports one
+JSON object with TPS, latency percentiles and deltas of the internal
+counters over the run.  The results go to the file given by
+WORKLOAD_RESULTS or to stdout.  WORKLOAD_DURATION (seconds, 10 by default)
+and WORKLOAD_CLIENTS (4 by default) control the size of the runs.
+
+	make USE_PGXS=1 workloads WORKLOAD_RESULTS=results.jsonl
+"""
+
+import glob
+import json
+import os
+import shutil
+import sys
+import tempfile
+import time
+
+from threading import Event, Thread
+
+from .base_test import BaseTest
+from .s3_base_test import S3BaseTest
+
+PGBENCH_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..',
+                           'bench', 'pgbench')
+DURATION = int(os.getenv('WORKLOAD_DURATION', '10'))
+CLIENTS = int(os.getenv('WORKLOAD_CLIENTS', '4'))
+
+COUNTERS = {
+    'trees':
+    """
+		SELECT sum(hits), sum(misses), sum(disk_loads), sum(s3_loads),
+			   sum(evictions), sum(writes), sum(splits), sum(merges)
+		FROM pg_stat_orioledb_trees;
+	""",
+    'eviction':
+    """
+		SELECT sum(stalls), sum(stall_time_us), sum(bgwriter_evictions)
+		FROM orioledb_eviction_stats();
+	""",
+    'undo':
+    """
+		SELECT sum(evicted_bytes), sum(retained_bytes), sum(disk_reads)
+		FROM pg_stat_orioledb_undo;
+	""",
+    'checkpoint':
+    """
+		SELECT max(checkpoint_number) FROM pg_stat_orioledb_checkpoint;
+	""",
+    's3':
+    """
+		SELECT sum(requests), sum(bytes), sum(errors)
+		FROM pg_stat_orioledb_s3;
+	""",
+    's3_headers':
+    """
+		SELECT sum(lookups), sum(misses), sum(cold_reads)
+		FROM pg_stat_orioledb_s3_headers;
+	"""
+}
+
+COUNTER_NAMES = {
+    'trees': [
+        'hits', 'misses', 'disk_loads', 's3_loads', 'evictions', 'writes',
+        'splits', 'merges'
+    ],
+    'eviction': ['stalls', 'stall_time_us', 'bgwriter_evictions'],
+    'undo': ['evicted_bytes', 'retained_bytes', 'disk_reads'],
+    'checkpoint': ['checkpoints'],
+    's3': ['requests', 'bytes', 'errors'],
+    's3_headers': ['lookups', 'misses', 'cold_reads']
+}
+
+
+class WorkloadMixin:
+
+	def initWorkloadNode(self, main_buffers='128MB', extra_conf=''):
+		node = self.node
+		node.append_conf(
+		    'postgresql.conf', "orioledb.main_buffers = %s\n"
+		    "orioledb.tree_stats_max = 128\n"
+		    "max_connections = 100\n" % main_buffers + extra_conf)
+		node.start()
+		node.safe_psql("CREATE EXTENSION IF NOT EXISTS orioledb;")
+
+	def createWorkloadTable(self, rows, payload=100):
+		self.node.safe_psql("""
+			CREATE TABLE o_workload (
+				id int PRIMARY KEY,
+				val int NOT NULL,
+				payload text
+			) USING orioledb;
+			INSERT INTO o_workload
+				SELECT v, 0, repeat('x', %d) FROM generate_series(1, %d) v;
+		""" % (payload, rows))
+
+	def readCounters(self, groups):
+		counters = {}
+		for group in groups:
+			row = self.node.execute(COUNTERS[group])[0]
+			for name, value in zip(COUNTER_NAMES[group], row):
+				counters[group + '.' + name] = float(value or 0)
+		return counters
+
+	def runPgbench(self, script, groups, defines, clients=CLIENTS,
+	               duration=DURATION):
+		log_dir = tempfile.mkdtemp(prefix='orioledb_workload_')
+		options = [
+		    '-n', '-c',
+		    str(clients), '-j',
+		    str(min(clients, 4)), '-T',
+		    str(duration), '-f',
+		    os.path.join(PGBENCH_DIR, script), '-l',
+		    '--log-prefix=%s' % os.path.join(log_dir, 'log')
+		]
+		for name, value in defines.items():
+			options += ['-D', '%s=%s' % (name, value)]
+
+		before = self.readCounters(groups)
+		output = self.node.pgbench_run(options=options)
+		after = self.readCounters(groups)
+
+		latencies = []
+		for path in glob.glob(os.path.join(log_dir, 'log*')):
+			with open(path) as f:
+				for line in f:
+					fields = line.split()
+					if len(fields) >= 3:
+						latencies.append(int(fields[2]) / 1000.0)
+		shutil.rmtree(log_dir)
+		latencies.sort()
+
+		tps = None
+		for line in output.splitlines():
+			if line.startswith('tps = '):
+				tps = float(line.split()[2])
+
+		def percentile(p):
+			if not latencies:
+				return None
+			return latencies[min(len(latencies) - 1,
+			                     int(len(latencies) * p / 100.0))]
+
+		return {
+		    'script': script,
+		    'clients': clients,
+		    'duration': duration,
+		    'tps': tps,
+		    'transactions': len(latencies),
+		    'latency_ms': {
+		        'p50': percentile(50),
+		        'p95': percentile(95),
+		        'p99': percentile(99),
+		        'max': latencies[-1] if latencies else None
+		    },
+		    'counters': {
+		        name: after[name] - before[name]
+		        for name in after
+		    }
+		}
+
+	def report(self, workload, result):
+		result = dict(workload=workload, **result)
+		path = os.getenv('WORKLOAD_RESULTS')
+		if path:
+			with open(path, 'a') as f:
+				f.write(json.dumps(result) + '\n')
+		else:
+			sys.stdout.write(json.dumps(result) + '\n')
+		self.assertGreater(result['tps'], 0)
+
+
+class WorkloadsTest(WorkloadMixin, BaseTest):
+
+	def test_eviction_heavy(self):
+		# The working set is several times bigger than main_buffers
+		rows = 400000
+		self.initWorkloadNode(main_buffers='8MB')
+		self.createWorkloadTable(rows, payload=200)
+		result = self.runPgbench('point_select.sql', ['trees', 'eviction'],
+		                         {'rows': rows})
+		self.report('eviction_heavy', result)
+		self.node.stop()
+
+	def test_hot_rows(self):
+		rows = 10000
+		self.initWorkloadNode()
+		self.createWorkloadTable(rows)
+		result = self.runPgbench('hot_rows.sql', ['trees', 'undo'], {
+		    'rows': rows,
+		    'hot_rows': 10
+		},
+		                         clients=max(CLIENTS, 16))
+		self.report('hot_rows', result)
+		self.node.stop()
+
+	def test_long_snapshot(self):
+		# An old snapshot retains the undo of all the concurrent updates
+		rows = 100000
+		self.initWorkloadNode(extra_conf="orioledb.undo_buffers = 8MB\n")
+		self.createWorkloadTable(rows)
+		con = self.node.connect()
+		con.begin('repeatable read')
+		con.execute("SELECT count(*) FROM o_workload;")
+		result = self.runPgbench('update.sql', ['trees', 'undo'],
+		                         {'rows': rows})
+		self.assertEqual([(rows, )],
+		                 con.execute("SELECT count(*) FROM o_workload;"))
+		con.commit()
+		con.close()
+		self.report('long_snapshot', result)
+		self.node.stop()
+
+	def test_checkpoint_under_load(self):
+		rows = 100000
+		self.initWorkloadNode()
+		self.createWorkloadTable(rows)
+		stop = Event()
+		checkpoints = []
+
+		def checkpointer():
+			con = self.node.connect()
+			while not stop.wait(2.0):
+				start = time.monotonic()
+				con.execute("CHECKPOINT;")
+				checkpoints.append(time.monotonic() - start)
+			con.close()
+
+		t = Thread(target=checkpointer)
+		t.start()
+		try:
+			result = self.runPgbench('update.sql', ['trees', 'checkpoint'],
+			                         {'rows': rows})
+		finally:
+			stop.set()
+			t.join()
+		result['checkpoint_seconds'] = checkpoints
+		self.report('checkpoint_under_load', result)
+		self.node.stop()
+
+	def test_recovery_replay(self):
+		rows = 100000
+		self.initWorkloadNode(extra_conf="checkpoint_timeout = 1h\n")
+		self.createWorkloadTable(rows)
+		self.node.safe_psql("CHECKPOINT;")
+		start_lsn = self.node.execute("SELECT pg_current_wal_lsn();")[0][0]
+		result = self.runPgbench('update.sql', ['trees'], {'rows': rows})
+		wal_bytes = self.node.execute(
+		    "SELECT pg_current_wal_lsn() - '%s'::pg_lsn;" % start_lsn)[0][0]
+
+		self.node.stop(['-m', 'immediate'])
+		start = time.monotonic()
+		self.node.start()
+		self.node.safe_psql("SELECT 1;")
+		result['replay_seconds'] = time.monotonic() - start
+		result['replay_wal_bytes'] = float(wal_bytes)
+		self.report('recovery_replay', result)
+		self.node.stop()
+
+
+class S3WorkloadsTest(WorkloadMixin, S3BaseTest):
+
+	def test_s3_cold_reads(self):
+		# The local copy is limited below the data size, so the reads of
+		# the evicted parts go to S3
+		rows = 200000
+		self.initWorkloadNode(extra_conf=f"""
+			orioledb.s3_mode = true
+			orioledb.s3_host = '{self.host}:{self.port}/{self.bucket_name}'
+			orioledb.s3_region = '{self.region}'
+			orioledb.s3_accesskey = '{self.access_key_id}'
+			orioledb.s3_secretkey = '{self.secret_access_key}'
+			orioledb.s3_cainfo = '{self.s3_cainfo}'
+			orioledb.s3_desired_size = 10MB
+			orioledb.s3_desired_size_max = 20MB
+		""")
+		self.createWorkloadTable(rows, payload=200)
+		self.node.safe_psql("CHECKPOINT;")
+		for _ in range(60):
+			loaded = self.node.execute(
+			    "SELECT loaded_size FROM pg_stat_orioledb_s3_headers;")[0][0]
+			if loaded <= 20 * 1024 * 1024:
+				break
+			time.sleep(1)
+		self.node.restart()
+		result = self.runPgbench('point_select.sql',
+		                         ['trees', 's3', 's3_headers'],
+		                         {'rows': rows})
+		self.report('s3_cold_reads', result)
+		self.node.stop()